@@ -0,0 +1,347 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fleet_benchmark.cpp
+ * @brief	 End to end benchmark of a fleet of robots
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/diff_drive.h>
+#include <flatland_server/step_timer.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <geometry_msgs/Twist.h>
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+namespace {
+
+/**
+ * The options of the scenario, from the command line
+ */
+struct Options {
+  unsigned int robots = 100;    ///< number of robots
+  unsigned int steps = 2000;    ///< steps timed after the warm up
+  unsigned int warmup = 100;    ///< steps run before timing
+  double step_size = 0.005;     ///< simulated seconds per step
+  unsigned int seed = 1;        ///< seed of the headings of the robots
+  unsigned int sensor_threads = 0;   ///< world property, 0 for the default
+  unsigned int plugin_threads = 0;   ///< world property, 0 for the default
+  unsigned int physics_threads = 0;  ///< world property, 0 for the default
+  std::string physics_backend = "box2d";  ///< world property
+  std::string write_dir;  ///< only write the scenario to it, if not empty
+  std::string json_file;  ///< also write the results to it, if not empty
+};
+
+/**
+ * @brief Read a memory figure of the process from /proc/self/status
+ * @param[in] key VmRSS for the resident size, VmHWM for its peak
+ * @return The size in MB, 0 if unknown
+ */
+double ReadMemory(const std::string &key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, key.size() + 1, key + ":") == 0) {
+      return std::atof(line.c_str() + key.size() + 1) / 1024.0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Write the scenario: a map of 1 m boxes 4 m apart, with the robots
+ * at every other crossing of the lanes between the boxes
+ * @param[in] options The options of the scenario
+ * @param[in] dir Directory to write world.yaml and the other files to
+ */
+void WriteScenario(const Options &options, const fs::path &dir) {
+  fs::create_directories(dir);
+  unsigned int columns =
+      static_cast<unsigned int>(std::ceil(std::sqrt(options.robots)));
+  unsigned int boxes = 2 * columns + 10;
+
+  std::ofstream data_file((dir / "map.dat").string());
+  for (unsigned int i = 0; i < boxes; i++) {
+    for (unsigned int j = 0; j < boxes; j++) {
+      double x = i * 4.0, y = j * 4.0;
+      data_file << x << " " << y << " " << x + 1 << " " << y << "\n"
+                << x + 1 << " " << y << " " << x + 1 << " " << y + 1 << "\n"
+                << x + 1 << " " << y + 1 << " " << x << " " << y + 1 << "\n"
+                << x << " " << y + 1 << " " << x << " " << y << "\n";
+    }
+  }
+  data_file.close();
+
+  std::ofstream map_file((dir / "map.yaml").string());
+  map_file << "type: line_segments\n"
+           << "data: map.dat\n"
+           << "scale: 1\n"
+           << "origin: [0, 0, 0]\n";
+  map_file.close();
+
+  std::ofstream robot_file((dir / "robot.model.yaml").string());
+  robot_file << "bodies:\n"
+             << "  - name: base\n"
+             << "    type: dynamic\n"
+             << "    footprints:\n"
+             << "      - {type: circle, density: 1, radius: 0.25}\n"
+             << "plugins:\n"
+             << "  - {type: DiffDrive, name: drive, body: base, "
+             << "pub_rate: 20}\n"
+             << "  - {type: Laser, name: laser, body: base, range: 10, "
+             << "update_rate: 10, angle: {min: -2.356194490192345, "
+             << "max: 2.356194490192345, increment: 0.017453292519943295}}\n"
+             << "  - {type: Bumper, name: bumper, update_rate: 10}\n"
+             << "  - {type: ModelTfPublisher, name: tf_publisher, "
+             << "update_rate: 10}\n";
+  robot_file.close();
+
+  std::mt19937 rng(options.seed);
+  std::uniform_real_distribution<double> heading(-M_PI, M_PI);
+  std::ofstream world_file((dir / "world.yaml").string());
+  world_file << "properties:\n"
+             << "  sensor_threads: " << options.sensor_threads << "\n"
+             << "  plugin_threads: " << options.plugin_threads << "\n"
+             << "  physics_threads: " << options.physics_threads << "\n"
+             << "  physics_backend: " << options.physics_backend << "\n"
+             << "layers:\n"
+             << "  - name: walls\n"
+             << "    map: map.yaml\n"
+             << "models:\n";
+  for (unsigned int k = 0; k < options.robots; k++) {
+    double x = (2 * (k % columns) + 1) * 4.0 + 2.5;
+    double y = (2 * (k / columns) + 1) * 4.0 + 2.5;
+    world_file << "  - name: robot_" << k << "\n"
+               << "    namespace: robot_" << k << "\n"
+               << "    pose: [" << x << ", " << y << ", " << heading(rng)
+               << "]\n"
+               << "    model: robot.model.yaml\n";
+  }
+  world_file.close();
+}
+
+/**
+ * @brief Parse the command line, exits on invalid options
+ * @return The options
+ */
+Options ParseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || i + 1 >= argc) {
+      printf(
+          "usage: fleet_benchmark [--robots N] [--steps N] [--warmup N]\n"
+          "  [--step-size S] [--seed N] [--sensor-threads N]\n"
+          "  [--plugin-threads N] [--physics-threads N]\n"
+          "  [--physics-backend NAME] [--write DIR] [--json FILE]\n");
+      std::exit(arg == "--help" ? 0 : 1);
+    }
+    std::string value = argv[++i];
+    if (arg == "--robots") {
+      options.robots = std::stoul(value);
+    } else if (arg == "--steps") {
+      options.steps = std::stoul(value);
+    } else if (arg == "--warmup") {
+      options.warmup = std::stoul(value);
+    } else if (arg == "--step-size") {
+      options.step_size = std::stod(value);
+    } else if (arg == "--seed") {
+      options.seed = std::stoul(value);
+    } else if (arg == "--sensor-threads") {
+      options.sensor_threads = std::stoul(value);
+    } else if (arg == "--plugin-threads") {
+      options.plugin_threads = std::stoul(value);
+    } else if (arg == "--physics-threads") {
+      options.physics_threads = std::stoul(value);
+    } else if (arg == "--physics-backend") {
+      options.physics_backend = value;
+    } else if (arg == "--write") {
+      options.write_dir = value;
+    } else if (arg == "--json") {
+      options.json_file = value;
+    } else {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      std::exit(1);
+    }
+  }
+  if (options.robots == 0 || options.steps == 0 || options.step_size <= 0) {
+    fprintf(stderr, "robots, steps and step-size must be positive\n");
+    std::exit(1);
+  }
+  return options;
+}
+
+/**
+ * @brief Send the scripted command of each robot for the time of a step, the
+ * robots weave with their own phase
+ * @param[in] drives The drive of each robot
+ * @param[in] t Simulated time
+ */
+void DriveRobots(const std::vector<DiffDrive *> &drives, double t) {
+  geometry_msgs::Twist twist;
+  for (size_t k = 0; k < drives.size(); k++) {
+    double phase = 2 * M_PI * k / drives.size();
+    twist.linear.x = 0.4 + 0.2 * std::sin(0.5 * t + phase);
+    twist.angular.z = 0.6 * std::sin(0.3 * t + 2 * phase);
+    drives[k]->TwistCallback(twist);
+  }
+}
+};  // namespace
+
+// Run with a roscore running, the plugins advertise their topics
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "fleet_benchmark", ros::init_options::AnonymousName);
+  Options options = ParseOptions(argc, argv);
+
+  if (!options.write_dir.empty()) {
+    WriteScenario(options, options.write_dir);
+    printf("scenario written to %s\n",
+           (fs::path(options.write_dir) / "world.yaml").string().c_str());
+    return 0;
+  }
+
+  fs::path dir = fs::temp_directory_path() /
+                 fs::unique_path("flatland_fleet_%%%%-%%%%-%%%%");
+  WriteScenario(options, dir);
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point load_start = Clock::now();
+  World *world = World::MakeWorld((dir / "world.yaml").string(), "", true);
+  double load_time =
+      std::chrono::duration<double>(Clock::now() - load_start).count();
+  double load_memory = ReadMemory("VmRSS");
+
+  std::vector<DiffDrive *> drives;
+  for (const auto &plugin : world->plugin_manager_.model_plugins_) {
+    DiffDrive *drive = dynamic_cast<DiffDrive *>(plugin.get());
+    if (drive) {
+      drives.push_back(drive);
+    }
+  }
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(options.step_size);
+  for (unsigned int i = 0; i < options.warmup; i++) {
+    DriveRobots(drives, timekeeper.GetSimTime().toSec());
+    world->Update(timekeeper);
+  }
+
+  // free run, the steps are timed one by one and broken down by stage and
+  // by plugin type
+  world->step_timer_.SetEnabled(true);
+  world->step_timer_.Reset();
+  world->plugin_manager_.SetProfiling(true);
+  world->plugin_manager_.ResetCosts();
+  TimingHistogram steps;
+  Clock::time_point run_start = Clock::now();
+  for (unsigned int i = 0; i < options.steps; i++) {
+    Clock::time_point step_start = Clock::now();
+    DriveRobots(drives, timekeeper.GetSimTime().toSec());
+    world->Update(timekeeper);
+    steps.Add(std::chrono::duration<double>(Clock::now() - step_start).count());
+  }
+  double run_time =
+      std::chrono::duration<double>(Clock::now() - run_start).count();
+
+  double steps_per_sec = options.steps / run_time;
+  double rss = ReadMemory("VmRSS"), peak_rss = ReadMemory("VmHWM");
+
+  printf("robots %u, steps %u of %.4f s, physics %s\n", options.robots,
+         options.steps, options.step_size,
+         world->physics_->GetName().c_str());
+  printf("load %.2f s, memory after load %.1f MB\n", load_time, load_memory);
+  printf("steps/s %.1f, real time factor %.2f\n", steps_per_sec,
+         steps_per_sec * options.step_size);
+  printf("step time p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+         steps.GetPercentile(50) * 1e3, steps.GetPercentile(99) * 1e3,
+         steps.GetMax() * 1e3);
+  printf("memory rss %.1f MB, peak %.1f MB\n", rss, peak_rss);
+
+  printf("\n%-28s %10s %10s\n", "stage", "mean ms", "p99 ms");
+  for (int i = 0; i < StepTimer::STAGE_COUNT; i++) {
+    StepTimer::Stage stage = StepTimer::Stage(i);
+    const TimingHistogram &histogram = world->step_timer_.GetHistogram(stage);
+    if (histogram.GetCount() > 0) {
+      printf("%-28s %10.3f %10.3f\n", StepTimer::GetStageName(stage),
+             histogram.GetMean() * 1e3, histogram.GetPercentile(99) * 1e3);
+    }
+  }
+
+  printf("\n%-28s %10s %14s\n", "plugin type", "instances", "ms per step");
+  for (const auto &entry : world->plugin_manager_.GetPluginTypeCosts()) {
+    printf("%-28s %10u %14.3f\n", entry.type.c_str(), entry.instances,
+           entry.cost.Total() * 1e3 / options.steps);
+  }
+
+  // flat metrics for scripts/perf_regression.py
+  if (!options.json_file.empty()) {
+    std::ofstream json(options.json_file);
+    json << "{\n"
+         << "  \"robots\": " << options.robots << ",\n"
+         << "  \"steps\": " << options.steps << ",\n"
+         << "  \"load_s\": " << load_time << ",\n"
+         << "  \"steps_per_sec\": " << steps_per_sec << ",\n"
+         << "  \"real_time_factor\": " << steps_per_sec * options.step_size
+         << ",\n"
+         << "  \"step_p50_ms\": " << steps.GetPercentile(50) * 1e3 << ",\n"
+         << "  \"step_p99_ms\": " << steps.GetPercentile(99) * 1e3 << ",\n"
+         << "  \"rss_mb\": " << rss << ",\n"
+         << "  \"peak_rss_mb\": " << peak_rss << "\n"
+         << "}\n";
+  }
+
+  delete world;
+  fs::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 laser_benchmark.cpp
+ * @brief	 Microbenchmarks of the laser raycasts
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <flatland_plugins/laser.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/world.h>
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <string>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+namespace {
+
+/**
+ * The maps the laser is benchmarked on
+ */
+enum MapKind {
+  OFFICE = 0,       ///< the map of flatland_server/test/conestogo_office_test
+  SYNTHETIC_S = 1,  ///< 50 x 50 boxes, 10000 line segments
+  SYNTHETIC_L = 2,  ///< 160 x 160 boxes, 102400 line segments
+};
+
+/**
+ * A headless world written to a temporary directory, with one robot carrying
+ * the benchmarked laser and dynamic obstacles on rings around it
+ */
+class LaserWorld {
+ public:
+  World *world_ = nullptr;  ///< the loaded world
+  Laser *laser_ = nullptr;  ///< the laser of the robot
+  fs::path dir_;            ///< directory of the world files
+
+  /**
+   * @param[in] map The MapKind of the layer
+   * @param[in] beams Number of beams of the laser
+   * @param[in] obstacles Number of dynamic obstacles
+   */
+  LaserWorld(int map, int beams, int obstacles) {
+    dir_ = fs::temp_directory_path() /
+           fs::unique_path("flatland_benchmark_%%%%-%%%%-%%%%");
+    fs::create_directories(dir_);
+
+    Pose robot(0, 0, 0);
+    std::string map_path;
+    if (map == OFFICE) {
+      map_path = (fs::path(__FILE__).parent_path() /
+                  "../../flatland_server/test/conestogo_office_test/map.yaml")
+                     .string();
+    } else {
+      int boxes = map == SYNTHETIC_S ? 50 : 160;
+      WriteBoxes(boxes);
+      map_path = "map.yaml";
+      // between the boxes in the middle of the map
+      robot = Pose(boxes / 2 * 4.0 - 1.5, boxes / 2 * 4.0 - 1.5, 0);
+    }
+
+    // min and max are inclusive, so the last beam stops one increment short
+    double increment = 2 * M_PI / beams;
+    std::ofstream robot_file((dir_ / "robot.model.yaml").string());
+    robot_file << "bodies:\n"
+               << "  - name: base_link\n"
+               << "    type: dynamic\n"
+               << "    footprints:\n"
+               << "      - {type: circle, density: 1, radius: 0.1}\n"
+               << "plugins:\n"
+               << "  - type: Laser\n"
+               << "    name: laser\n"
+               << "    body: base_link\n"
+               << "    range: 20\n"
+               << "    angle: {min: " << -M_PI << ", max: "
+               << -M_PI + increment * (beams - 1)
+               << ", increment: " << increment << "}\n";
+    robot_file.close();
+
+    std::ofstream obstacle_file((dir_ / "obstacle.model.yaml").string());
+    obstacle_file << "bodies:\n"
+                  << "  - name: base\n"
+                  << "    type: dynamic\n"
+                  << "    footprints:\n"
+                  << "      - {type: circle, density: 1, radius: 0.2}\n";
+    obstacle_file.close();
+
+    std::ofstream world_file((dir_ / "world.yaml").string());
+    world_file.precision(17);
+    world_file << "properties: {}\n"
+               << "layers:\n"
+               << "  - name: walls\n"
+               << "    map: \"" << map_path << "\"\n"
+               << "models:\n"
+               << "  - name: robot\n"
+               << "    pose: [" << robot.x << ", " << robot.y << ", 0]\n"
+               << "    model: robot.model.yaml\n";
+    // rings 0.6 m apart starting 1 m from the laser, 0.6 m between obstacles
+    double radius = 1;
+    int on_ring = 0;
+    for (int i = 0; i < obstacles; i++) {
+      int capacity = static_cast<int>(2 * M_PI * radius / 0.6);
+      if (on_ring == capacity) {
+        radius += 0.6;
+        on_ring = 0;
+        capacity = static_cast<int>(2 * M_PI * radius / 0.6);
+      }
+      double angle = 2 * M_PI * on_ring++ / capacity;
+      world_file << "  - name: obstacle_" << i << "\n"
+                 << "    pose: [" << robot.x + radius * std::cos(angle) << ", "
+                 << robot.y + radius * std::sin(angle) << ", 0]\n"
+                 << "    model: obstacle.model.yaml\n";
+    }
+    world_file.close();
+
+    world_ = World::MakeWorld((dir_ / "world.yaml").string(), "", true);
+    laser_ =
+        dynamic_cast<Laser *>(world_->plugin_manager_.model_plugins_[0].get());
+  }
+
+  ~LaserWorld() {
+    delete world_;
+    fs::remove_all(dir_);
+  }
+
+  /**
+   * @brief Write a line segments map of boxes x boxes 1 m boxes, 4 m apart
+   * @param[in] boxes Number of boxes along each axis
+   */
+  void WriteBoxes(int boxes) {
+    std::ofstream data_file((dir_ / "map.dat").string());
+    for (int i = 0; i < boxes; i++) {
+      for (int j = 0; j < boxes; j++) {
+        double x = i * 4.0, y = j * 4.0;
+        data_file << x << " " << y << " " << x + 1 << " " << y << "\n"
+                  << x + 1 << " " << y << " " << x + 1 << " " << y + 1 << "\n"
+                  << x + 1 << " " << y + 1 << " " << x << " " << y + 1 << "\n"
+                  << x << " " << y + 1 << " " << x << " " << y << "\n";
+      }
+    }
+    data_file.close();
+
+    std::ofstream map_file((dir_ / "map.yaml").string());
+    map_file << "type: line_segments\n"
+             << "data: map.dat\n"
+             << "scale: 1\n"
+             << "origin: [0, 0, 0]\n";
+    map_file.close();
+  }
+};
+
+/**
+ * Benchmark Laser::ComputeLaserRanges, the arguments are the MapKind, the
+ * number of beams, the number of obstacles and the number of workers
+ */
+void BM_ComputeLaserRanges(benchmark::State &state) {
+  SensorExecutor::Get().SetNumThreads(state.range(3));
+  LaserWorld laser_world(state.range(0), state.range(1), state.range(2));
+  Laser *laser = laser_world.laser_;
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    laser->ComputeLaserRanges();
+    benchmark::DoNotOptimize(laser->laser_scan_.ranges.data());
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  double beams = static_cast<double>(state.iterations()) * state.range(1);
+  state.SetItemsProcessed(static_cast<int64_t>(beams));
+  state.counters["ns/beam"] = ns / beams;
+  state.counters["scans/s"] = state.iterations() / (ns * 1e-9);
+}
+
+/**
+ * Sweep one argument at a time: the beams on every map, then the obstacles
+ * and the workers on the office map
+ */
+void LaserArguments(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"map", "beams", "obstacles", "workers"});
+  for (int map : {OFFICE, SYNTHETIC_S, SYNTHETIC_L}) {
+    for (int beams : {180, 720, 1440, 4000}) {
+      b->Args({map, beams, 0, 1});
+    }
+  }
+  for (int obstacles : {10, 50, 200}) {
+    b->Args({OFFICE, 720, obstacles, 1});
+  }
+  for (int workers : {2, 4, 8}) {
+    b->Args({OFFICE, 4000, 0, workers});
+  }
+}
+
+// the scans use the workers, so the CPU time of the main thread says nothing
+BENCHMARK(BM_ComputeLaserRanges)->Apply(LaserArguments)->UseRealTime();
+
+};  // namespace
+
+// Run with a roscore running, the laser advertises its topics
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "flatland_benchmarks",
+            ros::init_options::AnonymousName);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 spawn_benchmark.cpp
+ * @brief	 Benchmarks of the latency of spawning models
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <benchmark/benchmark.h>
+#include <flatland_server/tracer.h>
+#include <flatland_server/world.h>
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <string>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+
+namespace {
+
+/**
+ * A world with interactive markers written to a temporary directory, with an
+ * empty room of 120 x 120 m and a robot model like the ones of the fleet
+ * benchmark, with $eval expressions for the preprocessor
+ */
+class SpawnWorld {
+ public:
+  World *world_ = nullptr;  ///< the loaded world
+  fs::path dir_;            ///< directory of the world files
+  int spawned_ = 0;         ///< number of models spawned so far
+
+  SpawnWorld() {
+    dir_ = fs::temp_directory_path() /
+           fs::unique_path("flatland_spawn_%%%%-%%%%-%%%%");
+    fs::create_directories(dir_);
+
+    std::ofstream data_file((dir_ / "map.dat").string());
+    data_file << "0 0 120 0\n120 0 120 120\n120 120 0 120\n0 120 0 0\n";
+    data_file.close();
+
+    std::ofstream map_file((dir_ / "map.yaml").string());
+    map_file << "type: line_segments\n"
+             << "data: map.dat\n"
+             << "scale: 1\n"
+             << "origin: [0, 0, 0]\n";
+    map_file.close();
+
+    std::ofstream robot_file((dir_ / "robot.model.yaml").string());
+    robot_file << "bodies:\n"
+               << "  - name: base\n"
+               << "    type: dynamic\n"
+               << "    color: [1, 1, 1, 0.75]\n"
+               << "    footprints:\n"
+               << "      - type: polygon\n"
+               << "        density: 1\n"
+               << "        points: [[-0.3, -0.25], [0.3, -0.25], [0.35, 0], "
+               << "[0.3, 0.25], [-0.3, 0.25]]\n"
+               << "      - {type: circle, density: 0, radius: 0.1, "
+               << "center: [0.2, 0]}\n"
+               << "plugins:\n"
+               << "  - {type: DiffDrive, name: drive, body: base, "
+               << "pub_rate: 20}\n"
+               << "  - type: Laser\n"
+               << "    name: laser\n"
+               << "    body: base\n"
+               << "    range: $eval \"math.min(10, 4 * 3)\"\n"
+               << "    update_rate: 10\n"
+               << "    angle:\n"
+               << "      min: $eval \"-3 * math.pi / 4\"\n"
+               << "      max: $eval \"3 * math.pi / 4\"\n"
+               << "      increment: $eval \"math.pi / 180\"\n"
+               << "  - {type: Bumper, name: bumper, update_rate: 10}\n"
+               << "  - {type: ModelTfPublisher, name: tf_publisher, "
+               << "update_rate: 10, enabled: $eval \"true\"}\n";
+    robot_file.close();
+
+    std::ofstream world_file((dir_ / "world.yaml").string());
+    world_file << "properties: {}\n"
+               << "layers:\n"
+               << "  - name: walls\n"
+               << "    map: map.yaml\n"
+               << "models: []\n";
+    world_file.close();
+
+    world_ = World::MakeWorld((dir_ / "world.yaml").string());
+  }
+
+  ~SpawnWorld() {
+    delete world_;
+    fs::remove_all(dir_);
+  }
+
+  /**
+   * @brief Spawn a robot on the next cell of a 1.5 m grid
+   * @return The name of the robot
+   */
+  std::string Spawn() {
+    int k = spawned_++;
+    std::string name = "robot_" + std::to_string(k);
+    Pose pose(1.5 + (k % 75) * 1.5, 1.5 + (k / 75 % 75) * 1.5, 0);
+    world_->LoadModel("robot.model.yaml", name, name, pose);
+    return name;
+  }
+
+  /**
+   * @brief Move the modification time of the model file forward, so the
+   * next spawn loads and preprocesses it again instead of copying the cached
+   * template
+   */
+  void Touch() {
+    fs::path path = dir_ / "robot.model.yaml";
+    fs::last_write_time(path, fs::last_write_time(path) + 1);
+  }
+};
+
+/**
+ * @brief Add the time spent in the load phases traced since Tracer::Start
+ * @param[inout] phases ns per phase
+ */
+void AddPhases(std::map<std::string, double> *phases) {
+  for (const auto &phase : Tracer::Get().SumDurations("load")) {
+    (*phases)[phase.first] += phase.second;
+  }
+}
+
+/**
+ * @brief Report the load phases in ms per spawn
+ * @param[in] state The state of the benchmark
+ * @param[in] phases ns per phase
+ * @param[in] spawns Number of spawns timed
+ */
+void ReportPhases(benchmark::State &state,
+                  const std::map<std::string, double> &phases,
+                  double spawns) {
+  for (const auto &phase : phases) {
+    state.counters[phase.first + "_ms"] = phase.second * 1e-6 / spawns;
+  }
+  state.counters["spawns/s"] =
+      benchmark::Counter(spawns, benchmark::Counter::kIsRate);
+}
+
+/**
+ * Benchmark World::LoadModel of one robot in a world which already has some
+ * robots, the arguments are the number of robots already there and whether
+ * the model file is loaded cold, i.e. parsed and preprocessed again, or
+ * copied from the template cache
+ */
+void BM_Spawn(benchmark::State &state) {
+  SpawnWorld spawn_world;
+  for (int i = 0; i < state.range(0); i++) {
+    spawn_world.Spawn();
+  }
+
+  std::map<std::string, double> phases;
+  for (auto _ : state) {
+    state.PauseTiming();
+    if (state.range(1)) {
+      spawn_world.Touch();
+    }
+    Tracer::Get().Start();
+    state.ResumeTiming();
+
+    std::string name = spawn_world.Spawn();
+
+    state.PauseTiming();
+    Tracer::Get().Stop();
+    AddPhases(&phases);
+    spawn_world.world_->DeleteModel(name);
+    state.ResumeTiming();
+  }
+  ReportPhases(state, phases, state.iterations());
+}
+
+/**
+ * Benchmark a number of sequential World::LoadModel in a new world, to show
+ * how the spawns slow down as the world fills, the argument is the number of
+ * spawns
+ */
+void BM_SpawnSequence(benchmark::State &state) {
+  std::map<std::string, double> phases;
+  for (auto _ : state) {
+    state.PauseTiming();
+    SpawnWorld *spawn_world = new SpawnWorld();
+    Tracer::Get().Start();
+    state.ResumeTiming();
+
+    for (int i = 0; i < state.range(0); i++) {
+      spawn_world->Spawn();
+    }
+
+    state.PauseTiming();
+    Tracer::Get().Stop();
+    AddPhases(&phases);
+    delete spawn_world;
+    state.ResumeTiming();
+  }
+  ReportPhases(state, phases,
+               static_cast<double>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_Spawn)
+    ->ArgNames({"existing", "cold"})
+    ->ArgsProduct({{0, 10, 100, 1000}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SpawnSequence)
+    ->ArgNames({"spawns"})
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMillisecond);
+
+};  // namespace
+
+// Run with a roscore running, the plugins advertise their topics and the
+// world serves its interactive markers
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "flatland_spawn_benchmarks",
+            ros::init_options::AnonymousName);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -46,8 +46,10 @@
 
 #include <flatland_plugins/update_timer.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/trigger_volume.h>
 #include <ros/ros.h>
 #include <std_msgs/Bool.h>
+#include <memory>
 
 #ifndef FLATLAND_PLUGINS_BOOL_SENSOR_H
 #define FLATLAND_PLUGINS_BOOL_SENSOR_H
@@ -65,11 +67,23 @@ class BoolSensor : public ModelPlugin {
   Body *body_;          ///< The body to check collisions with
   double update_rate_;  ///< rate to publish message at
 
-  UpdateTimer update_timer_;    ///< for managing update rate
-  int collisions_ = 0;          ///< Current number of collisions
-  bool hit_something_ = false;  ///< "latch" var to ensure all hits published
+  bool publish_on_change_;  ///< whether to publish only when the state
+                            /// changes, and at heartbeat_rate_
+  double heartbeat_rate_;   ///< rate to publish at without changes, 0 for
+                            /// never
+
+  UpdateTimer update_timer_;     ///< for managing update rate
+  UpdateTimer heartbeat_timer_;  ///< for managing heartbeat rate
+  int collisions_ = 0;           ///< Current number of collisions
+  bool hit_something_ = false;   ///< "latch" var to ensure all hits published
+  bool published_ = false;       ///< if a state was published yet
+  bool published_state_ = false;  ///< the state published last
 
   ros::Publisher publisher_;  ///< For publishing the collisions
+  std::unique_ptr<TriggerVolume> trigger_volume_;  ///< the sensor footprints
+                                                 /// of the body when checked
+                                                 /// at the update rate
+                                                 /// instead of by contacts
 
   /**
    * @brief Initialization for the plugin
@@ -83,6 +97,11 @@ class BoolSensor : public ModelPlugin {
    */
   void AfterPhysicsStep(const Timekeeper &timekeeper) override;
 
+  /**
+   * @return true, the plugin only uses the contacts recorded by its callbacks
+   */
+  bool IsThreadSafe() const override { return true; }
+
   /**
    * @brief A method that is called for all Box2D begin contacts
    * @param[in] contact Box2D contact
@@ -44,9 +44,11 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_msgs/Collisions.h>
 #include <flatland_plugins/update_timer.h>
 #include <flatland_server/model_plugin.h>
 #include <ros/ros.h>
+#include <vector>
 
 #ifndef FLATLAND_PLUGINS_BUMPER_H
 #define FLATLAND_PLUGINS_BUMPER_H
@@ -62,10 +64,12 @@ namespace flatland_plugins {
 class Bumper : public ModelPlugin {
  public:
   struct ContactState {
+    b2Contact *contact;  ///< the Box2D contact, null once it ended
     int num_count;  ///< stores number of times post solve is called
     double sum_normal_impulses[2];      ///< sum of impulses for averaging later
     double sum_tangential_impulses[2];  ///< sum of impulses for averaging later
     b2Vec2 points[2];  ///< Box2D collision points, max of 2 from Box2D
+    int point_count;   ///< number of valid points, from the last post solve
     b2Vec2 normal;  ///< normal of collision points, all points have same normal
     int normal_sign;  ///< for flipping direction of normal when necessary
 
@@ -77,18 +81,78 @@ class Bumper : public ModelPlugin {
     void Reset();    ///< Reset counter and sums
   };
 
+  /**
+   * The contacts of a body of the model with another entity, summed up by
+   * AggregateContacts
+   */
+  struct PairState {
+    Body *body_A;      ///< the body of the model
+    Entity *entity_B;  ///< the other entity
+    Body *body_B;      ///< the other body of the strongest contact
+    double max_contact_force;  ///< force of the strongest contact so far
+    double force;  ///< summed force magnitude of the contact points
+    b2Vec2 weighted_point;   ///< sum of the points weighted by their force
+    b2Vec2 weighted_normal;  ///< sum of the normals weighted by their force
+    b2Vec2 point_sum;   ///< sum of the points, used without forces
+    b2Vec2 normal_sum;  ///< sum of the normals, used without forces
+    int point_count;    ///< number of contact points
+  };
+
   std::string topic_name_;
   std::string world_frame_id_;           ///< name of the world frame id
   std::vector<Body *> excluded_bodies_;  ///< bodies to ignore
   /// whether to publish all collisions, or strictly adhere to update rate
   bool publish_all_collisions_;
   double update_rate_;  ///< rate to publish message at
+  /// whether to publish only when contacts begin or end, and at
+  /// heartbeat_rate_, instead of at update_rate_
+  bool publish_on_change_;
+  double heartbeat_rate_;  ///< rate to publish at without changes, 0 for never
+  bool contacts_changed_ = false;  ///< a contact began or ended since the
+                                   /// last publish
+
+  /// whether to publish one collision per body of the model and other
+  /// entity instead of one per Box2D contact, see AggregateContacts
+  bool aggregate_;
+
+  UpdateTimer update_timer_;     ///< for managing update rate
+  UpdateTimer heartbeat_timer_;  ///< for managing heartbeat rate
+
+  /// For keeping track of contacts, in the order they began. Ended contacts
+  /// stay until CompactContacts removes them
+  std::vector<ContactState> contact_states_;
+  std::vector<int> contact_slots_;  ///< open addressing table of the indices
+                                    /// in contact_states_, -1 if free
+  size_t ended_contacts_ = 0;  ///< number of ended contacts in contact_states_
+  std::vector<PairState> pair_states_;  ///< scratch of AggregateContacts
+  std::vector<int> pair_slots_;  ///< scratch of AggregateContacts, open
+                                 /// addressing table of the indices in
+                                 /// pair_states_, -1 if free
+  ros::Publisher collisions_publisher_;  ///< For publishing the collisions
+  flatland_msgs::Collisions collisions_;  ///< reused for every message
+  std::vector<flatland_msgs::Collision>
+      spare_collisions_;  ///< collisions of earlier messages, kept with their
+                          /// buffers for later messages
 
-  UpdateTimer update_timer_;  ///< for managing update rate
+  /**
+   * @brief Find the state of a contact
+   * @param[in] contact Box2D contact
+   * @return The state, nullptr if the contact is not tracked
+   */
+  ContactState *FindContact(b2Contact *contact);
 
-  /// For keeping track of contacts
-  std::map<b2Contact *, ContactState> contact_states_;
-  ros::Publisher collisions_publisher_;  ///< For publishing the collisions
+  /**
+   * @brief Remove the ended contacts and rebuild contact_slots_, which is
+   * grown to keep it at most half full
+   */
+  void CompactContacts();
+
+  /**
+   * @brief Sum up the contacts of the step into pair_states_, one per body of
+   * the model and other entity, in a single pass over contact_states_
+   * @param[in] step_size Step size, converts the impulses to forces
+   */
+  void AggregateContacts(double step_size);
 
   /**
    * @brief Initialization for the plugin
@@ -108,6 +172,11 @@ class Bumper : public ModelPlugin {
    */
   void AfterPhysicsStep(const Timekeeper &timekeeper) override;
 
+  /**
+   * @return true, the plugin only uses the contacts recorded by its callbacks
+   */
+  bool IsThreadSafe() const override { return true; }
+
   /**
    * @brief A method that is called for all Box2D begin contacts
    * @param[in] contact Box2D contact
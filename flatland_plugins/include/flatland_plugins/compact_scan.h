@@ -0,0 +1,87 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	  compact_scan.h
+ * @brief   Quantization of laser scans into compact messages
+ * @author  Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_PLUGINS_COMPACT_SCAN_H
+#define FLATLAND_PLUGINS_COMPACT_SCAN_H
+
+#include <flatland_msgs/CompactScan.h>
+#include <sensor_msgs/LaserScan.h>
+#include <cstdint>
+
+namespace flatland_plugins {
+
+/**
+ * This class converts laser scans to and from flatland_msgs/CompactScan,
+ * whose ranges are uint16 multiples of a resolution and intensities uint8,
+ * and without the metadata that can be derived
+ */
+class CompactScan {
+ public:
+  static const uint16_t NO_RETURN = 0;  ///< range of the beams without return
+  static const uint16_t MAX_RANGE = 65535;  ///< largest quantized range
+
+  /**
+   * @brief Quantize a scan, the vectors of the message are reused
+   * @param[in] scan The scan, NaN ranges are beams without return
+   * @param[in] resolution Meters per unit of the ranges, the max range of the
+   * scan must be at most MAX_RANGE times the resolution
+   * @param[in] intensities If the intensities are sent, only if the scan has
+   * some
+   * @param[out] compact The compact scan
+   */
+  static void Encode(const sensor_msgs::LaserScan &scan, float resolution,
+                     bool intensities, flatland_msgs::CompactScan *compact);
+
+  /**
+   * @brief Restore a scan, the vectors of the scan are reused
+   * @param[in] compact The compact scan
+   * @param[out] scan The scan, the beams without return have NaN ranges
+   */
+  static void Decode(const flatland_msgs::CompactScan &compact,
+                     sensor_msgs::LaserScan *scan);
+};
+};      // namespace flatland_plugins
+#endif  // FLATLAND_PLUGINS_COMPACT_SCAN_H
@@ -0,0 +1,186 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 crowd.h
+ * @brief	 Crowd of pedestrian agents
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/body.h>
+#include <flatland_server/entity.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world_plugin.h>
+#include <ros/ros.h>
+#include <visualization_msgs/Marker.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef FLATLAND_PLUGINS_CROWD_H
+#define FLATLAND_PLUGINS_CROWD_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class simulates a crowd of pedestrians without a model per agent. The
+ * agents are kinematic circle bodies walking to random goals in an area,
+ * their velocities are set on every step by a social force model computed in
+ * parallel over arrays of agent states, repelled by the other agents, the
+ * walls and the models. They are in the layers like models, so lasers see
+ * them and bumpers report collisions with them
+ */
+class Crowd : public WorldPlugin {
+ public:
+  /**
+   * The entity the agents belong to, so plugins looking up the entity of a
+   * body find the crowd
+   */
+  class Agents : public Entity {
+   public:
+    Agents(b2World *physics_world, const std::string &name)
+        : Entity(physics_world, name) {}
+    EntityType Type() const override { return EntityType::MODEL; }
+    void DebugVisualize() const override {}
+    void DebugOutput() const override {}
+  };
+
+  std::unique_ptr<Agents> agents_;  ///< entity of the agents
+  std::unique_ptr<Body> anchor_;    ///< user data shared by the agent bodies
+
+  unsigned int count_;        ///< number of agents
+  double radius_;             ///< radius of an agent
+  double desired_speed_;      ///< speed an agent walks at without obstacles
+  double max_speed_;          ///< max speed of an agent
+  double relaxation_time_;    ///< time to reach the desired velocity
+  double agent_strength_;     ///< magnitude of the agent repulsion
+  double agent_range_;        ///< decay distance of the agent repulsion
+  double wall_strength_;      ///< magnitude of the wall repulsion
+  double wall_range_;         ///< decay distance of the wall repulsion
+  double neighbor_distance_;  ///< distance of the agents and walls considered
+  double goal_tolerance_;     ///< distance at which a goal is reached
+  b2AABB area_;               ///< area of the positions and goals
+  uint32_t layers_bits_;      ///< layers of the agents
+
+  std::mt19937 rng_;  ///< picks the positions and goals
+
+  std::vector<b2Body *> bodies_;        ///< body of each agent
+  std::vector<float> x_, y_;            ///< position of each agent
+  std::vector<float> vx_, vy_;          ///< velocity of each agent
+  std::vector<float> goal_x_, goal_y_;  ///< goal of each agent
+  std::vector<uint8_t> arrived_;        ///< if an agent reached its goal
+
+  std::vector<uint32_t> cell_start_;   ///< first agent of each grid bucket
+  std::vector<uint32_t> cell_agents_;  ///< agents sorted by grid bucket
+  std::vector<uint32_t> agent_cell_;   ///< grid bucket of each agent
+  uint32_t bucket_mask_;               ///< number of buckets minus one
+
+  ros::Publisher marker_publisher_;    ///< publishes the agents as one marker
+  visualization_msgs::Marker marker_;  ///< marker of the agents
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Compute the velocities of the agents for the step
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Publish the marker of the agents
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return The state of the generator of the positions and goals, see
+   * StateHasher
+   */
+  uint64_t GetRandomState() const override;
+
+  /**
+   * @brief Destructor, the agent bodies are destroyed with the Box2D world
+   */
+  ~Crowd();
+
+  /**
+   * @brief Sort the agents into the buckets of a grid of cells of the
+   * neighbor distance
+   */
+  void BuildGrid();
+
+  /**
+   * @brief Compute the velocities of the agents [begin, end), safe to call
+   * concurrently for disjoint ranges
+   * @param[in] begin First agent
+   * @param[in] end One past the last agent
+   * @param[in] dt Step size
+   */
+  void ComputeVelocities(unsigned int begin, unsigned int end, float dt);
+
+  /**
+   * @brief Check if an agent fits at a position, away from the walls, the
+   * models and the other agents
+   * @param[in] p The position
+   * @return true if the agent fits
+   */
+  bool IsFree(const b2Vec2 &p) const;
+
+  /**
+   * @return A random point of the area
+   */
+  b2Vec2 RandomPoint();
+
+  /**
+   * @return The grid bucket of a cell
+   */
+  uint32_t CellBucket(int cx, int cy) const;
+};
+};
+
+#endif
@@ -47,12 +47,15 @@
 #include <Box2D/Box2D.h>
 #include <flatland_plugins/update_timer.h>
 #include <flatland_plugins/dynamics_limits.h>
+#include <flatland_plugins/odometry_noise.h>
+#include <flatland_server/extrapolator.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/recorded_subscriber.h>
 #include <flatland_server/timekeeper.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
 #include <tf/transform_broadcaster.h>
-#include <random>
+#include <mutex>
 
 #ifndef FLATLAND_PLUGINS_DIFFDRIVE_H
 #define FLATLAND_PLUGINS_DIFFDRIVE_H
@@ -63,7 +66,7 @@ namespace flatland_plugins {
 
 class DiffDrive : public flatland_server::ModelPlugin {
  public:
-  ros::Subscriber twist_sub_;
+  RecordedSubscriber twist_sub_;  ///< recorded and replayed by the Recorder
   ros::Publisher odom_pub_;
   ros::Publisher ground_truth_pub_;
   ros::Publisher twist_pub_;
@@ -80,8 +83,35 @@ class DiffDrive : public flatland_server::ModelPlugin {
   double angular_velocity_ = 0.0;
   double linear_velocity_ = 0.0;
 
-  std::default_random_engine rng_;
-  std::array<std::normal_distribution<double>, 6> noise_gen_;
+  OdometryNoise noise_;  ///< noise of the odometry and twist
+
+  ros::Publisher latency_pub_;    ///< publishes the command latency, when
+                                  /// traced
+  double next_latency_pub_ = 0;   ///< wall time of the next latency message
+
+  double extrapolation_rate_ = 0;  ///< rate of the odometry extrapolated
+                                   /// between the physics steps, in Hz of
+                                   /// wall time, 0 to publish on the steps
+  unsigned int extrapolation_task_ = 0;  ///< see Extrapolator, 0 if none
+  std::mutex extrapolation_mutex_;  ///< guards the members below
+  nav_msgs::Odometry last_odom_msg_;  ///< odom_msg_ of the last update
+  nav_msgs::Odometry last_ground_truth_msg_;  ///< ground_truth_msg_ of the
+                                              /// last update
+  nav_msgs::Odometry extrapolated_msg_;  ///< reused by PublishExtrapolated
+  Extrapolator::Clock clock_;  ///< simulation time of the last update
+  double published_time_ = 0;  ///< stamp of the last extrapolated odometry
+
+  /**
+   * State of the drive saved in world snapshots
+   */
+  struct State {
+    geometry_msgs::Twist twist_msg;  ///< the last command
+    double angular_velocity;         ///< the limited angular velocity
+    double linear_velocity;          ///< the limited linear velocity
+    std::default_random_engine rng;  ///< the noise generator
+  };
+
+  ~DiffDrive() override;
 
   /**
    * @name          OnInitialize
@@ -95,12 +125,72 @@ class DiffDrive : public flatland_server::ModelPlugin {
    * @param[in]     config The plugin YAML node
    */
   void BeforePhysicsStep(const Timekeeper& timekeeper) override;
+  /**
+   * @return true, the plugin only sets the velocities of its own body
+   */
+  bool IsThreadSafe() const override { return true; }
+  /**
+   * @return true, a new twist wakes the model
+   */
+  bool SkipsWhileAsleep() const override { return true; }
   /**
    * @name        TwistCallback
    * @brief       callback to apply twist (velocity and omega)
    * @param[in]   timestep how much the physics time will increment
    */
   void TwistCallback(const geometry_msgs::Twist& msg);
+
+  /**
+   * @return The state of the odometry noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
+  /**
+   * @brief Save the command, velocities and noise generator for
+   * World::Snapshot
+   * @return The State of the drive
+   */
+  boost::any SaveState() override;
+
+  /**
+   * @brief Restore the State saved by SaveState
+   * @param[in] state The State of the drive
+   */
+  void RestoreState(const boost::any& state) override;
+
+  /**
+   * @brief Encode the State for World::SaveCheckpoint
+   * @param[in] state The State of the drive
+   * @return The encoded State
+   */
+  std::string EncodeState(const boost::any& state) override;
+
+  /**
+   * @brief Decode a State encoded by EncodeState
+   * @param[in] encoded The encoded State
+   * @return The State of the drive
+   */
+  boost::any DecodeState(const std::string& encoded) override;
+
+  /**
+   * @brief Publish the command latency of the last second and reset it,
+   * when traced
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void PublishLatency(const Timekeeper& timekeeper);
+
+  /**
+   * @brief Publish the odometry, the ground truth and the odom TF
+   * extrapolated from the last update, the task of the Extrapolator
+   * @param[in] wall_time The wall time, see Extrapolator::Now
+   */
+  void PublishExtrapolated(double wall_time);
+
+  /**
+   * @brief Broadcast the odom TF of an odometry message
+   * @param[in] odom The odometry
+   */
+  void SendOdomTf(const nav_msgs::Odometry& odom);
 };
 };
 
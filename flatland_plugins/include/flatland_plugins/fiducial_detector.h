@@ -0,0 +1,167 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fiducial_detector.h
+ * @brief	 Fiducial detector plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/FiducialDetections.h>
+#include <flatland_server/gaussian_noise.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/types.h>
+#include <ros/ros.h>
+#include <tf/transform_broadcaster.h>
+
+#ifndef FLATLAND_PLUGINS_FIDUCIAL_DETECTOR_H
+#define FLATLAND_PLUGINS_FIDUCIAL_DETECTOR_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class implements a detector of tagged models, such as fiducial
+ * markers. The candidate models in range are found with a query of the Box2D
+ * broadphase, and the ones in the field of view are checked for line of sight
+ * with a few rays each. The cost scales with the number of models nearby
+ * instead of an angular resolution
+ */
+class FiducialDetector : public ModelPlugin {
+ public:
+  /**
+   * A model in range and in the field of view of the detector
+   */
+  struct Candidate {
+    b2Body *body;       ///< body of the model detected
+    b2Vec2 position;    ///< position of the body in the world
+    float half_width;   ///< half width of the tagged fixtures
+    flatland_msgs::FiducialDetection detection;  ///< detection to publish
+  };
+
+  std::string topic_;      ///< topic to publish the detections on
+  Body *body_;             ///< body the detector frame attaches to
+  Pose origin_;            ///< detector frame w.r.t the body
+  double range_;           ///< max range of the detector
+  double min_angle_;       ///< start of the field of view
+  double max_angle_;       ///< end of the field of view
+  unsigned int los_rays_;  ///< line of sight rays per candidate
+  double noise_std_dev_;   ///< std deviation of the noise of the positions
+  double update_rate_;     ///< the rate detections will be published
+  std::string frame_id_;   ///< detector frame id name
+  bool broadcast_tf_;      ///< whether to broadcast detector origin w.r.t body
+  uint32_t fiducial_layers_bits_;  ///< layers of the tagged fixtures
+  uint32_t layers_bits_;           ///< layers blocking the line of sight
+
+  std::vector<b2Body *> model_bodies_;  ///< bodies of the detector's model
+  b2RayBatchFilter ray_filter_;         ///< fixtures hit by the rays
+  std::vector<Candidate> candidates_;   ///< candidates of the current update
+  std::vector<b2RayCastInput> inputs_;  ///< line of sight rays
+  std::vector<b2RayBatchHit> hits_;     ///< nearest hit of each ray
+  std::vector<float> noisy_xy_;         ///< positions of the detections
+
+  GaussianNoise noise_;  ///< bulk gaussian noise generator
+
+  flatland_msgs::FiducialDetections detections_;  ///< message to publish
+  ros::Publisher detections_publisher_;           ///< detections publisher
+  tf::TransformBroadcaster tf_broadcaster_;       ///< broadcast detector frame
+  geometry_msgs::TransformStamped detector_tf_;   ///< tf body to detector
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Called when just before physics update
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @brief Halve the update rate while the step budget requires it, see
+   * StepBudgetGovernor
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @return The state of the noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
+  /**
+   * @brief Find the tagged models in range and in the field of view
+   * @param[in] origin Detector origin in the world
+   * @param[in] angle Detector orientation in the world
+   */
+  void FindCandidates(const b2Vec2 &origin, double angle);
+
+  /**
+   * @brief Check the line of sight of the candidates with one batched
+   * raycast, and fill the detections of the visible ones
+   * @param[in] origin Detector origin in the world
+   */
+  void CheckLineOfSight(const b2Vec2 &origin);
+
+  /**
+   * @brief helper function to extract the paramters from the YAML Node
+   * @param[in] config Plugin YAML Node
+   */
+  void ParseParameters(const YAML::Node &config);
+
+  /**
+   * @brief Get the id of a model from its name
+   * @param[in] name Name of the model
+   * @return The number at the end of the name, -1 if none
+   */
+  static int32_t ParseId(const std::string &name);
+};
+};
+
+#endif
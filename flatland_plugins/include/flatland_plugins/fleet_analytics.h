@@ -0,0 +1,183 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fleet_analytics.h
+ * @brief	 Computes aggregates of the fleet online
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <flatland_msgs/FleetAnalytics.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world_plugin.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <ros/ros.h>
+#include <string>
+#include <vector>
+
+#ifndef FLATLAND_PLUGINS_FLEET_ANALYTICS_H
+#define FLATLAND_PLUGINS_FLEET_ANALYTICS_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class computes aggregates of the fleet online, instead of logging all
+ * the poses for offline processing. The first body of every non static
+ * model is sampled from the BodyStates at the sample rate into a decaying
+ * heatmap of the traffic, the near misses of pairs of models found with a
+ * spatial hash, the collisions from the touching contacts and the dwell
+ * times in regions. Summaries are published at the update rate
+ */
+class FleetAnalytics : public WorldPlugin {
+ public:
+  /// A region whose use is measured
+  struct Region {
+    std::string name;              ///< name of the region
+    b2AABB area;                   ///< area of the region
+    std::vector<uint32_t> inside;  ///< ids of the models inside at the last
+                                   /// sample, sorted
+    double dwell_time = 0;     ///< model seconds inside during the period
+    double occupied_time = 0;  ///< seconds with a model inside during the
+                               /// period
+    uint32_t entries = 0;      ///< models that entered during the period
+  };
+
+  double sample_period_;       ///< time between two samples
+  double publish_period_;      ///< time between two summaries
+  double next_sample_time_ = 0;   ///< time of the next sample
+  double next_publish_time_ = 0;  ///< time of the next summary
+  double last_sample_time_ = -1;  ///< time of the last sample, -1 if none
+  double period_start_ = 0;       ///< time of the last summary
+  double near_miss_distance_;     ///< distance of the origins of two models
+                                  /// making a near miss
+
+  bool heatmap_ = false;       ///< if the heatmap is computed
+  double half_life_ = 0;       ///< time for the heat of a cell to halve, 0
+                               /// for no decay
+  double heat_weight_ = 1;     ///< weight of the heat added at the sample,
+                               /// grows instead of decaying all the cells
+  std::vector<float> heat_;    ///< heat of the cells, times heat_weight_
+  nav_msgs::OccupancyGrid heatmap_msg_;  ///< the heatmap, filled to publish
+
+  std::vector<Region> regions_;  ///< the regions
+
+  std::vector<uint32_t> ids_;  ///< ids of the sampled models
+  std::vector<float> x_, y_;   ///< positions of the sampled models
+  double speed_sum_ = 0;       ///< sum of the speeds of the samples
+  uint32_t speed_count_ = 0;   ///< number of speeds summed
+
+  std::vector<uint32_t> cell_start_;   ///< first model of each grid bucket
+  std::vector<uint32_t> cell_models_;  ///< models sorted by grid bucket
+  std::vector<uint32_t> model_cell_;   ///< grid bucket of each model
+  uint32_t bucket_mask_ = 0;           ///< number of buckets minus one
+
+  std::vector<uint64_t> close_pairs_;     ///< pairs of model ids closer than
+                                          /// the near miss distance, sorted
+  std::vector<uint64_t> touching_pairs_;  ///< pairs of model ids touching,
+                                          /// sorted
+  std::vector<uint64_t> pairs_;           ///< pairs found by the sample
+  std::vector<uint32_t> inside_;          ///< models found in a region by
+                                          /// the sample
+
+  uint32_t near_misses_ = 0;        ///< near misses during the period
+  uint32_t collisions_ = 0;         ///< collisions during the period
+  uint32_t near_misses_total_ = 0;  ///< near misses since the start
+  uint32_t collisions_total_ = 0;   ///< collisions since the start
+
+  flatland_msgs::FleetAnalytics msg_;  ///< the last summary
+  ros::Publisher publisher_;           ///< publishes the summaries
+  ros::Publisher heatmap_publisher_;   ///< publishes the heatmap
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Sample the models and publish the summaries when they are due
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Sample the models and update the aggregates
+   * @param[in] dt Time since the last sample
+   */
+  void Sample(double dt);
+
+  /**
+   * @brief Count the pairs of models closer than the near miss distance
+   * that were not at the last sample
+   */
+  void FindNearMisses();
+
+  /**
+   * @brief Count the pairs of models touching that were not at the last
+   * sample
+   */
+  void FindCollisions();
+
+  /**
+   * @brief Publish the summary of the period, and the heatmap if it has
+   * subscribers
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void Publish(const Timekeeper &timekeeper);
+
+  /**
+   * @brief Count the pairs of pairs_, sorted, not in previous, and replace
+   * previous with them
+   * @param[in/out] previous The pairs of the last sample, sorted
+   * @return The number of new pairs
+   */
+  uint32_t CountNewPairs(std::vector<uint64_t> *previous);
+
+  /**
+   * @return The grid bucket of a cell
+   */
+  uint32_t CellBucket(int cx, int cy) const;
+};
+};
+
+#endif
@@ -1,11 +1,10 @@
-#include <flatland_plugins/update_timer.h>
+#include <flatland_server/gps_batch.h>
 #include <flatland_server/model_plugin.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/types.h>
 #include <ros/ros.h>
 #include <sensor_msgs/NavSatFix.h>
 #include <tf/transform_broadcaster.h>
-#include <Eigen/Dense>
 
 #ifndef FLATLAND_PLUGINS_GPS_H
 #define FLATLAND_PLUGINS_GPS_H
@@ -27,25 +26,21 @@ class Gps : public ModelPlugin {
                         /// frame
   double ref_lon_rad_;  ///< longitude in radians corresponding to (0, 0) in map
                         /// frame
-  double ref_ecef_x_;   ///< ECEF coordinates of reference lat and lon at zero
-                        /// altitude
-  double ref_ecef_y_;   ///< ECEF coordinates of reference lat and lon at zero
-                        /// altitude
-  double ref_ecef_z_;   ///< ECEF coordinates of reference lat and lon at zero
-                        /// altitude
+  GpsReference reference_;  ///< terms of ref_lat_rad_ and ref_lon_rad_,
+                            /// computed once
+  int batch_id_ = -1;   ///< id in GetGpsBatch(), -1 if not added
   double update_rate_;  ///< GPS fix publish rate
   bool broadcast_tf_;   ///< whether to broadcast laser origin w.r.t body
 
-  static double WGS84_A;   ///< Earth's major axis length
-  static double WGS84_E2;  ///< Square of Earth's first eccentricity
-
   ros::Publisher fix_publisher_;             ///< GPS fix topic publisher
   tf::TransformBroadcaster tf_broadcaster_;  ///< broadcast GPS frame
   geometry_msgs::TransformStamped gps_tf_;   ///< tf from body to GPS frame
   sensor_msgs::NavSatFix gps_fix_;           ///< message for publishing output
-  UpdateTimer update_timer_;                 ///< for controlling update rate
 
-  Eigen::Matrix3f m_body_to_gps_;  ///< tf from body to GPS
+  /**
+   * @brief Destructor, removes the receiver from the batch
+   */
+  ~Gps();
 
   /**
    * @brief Initialization for the plugin
@@ -59,6 +54,16 @@ class Gps : public ModelPlugin {
    */
   void BeforePhysicsStep(const Timekeeper &timekeeper) override;
 
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @return true, the outputs do not change while the model rests
+   */
+  bool SkipsWhileAsleep() const override { return true; }
+
   /**
    * @brief Helper function to extract the paramters from the YAML Node
    * @param[in] config Plugin YAML Node
@@ -66,14 +71,14 @@ class Gps : public ModelPlugin {
   void ParseParameters(const YAML::Node &config);
 
   /**
-   * @brief Method to compute ECEF coordinates of reference
-   * latitude and longitude, assuming zero altitude
+   * @brief Method to compute the terms of the reference latitude and
+   * longitude, see GpsReference
    */
   void ComputeReferenceEcef();
 
   /**
    * @brief Method that updates the current state of the GPS fix output
-   * for publishing
+   * for publishing, through GetGpsBatch() if it is set
    */
   void UpdateFix();
 };
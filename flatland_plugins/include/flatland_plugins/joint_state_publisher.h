@@ -0,0 +1,116 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 joint_state_publisher.h
+ * @brief	 Publish the states of the joints of a model
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <flatland_msgs/ModelJointStates.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+#include <string>
+#include <vector>
+
+#ifndef FLATLAND_PLUGINS_JOINT_STATE_PUBLISHER_H
+#define FLATLAND_PLUGINS_JOINT_STATE_PUBLISHER_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class implements the model plugin that publishes the angle, angular
+ * speed and reaction torque of the joints of a model in one
+ * sensor_msgs/JointState. The message is allocated once with the names of
+ * the joints, only the values are written at each update
+ */
+class JointStatePublisher : public ModelPlugin {
+ public:
+  std::string topic_;    ///< topic to publish the joint states on
+  double update_rate_;   ///< publish rate
+  std::vector<Joint *> joints_;  ///< the published joints, in message order
+  sensor_msgs::JointState joint_state_;  ///< reused between updates
+  /// the same values for OdometryAggregator, only filled when it is enabled
+  flatland_msgs::ModelJointStates model_joint_states_;
+  ros::Publisher publisher_;  ///< publishes topic_
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Called when just before physics update
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @return true, the outputs do not change while the model rests
+   */
+  bool SkipsWhileAsleep() const override { return true; }
+
+  /**
+   * @brief Read the state of a joint. Revolute joints give their angle and
+   * angular speed, weld joints the deflection of their soft constraint from
+   * the reference angle
+   * @param[in] joint The joint
+   * @param[in] inv_dt Inverse of the step size, for the reaction torque
+   * @param[out] position The angle of the joint
+   * @param[out] velocity The angular speed of the joint
+   * @param[out] effort The reaction torque of the joint
+   */
+  static void ReadJoint(b2Joint *joint, double inv_dt, double *position,
+                        double *velocity, double *effort);
+};
+};
+
+#endif  // FLATLAND_PLUGINS_JOINT_STATE_PUBLISHER_H
@@ -44,18 +44,19 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <flatland_plugins/update_timer.h>
+#include <flatland_msgs/CompactScan.h>
+#include <flatland_server/gaussian_noise.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/occupancy_grid.h>
+#include <flatland_server/segment_raycaster.h>
+#include <flatland_server/sensor_executor.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/types.h>
+#include <flatland_server/yaml_reader.h>
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include <tf/transform_broadcaster.h>
-#include <thirdparty/ThreadPool.h>
 #include <visualization_msgs/Marker.h>
-#include <Eigen/Dense>
-#include <random>
-#include <thread>
 
 #ifndef FLATLAND_PLUGINS_LASER_H
 #define FLATLAND_PLUGINS_LASER_H
@@ -64,12 +65,57 @@ using namespace flatland_server;
 
 namespace flatland_plugins {
 
+/**
+ * The parameters of a Laser, parsed once per model template and shared by
+ * its lasers, see ModelPlugin::SharedConfig
+ */
+struct LaserConfig {
+  std::string body;              ///< name of the body the laser attaches to
+  std::string topic;             ///< topic name to publish the laser scan
+  std::string frame_id;          ///< laser frame id name
+  bool broadcast_tf;             ///< whether to broadcast the laser origin
+  double update_rate;            ///< the rate laser scan will be published
+  Pose origin;                   ///< laser frame w.r.t the body
+  double range;                  ///< laser max range
+  double noise_std_dev;          ///< noise std deviation
+  int noise_seed;                ///< negative to pick a random seed
+  bool batch_raycast;            ///< see Laser::batch_raycast_
+  SensorExecutor::Priority priority;  ///< priority of the raycast tasks
+  bool grid_raycast;             ///< see Laser::grid_raycast_
+  bool segment_raycast;          ///< see Laser::segment_raycast_
+  bool scan_cache;               ///< see Laser::scan_cache_
+  bool static_cache;             ///< see Laser::static_cache_
+  bool world_batch;              ///< see Laser::world_batch_
+  bool sweep;                    ///< see Laser::sweep_
+  unsigned int echoes;           ///< number of returns reported per beam
+  double echo_separation;        ///< min distance between two returns
+  double divergence;             ///< beam width in radians
+  unsigned int divergence_rays;  ///< sub rays cast across the beam width
+  double cache_linear_tolerance;   ///< see Laser::cache_linear_tolerance_
+  double cache_angular_tolerance;  ///< see Laser::cache_angular_tolerance_
+  unsigned int message_pool;       ///< see Laser::message_pool_
+  double compact_resolution;       ///< see Laser::compact_resolution_
+  bool compact_intensities;        ///< see Laser::compact_intensities_
+  std::vector<std::string> layers;  ///< names of the layers the laser sees
+  double min_angle;                 ///< laser min angle
+  double max_angle;                 ///< laser max angle
+  double increment;                 ///< laser angle increment
+
+  /**
+   * @brief Read and validate the parameters, throws YAMLException
+   * @param[in] reader Reader of the plugin YAML node
+   * @param[in] name Name of the plugin, the default frame id
+   */
+  LaserConfig(YamlReader &reader, const std::string &name);
+};
+
 /**
  * This class implements the model plugin class and provides laser data
  * for the given configurations
  */
 class Laser : public ModelPlugin {
  public:
+  std::shared_ptr<const LaserConfig> config_;  ///< the parameters
   std::string topic_;     ///< topic name to publish the laser scan
   Body *body_;            ///<  body the laser frame attaches to
   Pose origin_;           ///< laser frame w.r.t the body
@@ -81,39 +127,155 @@ class Laser : public ModelPlugin {
   double update_rate_;    ///< the rate laser scan will be published
   std::string frame_id_;  ///< laser frame id name
   bool broadcast_tf_;     ///< whether to broadcast laser origin w.r.t body
-  uint16_t layers_bits_;  ///< for setting the layers where laser will function
-  ThreadPool pool_;       ///< ThreadPool for managing concurrent scan threads
+  uint32_t layers_bits_;  ///< for setting the layers where laser will function
+  bool batch_raycast_;    ///< raycast in one chunk per thread, not per beam
+  SensorExecutor::Priority priority_;  ///< priority of the raycast tasks
+  bool world_batch_;      ///< cast rays together with all sensors on a step
+  bool grid_raycast_;     ///< raycast bitmap layers on their occupancy grids
+  bool segment_raycast_;  ///< raycast line segment layers on their segments
+  bool sweep_;  ///< spread the beams of a scan over the steps of its period,
+                /// like a rotating lidar, instead of casting all at once
+  double scan_period_;  ///< sim time of a sweep, in sweep mode
+  bool sweeping_ = false;          ///< if a sweep is in progress
+  bool sweep_subscribed_ = false;  ///< if the current sweep is computed
+  double sweep_start_ = 0;         ///< sim time of the first beam of the sweep
+  unsigned int sweep_beam_ = 0;    ///< next beam of the sweep to cast
+
+  /**
+   * A static layer raycasted on its own data instead of its Box2D fixtures,
+   * exactly one of grid and segments is set
+   */
+  struct StaticLayer {
+    b2Body *body;                     ///< physics body of the layer
+    const OccupancyGrid *grid;        ///< occupancy grid in the body frame
+    const SegmentRaycaster *segments;  ///< segments in the body frame
+    uint32_t category_bits;           ///< category bits of the layer
+  };
+  std::vector<StaticLayer> static_layers_;  ///< layers raycasted directly
+  std::vector<const b2Body *> static_layer_bodies_;  ///< their bodies
+  uint64_t layer_generation_ = 0;  ///< Layer::GetGeometryGeneration when the
+                                   /// static layers were found
+  b2RayBatchFilter ray_filter_;  ///< fixtures hit by the batch ray casts
+
+  int export_id_ = -1;  ///< id of the scan in the state exporter, -1 if the
+                        /// scan is not exported
+  bool observed_ = false;  ///< the scan is computed without subscribers,
+                           /// it is read in process, e.g. from Python
+
+  /// beams cast together in one traversal of the broadphase
+  static const unsigned int RAY_PACKET_SIZE = 64;
+
+  static const unsigned int MAX_ECHOES = 8;  ///< max returns per beam
+
+  /**
+   * The nearest returns of a beam in increasing range, kept on the stack so
+   * that collecting them never allocates
+   */
+  struct Echoes {
+    unsigned int count = 0;       ///< number of returns
+    float range[MAX_ECHOES];      ///< range of the returns
+    float intensity[MAX_ECHOES];  ///< intensity of the returns
+
+    /**
+     * @brief Add a return, keeping the max nearest ones. A return closer than
+     * separation to a kept one is merged into it, keeping the nearest range
+     * @param[in] r Range of the return
+     * @param[in] i Intensity of the return
+     * @param[in] max Number of returns to keep
+     * @param[in] separation Min distance between two reported returns
+     */
+    void Insert(float r, float i, unsigned int max, float separation);
+  };
+
+  unsigned int echoes_;           ///< number of returns reported per beam
+  double echo_separation_;        ///< min distance between two returns
+  double divergence_;             ///< beam width in radians
+  unsigned int divergence_rays_;  ///< sub rays cast across the beam width
+  bool multi_echo_;               ///< if more than one ray or return per beam
+  std::vector<sensor_msgs::LaserScan> echo_scans_;  ///< returns after first
+  std::vector<ros::Publisher> echo_publishers_;     ///< publish echo_scans_
+
+  bool scan_cache_;  ///< reuse the last scan when nothing has moved
+  double cache_linear_tolerance_;   ///< laser translation invalidating cache
+  double cache_angular_tolerance_;  ///< laser rotation invalidating cache
+  bool cache_valid_ = false;        ///< if the cached scan can be used
+  Pose cached_pose_;                ///< laser pose of the cached scan
+  std::vector<float> cached_ranges_;  ///< noise free ranges of cached scan
+  uint64_t cache_layer_generation_ = 0;  ///< Layer::GetGeometryGeneration
+                                         /// of the cached scan
+  uint64_t cache_body_generation_ = 0;  ///< BodyStates::generation_ then
+  uint64_t cache_moves_ = 0;            ///< BodyStates::moves_ then
+
+  /// A body of a model in range of the cached scan, with its pose then
+  struct CachedBody {
+    const Body *body;  ///< the body
+    Pose pose;         ///< its pose in the body states
+    bool operator<(const CachedBody &other) const { return body < other.body; }
+  };
+  std::vector<CachedBody> cached_bodies_;  ///< in range of the cached scan,
+                                           /// sorted by body
+  unsigned int beam_stride_ = 1;  ///< cast every beam_stride_-th beam, the
+                                  /// others repeat the previous one
+
+  /// A fixture of a model within range of the laser, with the transform of
+  /// its body when the scan was prepared
+  struct ModelFixture {
+    const b2Fixture *fixture;  ///< the fixture
+    b2Transform xf;            ///< transform of its body
+    uint32_t category_bits;    ///< category bits of the fixture
+  };
+
+  bool static_cache_;  ///< raycast the layers once while the laser is
+                       /// stationary, and only the models on each scan
+  bool static_valid_ = false;       ///< if static_fractions_ can be used
+  Pose static_pose_;                ///< laser pose of static_fractions_
+  uint64_t static_generation_ = 0;  ///< Layer::GetGeometryGeneration then
+  int32_t static_proxy_count_ = 0;  ///< proxies in the physics world then
+  std::vector<float> static_fractions_;    ///< nearest layer hit of each
+                                           /// beam, 1 if none
+  std::vector<float> static_intensities_;  ///< intensity of those hits
+  std::vector<ModelFixture> model_fixtures_;  ///< fixtures of the models in
+                                              /// range of the current scan
+  std::vector<const b2Body *> static_ignored_;  ///< bodies the layer ray
+                                                /// casts ignore
 
   /*
    * for setting reflectance layers. if the laser hits those layers,
    * intensity will be high (255)
    */
-  uint16_t reflectance_layers_bits_;
+  uint32_t reflectance_layers_bits_;
 
-  std::default_random_engine rng_;              ///< random generator
-  std::normal_distribution<double> noise_gen_;  ///< gaussian noise generator
+  GaussianNoise noise_;  ///< bulk gaussian noise generator
 
-  Eigen::Matrix3f m_body_to_laser_;       ///< tf from body to laser
-  Eigen::Matrix3f m_world_to_body_;       ///< tf  from world to body
-  Eigen::Matrix3f m_world_to_laser_;      ///< tf from world to laser
-  Eigen::MatrixXf m_laser_points_;        ///< laser points in the laser' frame
-  Eigen::MatrixXf m_world_laser_points_;  /// laser point in the world frame
-  Eigen::Vector3f v_zero_point_;          ///< point representing (0,0)
-  Eigen::Vector3f v_world_laser_origin_;  ///< (0,0) in the laser frame
+  /// end points of the rays in the body frame, one array per coordinate so
+  /// that they are transformed in SIMD batches, see
+  /// Geometry::TransformPoints. Beam i uses [i * rays, (i + 1) * rays)
+  std::vector<float> body_points_x_, body_points_y_;
+  /// end points of the rays in the world frame for the current scan
+  std::vector<float> world_points_x_, world_points_y_;
+  b2Vec2 laser_origin_point_;  ///< laser origin in world of the current scan
+  double laser_angle_;         ///< laser angle in world of the current scan
   sensor_msgs::LaserScan laser_scan_;     ///< for publishing laser scan
 
   ros::Publisher scan_publisher_;             ///< ros laser topic publisher
+
+  float compact_resolution_;  ///< meters per unit of the compact ranges, 0
+                              /// if the compact scan is not published
+  bool compact_intensities_;  ///< if the compact scan has the intensities
+  ros::Publisher compact_publisher_;  ///< publishes compact_scan_
+  flatland_msgs::CompactScan compact_scan_;  ///< quantized laser_scan_
+
+  unsigned int message_pool_;  ///< messages per topic, 0 to publish by value
+  /// preallocated messages published by pointer, one pool per scan topic,
+  /// the first one for laser_scan_ followed by the ones of echo_scans_
+  std::vector<std::vector<sensor_msgs::LaserScanPtr>> scan_pools_;
   tf::TransformBroadcaster tf_broadcaster_;   ///< broadcast laser frame
   geometry_msgs::TransformStamped laser_tf_;  ///< tf from body to laser frame
-  UpdateTimer update_timer_;                  ///< for controlling update rate
 
   /**
-   * @brief Constructor to start the threadpool with N+1 threads
+   * @brief Remove the scan from the state exporter
    */
-  Laser() : pool_(std::thread::hardware_concurrency() + 1) {
-    ROS_INFO_STREAM("Laser plugin loaded with "
-                    << (std::thread::hardware_concurrency() + 1) << " threads");
-  };
+  ~Laser();
 
   /**
    * @brief Initialization for the plugin
@@ -127,33 +289,231 @@ class Laser : public ModelPlugin {
    */
   void BeforePhysicsStep(const Timekeeper &timekeeper) override;
 
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @return The bytes of the scans, the pooled messages and the beam buffers
+   */
+  size_t GetMemoryUsage() const override;
+
+  /**
+   * @brief Halve the update rate and cast every other beam while the step
+   * budget requires it, see StepBudgetGovernor
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @return The state of the noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
   /**
    * @brief Method that contains all of the laser range calculations
    */
   void ComputeLaserRanges();
 
+  /**
+   * @brief Compute the laser pose and beams in the world for a new scan
+   * @return false if the cached scan is reused and no rays need to be cast
+   */
+  bool PrepareScan();
+
+  /**
+   * @brief Compute the laser pose and the beams [begin, end) in the world
+   * @param[in] begin First beam
+   * @param[in] end One past the last beam
+   */
+  void PrepareBeams(unsigned int begin, unsigned int end);
+
+  /**
+   * @brief Cast the beams of the sweep whose time is reached by a step, from
+   * the pose of the laser on that step, and publish the scan once the sweep
+   * is complete
+   * @param[in] timekeeper Object managing the simulation time
+   * @return true if a scan was completed
+   */
+  bool SweepStep(const Timekeeper &timekeeper);
+
+  /**
+   * @brief Cast the beams [begin, end) of the scan prepared by PrepareScan,
+   * safe to call concurrently for disjoint ranges
+   * @param[in] begin First beam
+   * @param[in] end One past the last beam
+   */
+  void CastBeams(unsigned int begin, unsigned int end);
+
+  /**
+   * @brief Write the rays of all beams of the scan prepared by PrepareScan,
+   * for the GPU raycaster of the sensor scheduler
+   * @param[out] rays One ray per beam
+   */
+  void WriteRays(GpuRaycaster::Ray *rays) const;
+
+  /**
+   * @brief Read the ranges and intensities of the scan from the hits of the
+   * rays written by WriteRays
+   * @param[in] hits One hit per beam
+   */
+  void ReadHits(const GpuRaycaster::Hit *hits);
+
+  /**
+   * @brief Store the cast scan in the cache and add the noise, fills the
+   * beams skipped by beam_stride_
+   */
+  void FinishScan();
+
+  /**
+   * @brief Collect the returns of all sub rays of a beam, used in multi echo
+   * mode
+   * @param[in] laser_origin_point Origin of the laser in the world frame
+   * @param[in] i Index of the beam
+   * @param[out] echoes The nearest returns of the beam
+   */
+  void CastEchoes(const b2Vec2 &laser_origin_point, unsigned int i,
+                  Echoes *echoes);
+
+  /**
+   * @return true if any of the scan topics has subscribers, or the scan is
+   * exported to shared memory or observed
+   */
+  bool HasSubscribers() const;
+
+  /**
+   * @brief Check if the laser detects a fixture hit by a ray
+   * @param[in] fixture The fixture
+   * @return true if the hit should be reported
+   */
+  bool DetectsFixture(b2Fixture *fixture) const;
+
+  /**
+   * @brief Stamp and publish the laser scan
+   * @param[in] stamp Time stamp of the scan
+   */
+  void PublishScan(const ros::Time &stamp);
+
+  /**
+   * @brief Publish a scan by pointer without copying it, the scan is swapped
+   * with a pool message no subscriber holds anymore, so the scan keeps
+   * preallocated ranges of the same size for the next computation. Nothing
+   * is published without subscribers
+   * @param[in] publisher Publisher of the scan
+   * @param[in/out] scan The scan to publish
+   * @param[in/out] pool The preallocated messages of the topic
+   */
+  void PublishPooled(const ros::Publisher &publisher,
+                     sensor_msgs::LaserScan *scan,
+                     std::vector<sensor_msgs::LaserScanPtr> *pool);
+
+  /**
+   * @brief Raycast a packet of at most RAY_PACKET_SIZE beams against the
+   * physics world in one batch ray cast, and write their ranges (NAN if
+   * nothing is hit) and intensities into the scan
+   * @param[in] laser_origin_point Origin of the laser in the world frame
+   * @param[in] begin First beam
+   * @param[in] end One past the last beam
+   * @param[in] stride Cast only every stride-th beam from begin on
+   */
+  void RaycastBeams(const b2Vec2 &laser_origin_point, unsigned int begin,
+                    unsigned int end, unsigned int stride = 1);
+
+  /**
+   * @brief Raycast the static layers on their occupancy grids or segments
+   * @param[in] origin Origin of the ray in the world frame
+   * @param[in] point End of the ray in the world frame
+   * @param[inout] fraction Nearest hit as a fraction of the ray, only hits
+   * nearer than its value are reported
+   * @param[out] intensity Intensity of the nearest hit, if any
+   * @return true if a static layer is hit nearer than fraction
+   */
+  bool RaycastStaticLayers(const b2Vec2 &origin, const b2Vec2 &point,
+                           float *fraction, float *intensity) const;
+
+  /**
+   * @brief Find the fixtures of the models within range of the laser, and
+   * raycast the layers into static_fractions_ again if the laser moved or
+   * the layers or the bodies changed since they were cast
+   */
+  void PrepareStaticCache();
+
+  /**
+   * @brief Raycast beams against the fixtures of model_fixtures_ only, up to
+   * the cached layer hits, and write their ranges and intensities into the
+   * scan
+   * @param[in] begin First beam
+   * @param[in] end One past the last beam
+   * @param[in] stride Cast only every stride-th beam from begin on
+   */
+  void CastModelBeams(unsigned int begin, unsigned int end,
+                      unsigned int stride);
+
   /**
    * @brief helper function to extract the paramters from the YAML Node
    * @param[in] config Plugin YAML Node
    */
   void ParseParameters(const YAML::Node &config);
+
+  /**
+   * @brief Check if the cached scan is still valid for the laser pose: the
+   * layers changed nothing, no body was added, removed or moved outside of
+   * the steps, and the non static bodies in range are the same at the same
+   * poses. The poses are read from the body states, which no plugin writes
+   * @param[in] origin Laser origin in the world frame
+   * @param[in] angle Laser angle in the world frame
+   * @return true if the cached scan can be reused
+   */
+  bool CanReuseScan(const b2Vec2 &origin, double angle) const;
+
+  /**
+   * @brief Check if a body has a fixture the laser can detect within range
+   * @param[in] body The physics body
+   * @param[in] origin Laser origin in the world frame
+   * @return true if the bounding box of such a fixture overlaps the range
+   */
+  bool InRange(const b2Body *body, const b2Vec2 &origin) const;
+
+  /**
+   * @brief Save the scan just computed in the cache, with the non static
+   * bodies in range of it
+   */
+  void CacheScan();
+
+  /**
+   * @brief Find the layers the laser can raycast on their occupancy grids or
+   * line segments instead of Box2D, and exclude their bodies from the Box2D
+   * ray casts
+   */
+  void FindStaticLayers();
+
+  /**
+   * @brief Check if a physics body belongs to a layer raycasted directly
+   * @param[in] body The physics body
+   * @return true if the body is raycasted on its grid or segments
+   */
+  bool IsStaticLayerBody(const b2Body *body) const;
 };
 
 /**
- * This class handles the b2RayCastCallback ReportFixture method
- * allowing each thread to access its own callback object
+ * This class handles the b2RayCastCallback ReportFixture method in multi echo
+ * mode, it collects all hits along the ray instead of only the nearest one
  */
-class LaserCallback : public b2RayCastCallback {
+class LaserEchoCallback : public b2RayCastCallback {
  public:
-  bool did_hit_ = false;  ///< Box2D ray trace checking if ray hits anything
-  float fraction_ = 0;    ///< Box2D ray trace fraction
-  float intensity_ = 0;   ///< Intensity of raytrace collision
-  Laser *parent_;         ///< The parent Laser plugin
+  Laser *parent_;          ///< The parent Laser plugin
+  Laser::Echoes *echoes_;  ///< Returns of the beam the ray belongs to
+  float length_;           ///< Length of the ray
 
   /**
-   * Default constructor to assign parent object
+   * @brief Constructor
+   * @param[in] parent The parent Laser plugin
+   * @param[in] echoes Returns of the beam the ray belongs to
+   * @param[in] length Length of the ray
    */
-  LaserCallback(Laser *parent) : parent_(parent){};
+  LaserEchoCallback(Laser *parent, Laser::Echoes *echoes, float length)
+      : parent_(parent), echoes_(echoes), length_(length) {}
 
   /**
    * @brief Box2D raytrace call back method required for implementing the
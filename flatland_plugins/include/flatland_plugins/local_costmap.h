@@ -0,0 +1,144 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 local_costmap.h
+ * @brief	 Local costmap plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/types.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <ros/ros.h>
+
+#ifndef FLATLAND_PLUGINS_LOCAL_COSTMAP_H
+#define FLATLAND_PLUGINS_LOCAL_COSTMAP_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class rasterizes the geometry around a body into a rolling occupancy
+ * grid, aligned with the world and centered on the body, without simulating
+ * sensors. The fixtures of static bodies, e.g. the layers, are rasterized
+ * once and kept while they are in the window, only the rows and columns
+ * entering the window as the body moves are rasterized. The fixtures of the
+ * other bodies are rasterized again on every update
+ */
+class LocalCostmap : public ModelPlugin {
+ public:
+  static const int8_t FREE = 0;        ///< cost of a free cell
+  static const int8_t OCCUPIED = 100;  ///< cost of a cell with geometry
+
+  std::string topic_;           ///< topic to publish the grid on
+  std::string world_frame_id_;  ///< frame of the grid
+  Body *body_;                  ///< body the window is centered on
+  double update_rate_;          ///< the rate the grid will be published
+  double resolution_;           ///< size of a cell in meters
+  int width_;                   ///< number of cells of the window in x
+  int height_;                  ///< number of cells of the window in y
+  uint32_t layers_bits_;        ///< layers rasterized in the grid
+
+  int origin_x_;       ///< world cell index of the window corner in x
+  int origin_y_;       ///< world cell index of the window corner in y
+  bool window_valid_;  ///< if the static cells match the window origin
+  std::vector<int8_t> static_cells_;  ///< cells of the static bodies
+  std::vector<int8_t> shifted_;       ///< scratch buffer to shift the window
+  b2PolygonShape cell_shape_;         ///< a cell centered on the origin
+
+  nav_msgs::OccupancyGrid grid_;  ///< grid to publish
+  ros::Publisher grid_publisher_;  ///< grid publisher
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Called when just before physics update
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @brief Halve the update rate while the step budget requires it, see
+   * StepBudgetGovernor
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @brief Move the window to the body, reusing the static cells still in
+   * the window and rasterizing the static bodies in the new ones
+   */
+  void UpdateWindow();
+
+  /**
+   * @brief Rasterize the fixtures overlapping the cells [x0, x1) x [y0, y1)
+   * of the window
+   * @param[in] x0 First column
+   * @param[in] y0 First row
+   * @param[in] x1 One past the last column
+   * @param[in] y1 One past the last row
+   * @param[in] static_bodies Rasterize the fixtures of the static bodies if
+   * true, of the other bodies otherwise
+   * @param[out] cells Cells of the window, row major, set to OCCUPIED
+   */
+  void Rasterize(int x0, int y0, int x1, int y1, bool static_bodies,
+                 std::vector<int8_t> *cells);
+
+  /**
+   * @brief helper function to extract the paramters from the YAML Node
+   * @param[in] config Plugin YAML Node
+   */
+  void ParseParameters(const YAML::Node &config);
+};
+};
+
+#endif
@@ -44,11 +44,15 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <flatland_plugins/update_timer.h>
+#include <flatland_server/extrapolator.h>
 #include <flatland_server/model_plugin.h>
 #include <flatland_server/timekeeper.h>
+#include <geometry_msgs/TransformStamped.h>
 #include <ros/ros.h>
 #include <tf/transform_broadcaster.h>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #ifndef FLATLAND_PLUGINS_MODEL_TF_PUBLISHER_H
 #define FLATLAND_PLUGINS_MODEL_TF_PUBLISHER_H
@@ -68,9 +72,29 @@ class ModelTfPublisher : public ModelPlugin {
   std::vector<Body *> excluded_bodies_;  ///< list of bodies to ignore
   Body *reference_body_;  ///< body used as a reference to other bodies
   double update_rate_;    ///< publish rate
+  std::vector<Body *> published_bodies_;  ///< bodies besides the reference
+                                          /// body that are not excluded
+  std::string reference_frame_id_;  ///< resolved frame of the reference body
+  std::vector<geometry_msgs::TransformStamped>
+      transforms_;  ///< one per published body and the world transform, with
+                    /// the frames resolved once, sent together
 
   tf::TransformBroadcaster tf_broadcaster;  ///< For publish ROS TF
-  UpdateTimer update_timer_;                ///< for managing update rate
+
+  double extrapolation_rate_;  ///< rate of the transforms extrapolated
+                               /// between the physics steps, in Hz of wall
+                               /// time, 0 to publish on the steps only
+  unsigned int extrapolation_task_ = 0;  ///< see Extrapolator, 0 if none
+  std::vector<b2Transform> poses_;  ///< of the reference body, then of
+                                    /// published_bodies_, reused
+  std::mutex extrapolation_mutex_;  ///< guards the members below and
+                                    /// transforms_ when extrapolating
+  std::vector<Extrapolator::Motion> motions_;  ///< of the bodies of poses_
+                                               /// at the last update
+  Extrapolator::Clock clock_;  ///< simulation time of the last update
+  double published_time_ = 0;  ///< stamp of the last extrapolated transforms
+
+  ~ModelTfPublisher() override;
 
   /**
  * @brief Initialization for the plugin
@@ -83,6 +107,29 @@ class ModelTfPublisher : public ModelPlugin {
    * @param[in] timekeeper Object managing the simulation time
    */
   void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Publish the transforms extrapolated from the last update, the
+   * task of the Extrapolator
+   * @param[in] wall_time The wall time, see Extrapolator::Now
+   */
+  void PublishExtrapolated(double wall_time);
+
+  /**
+   * @brief Fill transforms_ from poses_
+   * @param[in] stamp Time stamp of the transforms
+   */
+  void FillTransforms(const ros::Time &stamp);
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @return true, the outputs do not change while the model rests
+   */
+  bool SkipsWhileAsleep() const override { return true; }
 };
 };
 
@@ -0,0 +1,214 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 multi_plane_laser.h
+ * @brief	 Multi plane laser plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/gaussian_noise.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/types.h>
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf/transform_broadcaster.h>
+
+#ifndef FLATLAND_PLUGINS_MULTI_PLANE_LASER_H
+#define FLATLAND_PLUGINS_MULTI_PLANE_LASER_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class implements a lidar scanning several tilted planes. The rays of
+ * all planes share one world transform computation and are cast in a single
+ * parallel raycast, the result is published as one laser scan per plane or
+ * as a single point cloud
+ */
+class MultiPlaneLaser : public ModelPlugin {
+ public:
+  /**
+   * A scan plane of the lidar
+   */
+  struct Plane {
+    std::string name;             ///< name of the plane
+    double elevation;             ///< tilt of the plane in radians, up is +
+    uint32_t layers_bits;         ///< layers the plane detects
+    unsigned int first_ray;       ///< index of the first ray of the plane
+    unsigned int num_rays;        ///< number of rays of the plane
+    ros::Publisher publisher;     ///< publisher of the scan of the plane
+    sensor_msgs::LaserScan scan;  ///< scan of the plane
+  };
+
+  std::string topic_;     ///< topic of the point cloud, or prefix of the scans
+  Body *body_;            ///< body the laser frame attaches to
+  Pose origin_;           ///< laser frame w.r.t the body
+  double range_;          ///< laser max range along the rays
+  double noise_std_dev_;  ///< noise std deviation
+  double update_rate_;    ///< the rate laser scan will be published
+  std::string frame_id_;  ///< laser frame id name
+  bool broadcast_tf_;     ///< whether to broadcast laser origin w.r.t body
+  bool point_cloud_;      ///< publish a point cloud instead of laser scans
+  bool world_batch_;      ///< cast rays together with all sensors on a step
+  SensorExecutor::Priority priority_;  ///< priority of the raycast tasks
+  uint32_t reflectance_layers_bits_;   ///< layers with high intensity (255)
+
+  std::vector<Plane> planes_;        ///< planes of the lidar
+  std::vector<uint16_t> ray_plane_;  ///< index of the plane of each ray
+  std::vector<float> ranges_;        ///< range along each ray, or NAN
+  std::vector<float> intensities_;   ///< intensity of each ray
+  std::vector<float> cos_angles_;    ///< cosine of each ray in its plane
+  std::vector<float> sin_angles_;    ///< sine of each ray in its plane
+
+  GaussianNoise noise_;  ///< bulk gaussian noise generator
+
+  /// ray ends in the body frame, one array per coordinate, see
+  /// Geometry::TransformPoints
+  std::vector<float> body_points_x_, body_points_y_;
+  /// ray ends in the world frame for the current scan
+  std::vector<float> world_points_x_, world_points_y_;
+  b2Vec2 laser_origin_point_;  ///< laser origin in world of the current scan
+
+  sensor_msgs::PointCloud2 cloud_;            ///< point cloud of all planes
+  ros::Publisher cloud_publisher_;            ///< point cloud publisher
+  tf::TransformBroadcaster tf_broadcaster_;   ///< broadcast laser frame
+  geometry_msgs::TransformStamped laser_tf_;  ///< tf from body to laser frame
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Called when just before physics update
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @brief Halve the update rate while the step budget requires it, see
+   * StepBudgetGovernor
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @return The state of the noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
+  /**
+   * @brief Compute the world pose of the rays of all planes for a new scan
+   */
+  void PrepareScan();
+
+  /**
+   * @brief Cast the rays [begin, end) of all planes, safe to call
+   * concurrently for disjoint ranges
+   * @param[in] begin First ray
+   * @param[in] end One past the last ray
+   */
+  void CastRays(unsigned int begin, unsigned int end);
+
+  /**
+   * @brief Add the noise and publish the scans or the point cloud
+   * @param[in] stamp Time stamp of the messages
+   */
+  void FinishScan(const ros::Time &stamp);
+
+  /**
+   * @return true if any of the output topics has subscribers
+   */
+  bool HasSubscribers() const;
+
+  /**
+   * @brief helper function to extract the paramters from the YAML Node
+   * @param[in] config Plugin YAML Node
+   */
+  void ParseParameters(const YAML::Node &config);
+};
+
+/**
+ * This class handles the b2RayCastCallback ReportFixture method for the rays
+ * of one plane, keeping the nearest hit in the plane's layers
+ */
+class MultiPlaneLaserCallback : public b2RayCastCallback {
+ public:
+  uint32_t layers_bits_;              ///< layers the ray detects
+  uint32_t reflectance_layers_bits_;  ///< layers with high intensity
+  bool did_hit_ = false;              ///< if the ray hits anything
+  float fraction_ = 0;                ///< Box2D ray trace fraction
+  float intensity_ = 0;               ///< intensity of the nearest hit
+
+  /**
+   * @brief Constructor
+   * @param[in] layers_bits Layers the ray detects
+   * @param[in] reflectance_layers_bits Layers with high intensity
+   */
+  MultiPlaneLaserCallback(uint32_t layers_bits,
+                          uint32_t reflectance_layers_bits)
+      : layers_bits_(layers_bits),
+        reflectance_layers_bits_(reflectance_layers_bits) {}
+
+  /**
+   * @brief Box2D raytrace call back method required for implementing the
+   * b2RayCastCallback abstract class
+   * @param[in] fixture Fixture the ray hits
+   * @param[in] point Point the ray hits the fixture
+   * @param[in] normal Vector indicating the normal at the point hit
+   * @param[in] fraction Fraction of ray length at hit point
+   */
+  float ReportFixture(b2Fixture *fixture, const b2Vec2 &point,
+                      const b2Vec2 &normal, float fraction) override;
+};
+};
+
+#endif
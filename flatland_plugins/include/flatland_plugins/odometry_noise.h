@@ -0,0 +1,123 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 odometry_noise.h
+ * @brief	 Gaussian noise of the odometry of the drive plugins
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FLATLAND_PLUGINS_ODOMETRY_NOISE_H
+#define FLATLAND_PLUGINS_ODOMETRY_NOISE_H
+
+#include <geometry_msgs/Quaternion.h>
+#include <nav_msgs/Odometry.h>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace flatland_plugins {
+
+/**
+ * @brief Build the quaternion of a rotation about z, same as
+ * tf::createQuaternionMsgFromYaw without going through roll and pitch
+ * @param[in] yaw The rotation in radians
+ * @return The quaternion
+ */
+inline geometry_msgs::Quaternion QuaternionMsgFromYaw(double yaw) {
+  geometry_msgs::Quaternion q;
+  q.x = 0;
+  q.y = 0;
+  q.z = sin(0.5 * yaw);
+  q.w = cos(0.5 * yaw);
+  return q;
+}
+
+/**
+ * Gaussian noise added by the drive plugins to their odometry. The six
+ * channels are pose x, y, yaw and twist linear x, linear y, angular z, the
+ * values of all channels are drawn in one go when the odometry is published.
+ */
+class OdometryNoise {
+ public:
+  /// Indices of the channels
+  enum Channel { POSE_X = 0, POSE_Y, POSE_YAW, TWIST_X, TWIST_Y, TWIST_YAW };
+
+  std::default_random_engine rng_;  ///< saved in the plugin snapshots
+  std::array<std::normal_distribution<double>, 6> noise_gen_;
+  bool enabled_ = false;  ///< false when all the variances are zero
+
+  /**
+   * @brief Set the variances of the channels and seed the generator
+   * @param[in] pose_noise Variances of pose x, y and yaw
+   * @param[in] twist_noise Variances of twist linear x, linear y, angular z
+   * @param[in] seed The seed of the random number generator
+   */
+  void Configure(const std::vector<double>& pose_noise,
+                 const std::vector<double>& twist_noise, unsigned int seed);
+
+  /**
+   * @brief Draw one value of a channel, zero when the noise is disabled
+   * @param[in] channel The channel
+   * @return The noise
+   */
+  double Draw(Channel channel) {
+    return enabled_ ? noise_gen_[channel](rng_) : 0.0;
+  }
+
+  /**
+   * @brief Write the ground truth plus freshly drawn noise to odom, the
+   * header and covariances of odom are left as they are
+   * @param[in] ground_truth The odometry without noise
+   * @param[in] yaw The yaw of the ground truth, saves recovering it from the
+   * quaternion
+   * @param[out] odom The noisy odometry
+   */
+  void Apply(const nav_msgs::Odometry& ground_truth, double yaw,
+             nav_msgs::Odometry* odom);
+
+  /**
+   * @return A digest of the state of the generator and distributions
+   */
+  uint64_t GetState() const;
+};
+};  // namespace flatland_plugins
+
+#endif  // FLATLAND_PLUGINS_ODOMETRY_NOISE_H
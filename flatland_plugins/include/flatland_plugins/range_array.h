@@ -0,0 +1,159 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 range_array.h
+ * @brief	 Range sensor array plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/RangeArray.h>
+#include <flatland_server/gaussian_noise.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/types.h>
+#include <ros/ros.h>
+
+#ifndef FLATLAND_PLUGINS_RANGE_ARRAY_H
+#define FLATLAND_PLUGINS_RANGE_ARRAY_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class implements an array of range sensors with a cone field of view,
+ * such as the sonars of a robot, mounted on one body. Every cone is sampled
+ * by a few rays, the rays of all sensors are cast in one batched raycast and
+ * the nearest detection of each sensor is published in a single RangeArray
+ * message
+ */
+class RangeArray : public ModelPlugin {
+ public:
+  /**
+   * A range sensor of the array
+   */
+  struct Sensor {
+    std::string name;        ///< name of the sensor
+    Pose origin;             ///< sensor pose w.r.t the body
+    double half_angle;       ///< half of the cone angle in radians
+    double min_range;        ///< detections closer than this are too close
+    double range;            ///< max range of the sensor
+    unsigned int first_ray;  ///< index of the first ray of the sensor
+    unsigned int num_rays;   ///< number of rays sampling the cone
+  };
+
+  std::string topic_;     ///< topic to publish the ranges on
+  Body *body_;            ///< body the sensors attach to
+  double noise_std_dev_;  ///< noise std deviation
+  double update_rate_;    ///< the rate the ranges will be published
+  uint32_t layers_bits_;  ///< layers the sensors detect
+  bool world_batch_;      ///< cast rays together with all sensors on a step
+
+  std::vector<Sensor> sensors_;         ///< sensors of the array
+  std::vector<b2Vec2> ray_origins_;     ///< ray origins in the body frame
+  std::vector<b2Vec2> ray_ends_;        ///< ray ends in the body frame
+  std::vector<b2RayCastInput> inputs_;  ///< rays of the current update
+  std::vector<b2RayBatchHit> hits_;     ///< nearest hit of each ray
+  b2RayBatchFilter ray_filter_;         ///< fixtures hit by the rays
+
+  GaussianNoise noise_;  ///< bulk gaussian noise generator
+
+  flatland_msgs::RangeArray ranges_;  ///< message of the ranges to publish
+  ros::Publisher ranges_publisher_;   ///< ranges publisher
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Called when just before physics update
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, the plugin only reads the world
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @brief Halve the update rate while the step budget requires it, see
+   * StepBudgetGovernor
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @return The state of the noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
+  /**
+   * @brief Compute the world pose of the rays of all sensors for an update
+   */
+  void PrepareRays();
+
+  /**
+   * @brief Cast the rays [begin, end) of all sensors in one batched raycast,
+   * safe to call concurrently for disjoint ranges
+   * @param[in] begin First ray
+   * @param[in] end One past the last ray
+   */
+  void CastRays(unsigned int begin, unsigned int end);
+
+  /**
+   * @brief Reduce the rays of every sensor to its nearest detection, add the
+   * noise and publish the ranges
+   * @param[in] stamp Time stamp of the message
+   */
+  void FinishRanges(const ros::Time &stamp);
+
+  /**
+   * @brief helper function to extract the paramters from the YAML Node
+   * @param[in] config Plugin YAML Node
+   */
+  void ParseParameters(const YAML::Node &config);
+};
+};
+
+#endif
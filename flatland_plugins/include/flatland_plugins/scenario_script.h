@@ -0,0 +1,161 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 scenario_script.h
+ * @brief	 Runs Lua scenario scripts as coroutines at sim time deadlines
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world_plugin.h>
+#include <yaml-cpp/yaml.h>
+
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+#include <exception>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef FLATLAND_PLUGINS_SCENARIO_SCRIPT_H
+#define FLATLAND_PLUGINS_SCENARIO_SCRIPT_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class runs a Lua scenario script inside the simulation, e.g. opening a
+ * door at t=30 or spawning pallets, without the round trips of services
+ * called from a node. The script and the functions it starts run as
+ * coroutines resumed after the physics step at sim time deadlines, so they
+ * act at exact sim times and see the world of the step
+ */
+class ScenarioScript : public WorldPlugin {
+ public:
+  /**
+   * A coroutine of the script
+   */
+  struct Thread {
+    lua_State *L;  ///< the coroutine
+    int ref;       ///< registry reference keeping it alive
+  };
+
+  lua_State *L_ = nullptr;  ///< the state of the script, owned
+  std::multimap<double, Thread> waiting_;  ///< coroutines by sim time to
+                                           /// resume at, in start order
+  std::vector<Thread> due_;  ///< scratch of AfterPhysicsStep
+  double time_;              ///< sim time of the step being run
+  double deadline_;          ///< sim time the running coroutine yielded
+                             /// until
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Resume the coroutines whose deadline has passed
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Destructor, closes the state
+   */
+  ~ScenarioScript();
+
+  /**
+   * @brief Make a coroutine running the function at the top of the stack,
+   * and pop it
+   * @param[in] L The state of the stack, L_ or a coroutine
+   * @param[in] deadline Sim time to first resume it at
+   */
+  void Start(lua_State *L, double deadline);
+
+  /**
+   * @brief Resume a coroutine, it waits again if it yielded and is dropped
+   * if it returned or failed
+   * @param[in] thread The coroutine
+   */
+  void Resume(const Thread &thread);
+
+  /**
+   * @brief Run a call on the world, turning exceptions into a message at the
+   * top of the stack. It keeps C++ objects out of the frames Lua errors jump
+   * over
+   * @param[in] L The state of the calling coroutine
+   * @param[in] call The call
+   * @return false if the call threw
+   */
+  template <typename Call>
+  static bool Protect(lua_State *L, const Call &call) {
+    try {
+      call();
+      return true;
+    } catch (const std::exception &e) {
+      lua_pushstring(L, e.what());
+      return false;
+    }
+  }
+
+  /**
+   * @return The plugin of a function of the script, its first upvalue
+   */
+  static ScenarioScript *Self(lua_State *L);
+
+  /// The functions of the script, see docs/included_plugins/scenario_script
+  static int LuaTime(lua_State *L);
+  static int LuaSleep(lua_State *L);
+  static int LuaWaitUntil(lua_State *L);
+  static int LuaStart(lua_State *L);
+  static int LuaSpawnModel(lua_State *L);
+  static int LuaDeleteModel(lua_State *L);
+  static int LuaMoveModel(lua_State *L);
+  static int LuaGetPose(lua_State *L);
+  static int LuaSetVelocity(lua_State *L);
+  static int LuaLog(lua_State *L);
+};
+};
+
+#endif
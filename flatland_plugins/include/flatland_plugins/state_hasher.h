@@ -0,0 +1,108 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_hasher.h
+ * @brief	 Digests the state of the world after each step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/column_log.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world_plugin.h>
+#include <ros/ros.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#ifndef FLATLAND_PLUGINS_STATE_HASHER_H
+#define FLATLAND_PLUGINS_STATE_HASHER_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class computes a digest of the state of the world after each step,
+ * of the transforms and velocities of the moving bodies and of the states of
+ * the random generators of the plugins, to check that runs with the parallel
+ * and pipelined modes stay deterministic. The digests are published, and
+ * logged with the digest of each body and generator into a ColumnLog, which
+ * scripts/state_hash_diff.py compares to find where two runs diverge
+ */
+class StateHasher : public WorldPlugin {
+ public:
+  ros::Publisher publisher_;                   ///< publishes the digests
+  std::unique_ptr<ColumnLog::Writer> writer_;  ///< the log, null if none
+  bool log_details_;  ///< if the digests of each body and generator are
+                      /// logged
+  uint64_t step_ = 0;  ///< number of steps done
+
+  uint32_t bodies_table_;         ///< id and name of the logged bodies
+  uint32_t generators_table_;     ///< id and name of the logged generators
+  uint32_t steps_table_;          ///< digests of the steps
+  uint32_t body_hashes_table_;    ///< digests of the bodies
+  uint32_t random_states_table_;  ///< digests of the generators
+
+  /// ids of the logged bodies and generators by name
+  std::unordered_map<std::string, uint32_t> body_ids_, generator_ids_;
+
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Digest the state after the step
+   */
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Log the digest of a body or generator, naming it in its table
+   * the first time
+   * @param[in] names_table The table naming the ids
+   * @param[in] ids The ids by name
+   * @param[in] table The table of the digests
+   * @param[in] name Name of the body or generator
+   * @param[in] hash The digest
+   */
+  void LogHash(uint32_t names_table,
+               std::unordered_map<std::string, uint32_t> *ids, uint32_t table,
+               const std::string &name, uint64_t hash);
+};
+};
+#endif  // FLATLAND_PLUGINS_STATE_HASHER_H
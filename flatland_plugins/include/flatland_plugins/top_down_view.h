@@ -0,0 +1,140 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 top_down_view.h
+ * @brief	 Top down view plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/raster_batch.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/types.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+
+#ifndef FLATLAND_PLUGINS_TOP_DOWN_VIEW_H
+#define FLATLAND_PLUGINS_TOP_DOWN_VIEW_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+/**
+ * This class publishes an egocentric top down image of the geometry around a
+ * body, e.g. as the observation of a learned policy. The views of all
+ * plugins due on a step are rendered together by the RasterBatch of the
+ * world
+ */
+class TopDownView : public ModelPlugin {
+ public:
+  std::string topic_;     ///< topic to publish the image on
+  std::string frame_id_;  ///< frame of the image
+  Body *body_;            ///< body the view is attached to
+  Pose origin_;           ///< view frame w.r.t the body
+  double update_rate_;    ///< the rate the image will be published
+  double resolution_;     ///< size of a pixel in meters
+  int width_;             ///< pixels from left to right
+  int height_;            ///< pixels from top to bottom
+  uint32_t layers_bits_;  ///< layers drawn in the image
+  int view_id_ = -1;      ///< id of the view in the raster batch, -1 if the
+                          /// image is rendered by the plugin
+  bool observed_ = false;  ///< the image is rendered without subscribers,
+                           /// it is read in process, e.g. from Python
+  std::vector<uint8_t> pixels_;  ///< the image, if rendered by the plugin
+
+  sensor_msgs::Image image_;         ///< image to publish
+  ros::Publisher image_publisher_;   ///< image publisher
+
+  /**
+   * @brief Destructor, removes the view from the batch
+   */
+  ~TopDownView();
+
+  /**
+   * @brief Initialization for the plugin
+   * @param[in] config Plugin YAML Node
+   */
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Request the image when it is due and subscribed or observed
+   * @param[in] timekeeper Object managing the simulation time
+   */
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @return true, requests to the batch are thread safe
+   */
+  bool IsThreadSafe() const override { return true; }
+
+  /**
+   * @brief Halve the rate on REDUCE_SENSOR_RATE
+   * @param[in] degradations Bits of StepBudgetGovernor::Degradation
+   */
+  void SetDegradations(uint32_t degradations) override;
+
+  /**
+   * @return The latest image, row major from the top left pixel, height_ *
+   * width_ pixels that do not move
+   */
+  const uint8_t *GetPixels() const;
+
+  /**
+   * @brief Publish the latest image if the topic has subscribers
+   * @param[in] stamp Simulation time of the image
+   */
+  void Publish(const ros::Time &stamp);
+
+  /**
+   * @brief Helper function to extract the paramters from the YAML Node
+   * @param[in] config Plugin YAML Node
+   */
+  void ParseParameters(const YAML::Node &config);
+
+  /**
+   * @return The parameters of the view
+   */
+  RasterBatch::Params MakeParams();
+};
+};
+
+#endif
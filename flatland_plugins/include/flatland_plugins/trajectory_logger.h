@@ -0,0 +1,127 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trajectory_logger.h
+ * @brief	 Logs the poses, contacts and scans of a run to a column log
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/column_log.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world_plugin.h>
+#include <ros/ros.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#ifndef FLATLAND_PLUGINS_TRAJECTORY_LOGGER_H
+#define FLATLAND_PLUGINS_TRAJECTORY_LOGGER_H
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+class Laser;
+
+/**
+ * This class logs the ground truth of a run in process, without serializing
+ * messages: the poses and velocities of the model bodies, the contacts and
+ * optionally the ranges of the lasers, into a ColumnLog compressed on a
+ * background thread. Bodies and lasers are logged by id, named in the
+ * "bodies" and "lasers" tables when first logged, see the docs for the tables
+ */
+class TrajectoryLogger : public WorldPlugin {
+ public:
+  std::unique_ptr<ColumnLog::Writer> writer_;  ///< the log
+  bool log_poses_;     ///< if the poses of the bodies are logged
+  bool log_contacts_;  ///< if the touching contacts are logged
+  bool log_scans_;     ///< if the scans of the lasers are logged
+  double period_;      ///< time between two logged steps, 0 for all steps
+  double next_log_time_ = 0;  ///< time of the next logged step
+  uint32_t step_ = 0;         ///< number of steps done
+
+  uint32_t bodies_table_;    ///< id, model and name of the logged bodies
+  uint32_t poses_table_;     ///< poses and velocities of the bodies
+  uint32_t contacts_table_;  ///< points of the touching contacts
+  uint32_t lasers_table_;    ///< id, model and name of the logged lasers
+  uint32_t scans_table_;     ///< ranges of the lasers
+
+  /// ids of the logged bodies, forgotten when bodies are added or removed
+  std::unordered_map<const Body *, uint32_t> body_ids_;
+  uint32_t next_body_id_ = 0;      ///< id of the next logged body
+  uint64_t body_generation_ = 0;   ///< BodyStates::generation_ of body_ids_
+
+  /// A logged laser
+  struct LoggedLaser {
+    uint32_t id;            ///< id of the laser
+    ros::Time last_stamp;   ///< stamp of the last logged scan
+  };
+  std::unordered_map<const Laser *, LoggedLaser> lasers_;  ///< forgotten
+                                                           /// with body_ids_
+  uint32_t next_laser_id_ = 0;  ///< id of the next logged laser
+
+  void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Log the state after the step
+   */
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override;
+
+  /**
+   * @brief Get the id of a body, naming it in the bodies table the first time
+   * @param[in] body The body
+   * @return The id
+   */
+  uint32_t GetBodyId(const Body *body);
+
+  /**
+   * @brief Log the scans of the lasers published since the last step
+   */
+  void LogScans(double time);
+
+  /**
+   * @brief Log the touching contacts between bodies
+   */
+  void LogContacts(double time);
+};
+};
+#endif  // FLATLAND_PLUGINS_TRAJECTORY_LOGGER_H
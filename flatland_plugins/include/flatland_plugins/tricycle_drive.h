@@ -47,7 +47,9 @@
 #include <Box2D/Box2D.h>
 #include <flatland_plugins/update_timer.h>
 #include <flatland_plugins/dynamics_limits.h>
+#include <flatland_plugins/odometry_noise.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/recorded_subscriber.h>
 #include <flatland_server/timekeeper.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
@@ -65,6 +67,7 @@ class TricycleDrive : public flatland_server::ModelPlugin {
  public:
   Body* body_;
   Joint* front_wj_;       ///<  front wheel joint
+  b2RevoluteJoint* front_joint_;  ///< Box2D joint of front_wj_
   Joint* rear_left_wj_;   ///< rear left wheel joint
   Joint* rear_right_wj_;  ///< rear right wheel joint
   double axel_track_;     ///< normal distrance between the rear two wheels
@@ -84,14 +87,25 @@ class TricycleDrive : public flatland_server::ModelPlugin {
   geometry_msgs::Twist twist_msg_;
   nav_msgs::Odometry odom_msg_;
   nav_msgs::Odometry ground_truth_msg_;
-  ros::Subscriber twist_sub_;
+  RecordedSubscriber twist_sub_;  ///< recorded and replayed by the Recorder
   ros::Publisher odom_pub_;
   ros::Publisher ground_truth_pub_;
 
   UpdateTimer update_timer_;
 
-  default_random_engine rng_;
-  array<normal_distribution<double>, 6> noise_gen_;
+  OdometryNoise noise_;  ///< noise of the odometry
+
+  /**
+   * State of the drive saved in world snapshots
+   */
+  struct State {
+    geometry_msgs::Twist twist_msg;  ///< the last command
+    double delta_command;            ///< see delta_command_
+    double theta_f;                  ///< see theta_f_
+    double d_delta;                  ///< see d_delta_
+    double v_f;                      ///< see v_f_
+    default_random_engine rng;       ///< the noise generator
+  };
 
   /**
    * @name                OnInitialize
@@ -140,6 +154,38 @@ class TricycleDrive : public flatland_server::ModelPlugin {
    * @return    input value capped between lower and upper
    */
   double Saturate(double in, double lower, double upper);
+
+  /**
+   * @return The state of the odometry noise generator, see StateHasher
+   */
+  uint64_t GetRandomState() const override { return noise_.GetState(); }
+
+  /**
+   * @brief Save the command, steering state and noise generator for
+   * World::Snapshot
+   * @return The State of the drive
+   */
+  boost::any SaveState() override;
+
+  /**
+   * @brief Restore the State saved by SaveState
+   * @param[in] state The State of the drive
+   */
+  void RestoreState(const boost::any& state) override;
+
+  /**
+   * @brief Encode the State for World::SaveCheckpoint
+   * @param[in] state The State of the drive
+   * @return The encoded State
+   */
+  std::string EncodeState(const boost::any& state) override;
+
+  /**
+   * @brief Decode a State encoded by EncodeState
+   * @param[in] encoded The encoded State
+   * @return The State of the drive
+   */
+  boost::any DecodeState(const std::string& encoded) override;
 };
 }
 
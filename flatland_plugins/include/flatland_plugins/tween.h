@@ -46,13 +46,15 @@
 
 #include <Box2D/Box2D.h>
 #include <flatland_plugins/update_timer.h>
+#include <flatland_server/kinematic_animator.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/recorded_subscriber.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/types.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
 #include <std_msgs/Bool.h>
-#include "tweeny.h"
+#include <memory>
 
 #ifndef FLATLAND_PLUGINS_TWEEN_H
 #define FLATLAND_PLUGINS_TWEEN_H
@@ -68,10 +70,14 @@ class Tween : public flatland_server::ModelPlugin {
   Pose delta_;      // The maximum change
   float duration_;  // Seconds to enact change over
 
-  ros::Subscriber trigger_sub_;  // Handle forward/reverse trigger
+  RecordedSubscriber trigger_sub_;  // Handle forward/reverse trigger
   bool triggered_ = false;  // If true,animate forwards, otherwise backwards
 
-  tweeny::tween<double, double, double> tween_;  // The tween object (x,y,theta)
+  KinematicAnimator* animator_ = nullptr;  // Moves the body, the animator of
+                                          // the world or own_animator_
+  std::unique_ptr<KinematicAnimator> own_animator_;  // If not loaded by the
+                                                     // plugin manager
+  int track_id_ = -1;  // Id of the track of the body in animator_
 
   // The three different operating modes
   enum class ModeType_ {
@@ -115,6 +121,14 @@ class Tween : public flatland_server::ModelPlugin {
     bounceInOut
   };
   static std::map<std::string, Tween::EasingType_> easing_strings_;
+  static std::map<Tween::EasingType_, KinematicAnimator::Easing>
+      easing_functions_;
+
+  /**
+   * @name          ~Tween
+   * @brief         removes the track of the body from the animator
+   */
+  ~Tween();
 
   /**
    * @name          OnInitialize
@@ -124,7 +138,8 @@ class Tween : public flatland_server::ModelPlugin {
   void OnInitialize(const YAML::Node& config) override;
   /**
    * @name          BeforePhysicsStep
-   * @brief         override the BeforePhysicsStep method
+   * @brief         steps own_animator_, the animator of the world steps
+   *                itself and the plugin is not called per step
    * @param[in]     config The plugin YAML node
    */
   void BeforePhysicsStep(const Timekeeper& timekeeper) override;
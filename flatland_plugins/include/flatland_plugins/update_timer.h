@@ -56,6 +56,8 @@ class UpdateTimer {
  public:
   ros::Duration period_;        ///< period of update
   ros::Time last_update_time_;  ///< last time the update occured
+  double stagger_;              ///< offset of the updates as a fraction of
+                                /// the period, see SetStagger
 
   /**
    * @brief Update timer constructor
@@ -68,6 +70,14 @@ class UpdateTimer {
    */
   void SetRate(double rate);
 
+  /**
+   * @brief Offset the updates by a fraction of the period, so that timers
+   * with the same rate are not all updated on the same step
+   * @param[in] fraction Fraction of the period in [0, 1), typically
+   * ModelPlugin::update_stagger_
+   */
+  void SetStagger(double fraction);
+
   /**
    * Call this method to check if an update is required to keep with the
    * set update rate
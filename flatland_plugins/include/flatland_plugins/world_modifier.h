@@ -47,6 +47,7 @@
 #define WORLD_MODIFIER_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/layer.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world.h>
 #include <flatland_server/yaml_reader.h>
@@ -80,8 +81,8 @@ struct LaserRead {
 struct RayTrace : public b2RayCastCallback {
   bool is_hit_;
   float fraction_;
-  uint16_t category_bits_;
-  RayTrace(uint16_t category_bits)
+  uint32_t category_bits_;
+  RayTrace(uint32_t category_bits)
       : is_hit_(false), category_bits_(category_bits) {}
   float ReportFixture(b2Fixture *fixture, const b2Vec2 &point,
                       const b2Vec2 &normal, float fraction) override;
@@ -94,6 +95,8 @@ struct WorldModifier {
   double wall_wall_dist_;
   bool double_wall_;
   Pose robot_ini_pose_;
+  Layer *layer_;  // the layer the walls are added to
+  std::vector<b2Fixture *> walls_;  // fixtures of the walls added so far
 
   /*
   * @brief based on the info regard old wall and d, calculate new obstacle's
@@ -107,12 +110,36 @@ struct WorldModifier {
   void CalculateNewWall(double d, b2Vec2 vertex1, b2Vec2 vertex2,
                         b2EdgeShape &new_wall);
 
+  /*
+  * @brief calculate the two side walls that make a full obstacle
+  * @param[in] old_wall, the old wall where new wall is added on top to
+  * @param[in] new_wall, the new wall got added
+  * @param[out] walls, the side walls are appended to it
+  */
+  void CalculateSideWalls(const b2EdgeShape &old_wall,
+                          const b2EdgeShape &new_wall,
+                          std::vector<b2EdgeShape> *walls);
+
+  /*
+  * @brief calculate the walls of the full obstacle(s) in front of an old wall
+  * @param[in] wall, old wall where the obstacle will be added on top to
+  * @param[out] walls, the walls of the obstacle(s) are appended to it
+  */
+  void CalculateFullWall(const b2EdgeShape &wall,
+                         std::vector<b2EdgeShape> *walls);
+
   /*
   * @brief add the new wall into the world
   * @param[in] new_wall, the wall that's going to be added
   */
   void AddWall(b2EdgeShape &new_wall);
 
+  /*
+  * @brief add new walls into the world in one batch
+  * @param[in] walls, the walls that are going to be added
+  */
+  void AddWalls(const std::vector<b2EdgeShape> &walls);
+
   /*
   * @brief add two side walls to make it a full obstacle
   * @param[in] old_wall, the old wall where new wall is added on top to
@@ -121,7 +148,7 @@ struct WorldModifier {
   void AddSideWall(b2EdgeShape &old_wall, b2EdgeShape &new_wall);
 
   /*
-   * @brief constructor for WorldModifier
+   * @brief constructor for WorldModifier, throws if the layer does not exist
    * @param[in] world, the world that we are adding walls to
    * @param[in] layer_name, which layer is the obstacle going to be added
    * @param[in] wall_wall_dist, how thick is the obstacle
@@ -139,6 +166,18 @@ struct WorldModifier {
   */
   void AddFullWall(b2EdgeShape *wall);
 
+  /*
+  * @brief make full obstacles in front of several old walls in one batch
+  * @param[in] walls, old walls where the obstacles will be added on top to
+  */
+  void AddFullWalls(const std::vector<const b2EdgeShape *> &walls);
+
+  /*
+  * @brief remove all walls added by this modifier, e.g. to reset an episode
+  * without reloading the world
+  */
+  void RemoveWalls();
+
 };      // class WorldModifier
 };      // namespace flatland_server
 #endif  // WORLD_MODIFIER_H
\ No newline at end of file
@@ -45,10 +45,16 @@
  */
 
 #include <Box2D/Box2D.h>
+#include <flatland_plugins/world_modifier.h>
+#include <flatland_server/recorded_subscriber.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world_plugin.h>
 #include <ros/ros.h>
+#include <std_srvs/Trigger.h>
+#include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
 #ifndef FLATLAND_PLUGINS_WORLD_RANDOM_WALL_H
 #define FLATLAND_PLUGINS_WORLD_RANDOM_WALL_H
@@ -57,7 +63,32 @@ using namespace flatland_server;
 
 namespace flatland_plugins {
 class RandomWall : public WorldPlugin {
+ public:
+  std::unique_ptr<WorldModifier> modifier_;  ///< adds and removes the walls
+  std::vector<b2EdgeShape> layer_walls_;  ///< walls of the layer at load time
+  unsigned int num_of_walls_;             ///< obstacles added per episode
+  std::mt19937 rng_;                      ///< picks the walls
+  RecordedService reset_service_;        ///< triggers Reset between steps
+
   void OnInitialize(const YAML::Node &config) override;
+
+  /**
+   * @brief Add obstacles in front of num_of_walls_ walls of the layer picked
+   * at random, without copying or shuffling all of them
+   */
+  void AddRandomWalls();
+
+  /**
+   * @brief Remove the obstacles added so far and add new ones, so that a new
+   * episode starts without reloading the world
+   */
+  void Reset();
+
+  /**
+   * @brief Service callback of reset_service_
+   */
+  bool OnReset(std_srvs::Trigger::Request &request,
+               std_srvs::Trigger::Response &response);
 };
 };
 
@@ -45,6 +45,7 @@
  */
 
 #include <flatland_plugins/bool_sensor.h>
+#include <flatland_server/plugin_registry.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/yaml_reader.h>
 #include <pluginlib/class_list_macros.h>
@@ -60,6 +61,9 @@ void BoolSensor::OnInitialize(const YAML::Node &config) {
   std::string topic_name = reader.Get<std::string>("topic", "bool_sensor");
   update_rate_ = reader.Get<double>("update_rate",
                                     std::numeric_limits<double>::infinity());
+  publish_on_change_ = reader.Get<bool>("publish_on_change", false);
+  heartbeat_rate_ = reader.Get<double>("heartbeat_rate", 0.0);
+  bool trigger_volume = reader.Get<bool>("trigger_volume", false);
 
   // sensor defaults to the first model in the list
   if (GetModel()->bodies_.size() == 0) {
@@ -77,8 +81,21 @@ void BoolSensor::OnInitialize(const YAML::Node &config) {
     throw YAMLException("Body with name \"" + body_name + "\" does not exist");
   }
 
+  // the sensor footprints of the body no longer create Box2D contacts, the
+  // contact callbacks are not needed anymore
+  if (trigger_volume) {
+    trigger_volume_.reset(new TriggerVolume(body_->physics_body_));
+    if (trigger_volume_->AddSensorFixtures() == 0) {
+      throw YAMLException("Body with name \"" + body_name +
+                          "\" has no sensor footprint for the trigger volume");
+    }
+    contact_callbacks_ &= ~(BEGIN_CONTACT | END_CONTACT);
+  }
+
   // Set the update timer
   update_timer_.SetRate(update_rate_);
+  update_timer_.SetStagger(update_stagger_);
+  heartbeat_timer_.SetRate(heartbeat_rate_);
 
   // Init publisher
   publisher_ =
@@ -86,13 +103,42 @@ void BoolSensor::OnInitialize(const YAML::Node &config) {
 
   ROS_DEBUG_NAMED("BoolSensor",
                   "Initialized with params: topic(%s) body(%s) "
-                  "update_rate(%f)",
-                  topic_name.c_str(), body_name.c_str(), update_rate_);
+                  "update_rate(%f) publish_on_change(%d) heartbeat_rate(%f) "
+                  "trigger_volume(%d)",
+                  topic_name.c_str(), body_name.c_str(), update_rate_,
+                  publish_on_change_, heartbeat_rate_, trigger_volume);
 }
 
 void BoolSensor::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  // the overlaps of a trigger volume are only checked at the update rate, a
+  // hit shorter than the period may be missed
+  if (trigger_volume_) {
+    if (!update_timer_.CheckUpdate(timekeeper)) {
+      return;
+    }
+    trigger_volume_->Update();
+    collisions_ = trigger_volume_->GetOccupants().size();
+  }
+
+  if (publish_on_change_) {
+    // edge triggered, a hit that began and ended within the step is still
+    // published as true, then as false after the next step
+    bool state = hit_something_ || collisions_ > 0;
+    hit_something_ = false;
+    bool heartbeat = heartbeat_timer_.CheckUpdate(timekeeper);
+    if (published_ && state == published_state_ && !heartbeat) {
+      return;
+    }
+    std_msgs::Bool msg;
+    msg.data = state;
+    PublishLazily(publisher_, msg);
+    published_ = true;
+    published_state_ = state;
+    return;
+  }
+
   // Publish the boolean timer at the desired update rate
-  if (!update_timer_.CheckUpdate(timekeeper)) {
+  if (!trigger_volume_ && !update_timer_.CheckUpdate(timekeeper)) {
     return;
   }
 
@@ -109,7 +155,7 @@ void BoolSensor::AfterPhysicsStep(const Timekeeper &timekeeper) {
       msg.data = false;
     }
   }
-  publisher_.publish(msg);
+  PublishLazily(publisher_, msg);
 }
 
 void BoolSensor::BeginContact(b2Contact *contact) {
@@ -138,3 +184,5 @@ void BoolSensor::EndContact(b2Contact *contact) {
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::BoolSensor,
                        flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::BoolSensor,
+                         flatland_server::ModelPlugin)
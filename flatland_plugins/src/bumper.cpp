@@ -47,17 +47,75 @@
 #include <flatland_msgs/Collision.h>
 #include <flatland_msgs/Collisions.h>
 #include <flatland_plugins/bumper.h>
+#include <flatland_server/counted_publish.h>
 #include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/yaml_reader.h>
 #include <pluginlib/class_list_macros.h>
 #include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 
 using namespace flatland_server;
 
 namespace flatland_plugins {
 
-Bumper::ContactState::ContactState() { Reset(); }
+namespace {
+
+/**
+ * @brief Hash a contact pointer into a power of two sized table
+ * @param[in] contact The contact
+ * @param[in] mask The size of the table minus one
+ * @return The first slot to probe
+ */
+size_t ContactSlot(const b2Contact *contact, size_t mask) {
+  uint64_t key = reinterpret_cast<uintptr_t>(contact);
+  return ((key >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+}
+
+/**
+ * @brief Hash a body and an entity into a power of two sized table
+ * @param[in] body The body
+ * @param[in] entity The entity
+ * @param[in] mask The size of the table minus one
+ * @return The first slot to probe
+ */
+size_t PairSlot(const Body *body, const Entity *entity, size_t mask) {
+  uint64_t key = reinterpret_cast<uintptr_t>(body) ^
+                 reinterpret_cast<uintptr_t>(entity) * 0xC2B2AE3D27D4EB4FULL;
+  return ((key >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+}
+
+/**
+ * @brief Compute the force of a contact point, from the impulses averaged
+ * over the post solves of the step
+ * @param[in] s State of the contact, with at least one post solve
+ * @param[in] i The point
+ * @param[in] step_size The step size
+ * @return The absolute magnitude of the force
+ */
+double PointForce(const Bumper::ContactState &s, int i, double step_size) {
+  // calculate average impulse during each time step, the impulse are
+  // converted to the applied force by dividing the step size
+  double ave_normal_impulse = s.sum_normal_impulses[i] / s.num_count;
+  double ave_tangential_impulse = s.sum_tangential_impulses[i] / s.num_count;
+  double ave_normal_force = ave_normal_impulse / step_size;
+  double ave_tangential_force = ave_tangential_impulse / step_size;
+
+  // Calculate the absolute magnitude of forces, forces are not provided
+  // in vector form because the forces are obtained from averaging
+  // Box2D impulses which are very inaccurate making them completely
+  // useless for anything other than ball parking the impact strength
+  return sqrt(ave_normal_force * ave_normal_force +
+              ave_tangential_force * ave_tangential_force);
+}
+}
+
+Bumper::ContactState::ContactState() : contact(nullptr), point_count(0) {
+  Reset();
+}
 
 void Bumper::ContactState::Reset() {
   num_count = 0;
@@ -76,6 +134,9 @@ void Bumper::OnInitialize(const YAML::Node &config) {
   publish_all_collisions_ = reader.Get<bool>("publish_all_collisions", true);
   update_rate_ = reader.Get<double>("update_rate",
                                     std::numeric_limits<double>::infinity());
+  publish_on_change_ = reader.Get<bool>("publish_on_change", false);
+  heartbeat_rate_ = reader.Get<double>("heartbeat_rate", 0.0);
+  aggregate_ = reader.Get<bool>("aggregate", false);
 
   std::vector<std::string> excluded_body_names =
       reader.GetList<std::string>("exclude", {}, -1, -1);
@@ -94,24 +155,124 @@ void Bumper::OnInitialize(const YAML::Node &config) {
   }
 
   update_timer_.SetRate(update_rate_);
+  update_timer_.SetStagger(update_stagger_);
+  heartbeat_timer_.SetRate(heartbeat_rate_);
   collisions_publisher_ =
       nh_.advertise<flatland_msgs::Collisions>(topic_name_, 1);
 
   ROS_DEBUG_NAMED("Bumper",
                   "Initialized with params: topic(%s) world_frame_id(%s) "
-                  "publish_all_collisions(%d) update_rate(%f) exclude({%s})",
+                  "publish_all_collisions(%d) update_rate(%f) "
+                  "publish_on_change(%d) heartbeat_rate(%f) aggregate(%d) "
+                  "exclude({%s})",
                   topic_name_.c_str(), world_frame_id_.c_str(),
-                  publish_all_collisions_, update_rate_,
+                  publish_all_collisions_, update_rate_, publish_on_change_,
+                  heartbeat_rate_, aggregate_,
                   boost::algorithm::join(excluded_body_names, ",").c_str());
 }
 
+Bumper::ContactState *Bumper::FindContact(b2Contact *contact) {
+  if (contact_slots_.empty()) return nullptr;
+  size_t mask = contact_slots_.size() - 1;
+  for (size_t slot = ContactSlot(contact, mask);; slot = (slot + 1) & mask) {
+    int index = contact_slots_[slot];
+    if (index < 0) return nullptr;
+    if (contact_states_[index].contact == contact) {
+      return &contact_states_[index];
+    }
+  }
+}
+
+void Bumper::CompactContacts() {
+  if (ended_contacts_ > 0) {
+    contact_states_.erase(
+        std::remove_if(contact_states_.begin(), contact_states_.end(),
+                       [](const ContactState &s) { return !s.contact; }),
+        contact_states_.end());
+    ended_contacts_ = 0;
+  }
+
+  size_t size = contact_slots_.empty() ? 16 : contact_slots_.size();
+  while (size < 2 * (contact_states_.size() + 1)) {
+    size *= 2;
+  }
+  contact_slots_.assign(size, -1);
+  for (unsigned int i = 0; i < contact_states_.size(); i++) {
+    size_t slot = ContactSlot(contact_states_[i].contact, size - 1);
+    while (contact_slots_[slot] >= 0) {
+      slot = (slot + 1) & (size - 1);
+    }
+    contact_slots_[slot] = i;
+  }
+}
+
+void Bumper::AggregateContacts(double step_size) {
+  pair_states_.clear();
+  size_t size = 16;
+  while (size < 2 * contact_states_.size()) {
+    size *= 2;
+  }
+  pair_slots_.assign(size, -1);
+  size_t mask = size - 1;
+
+  for (const auto &s : contact_states_) {
+    if (!s.contact) continue;  // ended
+
+    // find the pair of the contact, or add it
+    size_t slot = PairSlot(s.body_A, s.entity_B, mask);
+    int index;
+    while ((index = pair_slots_[slot]) >= 0 &&
+           (pair_states_[index].body_A != s.body_A ||
+            pair_states_[index].entity_B != s.entity_B)) {
+      slot = (slot + 1) & mask;
+    }
+    if (index < 0) {
+      index = pair_states_.size();
+      pair_slots_[slot] = index;
+      PairState pair;
+      pair.body_A = s.body_A;
+      pair.entity_B = s.entity_B;
+      pair.body_B = s.body_B;
+      pair.max_contact_force = 0;
+      pair.force = 0;
+      pair.weighted_point.SetZero();
+      pair.weighted_normal.SetZero();
+      pair.point_sum.SetZero();
+      pair.normal_sum.SetZero();
+      pair.point_count = 0;
+      pair_states_.push_back(pair);
+    }
+    PairState &pair = pair_states_[index];
+
+    // contacts without post solve, with sensors, have no points
+    int point_count = s.num_count > 0 ? s.point_count : 0;
+    double contact_force = 0;
+    for (int i = 0; i < point_count; i++) {
+      double force = PointForce(s, i, step_size);
+      contact_force += force;
+      pair.weighted_point += force * s.points[i];
+      pair.weighted_normal += force * s.normal;
+      pair.point_sum += s.points[i];
+      pair.normal_sum += s.normal;
+    }
+    pair.point_count += point_count;
+    pair.force += contact_force;
+    if (contact_force > pair.max_contact_force) {
+      pair.max_contact_force = contact_force;
+      pair.body_B = s.body_B;
+    }
+  }
+}
+
 void Bumper::BeforePhysicsStep(const Timekeeper &timekeeper) {
-  std::map<b2Contact *, ContactState>::iterator it;
+  if (ended_contacts_ > 0) {
+    CompactContacts();
+  }
 
   // Clear the forces at the begining of every physics step since brand
   // new collision resolutions are being calculated by Box2D each time step
-  for (it = contact_states_.begin(); it != contact_states_.end(); it++) {
-    it->second.Reset();
+  for (auto &state : contact_states_) {
+    state.Reset();
   }
 }
 
@@ -121,28 +282,101 @@ void Bumper::AfterPhysicsStep(const Timekeeper &timekeeper) {
   // manages the publishing rate of empty collisions when
   // publish_all_collisions is true, or it manages the publishing rate all
   // empty and non-empty collisions when publish_all_collisions_ is false
-  if (!publish_all_collisions_ || contact_states_.size() <= 0) {
+  size_t count = contact_states_.size() - ended_contacts_;
+  if (publish_on_change_) {
+    // edge triggered, long lasting contacts are only published once
+    bool heartbeat = heartbeat_timer_.CheckUpdate(timekeeper);
+    if (!contacts_changed_ && !heartbeat) {
+      return;
+    }
+    contacts_changed_ = false;
+  } else if (!publish_all_collisions_ || count <= 0) {
     if (!update_timer_.CheckUpdate(timekeeper)) {
       return;
     }
   }
 
-  std::map<b2Contact *, ContactState>::iterator it;
+  // nothing to compute when nobody listens, the timers and the edge
+  // detection above still advance
+  if (!IsSubscribed(collisions_publisher_)) {
+    return;
+  }
+
+  if (aggregate_) {
+    AggregateContacts(timekeeper.GetStepSize());
+    count = pair_states_.size();
+  }
 
-  flatland_msgs::Collisions collisions;
+  // the message and its collisions are reused, so in a steady state the
+  // strings and arrays are overwritten within their existing buffers
+  flatland_msgs::Collisions &collisions = collisions_;
   collisions.header.frame_id = world_frame_id_;
   collisions.header.stamp = timekeeper.GetSimTime();
+  while (collisions.collisions.size() > count) {
+    spare_collisions_.push_back(std::move(collisions.collisions.back()));
+    collisions.collisions.pop_back();
+  }
+  while (collisions.collisions.size() < count && !spare_collisions_.empty()) {
+    collisions.collisions.push_back(std::move(spare_collisions_.back()));
+    spare_collisions_.pop_back();
+  }
+  collisions.collisions.resize(count);
+
+  // one collision per pair, with the summed force, and the point and normal
+  // weighted by the forces of the contact points
+  if (aggregate_) {
+    for (size_t i = 0; i < count; i++) {
+      const PairState &pair = pair_states_[i];
+      flatland_msgs::Collision &collision = collisions.collisions[i];
+      collision.entity_A = GetModel()->GetName();
+      collision.entity_B = pair.entity_B->name_;
+      collision.body_A = pair.body_A->name_;
+      collision.body_B = pair.body_B->name_;
+      collision.magnitude_forces.clear();
+      collision.contact_positions.clear();
+      collision.contact_normals.clear();
+      if (pair.point_count == 0) continue;
+
+      b2Vec2 p = pair.weighted_point;
+      b2Vec2 n = pair.weighted_normal;
+      if (pair.force > 0) {
+        p *= 1.0 / pair.force;
+      } else {
+        p = pair.point_sum;
+        p *= 1.0 / pair.point_count;
+        n = pair.normal_sum;
+      }
+      n.Normalize();
+
+      flatland_msgs::Vector2 point;
+      flatland_msgs::Vector2 normal;
+      point.x = p.x;
+      point.y = p.y;
+      normal.x = n.x;
+      normal.y = n.y;
+      collision.magnitude_forces.push_back(pair.force);
+      collision.contact_positions.push_back(point);
+      collision.contact_normals.push_back(normal);
+    }
+    PublishCounted(collisions_publisher_, collisions);
+    return;
+  }
 
   // loop through all collisions in our record and publish
-  for (it = contact_states_.begin(); it != contact_states_.end(); it++) {
-    b2Contact *c = it->first;
-    ContactState *s = &it->second;
-    flatland_msgs::Collision collision;
+  size_t next = 0;
+  for (const auto &state : contact_states_) {
+    if (!state.contact) continue;  // ended
+    b2Contact *c = state.contact;
+    const ContactState *s = &state;
+    flatland_msgs::Collision &collision = collisions.collisions[next++];
     collision.entity_A = GetModel()->GetName();
     collision.entity_B = s->entity_B->name_;
 
     collision.body_A = s->body_A->name_;
     collision.body_B = s->body_B->name_;
+    collision.magnitude_forces.clear();
+    collision.contact_positions.clear();
+    collision.contact_normals.clear();
 
     // If there was no post solve called, which means that the collision
     // probably involves a Box2D sensor, therefore there are no contact points,
@@ -151,21 +385,7 @@ void Bumper::AfterPhysicsStep(const Timekeeper &timekeeper) {
 
       // go through each collision point
       for (int i = 0; i < m->pointCount; i++) {
-        // calculate average impulse during each time step, the impulse are
-        // converted to the applied force by dividing the step size
-        double ave_normal_impulse = s->sum_normal_impulses[i] / s->num_count;
-        double ave_tangential_impulse =
-            s->sum_tangential_impulses[i] / s->num_count;
-        double ave_normal_force = ave_normal_impulse / timekeeper.GetStepSize();
-        double ave_tangential_force =
-            ave_tangential_impulse / timekeeper.GetStepSize();
-
-        // Calculate the absolute magnitude of forces, forces are not provided
-        // in vector form because the forces are obtained from averaging
-        // Box2D impulses which are very inaccurate making them completely
-        // useless for anything other than ball parking the impact strength
-        double force_abs = sqrt(ave_normal_force * ave_normal_force +
-                                ave_tangential_force * ave_tangential_force);
+        double force_abs = PointForce(*s, i, timekeeper.GetStepSize());
 
         collision.magnitude_forces.push_back(force_abs);
         flatland_msgs::Vector2 point;
@@ -178,11 +398,9 @@ void Bumper::AfterPhysicsStep(const Timekeeper &timekeeper) {
         collision.contact_normals.push_back(normal);
       }
     }
-
-    collisions.collisions.push_back(collision);
   }
 
-  collisions_publisher_.publish(collisions);
+  PublishCounted(collisions_publisher_, collisions);
 }
 
 void Bumper::BeginContact(b2Contact *contact) {
@@ -193,7 +411,7 @@ void Bumper::BeginContact(b2Contact *contact) {
   }
 
   // If this is a new contact, add it to the records of alive contacts
-  if (!contact_states_.count(contact)) {
+  if (FindContact(contact) == nullptr) {
     Body *collision_body =
         static_cast<Body *>(this_fixture->GetBody()->GetUserData());
 
@@ -209,8 +427,10 @@ void Bumper::BeginContact(b2Contact *contact) {
 
     // add the body to the record of active contacts
     if (!ignore) {
-      contact_states_[contact] = ContactState();
-      ContactState *c = &contact_states_[contact];
+      contact_states_.push_back(ContactState());
+      ContactState *c = &contact_states_.back();
+      c->contact = contact;
+      contacts_changed_ = true;
       c->entity_B = other_entity;
       c->body_B = static_cast<Body *>(other_fixture->GetBody()->GetUserData());
       c->body_A = collision_body;
@@ -223,6 +443,19 @@ void Bumper::BeginContact(b2Contact *contact) {
       } else {
         c->normal_sign = -1;
       }
+
+      // the table is rebuilt when it gets half full, otherwise the contact
+      // is added to it
+      if (2 * contact_states_.size() > contact_slots_.size()) {
+        CompactContacts();
+      } else {
+        size_t mask = contact_slots_.size() - 1;
+        size_t slot = ContactSlot(contact, mask);
+        while (contact_slots_[slot] >= 0) {
+          slot = (slot + 1) & mask;
+        }
+        contact_slots_[slot] = contact_states_.size() - 1;
+      }
     }
   }
 }
@@ -230,22 +463,22 @@ void Bumper::BeginContact(b2Contact *contact) {
 void Bumper::EndContact(b2Contact *contact) {
   if (!FilterContact(contact)) return;
 
-  // The contact ended, remove it from the list of contacts
-  if (contact_states_.count(contact)) {
-    contact_states_.erase(contact);
-  } else {
-    // contact is ignored
-    return;
+  // The contact ended, it is only marked here and removed from the list of
+  // contacts by CompactContacts before the next step, so entries are never
+  // deleted from the open addressing table
+  ContactState *state = FindContact(contact);
+  if (state != nullptr) {
+    state->contact = nullptr;
+    ended_contacts_++;
+    contacts_changed_ = true;
   }
 }
 
 void Bumper::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {
   if (!FilterContact(contact)) return;
 
-  ContactState *state;
-  if (contact_states_.count(contact)) {
-    state = &contact_states_[contact];
-  } else {
+  ContactState *state = FindContact(contact);
+  if (state == nullptr) {
     // contact is ignored
     return;
   }
@@ -275,6 +508,7 @@ void Bumper::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {
 
   state->points[0] = m.points[0];
   state->points[1] = m.points[1];
+  state->point_count = contact->GetManifold()->pointCount;
 
   state->normal = m.normal;
   state->normal *= state->normal_sign;
@@ -282,3 +516,4 @@ void Bumper::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {
 };
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::Bumper, flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::Bumper, flatland_server::ModelPlugin)
@@ -0,0 +1,112 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	  compact_scan.cpp
+ * @brief   Quantization of laser scans into compact messages
+ * @author  Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/compact_scan.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_plugins {
+
+const uint16_t CompactScan::NO_RETURN;
+const uint16_t CompactScan::MAX_RANGE;
+
+void CompactScan::Encode(const sensor_msgs::LaserScan &scan, float resolution,
+                         bool intensities,
+                         flatland_msgs::CompactScan *compact) {
+  compact->header = scan.header;
+  compact->angle_min = scan.angle_min;
+  compact->angle_increment = scan.angle_increment;
+  compact->scan_time = scan.scan_time;
+  compact->range_max = scan.range_max;
+  compact->resolution = resolution;
+
+  // the returns are at least one unit, so they are never taken for no return
+  float scale = 1 / resolution;
+  compact->ranges.resize(scan.ranges.size());
+  for (size_t i = 0; i < scan.ranges.size(); i++) {
+    float r = scan.ranges[i];
+    if (std::isnan(r)) {
+      compact->ranges[i] = NO_RETURN;
+    } else {
+      float units = std::round(r * scale);
+      compact->ranges[i] = static_cast<uint16_t>(
+          std::min(std::max(units, 1.0f), static_cast<float>(MAX_RANGE)));
+    }
+  }
+
+  compact->intensities.resize(intensities ? scan.intensities.size() : 0);
+  for (size_t i = 0; i < compact->intensities.size(); i++) {
+    float v = std::round(scan.intensities[i]);
+    compact->intensities[i] =
+        static_cast<uint8_t>(std::min(std::max(v, 0.0f), 255.0f));
+  }
+}
+
+void CompactScan::Decode(const flatland_msgs::CompactScan &compact,
+                         sensor_msgs::LaserScan *scan) {
+  size_t count = compact.ranges.size();
+  scan->header = compact.header;
+  scan->angle_min = compact.angle_min;
+  scan->angle_increment = compact.angle_increment;
+  scan->angle_max =
+      compact.angle_min + compact.angle_increment * (count > 0 ? count - 1 : 0);
+  scan->scan_time = compact.scan_time;
+  scan->time_increment = count > 0 ? compact.scan_time / count : 0;
+  scan->range_min = 0;
+  scan->range_max = compact.range_max;
+
+  scan->ranges.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    uint16_t r = compact.ranges[i];
+    scan->ranges[i] = r == NO_RETURN ? NAN : r * compact.resolution;
+  }
+
+  scan->intensities.resize(compact.intensities.size());
+  for (size_t i = 0; i < compact.intensities.size(); i++) {
+    scan->intensities[i] = compact.intensities[i];
+  }
+}
+};  // namespace flatland_plugins
@@ -0,0 +1,103 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	  compact_scan_republisher.cpp
+ * @brief   Republishes compact scans as sensor_msgs/LaserScan
+ * @author  Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/compact_scan.h>
+#include <ros/ros.h>
+
+using namespace flatland_plugins;
+
+/**
+ * Converts the compact scans of a Laser back to sensor_msgs/LaserScan, e.g.
+ * on the machine running the robot software when the simulation runs
+ * elsewhere. The compact topic is only subscribed while the scan topic has
+ * subscribers.
+ *
+ * Topics: compact_scan (in), scan (out), remap them to the laser topics,
+ * e.g. compact_scan:=/robot/scan_compact scan:=/robot/scan
+ */
+class CompactScanRepublisher {
+ public:
+  ros::NodeHandle nh_;
+  ros::Publisher publisher_;
+  ros::Subscriber subscriber_;
+  sensor_msgs::LaserScan scan_;  ///< reused between messages
+
+  CompactScanRepublisher() {
+    auto connect = [this](const ros::SingleSubscriberPublisher &) {
+      Connect();
+    };
+    publisher_ =
+        nh_.advertise<sensor_msgs::LaserScan>("scan", 1, connect, connect);
+  }
+
+  /**
+   * @brief Subscribe to the compact scans while the scans are subscribed
+   */
+  void Connect() {
+    if (publisher_.getNumSubscribers() == 0) {
+      subscriber_.shutdown();
+    } else if (!subscriber_) {
+      subscriber_ = nh_.subscribe("compact_scan", 1,
+                                  &CompactScanRepublisher::Callback, this,
+                                  ros::TransportHints().tcpNoDelay());
+    }
+  }
+
+  /**
+   * @brief Republish a compact scan
+   */
+  void Callback(const flatland_msgs::CompactScan::ConstPtr &compact) {
+    CompactScan::Decode(*compact, &scan_);
+    publisher_.publish(scan_);
+  }
+};
+
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "compact_scan_republisher");
+  CompactScanRepublisher republisher;
+  ros::spin();
+  return 0;
+}
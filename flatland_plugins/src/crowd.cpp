@@ -0,0 +1,445 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 crowd.cpp
+ * @brief	 Crowd of pedestrian agents
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/crowd.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/recorder.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/state_hash.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+namespace {
+
+/**
+ * Collects the fixtures in some layers overlapping an AABB, optionally
+ * without the agents, a fixture with several children is reported once per
+ * child
+ */
+class ObstacleCollector : public b2QueryCallback {
+ public:
+  uint32_t layers_bits;
+  const void *agents;  ///< user data of the agents
+  bool skip_agents;
+  std::vector<b2Fixture *> fixtures;
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        !(fixture->GetFilterData().categoryBits & layers_bits) ||
+        (skip_agents && fixture->GetBody()->GetUserData() == agents)) {
+      return true;
+    }
+    fixtures.push_back(fixture);
+    return true;
+  }
+};
+}
+
+void Crowd::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  int count = reader.Get<int>("count");
+  radius_ = reader.Get<double>("radius", 0.25);
+  desired_speed_ = reader.Get<double>("desired_speed", 1.0);
+  max_speed_ = reader.Get<double>("max_speed", 1.5);
+  relaxation_time_ = reader.Get<double>("relaxation_time", 0.5);
+  agent_strength_ = reader.Get<double>("agent_strength", 2.0);
+  agent_range_ = reader.Get<double>("agent_range", 0.3);
+  wall_strength_ = reader.Get<double>("wall_strength", 5.0);
+  wall_range_ = reader.Get<double>("wall_range", 0.2);
+  neighbor_distance_ = reader.Get<double>("neighbor_distance", 2.0);
+  goal_tolerance_ = reader.Get<double>("goal_tolerance", 0.5);
+  std::array<double, 4> area = reader.GetArray<double, 4>("area");
+  std::vector<std::string> layers =
+      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+  Color color = reader.GetColor("color", Color(1, 0.5, 0, 1));
+  std::string topic = reader.Get<std::string>("topic", "crowd");
+  int seed = reader.Get<int>("seed", -1);
+  reader.EnsureAccessedAllKeys();
+
+  if (count < 1) {
+    throw YAMLException("Invalid \"count\" param, must be at least 1");
+  }
+  count_ = count;
+
+  if (radius_ <= 0 || desired_speed_ < 0 || max_speed_ < desired_speed_ ||
+      relaxation_time_ <= 0 || agent_range_ <= 0 || wall_range_ <= 0 ||
+      neighbor_distance_ < 2 * radius_) {
+    throw YAMLException(
+        "Invalid crowd params, must have radius > 0, max_speed >= "
+        "desired_speed >= 0, relaxation_time > 0, agent_range > 0, "
+        "wall_range > 0 and neighbor_distance >= 2 * radius");
+  }
+
+  if (area[2] <= area[0] || area[3] <= area[1]) {
+    throw YAMLException(
+        "Invalid \"area\" param, must be [min_x, min_y, max_x, max_y]");
+  }
+  area_.lowerBound.Set(area[0], area[1]);
+  area_.upperBound.Set(area[2], area[3]);
+
+  std::vector<std::string> invalid_layers;
+  layers_bits_ = world_->cfr_.GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw YAMLException("Cannot find layer(s): {" +
+                        boost::algorithm::join(invalid_layers, ",") + "}");
+  }
+
+  // a negative seed picks a random one, which is recorded and replayed by
+  // the Recorder
+  rng_.seed(seed < 0 ? Recorder::Get().Seed("seed:" + name_) : seed);
+
+  // the bodies of the agents share the user data of the anchor, so the
+  // entity of an agent is the crowd, like the tiles of a layer
+  b2World *physics_world = world_->physics_world_;
+  agents_.reset(new Agents(physics_world, name_));
+  anchor_.reset(new Body(physics_world, agents_.get(), "agents", color,
+                         Pose(0, 0, 0), b2_kinematicBody, YAML::Node()));
+
+  b2BodyDef body_def;
+  body_def.type = b2_kinematicBody;
+  body_def.fixedRotation = true;
+  body_def.userData = anchor_.get();
+
+  b2CircleShape circle;
+  circle.m_radius = radius_;
+  b2FixtureDef fixture_def;
+  fixture_def.shape = &circle;
+  fixture_def.density = 1;
+  fixture_def.filter.categoryBits = layers_bits_;
+  fixture_def.filter.maskBits = layers_bits_;
+
+  for (unsigned int i = 0; i < count_; i++) {
+    b2Vec2 p = RandomPoint();
+    for (int attempt = 1; !IsFree(p); attempt++) {
+      if (attempt >= 100) {
+        throw Exception("Crowd " + Q(name_) +
+                        ": cannot find a free position for agent " +
+                        std::to_string(i) + " in the area");
+      }
+      p = RandomPoint();
+    }
+
+    body_def.position = p;
+    b2Body *body = physics_world->CreateBody(&body_def);
+    body->CreateFixture(&fixture_def);
+    bodies_.push_back(body);
+
+    b2Vec2 goal = RandomPoint();
+    x_.push_back(p.x);
+    y_.push_back(p.y);
+    goal_x_.push_back(goal.x);
+    goal_y_.push_back(goal.y);
+  }
+  vx_.assign(count_, 0);
+  vy_.assign(count_, 0);
+  arrived_.assign(count_, 0);
+  agent_cell_.resize(count_);
+  cell_agents_.resize(count_);
+
+  // a power of two number of buckets, at least twice the agents
+  unsigned int buckets = 1;
+  while (buckets < 2 * count_) {
+    buckets *= 2;
+  }
+  cell_start_.resize(buckets + 1);
+  bucket_mask_ = buckets - 1;
+
+  marker_.header.frame_id = "map";
+  marker_.ns = name_;
+  marker_.id = 0;
+  marker_.type = visualization_msgs::Marker::SPHERE_LIST;
+  marker_.action = visualization_msgs::Marker::ADD;
+  marker_.pose.orientation.w = 1;
+  marker_.scale.x = marker_.scale.y = marker_.scale.z = 2 * radius_;
+  marker_.color.r = color.r;
+  marker_.color.g = color.g;
+  marker_.color.b = color.b;
+  marker_.color.a = color.a;
+  marker_.points.resize(count_);
+  marker_publisher_ = nh_.advertise<visualization_msgs::Marker>(topic, 1);
+
+  ROS_INFO_NAMED("Crowd", "Crowd %s: %u agents in [%f, %f, %f, %f]",
+                 name_.c_str(), count_, area[0], area[1], area[2], area[3]);
+}
+
+Crowd::~Crowd() {
+  // the world destroys the plugins after the Box2D world, which already
+  // freed the bodies of the agents and the anchor
+  if (anchor_) {
+    anchor_->physics_body_ = nullptr;
+  }
+}
+
+void Crowd::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  float dt = timekeeper.GetStepSize();
+  if (dt <= 0) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < count_; i++) {
+    const b2Vec2 &p = bodies_[i]->GetPosition();
+    x_[i] = p.x;
+    y_[i] = p.y;
+  }
+  BuildGrid();
+
+  SensorExecutor::Get().ParallelFor(
+      count_, 64, [this, dt](unsigned int begin, unsigned int end) {
+        ComputeVelocities(begin, end, dt);
+      });
+
+  // the random goals are drawn in order for the runs to be reproducible
+  for (unsigned int i = 0; i < count_; i++) {
+    if (arrived_[i]) {
+      b2Vec2 goal = RandomPoint();
+      goal_x_[i] = goal.x;
+      goal_y_[i] = goal.y;
+      arrived_[i] = 0;
+    }
+    bodies_[i]->SetLinearVelocity(b2Vec2(vx_[i], vy_[i]));
+  }
+}
+
+void Crowd::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  if (marker_publisher_.getNumSubscribers() == 0) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < count_; i++) {
+    const b2Vec2 &p = bodies_[i]->GetPosition();
+    marker_.points[i].x = p.x;
+    marker_.points[i].y = p.y;
+  }
+  marker_.header.stamp = timekeeper.GetSimTime();
+  PublishCounted(marker_publisher_, marker_);
+}
+
+uint64_t Crowd::GetRandomState() const {
+  std::ostringstream state;
+  state << rng_;
+  StateHash hash;
+  hash.Add(state.str());
+  return hash.Get();
+}
+
+uint32_t Crowd::CellBucket(int cx, int cy) const {
+  uint32_t h = uint32_t(cx) * 73856093u ^ uint32_t(cy) * 19349663u;
+  return h & bucket_mask_;
+}
+
+void Crowd::BuildGrid() {
+  // a counting sort of the agents by bucket, the ends of the buckets are
+  // moved back to their starts as the agents are placed
+  std::fill(cell_start_.begin(), cell_start_.end(), 0);
+  for (unsigned int i = 0; i < count_; i++) {
+    int cx = std::floor(x_[i] / neighbor_distance_);
+    int cy = std::floor(y_[i] / neighbor_distance_);
+    agent_cell_[i] = CellBucket(cx, cy);
+    cell_start_[agent_cell_[i]]++;
+  }
+  for (size_t b = 1; b < cell_start_.size(); b++) {
+    cell_start_[b] += cell_start_[b - 1];
+  }
+  for (unsigned int i = count_; i-- > 0;) {
+    cell_agents_[--cell_start_[agent_cell_[i]]] = i;
+  }
+}
+
+void Crowd::ComputeVelocities(unsigned int begin, unsigned int end,
+                              float dt) {
+  b2CircleShape point;
+  point.m_radius = 0;
+  float range2 = neighbor_distance_ * neighbor_distance_;
+
+  ObstacleCollector collector;
+  collector.layers_bits = layers_bits_;
+  collector.agents = anchor_.get();
+  collector.skip_agents = true;
+
+  for (unsigned int i = begin; i < end; i++) {
+    float px = x_[i], py = y_[i];
+
+    // relax toward the desired velocity to the goal
+    float gx = goal_x_[i] - px, gy = goal_y_[i] - py;
+    float goal_distance = std::sqrt(gx * gx + gy * gy);
+    float fx = -vx_[i], fy = -vy_[i];
+    if (goal_distance < goal_tolerance_) {
+      arrived_[i] = 1;
+    } else {
+      fx += desired_speed_ * gx / goal_distance;
+      fy += desired_speed_ * gy / goal_distance;
+    }
+    fx /= relaxation_time_;
+    fy /= relaxation_time_;
+
+    // repulsion of the agents in the 3x3 cells around, distinct cells may
+    // share a bucket, which is visited once
+    int cx = std::floor(px / neighbor_distance_);
+    int cy = std::floor(py / neighbor_distance_);
+    uint32_t visited[9];
+    int num_visited = 0;
+    for (int ox = -1; ox <= 1; ox++) {
+      for (int oy = -1; oy <= 1; oy++) {
+        uint32_t b = CellBucket(cx + ox, cy + oy);
+        if (std::find(visited, visited + num_visited, b) !=
+            visited + num_visited) {
+          continue;
+        }
+        visited[num_visited++] = b;
+
+        for (uint32_t k = cell_start_[b]; k < cell_start_[b + 1]; k++) {
+          uint32_t j = cell_agents_[k];
+          float dx = px - x_[j], dy = py - y_[j];
+          float d2 = dx * dx + dy * dy;
+          if (j == i || d2 > range2 || d2 == 0) {
+            continue;
+          }
+          float d = std::sqrt(d2);
+          float f =
+              agent_strength_ * std::exp((2 * radius_ - d) / agent_range_);
+          fx += f * dx / d;
+          fy += f * dy / d;
+        }
+      }
+    }
+
+    // repulsion of the walls and models around, from their nearest points
+    b2AABB aabb;
+    aabb.lowerBound.Set(px - neighbor_distance_, py - neighbor_distance_);
+    aabb.upperBound.Set(px + neighbor_distance_, py + neighbor_distance_);
+    collector.fixtures.clear();
+    world_->physics_world_->QueryAABB(&collector, aabb);
+
+    std::sort(collector.fixtures.begin(), collector.fixtures.end());
+    collector.fixtures.erase(
+        std::unique(collector.fixtures.begin(), collector.fixtures.end()),
+        collector.fixtures.end());
+    for (b2Fixture *fixture : collector.fixtures) {
+      const b2Shape *shape = fixture->GetShape();
+      for (int32 child = 0; child < shape->GetChildCount(); child++) {
+        b2DistanceInput input;
+        input.proxyA.Set(&point, 0);
+        input.proxyB.Set(shape, child);
+        input.transformA.Set(b2Vec2(px, py), 0);
+        input.transformB = fixture->GetBody()->GetTransform();
+        input.useRadii = false;
+        b2SimplexCache cache;
+        cache.count = 0;
+        b2DistanceOutput output;
+        b2Distance(&output, &cache, &input);
+
+        float d = output.distance;
+        if (d <= 0 || d > neighbor_distance_) {
+          continue;
+        }
+        b2Vec2 n = (1.0f / d) * (output.pointA - output.pointB);
+        float f = wall_strength_ * std::exp((radius_ - d) / wall_range_);
+        fx += f * n.x;
+        fy += f * n.y;
+      }
+    }
+
+    float vx = vx_[i] + fx * dt, vy = vy_[i] + fy * dt;
+    float speed = std::sqrt(vx * vx + vy * vy);
+    if (speed > max_speed_) {
+      vx *= max_speed_ / speed;
+      vy *= max_speed_ / speed;
+    }
+    vx_[i] = vx;
+    vy_[i] = vy;
+  }
+}
+
+bool Crowd::IsFree(const b2Vec2 &p) const {
+  b2CircleShape circle;
+  circle.m_radius = radius_;
+  b2Transform xf(p, b2Rot(0));
+
+  ObstacleCollector collector;
+  collector.layers_bits = layers_bits_;
+  collector.agents = anchor_.get();
+  collector.skip_agents = false;
+  b2AABB aabb;
+  aabb.lowerBound = p - b2Vec2(radius_, radius_);
+  aabb.upperBound = p + b2Vec2(radius_, radius_);
+  world_->physics_world_->QueryAABB(&collector, aabb);
+
+  for (b2Fixture *fixture : collector.fixtures) {
+    const b2Shape *shape = fixture->GetShape();
+    for (int32 child = 0; child < shape->GetChildCount(); child++) {
+      if (b2TestOverlap(&circle, 0, shape, child, xf,
+                        fixture->GetBody()->GetTransform())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+b2Vec2 Crowd::RandomPoint() {
+  std::uniform_real_distribution<float> x(area_.lowerBound.x,
+                                          area_.upperBound.x);
+  std::uniform_real_distribution<float> y(area_.lowerBound.y,
+                                          area_.upperBound.y);
+  float px = x(rng_);
+  return b2Vec2(px, y(rng_));
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::Crowd, flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::Crowd, flatland_server::WorldPlugin)
@@ -46,17 +46,177 @@
 
 #include <Box2D/Box2D.h>
 #include <flatland_plugins/diff_drive.h>
+#include <flatland_msgs/CommandLatency.h>
+#include <flatland_plugins/robot_odometry.h>
+#include <flatland_server/counted_publish.h>
 #include <flatland_server/debug_visualization.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/odometry_aggregator.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/tf_aggregator.h>
+#include <flatland_server/world_checkpoint.h>
 #include <geometry_msgs/TransformStamped.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 #include <tf/tf.h>
+#include <sstream>
 
 namespace flatland_plugins {
 
 void DiffDrive::TwistCallback(const geometry_msgs::Twist& msg) {
+  // the plugin is skipped while the model is asleep, a changed command wakes
+  // it, repeating the same command does not
+  if (msg.linear.x != twist_msg_.linear.x ||
+      msg.angular.z != twist_msg_.angular.z) {
+    GetModel()->SetAwake(true);
+  }
   twist_msg_ = msg;
+
+  CommandLatency* latency = GetModel()->command_latency_.get();
+  if (latency) {
+    // replayed commands have no receipt time
+    double now = CommandLatency::Now();
+    double received = RecordedSubscriber::GetReceiveTime();
+    latency->Receive(received > 0 ? received : now, now);
+  }
+}
+
+DiffDrive::~DiffDrive() {
+  if (extrapolation_task_ != 0) {
+    Extrapolator::Get().Remove(extrapolation_task_);
+  }
+}
+
+/**
+ * @brief Extrapolate an odometry message at constant velocities, its twist
+ * is the velocity of the body origin in the odom frame
+ * @param[in] from The odometry of the last update
+ * @param[in] stamp Time stamp of the extrapolated odometry
+ * @param[in] dt Time since the last update
+ * @param[out] to The extrapolated odometry
+ */
+static void ExtrapolateOdometry(const nav_msgs::Odometry& from,
+                                const ros::Time& stamp, double dt,
+                                nav_msgs::Odometry* to) {
+  *to = from;
+  to->header.stamp = stamp;
+  to->pose.pose.position.x += from.twist.twist.linear.x * dt;
+  to->pose.pose.position.y += from.twist.twist.linear.y * dt;
+  to->pose.pose.orientation = QuaternionMsgFromYaw(
+      tf::getYaw(from.pose.pose.orientation) + from.twist.twist.angular.z * dt);
+}
+
+void DiffDrive::PublishExtrapolated(double wall_time) {
+  std::lock_guard<std::mutex> lock(extrapolation_mutex_);
+  // the stamps only increase, a stalled simulation publishes nothing new
+  double time = clock_.Estimate(wall_time);
+  if (time <= published_time_) {
+    return;
+  }
+  published_time_ = time;
+
+  ros::Time stamp(time);
+  double dt = time - clock_.GetTime();
+  ExtrapolateOdometry(last_ground_truth_msg_, stamp, dt, &extrapolated_msg_);
+  PublishLazily(ground_truth_pub_, extrapolated_msg_);
+  ExtrapolateOdometry(last_odom_msg_, stamp, dt, &extrapolated_msg_);
+  PublishLazily(odom_pub_, extrapolated_msg_);
+
+  // sent right away, the aggregator only flushes on the physics steps
+  SendOdomTf(extrapolated_msg_);
+}
+
+void DiffDrive::SendOdomTf(const nav_msgs::Odometry& odom) {
+  geometry_msgs::TransformStamped odom_tf;
+  odom_tf.header = odom.header;
+  odom_tf.child_frame_id = odom.child_frame_id;
+  odom_tf.transform.translation.x = odom.pose.pose.position.x;
+  odom_tf.transform.translation.y = odom.pose.pose.position.y;
+  odom_tf.transform.translation.z = 0;
+  odom_tf.transform.rotation = odom.pose.pose.orientation;
+  if (extrapolation_task_ == 0 &&
+      flatland_server::TfAggregator::IsEnabled()) {
+    flatland_server::TfAggregator::Get().Send(odom_tf);
+  } else {
+    tf_broadcaster.sendTransform(odom_tf);
+  }
+}
+
+void DiffDrive::PublishLatency(const Timekeeper& timekeeper) {
+  CommandLatency* latency = GetModel()->command_latency_.get();
+  double now = CommandLatency::Now();
+  if (now < next_latency_pub_) {
+    return;
+  }
+  next_latency_pub_ = now + 1.0;
+
+  flatland_msgs::CommandLatency msg;
+  msg.header.stamp = timekeeper.GetSimTime();
+  msg.model = GetModel()->GetName();
+  msg.commands = latency->GetCommandCount();
+  msg.superseded = latency->GetSupersededCount();
+  for (int s = 0; s < CommandLatency::STAGE_COUNT; s++) {
+    CommandLatency::Stage stage = static_cast<CommandLatency::Stage>(s);
+    TimingHistogram histogram = latency->GetLatency(stage);
+    flatland_msgs::StageTiming timing;
+    timing.name = CommandLatency::GetStageName(stage);
+    timing.count = histogram.GetCount();
+    timing.min = histogram.GetMin();
+    timing.mean = histogram.GetMean();
+    timing.p99 = histogram.GetPercentile(99);
+    timing.max = histogram.GetMax();
+    msg.stages.push_back(timing);
+  }
+  latency->Reset();
+  flatland_server::PublishCounted(latency_pub_, msg);
+}
+
+boost::any DiffDrive::SaveState() {
+  State state;
+  state.twist_msg = twist_msg_;
+  state.angular_velocity = angular_velocity_;
+  state.linear_velocity = linear_velocity_;
+  state.rng = noise_.rng_;
+  return state;
+}
+
+void DiffDrive::RestoreState(const boost::any& state) {
+  const State* s = boost::any_cast<State>(&state);
+  if (s == nullptr) return;
+
+  twist_msg_ = s->twist_msg;
+  angular_velocity_ = s->angular_velocity;
+  linear_velocity_ = s->linear_velocity;
+  noise_.rng_ = s->rng;
+}
+
+std::string DiffDrive::EncodeState(const boost::any& state) {
+  const State* s = boost::any_cast<State>(&state);
+  if (s == nullptr) return std::string();
+
+  CheckpointWriter writer;
+  writer.Put(s->twist_msg.linear.x);
+  writer.Put(s->twist_msg.linear.y);
+  writer.Put(s->twist_msg.angular.z);
+  writer.Put(s->angular_velocity);
+  writer.Put(s->linear_velocity);
+  std::ostringstream rng;
+  rng << s->rng;
+  writer.PutString(rng.str());
+  return writer.Data();
+}
+
+boost::any DiffDrive::DecodeState(const std::string& encoded) {
+  CheckpointReader reader(encoded);
+  State state;
+  state.twist_msg.linear.x = reader.Get<double>();
+  state.twist_msg.linear.y = reader.Get<double>();
+  state.twist_msg.angular.z = reader.Get<double>();
+  state.angular_velocity = reader.Get<double>();
+  state.linear_velocity = reader.Get<double>();
+  std::istringstream rng(reader.GetString());
+  rng >> state.rng;
+  return state;
 }
 
 void DiffDrive::OnInitialize(const YAML::Node& config) {
@@ -72,6 +232,10 @@ void DiffDrive::OnInitialize(const YAML::Node& config) {
   std::string ground_truth_topic =
       reader.Get<std::string>("ground_truth_pub", "odometry/ground_truth");
   std::string twist_pub_topic = reader.Get<std::string>("twist_pub", "twist");
+  extrapolation_rate_ = reader.Get<double>("extrapolation_rate", 0);
+  bool trace_latency = reader.Get<bool>("trace_latency", false);
+  std::string latency_topic =
+      reader.Get<std::string>("latency_pub", "command_latency");
 
   // noise are in the form of linear x, linear y, angular variances
   std::vector<double> odom_twist_noise =
@@ -82,6 +246,7 @@ void DiffDrive::OnInitialize(const YAML::Node& config) {
   double pub_rate =
       reader.Get<double>("pub_rate", std::numeric_limits<double>::infinity());
   update_timer_.SetRate(pub_rate);
+  update_timer_.SetStagger(update_stagger_);
 
   // Angular dynamics constraints
   angular_dynamics_.Configure(reader.SubnodeOpt("angular_dynamics", YamlReader::MAP).Node());
@@ -109,13 +274,19 @@ void DiffDrive::OnInitialize(const YAML::Node& config) {
 
   reader.EnsureAccessedAllKeys();
 
+  if (extrapolation_rate_ < 0) {
+    throw YAMLException("Invalid \"extrapolation_rate\" " +
+                        std::to_string(extrapolation_rate_) +
+                        ", must not be negative");
+  }
+
   body_ = GetModel()->GetBody(body_name);
   if (body_ == nullptr) {
     throw YAMLException("Body with name " + Q(body_name) + " does not exist");
   }
 
   // publish and subscribe to topics
-  twist_sub_ = nh_.subscribe(twist_topic, 1, &DiffDrive::TwistCallback, this);
+  twist_sub_.Subscribe(nh_, twist_topic, 1, &DiffDrive::TwistCallback, this);
   if (enable_odom_pub_) {
     odom_pub_ = nh_.advertise<nav_msgs::Odometry>(odom_topic, 1);
     ground_truth_pub_ =
@@ -126,6 +297,13 @@ void DiffDrive::OnInitialize(const YAML::Node& config) {
     twist_pub_ = nh_.advertise<geometry_msgs::TwistStamped>(twist_pub_topic, 1);
   }
 
+  // the lasers of the model report their scans to the model
+  if (trace_latency) {
+    GetModel()->command_latency_.reset(new CommandLatency());
+    latency_pub_ =
+        nh_.advertise<flatland_msgs::CommandLatency>(latency_topic, 1);
+  }
+
   // init the values for the messages
   ground_truth_msg_.header.frame_id = odom_frame_id;
   ground_truth_msg_.child_frame_id =
@@ -141,29 +319,27 @@ void DiffDrive::OnInitialize(const YAML::Node& config) {
   }
 
   // init the random number generators
-  std::random_device rd;
-  rng_ = std::default_random_engine(rd());
-  for (unsigned int i = 0; i < 3; i++) {
-    // variance is standard deviation squared
-    noise_gen_[i] =
-        std::normal_distribution<double>(0.0, sqrt(odom_pose_noise[i]));
-  }
-
-  for (unsigned int i = 0; i < 3; i++) {
-    noise_gen_[i + 3] =
-        std::normal_distribution<double>(0.0, sqrt(odom_twist_noise[i]));
+  noise_.Configure(odom_pose_noise, odom_twist_noise, RandomSeed());
+
+  // the odometry is only published by the extrapolation task, see
+  // BeforePhysicsStep
+  if (extrapolation_rate_ > 0 && enable_odom_pub_) {
+    extrapolation_task_ = Extrapolator::Get().Add(
+        extrapolation_rate_,
+        [this](double wall_time) { PublishExtrapolated(wall_time); });
   }
 
   ROS_DEBUG_NAMED("DiffDrive",
                   "Initialized with params body(%p %s) odom_frame_id(%s) "
                   "twist_sub(%s) odom_pub(%s) ground_truth_pub(%s) "
                   "odom_pose_noise({%f,%f,%f}) odom_twist_noise({%f,%f,%f}) "
-                  "pub_rate(%f)\n",
+                  "pub_rate(%f) extrapolation_rate(%f)\n",
                   body_, body_->name_.c_str(), odom_frame_id.c_str(),
                   twist_topic.c_str(), odom_topic.c_str(),
                   ground_truth_topic.c_str(), odom_pose_noise[0],
                   odom_pose_noise[1], odom_pose_noise[2], odom_twist_noise[0],
-                  odom_twist_noise[1], odom_twist_noise[2], pub_rate);
+                  odom_twist_noise[1], odom_twist_noise[2], pub_rate,
+                  extrapolation_rate_);
 }
 
 void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
@@ -171,8 +347,10 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
   b2Body* b2body = body_->physics_body_;
 
-  b2Vec2 position = b2body->GetPosition();
-  float angle = b2body->GetAngle();
+  // the rotation of the body transform holds the sine and cosine of the
+  // angle, no need to recompute them
+  const b2Transform& xf = b2body->GetTransform();
+  const b2Vec2& position = xf.p;
 
   // Apply dynamics limits
   double dt = timekeeper.GetStepSize();
@@ -182,8 +360,7 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
   // we apply the twist velocities, this must be done every physics step to make
   // sure Box2D solver applies the correct velocity through out. The velocity
   // given in the twist message should be in the local frame
-  b2Vec2 linear_vel_local(linear_velocity_, 0);
-  b2Vec2 linear_vel = b2body->GetWorldVector(linear_vel_local);
+  b2Vec2 linear_vel(xf.q.c * linear_velocity_, xf.q.s * linear_velocity_);
   float angular_vel = angular_velocity_;  // angular is independent of frames
 
   // we want the velocity vector in the world frame at the center of mass
@@ -194,15 +371,25 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
   // center of mass
 
   // r is the vector from body origin to the CM in world frame
-  b2Vec2 r = b2body->GetWorldCenter() - position;
+  b2Vec2 r = b2Mul(xf.q, b2body->GetLocalCenter());
   b2Vec2 linear_vel_cm = linear_vel + angular_vel * b2Vec2(-r.y, r.x);
 
-  b2body->SetLinearVelocity(linear_vel_cm);
-  b2body->SetAngularVelocity(angular_vel);
+  // a resting robot without command is left alone, so that it falls asleep
+  // and is not solved until the next command
+  if (linear_velocity_ != 0 || angular_velocity_ != 0 || b2body->IsAwake()) {
+    b2body->SetLinearVelocity(linear_vel_cm);
+    b2body->SetAngularVelocity(angular_vel);
+  }
 
-  // Update odom+ground truth messages if needed
+  CommandLatency* latency = GetModel()->command_latency_.get();
+  if (latency) {
+    latency->Apply(timekeeper.GetSimTime().toSec(), CommandLatency::Now());
+  }
 
+  // the messages are only filled on the steps they are published
   if (publish) {
+    float angle = b2body->GetAngle();
+
     // get the state of the body and publish the data
     b2Vec2 linear_vel_local =
         b2body->GetLinearVelocityFromLocalPoint(b2Vec2(0, 0));
@@ -212,8 +399,7 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
     ground_truth_msg_.pose.pose.position.x = position.x;
     ground_truth_msg_.pose.pose.position.y = position.y;
     ground_truth_msg_.pose.pose.position.z = 0;
-    ground_truth_msg_.pose.pose.orientation =
-        tf::createQuaternionMsgFromYaw(angle);
+    ground_truth_msg_.pose.pose.orientation = QuaternionMsgFromYaw(angle);
     ground_truth_msg_.twist.twist.linear.x = linear_vel_local.x;
     ground_truth_msg_.twist.twist.linear.y = linear_vel_local.y;
     ground_truth_msg_.twist.twist.linear.z = 0;
@@ -223,19 +409,33 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
     // add the noise to odom messages
     odom_msg_.header.stamp = timekeeper.GetSimTime();
-    odom_msg_.pose.pose = ground_truth_msg_.pose.pose;
-    odom_msg_.twist.twist = ground_truth_msg_.twist.twist;
-    odom_msg_.pose.pose.position.x += noise_gen_[0](rng_);
-    odom_msg_.pose.pose.position.y += noise_gen_[1](rng_);
-    odom_msg_.pose.pose.orientation =
-        tf::createQuaternionMsgFromYaw(angle + noise_gen_[2](rng_));
-    odom_msg_.twist.twist.linear.x += noise_gen_[3](rng_);
-    odom_msg_.twist.twist.linear.y += noise_gen_[4](rng_);
-    odom_msg_.twist.twist.angular.z += noise_gen_[5](rng_);
+    noise_.Apply(ground_truth_msg_, angle, &odom_msg_);
 
     if (enable_odom_pub_) {
-      ground_truth_pub_.publish(ground_truth_msg_);
-      odom_pub_.publish(odom_msg_);
+      if (OdometryAggregator::IsEnabled()) {
+        OdometryAggregator::Get().Send(
+            MakeRobotOdometry(ground_truth_msg_, odom_msg_));
+      }
+      if (extrapolation_task_ != 0) {
+        // the extrapolation task publishes the messages and the odom TF
+        std::lock_guard<std::mutex> lock(extrapolation_mutex_);
+        last_ground_truth_msg_ = ground_truth_msg_;
+        last_odom_msg_ = odom_msg_;
+        double time = timekeeper.GetSimTime().toSec();
+        if (time < published_time_) {
+          published_time_ = 0;  // the simulation time went back
+        }
+        clock_.Step(time, Extrapolator::Now());
+      } else {
+        // the full messages are only serialized for their subscribers
+        PublishLazily(ground_truth_pub_, ground_truth_msg_);
+        PublishLazily(odom_pub_, odom_msg_);
+      }
+      if (latency) {
+        latency->Publish(CommandLatency::ODOMETRY,
+                         timekeeper.GetSimTime().toSec(),
+                         CommandLatency::Now());
+      }
     }
 
     if (enable_twist_pub_) {
@@ -245,29 +445,31 @@ void DiffDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
       twist_pub_msg.header.stamp = timekeeper.GetSimTime();
       twist_pub_msg.header.frame_id = odom_msg_.child_frame_id;
 
-      // Forward velocity in twist.linear.x
-      twist_pub_msg.twist.linear.x = cos(angle) * linear_vel_local.x +
-                                     sin(angle) * linear_vel_local.y +
-                                     noise_gen_[3](rng_);
+      // Forward velocity in twist.linear.x, the noise is drawn even without
+      // subscribers to keep the noise of the odometry reproducible
+      twist_pub_msg.twist.linear.x = xf.q.c * linear_vel_local.x +
+                                     xf.q.s * linear_vel_local.y +
+                                     noise_.Draw(OdometryNoise::TWIST_X);
 
       // Angular velocity in twist.angular.z
-      twist_pub_msg.twist.angular.z = angular_vel + noise_gen_[5](rng_);
-      twist_pub_.publish(twist_pub_msg);
+      twist_pub_msg.twist.angular.z =
+          angular_vel + noise_.Draw(OdometryNoise::TWIST_YAW);
+      PublishLazily(twist_pub_, twist_pub_msg);
     }
 
     // publish odom tf
-    geometry_msgs::TransformStamped odom_tf;
-    odom_tf.header = odom_msg_.header;
-    odom_tf.child_frame_id = odom_msg_.child_frame_id;
-    odom_tf.transform.translation.x = odom_msg_.pose.pose.position.x;
-    odom_tf.transform.translation.y = odom_msg_.pose.pose.position.y;
-    odom_tf.transform.translation.z = 0;
-    odom_tf.transform.rotation = odom_msg_.pose.pose.orientation;
-    tf_broadcaster.sendTransform(odom_tf);
+    if (extrapolation_task_ == 0) {
+      SendOdomTf(odom_msg_);
+    }
   }
 
+  if (latency) {
+    PublishLatency(timekeeper);
+  }
 }
 }
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::DiffDrive,
-                       flatland_server::ModelPlugin)
\ No newline at end of file
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::DiffDrive,
+                         flatland_server::ModelPlugin)
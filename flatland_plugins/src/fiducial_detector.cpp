@@ -0,0 +1,367 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fiducial_detector.cpp
+ * @brief	 Fiducial detector plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/fiducial_detector.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model.h>
+#include <flatland_server/model_body.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/tf_aggregator.h>
+#include <flatland_server/yaml_reader.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+namespace {
+
+/**
+ * Collects the fixtures in the tagged layers of the models other than the
+ * model of the detector, a fixture with several children is reported once
+ * per child
+ */
+class TaggedFixtureCollector : public b2QueryCallback {
+ public:
+  uint32_t layers_bits;
+  const Model *model;
+  std::vector<b2Fixture *> fixtures;
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        !(fixture->GetFilterData().categoryBits & layers_bits)) {
+      return true;
+    }
+    Body *body = static_cast<Body *>(fixture->GetBody()->GetUserData());
+    if (!body || body->GetEntity() == model ||
+        body->GetEntity()->Type() != Entity::EntityType::MODEL) {
+      return true;
+    }
+    fixtures.push_back(fixture);
+    return true;
+  }
+};
+
+/**
+ * @brief Wrap an angle to [-pi, pi]
+ */
+double WrapAngle(double angle) { return atan2(sin(angle), cos(angle)); }
+}
+
+void FiducialDetector::OnInitialize(const YAML::Node &config) {
+  ParseParameters(config);
+
+  SetUpdateRate(update_rate_);
+
+  // the rays start inside the model of the detector, the target of a ray is
+  // hit unless something blocks the line of sight
+  for (ModelBody *body : GetModel()->bodies_) {
+    model_bodies_.push_back(body->GetPhysicsBody());
+  }
+  ray_filter_.maskBits = layers_bits_ | fiducial_layers_bits_;
+  ray_filter_.ignoredBodies = model_bodies_.data();
+  ray_filter_.ignoredBodyCount = model_bodies_.size();
+
+  std::string frame_id = tf::resolve("", GetModel()->NameSpaceTF(frame_id_));
+  detections_.header.frame_id = frame_id;
+  detections_publisher_ =
+      nh_.advertise<flatland_msgs::FiducialDetections>(topic_, 1);
+
+  // Broadcast transform between the body and detector
+  tf::Quaternion q;
+  q.setRPY(0, 0, origin_.theta);
+
+  detector_tf_.header.frame_id =
+      tf::resolve("", GetModel()->NameSpaceTF(body_->GetName()));
+  detector_tf_.child_frame_id = frame_id;
+  detector_tf_.transform.translation.x = origin_.x;
+  detector_tf_.transform.translation.y = origin_.y;
+  detector_tf_.transform.translation.z = 0;
+  detector_tf_.transform.rotation.x = q.x();
+  detector_tf_.transform.rotation.y = q.y();
+  detector_tf_.transform.rotation.z = q.z();
+  detector_tf_.transform.rotation.w = q.w();
+
+  // the mount never moves, it is published once with the aggregator
+  if (broadcast_tf_ && TfAggregator::IsEnabled()) {
+    detector_tf_.header.stamp = ros::Time::now();
+    TfAggregator::Get().SendStatic(detector_tf_);
+  }
+}
+
+void FiducialDetector::SetDegradations(uint32_t degradations) {
+  SetUpdateRate(degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_);
+}
+
+void FiducialDetector::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  // only compute and publish when the number of subscribers is not zero
+  if (IsSubscribed(detections_publisher_)) {
+    const b2Body *b = body_->GetPhysicsBody();
+    b2Vec2 origin = b2Mul(b->GetTransform(), b2Vec2(origin_.x, origin_.y));
+    FindCandidates(origin, b->GetAngle() + origin_.theta);
+    CheckLineOfSight(origin);
+
+    detections_.header.stamp = timekeeper.GetSimTime();
+    PublishCounted(detections_publisher_, detections_);
+  }
+
+  if (broadcast_tf_ && !TfAggregator::IsEnabled()) {
+    detector_tf_.header.stamp = timekeeper.GetSimTime();
+    tf_broadcaster_.sendTransform(detector_tf_);
+  }
+}
+
+void FiducialDetector::FindCandidates(const b2Vec2 &origin, double angle) {
+  b2AABB aabb;
+  aabb.lowerBound = origin - b2Vec2(range_, range_);
+  aabb.upperBound = origin + b2Vec2(range_, range_);
+
+  TaggedFixtureCollector collector;
+  collector.layers_bits = fiducial_layers_bits_;
+  collector.model = GetModel();
+  GetModel()->GetPhysicsWorld()->QueryAABB(&collector, aabb);
+
+  // group the fixtures by body, a body is a candidate once
+  std::vector<b2Fixture *> &fixtures = collector.fixtures;
+  std::sort(fixtures.begin(), fixtures.end(),
+            [](const b2Fixture *a, const b2Fixture *b) {
+              return a->GetBody() < b->GetBody();
+            });
+
+  candidates_.clear();
+  for (size_t i = 0; i < fixtures.size();) {
+    b2Body *body = fixtures[i]->GetBody();
+    b2AABB bounds = fixtures[i]->GetAABB(0);
+    for (; i < fixtures.size() && fixtures[i]->GetBody() == body; i++) {
+      for (int32 child = 0; child < fixtures[i]->GetShape()->GetChildCount();
+           child++) {
+        bounds.Combine(fixtures[i]->GetAABB(child));
+      }
+    }
+
+    b2Vec2 d = body->GetPosition() - origin;
+    float range = d.Length();
+    double bearing = WrapAngle(atan2(d.y, d.x) - angle);
+    if (range > range_ || bearing < min_angle_ || bearing > max_angle_) {
+      continue;
+    }
+
+    const Entity *model =
+        static_cast<Body *>(body->GetUserData())->GetEntity();
+    b2Vec2 extents = bounds.GetExtents();
+
+    Candidate c;
+    c.body = body;
+    c.position = body->GetPosition();
+    c.half_width = std::max(extents.x, extents.y);
+    c.detection.name = model->GetName();
+    c.detection.id = ParseId(model->GetName());
+    c.detection.pose.x = range * cos(bearing);
+    c.detection.pose.y = range * sin(bearing);
+    c.detection.pose.theta = WrapAngle(body->GetAngle() - angle);
+    candidates_.push_back(c);
+  }
+}
+
+void FiducialDetector::CheckLineOfSight(const b2Vec2 &origin) {
+  // the rays of a candidate end at its position and across its width, a bit
+  // inside its bounds
+  inputs_.resize(candidates_.size() * los_rays_);
+  hits_.resize(inputs_.size());
+  for (size_t i = 0; i < candidates_.size(); i++) {
+    const Candidate &c = candidates_[i];
+    b2Vec2 dir = c.position - origin;
+    dir.Normalize();
+    b2Vec2 across = 0.8f * c.half_width * b2Vec2(-dir.y, dir.x);
+    for (unsigned int k = 0; k < los_rays_; k++) {
+      float offset = los_rays_ > 1 ? -1.0f + 2.0f * k / (los_rays_ - 1) : 0;
+      b2RayCastInput &input = inputs_[i * los_rays_ + k];
+      input.p1 = origin;
+      input.p2 = c.position + offset * across;
+      input.maxFraction = 1.0f;
+    }
+  }
+
+  // one traversal of the broadphase for the rays of all candidates
+  GetModel()->GetPhysicsWorld()->RayCastBatch(inputs_.data(), inputs_.size(),
+                                              ray_filter_, hits_.data());
+
+  // a candidate is visible if one of its rays reaches it
+  detections_.detections.clear();
+  for (size_t i = 0; i < candidates_.size(); i++) {
+    for (unsigned int k = 0; k < los_rays_; k++) {
+      const b2RayBatchHit &hit = hits_[i * los_rays_ + k];
+      if (!hit.fixture || hit.fixture->GetBody() == candidates_[i].body) {
+        detections_.detections.push_back(candidates_[i].detection);
+        break;
+      }
+    }
+  }
+
+  // the noise generator is not thread safe, add the noise in one bulk call
+  if (noise_std_dev_ > 0) {
+    noisy_xy_.clear();
+    for (const auto &d : detections_.detections) {
+      noisy_xy_.push_back(d.pose.x);
+      noisy_xy_.push_back(d.pose.y);
+    }
+    noise_.Add(noisy_xy_.data(), noisy_xy_.size());
+    for (size_t i = 0; i < detections_.detections.size(); i++) {
+      detections_.detections[i].pose.x = noisy_xy_[2 * i];
+      detections_.detections[i].pose.y = noisy_xy_[2 * i + 1];
+    }
+  }
+
+  for (auto &d : detections_.detections) {
+    d.range = hypot(d.pose.x, d.pose.y);
+    d.bearing = atan2(d.pose.y, d.pose.x);
+  }
+  std::sort(detections_.detections.begin(), detections_.detections.end(),
+            [](const flatland_msgs::FiducialDetection &a,
+               const flatland_msgs::FiducialDetection &b) {
+              return a.range < b.range;
+            });
+}
+
+int32_t FiducialDetector::ParseId(const std::string &name) {
+  size_t start = name.size();
+  while (start > 0 && std::isdigit(name[start - 1])) {
+    start--;
+  }
+  if (start == name.size() || name.size() - start > 9) {
+    return -1;
+  }
+  return std::stoi(name.substr(start));
+}
+
+void FiducialDetector::ParseParameters(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string body_name = reader.Get<std::string>("body");
+  topic_ = reader.Get<std::string>("topic", "detections");
+  frame_id_ = reader.Get<std::string>("frame", GetName());
+  broadcast_tf_ = reader.Get<bool>("broadcast_tf", true);
+  update_rate_ = reader.Get<double>("update_rate",
+                                    std::numeric_limits<double>::infinity());
+  origin_ = reader.GetPose("origin", Pose(0, 0, 0));
+  range_ = reader.Get<double>("range");
+  int los_rays = reader.Get<int>("los_rays", 3);
+  noise_std_dev_ = reader.Get<double>("noise_std_dev", 0);
+  int noise_seed = reader.Get<int>("noise_seed", -1);
+
+  std::vector<std::string> fiducial_layers =
+      reader.GetList<std::string>("fiducial_layers", {"all"}, -1, -1);
+  std::vector<std::string> layers =
+      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+
+  min_angle_ = -M_PI;
+  max_angle_ = M_PI;
+  YamlReader angle_reader = reader.SubnodeOpt("angle", YamlReader::MAP);
+  if (!angle_reader.IsNodeNull()) {
+    min_angle_ = angle_reader.Get<double>("min");
+    max_angle_ = angle_reader.Get<double>("max");
+    angle_reader.EnsureAccessedAllKeys();
+  }
+  reader.EnsureAccessedAllKeys();
+
+  if (max_angle_ < min_angle_ || min_angle_ < -M_PI || max_angle_ > M_PI) {
+    throw YAMLException(
+        "Invalid \"angle\" params, must have -pi <= min <= max <= pi");
+  }
+
+  if (los_rays < 1) {
+    throw YAMLException("Invalid \"los_rays\" param, must be at least 1");
+  }
+  los_rays_ = los_rays;
+
+  body_ = GetModel()->GetBody(body_name);
+  if (!body_) {
+    throw YAMLException("Cannot find body with name " + body_name);
+  }
+
+  std::vector<std::string> invalid_layers;
+  fiducial_layers_bits_ =
+      GetModel()->GetCfr()->GetCategoryBits(fiducial_layers, &invalid_layers);
+  layers_bits_ = GetModel()->GetCfr()->GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw YAMLException("Cannot find layer(s): {" +
+                        boost::algorithm::join(invalid_layers, ",") + "}");
+  }
+
+  // init the noise generator, a negative seed picks a random one, which is
+  // recorded and replayed by the Recorder
+  if (noise_seed < 0) {
+    noise_seed = RandomSeed() & 0x7fffffff;
+  }
+  noise_ = GaussianNoise(noise_std_dev_, noise_seed);
+
+  ROS_DEBUG_NAMED("FiducialDetector",
+                  "FiducialDetector %s params: topic(%s) body(%s, %p) "
+                  "origin(%f,%f,%f) frame_id(%s) broadcast_tf(%d) "
+                  "update_rate(%f) range(%f) angle(%f,%f) los_rays(%u) "
+                  "noise_std_dev(%f)",
+                  GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
+                  origin_.x, origin_.y, origin_.theta, frame_id_.c_str(),
+                  broadcast_tf_, update_rate_, range_, min_angle_, max_angle_,
+                  los_rays_, noise_std_dev_);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::FiducialDetector,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::FiducialDetector,
+                         flatland_server::ModelPlugin)
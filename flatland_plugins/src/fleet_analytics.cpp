@@ -0,0 +1,414 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fleet_analytics.cpp
+ * @brief	 Computes aggregates of the fleet online
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/fleet_analytics.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+namespace {
+
+/**
+ * @return The key of the pair of two model ids, in either order
+ */
+uint64_t PairKey(uint32_t a, uint32_t b) {
+  if (a > b) std::swap(a, b);
+  return uint64_t(a) << 32 | b;
+}
+
+/**
+ * @return The model owning a fixture, nullptr for layers and other entities
+ */
+const Model *FixtureModel(const b2Fixture *fixture) {
+  const Body *body =
+      static_cast<const Body *>(fixture->GetBody()->GetUserData());
+  return body ? dynamic_cast<const Model *>(body->entity_) : nullptr;
+}
+}
+
+void FleetAnalytics::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string topic = reader.Get<std::string>("topic", "fleet_analytics");
+  double update_rate = reader.Get<double>("update_rate", 1.0);
+  double sample_rate = reader.Get<double>("sample_rate", 10.0);
+  near_miss_distance_ = reader.Get<double>("near_miss_distance", 0.5);
+
+  YamlReader heatmap_reader = reader.SubnodeOpt("heatmap", YamlReader::MAP);
+  std::array<double, 4> area;
+  double resolution = 0;
+  if (!heatmap_reader.IsNodeNull()) {
+    heatmap_ = true;
+    area = heatmap_reader.GetArray<double, 4>("area");
+    resolution = heatmap_reader.Get<double>("resolution", 0.5);
+    half_life_ = heatmap_reader.Get<double>("half_life", 60.0);
+    heatmap_reader.EnsureAccessedAllKeys();
+  }
+
+  YamlReader regions_reader = reader.SubnodeOpt("regions", YamlReader::LIST);
+  regions_.clear();
+  int num_regions =
+      regions_reader.IsNodeNull() ? 0 : regions_reader.NodeSize();
+  for (int i = 0; i < num_regions; i++) {
+    YamlReader region_reader = regions_reader.Subnode(i, YamlReader::MAP);
+    Region region;
+    region.name = region_reader.Get<std::string>("name");
+    std::array<double, 4> r = region_reader.GetArray<double, 4>("area");
+    region_reader.EnsureAccessedAllKeys();
+    if (r[2] <= r[0] || r[3] <= r[1]) {
+      throw YAMLException("Invalid \"area\" of region " + Q(region.name) +
+                          ", must be [min_x, min_y, max_x, max_y]");
+    }
+    region.area.lowerBound.Set(r[0], r[1]);
+    region.area.upperBound.Set(r[2], r[3]);
+    regions_.push_back(region);
+  }
+  reader.EnsureAccessedAllKeys();
+
+  if (!(update_rate > 0) || !(sample_rate >= update_rate)) {
+    throw YAMLException(
+        "Invalid \"update_rate\" or \"sample_rate\" params, must have "
+        "sample_rate >= update_rate > 0");
+  }
+  if (!(near_miss_distance_ > 0)) {
+    throw YAMLException(
+        "Invalid \"near_miss_distance\" param, must be positive");
+  }
+  publish_period_ = 1.0 / update_rate;
+  sample_period_ = 1.0 / sample_rate;
+
+  if (heatmap_) {
+    if (area[2] <= area[0] || area[3] <= area[1] || !(resolution > 0) ||
+        half_life_ < 0) {
+      throw YAMLException(
+          "Invalid \"heatmap\" params, must have an area [min_x, min_y, "
+          "max_x, max_y], resolution > 0 and half_life >= 0");
+    }
+    nav_msgs::MapMetaData &info = heatmap_msg_.info;
+    info.resolution = resolution;
+    info.width = std::ceil((area[2] - area[0]) / resolution);
+    info.height = std::ceil((area[3] - area[1]) / resolution);
+    info.origin.position.x = area[0];
+    info.origin.position.y = area[1];
+    info.origin.orientation.w = 1;
+    heatmap_msg_.header.frame_id = "map";
+    heatmap_msg_.data.resize(info.width * info.height);
+    heat_.assign(info.width * info.height, 0);
+    heatmap_publisher_ =
+        nh_.advertise<nav_msgs::OccupancyGrid>(topic + "/heatmap", 1);
+  }
+
+  msg_.regions.resize(regions_.size());
+  for (size_t i = 0; i < regions_.size(); i++) {
+    msg_.regions[i].name = regions_[i].name;
+  }
+  publisher_ = nh_.advertise<flatland_msgs::FleetAnalytics>(topic, 1);
+
+  ROS_DEBUG_NAMED("FleetAnalytics",
+                  "Initialized with params: topic(%s) update_rate(%f) "
+                  "sample_rate(%f) near_miss_distance(%f) heatmap(%d) "
+                  "regions(%lu)",
+                  topic.c_str(), update_rate, sample_rate,
+                  near_miss_distance_, heatmap_,
+                  (unsigned long)regions_.size());
+}
+
+void FleetAnalytics::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  double time = timekeeper.GetSimTime().toSec();
+  if (last_sample_time_ < 0) {
+    last_sample_time_ = time;
+    period_start_ = time;
+    next_publish_time_ = time + publish_period_ - 1e-9;
+  }
+
+  bool publish = time >= next_publish_time_;
+  if (time >= next_sample_time_ || publish) {
+    next_sample_time_ = time + sample_period_ - 1e-9;
+    Sample(time - last_sample_time_);
+    last_sample_time_ = time;
+  }
+  if (publish) {
+    next_publish_time_ = time + publish_period_ - 1e-9;
+    Publish(timekeeper);
+  }
+}
+
+void FleetAnalytics::Sample(double dt) {
+  const BodyStates *states = GetBodyStates();
+  if (!states) {
+    return;
+  }
+
+  // the first body of each model stands for the model, read from the arrays
+  // of the states instead of Box2D
+  ids_.clear();
+  x_.clear();
+  y_.clear();
+  for (const Model *model : world_->models_) {
+    if (model->bodies_.empty()) {
+      continue;
+    }
+    const ModelBody *body = model->bodies_[0];
+    int i = body->state_index_;
+    if (i < 0 || body->physics_body_->GetType() == b2_staticBody) {
+      continue;
+    }
+    ids_.push_back(model->id_);
+    x_.push_back(states->x_[i]);
+    y_.push_back(states->y_[i]);
+    speed_sum_ += std::hypot(states->vx_[i], states->vy_[i]);
+    speed_count_++;
+  }
+
+  // the heat added grows instead of all the cells decaying, the cells are
+  // rescaled once in a while to stay within the float range
+  if (heatmap_ && dt > 0) {
+    if (half_life_ > 0) {
+      heat_weight_ *= std::exp2(dt / half_life_);
+    }
+    const nav_msgs::MapMetaData &info = heatmap_msg_.info;
+    float heat = heat_weight_ * dt;
+    for (size_t i = 0; i < ids_.size(); i++) {
+      int cx = std::floor((x_[i] - info.origin.position.x) / info.resolution);
+      int cy = std::floor((y_[i] - info.origin.position.y) / info.resolution);
+      if (cx >= 0 && cy >= 0 && cx < int(info.width) &&
+          cy < int(info.height)) {
+        heat_[cy * info.width + cx] += heat;
+      }
+    }
+    if (heat_weight_ > 1e6) {
+      for (float &h : heat_) {
+        h /= heat_weight_;
+      }
+      heat_weight_ = 1;
+    }
+  }
+
+  for (Region &region : regions_) {
+    inside_.clear();
+    for (size_t i = 0; i < ids_.size(); i++) {
+      if (x_[i] >= region.area.lowerBound.x &&
+          y_[i] >= region.area.lowerBound.y &&
+          x_[i] <= region.area.upperBound.x &&
+          y_[i] <= region.area.upperBound.y) {
+        inside_.push_back(ids_[i]);
+      }
+    }
+    std::sort(inside_.begin(), inside_.end());
+    region.dwell_time += dt * inside_.size();
+    if (!inside_.empty()) {
+      region.occupied_time += dt;
+    }
+    std::vector<uint32_t>::const_iterator it = region.inside.begin();
+    for (uint32_t id : inside_) {
+      while (it != region.inside.end() && *it < id) it++;
+      if (it == region.inside.end() || *it != id) region.entries++;
+    }
+    region.inside.swap(inside_);
+  }
+
+  FindNearMisses();
+  FindCollisions();
+}
+
+void FleetAnalytics::FindNearMisses() {
+  size_t count = ids_.size();
+  unsigned int buckets = 1;
+  while (buckets < 2 * count) {
+    buckets *= 2;
+  }
+  cell_start_.resize(buckets + 1);
+  cell_models_.resize(count);
+  model_cell_.resize(count);
+  bucket_mask_ = buckets - 1;
+
+  // a counting sort of the models by bucket, as in Crowd
+  std::fill(cell_start_.begin(), cell_start_.end(), 0);
+  for (size_t i = 0; i < count; i++) {
+    int cx = std::floor(x_[i] / near_miss_distance_);
+    int cy = std::floor(y_[i] / near_miss_distance_);
+    model_cell_[i] = CellBucket(cx, cy);
+    cell_start_[model_cell_[i]]++;
+  }
+  for (size_t b = 1; b < cell_start_.size(); b++) {
+    cell_start_[b] += cell_start_[b - 1];
+  }
+  for (size_t i = count; i-- > 0;) {
+    cell_models_[--cell_start_[model_cell_[i]]] = i;
+  }
+
+  // the pairs within the distance, in the 3x3 cells around each model,
+  // distinct cells may share a bucket, which is visited once
+  float range2 = near_miss_distance_ * near_miss_distance_;
+  pairs_.clear();
+  for (size_t i = 0; i < count; i++) {
+    int cx = std::floor(x_[i] / near_miss_distance_);
+    int cy = std::floor(y_[i] / near_miss_distance_);
+    uint32_t visited[9];
+    int num_visited = 0;
+    for (int ox = -1; ox <= 1; ox++) {
+      for (int oy = -1; oy <= 1; oy++) {
+        uint32_t b = CellBucket(cx + ox, cy + oy);
+        if (std::find(visited, visited + num_visited, b) !=
+            visited + num_visited) {
+          continue;
+        }
+        visited[num_visited++] = b;
+
+        for (uint32_t k = cell_start_[b]; k < cell_start_[b + 1]; k++) {
+          uint32_t j = cell_models_[k];
+          float dx = x_[i] - x_[j], dy = y_[i] - y_[j];
+          if (j > i && dx * dx + dy * dy < range2) {
+            pairs_.push_back(PairKey(ids_[i], ids_[j]));
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t near_misses = CountNewPairs(&close_pairs_);
+  near_misses_ += near_misses;
+  near_misses_total_ += near_misses;
+}
+
+void FleetAnalytics::FindCollisions() {
+  pairs_.clear();
+  for (b2Contact *c = world_->physics_world_->GetContactList(); c;
+       c = c->GetNext()) {
+    if (!c->IsTouching() || !c->IsEnabled() || c->GetFixtureA()->IsSensor() ||
+        c->GetFixtureB()->IsSensor()) {
+      continue;
+    }
+    const Model *a = FixtureModel(c->GetFixtureA());
+    const Model *b = FixtureModel(c->GetFixtureB());
+    if (a && b && a != b) {
+      pairs_.push_back(PairKey(a->id_, b->id_));
+    }
+  }
+
+  uint32_t collisions = CountNewPairs(&touching_pairs_);
+  collisions_ += collisions;
+  collisions_total_ += collisions;
+}
+
+uint32_t FleetAnalytics::CountNewPairs(std::vector<uint64_t> *previous) {
+  std::sort(pairs_.begin(), pairs_.end());
+  pairs_.erase(std::unique(pairs_.begin(), pairs_.end()), pairs_.end());
+
+  uint32_t count = 0;
+  std::vector<uint64_t>::const_iterator it = previous->begin();
+  for (uint64_t pair : pairs_) {
+    while (it != previous->end() && *it < pair) it++;
+    if (it == previous->end() || *it != pair) count++;
+  }
+  previous->swap(pairs_);
+  return count;
+}
+
+void FleetAnalytics::Publish(const Timekeeper &timekeeper) {
+  double time = timekeeper.GetSimTime().toSec();
+  double period = time - period_start_;
+  period_start_ = time;
+
+  msg_.header.stamp = timekeeper.GetSimTime();
+  msg_.period = period;
+  msg_.models = ids_.size();
+  msg_.near_misses = near_misses_;
+  msg_.collisions = collisions_;
+  msg_.near_misses_total = near_misses_total_;
+  msg_.collisions_total = collisions_total_;
+  msg_.mean_speed = speed_count_ > 0 ? speed_sum_ / speed_count_ : 0;
+  for (size_t i = 0; i < regions_.size(); i++) {
+    Region &region = regions_[i];
+    flatland_msgs::RegionUsage &usage = msg_.regions[i];
+    usage.dwell_time = region.dwell_time;
+    usage.utilization = period > 0 ? region.occupied_time / period : 0;
+    usage.entries = region.entries;
+    usage.occupants = region.inside.size();
+    region.dwell_time = 0;
+    region.occupied_time = 0;
+    region.entries = 0;
+  }
+  near_misses_ = 0;
+  collisions_ = 0;
+  speed_sum_ = 0;
+  speed_count_ = 0;
+  PublishCounted(publisher_, msg_);
+
+  // the cells are scaled to the hottest one, 0 to 100
+  if (heatmap_ && heatmap_publisher_.getNumSubscribers() > 0) {
+    float max_heat = *std::max_element(heat_.begin(), heat_.end());
+    for (size_t i = 0; i < heat_.size(); i++) {
+      heatmap_msg_.data[i] =
+          max_heat > 0 ? int8_t(std::lround(100 * heat_[i] / max_heat)) : 0;
+    }
+    heatmap_msg_.header.stamp = timekeeper.GetSimTime();
+    heatmap_msg_.info.map_load_time = timekeeper.GetSimTime();
+    PublishCounted(heatmap_publisher_, heatmap_msg_);
+  }
+}
+
+uint32_t FleetAnalytics::CellBucket(int cx, int cy) const {
+  uint32_t h = uint32_t(cx) * 73856093u ^ uint32_t(cy) * 19349663u;
+  return h & bucket_mask_;
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::FleetAnalytics,
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::FleetAnalytics,
+                         flatland_server::WorldPlugin)
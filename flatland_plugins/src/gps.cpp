@@ -1,89 +1,63 @@
 #include <flatland_plugins/gps.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/tf_aggregator.h>
 #include <pluginlib/class_list_macros.h>
 
 using namespace flatland_server;
 
 namespace flatland_plugins {
 
-double Gps::WGS84_A = 6378137.0;
-double Gps::WGS84_E2 = 0.0066943799831668;
+Gps::~Gps() {
+  if (GetGpsBatch()) {
+    GetGpsBatch()->Remove(batch_id_);
+  }
+}
 
 void Gps::OnInitialize(const YAML::Node &config) {
   ParseParameters(config);
-  update_timer_.SetRate(update_rate_);
+  SetUpdateRate(update_rate_);
   fix_publisher_ = nh_.advertise<sensor_msgs::NavSatFix>(topic_, 1);
 
-  double c = cos(origin_.theta);
-  double s = sin(origin_.theta);
-  double x = origin_.x, y = origin_.y;
-  m_body_to_gps_ << c, -s, x, s, c, y, 0, 0, 1;
+  // the receivers of the world are converted together
+  if (GetGpsBatch()) {
+    batch_id_ = GetGpsBatch()->Add(body_, b2Vec2(origin_.x, origin_.y),
+                                   reference_);
+  }
 }
 
 void Gps::BeforePhysicsStep(const Timekeeper &timekeeper) {
-  // keep the update rate
-  if (!update_timer_.CheckUpdate(timekeeper)) {
-    return;
-  }
-
   // only compute and publish when the number of subscribers is not zero
-  if (fix_publisher_.getNumSubscribers() > 0) {
-    UpdateFix();
-    gps_fix_.header.stamp = timekeeper.GetSimTime();
-    fix_publisher_.publish(gps_fix_);
-  }
+  PublishLazily(fix_publisher_, gps_fix_,
+                [&](sensor_msgs::NavSatFix &fix) {
+                  UpdateFix();
+                  fix.header.stamp = timekeeper.GetSimTime();
+                });
 
-  if (broadcast_tf_) {
+  if (broadcast_tf_ && !TfAggregator::IsEnabled()) {
     gps_tf_.header.stamp = timekeeper.GetSimTime();
     tf_broadcaster_.sendTransform(gps_tf_);
   }
 }
 
 void Gps::ComputeReferenceEcef() {
-  double s_lat = sin(ref_lat_rad_);
-  double c_lat = cos(ref_lat_rad_);
-  double s_lon = sin(ref_lon_rad_);
-  double c_lon = cos(ref_lon_rad_);
-
-  double n = WGS84_A / sqrt(1.0 - WGS84_E2 * s_lat * s_lat);
-
-  ref_ecef_x_ = n * c_lat * c_lon;
-  ref_ecef_y_ = n * c_lat * s_lon;
-  ref_ecef_z_ = n * (1.0 - WGS84_E2) * s_lat;
+  reference_ = GpsReference(ref_lat_rad_, ref_lon_rad_);
 }
 
 void Gps::UpdateFix() {
-  const b2Transform &t = body_->GetPhysicsBody()->GetTransform();
-  Eigen::Matrix3f m_world_to_body;
-  m_world_to_body << t.q.c, -t.q.s, t.p.x, t.q.s, t.q.c, t.p.y, 0, 0, 1;
-  Eigen::Matrix3f m_world_to_gps = m_world_to_body * m_body_to_gps_;
-  b2Vec2 gps_pos(m_world_to_gps(0, 2), m_world_to_gps(1, 2));
-
-  /* Convert simulation position into ECEF coordinates */
-  double s_lat = sin(ref_lat_rad_);
-  double c_lat = cos(ref_lat_rad_);
-  double s_lon = sin(ref_lon_rad_);
-  double c_lon = cos(ref_lon_rad_);
-
-  double ecef_x = ref_ecef_x_ - s_lon * gps_pos.x - s_lat * c_lon * gps_pos.y;
-  double ecef_y = ref_ecef_y_ + c_lon * gps_pos.x - s_lat * s_lon * gps_pos.y;
-  double ecef_z = ref_ecef_z_ + c_lat * gps_pos.y;
-
-  /* Convert ECEF to lat/lon */
-  // Longitude is easy
-  gps_fix_.longitude = atan2(ecef_y, ecef_x) * 180.0 * M_1_PI;
-
-  // Iterative solution for latitude
-  double r;
-  double alt;
-  double p = sqrt(ecef_x * ecef_x + ecef_y * ecef_y);
-  double lat_rad = atan(p / ecef_z);
-  for (unsigned int i = 0; i < 4; i++) {
-    double s_lat = sin(lat_rad);
-    r = WGS84_A / sqrt(1.0 - WGS84_E2 * s_lat * s_lat);
-    alt = p / cos(lat_rad) - r;
-    lat_rad = atan(ecef_z / p / (1 - WGS84_E2 * r / (r + alt)));
+  GpsBatch::Fix fix;
+  if (batch_id_ >= 0) {
+    fix = GetGpsBatch()->Get(batch_id_);
+  } else {
+    // the pose as of the last physics step, see BodyStates
+    const b2Transform t = GetBodyStates()
+                              ? GetBodyStates()->GetTransform(body_)
+                              : body_->GetPhysicsBody()->GetTransform();
+    b2Vec2 gps_pos = b2Mul(t, b2Vec2(origin_.x, origin_.y));
+    double x = gps_pos.x, y = gps_pos.y;
+    GpsBatch::Convert(1, &x, &y, &reference_, &fix.latitude, &fix.longitude);
   }
-  gps_fix_.latitude = lat_rad * 180.0 * M_1_PI;
+  gps_fix_.latitude = fix.latitude;
+  gps_fix_.longitude = fix.longitude;
   gps_fix_.altitude = 0.0;
 }
 
@@ -122,7 +96,14 @@ void Gps::ParseParameters(const YAML::Node &config) {
   gps_tf_.transform.rotation.y = 0.0;
   gps_tf_.transform.rotation.z = sin(0.5 * origin_.theta);
   gps_tf_.transform.rotation.w = cos(0.5 * origin_.theta);
+
+  // the mount never moves, it is published once with the aggregator
+  if (broadcast_tf_ && TfAggregator::IsEnabled()) {
+    gps_tf_.header.stamp = ros::Time::now();
+    TfAggregator::Get().SendStatic(gps_tf_);
+  }
 }
 }
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::Gps, flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::Gps, flatland_server::ModelPlugin)
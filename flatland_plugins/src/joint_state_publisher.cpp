@@ -0,0 +1,158 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 joint_state_publisher.cpp
+ * @brief	 Publish the states of the joints of a model
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/joint_state_publisher.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/odometry_aggregator.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void JointStatePublisher::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  topic_ = reader.Get<std::string>("topic", "joint_states");
+  update_rate_ = reader.Get<double>("update_rate",
+                                    std::numeric_limits<double>::infinity());
+  std::vector<std::string> joint_names =
+      reader.GetList<std::string>("joints", {}, -1, -1);
+  reader.EnsureAccessedAllKeys();
+
+  // defaults to all the joints of the model, in the order of the model file
+  if (joint_names.empty()) {
+    joints_ = GetModel()->GetJoints();
+  }
+  for (const std::string &name : joint_names) {
+    Joint *joint = GetModel()->GetJoint(name);
+    if (joint == nullptr) {
+      throw YAMLException("Joint with name \"" + name + "\" does not exist");
+    }
+    joints_.push_back(joint);
+  }
+
+  // the names and the sizes of the arrays never change
+  for (Joint *joint : joints_) {
+    joint_state_.name.push_back(joint->GetName());
+  }
+  joint_state_.position.resize(joints_.size());
+  joint_state_.velocity.resize(joints_.size());
+  joint_state_.effort.resize(joints_.size());
+  if (OdometryAggregator::IsEnabled()) {
+    // the robots of a fleet are told apart by their namespaces
+    model_joint_states_.model = GetModel()->GetNameSpace().empty()
+                                    ? GetModel()->GetName()
+                                    : GetModel()->GetNameSpace();
+    model_joint_states_.name = joint_state_.name;
+    model_joint_states_.position.resize(joints_.size());
+    model_joint_states_.velocity.resize(joints_.size());
+    model_joint_states_.effort.resize(joints_.size());
+  }
+
+  SetUpdateRate(update_rate_);
+  publisher_ = nh_.advertise<sensor_msgs::JointState>(topic_, 1);
+
+  ROS_DEBUG_NAMED("JointStatePublisher",
+                  "Initialized with params: topic(%s) update_rate(%f) "
+                  "joints(%lu)",
+                  topic_.c_str(), update_rate_, joints_.size());
+}
+
+void JointStatePublisher::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  bool aggregate = OdometryAggregator::IsEnabled();
+  if (!aggregate && !IsSubscribed(publisher_)) {
+    return;
+  }
+
+  double step_size = timekeeper.GetStepSize();
+  double inv_dt = step_size > 0 ? 1.0 / step_size : 0;
+  for (size_t i = 0; i < joints_.size(); i++) {
+    ReadJoint(joints_[i]->GetPhysicsJoint(), inv_dt, &joint_state_.position[i],
+              &joint_state_.velocity[i], &joint_state_.effort[i]);
+  }
+  joint_state_.header.stamp = timekeeper.GetSimTime();
+
+  if (aggregate) {
+    model_joint_states_.position = joint_state_.position;
+    model_joint_states_.velocity = joint_state_.velocity;
+    model_joint_states_.effort = joint_state_.effort;
+    OdometryAggregator::Get().Send(model_joint_states_);
+  }
+  PublishLazily(publisher_, joint_state_);
+}
+
+void JointStatePublisher::ReadJoint(b2Joint *joint, double inv_dt,
+                                    double *position, double *velocity,
+                                    double *effort) {
+  float32 t = float32(inv_dt);
+  if (joint->GetType() == e_revoluteJoint) {
+    b2RevoluteJoint *revolute = static_cast<b2RevoluteJoint *>(joint);
+    *position = revolute->GetJointAngle();
+    *velocity = revolute->GetJointSpeed();
+    // the torque of the limits and of the motor
+    *effort = revolute->GetReactionTorque(t) + revolute->GetMotorTorque(t);
+    return;
+  }
+
+  b2Body *a = joint->GetBodyA();
+  b2Body *b = joint->GetBodyB();
+  double reference = 0;
+  if (joint->GetType() == e_weldJoint) {
+    reference = static_cast<b2WeldJoint *>(joint)->GetReferenceAngle();
+  }
+  *position = b->GetAngle() - a->GetAngle() - reference;
+  *velocity = b->GetAngularVelocity() - a->GetAngularVelocity();
+  *effort = joint->GetReactionTorque(t);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::JointStatePublisher,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::JointStatePublisher,
+                         flatland_server::ModelPlugin)
@@ -44,14 +44,24 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_plugins/compact_scan.h>
 #include <flatland_plugins/laser.h>
 #include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
 #include <flatland_server/exceptions.h>
+#include <flatland_server/geometry.h>
+#include <flatland_server/layer.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/tf_aggregator.h>
+#include <flatland_server/tracer.h>
 #include <flatland_server/yaml_reader.h>
 #include <geometry_msgs/TransformStamped.h>
 #include <pluginlib/class_list_macros.h>
 #include <boost/algorithm/string/join.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
@@ -59,46 +69,92 @@ using namespace flatland_server;
 
 namespace flatland_plugins {
 
+namespace {
+
+/**
+ * Collects the fixtures of the models a laser detects overlapping an AABB,
+ * the layers are skipped. A fixture with several children is reported once
+ * per child
+ */
+class ModelFixtureCollector : public b2QueryCallback {
+ public:
+  uint32_t layers_bits;
+  std::vector<Laser::ModelFixture> *fixtures;
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        !(fixture->GetFilterData().categoryBits & layers_bits)) {
+      return true;
+    }
+    b2Body *b = fixture->GetBody();
+    Body *body = static_cast<Body *>(b->GetUserData());
+    if (body && body->GetEntity()->Type() == Entity::EntityType::LAYER) {
+      return true;
+    }
+    fixtures->push_back(
+        {fixture, b->GetTransform(), fixture->GetFilterData().categoryBits});
+    return true;
+  }
+};
+};  // namespace
+
 void Laser::OnInitialize(const YAML::Node &config) {
   ParseParameters(config);
 
-  update_timer_.SetRate(update_rate_);
-  scan_publisher_ = nh_.advertise<sensor_msgs::LaserScan>(topic_, 1);
+  // the fixtures hit by the Box2D packet ray casts, the static layers are
+  // raycasted on their own data
+  ray_filter_.maskBits = layers_bits_;
+  FindStaticLayers();
 
-  // construct the body to laser transformation matrix once since it never
-  // changes
-  double c = cos(origin_.theta);
-  double s = sin(origin_.theta);
-  double x = origin_.x, y = origin_.y;
-  m_body_to_laser_ << c, -s, x, s, c, y, 0, 0, 1;
+  // in sweep mode the laser is updated on every step to cast its slice
+  if (sweep_) {
+    scan_period_ = 1.0 / update_rate_;
+  } else {
+    SetUpdateRate(update_rate_);
+  }
+  scan_publisher_ = nh_.advertise<sensor_msgs::LaserScan>(topic_, 1);
+  for (unsigned int k = 1; k < echoes_; k++) {
+    echo_publishers_.push_back(nh_.advertise<sensor_msgs::LaserScan>(
+        topic_ + "_echo" + std::to_string(k + 1), 1));
+  }
+  if (compact_resolution_ > 0) {
+    compact_publisher_ =
+        nh_.advertise<flatland_msgs::CompactScan>(topic_ + "_compact", 1);
+  }
 
   unsigned int num_laser_points =
       std::lround((max_angle_ - min_angle_) / increment_) + 1;
 
-  // initialize size for the matrix storing the laser points
-  m_laser_points_ = Eigen::MatrixXf(3, num_laser_points);
-  m_world_laser_points_ = Eigen::MatrixXf(3, num_laser_points);
-  v_zero_point_ << 0, 0, 1;
-
-  // pre-calculate the laser points w.r.t to the laser frame, since this never
-  // changes
+  // pre-calculate the end points of the rays in the body frame, since they
+  // never change. There is one point per sub ray, spread evenly across the
+  // beam width, beam i uses [i * rays, (i + 1) * rays)
+  unsigned int rays = divergence_rays_;
+  double c = cos(origin_.theta), s = sin(origin_.theta);
+  body_points_x_.resize(num_laser_points * rays);
+  body_points_y_.resize(num_laser_points * rays);
+  world_points_x_.resize(num_laser_points * rays);
+  world_points_y_.resize(num_laser_points * rays);
   for (unsigned int i = 0; i < num_laser_points; i++) {
-    float angle = min_angle_ + i * increment_;
-
-    float x = range_ * cos(angle);
-    float y = range_ * sin(angle);
+    for (unsigned int j = 0; j < rays; j++) {
+      double angle = min_angle_ + i * increment_;
+      if (rays > 1) {
+        angle += divergence_ * (double(j) / (rays - 1) - 0.5);
+      }
 
-    m_laser_points_(0, i) = x;
-    m_laser_points_(1, i) = y;
-    m_laser_points_(2, i) = 1;
+      // in the laser frame, then in the body frame
+      double x = range_ * cos(angle);
+      double y = range_ * sin(angle);
+      body_points_x_[i * rays + j] = c * x - s * y + origin_.x;
+      body_points_y_[i * rays + j] = s * x + c * y + origin_.y;
+    }
   }
 
   // initialize constants in the laser scan message
   laser_scan_.angle_min = min_angle_;
   laser_scan_.angle_max = max_angle_;
   laser_scan_.angle_increment = increment_;
-  laser_scan_.time_increment = 0;
-  laser_scan_.scan_time = 0;
+  laser_scan_.time_increment = sweep_ ? scan_period_ / num_laser_points : 0;
+  laser_scan_.scan_time = sweep_ ? scan_period_ : 0;
   laser_scan_.range_min = 0;
   laser_scan_.range_max = range_;
   laser_scan_.ranges.resize(num_laser_points);
@@ -109,6 +165,22 @@ void Laser::OnInitialize(const YAML::Node &config) {
   laser_scan_.header.seq = 0;
   laser_scan_.header.frame_id =
       tf::resolve("", GetModel()->NameSpaceTF(frame_id_));
+  echo_scans_.assign(echoes_ - 1, laser_scan_);
+
+  // the latest ranges are also exported to shared memory, if enabled
+  if (GetStateExporter()) {
+    export_id_ = GetStateExporter()->AddScan(
+        GetModel()->GetName() + "/" + GetName(), laser_scan_.ranges.size());
+  }
+
+  // the pools are filled with copies of the scans, so all the messages have
+  // their vectors allocated to the right size once
+  scan_pools_.resize(message_pool_ > 0 ? echoes_ : 0);
+  for (auto &pool : scan_pools_) {
+    for (unsigned int j = 0; j < message_pool_; j++) {
+      pool.push_back(boost::make_shared<sensor_msgs::LaserScan>(laser_scan_));
+    }
+  }
 
   // Broadcast transform between the body and laser
   tf::Quaternion q;
@@ -125,126 +197,929 @@ void Laser::OnInitialize(const YAML::Node &config) {
   laser_tf_.transform.rotation.y = q.y();
   laser_tf_.transform.rotation.z = q.z();
   laser_tf_.transform.rotation.w = q.w();
+
+  // the mount never moves, it is published once with the aggregator
+  if (broadcast_tf_ && TfAggregator::IsEnabled()) {
+    laser_tf_.header.stamp = ros::Time::now();
+    TfAggregator::Get().SendStatic(laser_tf_);
+  }
 }
 
 void Laser::BeforePhysicsStep(const Timekeeper &timekeeper) {
-  // keep the update rate
-  if (!update_timer_.CheckUpdate(timekeeper)) {
+  // the grids and segments are replaced when a layer is reloaded, the
+  // cached scan may see the old geometry
+  if (layer_generation_ != Layer::GetGeometryGeneration()) {
+    FindStaticLayers();
+    cache_valid_ = false;
+  }
+
+  if (sweep_) {
+    // the mount is broadcast with each scan instead of on every step
+    if (SweepStep(timekeeper) && broadcast_tf_ && !TfAggregator::IsEnabled()) {
+      laser_tf_.header.stamp = timekeeper.GetSimTime();
+      tf_broadcaster_.sendTransform(laser_tf_);
+    }
     return;
   }
 
   // only compute and publish when the number of subscribers is not zero
-  if (scan_publisher_.getNumSubscribers() > 0) {
-    ComputeLaserRanges();
-    laser_scan_.header.stamp = timekeeper.GetSimTime();
-    scan_publisher_.publish(laser_scan_);
+  if (HasSubscribers()) {
+    ros::Time stamp = timekeeper.GetSimTime();
+
+    if (world_batch_ && GetSensorScheduler()) {
+      // the rays are cast together with all other sensors due on this step
+      // once all plugins have been called
+      if (PrepareScan()) {
+        SensorScheduler::Job job;
+        job.count = laser_scan_.ranges.size();
+        job.cast = [this](unsigned int begin, unsigned int end) {
+          CastBeams(begin, end);
+        };
+        job.done = [this, stamp] {
+          FinishScan();
+          PublishScan(stamp);
+        };
+        // the GPU only returns the nearest hit of each beam, and does not
+        // know the cached layer hits
+        if (!multi_echo_ && !static_cache_) {
+          job.rays = [this](GpuRaycaster::Ray *rays) { WriteRays(rays); };
+          job.hits = [this](const GpuRaycaster::Hit *hits) { ReadHits(hits); };
+        }
+        GetSensorScheduler()->Submit(job);
+      } else {
+        PublishScan(stamp);
+      }
+    } else {
+      ComputeLaserRanges();
+      PublishScan(stamp);
+    }
   }
 
-  if (broadcast_tf_) {
+  if (broadcast_tf_ && !TfAggregator::IsEnabled()) {
     laser_tf_.header.stamp = timekeeper.GetSimTime();
     tf_broadcaster_.sendTransform(laser_tf_);
   }
 }
 
+bool Laser::SweepStep(const Timekeeper &timekeeper) {
+  double now = timekeeper.GetSimTime().toSec();
+  unsigned int count = laser_scan_.ranges.size();
+
+  // the subscribers are checked once per sweep, the time going back, e.g. on
+  // a reset, restarts the sweep
+  if (!sweeping_ || now < sweep_start_) {
+    sweeping_ = true;
+    sweep_start_ = now;
+    sweep_beam_ = 0;
+    sweep_subscribed_ = HasSubscribers();
+  }
+
+  // beam i is due at sweep_start_ + i * time_increment, and cast on the step
+  // whose time is closest
+  double due = now + timekeeper.GetMaxStepSize() / 2.0 - sweep_start_;
+  unsigned int end = count;
+  if (due < scan_period_) {
+    end = std::min<unsigned int>(
+        count, std::ceil(due / laser_scan_.time_increment - 1e-9));
+  }
+  if (sweep_subscribed_ && end > sweep_beam_) {
+    FLATLAND_TRACE("laser", GetName());
+    PrepareBeams(sweep_beam_, end);
+    CastBeams(sweep_beam_, end);
+  }
+  sweep_beam_ = std::max(sweep_beam_, end);
+  if (sweep_beam_ < count) {
+    return false;
+  }
+
+  // the scan is stamped with the time of its first beam
+  bool published = sweep_subscribed_;
+  if (published) {
+    FinishScan();
+    PublishScan(ros::Time(sweep_start_));
+  }
+  sweep_start_ += scan_period_;
+  sweep_beam_ = 0;
+  sweep_subscribed_ = HasSubscribers();
+  return published;
+}
+
+void Laser::SetDegradations(uint32_t degradations) {
+  double rate = degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_;
+  if (sweep_) {
+    scan_period_ = 1.0 / rate;
+    laser_scan_.time_increment = scan_period_ / laser_scan_.ranges.size();
+    laser_scan_.scan_time = scan_period_;
+    for (auto &scan : echo_scans_) {
+      scan.time_increment = laser_scan_.time_increment;
+      scan.scan_time = laser_scan_.scan_time;
+    }
+  } else {
+    SetUpdateRate(rate);
+  }
+  beam_stride_ = degradations & StepBudgetGovernor::COARSEN_BEAMS ? 2 : 1;
+}
+
+Laser::~Laser() {
+  if (GetStateExporter()) {
+    GetStateExporter()->RemoveScan(export_id_);
+  }
+}
+
+size_t Laser::GetMemoryUsage() const {
+  auto scan_bytes = [](const sensor_msgs::LaserScan &scan) {
+    return sizeof(scan) +
+           (scan.ranges.capacity() + scan.intensities.capacity()) *
+               sizeof(float);
+  };
+  size_t bytes = scan_bytes(laser_scan_);
+  for (const auto &scan : echo_scans_) {
+    bytes += scan_bytes(scan);
+  }
+  for (const auto &pool : scan_pools_) {
+    for (const auto &scan : pool) {
+      bytes += scan_bytes(*scan);
+    }
+  }
+  bytes += compact_scan_.ranges.capacity() * sizeof(uint16_t) +
+           compact_scan_.intensities.capacity();
+  bytes += cached_ranges_.capacity() * sizeof(float);
+  bytes += (static_fractions_.capacity() + static_intensities_.capacity()) *
+           sizeof(float);
+  bytes += model_fixtures_.capacity() * sizeof(ModelFixture) +
+           static_ignored_.capacity() * sizeof(const b2Body *);
+  bytes += (body_points_x_.capacity() + body_points_y_.capacity() +
+            world_points_x_.capacity() + world_points_y_.capacity()) *
+           sizeof(float);
+  return bytes;
+}
+
+bool Laser::HasSubscribers() const {
+  if (observed_ || IsSubscribed(scan_publisher_, compact_publisher_) ||
+      export_id_ >= 0) {
+    return true;
+  }
+  for (const auto &p : echo_publishers_) {
+    if (IsSubscribed(p)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Laser::PublishScan(const ros::Time &stamp) {
+  FLATLAND_TRACE("publish", GetName());
+  CommandLatency *latency = GetModel()->command_latency_.get();
+  if (latency) {
+    latency->Publish(CommandLatency::SCAN, stamp.toSec(),
+                     CommandLatency::Now());
+  }
+  laser_scan_.header.stamp = stamp;
+  for (auto &scan : echo_scans_) {
+    scan.header.stamp = stamp;
+  }
+  if (export_id_ >= 0) {
+    GetStateExporter()->SetScan(export_id_, stamp.toSec(),
+                                laser_scan_.ranges.data());
+  }
+
+  // quantized before the pooled publishing swaps the buffers of the scan
+  PublishLazily(compact_publisher_, compact_scan_,
+                [this](flatland_msgs::CompactScan &compact) {
+                  CompactScan::Encode(laser_scan_, compact_resolution_,
+                                      compact_intensities_, &compact);
+                });
+
+  // the scan may only be computed for the export or for one of the echoes,
+  // the others are not serialized
+  if (scan_pools_.empty()) {
+    PublishLazily(scan_publisher_, laser_scan_);
+    for (unsigned int k = 0; k < echo_scans_.size(); k++) {
+      PublishLazily(echo_publishers_[k], echo_scans_[k]);
+    }
+    return;
+  }
+
+  PublishPooled(scan_publisher_, &laser_scan_, &scan_pools_[0]);
+  for (unsigned int k = 0; k < echo_scans_.size(); k++) {
+    PublishPooled(echo_publishers_[k], &echo_scans_[k], &scan_pools_[k + 1]);
+  }
+}
+
+void Laser::PublishPooled(const ros::Publisher &publisher,
+                          sensor_msgs::LaserScan *scan,
+                          std::vector<sensor_msgs::LaserScanPtr> *pool) {
+  if (!IsSubscribed(publisher)) {
+    return;
+  }
+
+  // find a message that is no longer held by any subscriber or queue, only
+  // when all of them are in use a new one is added to the pool
+  sensor_msgs::LaserScanPtr msg;
+  for (const auto &m : *pool) {
+    if (m.unique()) {
+      msg = m;
+      break;
+    }
+  }
+  if (!msg) {
+    msg = boost::make_shared<sensor_msgs::LaserScan>(*scan);
+    pool->push_back(msg);
+  }
+
+  // swapping only exchanges the vector buffers, the message then carries this
+  // scan while the scan takes the buffers of the free message
+  std::swap(*msg, *scan);
+  PublishCounted(publisher, sensor_msgs::LaserScanConstPtr(msg));
+}
+
 void Laser::ComputeLaserRanges() {
-  // get the transformation matrix from the world to the body, and get the
-  // world to laser frame transformation matrix by multiplying the world to body
-  // and body to laser
+  FLATLAND_TRACE("laser", GetName());
+  if (!PrepareScan()) {
+    return;
+  }
+
+  // raycast on the shared sensor executor, in batch mode the beams are split
+  // into one contiguous chunk per worker, otherwise one task per beam. The
+  // results are written directly into the scan message
+  SensorExecutor::Get().ParallelFor(
+      laser_scan_.ranges.size(), batch_raycast_ ? 0 : 1,
+      [this](unsigned int begin, unsigned int end) { CastBeams(begin, end); },
+      priority_);
+
+  FinishScan();
+}
+
+bool Laser::PrepareScan() {
+  PrepareBeams(0, laser_scan_.ranges.size());
+
+  // when nothing has moved, publish the last scan with fresh noise
+  if (scan_cache_ && CanReuseScan(laser_origin_point_, laser_angle_)) {
+    laser_scan_.ranges = cached_ranges_;
+    noise_.Add(laser_scan_.ranges.data(), laser_scan_.ranges.size());
+    return false;
+  }
+
+  if (static_cache_) {
+    PrepareStaticCache();
+  }
+  return true;
+}
+
+void Laser::PrepareBeams(unsigned int begin, unsigned int end) {
+  // transform the end points of the beams from the body to the world frame
   const b2Transform &t = body_->GetPhysicsBody()->GetTransform();
-  m_world_to_body_ << t.q.c, -t.q.s, t.p.x, t.q.s, t.q.c, t.p.y, 0, 0, 1;
-  m_world_to_laser_ = m_world_to_body_ * m_body_to_laser_;
-
-  // Get the laser points in the world frame by multiplying the laser points in
-  // the laser frame to the transformation matrix from world to laser frame
-  m_world_laser_points_ = m_world_to_laser_ * m_laser_points_;
-  // Get the (0, 0) point in the laser frame
-  v_world_laser_origin_ = m_world_to_laser_ * v_zero_point_;
-
-  // Conver to Box2D data types
-  b2Vec2 laser_origin_point(v_world_laser_origin_(0), v_world_laser_origin_(1));
-
-  // Results vector
-  std::vector<std::future<std::pair<double, double>>> results(
-      laser_scan_.ranges.size());
-
-  // loop through the laser points and call the Box2D world raycast by
-  // enqueueing the callback
-  for (unsigned int i = 0; i < laser_scan_.ranges.size(); ++i) {
-    results[i] =
-        pool_.enqueue([i, this, laser_origin_point] {  // Lambda function
-          b2Vec2 laser_point;
-          laser_point.x = m_world_laser_points_(0, i);
-          laser_point.y = m_world_laser_points_(1, i);
-          LaserCallback cb(this);
-
-          GetModel()->GetPhysicsWorld()->RayCast(&cb, laser_origin_point,
-                                                 laser_point);
-
-          if (!cb.did_hit_) {
-            return std::make_pair<double, double>(NAN, 0);
-          } else {
-            return std::make_pair<double, double>(cb.fraction_ * this->range_,
-                                                  cb.intensity_);
-          }
-        });
-  }
-
-  // Unqueue all of the future'd results
-  for (unsigned int i = 0; i < laser_scan_.ranges.size(); ++i) {
-    auto result = results[i].get();  // Pull the result from the future
-    laser_scan_.ranges[i] = result.first + this->noise_gen_(this->rng_);
-    if (reflectance_layers_bits_) laser_scan_.intensities[i] = result.second;
+  RotateTranslate body_to_world = {t.p.x, t.p.y, t.q.c, t.q.s};
+  unsigned int rays = divergence_rays_;
+  size_t first = begin * rays, count = (end - begin) * rays;
+  Geometry::TransformPoints(body_to_world, body_points_x_.data() + first,
+                            body_points_y_.data() + first, count,
+                            world_points_x_.data() + first,
+                            world_points_y_.data() + first);
+
+  // the laser origin and angle in the world frame
+  laser_origin_point_ =
+      Geometry::Transform(b2Vec2(origin_.x, origin_.y), body_to_world);
+  b2Rot laser_rot = b2Mul(t.q, b2Rot(origin_.theta));
+  laser_angle_ = atan2(laser_rot.s, laser_rot.c);
+}
+
+void Laser::CastBeams(unsigned int begin, unsigned int end) {
+  FLATLAND_TRACE("laser", "cast_beams");
+  if (multi_echo_) {
+    for (unsigned int i = begin; i < end; ++i) {
+      Echoes echoes;
+      CastEchoes(laser_origin_point_, i, &echoes);
+
+      laser_scan_.ranges[i] = echoes.count > 0 ? echoes.range[0] : NAN;
+      if (reflectance_layers_bits_) {
+        laser_scan_.intensities[i] = echoes.count > 0 ? echoes.intensity[0] : 0;
+      }
+
+      for (unsigned int k = 1; k < echoes_; k++) {
+        sensor_msgs::LaserScan &scan = echo_scans_[k - 1];
+        scan.ranges[i] = k < echoes.count ? echoes.range[k] : NAN;
+        if (reflectance_layers_bits_) {
+          scan.intensities[i] = k < echoes.count ? echoes.intensity[k] : 0;
+        }
+      }
+    }
+    return;
+  }
+
+  // with a stride, only the beams at multiples of it are cast, wherever the
+  // range [begin, end) starts
+  unsigned int stride = beam_stride_;
+  unsigned int first = (begin + stride - 1) / stride * stride;
+  if (static_cache_) {
+    CastModelBeams(first, end, stride);
+    return;
+  }
+  for (unsigned int i = first; i < end; i += RAY_PACKET_SIZE * stride) {
+    RaycastBeams(laser_origin_point_, i,
+                 std::min(end, i + RAY_PACKET_SIZE * stride), stride);
+  }
+}
+
+void Laser::WriteRays(GpuRaycaster::Ray *rays) const {
+  // all the beams are cast, those skipped by the stride are overwritten by
+  // FinishScan, which costs less than a second launch
+  for (unsigned int i = 0; i < laser_scan_.ranges.size(); i++) {
+    rays[i].p1 = laser_origin_point_;
+    rays[i].p2.Set(world_points_x_[i], world_points_y_[i]);
+    rays[i].maskBits = layers_bits_;
+  }
+}
+
+void Laser::ReadHits(const GpuRaycaster::Hit *hits) {
+  for (unsigned int i = 0; i < laser_scan_.ranges.size(); i++) {
+    bool hit = hits[i].categoryBits != 0;
+    laser_scan_.ranges[i] = hit ? hits[i].fraction * range_ : NAN;
+    if (reflectance_layers_bits_) {
+      laser_scan_.intensities[i] =
+          (hits[i].categoryBits & reflectance_layers_bits_) ? 255.0 : 0.0;
+    }
+  }
+}
+
+void Laser::FinishScan() {
+  // the skipped beams repeat the previous cast beam, a coarse scan is not
+  // cached since a full one is due once the budget allows it
+  if (beam_stride_ > 1 && !multi_echo_) {
+    std::vector<float> &ranges = laser_scan_.ranges;
+    for (unsigned int i = 0; i < ranges.size(); i++) {
+      if (i % beam_stride_ == 0) continue;
+      ranges[i] = ranges[i - 1];
+      if (reflectance_layers_bits_) {
+        laser_scan_.intensities[i] = laser_scan_.intensities[i - 1];
+      }
+    }
+    cache_valid_ = false;
+  } else if (scan_cache_) {
+    CacheScan();
+  }
+
+  // the noise generator is not thread safe, add the noise in one bulk call
+  noise_.Add(laser_scan_.ranges.data(), laser_scan_.ranges.size());
+  for (auto &scan : echo_scans_) {
+    noise_.Add(scan.ranges.data(), scan.ranges.size());
+  }
+}
+
+void Laser::RaycastBeams(const b2Vec2 &laser_origin_point, unsigned int begin,
+                         unsigned int end, unsigned int stride) {
+  b2RayCastInput inputs[RAY_PACKET_SIZE];
+  b2RayBatchHit hits[RAY_PACKET_SIZE];
+  float grid_intensities[RAY_PACKET_SIZE];
+  bool grid_hits[RAY_PACKET_SIZE];
+  unsigned int count = (end - begin + stride - 1) / stride;
+
+  for (unsigned int k = 0; k < count; k++) {
+    b2Vec2 laser_point;
+    laser_point.x = world_points_x_[begin + k * stride];
+    laser_point.y = world_points_y_[begin + k * stride];
+
+    // raycast the static layers on their occupancy grids or segments first,
+    // the closest hit shortens the ray for the Box2D raycast
+    float max_fraction = 1.0f;
+    grid_intensities[k] = 0;
+    grid_hits[k] = RaycastStaticLayers(laser_origin_point, laser_point,
+                                       &max_fraction, &grid_intensities[k]);
+
+    inputs[k].p1 = laser_origin_point;
+    inputs[k].p2 = laser_point;
+    inputs[k].maxFraction = max_fraction;
+  }
+
+  // one traversal of the broadphase for all the beams of the packet, on the
+  // snapshot of the world while the scan is pipelined with the physics step
+  const b2RayCastSnapshot *snapshot = GetRayCastSnapshot();
+  if (snapshot) {
+    snapshot->RayCastBatch(inputs, count, ray_filter_, hits);
+  } else {
+    GetModel()->GetPhysicsWorld()->RayCastBatch(inputs, count, ray_filter_,
+                                                hits);
+  }
+
+  for (unsigned int k = 0; k < count; k++) {
+    float range = NAN;
+    float intensity = 0;
+    if (hits[k].fixture) {
+      range = hits[k].fraction * range_;
+      if (hits[k].fixture->GetFilterData().categoryBits &
+          reflectance_layers_bits_) {
+        intensity = 255.0;
+      }
+    } else if (grid_hits[k]) {
+      range = hits[k].fraction * range_;
+      intensity = grid_intensities[k];
+    }
+
+    laser_scan_.ranges[begin + k * stride] = range;
+    if (reflectance_layers_bits_) {
+      laser_scan_.intensities[begin + k * stride] = intensity;
+    }
+  }
+}
+
+bool Laser::RaycastStaticLayers(const b2Vec2 &origin, const b2Vec2 &point,
+                                float *fraction, float *intensity) const {
+  bool hit = false;
+  for (const auto &sl : static_layers_) {
+    const b2Transform &t = sl.body->GetTransform();
+    b2Vec2 local_origin = b2MulT(t, origin);
+    b2Vec2 local_point = b2MulT(t, point);
+    float f;
+    bool layer_hit = sl.grid
+                         ? sl.grid->RayCast(local_origin, local_point, &f)
+                         : sl.segments->RayCast(local_origin, local_point, &f);
+    if (layer_hit && f < *fraction) {
+      *fraction = f;
+      *intensity = (sl.category_bits & reflectance_layers_bits_) ? 255.0 : 0.0;
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+void Laser::PrepareStaticCache() {
+  // the models are found by their bounding boxes on every scan, only their
+  // fixtures are raycasted then
+  b2World *world = GetModel()->GetPhysicsWorld();
+  b2Vec2 extent(range_, range_);
+  b2AABB aabb;
+  aabb.lowerBound = laser_origin_point_ - extent;
+  aabb.upperBound = laser_origin_point_ + extent;
+  model_fixtures_.clear();
+  ModelFixtureCollector collector;
+  collector.layers_bits = layers_bits_;
+  collector.fixtures = &model_fixtures_;
+  world->QueryAABB(&collector, aabb);
+  std::sort(model_fixtures_.begin(), model_fixtures_.end(),
+            [](const ModelFixture &a, const ModelFixture &b) {
+              return a.fixture < b.fixture;
+            });
+  model_fixtures_.erase(
+      std::unique(model_fixtures_.begin(), model_fixtures_.end(),
+                  [](const ModelFixture &a, const ModelFixture &b) {
+                    return a.fixture == b.fixture;
+                  }),
+      model_fixtures_.end());
+
+  // the layers only change with their geometry or their fixtures, e.g.
+  // segments added at runtime or tiles swapped, which change the proxies
+  double dx = laser_origin_point_.x - static_pose_.x;
+  double dy = laser_origin_point_.y - static_pose_.y;
+  double dtheta = fabs(remainder(laser_angle_ - static_pose_.theta, 2 * M_PI));
+  if (static_valid_ &&
+      dx * dx + dy * dy <=
+          cache_linear_tolerance_ * cache_linear_tolerance_ &&
+      dtheta <= cache_angular_tolerance_ &&
+      static_generation_ == Layer::GetGeometryGeneration() &&
+      static_proxy_count_ == world->GetProxyCount()) {
+    return;
+  }
+
+  FLATLAND_TRACE("laser", "static_cache");
+  static_ignored_.assign(static_layer_bodies_.begin(),
+                         static_layer_bodies_.end());
+  for (const ModelFixture &mf : model_fixtures_) {
+    static_ignored_.push_back(mf.fixture->GetBody());
+  }
+  b2RayBatchFilter filter = ray_filter_;
+  filter.ignoredBodies = static_ignored_.data();
+  filter.ignoredBodyCount = static_ignored_.size();
+
+  unsigned int beams = laser_scan_.ranges.size();
+  static_fractions_.resize(beams);
+  static_intensities_.resize(beams);
+  b2RayCastInput inputs[RAY_PACKET_SIZE];
+  b2RayBatchHit hits[RAY_PACKET_SIZE];
+  for (unsigned int begin = 0; begin < beams; begin += RAY_PACKET_SIZE) {
+    unsigned int count = std::min(beams, begin + RAY_PACKET_SIZE) - begin;
+    for (unsigned int k = 0; k < count; k++) {
+      unsigned int i = begin + k;
+      b2Vec2 laser_point(world_points_x_[i], world_points_y_[i]);
+      static_fractions_[i] = 1.0f;
+      static_intensities_[i] = 0;
+      RaycastStaticLayers(laser_origin_point_, laser_point,
+                          &static_fractions_[i], &static_intensities_[i]);
+      inputs[k].p1 = laser_origin_point_;
+      inputs[k].p2 = laser_point;
+      inputs[k].maxFraction = static_fractions_[i];
+    }
+
+    world->RayCastBatch(inputs, count, filter, hits);
+    for (unsigned int k = 0; k < count; k++) {
+      if (hits[k].fixture) {
+        static_fractions_[begin + k] = hits[k].fraction;
+        static_intensities_[begin + k] =
+            (hits[k].fixture->GetFilterData().categoryBits &
+             reflectance_layers_bits_)
+                ? 255.0
+                : 0.0;
+      }
+    }
+  }
+
+  static_pose_ =
+      Pose(laser_origin_point_.x, laser_origin_point_.y, laser_angle_);
+  static_generation_ = Layer::GetGeometryGeneration();
+  static_proxy_count_ = world->GetProxyCount();
+  static_valid_ = true;
+}
+
+void Laser::CastModelBeams(unsigned int begin, unsigned int end,
+                           unsigned int stride) {
+  for (unsigned int i = begin; i < end; i += stride) {
+    b2RayCastInput input;
+    input.p1 = laser_origin_point_;
+    input.p2.Set(world_points_x_[i], world_points_y_[i]);
+    input.maxFraction = static_fractions_[i];
+    bool hit = input.maxFraction < 1.0f;
+    float intensity = static_intensities_[i];
+
+    for (const ModelFixture &mf : model_fixtures_) {
+      const b2Shape *shape = mf.fixture->GetShape();
+      for (int32 c = 0; c < shape->GetChildCount(); c++) {
+        b2RayCastOutput output;
+        if (shape->RayCast(&output, input, mf.xf, c)) {
+          input.maxFraction = output.fraction;
+          hit = true;
+          intensity =
+              (mf.category_bits & reflectance_layers_bits_) ? 255.0 : 0.0;
+        }
+      }
+    }
+
+    laser_scan_.ranges[i] = hit ? input.maxFraction * range_ : NAN;
+    if (reflectance_layers_bits_) {
+      laser_scan_.intensities[i] = intensity;
+    }
+  }
+}
+
+void Laser::CastEchoes(const b2Vec2 &laser_origin_point, unsigned int i,
+                       Echoes *echoes) {
+  for (unsigned int j = 0; j < divergence_rays_; j++) {
+    unsigned int column = i * divergence_rays_ + j;
+    b2Vec2 laser_point(world_points_x_[column], world_points_y_[column]);
+
+    // static layers are opaque, only their nearest hit is a return and it
+    // ends the ray
+    float max_fraction = 1.0f;
+    float grid_intensity = 0;
+    bool grid_hit = RaycastStaticLayers(laser_origin_point, laser_point,
+                                        &max_fraction, &grid_intensity);
+    max_fraction = std::max(max_fraction, 0.0f);
+
+    if (grid_hit) {
+      echoes->Insert(max_fraction * range_, grid_intensity, echoes_,
+                     echo_separation_);
+      if (max_fraction <= 0) {
+        continue;
+      }
+    }
+
+    b2Vec2 ray_end =
+        laser_origin_point + max_fraction * (laser_point - laser_origin_point);
+    LaserEchoCallback cb(this, echoes, max_fraction * range_);
+    const b2RayCastSnapshot *snapshot = GetRayCastSnapshot();
+    if (snapshot) {
+      snapshot->RayCast(&cb, laser_origin_point, ray_end);
+    } else {
+      GetModel()->GetPhysicsWorld()->RayCast(&cb, laser_origin_point, ray_end);
+    }
+  }
+}
+
+void Laser::Echoes::Insert(float r, float i, unsigned int max,
+                           float separation) {
+  // merge with a return that is too close, keeping the nearest range
+  for (unsigned int k = 0; k < count; k++) {
+    if (std::fabs(range[k] - r) < separation) {
+      if (r >= range[k]) {
+        return;
+      }
+      std::copy(range + k + 1, range + count, range + k);
+      std::copy(intensity + k + 1, intensity + count, intensity + k);
+      count--;
+      break;
+    }
+  }
+
+  unsigned int pos = std::upper_bound(range, range + count, r) - range;
+  if (pos >= max) {
+    return;
+  }
+
+  unsigned int last = std::min(count, max - 1);
+  std::copy_backward(range + pos, range + last, range + last + 1);
+  std::copy_backward(intensity + pos, intensity + last, intensity + last + 1);
+  range[pos] = r;
+  intensity[pos] = i;
+  count = last + 1;
+}
+
+bool Laser::CanReuseScan(const b2Vec2 &origin, double angle) const {
+  const BodyStates *states = GetBodyStates();
+  if (!cache_valid_ || states == nullptr ||
+      cache_layer_generation_ != Layer::GetGeometryGeneration() ||
+      cache_body_generation_ != states->generation_ ||
+      cache_moves_ != states->moves_) {
+    return false;
+  }
+
+  double dx = origin.x - cached_pose_.x;
+  double dy = origin.y - cached_pose_.y;
+  double dtheta = fabs(remainder(angle - cached_pose_.theta, 2 * M_PI));
+  if (dx * dx + dy * dy > cache_linear_tolerance_ * cache_linear_tolerance_ ||
+      dtheta > cache_angular_tolerance_) {
+    return false;
+  }
+
+  // the bodies in range must be the cached ones, where they were. The awake
+  // flags are not read, the drives of other models write them concurrently
+  size_t found = 0;
+  for (const b2Body *b = GetModel()->GetPhysicsWorld()->GetBodyList(); b;
+       b = b->GetNext()) {
+    if (!InRange(b, origin)) {
+      continue;
+    }
+    CachedBody key = {static_cast<const Body *>(b->GetUserData()), Pose()};
+    auto it =
+        std::lower_bound(cached_bodies_.begin(), cached_bodies_.end(), key);
+    if (it == cached_bodies_.end() || it->body != key.body ||
+        states->GetPose(key.body) != it->pose) {
+      return false;
+    }
+    found++;
+  }
+  return found == cached_bodies_.size();
+}
+
+void Laser::CacheScan() {
+  const BodyStates *states = GetBodyStates();
+  if (states == nullptr) {
+    cache_valid_ = false;
+    return;
   }
+
+  cached_ranges_ = laser_scan_.ranges;
+  cached_pose_ =
+      Pose(laser_origin_point_.x, laser_origin_point_.y, laser_angle_);
+  cache_layer_generation_ = Layer::GetGeometryGeneration();
+  cache_body_generation_ = states->generation_;
+  cache_moves_ = states->moves_;
+
+  cached_bodies_.clear();
+  for (const b2Body *b = GetModel()->GetPhysicsWorld()->GetBodyList(); b;
+       b = b->GetNext()) {
+    if (InRange(b, laser_origin_point_)) {
+      const Body *body = static_cast<const Body *>(b->GetUserData());
+      cached_bodies_.push_back({body, states->GetPose(body)});
+    }
+  }
+  std::sort(cached_bodies_.begin(), cached_bodies_.end());
+  cache_valid_ = true;
 }
 
-float LaserCallback::ReportFixture(b2Fixture *fixture, const b2Vec2 &point,
-                                   const b2Vec2 &normal, float fraction) {
-  uint16_t category_bits = fixture->GetFilterData().categoryBits;
+bool Laser::InRange(const b2Body *body, const b2Vec2 &origin) const {
+  // the body the laser is attached to has not moved, otherwise the pose
+  // check would have failed, and the layers are checked by their generation
+  if (body->GetType() == b2_staticBody || body == body_->GetPhysicsBody() ||
+      body->GetUserData() == nullptr) {
+    return false;
+  }
+
+  for (const b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    if (f->IsSensor() || !(f->GetFilterData().categoryBits & layers_bits_)) {
+      continue;
+    }
+
+    // check if the fixture's bounding box overlaps the scan circle
+    for (int c = 0; c < f->GetShape()->GetChildCount(); c++) {
+      const b2AABB &aabb = f->GetAABB(c);
+      b2Vec2 closest = b2Clamp(origin, aabb.lowerBound, aabb.upperBound);
+      if (b2DistanceSquared(origin, closest) <= range_ * range_) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Laser::FindStaticLayers() {
+  static_layers_.clear();
+  static_layer_bodies_.clear();
+  layer_generation_ = Layer::GetGeometryGeneration();
+
+  // layers are loaded before models, so all of them exist at this point
+  for (b2Body *b = GetModel()->GetPhysicsWorld()->GetBodyList(); b;
+       b = b->GetNext()) {
+    Body *body = static_cast<Body *>(b->GetUserData());
+    if (!body || body->GetEntity()->Type() != Entity::EntityType::LAYER) {
+      continue;
+    }
+
+    Layer *layer = static_cast<Layer *>(body->GetEntity());
+    StaticLayer sl;
+    sl.body = b;
+    sl.grid = grid_raycast_ ? layer->GetGrid() : nullptr;
+    // the layers whose fixtures only serve the collisions are always sensed
+    // on their segments
+    sl.segments = segment_raycast_ || layer->HasSensingGeometry()
+                      ? layer->GetSegmentRaycaster()
+                      : nullptr;
+    sl.category_bits = layer->GetCfr()->GetCategoryBits(layer->names_);
+
+    if ((sl.grid || sl.segments) && (sl.category_bits & layers_bits_)) {
+      static_layers_.push_back(sl);
+    }
+  }
+
+  for (const auto &sl : static_layers_) {
+    static_layer_bodies_.push_back(sl.body);
+  }
+  ray_filter_.ignoredBodies = static_layer_bodies_.data();
+  ray_filter_.ignoredBodyCount = static_layer_bodies_.size();
+
+  ROS_DEBUG_NAMED("LaserPlugin", "Laser %s raycasts %lu static layer(s)",
+                  GetName().c_str(), static_layers_.size());
+}
+
+bool Laser::IsStaticLayerBody(const b2Body *body) const {
+  for (const auto &sl : static_layers_) {
+    if (sl.body == body) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Laser::DetectsFixture(b2Fixture *fixture) const {
   // only register hit in the specified layers
-  if (!(category_bits & parent_->layers_bits_)) {
-    return -1.0f;  // return -1 to ignore this hit
+  if (!(fixture->GetFilterData().categoryBits & layers_bits_)) {
+    return false;
   }
 
   // Don't return on hitting sensors... they're not real
-  if (fixture->IsSensor()) return -1.0f;
+  if (fixture->IsSensor()) return false;
+
+  // layers raycasted on their occupancy grids or segments are handled
+  // separately
+  return !IsStaticLayerBody(fixture->GetBody());
+}
 
-  if (category_bits & parent_->reflectance_layers_bits_) {
-    intensity_ = 255.0;
+float LaserEchoCallback::ReportFixture(b2Fixture *fixture,
+                                       const b2Vec2 &point,
+                                       const b2Vec2 &normal, float fraction) {
+  if (!parent_->DetectsFixture(fixture)) {
+    return -1.0f;  // return -1 to ignore this hit
   }
 
-  did_hit_ = true;
-  fraction_ = fraction;
+  float intensity = (fixture->GetFilterData().categoryBits &
+                     parent_->reflectance_layers_bits_)
+                        ? 255.0
+                        : 0.0;
+  echoes_->Insert(fraction * length_, intensity, parent_->echoes_,
+                  parent_->echo_separation_);
 
-  return fraction;
+  // keep looking for hits, once all returns are found only closer hits matter
+  if (echoes_->count < parent_->echoes_ || length_ <= 0) {
+    return 1.0f;
+  }
+  return std::min(1.0f, echoes_->range[echoes_->count - 1] / length_);
 }
 
-void Laser::ParseParameters(const YAML::Node &config) {
-  YamlReader reader(config);
-  std::string body_name = reader.Get<std::string>("body");
-  topic_ = reader.Get<std::string>("topic", "scan");
-  frame_id_ = reader.Get<std::string>("frame", GetName());
-  broadcast_tf_ = reader.Get<bool>("broadcast_tf", true);
-  update_rate_ = reader.Get<double>("update_rate",
-                                    std::numeric_limits<double>::infinity());
-  origin_ = reader.GetPose("origin", Pose(0, 0, 0));
-  range_ = reader.Get<double>("range");
-  noise_std_dev_ = reader.Get<double>("noise_std_dev", 0);
-
-  std::vector<std::string> layers =
-      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+LaserConfig::LaserConfig(YamlReader &reader, const std::string &name) {
+  body = reader.Get<std::string>("body");
+  topic = reader.Get<std::string>("topic", "scan");
+  frame_id = reader.Get<std::string>("frame", name);
+  broadcast_tf = reader.Get<bool>("broadcast_tf", true);
+  update_rate = reader.Get<double>("update_rate",
+                                   std::numeric_limits<double>::infinity());
+  origin = reader.GetPose("origin", Pose(0, 0, 0));
+  range = reader.Get<double>("range");
+  noise_std_dev = reader.Get<double>("noise_std_dev", 0);
+  noise_seed = reader.Get<int>("noise_seed", -1);
+  batch_raycast = reader.Get<bool>("batch_raycast", true);
+  priority = SensorExecutor::ParsePriority(
+      reader.Get<std::string>("task_priority", "normal"));
+  grid_raycast = reader.Get<bool>("grid_raycast", false);
+  segment_raycast = reader.Get<bool>("segment_raycast", false);
+  scan_cache = reader.Get<bool>("scan_cache", false);
+  static_cache = reader.Get<bool>("static_cache", false);
+  world_batch = reader.Get<bool>("world_batch", true);
+  sweep = reader.Get<bool>("sweep", false);
+  int echoes_count = reader.Get<int>("echoes", 1);
+  echo_separation = reader.Get<double>("echo_separation", 0.05);
+  divergence = reader.Get<double>("divergence", 0);
+  int rays = reader.Get<int>("divergence_rays", 1);
+  cache_linear_tolerance = reader.Get<double>("cache_linear_tolerance", 0.001);
+  cache_angular_tolerance =
+      reader.Get<double>("cache_angular_tolerance", 0.001);
+
+  int pool = reader.Get<int>("message_pool", 0);
+  compact_resolution = reader.Get<double>("compact_resolution", 0);
+  compact_intensities = reader.Get<bool>("compact_intensities", true);
+
+  layers = reader.GetList<std::string>("layers", {"all"}, -1, -1);
 
   YamlReader angle_reader = reader.Subnode("angle", YamlReader::MAP);
-  min_angle_ = angle_reader.Get<double>("min");
-  max_angle_ = angle_reader.Get<double>("max");
-  increment_ = angle_reader.Get<double>("increment");
+  min_angle = angle_reader.Get<double>("min");
+  max_angle = angle_reader.Get<double>("max");
+  increment = angle_reader.Get<double>("increment");
 
   angle_reader.EnsureAccessedAllKeys();
   reader.EnsureAccessedAllKeys();
 
-  if (max_angle_ < min_angle_) {
+  if (max_angle < min_angle) {
     throw YAMLException("Invalid \"angle\" params, must have max > min");
   }
 
+  if (echoes_count < 1 || echoes_count > int(Laser::MAX_ECHOES)) {
+    throw YAMLException("Invalid \"echoes\" param, must be in [1, " +
+                        std::to_string(Laser::MAX_ECHOES) + "]");
+  }
+
+  if (rays < 1 || divergence < 0) {
+    throw YAMLException(
+        "Invalid \"divergence\" params, must have divergence >= 0 and "
+        "divergence_rays >= 1");
+  }
+
+  echoes = echoes_count;
+  divergence_rays = rays;
+  if (pool < 0) {
+    throw YAMLException("Invalid \"message_pool\" param, must be >= 0");
+  }
+  message_pool = pool;
+
+  if (compact_resolution < 0 ||
+      (compact_resolution > 0 &&
+       range > CompactScan::MAX_RANGE * compact_resolution)) {
+    throw YAMLException(
+        "Invalid \"compact_resolution\" param, must be >= 0 and range / "
+        "compact_resolution must be <= " +
+        std::to_string(CompactScan::MAX_RANGE));
+  }
+
+  if ((echoes > 1 || divergence_rays > 1) && scan_cache) {
+    throw YAMLException("\"scan_cache\" is not supported with multiple "
+                        "echoes or divergence rays");
+  }
+
+  if (sweep && (update_rate <= 0 || std::isinf(update_rate))) {
+    throw YAMLException("\"sweep\" requires an \"update_rate\" > 0");
+  }
+  if (sweep && scan_cache) {
+    throw YAMLException("\"scan_cache\" is not supported with \"sweep\"");
+  }
+
+  if ((echoes > 1 || divergence_rays > 1 || sweep) && static_cache) {
+    throw YAMLException("\"static_cache\" is not supported with multiple "
+                        "echoes, divergence rays or \"sweep\"");
+  }
+}
+
+void Laser::ParseParameters(const YAML::Node &config) {
+  // validated once, the lasers of a model template share the parameters
+  config_ = SharedConfig<LaserConfig>(config, GetName());
+  const std::string &body_name = config_->body;
+  const std::vector<std::string> &layers = config_->layers;
+  topic_ = config_->topic;
+  frame_id_ = config_->frame_id;
+  broadcast_tf_ = config_->broadcast_tf;
+  update_rate_ = config_->update_rate;
+  origin_ = config_->origin;
+  range_ = config_->range;
+  noise_std_dev_ = config_->noise_std_dev;
+  int noise_seed = config_->noise_seed;
+  batch_raycast_ = config_->batch_raycast;
+  priority_ = config_->priority;
+  grid_raycast_ = config_->grid_raycast;
+  segment_raycast_ = config_->segment_raycast;
+  scan_cache_ = config_->scan_cache;
+  static_cache_ = config_->static_cache;
+  world_batch_ = config_->world_batch;
+  sweep_ = config_->sweep;
+  echoes_ = config_->echoes;
+  echo_separation_ = config_->echo_separation;
+  divergence_ = config_->divergence;
+  divergence_rays_ = config_->divergence_rays;
+  cache_linear_tolerance_ = config_->cache_linear_tolerance;
+  cache_angular_tolerance_ = config_->cache_angular_tolerance;
+  message_pool_ = config_->message_pool;
+  compact_resolution_ = config_->compact_resolution;
+  compact_intensities_ = config_->compact_intensities;
+  min_angle_ = config_->min_angle;
+  max_angle_ = config_->max_angle;
+  increment_ = config_->increment;
+  multi_echo_ = echoes_ > 1 || divergence_rays_ > 1;
+
   body_ = GetModel()->GetBody(body_name);
   if (!body_) {
     throw YAMLException("Cannot find body with name " + body_name);
@@ -261,22 +1136,25 @@ void Laser::ParseParameters(const YAML::Node &config) {
   reflectance_layers_bits_ =
       GetModel()->GetCfr()->GetCategoryBits(reflectance_layer, &invalid_layers);
 
-  // init the random number generators
-  std::random_device rd;
-  rng_ = std::default_random_engine(rd());
-  noise_gen_ = std::normal_distribution<double>(0.0, noise_std_dev_);
+  // init the noise generator, a negative seed picks a random one, which is
+  // recorded and replayed by the Recorder
+  if (noise_seed < 0) {
+    noise_seed = RandomSeed() & 0x7fffffff;
+  }
+  noise_ = GaussianNoise(noise_std_dev_, noise_seed);
 
   ROS_DEBUG_NAMED("LaserPlugin",
                   "Laser %s params: topic(%s) body(%s, %p) origin(%f,%f,%f) "
                   "frame_id(%s) broadcast_tf(%d) update_rate(%f) range(%f)  "
                   "noise_std_dev(%f) angle_min(%f) angle_max(%f) "
-                  "angle_increment(%f) layers(0x%u {%s})",
+                  "angle_increment(%f) layers(0x%u {%s}) batch_raycast(%d)",
                   GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
                   origin_.x, origin_.y, origin_.theta, frame_id_.c_str(),
                   broadcast_tf_, update_rate_, range_, noise_std_dev_,
                   min_angle_, max_angle_, increment_, layers_bits_,
-                  boost::algorithm::join(layers, ",").c_str());
+                  boost::algorithm::join(layers, ",").c_str(), batch_raycast_);
 }
 };
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::Laser, flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::Laser, flatland_server::ModelPlugin)
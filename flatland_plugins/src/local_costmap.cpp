@@ -0,0 +1,326 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 local_costmap.cpp
+ * @brief	 Local costmap plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/local_costmap.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+namespace {
+
+/**
+ * Collects the fixtures in the layers of the costmap overlapping an AABB,
+ * a fixture with several children is reported once per child
+ */
+class FixtureCollector : public b2QueryCallback {
+ public:
+  uint32_t layers_bits;
+  bool static_bodies;
+  const Model *model;
+  std::vector<b2Fixture *> fixtures;
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        !(fixture->GetFilterData().categoryBits & layers_bits)) {
+      return true;
+    }
+    b2Body *b = fixture->GetBody();
+    if ((b->GetType() == b2_staticBody) != static_bodies) {
+      return true;
+    }
+    // the costmap does not see the model it belongs to
+    Body *body = static_cast<Body *>(b->GetUserData());
+    if (body && body->GetEntity() == model) {
+      return true;
+    }
+    fixtures.push_back(fixture);
+    return true;
+  }
+};
+
+/**
+ * @brief Check if a cell touches a child of a shape, the skin of the polygons
+ * is ignored
+ * @param[in] cell Shape of the cell, centered on the origin
+ * @param[in] center Center of the cell in the world
+ * @param[in] shape The shape
+ * @param[in] child The child of the shape
+ * @param[in] xf Transform of the body of the shape
+ * @param[in] tolerance Distance at which the cell touches the shape
+ */
+bool CellOverlaps(const b2PolygonShape &cell, const b2Vec2 &center,
+                  const b2Shape *shape, int32 child, const b2Transform &xf,
+                  float tolerance) {
+  b2DistanceInput input;
+  input.proxyA.Set(&cell, 0);
+  input.proxyB.Set(shape, child);
+  input.transformA.Set(center, 0);
+  input.transformB = xf;
+  input.useRadii = false;
+
+  b2SimplexCache cache;
+  cache.count = 0;
+  b2DistanceOutput output;
+  b2Distance(&output, &cache, &input);
+
+  if (shape->GetType() == b2Shape::e_circle) {
+    tolerance += shape->m_radius;
+  }
+  return output.distance <= tolerance;
+}
+}
+
+const int8_t LocalCostmap::FREE;
+const int8_t LocalCostmap::OCCUPIED;
+
+void LocalCostmap::OnInitialize(const YAML::Node &config) {
+  ParseParameters(config);
+
+  SetUpdateRate(update_rate_);
+
+  double half = resolution_ / 2;
+  cell_shape_.SetAsBox(half, half);
+  window_valid_ = false;
+  static_cells_.assign(width_ * height_, FREE);
+
+  grid_.header.frame_id = world_frame_id_;
+  grid_.info.resolution = resolution_;
+  grid_.info.width = width_;
+  grid_.info.height = height_;
+  grid_.info.origin.orientation.w = 1;
+
+  grid_publisher_ = nh_.advertise<nav_msgs::OccupancyGrid>(topic_, 1);
+}
+
+void LocalCostmap::SetDegradations(uint32_t degradations) {
+  SetUpdateRate(degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_);
+}
+
+void LocalCostmap::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  // only compute and publish when the number of subscribers is not zero
+  if (!IsSubscribed(grid_publisher_)) {
+    return;
+  }
+
+  UpdateWindow();
+
+  // the other bodies may have moved since the last update
+  grid_.data = static_cells_;
+  Rasterize(0, 0, width_, height_, false, &grid_.data);
+
+  grid_.header.stamp = timekeeper.GetSimTime();
+  grid_.info.map_load_time = grid_.header.stamp;
+  grid_.info.origin.position.x = origin_x_ * resolution_;
+  grid_.info.origin.position.y = origin_y_ * resolution_;
+  PublishCounted(grid_publisher_, grid_);
+}
+
+void LocalCostmap::UpdateWindow() {
+  // the window snaps to the cells of the world so the cells it keeps are
+  // still aligned after it moves
+  const b2Vec2 &p = body_->GetPhysicsBody()->GetPosition();
+  int x = std::floor(p.x / resolution_) - width_ / 2;
+  int y = std::floor(p.y / resolution_) - height_ / 2;
+  int dx = x - origin_x_;
+  int dy = y - origin_y_;
+  origin_x_ = x;
+  origin_y_ = y;
+
+  if (!window_valid_ || std::abs(dx) >= width_ || std::abs(dy) >= height_) {
+    std::fill(static_cells_.begin(), static_cells_.end(), FREE);
+    Rasterize(0, 0, width_, height_, true, &static_cells_);
+    window_valid_ = true;
+    return;
+  }
+
+  if (dx == 0 && dy == 0) {
+    return;
+  }
+
+  // move the cells still in the window, the others are rasterized again
+  shifted_.assign(width_ * height_, FREE);
+  int x0 = std::max(0, -dx), x1 = std::min(width_, width_ - dx);
+  int y0 = std::max(0, -dy), y1 = std::min(height_, height_ - dy);
+  for (int j = y0; j < y1; j++) {
+    std::copy(static_cells_.begin() + (j + dy) * width_ + x0 + dx,
+              static_cells_.begin() + (j + dy) * width_ + x1 + dx,
+              shifted_.begin() + j * width_ + x0);
+  }
+  static_cells_.swap(shifted_);
+
+  // the new columns over all rows, then the new rows of the kept columns
+  if (dx > 0) {
+    Rasterize(x1, 0, width_, height_, true, &static_cells_);
+  } else if (dx < 0) {
+    Rasterize(0, 0, x0, height_, true, &static_cells_);
+  }
+  if (dy > 0) {
+    Rasterize(x0, y1, x1, height_, true, &static_cells_);
+  } else if (dy < 0) {
+    Rasterize(x0, 0, x1, y0, true, &static_cells_);
+  }
+}
+
+void LocalCostmap::Rasterize(int x0, int y0, int x1, int y1,
+                             bool static_bodies, std::vector<int8_t> *cells) {
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  b2AABB aabb;
+  aabb.lowerBound.Set((origin_x_ + x0) * resolution_,
+                      (origin_y_ + y0) * resolution_);
+  aabb.upperBound.Set((origin_x_ + x1) * resolution_,
+                      (origin_y_ + y1) * resolution_);
+
+  FixtureCollector collector;
+  collector.layers_bits = layers_bits_;
+  collector.static_bodies = static_bodies;
+  collector.model = GetModel();
+  GetModel()->GetPhysicsWorld()->QueryAABB(&collector, aabb);
+
+  std::vector<b2Fixture *> &fixtures = collector.fixtures;
+  std::sort(fixtures.begin(), fixtures.end());
+  fixtures.erase(std::unique(fixtures.begin(), fixtures.end()),
+                 fixtures.end());
+
+  // only the cells in the bounds of a child are tested against it
+  float tolerance = 1e-3 * resolution_;
+  for (b2Fixture *fixture : fixtures) {
+    const b2Shape *shape = fixture->GetShape();
+    const b2Transform &xf = fixture->GetBody()->GetTransform();
+    for (int32 child = 0; child < shape->GetChildCount(); child++) {
+      b2AABB bounds;
+      shape->ComputeAABB(&bounds, xf, child);
+      int lx = std::floor(bounds.lowerBound.x / resolution_) - origin_x_;
+      int ly = std::floor(bounds.lowerBound.y / resolution_) - origin_y_;
+      int ux = std::floor(bounds.upperBound.x / resolution_) - origin_x_;
+      int uy = std::floor(bounds.upperBound.y / resolution_) - origin_y_;
+      int cx0 = std::max(x0, lx), cx1 = std::min(x1, ux + 1);
+      int cy0 = std::max(y0, ly), cy1 = std::min(y1, uy + 1);
+
+      for (int j = cy0; j < cy1; j++) {
+        for (int i = cx0; i < cx1; i++) {
+          int8_t &cell = (*cells)[j * width_ + i];
+          if (cell == OCCUPIED) continue;
+          b2Vec2 center((origin_x_ + i + 0.5) * resolution_,
+                        (origin_y_ + j + 0.5) * resolution_);
+          if (CellOverlaps(cell_shape_, center, shape, child, xf, tolerance)) {
+            cell = OCCUPIED;
+          }
+        }
+      }
+    }
+  }
+}
+
+void LocalCostmap::ParseParameters(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string body_name = reader.Get<std::string>("body");
+  topic_ = reader.Get<std::string>("topic", "local_costmap");
+  world_frame_id_ = reader.Get<std::string>("world_frame_id", "map");
+  update_rate_ = reader.Get<double>("update_rate", 5);
+  resolution_ = reader.Get<double>("resolution", 0.05);
+  double width = reader.Get<double>("width", 6);
+  double height = reader.Get<double>("height", 6);
+  std::vector<std::string> layers =
+      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+  reader.EnsureAccessedAllKeys();
+
+  if (resolution_ <= 0) {
+    throw YAMLException("Invalid \"resolution\" param, must be > 0");
+  }
+
+  if (width < resolution_ || height < resolution_) {
+    throw YAMLException(
+        "Invalid \"width\" or \"height\" param, must be at least the "
+        "resolution");
+  }
+  width_ = std::lround(width / resolution_);
+  height_ = std::lround(height / resolution_);
+
+  body_ = GetModel()->GetBody(body_name);
+  if (!body_) {
+    throw YAMLException("Cannot find body with name " + body_name);
+  }
+
+  std::vector<std::string> invalid_layers;
+  layers_bits_ = GetModel()->GetCfr()->GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw YAMLException("Cannot find layer(s): {" +
+                        boost::algorithm::join(invalid_layers, ",") + "}");
+  }
+
+  ROS_DEBUG_NAMED("LocalCostmap",
+                  "LocalCostmap %s params: topic(%s) body(%s, %p) "
+                  "world_frame_id(%s) update_rate(%f) resolution(%f) "
+                  "cells(%d x %d)",
+                  GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
+                  world_frame_id_.c_str(), update_rate_, resolution_, width_,
+                  height_);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::LocalCostmap,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::LocalCostmap,
+                         flatland_server::ModelPlugin)
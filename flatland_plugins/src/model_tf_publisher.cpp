@@ -47,11 +47,13 @@
 #include <flatland_plugins/model_tf_publisher.h>
 #include <flatland_server/exceptions.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/tf_aggregator.h>
 #include <flatland_server/yaml_reader.h>
 #include <geometry_msgs/TransformStamped.h>
 #include <pluginlib/class_list_macros.h>
-#include <Eigen/Dense>
 #include <boost/algorithm/string/join.hpp>
+#include <algorithm>
 
 using namespace flatland_server;
 
@@ -65,12 +67,19 @@ void ModelTfPublisher::OnInitialize(const YAML::Node &config) {
   world_frame_id_ = reader.Get<std::string>("world_frame_id", "map");
   update_rate_ = reader.Get<double>("update_rate",
                                     std::numeric_limits<double>::infinity());
+  extrapolation_rate_ = reader.Get<double>("extrapolation_rate", 0);
 
   std::string ref_body_name = reader.Get<std::string>("reference", "");
   std::vector<std::string> excluded_body_names =
       reader.GetList<std::string>("exclude", {}, -1, -1);
   reader.EnsureAccessedAllKeys();
 
+  if (extrapolation_rate_ < 0) {
+    throw YAMLException("Invalid \"extrapolation_rate\" " +
+                        std::to_string(extrapolation_rate_) +
+                        ", must not be negative");
+  }
+
   if (ref_body_name.size() != 0) {
     reference_body_ = GetModel()->GetBody(ref_body_name);
 
@@ -95,69 +104,145 @@ void ModelTfPublisher::OnInitialize(const YAML::Node &config) {
     }
   }
 
-  update_timer_.SetRate(update_rate_);
+  // the bodies and frames do not change, only the transforms are updated
+  reference_frame_id_ =
+      tf::resolve("", GetModel()->NameSpaceTF(reference_body_->name_));
+  for (Body *body : GetModel()->bodies_) {
+    if (body == reference_body_ ||
+        std::find(excluded_bodies_.begin(), excluded_bodies_.end(), body) !=
+            excluded_bodies_.end()) {
+      continue;
+    }
+    published_bodies_.push_back(body);
+
+    geometry_msgs::TransformStamped tf_stamped;
+    tf_stamped.header.frame_id = reference_frame_id_;
+    tf_stamped.child_frame_id =
+        tf::resolve("", GetModel()->NameSpaceTF(body->name_));
+    transforms_.push_back(tf_stamped);
+  }
+  if (publish_tf_world_) {
+    geometry_msgs::TransformStamped tf_stamped;
+    tf_stamped.header.frame_id = world_frame_id_;
+    tf_stamped.child_frame_id = reference_frame_id_;
+    transforms_.push_back(tf_stamped);
+  }
+
+  poses_.resize(published_bodies_.size() + 1);
+  SetUpdateRate(update_rate_);
+
+  // the transforms are only published by the extrapolation task, see
+  // BeforePhysicsStep
+  if (extrapolation_rate_ > 0) {
+    motions_.resize(poses_.size());
+    extrapolation_task_ = Extrapolator::Get().Add(
+        extrapolation_rate_,
+        [this](double wall_time) { PublishExtrapolated(wall_time); });
+  }
 
   ROS_DEBUG_NAMED(
       "ModelTfPublisher",
       "Initialized with params: reference(%s, %p) "
-      "publish_tf_world(%d) world_frame_id(%s) update_rate(%f), exclude({%s})",
+      "publish_tf_world(%d) world_frame_id(%s) update_rate(%f) "
+      "extrapolation_rate(%f), exclude({%s})",
       reference_body_->name_.c_str(), reference_body_, publish_tf_world_,
-      world_frame_id_.c_str(), update_rate_,
+      world_frame_id_.c_str(), update_rate_, extrapolation_rate_,
       boost::algorithm::join(excluded_body_names, ",").c_str());
 }
 
+ModelTfPublisher::~ModelTfPublisher() {
+  if (extrapolation_task_ != 0) {
+    Extrapolator::Get().Remove(extrapolation_task_);
+  }
+}
+
 void ModelTfPublisher::BeforePhysicsStep(const Timekeeper &timekeeper) {
-  if (!update_timer_.CheckUpdate(timekeeper)) {
+  // the transforms of the bodies as of the last physics step, read from the
+  // contiguous body states of the world when loaded by the plugin manager
+  const BodyStates *states = GetBodyStates();
+  auto transform = [states](const Body *body) {
+    return states ? states->GetTransform(body)
+                  : body->physics_body_->GetTransform();
+  };
+
+  if (extrapolation_rate_ > 0) {
+    // only the motions are saved, the extrapolation task publishes them
+    std::lock_guard<std::mutex> lock(extrapolation_mutex_);
+    for (unsigned int i = 0; i < motions_.size(); i++) {
+      const Body *body = i == 0 ? reference_body_ : published_bodies_[i - 1];
+      const b2Body *b = body->physics_body_;
+      motions_[i] = Extrapolator::Motion::Of(
+          transform(body),
+          states ? states->GetLinearVelocity(body) : b->GetLinearVelocity(),
+          states ? states->GetAngularVelocity(body) : b->GetAngularVelocity(),
+          b->GetLocalCenter());
+    }
+    double time = timekeeper.GetSimTime().toSec();
+    if (time < published_time_) {
+      published_time_ = 0;  // the simulation time went back
+    }
+    clock_.Step(time, Extrapolator::Now());
     return;
   }
 
-  Eigen::Matrix3f ref_tf_m;  ///< for storing TF from world to the ref. body
-  Eigen::Matrix3f rel_tf;    ///< for storing TF from ref. body to other bodies
+  poses_[0] = transform(reference_body_);
+  for (unsigned int i = 0; i < published_bodies_.size(); i++) {
+    poses_[i + 1] = transform(published_bodies_[i]);
+  }
+  FillTransforms(timekeeper.GetSimTime());
 
-  // fill the world to ref. body TF with data from Box2D
-  const b2Transform &r = reference_body_->physics_body_->GetTransform();
-  ref_tf_m << r.q.c, -r.q.s, r.p.x, r.q.s, r.q.c, r.p.y, 0, 0, 1;
+  // one message for all the transforms of the model
+  if (transforms_.empty()) {
+    return;
+  }
+  if (TfAggregator::IsEnabled()) {
+    TfAggregator::Get().Send(transforms_);
+  } else {
+    tf_broadcaster.sendTransform(transforms_);
+  }
+}
 
-  geometry_msgs::TransformStamped tf_stamped;
-  tf_stamped.header.stamp = timekeeper.GetSimTime();
+void ModelTfPublisher::PublishExtrapolated(double wall_time) {
+  std::lock_guard<std::mutex> lock(extrapolation_mutex_);
+  // the stamps only increase, a stalled simulation publishes nothing new
+  double time = clock_.Estimate(wall_time);
+  if (transforms_.empty() || time <= published_time_) {
+    return;
+  }
+  published_time_ = time;
 
-  // loop through the bodies to calculate TF, and ignores excluded bodies
-  for (unsigned int i = 0; i < GetModel()->bodies_.size(); i++) {
-    Body *body = GetModel()->bodies_[i];
-    bool is_excluded = false;
+  double dt = time - clock_.GetTime();
+  for (unsigned int i = 0; i < motions_.size(); i++) {
+    poses_[i] = motions_[i].At(dt);
+  }
+  FillTransforms(ros::Time(time));
 
-    for (unsigned int j = 0; j < excluded_bodies_.size(); j++) {
-      if (body == excluded_bodies_[j]) {
-        is_excluded = true;
-      }
-    }
+  // sent right away, the aggregator only flushes on the physics steps
+  tf_broadcaster.sendTransform(transforms_);
+}
 
-    if (is_excluded || body == reference_body_) {
-      continue;
-    }
+void ModelTfPublisher::FillTransforms(const ros::Time &stamp) {
+  // the world to ref. body TF
+  const b2Transform &r = poses_[0];
+
+  // loop through the bodies to calculate TF, the excluded bodies are not in
+  // published_bodies_
+  for (unsigned int i = 0; i < published_bodies_.size(); i++) {
+    geometry_msgs::TransformStamped &tf_stamped = transforms_[i];
+    tf_stamped.header.stamp = stamp;
 
     // Get transformation of body w.r.t to the world
-    const b2Transform &b = body->physics_body_->GetTransform();
-    Eigen::Matrix3f body_tf_m;
-    body_tf_m << b.q.c, -b.q.s, b.p.x, b.q.s, b.q.c, b.p.y, 0, 0, 1;
+    const b2Transform &b = poses_[i + 1];
 
     // this calculates the transformation from the reference body to the
     // other body. It is needed because Box2D only provides position and
-    // angle of bodies w.r.t to the world
-    rel_tf = ref_tf_m.inverse() * body_tf_m;
+    // angle of bodies w.r.t to the world. The rigid transform is inverted
+    // directly, without a general 3x3 matrix inverse
+    b2Transform rel_tf = b2MulT(r, b);
+    double yaw = atan2(rel_tf.q.s, rel_tf.q.c);
 
-    // obtain the yaw from the transformation matrice
-    double cosine = rel_tf(0, 0);
-    double sine = rel_tf(1, 0);
-    double yaw = atan2(sine, cosine);
-
-    // publish TF
-    tf_stamped.header.frame_id =
-        tf::resolve("", GetModel()->NameSpaceTF(reference_body_->name_));
-    tf_stamped.child_frame_id =
-        tf::resolve("", GetModel()->NameSpaceTF(body->name_));
-    tf_stamped.transform.translation.x = rel_tf(0, 2);
-    tf_stamped.transform.translation.y = rel_tf(1, 2);
+    tf_stamped.transform.translation.x = rel_tf.p.x;
+    tf_stamped.transform.translation.y = rel_tf.p.y;
     tf_stamped.transform.translation.z = 0;
     tf::Quaternion q;
     q.setRPY(0, 0, yaw);
@@ -165,18 +250,15 @@ void ModelTfPublisher::BeforePhysicsStep(const Timekeeper &timekeeper) {
     tf_stamped.transform.rotation.y = q.y();
     tf_stamped.transform.rotation.z = q.z();
     tf_stamped.transform.rotation.w = q.w();
-
-    tf_broadcaster.sendTransform(tf_stamped);
   }
 
-  // publish world TF if necessary
+  // world TF if necessary, after the bodies
   if (publish_tf_world_) {
-    const b2Vec2 &p = reference_body_->physics_body_->GetPosition();
-    double yaw = reference_body_->physics_body_->GetAngle();
+    const b2Vec2 &p = r.p;
+    double yaw = r.q.GetAngle();
 
-    tf_stamped.header.frame_id = world_frame_id_;
-    tf_stamped.child_frame_id =
-        tf::resolve("", GetModel()->NameSpaceTF(reference_body_->name_));
+    geometry_msgs::TransformStamped &tf_stamped = transforms_.back();
+    tf_stamped.header.stamp = stamp;
     tf_stamped.transform.translation.x = p.x;
     tf_stamped.transform.translation.y = p.y;
     tf_stamped.transform.translation.z = 0;
@@ -186,11 +268,11 @@ void ModelTfPublisher::BeforePhysicsStep(const Timekeeper &timekeeper) {
     tf_stamped.transform.rotation.y = q.y();
     tf_stamped.transform.rotation.z = q.z();
     tf_stamped.transform.rotation.w = q.w();
-
-    tf_broadcaster.sendTransform(tf_stamped);
   }
 }
 };
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::ModelTfPublisher,
-                       flatland_server::ModelPlugin)
\ No newline at end of file
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::ModelTfPublisher,
+                         flatland_server::ModelPlugin)
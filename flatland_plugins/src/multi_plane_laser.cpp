@@ -0,0 +1,403 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 multi_plane_laser.cpp
+ * @brief	 Multi plane laser plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/multi_plane_laser.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/geometry.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/sensor_scheduler.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/tf_aggregator.h>
+#include <flatland_server/yaml_reader.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void MultiPlaneLaser::OnInitialize(const YAML::Node &config) {
+  ParseParameters(config);
+
+  SetUpdateRate(update_rate_);
+
+  // the ray ends are precomputed in the body frame, the mount never moves
+  double c = cos(origin_.theta);
+  double s = sin(origin_.theta);
+
+  unsigned int num_rays = ray_plane_.size();
+  std::string frame_id = tf::resolve("", GetModel()->NameSpaceTF(frame_id_));
+
+  // pre-calculate the ray ends of all planes in the body frame. A ray of a
+  // tilted plane reaches range * cos(elevation) on the ground plane, so the
+  // Box2D fraction of a hit is also its fraction of the range along the ray
+  body_points_x_.resize(num_rays);
+  body_points_y_.resize(num_rays);
+  world_points_x_.resize(num_rays);
+  world_points_y_.resize(num_rays);
+  cos_angles_.resize(num_rays);
+  sin_angles_.resize(num_rays);
+  for (auto &plane : planes_) {
+    double reach = range_ * cos(plane.elevation);
+    for (unsigned int j = 0; j < plane.num_rays; j++) {
+      unsigned int i = plane.first_ray + j;
+      double angle = plane.scan.angle_min + j * plane.scan.angle_increment;
+      cos_angles_[i] = cos(angle);
+      sin_angles_[i] = sin(angle);
+      double x = reach * cos_angles_[i], y = reach * sin_angles_[i];
+      body_points_x_[i] = c * x - s * y + origin_.x;
+      body_points_y_[i] = s * x + c * y + origin_.y;
+    }
+
+    plane.scan.time_increment = 0;
+    plane.scan.scan_time = 0;
+    plane.scan.range_min = 0;
+    plane.scan.range_max = range_;
+    plane.scan.ranges.resize(plane.num_rays);
+    plane.scan.intensities.resize(reflectance_layers_bits_ ? plane.num_rays
+                                                           : 0);
+    plane.scan.header.frame_id = frame_id;
+  }
+  ranges_.resize(num_rays);
+  intensities_.resize(num_rays, 0);
+
+  if (point_cloud_) {
+    // an organized cloud with one point per ray, rays without a hit are NAN
+    cloud_.header.frame_id = frame_id;
+    cloud_.height = 1;
+    cloud_.width = num_rays;
+    cloud_.is_dense = false;
+    sensor_msgs::PointCloud2Modifier modifier(cloud_);
+    modifier.setPointCloud2Fields(4, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                  "y", 1, sensor_msgs::PointField::FLOAT32, "z",
+                                  1, sensor_msgs::PointField::FLOAT32,
+                                  "intensity", 1,
+                                  sensor_msgs::PointField::FLOAT32);
+    modifier.resize(num_rays);
+    cloud_publisher_ = nh_.advertise<sensor_msgs::PointCloud2>(topic_, 1);
+  } else {
+    for (auto &plane : planes_) {
+      plane.publisher =
+          nh_.advertise<sensor_msgs::LaserScan>(topic_ + "_" + plane.name, 1);
+    }
+  }
+
+  // Broadcast transform between the body and laser
+  tf::Quaternion q;
+  q.setRPY(0, 0, origin_.theta);
+
+  laser_tf_.header.frame_id =
+      tf::resolve("", GetModel()->NameSpaceTF(body_->GetName()));
+  laser_tf_.child_frame_id = frame_id;
+  laser_tf_.transform.translation.x = origin_.x;
+  laser_tf_.transform.translation.y = origin_.y;
+  laser_tf_.transform.translation.z = 0;
+  laser_tf_.transform.rotation.x = q.x();
+  laser_tf_.transform.rotation.y = q.y();
+  laser_tf_.transform.rotation.z = q.z();
+  laser_tf_.transform.rotation.w = q.w();
+
+  // the mount never moves, it is published once with the aggregator
+  if (broadcast_tf_ && TfAggregator::IsEnabled()) {
+    laser_tf_.header.stamp = ros::Time::now();
+    TfAggregator::Get().SendStatic(laser_tf_);
+  }
+}
+
+void MultiPlaneLaser::SetDegradations(uint32_t degradations) {
+  SetUpdateRate(degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_);
+}
+
+void MultiPlaneLaser::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  // only compute and publish when the number of subscribers is not zero
+  if (HasSubscribers()) {
+    ros::Time stamp = timekeeper.GetSimTime();
+    PrepareScan();
+
+    if (world_batch_ && GetSensorScheduler()) {
+      SensorScheduler::Job job;
+      job.count = ranges_.size();
+      job.cast = [this](unsigned int begin, unsigned int end) {
+        CastRays(begin, end);
+      };
+      job.done = [this, stamp] { FinishScan(stamp); };
+      GetSensorScheduler()->Submit(job);
+    } else {
+      SensorExecutor::Get().ParallelFor(
+          ranges_.size(), 0,
+          [this](unsigned int begin, unsigned int end) {
+            CastRays(begin, end);
+          },
+          priority_);
+      FinishScan(stamp);
+    }
+  }
+
+  if (broadcast_tf_ && !TfAggregator::IsEnabled()) {
+    laser_tf_.header.stamp = timekeeper.GetSimTime();
+    tf_broadcaster_.sendTransform(laser_tf_);
+  }
+}
+
+bool MultiPlaneLaser::HasSubscribers() const {
+  if (point_cloud_) {
+    return IsSubscribed(cloud_publisher_);
+  }
+  for (const auto &plane : planes_) {
+    if (IsSubscribed(plane.publisher)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MultiPlaneLaser::PrepareScan() {
+  // one transform for the rays of all planes
+  const b2Transform &t = body_->GetPhysicsBody()->GetTransform();
+  RotateTranslate body_to_world = {t.p.x, t.p.y, t.q.c, t.q.s};
+  Geometry::TransformPoints(body_to_world, body_points_x_.data(),
+                            body_points_y_.data(), body_points_x_.size(),
+                            world_points_x_.data(), world_points_y_.data());
+  laser_origin_point_ =
+      Geometry::Transform(b2Vec2(origin_.x, origin_.y), body_to_world);
+}
+
+void MultiPlaneLaser::CastRays(unsigned int begin, unsigned int end) {
+  b2World *physics_world = GetModel()->GetPhysicsWorld();
+  const b2RayCastSnapshot *snapshot = GetRayCastSnapshot();
+  for (unsigned int i = begin; i < end; i++) {
+    const Plane &plane = planes_[ray_plane_[i]];
+    b2Vec2 laser_point(world_points_x_[i], world_points_y_[i]);
+
+    MultiPlaneLaserCallback cb(plane.layers_bits, reflectance_layers_bits_);
+    if (snapshot) {
+      snapshot->RayCast(&cb, laser_origin_point_, laser_point);
+    } else {
+      physics_world->RayCast(&cb, laser_origin_point_, laser_point);
+    }
+
+    ranges_[i] = cb.did_hit_ ? cb.fraction_ * range_ : NAN;
+    intensities_[i] = cb.intensity_;
+  }
+}
+
+void MultiPlaneLaser::FinishScan(const ros::Time &stamp) {
+  // the noise generator is not thread safe, add the noise in one bulk call
+  noise_.Add(ranges_.data(), ranges_.size());
+
+  if (point_cloud_) {
+    cloud_.header.stamp = stamp;
+    sensor_msgs::PointCloud2Iterator<float> it(cloud_, "x");
+    for (unsigned int i = 0; i < ranges_.size(); i++, ++it) {
+      double elevation = planes_[ray_plane_[i]].elevation;
+      float r = ranges_[i];
+      float d = r * cos(elevation);  // NAN propagates to all coordinates
+      it[0] = d * cos_angles_[i];
+      it[1] = d * sin_angles_[i];
+      it[2] = r * sin(elevation);
+      it[3] = intensities_[i];
+    }
+    PublishCounted(cloud_publisher_, cloud_);
+    return;
+  }
+
+  // only the planes with subscribers are copied and serialized
+  for (auto &plane : planes_) {
+    PublishLazily(plane.publisher, plane.scan,
+                  [&](sensor_msgs::LaserScan &scan) {
+                    std::copy(ranges_.begin() + plane.first_ray,
+                              ranges_.begin() + plane.first_ray +
+                                  plane.num_rays,
+                              scan.ranges.begin());
+                    if (reflectance_layers_bits_) {
+                      std::copy(intensities_.begin() + plane.first_ray,
+                                intensities_.begin() + plane.first_ray +
+                                    plane.num_rays,
+                                scan.intensities.begin());
+                    }
+                    scan.header.stamp = stamp;
+                  });
+  }
+}
+
+float MultiPlaneLaserCallback::ReportFixture(b2Fixture *fixture,
+                                             const b2Vec2 &point,
+                                             const b2Vec2 &normal,
+                                             float fraction) {
+  uint32_t category_bits = fixture->GetFilterData().categoryBits;
+  // only register hit in the layers of the plane
+  if (!(category_bits & layers_bits_)) {
+    return -1.0f;  // return -1 to ignore this hit
+  }
+
+  // Don't return on hitting sensors... they're not real
+  if (fixture->IsSensor()) return -1.0f;
+
+  intensity_ = (category_bits & reflectance_layers_bits_) ? 255.0 : 0.0;
+  did_hit_ = true;
+  fraction_ = fraction;
+
+  return fraction;
+}
+
+void MultiPlaneLaser::ParseParameters(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string body_name = reader.Get<std::string>("body");
+  topic_ = reader.Get<std::string>("topic", "scan");
+  frame_id_ = reader.Get<std::string>("frame", GetName());
+  broadcast_tf_ = reader.Get<bool>("broadcast_tf", true);
+  update_rate_ = reader.Get<double>("update_rate",
+                                    std::numeric_limits<double>::infinity());
+  origin_ = reader.GetPose("origin", Pose(0, 0, 0));
+  range_ = reader.Get<double>("range");
+  noise_std_dev_ = reader.Get<double>("noise_std_dev", 0);
+  int noise_seed = reader.Get<int>("noise_seed", -1);
+  world_batch_ = reader.Get<bool>("world_batch", true);
+  priority_ = SensorExecutor::ParsePriority(
+      reader.Get<std::string>("task_priority", "normal"));
+
+  std::string output = reader.Get<std::string>("output", "scans");
+  if (output != "scans" && output != "cloud") {
+    throw YAMLException("Invalid \"output\" param " + Q(output) +
+                        ", must be \"scans\" or \"cloud\"");
+  }
+  point_cloud_ = output == "cloud";
+
+  body_ = GetModel()->GetBody(body_name);
+  if (!body_) {
+    throw YAMLException("Cannot find body with name " + body_name);
+  }
+
+  YamlReader planes_reader = reader.Subnode("planes", YamlReader::LIST);
+  if (planes_reader.NodeSize() <= 0) {
+    throw YAMLException(
+        "Invalid \"planes\", must be a list of at least size 1");
+  }
+
+  planes_.clear();
+  ray_plane_.clear();
+  for (int p = 0; p < planes_reader.NodeSize(); p++) {
+    YamlReader plane_reader = planes_reader.Subnode(p, YamlReader::MAP);
+    Plane plane;
+    plane.name = plane_reader.Get<std::string>("name");
+    plane.elevation = plane_reader.Get<double>("elevation", 0);
+
+    YamlReader angle_reader = plane_reader.Subnode("angle", YamlReader::MAP);
+    double min_angle = angle_reader.Get<double>("min");
+    double max_angle = angle_reader.Get<double>("max");
+    double increment = angle_reader.Get<double>("increment");
+    angle_reader.EnsureAccessedAllKeys();
+
+    std::vector<std::string> layers =
+        plane_reader.GetList<std::string>("layers", {"all"}, -1, -1);
+    plane_reader.EnsureAccessedAllKeys();
+
+    if (max_angle < min_angle) {
+      throw YAMLException("Invalid \"angle\" params of plane " +
+                          Q(plane.name) + ", must have max > min");
+    }
+
+    if (std::fabs(plane.elevation) >= M_PI / 2) {
+      throw YAMLException("Invalid \"elevation\" of plane " + Q(plane.name) +
+                          ", must be within (-pi/2, pi/2)");
+    }
+
+    std::vector<std::string> invalid_layers;
+    plane.layers_bits =
+        GetModel()->GetCfr()->GetCategoryBits(layers, &invalid_layers);
+    if (!invalid_layers.empty()) {
+      throw YAMLException("Cannot find layer(s): {" +
+                          boost::algorithm::join(invalid_layers, ",") + "}");
+    }
+
+    plane.num_rays = std::lround((max_angle - min_angle) / increment) + 1;
+    plane.first_ray = ray_plane_.size();
+    plane.scan.angle_min = min_angle;
+    plane.scan.angle_max = max_angle;
+    plane.scan.angle_increment = increment;
+    ray_plane_.resize(ray_plane_.size() + plane.num_rays, planes_.size());
+    planes_.push_back(plane);
+  }
+  reader.EnsureAccessedAllKeys();
+
+  std::vector<std::string> reflectance_layer = {"reflectance"};
+  std::vector<std::string> invalid_layers;
+  reflectance_layers_bits_ =
+      GetModel()->GetCfr()->GetCategoryBits(reflectance_layer, &invalid_layers);
+
+  // init the noise generator, a negative seed picks a random one, which is
+  // recorded and replayed by the Recorder
+  if (noise_seed < 0) {
+    noise_seed = RandomSeed() & 0x7fffffff;
+  }
+  noise_ = GaussianNoise(noise_std_dev_, noise_seed);
+
+  ROS_DEBUG_NAMED("MultiPlaneLaser",
+                  "MultiPlaneLaser %s params: topic(%s) body(%s, %p) "
+                  "origin(%f,%f,%f) frame_id(%s) broadcast_tf(%d) "
+                  "update_rate(%f) range(%f) noise_std_dev(%f) planes(%lu) "
+                  "rays(%lu) output(%s)",
+                  GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
+                  origin_.x, origin_.y, origin_.theta, frame_id_.c_str(),
+                  broadcast_tf_, update_rate_, range_, noise_std_dev_,
+                  planes_.size(), ray_plane_.size(), output.c_str());
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::MultiPlaneLaser,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::MultiPlaneLaser,
+                         flatland_server::ModelPlugin)
@@ -0,0 +1,99 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 odometry_noise.cpp
+ * @brief	 Gaussian noise of the odometry of the drive plugins
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+
+#include "flatland_plugins/odometry_noise.h"
+#include <flatland_server/state_hash.h>
+#include <sstream>
+
+namespace flatland_plugins {
+
+uint64_t OdometryNoise::GetState() const {
+  // the standard engines and distributions only expose their state as text
+  std::ostringstream state;
+  state << rng_;
+  for (const auto& gen : noise_gen_) {
+    state << ' ' << gen;
+  }
+  flatland_server::StateHash hash;
+  hash.Add(state.str());
+  return hash.Get();
+}
+
+void OdometryNoise::Configure(const std::vector<double>& pose_noise,
+                              const std::vector<double>& twist_noise,
+                              unsigned int seed) {
+  rng_ = std::default_random_engine(seed);
+  enabled_ = false;
+  for (unsigned int i = 0; i < 3; i++) {
+    // variance is standard deviation squared
+    noise_gen_[i] =
+        std::normal_distribution<double>(0.0, sqrt(pose_noise[i]));
+    noise_gen_[i + 3] =
+        std::normal_distribution<double>(0.0, sqrt(twist_noise[i]));
+    enabled_ = enabled_ || pose_noise[i] != 0 || twist_noise[i] != 0;
+  }
+}
+
+void OdometryNoise::Apply(const nav_msgs::Odometry& ground_truth, double yaw,
+                          nav_msgs::Odometry* odom) {
+  odom->pose.pose = ground_truth.pose.pose;
+  odom->twist.twist = ground_truth.twist.twist;
+  if (!enabled_) return;
+
+  // drawn in the same order as the channels so that a seed always gives the
+  // same odometry
+  std::array<double, 6> noise;
+  for (unsigned int i = 0; i < noise.size(); i++) {
+    noise[i] = noise_gen_[i](rng_);
+  }
+
+  odom->pose.pose.position.x += noise[POSE_X];
+  odom->pose.pose.position.y += noise[POSE_Y];
+  odom->pose.pose.orientation = QuaternionMsgFromYaw(yaw + noise[POSE_YAW]);
+  odom->twist.twist.linear.x += noise[TWIST_X];
+  odom->twist.twist.linear.y += noise[TWIST_Y];
+  odom->twist.twist.angular.z += noise[TWIST_YAW];
+}
+};  // namespace flatland_plugins
@@ -0,0 +1,604 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 python_bindings.cpp
+ * @brief	 Python bindings of an embedded world
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/diff_drive.h>
+#include <flatland_plugins/laser.h>
+#include <flatland_plugins/top_down_view.h>
+#include <flatland_plugins/tricycle_drive.h>
+#include <flatland_server/body.h>
+#include <flatland_server/task_pool.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <geometry_msgs/Twist.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <ros/ros.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace py = pybind11;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+namespace {
+
+/// Linear and angular velocity commanded to the drives of a model
+typedef std::map<std::string, std::pair<double, double>> Actions;
+
+/**
+ * @brief Initialize ROS for the worlds of the process, once
+ */
+void InitRos() {
+  if (!ros::isInitialized()) {
+    ros::M_string remappings;
+    ros::init(remappings, "flatland_py",
+              ros::init_options::AnonymousName |
+                  ros::init_options::NoSigintHandler);
+  }
+}
+
+/**
+ * @return A read only array onto a buffer, without copying
+ * @param[in] data The buffer
+ * @param[in] shape The shape of the array, row major
+ * @param[in] base The Python object owning the buffer, kept alive by the
+ * array
+ */
+template <typename T>
+py::array View(const T *data, const std::vector<size_t> &shape,
+               py::handle base) {
+  py::array_t<T> view(shape, data, base);
+  view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
+
+/**
+ * @brief Send a twist to a plugin if it is a DiffDrive or TricycleDrive
+ * @param[in] plugin The plugin
+ * @param[in] v Linear velocity
+ * @param[in] omega Angular velocity
+ * @return If the plugin is a drive
+ */
+bool SendTwist(ModelPlugin *plugin, double v, double omega) {
+  geometry_msgs::Twist twist;
+  twist.linear.x = v;
+  twist.angular.z = omega;
+  if (DiffDrive *drive = dynamic_cast<DiffDrive *>(plugin)) {
+    drive->TwistCallback(twist);
+    return true;
+  }
+  if (TricycleDrive *drive = dynamic_cast<TricycleDrive *>(plugin)) {
+    drive->TwistCallback(twist);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Find a laser and make it scan without subscribers
+ * @param[in] world The world
+ * @param[in] model Name of the model
+ * @param[in] plugin Name of the Laser plugin
+ * @return The laser, nullptr if there is none
+ */
+Laser *ObserveLaser(World *world, const std::string &model,
+                    const std::string &plugin) {
+  for (const auto &p : world->plugin_manager_.model_plugins_) {
+    Laser *laser = dynamic_cast<Laser *>(p.get());
+    if (laser != nullptr && laser->GetName() == plugin &&
+        laser->GetModel()->GetName() == model) {
+      laser->observed_ = true;
+      return laser;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * A world loaded headless and stepped by the Python process. The arrays it
+ * returns are read only views onto the buffers of the world, they are
+ * updated in place by each step and stay valid until models are added or
+ * removed, see generation
+ */
+class Simulation {
+ public:
+  /**
+   * @brief Load the world, initializes ROS if needed, throws Exception
+   * @param[in] world_path Path to the world yaml file
+   * @param[in] step_size Simulated seconds per step
+   */
+  Simulation(const std::string &world_path, double step_size) {
+    InitRos();
+    world_.reset(World::MakeWorld(world_path, "", true));
+    timekeeper_.reset(new Timekeeper());
+    timekeeper_->SetMaxStepSize(step_size);
+  }
+
+  /**
+   * @brief Return the world to its state after loading, as the reset_world
+   * service. The simulation time keeps running
+   */
+  void Reset() { world_->Restore(world_->snapshot_); }
+
+  /**
+   * @brief Command the drives and step the world
+   * @param[in] actions (v, omega) by model name, applied to its DiffDrive and
+   * TricycleDrive plugins as a twist, the others keep their last command
+   * @param[in] steps Number of steps
+   */
+  void Step(const Actions &actions, unsigned int steps) {
+    for (const auto &action : actions) {
+      if (world_->GetModel(action.first) == nullptr) {
+        throw py::key_error("no model named \"" + action.first + "\"");
+      }
+    }
+    if (!actions.empty()) {
+      for (const auto &plugin : world_->plugin_manager_.model_plugins_) {
+        auto it = actions.find(plugin->GetModel()->GetName());
+        if (it != actions.end()) {
+          SendTwist(plugin.get(), it->second.first, it->second.second);
+        }
+      }
+    }
+
+    // the plugins do not call into Python, other Python threads may run
+    py::gil_scoped_release release;
+    for (unsigned int i = 0; i < steps; i++) {
+      world_->Update(*timekeeper_);
+    }
+  }
+
+  /**
+   * @return The simulation time in seconds
+   */
+  double GetTime() const { return timekeeper_->GetSimTime().toSec(); }
+
+  /**
+   * @return Incremented when a body is added or removed, the views returned
+   * before are then invalid
+   */
+  uint64_t GetGeneration() const {
+    return world_->plugin_manager_.body_states_.generation_;
+  }
+
+  /**
+   * @return "<model>/<body>" of the bodies, in the order of GetBodyStates
+   */
+  std::vector<std::string> GetBodyNames() const {
+    std::vector<std::string> names;
+    for (Body *body : world_->plugin_manager_.body_states_.bodies_) {
+      names.push_back(body->GetEntity()->GetName() + "/" + body->GetName());
+    }
+    return names;
+  }
+
+  /**
+   * @param[in] base The Python object of the simulation, kept alive by the
+   * views
+   * @return Views of x, y, angle, vx, vy and omega of the bodies
+   */
+  py::dict GetBodyStates(py::handle base) const {
+    const BodyStates &states = world_->plugin_manager_.body_states_;
+    std::vector<size_t> shape = {states.Size()};
+    py::dict views;
+    views["x"] = View(states.x_.data(), shape, base);
+    views["y"] = View(states.y_.data(), shape, base);
+    views["angle"] = View(states.angle_.data(), shape, base);
+    views["vx"] = View(states.vx_.data(), shape, base);
+    views["vy"] = View(states.vy_.data(), shape, base);
+    views["omega"] = View(states.omega_.data(), shape, base);
+    return views;
+  }
+
+  /**
+   * @brief Get the ranges of a laser, which from then on scans at its rate
+   * even without subscribers. The ranges are those of the latest scan
+   * @param[in] model Name of the model
+   * @param[in] plugin Name of the Laser plugin
+   * @param[in] base The Python object of the simulation, kept alive by the
+   * view
+   * @return View of the ranges
+   */
+  py::array GetRanges(const std::string &model, const std::string &plugin,
+                      py::handle base) {
+    Laser *laser = ObserveLaser(world_.get(), model, plugin);
+    if (laser == nullptr) {
+      throw py::key_error("no laser \"" + plugin + "\" in model \"" + model +
+                          "\"");
+    }
+    // pooled messages exchange their buffers with the scan on publishing
+    if (laser->message_pool_ > 0) {
+      throw py::value_error("laser \"" + model + "/" + plugin +
+                            "\" has a message_pool, its ranges move");
+    }
+    const std::vector<float> &ranges = laser->laser_scan_.ranges;
+    return View(ranges.data(), {ranges.size()}, base);
+  }
+
+  /**
+   * @brief Get the image of a TopDownView, which from then on is rendered at
+   * its rate even without subscribers
+   * @param[in] model Name of the model
+   * @param[in] plugin Name of the TopDownView plugin
+   * @param[in] base The Python object of the simulation, kept alive by the
+   * view
+   * @return View of the latest image, [height, width]
+   */
+  py::array GetTopDownView(const std::string &model, const std::string &plugin,
+                           py::handle base) {
+    for (const auto &p : world_->plugin_manager_.model_plugins_) {
+      TopDownView *view = dynamic_cast<TopDownView *>(p.get());
+      if (view != nullptr && view->GetName() == plugin &&
+          view->GetModel()->GetName() == model) {
+        view->observed_ = true;
+        return View(view->GetPixels(), {size_t(view->height_),
+                                        size_t(view->width_)}, base);
+      }
+    }
+    throw py::key_error("no top down view \"" + plugin + "\" in model \"" +
+                        model + "\"");
+  }
+
+ private:
+  std::unique_ptr<World> world_;  ///< the world
+  std::unique_ptr<Timekeeper> timekeeper_;  ///< the simulation time, made
+                                            /// once ROS is initialized
+};
+
+/**
+ * N copies of a world with one agent model each, stepped together on a pool
+ * of threads. The observations of all worlds are gathered into contiguous
+ * [N, ...] arrays, which are returned as read only views updated in place
+ * by each step. A world whose episode ended is reset at the end of the step,
+ * its observations are then the first of the next episode
+ */
+class VectorSimulation {
+ public:
+  /**
+   * @brief Load the worlds, throws Exception, KeyError for a missing model
+   * or laser
+   * @param[in] world_path Path to the world yaml file
+   * @param[in] num_worlds Number of worlds, world i in namespace world_<i>
+   * @param[in] model Name of the agent model
+   * @param[in] laser Name of the Laser plugin of the model, empty for none
+   * @param[in] step_size Simulated seconds per step
+   * @param[in] episode_steps Steps of an episode, 0 for no limit
+   * @param[in] end_on_collision End the episode when the model touches
+   * anything
+   * @param[in] threads Threads stepping the worlds besides the calling
+   * thread, -1 for one per hardware thread
+   */
+  VectorSimulation(const std::string &world_path, unsigned int num_worlds,
+                   const std::string &model, const std::string &laser,
+                   double step_size, unsigned int episode_steps,
+                   bool end_on_collision, int threads)
+      : model_(model),
+        laser_(laser),
+        episode_steps_(episode_steps),
+        end_on_collision_(end_on_collision) {
+    if (num_worlds == 0) {
+      throw py::value_error("num_worlds must be > 0");
+    }
+    InitRos();
+
+    envs_.resize(num_worlds);
+    for (unsigned int i = 0; i < num_worlds; i++) {
+      Env &env = envs_[i];
+      env.world.reset(
+          World::MakeWorld(world_path, "world_" + std::to_string(i), true));
+      env.timekeeper.reset(
+          new Timekeeper("world_" + std::to_string(i) + "/clock"));
+      env.timekeeper->SetMaxStepSize(step_size);
+      Find(&env);
+      if (env.model == nullptr) {
+        throw py::key_error("no model named \"" + model + "\"");
+      }
+      if (!laser_.empty() && env.laser == nullptr) {
+        throw py::key_error("no laser \"" + laser + "\" in model \"" + model +
+                            "\"");
+      }
+    }
+
+    beams_ = laser_.empty() ? 0 : envs_[0].laser->laser_scan_.ranges.size();
+    ranges_.assign(num_worlds * beams_, 0);
+    odometry_.assign(num_worlds * 6, 0);
+    commands_.assign(num_worlds * 2, 0);
+    dones_.reset(new bool[num_worlds]());
+
+    if (threads < 0) {
+      threads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+    pool_.reset(new TaskPool(std::min<unsigned int>(threads, num_worlds - 1)));
+    for (unsigned int i = 0; i < num_worlds; i++) {
+      Observe(i);
+    }
+  }
+
+  /**
+   * @brief Reset all worlds, see Simulation::Reset
+   */
+  void Reset() {
+    py::gil_scoped_release release;
+    pool_->Run(envs_.size(), [this](unsigned int i) {
+      Restore(i);
+      dones_[i] = false;
+      Observe(i);
+    });
+  }
+
+  /**
+   * @brief Command the drives of the agents and step all worlds once
+   * @param[in] actions (v, omega) of the agent of each world, [N, 2]
+   */
+  void Step(py::array_t<float, py::array::c_style | py::array::forcecast>
+                actions) {
+    if (actions.ndim() != 2 || actions.shape(0) != (ssize_t)envs_.size() ||
+        actions.shape(1) != 2) {
+      throw py::value_error("actions must be of shape [" +
+                            std::to_string(envs_.size()) + ", 2]");
+    }
+    std::memcpy(commands_.data(), actions.data(),
+                commands_.size() * sizeof(float));
+
+    // the worlds are independent, each one is only touched by one thread
+    py::gil_scoped_release release;
+    pool_->Run(envs_.size(), [this](unsigned int i) { StepWorld(i); });
+  }
+
+  /**
+   * @return Number of worlds
+   */
+  unsigned int Size() const { return envs_.size(); }
+
+  /**
+   * @param[in] base The Python object, kept alive by the view
+   * @return View of the latest ranges of the lasers, [N, beams]
+   */
+  py::array GetRanges(py::handle base) const {
+    return View(ranges_.data(), {envs_.size(), beams_}, base);
+  }
+
+  /**
+   * @param[in] base The Python object, kept alive by the view
+   * @return View of x, y, angle, vx, vy and omega of the first body of the
+   * agents, [N, 6]
+   */
+  py::array GetOdometry(py::handle base) const {
+    return View(odometry_.data(), {envs_.size(), 6}, base);
+  }
+
+  /**
+   * @param[in] base The Python object, kept alive by the view
+   * @return View of the worlds whose episode ended on the last step, [N]
+   */
+  py::array GetDones(py::handle base) const {
+    return View(dones_.get(), {envs_.size()}, base);
+  }
+
+ private:
+  /// A world and what is looked up in it
+  struct Env {
+    std::unique_ptr<World> world;            ///< the world
+    std::unique_ptr<Timekeeper> timekeeper;  ///< its simulation time
+    uint64_t generation = UINT64_MAX;  ///< body states generation of lookups
+    Model *model = nullptr;            ///< the agent
+    std::vector<ModelPlugin *> drives;  ///< drives of the agent
+    Laser *laser = nullptr;             ///< observed laser of the agent
+    unsigned int steps = 0;             ///< steps of the episode
+  };
+
+  std::string model_;            ///< name of the agent model
+  std::string laser_;            ///< name of the laser, empty for none
+  unsigned int episode_steps_;   ///< steps of an episode, 0 for no limit
+  bool end_on_collision_;        ///< end the episode on contacts
+  size_t beams_ = 0;             ///< ranges per scan
+  std::vector<Env> envs_;        ///< the worlds
+  std::vector<float> ranges_;    ///< [N, beams_]
+  std::vector<float> odometry_;  ///< [N, 6]
+  std::vector<float> commands_;  ///< [N, 2] of the current step
+  std::unique_ptr<bool[]> dones_;  ///< [N]
+  std::unique_ptr<TaskPool> pool_;  ///< steps the worlds
+
+  /**
+   * @brief Look up the agent, its drives and laser, again after models were
+   * added or removed, e.g. reloaded by a reset
+   */
+  void Find(Env *env) {
+    uint64_t generation = env->world->plugin_manager_.body_states_.generation_;
+    if (env->generation == generation) {
+      return;
+    }
+    env->generation = generation;
+    env->model = env->world->GetModel(model_);
+    env->drives.clear();
+    for (const auto &plugin : env->world->plugin_manager_.model_plugins_) {
+      if (plugin->GetModel() == env->model &&
+          (dynamic_cast<DiffDrive *>(plugin.get()) ||
+           dynamic_cast<TricycleDrive *>(plugin.get()))) {
+        env->drives.push_back(plugin.get());
+      }
+    }
+    env->laser = laser_.empty()
+                     ? nullptr
+                     : ObserveLaser(env->world.get(), model_, laser_);
+  }
+
+  /**
+   * @brief Step world i with its command, then reset it if its episode ended
+   */
+  void StepWorld(unsigned int i) {
+    Env &env = envs_[i];
+    for (ModelPlugin *drive : env.drives) {
+      SendTwist(drive, commands_[2 * i], commands_[2 * i + 1]);
+    }
+    env.world->Update(*env.timekeeper);
+    env.steps++;
+
+    dones_[i] = (episode_steps_ > 0 && env.steps >= episode_steps_) ||
+                (end_on_collision_ && InContact(env));
+    if (dones_[i]) {
+      Restore(i);
+    }
+    Observe(i);
+  }
+
+  /**
+   * @brief Return world i to its state after loading and start an episode
+   */
+  void Restore(unsigned int i) {
+    Env &env = envs_[i];
+    env.world->Restore(env.world->snapshot_);
+    env.steps = 0;
+    Find(&env);
+  }
+
+  /**
+   * @return If a body of the agent touches anything
+   */
+  bool InContact(const Env &env) const {
+    if (env.model == nullptr) {
+      return false;
+    }
+    for (Body *body : env.model->bodies_) {
+      for (b2ContactEdge *edge = body->physics_body_->GetContactList();
+           edge != nullptr; edge = edge->next) {
+        if (edge->contact->IsTouching()) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Copy the observations of world i into its rows
+   */
+  void Observe(unsigned int i) {
+    const Env &env = envs_[i];
+    float *odometry = &odometry_[6 * i];
+    if (env.model != nullptr && !env.model->bodies_.empty()) {
+      const BodyStates &states = env.world->plugin_manager_.body_states_;
+      const Body *body = env.model->bodies_[0];
+      Pose pose = states.GetPose(body);
+      b2Vec2 velocity = states.GetLinearVelocity(body);
+      odometry[0] = pose.x;
+      odometry[1] = pose.y;
+      odometry[2] = pose.theta;
+      odometry[3] = velocity.x;
+      odometry[4] = velocity.y;
+      odometry[5] = states.GetAngularVelocity(body);
+    }
+    if (env.laser != nullptr &&
+        env.laser->laser_scan_.ranges.size() == beams_) {
+      std::copy(env.laser->laser_scan_.ranges.begin(),
+                env.laser->laser_scan_.ranges.end(), &ranges_[beams_ * i]);
+    }
+  }
+};
+};  // namespace
+
+PYBIND11_MODULE(flatland_py, m) {
+  m.doc() = "Flatland worlds stepped from Python";
+
+  py::class_<Simulation>(m, "Simulation")
+      .def(py::init<const std::string &, double>(), py::arg("world_path"),
+           py::arg("step_size") = 0.005)
+      .def("reset", &Simulation::Reset)
+      .def("step", &Simulation::Step, py::arg("actions") = Actions(),
+           py::arg("steps") = 1)
+      .def_property_readonly("time", &Simulation::GetTime)
+      .def_property_readonly("generation", &Simulation::GetGeneration)
+      .def("body_names", &Simulation::GetBodyNames)
+      .def("body_states",
+           [](py::object self) {
+             return self.cast<Simulation &>().GetBodyStates(self);
+           })
+      .def("ranges",
+           [](py::object self, const std::string &model,
+              const std::string &plugin) {
+             return self.cast<Simulation &>().GetRanges(model, plugin, self);
+           },
+           py::arg("model"), py::arg("plugin"))
+      .def("top_down_view",
+           [](py::object self, const std::string &model,
+              const std::string &plugin) {
+             return self.cast<Simulation &>().GetTopDownView(model, plugin,
+                                                             self);
+           },
+           py::arg("model"), py::arg("plugin"));
+
+  py::class_<VectorSimulation>(m, "VectorSimulation")
+      .def(py::init<const std::string &, unsigned int, const std::string &,
+                    const std::string &, double, unsigned int, bool, int>(),
+           py::arg("world_path"), py::arg("num_worlds"), py::arg("model"),
+           py::arg("laser") = "", py::arg("step_size") = 0.005,
+           py::arg("episode_steps") = 0, py::arg("end_on_collision") = false,
+           py::arg("threads") = -1)
+      .def("reset", &VectorSimulation::Reset)
+      .def("step", &VectorSimulation::Step, py::arg("actions"))
+      .def("__len__", &VectorSimulation::Size)
+      .def_property_readonly(
+          "ranges",
+          [](py::object self) {
+            return self.cast<VectorSimulation &>().GetRanges(self);
+          })
+      .def_property_readonly(
+          "odometry",
+          [](py::object self) {
+            return self.cast<VectorSimulation &>().GetOdometry(self);
+          })
+      .def_property_readonly("dones", [](py::object self) {
+        return self.cast<VectorSimulation &>().GetDones(self);
+      });
+}
@@ -0,0 +1,291 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 range_array.cpp
+ * @brief	 Range sensor array plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/range_array.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/sensor_scheduler.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <tf/tf.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void RangeArray::OnInitialize(const YAML::Node &config) {
+  ParseParameters(config);
+
+  SetUpdateRate(update_rate_);
+
+  ray_filter_.maskBits = layers_bits_;
+
+  // pre-calculate the rays of all sensors in the body frame, the rays of a
+  // sensor spread evenly over its cone, a single ray is on the cone axis
+  ray_origins_.clear();
+  ray_ends_.clear();
+  for (const auto &sensor : sensors_) {
+    for (unsigned int j = 0; j < sensor.num_rays; j++) {
+      double angle = sensor.origin.theta;
+      if (sensor.num_rays > 1) {
+        angle += -sensor.half_angle +
+                 j * 2 * sensor.half_angle / (sensor.num_rays - 1);
+      }
+      b2Vec2 origin(sensor.origin.x, sensor.origin.y);
+      ray_origins_.push_back(origin);
+      ray_ends_.push_back(origin + sensor.range *
+                                       b2Vec2(cos(angle), sin(angle)));
+    }
+  }
+  inputs_.resize(ray_origins_.size());
+  hits_.resize(ray_origins_.size());
+
+  // everything but the ranges never changes
+  ranges_.header.frame_id =
+      tf::resolve("", GetModel()->NameSpaceTF(body_->GetName()));
+  for (const auto &sensor : sensors_) {
+    geometry_msgs::Pose2D origin;
+    origin.x = sensor.origin.x;
+    origin.y = sensor.origin.y;
+    origin.theta = sensor.origin.theta;
+    ranges_.names.push_back(sensor.name);
+    ranges_.origins.push_back(origin);
+    ranges_.field_of_view.push_back(2 * sensor.half_angle);
+    ranges_.min_range.push_back(sensor.min_range);
+    ranges_.max_range.push_back(sensor.range);
+  }
+  ranges_.ranges.resize(sensors_.size());
+
+  ranges_publisher_ = nh_.advertise<flatland_msgs::RangeArray>(topic_, 1);
+}
+
+void RangeArray::SetDegradations(uint32_t degradations) {
+  SetUpdateRate(degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_);
+}
+
+void RangeArray::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  // only compute and publish when the number of subscribers is not zero
+  if (!IsSubscribed(ranges_publisher_)) {
+    return;
+  }
+
+  ros::Time stamp = timekeeper.GetSimTime();
+  PrepareRays();
+
+  if (world_batch_ && GetSensorScheduler()) {
+    SensorScheduler::Job job;
+    job.count = inputs_.size();
+    job.cast = [this](unsigned int begin, unsigned int end) {
+      CastRays(begin, end);
+    };
+    job.done = [this, stamp] { FinishRanges(stamp); };
+    GetSensorScheduler()->Submit(job);
+  } else {
+    // the rays of a whole array are few, a single batch is cheaper than
+    // splitting it over the sensor executor
+    CastRays(0, inputs_.size());
+    FinishRanges(stamp);
+  }
+}
+
+void RangeArray::PrepareRays() {
+  const b2Transform &t = body_->GetPhysicsBody()->GetTransform();
+  for (unsigned int i = 0; i < inputs_.size(); i++) {
+    inputs_[i].p1 = b2Mul(t, ray_origins_[i]);
+    inputs_[i].p2 = b2Mul(t, ray_ends_[i]);
+    inputs_[i].maxFraction = 1.0f;
+  }
+}
+
+void RangeArray::CastRays(unsigned int begin, unsigned int end) {
+  // one traversal of the broadphase for the rays of all sensors, on the
+  // snapshot of the world while they are pipelined with the physics step
+  const b2RayCastSnapshot *snapshot = GetRayCastSnapshot();
+  if (snapshot) {
+    snapshot->RayCastBatch(inputs_.data() + begin, end - begin, ray_filter_,
+                           hits_.data() + begin);
+  } else {
+    GetModel()->GetPhysicsWorld()->RayCastBatch(inputs_.data() + begin,
+                                                end - begin, ray_filter_,
+                                                hits_.data() + begin);
+  }
+}
+
+void RangeArray::FinishRanges(const ros::Time &stamp) {
+  const float inf = std::numeric_limits<float>::infinity();
+  for (unsigned int s = 0; s < sensors_.size(); s++) {
+    const Sensor &sensor = sensors_[s];
+    float fraction = inf;
+    for (unsigned int i = sensor.first_ray;
+         i < sensor.first_ray + sensor.num_rays; i++) {
+      if (hits_[i].fixture) {
+        fraction = std::min(fraction, hits_[i].fraction);
+      }
+    }
+    ranges_.ranges[s] = fraction * sensor.range;
+  }
+
+  // the noise generator is not thread safe, add the noise in one bulk call,
+  // it leaves the sensors without a detection at inf
+  noise_.Add(ranges_.ranges.data(), ranges_.ranges.size());
+  for (unsigned int s = 0; s < sensors_.size(); s++) {
+    if (ranges_.ranges[s] < sensors_[s].min_range) {
+      ranges_.ranges[s] = -inf;
+    }
+  }
+
+  ranges_.header.stamp = stamp;
+  PublishCounted(ranges_publisher_, ranges_);
+}
+
+void RangeArray::ParseParameters(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string body_name = reader.Get<std::string>("body");
+  topic_ = reader.Get<std::string>("topic", "ranges");
+  update_rate_ = reader.Get<double>("update_rate",
+                                    std::numeric_limits<double>::infinity());
+  noise_std_dev_ = reader.Get<double>("noise_std_dev", 0);
+  int noise_seed = reader.Get<int>("noise_seed", -1);
+  world_batch_ = reader.Get<bool>("world_batch", true);
+  std::vector<std::string> layers =
+      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+
+  std::string radiation_type =
+      reader.Get<std::string>("radiation_type", "ultrasound");
+  if (radiation_type == "ultrasound") {
+    ranges_.radiation_type = flatland_msgs::RangeArray::ULTRASOUND;
+  } else if (radiation_type == "infrared") {
+    ranges_.radiation_type = flatland_msgs::RangeArray::INFRARED;
+  } else {
+    throw YAMLException("Invalid \"radiation_type\" param " +
+                        Q(radiation_type) +
+                        ", must be \"ultrasound\" or \"infrared\"");
+  }
+
+  body_ = GetModel()->GetBody(body_name);
+  if (!body_) {
+    throw YAMLException("Cannot find body with name " + body_name);
+  }
+
+  std::vector<std::string> invalid_layers;
+  layers_bits_ = GetModel()->GetCfr()->GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw YAMLException("Cannot find layer(s): {" +
+                        boost::algorithm::join(invalid_layers, ",") + "}");
+  }
+
+  YamlReader sensors_reader = reader.Subnode("sensors", YamlReader::LIST);
+  if (sensors_reader.NodeSize() <= 0) {
+    throw YAMLException(
+        "Invalid \"sensors\", must be a list of at least size 1");
+  }
+
+  sensors_.clear();
+  unsigned int num_rays = 0;
+  for (int i = 0; i < sensors_reader.NodeSize(); i++) {
+    YamlReader sensor_reader = sensors_reader.Subnode(i, YamlReader::MAP);
+    Sensor sensor;
+    sensor.name = sensor_reader.Get<std::string>("name");
+    sensor.origin = sensor_reader.GetPose("origin", Pose(0, 0, 0));
+    sensor.half_angle = sensor_reader.Get<double>("half_angle");
+    int rays = sensor_reader.Get<int>("rays", 3);
+    sensor.range = sensor_reader.Get<double>("range");
+    sensor.min_range = sensor_reader.Get<double>("min_range", 0);
+    sensor_reader.EnsureAccessedAllKeys();
+
+    if (sensor.half_angle < 0 || sensor.half_angle >= M_PI) {
+      throw YAMLException("Invalid \"half_angle\" of sensor " +
+                          Q(sensor.name) + ", must be within [0, pi)");
+    }
+
+    if (rays < 1) {
+      throw YAMLException("Invalid \"rays\" of sensor " + Q(sensor.name) +
+                          ", must be at least 1");
+    }
+
+    if (sensor.min_range < 0 || sensor.range <= sensor.min_range) {
+      throw YAMLException("Invalid \"range\" of sensor " + Q(sensor.name) +
+                          ", must have range > min_range >= 0");
+    }
+
+    sensor.num_rays = rays;
+    sensor.first_ray = num_rays;
+    num_rays += sensor.num_rays;
+    sensors_.push_back(sensor);
+  }
+  reader.EnsureAccessedAllKeys();
+
+  // init the noise generator, a negative seed picks a random one, which is
+  // recorded and replayed by the Recorder
+  if (noise_seed < 0) {
+    noise_seed = RandomSeed() & 0x7fffffff;
+  }
+  noise_ = GaussianNoise(noise_std_dev_, noise_seed);
+
+  ROS_DEBUG_NAMED("RangeArray",
+                  "RangeArray %s params: topic(%s) body(%s, %p) "
+                  "update_rate(%f) noise_std_dev(%f) radiation_type(%s) "
+                  "sensors(%lu) rays(%u)",
+                  GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
+                  update_rate_, noise_std_dev_, radiation_type.c_str(),
+                  sensors_.size(), num_rays);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::RangeArray,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::RangeArray,
+                         flatland_server::ModelPlugin)
@@ -0,0 +1,73 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 robot_odometry.cpp
+ * @brief	 Converts the odometry of the drive plugins to fleet records
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "flatland_plugins/robot_odometry.h"
+#include <tf/tf.h>
+
+namespace flatland_plugins {
+
+flatland_msgs::RobotOdometry MakeRobotOdometry(
+    const nav_msgs::Odometry& ground_truth, const nav_msgs::Odometry& odom) {
+  flatland_msgs::RobotOdometry record;
+  record.frame_id = ground_truth.header.frame_id;
+  record.child_frame_id = ground_truth.child_frame_id;
+
+  record.pose.x = ground_truth.pose.pose.position.x;
+  record.pose.y = ground_truth.pose.pose.position.y;
+  record.pose.theta = tf::getYaw(ground_truth.pose.pose.orientation);
+  record.linear.x = ground_truth.twist.twist.linear.x;
+  record.linear.y = ground_truth.twist.twist.linear.y;
+  record.angular = ground_truth.twist.twist.angular.z;
+
+  record.odom_pose.x = odom.pose.pose.position.x;
+  record.odom_pose.y = odom.pose.pose.position.y;
+  record.odom_pose.theta = tf::getYaw(odom.pose.pose.orientation);
+  record.odom_linear.x = odom.twist.twist.linear.x;
+  record.odom_linear.y = odom.twist.twist.linear.y;
+  record.odom_angular = odom.twist.twist.angular.z;
+  return record;
+}
+};  // namespace flatland_plugins
@@ -0,0 +1,261 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 scenario_script.cpp
+ * @brief	 Runs Lua scenario scripts as coroutines at sim time deadlines
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/scenario_script.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void ScenarioScript::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string script = reader.Get<std::string>("script", "");
+  std::string code = reader.Get<std::string>("code", "");
+  reader.EnsureAccessedAllKeys();
+
+  if (script.empty() == code.empty()) {
+    throw YAMLException("Exactly one of \"script\" and \"code\" must be given");
+  }
+
+  L_ = luaL_newstate();
+  luaL_openlibs(L_);
+  const luaL_Reg functions[] = {{"time", LuaTime},
+                                {"sleep", LuaSleep},
+                                {"wait_until", LuaWaitUntil},
+                                {"start", LuaStart},
+                                {"spawn_model", LuaSpawnModel},
+                                {"delete_model", LuaDeleteModel},
+                                {"move_model", LuaMoveModel},
+                                {"get_pose", LuaGetPose},
+                                {"set_velocity", LuaSetVelocity},
+                                {"log", LuaLog}};
+  for (const luaL_Reg &function : functions) {
+    lua_pushlightuserdata(L_, this);
+    lua_pushcclosure(L_, function.func, 1);
+    lua_setglobal(L_, function.name);
+  }
+
+  int error;
+  if (!script.empty()) {
+    boost::filesystem::path path(script);
+    if (path.is_relative()) {
+      path = world_->world_yaml_dir_ / path;
+    }
+    error = luaL_loadfile(L_, path.string().c_str());
+  } else {
+    error = luaL_loadbuffer(L_, code.data(), code.size(), name_.c_str());
+  }
+  if (error) {
+    std::string msg = lua_tostring(L_, -1);
+    throw YAMLException("Invalid scenario script in " + Q(name_) + ", " + msg);
+  }
+
+  // the script starts at the first step
+  time_ = 0;
+  Start(L_, 0);
+}
+
+void ScenarioScript::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  time_ = timekeeper.GetSimTime().toSec();
+
+  // the coroutines started or yielding during the pass are resumed at the
+  // next step at the earliest, so that sleep(0) cannot spin
+  due_.clear();
+  auto end = waiting_.upper_bound(time_);
+  for (auto it = waiting_.begin(); it != end; ++it) {
+    due_.push_back(it->second);
+  }
+  waiting_.erase(waiting_.begin(), end);
+
+  for (const Thread &thread : due_) {
+    Resume(thread);
+  }
+}
+
+ScenarioScript::~ScenarioScript() {
+  // the coroutines are collected with the state
+  if (L_ != nullptr) {
+    lua_close(L_);
+  }
+}
+
+void ScenarioScript::Start(lua_State *L, double deadline) {
+  lua_State *T = lua_newthread(L);
+  lua_insert(L, -2);  // below the function
+  lua_xmove(L, T, 1);
+  int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  waiting_.emplace(deadline, Thread{T, ref});
+}
+
+void ScenarioScript::Resume(const Thread &thread) {
+  // a plain coroutine.yield() waits for the next step
+  deadline_ = time_;
+
+#if LUA_VERSION_NUM >= 504
+  int results;
+  int status = lua_resume(thread.L, L_, 0, &results);
+#elif LUA_VERSION_NUM >= 502
+  int status = lua_resume(thread.L, L_, 0);
+#else
+  int status = lua_resume(thread.L, 0);
+#endif
+
+  if (status == LUA_YIELD) {
+    lua_settop(thread.L, 0);  // the yielded values are unused
+    waiting_.emplace(deadline_, thread);
+    return;
+  }
+  if (status != 0) {
+    ROS_ERROR_NAMED("ScenarioScript", "Scenario script %s failed: %s",
+                    Q(name_).c_str(), lua_tostring(thread.L, -1));
+  }
+  luaL_unref(L_, LUA_REGISTRYINDEX, thread.ref);
+}
+
+ScenarioScript *ScenarioScript::Self(lua_State *L) {
+  return static_cast<ScenarioScript *>(lua_touserdata(L, lua_upvalueindex(1)));
+}
+
+int ScenarioScript::LuaTime(lua_State *L) {
+  lua_pushnumber(L, Self(L)->time_);
+  return 1;
+}
+
+int ScenarioScript::LuaSleep(lua_State *L) {
+  ScenarioScript *self = Self(L);
+  self->deadline_ = self->time_ + luaL_checknumber(L, 1);
+  return lua_yield(L, 0);
+}
+
+int ScenarioScript::LuaWaitUntil(lua_State *L) {
+  Self(L)->deadline_ = luaL_checknumber(L, 1);
+  return lua_yield(L, 0);
+}
+
+int ScenarioScript::LuaStart(lua_State *L) {
+  ScenarioScript *self = Self(L);
+  luaL_checktype(L, 1, LUA_TFUNCTION);
+  lua_settop(L, 1);
+  self->Start(L, self->time_);
+  return 0;
+}
+
+int ScenarioScript::LuaSpawnModel(lua_State *L) {
+  ScenarioScript *self = Self(L);
+  const char *path = luaL_checkstring(L, 1);
+  const char *name = luaL_checkstring(L, 2);
+  Pose pose(luaL_optnumber(L, 3, 0), luaL_optnumber(L, 4, 0),
+            luaL_optnumber(L, 5, 0));
+  const char *ns = luaL_optstring(L, 6, "");
+  if (!Protect(L, [&]() { self->world_->LoadModel(path, ns, name, pose); })) {
+    return lua_error(L);
+  }
+  return 0;
+}
+
+int ScenarioScript::LuaDeleteModel(lua_State *L) {
+  ScenarioScript *self = Self(L);
+  const char *name = luaL_checkstring(L, 1);
+  if (!Protect(L, [&]() { self->world_->DeleteModel(name); })) {
+    return lua_error(L);
+  }
+  return 0;
+}
+
+int ScenarioScript::LuaMoveModel(lua_State *L) {
+  ScenarioScript *self = Self(L);
+  const char *name = luaL_checkstring(L, 1);
+  Pose pose(luaL_checknumber(L, 2), luaL_checknumber(L, 3),
+            luaL_optnumber(L, 4, 0));
+  if (!Protect(L, [&]() { self->world_->MoveModel(name, pose); })) {
+    return lua_error(L);
+  }
+  return 0;
+}
+
+int ScenarioScript::LuaGetPose(lua_State *L) {
+  Model *model = Self(L)->world_->GetModel(luaL_checkstring(L, 1));
+  if (model == nullptr || model->bodies_.empty()) {
+    return luaL_error(L, "model \"%s\" does not exist", lua_tostring(L, 1));
+  }
+  b2Body *body = model->bodies_[0]->physics_body_;
+  lua_pushnumber(L, body->GetPosition().x);
+  lua_pushnumber(L, body->GetPosition().y);
+  lua_pushnumber(L, body->GetAngle());
+  return 3;
+}
+
+int ScenarioScript::LuaSetVelocity(lua_State *L) {
+  Model *model = Self(L)->world_->GetModel(luaL_checkstring(L, 1));
+  if (model == nullptr || model->bodies_.empty()) {
+    return luaL_error(L, "model \"%s\" does not exist", lua_tostring(L, 1));
+  }
+  b2Body *body = model->bodies_[0]->physics_body_;
+  body->SetLinearVelocity(
+      b2Vec2(luaL_checknumber(L, 2), luaL_checknumber(L, 3)));
+  body->SetAngularVelocity(luaL_optnumber(L, 4, 0));
+  return 0;
+}
+
+int ScenarioScript::LuaLog(lua_State *L) {
+  ROS_INFO_NAMED("ScenarioScript", "%s: %s", Self(L)->name_.c_str(),
+                 luaL_checkstring(L, 1));
+  return 0;
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::ScenarioScript,
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::ScenarioScript,
+                         flatland_server::WorldPlugin)
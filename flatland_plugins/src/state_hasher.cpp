@@ -0,0 +1,213 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_hasher.cpp
+ * @brief	 Digests the state of the world after each step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/StateHash.h>
+#include <flatland_plugins/state_hasher.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/state_hash.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/filesystem.hpp>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void StateHasher::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string topic = reader.Get<std::string>("topic", "state_hash");
+  std::string path = reader.Get<std::string>("path", "");
+  log_details_ = reader.Get<bool>("details", true);
+  int level = reader.Get<int>("compression_level", 1);
+  reader.EnsureAccessedAllKeys();
+
+  if (level < 0 || level > 9) {
+    throw YAMLException(
+        "Invalid \"compression_level\" param, must be between 0 and 9");
+  }
+
+  // a queue of steps, so a subscriber recording the digests misses none
+  publisher_ = nh_.advertise<flatland_msgs::StateHash>(topic, 100);
+  if (path.empty()) {
+    return;
+  }
+
+  // relative paths are relative to the world file, like the maps
+  boost::filesystem::path log_path(path);
+  if (log_path.is_relative()) {
+    log_path = world_->world_yaml_dir_ / log_path;
+  }
+  writer_.reset(new ColumnLog::Writer(log_path.string(), level));
+
+  // the 64 bit digests are split into two uint32 columns
+  bodies_table_ = writer_->AddTable("bodies", {{"id", ColumnLog::UINT32},
+                                               {"name", ColumnLog::STRING}});
+  generators_table_ = writer_->AddTable(
+      "generators", {{"id", ColumnLog::UINT32}, {"name", ColumnLog::STRING}});
+  steps_table_ = writer_->AddTable("steps", {{"step", ColumnLog::UINT32},
+                                             {"time", ColumnLog::FLOAT64},
+                                             {"hash_hi", ColumnLog::UINT32},
+                                             {"hash_lo", ColumnLog::UINT32}});
+  body_hashes_table_ =
+      writer_->AddTable("body_hashes", {{"step", ColumnLog::UINT32},
+                                        {"body", ColumnLog::UINT32},
+                                        {"hash_hi", ColumnLog::UINT32},
+                                        {"hash_lo", ColumnLog::UINT32}});
+  random_states_table_ =
+      writer_->AddTable("random_states", {{"step", ColumnLog::UINT32},
+                                          {"generator", ColumnLog::UINT32},
+                                          {"hash_hi", ColumnLog::UINT32},
+                                          {"hash_lo", ColumnLog::UINT32}});
+
+  ROS_INFO_NAMED("StateHasher", "Logging the state digests to %s",
+                 log_path.string().c_str());
+}
+
+void StateHasher::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  step_++;
+  bool details = writer_ && log_details_;
+
+  // the body list of Box2D is in the order the bodies were created, which is
+  // the same in two runs of a world. The static bodies never move
+  StateHash bodies_hash;
+  std::unordered_map<std::string, uint32_t> name_counts;
+  for (b2Body *b = world_->physics_world_->GetBodyList(); b;
+       b = b->GetNext()) {
+    if (b->GetType() == b2_staticBody) {
+      continue;
+    }
+    StateHash body_hash;
+    body_hash.Add(b->GetTransform());
+    body_hash.Add(b->GetLinearVelocity());
+    body_hash.Add(b->GetAngularVelocity());
+    bodies_hash.Add(body_hash.Get());
+
+    if (details) {
+      // bodies sharing a name, e.g. the agents of a crowd, are numbered
+      const Body *body = static_cast<const Body *>(b->GetUserData());
+      std::string name =
+          body ? body->GetEntity()->GetName() + "/" + body->GetName() : "";
+      uint32_t count = name_counts[name]++;
+      if (count > 0) {
+        name += "#" + std::to_string(count);
+      }
+      LogHash(bodies_table_, &body_ids_, body_hashes_table_, name,
+              body_hash.Get());
+    }
+  }
+
+  StateHash random_hash;
+  for (const auto &plugin : world_->plugin_manager_.model_plugins_) {
+    uint64_t state = plugin->GetRandomState();
+    if (state == 0) {
+      continue;
+    }
+    random_hash.Add(state);
+    if (details) {
+      LogHash(generators_table_, &generator_ids_, random_states_table_,
+              plugin->GetModel()->GetName() + "/" + plugin->GetName(), state);
+    }
+  }
+  for (const auto &plugin : world_->plugin_manager_.world_plugins_) {
+    uint64_t state = plugin->GetRandomState();
+    if (state == 0) {
+      continue;
+    }
+    random_hash.Add(state);
+    if (details) {
+      LogHash(generators_table_, &generator_ids_, random_states_table_,
+              plugin->GetName(), state);
+    }
+  }
+
+  StateHash hash;
+  hash.Add(bodies_hash.Get());
+  hash.Add(random_hash.Get());
+
+  flatland_msgs::StateHash msg;
+  msg.header.stamp = timekeeper.GetSimTime();
+  msg.step = step_;
+  msg.hash = hash.Get();
+  msg.bodies_hash = bodies_hash.Get();
+  msg.random_hash = random_hash.Get();
+  PublishCounted(publisher_, msg);
+
+  if (writer_) {
+    writer_->Put(steps_table_, 0, static_cast<uint32_t>(step_));
+    writer_->Put(steps_table_, 1, timekeeper.GetSimTime().toSec());
+    writer_->Put(steps_table_, 2, static_cast<uint32_t>(msg.hash >> 32));
+    writer_->Put(steps_table_, 3, static_cast<uint32_t>(msg.hash));
+    writer_->EndRow(steps_table_);
+  }
+}
+
+void StateHasher::LogHash(uint32_t names_table,
+                          std::unordered_map<std::string, uint32_t> *ids,
+                          uint32_t table, const std::string &name,
+                          uint64_t hash) {
+  auto it = ids->find(name);
+  if (it == ids->end()) {
+    it = ids->emplace(name, ids->size()).first;
+    writer_->Put(names_table, 0, it->second);
+    writer_->Put(names_table, 1, name);
+    writer_->EndRow(names_table);
+  }
+  writer_->Put(table, 0, static_cast<uint32_t>(step_));
+  writer_->Put(table, 1, it->second);
+  writer_->Put(table, 2, static_cast<uint32_t>(hash >> 32));
+  writer_->Put(table, 3, static_cast<uint32_t>(hash));
+  writer_->EndRow(table);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::StateHasher,
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::StateHasher,
+                         flatland_server::WorldPlugin)
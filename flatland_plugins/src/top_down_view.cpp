@@ -0,0 +1,198 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 top_down_view.cpp
+ * @brief	 Top down view plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/top_down_view.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <sensor_msgs/image_encodings.h>
+#include <tf/tf.h>
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+TopDownView::~TopDownView() {
+  if (GetRasterBatch()) {
+    GetRasterBatch()->Remove(view_id_);
+  }
+}
+
+void TopDownView::OnInitialize(const YAML::Node &config) {
+  ParseParameters(config);
+
+  SetUpdateRate(update_rate_);
+
+  image_.header.frame_id =
+      tf::resolve("", GetModel()->NameSpaceTF(frame_id_));
+  image_.encoding = sensor_msgs::image_encodings::MONO8;
+  image_.width = width_;
+  image_.height = height_;
+  image_.step = width_;
+  image_.data.assign(width_ * height_, RasterBatch::FREE);
+
+  image_publisher_ = nh_.advertise<sensor_msgs::Image>(topic_, 1);
+
+  // the views of the world are rendered together
+  if (GetRasterBatch()) {
+    view_id_ = GetRasterBatch()->Add(MakeParams());
+  } else {
+    pixels_.assign(width_ * height_, RasterBatch::FREE);
+  }
+}
+
+void TopDownView::SetDegradations(uint32_t degradations) {
+  SetUpdateRate(degradations & StepBudgetGovernor::REDUCE_SENSOR_RATE
+                    ? update_rate_ / 2
+                    : update_rate_);
+}
+
+void TopDownView::BeforePhysicsStep(const Timekeeper &timekeeper) {
+  // only render when the image is subscribed or observed
+  if (!observed_ && !IsSubscribed(image_publisher_)) {
+    return;
+  }
+
+  ros::Time stamp = timekeeper.GetSimTime();
+  if (view_id_ >= 0) {
+    GetRasterBatch()->Request(view_id_, [this, stamp] { Publish(stamp); });
+    return;
+  }
+
+  b2Transform xf = b2Mul(body_->GetPhysicsBody()->GetTransform(),
+                         b2Transform(b2Vec2(origin_.x, origin_.y),
+                                     b2Rot(origin_.theta)));
+  RasterBatch::Rasterize(GetModel()->GetPhysicsWorld(), xf, MakeParams(),
+                         pixels_.data());
+  Publish(stamp);
+}
+
+const uint8_t *TopDownView::GetPixels() const {
+  return view_id_ >= 0 ? GetRasterBatch()->GetImage(view_id_)
+                       : pixels_.data();
+}
+
+void TopDownView::Publish(const ros::Time &stamp) {
+  if (!IsSubscribed(image_publisher_)) {
+    return;
+  }
+  const uint8_t *pixels = GetPixels();
+  std::copy(pixels, pixels + image_.data.size(), image_.data.begin());
+  image_.header.stamp = stamp;
+  PublishCounted(image_publisher_, image_);
+}
+
+RasterBatch::Params TopDownView::MakeParams() {
+  RasterBatch::Params params;
+  params.body = body_;
+  params.origin = origin_;
+  params.resolution = resolution_;
+  params.width = width_;
+  params.height = height_;
+  params.layers_bits = layers_bits_;
+  params.ignore = GetModel();
+  return params;
+}
+
+void TopDownView::ParseParameters(const YAML::Node &config) {
+  YamlReader reader(config);
+  std::string body_name = reader.Get<std::string>("body");
+  topic_ = reader.Get<std::string>("topic", "top_down_view");
+  frame_id_ = reader.Get<std::string>("frame", GetName());
+  origin_ = reader.GetPose("origin", Pose(0, 0, 0));
+  update_rate_ = reader.Get<double>("update_rate", 10);
+  resolution_ = reader.Get<double>("resolution", 0.05);
+  double width = reader.Get<double>("width", 6.4);
+  double height = reader.Get<double>("height", 6.4);
+  std::vector<std::string> layers =
+      reader.GetList<std::string>("layers", {"all"}, -1, -1);
+  reader.EnsureAccessedAllKeys();
+
+  if (resolution_ <= 0) {
+    throw YAMLException("Invalid \"resolution\" param, must be > 0");
+  }
+
+  if (width < resolution_ || height < resolution_) {
+    throw YAMLException(
+        "Invalid \"width\" or \"height\" param, must be at least the "
+        "resolution");
+  }
+  width_ = std::lround(width / resolution_);
+  height_ = std::lround(height / resolution_);
+
+  body_ = GetModel()->GetBody(body_name);
+  if (!body_) {
+    throw YAMLException("Cannot find body with name " + body_name);
+  }
+
+  std::vector<std::string> invalid_layers;
+  layers_bits_ = GetModel()->GetCfr()->GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw YAMLException("Cannot find layer(s): {" +
+                        boost::algorithm::join(invalid_layers, ",") + "}");
+  }
+
+  ROS_DEBUG_NAMED("TopDownView",
+                  "TopDownView %s params: topic(%s) body(%s, %p) "
+                  "origin(%f,%f,%f) frame_id(%s) update_rate(%f) "
+                  "resolution(%f) pixels(%d x %d)",
+                  GetName().c_str(), topic_.c_str(), body_name.c_str(), body_,
+                  origin_.x, origin_.y, origin_.theta, frame_id_.c_str(),
+                  update_rate_, resolution_, width_, height_);
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::TopDownView,
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::TopDownView,
+                         flatland_server::ModelPlugin)
@@ -0,0 +1,255 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trajectory_logger.cpp
+ * @brief	 Logs the poses, contacts and scans of a run to a column log
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/laser.h>
+#include <flatland_plugins/trajectory_logger.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/filesystem.hpp>
+#include <limits>
+
+using namespace flatland_server;
+
+namespace flatland_plugins {
+
+void TrajectoryLogger::OnInitialize(const YAML::Node &config) {
+  YamlReader reader(config);
+  boost::filesystem::path path(reader.Get<std::string>("path"));
+  log_poses_ = reader.Get<bool>("poses", true);
+  log_contacts_ = reader.Get<bool>("contacts", true);
+  log_scans_ = reader.Get<bool>("scans", false);
+  double update_rate = reader.Get<double>(
+      "update_rate", std::numeric_limits<double>::infinity());
+  int level = reader.Get<int>("compression_level", 1);
+  int chunk_rows = reader.Get<int>("chunk_rows", 65536);
+  reader.EnsureAccessedAllKeys();
+
+  if (level < 0 || level > 9) {
+    throw YAMLException(
+        "Invalid \"compression_level\" param, must be between 0 and 9");
+  }
+  if (chunk_rows < 1) {
+    throw YAMLException("Invalid \"chunk_rows\" param, must be at least 1");
+  }
+  if (!(update_rate > 0)) {
+    throw YAMLException("Invalid \"update_rate\" param, must be positive");
+  }
+  period_ = 1.0 / update_rate;
+
+  // relative paths are relative to the world file, like the maps
+  if (path.is_relative()) {
+    path = world_->world_yaml_dir_ / path;
+  }
+  writer_.reset(new ColumnLog::Writer(path.string(), level, chunk_rows));
+
+  bodies_table_ = writer_->AddTable("bodies", {{"id", ColumnLog::UINT32},
+                                               {"model", ColumnLog::STRING},
+                                               {"body", ColumnLog::STRING}});
+  poses_table_ = writer_->AddTable("poses", {{"step", ColumnLog::UINT32},
+                                             {"time", ColumnLog::FLOAT64},
+                                             {"body", ColumnLog::UINT32},
+                                             {"x", ColumnLog::FLOAT32},
+                                             {"y", ColumnLog::FLOAT32},
+                                             {"angle", ColumnLog::FLOAT32},
+                                             {"vx", ColumnLog::FLOAT32},
+                                             {"vy", ColumnLog::FLOAT32},
+                                             {"omega", ColumnLog::FLOAT32}});
+  contacts_table_ =
+      writer_->AddTable("contacts", {{"step", ColumnLog::UINT32},
+                                     {"time", ColumnLog::FLOAT64},
+                                     {"body_a", ColumnLog::UINT32},
+                                     {"body_b", ColumnLog::UINT32},
+                                     {"x", ColumnLog::FLOAT32},
+                                     {"y", ColumnLog::FLOAT32},
+                                     {"normal_x", ColumnLog::FLOAT32},
+                                     {"normal_y", ColumnLog::FLOAT32}});
+  lasers_table_ = writer_->AddTable("lasers", {{"id", ColumnLog::UINT32},
+                                               {"model", ColumnLog::STRING},
+                                               {"laser", ColumnLog::STRING}});
+  scans_table_ =
+      writer_->AddTable("scans", {{"step", ColumnLog::UINT32},
+                                  {"time", ColumnLog::FLOAT64},
+                                  {"laser", ColumnLog::UINT32},
+                                  {"ranges", ColumnLog::FLOAT32_LIST}});
+
+  ROS_INFO_NAMED("TrajectoryLogger", "Logging the run to %s",
+                 path.string().c_str());
+}
+
+void TrajectoryLogger::AfterPhysicsStep(const Timekeeper &timekeeper) {
+  step_++;
+  double time = timekeeper.GetSimTime().toSec();
+  if (time < next_log_time_) {
+    return;
+  }
+  next_log_time_ = time + period_ - 1e-9;
+
+  const BodyStates *states = GetBodyStates();
+  if (!states) {
+    return;
+  }
+
+  // bodies may reuse the addresses of deleted ones, which then get new ids
+  if (states->generation_ != body_generation_) {
+    body_generation_ = states->generation_;
+    body_ids_.clear();
+    lasers_.clear();
+  }
+
+  if (log_poses_) {
+    for (size_t i = 0; i < states->Size(); i++) {
+      uint32_t id = GetBodyId(states->bodies_[i]);
+      writer_->Put(poses_table_, 0, step_);
+      writer_->Put(poses_table_, 1, time);
+      writer_->Put(poses_table_, 2, id);
+      writer_->Put(poses_table_, 3, states->x_[i]);
+      writer_->Put(poses_table_, 4, states->y_[i]);
+      writer_->Put(poses_table_, 5, states->angle_[i]);
+      writer_->Put(poses_table_, 6, states->vx_[i]);
+      writer_->Put(poses_table_, 7, states->vy_[i]);
+      writer_->Put(poses_table_, 8, states->omega_[i]);
+      writer_->EndRow(poses_table_);
+    }
+  }
+
+  if (log_contacts_) {
+    LogContacts(time);
+  }
+  if (log_scans_) {
+    LogScans(time);
+  }
+}
+
+uint32_t TrajectoryLogger::GetBodyId(const Body *body) {
+  auto it = body_ids_.find(body);
+  if (it != body_ids_.end()) {
+    return it->second;
+  }
+
+  uint32_t id = next_body_id_++;
+  body_ids_.emplace(body, id);
+  writer_->Put(bodies_table_, 0, id);
+  writer_->Put(bodies_table_, 1, body->GetEntity()->GetName());
+  writer_->Put(bodies_table_, 2, body->GetName());
+  writer_->EndRow(bodies_table_);
+  return id;
+}
+
+void TrajectoryLogger::LogContacts(double time) {
+  for (b2Contact *c = world_->physics_world_->GetContactList(); c;
+       c = c->GetNext()) {
+    if (!c->IsTouching() || !c->IsEnabled()) {
+      continue;
+    }
+    const Body *a =
+        static_cast<const Body *>(c->GetFixtureA()->GetBody()->GetUserData());
+    const Body *b =
+        static_cast<const Body *>(c->GetFixtureB()->GetBody()->GetUserData());
+    if (!a || !b) {
+      continue;
+    }
+
+    b2WorldManifold manifold;
+    c->GetWorldManifold(&manifold);
+    uint32_t id_a = GetBodyId(a);
+    uint32_t id_b = GetBodyId(b);
+    for (int32 p = 0; p < c->GetManifold()->pointCount; p++) {
+      writer_->Put(contacts_table_, 0, step_);
+      writer_->Put(contacts_table_, 1, time);
+      writer_->Put(contacts_table_, 2, id_a);
+      writer_->Put(contacts_table_, 3, id_b);
+      writer_->Put(contacts_table_, 4, manifold.points[p].x);
+      writer_->Put(contacts_table_, 5, manifold.points[p].y);
+      writer_->Put(contacts_table_, 6, manifold.normal.x);
+      writer_->Put(contacts_table_, 7, manifold.normal.y);
+      writer_->EndRow(contacts_table_);
+    }
+  }
+}
+
+void TrajectoryLogger::LogScans(double time) {
+  // the scans are complete once the model plugins are done with the step,
+  // a scan is logged once, with the time it was taken at
+  for (const auto &plugin : world_->plugin_manager_.model_plugins_) {
+    Laser *laser = dynamic_cast<Laser *>(plugin.get());
+    if (!laser) {
+      continue;
+    }
+
+    auto it = lasers_.find(laser);
+    if (it == lasers_.end()) {
+      LoggedLaser logged;
+      logged.id = next_laser_id_++;
+      it = lasers_.emplace(laser, logged).first;
+      writer_->Put(lasers_table_, 0, logged.id);
+      writer_->Put(lasers_table_, 1, laser->GetModel()->GetName());
+      writer_->Put(lasers_table_, 2, laser->GetName());
+      writer_->EndRow(lasers_table_);
+    }
+
+    const sensor_msgs::LaserScan &scan = laser->laser_scan_;
+    if (scan.header.stamp.isZero() ||
+        scan.header.stamp == it->second.last_stamp) {
+      continue;
+    }
+    it->second.last_stamp = scan.header.stamp;
+    writer_->Put(scans_table_, 0, step_);
+    writer_->Put(scans_table_, 1, scan.header.stamp.toSec());
+    writer_->Put(scans_table_, 2, it->second.id);
+    writer_->Put(scans_table_, 3, scan.ranges.data(), scan.ranges.size());
+    writer_->EndRow(scans_table_);
+  }
+}
+};
+
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::TrajectoryLogger,
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::TrajectoryLogger,
+                         flatland_server::WorldPlugin)
@@ -45,13 +45,18 @@
  */
 
 #include <Box2D/Box2D.h>
+#include <flatland_plugins/robot_odometry.h>
 #include <flatland_plugins/tricycle_drive.h>
 #include <flatland_server/debug_visualization.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/odometry_aggregator.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/world_checkpoint.h>
 #include <flatland_server/yaml_reader.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 #include <tf/tf.h>
+#include <sstream>
 
 namespace flatland_plugins {
 
@@ -79,6 +84,7 @@ void TricycleDrive::OnInitialize(const YAML::Node& config) {
   double pub_rate =
       r.Get<double>("pub_rate", numeric_limits<double>::infinity());
   update_timer_.SetRate(pub_rate);
+  update_timer_.SetStagger(update_stagger_);
 
   // by default the covariance diagonal is the variance of actual noise
   // generated, non-diagonal elements are zero assuming the noises are
@@ -149,8 +155,8 @@ void TricycleDrive::OnInitialize(const YAML::Node& config) {
   ComputeJoints();
 
   // publish and subscribe to topics
-  twist_sub_ =
-      nh_.subscribe(twist_topic, 1, &TricycleDrive::TwistCallback, this);
+  twist_sub_.Subscribe(nh_, twist_topic, 1, &TricycleDrive::TwistCallback,
+                       this);
   odom_pub_ = nh_.advertise<nav_msgs::Odometry>(odom_topic, 1);
   ground_truth_pub_ = nh_.advertise<nav_msgs::Odometry>(ground_truth_topic, 1);
 
@@ -170,17 +176,7 @@ void TricycleDrive::OnInitialize(const YAML::Node& config) {
   }
 
   // init the random number generators
-  random_device rd;
-  rng_ = default_random_engine(rd());
-  for (unsigned int i = 0; i < 3; i++) {
-    // variance is standard deviation squared
-    noise_gen_[i] = normal_distribution<double>(0.0, sqrt(odom_pose_noise[i]));
-  }
-
-  for (unsigned int i = 0; i < 3; i++) {
-    noise_gen_[i + 3] =
-        normal_distribution<double>(0.0, sqrt(odom_twist_noise[i]));
-  }
+  noise_.Configure(odom_pose_noise, odom_twist_noise, RandomSeed());
 
   ROS_DEBUG_NAMED(
       "TricycleDrive",
@@ -247,10 +243,10 @@ void TricycleDrive::ComputeJoints() {
     throw YAMLException("Rear right wheel joint must be a weld joint");
   }
 
-  // enable limits for the front joint
-  b2RevoluteJoint* j =
-      dynamic_cast<b2RevoluteJoint*>(front_wj_->physics_joint_);
-  j->EnableLimit(true);
+  // enable limits for the front joint, they stay enabled, the steering only
+  // moves them
+  front_joint_ = static_cast<b2RevoluteJoint*>(front_wj_->physics_joint_);
+  front_joint_->EnableLimit(true);
 
   // positive joint angle goes counter clockwise from the perspective of BodyA,
   // if body_ is not BodyA, we need flip the steering angle for visualization
@@ -302,10 +298,14 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
   b2Body* b2body = body_->physics_body_;
 
-  b2Vec2 position = b2body->GetPosition();
-  float angle = b2body->GetAngle();
+  // the rotation of the body transform holds the sine and cosine of the
+  // angle, no need to recompute them
+  const b2Transform& xf = b2body->GetTransform();
 
   if (publish) {
+    b2Vec2 position = xf.p;
+    float angle = b2body->GetAngle();
+
     // 1. get the state of the body and publish the data,
     //    before the tricycle physics get updated
     b2Vec2 linear_vel_local =
@@ -316,8 +316,7 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
     ground_truth_msg_.pose.pose.position.x = position.x;
     ground_truth_msg_.pose.pose.position.y = position.y;
     ground_truth_msg_.pose.pose.position.z = 0;
-    ground_truth_msg_.pose.pose.orientation =
-        tf::createQuaternionMsgFromYaw(angle);
+    ground_truth_msg_.pose.pose.orientation = QuaternionMsgFromYaw(angle);
     ground_truth_msg_.twist.twist.linear.x = linear_vel_local.x;
     ground_truth_msg_.twist.twist.linear.y = linear_vel_local.y;
     ground_truth_msg_.twist.twist.linear.z = 0;
@@ -327,18 +326,15 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
     // add the noise to odom messages
     odom_msg_.header.stamp = timekeeper.GetSimTime();
-    odom_msg_.pose.pose = ground_truth_msg_.pose.pose;
-    odom_msg_.twist.twist = ground_truth_msg_.twist.twist;
-    odom_msg_.pose.pose.position.x += noise_gen_[0](rng_);
-    odom_msg_.pose.pose.position.y += noise_gen_[1](rng_);
-    odom_msg_.pose.pose.orientation =
-        tf::createQuaternionMsgFromYaw(angle + noise_gen_[2](rng_));
-    odom_msg_.twist.twist.linear.x += noise_gen_[3](rng_);
-    odom_msg_.twist.twist.linear.y += noise_gen_[4](rng_);
-    odom_msg_.twist.twist.angular.z += noise_gen_[5](rng_);
-
-    ground_truth_pub_.publish(ground_truth_msg_);
-    odom_pub_.publish(odom_msg_);
+    noise_.Apply(ground_truth_msg_, angle, &odom_msg_);
+
+    if (OdometryAggregator::IsEnabled()) {
+      OdometryAggregator::Get().Send(
+          MakeRobotOdometry(ground_truth_msg_, odom_msg_));
+    }
+    // the full messages are only serialized for their subscribers
+    PublishLazily(ground_truth_pub_, ground_truth_msg_);
+    PublishLazily(odom_pub_, odom_msg_);
   }
 
   // 2. Update the tricycle physics based on the twist command
@@ -363,7 +359,6 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
   // twist message contains the speed and angle of the front wheel
   delta_command_ = twist_msg_.angular.z;  // target steering angle
-  double theta = angle;                   // angle of robot in map frame
   double dt = timekeeper.GetStepSize();
 
   // In the simulation, the equations of motion have to be computed backwards
@@ -397,13 +392,10 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
 
   // change angle of the front wheel for visualization
 
-  b2RevoluteJoint* j =
-      dynamic_cast<b2RevoluteJoint*>(front_wj_->physics_joint_);
-  j->EnableLimit(true);
   if (invert_steering_angle_) {
-    j->SetLimits(-theta_f_, -theta_f_);
+    front_joint_->SetLimits(-theta_f_, -theta_f_);
   } else {
-    j->SetLimits(theta_f_, theta_f_);
+    front_joint_->SetLimits(theta_f_, theta_f_);
   }
 
   // calculate the desired velocity using the bicycle model in the world frame
@@ -413,9 +405,11 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
   // apply linear velocity and acceleration constraints
   v_f_ = linear_dynamics_.Limit(v_f_, twist_msg_.linear.x, dt);
 
-  double v_x = v_f_ * cos(theta_f_) * cos(theta);  // x velocity in world
-  double v_y = v_f_ * cos(theta_f_) * sin(theta);  // y velocity in world
-  double w = v_f_ * sin(theta_f_) / wheelbase_;    // angular velocity
+  // xf.q holds the sine and cosine of the angle of robot in map frame
+  double v_r = v_f_ * cos(theta_f_);             // velocity of the rear center
+  double v_x = v_r * xf.q.c;                     // x velocity in world
+  double v_y = v_r * xf.q.s;                     // y velocity in world
+  double w = v_f_ * sin(theta_f_) / wheelbase_;  // angular velocity
 
   // Now we would like the rear center to move at v_x, v_y, and w, since Box2D
   // applies velocities at center of mass, we must use rigid body kinematics
@@ -427,10 +421,17 @@ void TricycleDrive::BeforePhysicsStep(const Timekeeper& timekeeper) {
   // angular velocity cross product the displacement from the rear center to the
   // center of mass
 
-  // r is the vector from rear center to CM in world frame
-  b2Vec2 r = b2body->GetWorldCenter() - b2body->GetWorldPoint(rear_center_);
+  // r is the vector from rear center to CM in world frame, both are fixed in
+  // the body so only the difference needs rotating
+  b2Vec2 r = b2Mul(xf.q, b2body->GetLocalCenter() - rear_center_);
   b2Vec2 linear_vel_cm = linear_vel + w * b2Vec2(-r.y, r.x);
 
+  // a resting robot without command is left alone, so that it falls asleep
+  // and is not solved until the next command
+  if (v_f_ == 0 && !b2body->IsAwake()) {
+    return;
+  }
+
   b2body->SetLinearVelocity(linear_vel_cm);
 
   // angular velocity is the same at any point in body
@@ -441,7 +442,63 @@ void TricycleDrive::TwistCallback(const geometry_msgs::Twist& msg) {
   twist_msg_ = msg;
 }
 
+boost::any TricycleDrive::SaveState() {
+  State state;
+  state.twist_msg = twist_msg_;
+  state.delta_command = delta_command_;
+  state.theta_f = theta_f_;
+  state.d_delta = d_delta_;
+  state.v_f = v_f_;
+  state.rng = noise_.rng_;
+  return state;
+}
+
+void TricycleDrive::RestoreState(const boost::any& state) {
+  const State* s = boost::any_cast<State>(&state);
+  if (s == nullptr) return;
+
+  twist_msg_ = s->twist_msg;
+  delta_command_ = s->delta_command;
+  theta_f_ = s->theta_f;
+  d_delta_ = s->d_delta;
+  v_f_ = s->v_f;
+  noise_.rng_ = s->rng;
+}
+
+std::string TricycleDrive::EncodeState(const boost::any& state) {
+  const State* s = boost::any_cast<State>(&state);
+  if (s == nullptr) return std::string();
+
+  CheckpointWriter writer;
+  writer.Put(s->twist_msg.linear.x);
+  writer.Put(s->twist_msg.angular.z);
+  writer.Put(s->delta_command);
+  writer.Put(s->theta_f);
+  writer.Put(s->d_delta);
+  writer.Put(s->v_f);
+  std::ostringstream rng;
+  rng << s->rng;
+  writer.PutString(rng.str());
+  return writer.Data();
+}
+
+boost::any TricycleDrive::DecodeState(const std::string& encoded) {
+  CheckpointReader reader(encoded);
+  State state;
+  state.twist_msg.linear.x = reader.Get<double>();
+  state.twist_msg.angular.z = reader.Get<double>();
+  state.delta_command = reader.Get<double>();
+  state.theta_f = reader.Get<double>();
+  state.d_delta = reader.Get<double>();
+  state.v_f = reader.Get<double>();
+  std::istringstream rng(reader.GetString());
+  rng >> state.rng;
+  return state;
+}
+
 }
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::TricycleDrive,
-                       flatland_server::ModelPlugin)
\ No newline at end of file
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::TricycleDrive,
+                         flatland_server::ModelPlugin)
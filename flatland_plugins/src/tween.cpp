@@ -48,9 +48,11 @@
 #include <flatland_plugins/tween.h>
 #include <flatland_server/debug_visualization.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 #include <tf/tf.h>
+#include "tweeny.h"
 
 namespace flatland_plugins {
 
@@ -91,6 +93,66 @@ std::map<std::string, Tween::EasingType_> Tween::easing_strings_ = {
     {"bounceOut", Tween::EasingType_::bounceOut},
     {"bounceInOut", Tween::EasingType_::bounceInOut}};
 
+// the tweeny easings are all of the form start + (end - start) * f(position)
+template <typename Easing>
+static double Ease(double progress) {
+  return Easing::template run<double>(progress, 0.0, 1.0);
+}
+
+std::map<Tween::EasingType_, KinematicAnimator::Easing>
+    Tween::easing_functions_ = {
+        {Tween::EasingType_::linear, Ease<tweeny::easing::linearEasing>},
+        {Tween::EasingType_::quadraticIn,
+         Ease<tweeny::easing::quadraticInEasing>},
+        {Tween::EasingType_::quadraticOut,
+         Ease<tweeny::easing::quadraticOutEasing>},
+        {Tween::EasingType_::quadraticInOut,
+         Ease<tweeny::easing::quadraticInOutEasing>},
+        {Tween::EasingType_::cubicIn, Ease<tweeny::easing::cubicInEasing>},
+        {Tween::EasingType_::cubicOut, Ease<tweeny::easing::cubicOutEasing>},
+        {Tween::EasingType_::cubicInOut,
+         Ease<tweeny::easing::cubicInOutEasing>},
+        {Tween::EasingType_::quarticIn, Ease<tweeny::easing::quarticInEasing>},
+        {Tween::EasingType_::quarticOut,
+         Ease<tweeny::easing::quarticOutEasing>},
+        {Tween::EasingType_::quarticInOut,
+         Ease<tweeny::easing::quarticInOutEasing>},
+        {Tween::EasingType_::quinticIn, Ease<tweeny::easing::quinticInEasing>},
+        {Tween::EasingType_::quinticOut,
+         Ease<tweeny::easing::quinticOutEasing>},
+        {Tween::EasingType_::quinticInOut,
+         Ease<tweeny::easing::quinticInOutEasing>},
+        {Tween::EasingType_::exponentialIn,
+         Ease<tweeny::easing::exponentialInEasing>},
+        {Tween::EasingType_::exponentialOut,
+         Ease<tweeny::easing::exponentialOutEasing>},
+        {Tween::EasingType_::exponentialInOut,
+         Ease<tweeny::easing::exponentialInOutEasing>},
+        {Tween::EasingType_::circularIn,
+         Ease<tweeny::easing::circularInEasing>},
+        {Tween::EasingType_::circularOut,
+         Ease<tweeny::easing::circularOutEasing>},
+        {Tween::EasingType_::circularInOut,
+         Ease<tweeny::easing::circularInOutEasing>},
+        {Tween::EasingType_::backIn, Ease<tweeny::easing::backInEasing>},
+        {Tween::EasingType_::backOut, Ease<tweeny::easing::backOutEasing>},
+        {Tween::EasingType_::backInOut, Ease<tweeny::easing::backInOutEasing>},
+        {Tween::EasingType_::elasticIn, Ease<tweeny::easing::elasticInEasing>},
+        {Tween::EasingType_::elasticOut,
+         Ease<tweeny::easing::elasticOutEasing>},
+        {Tween::EasingType_::elasticInOut,
+         Ease<tweeny::easing::elasticInOutEasing>},
+        {Tween::EasingType_::bounceIn, Ease<tweeny::easing::bounceInEasing>},
+        {Tween::EasingType_::bounceOut, Ease<tweeny::easing::bounceOutEasing>},
+        {Tween::EasingType_::bounceInOut,
+         Ease<tweeny::easing::bounceInOutEasing>}};
+
+Tween::~Tween() {
+  if (animator_ && !own_animator_) {
+    animator_->Remove(track_id_);
+  }
+}
+
 void Tween::OnInitialize(const YAML::Node& config) {
   YamlReader reader(config);
   std::string body_name = reader.Get<std::string>("body");
@@ -98,14 +160,17 @@ void Tween::OnInitialize(const YAML::Node& config) {
   // reciprocal, loop, or oneshot
   std::string mode = reader.Get<std::string>("mode", "yoyo");
   duration_ = reader.Get<float>("duration", 1.0);
+  if (duration_ <= 0) {
+    throw YAMLException("Duration must be positive");
+  }
 
   delta_ = reader.GetPose("delta", Pose(0, 0, 0));
 
   // Boolean play pause topic
   std::string trigger_topic = reader.Get<std::string>("trigger_topic", "");
   if (trigger_topic != "") {
-    trigger_sub_ =
-        nh_.subscribe(trigger_topic, 1, &Tween::TriggerCallback, this);
+    trigger_sub_.Subscribe(nh_, trigger_topic, 1, &Tween::TriggerCallback,
+                           this);
   }
 
   body_ = GetModel()->GetBody(body_name);
@@ -122,112 +187,43 @@ void Tween::OnInitialize(const YAML::Node& config) {
   }
   mode_ = Tween::mode_strings_.at(mode);
 
-  tween_ = tweeny::from(0.0, 0.0, 0.0)
-               .to(delta_.x, delta_.y, delta_.theta)
-               .during((uint32)(duration_ * 1000.0));
-
   Tween::EasingType_ easing_type;
   std::string easing = reader.Get<std::string>("easing", "linear");
   if (!Tween::easing_strings_.count(easing)) {
-    throw YAMLException("Mode " + mode + " does not exist");
+    throw YAMLException("Easing " + easing + " does not exist");
   }
   easing_type = Tween::easing_strings_.at(easing);
+  bool easing_table = reader.Get<bool>("easing_table", false);
 
-  // This is clumsy but because tweeny used structs for each tweening rather
-  // than subclasses
-  // I believe that this is the best way to do this
-  switch (easing_type) {
-    case Tween::EasingType_::linear:
-      tween_ = tween_.via(tweeny::easing::linear);
-      break;
-    case Tween::EasingType_::quadraticIn:
-      tween_ = tween_.via(tweeny::easing::quadraticIn);
-      break;
-    case Tween::EasingType_::quadraticOut:
-      tween_ = tween_.via(tweeny::easing::quadraticOut);
-      break;
-    case Tween::EasingType_::quadraticInOut:
-      tween_ = tween_.via(tweeny::easing::quadraticInOut);
-      break;
-    case Tween::EasingType_::cubicIn:
-      tween_ = tween_.via(tweeny::easing::cubicIn);
-      break;
-    case Tween::EasingType_::cubicOut:
-      tween_ = tween_.via(tweeny::easing::cubicOut);
-      break;
-    case Tween::EasingType_::cubicInOut:
-      tween_ = tween_.via(tweeny::easing::cubicInOut);
-      break;
-    case Tween::EasingType_::quarticIn:
-      tween_ = tween_.via(tweeny::easing::quarticIn);
-      break;
-    case Tween::EasingType_::quarticOut:
-      tween_ = tween_.via(tweeny::easing::quarticOut);
-      break;
-    case Tween::EasingType_::quarticInOut:
-      tween_ = tween_.via(tweeny::easing::quarticInOut);
-      break;
-    case Tween::EasingType_::quinticIn:
-      tween_ = tween_.via(tweeny::easing::quinticIn);
-      break;
-    case Tween::EasingType_::quinticOut:
-      tween_ = tween_.via(tweeny::easing::quinticOut);
-      break;
-    case Tween::EasingType_::quinticInOut:
-      tween_ = tween_.via(tweeny::easing::quinticInOut);
+  KinematicAnimator::Mode animator_mode = KinematicAnimator::Mode::ONCE;
+  switch (mode_) {
+    case Tween::ModeType_::YOYO:
+      animator_mode = KinematicAnimator::Mode::YOYO;
       break;
-    // case Tween::EasingType_::sinuisodal:
-    //   tween_ = tween_.via(tweeny::easing::sinuisodal);
-    //   break;
-    case Tween::EasingType_::exponentialIn:
-      tween_ = tween_.via(tweeny::easing::exponentialIn);
+    case Tween::ModeType_::LOOP:
+      animator_mode = KinematicAnimator::Mode::LOOP;
       break;
-    case Tween::EasingType_::exponentialOut:
-      tween_ = tween_.via(tweeny::easing::exponentialOut);
+    case Tween::ModeType_::ONCE:
+      animator_mode = KinematicAnimator::Mode::ONCE;
       break;
-    case Tween::EasingType_::exponentialInOut:
-      tween_ = tween_.via(tweeny::easing::exponentialInOut);
+    case Tween::ModeType_::TRIGGER:
+      animator_mode = KinematicAnimator::Mode::TRIGGER;
       break;
-    case Tween::EasingType_::circularIn:
-      tween_ = tween_.via(tweeny::easing::circularIn);
-      break;
-    case Tween::EasingType_::circularOut:
-      tween_ = tween_.via(tweeny::easing::circularOut);
-      break;
-    case Tween::EasingType_::circularInOut:
-      tween_ = tween_.via(tweeny::easing::circularInOut);
-      break;
-    case Tween::EasingType_::backIn:
-      tween_ = tween_.via(tweeny::easing::backIn);
-      break;
-    case Tween::EasingType_::backOut:
-      tween_ = tween_.via(tweeny::easing::backOut);
-      break;
-    case Tween::EasingType_::backInOut:
-      tween_ = tween_.via(tweeny::easing::backInOut);
-      break;
-    case Tween::EasingType_::elasticIn:
-      tween_ = tween_.via(tweeny::easing::elasticIn);
-      break;
-    case Tween::EasingType_::elasticOut:
-      tween_ = tween_.via(tweeny::easing::elasticOut);
-      break;
-    case Tween::EasingType_::elasticInOut:
-      tween_ = tween_.via(tweeny::easing::elasticInOut);
-      break;
-    case Tween::EasingType_::bounceIn:
-      tween_ = tween_.via(tweeny::easing::bounceIn);
-      break;
-    case Tween::EasingType_::bounceOut:
-      tween_ = tween_.via(tweeny::easing::bounceOut);
-      break;
-    case Tween::EasingType_::bounceInOut:
-      tween_ = tween_.via(tweeny::easing::bounceInOut);
-      break;
-    default:
-      throw new Exception("Unknown easing type!");
   }
 
+  // the animator of the world moves all tweens in one pass before the model
+  // plugins, so this plugin is only called once
+  animator_ = GetKinematicAnimator();
+  if (animator_) {
+    SetUpdateRate(0);
+  } else {
+    own_animator_.reset(new KinematicAnimator());
+    animator_ = own_animator_.get();
+  }
+  track_id_ = animator_->Add(body_, start_, delta_, duration_, animator_mode,
+                             Tween::easing_functions_.at(easing_type),
+                             easing_table);
+
   // Make sure there are no unused keys
   reader.EnsureAccessedAllKeys();
 
@@ -245,44 +241,15 @@ void Tween::OnInitialize(const YAML::Node& config) {
 
 void Tween::TriggerCallback(const std_msgs::Bool& msg) {
   triggered_ = msg.data;
+  animator_->SetTriggered(track_id_, triggered_);
 }
 
 void Tween::BeforePhysicsStep(const Timekeeper& timekeeper) {
-  std::array<double, 3> v =
-      tween_.step((uint32)(timekeeper.GetStepSize() * 1000.0));
-  ROS_DEBUG_THROTTLE_NAMED(1.0, "Tween", "value %f,%f,%f step %f progress %f",
-                           v[0], v[1], v[2], timekeeper.GetStepSize(),
-                           tween_.progress());
-  body_->physics_body_->SetTransform(b2Vec2(start_.x + v[0], start_.y + v[1]),
-                                     start_.theta + v[2]);
-  // Tell Box2D to update the AABB and check for collisions for this object
-  body_->physics_body_->SetAwake(true);
-
-  // Yoyo back and forth
-  if (mode_ == Tween::ModeType_::YOYO) {
-    if (tween_.progress() >= 1.0f) {
-      tween_.backward();
-    } else if (tween_.progress() <= 0.001f) {
-      tween_.forward();
-    }
-  }
-
-  // Teleport back in loop mode
-  if (mode_ == Tween::ModeType_::LOOP) {
-    if (tween_.progress() >= 1.0f) {
-      tween_.seek(0);
-    }
-  }
-
-  // Handle external trigger
-  if (mode_ == Tween::ModeType_::TRIGGER) {
-    if (triggered_) {
-      tween_.forward();
-    } else {
-      tween_.backward();
-    }
+  if (own_animator_) {
+    own_animator_->Step(timekeeper.GetStepSize());
   }
 }
 }
 
-PLUGINLIB_EXPORT_CLASS(flatland_plugins::Tween, flatland_server::ModelPlugin)
\ No newline at end of file
+PLUGINLIB_EXPORT_CLASS(flatland_plugins::Tween, flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::Tween, flatland_server::ModelPlugin)
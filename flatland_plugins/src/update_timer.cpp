@@ -50,7 +50,9 @@
 namespace flatland_plugins {
 
 UpdateTimer::UpdateTimer()
-    : period_(ros::Duration(0)), last_update_time_(ros::Time(0, 0)) {}
+    : period_(ros::Duration(0)),
+      last_update_time_(ros::Time(0, 0)),
+      stagger_(0) {}
 
 void UpdateTimer::SetRate(double rate) {
   if (rate == 0.0)
@@ -59,6 +61,8 @@ void UpdateTimer::SetRate(double rate) {
     period_ = ros::Duration(1.0 / rate);
 }
 
+void UpdateTimer::SetStagger(double fraction) { stagger_ = fraction; }
+
 bool UpdateTimer::CheckUpdate(const flatland_server::Timekeeper &timekeeper) {
   if (fabs(period_.toSec()) < 1e-5) {
     return true;
@@ -77,9 +81,13 @@ bool UpdateTimer::CheckUpdate(const flatland_server::Timekeeper &timekeeper) {
   // Method obtained from Hector Gazebo Plugins, works well when the step size
   // is stable and close to max step size.
   // hector_gazebo/hector_gazebo_plugins/include/hector_gazebo_plugins/update_timer.h
+  // the stagger shifts the updates by less than a period, adding a period
+  // keeps the time positive. A rate of 0 is not staggered, it updates once
   double step = timekeeper.GetMaxStepSize();
-  double fraction =
-      fmod(timekeeper.GetSimTime().toSec() + (step / 2.0), period_.toSec());
+  double period = period_.toSec();
+  double offset = period_.sec < INT32_MAX ? stagger_ * period : 0;
+  double fraction = fmod(
+      timekeeper.GetSimTime().toSec() + (step / 2.0) - offset + period, period);
 
   if ((fraction >= 0.0) && (fraction < step)) {
     last_update_time_ = timekeeper.GetSimTime();
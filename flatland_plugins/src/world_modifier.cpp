@@ -47,6 +47,7 @@
 #include <ros/ros.h>
 
 #include <flatland_plugins/world_modifier.h>
+#include <flatland_server/exceptions.h>
 #include <flatland_server/layer.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world.h>
@@ -87,7 +88,13 @@ WorldModifier::WorldModifier(flatland_server::World *world,
       layer_name_(layer_name),
       wall_wall_dist_(wall_wall_dist),
       double_wall_(double_wall),
-      robot_ini_pose_(robot_ini_pose) {}
+      robot_ini_pose_(robot_ini_pose) {
+  // resolve the layer once instead of for every wall
+  layer_ = world_->GetLayer(layer_name_);
+  if (layer_ == nullptr) {
+    throw Exception("no such layer name " + Q(layer_name_));
+  }
+}
 
 void WorldModifier::CalculateNewWall(double d, b2Vec2 vertex1, b2Vec2 vertex2,
                                      b2EdgeShape &new_wall) {
@@ -122,30 +129,22 @@ void WorldModifier::CalculateNewWall(double d, b2Vec2 vertex1, b2Vec2 vertex2,
 }
 
 void WorldModifier::AddWall(b2EdgeShape &new_wall) {
-  Layer *layer = NULL;
-  std::vector<std::string> cfr_names;
-  for (auto &it : world_->layers_name_map_) {
-    for (auto &v_it : it.first) {
-      if (v_it == layer_name_) {
-        layer = it.second;
-        cfr_names = it.first;
-        break;
-      }
-    }
-  }
-  if (layer == NULL) {
-    throw("no such layer name!");
-  }
-  b2FixtureDef fixture_def;
-  fixture_def.shape = &new_wall;
-  uint16_t categoryBits = layer->cfr_->GetCategoryBits(cfr_names);
-  fixture_def.filter.categoryBits = categoryBits;
-  fixture_def.filter.maskBits = categoryBits;
+  AddWalls(std::vector<b2EdgeShape>(1, new_wall));
+}
 
-  layer->body_->physics_body_->CreateFixture(&fixture_def);
+void WorldModifier::AddWalls(const std::vector<b2EdgeShape> &walls) {
+  std::vector<b2Fixture *> fixtures = layer_->AddSegments(walls);
+  walls_.insert(walls_.end(), fixtures.begin(), fixtures.end());
 }
 
-void WorldModifier::AddSideWall(b2EdgeShape &old_wall, b2EdgeShape &new_wall) {
+void WorldModifier::RemoveWalls() {
+  layer_->RemoveSegments(walls_);
+  walls_.clear();
+}
+
+void WorldModifier::CalculateSideWalls(const b2EdgeShape &old_wall,
+                                       const b2EdgeShape &new_wall,
+                                       std::vector<b2EdgeShape> *walls) {
   b2Vec2 old_wall_v1 = old_wall.m_vertex1;
   b2Vec2 old_wall_v2 = old_wall.m_vertex2;
   b2Vec2 new_wall_v1 = new_wall.m_vertex1;
@@ -158,9 +157,8 @@ void WorldModifier::AddSideWall(b2EdgeShape &old_wall, b2EdgeShape &new_wall) {
        std::pow((old_wall_v2.x - old_wall_v1.x), 2));
   double x = new_wall_v1.x - k * (old_wall_v2.y - old_wall_v1.y);
   double y = new_wall_v1.y + k * (old_wall_v2.x - old_wall_v1.x);
-  b2EdgeShape first_wall;
-  first_wall.Set(new_wall_v1, b2Vec2(x, y));
-  AddWall(first_wall);
+  walls->push_back(b2EdgeShape());
+  walls->back().Set(new_wall_v1, b2Vec2(x, y));
 
   // second side
   k = ((old_wall_v2.y - old_wall_v1.y) * (new_wall_v2.x - old_wall_v1.x) -
@@ -169,29 +167,50 @@ void WorldModifier::AddSideWall(b2EdgeShape &old_wall, b2EdgeShape &new_wall) {
        std::pow((old_wall_v2.x - old_wall_v1.x), 2));
   x = new_wall_v2.x - k * (old_wall_v2.y - old_wall_v1.y);
   y = new_wall_v2.y + k * (old_wall_v2.x - old_wall_v1.x);
-  b2EdgeShape second_wall;
-  second_wall.Set(new_wall_v2, b2Vec2(x, y));
-  AddWall(second_wall);
+  walls->push_back(b2EdgeShape());
+  walls->back().Set(new_wall_v2, b2Vec2(x, y));
 }
 
-void WorldModifier::AddFullWall(b2EdgeShape *wall) {
-  b2Vec2 vertex1 = wall->m_vertex1;
-  b2Vec2 vertex2 = wall->m_vertex2;
+void WorldModifier::AddSideWall(b2EdgeShape &old_wall, b2EdgeShape &new_wall) {
+  std::vector<b2EdgeShape> walls;
+  CalculateSideWalls(old_wall, new_wall, &walls);
+  AddWalls(walls);
+}
+
+void WorldModifier::CalculateFullWall(const b2EdgeShape &wall,
+                                      std::vector<b2EdgeShape> *walls) {
+  b2Vec2 vertex1 = wall.m_vertex1;
+  b2Vec2 vertex2 = wall.m_vertex2;
   double d = (robot_ini_pose_.x - vertex1.x) * (vertex2.y - vertex1.y) -
              (robot_ini_pose_.y - vertex1.y) * (vertex2.x - vertex1.x);
 
-  // add the main wall
+  // the main wall
   b2EdgeShape new_wall;
   CalculateNewWall(d, vertex1, vertex2, new_wall);
-  AddWall(new_wall);
-  // add the sidewall
-  AddSideWall(*wall, new_wall);
+  walls->push_back(new_wall);
+  // the sidewall
+  CalculateSideWalls(wall, new_wall, walls);
 
   if (double_wall_) {  // if add walls on both side
     CalculateNewWall(-d, vertex1, vertex2, new_wall);
-    AddWall(new_wall);
-    // add the sidewall
-    AddSideWall(*wall, new_wall);
+    walls->push_back(new_wall);
+    CalculateSideWalls(wall, new_wall, walls);
+  }
+}
+
+void WorldModifier::AddFullWall(b2EdgeShape *wall) {
+  std::vector<b2EdgeShape> walls;
+  CalculateFullWall(*wall, &walls);
+  AddWalls(walls);
+}
+
+void WorldModifier::AddFullWalls(
+    const std::vector<const b2EdgeShape *> &walls) {
+  std::vector<b2EdgeShape> new_walls;
+  new_walls.reserve(walls.size() * (double_wall_ ? 6 : 3));
+  for (const b2EdgeShape *wall : walls) {
+    CalculateFullWall(*wall, &new_walls);
   }
+  AddWalls(new_walls);
 }
-};  // namespace
\ No newline at end of file
+};  // namespace
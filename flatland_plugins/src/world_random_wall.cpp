@@ -47,14 +47,19 @@
 #include <Box2D/Box2D.h>
 #include <flatland_plugins/world_modifier.h>
 #include <flatland_plugins/world_random_wall.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world_plugin.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
 #include <algorithm>
+#include <ctime>
 #include <iostream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 using namespace flatland_server;
 using std::cout;
@@ -69,17 +74,11 @@ void RandomWall::OnInitialize(const YAML::Node &config) {
   double wall_wall_dist = plugin_reader.Get<double>("wall_wall_dist", 1);
   bool double_wall = plugin_reader.Get<bool>("double_wall", false);
   std::string robot_name = plugin_reader.Get<std::string>("robot_name", "");
-  Layer *layer = NULL;
-  for (auto &it : world_->layers_name_map_) {
-    for (auto &v_it : it.first) {
-      if (v_it == layer_name) {
-        layer = it.second;
-        break;
-      }
-    }
-  }
-  if (layer == NULL) {
-    throw("no such layer name!");
+  std::string reset_service =
+      plugin_reader.Get<std::string>("reset_service", "");
+  Layer *layer = world_->GetLayer(layer_name);
+  if (layer == nullptr) {
+    throw Exception("no such layer name " + Q(layer_name));
   }
 
   // read in the robot location from the world.yaml
@@ -106,27 +105,74 @@ void RandomWall::OnInitialize(const YAML::Node &config) {
     }
   }
   // create the world modifiyer
-  cout << "robot location read" << endl;
-  WorldModifier modifier(world_, layer_name, wall_wall_dist, double_wall,
-                         robot_ini_pose);
+  modifier_.reset(new WorldModifier(world_, layer_name, wall_wall_dist,
+                                    double_wall, robot_ini_pose));
 
-  // get all walls
-  std::vector<b2EdgeShape *> Wall_List;
+  // copy the walls once, later the fixtures of the layer also hold the
+  // obstacles, the edges of chain shapes are copied out of them
   for (b2Fixture *f = layer->body_->physics_body_->GetFixtureList(); f;
        f = f->GetNext()) {
-    Wall_List.push_back(static_cast<b2EdgeShape *>(f->GetShape()));
+    if (f->GetType() == b2Shape::e_edge) {
+      layer_walls_.push_back(*static_cast<b2EdgeShape *>(f->GetShape()));
+    } else if (f->GetType() == b2Shape::e_chain) {
+      b2ChainShape *chain = static_cast<b2ChainShape *>(f->GetShape());
+      for (int i = 0; i < chain->GetChildCount(); i++) {
+        layer_walls_.push_back(b2EdgeShape());
+        chain->GetChildEdge(&layer_walls_.back(), i);
+      }
+    }
   }
-  std::srand(std::time(0));
-  std::random_shuffle(Wall_List.begin(), Wall_List.end());
-  try {
-    for (unsigned int i = 0; i < num_of_walls; i++) {
-      modifier.AddFullWall(Wall_List[i]);
+  if (num_of_walls > layer_walls_.size()) {
+    ROS_WARN_NAMED("RandomWall", "Layer %s has only %lu walls",
+                   Q(layer_name).c_str(), layer_walls_.size());
+    num_of_walls = layer_walls_.size();
+  }
+  num_of_walls_ = num_of_walls;
+
+  rng_.seed(std::time(0));
+  AddRandomWalls();
+
+  if (!reset_service.empty()) {
+    reset_service_.Advertise(nh_, reset_service, &RandomWall::OnReset, this);
+  }
+}
+
+void RandomWall::AddRandomWalls() {
+  // Floyd's algorithm picks distinct walls in O(num_of_walls_)
+  std::unordered_set<size_t> picked;
+  std::vector<const b2EdgeShape *> walls;
+  walls.reserve(num_of_walls_);
+  for (size_t j = layer_walls_.size() - num_of_walls_; j < layer_walls_.size();
+       j++) {
+    size_t t = std::uniform_int_distribution<size_t>(0, j)(rng_);
+    if (!picked.insert(t).second) {
+      t = j;
+      picked.insert(j);
     }
-  } catch (std::string e) {
-    throw e;
+    walls.push_back(&layer_walls_[t]);
+  }
+  modifier_->AddFullWalls(walls);
+}
+
+void RandomWall::Reset() {
+  modifier_->RemoveWalls();
+  AddRandomWalls();
+}
+
+bool RandomWall::OnReset(std_srvs::Trigger::Request &request,
+                         std_srvs::Trigger::Response &response) {
+  try {
+    Reset();
+    response.success = true;
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
   }
+  return true;
 }
 };  // namespace
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::RandomWall,
-                       flatland_server::WorldPlugin)
\ No newline at end of file
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::RandomWall,
+                         flatland_server::WorldPlugin)
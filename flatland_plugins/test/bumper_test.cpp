@@ -280,6 +280,108 @@ TEST_F(BumperPluginTest, collision_test) {
   // ros::spin();
 }
 
+/**
+ * Test the table of contacts with many contacts, some of which end
+ */
+TEST_F(BumperPluginTest, contact_table_test) {
+  world_yaml =
+      this_file_dir / fs::path("bumper_tests/collision_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  Bumper* p = dynamic_cast<Bumper*>(w->plugin_manager_.model_plugins_[0].get());
+
+  // the contacts are only used as keys
+  std::vector<b2Contact*> contacts;
+  for (uintptr_t i = 1; i <= 100; i++) {
+    contacts.push_back(reinterpret_cast<b2Contact*>(i * 64));
+    Bumper::ContactState state;
+    state.contact = contacts.back();
+    p->contact_states_.push_back(state);
+  }
+  p->CompactContacts();
+  EXPECT_GE(p->contact_slots_.size(), 2 * contacts.size());
+  for (b2Contact* c : contacts) {
+    ASSERT_TRUE(p->FindContact(c) != nullptr);
+    EXPECT_EQ(p->FindContact(c)->contact, c);
+  }
+  EXPECT_TRUE(p->FindContact(reinterpret_cast<b2Contact*>(8)) == nullptr);
+
+  // ended contacts are no longer found, and removed in order
+  for (unsigned int i = 0; i < contacts.size(); i += 2) {
+    p->FindContact(contacts[i])->contact = nullptr;
+    p->ended_contacts_++;
+  }
+  p->CompactContacts();
+  ASSERT_EQ(p->contact_states_.size(), 50);
+  EXPECT_EQ(p->ended_contacts_, 0);
+  for (unsigned int i = 0; i < contacts.size(); i++) {
+    EXPECT_EQ(p->FindContact(contacts[i]) != nullptr, i % 2 == 1);
+  }
+  EXPECT_EQ(p->contact_states_[0].contact, contacts[1]);
+}
+
+/**
+ * Test the contacts are summed up per body of the model and other entity
+ */
+TEST_F(BumperPluginTest, aggregate_test) {
+  world_yaml =
+      this_file_dir / fs::path("bumper_tests/collision_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  Bumper* p = dynamic_cast<Bumper*>(w->plugin_manager_.model_plugins_[0].get());
+  Body* b0 = p->GetModel()->bodies_[0];
+  Body* b1 = p->GetModel()->bodies_[1];
+  Layer* layer = w->GetLayer("layer_1");
+
+  // the contacts are only used as keys
+  auto add = [&](uintptr_t key, Body* body_A, Entity* entity_B, Body* body_B,
+                 int point_count) {
+    Bumper::ContactState state;
+    state.contact = reinterpret_cast<b2Contact*>(key * 64);
+    state.body_A = body_A;
+    state.entity_B = entity_B;
+    state.body_B = body_B;
+    state.num_count = point_count > 0 ? 1 : 0;
+    state.point_count = point_count;
+    p->contact_states_.push_back(state);
+    return &p->contact_states_.back();
+  };
+
+  Bumper::ContactState* s = add(1, b1, layer, layer->body_, 2);
+  s->sum_normal_impulses[0] = 0.01;
+  s->sum_normal_impulses[1] = 0.03;
+  s->points[0] = b2Vec2(1, 0);
+  s->points[1] = b2Vec2(1, 1);
+  s->normal = b2Vec2(1, 0);
+  add(2, b0, layer, layer->body_, 0);  // a sensor
+  s = add(3, b1, layer, layer->body_, 1);
+  s->sum_normal_impulses[0] = 0.02;
+  s->points[0] = b2Vec2(1, 2);
+  s->normal = b2Vec2(0, 1);
+  s = add(4, b1, p->GetModel(), b0, 1);
+  s->sum_normal_impulses[0] = 0.01;
+  s->points[0] = b2Vec2(0, 0);
+  s->normal = b2Vec2(-1, 0);
+
+  p->AggregateContacts(0.01);
+  ASSERT_EQ(p->pair_states_.size(), 3);
+
+  const Bumper::PairState& wall = p->pair_states_[0];
+  EXPECT_EQ(wall.body_A, b1);
+  EXPECT_EQ(wall.entity_B, layer);
+  EXPECT_EQ(wall.point_count, 3);
+  EXPECT_NEAR(wall.force, 6, 1e-5);
+  EXPECT_NEAR(wall.weighted_point.x / wall.force, 1, 1e-5);
+  EXPECT_NEAR(wall.weighted_point.y / wall.force, 7.0 / 6, 1e-5);
+  EXPECT_NEAR(wall.weighted_normal.x, 4, 1e-5);
+  EXPECT_NEAR(wall.weighted_normal.y, 2, 1e-5);
+
+  EXPECT_EQ(p->pair_states_[1].body_A, b0);
+  EXPECT_EQ(p->pair_states_[1].point_count, 0);
+
+  EXPECT_EQ(p->pair_states_[2].entity_B, p->GetModel());
+  EXPECT_EQ(p->pair_states_[2].body_B, b0);
+  EXPECT_NEAR(p->pair_states_[2].force, 1, 1e-5);
+}
+
 /**
  * Test with a invalid body specified in the exclude list
  */
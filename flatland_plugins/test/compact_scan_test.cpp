@@ -0,0 +1,108 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	  compact_scan_test.cpp
+ * @brief   Test the quantization of laser scans
+ * @author  Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/compact_scan.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace flatland_plugins;
+
+/**
+ * Test that a scan survives a round trip within half the resolution
+ */
+TEST(CompactScanTest, round_trip) {
+  sensor_msgs::LaserScan scan;
+  scan.header.frame_id = "laser";
+  scan.angle_min = -1;
+  scan.angle_max = 1;
+  scan.angle_increment = 0.5;
+  scan.range_max = 10;
+  scan.ranges = {0.0004f, 1.2345f, NAN, 9.9999f, 12.0f};
+  scan.intensities = {0, 255, 300, -5, 127.6f};
+
+  flatland_msgs::CompactScan compact;
+  CompactScan::Encode(scan, 0.001, true, &compact);
+  ASSERT_EQ(compact.ranges.size(), 5u);
+  EXPECT_EQ(compact.ranges[0], 1u);  // returns are never taken for none
+  EXPECT_EQ(compact.ranges[1], 1235u);
+  EXPECT_EQ(compact.ranges[2], CompactScan::NO_RETURN);
+  EXPECT_EQ(compact.ranges[3], 10000u);
+  EXPECT_EQ(compact.ranges[4], 12000u);
+  std::vector<uint8_t> intensities = {0, 255, 255, 0, 128};
+  EXPECT_EQ(compact.intensities, intensities);
+
+  sensor_msgs::LaserScan restored;
+  CompactScan::Decode(compact, &restored);
+  EXPECT_EQ(restored.header.frame_id, "laser");
+  EXPECT_FLOAT_EQ(restored.angle_max, 1);
+  EXPECT_FLOAT_EQ(restored.range_max, 10);
+  ASSERT_EQ(restored.ranges.size(), 5u);
+  EXPECT_NEAR(restored.ranges[1], 1.2345, 0.0005);
+  EXPECT_TRUE(std::isnan(restored.ranges[2]));
+  EXPECT_NEAR(restored.ranges[3], 10, 0.0005);
+  EXPECT_EQ(restored.intensities.size(), 5u);
+}
+
+/**
+ * Test that the intensities can be left out and ranges saturate
+ */
+TEST(CompactScanTest, saturation) {
+  sensor_msgs::LaserScan scan;
+  scan.ranges = {100, -1};
+  scan.intensities = {1, 2};
+
+  flatland_msgs::CompactScan compact;
+  CompactScan::Encode(scan, 0.001, false, &compact);
+  EXPECT_TRUE(compact.intensities.empty());
+  EXPECT_EQ(compact.ranges[0], CompactScan::MAX_RANGE);
+  EXPECT_EQ(compact.ranges[1], 1u);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,145 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 crowd_test.cpp
+ * @brief	 test crowd plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/crowd.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class CrowdTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    world_yaml = this_file_dir / fs::path("crowd_tests/world.yaml");
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  // load the world and step it, return the positions of the agents
+  std::vector<b2Vec2> Run(unsigned int steps) {
+    if (w != nullptr) {
+      delete w;
+    }
+    w = World::MakeWorld(world_yaml.string());
+    Timekeeper timekeeper;
+    timekeeper.SetMaxStepSize(0.05);
+    for (unsigned int i = 0; i < steps; i++) {
+      w->Update(timekeeper);
+    }
+
+    std::vector<b2Vec2> positions;
+    for (b2Body* b : GetCrowd()->bodies_) {
+      positions.push_back(b->GetPosition());
+    }
+    return positions;
+  }
+
+  Crowd* GetCrowd() {
+    return dynamic_cast<Crowd*>(w->plugin_manager_.world_plugins_[0].get());
+  }
+};
+
+/**
+ * Test the agents are created in the area and belong to the crowd entity
+ */
+TEST_F(CrowdTest, load_test) {
+  std::vector<b2Vec2> positions = Run(0);
+  Crowd* crowd = GetCrowd();
+  ASSERT_NE(crowd, nullptr);
+  ASSERT_EQ(positions.size(), 20u);
+
+  for (const b2Vec2& p : positions) {
+    EXPECT_GE(p.x, 2);
+    EXPECT_LE(p.x, 8);
+    EXPECT_GE(p.y, 2);
+    EXPECT_LE(p.y, 8);
+  }
+
+  b2Body* b = crowd->bodies_[3];
+  EXPECT_EQ(b->GetType(), b2_kinematicBody);
+  Body* body = static_cast<Body*>(b->GetUserData());
+  EXPECT_EQ(body->GetEntity()->GetName(), "crowd");
+  EXPECT_EQ(body->GetEntity()->Type(), Entity::EntityType::MODEL);
+  EXPECT_EQ(b->GetFixtureList()->GetFilterData().categoryBits, 1u);
+}
+
+/**
+ * Test the agents walk and a run with the same seed is the same
+ */
+TEST_F(CrowdTest, walk_test) {
+  std::vector<b2Vec2> start = Run(0);
+  std::vector<b2Vec2> end = Run(40);
+  std::vector<b2Vec2> again = Run(40);
+
+  ASSERT_EQ(end.size(), start.size());
+  double moved = 0;
+  for (unsigned int i = 0; i < end.size(); i++) {
+    moved += (end[i] - start[i]).Length();
+    EXPECT_EQ(end[i].x, again[i].x);
+    EXPECT_EQ(end[i].y, again[i].y);
+  }
+  EXPECT_GT(moved / end.size(), 0.5);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "crowd_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
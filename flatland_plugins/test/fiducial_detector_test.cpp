@@ -0,0 +1,141 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fiducial_detector_test.cpp
+ * @brief	 test fiducial detector plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/FiducialDetections.h>
+#include <flatland_plugins/fiducial_detector.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class FiducialDetectorTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  flatland_msgs::FiducialDetections detections;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  void DetectionsCb(const flatland_msgs::FiducialDetections& msg) {
+    detections = msg;
+  };
+};
+
+/**
+ * Test the models in range and in the field of view are detected unless
+ * another model blocks the line of sight
+ */
+TEST_F(FiducialDetectorTest, detections_test) {
+  world_yaml = this_file_dir / fs::path("fiducial_detector_tests/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub;
+  FiducialDetectorTest* obj = dynamic_cast<FiducialDetectorTest*>(this);
+  sub = nh.subscribe("r/detections", 1, &FiducialDetectorTest::DetectionsCb,
+                     obj);
+
+  // let it spin for 10 times to make sure the message gets through
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  // tag_2 is out of the field of view and tag_3 is behind tag_1
+  EXPECT_EQ(detections.header.frame_id, "r_detector");
+  ASSERT_EQ(detections.detections.size(), 2u);
+
+  const flatland_msgs::FiducialDetection& d1 = detections.detections[0];
+  EXPECT_EQ(d1.name, "tag_1");
+  EXPECT_EQ(d1.id, 1);
+  EXPECT_NEAR(d1.pose.x, 2, 1e-5);
+  EXPECT_NEAR(d1.pose.y, 0, 1e-5);
+  EXPECT_NEAR(d1.pose.theta, 0.5, 1e-5);
+  EXPECT_NEAR(d1.range, 2, 1e-5);
+  EXPECT_NEAR(d1.bearing, 0, 1e-5);
+
+  const flatland_msgs::FiducialDetection& d4 = detections.detections[1];
+  EXPECT_EQ(d4.name, "tag_4");
+  EXPECT_EQ(d4.id, 4);
+  EXPECT_NEAR(d4.range, 4.317407, 1e-4);
+  EXPECT_NEAR(d4.bearing, -0.233743, 1e-4);
+}
+
+/**
+ * Test the ids of the models are the numbers at the end of their names
+ */
+TEST_F(FiducialDetectorTest, parse_id_test) {
+  EXPECT_EQ(FiducialDetector::ParseId("tag_12"), 12);
+  EXPECT_EQ(FiducialDetector::ParseId("7"), 7);
+  EXPECT_EQ(FiducialDetector::ParseId("tag"), -1);
+  EXPECT_EQ(FiducialDetector::ParseId(""), -1);
+  EXPECT_EQ(FiducialDetector::ParseId("tag_12345678901"), -1);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "fiducial_detector_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
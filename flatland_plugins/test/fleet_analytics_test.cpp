@@ -0,0 +1,130 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 fleet_analytics_test.cpp
+ * @brief	 Test the fleet analytics plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/fleet_analytics.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class FleetAnalyticsTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    world_yaml = this_file_dir / fs::path("fleet_analytics_tests/world.yaml");
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  FleetAnalytics* GetAnalytics() {
+    return dynamic_cast<FleetAnalytics*>(
+        w->plugin_manager_.world_plugins_[0].get());
+  }
+};
+
+/**
+ * Test the near misses, collisions, region use and heatmap of three balls,
+ * two of them overlapping at the start
+ */
+TEST_F(FleetAnalyticsTest, aggregate_test) {
+  w = World::MakeWorld(world_yaml.string());
+  FleetAnalytics* analytics = GetAnalytics();
+  ASSERT_NE(analytics, nullptr);
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  for (unsigned int i = 0; i < 25; i++) {
+    w->Update(timekeeper);
+  }
+
+  // the overlapping balls push each other apart, they count once
+  EXPECT_EQ(analytics->near_misses_total_, 1u);
+  EXPECT_EQ(analytics->collisions_total_, 1u);
+  EXPECT_EQ(analytics->close_pairs_.size(), 1u);
+
+  // summaries at 0.1 and 0.2 s, the second one covers a full period
+  const flatland_msgs::FleetAnalytics& msg = analytics->msg_;
+  EXPECT_NEAR(msg.period, 0.1, 1e-6);
+  EXPECT_EQ(msg.models, 3u);
+  EXPECT_EQ(msg.near_misses, 0u);
+  EXPECT_EQ(msg.near_misses_total, 1u);
+  ASSERT_EQ(msg.regions.size(), 2u);
+  EXPECT_EQ(msg.regions[0].name, "corner");
+  EXPECT_NEAR(msg.regions[0].dwell_time, 0.1, 1e-6);
+  EXPECT_NEAR(msg.regions[0].utilization, 1, 1e-6);
+  EXPECT_EQ(msg.regions[0].entries, 0u);
+  EXPECT_EQ(msg.regions[0].occupants, 1u);
+  EXPECT_EQ(msg.regions[1].name, "empty");
+  EXPECT_EQ(msg.regions[1].dwell_time, 0);
+  EXPECT_EQ(msg.regions[1].occupants, 0u);
+
+  // the heat is in the cells of the balls, two balls heat their cell twice
+  // as much as one
+  const std::vector<float>& heat = analytics->heat_;
+  ASSERT_EQ(heat.size(), 100u);
+  EXPECT_GT(heat[8 * 10 + 8], 0);
+  EXPECT_NEAR(heat[5 * 10 + 5], 2 * heat[8 * 10 + 8], 1e-3 * heat[5 * 10 + 5]);
+  EXPECT_EQ(heat[0], 0);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "fleet_analytics_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
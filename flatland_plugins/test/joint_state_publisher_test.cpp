@@ -0,0 +1,130 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 joint_state_publisher_test.cpp
+ * @brief	 Test the JointStatePublisher plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/joint_state_publisher.h>
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+TEST(JointStatePublisherTest, load_test) {
+  pluginlib::ClassLoader<flatland_server::ModelPlugin> loader(
+      "flatland_server", "flatland_server::ModelPlugin");
+
+  try {
+    boost::shared_ptr<flatland_server::ModelPlugin> plugin =
+        loader.createInstance("flatland_plugins::JointStatePublisher");
+  } catch (pluginlib::PluginlibException& e) {
+    FAIL() << "Failed to load JointStatePublisher plugin. " << e.what();
+  }
+}
+
+/**
+ * Test the joint states of a spinning wheel and a weld joint
+ */
+TEST(JointStatePublisherTest, publish_test) {
+  fs::path world_yaml = fs::path(__FILE__).parent_path() /
+                        "joint_state_publisher_tests/world.yaml";
+  World* w = World::MakeWorld(world_yaml.string());
+  JointStatePublisher* p = dynamic_cast<JointStatePublisher*>(
+      w->plugin_manager_.model_plugins_[0].get());
+
+  // the names are in the order of the configuration
+  ASSERT_EQ(2u, p->joint_state_.name.size());
+  EXPECT_EQ("wheel_joint", p->joint_state_.name[0]);
+  EXPECT_EQ("antenna_weld", p->joint_state_.name[1]);
+
+  sensor_msgs::JointState received;
+  int count = 0;
+  ros::NodeHandle nh;
+  ros::Subscriber sub = nh.subscribe<sensor_msgs::JointState>(
+      "joint_states", 1, [&](const sensor_msgs::JointStateConstPtr& msg) {
+        received = *msg;
+        count++;
+      });
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5);
+  while (p->publisher_.getNumSubscribers() == 0 &&
+         ros::WallTime::now() < deadline) {
+    ros::WallDuration(0.01).sleep();
+  }
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.1);
+  w->GetModel("robot1")
+      ->GetBody("wheel")
+      ->physics_body_->SetAngularVelocity(1.0);
+  // the joints are read before the physics step, the second update publishes
+  // the state after the first step
+  w->Update(timekeeper);
+  w->Update(timekeeper);
+
+  deadline = ros::WallTime::now() + ros::WallDuration(5);
+  while (count < 2 && ros::WallTime::now() < deadline) {
+    ros::spinOnce();
+    ros::WallDuration(0.01).sleep();
+  }
+  ASSERT_EQ(2u, received.name.size());
+  EXPECT_NEAR(0.1, received.position[0], 1e-3);
+  EXPECT_NEAR(1.0, received.velocity[0], 1e-3);
+  EXPECT_NEAR(0.0, received.position[1], 1e-3);
+  EXPECT_NEAR(0.0, received.velocity[1], 1e-3);
+
+  delete w;
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "joint_state_publisher_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -62,6 +62,7 @@ class LaserPluginTest : public ::testing::Test {
   boost::filesystem::path this_file_dir;
   boost::filesystem::path world_yaml;
   sensor_msgs::LaserScan scan_front, scan_center, scan_back;
+  sensor_msgs::LaserScan scan_multi, scan_multi_echo2, scan_sweep;
   World* w;
 
   void SetUp() override {
@@ -160,6 +161,11 @@ class LaserPluginTest : public ::testing::Test {
   void ScanFrontCb(const sensor_msgs::LaserScan& msg) { scan_front = msg; };
   void ScanCenterCb(const sensor_msgs::LaserScan& msg) { scan_center = msg; };
   void ScanBackCb(const sensor_msgs::LaserScan& msg) { scan_back = msg; };
+  void ScanMultiCb(const sensor_msgs::LaserScan& msg) { scan_multi = msg; };
+  void ScanMultiEcho2Cb(const sensor_msgs::LaserScan& msg) {
+    scan_multi_echo2 = msg;
+  };
+  void ScanSweepCb(const sensor_msgs::LaserScan& msg) { scan_sweep = msg; };
 };
 
 /**
@@ -208,6 +214,198 @@ TEST_F(LaserPluginTest, range_test) {
   EXPECT_TRUE(fltcmp(p3->update_rate_, 1)) << "Actual: " << p2->update_rate_;
   EXPECT_EQ(p3->body_, w->models_[0]->bodies_[0]);
 }
+
+/**
+ * Test the laser plugin reports the nearest returns of each beam on one topic
+ * per echo, the second echo comes from the walls of layer_1 behind layer_2
+ */
+TEST_F(LaserPluginTest, multi_echo_test) {
+  world_yaml = this_file_dir / fs::path("laser_tests/range_test/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub_1, sub_2;
+  LaserPluginTest* obj = dynamic_cast<LaserPluginTest*>(this);
+  sub_1 = nh.subscribe("r/scan_multi", 1, &LaserPluginTest::ScanMultiCb, obj);
+  sub_2 = nh.subscribe("r/scan_multi_echo2", 1,
+                       &LaserPluginTest::ScanMultiEcho2Cb, obj);
+
+  Laser* p4 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[3].get());
+
+  // let it spin for 10 times to make sure the message gets through
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  EXPECT_EQ(p4->echoes_, 2u);
+  EXPECT_EQ(p4->divergence_rays_, 3u);
+  EXPECT_TRUE(ScanEq(scan_multi, "r_laser_multi", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 4.4, 4.3}, {}));
+  EXPECT_TRUE(ScanEq(scan_multi_echo2, "r_laser_multi", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.9, 4.8, 4.7}, {}));
+}
+
+/**
+ * Test the laser plugin in sweep mode casts the beams of a scan over the
+ * steps of its period and stamps the scan with the time of its first beam
+ */
+TEST_F(LaserPluginTest, sweep_test) {
+  world_yaml = this_file_dir / fs::path("laser_tests/range_test/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  LaserPluginTest* obj = dynamic_cast<LaserPluginTest*>(this);
+  ros::Subscriber sub =
+      nh.subscribe("r/scan_sweep", 1, &LaserPluginTest::ScanSweepCb, obj);
+
+  Laser* p5 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[4].get());
+  ASSERT_TRUE(p5 != nullptr);
+  EXPECT_TRUE(p5->sweep_);
+
+  // the period of 2s is swept in 2 steps of 1s, the first beam on the first
+  // step and the two others on the second one
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    EXPECT_EQ(p5->sweep_beam_, i % 2 == 0 ? 1u : 0u) << "step " << i;
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  EXPECT_TRUE(ScanEq(scan_sweep, "r_laser_sweep", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 2.0 / 3.0, 2.0, 0.0, 5.0, {4.5, 4.4, 4.3}, {}));
+  EXPECT_EQ(std::fmod(scan_sweep.header.stamp.toSec(), 2.0), 0.0);
+}
+
+/**
+ * Test the laser plugin with static_cache raycasts the layers once while it
+ * is stationary, and the models in range on every scan
+ */
+TEST_F(LaserPluginTest, static_cache_test) {
+  world_yaml = this_file_dir / fs::path("laser_tests/range_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  w->LoadModel("obstacle.model.yaml", "", "obstacle", Pose(20, 20, 0));
+
+  Laser* p6 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[5].get());
+  ASSERT_TRUE(p6 != nullptr);
+  EXPECT_TRUE(p6->static_cache_);
+
+  // the same ranges as laser_front, only the robot itself is in range
+  p6->ComputeLaserRanges();
+  EXPECT_TRUE(p6->static_valid_);
+  EXPECT_EQ(p6->model_fixtures_.size(), 1u);
+  EXPECT_TRUE(ScanEq(p6->laser_scan_, "r_laser_static", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 4.4, 4.3}, {}));
+
+  // the obstacle moved in front of the laser is found by its bounding box,
+  // the layers are not cast again, so a planted layer hit is kept
+  w->MoveModel("obstacle", Pose(7, 5, 0));
+  p6->static_fractions_[0] = 0.5;
+  p6->ComputeLaserRanges();
+  EXPECT_EQ(p6->model_fixtures_.size(), 2u);
+  EXPECT_TRUE(ScanEq(p6->laser_scan_, "r_laser_static", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {2.5, 1.8, 4.3}, {}));
+
+  // moving the laser casts the layers again
+  w->MoveModel("robot1", Pose(5.5, 5, 0));
+  p6->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p6->static_pose_.x, 5.5);
+  EXPECT_TRUE(ScanEq(p6->laser_scan_, "r_laser_static", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 1.3, 4.3}, {}));
+}
+
+/**
+ * Test the laser plugin with scan_cache reuses its last scan while nothing in
+ * range changed, and casts again when the layers change, or a body in range
+ * is moved, added, deleted or restored
+ */
+TEST_F(LaserPluginTest, scan_cache_test) {
+  world_yaml = this_file_dir / fs::path("laser_tests/range_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  w->LoadModel("obstacle.model.yaml", "", "obstacle", Pose(7, 5, 0));
+  w->GetModel("obstacle")->bodies_[0]->physics_body_->SetAwake(false);
+  WorldSnapshot obstacle_in_front = w->Snapshot();
+  w->MoveModel("obstacle", Pose(20, 20, 0));
+
+  Laser* p7 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[6].get());
+  ASSERT_TRUE(p7 != nullptr);
+  EXPECT_TRUE(p7->scan_cache_);
+  b2Body* obstacle = w->GetModel("obstacle")->bodies_[0]->physics_body_;
+
+  // the ranges are cached, the bodies out of range are not recorded
+  p7->ComputeLaserRanges();
+  EXPECT_TRUE(p7->cache_valid_);
+  EXPECT_TRUE(p7->cached_bodies_.empty());
+  EXPECT_TRUE(ScanEq(p7->laser_scan_, "r_laser_cached", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 4.4, 4.3}, {}));
+
+  // a cache hit returns the planted range
+  p7->cached_ranges_[0] = 1;
+  p7->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p7->laser_scan_.ranges[0], 1);
+
+  // a body stepped into range by the physics
+  obstacle->SetTransform(b2Vec2(7, 5), 0);
+  w->plugin_manager_.body_states_.Refresh();
+  p7->ComputeLaserRanges();
+  EXPECT_TRUE(ScanEq(p7->laser_scan_, "r_laser_cached", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 1.8, 4.3}, {}));
+  ASSERT_EQ(p7->cached_bodies_.size(), 1u);
+  p7->cached_ranges_[0] = 1;
+  p7->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p7->laser_scan_.ranges[0], 1);
+
+  // a body in range stepped to another pose
+  obstacle->SetTransform(b2Vec2(7.5, 5), 0);
+  w->plugin_manager_.body_states_.Refresh();
+  p7->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p7->laser_scan_.ranges[1], 2.3);
+
+  // a body in range deleted
+  p7->cached_ranges_[0] = 1;
+  w->DeleteModel("obstacle");
+  p7->ComputeLaserRanges();
+  EXPECT_TRUE(ScanEq(p7->laser_scan_, "r_laser_cached", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 4.4, 4.3}, {}));
+
+  // a body spawned, then moved outside of the steps
+  w->LoadModel("obstacle.model.yaml", "", "obstacle", Pose(20, 20, 0));
+  p7->ComputeLaserRanges();
+  p7->cached_ranges_[0] = 1;
+  w->MoveModel("obstacle", Pose(20, 21, 0));
+  p7->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p7->laser_scan_.ranges[0], 4.5);
+
+  // a body restored asleep in range
+  p7->cached_ranges_[0] = 1;
+  w->Restore(obstacle_in_front);
+  p7->ComputeLaserRanges();
+  EXPECT_TRUE(ScanEq(p7->laser_scan_, "r_laser_cached", -M_PI / 2, M_PI / 2,
+                     M_PI / 2, 0.0, 0.0, 0.0, 5.0, {4.5, 1.8, 4.3}, {}));
+
+  // the geometry of a layer changed, e.g. reloaded or its tiles activated
+  p7->cached_ranges_[0] = 1;
+  w->layers_[0]->GeometryChanged();
+  p7->ComputeLaserRanges();
+  EXPECT_FLOAT_EQ(p7->laser_scan_.ranges[0], 4.5);
+
+  // the physics step clears the cache of a changed layer geometry
+  p7->cached_ranges_[0] = 1;
+  w->layers_[0]->GeometryChanged();
+  Timekeeper timekeeper;
+  p7->BeforePhysicsStep(timekeeper);
+  EXPECT_FALSE(p7->cache_valid_);
+}
+
 /**
  * Test the laser plugin for intensity configuration
  */
@@ -255,6 +453,33 @@ TEST_F(LaserPluginTest, intensity_test) {
   EXPECT_EQ(p3->body_, w->models_[0]->bodies_[0]);
 }
 
+/**
+ * Test the lasers of two models spawned from the same model YAML file share
+ * their parsed parameters, while each model has its own body
+ */
+TEST_F(LaserPluginTest, shared_config_test) {
+  world_yaml = this_file_dir / fs::path("laser_tests/range_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  size_t count = w->plugin_manager_.model_plugins_.size();
+
+  // relative to the world, the same path as robot1
+  w->LoadModel("robot.model.yaml", "r2", "robot2", Pose(1, 1, 0));
+  ASSERT_EQ(w->plugin_manager_.model_plugins_.size(), 2 * count);
+
+  for (size_t i = 0; i < count; i++) {
+    Laser* p1 =
+        dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[i].get());
+    Laser* p2 = dynamic_cast<Laser*>(
+        w->plugin_manager_.model_plugins_[count + i].get());
+    ASSERT_TRUE(p1 != nullptr && p2 != nullptr);
+    EXPECT_EQ(p1->config_, p2->config_);
+    EXPECT_NE(p1->body_, p2->body_);
+  }
+  Laser* p1 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[0].get());
+  Laser* p2 = dynamic_cast<Laser*>(w->plugin_manager_.model_plugins_[1].get());
+  EXPECT_NE(p1->config_, p2->config_);
+}
+
 /**
  * Checks the laser plugin will throw correct exception for invalid
  * configurations
@@ -0,0 +1,147 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 local_costmap_test.cpp
+ * @brief	 test local costmap plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/local_costmap.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <algorithm>
+#include <cmath>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class LocalCostmapTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  nav_msgs::OccupancyGrid grid;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  // cost of the cell of the grid containing a world point
+  int Cost(double x, double y) {
+    const nav_msgs::MapMetaData& info = grid.info;
+    int i = std::floor((x - info.origin.position.x) / info.resolution);
+    int j = std::floor((y - info.origin.position.y) / info.resolution);
+    return grid.data[j * info.width + i];
+  }
+
+  void GridCb(const nav_msgs::OccupancyGrid& msg) { grid = msg; };
+};
+
+/**
+ * Test the grid has the static layers and the other models but not the model
+ * of the costmap, and the window moved with the body keeps the same cells as
+ * a window rasterized from scratch
+ */
+TEST_F(LocalCostmapTest, rasterize_test) {
+  world_yaml = this_file_dir / fs::path("local_costmap_tests/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub;
+  LocalCostmapTest* obj = dynamic_cast<LocalCostmapTest*>(this);
+  sub = nh.subscribe("r/local_costmap", 1, &LocalCostmapTest::GridCb, obj);
+
+  LocalCostmap* p = dynamic_cast<LocalCostmap*>(
+      w->plugin_manager_.model_plugins_[0].get());
+
+  // let it spin for 10 times to make sure the message gets through
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  ASSERT_EQ(grid.info.width, 100u);
+  ASSERT_EQ(grid.info.height, 100u);
+  EXPECT_EQ(grid.header.frame_id, "map");
+
+  // the wall of layer_2 in front of the robot, the obstacle and the robot
+  EXPECT_EQ(Cost(9.35, 5.05), LocalCostmap::OCCUPIED);
+  EXPECT_EQ(Cost(6.05, 5.05), LocalCostmap::OCCUPIED);
+  EXPECT_EQ(Cost(5.55, 5.05), LocalCostmap::FREE);
+  EXPECT_EQ(Cost(5.05, 5.05), LocalCostmap::FREE);
+
+  // only the static bodies are kept between the updates
+  int i = std::floor(6.05 / p->resolution_) - p->origin_x_;
+  int j = std::floor(5.05 / p->resolution_) - p->origin_y_;
+  EXPECT_EQ(p->static_cells_[j * p->width_ + i], LocalCostmap::FREE);
+
+  // move the window by a few cells in x and y
+  p->body_->GetPhysicsBody()->SetTransform(b2Vec2(5.73, 4.42), 0);
+  p->UpdateWindow();
+  std::vector<int8_t> moved = p->static_cells_;
+  ASSERT_GT(std::count(moved.begin(), moved.end(), LocalCostmap::OCCUPIED), 0);
+
+  p->window_valid_ = false;
+  p->UpdateWindow();
+  EXPECT_EQ(moved, p->static_cells_);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "local_costmap_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -251,6 +251,53 @@ TEST_F(ModelTfPublisherTest, tf_publish_test_B) {
   EXPECT_TRUE(TfEq(tf_base_to_rear_bumper, -2, 0, 0));
 }
 
+/**
+ * Test that the transformations extrapolated between the physics steps are
+ * published with stamps ahead of the last step
+ */
+TEST_F(ModelTfPublisherTest, tf_extrapolation_test) {
+  world_yaml = this_file_dir /
+               fs::path("model_tf_publisher_tests/extrapolation/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  ModelTfPublisher* p = dynamic_cast<ModelTfPublisher*>(
+      w->plugin_manager_.model_plugins_[0].get());
+
+  EXPECT_DOUBLE_EQ(200.0, p->extrapolation_rate_);
+  EXPECT_NE(0u, p->extrapolation_task_);
+
+  tf2_ros::Buffer tf_buffer;
+  tf2_ros::TransformListener tf_listener(tf_buffer);
+
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 100; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+  // the last update was one step before the current time, the
+  // extrapolation runs up to it while the simulation is paused
+  for (unsigned int i = 0; i < 50; i++) {
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  geometry_msgs::TransformStamped tf_map_to_base =
+      tf_buffer.lookupTransform("map", "base", ros::Time(0));
+  geometry_msgs::TransformStamped tf_base_to_antenna =
+      tf_buffer.lookupTransform("base", "antenna", ros::Time(0));
+  EXPECT_GT(tf_map_to_base.header.stamp.toSec(),
+            timekeeper.GetSimTime().toSec() - 1.0);
+  EXPECT_LE(tf_map_to_base.header.stamp.toSec(),
+            timekeeper.GetSimTime().toSec() + 1e-6);
+
+  // the model rests, the extrapolation keeps its pose
+  EXPECT_TRUE(TfEq(tf_map_to_base, 8, 6, -0.575958653));
+  EXPECT_TRUE(TfEq(tf_base_to_antenna, 0, 0, 0));
+}
+
 /**
  * Test the transformation for the provided model yaml, which will fail due
  * to a nonexistent reference body
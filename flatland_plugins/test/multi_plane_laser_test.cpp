@@ -0,0 +1,151 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 multi_plane_laser_test.cpp
+ * @brief	 test multi plane laser plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/multi_plane_laser.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class MultiPlaneLaserTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  sensor_msgs::LaserScan scan_low, scan_high;
+  sensor_msgs::PointCloud2 cloud;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  // check the ranges of a scan, NAN is expected for rays without a hit
+  void ExpectRanges(const sensor_msgs::LaserScan& scan,
+                    const std::vector<float>& ranges) {
+    ASSERT_EQ(ranges.size(), scan.ranges.size());
+    for (unsigned int i = 0; i < ranges.size(); i++) {
+      EXPECT_NEAR(ranges[i], scan.ranges[i], 1e-5) << "i=" << i;
+    }
+  }
+
+  void ScanLowCb(const sensor_msgs::LaserScan& msg) { scan_low = msg; };
+  void ScanHighCb(const sensor_msgs::LaserScan& msg) { scan_high = msg; };
+  void CloudCb(const sensor_msgs::PointCloud2& msg) { cloud = msg; };
+};
+
+/**
+ * Test every plane scans its own layers, the ranges of the tilted plane are
+ * measured along its rays
+ */
+TEST_F(MultiPlaneLaserTest, planes_test) {
+  world_yaml =
+      this_file_dir / fs::path("multi_plane_laser_tests/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub_1, sub_2, sub_3;
+  MultiPlaneLaserTest* obj = dynamic_cast<MultiPlaneLaserTest*>(this);
+  sub_1 = nh.subscribe("r/scan_low", 1, &MultiPlaneLaserTest::ScanLowCb, obj);
+  sub_2 =
+      nh.subscribe("r/scan_high", 1, &MultiPlaneLaserTest::ScanHighCb, obj);
+  sub_3 = nh.subscribe("r/cloud", 1, &MultiPlaneLaserTest::CloudCb, obj);
+
+  MultiPlaneLaser* p1 = dynamic_cast<MultiPlaneLaser*>(
+      w->plugin_manager_.model_plugins_[0].get());
+  MultiPlaneLaser* p2 = dynamic_cast<MultiPlaneLaser*>(
+      w->plugin_manager_.model_plugins_[1].get());
+
+  // let it spin for 10 times to make sure the message gets through
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  ASSERT_EQ(p1->planes_.size(), 2u);
+  EXPECT_EQ(p1->planes_[1].first_ray, 3u);
+  EXPECT_FALSE(p1->point_cloud_);
+  EXPECT_TRUE(p2->point_cloud_);
+
+  EXPECT_EQ(scan_low.header.frame_id, "r_lidar");
+  ExpectRanges(scan_low, {4.5, 4.4, 4.3});
+  ExpectRanges(scan_high, {4.924603, 4.824100, 4.723598});
+
+  // one point per ray, the low plane first
+  ASSERT_EQ(cloud.width, 6u);
+  sensor_msgs::PointCloud2ConstIterator<float> it(cloud, "x");
+  EXPECT_NEAR(it[0], 0, 1e-5);
+  EXPECT_NEAR(it[1], -4.5, 1e-5);
+  EXPECT_NEAR(it[2], 0, 1e-5);
+  it += 4;
+  EXPECT_NEAR(it[0], 4.8, 1e-5);
+  EXPECT_NEAR(it[1], 0, 1e-5);
+  EXPECT_NEAR(it[2], 0.481606, 1e-5);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "multi_plane_laser_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python2
+
+'''
+Smoke test of the flatland_py module: loads the worlds of
+python_bindings_tests, steps and resets them, and checks the views of the
+observations are updated in place
+'''
+
+import os
+import unittest
+
+import numpy as np
+
+import flatland_py
+
+WORLD = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                     "python_bindings_tests", "world.yaml")
+
+
+class PythonBindingsTest(unittest.TestCase):
+    def test_simulation(self):
+        sim = flatland_py.Simulation(WORLD, step_size=0.005)
+        self.assertEqual(sim.body_names(), ["robot1/base_link"])
+        generation = sim.generation
+
+        states = sim.body_states()
+        self.assertAlmostEqual(states["x"][0], 5)
+        self.assertAlmostEqual(states["y"][0], 5)
+        with self.assertRaises(ValueError):
+            states["x"][0] = 0
+
+        # the views follow the steps without being fetched again
+        sim.step({"robot1": (0.5, 0)}, steps=40)
+        self.assertAlmostEqual(sim.time, 0.2, places=6)
+        self.assertGreater(states["x"][0], 5.05)
+        self.assertAlmostEqual(states["y"][0], 5, places=3)
+        self.assertEqual(sim.generation, generation)
+
+        ranges = sim.ranges("robot1", "laser")
+        self.assertEqual(ranges.shape, (9,))
+        sim.step()
+        # NaN where the beams hit nothing
+        self.assertTrue(np.all(np.isnan(ranges) | (ranges > 0)))
+
+        view = sim.top_down_view("robot1", "view")
+        self.assertEqual(view.shape, (100, 100))
+
+        sim.reset()
+        self.assertAlmostEqual(states["x"][0], 5)
+
+        with self.assertRaises(KeyError):
+            sim.step({"robot2": (1, 0)})
+        with self.assertRaises(KeyError):
+            sim.ranges("robot1", "missing")
+
+    def test_vector_simulation(self):
+        envs = flatland_py.VectorSimulation(WORLD, 3, "robot1", laser="laser",
+                                            episode_steps=10, threads=2)
+        self.assertEqual(len(envs), 3)
+        self.assertEqual(envs.ranges.shape, (3, 9))
+        odometry = envs.odometry
+        dones = envs.dones
+        self.assertEqual(odometry.shape, (3, 6))
+        np.testing.assert_allclose(odometry[:, :2], 5, atol=1e-6)
+
+        actions = np.array([[0.5, 0], [0, 0], [-0.5, 0]], dtype=np.float32)
+        for _ in range(5):
+            envs.step(actions)
+        self.assertFalse(np.any(dones))
+        self.assertGreater(odometry[0, 0], odometry[1, 0])
+        self.assertLess(odometry[2, 0], odometry[1, 0])
+
+        # the episodes end on the 10th step and the worlds start over
+        for _ in range(5):
+            envs.step(actions)
+        self.assertTrue(np.all(dones))
+        np.testing.assert_allclose(odometry[:, :2], 5, atol=1e-6)
+
+        envs.step(actions)
+        envs.reset()
+        self.assertFalse(np.any(dones))
+        np.testing.assert_allclose(odometry[:, :2], 5, atol=1e-6)
+
+        with self.assertRaises(ValueError):
+            envs.step(np.zeros((2, 2)))
+
+
+if __name__ == "__main__":
+    import rostest
+    rostest.rosrun("flatland_plugins", "python_bindings_test",
+                   PythonBindingsTest)
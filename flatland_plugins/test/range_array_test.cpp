@@ -0,0 +1,133 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 range_array_test.cpp
+ * @brief	 test range array plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/RangeArray.h>
+#include <flatland_plugins/range_array.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <limits>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class RangeArrayTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  flatland_msgs::RangeArray ranges;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  void RangesCb(const flatland_msgs::RangeArray& msg) { ranges = msg; };
+};
+
+/**
+ * Test every sensor reports the nearest detection in its cone, inf without
+ * a detection and -inf for a detection closer than its min range
+ */
+TEST_F(RangeArrayTest, ranges_test) {
+  world_yaml = this_file_dir / fs::path("range_array_tests/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub;
+  RangeArrayTest* obj = dynamic_cast<RangeArrayTest*>(this);
+  sub = nh.subscribe("r/ranges", 1, &RangeArrayTest::RangesCb, obj);
+
+  RangeArray* p = dynamic_cast<RangeArray*>(
+      w->plugin_manager_.model_plugins_[0].get());
+
+  // let it spin for 10 times to make sure the message gets through
+  ros::WallRate rate(500);
+  for (unsigned int i = 0; i < 10; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+    rate.sleep();
+  }
+
+  // the rays of all sensors, 3 per cone by default
+  ASSERT_EQ(p->sensors_.size(), 4u);
+  EXPECT_EQ(p->sensors_[2].first_ray, 4u);
+  EXPECT_EQ(p->inputs_.size(), 10u);
+
+  EXPECT_EQ(ranges.header.frame_id, "r_base_link");
+  EXPECT_EQ(ranges.radiation_type, flatland_msgs::RangeArray::ULTRASOUND);
+  ASSERT_EQ(ranges.names.size(), 4u);
+  EXPECT_EQ(ranges.names[1], "left");
+  EXPECT_NEAR(ranges.origins[1].y, 0.1, 1e-5);
+  EXPECT_NEAR(ranges.field_of_view[0], 0.4, 1e-5);
+  EXPECT_NEAR(ranges.max_range[2], 3, 1e-5);
+  EXPECT_NEAR(ranges.min_range[3], 4.5, 1e-5);
+
+  float inf = std::numeric_limits<float>::infinity();
+  ASSERT_EQ(ranges.ranges.size(), 4u);
+  EXPECT_NEAR(ranges.ranges[0], 4.4, 1e-5);
+  EXPECT_NEAR(ranges.ranges[1], 4.2, 1e-5);
+  EXPECT_EQ(ranges.ranges[2], inf);
+  EXPECT_EQ(ranges.ranges[3], -inf);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "range_array_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
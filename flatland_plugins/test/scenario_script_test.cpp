@@ -0,0 +1,142 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 scenario_script_test.cpp
+ * @brief	 test scenario script plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/scenario_script.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class ScenarioScriptTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  World* w;
+  Timekeeper timekeeper;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+    timekeeper.SetMaxStepSize(0.01);
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  void Step(unsigned int steps) {
+    for (unsigned int i = 0; i < steps; i++) {
+      w->Update(timekeeper);
+    }
+  }
+
+  /**
+   * @return A global of the script, nil as NaN
+   */
+  double GetGlobal(const char* name) {
+    ScenarioScript* script = dynamic_cast<ScenarioScript*>(
+        w->plugin_manager_.world_plugins_[0].get());
+    lua_getglobal(script->L_, name);
+    double value =
+        lua_isnil(script->L_, -1) ? NAN : lua_tonumber(script->L_, -1);
+    lua_pop(script->L_, 1);
+    return value;
+  }
+};
+
+/**
+ * Test the script acts on the world at its deadlines, and runs the started
+ * coroutine on every step
+ */
+TEST_F(ScenarioScriptTest, deadline_test) {
+  w = World::MakeWorld((this_file_dir / "scenario_script_tests/world.yaml")
+                           .string());
+  ASSERT_EQ(w->GetModel("pallet"), nullptr);
+
+  Step(15);
+  ASSERT_NE(w->GetModel("pallet"), nullptr);
+  EXPECT_NEAR(GetGlobal("spawned_at"), 0.1, 0.0101);
+  b2Vec2 p = w->GetModel("pallet")->bodies_[0]->physics_body_->GetPosition();
+  EXPECT_NEAR(p.x, 5, 1e-5);
+  EXPECT_NEAR(p.y, 5, 1e-5);
+
+  Step(35);
+  EXPECT_EQ(w->GetModel("pallet"), nullptr);
+  EXPECT_NEAR(GetGlobal("deleted_at"), 0.3, 0.0101);
+  b2Body* blocker = w->GetModel("blocker")->bodies_[0]->physics_body_;
+  EXPECT_NEAR(blocker->GetPosition().x, 3, 1e-5);
+  EXPECT_NEAR(blocker->GetPosition().y, 4, 1e-5);
+  EXPECT_NEAR(blocker->GetAngle(), 1.5, 1e-5);
+
+  // the coroutine started at the first step runs from the second one
+  EXPECT_EQ(GetGlobal("steps"), 49);
+
+  // deleting the model twice failed the script, but not the simulation
+  EXPECT_TRUE(std::isnan(GetGlobal("unreachable")));
+}
+
+/**
+ * Test scripts that do not compile fail the loading of the world
+ */
+TEST_F(ScenarioScriptTest, invalid_test) {
+  EXPECT_THROW(World::MakeWorld(
+                   (this_file_dir / "scenario_script_tests/invalid_world.yaml")
+                       .string()),
+               Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "scenario_script_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
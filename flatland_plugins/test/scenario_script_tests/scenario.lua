@@ -0,0 +1,27 @@
+-- spawns a ball at t=0.1, moves the blocker at t=0.2 and deletes the ball at
+-- t=0.3, while another coroutine counts the steps
+steps = 0
+start(function()
+  while true do
+    steps = steps + 1
+    coroutine.yield()
+  end
+end)
+
+sleep(0.1)
+spawn_model("../state_hasher_tests/ball.model.yaml", "pallet", 5, 5, 0)
+spawned_at = time()
+
+wait_until(0.2)
+move_model("blocker", 3, 4, 1.5)
+local x, y, theta = get_pose("blocker")
+moved_to = {x, y, theta}
+
+wait_until(0.3)
+delete_model("pallet")
+deleted_at = time()
+
+-- errors of the world end the coroutine, not the simulation
+wait_until(0.4)
+delete_model("pallet")
+unreachable = true
@@ -0,0 +1,155 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_hasher_test.cpp
+ * @brief	 test state hasher plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/StateHash.h>
+#include <flatland_plugins/state_hasher.h>
+#include <flatland_server/column_log.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <sensor_msgs/LaserScan.h>
+#include <string>
+#include <vector>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class StateHasherTest : public ::testing::Test {
+ public:
+  boost::filesystem::path world_yaml;
+  std::string log_path = "/tmp/flatland_state_hasher_test.flcol";
+  std::vector<flatland_msgs::StateHash> msgs;
+
+  void SetUp() override {
+    world_yaml = boost::filesystem::path(__FILE__).parent_path() /
+                 "state_hasher_tests/world.yaml";
+  }
+
+  void TearDown() override { fs::remove(log_path); }
+
+  void OnScan(const sensor_msgs::LaserScan& scan) {}
+
+  void OnHash(const flatland_msgs::StateHash& msg) { msgs.push_back(msg); }
+
+  /**
+   * @brief Run the world for some steps and read its log
+   * @return The tables of the log
+   */
+  std::vector<ColumnLog::Table> Run() {
+    World* w = World::MakeWorld(world_yaml.string());
+
+    // the laser only scans, and draws noise, with a subscriber
+    ros::NodeHandle nh;
+    ros::Subscriber scan_sub =
+        nh.subscribe("r/scan", 1, &StateHasherTest::OnScan, this);
+    ros::Subscriber hash_sub =
+        nh.subscribe("state_hash", 100, &StateHasherTest::OnHash, this);
+    Timekeeper timekeeper;
+    timekeeper.SetMaxStepSize(0.01);
+    for (unsigned int i = 0; i < 30; i++) {
+      w->Update(timekeeper);
+      ros::spinOnce();
+    }
+    ros::WallDuration(0.1).sleep();
+    ros::spinOnce();
+    delete w;
+    return ColumnLog::Read(log_path);
+  }
+};
+
+/**
+ * Test the digests of the bodies and generators are logged and published,
+ * and are the same in two runs of the world
+ */
+TEST_F(StateHasherTest, hash_test) {
+  std::vector<ColumnLog::Table> first = Run();
+  ASSERT_EQ(first.size(), 5u);
+
+  const ColumnLog::Table& bodies = first[0];
+  EXPECT_EQ(bodies.name, "bodies");
+  std::string names(bodies.values[1].begin(), bodies.values[1].end());
+  EXPECT_NE(names.find("robot1/base_link"), std::string::npos);
+  EXPECT_NE(names.find("robot2/ball"), std::string::npos);
+
+  const ColumnLog::Table& generators = first[1];
+  EXPECT_EQ(generators.name, "generators");
+  ASSERT_EQ(generators.rows, 1u);
+  EXPECT_EQ(std::string(generators.values[1].begin(),
+                        generators.values[1].end()),
+            "robot1/laser");
+
+  // one digest per step, the overlapping bodies are pushed apart so the
+  // digests change
+  const ColumnLog::Table& steps = first[2];
+  EXPECT_EQ(steps.name, "steps");
+  ASSERT_EQ(steps.rows, 30u);
+  std::vector<uint32_t> hash_lo = steps.Get<uint32_t>(3);
+  EXPECT_NE(hash_lo[0], hash_lo[29]);
+  EXPECT_EQ(first[3].name, "body_hashes");
+  EXPECT_EQ(first[3].rows, 60u);
+  EXPECT_EQ(first[4].name, "random_states");
+  EXPECT_EQ(first[4].rows, 30u);
+
+  // the published digests are the logged ones
+  ASSERT_EQ(msgs.size(), 30u);
+  EXPECT_EQ(msgs.back().step, 30u);
+  EXPECT_EQ(static_cast<uint32_t>(msgs.back().hash), hash_lo[29]);
+
+  // a second run gives the same digests
+  std::vector<ColumnLog::Table> second = Run();
+  ASSERT_EQ(second.size(), 5u);
+  for (size_t t = 2; t < 5; t++) {
+    EXPECT_EQ(first[t].values, second[t].values) << first[t].name;
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "state_hasher_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
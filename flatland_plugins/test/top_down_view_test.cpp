@@ -0,0 +1,136 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 top_down_view_test.cpp
+ * @brief	 test top down view plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/top_down_view.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <sensor_msgs/Image.h>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class TopDownViewTest : public ::testing::Test {
+ public:
+  boost::filesystem::path this_file_dir;
+  boost::filesystem::path world_yaml;
+  sensor_msgs::Image image;
+  World* w;
+
+  void SetUp() override {
+    this_file_dir = boost::filesystem::path(__FILE__).parent_path();
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+  }
+
+  // value of a pixel of the image
+  int Pixel(int row, int col) { return image.data[row * image.width + col]; }
+
+  // step the world and spin until the image gets through
+  void Spin(Timekeeper* timekeeper) {
+    ros::WallRate rate(500);
+    for (unsigned int i = 0; i < 10; i++) {
+      w->Update(*timekeeper);
+      ros::spinOnce();
+      rate.sleep();
+    }
+  }
+
+  void ImageCb(const sensor_msgs::Image& msg) { image = msg; };
+};
+
+/**
+ * Test the image has the static layers and the other models but not the
+ * model of the view, in the frame of the body
+ */
+TEST_F(TopDownViewTest, render_test) {
+  world_yaml = this_file_dir / fs::path("top_down_view_tests/world.yaml");
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+
+  ros::NodeHandle nh;
+  ros::Subscriber sub;
+  TopDownViewTest* obj = dynamic_cast<TopDownViewTest*>(this);
+  sub = nh.subscribe("r/top_down_view", 1, &TopDownViewTest::ImageCb, obj);
+
+  TopDownView* p = dynamic_cast<TopDownView*>(
+      w->plugin_manager_.model_plugins_[0].get());
+  ASSERT_GE(p->view_id_, 0);
+
+  Spin(&timekeeper);
+  ASSERT_EQ(image.width, 100u);
+  ASSERT_EQ(image.height, 100u);
+  EXPECT_EQ(image.encoding, "mono8");
+  EXPECT_EQ(image.header.frame_id, "r_view");
+
+  // the robot faces x, the wall of layer_2 4.35 m and the obstacle 1 m ahead
+  EXPECT_TRUE(Pixel(6, 50) == RasterBatch::STATIC ||
+              Pixel(7, 50) == RasterBatch::STATIC);
+  EXPECT_EQ(Pixel(40, 50), RasterBatch::DYNAMIC);
+  EXPECT_EQ(Pixel(50, 50), RasterBatch::FREE);
+  EXPECT_EQ(Pixel(50, 60), RasterBatch::FREE);
+
+  // facing y, the obstacle is to the right
+  p->body_->GetPhysicsBody()->SetTransform(b2Vec2(5, 5), M_PI / 2);
+  Spin(&timekeeper);
+  EXPECT_EQ(Pixel(50, 60), RasterBatch::DYNAMIC);
+  EXPECT_EQ(Pixel(40, 50), RasterBatch::FREE);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "top_down_view_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
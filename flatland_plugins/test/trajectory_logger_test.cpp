@@ -0,0 +1,149 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trajectory_logger_test.cpp
+ * @brief	 test trajectory logger plugin
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_plugins/trajectory_logger.h>
+#include <flatland_server/column_log.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <gtest/gtest.h>
+#include <sensor_msgs/LaserScan.h>
+#include <algorithm>
+#include <cmath>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+using namespace flatland_plugins;
+
+class TrajectoryLoggerTest : public ::testing::Test {
+ public:
+  boost::filesystem::path world_yaml;
+  std::string log_path = "/tmp/flatland_trajectory_logger_test.flcol";
+  World* w;
+
+  void SetUp() override {
+    world_yaml = boost::filesystem::path(__FILE__).parent_path() /
+                 "trajectory_logger_tests/world.yaml";
+    w = nullptr;
+  }
+
+  void TearDown() override {
+    if (w != nullptr) {
+      delete w;
+    }
+    fs::remove(log_path);
+  }
+
+  void OnScan(const sensor_msgs::LaserScan& scan) {}
+};
+
+/**
+ * Test the poses, contacts and scans of the steps are logged with the names
+ * of the bodies and lasers
+ */
+TEST_F(TrajectoryLoggerTest, log_test) {
+  w = World::MakeWorld(world_yaml.string());
+
+  // the laser only scans with a subscriber
+  ros::NodeHandle nh;
+  ros::Subscriber sub =
+      nh.subscribe("r/scan", 1, &TrajectoryLoggerTest::OnScan, this);
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  for (unsigned int i = 0; i < 40; i++) {
+    w->Update(timekeeper);
+    ros::spinOnce();
+  }
+  delete w;
+  w = nullptr;
+
+  std::vector<ColumnLog::Table> tables = ColumnLog::Read(log_path);
+  ASSERT_EQ(tables.size(), 5u);
+
+  const ColumnLog::Table& bodies = tables[0];
+  EXPECT_EQ(bodies.name, "bodies");
+  ASSERT_GE(bodies.rows, 2u);  // and the layer if a robot touches it
+  EXPECT_EQ(bodies.Get<uint32_t>(0)[1], 1u);
+  std::string models(bodies.values[1].begin(), bodies.values[1].end());
+  EXPECT_NE(models.find("robot1"), std::string::npos);
+  EXPECT_NE(models.find("robot2"), std::string::npos);
+
+  // both bodies on every step
+  const ColumnLog::Table& poses = tables[1];
+  EXPECT_EQ(poses.name, "poses");
+  ASSERT_EQ(poses.rows, 80u);
+  std::vector<uint32_t> steps = poses.Get<uint32_t>(0);
+  std::vector<float> x = poses.Get<float>(3);
+  EXPECT_EQ(steps.front(), 1u);
+  EXPECT_EQ(steps.back(), 40u);
+  EXPECT_TRUE(std::is_sorted(steps.begin(), steps.end()));
+  EXPECT_NEAR(std::min(x[0], x[1]), 5, 0.1);
+
+  // the overlapping bodies touch and are pushed apart
+  const ColumnLog::Table& contacts = tables[2];
+  EXPECT_EQ(contacts.name, "contacts");
+  EXPECT_GT(contacts.rows, 0u);
+  EXPECT_GT(std::fabs(x[78] - x[79]), 0.17);
+
+  const ColumnLog::Table& lasers = tables[3];
+  EXPECT_EQ(lasers.name, "lasers");
+  ASSERT_EQ(lasers.rows, 1u);
+  EXPECT_EQ(std::string(lasers.values[2].begin(), lasers.values[2].end()),
+            "laser");
+
+  const ColumnLog::Table& scans = tables[4];
+  EXPECT_EQ(scans.name, "scans");
+  ASSERT_GT(scans.rows, 0u);
+  for (uint32_t length : scans.lengths[3]) {
+    EXPECT_EQ(length, 3u);
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "trajectory_logger_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -214,6 +214,41 @@ TEST_F(UpdateTimerTest, rate_test_E) {
   EXPECT_NEAR(actual_rate, expected_rate, 1);
 }
 
+/**
+ * Test that a staggered timer updates on the steps shifted by the fraction of
+ * its period
+ */
+TEST(UpdateTimerStaggerTest, stagger_test) {
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.1);
+  UpdateTimer in_phase, staggered;
+  in_phase.SetRate(2.5);
+  staggered.SetRate(2.5);
+  staggered.SetStagger(0.74);
+
+  std::vector<double> in_phase_times, staggered_times;
+  for (int step = 0; step < 13; step++) {
+    if (in_phase.CheckUpdate(timekeeper)) {
+      in_phase_times.push_back(timekeeper.GetSimTime().toSec());
+    }
+    if (staggered.CheckUpdate(timekeeper)) {
+      staggered_times.push_back(timekeeper.GetSimTime().toSec());
+    }
+    timekeeper.StepTime();
+  }
+
+  std::vector<double> expected_in_phase = {0, 0.4, 0.8, 1.2};
+  std::vector<double> expected_staggered = {0.3, 0.7, 1.1};
+  ASSERT_EQ(in_phase_times.size(), expected_in_phase.size());
+  ASSERT_EQ(staggered_times.size(), expected_staggered.size());
+  for (unsigned int i = 0; i < expected_in_phase.size(); i++) {
+    EXPECT_NEAR(in_phase_times[i], expected_in_phase[i], 1e-6);
+  }
+  for (unsigned int i = 0; i < expected_staggered.size(); i++) {
+    EXPECT_NEAR(staggered_times[i], expected_staggered[i], 1e-6);
+  }
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char** argv) {
   ros::init(argc, argv, "model_tf_plugin_test");
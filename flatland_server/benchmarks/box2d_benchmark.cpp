@@ -0,0 +1,402 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 box2d_benchmark.cpp
+ * @brief	 Microbenchmarks of the vendored Box2D
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const float kStepSize = 0.005f;  ///< seconds per step, as the server default
+const int kWarmupSteps = 200;     ///< steps before a scene is timed
+const float kCellSize = 4;        ///< meters between the boxes of the layer
+const int kQueries = 4096;        ///< rays and boxes cycled through
+const int kRepetitions = 5;       ///< repetitions of each benchmark, for the
+                                  /// mean, median and deviation of the runs
+
+/**
+ * @brief Add a layer to a world: one static body with a 1 m box of four
+ * edges per cell of a square grid, as a layer loaded from a map
+ * @param[in] world The world
+ * @param[in] boxes Number of boxes
+ * @return Side of the square covered in meters
+ */
+float AddLayer(b2World *world, int boxes) {
+  int columns = std::ceil(std::sqrt(boxes));
+  b2BodyDef def;
+  b2Body *layer = world->CreateBody(&def);
+  for (int i = 0; i < boxes; i++) {
+    b2Vec2 corner((i % columns) * kCellSize + 1, (i / columns) * kCellSize + 1);
+    b2Vec2 corners[4] = {corner, corner + b2Vec2(1, 0), corner + b2Vec2(1, 1),
+                         corner + b2Vec2(0, 1)};
+    for (int j = 0; j < 4; j++) {
+      b2EdgeShape edge;
+      edge.Set(corners[j], corners[(j + 1) % 4]);
+      layer->CreateFixture(&edge, 0);
+    }
+  }
+
+  // a wall around the grid keeps the bodies in
+  float side = columns * kCellSize + 1;
+  b2Vec2 walls[4] = {b2Vec2(0, 0), b2Vec2(side, 0), b2Vec2(side, side),
+                     b2Vec2(0, side)};
+  b2ChainShape chain;
+  chain.CreateLoop(walls, 4);
+  layer->CreateFixture(&chain, 0);
+  return side;
+}
+
+/**
+ * @brief Step a world kWarmupSteps times, the contacts and islands of the
+ * scene then reach their steady state before it is timed
+ */
+void WarmUp(b2World *world) {
+  for (int i = 0; i < kWarmupSteps; i++) {
+    world->Step(kStepSize, 10, 10);
+  }
+}
+
+/**
+ * A world cached across the repetitions of a benchmark
+ */
+struct Scene {
+  std::unique_ptr<b2World> world;  ///< the world
+  float side = 0;                  ///< side of the square it covers
+  std::vector<std::pair<b2Vec2, b2Vec2>> rays;  ///< random rays
+  std::vector<b2AABB> boxes;                    ///< random query boxes
+};
+
+std::map<std::pair<int, int>, Scene> scenes;  ///< by kind and argument
+
+/**
+ * @brief Create, once per argument, a world of a layer of 4 m cells whose
+ * lanes are filled with dynamic circles and boxes bouncing off each other
+ * @param[in] bodies Number of dynamic bodies, half circles, half boxes
+ */
+Scene &ShapesScene(int bodies) {
+  Scene &scene = scenes[std::make_pair(0, bodies)];
+  if (scene.world) {
+    return scene;
+  }
+  scene.world.reset(new b2World(b2Vec2(0, 0)));
+  int cells = std::max(1, bodies / 8);
+  scene.side = AddLayer(scene.world.get(), cells);
+
+  // two rows of four bodies in the lane below each box, with elastic and
+  // frictionless contacts so that they keep bouncing
+  std::mt19937 rng(bodies);
+  std::uniform_real_distribution<float> speed(-2, 2);
+  int columns = std::ceil(std::sqrt(cells));
+  b2CircleShape circle;
+  circle.m_radius = 0.2f;
+  b2PolygonShape box;
+  box.SetAsBox(0.2f, 0.2f);
+  for (int i = 0; i < bodies; i++) {
+    int cell = i / 8, k = i % 8;
+    b2BodyDef def;
+    def.type = b2_dynamicBody;
+    def.position.Set((cell % columns) * kCellSize + 0.5f + (k % 4) * 0.8f,
+                     (cell / columns) * kCellSize + 2.5f + (k / 4) * 0.8f);
+    def.linearVelocity.Set(speed(rng), speed(rng));
+    b2FixtureDef fixture;
+    fixture.shape = i % 2 ? static_cast<b2Shape *>(&box) : &circle;
+    fixture.density = 1;
+    fixture.friction = 0;
+    fixture.restitution = 1;
+    scene.world->CreateBody(&def)->CreateFixture(&fixture);
+  }
+  WarmUp(scene.world.get());
+  return scene;
+}
+
+/**
+ * @brief Create, once per argument, a world of tricycles as in the
+ * TricycleDrive models: a base with a front wheel on a revolute joint and
+ * two rear wheels welded to it, driving in the lanes of a layer
+ * @param[in] vehicles Number of tricycles, four bodies and three joints each
+ */
+Scene &JointsScene(int vehicles) {
+  Scene &scene = scenes[std::make_pair(1, vehicles)];
+  if (scene.world) {
+    return scene;
+  }
+  scene.world.reset(new b2World(b2Vec2(0, 0)));
+  scene.side = AddLayer(scene.world.get(), vehicles);
+
+  std::mt19937 rng(vehicles);
+  std::uniform_real_distribution<float> speed(-1, 1);
+  int columns = std::ceil(std::sqrt(vehicles));
+  b2PolygonShape base, wheel;
+  base.SetAsBox(0.5f, 0.3f);
+  wheel.SetAsBox(0.1f, 0.05f);
+  for (int i = 0; i < vehicles; i++) {
+    b2Vec2 position((i % columns) * kCellSize + 1.5f,
+                    (i / columns) * kCellSize + 3);
+    b2Vec2 velocity(speed(rng), speed(rng));
+    b2Body *bodies[4];
+    b2Vec2 offsets[4] = {b2Vec2(0, 0), b2Vec2(0.4f, 0), b2Vec2(-0.4f, 0.29f),
+                         b2Vec2(-0.4f, -0.29f)};
+    for (int j = 0; j < 4; j++) {
+      b2BodyDef def;
+      def.type = b2_dynamicBody;
+      def.position = position + offsets[j];
+      def.linearVelocity = velocity;
+      bodies[j] = scene.world->CreateBody(&def);
+      b2FixtureDef fixture;
+      fixture.shape = j == 0 ? &base : &wheel;
+      fixture.density = 1;
+      fixture.restitution = 1;
+      fixture.friction = 0;
+      // the wheels overlap the base, as in the models
+      fixture.filter.groupIndex = -(i + 1);
+      bodies[j]->CreateFixture(&fixture);
+    }
+
+    b2RevoluteJointDef revolute;
+    revolute.Initialize(bodies[1], bodies[0], bodies[1]->GetPosition());
+    scene.world->CreateJoint(&revolute);
+    for (int j = 2; j < 4; j++) {
+      b2WeldJointDef weld;
+      weld.Initialize(bodies[j], bodies[0], bodies[j]->GetPosition());
+      scene.world->CreateJoint(&weld);
+    }
+  }
+  WarmUp(scene.world.get());
+  return scene;
+}
+
+/**
+ * @brief Create, once per argument, a world of only a layer, with random
+ * rays up to 10 m long and random 2 m query boxes within it
+ * @param[in] boxes Number of boxes of the layer, four edges each
+ */
+Scene &LayerScene(int boxes) {
+  Scene &scene = scenes[std::make_pair(2, boxes)];
+  if (scene.world) {
+    return scene;
+  }
+  scene.world.reset(new b2World(b2Vec2(0, 0)));
+  scene.side = AddLayer(scene.world.get(), boxes);
+
+  std::mt19937 rng(boxes);
+  std::uniform_real_distribution<float> position(0, scene.side);
+  std::uniform_real_distribution<float> angle(-b2_pi, b2_pi);
+  for (int i = 0; i < kQueries; i++) {
+    b2Vec2 start(position(rng), position(rng));
+    float a = angle(rng);
+    scene.rays.push_back(
+        std::make_pair(start, start + 10 * b2Vec2(std::cos(a), std::sin(a))));
+    b2AABB aabb;
+    aabb.lowerBound.Set(position(rng), position(rng));
+    aabb.upperBound = aabb.lowerBound + b2Vec2(2, 2);
+    scene.boxes.push_back(aabb);
+  }
+  return scene;
+}
+
+/**
+ * @brief Time b2World::Step on a scene, the phases of the steps from
+ * b2Profile are reported in ms per step, and the islands and pairs of the
+ * last step from b2StepStats
+ */
+void TimeSteps(benchmark::State &state, b2World *world) {
+  b2Profile sum = {};
+  for (auto _ : state) {
+    world->Step(kStepSize, 10, 10);
+    const b2Profile &p = world->GetProfile();
+    sum.collide += p.collide;
+    sum.solve += p.solve;
+    sum.solveInit += p.solveInit;
+    sum.solveVelocity += p.solveVelocity;
+    sum.solvePosition += p.solvePosition;
+    sum.broadphase += p.broadphase;
+    sum.solveTOI += p.solveTOI;
+  }
+
+  double steps = state.iterations();
+  state.counters["collide_ms"] = sum.collide / steps;
+  state.counters["solve_ms"] = sum.solve / steps;
+  state.counters["solve_init_ms"] = sum.solveInit / steps;
+  state.counters["solve_velocity_ms"] = sum.solveVelocity / steps;
+  state.counters["solve_position_ms"] = sum.solvePosition / steps;
+  state.counters["broadphase_ms"] = sum.broadphase / steps;
+  state.counters["solve_toi_ms"] = sum.solveTOI / steps;
+  const b2StepStats &stats = world->GetStepStats();
+  state.counters["islands"] = stats.islandCount;
+  state.counters["pairs"] = stats.pairCount;
+  state.counters["contacts"] = world->GetContactCount();
+  state.SetItemsProcessed(state.iterations() * world->GetBodyCount());
+}
+
+/**
+ * Dynamic circles and boxes in contact among a layer
+ */
+void BM_StepShapes(benchmark::State &state) {
+  TimeSteps(state, ShapesScene(state.range(0)).world.get());
+}
+
+/**
+ * Tricycles of jointed bodies among a layer
+ */
+void BM_StepJoints(benchmark::State &state) {
+  TimeSteps(state, JointsScene(state.range(0)).world.get());
+}
+
+/**
+ * Finds the closest hit of a ray, as the lasers do
+ */
+class ClosestHit : public b2RayCastCallback {
+ public:
+  float fraction = 1;  ///< of the closest hit, 1 if none
+
+  float32 ReportFixture(b2Fixture *fixture, const b2Vec2 &point,
+                        const b2Vec2 &normal, float32 f) override {
+    fraction = f;
+    return f;
+  }
+};
+
+/**
+ * b2World::RayCast of rays of up to 10 m against the layer
+ */
+void BM_RayCast(benchmark::State &state) {
+  const Scene &scene = LayerScene(state.range(0));
+  const b2World *world = scene.world.get();
+  double hits = 0;
+  for (const auto &ray : scene.rays) {
+    ClosestHit callback;
+    world->RayCast(&callback, ray.first, ray.second);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto &ray = scene.rays[i++ % kQueries];
+    ClosestHit callback;
+    world->RayCast(&callback, ray.first, ray.second);
+    hits += callback.fraction < 1;
+    benchmark::DoNotOptimize(callback.fraction);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hit_ratio"] = hits / state.iterations();
+  state.counters["edges"] = 4.0 * state.range(0);
+}
+
+/**
+ * Counts the fixtures overlapping a box
+ */
+class CountFixtures : public b2QueryCallback {
+ public:
+  int count = 0;  ///< fixtures reported
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    count++;
+    return true;
+  }
+};
+
+/**
+ * b2World::QueryAABB of 2 m boxes against the layer
+ */
+void BM_QueryAABB(benchmark::State &state) {
+  const Scene &scene = LayerScene(state.range(0));
+  const b2World *world = scene.world.get();
+  for (const b2AABB &aabb : scene.boxes) {
+    CountFixtures callback;
+    world->QueryAABB(&callback, aabb);
+  }
+
+  size_t i = 0;
+  double found = 0;
+  for (auto _ : state) {
+    CountFixtures callback;
+    world->QueryAABB(&callback, scene.boxes[i++ % kQueries]);
+    found += callback.count;
+    benchmark::DoNotOptimize(callback.count);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["fixtures_per_query"] = found / state.iterations();
+  state.counters["edges"] = 4.0 * state.range(0);
+}
+
+BENCHMARK(BM_StepShapes)
+    ->RangeMultiplier(10)
+    ->Range(100, 10000)
+    ->Repetitions(kRepetitions)
+    ->DisplayAggregatesOnly(true)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StepJoints)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->Repetitions(kRepetitions)
+    ->DisplayAggregatesOnly(true)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RayCast)
+    ->RangeMultiplier(8)
+    ->Range(64, 32768)
+    ->Repetitions(kRepetitions)
+    ->DisplayAggregatesOnly(true);
+BENCHMARK(BM_QueryAABB)
+    ->RangeMultiplier(8)
+    ->Range(64, 32768)
+    ->Repetitions(kRepetitions)
+    ->DisplayAggregatesOnly(true);
+
+};  // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
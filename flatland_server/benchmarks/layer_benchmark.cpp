@@ -0,0 +1,197 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_benchmark.cpp
+ * @brief	 Benchmarks of loading layers
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <benchmark/benchmark.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/layer.h>
+#include <flatland_server/tracer.h>
+#include <yaml-cpp/yaml.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <map>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+
+namespace {
+
+const int kCellSize = 64;         ///< pixels per cell, one box per cell
+const double kResolution = 0.05;  ///< meters per pixel of the maps
+std::map<int, fs::path> generated_maps;  ///< directory of the maps by size
+
+/**
+ * @brief Generate, once per size, a map of size x size pixels with a box of
+ * random size in each cell, both as an image and as line segments
+ * @param[in] size Number of pixels along each axis
+ * @return The directory of map.yaml (image) and lines.yaml (line segments)
+ */
+const fs::path &GeneratedMap(int size) {
+  auto it = generated_maps.find(size);
+  if (it != generated_maps.end()) {
+    return it->second;
+  }
+
+  fs::path dir = fs::temp_directory_path() /
+                 fs::unique_path("flatland_benchmark_%%%%-%%%%-%%%%");
+  fs::create_directories(dir);
+
+  cv::Mat image(size, size, CV_8UC1, cv::Scalar(255));
+  std::ofstream lines_file((dir / "lines.dat").string());
+  cv::RNG rng(size);
+  for (int y = 0; y + kCellSize <= size; y += kCellSize) {
+    for (int x = 0; x + kCellSize <= size; x += kCellSize) {
+      int w = rng.uniform(8, 40), h = rng.uniform(8, 40);
+      int x1 = x + rng.uniform(0, kCellSize - w);
+      int y1 = y + rng.uniform(0, kCellSize - h);
+      int x2 = x1 + w, y2 = y1 + h;
+      cv::rectangle(image, cv::Rect(x1, y1, w, h), cv::Scalar(0), -1);
+
+      // the same box in the line segments, whose y axis points up
+      y1 = size - y1;
+      y2 = size - y2;
+      lines_file << x1 << " " << y1 << " " << x2 << " " << y1 << "\n"
+                 << x2 << " " << y1 << " " << x2 << " " << y2 << "\n"
+                 << x2 << " " << y2 << " " << x1 << " " << y2 << "\n"
+                 << x1 << " " << y2 << " " << x1 << " " << y1 << "\n";
+    }
+  }
+  lines_file.close();
+  cv::imwrite((dir / "map.png").string(), image);
+
+  std::ofstream map_file((dir / "map.yaml").string());
+  map_file << "image: map.png\n"
+           << "resolution: " << kResolution << "\n"
+           << "origin: [0, 0, 0]\n"
+           << "negate: 0\n"
+           << "occupied_thresh: 0.65\n"
+           << "free_thresh: 0.196\n";
+  map_file.close();
+
+  std::ofstream lines_map_file((dir / "lines.yaml").string());
+  lines_map_file << "type: line_segments\n"
+                 << "data: lines.dat\n"
+                 << "scale: " << kResolution << "\n"
+                 << "origin: [0, 0, 0]\n";
+  lines_map_file.close();
+
+  return generated_maps[size] = dir;
+}
+
+/**
+ * @brief Time Layer::MakeLayer on a map, the time of each phase of loading
+ * is reported per iteration from the spans of the Tracer
+ * @param[in] state The benchmark state, the argument is the map size
+ * @param[in] map_file map.yaml or lines.yaml
+ */
+void MakeLayer(benchmark::State &state, const std::string &map_file) {
+  std::string map_path = (GeneratedMap(state.range(0)) / map_file).string();
+  std::vector<std::string> names = {"walls"};
+
+  Tracer::Get().Start();
+  for (auto _ : state) {
+    state.PauseTiming();
+    b2World physics_world(b2Vec2(0, 0));
+    CollisionFilterRegistry cfr;
+    cfr.RegisterLayer(names[0]);
+    state.ResumeTiming();
+
+    Layer *layer = Layer::MakeLayer(&physics_world, &cfr, map_path, names,
+                                    Color(1, 1, 1, 1), YAML::Node());
+
+    state.PauseTiming();
+    delete layer;
+    state.ResumeTiming();
+  }
+  Tracer::Get().Stop();
+
+  for (const auto &phase : Tracer::Get().SumDurations("load")) {
+    state.counters[phase.first + "_ms"] =
+        phase.second * 1e-6 / state.iterations();
+  }
+  state.counters["pixels"] = static_cast<double>(state.range(0)) *
+                             state.range(0);
+}
+
+/**
+ * Load the image of a map, see LoadFromBitmap
+ */
+void BM_MakeLayerBitmap(benchmark::State &state) {
+  MakeLayer(state, "map.yaml");
+}
+
+/**
+ * Load the same map from a text line segments file
+ */
+void BM_MakeLayerLineSegments(benchmark::State &state) {
+  MakeLayer(state, "lines.yaml");
+}
+
+BENCHMARK(BM_MakeLayerBitmap)
+    ->RangeMultiplier(2)
+    ->Range(1024, 16384)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MakeLayerLineSegments)
+    ->RangeMultiplier(2)
+    ->Range(1024, 16384)
+    ->Unit(benchmark::kMillisecond);
+
+};  // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+
+  for (const auto &map : generated_maps) {
+    fs::remove_all(map.second);
+  }
+  return 0;
+}
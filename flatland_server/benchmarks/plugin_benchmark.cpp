@@ -0,0 +1,274 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 plugin_benchmark.cpp
+ * @brief	 Benchmarks of the dispatch of the plugin callbacks
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <benchmark/benchmark.h>
+#include <flatland_server/dummy_model_plugin.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/world.h>
+#include <ros/ros.h>
+#include <yaml-cpp/yaml.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+
+namespace {
+
+const int kPluginsPerModel = 2;  ///< plugins added to each model
+
+/**
+ * A DummyModelPlugin overriding the step and contact callbacks, which only
+ * count their calls, so the benchmarks measure the dispatch
+ */
+class CountingPlugin : public flatland_plugins::DummyModelPlugin {
+ public:
+  uint64_t step_calls = 0;     ///< calls of the step callbacks
+  uint64_t contact_calls = 0;  ///< calls of the contact callbacks
+
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override {
+    step_calls++;
+  }
+
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override {
+    step_calls++;
+  }
+
+  void BeginContact(b2Contact *contact) override { contact_calls++; }
+
+  void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) override {
+    contact_calls++;
+  }
+};
+
+/**
+ * A world whose models carry CountingPlugins, and its touching contacts
+ */
+struct PluginWorld {
+  fs::path dir;                      ///< directory of the world files
+  World *world = nullptr;            ///< the world
+  std::vector<b2Contact *> contacts;  ///< touching contacts of the models
+};
+
+std::map<std::pair<int, int>, PluginWorld> plugin_worlds;  ///< by arguments
+
+/**
+ * @brief Create, once per arguments, a headless world with the models in
+ * pairs of sensor circles, the models of a pair overlap for the given
+ * percentage of the pairs
+ * @param[in] plugins Number of plugins, kPluginsPerModel per model
+ * @param[in] density Percentage of the pairs of models in contact
+ * @return The world and its contacts
+ */
+const PluginWorld &GeneratedWorld(int plugins, int density) {
+  auto it = plugin_worlds.find(std::make_pair(plugins, density));
+  if (it != plugin_worlds.end()) {
+    return it->second;
+  }
+
+  PluginWorld &pw = plugin_worlds[std::make_pair(plugins, density)];
+  pw.dir = fs::temp_directory_path() /
+           fs::unique_path("flatland_benchmark_%%%%-%%%%-%%%%");
+  fs::create_directories(pw.dir);
+
+  // a single wall away from the models, a world needs a layer
+  std::ofstream data_file((pw.dir / "map.dat").string());
+  data_file << "-10 -10 -10 -9\n";
+  data_file.close();
+  std::ofstream map_file((pw.dir / "map.yaml").string());
+  map_file << "type: line_segments\n"
+           << "data: map.dat\n"
+           << "scale: 1\n"
+           << "origin: [0, 0, 0]\n";
+  map_file.close();
+
+  std::ofstream model_file((pw.dir / "circle.model.yaml").string());
+  model_file << "bodies:\n"
+             << "  - name: base\n"
+             << "    type: dynamic\n"
+             << "    footprints:\n"
+             << "      - {type: circle, radius: 0.5, density: 1, "
+             << "sensor: true}\n";
+  model_file.close();
+
+  int models = std::max(2, plugins / kPluginsPerModel);
+  int pairs = models / 2;
+  int columns = std::ceil(std::sqrt(pairs));
+  std::ofstream world_file((pw.dir / "world.yaml").string());
+  world_file << "properties: {}\n"
+             << "layers:\n"
+             << "  - name: walls\n"
+             << "    map: map.yaml\n"
+             << "models:\n";
+  for (int j = 0; j < pairs; j++) {
+    double x = (j % columns) * 4.0, y = (j / columns) * 4.0;
+    bool touching = (j * density) % 100 < density;
+    double offsets[2] = {0, touching ? 0.8 : 2.0};
+    for (int k = 0; k < 2; k++) {
+      world_file << "  - name: model_" << 2 * j + k << "\n"
+                 << "    pose: [" << x + offsets[k] << ", " << y << ", 0]\n"
+                 << "    model: circle.model.yaml\n";
+    }
+  }
+  world_file.close();
+
+  pw.world = World::MakeWorld((pw.dir / "world.yaml").string(), "", true);
+
+  YAML::Node config;
+  config["dummy_param_float"] = 0.123456;
+  config["dummy_param_string"] = "dummy_test_123456";
+  config["dummy_param_int"] = 123456;
+  PluginManager &pm = pw.world->plugin_manager_;
+  for (int i = 0; i < plugins; i++) {
+    PluginManager::PreparedPlugin prepared;
+    prepared.name = "counting_" + std::to_string(i / models);
+    prepared.type = "CountingPlugin";
+    prepared.config = config;
+    prepared.plugin.reset(new CountingPlugin());
+    pm.AddModelPlugin(pw.world->models_[i % models], prepared);
+  }
+
+  // one step lets Box2D find the overlapping models, the sensors are not
+  // pushed apart
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  pw.world->Update(timekeeper);
+  for (b2Contact *c = pw.world->physics_world_->GetContactList(); c;
+       c = c->GetNext()) {
+    if (c->IsTouching()) {
+      pw.contacts.push_back(c);
+    }
+  }
+  return pw;
+}
+
+void BM_BeforePhysicsStep(benchmark::State &state) {
+  PluginManager &pm = GeneratedWorld(state.range(0), 0).world->plugin_manager_;
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  for (auto _ : state) {
+    pm.BeforePhysicsStep(timekeeper);
+    timekeeper.StepTime();
+  }
+  state.SetItemsProcessed(state.iterations() * pm.model_plugins_.size());
+}
+
+void BM_AfterPhysicsStep(benchmark::State &state) {
+  PluginManager &pm = GeneratedWorld(state.range(0), 0).world->plugin_manager_;
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  for (auto _ : state) {
+    pm.AfterPhysicsStep(timekeeper);
+    timekeeper.StepTime();
+  }
+  state.SetItemsProcessed(state.iterations() * pm.model_plugins_.size());
+}
+
+/**
+ * @brief Time a contact callback over all touching contacts of a world, as
+ * Box2D calls it in one step
+ * @param[in] state The benchmark state, the arguments are the number of
+ * plugins and the contact density
+ * @param[in] call Calls the callback of the plugin manager for a contact
+ */
+template <class Call>
+void DispatchContacts(benchmark::State &state, const Call &call) {
+  const PluginWorld &pw = GeneratedWorld(state.range(0), state.range(1));
+  PluginManager &pm = pw.world->plugin_manager_;
+  for (auto _ : state) {
+    for (b2Contact *contact : pw.contacts) {
+      call(pm, contact);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pw.contacts.size());
+  state.counters["contacts"] = pw.contacts.size();
+}
+
+void BM_BeginContact(benchmark::State &state) {
+  DispatchContacts(state, [](PluginManager &pm, b2Contact *contact) {
+    pm.BeginContact(contact);
+  });
+}
+
+void BM_PostSolve(benchmark::State &state) {
+  b2ContactImpulse impulse = {};
+  DispatchContacts(state, [&](PluginManager &pm, b2Contact *contact) {
+    pm.PostSolve(contact, &impulse);
+  });
+}
+
+BENCHMARK(BM_BeforePhysicsStep)->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK(BM_AfterPhysicsStep)->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK(BM_BeginContact)
+    ->ArgNames({"plugins", "density"})
+    ->ArgsProduct({{10, 100, 1000, 10000}, {0, 10, 50, 100}});
+BENCHMARK(BM_PostSolve)
+    ->ArgNames({"plugins", "density"})
+    ->ArgsProduct({{10, 100, 1000, 10000}, {0, 10, 50, 100}});
+
+};  // namespace
+
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "plugin_benchmark", ros::init_options::AnonymousName);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+
+  for (auto &pw : plugin_worlds) {
+    delete pw.second.world;
+    fs::remove_all(pw.second.dir);
+  }
+  return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 visualization_benchmark.cpp
+ * @brief	 Benchmarks of the cost of the debug visualization
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <benchmark/benchmark.h>
+#include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/debug_visualization.h>
+#include <flatland_server/layer.h>
+#include <flatland_server/timekeeper.h>
+#include <flatland_server/topic_stats.h>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <yaml-cpp/yaml.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+namespace fs = boost::filesystem;
+using namespace flatland_server;
+
+namespace {
+
+std::map<int, fs::path> generated_maps;  ///< directory of the maps by tiles
+
+/**
+ * @brief Generate, once per count, the map of conestogo_office_test repeated
+ * tiles x tiles times
+ * @param[in] tiles Number of copies of the office along each axis
+ * @return The path of map.yaml
+ */
+std::string OfficeMap(int tiles) {
+  auto it = generated_maps.find(tiles);
+  if (it == generated_maps.end()) {
+    fs::path office = fs::path(__FILE__).parent_path() /
+                      "../test/conestogo_office_test/map.png";
+    fs::path dir = fs::temp_directory_path() /
+                   fs::unique_path("flatland_benchmark_%%%%-%%%%-%%%%");
+    fs::create_directories(dir);
+
+    cv::Mat image = cv::imread(office.string(), cv::IMREAD_GRAYSCALE);
+    cv::imwrite((dir / "map.png").string(), cv::repeat(image, tiles, tiles));
+
+    std::ofstream map_file((dir / "map.yaml").string());
+    map_file << "image: map.png\n"
+             << "resolution: 0.05\n"
+             << "origin: [0, 0, 0]\n"
+             << "negate: 0\n"
+             << "occupied_thresh: 0.65\n"
+             << "free_thresh: 0.196\n";
+    map_file.close();
+    it = generated_maps.emplace(tiles, dir).first;
+  }
+  return (it->second / "map.yaml").string();
+}
+
+/**
+ * @return The serialized length of the markers of a topic, 0 if it does not
+ * exist
+ */
+uint32_t TopicBytes(const std::string &name) {
+  auto &topics = DebugVisualization::Get().topics_;
+  auto it = topics.find(name);
+  if (it == topics.end()) {
+    return 0;
+  }
+  return ros::serialization::serializationLength(it->second.markers);
+}
+
+/**
+ * A layer of the scaled up office, loaded with or without the reduced level
+ * of detail of its visualization
+ */
+class OfficeLayer {
+ public:
+  b2World physics_world_;         ///< the world of the layer
+  CollisionFilterRegistry cfr_;   ///< the registry of the layer
+  std::unique_ptr<Layer> layer_;  ///< the layer
+
+  /**
+   * @param[in] tiles Number of copies of the office along each axis
+   * @param[in] lod true for merged, simplified segments in 50 m regions
+   */
+  OfficeLayer(int tiles, bool lod) : physics_world_(b2Vec2(0, 0)) {
+    std::vector<std::string> names = {"walls"};
+    cfr_.RegisterLayer(names[0]);
+    YAML::Node properties;
+    if (lod) {
+      properties["debug"]["merge_segments"] = true;
+      properties["debug"]["simplify_tolerance"] = 0.05;
+      properties["debug"]["region_size"] = 50;
+    }
+    layer_.reset(Layer::MakeLayer(&physics_world_, &cfr_, OfficeMap(tiles),
+                                  names, Color(1, 1, 1, 1), properties));
+  }
+
+  /**
+   * @brief Build the markers of the layer as Layer::DebugVisualize does when
+   * its geometry changed
+   */
+  void Visualize() {
+    DebugVisualization &viz = DebugVisualization::Get();
+    Body *body = layer_->body_;
+    viz.Reset("layer_walls");
+    viz.Reset("layer_walls_3d");
+    LayerVisualization lod(body->properties_);
+    if (lod.ReducesDetail()) {
+      viz.VisualizeLayer("layer_walls", body, lod);
+    } else {
+      viz.Visualize("layer_walls", body->physics_body_, body->color_.r,
+                    body->color_.g, body->color_.b, body->color_.a);
+      viz.VisualizeLayer("layer_walls_3d", body);
+    }
+  }
+
+  /**
+   * @return The serialized length of the markers of both topics
+   */
+  uint32_t Bytes() const {
+    return TopicBytes("layer_walls") + TopicBytes("layer_walls_3d");
+  }
+
+  ~OfficeLayer() {
+    DebugVisualization::Get().topics_.erase("layer_walls");
+    DebugVisualization::Get().topics_.erase("layer_walls_3d");
+  }
+};
+
+/**
+ * A fleet of robots with the footprints of the cleaner of
+ * conestogo_office_test, a polygon base and three wheels, on a 2 m grid
+ */
+class Fleet {
+ public:
+  b2World physics_world_;         ///< the world of the robots
+  std::vector<b2Body *> bodies_;  ///< the bodies of all robots
+
+  /**
+   * @param[in] robots Number of robots
+   */
+  explicit Fleet(int robots) : physics_world_(b2Vec2(0, 0)) {
+    b2Vec2 base[6] = {{-1.03f, -0.337f}, {0.07983f, -0.337f},
+                      {0.30f, -0.16111f}, {0.30f, 0.16111f},
+                      {0.07983f, 0.337f}, {-1.03f, 0.337f}};
+    b2PolygonShape base_shape;
+    base_shape.Set(base, 6);
+    for (int k = 0; k < robots; k++) {
+      b2BodyDef body_def;
+      body_def.type = b2_dynamicBody;
+      body_def.position.Set((k % 100) * 2.0f, (k / 100) * 2.0f);
+      b2Body *body = physics_world_.CreateBody(&body_def);
+      body->CreateFixture(&base_shape, 100);
+      bodies_.push_back(body);
+
+      b2Vec2 wheels[3] = {{0, 0}, {-0.9f, 0.3f}, {-0.9f, -0.3f}};
+      for (const b2Vec2 &wheel : wheels) {
+        b2PolygonShape wheel_shape;
+        wheel_shape.SetAsBox(0.0875f, 0.025f);
+        body_def.position = body->GetWorldPoint(wheel);
+        b2Body *wheel_body = physics_world_.CreateBody(&body_def);
+        wheel_body->CreateFixture(&wheel_shape, 1);
+        bodies_.push_back(wheel_body);
+      }
+    }
+  }
+
+  /**
+   * @param[in] robot Index of a robot
+   * @return The topic of the robot
+   */
+  static std::string Topic(int robot) {
+    return "model/robot_" + std::to_string(robot);
+  }
+};
+
+/**
+ * Benchmark the markers of a layer, the arguments are the number of copies
+ * of the office along each axis and whether the detail is reduced
+ */
+void BM_VisualizeLayer(benchmark::State &state) {
+  OfficeLayer office(state.range(0), state.range(1));
+  for (auto _ : state) {
+    office.Visualize();
+  }
+  state.counters["bytes"] = office.Bytes();
+  int fixtures = 0;
+  for (b2Fixture *f = office.layer_->body_->physics_body_->GetFixtureList();
+       f != nullptr; f = f->GetNext()) {
+    fixtures++;
+  }
+  state.counters["fixtures"] = fixtures;
+}
+
+/**
+ * Benchmark the serialization of the markers of a layer, which publishing
+ * does for each remote subscriber, the arguments are those of
+ * BM_VisualizeLayer
+ */
+void BM_SerializeLayer(benchmark::State &state) {
+  OfficeLayer office(state.range(0), state.range(1));
+  office.Visualize();
+  const auto &topics = DebugVisualization::Get().topics_;
+  std::vector<const visualization_msgs::MarkerArray *> markers;
+  for (const auto &topic : topics) {
+    if (topic.first.compare(0, 11, "layer_walls") == 0) {
+      markers.push_back(&topic.second.markers);
+    }
+  }
+
+  for (auto _ : state) {
+    for (const visualization_msgs::MarkerArray *m : markers) {
+      ros::SerializedMessage message = ros::serialization::serializeMessage(*m);
+      benchmark::DoNotOptimize(message.buf.get());
+    }
+  }
+  state.counters["bytes"] = office.Bytes();
+  state.counters["bytes/s"] = benchmark::Counter(
+      static_cast<double>(office.Bytes()) * state.iterations(),
+      benchmark::Counter::kIsRate);
+}
+
+/**
+ * Benchmark DebugVisualization::BodyToMarkers over all bodies of a fleet,
+ * the argument is the number of robots
+ */
+void BM_BodyToMarkers(benchmark::State &state) {
+  Fleet fleet(state.range(0));
+  visualization_msgs::MarkerArray markers;
+  for (auto _ : state) {
+    markers.markers.clear();
+    for (b2Body *body : fleet.bodies_) {
+      DebugVisualization::Get().BodyToMarkers(markers, body, 1, 1, 1, 0.75);
+    }
+    benchmark::DoNotOptimize(markers.markers.data());
+  }
+  state.counters["markers"] = markers.markers.size();
+  state.counters["bytes"] = ros::serialization::serializationLength(markers);
+}
+
+/**
+ * Benchmark DebugVisualization::Publish of the topics of a fleet, one per
+ * robot, all of which changed since the last publish. The arguments are the
+ * number of robots and whether publishing is asynchronous. Without remote
+ * subscribers, roscpp does not serialize the messages, see
+ * BM_SerializeLayer for that cost
+ */
+void BM_PublishFleet(benchmark::State &state) {
+  DebugVisualization &viz = DebugVisualization::Get();
+  DebugVisualization::SetAsyncPublishing(state.range(1));
+  Fleet fleet(state.range(0));
+  for (size_t i = 0; i < fleet.bodies_.size(); i++) {
+    viz.Visualize(Fleet::Topic(i / 4), fleet.bodies_[i], 1, 1, 1, 0.75);
+  }
+
+  Timekeeper timekeeper;
+  TopicStats::SetEnabled(true);
+  TopicStats::Get().Reset();
+  for (auto _ : state) {
+    for (int k = 0; k < state.range(0); k++) {
+      viz.topics_[Fleet::Topic(k)].needs_publishing = true;
+    }
+    viz.Publish(timekeeper);
+  }
+  viz.StopPublishing();
+
+  uint64_t bytes = 0;
+  for (const auto &entry :
+       TopicStats::Get().GetTopTalkers(0, TopicStats::BYTES)) {
+    bytes += entry.bytes;
+  }
+  TopicStats::SetEnabled(false);
+  state.counters["bytes"] = static_cast<double>(bytes) / state.iterations();
+
+  for (int k = 0; k < state.range(0); k++) {
+    viz.topics_.erase(Fleet::Topic(k));
+  }
+  DebugVisualization::SetAsyncPublishing(false);
+}
+
+BENCHMARK(BM_VisualizeLayer)
+    ->ArgNames({"tiles", "lod"})
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SerializeLayer)
+    ->ArgNames({"tiles", "lod"})
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BodyToMarkers)
+    ->ArgNames({"robots"})
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->Unit(benchmark::kMicrosecond);
+// the topics are published on the thread with async, so only the real time
+// of the simulation thread counts
+BENCHMARK(BM_PublishFleet)
+    ->ArgNames({"robots", "async"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+};  // namespace
+
+// Run with a roscore running, the topics are advertised
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "flatland_visualization_benchmarks",
+            ros::init_options::AnonymousName);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+
+  for (const auto &map : generated_maps) {
+    fs::remove_all(map.second);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 alloc_counter.h
+ * @brief	 Counting of the heap allocations of the simulation steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_ALLOC_COUNTER_H
+#define FLATLAND_SERVER_ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace flatland_server {
+
+/**
+ * This class counts the heap allocations made while a Scope is alive, on any
+ * thread, to find the allocations of the simulation steps, which should have
+ * none once their buffers have grown. The global operator new is only
+ * replaced when flatland_server is configured with -DALLOC_COUNTING=ON, which
+ * defines FLATLAND_ALLOC_COUNTING, otherwise nothing is counted and the
+ * FLATLAND_COUNT_ALLOCATIONS macro compiles to nothing
+ */
+class AllocCounter {
+ public:
+  /// Number and size of allocations
+  struct Counts {
+    uint64_t allocations;  ///< number of allocations
+    uint64_t bytes;        ///< bytes allocated
+  };
+
+  /**
+   * This class counts the allocations until it is destroyed, a warning with
+   * their number is logged at most once per second if there were any
+   */
+  class Scope {
+   public:
+    /**
+     * @param[in] name Name in the warning, e.g. the function counted
+     */
+    explicit Scope(const char *name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    /**
+     * @return The allocations since the start of the scope, including those
+     * of other threads
+     */
+    Counts GetCounts() const;
+
+   private:
+    const char *name_;  ///< name in the warning
+    Counts start_;      ///< counts at the start of the scope
+  };
+
+  /**
+   * @return If the allocations are counted, see FLATLAND_ALLOC_COUNTING
+   */
+  static bool IsEnabled();
+
+  /**
+   * @return The allocations counted while any scope was alive
+   */
+  static Counts Get();
+
+  /**
+   * @brief Count an allocation if a scope is alive, called by operator new
+   * @param[in] bytes Size of the allocation
+   */
+  static void Record(size_t bytes) {
+    if (active_.load(std::memory_order_relaxed) > 0) {
+      allocations_.fetch_add(1, std::memory_order_relaxed);
+      bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  static std::atomic<int> active_;  ///< number of scopes alive
+  static std::atomic<uint64_t> allocations_;  ///< allocations counted
+  static std::atomic<uint64_t> bytes_;        ///< bytes counted
+};
+};  // namespace flatland_server
+
+#define FLATLAND_ALLOC_CONCAT_(a, b) a##b
+#define FLATLAND_ALLOC_CONCAT(a, b) FLATLAND_ALLOC_CONCAT_(a, b)
+
+#ifndef FLATLAND_ALLOC_COUNTING
+#define FLATLAND_COUNT_ALLOCATIONS(name)
+#else
+/**
+ * Count the heap allocations until the end of the current scope, and warn if
+ * there were any
+ */
+#define FLATLAND_COUNT_ALLOCATIONS(name)                      \
+  flatland_server::AllocCounter::Scope FLATLAND_ALLOC_CONCAT( \
+      flatland_alloc_scope_, __LINE__)(name)
+#endif
+
+#endif  // FLATLAND_SERVER_ALLOC_COUNTER_H
@@ -65,6 +65,7 @@ class Body {
   b2Body *physics_body_;   ///< Box2D physics body
   Color color_;            ///< color, for visualization
   YAML::Node properties_;  ///< Properties document for plugins to use
+  int state_index_ = -1;   ///< index in BodyStates, -1 if not added
 
   /**
    * @brief constructor for body, takes in all the required parameters
@@ -133,5 +134,61 @@ class Body {
   Body(const Body &) = delete;
   Body &operator=(const Body &) = delete;
 };
+
+/**
+ * Creates or destroys the fixtures of static bodies in bulk. While an
+ * instance is in scope, the broad-phase proxies of new fixtures on static
+ * bodies are not inserted one by one, and the ones of destroyed fixtures are
+ * not removed one by one. The tree is built in one pass when the last
+ * instance goes out of scope, see b2World::BeginStaticBulk. Ray casts and
+ * queries do not find these fixtures until then
+ */
+class BulkFixtures {
+ public:
+  /**
+   * @brief Begin creating fixtures in bulk
+   * @param[in] physics_world Box2D physics world of the bodies
+   */
+  explicit BulkFixtures(b2World *physics_world);
+
+  /**
+   * @brief End creating fixtures in bulk, builds the tree
+   */
+  ~BulkFixtures();
+
+  BulkFixtures(const BulkFixtures &) = delete;
+  BulkFixtures &operator=(const BulkFixtures &) = delete;
+
+ private:
+  b2World *physics_world_;  ///< Box2D physics world of the bodies
+};
+
+/**
+ * Destroys many bodies in bulk, e.g. the models of a fleet or a whole world.
+ * While an instance is in scope, the broad-phase proxies of destroyed
+ * fixtures, static or not, are only marked destroyed, and removed from the
+ * trees in one pass when the last instance goes out of scope, rebuilding
+ * them if many were destroyed, see b2World::BeginBulkDestroy. It also acts
+ * as a BulkFixtures
+ */
+class BulkDestroy {
+ public:
+  /**
+   * @brief Begin destroying bodies in bulk
+   * @param[in] physics_world Box2D physics world of the bodies
+   */
+  explicit BulkDestroy(b2World *physics_world);
+
+  /**
+   * @brief End destroying bodies in bulk, removes their proxies
+   */
+  ~BulkDestroy();
+
+  BulkDestroy(const BulkDestroy &) = delete;
+  BulkDestroy &operator=(const BulkDestroy &) = delete;
+
+ private:
+  b2World *physics_world_;  ///< Box2D physics world of the bodies
+};
 };      // namespace flatland_server
 #endif  // FLATLAND_MODEL_BODY_H
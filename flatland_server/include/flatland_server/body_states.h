@@ -0,0 +1,163 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 body_states.h
+ * @brief	 Contiguous snapshot of the states of the bodies
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_BODY_STATES_H
+#define FLATLAND_SERVER_BODY_STATES_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/types.h>
+#include <cstdint>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+
+/**
+ * This class keeps the poses and velocities of the bodies of the models in a
+ * structure of arrays, refreshed once after each physics step. Loops over
+ * many bodies, e.g. publishing their transforms, read the contiguous arrays
+ * by Body::state_index_ instead of chasing the pointers to the Box2D bodies,
+ * and may run on several threads at once. The state is the one of the last
+ * refresh, changes made to the Box2D bodies in between are not seen
+ */
+class BodyStates {
+ public:
+  std::vector<Body *> bodies_;  ///< the bodies, by index
+  std::vector<float> x_;        ///< x of the body origins
+  std::vector<float> y_;        ///< y of the body origins
+  std::vector<float> angle_;    ///< angles of the bodies
+  std::vector<float> cos_;      ///< cosines of angle_
+  std::vector<float> sin_;      ///< sines of angle_
+  std::vector<float> vx_;       ///< x of the linear velocities of the centers
+                                /// of mass
+  std::vector<float> vy_;       ///< y of the linear velocities of the centers
+                                /// of mass
+  std::vector<float> omega_;    ///< angular velocities
+  uint64_t generation_ = 0;     ///< incremented when a body is added or
+                                /// removed
+  uint64_t refreshes_ = 0;      ///< incremented by each Refresh, e.g. to
+                                /// know when values derived from the
+                                /// states are stale
+  uint64_t moves_ = 0;          ///< incremented when bodies are moved
+                                /// outside of the physics steps, by
+                                /// Refresh(const Body *) and the restores
+                                /// of the world
+
+  /**
+   * @brief Add a body and read its state, sets Body::state_index_
+   * @param[in] body The body, must not be added already
+   */
+  void Add(Body *body);
+
+  /**
+   * @brief Remove a body, the last body takes its index
+   * @param[in] body The body, nothing happens if it is not added
+   */
+  void Remove(Body *body);
+
+  /**
+   * @brief Read the states of all bodies from Box2D
+   */
+  void Refresh();
+
+  /**
+   * @brief Read the state of one body from Box2D, e.g. after moving it,
+   * increments moves_
+   * @param[in] body The body, nothing happens if it is not added
+   */
+  void Refresh(const Body *body);
+
+  /**
+   * @return The number of bodies
+   */
+  size_t Size() const { return bodies_.size(); }
+
+  /**
+   * @brief Get the transform of a body, read from Box2D if it is not added
+   * @param[in] body The body
+   * @return The transform of the body origin
+   */
+  b2Transform GetTransform(const Body *body) const;
+
+  /**
+   * @brief Get the pose of a body, read from Box2D if it is not added
+   * @param[in] body The body
+   * @return The pose of the body origin
+   */
+  Pose GetPose(const Body *body) const;
+
+  /**
+   * @brief Get the linear velocity of a body, read from Box2D if it is not
+   * added
+   * @param[in] body The body
+   * @return The linear velocity of the center of mass
+   */
+  b2Vec2 GetLinearVelocity(const Body *body) const;
+
+  /**
+   * @brief Get the angular velocity of a body, read from Box2D if it is not
+   * added
+   * @param[in] body The body
+   * @return The angular velocity
+   */
+  float GetAngularVelocity(const Body *body) const;
+
+ private:
+  /**
+   * @param[in] body A body
+   * @return The index of the body, -1 if it is not added
+   */
+  int IndexOf(const Body *body) const;
+
+  /**
+   * @brief Read the state of the body at an index from Box2D
+   * @param[in] i The index
+   */
+  void Read(size_t i);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_BODY_STATES_H
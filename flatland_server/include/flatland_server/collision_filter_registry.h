@@ -47,8 +47,10 @@
 #ifndef FLATLAND_SERVER_COLLISION_FILTER_REGISTRY_H
 #define FLATLAND_SERVER_COLLISION_FILTER_REGISTRY_H
 
-#include <map>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace flatland_server {
@@ -65,13 +67,18 @@ class CollisionFilterRegistry {
   static const int LAYER_NOT_EXIST = -1;      ///< No such layer
   static const int LAYER_ALREADY_EXIST = -2;  ///< Layer exists
   static const int LAYERS_FULL = -3;          ///< Cannot add more layers
-  static const int MAX_LAYERS = 16;  ///< 16 is the maximum as defined by Box2D
+  /// the width of the collision category bits, widened from 16 to 32 bits in
+  /// the bundled Box2D
+  static const int MAX_LAYERS = 32;
+  /// the most collide or no collide groups, Box2D groups are 16 bit signed
+  static const int MAX_GROUPS = 32767;
 
   /// internal counter to keep track of no collides groups
   int no_collide_group_cnt_;
   /// internal counter to keep track of collide groups
   int collide_group_cnt_;
-  std::map<std::string, int> layer_id_table_;  ///< Layer name to ID LUT
+  std::unordered_map<std::string, int> layer_id_table_;  ///< name to ID LUT
+  uint32_t used_layer_ids_;  ///< bit i is set if ID i is assigned
 
   /**
    * @brief Constructor for the collision filter registry
@@ -88,6 +95,17 @@ class CollisionFilterRegistry {
    */
   int RegisterNoCollide();
 
+  /**
+   * @brief Get the collision group of a name, a new collide or no collide
+   * group is registered the first time the name is used. Thread safe
+   * @param[in] name Name of the group, e.g. from the model YAML
+   * @param[in] collide If a new group is a collide group
+   * @return The group, its sign is the one it was registered with, which
+   * differs from collide if the name was first used with the other. 0 if
+   * MAX_GROUPS groups of the kind are registered already
+   */
+  int RegisterGroup(const std::string &name, bool collide);
+
   /**
    * @brief Check if the number of layers maxed out
    * @return if layers are full
@@ -124,13 +142,30 @@ class CollisionFilterRegistry {
   /**
    * @brief: Get the Box2D category bits from a list of layers
    * @param[in] layers The layers for generating the category bits, if the input
-   * exactly equals to {"all"}, it returns all bits to 1 (0xFFFF)
+   * exactly equals to {"all"}, it returns all bits to 1 (0xFFFFFFFF)
    * @param[out] invalid_layers if a given layer does not exist, it is pushed to
    * this list, optional
+   * The bits of lists of existing layers are cached, since the same lists are
+   * looked up by every model spawned from a model YAML file. Thread safe
+   * against other calls of GetCategoryBits
    */
-  uint16_t GetCategoryBits(
+  uint32_t GetCategoryBits(
       const std::vector<std::string> &layers,
       std::vector<std::string> *invalid_layers = nullptr) const;
+
+ private:
+  /// max number of cached layer lists, the lists come from YAML files so the
+  /// bound is only hit by generated ones
+  static const size_t MAX_CACHED_BITS = 4096;
+
+  /// category bits of lists of existing layers, keyed by the names joined
+  /// with '\n'. Layers are never unregistered, so the entries stay valid
+  mutable std::unordered_map<std::string, uint32_t> bits_cache_;
+  mutable std::mutex bits_cache_mutex_;  ///< models are prepared on any thread
+
+  /// groups by name, see RegisterGroup
+  std::unordered_map<std::string, int> groups_;
+  std::mutex groups_mutex_;  ///< guards groups_ and the group counters
 };
 };      // namespace flatland_server
 #endif  // FLATLAND_SERVER_COLLISION_FILTER_REGISTRY_H
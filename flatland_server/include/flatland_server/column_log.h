@@ -0,0 +1,253 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 column_log.h
+ * @brief	 Chunked columnar binary log of the state of a run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_COLUMN_LOG_H
+#define FLATLAND_SERVER_COLUMN_LOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads and writes logs of tables stored by columns, e.g. the
+ * poses of the bodies on every step, for offline analysis. The rows of a
+ * table are written in chunks, each column of a chunk as one or two buffers
+ * compressed with zlib, so a reader loads a column without parsing rows.
+ *
+ * The file starts with the 8 bytes FLCOLLOG and a little endian uint32
+ * version. Blocks follow, as LEB128 varints: a table block names a table and
+ * its columns (id, name, column count, then name and type of each column), a
+ * chunk block has the table id, the row count, then for each buffer of each
+ * column the codec (0 raw, 1 zlib), the raw size and the stored size before
+ * the stored bytes. UINT32 columns have one buffer of values, FLOAT32 and
+ * FLOAT64 one buffer of values with their bytes split into streams (all the
+ * first bytes, then all the second ones...) which compresses better, list and
+ * string columns a buffer of uint32 lengths per row followed by the buffer of
+ * the values. Values are little endian. See scripts/column_log.py
+ */
+class ColumnLog {
+ public:
+  /// The type of a column
+  enum Type : uint8_t {
+    UINT32 = 0,
+    FLOAT32 = 1,
+    FLOAT64 = 2,
+    FLOAT32_LIST = 3,  ///< a variable number of float32 per row
+    STRING = 4
+  };
+
+  /**
+   * A column of a table
+   */
+  struct Column {
+    std::string name;  ///< name of the column
+    Type type;         ///< type of the values
+  };
+
+  /**
+   * A table read from a log
+   */
+  struct Table {
+    std::string name;             ///< name of the table
+    std::vector<Column> columns;  ///< the columns
+    uint64_t rows = 0;            ///< number of rows
+    /// values of each column, of all chunks in order, the bytes of the
+    /// string columns
+    std::vector<std::vector<uint8_t>> values;
+    /// number of values of each row of the list and string columns
+    std::vector<std::vector<uint32_t>> lengths;
+
+    /**
+     * @param[in] column Index of the column
+     * @return The values of a column as T, which must match its type
+     */
+    template <typename T>
+    std::vector<T> Get(size_t column) const {
+      const std::vector<uint8_t> &v = values.at(column);
+      const T *begin = reinterpret_cast<const T *>(v.data());
+      return std::vector<T>(begin, begin + v.size() / sizeof(T));
+    }
+  };
+
+  /**
+   * This class writes a log. The rows are built with Put and EndRow and
+   * handed to a background thread once a chunk is full, which compresses and
+   * writes it. The writer is not thread safe
+   */
+  class Writer {
+   public:
+    /**
+     * @brief Create the log file, throws exception upon failure
+     * @param[in] path Path to the file
+     * @param[in] level zlib compression level, 0 to store the buffers raw
+     * @param[in] chunk_rows Number of rows of a chunk
+     */
+    Writer(const std::string &path, int level = 1,
+           uint32_t chunk_rows = 65536);
+
+    /**
+     * @brief Destructor, closes the log, see Close
+     */
+    ~Writer();
+
+    /**
+     * @brief Add a table
+     * @param[in] name Name of the table
+     * @param[in] columns Columns of the table
+     * @return Id of the table
+     */
+    uint32_t AddTable(const std::string &name,
+                      const std::vector<Column> &columns);
+
+    /**
+     * @brief Set the value of a column of the current row of a table, each
+     * column must be set once per row with the type of the column
+     * @param[in] table Id of the table
+     * @param[in] column Index of the column
+     * @param[in] value The value
+     */
+    void Put(uint32_t table, uint32_t column, uint32_t value) {
+      Append(table, column, &value, sizeof(value));
+    }
+    void Put(uint32_t table, uint32_t column, float value) {
+      Append(table, column, &value, sizeof(value));
+    }
+    void Put(uint32_t table, uint32_t column, double value) {
+      Append(table, column, &value, sizeof(value));
+    }
+    void Put(uint32_t table, uint32_t column, const float *values,
+             uint32_t count);
+    void Put(uint32_t table, uint32_t column, const std::string &value);
+
+    /**
+     * @brief End the current row of a table, throws exception if the
+     * background thread failed to write
+     * @param[in] table Id of the table
+     */
+    void EndRow(uint32_t table);
+
+    /**
+     * @brief Write the rows of all tables, wait for the background thread
+     * and close the file, throws exception upon failure. Does nothing once
+     * closed
+     */
+    void Close();
+
+   private:
+    /// The rows of a table not written yet
+    struct PendingTable {
+      std::vector<Column> columns;  ///< the columns
+      uint32_t rows = 0;            ///< number of rows
+      std::vector<std::vector<uint8_t>> values;    ///< values by column
+      std::vector<std::vector<uint32_t>> lengths;  ///< lengths by column
+    };
+
+    /// A block handed to the background thread
+    struct Block {
+      std::vector<uint8_t> header;  ///< written as is
+      std::vector<std::vector<uint8_t>> buffers;  ///< compressed, in order
+      std::vector<uint8_t> widths;  ///< bytes of the values of each buffer,
+                                    /// split into streams when above 1
+    };
+
+    std::string path_;    ///< path to the file
+    std::ofstream out_;   ///< the file, written by the background thread
+    int level_;           ///< zlib compression level
+    uint32_t chunk_rows_;  ///< number of rows of a chunk
+    std::vector<PendingTable> tables_;  ///< the tables, by id
+    bool closed_ = false;               ///< if Close was called
+
+    std::thread thread_;              ///< compresses and writes the blocks
+    std::mutex mutex_;                ///< guards the members below
+    std::condition_variable cv_;      ///< signaled on changes of the queue
+    std::deque<Block> queue_;         ///< blocks to write
+    bool stopping_ = false;           ///< if the thread must stop when idle
+    bool failed_ = false;             ///< if the thread failed to write
+
+    /**
+     * @brief Append the bytes of a value to a column of the current row
+     */
+    void Append(uint32_t table, uint32_t column, const void *value,
+                size_t size) {
+      const uint8_t *bytes = static_cast<const uint8_t *>(value);
+      std::vector<uint8_t> &v = tables_[table].values[column];
+      v.insert(v.end(), bytes, bytes + size);
+    }
+
+    /**
+     * @brief Hand the rows of a table to the background thread
+     */
+    void Seal(uint32_t table);
+
+    /**
+     * @brief Queue a block, waits while the background thread is far behind
+     * so that the memory stays bounded
+     */
+    void Enqueue(Block block);
+
+    /**
+     * @brief Loop of the background thread
+     */
+    void Run();
+  };
+
+  /**
+   * @brief Read all tables of a log, throws exception upon failure. A log
+   * cut short, e.g. of a run that crashed, ends with its last complete chunk
+   * @param[in] path Path to the file
+   * @return The tables, by id
+   */
+  static std::vector<Table> Read(const std::string &path);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_COLUMN_LOG_H
@@ -0,0 +1,150 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_latency.h
+ * @brief	 Latency from commands being received to their effects
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_COMMAND_LATENCY_H
+#define FLATLAND_SERVER_COMMAND_LATENCY_H
+
+#include <flatland_server/step_timer.h>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+namespace flatland_server {
+
+/**
+ * This class measures the latency of the commands of a model, from the
+ * subscriber receiving a command to its effects: the callback handling it,
+ * the step it sets the velocity of the body for, and the first odometry and
+ * scan published with the new velocity. This shows the delays of where the
+ * callbacks are spun and of the update rates of the publications. Only the
+ * last command received is followed, a command replaced before it is applied
+ * is counted as superseded. The latencies are histograms of seconds of the
+ * monotonic clock. Thread safe, the sensors may publish from other threads
+ */
+class CommandLatency {
+ public:
+  /// The effects of a command
+  enum Stage {
+    DISPATCH,  ///< the callback handles the command
+    PHYSICS,   ///< the velocity is set for the next step
+    ODOMETRY,  ///< the odometry is published with the new velocity
+    SCAN,      ///< a scan is taken after a step with the new velocity
+    STAGE_COUNT
+  };
+
+  /**
+   * @return The name of a stage, e.g. physics
+   */
+  static const char *GetStageName(Stage stage);
+
+  /**
+   * @return The time of the monotonic clock
+   */
+  static double Now();
+
+  /**
+   * @brief Called by the callback handling a command
+   * @param[in] received The time the subscriber received the command
+   * @param[in] now The current time
+   */
+  void Receive(double received, double now);
+
+  /**
+   * @brief Called when the velocity of the last command received is set on
+   * the body, does nothing if it was set already
+   * @param[in] sim_time The simulation time of the step
+   * @param[in] now The current time
+   */
+  void Apply(double sim_time, double now);
+
+  /**
+   * @brief Called when the odometry or a scan is published, the first
+   * publication of each stage after a command is applied is measured. The
+   * odometry of the step the command is applied at has the new velocity, a
+   * scan must be taken at a later step, once the body moved
+   * @param[in] stage ODOMETRY or SCAN
+   * @param[in] sim_time The simulation time the data was taken at
+   * @param[in] now The current time
+   */
+  void Publish(Stage stage, double sim_time, double now);
+
+  /**
+   * @return The latencies from the receipt of the commands to a stage
+   */
+  TimingHistogram GetLatency(Stage stage) const;
+
+  /**
+   * @return The number of commands received
+   */
+  uint64_t GetCommandCount() const;
+
+  /**
+   * @return The number of commands replaced by a newer one before they were
+   * applied
+   */
+  uint64_t GetSupersededCount() const;
+
+  /**
+   * @brief Clear the latencies and counts, e.g. once they are reported. The
+   * command followed keeps being followed
+   */
+  void Reset();
+
+ private:
+  mutable std::mutex mutex_;  ///< guards the members below
+
+  bool pending_ = false;           ///< if a command waits to be applied
+  double pending_received_ = 0;    ///< receipt time of the waiting command
+  double applied_received_ = 0;    ///< receipt time of the applied command
+  double applied_sim_time_ = 0;    ///< simulation time it was applied at
+  std::array<bool, STAGE_COUNT> armed_{};  ///< stages not reached yet by
+                                           /// the applied command
+  std::array<TimingHistogram, STAGE_COUNT> latencies_;  ///< by stage
+  uint64_t commands_ = 0;    ///< commands received
+  uint64_t superseded_ = 0;  ///< commands replaced before being applied
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_COMMAND_LATENCY_H
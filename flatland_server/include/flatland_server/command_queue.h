@@ -0,0 +1,145 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_queue.h
+ * @brief	 Queue of commands applied by the simulation loop
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_COMMAND_QUEUE_H
+#define FLATLAND_SERVER_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace flatland_server {
+
+/**
+ * This class passes the ROS callbacks to the simulation loop when they are
+ * served by an AsyncSpinner: the callbacks post commands, which the loop
+ * applies between steps, so they never run while a world is stepped. Posting
+ * is lock free, the commands are pushed to a stack which Apply takes at once.
+ * While disabled, which is the default, commands are run when posted
+ */
+class CommandQueue {
+ public:
+  typedef std::function<void()> Command;
+
+  /**
+   * @brief Return the singleton object
+   */
+  static CommandQueue &Get();
+
+  ~CommandQueue();
+
+  /**
+   * @brief Enable or disable queuing, drops the commands not applied yet.
+   * Must not be called while a Call is waiting, i.e. after Close once the
+   * threads posting are stopped
+   * @param[in] enabled true to queue the commands until Apply
+   */
+  void SetEnabled(bool enabled);
+
+  /**
+   * @return true if the commands are queued until Apply
+   */
+  bool IsEnabled() const { return enabled_.load(); }
+
+  /**
+   * @brief Post a command, run now if disabled. Commands posted after Close
+   * are dropped
+   * @param[in] command The command
+   */
+  void Post(Command command);
+
+  /**
+   * @brief Post a command and wait until it was applied, the exceptions of
+   * the command are rethrown. Must not be called by the thread calling Apply
+   * @param[in] command The command
+   * @return false if the queue was closed before applying the command
+   */
+  bool Call(Command command);
+
+  /**
+   * @brief Apply the commands posted so far in the order they were posted,
+   * called by the simulation loop between steps
+   * @return The number of commands applied
+   */
+  unsigned int Apply();
+
+  /**
+   * @brief Block until a command is posted or the timeout elapses, for the
+   * simulation loop to sleep while it has nothing else to do
+   * @param[in] timeout Maximum wait, in seconds
+   * @return true if commands are waiting to be applied
+   */
+  bool Wait(double timeout);
+
+  /**
+   * @brief Apply the remaining commands, later commands are dropped and
+   * waiting callers return, until the next SetEnabled
+   */
+  void Close();
+
+ private:
+  struct Node {
+    Command command;
+    Node *next;
+  };
+
+  CommandQueue() = default;
+
+  /**
+   * @brief Delete a stack of nodes without running them
+   */
+  static void Delete(Node *head);
+
+  std::atomic<Node *> head_{nullptr};  ///< the commands, last posted first
+  std::atomic<bool> enabled_{false};   ///< true if queuing
+  std::atomic<bool> closed_{false};    ///< true after Close
+  std::atomic<int> waiting_{0};        ///< number of threads in Wait
+  std::mutex wait_mutex_;              ///< guards the wake up of Wait
+  std::condition_variable posted_;     ///< notified by Post while waiting_
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_COMMAND_QUEUE_H
@@ -0,0 +1,149 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 contact_event_queue.h
+ * @brief	 Ring buffer of the contact events of a physics step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_CONTACT_EVENT_QUEUE_H
+#define FLATLAND_SERVER_CONTACT_EVENT_QUEUE_H
+
+#include <Box2D/Box2D.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * A contact callback recorded during the physics step, delivered to the
+ * plugins after it, see FlatlandPlugin::ContactEvents
+ */
+struct ContactEvent {
+  /// The callback the event was recorded from
+  enum Type : uint8_t {
+    BEGIN,    ///< BeginContact
+    END,      ///< EndContact
+    IMPULSE,  ///< PostSolve
+  };
+
+  Type type;             ///< the callback
+  b2Fixture *fixture_a;  ///< first fixture of the contact
+  b2Fixture *fixture_b;  ///< second fixture of the contact
+  b2Vec2 normal;         ///< world normal from fixture_a to fixture_b, zero
+                         /// if the fixtures were not touching
+  b2Vec2 point;  ///< mean of the world contact points, zero if none
+  float normal_impulse;   ///< sum of the normal impulses, IMPULSE only
+  float tangent_impulse;  ///< sum of the tangent impulses, IMPULSE only
+
+  /**
+   * @brief Record the state of a contact, the contact itself may be
+   * destroyed by the physics step
+   * @param[in] type The callback
+   * @param[in] contact The contact
+   * @param[in] impulse The impulse of a PostSolve, nullptr otherwise
+   * @return The event
+   */
+  static ContactEvent Record(Type type, b2Contact *contact,
+                             const b2ContactImpulse *impulse = nullptr);
+};
+
+/**
+ * This class keeps the contact events of a physics step in a buffer
+ * allocated once, so recording them from the Box2D callbacks never
+ * allocates. When full, the oldest events are overwritten and counted as
+ * dropped
+ */
+class ContactEventQueue {
+ public:
+  /**
+   * @brief Set the number of events kept, drops the events recorded so far
+   * @param[in] capacity Number of events, 0 disables recording
+   */
+  void SetCapacity(size_t capacity);
+
+  /**
+   * @return The number of events kept, 0 if disabled
+   */
+  size_t Capacity() const { return events_.size(); }
+
+  /**
+   * @brief Add an event, overwriting the oldest one when full. Ignored if
+   * the capacity is 0
+   * @param[in] event The event
+   */
+  void Push(const ContactEvent &event);
+
+  /**
+   * @return The number of events recorded and not cleared
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * @param[in] i Index of the event, 0 being the oldest, less than Size
+   * @return The event
+   */
+  const ContactEvent &operator[](size_t i) const {
+    return events_[(head_ + i) % events_.size()];
+  }
+
+  /**
+   * @brief Remove all events, keeps the buffer
+   */
+  void Clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  /**
+   * @return The total number of events overwritten before being cleared
+   */
+  uint64_t Dropped() const { return dropped_; }
+
+ private:
+  std::vector<ContactEvent> events_;  ///< the ring buffer
+  size_t head_ = 0;       ///< index of the oldest event
+  size_t size_ = 0;       ///< number of events in the buffer
+  uint64_t dropped_ = 0;  ///< number of events overwritten
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_CONTACT_EVENT_QUEUE_H
@@ -0,0 +1,146 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 counted_publish.h
+ * @brief	Publishes messages counted by TopicStats
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_COUNTED_PUBLISH_H
+#define FLATLAND_SERVER_COUNTED_PUBLISH_H
+
+#include <flatland_server/publish_queue.h>
+#include <flatland_server/topic_stats.h>
+#include <ros/publisher.h>
+#include <ros/serialization.h>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <chrono>
+
+namespace flatland_server {
+
+/**
+ * @brief Publish a message and record it in TopicStats when it is enabled.
+ * The serialized length is computed only then, it is a pass over the message
+ * @param[in] publisher The publisher
+ * @param[in] message The message
+ * @param[in] length The serialized length of the message
+ */
+template <typename Message>
+void PublishCounted(const ros::Publisher &publisher, const Message &message,
+                    uint32_t length) {
+  uint32_t subscribers = publisher.getNumSubscribers();
+  auto start = std::chrono::steady_clock::now();
+  publisher.publish(message);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  TopicStats::Get().Record(publisher.getTopic(), length, subscribers, seconds);
+}
+
+/**
+ * @brief Publish a message on the calling thread, see TopicStats
+ * @param[in] publisher The publisher
+ * @param[in] message The message
+ */
+template <typename Message>
+void PublishCountedNow(const ros::Publisher &publisher,
+                       const Message &message) {
+  if (!TopicStats::IsEnabled()) {
+    publisher.publish(message);
+    return;
+  }
+  PublishCounted(publisher, message,
+                 ros::serialization::serializationLength(message));
+}
+
+/**
+ * @brief Publish a shared message on the calling thread, see TopicStats. The
+ * message is not serialized for intraprocess subscribers
+ * @param[in] publisher The publisher
+ * @param[in] message The message
+ */
+template <typename Message>
+void PublishCountedNow(const ros::Publisher &publisher,
+                       const boost::shared_ptr<Message> &message) {
+  if (!TopicStats::IsEnabled()) {
+    publisher.publish(message);
+    return;
+  }
+  PublishCounted(publisher, message,
+                 ros::serialization::serializationLength(*message));
+}
+
+/**
+ * @brief Publish a shared message, see TopicStats. With the PublishQueue
+ * enabled, the message is handed to a publisher thread, so it must not be
+ * modified afterwards
+ * @param[in] publisher The publisher
+ * @param[in] message The message
+ */
+template <typename Message>
+void PublishCounted(const ros::Publisher &publisher,
+                    const boost::shared_ptr<Message> &message) {
+  if (!PublishQueue::IsEnabled()) {
+    PublishCountedNow(publisher, message);
+    return;
+  }
+  PublishQueue::Get().Post(publisher.getTopic(), [publisher, message]() {
+    PublishCountedNow(publisher, message);
+  });
+}
+
+/**
+ * @brief Publish a message, see TopicStats. With the PublishQueue enabled,
+ * a copy of the message is handed to a publisher thread, which serializes it
+ * @param[in] publisher The publisher
+ * @param[in] message The message
+ */
+template <typename Message>
+void PublishCounted(const ros::Publisher &publisher, const Message &message) {
+  if (!PublishQueue::IsEnabled()) {
+    PublishCountedNow(publisher, message);
+    return;
+  }
+  PublishCounted(publisher, boost::make_shared<Message>(message));
+}
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_COUNTED_PUBLISH_H
@@ -0,0 +1,166 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 deadline_pacer.h
+ * @brief	 Paces the simulation loop to absolute deadlines
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_DEADLINE_PACER_H
+#define FLATLAND_SERVER_DEADLINE_PACER_H
+
+#include <flatland_server/step_timer.h>
+#include <cstdint>
+#include <string>
+
+namespace flatland_server {
+
+/**
+ * This class paces a loop at a fixed period to absolute deadlines on the
+ * monotonic clock. Unlike ros::WallRate, which sleeps for a relative duration
+ * computed from the time it is called, the wake up times do not accumulate
+ * the delays of the sleeps, and the last part of the sleep may be spent
+ * spinning on the clock, which wakes up within microseconds of the deadline
+ * at the cost of a busy core. The lateness of every wake up is recorded in a
+ * histogram. The times are in seconds of the monotonic clock
+ */
+class DeadlinePacer {
+ public:
+  /// What happens when the work of a cycle runs past the next deadline
+  enum Overrun {
+    SKIP,   ///< the missed deadlines are dropped, the loop waits for the next
+            /// deadline of the schedule
+    BURST,  ///< the missed cycles run back to back without waiting, up to
+            /// max_burst of them, the older ones are dropped
+    SLIP    ///< the schedule restarts one period after the overrun cycle
+  };
+
+  /**
+   * @brief Get an overrun policy by name, throws Exception if unknown
+   * @param[in] name skip, burst or slip
+   * @return The policy
+   */
+  static Overrun ParseOverrun(const std::string &name);
+
+  /**
+   * @return The name of a policy, see ParseOverrun
+   */
+  static std::string OverrunName(Overrun overrun);
+
+  /**
+   * @return The time of the monotonic clock
+   */
+  static double Now();
+
+  /**
+   * @param[in] period Time between two deadlines, > 0
+   * @param[in] overrun What happens when a cycle misses its deadline
+   * @param[in] spin_tail Time before a deadline spent spinning instead of
+   * sleeping, 0 to only sleep
+   * @param[in] max_burst Most cycles run back to back with BURST, at least 1
+   */
+  DeadlinePacer(double period, Overrun overrun = SKIP, double spin_tail = 0,
+                unsigned int max_burst = 1);
+
+  /**
+   * @brief Restart the schedule, the next deadline is one period from now
+   * @param[in] now The current time
+   */
+  void Reset(double now);
+
+  /**
+   * @brief Advance the schedule at the end of the work of a cycle
+   * @param[in] now The current time
+   * @return The deadline to wait for before the next cycle, not after now if
+   * the next cycle is due already
+   */
+  double NextDeadline(double now);
+
+  /**
+   * @brief Wait for the next deadline on the calling thread, called at the
+   * end of the work of each cycle
+   */
+  void Wait();
+
+  /**
+   * @return The period
+   */
+  double GetPeriod() const { return period_; }
+
+  /**
+   * @return The overrun policy
+   */
+  Overrun GetOverrun() const { return overrun_; }
+
+  /**
+   * @return The time the work of the last cycle took, from the wake up to the
+   * call to Wait
+   */
+  double GetCycleTime() const { return cycle_time_; }
+
+  /**
+   * @return The number of cycles that missed their deadline
+   */
+  uint64_t GetOverrunCount() const { return overruns_; }
+
+  /**
+   * @return How late the wake ups were, since ResetJitter
+   */
+  const TimingHistogram &GetJitter() const { return jitter_; }
+
+  /**
+   * @brief Clear the jitter histogram
+   */
+  void ResetJitter() { jitter_.Reset(); }
+
+ private:
+  double period_;           ///< time between deadlines
+  Overrun overrun_;         ///< overrun policy
+  double spin_tail_;        ///< time spun before each deadline
+  unsigned int max_burst_;  ///< most cycles back to back with BURST
+  double deadline_;         ///< the next deadline of the schedule
+  double wake_;             ///< time of the last wake up
+  double cycle_time_;       ///< see GetCycleTime
+  uint64_t overruns_;       ///< see GetOverrunCount
+  TimingHistogram jitter_;  ///< lateness of the wake ups
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_DEADLINE_PACER_H
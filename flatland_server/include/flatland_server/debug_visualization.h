@@ -51,8 +51,13 @@
 #include <flatland_msgs/DebugTopicList.h>
 #include <ros/ros.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "flatland_server/body.h"
@@ -63,22 +68,162 @@ struct DebugTopic {
   ros::Publisher publisher;
   bool needs_publishing;
   visualization_msgs::MarkerArray markers;
+  int shard;  ///< index in DebugVisualization::shards_ if the topic is
+              /// published on a shard, -1 if on its own publisher
+};
+
+/**
+ * Level of detail of the visualization of a layer, read from the debug
+ * properties of the layer, see DebugVisualization::VisualizeLayer
+ */
+struct LayerVisualization {
+  float min_z = 0;                ///< bottom of the walls in 2.5d
+  float max_z = 1;                ///< top of the walls in 2.5d
+  bool merge_segments = false;    ///< link the edges, merge collinear ones
+  double simplify_tolerance = 0;  ///< Douglas-Peucker tolerance in meters
+  double region_size = 0;  ///< edge length in meters of the regions with a
+                           /// marker each, 0 for a single marker
+  size_t max_bytes = 0;  ///< budget of the points of a topic, 0 for none
+
+  /**
+   * @brief Read the level of detail from the properties of a layer
+   * @param[in] properties The properties, the options are in its debug map
+   */
+  explicit LayerVisualization(const YAML::Node& properties);
+
+  /**
+   * @return true if the edges are merged, simplified, tiled or budgeted
+   */
+  bool ReducesDetail() const;
+};
+
+/// A topic publishing the markers of several model topics, see
+/// DebugVisualization::SetModelsPerTopic
+struct DebugShard {
+  ros::Publisher publisher;
+  bool needs_publishing;
+  std::vector<std::string> topics;  ///< the topics packed into the shard
 };
 
 class DebugVisualization {
  private:
   DebugVisualization();
 
+  /// A marker array snapshot handed to the publisher thread, not modified
+  /// once handed over
+  struct PublishJob {
+    ros::Publisher publisher;
+    visualization_msgs::MarkerArrayPtr markers;
+  };
+
+  static bool headless_;  ///< if visualization is disabled in the process
+  static unsigned int models_per_topic_;  ///< see SetModelsPerTopic
+  static bool async_publishing_;          ///< see SetAsyncPublishing
+  static bool topic_list_deltas_;         ///< see SetTopicListDeltas
+
+  std::map<std::string, PublishJob> pending_;  ///< latest snapshot by topic,
+                                               /// not yet published
+  std::mutex pending_mutex_;                   ///< guards pending_, stopping_
+  std::condition_variable pending_cv_;  ///< signaled when a job is pending
+  std::thread publisher_thread_;        ///< publishes the pending jobs
+  bool stopping_ = false;               ///< if the thread must exit
+
+  /**
+   * @brief Stamp and publish a marker array, or hand a snapshot of it to the
+   * publisher thread when publishing asynchronously. A newer snapshot of a
+   * topic replaces one the thread has not published yet
+   * @param[in] name The name of the topic
+   * @param[in] publisher The publisher of the topic
+   * @param[in] markers The markers, stamped in place
+   * @param[in] stamp The stamp of the markers
+   */
+  void Send(const std::string& name, const ros::Publisher& publisher,
+            visualization_msgs::MarkerArray& markers, const ros::Time& stamp);
+
+  /**
+   * @brief Body of the publisher thread
+   */
+  void PublisherThread();
+
+  std::set<std::string> listed_topics_;  ///< the topics of the list as last
+                                         /// published
+  std::mutex topic_list_mutex_;  ///< guards listed_topics_ and the list
+                                 /// publications, subscribers connect from
+                                 /// the callback threads
+
+  /**
+   * @brief Send the whole topic list to a subscriber that connected, when
+   * publishing deltas
+   * @param[in] publisher The publisher to the subscriber
+   */
+  void SendTopicList(const ros::SingleSubscriberPublisher& publisher);
+
  public:
   std::map<std::string, DebugTopic> topics_;
+  std::vector<DebugShard> shards_;  ///< the shards of the model topics
+  std::vector<std::string> deleted_topics_;  ///< scratch of Publish
   ros::NodeHandle node_;
   ros::Publisher topic_list_publisher_;
+  bool topic_list_dirty_ = false;  ///< if topics were added or deleted since
+                                   /// the topic list was published
 
   /**
    * @brief Return the singleton object
    */
   static DebugVisualization& Get();
 
+  /**
+   * @brief Disable the visualization of the whole process, for headless runs.
+   * No topic is advertised, and Visualize, VisualizeLayer, Reset and Publish
+   * do nothing. Must be called before the first call of Get
+   * @param[in] headless true to disable visualization
+   */
+  static void SetHeadless(bool headless);
+
+  /**
+   * @return true if visualization is disabled, see SetHeadless
+   */
+  static bool IsHeadless();
+
+  /**
+   * @brief Pack the model topics ("model/<name>") into shared "models/<i>"
+   * topics of up to count models each, instead of advertising a topic per
+   * model. Each model keeps its markers ids, with the topic name as the
+   * marker namespace, and a model always stays on the same shard. Must be
+   * called before the first model is visualized
+   * @param[in] count Models per topic, 0 for a topic per model
+   */
+  static void SetModelsPerTopic(unsigned int count);
+
+  /**
+   * @brief Publish the marker arrays on a background thread, so that their
+   * serialization does not stall the simulation loop. Publish then only
+   * stamps and copies the marker arrays that changed. Disabled by default
+   * @param[in] async true to enable
+   */
+  static void SetAsyncPublishing(bool async);
+
+  /**
+   * @brief Publish the changes of the topic list as deltas, the topics
+   * added and removed since the previous message, instead of the whole list.
+   * The topic is then not latched, a subscriber gets the whole list when it
+   * connects. Disabled by default, must be called before the first call of
+   * Get
+   * @param[in] deltas true to enable
+   */
+  static void SetTopicListDeltas(bool deltas);
+
+  /**
+   * @brief Publish the snapshots still pending and stop the publisher
+   * thread, it is started again by the next Publish
+   */
+  void StopPublishing();
+
+  /**
+   * @brief Destructor, stops the publisher thread
+   */
+  ~DebugVisualization();
+
   /**
    * @brief Publish all marker array topics_ that need publishing
    * @param[in] timekeeper The time object to use for header timestamps
@@ -97,6 +242,31 @@ class DebugVisualization {
   void Visualize(std::string name, b2Body* body, float r, float g, float b,
                  float a);
 
+  /**
+   * @brief Visualize body with markers of its own, which are not merged with
+   * the markers before them, so that MoveBody can move them afterwards
+   * @param[in] name    The name of the topic
+   * @param[in] body The body to output
+   * @param[in] r red color 0.0->1.0
+   * @param[in] g green color 0.0->1.0
+   * @param[in] b blue color 0.0->1.0
+   * @param[in] a alpha color 0.0->1.0
+   * @return Number of markers added at the end of the topic
+   */
+  size_t VisualizeMovable(const std::string& name, b2Body* body, float r,
+                          float g, float b, float a);
+
+  /**
+   * @brief Set the pose of the markers added by VisualizeMovable to the
+   * current pose of their body, the points are in the frame of the body
+   * @param[in] name    The name of the topic
+   * @param[in] first Index of the first marker of the body
+   * @param[in] count Number of markers of the body
+   * @param[in] body The body
+   */
+  void MoveBody(const std::string& name, size_t first, size_t count,
+                b2Body* body);
+
   /**
    * @brief Visualize body
    * @param[in] name    The name of the topic
@@ -109,6 +279,13 @@ class DebugVisualization {
   void Visualize(std::string name, b2Joint* joint, float r, float g, float b,
                  float a);
 
+  /**
+   * @brief Visualize the joints of a model with two markers for all of them
+   * @param[in] name The name of the topic
+   * @param[in] states The joints, see Model::GetJointStates
+   */
+  void VisualizeJoints(const std::string& name,
+                       const std::vector<JointState>& states);
   /**
    * @brief Visualize a layer in 2.5d
    * @param[in] name    The name of the topic
@@ -120,12 +297,57 @@ class DebugVisualization {
    */
   void VisualizeLayer(std::string name, Body* body);
 
+  /**
+   * @brief Visualize a layer with a reduced level of detail, in 2d on the
+   * topic name and in 2.5d on the topic name + "_3d"
+   * @param[in] name The name of the 2d topic
+   * @param[in] body The body of the layer
+   * @param[in] lod The level of detail
+   */
+  void VisualizeLayer(const std::string& name, Body* body,
+                      const LayerVisualization& lod);
+
+  /**
+   * @brief Get the edges of the edge and chain fixtures of a layer, merged
+   * and simplified according to a level of detail. When the edges exceed the
+   * byte budget, the tolerance is doubled until they fit
+   * @param[in] body The body of the layer
+   * @param[in] lod The level of detail
+   * @return The edges in the frame of the body
+   */
+  static std::vector<std::pair<b2Vec2, b2Vec2>> LayerEdges(
+      b2Body* body, const LayerVisualization& lod);
+
   /**
    * @brief Remove all elements in a visualization topic
    * @param name
    */
   void Reset(std::string name);
 
+  /**
+   * @brief Remove the last elements of a visualization topic
+   * @param[in] name The name of the topic
+   * @param[in] count Number of markers kept
+   */
+  void Truncate(const std::string& name, size_t count);
+
+  /**
+   * @param[in] name The name of the topic
+   * @return Number of markers of a topic, 0 if it does not exist
+   */
+  size_t MarkerCount(const std::string& name) const;
+
+  /**
+   * @brief Check if the markers of a topic are watched, so that the markers
+   * of the models and layers nobody watches are not built. A topic that does
+   * not exist is advertised without markers, so that it can be discovered
+   * and subscribed to
+   * @param[in] name The name of the topic
+   * @return true if the topic, or the shard it is published on, has
+   * subscribers
+   */
+  bool HasSubscribers(const std::string& name);
+
   /**
    * @brief Append body as a marker on the marker array
    * @param[in] markers The output marker array
@@ -149,15 +371,26 @@ class DebugVisualization {
    */
   void JointToMarkers(visualization_msgs::MarkerArray& markers, b2Joint* joint,
                       float r, float g, float b, float a);
+  /**
+   * @brief Append joints as one LINE_LIST and one CUBE_LIST marker, with the
+   * same lines and cubes as JointToMarkers and the colors given per point
+   * @param[in] markers The output marker array
+   * @param[in] states The joints
+   */
+  void JointsToMarkers(visualization_msgs::MarkerArray& markers,
+                       const std::vector<JointState>& states);
 
   /**
-   * @brief Ensure that a topic name is being broadcasted
+   * @brief Ensure that a topic name is being broadcasted, the topic list is
+   * published by the next Publish
    * @param[in] name Name of the topic
    */
   void AddTopicIfNotExist(const std::string& name);
 
   /**
-   * @brief Publish topics list
+   * @brief Publish topics list if it changed since it was last published,
+   * whole or as a delta, see SetTopicListDeltas. Called by Publish, so a
+   * burst of spawns or deletions publishes one list per cycle
    */
   void PublishTopicList();
 };
@@ -0,0 +1,199 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 extrapolator.h
+ * @brief	 Extrapolates the plugin outputs between physics steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_EXTRAPOLATOR_H
+#define FLATLAND_SERVER_EXTRAPOLATOR_H
+
+#include <Box2D/Box2D.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace flatland_server {
+
+/**
+ * This class runs the tasks of the plugins that publish their outputs
+ * between the physics steps, at a rate of wall time above the physics rate,
+ * e.g. TF and odometry for controllers expecting them at a high rate. The
+ * tasks run on a process wide thread that never steps the worlds, they
+ * extrapolate the last physics state the plugins saved at constant
+ * velocities, see Motion and Clock. The thread is started by the first task
+ */
+class Extrapolator {
+ public:
+  /// A task, called with the wall time, see Now
+  typedef std::function<void(double)> Task;
+
+  /**
+   * The pose and the velocities of a body at a physics step, about the
+   * origin of the body
+   */
+  struct Motion {
+    b2Transform transform;  ///< pose of the origin
+    b2Vec2 linear;          ///< velocity of the origin in the world frame
+    float angular = 0;      ///< angular velocity
+
+    /**
+     * @brief Make the motion of a body from its state
+     * @param[in] transform Pose of the origin of the body
+     * @param[in] center_velocity Velocity of the center of mass, as kept by
+     * Box2D and BodyStates
+     * @param[in] angular Angular velocity
+     * @param[in] local_center Center of mass in the body frame
+     * @return The motion
+     */
+    static Motion Of(const b2Transform &transform,
+                     const b2Vec2 &center_velocity, float angular,
+                     const b2Vec2 &local_center);
+
+    /**
+     * @param[in] dt Time since the physics step, in seconds
+     * @return The pose extrapolated at constant velocities
+     */
+    b2Transform At(double dt) const;
+  };
+
+  /**
+   * The simulation time of the last physics step seen by a plugin,
+   * extrapolated to the wall time with the measured real time factor. The
+   * estimate never runs ahead of the last step by more than the period
+   * between the steps, so a paused or stalled simulation stops the
+   * extrapolation instead of running away
+   */
+  class Clock {
+   public:
+    /**
+     * @brief Record a physics step, a simulation time going back, e.g. after
+     * a reset, restarts the estimate
+     * @param[in] sim_time Simulation time of the step, in seconds
+     * @param[in] wall_time Wall time of the step, see Now
+     */
+    void Step(double sim_time, double wall_time);
+
+    /**
+     * @param[in] wall_time The wall time, see Now
+     * @return The estimated simulation time, the time of the last step until
+     * the period between the steps is known
+     */
+    double Estimate(double wall_time) const;
+
+    /**
+     * @return The simulation time of the last step
+     */
+    double GetTime() const { return time_; }
+
+   private:
+    double time_ = 0;    ///< simulation time of the last step
+    double wall_ = 0;    ///< wall time of the last step, 0 before any step
+    double period_ = 0;  ///< simulation time between the last two steps
+    double factor_ = 0;  ///< smoothed real time factor, 0 before two steps
+  };
+
+  /**
+   * @brief Return the singleton object
+   */
+  static Extrapolator &Get();
+
+  /**
+   * @return The monotonic wall time in seconds
+   */
+  static double Now();
+
+  /**
+   * @brief Run a task periodically
+   * @param[in] rate Rate of the task in Hz of wall time, positive
+   * @param[in] task The task
+   * @return The id of the task for Remove
+   */
+  unsigned int Add(double rate, Task task);
+
+  /**
+   * @brief Stop running a task, waits for the task if it is running, so it
+   * must not be called from a task
+   * @param[in] id The id returned by Add
+   */
+  void Remove(unsigned int id);
+
+  /**
+   * @return The number of tasks
+   */
+  size_t GetTaskCount();
+
+  ~Extrapolator();
+
+ private:
+  /**
+   * A periodic task
+   */
+  struct Entry {
+    double period;  ///< wall time between the runs
+    double next;    ///< wall time of the next run
+    Task task;      ///< the task
+  };
+
+  std::mutex mutex_;              ///< guards the members below
+  std::condition_variable cv_;    ///< signaled when the tasks change
+  std::map<unsigned int, Entry> tasks_;  ///< the tasks by id
+  unsigned int next_id_ = 1;      ///< id of the next task
+  unsigned int running_ = 0;      ///< id of the running task, 0 if none
+  bool stopping_ = false;         ///< if the thread must exit
+  std::thread thread_;            ///< runs the tasks
+
+  /**
+   * @brief Private constructor for the singleton
+   */
+  Extrapolator() = default;
+
+  /**
+   * @brief Body of the thread
+   */
+  void Loop();
+};
+};  // namespace flatland_server
+
+#endif  // FLATLAND_SERVER_EXTRAPOLATOR_H
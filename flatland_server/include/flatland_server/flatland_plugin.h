@@ -48,19 +48,89 @@
 #define FLATLAND_SERVER_FLATLAND_PLUGIN_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/contact_event_queue.h>
+#include <flatland_server/gps_batch.h>
+#include <flatland_server/kinematic_animator.h>
+#include <flatland_server/raster_batch.h>
+#include <flatland_server/sensor_scheduler.h>
+#include <flatland_server/state_exporter.h>
 #include <flatland_server/timekeeper.h>
 #include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
+#include <boost/any.hpp>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace flatland_server {
+
+/**
+ * Wall time spent in the callbacks of a plugin, measured by the plugin
+ * manager when profiling, see PluginManager::SetProfiling
+ */
+struct PluginCost {
+  double before_physics_step = 0;  ///< in BeforePhysicsStep, in seconds
+  double after_physics_step = 0;   ///< in AfterPhysicsStep, in seconds
+  double contact = 0;  ///< in the contact callbacks, in seconds
+  uint64_t calls = 0;  ///< number of callbacks measured
+
+  /**
+   * @return The time spent in all callbacks
+   */
+  double Total() const {
+    return before_physics_step + after_physics_step + contact;
+  }
+
+  /**
+   * @brief Add the costs of another plugin
+   * @param[in] other The other cost
+   */
+  void Add(const PluginCost &other) {
+    before_physics_step += other.before_physics_step;
+    after_physics_step += other.after_physics_step;
+    contact += other.contact;
+    calls += other.calls;
+  }
+};
+
 class FlatlandPlugin {
  public:
   enum class PluginType { Invalid, Model, World };  // Different plugin Types
+
+  /// The contact callbacks, as bits of contact_callbacks_
+  enum ContactCallback : uint8_t {
+    BEGIN_CONTACT = 1,
+    END_CONTACT = 2,
+    PRE_SOLVE = 4,
+    POST_SOLVE = 8,
+    CONTACT_EVENTS = 16,
+    ALL_CONTACT_CALLBACKS = 31
+  };
+
+  /// The step callbacks, as bits of step_callbacks_
+  enum StepCallback : uint8_t {
+    BEFORE_PHYSICS_STEP = 1,
+    AFTER_PHYSICS_STEP = 2,
+    ALL_STEP_CALLBACKS = 3
+  };
+
   std::string type_;                                ///< type of the plugin
   std::string name_;                                ///< name of the plugin
   ros::NodeHandle nh_;                              // ROS node handle
   PluginType plugin_type_;
+  SensorScheduler *sensor_scheduler_ = nullptr;  ///< set by plugin manager
+  const BodyStates *body_states_ = nullptr;      ///< set by plugin manager
+  GpsBatch *gps_batch_ = nullptr;                ///< set by plugin manager
+  RasterBatch *raster_batch_ = nullptr;          ///< set by plugin manager
+  KinematicAnimator *kinematic_animator_ = nullptr;  ///< set by plugin
+                                                     /// manager
+  StateExporter *state_exporter_ = nullptr;      ///< set by plugin manager
+  PluginCost cost_;  ///< accumulated by plugin manager when profiling
+  uint8_t contact_callbacks_ = ALL_CONTACT_CALLBACKS;  ///< the callbacks that
+                                                       /// may be overridden
+  uint8_t step_callbacks_ = ALL_STEP_CALLBACKS;  ///< the step callbacks that
+                                                 /// may be overridden
 
   /*
   * @brief Get PluginType
@@ -77,6 +147,53 @@ class FlatlandPlugin {
   */
   const std::string &GetType() const { return type_; }
 
+  /**
+  * @brief Get the scheduler batching the rays of all sensors on a step
+  * @return The scheduler, nullptr if not loaded by the plugin manager
+  */
+  SensorScheduler *GetSensorScheduler() { return sensor_scheduler_; }
+
+  /**
+  * @brief Get the snapshot of the world the jobs of the sensor scheduler ray
+  * cast against while they are pipelined with the physics step
+  * @return The snapshot, nullptr when the rays are cast on the world
+  */
+  const b2RayCastSnapshot *GetRayCastSnapshot() const {
+    return sensor_scheduler_ ? sensor_scheduler_->GetSnapshot() : nullptr;
+  }
+
+  /**
+  * @brief Get the states of the model bodies as of the last physics step
+  * @return The states, nullptr if not loaded by the plugin manager
+  */
+  const BodyStates *GetBodyStates() const { return body_states_; }
+
+  /**
+  * @brief Get the converter of the fixes of all GPS receivers of the world
+  * @return The converter, nullptr if not loaded by the plugin manager
+  */
+  GpsBatch *GetGpsBatch() const { return gps_batch_; }
+
+  /**
+  * @brief Get the renderer of the top down views of all plugins of the world
+  * @return The renderer, nullptr if not loaded by the plugin manager
+  */
+  RasterBatch *GetRasterBatch() const { return raster_batch_; }
+
+  /**
+  * @brief Get the animator of the bodies moved along paths by plugins
+  * @return The animator, nullptr if not loaded by the plugin manager
+  */
+  KinematicAnimator *GetKinematicAnimator() const {
+    return kinematic_animator_;
+  }
+
+  /**
+  * @brief Get the exporter of the world state to shared memory
+  * @return The exporter, nullptr if the export is disabled
+  */
+  StateExporter *GetStateExporter() const { return state_exporter_; }
+
   /**
  * @brief The method for the particular model plugin to override and provide
  * its own initialization
@@ -85,42 +202,156 @@ class FlatlandPlugin {
   virtual void OnInitialize(const YAML::Node &config) = 0;
 
   /**
-   * @brief This method is called before the Box2D physics step
+   * @brief This method is called before the Box2D physics step. Like the
+   * contact callbacks, the default implementations of the step callbacks
+   * clear their bit of step_callbacks_, so the plugin manager stops calling
+   * them, overrides must not call them
    * @param[in] timekeeper provide time related information
    */
-  virtual void BeforePhysicsStep(const Timekeeper &timekeeper) {}
+  virtual void BeforePhysicsStep(const Timekeeper &timekeeper) {
+    step_callbacks_ &= ~BEFORE_PHYSICS_STEP;
+  }
 
   /**
    * @brief This method is called after the Box2D physics step
    * @param[in] timekeeper provide time related information
    */
-  virtual void AfterPhysicsStep(const Timekeeper &timekeeper) {}
+  virtual void AfterPhysicsStep(const Timekeeper &timekeeper) {
+    step_callbacks_ &= ~AFTER_PHYSICS_STEP;
+  }
 
   /**
-   * @brief A method that is called for all Box2D begin contacts
+   * @brief A method that is called for the Box2D begin contacts of the
+   * model of the plugin, or all of them, see ReceivesAllContacts. The default
+   * implementations of the contact callbacks clear their bit of
+   * contact_callbacks_, so the plugin manager stops calling them, overrides
+   * must not call them
    * @param[in] contact Box2D contact
    */
-  virtual void BeginContact(b2Contact *contact) {}
+  virtual void BeginContact(b2Contact *contact) {
+    contact_callbacks_ &= ~BEGIN_CONTACT;
+  }
 
   /**
-   * @brief A method that is called for all Box2D end contacts
+   * @brief A method that is called for the Box2D end contacts of the model
+   * of the plugin
    * @param[in] contact Box2D contact
    */
-  virtual void EndContact(b2Contact *contact) {}
+  virtual void EndContact(b2Contact *contact) {
+    contact_callbacks_ &= ~END_CONTACT;
+  }
 
   /**
-   * @brief A method that is called for Box2D presolve
+   * @brief A method that is called for Box2D presolve of the contacts of the
+   * model of the plugin
    * @param[in] contact Box2D contact
    * @param[in] oldManifold Manifold from the previous iteration
    */
-  virtual void PreSolve(b2Contact *contact, const b2Manifold *oldManifold) {}
+  virtual void PreSolve(b2Contact *contact, const b2Manifold *oldManifold) {
+    contact_callbacks_ &= ~PRE_SOLVE;
+  }
 
   /**
-   * @brief A method that is called for Box2D postsolve
+   * @brief A method that is called for Box2D postsolve of the contacts of the
+   * model of the plugin
    * @param[in] contact Box2D contact
    * @param[in] impulse Impulse from the collision resolution
    */
-  virtual void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {}
+  virtual void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {
+    contact_callbacks_ &= ~POST_SOLVE;
+  }
+
+  /**
+   * @brief A method that is called after each Box2D step with the begin
+   * contact, end contact and postsolve events of the step for the model of
+   * the plugin, in the order Box2D reported them, when the world records
+   * them, see PluginManager::SetDeferredContacts. Unlike the other contact
+   * callbacks it runs outside of the step, so the plugin may modify the
+   * world, and thread safe plugins are called in parallel per model
+   * @param[in] events The events, the fixtures are valid during the call
+   */
+  virtual void ContactEvents(const std::vector<ContactEvent> &events) {
+    contact_callbacks_ &= ~CONTACT_EVENTS;
+  }
+
+  /**
+   * @brief Plugins return true to have the contact callbacks called for the
+   * contacts of all models and layers. By default, they are only called for
+   * the contacts with a fixture of the model of the plugin
+   * @return If the plugin receives all contacts
+   */
+  virtual bool ReceivesAllContacts() const { return false; }
+
+  /**
+   * @brief Plugins return true if their BeforePhysicsStep,
+   * AfterPhysicsStep and ContactEvents only read the world and write to the bodies of their own
+   * model, so the plugin manager may call them concurrently with the plugins
+   * of other models, see PluginManager::SetNumThreads. ROS publishers and
+   * the sensor scheduler may be used, moving bodies with SetTransform,
+   * creating or destroying bodies and fixtures may not
+   * @return If the plugin is thread safe
+   */
+  virtual bool IsThreadSafe() const { return false; }
+
+  /**
+   * @brief Plugins holding large buffers, e.g. the scans of sensors, return
+   * an estimate of their bytes for the memory report, see MemoryReport
+   * @return The bytes of the buffers of the plugin
+   */
+  virtual size_t GetMemoryUsage() const { return 0; }
+
+  /**
+   * @brief Plugins return true to have BeforePhysicsStep and AfterPhysicsStep
+   * called around each Box2D sub-step when the world is sub-stepped, see the
+   * physics_substep_size world property, with a timekeeper giving the time
+   * and size of the sub-step. The other plugins are called once per step
+   * @return If the plugin is updated per sub-step
+   */
+  virtual bool UpdatesPerSubstep() const { return false; }
+
+  /**
+   * @brief A method that is called by World::Snapshot, plugins keeping state
+   * that affects the simulation return a copy of it
+   * @return The state of the plugin, empty if the plugin has no state
+   */
+  virtual boost::any SaveState() { return boost::any(); }
+
+  /**
+   * @brief A method that is called by World::Restore with the state returned
+   * by SaveState, it is called even if the state is empty so that plugins
+   * can clear transient state such as received commands
+   * @param[in] state The state of the plugin
+   */
+  virtual void RestoreState(const boost::any &state) {}
+
+  /**
+   * @brief A method that is called by World::SaveCheckpoint, plugins with a
+   * state encode it so that it is saved to the checkpoint files, e.g. with a
+   * CheckpointWriter
+   * @param[in] state A state returned by SaveState
+   * @return The encoded state, empty if the state is not saved to the files
+   */
+  virtual std::string EncodeState(const boost::any &state) {
+    return std::string();
+  }
+
+  /**
+   * @brief A method that is called by World::Restore for the states loaded
+   * from a checkpoint file, before RestoreState
+   * @param[in] encoded The state returned by EncodeState
+   * @return The state to restore, as returned by SaveState
+   */
+  virtual boost::any DecodeState(const std::string &encoded) {
+    return boost::any();
+  }
+
+  /**
+   * @brief A method that is called by the StateHasher world plugin after the
+   * steps, plugins drawing random numbers return a digest of the state of
+   * their generators, so that two runs can be checked for determinism
+   * @return The digest, 0 if the plugin has no random generator
+   */
+  virtual uint64_t GetRandomState() const { return 0; }
 
   /**
    * @brief Flatland plugin destructor
@@ -0,0 +1,149 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 flight_recorder.h
+ * @brief	 Keeps the last iterations of the loop to write the ones around a spike
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLATLAND_SERVER_FLIGHT_RECORDER_H
+#define FLATLAND_SERVER_FLIGHT_RECORDER_H
+
+#include <flatland_server/step_timer.h>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class keeps the details of the last iterations of the simulation loop
+ * in a ring, to debug rare step time spikes that the throttled logs and the
+ * step timing histograms average away. When an iteration overruns the
+ * threshold, the window around it, the iterations before and a quarter of
+ * the window after, is written to a Chrome trace file with the spans the
+ * Tracer kept over the same time: phases, plugins and sensor jobs. The
+ * windows written never overlap. Not thread safe, the iterations are added
+ * from the thread of the loop
+ */
+class FlightRecorder {
+ public:
+  /**
+   * The details of one iteration of the loop
+   */
+  struct Step {
+    uint64_t step = 0;          ///< steps of the world after the iteration
+    unsigned int steps = 1;     ///< steps run in the iteration
+    uint64_t start = 0;         ///< from Tracer::Now
+    uint64_t duration = 0;      ///< work in ns, without the time slept
+    std::array<double, StepTimer::STAGE_COUNT> stages{};  ///< time of each
+                                                          /// stage in s
+    int contacts = 0;           ///< contacts of the physics world
+    int islands = 0;            ///< islands solved in the last step
+    int island_bodies = 0;      ///< bodies of the islands solved
+    int pairs = 0;              ///< new pairs found by the broad phase
+    int toi_events = 0;         ///< TOI events of the last step
+    unsigned int sensor_tasks = 0;  ///< sensor tasks still queued
+  };
+
+  /**
+   * @param[in] threshold Wall time in seconds a step may take, the
+   * iterations with a longer mean step time are overruns
+   * @param[in] window Number of iterations kept and written
+   * @param[in] directory Directory of the files, the working directory if
+   * empty
+   * @param[in] max_dumps Number of files written at most
+   */
+  FlightRecorder(double threshold, size_t window,
+                 const std::string &directory = "", size_t max_dumps = 10);
+
+  /**
+   * @brief Add an iteration
+   * @param[in] step The details of the iteration
+   * @return true once the window around an overrun is complete, Dump should
+   * be called
+   */
+  bool Add(const Step &step);
+
+  /**
+   * @brief Write the window kept as Chrome trace events, the iterations on
+   * a track of their own, followed by the spans of the Tracer
+   * @param[in] out The stream to write to
+   * @return The number of iterations written
+   */
+  size_t WriteChromeTrace(std::ostream &out) const;
+
+  /**
+   * @brief Write the window kept to a file named after the overrun step,
+   * throws Exception on failure
+   * @return The path of the file
+   */
+  std::string Dump();
+
+  /**
+   * @return The number of overruns, including the ones not written
+   */
+  uint64_t GetOverrunCount() const { return overruns_; }
+
+  /**
+   * @return The number of files written
+   */
+  size_t GetDumpCount() const { return dumps_; }
+
+ private:
+  double threshold_;         ///< wall time a step may take
+  std::string directory_;    ///< directory of the files
+  size_t max_dumps_;         ///< files written at most
+  std::vector<Step> ring_;   ///< last iterations
+  uint64_t count_;           ///< iterations added
+  uint64_t overruns_;        ///< overrunning iterations added
+  size_t dumps_;             ///< files written
+  size_t pending_;           ///< iterations to add until the window of the
+                             /// overrun is complete, 0 if none
+  uint64_t overrun_step_;    ///< step of the overrun being recorded
+  uint64_t next_trigger_;    ///< count_ from which an overrun triggers a dump
+};
+};  // namespace flatland_server
+
+#endif  // FLATLAND_SERVER_FLIGHT_RECORDER_H
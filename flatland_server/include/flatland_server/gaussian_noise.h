@@ -0,0 +1,128 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gaussian_noise.h
+ * @brief	 Counter based bulk gaussian noise generator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_GAUSSIAN_NOISE_H
+#define FLATLAND_SERVER_GAUSSIAN_NOISE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flatland_server {
+
+/**
+ * This class generates gaussian noise in bulk. It uses the counter based
+ * Philox4x32-10 generator with a Box-Muller transform, the values are computed
+ * in fixed size blocks with plain loops over arrays so that the compiler can
+ * vectorize them. The n-th value of the stream only depends on the seed, so
+ * a given seed always produces the same noise regardless of how it is drawn
+ */
+class GaussianNoise {
+ public:
+  static const unsigned int BLOCK_SIZE = 64;  ///< values generated at once
+
+  /**
+   * @brief Constructor for the noise generator
+   * @param[in] std_dev Standard deviation of the noise
+   * @param[in] seed Seed of the random stream
+   */
+  explicit GaussianNoise(double std_dev = 0, uint64_t seed = 0);
+
+  /**
+   * @brief Restart the random stream with a new seed
+   * @param[in] seed The seed
+   */
+  void Seed(uint64_t seed);
+
+  /**
+   * @param[in] std_dev Standard deviation of the noise
+   */
+  void SetStdDev(double std_dev) { std_dev_ = std_dev; }
+
+  /**
+   * @return Standard deviation of the noise
+   */
+  double GetStdDev() const { return std_dev_; }
+
+  /**
+   * @brief Write n noise values to out
+   * @param[out] out Buffer of at least n values
+   * @param[in] n Number of values
+   */
+  void Fill(float *out, size_t n);
+
+  /**
+   * @brief Add noise to n values, does nothing if the std deviation is zero
+   * @param[in/out] data Buffer of at least n values
+   * @param[in] n Number of values
+   */
+  void Add(float *data, size_t n);
+
+  /**
+   * @return The next noise value
+   */
+  float Next();
+
+  /**
+   * @return A digest of the position in the random stream, equal for two
+   * generators with the same seed that handed out the same number of values
+   */
+  uint64_t GetState() const;
+
+ private:
+  uint32_t key_[2];           ///< Philox key derived from the seed
+  uint64_t counter_;          ///< counter of the next block
+  double std_dev_;            ///< standard deviation
+  float buffer_[BLOCK_SIZE];  ///< values of the current block
+  unsigned int used_;         ///< values of the block already handed out
+
+  /**
+   * @brief Generate one block of unit gaussian values and advance the counter
+   * @param[out] out Buffer of BLOCK_SIZE values
+   */
+  void GenerateBlock(float *out);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_GAUSSIAN_NOISE_H
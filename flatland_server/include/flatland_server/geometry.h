@@ -48,6 +48,8 @@
 #define FLATLAND_SERVER_GEOMETRY_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/types.h>
+#include <vector>
 
 namespace flatland_server {
 
@@ -86,6 +88,99 @@ class Geometry {
    * @return Inverse transformed point
    */
   static b2Vec2 InverseTransform(const b2Vec2& in, const RotateTranslate& rt);
+
+  /**
+   * @brief Get the inverse of a transformation
+   * @param[in] rt The transformation
+   * @return The transformation undoing rt
+   */
+  static RotateTranslate Inverse(const RotateTranslate& rt);
+
+  /**
+   * @brief Transform an array of points, vectorized with SSE2 or NEON when
+   * available. The points are computed in single precision
+   * @param[in] rt Defined transformation
+   * @param[in] in The points
+   * @param[in] count Number of points
+   * @param[out] out The transformed points, may be in
+   */
+  static void TransformPoints(const RotateTranslate& rt, const b2Vec2* in,
+                              size_t count, b2Vec2* out);
+
+  /**
+   * @brief Inverse transform an array of points, see TransformPoints
+   * @param[in] rt Defined transformation
+   * @param[in] in The points
+   * @param[in] count Number of points
+   * @param[out] out The inverse transformed points, may be in
+   */
+  static void InverseTransformPoints(const RotateTranslate& rt,
+                                     const b2Vec2* in, size_t count,
+                                     b2Vec2* out);
+
+  /**
+   * @brief Transform points stored as separate arrays of coordinates, which
+   * is faster to vectorize than arrays of b2Vec2, see TransformPoints
+   * @param[in] rt Defined transformation
+   * @param[in] x The x coordinates of the points
+   * @param[in] y The y coordinates of the points
+   * @param[in] count Number of points
+   * @param[out] out_x The x coordinates of the transformed points, may be x
+   * @param[out] out_y The y coordinates of the transformed points, may be y
+   */
+  static void TransformPoints(const RotateTranslate& rt, const float* x,
+                              const float* y, size_t count, float* out_x,
+                              float* out_y);
+
+  /**
+   * @brief Link line segments sharing end points into polylines. Segments
+   * forming a cycle give a closed polyline, whose first vertex is not
+   * repeated at the end, the others give open polylines. At an end point
+   * shared by more than two segments, the segments are linked in pairs
+   * @param[in] segments The line segments, end points are compared exactly
+   * @param[out] closed Closed polylines
+   * @param[out] open Open polylines
+   */
+  static void LinkSegments(const std::vector<LineSegment>& segments,
+                           std::vector<std::vector<b2Vec2>>* closed,
+                           std::vector<std::vector<b2Vec2>>* open);
+
+  /**
+   * @brief Simplify a polyline with the Douglas-Peucker algorithm, vertices
+   * within the tolerance of the simplified polyline are removed, a tolerance
+   * of zero only removes collinear vertices
+   * @param[in] polyline The polyline
+   * @param[in] tolerance Max distance of the removed vertices to the result
+   * @param[in] closed If the polyline is a closed loop
+   * @return The simplified polyline
+   */
+  static std::vector<b2Vec2> SimplifyPolyline(
+      const std::vector<b2Vec2>& polyline, double tolerance, bool closed);
+
+  /**
+   * @brief Check if a polygon is convex, collinear vertices are allowed
+   * @param[in] polygon The vertices in either winding order
+   * @return true if convex
+   */
+  static bool IsConvex(const std::vector<b2Vec2>& polygon);
+
+  /**
+   * @brief Decompose a simple polygon, possibly concave, into convex pieces
+   * of at most max_vertices vertices each. The polygon is triangulated by ear
+   * clipping, and the triangles are merged across their diagonals as long as
+   * the pieces stay convex and small enough (Hertel-Mehlhorn), which gives at
+   * most four times the minimal number of pieces
+   * @param[in] polygon The vertices in either winding order, without
+   * repeating the first one at the end
+   * @param[in] max_vertices Maximum number of vertices of a piece, not
+   * counting collinear ones, at least 3
+   * @param[out] pieces The convex pieces, counterclockwise, without collinear
+   * vertices
+   * @return false if the polygon is degenerate or intersects itself
+   */
+  static bool DecomposePolygon(const std::vector<b2Vec2>& polygon,
+                               int max_vertices,
+                               std::vector<std::vector<b2Vec2>>* pieces);
 };
 
 };      // namespace flatland_server
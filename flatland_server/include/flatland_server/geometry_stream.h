@@ -0,0 +1,138 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 geometry_stream.h
+ * @brief	 Publishes the outlines and poses of the bodies as packed arrays
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_GEOMETRY_STREAM_H
+#define FLATLAND_SERVER_GEOMETRY_STREAM_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_msgs/BodyPoses.h>
+#include <flatland_msgs/WorldGeometry.h>
+#include <flatland_server/types.h>
+#include <ros/ros.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+class World;
+
+/**
+ * This class publishes a compact binary alternative to the debug markers of
+ * a world, for viewers on slow links: the outlines of the layers and model
+ * bodies as packed line segments, latched on the geometry topic whenever they
+ * change, and the poses of the model bodies as one packed array on the
+ * body_poses topic at a fixed rate of simulation time. A 500 robot world then
+ * streams 6 kB of poses per message instead of the marker arrays of every
+ * model. The flatland_viz/Geometry rviz display renders both topics
+ */
+class GeometryStream {
+ public:
+  /// Number of segments approximating a circle
+  static const int CIRCLE_SEGMENTS = 16;
+
+  /**
+   * @brief Constructor, advertises the topics
+   * @param[in] world The world, must outlive the stream
+   * @param[in] rate Rate of the poses in Hz of simulation time
+   */
+  GeometryStream(World *world, double rate);
+
+  /**
+   * @brief Publish the geometry if it changed, and the poses if they are due
+   * and have subscribers, called by World::Update after each step
+   * @param[in] time Simulation time after the step
+   */
+  void AfterStep(const ros::Time &time);
+
+  /**
+   * @brief Append the outline of the fixtures of a Box2D body as segments,
+   * circles are approximated with CIRCLE_SEGMENTS segments
+   * @param[in] body The body
+   * @param[in] transform Transform applied to the segments, identity to keep
+   * them in the frame of the body
+   * @param[out] segments x1, y1, x2, y2 of each segment are appended
+   */
+  static void AppendOutline(const b2Body *body, const b2Transform &transform,
+                            std::vector<float> *segments);
+
+  /**
+   * @brief Append a body to a geometry message
+   * @param[in] name The name of the body
+   * @param[in] color The color of the body
+   * @param[in] msg The message, its segments must already be appended
+   */
+  static void AppendBody(const std::string &name, const Color &color,
+                         flatland_msgs::WorldGeometry *msg);
+
+ private:
+  World *world_;             ///< the world
+  double period_;            ///< seconds of simulation time between poses
+  double next_time_ = 0;     ///< simulation time of the next poses
+  uint64_t signature_ = 0;   ///< changes of the geometry published last
+  bool published_ = false;   ///< if the geometry was published once
+  std::vector<const Body *> bodies_;  ///< the moving bodies, in the order of
+                                      /// the message
+  flatland_msgs::WorldGeometry geometry_;  ///< the geometry published last
+  flatland_msgs::BodyPoses poses_;         ///< reused between messages
+  ros::Publisher geometry_publisher_;      ///< publishes geometry, latched
+  ros::Publisher poses_publisher_;         ///< publishes body_poses
+
+  /**
+   * @return A number that changes whenever bodies are added or removed, or
+   * the fixtures of the layers or models change
+   */
+  uint64_t Signature() const;
+
+  /**
+   * @brief Rebuild the geometry message from the layers and models
+   * @param[in] time Stamp of the message
+   */
+  void Rebuild(const ros::Time &time);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_GEOMETRY_STREAM_H
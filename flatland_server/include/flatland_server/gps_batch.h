@@ -0,0 +1,170 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gps_batch.h
+ * @brief	 Converts the positions of all GPS receivers of a world at once
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_GPS_BATCH_H
+#define FLATLAND_SERVER_GPS_BATCH_H
+
+#include <Box2D/Box2D.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+class BodyStates;
+
+/**
+ * The terms of the reference latitude and longitude of a GPS receiver, that
+ * is the geodetic coordinates of (0, 0) in the map frame, computed once
+ */
+struct GpsReference {
+  double sin_lat = 0;  ///< sine of the reference latitude
+  double cos_lat = 1;  ///< cosine of the reference latitude
+  double sin_lon = 0;  ///< sine of the reference longitude
+  double cos_lon = 1;  ///< cosine of the reference longitude
+  double ecef_x = 0;   ///< ECEF coordinates of the reference at zero altitude
+  double ecef_y = 0;   ///< ECEF coordinates of the reference at zero altitude
+  double ecef_z = 0;   ///< ECEF coordinates of the reference at zero altitude
+
+  GpsReference() = default;
+
+  /**
+   * @param[in] lat_rad Reference latitude in radians
+   * @param[in] lon_rad Reference longitude in radians
+   */
+  GpsReference(double lat_rad, double lon_rad);
+};
+
+/**
+ * This class converts the map positions of all GPS receivers of a world to
+ * latitudes and longitudes in one pass over arrays, instead of one plugin
+ * at a time. The pass runs on the first Get after the body states were
+ * refreshed, so the receivers due on a step share one pass and no pass runs
+ * on the steps without fixes
+ */
+class GpsBatch {
+ public:
+  static const double WGS84_A;   ///< Earth's major axis length
+  static const double WGS84_E2;  ///< Square of Earth's first eccentricity
+
+  /// A fix in degrees, at zero altitude
+  struct Fix {
+    double latitude = 0;
+    double longitude = 0;
+  };
+
+  /**
+   * @brief Set the body states the positions are read from, set by the
+   * plugin manager
+   * @param[in] states The body states
+   */
+  void SetBodyStates(const BodyStates *states) { states_ = states; }
+
+  /**
+   * @brief Add a receiver
+   * @param[in] body Body the receiver is mounted on
+   * @param[in] offset Position of the receiver in the frame of the body
+   * @param[in] reference Reference of the receiver
+   * @return Id of the receiver
+   */
+  int Add(const Body *body, const b2Vec2 &offset,
+          const GpsReference &reference);
+
+  /**
+   * @brief Remove a receiver, its id may be reused by the next Add
+   * @param[in] id Id of the receiver, nothing happens for -1
+   */
+  void Remove(int id);
+
+  /**
+   * @brief Get the fix of a receiver as of the last refresh of the body
+   * states, converting all receivers if they were refreshed since the last
+   * conversion. May be called from several threads
+   * @param[in] id Id of the receiver
+   * @return The fix
+   */
+  Fix Get(int id);
+
+  /**
+   * @return The number of receivers
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * @brief Convert map positions to latitudes and longitudes, all of the same
+   * reference or each with its own reference. The loop over the points
+   * does not branch, so that the compiler can vectorize it
+   * @param[in] count Number of points
+   * @param[in] x Map x of the points
+   * @param[in] y Map y of the points
+   * @param[in] references References of the points, count of them
+   * @param[out] latitudes Latitudes in degrees, count of them
+   * @param[out] longitudes Longitudes in degrees, count of them
+   */
+  static void Convert(size_t count, const double *x, const double *y,
+                      const GpsReference *references, double *latitudes,
+                      double *longitudes);
+
+ private:
+  const BodyStates *states_ = nullptr;  ///< see SetBodyStates
+
+  std::mutex mutex_;  ///< guards all members below
+  std::vector<const Body *> bodies_;       ///< by id, null if removed
+  std::vector<b2Vec2> offsets_;            ///< by id
+  std::vector<GpsReference> references_;   ///< by id
+  std::vector<double> x_;                  ///< map x of the last pass, by id
+  std::vector<double> y_;                  ///< map y of the last pass, by id
+  std::vector<double> latitudes_;          ///< of the last pass, by id
+  std::vector<double> longitudes_;         ///< of the last pass, by id
+  std::vector<int> free_;                  ///< removed ids
+  size_t size_ = 0;                        ///< number of receivers
+  uint64_t converted_ = UINT64_MAX;  ///< BodyStates::refreshes_ of the last
+                                     /// pass
+  bool changed_ = false;  ///< if receivers were added since the last pass
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_GPS_BATCH_H
@@ -0,0 +1,174 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gpu_raycaster.h
+ * @brief	 Casts batches of rays on a GPU with OpenCL
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_GPU_RAYCASTER_H
+#define FLATLAND_SERVER_GPU_RAYCASTER_H
+
+#include <Box2D/Box2D.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class casts batches of rays against the fixtures of a world on a GPU,
+ * with OpenCL. The fixtures of the static bodies are uploaded as segments
+ * once, and again only when the layers or the number of proxies change, the
+ * fixtures of the other bodies are uploaded before each batch. Every ray is
+ * tested against every segment and circle by one work item, which pays off
+ * over the Box2D tree for thousands of rays per step.
+ *
+ * Polygons are cast as their edges, so rays starting inside a polygon hit it
+ * on the way out, unlike with Box2D. Sensor fixtures are never hit.
+ *
+ * Only available when flatland_server is built with -DGPU_RAYCAST=ON, Create
+ * returns nullptr otherwise
+ */
+class GpuRaycaster {
+ public:
+  /**
+   * A ray, hitting the fixtures with one of the mask bits
+   */
+  struct Ray {
+    b2Vec2 p1;        ///< start of the ray
+    b2Vec2 p2;        ///< end of the ray
+    uint32 maskBits;  ///< category bits of the fixtures hit
+  };
+
+  /**
+   * The nearest hit of a ray
+   */
+  struct Hit {
+    float fraction;       ///< fraction of the ray at the hit, 1 if no hit
+    uint32 categoryBits;  ///< category bits of the fixture hit, 0 if no hit
+  };
+
+  /**
+   * @brief Set up the first GPU found for ray casting
+   * @param[in] world The world to cast rays against
+   * @return The raycaster, nullptr if there is no GPU or flatland_server is
+   * built without GPU_RAYCAST
+   */
+  static std::unique_ptr<GpuRaycaster> Create(b2World *world);
+
+  /**
+   * @brief Destructor, releases the device
+   */
+  ~GpuRaycaster();
+
+  /**
+   * @brief Cast rays against the world as it is now, must not be called
+   * while the world is stepped
+   * @param[in] rays The rays
+   * @param[in] count The number of rays
+   * @param[out] hits The nearest hit of each ray
+   * @return false if the device failed, the hits are then undefined
+   */
+  bool Cast(const Ray *rays, unsigned int count, Hit *hits);
+
+  /**
+   * @return The name of the device
+   */
+  const std::string &GetDeviceName() const { return device_name_; }
+
+  /**
+   * @return Number of segments of the static bodies on the device
+   */
+  unsigned int GetStaticSegmentCount() const { return static_bits_.size(); }
+
+ private:
+  struct Device;  ///< OpenCL objects, kept out of the header
+
+  /**
+   * @brief Constructor, see Create
+   */
+  GpuRaycaster(b2World *world, std::unique_ptr<Device> device);
+
+  /**
+   * @brief Add the shape of a fixture in world coordinates
+   * @param[in] fixture The fixture
+   * @param[in] xf The transform of its body
+   * @param[out] segments Segments as x1, y1, x2, y2
+   * @param[out] segment_bits Category bits of the segments
+   * @param[out] circles Circles as x, y, radius, 0
+   * @param[out] circle_bits Category bits of the circles
+   */
+  static void AddFixture(const b2Fixture *fixture, const b2Transform &xf,
+                         std::vector<float> *segments,
+                         std::vector<uint32> *segment_bits,
+                         std::vector<float> *circles,
+                         std::vector<uint32> *circle_bits);
+
+  /**
+   * @brief Gather the fixtures of the static bodies if they changed, then the
+   * fixtures of the other bodies
+   * @return true if the static fixtures were gathered again
+   */
+  bool GatherFixtures();
+
+  b2World *world_;                  ///< world the rays are cast against
+  std::unique_ptr<Device> device_;  ///< the GPU
+  std::string device_name_;         ///< see GetDeviceName
+  uint64_t layer_generation_;  ///< Layer::GetGeometryGeneration when the
+                               /// static fixtures were gathered
+  int32 proxy_count_ = -1;  ///< proxies of the world at that time, changes
+                            /// when tiles are swapped or models spawned
+  std::vector<float> static_segments_;   ///< see AddFixture
+  std::vector<uint32> static_bits_;      ///< see AddFixture
+  std::vector<float> static_circles_;    ///< see AddFixture
+  std::vector<uint32> static_circle_bits_;  ///< see AddFixture
+  std::vector<float> dynamic_segments_;  ///< see AddFixture
+  std::vector<uint32> dynamic_bits_;     ///< see AddFixture
+  std::vector<float> circles_;  ///< circles of all bodies, see AddFixture
+  std::vector<uint32> circle_bits_;      ///< see AddFixture
+  std::vector<float> ray_data_;          ///< rays as x1, y1, x2, y2
+  std::vector<uint32> ray_masks_;        ///< mask bits of the rays
+  std::vector<float> fractions_;         ///< fractions read back
+  std::vector<uint32> hit_bits_;         ///< category bits read back
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_GPU_RAYCASTER_H
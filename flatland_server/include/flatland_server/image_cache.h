@@ -0,0 +1,149 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_cache.h
+ * @brief	Process wide cache of the decoded map images
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_IMAGE_CACHE_H
+#define FLATLAND_SERVER_IMAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <unordered_map>
+
+namespace flatland_server {
+
+/**
+ * This class keeps the map images decoded by the layers, as 8 bit greyscale
+ * images, so that layers thresholding the same image differently, and the
+ * worlds of a process loading the same map, decode it only once. The images
+ * are keyed on their path, and reloaded when the modification time or the
+ * size of the file change. The least recently used images are dropped once
+ * their total size exceeds the capacity. Thread safe
+ */
+class ImageCache {
+ public:
+  /// The counters of the cache
+  struct Stats {
+    uint64_t hits = 0;    ///< loads served from the cache
+    uint64_t misses = 0;  ///< loads that decoded the image
+    size_t images = 0;    ///< images in the cache
+    size_t bytes = 0;     ///< pixel bytes of the images in the cache
+  };
+
+  /// Default capacity in bytes
+  static const size_t DEFAULT_CAPACITY = size_t(256) << 20;
+
+  /**
+   * @brief Return the singleton object
+   */
+  static ImageCache &Get();
+
+  /**
+   * @brief Return the decoded image of a file
+   * @param[in] path Path to the image
+   * @return The image as 8 bit greyscale, shared with the other users of the
+   * file, nullptr if the file cannot be read or decoded
+   */
+  std::shared_ptr<const cv::Mat> Load(const std::string &path);
+
+  /**
+   * @brief Set the total size of the images kept in the cache, the least
+   * recently used ones are dropped beyond it. An image larger than the
+   * capacity is decoded but not kept. Images still in use elsewhere stay
+   * alive until their last user releases them
+   * @param[in] bytes The capacity in bytes, 0 disables the cache
+   */
+  void SetCapacity(size_t bytes);
+
+  /**
+   * @return The capacity in bytes, see SetCapacity
+   */
+  size_t GetCapacity() const;
+
+  /**
+   * @brief Drop all images, the counters are kept
+   */
+  void Clear();
+
+  /**
+   * @return The counters of the cache
+   */
+  Stats GetStats() const;
+
+ private:
+  /// An image in the cache
+  struct Entry {
+    int64_t mtime_ns;  ///< modification time of the file, in nanoseconds
+    int64_t size;      ///< size of the file
+    std::shared_ptr<const cv::Mat> image;  ///< the decoded image
+    std::list<std::string>::iterator lru;  ///< position in lru_
+  };
+
+  ImageCache() = default;
+
+  /**
+   * @brief Drop the least recently used images until the total size fits in
+   * the capacity, must be called with mutex_ held
+   */
+  void Evict();
+
+  /**
+   * @brief Remove an image, must be called with mutex_ held
+   * @param[in] it The image
+   */
+  void Erase(std::unordered_map<std::string, Entry>::iterator it);
+
+  mutable std::mutex mutex_;  ///< guards the members below
+  std::unordered_map<std::string, Entry> entries_;  ///< by path
+  std::list<std::string> lru_;  ///< paths, most recently used first
+  size_t capacity_ = DEFAULT_CAPACITY;  ///< see SetCapacity
+  Stats stats_;                         ///< see GetStats
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_IMAGE_CACHE_H
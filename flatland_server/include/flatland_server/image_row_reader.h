@@ -0,0 +1,159 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_row_reader.h
+ * @brief	 Decodes map images row by row
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLATLAND_SERVER_IMAGE_ROW_READER_H
+#define FLATLAND_SERVER_IMAGE_ROW_READER_H
+
+#include <zlib.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class decodes a map image row by row, top to bottom, as 8 bit
+ * greyscale, so that the memory used does not depend on the size of the
+ * image. Only the formats whose rows can be read without converting colors
+ * are supported, which are the usual formats of large maps: greyscale non
+ * interlaced PNG of 1, 2, 4 or 8 bits, and binary PGM with a maximum value
+ * of 255. The pixels are the same as cv::imread in greyscale. Other images
+ * must be decoded whole
+ */
+class ImageRowReader {
+ public:
+  ImageRowReader() = default;
+  ~ImageRowReader();
+  ImageRowReader(const ImageRowReader &) = delete;
+  ImageRowReader &operator=(const ImageRowReader &) = delete;
+
+  /**
+   * @brief Open an image and read its header
+   * @param[in] path Path to the image
+   * @return false if the file cannot be opened or its format is not
+   * supported, it must then be decoded whole
+   */
+  bool Open(const std::string &path);
+
+  /**
+   * @brief Read the next row, throws exception if the image is truncated or
+   * corrupted
+   * @param[out] row The pixels of the row, GetCols of them
+   */
+  void ReadRow(uint8_t *row);
+
+  /**
+   * @return The width of the image in pixels
+   */
+  int GetCols() const { return cols_; }
+
+  /**
+   * @return The height of the image in pixels
+   */
+  int GetRows() const { return rows_; }
+
+ private:
+  std::string path_;     ///< path of the image
+  std::ifstream file_;   ///< the image file
+  int cols_ = 0;         ///< width of the image
+  int rows_ = 0;         ///< height of the image
+  int row_ = 0;          ///< index of the next row
+  bool png_ = false;     ///< if the image is a PNG, otherwise a PGM
+  int bit_depth_ = 8;    ///< bits per pixel of the PNG
+  z_stream zstream_;     ///< inflates the PNG pixels
+  bool inflating_ = false;            ///< if zstream_ is initialized
+  uint32_t chunk_left_ = 0;           ///< bytes left in the current IDAT
+  std::vector<uint8_t> input_;        ///< compressed bytes read from file_
+  std::vector<uint8_t> filtered_;     ///< filter type and bytes of a row
+  std::vector<uint8_t> previous_;     ///< unfiltered bytes of the previous row
+  std::vector<uint8_t> current_;      ///< unfiltered bytes of the row
+  uint32_t crc_ = 0;  ///< CRC of the current chunk so far
+
+  /**
+   * @brief Read the header of a PNG after its signature
+   * @return false if the PNG is not supported
+   */
+  bool OpenPng();
+
+  /**
+   * @brief Read the header of a PGM after its magic
+   * @return false if the PGM is not supported
+   */
+  bool OpenPgm();
+
+  /**
+   * @brief Read the next PNG row into current_
+   */
+  void ReadPngRow();
+
+  /**
+   * @brief Refill input_ from the IDAT chunks
+   * @return false at the end of the image data
+   */
+  bool ReadPngData();
+
+  /**
+   * @brief Read the header of the next PNG chunk, and start its CRC
+   * @param[out] type The type of the chunk
+   * @return The length of the chunk
+   */
+  uint32_t ReadChunkHeader(std::string *type);
+
+  /**
+   * @brief Read the CRC at the end of a PNG chunk and check it
+   */
+  void CheckChunkCrc();
+
+  /**
+   * @brief Throw an exception for a corrupted image
+   * @param[in] what What is wrong
+   */
+  void Fail(const std::string &what) const;
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_IMAGE_ROW_READER_H
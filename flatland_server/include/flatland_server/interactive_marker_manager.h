@@ -8,19 +8,23 @@
 #include <interactive_markers/interactive_marker_server.h>
 #include <interactive_markers/menu_handler.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace flatland_server {
 
+class World;
+
 class InteractiveMarkerManager {
  public:
   /**
    * @brief Constructor for the interactive marker manager class
-   * @param[in] model_list_ptr Pointer to the list of models in the World class
-   * @param[in] plugin_manager_ptr Pointer to the plugin manager in the World
-   * class
+   * @param[in] world The world of the models, which are moved and deleted
+   * through it
+   * @param[in] ns Namespace of the marker server topics
    */
-  InteractiveMarkerManager(std::vector<Model*>* model_list_ptr,
-                           PluginManager* plugin_manager_ptr);
+  InteractiveMarkerManager(World* world, const std::string& ns = "");
 
   /**
    * @brief Destructor for the interactive marker manager class
@@ -28,14 +32,12 @@ class InteractiveMarkerManager {
   ~InteractiveMarkerManager();
 
   /**
-   * @brief Add a new interactive marker when spawning a model
-   * @param[in] model_name Name of the model being spawned
-   * @param[in] pose Initial pose of the spawning model
-   * @param[in] body_markers Marker array corresponding to new model bodies
+   * @brief Add a new interactive marker when spawning a model. The marker is
+   * only created while the marker server has subscribers, otherwise it is
+   * created by update once one subscribes
+   * @param[in] model The model being spawned
    */
-  void createInteractiveMarker(
-      const std::string& model_name, const Pose& pose,
-      const visualization_msgs::MarkerArray& body_markers);
+  void createInteractiveMarker(Model* model);
 
   /**
    * @brief Remove interactive marker corresponding to a given model when
@@ -46,29 +48,78 @@ class InteractiveMarkerManager {
 
   /**
    * @brief Update the interactive marker poses after running
-   * physics update to synchronize the markers with the models
+   * physics update to synchronize the markers with the models. Only the
+   * markers of the models that moved are updated, and the changes are
+   * published at most at the update rate. At the same rate, the markers of
+   * all the models are created when the marker server gets its first
+   * subscriber, and removed when the last one leaves
    */
   void update();
 
+  /**
+   * @brief Set the rate at which the marker poses are published, in wall
+   * clock time and independent of the physics rate
+   * @param[in] rate The rate in Hz, 0 publishes on every update
+   */
+  void setUpdateRate(double rate);
+
   bool isManipulating() { return manipulating_model_; }
 
+  /**
+   * @return If the markers of the models exist, i.e. the marker server had
+   * subscribers at the last update
+   */
+  bool isActive() const { return active_; }
+
  private:
   interactive_markers::MenuHandler
       menu_handler_;  ///< Handler for the interactive marker context menus
   boost::shared_ptr<interactive_markers::InteractiveMarkerServer>
       interactive_marker_server_;  ///< Interactive marker server
+  World* world_;  ///< the world of the models
   std::vector<Model*>*
       models_;  ///< Pointer to the model list in the World class
-  PluginManager*
-      plugin_manager_;  ///< Pointer to the plugin manager in the World class
   bool manipulating_model_;  ///< Boolean flag indicating if the user is
   /// manipulating a model with its interactive marker
+  std::unordered_map<std::string, Pose>
+      marker_poses_;  ///< last pose sent for the marker of each model
+  std::unordered_map<std::string, std::vector<visualization_msgs::Marker>>
+      body_markers_;  ///< markers of the bodies in the frame of the root
+                      /// body, by model file, shared by its models
+  std::string update_topic_;  ///< resolved update topic of the server, its
+                              /// subscribers are counted
+  bool active_;  ///< if the markers exist, see isActive
+  double update_period_;         ///< min wall time between updates, seconds
+  ros::WallTime last_update_;    ///< wall time of the last update
   ros::WallTime pose_update_stamp_;  ///< Timestamp of the last received pose
   /// update feedback. Used to handle when the
   /// interactive marker server stops
   /// manipulating without triggering a
   /// MOUSE_UP event.
 
+  /**
+   * @brief Insert the interactive marker of a model in the server, without
+   * applying the changes
+   * @param[in] model The model
+   */
+  void insertInteractiveMarker(Model* model);
+
+  /**
+   * @brief Get the markers of the bodies of a model in the frame of its root
+   * body, computed once per model file unless the geometry of the model
+   * changed since it was loaded
+   * @param[in] model The model
+   * @param[out] markers The markers
+   */
+  void getBodyMarkers(Model* model,
+                      std::vector<visualization_msgs::Marker>& markers);
+
+  /**
+   * @brief Create the markers of all the models when the server gets its
+   * first subscriber, remove them when the last one leaves
+   */
+  void updateSubscribers();
+
   /**
   * @brief Process interactive feedback on a MOUSE_UP event and use it
   * to move the appropriate model to the new pose
@@ -109,6 +109,11 @@ class Joint {
    */
   void SetColor(const Color &color);
 
+  /**
+   * @return The anchors and body origins of the joint in the world frame
+   */
+  JointState GetState() const;
+
   /**
    * @return Get pointer to the Box2D physics joint
    */
@@ -0,0 +1,151 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 kinematic_animator.h
+ * @brief	 Moves the animated bodies of a world in one pass
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_KINEMATIC_ANIMATOR_H
+#define FLATLAND_SERVER_KINEMATIC_ANIMATOR_H
+
+#include <flatland_server/types.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+
+/**
+ * This class moves the bodies animated by plugins, e.g. doors and conveyors
+ * of Tween plugins, along their paths. All tracks are advanced in one loop
+ * before the model plugins of each step, the tracks that rest at an end of
+ * their path are skipped, so the plugins need no callback per step
+ */
+class KinematicAnimator {
+ public:
+  /// Maps the progress along a path, in [0, 1], to the fraction of the path
+  /// covered, 0 at 0 and 1 at 1
+  typedef double (*Easing)(double progress);
+
+  /// What a track does at the ends of its path
+  enum class Mode {
+    ONCE,     ///< stop at the end
+    YOYO,     ///< turn around at either end
+    LOOP,     ///< jump back to the start after the end
+    TRIGGER,  ///< move forward while triggered, backward otherwise, stop at
+              /// either end
+  };
+
+  static const int TABLE_SIZE = 1024;  ///< intervals of the easing tables
+
+  /**
+   * @brief Add a track, it starts at the start of its path moving forward
+   * @param[in] body The body to move, must not be static
+   * @param[in] start Pose of the body at the start of the path
+   * @param[in] delta Change of the pose from the start to the end
+   * @param[in] duration Seconds from the start to the end, positive
+   * @param[in] mode See Mode
+   * @param[in] easing The easing of the path
+   * @param[in] use_table true to interpolate the easing in a table of
+   * TABLE_SIZE intervals computed once per easing, instead of calling it
+   * @return Id of the track
+   */
+  int Add(Body *body, const Pose &start, const Pose &delta, double duration,
+          Mode mode, Easing easing, bool use_table);
+
+  /**
+   * @brief Remove a track, its id may be reused by the next Add
+   * @param[in] id Id of the track, nothing happens for -1
+   */
+  void Remove(int id);
+
+  /**
+   * @brief Set if a track in Mode::TRIGGER moves forward, from the next step
+   * on. May be called from any thread
+   * @param[in] id Id of the track
+   * @param[in] triggered true to move forward, false to move backward
+   */
+  void SetTriggered(int id, bool triggered);
+
+  /**
+   * @brief Advance all tracks and set the transforms of their bodies
+   * @param[in] dt Seconds to advance
+   */
+  void Step(double dt);
+
+  /**
+   * @return The number of tracks
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * @return The number of bodies moved by the last Step
+   */
+  size_t Moved() const { return moved_; }
+
+ private:
+  /// A body moving along its path
+  struct Track {
+    Body *body = nullptr;  ///< null if removed
+    Pose start;            ///< see Add
+    Pose delta;            ///< see Add
+    double duration = 1;   ///< see Add
+    double position = 0;   ///< seconds along the path
+    int direction = 1;     ///< 1 forward, -1 backward
+    Mode mode = Mode::ONCE;
+    Easing easing = nullptr;               ///< see Add
+    const std::vector<double> *table = nullptr;  ///< null to call easing
+    bool triggered = false;  ///< see SetTriggered
+    bool placed = false;     ///< if the body is at position already
+  };
+
+  std::mutex mutex_;                    ///< guards all members below
+  std::vector<Track> tracks_;           ///< by id
+  std::vector<int> free_;               ///< removed ids
+  size_t size_ = 0;                     ///< number of tracks
+  size_t moved_ = 0;                    ///< see Moved
+  std::map<Easing, std::vector<double>> tables_;  ///< by easing
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_KINEMATIC_ANIMATOR_H
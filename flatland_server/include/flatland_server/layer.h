@@ -48,27 +48,65 @@
 #define FLATLAND_SERVER_LAYER_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_msgs/DistanceField.h>
 #include <flatland_server/body.h>
 #include <flatland_server/collision_filter_registry.h>
 #include <flatland_server/entity.h>
+#include <flatland_server/image_row_reader.h>
+#include <flatland_server/layer_cache.h>
+#include <flatland_server/layer_tiles.h>
+#include <flatland_server/line_segments_file.h>
+#include <flatland_server/occupancy_grid.h>
+#include <flatland_server/recorded_subscriber.h>
+#include <flatland_server/segment_raycaster.h>
 #include <flatland_server/types.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <string>
 
 namespace flatland_server {
 
+class WorldBundle;
+
 /**
  * This class defines a layer in the simulation world which simulates the
  * environment in the world
  */
 class Layer : public Entity {
  public:
+  struct GridStream;
+
   std::vector<std::string> names_;  ///< list of layer names
 
   Body *body_ = nullptr;
   CollisionFilterRegistry *cfr_;  ///< collision filter registry
   std::string viz_name_;          ///< for visualization
+  std::shared_ptr<const OccupancyGrid> grid_;  ///< occupancy of bitmap
+                                               /// layers, in the body frame
+  std::shared_ptr<const SegmentRaycaster> segments_;  ///< for raycasting
+                                                      /// line segment layers
+  bool fine_sensing_ = false;  ///< sensed on segments_ at the resolution of
+                               /// the image, see BuildSensingSegments
+  LayerTiles *tiles_ = nullptr;  ///< tiles holding the geometry instead of
+                                 /// the layer body, nullptr if not tiled
+  mutable bool viz_dirty_ = true;  ///< if the markers must be rebuilt, see
+                                   /// GeometryChanged
+  mutable uint64_t viz_tile_changes_ = 0;  ///< tile changes when the markers
+                                           /// were built
+  uint64_t geometry_changes_ = 0;  ///< incremented by GeometryChanged
+  bool publish_grid_ = false;  ///< publish the occupancy grid, see PublishGrid
+  bool publish_distance_field_ = false;  ///< publish the distance field
+  ros::Publisher grid_pub_;            ///< latched occupancy grid
+  ros::Publisher distance_field_pub_;  ///< latched distance field
+  std::string map_path_;  ///< path of the map yaml, empty if the layer has no
+                          /// map
+  GridStream *stream_ = nullptr;  ///< geometry streamed from an occupancy grid
+                                  /// topic, nullptr if the layer is not
+                                  /// streamed, see UpdateFromGrid
+  RecordedSubscriber grid_sub_;   ///< subscription of a streamed layer
 
   /**
    * @brief Constructor for the Layer class for initialization using a image
@@ -81,14 +119,66 @@ class Layer : public Entity {
    * @param[in] origin Coordinate of the lower left corner of the image, in the
    * form of x, y, theta
    * @param[in] occupied_thresh Threshold indicating obstacle if above
-   * @param[in] bitmap Matrix containing the map image
+   * @param[in] bitmap Matrix containing the map image, 8 bit greyscale or
+   * float between 0 and 1
    * @param[in] resolution Resolution of the map image in meters per pixel
+   * @param[in] contours Link the edges into chain shapes, see LoadFromBitmap
+   * @param[in] simplify_tolerance Tolerance of the chain shapes in meters
    * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] tiling Tiling parameters, see LayerTiles
    */
   Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
         const std::vector<std::string> &names, const Color &color,
         const Pose &origin, const cv::Mat &bitmap, double occupied_thresh,
-        double resolution, const YAML::Node &properties);
+        double resolution, bool contours, double simplify_tolerance,
+        const YAML::Node &properties,
+        const LayerTiles::Params &tiling = LayerTiles::Params());
+
+  /**
+   * @brief Constructor for the Layer class for initialization using the
+   * geometry cached from a bitmap
+   * @param[in] physics_world Pointer to the box2d physics world
+   * @param[in] cfr Collision filter registry
+   * @param[in] names A list of names for the layer, the first name is used
+   * for the name of the body
+   * @param[in] color Color in the form of r, g, b, a, used for visualization
+   * @param[in] origin Coordinate of the lower left corner of the image, in the
+   * form of x, y, theta
+   * @param[in] cache An opened geometry cache
+   * @param[in] contours Link the edges into chain shapes, see LoadFromBitmap
+   * @param[in] simplify_tolerance Tolerance of the chain shapes in meters
+   * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] tiling Tiling parameters, see LayerTiles
+   */
+  Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+        const std::vector<std::string> &names, const Color &color,
+        const Pose &origin, const LayerCache &cache, bool contours,
+        double simplify_tolerance, const YAML::Node &properties,
+        const LayerTiles::Params &tiling = LayerTiles::Params());
+
+  /**
+   * @brief Constructor for the Layer class for initialization using the
+   * edges extracted from a bitmap, see ExtractRuns and StreamRuns
+   * @param[in] physics_world Pointer to the box2d physics world
+   * @param[in] cfr Collision filter registry
+   * @param[in] names A list of names for the layer, the first name is used
+   * for the name of the body
+   * @param[in] color Color in the form of r, g, b, a, used for visualization
+   * @param[in] origin Coordinate of the lower left corner of the image, in the
+   * form of x, y, theta
+   * @param[in] runs The edges in pixel coordinates
+   * @param[in] grid The occupancy grid of the bitmap, the layer takes it
+   * @param[in] contours Link the edges into chain shapes, see LoadFromBitmap
+   * @param[in] simplify_tolerance Tolerance of the chain shapes in meters
+   * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] tiling Tiling parameters, see LayerTiles
+   */
+  Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+        const std::vector<std::string> &names, const Color &color,
+        const Pose &origin, const std::vector<LayerCache::Run> &runs,
+        OccupancyGrid *grid, bool contours, double simplify_tolerance,
+        const YAML::Node &properties,
+        const LayerTiles::Params &tiling = LayerTiles::Params());
 
   /**
    * @brief Constructor for the Layer class for initialization using line
@@ -104,11 +194,35 @@ class Layer : public Entity {
    * @param[in] scale Scale to apply to the line segment end points, works in
    * the same way as resolution
    * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] tiling Tiling parameters, see LayerTiles
    */
   Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
         const std::vector<std::string> &names, const Color &color,
         const Pose &origin, const std::vector<LineSegment> &line_segments,
-        double scale, const YAML::Node &properties);
+        double scale, const YAML::Node &properties,
+        const LayerTiles::Params &tiling = LayerTiles::Params());
+
+  /**
+   * @brief Constructor for the Layer class for initialization using line
+   * segments from a binary file
+   * @param[in] physics_world Pointer to the box2d physics world
+   * @param[in] cfr Collision filter registry
+   * @param[in] names A list of names for the layer, the first name is used
+   * for the name of the body
+   * @param[in] color Color in the form of r, g, b, a, used for visualization
+   * @param[in] origin Coordinate of the lower left corner of the image, in the
+   * form of x, y, theta
+   * @param[in] line_segments An opened binary line segments file
+   * @param[in] scale Scale to apply to the line segment end points, works in
+   * the same way as resolution
+   * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] tiling Tiling parameters, see LayerTiles
+   */
+  Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+        const std::vector<std::string> &names, const Color &color,
+        const Pose &origin, const LineSegmentsFile &line_segments,
+        double scale, const YAML::Node &properties,
+        const LayerTiles::Params &tiling = LayerTiles::Params());
 
   /**
   * @brief Constructor for the Layer class for initialization with no static
@@ -123,6 +237,25 @@ class Layer : public Entity {
         const std::vector<std::string> &names, const Color &color,
         const YAML::Node &properties);
 
+  /**
+   * @brief Constructor for the Layer class for initialization from an
+   * occupancy grid topic, the layer is empty until the first grid is
+   * received, see SubscribeGrid
+   * @param[in] physics_world Pointer to the box2d physics world
+   * @param[in] cfr Collision filter registry
+   * @param[in] names A list of names for the layer, the first name is used
+   * for the name of the body
+   * @param[in] color Color in the form of r, g, b, a, used for visualization
+   * @param[in] topic Topic of the nav_msgs/OccupancyGrid messages
+   * @param[in] occupied_thresh Cells with an occupancy probability above it
+   * are obstacles, unknown cells are free
+   * @param[in] properties A YAML node containing properties for plugins to use
+   */
+  Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+        const std::vector<std::string> &names, const Color &color,
+        const std::string &topic, double occupied_thresh,
+        const YAML::Node &properties);
+
   /**
    * @brief Destructor for the layer class
    */
@@ -140,6 +273,77 @@ class Layer : public Entity {
 
   Body *GetBody();
 
+  /**
+   * @return The occupancy grid of the layer in the frame of the layer body,
+   * nullptr if the layer is not loaded from a bitmap
+   */
+  const OccupancyGrid *GetGrid() const;
+
+  /**
+   * @return The segment raycaster of the layer in the frame of the layer
+   * body, nullptr if the layer is not loaded from line segments or has no
+   * sensing segments
+   */
+  const SegmentRaycaster *GetSegmentRaycaster() const;
+
+  /**
+   * @return true if the fixtures of the layer are only for collisions, the
+   * sensors must raycast its segments, see BuildSensingSegments
+   */
+  bool HasSensingGeometry() const { return fine_sensing_; }
+
+  /**
+   * @return The tiles of the layer, nullptr if the layer is not tiled
+   */
+  LayerTiles *GetTiles();
+
+  /**
+   * @brief Share the read-only geometry of the layer, the occupancy grid and
+   * the segment raycaster, with the other layers loaded from the same map
+   * file in the process. If such a layer exists, its geometry replaces the
+   * geometry of this layer, otherwise the geometry of this layer is shared
+   * with the layers loaded later
+   * @param[in] map_path Path of the map file of the layer
+   */
+  void ShareGeometry(const std::string &map_path);
+
+  /**
+   * @brief Build the distance field of the occupancy grid of a bitmap layer,
+   * see OccupancyGrid::BuildDistanceField, which speeds up the lasers using
+   * grid_raycast in open space. Does nothing for other layers
+   */
+  void BuildDistanceField();
+
+  /**
+   * @brief Build the segments of the edges of a bitmap layer at the
+   * resolution of the image from its occupancy grid, so that the lasers see
+   * the full detail of the map while its fixtures, simplified by contours
+   * and simplify_tolerance, only serve the collisions. Does nothing for
+   * other layers
+   */
+  void BuildSensingSegments();
+
+  /**
+   * @brief Publish the occupancy grid and the distance field of a bitmap
+   * layer once on latched topics, if enabled in the map yaml, so that the
+   * planners running next to the simulator do not load the map again. Does
+   * nothing for other layers
+   * @param[in] ns Namespace of the topics, the namespace of the world
+   */
+  void PublishGrid(const std::string &ns);
+
+  /**
+   * @return The occupancy grid as a message in the map frame, occupied cells
+   * are 100 and free cells 0, requires a bitmap layer
+   */
+  nav_msgs::OccupancyGrid GridToMsg() const;
+
+  /**
+   * @return The distance field as a message in the map frame, requires a
+   * bitmap layer with a distance field, see BuildDistanceField
+   */
+  flatland_msgs::DistanceField DistanceFieldToMsg() const;
+
   /**
    * @brief Return the type of entity
    * @return type indicating it is a layer
@@ -148,18 +352,186 @@ class Layer : public Entity {
 
   /**
    * @brief Load the map by extracting edges from images
-   * @param[in] bitmap OpenCV Image
+   * @param[in] bitmap OpenCV Image, 8 bit greyscale or float between 0 and 1
    * @param[in] occupied_thresh Threshold indicating obstacle if above
    * @param[in] resolution Resolution of the map image in meters per pixel
+   * @param[in] contours If true, the edges around each obstacle are linked
+   * into one b2ChainShape fixture instead of one b2EdgeShape fixture each
+   * @param[in] simplify_tolerance Douglas-Peucker tolerance in meters applied
+   * to the chain shapes, 0 keeps the exact pixel contours
    */
   void LoadFromBitmap(const cv::Mat &bitmap, double occupied_thresh,
-                      double resolution);
+                      double resolution, bool contours = false,
+                      double simplify_tolerance = 0);
+
+  /**
+   * @brief Extract the edges between free and occupied pixels of an image,
+   * the work is spread over the threads of the SensorExecutor
+   * @param[in] bitmap OpenCV Image, 8 bit greyscale or float between 0 and 1
+   * @param[in] occupied_thresh Threshold indicating obstacle if above
+   * @param[in] resolution Resolution of the map image in meters per pixel
+   * @param[out] runs The edges in pixel coordinates, horizontal edges first
+   * @return A new occupancy grid of the thresholded image
+   */
+  static OccupancyGrid *ExtractRuns(const cv::Mat &bitmap,
+                                    double occupied_thresh, double resolution,
+                                    std::vector<LayerCache::Run> *runs);
+
+  /**
+   * @brief Extract the edges of an image decoded row by row, in bands of
+   * rows, so that the whole image is never held in memory. The result is
+   * the same as ExtractRuns on the decoded image
+   * @param[in] image An opened image, read to the end
+   * @param[in] occupied_thresh Threshold indicating obstacle if above
+   * @param[in] resolution Resolution of the map image in meters per pixel
+   * @param[out] runs The edges in pixel coordinates, horizontal edges first
+   * @return A new occupancy grid of the thresholded image
+   */
+  static OccupancyGrid *StreamRuns(ImageRowReader &image,
+                                   double occupied_thresh, double resolution,
+                                   std::vector<LayerCache::Run> *runs);
+
+  /**
+   * @brief Extract the edges between consecutive rows of a thresholded image
+   * in parallel, see ExtractRuns
+   * @param[in] obstacle_map Thresholded image, obstacles are 0
+   * @param[in] transposed If the image is transposed, the coordinates of the
+   * edges are swapped back to the coordinates of the original image
+   * @param[out] runs The edges are appended to it
+   */
+  static void ExtractRowRuns(const cv::Mat &obstacle_map, bool transposed,
+                             std::vector<LayerCache::Run> *runs);
+
+  /**
+   * @brief Extract the edges along a range of boundaries of a thresholded
+   * image, see ExtractRowRuns. The image may be a band of the rows of a
+   * larger image, it must then hold the rows on both sides of the boundaries
+   * that are inside the larger image
+   * @param[in] obstacle_map Thresholded image, obstacles are 0
+   * @param[in] transposed See ExtractRowRuns
+   * @param[in] offset Row of the larger image at the first row of the image
+   * @param[in] begin First boundary, boundary i lies between the rows i - 1
+   * and i of the larger image
+   * @param[in] end Boundary after the last one
+   * @param[out] runs The edges are appended to it, in the order of the
+   * boundaries
+   */
+  static void ExtractRowRuns(const cv::Mat &obstacle_map, bool transposed,
+                             int offset, unsigned int begin, unsigned int end,
+                             std::vector<LayerCache::Run> *runs);
 
   /**
-   * @brief Visualize layer for debugging purposes
+   * @brief Create the fixtures of the layer from extracted edges
+   * @param[in] runs The edges in pixel coordinates, see ExtractRuns
+   * @param[in] run_count Number of edges
+   * @param[in] rows Number of rows of the image
+   * @param[in] resolution Resolution of the map image in meters per pixel
+   * @param[in] contours See LoadFromBitmap
+   * @param[in] simplify_tolerance See LoadFromBitmap
+   */
+  void LoadFromRuns(const LayerCache::Run *runs, size_t run_count,
+                    unsigned int rows, double resolution, bool contours,
+                    double simplify_tolerance);
+
+  /**
+   * @brief Create the tiles of the layer if tiling is enabled, must be called
+   * before any geometry is added
+   * @param[in] tiling Tiling parameters
+   */
+  void InitTiles(const LayerTiles::Params &tiling);
+
+  /**
+   * @brief Create the fixture of a line segment, or add it to the tiles
+   * @param[in] start Start point of the line segment
+   * @param[in] end End point of the line segment
+   * @param[in] scale Scale to apply to the end points
+   * @param[in] category_bits Collision category of the layer
+   * @param[out] scaled_segments The scaled line segment is appended to it
+   */
+  void AddLineSegment(const b2Vec2 &start, const b2Vec2 &end, double scale,
+                      uint32_t category_bits,
+                      std::vector<LineSegment> *scaled_segments);
+
+  /**
+   * @brief Add line segments to the layer at runtime, e.g. obstacles of an
+   * episode. The collision category of the layer is computed once for the
+   * whole batch. Tiled layers cannot be modified, and the occupancy grid and
+   * segment raycaster of the layer do not include the new segments
+   * @param[in] segments The segments, in the frame of the layer body
+   * @return The fixtures created, in the order of the segments
+   */
+  std::vector<b2Fixture *> AddSegments(
+      const std::vector<b2EdgeShape> &segments);
+
+  /**
+   * @brief Remove line segments added by AddSegments
+   * @param[in] fixtures Fixtures returned by AddSegments
+   */
+  void RemoveSegments(const std::vector<b2Fixture *> &fixtures);
+
+  /**
+   * @brief Take the geometry of a layer loaded from a new version of the map
+   * of this layer, e.g. in another b2World. The fixtures of both layers are
+   * matched by shape, only the fixtures that differ are destroyed and
+   * created, the others and their contacts are kept. The occupancy grid and
+   * segment raycaster are replaced. Tiled layers cannot be updated
+   * @param[in] source The layer loaded from the new map
+   * @param[out] removed Number of fixtures destroyed, if not null
+   * @param[out] added Number of fixtures created, if not null
+   */
+  void UpdateGeometry(const Layer &source, size_t *removed = nullptr,
+                      size_t *added = nullptr);
+
+  /**
+   * @return A counter incremented each time the geometry of any layer
+   * changes, see GeometryChanged, so that the plugins holding the occupancy
+   * grids or segment raycasters of the layers know when to look them up
+   * again, and the plugins caching raycasts when to drop them
+   */
+  static uint64_t GetGeometryGeneration();
+
+  /**
+   * @brief Subscribe a layer streamed from an occupancy grid topic to its
+   * topic, the grids are applied between steps by UpdateFromGrid and are
+   * recorded. Does nothing for other layers
+   * @param[in] ns Namespace of the topic, the namespace of the world
+   */
+  void SubscribeGrid(const std::string &ns);
+
+  /**
+   * @brief Update a layer streamed from an occupancy grid topic. The cells
+   * are compared to the previous grid, and only the edges along the rows and
+   * columns around the cells that changed are extracted again. Of these, only
+   * the fixtures of the edges that differ are destroyed and created. The
+   * whole layer is rebuilt when the size, resolution or origin of the grid
+   * changes
+   * @param[in] msg The grid, unknown cells are free
+   * @param[out] removed Number of fixtures destroyed, if not null
+   * @param[out] added Number of fixtures created, if not null
+   */
+  void UpdateFromGrid(const nav_msgs::OccupancyGrid &msg,
+                      size_t *removed = nullptr, size_t *added = nullptr);
+
+  /**
+   * @brief Callback of the occupancy grid topic, see SubscribeGrid
+   * @param[in] msg The grid
+   */
+  void GridCallback(const nav_msgs::OccupancyGrid &msg);
+
+  /**
+   * @brief Visualize layer for debugging purposes. The markers are only
+   * rebuilt when the geometry changed, otherwise the markers already on the
+   * topics are kept and nothing is done
    */
   void DebugVisualize() const override;
 
+  /**
+   * @brief Call after changing the fixtures of the layer body, its grid or
+   * its segments, or activating or evicting its tiles, so that the next
+   * DebugVisualize rebuilds the markers. Increments GetGeometryGeneration
+   */
+  void GeometryChanged();
+
   /**
    * @brief log debug messages for the layer
    */
@@ -186,12 +558,17 @@ class Layer : public Entity {
    * @param[in] color Color of the layer
    * file, this is used to calculate the path to the layermap yaml file
    * @param[in] properties A YAML node containing properties for plugins to use
+   * @param[in] bundle The bundle to read the map yaml and the geometry from
+   * instead of the files, null to read the files
+   * @param[in] bundle_key The map path as written in the world yaml
    * @return A new layer
    */
   static Layer *MakeLayer(b2World *physics_world, CollisionFilterRegistry *cfr,
                           const std::string &map_path,
                           const std::vector<std::string> &names,
-                          const Color &color, const YAML::Node &properties);
+                          const Color &color, const YAML::Node &properties,
+                          const WorldBundle *bundle = nullptr,
+                          const std::string &bundle_key = "");
 };
 };      // namespace flatland_server
 #endif  // FLATLAND_SERVER_WORLD_H
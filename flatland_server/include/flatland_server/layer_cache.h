@@ -0,0 +1,192 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_cache.h
+ * @brief	 Binary on disk cache of the geometry extracted from bitmap layers
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_LAYER_CACHE_H
+#define FLATLAND_SERVER_LAYER_CACHE_H
+
+#include <flatland_server/occupancy_grid.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads and writes the geometry extracted from a bitmap layer, i.e.
+ * the edge runs and the occupancy grid, so that later loads of the same map
+ * skip decoding and thresholding the image. The file is memory mapped and
+ * the runs are used in place. A cache is only valid for the key it was
+ * written with, see MakeKey. The data is stored in native byte order
+ */
+class LayerCache {
+ public:
+  /**
+   * An edge between free and occupied pixels, in pixel coordinates of the
+   * image padded with one row or column of free pixels, with y growing
+   * downwards as in the image
+   */
+  struct Run {
+    int32_t x1;  ///< x of the start point
+    int32_t y1;  ///< y of the start point
+    int32_t x2;  ///< x of the end point
+    int32_t y2;  ///< y of the end point
+  };
+
+  LayerCache() = default;
+  ~LayerCache();
+  LayerCache(const LayerCache &) = delete;
+  LayerCache &operator=(const LayerCache &) = delete;
+
+  /**
+   * @brief Hash the content of a file
+   * @param[in] path Path to the file
+   * @return 64 bit FNV-1a hash of the file content, throws Exception if the
+   * file cannot be read
+   */
+  static uint64_t HashFile(const std::string &path);
+
+  /**
+   * @brief Combine the hash of an image with the parameters used to extract
+   * its geometry into a cache key
+   * @param[in] image_hash Hash of the image file
+   * @param[in] resolution Resolution of the map in meters per pixel
+   * @param[in] occupied_thresh Threshold indicating obstacle if above
+   * @param[in] origin Origin of the map in the form of x, y, theta
+   * @return The key
+   */
+  static uint64_t MakeKey(uint64_t image_hash, double resolution,
+                          double occupied_thresh,
+                          const std::vector<double> &origin);
+
+  /**
+   * @brief Make the path of the cache file of an image, the key is part of
+   * the name so that caches of the same image with other parameters do not
+   * replace each other
+   * @param[in] image_path Path to the image
+   * @param[in] key Key of the cache
+   * @return <image_path>.<key in hex>.geometry
+   */
+  static std::string MakePath(const std::string &image_path, uint64_t key);
+
+  /**
+   * @brief Write a cache file, the file is written to a uniquely named file
+   * next to its final path and renamed, so that readers never see a partial
+   * file and concurrent writers do not write to the same file
+   * @param[in] path Path to the cache file
+   * @param[in] key Key of the cache
+   * @param[in] runs The edge runs
+   * @param[in] grid The occupancy grid of the map
+   * @return false if the file cannot be written
+   */
+  static bool Write(const std::string &path, uint64_t key,
+                    const std::vector<Run> &runs, const OccupancyGrid &grid);
+
+  /**
+   * @brief Serialize a cache to memory, in the format of the cache files
+   * @param[in] key Key of the cache
+   * @param[in] runs The edge runs
+   * @param[in] grid The occupancy grid of the map
+   * @return The content of the cache file
+   */
+  static std::string Serialize(uint64_t key, const std::vector<Run> &runs,
+                               const OccupancyGrid &grid);
+
+  /**
+   * @brief Map a cache file
+   * @param[in] path Path to the cache file
+   * @param[in] key Expected key of the cache
+   * @return false if the file does not exist, is invalid, or has another key
+   */
+  bool Open(const std::string &path, uint64_t key);
+
+  /**
+   * @brief Use a cache in memory in place, e.g. embedded in a WorldBundle
+   * @param[in] data The content of a cache file, 8 byte aligned, it must
+   * outlive this object
+   * @param[in] size Size of the content
+   * @param[in] key Expected key of the cache
+   * @return false if the content is invalid, or has another key
+   */
+  bool Attach(const void *data, size_t size, uint64_t key);
+
+  /**
+   * @return The edge runs, valid for the lifetime of this object
+   */
+  const Run *GetRuns() const { return runs_; }
+
+  /**
+   * @return Number of edge runs
+   */
+  size_t GetRunCount() const { return run_count_; }
+
+  /**
+   * @return A new occupancy grid with the cached content
+   */
+  OccupancyGrid *MakeGrid() const;
+
+  /**
+   * @return Number of rows of the map image
+   */
+  unsigned int GetRows() const { return rows_; }
+
+ private:
+  void *data_ = nullptr;         ///< mapped file
+  size_t size_ = 0;              ///< size of the mapped file
+  const Run *runs_ = nullptr;    ///< runs in the mapped file
+  size_t run_count_ = 0;         ///< number of runs
+  const uint64_t *grid_ = nullptr;  ///< grid words in the mapped file
+  unsigned int rows_ = 0;        ///< rows of the map image
+  unsigned int cols_ = 0;        ///< columns of the map image
+  double resolution_ = 0;        ///< resolution of the map
+
+  /**
+   * @brief Unmap the file
+   */
+  void Close();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_LAYER_CACHE_H
@@ -0,0 +1,182 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_tiles.h
+ * @brief	 Defines tiles of layer geometry activated around models
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_LAYER_TILES_H
+#define FLATLAND_SERVER_LAYER_TILES_H
+
+#include <Box2D/Box2D.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class splits the static geometry of a layer into square tiles, each
+ * with its own static body. A tile's body and fixtures only exist while a
+ * region of interest, usually a model's bounding box grown by the sensor
+ * range, overlaps the tile, and are destroyed once no region has touched the
+ * tile for a timeout. This keeps the broadphase proportional to the area
+ * around the models instead of the area of the map. Line segments are split
+ * at tile boundaries, so each tile owns the geometry inside of it exactly
+ *
+ * The segments of bitmap layers lie on the pixel grid, their end points are
+ * stored as 16 bit pixel coordinates from the corner of their tile instead of
+ * floats, which halves the memory of the inactive tiles. The tile size is then
+ * rounded to a whole number of pixels, and the points are stored as floats if
+ * a tile is more than 65535 pixels wide
+ */
+class LayerTiles {
+ public:
+  /**
+   * Tiling parameters of a layer
+   */
+  struct Params {
+    double size = 0;      ///< tile edge length in meters, 0 disables tiling
+    double margin = 10;   ///< distance in meters added around the regions
+    double timeout = 10;  ///< seconds after which untouched tiles are evicted
+    double quantum = 0;   ///< if positive, e.g. the resolution of a bitmap,
+                          /// the end points are stored as 16 bit multiples of
+                          /// it from the tile corner, see LayerTiles
+  };
+
+  /**
+   * @brief Constructor for the layer tiles
+   * @param[in] physics_world Pointer to the box2d physics world
+   * @param[in] layer_body The body of the layer, the tile bodies are created
+   * with its transform and user data
+   * @param[in] category_bits Collision category of the layer
+   * @param[in] params Tiling parameters, the size must be positive, see
+   * GetParams
+   */
+  LayerTiles(b2World *physics_world, b2Body *layer_body,
+             uint32_t category_bits, const Params &params);
+
+  /**
+   * @brief Destructor, destroys the bodies of all active tiles
+   */
+  ~LayerTiles();
+
+  /**
+   * @brief Add a line segment to the tiles it passes through
+   * @param[in] start Start point in the frame of the layer body
+   * @param[in] end End point in the frame of the layer body
+   */
+  void AddSegment(const b2Vec2 &start, const b2Vec2 &end);
+
+  /**
+   * @brief Activate the tiles near the regions and evict the tiles that have
+   * not been near any region for the timeout
+   * @param[in] regions Regions of interest, axis aligned in the world frame
+   * @param[in] time Current simulation time in seconds
+   */
+  void Update(const std::vector<b2AABB> &regions, double time);
+
+  /**
+   * @return The bodies of the active tiles
+   */
+  std::vector<b2Body *> GetActiveBodies() const;
+
+  /**
+   * @return Number of tiles holding geometry
+   */
+  size_t GetTileCount() const { return tiles_.size(); }
+
+  /**
+   * @return Number of tiles with a body
+   */
+  size_t GetActiveTileCount() const { return active_.size(); }
+
+  /**
+   * @return Number of tile activations and evictions so far, changes
+   * whenever the set of active tiles changes
+   */
+  uint64_t GetChangeCount() const { return changes_; }
+
+  /**
+   * @return The tiling parameters, the size rounded to a multiple of the
+   * quantum and the quantum 0 if the points are stored as floats
+   */
+  const Params &GetParams() const { return params_; }
+
+ private:
+  /**
+   * A tile of geometry
+   */
+  struct Tile {
+    std::vector<b2Vec2> vertices;  ///< segment end points, two per segment,
+                                   /// if not quantized
+    std::vector<uint16_t> quantized;  ///< x and y of the end points in quanta
+                                      /// from the tile corner, if quantized
+    b2Body *body = nullptr;        ///< body while the tile is active
+    double last_used = 0;          ///< last time a region touched the tile
+  };
+
+  b2World *physics_world_;  ///< Box2D physics world
+  b2Body *layer_body_;      ///< body of the layer
+  uint32_t category_bits_;  ///< collision category of the layer
+  Params params_;           ///< tiling parameters
+  std::unordered_map<uint64_t, Tile> tiles_;  ///< tiles by Key
+  std::vector<uint64_t> active_;              ///< keys of active tiles
+  uint64_t changes_ = 0;  ///< number of activations and evictions
+
+  /**
+   * @return The key of the tile at the given tile coordinates
+   */
+  static uint64_t Key(int32_t x, int32_t y);
+
+  /**
+   * @return The tile coordinate of a position in the frame of the layer body
+   */
+  int32_t TileCoord(double v) const;
+
+  /**
+   * @brief Create the body and fixtures of a tile
+   */
+  void Activate(uint64_t key, Tile *tile);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_LAYER_TILES_H
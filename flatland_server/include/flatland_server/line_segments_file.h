@@ -0,0 +1,141 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 line_segments_file.h
+ * @brief	 Defines the binary line segments file format
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_LINE_SEGMENTS_FILE_H
+#define FLATLAND_SERVER_LINE_SEGMENTS_FILE_H
+
+#include <flatland_server/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads and writes line segments in a binary format, a 24 byte
+ * header followed by one record of four little endian 32 bit floats x1, y1,
+ * x2, y2 per line segment. The file is memory mapped and the records are
+ * used in place, which avoids parsing the text format for large maps
+ */
+class LineSegmentsFile {
+ public:
+  /**
+   * A line segment record as stored in the file
+   */
+  struct Record {
+    float x1;  ///< x of the start point
+    float y1;  ///< y of the start point
+    float x2;  ///< x of the end point
+    float y2;  ///< y of the end point
+  };
+
+  LineSegmentsFile() = default;
+  ~LineSegmentsFile();
+  LineSegmentsFile(const LineSegmentsFile &) = delete;
+  LineSegmentsFile &operator=(const LineSegmentsFile &) = delete;
+
+  /**
+   * @brief Check if a file is in the binary format
+   * @param[in] path Path to the file
+   * @return true if the file starts with the binary format magic
+   */
+  static bool IsBinary(const std::string &path);
+
+  /**
+   * @brief Write line segments in the binary format, throws exception upon
+   * failure
+   * @param[in] path Path to the file
+   * @param[in] line_segments Line segments to write
+   */
+  static void Write(const std::string &path,
+                    const std::vector<LineSegment> &line_segments);
+
+  /**
+   * @brief Serialize line segments to memory in the binary format
+   * @param[in] line_segments Line segments to serialize
+   * @return The content of the binary file
+   */
+  static std::string Serialize(const std::vector<LineSegment> &line_segments);
+
+  /**
+   * @brief Map a file in the binary format, throws exception upon failure
+   * @param[in] path Path to the file
+   */
+  void Open(const std::string &path);
+
+  /**
+   * @brief Use line segments in memory in the binary format in place, e.g.
+   * embedded in a WorldBundle, throws exception if they are invalid
+   * @param[in] data The content of a binary file, 4 byte aligned, it must
+   * outlive this object
+   * @param[in] size Size of the content
+   */
+  void Attach(const void *data, size_t size);
+
+  /**
+   * @return The line segments, valid for the lifetime of this object
+   */
+  const Record *GetRecords() const { return records_; }
+
+  /**
+   * @return Number of line segments
+   */
+  size_t GetCount() const { return count_; }
+
+ private:
+  void *data_ = nullptr;           ///< mapped file
+  size_t size_ = 0;                ///< size of the mapped file
+  const Record *records_ = nullptr;  ///< records in the mapped file
+  size_t count_ = 0;               ///< number of records
+
+  /**
+   * @brief Unmap the file
+   */
+  void Close();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_LINE_SEGMENTS_FILE_H
@@ -0,0 +1,119 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 memory_report.h
+ * @brief	Breakdown of the memory of a world by subsystem
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_MEMORY_REPORT_H
+#define FLATLAND_SERVER_MEMORY_REPORT_H
+
+#include <Box2D/Box2D.h>
+#include <yaml-cpp/yaml.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+class World;
+
+/**
+ * This class estimates the memory held by a world, broken down by subsystem,
+ * to see how the memory scales with the size of the world. The sizes are
+ * computed from the objects and the capacities of their buffers, allocator
+ * overheads are not counted
+ */
+class MemoryReport {
+ public:
+  /// Memory of one item of a subsystem
+  struct Entry {
+    std::string subsystem;  ///< e.g. layer, model, box2d, markers, plugin
+    std::string name;       ///< the layer, model, topic, plugin type...
+    uint64_t count;  ///< number of objects, e.g. fixtures or markers
+    uint64_t bytes;  ///< estimated bytes
+    uint64_t box2d_bytes;  ///< part of bytes allocated from the block
+                           /// allocator of Box2D, which has its own entry
+  };
+
+  std::vector<Entry> entries_;  ///< the entries, by subsystem
+
+  /**
+   * @brief Measure a world, must be called between steps
+   * @param[in] world The world
+   */
+  explicit MemoryReport(World *world);
+
+  /**
+   * @return The bytes of all entries, without counting the Box2D objects
+   * twice
+   */
+  uint64_t GetTotalBytes() const;
+
+  /**
+   * @brief Estimate the memory of a Box2D body and its fixtures
+   * @param[in] body The body
+   * @param[out] fixtures Incremented by the number of fixtures
+   * @param[out] box2d_bytes Incremented by the bytes allocated from the block
+   * allocator of the world
+   * @return The bytes, including the broadphase nodes of the fixtures
+   */
+  static uint64_t BodyBytes(const b2Body *body, uint64_t *fixtures,
+                            uint64_t *box2d_bytes);
+
+  /**
+   * @brief Estimate the memory of a YAML document
+   * @param[in] node The root of the document
+   * @param[out] nodes Incremented by the number of nodes
+   * @return The bytes of the nodes and their scalars
+   */
+  static uint64_t YamlBytes(const YAML::Node &node, uint64_t *nodes);
+
+ private:
+  /**
+   * @brief Add an entry
+   */
+  void Add(const std::string &subsystem, const std::string &name,
+           uint64_t count, uint64_t bytes, uint64_t box2d_bytes = 0);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_MEMORY_REPORT_H
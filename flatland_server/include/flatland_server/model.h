@@ -48,12 +48,19 @@
 #define FLATLAND_SERVER_MODEL_H
 
 #include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/command_latency.h>
 #include <flatland_server/entity.h>
 #include <flatland_server/joint.h>
 #include <flatland_server/model_body.h>
 #include <flatland_server/yaml_reader.h>
 #include <yaml-cpp/yaml.h>
 #include <boost/filesystem.hpp>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace flatland_server {
 
@@ -66,12 +73,54 @@ class Joint;
  */
 class Model : public Entity {
  public:
+  /// The markers of a body on the topic of the model, see DebugVisualize
+  struct BodyMarkers {
+    size_t first;     ///< index of the first marker
+    size_t count;     ///< number of markers
+    b2Vec2 position;  ///< position of the body when the markers were moved
+    float angle;      ///< angle of the body when the markers were moved
+  };
+
   std::string namespace_;            ///< namespace of the model
   std::vector<ModelBody *> bodies_;  ///< list of bodies in the model
   std::vector<Joint *> joints_;      ///< list of joints in the model
+  std::unordered_map<std::string, ModelBody *>
+      bodies_by_name_;  ///< bodies_ by name, see GetBody
+  std::unordered_map<std::string, Joint *>
+      joints_by_name_;  ///< joints_ by name, see GetJoint
+  uint32_t id_ = 0;     ///< handle of the model in the world, unique during
+                        /// the life of the world, 0 until added to a world
+  std::vector<b2Transform>
+      initial_transforms_;  ///< transforms of the bodies in the model frame
+                            /// as loaded, restored by Reuse
   YamlReader plugins_reader_;        ///< for storing plugins when paring YAML
+  std::vector<b2Vec2> positions_;  ///< scratch of TransformAll and SetPose
+  bool kinematic_ = false;  ///< if the bodies bypass the Box2D solver, see
+                            /// BypassSolver
+  bool lod_reduced_ = false;  ///< if outside the regions of interest of the
+                              /// PhysicsLod of the world, set by it
+  std::string group_;  ///< collision group of the footprints, empty for none
+  bool self_collide_ = true;  ///< if the footprints of group_ collide with
+                              /// each other
+  std::unique_ptr<CommandLatency>
+      command_latency_;  ///< latency of the commands of the drive plugin,
+                         /// null unless the drive traces it
   CollisionFilterRegistry *cfr_;     ///< Collision filter registry
   std::string viz_name_;             ///< used for visualization
+  std::string yaml_path_;            ///< path of the model file
+  std::time_t yaml_mtime_ = 0;       ///< modification time of the model file
+                                     /// when loaded, see World::ModelPool
+  mutable std::vector<BodyMarkers> viz_bodies_;  ///< markers of the bodies
+  mutable size_t viz_joints_first_ = 0;  ///< index of the first joint marker
+  mutable bool viz_dirty_ = true;  ///< if the markers must be rebuilt, see
+                                   /// GeometryChanged
+  uint64_t geometry_changes_ = 0;  ///< incremented by GeometryChanged
+  mutable std::vector<JointState> joint_states_;  ///< see GetJointStates
+  mutable std::vector<b2Transform>
+      joint_states_transforms_;  ///< transforms of the bodies when
+                                 /// joint_states_ was taken
+  mutable bool joint_states_dirty_ = true;  ///< if joint_states_ must be
+                                            /// taken again
 
   /**
    * @brief Constructor for the model
@@ -99,6 +148,15 @@ class Model : public Entity {
    */
   void LoadBodies(YamlReader &bodies_reader);
 
+  /**
+   * @brief Take the bodies of a kinematic model out of the Box2D constraint
+   * solver. They are moved by their velocities alone at the end of each step
+   * and keep their fixtures in the broadphase, so sensors and contact
+   * callbacks still see them, but they neither push nor get pushed. Throws
+   * if the model has joints
+   */
+  void BypassSolver();
+
   /**
    * @brief load joints to this model, throws exceptions upon failure
    * @param[in] joints_reader YAML reader for node containing the list of joints
@@ -155,10 +213,30 @@ class Model : public Entity {
   const CollisionFilterRegistry *GetCfr() const;
 
   /**
-   * @brief Publish debug visualizations for model
+   * @brief Publish debug visualizations for model. The markers of the bodies
+   * are built once, afterwards only the markers of the bodies that moved are
+   * updated, and the topic is not published again if nothing moved
    */
   void DebugVisualize() const override;
 
+  /**
+   * @brief Call after changing the bodies, fixtures or joints of the model,
+   * so that the next DebugVisualize rebuilds the markers
+   */
+  void GeometryChanged() {
+    viz_dirty_ = true;
+    joint_states_dirty_ = true;
+    geometry_changes_++;
+  }
+
+  /**
+   * @brief Snapshot of the joints of the model in the world frame, in the
+   * order of joints_. It is only taken again when a body of the model moved,
+   * so the plugins and the visualization of a step share one snapshot
+   * @return The joint states
+   */
+  const std::vector<JointState> &GetJointStates() const;
+
   /**
    * @brief log debug messages for the layer
    */
@@ -181,6 +259,41 @@ class Model : public Entity {
    */
   void SetPose(const Pose &pose);
 
+  /**
+   * @brief Copy the positions of the bodies to positions_, to transform them
+   * in one batch
+   */
+  void GetPositions();
+
+  /**
+   * @brief Take a model out of the simulation without destroying it, its
+   * bodies are deactivated so they collide with and are seen by nothing
+   */
+  void Park();
+
+  /**
+   * @brief Bring a parked model back under a new name, its bodies get back
+   * their initial layout, at rest, at the given pose
+   * @param[in] ns Namespace of the model
+   * @param[in] name Name of the model
+   * @param[in] pose world x, world y, world yaw
+   */
+  void Reuse(const std::string &ns, const std::string &name, const Pose &pose);
+
+  /**
+   * @brief Check if a body of the model is awake, Box2D puts the bodies that
+   * came to rest to sleep. Static bodies never are awake
+   * @return If any non static body of the model is awake
+   */
+  bool IsAwake() const;
+
+  /**
+   * @brief Wake up or put to sleep the non static bodies of the model, e.g.
+   * when a plugin receives a new command, see ModelPlugin::SkipsWhileAsleep
+   * @param[in] awake true to wake up
+   */
+  void SetAwake(bool awake);
+
   /**
    * @brief Create a model, throws exceptions upon failure
    * @param[in] physics_world Box2D physics world
@@ -193,6 +306,22 @@ class Model : public Entity {
   static Model *MakeModel(b2World *physics_world, CollisionFilterRegistry *cfr,
                           const std::string &model_yaml_path,
                           const std::string &ns, const std::string &name);
+
+  /**
+   * @brief Create a model from a model yaml file parsed already, throws
+   * exceptions upon failure
+   * @param[in] physics_world Box2D physics world
+   * @param[in] cfr Collision filter registry
+   * @param[in] reader The YAML reader of the model yaml file
+   * @param[in] model_yaml_path Absolute path to the model yaml file
+   * @param[in] ns Namespace of the robot
+   * @param[in] name Name of the model
+   * @return A new model
+   */
+  static Model *MakeModel(b2World *physics_world, CollisionFilterRegistry *cfr,
+                          YamlReader &reader,
+                          const std::string &model_yaml_path,
+                          const std::string &ns, const std::string &name);
 };
 };      // namespace flatland_server
 #endif  // FLATLAND_SERVER_MODEL_H
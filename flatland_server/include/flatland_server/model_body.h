@@ -114,7 +114,8 @@ class ModelBody : public Body {
   void LoadCircleFootprint(YamlReader &footprint_reader);
 
   /**
-   * @brief Loads a circle footprint
+   * @brief Loads a polygon footprint, concave polygons and polygons with more
+   * vertices than Box2D supports are decomposed into convex fixtures
    * @param[in] footprint_reader YAML reader for node containing the footprint
    * parameters
    */
@@ -48,11 +48,20 @@
 #define FLATLAND_SERVER_MODEL_PLUGIN_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/counted_publish.h>
 #include <flatland_server/flatland_plugin.h>
 #include <flatland_server/model.h>
 #include <flatland_server/timekeeper.h>
+#include <flatland_server/yaml_reader.h>
 #include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <vector>
 
 namespace flatland_server {
 
@@ -67,6 +76,24 @@ class ModelPlugin : public FlatlandPlugin {
 
  public:
   ros::NodeHandle nh_;  ///< ROS node handle
+  double update_period_ = 0;  ///< period of the updates in seconds, 0 to be
+                              /// updated on every step, see SetUpdateRate
+  double update_phase_ = 0;   ///< time of the first update in seconds, set
+                              /// from the update_phase plugin parameter
+  double update_stagger_ = 0;  ///< further offset of the updates as a
+                               /// fraction of their period, set by the
+                               /// plugin manager, see StaggerFraction
+  bool update_due_ = true;    ///< if the plugin is updated on this step, set
+                              /// by the plugin manager
+  double last_update_time_ = -std::numeric_limits<double>::infinity();
+  ///< sim time of the last update, only kept while skipping sleeping or
+  /// reduced models, see SkipsWhileAsleep and PhysicsLod
+  std::vector<ContactEvent> contact_events_;  ///< events of the step
+                                              /// passed to ContactEvents,
+                                              /// set by the plugin manager
+  std::string config_key_;  ///< identifies the plugin in the model template
+                            /// its config was read from, empty if none, set
+                            /// by the plugin manager, see SharedConfig
 
   /**
    * @brief Get model
@@ -107,11 +134,190 @@ class ModelPlugin : public FlatlandPlugin {
    */
   bool FilterContact(b2Contact *contact);
 
+  /**
+   * @brief Have the plugin manager call BeforePhysicsStep and
+   * AfterPhysicsStep only on the steps at which an update is due, instead of
+   * the plugin checking the time on every step. The updates are due at
+   * update_phase_ + k / rate, on the step whose time is closest. Typically
+   * called from OnInitialize, ignored for plugins updated per sub-step
+   * @param[in] rate Rate in Hz, infinite to be updated on every step
+   */
+  void SetUpdateRate(double rate);
+
+  /**
+   * @return Time in seconds of the first update within the update period,
+   * update_phase_ shifted by update_stagger_ periods
+   */
+  double FirstUpdateTime() const;
+
+  /**
+   * @brief Spread the updates of plugins with the same rate over the steps of
+   * their period, instead of all of them being updated on the same step. The
+   * fraction is a hash of the key, so that a plugin keeps its offset from
+   * run to run
+   * @param[in] key Identifies the plugin, e.g. its namespace, model and name
+   * @return The offset of the updates as a fraction of the period, in [0, 1)
+   */
+  static double StaggerFraction(const std::string &key);
+
+  /**
+   * @brief Plugins return true to be skipped while their model is asleep,
+   * see Model::IsAwake, if enabled by the sleeping_update_rate world
+   * property. BeforePhysicsStep and AfterPhysicsStep are then only called at
+   * that lower rate, e.g. to publish the unchanged pose again. Only plugins
+   * whose outputs do not change while the model rests may return true, and
+   * they must wake the model with Model::SetAwake when they receive a new
+   * command. Ignored for plugins updated per sub-step
+   * @return If the plugin may be skipped while its model is asleep
+   */
+  virtual bool SkipsWhileAsleep() const { return false; }
+
+  /**
+   * @brief Called when the simulation loop changes the work the sensors
+   * should save because the steps overrun their budget, see
+   * StepBudgetGovernor. Plugins reduce their work accordingly, e.g. by
+   * calling SetUpdateRate with a lower rate, and restore it once the flags
+   * are cleared. Also called after OnInitialize if degradations are active
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags, 0
+   * for none
+   */
+  virtual void SetDegradations(uint32_t degradations) {}
+
+  /**
+   * @brief Pick a random seed, e.g. for noise, through the Recorder, so that
+   * a replayed run gets the seeds of the recorded one
+   * @return The seed
+   */
+  uint32_t RandomSeed();
+
+  /**
+   * @brief Parse the parameters of the plugin into a typed struct once per
+   * model template, the instances of the template share one immutable
+   * struct. The struct declares the parameters of the plugin: its
+   * constructor takes a YamlReader of the config, followed by args, reads
+   * and validates all parameters, and throws YAMLException. It must not
+   * depend on anything but the config and args, e.g. not on the model
+   * @param[in] config The plugin YAML node, as passed to OnInitialize
+   * @param[in] args Further arguments of the constructor of Config, the same
+   * for all instances of a template
+   * @return The parameters
+   */
+  template <typename Config, typename... Args>
+  std::shared_ptr<const Config> SharedConfig(const YAML::Node &config,
+                                             Args &&... args);
+
+  /**
+   * @brief Check if an output of the plugin has subscribers, so that the
+   * plugin can skip computing and serializing the outputs nobody listens to
+   * @param[in] publisher The publisher of the output
+   * @return true if the publisher has a subscriber
+   */
+  static bool IsSubscribed(const ros::Publisher &publisher) {
+    return publisher.getNumSubscribers() > 0;
+  }
+
+  /**
+   * @brief Check if any of the publishers of an output has subscribers, see
+   * IsSubscribed
+   * @param[in] publisher The first publisher of the output
+   * @param[in] other The second publisher
+   * @param[in] others Further publishers of the same output
+   * @return true if any of the publishers has a subscriber
+   */
+  template <typename... Publishers>
+  static bool IsSubscribed(const ros::Publisher &publisher,
+                           const ros::Publisher &other,
+                           const Publishers &... others);
+
+  /**
+   * @brief Fill and publish a message only if its publisher has subscribers,
+   * see IsSubscribed
+   * @param[in] publisher The publisher
+   * @param[in, out] message The message, it may be reused between calls
+   * @param[in] fill Called with the message to compute its content before it
+   * is published, not called without subscribers
+   * @return true if the message was published
+   */
+  template <typename Message, typename Fill>
+  static bool PublishLazily(const ros::Publisher &publisher, Message &message,
+                            Fill &&fill);
+
+  /**
+   * @brief Publish a message that is already computed only if its publisher
+   * has subscribers, see IsSubscribed
+   * @param[in] publisher The publisher
+   * @param[in] message The message
+   * @return true if the message was published
+   */
+  template <typename Message>
+  static bool PublishLazily(const ros::Publisher &publisher,
+                            const Message &message);
+
  protected:
   /**
    * @brief Model plugin default constructor
    */
   ModelPlugin() = default;
+
+ private:
+  /**
+   * @brief Find the struct of config_key_ parsed by another instance
+   * @param[in] type Type of the struct
+   * @return The struct, null if there is none
+   */
+  std::shared_ptr<const void> FindSharedConfig(const std::type_index &type);
+
+  /**
+   * @brief Share a struct with the other instances with config_key_, the
+   * struct is freed with the last instance using it
+   * @param[in] type Type of the struct
+   * @param[in] parsed The struct
+   */
+  void StoreSharedConfig(const std::type_index &type,
+                         const std::shared_ptr<const void> &parsed);
 };
+
+template <typename Config, typename... Args>
+std::shared_ptr<const Config> ModelPlugin::SharedConfig(
+    const YAML::Node &config, Args &&... args) {
+  std::shared_ptr<const void> shared = FindSharedConfig(typeid(Config));
+  if (shared) {
+    return std::static_pointer_cast<const Config>(shared);
+  }
+
+  YamlReader reader(config);
+  std::shared_ptr<const Config> parsed =
+      std::make_shared<const Config>(reader, std::forward<Args>(args)...);
+  StoreSharedConfig(typeid(Config), parsed);
+  return parsed;
+}
+
+template <typename... Publishers>
+bool ModelPlugin::IsSubscribed(const ros::Publisher &publisher,
+                               const ros::Publisher &other,
+                               const Publishers &... others) {
+  return IsSubscribed(publisher) || IsSubscribed(other, others...);
+}
+
+template <typename Message, typename Fill>
+bool ModelPlugin::PublishLazily(const ros::Publisher &publisher,
+                                Message &message, Fill &&fill) {
+  if (!IsSubscribed(publisher)) {
+    return false;
+  }
+  fill(message);
+  PublishCounted(publisher, message);
+  return true;
+}
+
+template <typename Message>
+bool ModelPlugin::PublishLazily(const ros::Publisher &publisher,
+                                const Message &message) {
+  if (!IsSubscribed(publisher)) {
+    return false;
+  }
+  PublishCounted(publisher, message);
+  return true;
+}
 };      // namespace flatland_server
 #endif  // FLATLAND_SERVER_MODEL_PLUGIN_H
@@ -0,0 +1,108 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 model_states_publisher.h
+ * @brief	 Publishes the states of all models of a world in one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_MODEL_STATES_PUBLISHER_H
+#define FLATLAND_SERVER_MODEL_STATES_PUBLISHER_H
+
+#include <flatland_msgs/ModelStates.h>
+#include <ros/ros.h>
+#include <cstdint>
+#include <vector>
+
+namespace flatland_server {
+
+class BodyStates;
+class Model;
+class World;
+
+/**
+ * This class publishes the pose and velocity of the first body of every
+ * model of a world as one flatland_msgs/ModelStates on the model_states
+ * topic of the world, at a fixed rate of simulation time. The states are
+ * gathered from BodyStates, which the get_model_states service uses as well,
+ * instead of a topic or a Box2D query per model
+ */
+class ModelStatesPublisher {
+ public:
+  /**
+   * @brief Constructor, advertises the topic
+   * @param[in] world The world, must outlive the publisher
+   * @param[in] rate Rate of the messages in Hz of simulation time
+   */
+  ModelStatesPublisher(World *world, double rate);
+
+  /**
+   * @brief Publish the states if a message is due and the topic has
+   * subscribers, called by World::Update after each step
+   * @param[in] time Simulation time after the step
+   */
+  void AfterStep(const ros::Time &time);
+
+  /**
+   * @brief Fill a message with the states of the first body of models. The
+   * names already in the message are kept if there are as many as models,
+   * they must be cleared when the models change
+   * @param[in] states The body states of the world of the models
+   * @param[in] models The models, all of them must have bodies
+   * @param[in] time Stamp of the message
+   * @param[out] msg The message, its arrays are resized to the models
+   */
+  static void Collect(const BodyStates &states,
+                      const std::vector<const Model *> &models,
+                      const ros::Time &time, flatland_msgs::ModelStates *msg);
+
+ private:
+  World *world_;             ///< the world
+  double period_;            ///< seconds of simulation time between messages
+  double next_time_ = 0;     ///< simulation time of the next message
+  uint64_t generation_ = 0;  ///< BodyStates::generation_ of models_
+  bool stale_ = true;        ///< if models_ must be rebuilt
+  std::vector<const Model *> models_;  ///< the models with bodies
+  flatland_msgs::ModelStates msg_;     ///< reused between messages
+  ros::Publisher publisher_;           ///< publishes model_states
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_MODEL_STATES_PUBLISHER_H
@@ -0,0 +1,169 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 occupancy_grid.h
+ * @brief	 Packed occupancy grid with grid traversal raycasting
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_OCCUPANCY_GRID_H
+#define FLATLAND_SERVER_OCCUPANCY_GRID_H
+
+#include <Box2D/Box2D.h>
+#include <cstdint>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class stores a bitmap layer as a bit packed occupancy grid and
+ * provides Amanatides-Woo grid traversal raycasting. The grid is expressed
+ * in the frame of the layer body, cell (x, y) covers the square from
+ * (x * resolution, y * resolution) to ((x + 1) * resolution,
+ * (y + 1) * resolution), i.e. y = 0 is the bottom row of the map image
+ */
+class OccupancyGrid {
+ public:
+  /**
+   * @brief Constructor for an empty (free) occupancy grid
+   * @param[in] width Number of cells in x
+   * @param[in] height Number of cells in y
+   * @param[in] resolution Size of each cell in meters
+   */
+  OccupancyGrid(unsigned int width, unsigned int height, double resolution);
+
+  /**
+   * @brief Set the occupancy of a cell
+   * @param[in] x Cell x index, must be within the grid
+   * @param[in] y Cell y index, must be within the grid
+   * @param[in] occupied true for occupied
+   */
+  void SetOccupied(unsigned int x, unsigned int y, bool occupied);
+
+  /**
+   * @brief Get the occupancy of a cell, cells outside of the grid are free
+   * @param[in] x Cell x index
+   * @param[in] y Cell y index
+   * @return true if occupied
+   */
+  bool IsOccupied(int x, int y) const {
+    if (x < 0 || y < 0 || x >= (int)width_ || y >= (int)height_) {
+      return false;
+    }
+    return (bits_[y * words_per_row_ + (x >> 6)] >> (x & 63)) & 1;
+  }
+
+  /**
+   * @return Number of cells in x
+   */
+  unsigned int GetWidth() const { return width_; }
+
+  /**
+   * @return Number of cells in y
+   */
+  unsigned int GetHeight() const { return height_; }
+
+  /**
+   * @return Size of each cell in meters
+   */
+  double GetResolution() const { return resolution_; }
+
+  /**
+   * @return The occupancy bits, row major with (width + 63) / 64 words per
+   * row, bit x % 64 of word x / 64 of a row is cell x
+   */
+  const std::vector<uint64_t> &GetData() const { return bits_; }
+
+  /**
+   * @brief Replace all occupancy bits, in the layout returned by GetData
+   * @param[in] data GetData().size() words
+   */
+  void SetData(const uint64_t *data);
+
+  /**
+   * @brief Compute the exact Euclidean distance of each cell to the nearest
+   * occupied cell, which RayCast then uses to skip through open space in a
+   * few steps instead of visiting every cell. Must be called again after the
+   * occupancy changed
+   */
+  void BuildDistanceField();
+
+  /**
+   * @return true if BuildDistanceField was called
+   */
+  bool HasDistanceField() const { return !distance_.empty(); }
+
+  /**
+   * @brief Get the distance of a cell to the nearest occupied cell, between
+   * the cell centers, rounded down to whole cells, 0 for occupied cells and
+   * MAX_DISTANCE if farther or there is no occupied cell
+   * @param[in] x Cell x index, must be within the grid
+   * @param[in] y Cell y index, must be within the grid
+   * @return The distance in cells, requires BuildDistanceField
+   */
+  unsigned int GetDistance(unsigned int x, unsigned int y) const {
+    return distance_[y * width_ + x];
+  }
+
+  static const unsigned int MAX_DISTANCE = UINT16_MAX;  ///< largest distance
+
+  /**
+   * @brief Cast a ray through the grid. A hit is reported at the first
+   * boundary between occupied and free cells, matching the edges generated
+   * from the bitmap by Layer::LoadFromBitmap
+   * @param[in] p1 Start of the ray in the grid frame
+   * @param[in] p2 End of the ray in the grid frame
+   * @param[out] fraction Fraction of the ray length at the hit point
+   * @return true if the ray hits
+   */
+  bool RayCast(const b2Vec2 &p1, const b2Vec2 &p2, float *fraction) const;
+
+ private:
+  unsigned int width_;          ///< number of cells in x
+  unsigned int height_;         ///< number of cells in y
+  double resolution_;           ///< size of a cell in meters
+  unsigned int words_per_row_;  ///< number of 64 bit words per row
+  std::vector<uint64_t> bits_;  ///< occupancy bits, row major
+  std::vector<uint16_t> distance_;  ///< distance field in cells, row major,
+                                    /// empty if not built
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_OCCUPANCY_GRID_H
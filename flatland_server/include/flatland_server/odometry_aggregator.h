@@ -0,0 +1,136 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 odometry_aggregator.h
+ * @brief	 Collects the odometry of the drive plugins into one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_ODOMETRY_AGGREGATOR_H
+#define FLATLAND_SERVER_ODOMETRY_AGGREGATOR_H
+
+#include <flatland_msgs/FleetJointStates.h>
+#include <flatland_msgs/FleetOdometry.h>
+#include <flatland_msgs/ModelJointStates.h>
+#include <flatland_msgs/RobotOdometry.h>
+#include <ros/ros.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class collects the odometry sent by the drive plugins of all worlds,
+ * and publishes it as one flatland_msgs/FleetOdometry on /fleet_odometry per
+ * cycle of the simulation loop. The joint states of the JointStatePublisher
+ * plugins are batched the same way on /fleet_joint_states. When it is
+ * enabled, the plugins publish their own topics only while they have
+ * subscribers
+ */
+class OdometryAggregator {
+ private:
+  OdometryAggregator();
+
+  static bool enabled_;  ///< see SetEnabled
+
+  /// guards all members below, plugins may send from the threads of the
+  /// worlds
+  std::mutex mutex_;
+  /// index in latest_ by child frame
+  std::unordered_map<std::string, size_t> slots_;
+  std::vector<flatland_msgs::RobotOdometry> latest_;  ///< by slot
+  std::vector<bool> dirty_;  ///< if latest_[i] was sent since the last flush
+  flatland_msgs::FleetOdometry message_;  ///< reused between flushes
+  /// index in latest_joints_ by model
+  std::unordered_map<std::string, size_t> joint_slots_;
+  std::vector<flatland_msgs::ModelJointStates> latest_joints_;  ///< by slot
+  std::vector<bool> dirty_joints_;  ///< see dirty_
+  flatland_msgs::FleetJointStates joints_message_;  ///< see message_
+
+ public:
+  ros::NodeHandle node_;
+  ros::Publisher publisher_;  ///< publishes /fleet_odometry
+  ros::Publisher joints_publisher_;  ///< publishes /fleet_joint_states
+
+  /**
+   * @brief Return the singleton object
+   */
+  static OdometryAggregator& Get();
+
+  /**
+   * @brief Let the drive plugins send their odometry to the aggregator.
+   * Disabled by default, must be called before the plugins are loaded
+   * @param[in] enabled true to enable
+   */
+  static void SetEnabled(bool enabled);
+
+  /**
+   * @return true if the drive plugins send their odometry to the aggregator,
+   * see SetEnabled
+   */
+  static bool IsEnabled();
+
+  /**
+   * @brief Send the odometry of a robot with the next flush, it replaces the
+   * odometry of the same child frame that was not flushed yet
+   * @param[in] odometry The odometry
+   */
+  void Send(const flatland_msgs::RobotOdometry& odometry);
+
+  /**
+   * @brief Send the joint states of a model with the next flush, they replace
+   * the joint states of the same model that were not flushed yet
+   * @param[in] joints The joint states
+   */
+  void Send(const flatland_msgs::ModelJointStates& joints);
+
+  /**
+   * @brief Flush the odometry and the joint states that were sent since the
+   * last flush in one message each, nothing is published if none was sent
+   * @param[in] now The current simulation time
+   */
+  void Publish(const ros::Time& now);
+};
+}
+
+#endif  // FLATLAND_SERVER_ODOMETRY_AGGREGATOR_H
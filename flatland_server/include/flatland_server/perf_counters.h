@@ -0,0 +1,125 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 perf_counters.h
+ * @brief	 Hardware performance counters of the calling thread
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_PERF_COUNTERS_H
+#define FLATLAND_SERVER_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace flatland_server {
+
+/**
+ * This class reads the hardware performance counters of the thread that
+ * opened it through perf_event_open: the CPU cycles, the instructions
+ * retired and the last level cache misses, counted in user space only. The
+ * counters are a group, so they are read together with a single system call.
+ * Linux only, and the kernel may refuse them, e.g. in virtual machines
+ * without a PMU or with kernel.perf_event_paranoid above 2
+ */
+class PerfCounters {
+ public:
+  /// The values of the counters
+  struct Sample {
+    uint64_t cycles = 0;        ///< CPU cycles
+    uint64_t instructions = 0;  ///< instructions retired
+    uint64_t llc_misses = 0;    ///< last level cache misses
+
+    Sample &operator+=(const Sample &other);
+    Sample operator-(const Sample &other) const;
+  };
+
+  PerfCounters();
+
+  /**
+   * @brief Destructor, closes the counters
+   */
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /**
+   * @brief Open and start the counters of the calling thread
+   * @return false if the kernel refused them, see GetError
+   */
+  bool Open();
+
+  /**
+   * @return true if the counters are open
+   */
+  bool IsOpen() const { return fds_[0] >= 0; }
+
+  /**
+   * @return true if called from the thread the counters count
+   */
+  bool IsOwner() const { return std::this_thread::get_id() == owner_; }
+
+  /**
+   * @return Why Open failed
+   */
+  const std::string &GetError() const { return error_; }
+
+  /**
+   * @brief Read the counters, zeros if they are not open
+   * @param[out] sample The values since Open
+   */
+  void Read(Sample *sample) const;
+
+ private:
+  int fds_[3];               ///< the counters, the cycles lead the group
+  uint64_t ids_[3];          ///< ids of the counters in the group reads
+  std::thread::id owner_;    ///< thread counted
+  std::string error_;        ///< see GetError
+
+  /**
+   * @brief Close the counters
+   */
+  void Close();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_PERF_COUNTERS_H
@@ -0,0 +1,261 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_backend.h
+ * @brief	 Interface of the physics engine of a world
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_PHYSICS_BACKEND_H
+#define FLATLAND_SERVER_PHYSICS_BACKEND_H
+
+#include <Box2D/Box2D.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+class PhysicsExecutor;
+
+/**
+ * This class is the physics engine of a world seen through a thin interface:
+ * stepping, the state of the bodies, ray casts, AABB queries and contacts.
+ * The bodies are the flatland bodies, of the models and the layers, and the
+ * geometry is given with the Box2D math types, which other engines map to
+ * their own. Code written against it runs on any backend, Box2DBackend is
+ * the default
+ */
+class PhysicsBackend {
+ public:
+  /// The nearest hit of a ray
+  struct RayHit {
+    Body *body = nullptr;        ///< body hit, nullptr if nothing was hit
+    float fraction = 1;          ///< fraction of the ray at the hit
+    b2Vec2 normal = b2Vec2_zero;  ///< normal of the surface at the hit
+    uint32_t category_bits = 0;  ///< collision category of the surface
+  };
+
+  /// Two bodies in contact
+  struct Contact {
+    Body *body_a;    ///< first body
+    Body *body_b;    ///< second body
+    b2Vec2 normal;   ///< contact normal, from a to b
+    bool touching;   ///< if the shapes touch, not only their bounds
+  };
+
+  /// The state of the engine, to tell where the time of the steps goes
+  struct Stats {
+    int bodies = 0;               ///< bodies
+    int awake_bodies = 0;         ///< dynamic and kinematic bodies awake
+    int fixtures = 0;             ///< fixtures
+    int proxies = 0;              ///< broad phase proxies of all fixtures
+    int static_proxies = 0;       ///< of these, proxies of static fixtures
+    int tree_height = 0;          ///< height of the tree of moving proxies
+    int tree_balance = 0;         ///< largest height difference of siblings
+    float tree_quality = 0;       ///< area of the nodes over the root, >= 1
+    int static_tree_height = 0;   ///< height of the tree of static proxies
+    int contacts = 0;             ///< pairs of overlapping proxies
+    int touching_contacts = 0;    ///< contacts whose shapes touch
+    b2StepStats step = b2StepStats();  ///< islands, TOI events and broad
+                                       /// phase work of the last step
+    uint64_t toi_events = 0;      ///< TOI events of all steps
+  };
+
+  /// Called by QueryAABB with a body and the category of its surface
+  /// overlapping the box, return false to stop the query
+  typedef std::function<bool(Body *, uint32_t)> QueryCallback;
+
+  virtual ~PhysicsBackend() = default;
+
+  /**
+   * @brief Create a backend, throws Exception for unknown names
+   * @param[in] name Name of the backend, see GetBackendNames
+   * @param[in] world The Box2D world the bodies are created in
+   * @return The backend
+   */
+  static std::unique_ptr<PhysicsBackend> Create(const std::string &name,
+                                                b2World *world);
+
+  /**
+   * @return The names of the backends built in
+   */
+  static std::vector<std::string> GetBackendNames();
+
+  /**
+   * @return The name of the backend
+   */
+  virtual std::string GetName() const = 0;
+
+  /**
+   * @brief Set the solver iterations, for the backends with iterations
+   * @param[in] velocity_iterations Velocity iterations per step
+   * @param[in] position_iterations Position iterations per step
+   */
+  virtual void SetIterations(int velocity_iterations,
+                             int position_iterations) = 0;
+
+  /**
+   * @brief Set the number of threads solving a step
+   * @param[in] threads Number of threads, 0 to solve on the calling thread
+   */
+  virtual void SetThreads(unsigned int threads) = 0;
+
+  /**
+   * @brief Advance the simulation
+   * @param[in] step_size Simulated seconds
+   */
+  virtual void Step(double step_size) = 0;
+
+  /**
+   * @return The time spent in the phases of the last step in milliseconds,
+   * zero for the phases the backend does not have
+   */
+  virtual b2Profile GetProfile() const = 0;
+
+  /**
+   * @return The state of the engine, zero for what the backend does not
+   * have. Goes over all bodies and contacts
+   */
+  virtual Stats GetStats() const = 0;
+
+  /**
+   * @return The transform of the origin of a body
+   */
+  virtual b2Transform GetTransform(const Body *body) const = 0;
+
+  /**
+   * @brief Move a body
+   * @param[in] body The body
+   * @param[in] transform The new transform of its origin
+   */
+  virtual void SetTransform(Body *body, const b2Transform &transform) = 0;
+
+  /**
+   * @return The linear velocity of the center of mass of a body
+   */
+  virtual b2Vec2 GetLinearVelocity(const Body *body) const = 0;
+
+  /**
+   * @return The angular velocity of a body
+   */
+  virtual float GetAngularVelocity(const Body *body) const = 0;
+
+  /**
+   * @brief Set the velocity of a body
+   * @param[in] body The body
+   * @param[in] linear Linear velocity of its center of mass
+   * @param[in] angular Angular velocity
+   */
+  virtual void SetVelocity(Body *body, const b2Vec2 &linear,
+                           float angular) = 0;
+
+  /**
+   * @brief Cast rays and find their nearest hits on the non sensor surfaces
+   * in the given categories. Thread safe between steps
+   * @param[in] inputs The rays
+   * @param[in] count Number of rays
+   * @param[in] mask Categories hit
+   * @param[out] hits The hits, count of them
+   */
+  virtual void RayCast(const b2RayCastInput *inputs, unsigned int count,
+                       uint32_t mask, RayHit *hits) const = 0;
+
+  /**
+   * @brief Find the bodies whose non sensor surfaces in the given categories
+   * may overlap a box, a body may be reported more than once. Thread safe
+   * between steps
+   * @param[in] aabb The box
+   * @param[in] mask Categories found
+   * @param[in] callback Called for each surface found
+   */
+  virtual void QueryAABB(const b2AABB &aabb, uint32_t mask,
+                         const QueryCallback &callback) const = 0;
+
+  /**
+   * @brief Get the contacts of the last step
+   * @param[out] contacts The contacts, replaced
+   */
+  virtual void GetContacts(std::vector<Contact> *contacts) const = 0;
+};
+
+/**
+ * The vendored Box2D 2.3, stepping a b2World
+ */
+class Box2DBackend : public PhysicsBackend {
+ public:
+  /**
+   * @param[in] world The Box2D world, not owned
+   */
+  explicit Box2DBackend(b2World *world);
+  ~Box2DBackend();
+
+  std::string GetName() const override { return "box2d"; }
+  void SetIterations(int velocity_iterations,
+                     int position_iterations) override;
+  void SetThreads(unsigned int threads) override;
+  void Step(double step_size) override;
+  b2Profile GetProfile() const override { return world_->GetProfile(); }
+  Stats GetStats() const override;
+  b2Transform GetTransform(const Body *body) const override;
+  void SetTransform(Body *body, const b2Transform &transform) override;
+  b2Vec2 GetLinearVelocity(const Body *body) const override;
+  float GetAngularVelocity(const Body *body) const override;
+  void SetVelocity(Body *body, const b2Vec2 &linear, float angular) override;
+  void RayCast(const b2RayCastInput *inputs, unsigned int count, uint32_t mask,
+               RayHit *hits) const override;
+  void QueryAABB(const b2AABB &aabb, uint32_t mask,
+                 const QueryCallback &callback) const override;
+  void GetContacts(std::vector<Contact> *contacts) const override;
+
+ private:
+  b2World *world_;                ///< the Box2D world
+  int velocity_iterations_ = 10;  ///< see SetIterations
+  int position_iterations_ = 10;  ///< see SetIterations
+  uint64_t toi_events_ = 0;       ///< TOI events of all steps
+  std::unique_ptr<PhysicsExecutor> executor_;  ///< solves the islands in
+                                               /// parallel, null if not
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_PHYSICS_BACKEND_H
@@ -0,0 +1,86 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_executor.h
+ * @brief	 Runs the parallel island solver of Box2D on a task pool
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_PHYSICS_EXECUTOR_H
+#define FLATLAND_SERVER_PHYSICS_EXECUTOR_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/task_pool.h>
+
+namespace flatland_server {
+
+/**
+ * This class lets a Box2D world solve its independent islands on a pool of
+ * threads, see b2World::SetTaskExecutor. Each world needs its own executor
+ * since the pool is not reentrant
+ */
+class PhysicsExecutor : public b2TaskExecutor {
+ public:
+  /**
+   * @brief Constructor
+   * @param[in] num_threads Number of threads in addition to the thread
+   * stepping the world
+   */
+  explicit PhysicsExecutor(unsigned int num_threads);
+
+  /**
+   * @brief Call a Box2D task function for each index in [0, count)
+   * @param[in] fcn The task function
+   * @param[in] context Passed to the task function
+   * @param[in] count Number of calls
+   */
+  void ParallelFor(b2TaskFcn *fcn, void *context, int32 count) override;
+
+  /**
+   * @return Number of threads, including the thread stepping the world
+   */
+  int32 GetThreadCount() const override;
+
+ private:
+  TaskPool pool_;  ///< runs the task functions
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_PHYSICS_EXECUTOR_H
@@ -0,0 +1,173 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_lod.h
+ * @brief	 Lowers the level of detail of models outside regions of interest
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_PHYSICS_LOD_H
+#define FLATLAND_SERVER_PHYSICS_LOD_H
+
+#include <Box2D/Box2D.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatland_server {
+
+class Model;
+class World;
+
+/**
+ * This class lowers the level of detail of the models far from the regions
+ * of interest of a world, e.g. the robots under test in a campus with a
+ * large fleet. Their dynamic bodies become kinematic, so Box2D no longer
+ * solves them nor finds their contacts with the layers and each other, they
+ * either rest or move by their commanded velocities at a reduced rate, and
+ * their plugins are updated at a reduced rate, see
+ * PluginManager::SetReducedUpdateRate. The cost of a step then grows with
+ * the active area instead of the whole fleet. A model entering a region
+ * gets its body types back, and its plugins are updated on every step again
+ */
+class PhysicsLod {
+ public:
+  /// The regions of interest and the level of detail outside of them
+  struct Params {
+    std::vector<std::string> focus;  ///< names of the models the regions
+                                     /// are centered on
+    double radius = 10;              ///< radius of the regions around the
+                                     /// focus models in meters
+    std::vector<b2AABB> regions;     ///< fixed regions of interest
+    double hysteresis = 1;  ///< meters a model must be beyond a region to
+                            /// leave it, so that models near its border do
+                            /// not switch on every step
+    double physics_rate = 0;  ///< rate in Hz at which the models outside
+                              /// move, 0 to freeze them in place
+    double plugin_rate = 1;   ///< rate in Hz of the updates of the plugins
+                              /// of the models outside
+  };
+
+  /**
+   * @brief Constructor
+   * @param[in] world The world, must outlive this object
+   * @param[in] params See Params
+   */
+  PhysicsLod(World *world, const Params &params);
+
+  /**
+   * @brief Reduce the models that left the regions and restore the ones
+   * that entered them, called by World::Update before the plugins. Nothing
+   * is reduced while no focus model exists and there are no fixed regions
+   */
+  void BeforeStep();
+
+  /**
+   * @brief Set the velocities of the reduced bodies for a Box2D step, they
+   * rest unless their catch-up move is due. Called by World::PhysicsStep
+   * @param[in] step_size Seconds of the step
+   */
+  void BeforePhysicsStep(double step_size);
+
+  /**
+   * @brief Give the reduced bodies their commanded velocities back after a
+   * Box2D step, so that the plugins see them. Called by World::PhysicsStep
+   */
+  void AfterPhysicsStep();
+
+  /**
+   * @brief Restore the body types of a model, before it is deleted or
+   * parked
+   * @param[in] model The model
+   */
+  void Remove(Model *model);
+
+  /**
+   * @param[in] model The model
+   * @return If the model is outside the regions of interest
+   */
+  bool IsReduced(const Model *model) const;
+
+  /**
+   * @return The number of models outside the regions of interest
+   */
+  size_t GetReducedCount() const { return reduced_.size(); }
+
+ private:
+  /// A model outside the regions of interest
+  struct Reduced {
+    Model *model;                   ///< the model
+    std::vector<b2Body *> bodies;   ///< its bodies made kinematic
+    std::vector<b2Vec2> linear;     ///< commanded velocities of bodies
+    std::vector<float> angular;     ///< commanded velocities of bodies
+    double pending = 0;  ///< seconds of motion since its last catch-up move
+  };
+
+  /**
+   * @param[in] position Position of a model
+   * @param[in] margin Meters added to the radius and the regions
+   * @return If the position is inside a region of interest
+   */
+  bool InRegion(const b2Vec2 &position, double margin) const;
+
+  /**
+   * @brief Make the dynamic bodies of a model kinematic
+   * @param[in] model The model
+   */
+  void Reduce(Model *model);
+
+  /**
+   * @brief Restore the bodies of a reduced model and forget it
+   * @param[in] i Index of the model in reduced_
+   */
+  void Erase(size_t i);
+
+  World *world_;   ///< the world
+  Params params_;  ///< see Params
+  double period_;  ///< seconds between the moves of the reduced models, 0
+                   /// if they are frozen
+  std::vector<b2Vec2> centers_;  ///< positions of the focus models
+  std::unordered_map<const Model *, size_t>
+      index_;                     ///< indices in reduced_ by model
+  std::vector<Reduced> reduced_;  ///< the reduced models
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_PHYSICS_LOD_H
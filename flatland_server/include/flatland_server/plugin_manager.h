@@ -48,13 +48,29 @@
 #define FLATLAND_PLUGIN_MANAGER_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/contact_event_queue.h>
+#include <flatland_server/gps_batch.h>
+#include <flatland_server/kinematic_animator.h>
 #include <flatland_server/model.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/raster_batch.h>
+#include <flatland_server/sensor_scheduler.h>
+#include <flatland_server/state_exporter.h>
+#include <flatland_server/task_pool.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/world_plugin.h>
 #include <flatland_server/yaml_reader.h>
 #include <pluginlib/class_loader.h>
 #include <yaml-cpp/yaml.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace flatland_server {
 
@@ -63,11 +79,106 @@ class World;
 
 class PluginManager {
  public:
+  /**
+   * Selects the plugins called by BeforePhysicsStep and AfterPhysicsStep,
+   * see FlatlandPlugin::UpdatesPerSubstep
+   */
+  enum class StepPlugins {
+    ALL,      ///< all plugins, the world is not sub-stepped
+    STEP,     ///< the plugins updated once per step
+    SUBSTEP,  ///< the plugins updated per sub-step
+  };
+
+  /// The cost of a plugin, or of all plugins of a type
+  struct CostEntry {
+    std::string name;  ///< <model>/<plugin> for model plugins, empty per type
+    std::string type;  ///< type of the plugin(s)
+    unsigned int instances;  ///< number of plugins summed
+    PluginCost cost;         ///< the cost
+  };
+
+  /// A model plugin created by PrepareModelPlugin, not initialized yet
+  struct PreparedPlugin {
+    std::string name;    ///< name of the plugin
+    std::string type;    ///< type of the plugin
+    YAML::Node config;   ///< parameters of the plugin
+    boost::shared_ptr<ModelPlugin> plugin;  ///< nullptr if disabled
+    double update_phase = 0;  ///< the update_phase parameter
+    std::string config_key;   ///< see ModelPlugin::config_key_
+  };
+
+  /// The plugins called by a step callback, see FlatlandPlugin::StepCallback
+  struct StepDispatch {
+    std::vector<ModelPlugin *> plugins;  ///< model plugins, in order
+    /// with SetNumThreads, the thread safe model plugins, by model
+    std::vector<std::vector<ModelPlugin *>> parallel_groups;
+    std::vector<ModelPlugin *> serial_plugins;  ///< the other model plugins
+    std::vector<WorldPlugin *> world_plugins;   ///< world plugins, in order
+  };
+
+  /// The next update of a model plugin with an update rate
+  struct ScheduledUpdate {
+    double time;          ///< time of the update, in seconds
+    int64_t count;        ///< the update is the count-th of the plugin
+    ModelPlugin *plugin;  ///< the plugin
+  };
+
   std::vector<boost::shared_ptr<ModelPlugin>> model_plugins_;
   pluginlib::ClassLoader<flatland_server::ModelPlugin> *model_plugin_loader_;
+  /// the parameters of the plugins by PreparedPlugin::config_key, shared by
+  /// the instances of a model template
+  std::map<std::string, YAML::Node> template_configs_;
+  std::mutex template_configs_mutex_;  ///< guards template_configs_
+  std::mutex model_plugin_loader_mutex_;  ///< plugins may be prepared on
+                                          /// other threads
 
   std::vector<boost::shared_ptr<WorldPlugin>> world_plugins_;
   pluginlib::ClassLoader<flatland_server::WorldPlugin> *world_plugin_loader_;
+
+  SensorScheduler sensor_scheduler_;  ///< batches the rays of all sensors
+  BodyStates body_states_;  ///< states of the model bodies, maintained by
+                            /// the world
+  GpsBatch gps_batch_;      ///< converts the fixes of all GPS receivers
+  RasterBatch raster_batch_;  ///< renders the top down views of the plugins
+  KinematicAnimator kinematic_animator_;  ///< moves the animated bodies
+  std::unique_ptr<StateExporter> state_exporter_;  ///< exports the world
+                                                   /// state, null if disabled
+  std::unique_ptr<TaskPool> pool_;  ///< runs the thread safe model plugins,
+                                    /// nullptr to run all plugins in order
+  StepDispatch before_dispatch_;  ///< plugins overriding BeforePhysicsStep
+  StepDispatch after_dispatch_;   ///< plugins overriding AfterPhysicsStep
+  StepDispatch contact_dispatch_;  ///< plugins overriding ContactEvents
+  std::atomic<bool> groups_dirty_{true};  ///< if the dispatch lists must be
+                                          /// rebuilt, set by the plugins
+                                          /// found not to override a step
+                                          /// callback, possibly in parallel
+  std::unordered_map<const Entity *, std::vector<size_t>>
+      contact_plugins_;  ///< indices in model_plugins_ by model, the plugins
+                         /// receiving the contacts of the model
+  std::vector<size_t> all_contact_plugins_;  ///< indices of the plugins
+                                             /// receiving all contacts
+  std::vector<size_t> contact_targets_;  ///< plugins called for a contact
+  bool contacts_dirty_ = true;  ///< if contact_plugins_ must be rebuilt
+  ContactEventQueue contact_queue_;  ///< events of the current physics
+                                     /// step, see SetDeferredContacts
+  uint64_t reported_drops_ = 0;  ///< contact events dropped when last warned
+  std::vector<ScheduledUpdate> schedule_;  ///< min-heap by time of the
+                                           /// plugins with an update rate
+  std::vector<ModelPlugin *> due_plugins_;  ///< scheduled plugins updated on
+                                            /// the current step
+  std::vector<ModelPlugin *> skipped_plugins_;  ///< plugins skipped on the
+                                                /// current step since their
+                                                /// model is asleep or reduced
+  double sleeping_period_ = 0;  ///< period of the updates of the plugins of
+                                /// sleeping models, 0 to not skip them
+  double reduced_period_ = 0;   ///< period of the updates of the plugins of
+                                /// reduced models, 0 to not skip them
+  double schedule_time_ = 0;    ///< time of the last scheduled step
+  bool stagger_updates_ = false;  ///< see SetStaggerUpdates
+  b2World *pipelined_world_ = nullptr;  ///< see SetPipelinedSensing
+  uint32_t degradations_ = 0;     ///< see SetDegradations
+  bool schedule_dirty_ = true;  ///< if schedule_ must be rebuilt
+  bool profiling_ = false;    ///< if the cost of the plugins is measured
   /**
    * @brief Plugin manager constructor
    */
@@ -79,16 +190,165 @@ class PluginManager {
   ~PluginManager();
 
   /**
-   * @brief This method is called before the Box2D physics step
+   * @brief Run the model plugins that are thread safe, see
+   * FlatlandPlugin::IsThreadSafe, in parallel. The plugins of one model run
+   * in order on the same thread, the other model plugins run in order once
+   * all thread safe plugins are done, followed by the world plugins
+   * @param[in] num_threads Number of threads besides the simulation thread,
+   * 0 runs all plugins in order on the simulation thread
+   */
+  void SetNumThreads(unsigned int num_threads);
+
+  /**
+   * @brief Record the begin contact, end contact and postsolve events of the
+   * physics steps for the plugins overriding FlatlandPlugin::ContactEvents,
+   * which DeliverContactEvents passes to them after each step. The other
+   * contact callbacks are still called during the step. Disabled by default
+   * @param[in] capacity Maximum number of events recorded on a step, the
+   * oldest are dropped beyond it, 0 to disable
+   */
+  void SetDeferredContacts(size_t capacity);
+
+  /**
+   * @brief Pass the contact events recorded during the last physics step to
+   * the plugins of the models involved, and to the plugins receiving all
+   * contacts, see FlatlandPlugin::ContactEvents. The thread safe plugins run
+   * in parallel per model like the step callbacks, see SetNumThreads. Called
+   * by the world after each Box2D step
+   */
+  void DeliverContactEvents();
+
+  /**
+   * @brief Rebuild the dispatch lists of the step callbacks if the plugins
+   * changed, or some were found not to override a step callback
+   */
+  void UpdateDispatch();
+
+  /**
+   * @brief Call a function for each model plugin of a dispatch list, in
+   * parallel if enabled by SetNumThreads, returns once all calls are done
+   * @param[in] dispatch The plugins, before_dispatch_ or after_dispatch_
+   * @param[in] func The function
+   */
+  void CallModelPlugins(const StepDispatch &dispatch,
+                        const std::function<void(ModelPlugin *)> &func);
+
+  /**
+   * @brief Enable or disable measuring the wall time spent in the step and
+   * contact callbacks of each plugin, accumulated in FlatlandPlugin::cost_.
+   * Disabled by default, since it reads the clock around every callback
+   * @param[in] profiling true to enable
+   */
+  void SetProfiling(bool profiling) { profiling_ = profiling; }
+  bool IsProfiling() const { return profiling_; }
+
+  /**
+   * @brief Rank the loaded plugins by their total cost, must not be called
+   * while the plugins are stepped
+   * @param[in] count Maximum number of plugins returned, 0 for all
+   * @return The most costly plugins first
+   */
+  std::vector<CostEntry> GetPluginCosts(size_t count = 0) const;
+
+  /**
+   * @brief Rank the plugin types by the total cost of their loaded plugins
+   * @param[in] count Maximum number of types returned, 0 for all
+   * @return The most costly types first
+   */
+  std::vector<CostEntry> GetPluginTypeCosts(size_t count = 0) const;
+
+  /**
+   * @brief Clear the cost of all loaded plugins
+   */
+  void ResetCosts();
+
+  /**
+   * @brief Mark the model plugins with an update rate whose update is due on
+   * a step, see ModelPlugin::SetUpdateRate. The schedule is a min-heap of the
+   * next update of each plugin, so only the due plugins are visited
+   * @param[in] timekeeper The time of the step
+   */
+  void ScheduleUpdates(const Timekeeper &timekeeper);
+
+  /**
+   * @brief Offset the updates of each model plugin loaded afterwards by a
+   * fraction of its update period, see ModelPlugin::StaggerFraction, so that
+   * e.g. the lasers of many robots with the same rate are not all updated on
+   * the same step. Applies to the plugins scheduled by
+   * ModelPlugin::SetUpdateRate and those passing update_stagger_ to their
+   * UpdateTimer. Disabled by default
+   * @param[in] stagger true to enable
+   */
+  void SetStaggerUpdates(bool stagger);
+
+  /**
+   * @brief Cast the rays of the sensors while the physics step runs, on a
+   * snapshot of the world taken at the end of BeforePhysicsStep. The scans
+   * keep the time of the step they were taken on, but are published after
+   * the step, in AfterPhysicsStep. Only applies to the steps without
+   * sub-steps. Disabled by default
+   * @param[in] world The world to snapshot, nullptr to disable
+   */
+  void SetPipelinedSensing(b2World *world);
+
+  /**
+   * @brief Cast the rays of the sensors that describe them (Laser) on a GPU,
+   * see GpuRaycaster. Stays on the CPU if there is no GPU or flatland_server
+   * is built without GPU_RAYCAST
+   * @param[in] world The world to cast rays against
+   */
+  void SetGpuRaycasting(b2World *world);
+
+  /**
+   * @brief Pass the active degradations of the step budget to the model
+   * plugins, see ModelPlugin::SetDegradations, including those loaded
+   * afterwards. Must not be called while the plugins are stepped
+   * @param[in] degradations Or'ed StepBudgetGovernor::Degradation flags
+   */
+  void SetDegradations(uint32_t degradations);
+
+  /**
+   * @brief Skip the plugins returning true from ModelPlugin::SkipsWhileAsleep
+   * while their model is asleep, they are only updated at a lower rate then
+   * @param[in] rate Rate in Hz of their updates while asleep, 0 (default)
+   * to never skip them
+   */
+  void SetSleepingUpdateRate(double rate);
+
+  /**
+   * @brief Skip the plugins of the models outside the regions of interest of
+   * the PhysicsLod of the world, see Model::lod_reduced_, they are only
+   * updated at a lower rate then. Unlike SetSleepingUpdateRate, this applies
+   * to all plugins not updated per sub-step
+   * @param[in] rate Rate in Hz of their updates while reduced, 0 (default)
+   * to never skip them
+   */
+  void SetReducedUpdateRate(double rate);
+
+  /**
+   * @brief Unmark the due plugins to skip on a step since their model is
+   * asleep or reduced, see SetSleepingUpdateRate and SetReducedUpdateRate,
+   * after ScheduleUpdates marked them
+   * @param[in] timekeeper The time of the step
+   */
+  void SkipThrottledPlugins(const Timekeeper &timekeeper);
+
+  /**
+   * @brief This method is called before the Box2D physics step, the rays
+   * submitted by the plugins are cast once all plugins have been called
    * @param[in] timekeeper provide time related information
+   * @param[in] plugins The plugins to call
    */
-  void BeforePhysicsStep(const Timekeeper &timekeeper);
+  void BeforePhysicsStep(const Timekeeper &timekeeper,
+                         StepPlugins plugins = StepPlugins::ALL);
 
   /**
    * @brief This method is called after the Box2D physics step
    * @param[in] timekeeper provide time related information
+   * @param[in] plugins The plugins to call
    */
-  void AfterPhysicsStep(const Timekeeper &timekeeper);
+  void AfterPhysicsStep(const Timekeeper &timekeeper,
+                        StepPlugins plugins = StepPlugins::ALL);
 
   /**
    * @brief This method removes all model plugins associated with a given mode
@@ -104,6 +364,28 @@ class PluginManager {
    */
   void LoadModelPlugin(Model *model, YamlReader &plugin_reader);
 
+  /**
+   * @brief Parse a model plugin and create its instance, the part of
+   * LoadModelPlugin which may run on another thread than the simulation
+   * @param[in] model_name Name of the model the plugin will be tied to
+   * @param[in] plugin_reader The YAML reader with node containing the plugin
+   * parameter
+   * @param[in] config_key Identifies the plugin in the model template it was
+   * read from, see ModelPlugin::config_key_, empty if it has no template. The
+   * plugins with the same key share their parameters
+   * @return The plugin, to add by AddModelPlugin
+   */
+  PreparedPlugin PrepareModelPlugin(const std::string &model_name,
+                                    YamlReader &plugin_reader,
+                                    const std::string &config_key = "");
+
+  /**
+   * @brief Initialize a plugin created by PrepareModelPlugin and add it
+   * @param[in] model The model that this plugin is tied to
+   * @param[in] prepared The plugin
+   */
+  void AddModelPlugin(Model *model, PreparedPlugin &prepared);
+
   /*
    * @brief load world plugins
    * @param[in] world, the world that thsi plugin is tied to
@@ -113,6 +395,36 @@ class PluginManager {
   void LoadWorldPlugin(World *world, YamlReader &plugin_reader,
                        YamlReader &world_config);
 
+  /**
+   * @brief Find the plugins receiving the contacts of two fixtures, in the
+   * order they were loaded, and store them in contact_targets_
+   * @param[in] fixture_a First fixture of the contact
+   * @param[in] fixture_b Second fixture of the contact
+   */
+  void FindContactTargets(b2Fixture *fixture_a, b2Fixture *fixture_b);
+
+  /**
+   * @brief Record a contact event during the physics step if a plugin found
+   * by the last FindContactTargets overrides FlatlandPlugin::ContactEvents
+   * @param[in] type The callback
+   * @param[in] contact Box2D contact
+   * @param[in] impulse The impulse of a postsolve, nullptr otherwise
+   */
+  void RecordContact(ContactEvent::Type type, b2Contact *contact,
+                     const b2ContactImpulse *impulse = nullptr);
+
+  /**
+   * @brief Call a contact callback of the plugins of the models owning the
+   * fixtures of a contact, and of the plugins receiving all contacts, in the
+   * order the plugins were loaded. The plugins not overriding the callback
+   * are skipped
+   * @param[in] contact Box2D contact
+   * @param[in] callback The callback, see FlatlandPlugin::ContactCallback
+   * @param[in] call Calls the callback of a plugin
+   */
+  template <class Call>
+  void DispatchContact(b2Contact *contact, uint8_t callback, const Call &call);
+
   /**
    * @brief Method called for a box2D begin contact
    * @param[in] contact Box2D contact information
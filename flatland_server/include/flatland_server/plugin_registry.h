@@ -0,0 +1,140 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 plugin_registry.h
+ * @brief	 Registry of statically linked plugin factories
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_PLUGIN_REGISTRY_H
+#define FLATLAND_SERVER_PLUGIN_REGISTRY_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace flatland_server {
+
+/**
+ * This class holds the factories of the plugins of a base class (ModelPlugin
+ * or WorldPlugin) by their full type name, e.g. "flatland_plugins::Laser".
+ * The PluginManager creates the plugins found here directly, and only goes
+ * through pluginlib for the others. A plugin library adds its types with
+ * FLATLAND_REGISTER_PLUGIN when it is linked in, or when pluginlib first
+ * loads it, so only the first instance of a library is loaded by pluginlib
+ */
+template <class Base>
+class PluginRegistry {
+ public:
+  typedef Base *(*Factory)();
+
+  /**
+   * @brief Add a factory, replaces the factory of the same type if any
+   * @param[in] type Full type name of the plugin
+   * @param[in] factory Creates a plugin of the type
+   */
+  static void Register(const std::string &type, Factory factory);
+
+  /**
+   * @brief Remove a factory, e.g. when its library is unloaded, nothing is
+   * done if the type has a different factory
+   * @param[in] type Full type name of the plugin
+   * @param[in] factory The factory added for the type
+   */
+  static void Unregister(const std::string &type, Factory factory);
+
+  /**
+   * @param[in] type Full type name of the plugin
+   * @return The factory of the type, nullptr if none
+   */
+  static Factory Find(const std::string &type);
+
+ private:
+  /**
+   * @return The mutex guarding the factories, constructed on first use since
+   * the registrars of other translation units may run first
+   */
+  static std::mutex &Mutex();
+
+  /**
+   * @return The factories by type, constructed on first use
+   */
+  static std::map<std::string, Factory> &Factories();
+};
+
+/**
+ * Adds a factory to the PluginRegistry for as long as it exists, see
+ * FLATLAND_REGISTER_PLUGIN
+ */
+template <class Base, class Derived>
+class PluginRegistrar {
+ public:
+  /**
+   * @param[in] type Full type name of the plugin
+   */
+  explicit PluginRegistrar(const char *type) : type_(type) {
+    PluginRegistry<Base>::Register(type_, &Create);
+  }
+
+  ~PluginRegistrar() { PluginRegistry<Base>::Unregister(type_, &Create); }
+
+ private:
+  std::string type_;  ///< full type name of the plugin
+
+  static Base *Create() { return new Derived(); }
+};
+};  // namespace flatland_server
+
+#define FLATLAND_REGISTER_PLUGIN_CONCAT(a, b) a##b
+#define FLATLAND_REGISTER_PLUGIN_NAME(line) \
+  FLATLAND_REGISTER_PLUGIN_CONCAT(flatland_plugin_registrar_, line)
+
+/**
+ * Add a plugin class to the PluginRegistry of its base class, next to its
+ * PLUGINLIB_EXPORT_CLASS, the class must be given with its namespace
+ */
+#define FLATLAND_REGISTER_PLUGIN(Derived, Base)                     \
+  namespace {                                                       \
+  const flatland_server::PluginRegistrar<Base, Derived>             \
+      FLATLAND_REGISTER_PLUGIN_NAME(__LINE__)(#Derived);            \
+  }
+
+#endif  // FLATLAND_SERVER_PLUGIN_REGISTRY_H
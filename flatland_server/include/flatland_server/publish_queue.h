@@ -0,0 +1,155 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 publish_queue.h
+ * @brief	 Publishes the messages of the plugins on dedicated threads
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLATLAND_SERVER_PUBLISH_QUEUE_H
+#define FLATLAND_SERVER_PUBLISH_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class is a process wide queue of messages to publish, drained by
+ * dedicated publisher threads, so that the plugins hand their messages over
+ * instead of serializing them on the simulation thread. Each topic is always
+ * published by the same thread, in the order of its messages. When a topic
+ * builds a backlog, e.g. because a slow subscriber holds its thread, its
+ * oldest messages are dropped in favour of the newer ones. The messages are
+ * posted through PublishCounted, see counted_publish.h. Disabled by default
+ */
+class PublishQueue {
+ public:
+  /**
+   * @brief Return the singleton object
+   */
+  static PublishQueue &Get();
+
+  /**
+   * @return true if the messages are posted to the queue, see Start
+   */
+  static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Start the publisher threads, the messages posted from now on are
+   * published by them. Does nothing if already started
+   * @param[in] num_threads Number of publisher threads, at least 1
+   * @param[in] depth Messages of a topic waiting at most, the oldest ones are
+   * dropped beyond that, at least 1
+   */
+  void Start(unsigned int num_threads, size_t depth);
+
+  /**
+   * @brief Publish the messages waiting and stop the threads, the messages
+   * are published by the caller again
+   */
+  void Stop();
+
+  /**
+   * @brief Post a message to publish
+   * @param[in] topic Name of the topic, which selects the thread
+   * @param[in] publish Publishes the message, it owns the message
+   */
+  void Post(const std::string &topic, std::function<void()> publish);
+
+  /**
+   * @brief Block until the messages posted so far are published, e.g. before
+   * replying to a step request
+   */
+  void Flush();
+
+  /**
+   * @return The number of messages dropped because of a backlog
+   */
+  uint64_t GetCoalescedCount() const { return coalesced_; }
+
+ private:
+  /// The messages waiting by topic
+  typedef std::map<std::string, std::deque<std::function<void()>>> Pending;
+
+  /**
+   * A publisher thread with its messages
+   */
+  struct Worker {
+    std::mutex mutex;                  ///< guards the members below
+    std::condition_variable pending_cv;  ///< signaled when a message waits
+    std::condition_variable idle_cv;   ///< signaled when a batch is done
+    Pending pending;                   ///< messages not yet taken
+    bool busy = false;                 ///< if publishing a batch
+    bool stopping = false;             ///< if the thread must exit
+    std::thread thread;                ///< the publisher thread
+  };
+
+  static std::atomic<bool> enabled_;  ///< if started
+  std::mutex start_mutex_;            ///< guards Start and Stop
+  std::vector<std::unique_ptr<Worker>> workers_;  ///< publisher threads
+  size_t depth_;                      ///< messages waiting per topic at most
+  std::atomic<uint64_t> coalesced_;   ///< messages dropped
+
+  /**
+   * @brief Private constructor for the singleton
+   */
+  PublishQueue();
+
+  /**
+   * @brief Body of a publisher thread
+   * @param[in] worker The worker of the thread
+   * @param[in] index Index of the thread, for its name in the trace
+   */
+  void WorkerLoop(Worker *worker, unsigned int index);
+};
+};  // namespace flatland_server
+
+#endif  // FLATLAND_SERVER_PUBLISH_QUEUE_H
@@ -0,0 +1,163 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 raster_batch.h
+ * @brief	 Renders the egocentric top down images of all robots at once
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_RASTER_BATCH_H
+#define FLATLAND_SERVER_RASTER_BATCH_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/types.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace flatland_server {
+
+class Body;
+class Entity;
+
+/**
+ * This class renders egocentric top down images of the geometry around
+ * bodies, for all views requested on a step in one pass over the sensor
+ * executor, one view per task. Each view queries the Box2D broadphase for
+ * its window only, so with tiled layers only the active tiles around the
+ * models are drawn from
+ */
+class RasterBatch {
+ public:
+  static const uint8_t FREE = 0;       ///< value of empty pixels
+  static const uint8_t DYNAMIC = 127;  ///< value of pixels of moving bodies
+  static const uint8_t STATIC = 255;   ///< value of pixels of static bodies
+
+  /**
+   * The parameters of a view. The body faces the top of the image and its
+   * left is the left of the image, the origin of the view is at the center
+   */
+  struct Params {
+    const Body *body = nullptr;    ///< body the view is attached to
+    Pose origin;                   ///< view frame in the body frame
+    double resolution = 0.05;      ///< size of a pixel in meters
+    unsigned int width = 0;        ///< pixels from left to right
+    unsigned int height = 0;       ///< pixels from top to bottom
+    uint32_t layers_bits = 0;      ///< category bits of the fixtures drawn
+    const Entity *ignore = nullptr;  ///< entity not drawn, e.g. own model
+  };
+
+  /**
+   * @brief Add a view, thread safe
+   * @param[in] params The parameters of the view
+   * @return Id of the view
+   */
+  int Add(const Params &params);
+
+  /**
+   * @brief Remove a view, its id may be reused by the next Add. Thread safe
+   * @param[in] id Id of the view, nothing happens for -1
+   */
+  void Remove(int id);
+
+  /**
+   * @brief Render a view on the next Render, thread safe
+   * @param[in] id Id of the view
+   * @param[in] done Called once the image is rendered, on the thread calling
+   * Render
+   */
+  void Request(int id, const std::function<void()> &done);
+
+  /**
+   * @brief Render the requested views in parallel, then call their done
+   * callbacks in the order of the requests
+   */
+  void Render();
+
+  /**
+   * @brief Get the image of a view, row major from the top left pixel. Not
+   * thread safe with Add
+   * @param[in] id Id of the view
+   * @return The width * height pixels rendered by the last Render that
+   * requested the view, they do not move until the view is removed
+   */
+  const uint8_t *GetImage(int id) const { return views_[id].image.data(); }
+
+  /**
+   * @return Number of views
+   */
+  size_t Size() const { return size_; }
+
+  /**
+   * @brief Draw the fixtures around a view into its image
+   * @param[in] world The physics world
+   * @param[in] view Transform of the view frame in the world
+   * @param[in] params The parameters of the view, the body is not used
+   * @param[out] image The image, width * height pixels, cleared first
+   */
+  static void Rasterize(b2World *world, const b2Transform &view,
+                        const Params &params, uint8_t *image);
+
+ private:
+  /// A view added by Add
+  struct View {
+    Params params;               ///< the parameters
+    std::vector<uint8_t> image;  ///< the latest image
+    bool used = false;           ///< false once removed
+  };
+
+  /// A view to render on the next Render
+  struct Job {
+    int id;                      ///< the view
+    std::function<void()> done;  ///< called once rendered
+  };
+
+  std::mutex mutex_;         ///< guards the members below
+  std::vector<View> views_;  ///< the views by id
+  std::vector<int> free_;    ///< removed ids
+  size_t size_ = 0;          ///< number of views
+  std::vector<Job> jobs_;    ///< requested since the last Render
+  std::vector<Job> rendering_;  ///< jobs of the current Render, swapped with
+                                /// jobs_ so that both keep their capacity
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_RASTER_BATCH_H
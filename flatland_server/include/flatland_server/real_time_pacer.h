@@ -0,0 +1,109 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 real_time_pacer.h
+ * @brief	 Paces the simulation loop to a target real time factor
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_REAL_TIME_PACER_H
+#define FLATLAND_SERVER_REAL_TIME_PACER_H
+
+namespace flatland_server {
+
+/**
+ * This class paces the simulation loop so that the simulation time advances
+ * at a target factor of the wall clock time. Unlike a fixed rate, it tracks
+ * the simulation time actually achieved: the loop sleeps while it is ahead,
+ * and runs several steps per cycle while it is behind. The times are in
+ * seconds, from any clock that does not jump
+ */
+class RealTimePacer {
+ public:
+  /**
+   * @param[in] target_factor Simulated seconds per wall clock second, > 0
+   * @param[in] max_steps_per_cycle Most steps run back to back to catch up,
+   * at least 1
+   * @param[in] max_lag Wall clock seconds the simulation may fall behind
+   * before the lag is dropped instead of caught up
+   */
+  RealTimePacer(double target_factor, unsigned int max_steps_per_cycle = 1,
+                double max_lag = 0.5);
+
+  /**
+   * @brief Set the reference the target simulation time is measured from
+   * @param[in] wall_time The current wall time
+   * @param[in] sim_time The current simulation time
+   */
+  void Reset(double wall_time, double sim_time);
+
+  /**
+   * @brief Compute the next cycle
+   * @param[in] wall_time The current wall time
+   * @param[in] sim_time The current simulation time
+   * @param[in] step_size Simulation time of a step
+   * @param[out] sleep Wall time to sleep before stepping, 0 if behind
+   * @return The number of steps to run after sleeping, at least 1
+   */
+  unsigned int NextCycle(double wall_time, double sim_time, double step_size,
+                         double *sleep);
+
+  /**
+   * @return The target real time factor
+   */
+  double GetTargetFactor() const { return target_factor_; }
+
+  /**
+   * @return The number of times the simulation fell behind by more than
+   * max_lag and dropped the lag
+   */
+  unsigned int GetSlipCount() const { return slips_; }
+
+ private:
+  double target_factor_;              ///< target sim time per wall time
+  unsigned int max_steps_per_cycle_;  ///< most steps per cycle
+  double max_lag_;             ///< wall time the simulation may fall behind
+  double reference_wall_;      ///< wall time of the reference
+  double reference_sim_;       ///< sim time of the reference
+  unsigned int slips_;         ///< times the lag was dropped
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_REAL_TIME_PACER_H
@@ -0,0 +1,269 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 recorded_subscriber.h
+ * @brief	 Subscribes to topics through the recorder
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_RECORDED_SUBSCRIBER_H
+#define FLATLAND_SERVER_RECORDED_SUBSCRIBER_H
+
+#include <flatland_server/command_latency.h>
+#include <flatland_server/command_queue.h>
+#include <flatland_server/recorder.h>
+#include <boost/function.hpp>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * @brief Serialize a ROS message or service request for the Recorder
+ * @param[in] msg The message
+ * @return The serialized message
+ */
+template <class M>
+std::vector<uint8_t> SerializeMessage(const M &msg) {
+  std::vector<uint8_t> data(ros::serialization::serializationLength(msg));
+  ros::serialization::OStream stream(data.data(), data.size());
+  ros::serialization::serialize(stream, msg);
+  return data;
+}
+
+/**
+ * @brief Deserialize a message serialized by SerializeMessage
+ * @param[in] data The serialized message
+ * @param[out] msg The message
+ */
+template <class M>
+void DeserializeMessage(const std::vector<uint8_t> &data, M *msg) {
+  ros::serialization::IStream stream(const_cast<uint8_t *>(data.data()),
+                                     data.size());
+  ros::serialization::deserialize(stream, *msg);
+}
+
+/**
+ * This class subscribes to a topic through the Recorder: the received
+ * messages are recorded, and while replaying, the recorded messages are
+ * passed to the callback on the steps they were received at, instead of the
+ * received ones. The messages are passed through the CommandQueue
+ */
+class RecordedSubscriber {
+ public:
+  RecordedSubscriber() = default;
+  RecordedSubscriber(const RecordedSubscriber &) = delete;
+  RecordedSubscriber &operator=(const RecordedSubscriber &) = delete;
+
+  /**
+   * @brief Destructor, unsubscribes
+   */
+  ~RecordedSubscriber() { Shutdown(); }
+
+  /**
+   * @brief Subscribe to a topic, replaces the previous subscription
+   * @param[in] nh Node handle resolving the topic
+   * @param[in] topic The topic
+   * @param[in] queue_size Size of the subscriber queue
+   * @param[in] callback Member function called with the messages
+   * @param[in] obj Object the callback is called on, must outlive the
+   * subscription
+   */
+  template <class M, class T>
+  void Subscribe(ros::NodeHandle &nh, const std::string &topic,
+                 uint32_t queue_size, void (T::*callback)(const M &),
+                 T *obj) {
+    Shutdown();
+    std::string channel = "topic:" + nh.resolveName(topic);
+
+    // a message received while unsubscribing may be applied after, it is
+    // dropped once the subscription it came from is shut down
+    subscribed_ = std::make_shared<bool>(true);
+    std::weak_ptr<bool> subscribed = subscribed_;
+    boost::function<void(const boost::shared_ptr<M const> &)> receive =
+        [channel, callback, obj,
+         subscribed](const boost::shared_ptr<M const> &msg) {
+          if (Recorder::Get().IsReplaying()) return;  // replaced by recording
+          double received = CommandLatency::Now();
+          CommandQueue::Get().Post(
+              [channel, callback, obj, subscribed, msg, received]() {
+                if (subscribed.expired()) return;
+                Recorder &recorder = Recorder::Get();
+                if (recorder.IsRecording()) {
+                  recorder.Record(channel, SerializeMessage(*msg));
+                }
+                ReceiveTime() = received;
+                (obj->*callback)(*msg);
+                ReceiveTime() = 0;
+              });
+        };
+    subscriber_ = nh.subscribe<M>(topic, queue_size, receive);
+    handler_ = Recorder::Get().AddHandler(
+        channel, [callback, obj](const std::vector<uint8_t> &data) {
+          M msg;
+          DeserializeMessage(data, &msg);
+          (obj->*callback)(msg);
+        });
+  }
+
+  /**
+   * @brief Unsubscribe
+   */
+  void Shutdown() {
+    subscriber_.shutdown();
+    subscribed_.reset();
+    Recorder::Get().RemoveHandler(handler_);
+    handler_ = 0;
+  }
+
+  /**
+   * @return The ROS subscriber
+   */
+  const ros::Subscriber &GetSubscriber() const { return subscriber_; }
+
+  /**
+   * @return The time the message handled by the running callback was
+   * received by the subscriber, on the clock of CommandLatency::Now. 0 for
+   * replayed messages and outside of the callbacks
+   */
+  static double GetReceiveTime() { return ReceiveTime(); }
+
+ private:
+  /**
+   * @return The time returned by GetReceiveTime, the callbacks are called by
+   * the CommandQueue on the simulation thread
+   */
+  static double &ReceiveTime() {
+    static double time = 0;
+    return time;
+  }
+
+  ros::Subscriber subscriber_;  ///< the subscription to the topic
+  unsigned int handler_ = 0;    ///< id of the replay handler
+  std::shared_ptr<bool> subscribed_;  ///< expires when unsubscribed
+};
+
+/**
+ * This class advertises a service of a plugin through the Recorder, like
+ * ServiceManager::AdvertiseRecorded: the calls are applied through the
+ * CommandQueue, i.e. between steps when the callbacks are served by an
+ * AsyncSpinner, and recorded when applied. While replaying, the calls are
+ * refused and the recorded ones are applied on the steps they were made at
+ */
+class RecordedService {
+ public:
+  RecordedService() = default;
+  RecordedService(const RecordedService &) = delete;
+  RecordedService &operator=(const RecordedService &) = delete;
+
+  /**
+   * @brief Destructor, stops advertising
+   */
+  ~RecordedService() { Shutdown(); }
+
+  /**
+   * @brief Advertise a service, replaces the previous one
+   * @param[in] nh Node handle resolving the service
+   * @param[in] service Name of the service
+   * @param[in] callback Member function serving the calls
+   * @param[in] obj Object the callback is called on, must outlive the
+   * service
+   */
+  template <class Req, class Res, class T>
+  void Advertise(ros::NodeHandle &nh, const std::string &service,
+                 bool (T::*callback)(Req &, Res &), T *obj) {
+    Shutdown();
+    std::string channel = "service:" + nh.resolveName(service);
+
+    // a call waiting in the queue while stopping is not applied after
+    advertised_ = std::make_shared<bool>(true);
+    std::weak_ptr<bool> advertised = advertised_;
+    boost::function<bool(Req &, Res &)> call = [channel, callback, obj,
+                                                advertised](Req &request,
+                                                            Res &response) {
+      Recorder &recorder = Recorder::Get();
+      if (recorder.IsReplaying()) {
+        ROS_WARN_NAMED("RecordedService", "Refused %s call while replaying",
+                       channel.c_str());
+        return false;
+      }
+
+      bool result = false;
+      bool applied = CommandQueue::Get().Call([&]() {
+        if (advertised.expired()) return;
+        if (recorder.IsRecording()) {
+          recorder.Record(channel, SerializeMessage(request));
+        }
+        result = (obj->*callback)(request, response);
+      });
+      return applied && result;
+    };
+    server_ = nh.advertiseService(service, call);
+    handler_ = Recorder::Get().AddHandler(
+        channel, [callback, obj](const std::vector<uint8_t> &data) {
+          Req request;
+          Res response;
+          DeserializeMessage(data, &request);
+          (obj->*callback)(request, response);
+        });
+  }
+
+  /**
+   * @brief Stop advertising
+   */
+  void Shutdown() {
+    server_.shutdown();
+    advertised_.reset();
+    Recorder::Get().RemoveHandler(handler_);
+    handler_ = 0;
+  }
+
+ private:
+  ros::ServiceServer server_;  ///< the advertised service
+  unsigned int handler_ = 0;   ///< id of the replay handler
+  std::shared_ptr<bool> advertised_;  ///< expires when stopped
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_RECORDED_SUBSCRIBER_H
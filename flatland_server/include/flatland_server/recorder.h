@@ -0,0 +1,184 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 recorder.h
+ * @brief	 Records and replays the inputs of a simulation run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_RECORDER_H
+#define FLATLAND_SERVER_RECORDER_H
+
+#include <flatland_server/run_log.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class is a process wide recorder of the inputs of a run: the messages
+ * received by the plugins, the service calls and the random seeds picked by
+ * the plugins, each tagged with the number of steps done when it arrived.
+ * When replaying, the recorded inputs are passed to the handlers of their
+ * channel before the step following the one they were recorded at, and the
+ * recorded seeds are returned instead of random ones, which reproduces the
+ * run exactly. See RecordedSubscriber for the plugin side
+ */
+class Recorder {
+ public:
+  /// Called with the data of a replayed record
+  typedef std::function<void(const std::vector<uint8_t> &)> Handler;
+
+  /**
+   * @brief Get the process wide recorder, it neither records nor replays
+   * until started
+   * @return the recorder singleton
+   */
+  static Recorder &Get();
+
+  /**
+   * @brief Start recording to a file, throws exception upon failure
+   * @param[in] path Path to the run log
+   */
+  void StartRecording(const std::string &path);
+
+  /**
+   * @brief Load a run log and start replaying it, throws exception upon
+   * failure
+   * @param[in] path Path to the run log
+   */
+  void StartReplay(const std::string &path);
+
+  /**
+   * @brief Stop recording or replaying. A recording is closed with the
+   * current step as its last step, throws exception upon failure
+   */
+  void Stop();
+
+  /**
+   * @return If inputs are being recorded
+   */
+  bool IsRecording() const { return recording_; }
+
+  /**
+   * @return If a run log is being replayed, the live inputs should then be
+   * ignored
+   */
+  bool IsReplaying() const { return replaying_; }
+
+  /**
+   * @brief Set the number of steps done, the following records are tagged
+   * with it
+   * @param[in] step Number of steps done
+   */
+  void SetStep(uint64_t step);
+
+  /**
+   * @brief Set the number of steps done, and pass the records of the replayed
+   * log up to this step to their handlers, called before the next step
+   * @param[in] step Number of steps done
+   * @return false once the step reaches the end of the replayed run
+   */
+  bool ReplayStep(uint64_t step);
+
+  /**
+   * @brief Record the data of an input, does nothing if not recording
+   * @param[in] channel What the input belongs to, e.g. a topic
+   * @param[in] data The serialized input
+   */
+  void Record(const std::string &channel, const std::vector<uint8_t> &data);
+
+  /**
+   * @brief Pick a random seed. It is recorded when recording, and when
+   * replaying, the seeds recorded for the channel are returned in order
+   * @param[in] channel What the seed is for, e.g. a plugin
+   * @return The seed
+   */
+  uint32_t Seed(const std::string &channel);
+
+  /**
+   * @brief Set the handler of a channel for replaying, replaces the previous
+   * one
+   * @param[in] channel The channel
+   * @param[in] handler Called with the data of each replayed record
+   * @return Id of the handler for RemoveHandler, never 0
+   */
+  unsigned int AddHandler(const std::string &channel, const Handler &handler);
+
+  /**
+   * @brief Remove a handler, unless it was replaced since
+   * @param[in] id Id returned by AddHandler, 0 is ignored
+   */
+  void RemoveHandler(unsigned int id);
+
+  /**
+   * @return Number of replayed records without a handler, and seeds
+   * requested but not recorded, since the replay started
+   */
+  uint64_t GetMismatchCount() const { return mismatches_; }
+
+ private:
+  std::mutex mutex_;                        ///< guards the members below
+  std::atomic<bool> recording_{false};      ///< if recording
+  std::atomic<bool> replaying_{false};      ///< if replaying
+  std::unique_ptr<RunLog::Writer> writer_;  ///< the recorded log
+  uint64_t step_ = 0;                       ///< number of steps done
+  std::vector<RunLog::Record> records_;     ///< DATA records of the replay
+  size_t next_record_ = 0;                  ///< next record to replay
+  uint64_t end_step_ = 0;                   ///< number of steps of the replay
+  std::map<std::string, std::deque<uint32_t>>
+      seeds_;  ///< seeds of the replay by channel
+  std::map<std::string, std::pair<unsigned int, Handler>>
+      handlers_;                   ///< handlers and their ids by channel
+  unsigned int next_handler_ = 1;  ///< id of the next handler
+  std::atomic<uint64_t> mismatches_{0};  ///< see GetMismatchCount
+
+  Recorder() = default;
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_RECORDER_H
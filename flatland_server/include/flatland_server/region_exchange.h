@@ -0,0 +1,177 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 region_exchange.h
+ * @brief	 Exchanges the models between the regions of a distributed simulation
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_REGION_EXCHANGE_H
+#define FLATLAND_SERVER_REGION_EXCHANGE_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_msgs/RegionModels.h>
+#include <flatland_server/recorded_subscriber.h>
+#include <ros/ros.h>
+#include <map>
+#include <string>
+
+namespace flatland_server {
+
+class Model;
+class World;
+
+/**
+ * This class splits a simulation into regions, each simulated by its own
+ * server process, usually stepped in lockstep by scripts/region_coordinator.py.
+ * Every server loads the same layers, and owns the models whose first body is
+ * inside its region. After each step, the models that left the region are
+ * deleted and sent to the other regions, where the region containing them
+ * loads them with the same body states. The models within a margin of the
+ * border are sent as well, and the neighbouring regions mirror them as
+ * ghosts: kinematic copies of their bodies without plugins, so that the
+ * models on both sides collide with and see each other. All servers share
+ * one topic, the messages are applied between steps and recorded
+ */
+class RegionExchange {
+ public:
+  /**
+   * Parameters of a region
+   */
+  struct Params {
+    std::string name;    ///< name of the region, unique among the servers
+    b2AABB bounds;       ///< the region, the lower bounds are inclusive
+    double margin = 2;   ///< distance from the border within which the
+                         /// models are mirrored by the neighbours
+    std::string topic = "/flatland_regions";  ///< topic shared by the servers
+  };
+
+  /**
+   * @brief Constructor, subscribes to the topic shared by the servers
+   * @param[in] world The world of this server, must outlive the exchange
+   * @param[in] params Parameters of the region
+   */
+  RegionExchange(World *world, const Params &params);
+
+  /**
+   * @brief Destructor, deletes the ghosts
+   */
+  ~RegionExchange();
+
+  RegionExchange(const RegionExchange &) = delete;
+  RegionExchange &operator=(const RegionExchange &) = delete;
+
+  /**
+   * @brief Delete the models outside of the region without sending them,
+   * called once the world file is loaded, since every server loads the models
+   * of the whole world file
+   */
+  void DeleteForeignModels();
+
+  /**
+   * @brief Send the models that left the region and the ones near its
+   * border, called by World::Update after each step
+   * @param[in] time Simulation time after the step
+   */
+  void AfterStep(const ros::Time &time);
+
+  /**
+   * @brief Delete the models that left the region and collect them with the
+   * models near the border, see AfterStep
+   * @param[in] time Simulation time after the step
+   * @return The message for the other regions
+   */
+  flatland_msgs::RegionModels Collect(const ros::Time &time);
+
+  /**
+   * @brief Apply the message of another region: load the models that moved
+   * into this region, and update the ghosts of the models of the sender near
+   * this region. Messages of this region are ignored
+   * @param[in] msg The message
+   */
+  void Apply(const flatland_msgs::RegionModels &msg);
+
+  /**
+   * @param[in] p A position in the world frame
+   * @param[in] grow Distance added around the region
+   * @return If the position is in the region grown by the distance
+   */
+  bool Contains(const b2Vec2 &p, double grow) const;
+
+  /**
+   * @param[in] name Name of a model
+   * @return The ghost of the model, nullptr if there is none
+   */
+  Model *GetGhost(const std::string &name) const;
+
+  /**
+   * @return The number of ghosts
+   */
+  size_t GetGhostCount() const { return ghosts_.size(); }
+
+  /**
+   * @return The parameters of the region
+   */
+  const Params &GetParams() const { return params_; }
+
+ private:
+  /// A kinematic copy of a model of another region
+  struct Ghost {
+    std::string region;     ///< region owning the model
+    Model *model = nullptr;  ///< the copy
+  };
+
+  World *world_;                          ///< world of this server
+  Params params_;                         ///< parameters of the region
+  ros::Publisher publisher_;              ///< sends the messages
+  RecordedSubscriber subscriber_;         ///< receives the messages
+  std::map<std::string, Ghost> ghosts_;   ///< the ghosts by model name
+  bool sent_ghosts_ = false;  ///< if the last message had ghosts, an empty
+                              /// message is sent once they are gone
+
+  /**
+   * @brief Delete a ghost, if there is one
+   * @param[in] name Name of the model
+   */
+  void DeleteGhost(const std::string &name);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_REGION_EXCHANGE_H
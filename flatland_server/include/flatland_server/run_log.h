@@ -0,0 +1,136 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 run_log.h
+ * @brief	 Defines the binary log of the inputs of a simulation run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_RUN_LOG_H
+#define FLATLAND_SERVER_RUN_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads and writes the binary log of the inputs of a run, used by
+ * the Recorder. The file starts with the 8 bytes FLRUNLOG and a little endian
+ * uint32 version. Each record follows as the step increase since the previous
+ * record, its type, its channel id and the size of its data, all as LEB128
+ * varints, then the data. A channel is named by a channel record the first
+ * time it is used, so the names are only stored once
+ */
+class RunLog {
+ public:
+  /**
+   * A record of the log
+   */
+  struct Record {
+    enum Type : uint8_t {
+      SEED = 1,  ///< a random seed picked by a plugin
+      DATA = 2,  ///< a serialized message or service request
+      END = 3    ///< the last step of the run, has no channel
+    };
+
+    uint64_t step;              ///< number of steps done before the record
+    Type type;                  ///< type of the record
+    std::string channel;        ///< what the record belongs to
+    std::vector<uint8_t> data;  ///< content of the record
+  };
+
+  /**
+   * This class writes a log, records must be written with non decreasing
+   * steps
+   */
+  class Writer {
+   public:
+    /**
+     * @brief Create the log file, throws exception upon failure
+     * @param[in] path Path to the file
+     */
+    explicit Writer(const std::string &path);
+
+    /**
+     * @brief Add a record, throws exception upon failure
+     * @param[in] step Number of steps done before the record
+     * @param[in] type Type of the record, not END
+     * @param[in] channel What the record belongs to
+     * @param[in] data Content of the record
+     */
+    void Write(uint64_t step, Record::Type type, const std::string &channel,
+               const std::vector<uint8_t> &data);
+
+    /**
+     * @brief Add the END record and close the file, throws exception upon
+     * failure
+     * @param[in] step The number of steps of the run
+     */
+    void Close(uint64_t step);
+
+   private:
+    std::string path_;                          ///< path to the file
+    std::ofstream out_;                         ///< the file
+    uint64_t step_ = 0;                         ///< step of the last record
+    std::map<std::string, uint64_t> channels_;  ///< ids of the channels
+
+    /**
+     * @brief Write a record without the data
+     */
+    void WriteHeader(uint64_t step, uint8_t type, uint64_t channel,
+                     uint64_t size);
+  };
+
+  /**
+   * @brief Read all records of a log, throws exception upon failure. A log
+   * without END record, e.g. of a run that crashed, ends with the step of its
+   * last complete record
+   * @param[in] path Path to the file
+   * @return The records, the last one is always an END record
+   */
+  static std::vector<Record> Read(const std::string &path);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_RUN_LOG_H
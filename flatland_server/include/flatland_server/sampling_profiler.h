@@ -0,0 +1,158 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sampling_profiler.h
+ * @brief	 Samples the call stacks of the process on demand
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLATLAND_SERVER_SAMPLING_PROFILER_H
+#define FLATLAND_SERVER_SAMPLING_PROFILER_H
+
+#include <flatland_server/tracer.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace flatland_server {
+
+/**
+ * This class samples the call stacks of the process at a fixed rate of CPU
+ * time, to find where the time of a slow simulation goes without restarting
+ * it under an external profiler. The timer signal SIGPROF interrupts the
+ * thread using the CPU, which copies its call stack to a preallocated buffer.
+ * While the tracer is recording, each sample also keeps the innermost trace
+ * span of its thread, so the samples are grouped by phase of the step. The
+ * stacks are written in the folded format of flamegraph.pl and speedscope.
+ * Only one profile runs at a time, for the whole process
+ */
+class SamplingProfiler {
+ public:
+  /**
+   * A call stack of the thread interrupted by the timer
+   */
+  struct Sample {
+    static const int kMaxFrames = 48;  ///< deeper stacks are truncated
+    void *frames[kMaxFrames];          ///< return addresses, innermost first
+    int depth;                         ///< number of frames
+    char span[Tracer::Event::kNameSize];  ///< innermost trace span, empty
+                                          /// if none
+    std::atomic<bool> complete;        ///< if fully written by the handler
+  };
+
+  /**
+   * @brief Return the singleton object
+   */
+  static SamplingProfiler &Get();
+
+  /**
+   * @brief Clear the samples and start sampling, throws Exception if already
+   * sampling or if the timer fails
+   * @param[in] frequency Samples per second of CPU time, in (0, 10000]
+   * @param[in] max_samples Samples kept, the later ones are dropped
+   */
+  void Start(double frequency = 100, size_t max_samples = 1 << 15);
+
+  /**
+   * @brief Stop sampling, the samples are kept
+   */
+  void Stop();
+
+  /**
+   * @return true if sampling
+   */
+  bool IsRunning() const { return running_; }
+
+  /**
+   * @return The number of samples kept
+   */
+  size_t GetSampleCount() const;
+
+  /**
+   * @return The number of samples dropped once the buffer was full
+   */
+  size_t GetDroppedCount() const;
+
+  /**
+   * @brief Write the samples kept as folded stacks, one line per distinct
+   * stack with its number of samples, outermost frame first. Should be
+   * called once stopped
+   * @param[in] out The stream to write to
+   * @param[in] root Name of the frame all stacks start from, e.g. the world
+   * @return The number of samples written
+   */
+  size_t WriteFolded(std::ostream &out, const std::string &root);
+
+  /**
+   * @brief Write the samples to a file, throws Exception on failure
+   * @param[in] path Path of the file
+   * @param[in] root Name of the frame all stacks start from
+   * @return The number of samples written
+   */
+  size_t DumpFolded(const std::string &path, const std::string &root);
+
+ private:
+  bool running_;                         ///< if sampling
+  std::unique_ptr<Sample[]> samples_;    ///< preallocated samples
+  size_t max_samples_;                   ///< size of samples_
+  std::atomic<size_t> count_;            ///< samples taken, incl. dropped
+
+  /**
+   * @brief Private constructor for the singleton
+   */
+  SamplingProfiler();
+
+  /**
+   * @brief SIGPROF handler, only async-signal-safe calls are made
+   */
+  static void HandleSignal(int signal);
+
+  /**
+   * @return Name of the function at an address of the stack
+   */
+  static std::string Symbolize(void *address);
+};
+};  // namespace flatland_server
+
+#endif  // FLATLAND_SERVER_SAMPLING_PROFILER_H
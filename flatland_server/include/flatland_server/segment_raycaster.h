@@ -0,0 +1,118 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 segment_raycaster.h
+ * @brief	 Vectorized raycasting against static line segments
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_SEGMENT_RAYCASTER_H
+#define FLATLAND_SERVER_SEGMENT_RAYCASTER_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/types.h>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class raycasts against a static set of line segments, e.g. a line
+ * segments layer. The segments are bucketed into a uniform grid, each bucket
+ * stores its segments as structure of arrays so they can be tested several
+ * at a time with SIMD instructions (AVX2, SSE2 or NEON, scalar otherwise).
+ * Rays walk the buckets in order and stop at the first bucket with a hit
+ */
+class SegmentRaycaster {
+ public:
+  /**
+   * @brief Constructor
+   * @param[in] segments The line segments, in the frame of the layer body
+   */
+  explicit SegmentRaycaster(const std::vector<LineSegment> &segments);
+
+  /**
+   * @brief Cast a ray against the segments, same as raycasting the
+   * b2EdgeShapes of the segments in Box2D
+   * @param[in] p1 Start of the ray in the frame of the segments
+   * @param[in] p2 End of the ray in the frame of the segments
+   * @param[out] fraction Fraction of the ray length at the closest hit
+   * @return true if the ray hits
+   */
+  bool RayCast(const b2Vec2 &p1, const b2Vec2 &p2, float *fraction) const;
+
+  /**
+   * @return Number of segments
+   */
+  unsigned int GetSegmentCount() const { return segment_count_; }
+
+  /**
+   * Number of segments tested in one SIMD operation, buckets are padded to
+   * a multiple of this
+   */
+  static const unsigned int LANES = 8;
+
+ private:
+  /**
+   * Segments of a bucket, as start point ax, ay and direction ex, ey
+   */
+  struct Bucket {
+    std::vector<float> ax, ay, ex, ey;
+  };
+
+  unsigned int segment_count_;  ///< number of segments
+  b2Vec2 min_;                  ///< lower corner of the bucket grid
+  float cell_size_;             ///< size of a bucket
+  int cols_;                    ///< number of buckets in x
+  int rows_;                    ///< number of buckets in y
+  std::vector<Bucket> buckets_;  ///< buckets, row major
+
+  /**
+   * @brief Test a ray against all segments in a bucket
+   * @param[in] b The bucket
+   * @param[in] p1 Start of the ray
+   * @param[in] r Ray direction, i.e. p2 - p1
+   * @param[in/out] best The closest hit fraction, updated if a hit is closer
+   */
+  static void TestBucket(const Bucket &b, const b2Vec2 &p1, const b2Vec2 &r,
+                         float &best);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_SEGMENT_RAYCASTER_H
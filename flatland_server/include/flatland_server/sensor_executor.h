@@ -0,0 +1,238 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_executor.h
+ * @brief	 Shared work stealing executor for sensor plugins
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_SENSOR_EXECUTOR_H
+#define FLATLAND_SERVER_SENSOR_EXECUTOR_H
+
+#include <atomic>
+#include <boost/thread/shared_mutex.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class is a process wide pool of worker threads shared by all sensor
+ * plugins. Each worker owns a task queue per priority, idle workers steal
+ * tasks from the other queues, higher priority tasks are always served first
+ */
+class SensorExecutor {
+ public:
+  /**
+   * Task priority, tasks with lower value are served first
+   */
+  enum Priority { HIGH = 0, NORMAL = 1, LOW = 2, NUM_PRIORITIES = 3 };
+
+  /**
+   * @brief Get the process wide executor, threads are started on first use
+   * @return the executor singleton
+   */
+  static SensorExecutor &Get();
+
+  /**
+   * @brief Convert a string to priority, throws YAMLException if invalid
+   * @param[in] str One of "high", "normal" or "low"
+   * @return The priority
+   */
+  static Priority ParsePriority(const std::string &str);
+
+  /**
+   * @brief Restart the executor with the given number of worker threads,
+   * tasks already submitted are finished first. Must not be called from a
+   * task
+   * @param[in] num_threads Number of workers, 0 for one per hardware thread
+   */
+  void SetNumThreads(unsigned int num_threads);
+
+  /**
+   * @brief Restart the executor with the number of worker threads asked for
+   * by a world, until Release is called the request is compared with the
+   * ones of the other worlds
+   * @param[in] num_threads Number of workers, 0 for one per hardware thread
+   * @return false if a world not released yet asked for a different number,
+   * the last request is used
+   */
+  bool Request(unsigned int num_threads);
+
+  /**
+   * @brief Forget a request of a world being destroyed
+   * @param[in] num_threads Number of workers passed to Request
+   */
+  void Release(unsigned int num_threads);
+
+  /**
+   * @return The number of worker threads
+   */
+  unsigned int GetNumThreads() const { return num_threads_; }
+
+  /**
+   * @return The number of tasks waiting in the queues
+   */
+  unsigned int GetQueuedTasks() const { return num_queued_; }
+
+  /**
+   * @return The most tasks waiting in the queues at once since the last
+   * call, the queue depth reported by SimulationDiagnostics
+   */
+  unsigned int TakePeakQueuedTasks() { return peak_queued_.exchange(0); }
+
+  /**
+   * @brief Pin the workers, and the ones started later, to a set of CPUs,
+   * throws Exception if they cannot be pinned
+   * @param[in] cpus The CPUs, see ThreadConfig::ParseCpuSet, empty to leave
+   * the workers started later on the CPUs of the thread starting them
+   */
+  void SetCpus(const std::vector<unsigned int> &cpus);
+
+  /**
+   * @brief Submit a task to be run on one of the workers
+   * @param[in] task The task
+   * @param[in] priority Priority of the task
+   */
+  void Submit(const std::function<void()> &task, Priority priority = NORMAL);
+
+  /**
+   * @brief Run a function over the range [0, count) split into contiguous
+   * chunks on the workers, blocks until all chunks are done
+   * @param[in] count Number of items
+   * @param[in] chunk_size Items per chunk, 0 for one chunk per worker
+   * @param[in] func Called with [begin, end) of each chunk
+   * @param[in] priority Priority of the chunks
+   */
+  void ParallelFor(unsigned int count, unsigned int chunk_size,
+                   const std::function<void(unsigned int, unsigned int)> &func,
+                   Priority priority = NORMAL);
+
+  /**
+   * @brief Destructor, finishes all tasks and joins the workers
+   */
+  ~SensorExecutor();
+
+ private:
+  /**
+   * A double ended queue of tasks in a ring buffer, which only allocates when
+   * it grows, unlike std::deque which allocates blocks as tasks pass through
+   */
+  struct TaskRing {
+    std::vector<std::function<void()>> slots;  ///< size is a power of two
+    size_t head = 0;   ///< index of the first task
+    size_t count = 0;  ///< number of tasks
+
+    bool empty() const { return count == 0; }
+    void push_back(const std::function<void()> &task);
+    void pop_front(std::function<void()> &task);
+    void pop_back(std::function<void()> &task);
+  };
+
+  /**
+   * Task queues owned by a single worker
+   */
+  struct WorkerQueue {
+    std::mutex mutex;                ///< guards the queues
+    TaskRing tasks[NUM_PRIORITIES];  ///< by priority
+  };
+
+  std::vector<std::thread> workers_;      ///< worker threads
+  std::vector<WorkerQueue *> queues_;     ///< one queue per worker
+  std::atomic<unsigned int> next_queue_;  ///< round robin submission index
+  std::atomic<unsigned int> num_queued_;  ///< tasks waiting in all queues
+  std::atomic<unsigned int> peak_queued_;  ///< see TakePeakQueuedTasks
+  std::mutex wake_mutex_;                 ///< for sleeping idle workers
+  std::condition_variable wake_cv_;  ///< signaled on submission and stop
+  bool stop_;                        ///< tells workers to exit once idle
+  std::mutex config_mutex_;          ///< guards restarting the workers
+  std::vector<unsigned int> requests_;  ///< see Request, hardware resolved
+  std::atomic<unsigned int> num_threads_;  ///< size of workers_
+  /// guards workers_ and queues_, shared by the submitting threads other
+  /// than the workers, which are joined while it is held exclusively
+  boost::shared_mutex threads_mutex_;
+  static thread_local bool is_worker_;  ///< calling thread is a worker
+  std::vector<unsigned int> cpus_;   ///< CPUs of the workers, empty for all
+
+  /**
+   * @brief Private constructor for the singleton
+   */
+  SensorExecutor();
+
+  /**
+   * @brief Start the worker threads
+   * @param[in] num_threads Number of worker threads, 0 for hardware threads
+   */
+  void Start(unsigned int num_threads);
+
+  /**
+   * @brief Finish all tasks, join and delete the workers
+   */
+  void Stop();
+
+  /**
+   * @brief Add a task to the queues, workers_ and queues_ must not change
+   * @param[in] task The task
+   * @param[in] priority Priority of the task
+   */
+  void Push(const std::function<void()> &task, Priority priority);
+
+  /**
+   * @brief Take the highest priority task, from worker's own queue first,
+   * otherwise steal from the other workers
+   * @param[in] id Index of the worker
+   * @param[out] task The task found
+   * @return true if a task was found
+   */
+  bool TryPop(unsigned int id, std::function<void()> &task);
+
+  /**
+   * @brief Worker thread main loop
+   * @param[in] id Index of the worker
+   */
+  void WorkerLoop(unsigned int id);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_SENSOR_EXECUTOR_H
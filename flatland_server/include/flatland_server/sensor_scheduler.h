@@ -0,0 +1,214 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_scheduler.h
+ * @brief	 Batches the rays of all sensors due on a step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_SENSOR_SCHEDULER_H
+#define FLATLAND_SERVER_SENSOR_SCHEDULER_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/gpu_raycaster.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/step_timer.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class gathers the rays of every sensor due on the current step and
+ * casts all of them in a single pass over the sensor executor, instead of one
+ * fork/join per sensor. Sensors submit jobs during BeforePhysicsStep, the
+ * plugin manager flushes the scheduler once all plugins have been called.
+ *
+ * In pipelined mode the jobs are launched on a snapshot of the world instead,
+ * and cast while the physics step runs, the plugin manager joins them after
+ * the step. The jobs must then ray cast against GetSnapshot
+ *
+ * With a GPU raycaster, the rays of the jobs that can describe them are all
+ * cast on the GPU in a single launch at the start of the flush or launch,
+ * the other jobs and those of a failed launch are cast on the CPU
+ */
+class SensorScheduler {
+ public:
+  /**
+   * A group of rays submitted by a sensor
+   */
+  struct Job {
+    unsigned int count;  ///< number of rays
+    /// casts the rays [begin, end) of the job, called on the worker threads
+    std::function<void(unsigned int, unsigned int)> cast;
+    /// called on the thread calling Flush once all rays of the step are cast
+    std::function<void()> done;
+    /// optional, writes the count rays of the job for the GPU raycaster
+    std::function<void(GpuRaycaster::Ray *)> rays;
+    /// optional, set with rays, reads the hits of the rays cast on the GPU
+    /// instead of calling cast, called on the thread calling Flush or Launch
+    std::function<void(const GpuRaycaster::Hit *)> hits;
+  };
+
+  /**
+   * @brief Submit a job to be cast on the next flush, sensors may submit
+   * concurrently when the plugins run in parallel
+   * @param[in] job The job
+   */
+  void Submit(const Job &job);
+
+  /**
+   * @brief Cast the rays of all submitted jobs in one pass, then call the done
+   * callbacks of the jobs in submission order
+   * @param[in] priority Priority of the raycast tasks
+   */
+  void Flush(SensorExecutor::Priority priority = SensorExecutor::NORMAL);
+
+  /**
+   * @brief Take a snapshot of the world and start casting the rays of all
+   * submitted jobs against it, without waiting for them. Nothing but a
+   * physics step may modify the world until Join is called
+   * @param[in] world The world to snapshot
+   * @param[in] priority Priority of the raycast tasks
+   */
+  void Launch(b2World *world,
+              SensorExecutor::Priority priority = SensorExecutor::NORMAL);
+
+  /**
+   * @brief Wait for the rays of the launched jobs, then call their done
+   * callbacks in submission order. Does nothing if nothing was launched
+   */
+  void Join();
+
+  /**
+   * @return The snapshot the launched jobs must ray cast against, nullptr
+   * when the jobs are flushed, in which case they ray cast the world
+   */
+  const b2RayCastSnapshot *GetSnapshot() const {
+    return launched_ ? &snapshot_ : nullptr;
+  }
+
+  /**
+   * @brief Destructor, waits for the launched jobs without calling their
+   * done callbacks
+   */
+  ~SensorScheduler();
+
+  /**
+   * @return Number of jobs waiting for the next flush
+   */
+  unsigned int GetPendingJobs() const { return jobs_.size(); }
+
+  /**
+   * @return Wall time from the flush or launch of the jobs until their rays
+   * are cast, including the physics step when launched
+   */
+  const TimingHistogram &GetLatency() const { return latency_; }
+
+  /**
+   * @brief Reset the histogram of GetLatency
+   */
+  void ResetLatency() { latency_.Reset(); }
+
+  /**
+   * @brief Cast the rays of the jobs on a GPU, see GpuRaycaster
+   * @param[in] raycaster The GPU raycaster, nullptr to cast on the CPU
+   */
+  void SetGpuRaycaster(std::unique_ptr<GpuRaycaster> raycaster) {
+    gpu_raycaster_ = std::move(raycaster);
+  }
+
+  /**
+   * @return The GPU raycaster, nullptr if the rays are cast on the CPU
+   */
+  GpuRaycaster *GetGpuRaycaster() { return gpu_raycaster_.get(); }
+
+ private:
+  /**
+   * @brief Cast the rays [begin, end) of the batch of all jobs
+   */
+  void CastRays(unsigned int begin, unsigned int end);
+
+  /**
+   * @brief Cast the rays of the jobs with a rays callback on the GPU, then
+   * leave only the rays of the other jobs in the batch
+   */
+  void CastOnGpu();
+
+  /**
+   * @brief Clear the jobs, then call their done callbacks
+   */
+  void FinishJobs();
+
+  /**
+   * @brief Add the time since start_ to latency_
+   */
+  void AddLatency();
+
+  /**
+   * @return Number of rays of a chunk, several per worker so a few expensive
+   * sensors do not leave the other workers idle
+   */
+  unsigned int ChunkSize() const;
+
+  std::vector<Job> jobs_;             ///< jobs submitted for this step
+  std::vector<Job> done_jobs_;  ///< jobs of the last flush, swapped with
+                                /// jobs_ so that both keep their capacity
+  std::vector<unsigned int> offsets_;  ///< first ray of each job in the batch
+  unsigned int total_rays_ = 0;        ///< number of rays of all jobs
+  std::mutex mutex_;                   ///< guards the submissions
+  b2RayCastSnapshot snapshot_;  ///< world the launched jobs ray cast against
+  bool launched_ = false;       ///< if jobs are launched and not joined yet
+  unsigned int pending_chunks_ = 0;  ///< launched chunks not done yet
+  std::mutex launch_mutex_;          ///< guards pending_chunks_
+  std::condition_variable launch_cv_;  ///< signaled when the chunks are done
+  std::unique_ptr<GpuRaycaster> gpu_raycaster_;  ///< see SetGpuRaycaster
+  std::vector<GpuRaycaster::Ray> gpu_rays_;  ///< rays of the GPU jobs
+  std::vector<GpuRaycaster::Hit> gpu_hits_;  ///< hits of the GPU jobs
+  std::chrono::steady_clock::time_point start_;  ///< of the flush or launch
+  TimingHistogram latency_;                      ///< see GetLatency
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_SENSOR_SCHEDULER_H
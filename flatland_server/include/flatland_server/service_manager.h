@@ -44,13 +44,35 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_msgs/CheckCollisions.h>
 #include <flatland_msgs/DeleteModel.h>
+#include <flatland_msgs/DeleteModels.h>
+#include <flatland_msgs/DumpTrace.h>
+#include <flatland_msgs/GetMemoryReport.h>
+#include <flatland_msgs/GetModelStates.h>
+#include <flatland_msgs/GetPluginCosts.h>
+#include <flatland_msgs/GetTopicStats.h>
 #include <flatland_msgs/MoveModel.h>
+#include <flatland_msgs/MoveModels.h>
+#include <flatland_msgs/RaycastBatch.h>
+#include <flatland_msgs/ReloadLayer.h>
+#include <flatland_msgs/RunUntil.h>
+#include <flatland_msgs/SetModelAwake.h>
 #include <flatland_msgs/SpawnModel.h>
+#include <flatland_msgs/SpawnModels.h>
+#include <flatland_msgs/StartProfiling.h>
+#include <flatland_msgs/StepWorld.h>
+#include <flatland_msgs/StopProfiling.h>
+#include <flatland_msgs/WorldCheckpoint.h>
+#include <flatland_server/command_queue.h>
 #include <flatland_server/simulation_manager.h>
 #include <flatland_server/world.h>
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
+#include <functional>
+#include <string>
+#include <vector>
 
 #ifndef FLATLAND_PLUGIN_SERVICE_MANAGER_H
 #define FLATLAND_PLUGIN_SERVICE_MANAGER_H
@@ -71,17 +93,66 @@ class ServiceManager {
   ros::ServiceServer spawn_model_service_;   ///< service for spawning models
   ros::ServiceServer delete_model_service_;  ///< service for deleting models
   ros::ServiceServer move_model_service_;    ///< service for moving models
+  ros::ServiceServer spawn_models_service_;   ///< spawns models in a batch
+  ros::ServiceServer delete_models_service_;  ///< deletes models in a batch
+  ros::ServiceServer move_models_service_;    ///< moves models in a batch
+  ros::ServiceServer set_model_awake_service_;  ///< wakes models up or puts
+                                               /// them to sleep
   ros::ServiceServer pause_service_;   ///< service for pausing the simulation
   ros::ServiceServer resume_service_;  ///< service for resuming the simulation
   ros::ServiceServer toggle_pause_service_;  ///< service for toggling the
                                              /// pause state of the simulation
+  ros::ServiceServer step_world_service_;  ///< service for stepping the
+                                           /// simulation in lockstep mode
+  ros::ServiceServer run_until_service_;  ///< service for stepping the
+                                          /// simulation until an event
+  ros::ServiceServer reset_world_service_;  ///< service for restoring the
+                                            /// snapshot of the world
+  ros::ServiceServer snapshot_world_service_;  ///< service for replacing the
+                                               /// snapshot of the world
+  ros::ServiceServer save_world_service_;  ///< service for saving the world
+                                           /// to a checkpoint file
+  ros::ServiceServer load_world_service_;  ///< service for restoring the
+                                           /// world from a checkpoint file
+  ros::ServiceServer get_plugin_costs_service_;  ///< service for the time
+                                                 /// spent in the plugins
+  ros::ServiceServer dump_trace_service_;  ///< service for writing the trace
+                                           /// of the process, see Tracer
+  ros::ServiceServer start_profiling_service_;  ///< service for sampling
+                                                /// the call stacks of the
+                                                /// process, see
+                                                /// SamplingProfiler
+  ros::ServiceServer stop_profiling_service_;  ///< service for writing the
+                                               /// sampled call stacks
+  ros::ServiceServer get_topic_stats_service_;  ///< service for the topics
+                                                /// publishing the most
+  ros::ServiceServer check_collisions_service_;  ///< service for checking
+                                                 /// footprints at many poses
+  ros::ServiceServer raycast_batch_service_;  ///< service for casting many
+                                              /// rays in the world
+  ros::ServiceServer get_model_states_service_;  ///< service for the states
+                                                 /// of all models at once
+  ros::ServiceServer reload_layer_service_;  ///< service for reloading the
+                                             /// map of a layer
+  ros::ServiceServer get_memory_report_service_;  ///< service for the memory
+                                                  /// of the world, see
+                                                  /// MemoryReport
+  std::vector<unsigned int> replay_handlers_;  ///< Recorder handlers of the
+                                               /// recorded services
 
   /**
    * @brief Service manager constructor
    * @param[in] sim_man A handle to the simulation manager
    * @param[in] world A handle to the simulation world
+   * @param[in] ns Namespace of the services, the namespace of the world
    */
-  ServiceManager(SimulationManager *sim_man, World *world);
+  ServiceManager(SimulationManager *sim_man, World *world,
+                 const std::string &ns = "");
+
+  /**
+   * @brief Service manager destructor
+   */
+  ~ServiceManager();
 
   /**
    * @brief Callback for the spawn model service
@@ -91,6 +162,19 @@ class ServiceManager {
   bool SpawnModel(flatland_msgs::SpawnModel::Request &request,
                   flatland_msgs::SpawnModel::Response &response);
 
+  /**
+   * @brief Parse the model of a spawn model call and create its plugins,
+   * which may run on any thread
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service, set if
+   * the preparation failed
+   * @return The command adding the model to the world and setting the
+   * response, empty if the preparation failed
+   */
+  CommandQueue::Command PrepareSpawnModel(
+      flatland_msgs::SpawnModel::Request &request,
+      flatland_msgs::SpawnModel::Response &response);
+
   /**
    * @brief Callback for the delete model service
    * @param[in] request Contains the request data for the service
@@ -107,6 +191,192 @@ class ServiceManager {
   bool MoveModel(flatland_msgs::MoveModel::Request &request,
                  flatland_msgs::MoveModel::Response &response);
 
+  /**
+   * @brief Parse the models of a spawn models call and create their plugins
+   * on any thread, the models are added at the same step
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service, set if
+   * the request is invalid
+   * @return The command adding the models prepared successfully to the world
+   * and setting the response, empty if the request is invalid
+   */
+  CommandQueue::Command PrepareSpawnModels(
+      flatland_msgs::SpawnModels::Request &request,
+      flatland_msgs::SpawnModels::Response &response);
+
+  /**
+   * @brief Callback for the delete models service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool DeleteModels(flatland_msgs::DeleteModels::Request &request,
+                    flatland_msgs::DeleteModels::Response &response);
+
+  /**
+   * @brief Callback for the move models service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool MoveModels(flatland_msgs::MoveModels::Request &request,
+                  flatland_msgs::MoveModels::Response &response);
+
+  /**
+   * @brief Callback for the set model awake service, see
+   * World::SetModelAwake
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool SetModelAwake(flatland_msgs::SetModelAwake::Request &request,
+                     flatland_msgs::SetModelAwake::Response &response);
+
+  /**
+   * @brief Callback for the reload layer service, see World::ReloadLayer
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool ReloadLayer(flatland_msgs::ReloadLayer::Request &request,
+                   flatland_msgs::ReloadLayer::Response &response);
+
+  /**
+   * @brief Get the name of a model of a batch call
+   * @param[in] names The names of the models, empty to use the ids
+   * @param[in] ids The ids of the models, see World::GetModelById
+   * @param[in] index Index of the model in the call
+   * @return The name, throws Exception if no model has the id
+   */
+  std::string ModelName(const std::vector<std::string> &names,
+                        const std::vector<uint32_t> &ids, size_t index);
+
+  /**
+   * @brief Callback for the step world service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool StepWorld(flatland_msgs::StepWorld::Request &request,
+                 flatland_msgs::StepWorld::Response &response);
+
+  /**
+   * @brief Callback for the run until service, steps the world in lockstep
+   * mode until one of the conditions of the request is met
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool RunUntil(flatland_msgs::RunUntil::Request &request,
+                flatland_msgs::RunUntil::Response &response);
+
+  /**
+   * @brief Callback for the reset world service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool ResetWorld(std_srvs::Trigger::Request &request,
+                  std_srvs::Trigger::Response &response);
+
+  /**
+   * @brief Callback for the snapshot world service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool SnapshotWorld(std_srvs::Trigger::Request &request,
+                     std_srvs::Trigger::Response &response);
+
+  /**
+   * @brief Callback for the save world service, see World::SaveCheckpoint
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool SaveWorld(flatland_msgs::WorldCheckpoint::Request &request,
+                 flatland_msgs::WorldCheckpoint::Response &response);
+
+  /**
+   * @brief Callback for the load world service, see World::LoadCheckpoint
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool LoadWorld(flatland_msgs::WorldCheckpoint::Request &request,
+                 flatland_msgs::WorldCheckpoint::Response &response);
+
+  /**
+   * @brief Callback for the get plugin costs service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool GetPluginCosts(flatland_msgs::GetPluginCosts::Request &request,
+                      flatland_msgs::GetPluginCosts::Response &response);
+
+  /**
+   * @brief Callback for the dump trace service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool DumpTrace(flatland_msgs::DumpTrace::Request &request,
+                 flatland_msgs::DumpTrace::Response &response);
+
+  /**
+   * @brief Callback for the start profiling service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool StartProfiling(flatland_msgs::StartProfiling::Request &request,
+                      flatland_msgs::StartProfiling::Response &response);
+
+  /**
+   * @brief Callback for the stop profiling service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool StopProfiling(flatland_msgs::StopProfiling::Request &request,
+                     flatland_msgs::StopProfiling::Response &response);
+
+  /**
+   * @brief Callback for the get topic stats service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool GetTopicStats(flatland_msgs::GetTopicStats::Request &request,
+                     flatland_msgs::GetTopicStats::Response &response);
+
+  /**
+   * @brief Callback for the check collisions service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool CheckCollisions(flatland_msgs::CheckCollisions::Request &request,
+                       flatland_msgs::CheckCollisions::Response &response);
+
+  /**
+   * @brief Callback for the raycast batch service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool RaycastBatch(flatland_msgs::RaycastBatch::Request &request,
+                    flatland_msgs::RaycastBatch::Response &response);
+
+  /**
+   * @brief Callback for the get model states service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool GetModelStates(flatland_msgs::GetModelStates::Request &request,
+                      flatland_msgs::GetModelStates::Response &response);
+
+  /**
+   * @brief Callback for the get memory report service
+   * @param[in] request Contains the request data for the service
+   * @param[in/out] response Contains the response for the service
+   */
+  bool GetMemoryReport(flatland_msgs::GetMemoryReport::Request &request,
+                       flatland_msgs::GetMemoryReport::Response &response);
+
+  /**
+   * @brief Convert plugin costs to messages
+   * @param[in] entries The costs, from PluginManager::GetPluginCosts or
+   * GetPluginTypeCosts
+   * @return The messages
+   */
+  static std::vector<flatland_msgs::PluginCost> PluginCostsToMsg(
+      const std::vector<PluginManager::CostEntry> &entries);
+
   /**
    * @brief Callback for the pause service
    */
@@ -124,6 +394,58 @@ class ServiceManager {
    */
   bool TogglePause(std_srvs::Empty::Request &request,
                    std_srvs::Empty::Response &response);
+
+ private:
+  /**
+   * @brief Advertise a service whose calls are recorded by the Recorder, and
+   * made again on the same steps when replaying. Calls made while replaying
+   * are refused. The calls are applied through the CommandQueue
+   * @param[in] nh Node handle advertising the service
+   * @param[in] service Name of the service
+   * @param[in] callback Callback of the service
+   * @return The service server
+   */
+  template <class Req, class Res>
+  ros::ServiceServer AdvertiseRecorded(
+      ros::NodeHandle &nh, const std::string &service,
+      bool (ServiceManager::*callback)(Req &, Res &));
+
+  /**
+   * @brief Advertise a recorded service whose calls are prepared on the
+   * thread serving them, only the returned command is recorded and applied
+   * through the CommandQueue
+   * @param[in] nh Node handle advertising the service
+   * @param[in] service Name of the service
+   * @param[in] prepare Prepares a call, returns the command applying it, or
+   * an empty command if the call failed
+   * @return The service server
+   */
+  template <class Req, class Res>
+  ros::ServiceServer AdvertiseRecorded(
+      ros::NodeHandle &nh, const std::string &service,
+      CommandQueue::Command (ServiceManager::*prepare)(Req &, Res &));
+
+  /**
+   * @brief Implementation of the AdvertiseRecorded overloads
+   */
+  template <class Req, class Res>
+  ros::ServiceServer AdvertiseRecorded(
+      ros::NodeHandle &nh, const std::string &service,
+      const std::function<CommandQueue::Command(Req &, Res &)> &prepare);
+
+  /**
+   * @brief Advertise a service whose calls are applied through the
+   * CommandQueue, i.e. between steps when the callbacks are served by an
+   * AsyncSpinner
+   * @param[in] nh Node handle advertising the service
+   * @param[in] service Name of the service
+   * @param[in] callback Callback of the service
+   * @return The service server
+   */
+  template <class Req, class Res>
+  ros::ServiceServer AdvertiseQueued(
+      ros::NodeHandle &nh, const std::string &service,
+      bool (ServiceManager::*callback)(Req &, Res &));
 };
 };
 #endif
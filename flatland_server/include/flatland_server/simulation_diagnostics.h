@@ -0,0 +1,115 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 simulation_diagnostics.h
+ * @brief	 Publishes the health of the simulation loop on /diagnostics
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_SIMULATION_DIAGNOSTICS_H
+#define FLATLAND_SERVER_SIMULATION_DIAGNOSTICS_H
+
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace flatland_server {
+
+class World;
+
+/**
+ * This class publishes the health of the simulation loop on /diagnostics,
+ * with a status for the step time against its budget, the real time factor,
+ * the sensor executor and the costs of the plugins. The statuses cover the
+ * period since the previous publication, about 1s
+ */
+class SimulationDiagnostics {
+ public:
+  /**
+   * @brief Constructor
+   * @param[in] world The world whose sensors and plugins are reported
+   * @param[in] step_budget Wall time a step may take, 0 for no budget
+   * @param[in] target_factor Real time factor to hold, 0 for none
+   */
+  SimulationDiagnostics(World *world, double step_budget,
+                        double target_factor);
+
+  /**
+   * @brief Add the wall time of the work of a step, without the sleeps
+   * @param[in] work The time in seconds
+   */
+  void AddStep(double work);
+
+  /**
+   * @brief Set the real time factor achieved over the last period
+   * @param[in] factor The factor
+   */
+  void SetRealTimeFactor(double factor) { real_time_factor_ = factor; }
+
+  /**
+   * @brief Publish the statuses if their period is over, call once per
+   * iteration of the loop
+   */
+  void Update() { updater_.update(); }
+
+ private:
+  World *world_;                  ///< the world reported
+  double step_budget_;            ///< see the constructor
+  double target_factor_;          ///< see the constructor
+  double real_time_factor_ = 0;   ///< see SetRealTimeFactor
+  uint64_t steps_ = 0;            ///< steps added in the period
+  uint64_t period_steps_ = 0;     ///< steps of the last reported period
+  uint64_t overruns_ = 0;         ///< steps of the period over the budget
+  double work_ = 0;               ///< summed work of the steps of the period
+  double max_work_ = 0;           ///< longest step of the period
+  std::map<std::string, double> plugin_costs_;  ///< total cost of each
+                                                /// plugin at the last report
+  diagnostic_updater::Updater updater_;  ///< publishes the statuses
+
+  /// The status callbacks, called by updater_ when it publishes
+  void StepTime(diagnostic_updater::DiagnosticStatusWrapper &status);
+  void RealTimeFactor(diagnostic_updater::DiagnosticStatusWrapper &status);
+  void Sensors(diagnostic_updater::DiagnosticStatusWrapper &status);
+  void Plugins(diagnostic_updater::DiagnosticStatusWrapper &status);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_SIMULATION_DIAGNOSTICS_H
@@ -48,22 +48,62 @@
 #define FLATLAND_SERVER_SIMULATION_MANAGER_H
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/deadline_pacer.h>
 #include <flatland_server/debug_visualization.h>
+#include <flatland_server/step_budget_governor.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/world.h>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace flatland_server {
 
 class SimulationManager {
  public:
   bool run_simulator_;           ///<  While true, keep running the sim loop
-  World *world_;                 ///< Simulation world
+  World *world_;                 ///< Simulation world, the first of worlds_
+  std::vector<World *> worlds_;  ///< all worlds, stepped together
   double update_rate_;           ///< sim loop rate
   double step_size_;             ///< step size
   bool show_viz_;                ///< flag to determine if to show visualization
   double viz_pub_rate_;          ///< rate to publish visualization
   std::string world_yaml_file_;  ///< path to the world file
+  bool lockstep_;                ///< only step when requested by StepWorld
+  unsigned int num_worlds_;      ///< number of worlds to run
+  bool headless_;                ///< no visualization or interactive markers
+  unsigned int timing_steps_;    ///< steps per step_timing message, 0 for none
+  unsigned int profile_plugins_;  ///< plugins ranked on step_timing, 0 to not
+                                  /// profile the plugins
+  double real_time_factor_;  ///< target real time factor, 0 to pace by
+                             /// update_rate_, inf to run as fast as possible
+  unsigned int max_steps_per_cycle_;  ///< steps run back to back to catch up
+                                      /// with real_time_factor_
+  unsigned int callback_threads_;  ///< threads of the AsyncSpinner serving
+                                   /// the callbacks, 0 to spin in the loop
+  bool profile_startup_;  ///< log the time spent in the phases of loading
+  double clock_rate_;     ///< rate of the clock in Hz of simulation time, 0
+                          /// to publish it on every step
+  double step_budget_;    ///< wall time allowed per step, 0 for no budget
+  std::vector<StepBudgetGovernor::Degradation>
+      step_budget_degradations_;  ///< degradations on overruns, in order
+  bool deadline_pacing_;  ///< pace update_rate_ with a DeadlinePacer instead
+                          /// of ros::WallRate
+  double spin_tail_;      ///< time spun before each deadline
+  DeadlinePacer::Overrun overrun_policy_;  ///< what the DeadlinePacer does
+                                           /// when a cycle overruns
+  bool perf_counters_;  ///< count the hardware events of the timed stages
+  bool diagnostics_;    ///< publish the health of the loop on /diagnostics
+  double flight_recorder_threshold_;  ///< step time written with the steps
+                                     /// around it, 0 for no FlightRecorder
+  unsigned int flight_recorder_steps_;  ///< iterations kept by the
+                                        /// FlightRecorder
+  std::string flight_recorder_dir_;  ///< directory of the FlightRecorder
+                                     /// files
+  Timekeeper *timekeeper_;       ///< time of world_, valid while Main runs
+  std::vector<Timekeeper *> timekeepers_;  ///< time of each world
+  uint64_t steps_;  ///< steps of world_ since the loop started
 
   /**
    * @name  Simulation Manager constructor
@@ -73,15 +113,111 @@ class SimulationManager {
    * @param[in] show_viz if to show visualization
    * @param[in] viz_pub_rate rate to publish visualization
    * behaving ones
+   * @param[in] lockstep if true, the world is only stepped by StepWorld
+   * @param[in] num_worlds number of independent worlds loaded from the world
+   * file, with more than one each world is in the namespace world_<index>
+   * @param[in] headless if true, no visualization topics, markers or
+   * interactive markers are created, implies show_viz false
+   * @param[in] timing_steps if not 0, the time spent in the stages of the
+   * steps is published on step_timing every timing_steps steps
+   * @param[in] profile_plugins if not 0, the time spent in each plugin is
+   * measured, and the profile_plugins most costly plugins are published on
+   * step_timing
+   * @param[in] real_time_factor if > 0, the loop is paced to hold this
+   * factor of simulated time per wall clock time instead of update_rate, inf
+   * to run as fast as possible
+   * @param[in] max_steps_per_cycle most steps run back to back when the loop
+   * falls behind real_time_factor
+   * @param[in] callback_threads if not 0, the ROS callbacks are served by an
+   * AsyncSpinner with this many threads, and applied through the
+   * CommandQueue between steps, instead of spinning in the loop
+   * @param[in] profile_startup if true, the time spent loading the layers,
+   * models and plugins of the worlds is logged once they are loaded
+   * @param[in] clock_rate if > 0, the clock is published at this rate of
+   * simulation time instead of on every step, and at the steps the plugins
+   * with an update rate are updated
+   * @param[in] step_budget if > 0, the wall time in seconds a step may take,
+   * steps that keep overrunning it activate step_budget_degradations one by
+   * one until they fit again, see StepBudgetGovernor
+   * @param[in] step_budget_degradations ways to reduce the work of the steps
+   * in the order they are activated
+   * @param[in] deadline_pacing if true, update_rate is paced to absolute
+   * deadlines by a DeadlinePacer instead of ros::WallRate, and the jitter of
+   * the wake ups is published on simulation_metrics
+   * @param[in] spin_tail with deadline_pacing, the time before each deadline
+   * spent spinning on the clock instead of sleeping
+   * @param[in] overrun_policy with deadline_pacing, what happens when a cycle
+   * misses its deadline, the bursts are up to max_steps_per_cycle cycles
+   * @param[in] perf_counters if true, the CPU cycles, instructions and last
+   * level cache misses of the stages timed for step_timing are counted with
+   * PerfCounters on the simulation thread
+   * @param[in] diagnostics if true, the step time, real time factor, sensors
+   * and plugins are reported on /diagnostics, see SimulationDiagnostics
+   * @param[in] flight_recorder_threshold if > 0, the details of the last
+   * flight_recorder_steps iterations are kept, and the ones around an
+   * iteration whose steps take longer than this wall time in seconds are
+   * written to a file in flight_recorder_dir, see FlightRecorder
+   * @param[in] flight_recorder_steps iterations kept and written
+   * @param[in] flight_recorder_dir directory of the files, the working
+   * directory if empty
    */
   SimulationManager(std::string world_yaml_file, double update_rate,
-                    double step_size, bool show_viz, double viz_pub_rate);
+                    double step_size, bool show_viz, double viz_pub_rate,
+                    bool lockstep = false, unsigned int num_worlds = 1,
+                    bool headless = false, unsigned int timing_steps = 0,
+                    unsigned int profile_plugins = 0,
+                    double real_time_factor = 0,
+                    unsigned int max_steps_per_cycle = 1,
+                    unsigned int callback_threads = 0,
+                    bool profile_startup = false, double clock_rate = 0,
+                    double step_budget = 0,
+                    const std::vector<StepBudgetGovernor::Degradation>
+                        &step_budget_degradations = {},
+                    bool deadline_pacing = false, double spin_tail = 0,
+                    DeadlinePacer::Overrun overrun_policy =
+                        DeadlinePacer::SKIP,
+                    bool perf_counters = false, bool diagnostics = false,
+                    double flight_recorder_threshold = 0,
+                    unsigned int flight_recorder_steps = 200,
+                    const std::string &flight_recorder_dir = "");
 
   /**
    * This method contains the loop that runs the simulation
    */
   void Main();
 
+  /**
+   * @brief Step a world back to back in lockstep mode, returns once the
+   * plugins are done with the last step. Called from the service callbacks,
+   * which run on the thread of the simulation loop
+   * @param[in] world The world to step, one of worlds_
+   * @param[in] steps Number of steps
+   * @param[out] message Reason of failure
+   * @return true if the world was stepped
+   */
+  bool StepWorld(World *world, unsigned int steps, std::string *message);
+
+  /**
+   * @brief Step a world back to back in lockstep mode until a condition is
+   * met, checked once the plugins are done with each step. Same rules as
+   * StepWorld
+   * @param[in] world The world to step, one of worlds_
+   * @param[in] max_steps Number of steps to stop after, 0 for no limit
+   * @param[in] stop Returns true to stop after the step
+   * @param[out] steps Number of steps run
+   * @param[out] message Reason of failure
+   * @return true if the world was stepped
+   */
+  bool RunWorld(World *world, unsigned int max_steps,
+                const std::function<bool()> &stop, unsigned int *steps,
+                std::string *message);
+
+  /**
+   * @param[in] world One of worlds_
+   * @return The time of the world, nullptr if the loop is not running
+   */
+  Timekeeper *GetTimekeeper(const World *world);
+
   /**
    * Kill the world
    */
@@ -0,0 +1,247 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_export.h
+ * @brief	 Shared memory layout of the exported world state and its reader
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_STATE_EXPORT_H
+#define FLATLAND_SERVER_STATE_EXPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/*
+ * The world state is exported to a POSIX shared memory object by
+ * StateExporter and read by StateReader, which depends on nothing but the
+ * standard library so that other processes on the host can link it alone.
+ * The object holds, in native byte order and 8 byte aligned:
+ *
+ * - StateExportHeader, with the offsets of the other parts
+ * - the directory: StateExportDirectory, followed by the names of the bodies
+ *   and the StateExportScanInfo of the scans
+ * - a ring of slot_count slots: StateExportSlot, followed by the
+ *   StateExportBody of the bodies, the stamps of the scans and the ranges of
+ *   all scans
+ *
+ * One slot is written per step, the directory only when bodies or scans are
+ * added or removed. Each is guarded by its own seqlock: an odd sequence
+ * number while it is written, readers retry if it changed while reading.
+ */
+
+const char STATE_EXPORT_MAGIC[8] = {'F', 'L', 'S', 'T', 'A', 'T', 'E', 0};
+const uint32_t STATE_EXPORT_VERSION = 1;
+const size_t STATE_EXPORT_NAME_SIZE = 64;  ///< including the terminating 0
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "the seqlocks in shared memory must be plain 64 bit words");
+
+/// The start of the shared memory object
+struct StateExportHeader {
+  char magic[8];              ///< STATE_EXPORT_MAGIC, written last
+  uint32_t version;           ///< STATE_EXPORT_VERSION
+  uint32_t slot_count;        ///< number of slots in the ring
+  uint32_t max_bodies;        ///< capacity of the slots in bodies
+  uint32_t max_scans;         ///< capacity of the slots in scans
+  uint32_t max_ranges;        ///< capacity of the slots in ranges
+  uint32_t reserved;          ///< 0
+  uint64_t size;              ///< size of the object in bytes
+  uint64_t directory_offset;  ///< offset of the StateExportDirectory
+  uint64_t names_offset;      ///< offset of the names of the bodies
+  uint64_t scan_infos_offset;  ///< offset of the StateExportScanInfo
+  uint64_t slots_offset;      ///< offset of the first slot
+  uint64_t slot_size;         ///< size of a slot in bytes
+  uint64_t bodies_offset;     ///< offset of the bodies within a slot
+  uint64_t stamps_offset;     ///< offset of the scan stamps within a slot
+  uint64_t ranges_offset;     ///< offset of the ranges within a slot
+  std::atomic<uint64_t> written;  ///< number of slots written, the latest is
+                                  /// (written - 1) % slot_count
+};
+
+/// The names of the bodies and scans, which rarely change
+struct StateExportDirectory {
+  std::atomic<uint64_t> seq;  ///< seqlock sequence number
+  uint64_t generation;        ///< incremented on each change
+  uint32_t body_count;        ///< number of body names
+  uint32_t scan_count;        ///< number of scan infos
+};
+
+/// A scan in the directory
+struct StateExportScanInfo {
+  char name[STATE_EXPORT_NAME_SIZE];  ///< "<model>/<plugin>"
+  uint32_t offset;  ///< index of the first range in the ranges of a slot
+  uint32_t count;   ///< number of ranges
+};
+
+/// The state of the world after a step
+struct StateExportSlot {
+  std::atomic<uint64_t> seq;  ///< seqlock sequence number
+  uint64_t step;              ///< number of the step, from 1
+  double time;                ///< simulation time in seconds
+  uint64_t generation;        ///< generation of the directory of the slot
+  uint32_t body_count;        ///< number of bodies
+  uint32_t scan_count;        ///< number of scans
+  uint32_t range_count;       ///< number of ranges of all scans
+  uint32_t reserved;          ///< 0
+};
+
+/// The state of a body in a slot, the names are in the directory
+struct StateExportBody {
+  float x;      ///< x of the body origin
+  float y;      ///< y of the body origin
+  float angle;  ///< angle of the body
+  float vx;     ///< x of the linear velocity of the center of mass
+  float vy;     ///< y of the linear velocity of the center of mass
+  float omega;  ///< angular velocity
+};
+
+/// Start writing data guarded by a seqlock
+inline void SeqlockWriteBegin(std::atomic<uint64_t> *seq) {
+  seq->store(seq->load(std::memory_order_relaxed) + 1,
+             std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+/// Finish writing data guarded by a seqlock
+inline void SeqlockWriteEnd(std::atomic<uint64_t> *seq) {
+  seq->store(seq->load(std::memory_order_relaxed) + 1,
+             std::memory_order_release);
+}
+
+/// Start reading data guarded by a seqlock, odd if it is being written
+inline uint64_t SeqlockReadBegin(const std::atomic<uint64_t> *seq) {
+  return seq->load(std::memory_order_acquire);
+}
+
+/// Check the data read since SeqlockReadBegin was not written meanwhile
+inline bool SeqlockReadValid(const std::atomic<uint64_t> *seq,
+                             uint64_t begin) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return (begin & 1) == 0 && seq->load(std::memory_order_relaxed) == begin;
+}
+
+/**
+ * This class reads the world state exported by a StateExporter of another
+ * process, or of this one. Reading copies the latest slot, it never blocks
+ * the writer
+ */
+class StateReader {
+ public:
+  /// A scan, its latest ranges are in Frame::ranges
+  struct Scan {
+    std::string name;     ///< "<model>/<plugin>"
+    uint32_t offset = 0;  ///< index of the first range in Frame::ranges
+    uint32_t count = 0;   ///< number of ranges
+  };
+
+  /// A copy of a slot
+  struct Frame {
+    uint64_t step = 0;                    ///< number of the step, from 1
+    double time = 0;                      ///< simulation time in seconds
+    uint64_t generation = UINT64_MAX;     ///< generation of the names
+    std::vector<std::string> names;       ///< "<model>/<body>" by body
+    std::vector<StateExportBody> bodies;  ///< states of the bodies
+    std::vector<Scan> scans;              ///< the scans
+    std::vector<double> stamps;  ///< simulation time of the latest ranges of
+                                 /// the scans, 0 if none yet
+    std::vector<float> ranges;   ///< latest ranges of all scans
+  };
+
+  StateReader() = default;
+  ~StateReader();
+  StateReader(const StateReader &) = delete;
+  StateReader &operator=(const StateReader &) = delete;
+
+  /**
+   * @brief Map an exported state
+   * @param[in] name Name of the shared memory object, e.g. "/flatland_state"
+   * @return false if the object does not exist or is not a valid export
+   */
+  bool Open(const std::string &name);
+
+  /**
+   * @brief Unmap the exported state
+   */
+  void Close();
+
+  /**
+   * @return true if an exported state is mapped
+   */
+  bool IsOpen() const { return data_ != nullptr; }
+
+  /**
+   * @brief Copy the latest slot. The names are only copied again when they
+   * changed since the frame was last read
+   * @param[in/out] frame The frame to fill, reuse it to avoid allocations
+   * @param[in] max_retries Times to retry if the writer changed the slot or
+   * the names while they were read
+   * @return false if nothing was written yet or the retries ran out
+   */
+  bool Read(Frame *frame, unsigned int max_retries = 100) const;
+
+  /**
+   * @return The header of the mapped state, nullptr if none is mapped
+   */
+  const StateExportHeader *GetHeader() const {
+    return static_cast<const StateExportHeader *>(data_);
+  }
+
+ private:
+  void *data_ = nullptr;  ///< the mapping
+  size_t size_ = 0;       ///< size of the mapping
+
+  /**
+   * @brief Copy the directory into a frame
+   * @param[in] generation The generation the slot was written with
+   * @param[out] frame The frame
+   * @return false if the directory changed while it was read or has another
+   * generation
+   */
+  bool ReadDirectory(uint64_t generation, Frame *frame) const;
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_STATE_EXPORT_H
@@ -0,0 +1,169 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_exporter.h
+ * @brief	 Exports the world state to shared memory
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_STATE_EXPORTER_H
+#define FLATLAND_SERVER_STATE_EXPORTER_H
+
+#include <flatland_server/state_export.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+class BodyStates;
+
+/**
+ * This class exports the poses and velocities of the model bodies and the
+ * latest ranges of the scans to a POSIX shared memory object once per step,
+ * so that processes on the same host read them with a StateReader instead of
+ * subscribing to the ROS topics. See state_export.h for the layout
+ */
+class StateExporter {
+ public:
+  StateExporter() = default;
+
+  /**
+   * @brief Unlink the shared memory object, readers which mapped it keep
+   * their mapping
+   */
+  ~StateExporter();
+
+  StateExporter(const StateExporter &) = delete;
+  StateExporter &operator=(const StateExporter &) = delete;
+
+  /**
+   * @brief Create the shared memory object, replacing any object of the same
+   * name. Throws Exception
+   * @param[in] name Name of the object, e.g. "/flatland_state"
+   * @param[in] slot_count Number of steps kept in the ring
+   * @param[in] max_bodies Max number of bodies exported
+   * @param[in] max_scans Max number of scans exported
+   * @param[in] max_ranges Max number of ranges of all scans
+   */
+  void Create(const std::string &name, uint32_t slot_count,
+              uint32_t max_bodies, uint32_t max_scans, uint32_t max_ranges);
+
+  /**
+   * @brief Add a scan, thread safe
+   * @param[in] name Name of the scan, "<model>/<plugin>"
+   * @param[in] count Number of ranges of the scan
+   * @return Id of the scan, -1 if there is no room left
+   */
+  int AddScan(const std::string &name, uint32_t count);
+
+  /**
+   * @brief Remove a scan, thread safe
+   * @param[in] id Id returned by AddScan, nothing happens for -1
+   */
+  void RemoveScan(int id);
+
+  /**
+   * @brief Set the latest ranges of a scan, exported on the next Write.
+   * Thread safe
+   * @param[in] id Id returned by AddScan, nothing happens for -1
+   * @param[in] stamp Simulation time of the scan in seconds
+   * @param[in] ranges The ranges, as many as given to AddScan
+   */
+  void SetScan(int id, double stamp, const float *ranges);
+
+  /**
+   * @brief Write the state after a step into the next slot of the ring
+   * @param[in] states The states of the model bodies
+   * @param[in] time Simulation time in seconds
+   */
+  void Write(const BodyStates &states, double time);
+
+  /**
+   * @return Name of the shared memory object, empty until created
+   */
+  const std::string &GetName() const { return name_; }
+
+ private:
+  /// A scan added by AddScan
+  struct Scan {
+    std::string name;     ///< name of the scan
+    uint32_t count = 0;   ///< number of ranges
+    uint32_t offset = 0;  ///< index of the first range in ranges_
+    double stamp = 0;     ///< simulation time of the ranges, 0 if none yet
+    bool used = false;    ///< false once removed, the id may be reused
+  };
+
+  std::string name_;      ///< name of the shared memory object
+  void *data_ = nullptr;  ///< the mapping
+  size_t size_ = 0;       ///< size of the mapping
+  uint64_t step_ = 0;     ///< number of slots written
+  uint64_t generation_ = 0;        ///< generation of the directory
+  uint64_t body_generation_ = 0;   ///< BodyStates::generation_ of the names
+  bool names_valid_ = false;       ///< if the body names are written
+  bool truncated_warned_ = false;  ///< if warned about too many bodies
+
+  std::mutex mutex_;          ///< guards the scans, set from sensor threads
+  std::vector<Scan> scans_;   ///< the scans by id
+  std::vector<float> ranges_;  ///< latest ranges of the used scans
+  bool scans_dirty_ = false;  ///< if the scans changed since the last Write
+
+  /**
+   * @return The header of the object
+   */
+  StateExportHeader *Header() const {
+    return static_cast<StateExportHeader *>(data_);
+  }
+
+  /**
+   * @brief Pack the ranges of the used scans, with the mutex held
+   */
+  void PackScans();
+
+  /**
+   * @brief Write the names of the bodies and scans, with the mutex held
+   * @param[in] states The states of the model bodies
+   */
+  void WriteDirectory(const BodyStates &states);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_STATE_EXPORTER_H
@@ -0,0 +1,97 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_hash.h
+ * @brief	 Digest of the state of the simulation
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_STATE_HASH_H
+#define FLATLAND_SERVER_STATE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace flatland_server {
+
+/**
+ * This class computes the 64 bit FNV-1a digest of the bytes of values, e.g.
+ * of the poses of the bodies of a step. Equal values give equal digests on
+ * every platform of the same endianness, so the digests of two runs tell if
+ * their states stayed bit identical
+ */
+class StateHash {
+ public:
+  static const uint64_t OFFSET = 0xcbf29ce484222325ULL;  ///< empty digest
+
+  /**
+   * @brief Add bytes to the digest
+   * @param[in] data The bytes
+   * @param[in] size Number of bytes
+   */
+  void Add(const void *data, size_t size);
+
+  /**
+   * @brief Add the bytes of a value, which must have no padding
+   * @param[in] value The value
+   */
+  template <typename T>
+  void Add(const T &value) {
+    Add(&value, sizeof(value));
+  }
+
+  /**
+   * @brief Add the characters of a string
+   * @param[in] value The string
+   */
+  void Add(const std::string &value) { Add(value.data(), value.size()); }
+
+  /**
+   * @return The digest of the bytes added so far
+   */
+  uint64_t Get() const { return hash_; }
+
+ private:
+  uint64_t hash_ = OFFSET;  ///< the digest
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_STATE_HASH_H
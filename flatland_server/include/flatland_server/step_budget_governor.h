@@ -0,0 +1,141 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_budget_governor.h
+ * @brief	 Degrades sensor work while simulation steps overrun a budget
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_STEP_BUDGET_GOVERNOR_H
+#define FLATLAND_SERVER_STEP_BUDGET_GOVERNOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class watches the wall time taken by simulation steps against a
+ * budget. When steps keep overrunning the budget, it activates the next
+ * degradation in a configured priority order, and when steps are well under
+ * the budget again, it lifts the most recent one. Both directions require
+ * a run of consecutive steps, so a single slow step, e.g. a model spawn,
+ * does not change anything
+ */
+class StepBudgetGovernor {
+ public:
+  /// Ways to reduce the work of a step, bit flags
+  enum Degradation : uint32_t {
+    SKIP_VISUALIZATION = 1,  ///< stop publishing the debug visualization
+    REDUCE_SENSOR_RATE = 2,  ///< halve the update rate of lasers
+    COARSEN_BEAMS = 4,       ///< cast every other laser beam
+  };
+
+  /**
+   * @param[in] budget Wall time allowed per step in seconds, > 0
+   * @param[in] priorities Degradations in the order they are activated
+   * @param[in] overrun_steps Consecutive overrunning steps before degrading
+   * @param[in] recover_steps Consecutive recovered steps before restoring
+   * @param[in] recover_fraction Fraction of the budget a step must stay under
+   * to count as recovered
+   */
+  StepBudgetGovernor(double budget, const std::vector<Degradation> &priorities,
+                     unsigned int overrun_steps = 10,
+                     unsigned int recover_steps = 200,
+                     double recover_fraction = 0.7);
+
+  /**
+   * @brief Account for a step
+   * @param[in] wall_time Wall time taken by the step in seconds
+   * @return true if the active degradations changed
+   */
+  bool AddStep(double wall_time);
+
+  /**
+   * @return The active degradations, or'ed Degradation flags
+   */
+  uint32_t GetDegradations() const;
+
+  /**
+   * @return The names of the active degradations, in priority order
+   */
+  std::vector<std::string> GetDegradationNames() const;
+
+  /**
+   * @return The number of active degradations
+   */
+  unsigned int GetLevel() const { return level_; }
+
+  /**
+   * @return The number of steps that overran the budget
+   */
+  uint64_t GetOverrunCount() const { return overruns_; }
+
+  /**
+   * @return The budget in seconds
+   */
+  double GetBudget() const { return budget_; }
+
+  /**
+   * @brief Get a degradation from its name, throws exception if unknown
+   * @param[in] name One of visualization, laser_rate and laser_beams
+   */
+  static Degradation ParseDegradation(const std::string &name);
+
+  /**
+   * @return The name of a degradation
+   */
+  static std::string DegradationName(Degradation degradation);
+
+ private:
+  double budget_;                         ///< wall time allowed per step
+  std::vector<Degradation> priorities_;   ///< activation order
+  unsigned int overrun_steps_;            ///< steps before degrading
+  unsigned int recover_steps_;            ///< steps before restoring
+  double recover_fraction_;               ///< fraction of budget to recover
+  unsigned int level_;                    ///< active degradations
+  unsigned int streak_;                   ///< consecutive steps in a state
+  bool overrunning_;                      ///< state the streak counts
+  uint64_t overruns_;                     ///< total overrunning steps
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_STEP_BUDGET_GOVERNOR_H
@@ -0,0 +1,241 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_timer.h
+ * @brief	 Timing of the stages of the simulation steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_STEP_TIMER_H
+#define FLATLAND_SERVER_STEP_TIMER_H
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/perf_counters.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace flatland_server {
+
+/**
+ * This class is a histogram of durations, with logarithmic buckets about 9%
+ * wide from 0.1us to about 100s, so that percentiles can be estimated without
+ * keeping the samples
+ */
+class TimingHistogram {
+ public:
+  static const int kBucketsPerOctave = 8;  ///< resolution of the buckets
+  static const int kBucketCount = 240;      ///< 30 octaves from kMinTime
+  static constexpr double kMinTime = 1e-7;  ///< upper end of the first bucket
+
+  TimingHistogram();
+
+  /**
+   * @brief Add a sample
+   * @param[in] seconds The duration
+   */
+  void Add(double seconds);
+
+  /**
+   * @brief Remove all samples
+   */
+  void Reset();
+
+  uint64_t GetCount() const { return count_; }
+  double GetMin() const { return count_ ? min_ : 0; }
+  double GetMax() const { return count_ ? max_ : 0; }
+  double GetMean() const { return count_ ? sum_ / count_ : 0; }
+
+  /**
+   * @brief Estimate a percentile, as the upper end of the bucket containing
+   * it, clamped to the range of the samples
+   * @param[in] p The percentile, between 0 and 100
+   * @return The estimate in seconds, 0 without samples
+   */
+  double GetPercentile(double p) const;
+
+ private:
+  std::array<uint64_t, kBucketCount> buckets_;  ///< samples per bucket
+  uint64_t count_;                               ///< number of samples
+  double sum_;                                   ///< sum of the samples
+  double min_;                                   ///< smallest sample
+  double max_;                                   ///< largest sample
+};
+
+/**
+ * This class collects the time spent in each stage of the simulation steps.
+ * The durations measured during a step are summed per stage, e.g. over the
+ * sub-steps of a step, and added to the histogram of the stage by EndStep.
+ * With PerfCounters, the hardware counters of the stages timed by a Scope are
+ * summed as well. Not thread safe, a world is timed from the thread stepping
+ * it
+ */
+class StepTimer {
+ public:
+  /// The stages, the Box2D ones are taken from b2Profile
+  enum Stage {
+    BEFORE_PHYSICS_STEP,
+    PHYSICS_STEP,
+    COLLIDE,
+    SOLVE,
+    SOLVE_INIT,
+    SOLVE_VELOCITY,
+    SOLVE_POSITION,
+    BROADPHASE,
+    SOLVE_TOI,
+    AFTER_PHYSICS_STEP,
+    INTERACTIVE_MARKERS,
+    VISUALIZATION,
+    COMMANDS,
+    SPIN,
+    STAGE_COUNT
+  };
+
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * This class measures the time until it is destroyed, if the timer is
+   * enabled
+   */
+  class Scope {
+   public:
+    /**
+     * @param[in] timer The timer to add the time to
+     * @param[in] stage The stage being timed
+     */
+    Scope(StepTimer &timer, Stage stage);
+    ~Scope();
+
+   private:
+    StepTimer &timer_;        ///< timer to add the time to
+    Stage stage_;             ///< stage being timed
+    Clock::time_point start_;  ///< start of the measurement
+    bool counted_;            ///< if the counters are read
+    PerfCounters::Sample start_counts_;  ///< counters at the start
+  };
+
+  StepTimer();
+
+  /**
+   * @brief Enable or disable the timing, disabled by default so that it costs
+   * nothing
+   * @param[in] enabled true to enable
+   */
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  bool IsEnabled() const { return enabled_; }
+
+  /**
+   * @brief Count the hardware events of the stages timed by a Scope, on the
+   * thread of the counters only, the scopes on other threads are only timed
+   * @param[in] counters The open counters, not owned, null to not count
+   */
+  void SetCounters(const PerfCounters *counters) { counters_ = counters; }
+
+  /**
+   * @brief Add time to a stage of the current step
+   * @param[in] stage The stage
+   * @param[in] seconds The time spent
+   */
+  void Add(Stage stage, double seconds);
+
+  /**
+   * @brief Add the Box2D stages of a b2World::Step to the current step
+   * @param[in] profile The profile of the Box2D step, in milliseconds
+   */
+  void AddProfile(const b2Profile &profile);
+
+  /**
+   * @brief Add the time of each stage that was timed since the last call to
+   * the histogram of the stage
+   */
+  void EndStep();
+
+  /**
+   * @brief Remove all samples, e.g. once they are published
+   */
+  void Reset();
+
+  /**
+   * @return The time of each stage in the step ended last by EndStep, 0 for
+   * the stages not timed in it
+   */
+  const std::array<double, STAGE_COUNT> &GetLastStep() const { return last_; }
+
+  /**
+   * @return The histogram of a stage
+   */
+  const TimingHistogram &GetHistogram(Stage stage) const {
+    return histograms_[stage];
+  }
+
+  /**
+   * @return The sum of the counters of a stage over the steps it was counted
+   * in, see GetCountedSteps
+   */
+  const PerfCounters::Sample &GetCounts(Stage stage) const {
+    return counts_[stage];
+  }
+
+  /**
+   * @return The number of steps the counters of a stage were read in
+   */
+  uint64_t GetCountedSteps(Stage stage) const { return counted_steps_[stage]; }
+
+  /**
+   * @return The name of a stage
+   */
+  static const char *GetStageName(Stage stage);
+
+ private:
+  bool enabled_;                                     ///< if timing is enabled
+  const PerfCounters *counters_;                     ///< null to not count
+  std::array<PerfCounters::Sample, STAGE_COUNT>
+      pending_counts_;                               ///< of the current step
+  std::array<bool, STAGE_COUNT> counted_;            ///< stages counted in step
+  std::array<PerfCounters::Sample, STAGE_COUNT> counts_;  ///< since Reset
+  std::array<uint64_t, STAGE_COUNT> counted_steps_;  ///< since Reset
+  std::array<double, STAGE_COUNT> pending_;          ///< time of current step
+  std::array<bool, STAGE_COUNT> timed_;              ///< stages timed in step
+  std::array<double, STAGE_COUNT> last_;             ///< time of last step
+  std::array<TimingHistogram, STAGE_COUNT> histograms_;  ///< of each stage
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_STEP_TIMER_H
@@ -0,0 +1,120 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 task_pool.h
+ * @brief	 Defines a pool of threads running independent tasks
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_TASK_POOL_H
+#define FLATLAND_SERVER_TASK_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class is a pool of threads running one function call per index, used
+ * to step independent worlds, or the plugins of independent models, in
+ * parallel. It is separate from the SensorExecutor since the sensors submit
+ * work to the executor and wait for it while being stepped, which would
+ * deadlock the executor's workers if they were running the steps themselves
+ */
+class TaskPool {
+ public:
+  /**
+   * @brief Constructor, starts the threads
+   * @param[in] num_threads Number of threads, the calling thread of Run also
+   * takes part, so 0 runs everything on the calling thread
+   */
+  explicit TaskPool(unsigned int num_threads);
+
+  /**
+   * @brief Destructor, joins the threads
+   */
+  ~TaskPool();
+
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+
+  /**
+   * @brief Call a function for each index in [0, count), blocks until all
+   * calls are done. Not reentrant
+   * @param[in] count Number of calls
+   * @param[in] func Called with the index
+   */
+  void Run(unsigned int count, const std::function<void(unsigned int)> &func);
+
+  /**
+   * @return Number of threads, not counting the calling thread
+   */
+  unsigned int GetNumThreads() const { return threads_.size(); }
+
+ private:
+  std::vector<std::thread> threads_;  ///< the threads
+  std::mutex mutex_;                  ///< guards the members below
+  std::condition_variable start_cv_;  ///< signaled when a run starts
+  std::condition_variable done_cv_;   ///< signaled when a run is done
+  const std::function<void(unsigned int)> *func_ = nullptr;  ///< current run
+  unsigned int count_ = 0;      ///< number of calls of the current run
+  unsigned int next_ = 0;       ///< next index to call
+  unsigned int running_ = 0;    ///< calls in progress
+  unsigned int generation_ = 0;  ///< incremented for each run
+  bool stop_ = false;           ///< tells the threads to exit
+
+  /**
+   * @brief Take indices of the current run and call the function until there
+   * are none left, must be called with the lock held
+   * @param[in] lock The lock on mutex_
+   */
+  void Work(std::unique_lock<std::mutex> &lock);
+
+  /**
+   * @brief Thread main loop
+   */
+  void ThreadLoop();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_TASK_POOL_H
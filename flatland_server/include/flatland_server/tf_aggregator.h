@@ -0,0 +1,148 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tf_aggregator.h
+ * @brief	 Collects the transforms of the plugins into one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_TF_AGGREGATOR_H
+#define FLATLAND_SERVER_TF_AGGREGATOR_H
+
+#include <geometry_msgs/TransformStamped.h>
+#include <ros/ros.h>
+#include <tf2_msgs/TFMessage.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class collects the transforms sent by the plugins of all worlds, and
+ * publishes them as one tf2_msgs/TFMessage on /tf per flush, instead of one
+ * message per plugin and update. Transforms that never change, such as the
+ * mounts of the sensors, are published once on the latched /tf_static
+ */
+class TfAggregator {
+ private:
+  TfAggregator();
+
+  static bool enabled_;  ///< see SetEnabled
+  static double rate_;   ///< see SetRate
+
+  /// guards all members below, plugins may send from the threads of the
+  /// worlds or of the sensors
+  std::mutex mutex_;
+  /// index in latest_ by child frame
+  std::unordered_map<std::string, size_t> slots_;
+  std::vector<geometry_msgs::TransformStamped> latest_;  ///< by slot
+  std::vector<bool> dirty_;  ///< if latest_[i] was sent since the last flush
+  /// the static transforms by child frame
+  std::map<std::string, geometry_msgs::TransformStamped> static_;
+  bool static_changed_ = false;  ///< if static_ must be published again
+  ros::Time last_flush_;         ///< simulation time of the last flush
+  tf2_msgs::TFMessage message_;  ///< reused between flushes
+
+ public:
+  ros::NodeHandle node_;
+  ros::Publisher tf_publisher_;      ///< publishes /tf
+  ros::Publisher static_publisher_;  ///< publishes the latched /tf_static
+
+  /**
+   * @brief Return the singleton object
+   */
+  static TfAggregator& Get();
+
+  /**
+   * @brief Let the plugins send their transforms through the aggregator
+   * instead of broadcasting them themselves. Disabled by default, must be
+   * called before the plugins are loaded
+   * @param[in] enabled true to enable
+   */
+  static void SetEnabled(bool enabled);
+
+  /**
+   * @return true if the plugins send their transforms through the
+   * aggregator, see SetEnabled
+   */
+  static bool IsEnabled();
+
+  /**
+   * @brief Set the rate of the flushes of /tf in simulation time
+   * @param[in] rate The rate in Hz, 0 to flush on every call of Publish
+   */
+  static void SetRate(double rate);
+
+  /**
+   * @brief Send a transform with the next flush, it replaces a transform of
+   * the same child frame that was not flushed yet
+   * @param[in] transform The transform
+   */
+  void Send(const geometry_msgs::TransformStamped& transform);
+
+  /**
+   * @brief Send transforms with the next flush, see Send
+   * @param[in] transforms The transforms
+   */
+  void Send(const std::vector<geometry_msgs::TransformStamped>& transforms);
+
+  /**
+   * @brief Publish a transform that never changes on /tf_static, it replaces
+   * the static transform of the same child frame. All static transforms are
+   * published again by the next Publish, latched for late subscribers
+   * @param[in] transform The transform
+   */
+  void SendStatic(const geometry_msgs::TransformStamped& transform);
+
+  /**
+   * @brief Flush the transforms that were sent since the last flush in one
+   * message, if the period of the rate has passed, and the static transforms
+   * if they changed
+   * @param[in] now The current simulation time
+   */
+  void Publish(const ros::Time& now);
+};
+}
+
+#endif  // FLATLAND_SERVER_TF_AGGREGATOR_H
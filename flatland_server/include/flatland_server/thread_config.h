@@ -0,0 +1,108 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 thread_config.h
+ * @brief	 Real time scheduling, CPU pinning and memory locking of threads
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_THREAD_CONFIG_H
+#define FLATLAND_SERVER_THREAD_CONFIG_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class configures threads to run with less scheduling noise on hosts
+ * shared with other processes: pinned to a set of CPUs, under the SCHED_FIFO
+ * real time policy, and with the memory of the process locked so that steps
+ * do not page fault. Linux only, the functions throw Exception when the
+ * system refuses, e.g. without the CAP_SYS_NICE or CAP_IPC_LOCK capability
+ * or the matching rtprio and memlock limits
+ */
+class ThreadConfig {
+ public:
+  /**
+   * @brief Parse a set of CPUs, throws Exception if invalid
+   * @param[in] spec Comma separated CPUs and ranges of CPUs, e.g. "2,4-7",
+   * where node:<n> stands for the CPUs of NUMA node n, e.g. "node:1". Empty
+   * for no CPUs
+   * @param[in] node_dir Directory of the NUMA nodes in sysfs
+   * @return The CPUs, sorted and without duplicates
+   */
+  static std::vector<unsigned int> ParseCpuSet(
+      const std::string &spec,
+      const std::string &node_dir = "/sys/devices/system/node");
+
+  /**
+   * @brief Restrict a thread to a set of CPUs, throws Exception on failure
+   * @param[in] thread The thread, e.g. pthread_self() or the native handle of
+   * a std::thread
+   * @param[in] cpus The CPUs, not empty
+   */
+  static void SetAffinity(pthread_t thread,
+                          const std::vector<unsigned int> &cpus);
+
+  /**
+   * @brief Get the CPUs a thread may run on
+   * @param[in] thread The thread
+   * @return The CPUs, sorted
+   */
+  static std::vector<unsigned int> GetAffinity(pthread_t thread);
+
+  /**
+   * @brief Run a thread under SCHED_FIFO, throws Exception on failure
+   * @param[in] thread The thread
+   * @param[in] priority Real time priority, from 1 to 99
+   */
+  static void SetFifoPriority(pthread_t thread, int priority);
+
+  /**
+   * @brief Lock the current and future memory of the process into RAM,
+   * throws Exception on failure
+   */
+  static void LockMemory();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_THREAD_CONFIG_H
@@ -49,24 +49,36 @@
 
 #include <ros/ros.h>
 #include <ros/time.h>
+#include <functional>
+#include <string>
 
 namespace flatland_server {
 
 class Timekeeper {
  public:
+  /// Receives the clock instead of the clock topic, see SetClockSink
+  typedef std::function<void(const ros::Time&)> ClockSink;
+
   ros::Publisher clock_pub_;       ///< the topic to publish the clock
+  ClockSink clock_sink_;           ///< replaces clock_pub_ if set
   ros::NodeHandle nh_;             ///< ROS Node handle
   ros::Time time_;                 ///< simulation time
   double max_step_size_;           ///< maximum step size
   const std::string clock_topic_;  ///< the name of the clock topic
+  double clock_period_;            ///< simulation time between clocks
+  mutable ros::Time clock_time_;   ///< time of the last published clock
+  mutable bool clock_published_;   ///< if a clock was published yet
 
   /**
    * @brief constructor
+   * @param[in] clock_topic The topic to publish the clock on, empty to not
+   * publish the clock, e.g. for the time of the sub-steps of a world
    */
-  Timekeeper();
+  explicit Timekeeper(const std::string& clock_topic = "/clock");
 
   /**
-   * @brief Step time once with the current set of parameters
+   * @brief Step time once with the current set of parameters, the clock is
+   * published when the clock period has passed since the last one
    */
   void StepTime();
 
@@ -75,6 +87,33 @@ class Timekeeper {
    */
   void UpdateRosClock() const;
 
+  /**
+   * @brief Publish the clock to ROS unless it was already published at the
+   * current time, e.g. at the steps where plugins publish their updates
+   */
+  void EnsureClockPublished() const;
+
+  /**
+   * @brief Pass the clock to a function instead of publishing it, e.g. for
+   * a process stepping the world itself without a ROS master
+   * @param[in] sink The function, empty to publish on the clock topic again
+   */
+  void SetClockSink(ClockSink sink);
+
+  /**
+   * @brief Set the rate at which StepTime publishes the clock
+   * @param[in] rate The rate in Hz of simulation time, 0 to publish on every
+   * step
+   */
+  void SetClockRate(double rate);
+
+  /**
+   * @brief Set the simulation time, e.g. to the time of a loaded checkpoint,
+   * and publish the clock
+   * @param[in] time The time
+   */
+  void SetSimTime(const ros::Time& time);
+
   /**
    * @brief Set the maximum step size
    * @param[in] step_size The step size
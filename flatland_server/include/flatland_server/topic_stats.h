@@ -0,0 +1,148 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 topic_stats.h
+ * @brief	Counts the messages published on each topic
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_TOPIC_STATS_H
+#define FLATLAND_SERVER_TOPIC_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class accumulates the messages published on each topic by the
+ * plugins and the debug visualization: their number, their serialized bytes
+ * and the wall time spent publishing them, to find the topics loading the
+ * network the most. The publishers record their messages through
+ * PublishCounted, see counted_publish.h. Thread safe, the plugins and the
+ * visualization may publish from other threads
+ */
+class TopicStats {
+ public:
+  /// The totals of a topic
+  struct Entry {
+    std::string topic;
+    uint64_t messages = 0;    ///< messages published
+    uint64_t bytes = 0;       ///< serialized bytes of the messages
+    uint64_t bytes_sent = 0;  ///< bytes times the subscribers at the time,
+                              /// an upper bound of the bytes sent over the
+                              /// network as intraprocess subscribers are not
+                              /// sent serialized messages
+    double publish_time = 0;      ///< wall seconds in publish
+    double max_publish_time = 0;  ///< wall seconds of the longest publish
+  };
+
+  /// The total the topics are ranked by
+  enum SortKey { BYTES_SENT, BYTES, MESSAGES, PUBLISH_TIME };
+
+  /**
+   * @brief Return the singleton object
+   */
+  static TopicStats &Get();
+
+  /**
+   * @brief Let the publishers record their messages. Disabled by default,
+   * the messages are not measured then
+   * @param[in] enabled true to enable
+   */
+  static void SetEnabled(bool enabled);
+
+  /**
+   * @return true if the publishers record their messages, see SetEnabled
+   */
+  static bool IsEnabled();
+
+  /**
+   * @brief Parse the name of a sort key
+   * @param[in] name bytes_sent, bytes, messages or publish_time, empty for
+   * bytes_sent
+   * @param[out] key The sort key
+   * @return false if the name is unknown
+   */
+  static bool ParseSortKey(const std::string &name, SortKey *key);
+
+  /**
+   * @brief Add a message published on a topic
+   * @param[in] topic The resolved name of the topic
+   * @param[in] bytes The serialized length of the message
+   * @param[in] subscribers The number of subscribers it was published to
+   * @param[in] seconds The wall time spent in publish
+   */
+  void Record(const std::string &topic, uint64_t bytes, uint32_t subscribers,
+              double seconds);
+
+  /**
+   * @brief Return the totals of the topics that published the most
+   * @param[in] count The maximum number of topics returned, 0 for all
+   * @param[in] key The total ranking the topics, largest first
+   */
+  std::vector<Entry> GetTopTalkers(size_t count, SortKey key) const;
+
+  /**
+   * @return The wall seconds the totals were accumulated over
+   */
+  double GetPeriod() const;
+
+  /**
+   * @brief Clear the totals of all topics, the period restarts
+   */
+  void Reset();
+
+ private:
+  TopicStats();
+
+  static bool enabled_;  ///< see SetEnabled
+
+  mutable std::mutex mutex_;  ///< guards the members below
+  std::unordered_map<std::string, Entry> entries_;  ///< by topic
+  std::chrono::steady_clock::time_point start_;     ///< of the period
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_TOPIC_STATS_H
@@ -0,0 +1,260 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tracer.h
+ * @brief	 Timeline tracing of the simulation loop
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_TRACER_H
+#define FLATLAND_SERVER_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class records spans of time, e.g. plugin callbacks or Box2D steps, to
+ * view the simulation loop on a timeline. Each thread writes to its own ring
+ * buffer without locking, so only the last events of each thread are kept.
+ * The trace is written in the Chrome trace event format, which is opened by
+ * chrome://tracing and ui.perfetto.dev. Tracing is disabled by default, and
+ * the FLATLAND_TRACE macro compiles to nothing with FLATLAND_NO_TRACING
+ */
+class Tracer {
+ public:
+  /**
+   * A span of time on one thread
+   */
+  struct Event {
+    static const int kNameSize = 48;  ///< longer names are truncated
+    char name[kNameSize];             ///< name of the span
+    const char *category;             ///< string literal grouping spans
+    uint64_t start;                   ///< in ns since the tracer was created
+    uint64_t duration;                ///< in ns
+  };
+
+  /**
+   * @brief Return the singleton object
+   */
+  static Tracer &Get();
+
+  /**
+   * @brief Clear the trace and start recording
+   * @param[in] buffer_size Number of events kept per thread
+   */
+  void Start(size_t buffer_size = 1 << 16);
+
+  /**
+   * @brief Stop recording, the trace is kept
+   */
+  void Stop();
+
+  /**
+   * @return true if recording
+   */
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Name the calling thread in the trace, the buffer of the thread is
+   * only created once it records
+   * @param[in] name The name
+   */
+  void SetThreadName(const std::string &name);
+
+  /**
+   * @brief Record a span on the calling thread, if recording
+   * @param[in] category String literal grouping spans
+   * @param[in] name Name of the span, copied
+   * @param[in] start Start time, from Now
+   * @param[in] end End time, from Now
+   */
+  void Record(const char *category, const char *name, uint64_t start,
+              uint64_t end);
+
+  /**
+   * @return The current time in ns since the tracer was created
+   */
+  static uint64_t Now();
+
+  /**
+   * @brief Write the events kept in the Chrome trace event JSON format. The
+   * events of threads recording during the call may be inconsistent, so it
+   * should be called between steps
+   * @param[in] out The stream to write to
+   * @return The number of events written
+   */
+  size_t WriteChromeTrace(std::ostream &out);
+
+  /**
+   * @brief Write the events kept that overlap a window of time, after events
+   * of the caller, e.g. the steps of a FlightRecorder
+   * @param[in] out The stream to write to
+   * @param[in] begin Start of the window, from Now
+   * @param[in] end End of the window, from Now
+   * @param[in] extra_events Events written first, as JSON objects
+   * @return The number of events of the tracer written
+   */
+  size_t WriteChromeTrace(std::ostream &out, uint64_t begin, uint64_t end,
+                          const std::vector<std::string> &extra_events);
+
+  /**
+   * @brief Sum the durations of the spans kept by their name, e.g. to log the
+   * time spent in each phase of loading a world
+   * @param[in] category Only the spans of this category are summed
+   * @return Total duration in ns of the spans of each name
+   */
+  std::map<std::string, uint64_t> SumDurations(const std::string &category);
+
+  /**
+   * @brief Write the trace to a file, throws Exception on failure
+   * @param[in] path Path of the file
+   * @return The number of events written
+   */
+  size_t DumpChromeTrace(const std::string &path);
+
+ private:
+  /**
+   * The ring buffer of one thread
+   */
+  struct ThreadBuffer {
+    std::vector<Event> events;         ///< the ring buffer
+    std::atomic<uint64_t> count{0};    ///< events recorded by the thread
+    unsigned int tid;                  ///< id of the thread in the trace
+    std::string name;                  ///< name of the thread in the trace
+  };
+
+  std::atomic<bool> enabled_;  ///< if recording
+  size_t buffer_size_;         ///< events kept per thread
+  std::mutex mutex_;           ///< guards buffers_
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;  ///< of all threads
+                                                        /// that recorded
+  static thread_local ThreadBuffer *thread_buffer_;  ///< of calling thread
+  static thread_local std::string thread_name_;      ///< of calling thread
+
+  /**
+   * @brief Private constructor for the singleton
+   */
+  Tracer();
+
+  /**
+   * @return The buffer of the calling thread, created on first use
+   */
+  ThreadBuffer *GetThreadBuffer();
+};
+
+/**
+ * This class records a span from its construction to its destruction, if the
+ * tracer is recording when it is constructed
+ */
+class TraceScope {
+ public:
+  /**
+   * @param[in] category String literal grouping spans
+   * @param[in] name Name of the span
+   */
+  TraceScope(const char *category, const char *name)
+      : category_(category),
+        name_(name),
+        recording_(Tracer::Get().IsEnabled()),
+        start_(recording_ ? Tracer::Now() : 0),
+        parent_(current_) {
+    if (recording_) {
+      current_ = name_;
+    }
+  }
+
+  /**
+   * @param[in] category String literal grouping spans
+   * @param[in] name Name of the span, must outlive the scope
+   */
+  TraceScope(const char *category, const std::string &name)
+      : TraceScope(category, name.c_str()) {}
+
+  ~TraceScope() {
+    if (recording_) {
+      Tracer::Get().Record(category_, name_, start_, Tracer::Now());
+      current_ = parent_;
+    }
+  }
+
+  /**
+   * @return Name of the innermost span recording on the calling thread,
+   * nullptr if none, see SamplingProfiler
+   */
+  static const char *Current() { return current_; }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+ private:
+  const char *category_;  ///< category of the span
+  const char *name_;      ///< name of the span
+  bool recording_;        ///< if the tracer was recording at the start
+  uint64_t start_;        ///< start of the span
+  const char *parent_;    ///< innermost span when this one started
+  static thread_local const char *current_;  ///< innermost span recording
+                                             /// on the calling thread
+};
+};  // namespace flatland_server
+
+#define FLATLAND_TRACE_CONCAT_(a, b) a##b
+#define FLATLAND_TRACE_CONCAT(a, b) FLATLAND_TRACE_CONCAT_(a, b)
+
+#ifdef FLATLAND_NO_TRACING
+#define FLATLAND_TRACE(category, name)
+#else
+/**
+ * Record a span named name in category until the end of the current scope
+ */
+#define FLATLAND_TRACE(category, name)               \
+  flatland_server::TraceScope FLATLAND_TRACE_CONCAT( \
+      flatland_trace_scope_, __LINE__)(category, name)
+#endif
+
+#endif  // FLATLAND_SERVER_TRACER_H
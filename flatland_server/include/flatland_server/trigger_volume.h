@@ -0,0 +1,152 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trigger_volume.h
+ * @brief	 Finds the fixtures overlapping shapes without Box2D contacts
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_TRIGGER_VOLUME_H
+#define FLATLAND_SERVER_TRIGGER_VOLUME_H
+
+#include <Box2D/Box2D.h>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class finds the fixtures overlapping shapes attached to a body, with
+ * b2World::QueryAABB and b2TestOverlap, only when Update is called. Unlike
+ * Box2D sensor fixtures, the shapes create no contacts in the solver, and
+ * no contact callback is called for them on every step. Plugins call
+ * Update at their own update rate, e.g. BoolSensor with trigger_volume
+ */
+class TriggerVolume : private b2QueryCallback {
+ public:
+  /**
+   * @brief Constructor
+   * @param[in] body The body the shapes are attached to, its own fixtures
+   * never occupy the volume
+   */
+  explicit TriggerVolume(b2Body *body);
+
+  /**
+   * @brief Add a shape to the volume
+   * @param[in] shape The shape in the frame of the body, it must outlive the
+   * volume
+   * @param[in] filter Only the fixtures the shape would collide with by
+   * this filter occupy it, as for a fixture
+   */
+  void AddShape(const b2Shape *shape, const b2Filter &filter = b2Filter());
+
+  /**
+   * @brief Turn the sensor fixtures of the body into shapes of the volume.
+   * Their filters are kept for the volume and cleared in Box2D, so they do
+   * not create contacts anymore
+   * @return The number of fixtures turned into shapes
+   */
+  int AddSensorFixtures();
+
+  /**
+   * @brief Find the fixtures overlapping the shapes now, and those that
+   * entered and left the volume since the last update
+   * @return true if a fixture entered or left the volume
+   */
+  bool Update();
+
+  /**
+   * @return The fixtures overlapping the volume at the last update, sorted
+   */
+  const std::vector<b2Fixture *> &GetOccupants() const { return occupants_; }
+
+  /**
+   * @return The fixtures that entered the volume at the last update
+   */
+  const std::vector<b2Fixture *> &GetEntered() const { return entered_; }
+
+  /**
+   * @return The fixtures that left the volume at the last update. They may
+   * have been destroyed since, so they must not be dereferenced
+   */
+  const std::vector<b2Fixture *> &GetLeft() const { return left_; }
+
+  /**
+   * @return The number of shapes of the volume
+   */
+  size_t GetShapeCount() const { return shapes_.size(); }
+
+ private:
+  /**
+   * A shape of the volume
+   */
+  struct Shape {
+    const b2Shape *shape;  ///< the shape in the frame of the body
+    b2Filter filter;       ///< the filter of the shape
+  };
+
+  b2Body *body_;                       ///< body the shapes are attached to
+  std::vector<Shape> shapes_;          ///< shapes of the volume
+  std::vector<b2Fixture *> occupants_;  ///< overlapping fixtures, sorted
+  std::vector<b2Fixture *> current_;   ///< occupants found by the update
+  std::vector<b2Fixture *> entered_;   ///< fixtures entered at the update
+  std::vector<b2Fixture *> left_;      ///< fixtures left at the update
+  const Shape *query_shape_ = nullptr;  ///< shape queried by ReportFixture
+  int32 query_child_ = 0;               ///< child of the shape queried
+  b2Transform query_xf_;                ///< transform of the body queried
+
+  /**
+   * @brief Test a fixture found in the box of the queried shape
+   * @param[in] fixture The fixture
+   * @return true, to continue the query
+   */
+  bool ReportFixture(b2Fixture *fixture) override;
+
+  /**
+   * @brief Check if two filters let their fixtures collide, the same as the
+   * default b2ContactFilter
+   * @param[in] a First filter
+   * @param[in] b Second filter
+   * @return If they collide
+   */
+  static bool ShouldCollide(const b2Filter &a, const b2Filter &b);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_TRIGGER_VOLUME_H
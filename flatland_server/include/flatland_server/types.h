@@ -45,7 +45,7 @@
  */
 
 #include <Box2D/Box2D.h>
-#include <geometry_msgs/Pose2D.h>
+#include <array>
 
 #ifndef FLATLAND_SERVER_TYPES_H
 #define FLATLAND_SERVER_TYPES_H
@@ -132,6 +132,17 @@ struct Color {
 
   bool operator!=(const Color &c) const { return !operator==(c); }
 };
+
+/**
+ * Snapshot of a joint in the world frame, see Model::GetJointStates
+ */
+struct JointState {
+  b2Vec2 anchor_a;    ///< anchor point on body A
+  b2Vec2 anchor_b;    ///< anchor point on body B
+  b2Vec2 position_a;  ///< origin of body A
+  b2Vec2 position_b;  ///< origin of body B
+  Color color;        ///< color of the joint for visualization
+};
 }
 
 #endif
@@ -0,0 +1,154 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 vector_map.h
+ * @brief	 Read the walls of a layer from vector drawings
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_VECTOR_MAP_H
+#define FLATLAND_SERVER_VECTOR_MAP_H
+
+#include <flatland_server/types.h>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads the walls of a layer from vector drawings, SVG, DXF and
+ * GeoJSON, without rasterizing them. The polylines of the drawing become
+ * line segments with their collinear runs merged, so that a diagonal wall is
+ * one segment instead of a staircase of pixel edges
+ */
+class VectorMap {
+ public:
+  /**
+   * Formats of the vector drawings
+   */
+  enum Format { SVG, DXF, GEOJSON };
+
+  /**
+   * A polyline of a drawing, in the units of the drawing
+   */
+  struct Polyline {
+    std::vector<Vec2> points;  ///< vertices in order
+    bool closed = false;       ///< if the last vertex connects to the first
+  };
+
+  /**
+   * @brief Get the format of a drawing from the extension of its path,
+   * throws exception if it is unknown
+   * @param[in] path Path to the drawing, .svg, .dxf, .geojson or .json
+   * @return The format
+   */
+  static Format FormatOf(const std::string &path);
+
+  /**
+   * @brief Parse the format name of a layer yaml, throws exception if it is
+   * unknown
+   * @param[in] name svg, dxf or geojson
+   * @return The format
+   */
+  static Format ParseFormat(const std::string &name);
+
+  /**
+   * @brief Read the polylines of a drawing, throws exception upon failure
+   * @param[in] path Path to the drawing
+   * @param[in] format Format of the drawing
+   * @return The polylines
+   */
+  static std::vector<Polyline> Read(const std::string &path, Format format);
+
+  /**
+   * @brief Read the polylines of an SVG drawing: line, polyline, polygon,
+   * rect, circle, ellipse and path elements with their transforms. The y
+   * axis is flipped, so that the map looks like the drawing. Curves and arcs
+   * are flattened, the content of defs, clipPath, mask, marker, pattern and
+   * symbol is ignored
+   * @param[in] text Content of the drawing
+   * @return The polylines
+   */
+  static std::vector<Polyline> ParseSvg(const std::string &text);
+
+  /**
+   * @brief Read the polylines of the ENTITIES section of a DXF drawing:
+   * LINE, LWPOLYLINE, POLYLINE, CIRCLE and ARC entities, with the bulges of
+   * the polylines flattened. Blocks are not inserted
+   * @param[in] text Content of the drawing
+   * @return The polylines
+   */
+  static std::vector<Polyline> ParseDxf(const std::string &text);
+
+  /**
+   * @brief Read the polylines of the LineString, MultiLineString, Polygon
+   * and MultiPolygon geometries of a GeoJSON document, at any depth of its
+   * features and collections. The coordinates are used as they are
+   * @param[in] text Content of the document
+   * @return The polylines
+   */
+  static std::vector<Polyline> ParseGeoJson(const std::string &text);
+
+  /**
+   * @brief Convert polylines to line segments. Consecutive vertices closer
+   * than the tolerance are dropped, the runs of vertices within the
+   * tolerance of a straight line become one segment, and duplicate segments,
+   * e.g. walls drawn twice, are only kept once
+   * @param[in] polylines The polylines
+   * @param[in] tolerance Max distance of a dropped vertex from its segment,
+   * in the units of the drawing, 0 merges only exactly collinear vertices
+   * @return The line segments
+   */
+  static std::vector<LineSegment> ToSegments(
+      const std::vector<Polyline> &polylines, double tolerance);
+
+  /**
+   * @brief Read the line segments of a drawing, see Read and ToSegments
+   * @param[in] path Path to the drawing
+   * @param[in] format Format of the drawing
+   * @param[in] tolerance See ToSegments
+   * @return The line segments
+   */
+  static std::vector<LineSegment> Load(const std::string &path, Format format,
+                                       double tolerance);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_VECTOR_MAP_H
@@ -49,18 +49,73 @@
 
 #include <Box2D/Box2D.h>
 #include <flatland_server/collision_filter_registry.h>
+#include <flatland_server/geometry_stream.h>
 #include <flatland_server/interactive_marker_manager.h>
 #include <flatland_server/layer.h>
 #include <flatland_server/model.h>
+#include <flatland_server/model_states_publisher.h>
+#include <flatland_server/physics_backend.h>
+#include <flatland_server/physics_lod.h>
 #include <flatland_server/plugin_manager.h>
+#include <flatland_server/region_exchange.h>
+#include <flatland_server/step_timer.h>
 #include <flatland_server/timekeeper.h>
+#include <flatland_server/world_bundle.h>
+#include <flatland_server/world_snapshot.h>
+#include <ctime>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace flatland_server {
 
+/**
+ * An entry of the models of a world file, as passed to World::LoadModel
+ */
+struct ModelEntry {
+  std::string path;  ///< path to the model yaml file
+  std::string ns;    ///< namespace, inside the namespace of the world
+  std::string name;  ///< name of the model
+  Pose pose;         ///< initial pose of the model
+};
+
+/**
+ * A model parsed by World::PrepareModel, with its plugins created, which
+ * World::CommitModel adds to the world
+ */
+struct PreparedModel {
+  std::string yaml_path;  ///< absolute path of the model yaml file
+  std::string ns;         ///< namespace, inside the namespace of the world
+  std::string name;       ///< name of the model
+  Pose pose;              ///< initial pose of the model
+  YamlReader reader;      ///< the parsed model yaml file
+  std::time_t yaml_mtime;  ///< modification time of the model yaml file
+  std::vector<PluginManager::PreparedPlugin> plugins;  ///< not initialized
+};
+
+/**
+ * A model yaml file loaded and preprocessed once, which the instances of the
+ * model are read from while the file is unchanged
+ */
+struct ModelTemplate {
+  std::time_t mtime;     ///< modification time of the file when loaded
+  YAML::Node node;       ///< the preprocessed yaml, never handed out directly
+  bool bundled = false;  ///< if read from a WorldBundle, which never changes
+};
+
+/**
+ * The models of a model yaml file parked by World::DeleteModel, which
+ * World::CommitModel reuses instead of loading new models
+ */
+struct ModelPool {
+  std::time_t mtime;            ///< modification time of the file they were
+                                /// loaded from, older models are deleted
+  std::vector<Model *> models;  ///< the parked models
+};
+
 /**
  * This class defines a world in the simulation. A world contains layers
  * that can represent environments at multiple levels, and models which are
@@ -74,21 +129,74 @@ class World : public b2ContactListener {
   std::map<std::vector<std::string>, Layer *>
       layers_name_map_;           ///< map of all layers and thier name
   std::vector<Layer *> layers_;   ///< list of layers
+  std::unordered_map<std::string, Layer *>
+      layers_by_name_;  ///< layers_ by each of their names, see GetLayer
   std::vector<Model *> models_;   ///< list of models
+  std::unordered_map<std::string, Model *>
+      models_by_name_;  ///< models_ by name, see GetModel
+  std::unordered_map<uint32_t, Model *>
+      models_by_id_;        ///< models_ by Model::id_, see GetModelById
+  uint32_t next_model_id_;  ///< id of the next model added
   CollisionFilterRegistry cfr_;   ///< collision registry for layers and models
   PluginManager plugin_manager_;  ///< for loading and updating plugins
   bool service_paused_;  ///< indicates if simulation is paused by a service
                          /// call or not
-  InteractiveMarkerManager
-      int_marker_manager_;  ///< for dynamically moving models from Rviz
-  int physics_position_iterations_;  ///< Box2D solver param
-  int physics_velocity_iterations_;  ///< Box2D solver param
+  std::unique_ptr<InteractiveMarkerManager>
+      int_marker_manager_;  ///< for dynamically moving models from Rviz, null
+                            /// in headless worlds
+  std::unique_ptr<PhysicsBackend>
+      physics_;  ///< steps physics_world_, Box2DBackend unless another
+                 /// backend is chosen by the physics_backend property
+  std::string namespace_;  ///< namespace of the world, prepended to the
+                           /// namespaces of its models and plugins
+  WorldSnapshot snapshot_;  ///< state restored by the reset_world service,
+                            /// taken once the world is loaded
+  double physics_substep_size_;    ///< maximum size of the Box2D sub-steps
+                                   /// of a step, 0 to not sub-step
+  Timekeeper substep_timekeeper_;  ///< time of the current sub-step
+  StepTimer step_timer_;  ///< time spent in the stages of Update, disabled
+                          /// unless enabled by the simulation manager
+  std::map<std::string, ModelTemplate>
+      model_templates_;              ///< model yaml files by absolute path
+  std::mutex model_templates_mutex_;  ///< PrepareModel runs on any thread
+  std::map<std::string, ModelPool>
+      model_pools_;               ///< parked models by absolute yaml path
+  unsigned int model_pool_size_;  ///< maximum number of parked models per
+                                  /// model file, 0 to delete the models
+  unsigned int load_threads_ = 0;  ///< threads preparing the models of the
+                                   /// world file, 0 to load them in series
+  bool sensor_request_ = false;      ///< sensor_threads_ passed to the executor
+  unsigned int sensor_threads_ = 0;  ///< see SensorExecutor::Request
+  std::shared_ptr<const WorldBundle>
+      bundle_;  ///< the bundle the world was loaded from, null if loaded from
+                /// its yaml files
+  std::vector<Layer *> tiled_layers_;  ///< scratch of UpdateLayerTiles
+  std::map<Layer *, std::time_t>
+      watched_layers_;  ///< layers reloaded when their files change, with the
+                        /// latest modification time of the files
+  ros::WallTime next_layer_check_;  ///< when watched_layers_ are checked next
+  std::vector<b2AABB> tile_regions_;        ///< scratch of UpdateLayerTiles
+  std::unique_ptr<RegionExchange>
+      region_;  ///< exchanges the models with the servers of the other
+                /// regions, null unless the world is a region of a
+                /// distributed simulation
+  std::unique_ptr<ModelStatesPublisher>
+      model_states_;  ///< publishes the states of the models, null unless
+                      /// the model_states_rate property is set
+  std::unique_ptr<GeometryStream>
+      geometry_stream_;  ///< publishes the geometry and body poses, null
+                         /// unless the geometry_stream_rate property is set
+  std::unique_ptr<PhysicsLod>
+      physics_lod_;  ///< reduces the models outside the regions of interest,
+                     /// null unless the physics_lod property is set
 
   /**
    * @brief Constructor for the world class. All data required for
    * initialization should be passed in here
+   * @param[in] ns Namespace of the world, empty for the global namespace
+   * @param[in] headless if true, no interactive markers are created
    */
-  World();
+  explicit World(const std::string &ns = "", bool headless = false);
 
   /**
    * @brief Destructor for the world class
@@ -96,11 +204,32 @@ class World : public b2ContactListener {
   ~World();
 
   /**
-   * @brief trigger world update include all physics and plugins
+   * @brief trigger world update include all physics and plugins. With
+   * physics_substep_size_, the step is split into as many equal Box2D
+   * sub-steps as needed to keep them below that size, see
+   * FlatlandPlugin::UpdatesPerSubstep
    * @param[in] timekeeper The time keeping object
    */
   void Update(Timekeeper &timekeeper);
 
+  /**
+   * @brief Step the Box2D world once and time it
+   * @param[in] step_size The time to step
+   */
+  void PhysicsStep(double step_size);
+
+  /**
+   * @brief Update the interactive markers, if the world has them
+   */
+  void UpdateInteractiveMarkers();
+
+  /**
+   * @brief Activate and evict the tiles of tiled layers around the models,
+   * called by Update before each physics step
+   * @param[in] time Current simulation time in seconds
+   */
+  void UpdateLayerTiles(double time);
+
   /**
    * @brief Box2D inherited begin contact
    * @param[in] contact Box2D contact information
@@ -142,15 +271,34 @@ class World : public b2ContactListener {
   void LoadLayers(YamlReader &layers_reader);
 
   /**
-   * @brief load models into the world. Throws YAMLException.
+   * @brief load models into the world. With load_threads_, the models are
+   * prepared in parallel and then committed in the order of the list, so the
+   * world is the same as when loaded in series. Throws YAMLException.
    * @param[in] layers_reader Yaml reader for node that has a list of models
    */
   void LoadModels(YamlReader &models_reader);
 
+  /**
+   * @brief Read the entries of the models of a world file, expanding the
+   * replicate entries into their copies. Throws YAMLException
+   * @param[in] models_reader Yaml reader for node that has a list of models
+   * @param[out] entries The models, in the order of the list
+   */
+  static void ReadModelEntries(YamlReader &models_reader,
+                               std::vector<ModelEntry> *entries);
+
+  /**
+   * @brief Read a replicate entry, see ReadModelEntries. Throws YAMLException
+   * @param[in] reader Yaml reader for the replicate node
+   * @param[out] entries The copies are appended to it
+   */
+  static void ReadReplicas(YamlReader &reader,
+                           std::vector<ModelEntry> *entries);
+
   /**
    * @brief load models into the world. Throws YAMLException.
    * @param[in] model_yaml_path Relative path to the model yaml file
-   * @param[in] ns Namespace of the robot
+   * @param[in] ns Namespace of the robot, inside the namespace of the world
    * @param[in] name Name of the model
    * @param[in] pose Initial pose of the model in x, y, yaw
    */
@@ -158,7 +306,43 @@ class World : public b2ContactListener {
                  const std::string &name, const Pose &pose);
 
   /**
-   * @brief remove model with a given name
+   * @brief The part of LoadModel which does not touch the world, i.e. loading
+   * and preprocessing the model yaml file and creating the plugins, so it may
+   * run on another thread while the world is stepped. Throws YAMLException
+   * and PluginException
+   * @param[in] model_yaml_path Relative path to the model yaml file
+   * @param[in] ns Namespace of the robot, inside the namespace of the world
+   * @param[in] name Name of the model
+   * @param[in] pose Initial pose of the model in x, y, yaw
+   * @return The model, to add by CommitModel
+   */
+  PreparedModel PrepareModel(const std::string &model_yaml_path,
+                             const std::string &ns, const std::string &name,
+                             const Pose &pose);
+
+  /**
+   * @brief Read a model yaml file from model_templates_, the file is only
+   * loaded and preprocessed again when its modification time changes. Throws
+   * YAMLException
+   * @param[in] path Absolute path to the model yaml file
+   * @param[out] mtime The modification time of the file, if not null
+   * @return A reader of a copy of the preprocessed yaml
+   */
+  YamlReader ReadModelYaml(const std::string &path,
+                           std::time_t *mtime = nullptr);
+
+  /**
+   * @brief Add a model prepared by PrepareModel: create its bodies and
+   * joints, initialize its plugins and create its interactive marker. Must run
+   * on the simulation thread between steps. Throws YAMLException and
+   * PluginException
+   * @param[in] prepared The model, its plugins are consumed
+   */
+  void CommitModel(PreparedModel &prepared);
+
+  /**
+   * @brief remove model with a given name. Its plugins are deleted, the
+   * model itself is parked in model_pools_ for reuse if there is room
    * @param[in] name The name of the model to remove
    */
   void DeleteModel(const std::string &name);
@@ -170,6 +354,127 @@ class World : public b2ContactListener {
    */
   void MoveModel(const std::string &name, const Pose &pose);
 
+  /**
+   * @brief wake up or put to sleep all the bodies of a model with a given
+   * name, see Model::SetAwake
+   * @param[in] name The name of the model
+   * @param[in] awake True to wake the model up, false to put it to sleep
+   */
+  void SetModelAwake(const std::string &name, bool awake);
+
+  /**
+   * @brief Get a model of the world using its name
+   * @param[in] name Name of the model
+   * @return pointer to the model, nullptr if the model does not exist
+   */
+  Model *GetModel(const std::string &name);
+
+  /**
+   * @brief Load the map of a layer again and update the layer with the
+   * fixtures that changed, see Layer::UpdateGeometry. Must run on the
+   * simulation thread between steps. Throws Exception if the layer does not
+   * exist, has no map, is tiled or was loaded from a bundle, and
+   * YAMLException if the map cannot be loaded, the layer is unchanged then
+   * @param[in] name Any name of the layer
+   * @param[out] removed Number of fixtures destroyed, if not null
+   * @param[out] added Number of fixtures created, if not null
+   */
+  void ReloadLayer(const std::string &name, size_t *removed = nullptr,
+                   size_t *added = nullptr);
+
+  /**
+   * @brief Reload the watched layers whose map yaml or map data changed on
+   * disk, at most once per second of wall time. Errors are logged, the layer
+   * keeps its geometry
+   */
+  void ReloadWatchedLayers();
+
+  /**
+   * @brief Get a layer of the world using any of its names
+   * @param[in] name Name of the layer
+   * @return pointer to the layer, nullptr if the layer does not exist
+   */
+  Layer *GetLayer(const std::string &name);
+
+  /**
+   * @brief Get a model of the world using its id, ids are not reused so a
+   * deleted model is never mistaken for a later one
+   * @param[in] id Id of the model, see Model::id_
+   * @return pointer to the model, nullptr if the model does not exist
+   */
+  Model *GetModelById(uint32_t id);
+
+  /**
+   * @brief Get the category bits of layers, throws Exception if a layer does
+   * not exist
+   * @param[in] layers Names of the layers, {"all"} for all of them
+   * @return The category bits
+   */
+  uint32_t GetLayerMask(const std::vector<std::string> &layers) const;
+
+  /**
+   * @brief Check if a footprint placed at each of the poses would overlap
+   * the fixtures of the given layers, sensors excluded, e.g. for planners
+   * testing candidate poses without spawning models. The poses are checked
+   * in parallel on the SensorExecutor, so this must run between steps.
+   * Throws Exception if a layer does not exist
+   * @param[in] footprint A circle or polygon in the frame of the poses
+   * @param[in] layers Names of the layers, {"all"} for all of them
+   * @param[in] poses The poses to check
+   * @return One entry per pose, 1 if the footprint collides there
+   */
+  std::vector<uint8_t> CheckCollisions(const b2Shape &footprint,
+                                       const std::vector<std::string> &layers,
+                                       const std::vector<Pose> &poses);
+
+  /**
+   * @brief Cast many rays against the fixtures of the given layers, sensors
+   * excluded, e.g. for external tools computing visibility on the geometry
+   * of the simulation. The rays are cast in packets by
+   * PhysicsBackend::RayCast on the SensorExecutor, so this must run between
+   * steps. Throws Exception if a layer does not exist or a direction is zero
+   * @param[in] origins Start of each ray
+   * @param[in] directions Direction of each ray, not necessarily normalized
+   * @param[in] max_range Length of the rays
+   * @param[in] layers Names of the layers, {"all"} for all of them
+   * @return Distance to the nearest hit of each ray, infinity if none
+   */
+  std::vector<float> RaycastBatch(const std::vector<b2Vec2> &origins,
+                                  const std::vector<b2Vec2> &directions,
+                                  float max_range,
+                                  const std::vector<std::string> &layers);
+
+  /**
+   * @brief Record the state of the models and plugins
+   * @return The snapshot, see Restore
+   */
+  WorldSnapshot Snapshot();
+
+  /**
+   * @brief Return the models and plugins to the state of a snapshot. Models
+   * are moved in place, models spawned since the snapshot are deleted and
+   * models deleted since the snapshot are reloaded. Throws Exception
+   * @param[in] snapshot A snapshot of this world
+   */
+  void Restore(const WorldSnapshot &snapshot);
+
+  /**
+   * @brief Save a snapshot of the world to a WorldCheckpoint file, with the
+   * states of the plugins that encode them. Throws Exception
+   * @param[in] path Path to the file
+   * @param[in] time The simulation time saved with it
+   */
+  void SaveCheckpoint(const std::string &path, const ros::Time &time);
+
+  /**
+   * @brief Return the world to a WorldCheckpoint file, see Restore. The
+   * models not in the world are loaded from the model templates, the yaml
+   * files are only parsed again if they changed. Throws Exception
+   * @param[in] path Path to the file
+   * @return The simulation time saved with the checkpoint
+   */
+  ros::Time LoadCheckpoint(const std::string &path);
+
   /**
    * @brief set the paused state of the simulation to true
    */
@@ -195,14 +500,19 @@ class World : public b2ContactListener {
    * @brief factory method to create a instance of the world class. Cleans all
    * the inputs before instantiation of the class. TThrows YAMLException.
    * @param[in] yaml_path Path to the world yaml file
+   * @param[in] ns Namespace of the world, used to run several worlds in the
+   * same process
+   * @param[in] headless if true, the world has no interactive markers
    * @return pointer to a new world
    */
-  static World *MakeWorld(const std::string &yaml_path);
+  static World *MakeWorld(const std::string &yaml_path,
+                          const std::string &ns = "", bool headless = false);
 
   /**
    * @brief Publish debug visualizations for everything
-   * @param[in] update_layers since layers are pretty much static, this
-   * parameter is used to skip updating layers
+   * @param[in] update_layers false to skip the layers, the layers only
+   * rebuild their markers when their geometry changed anyway, see
+   * Layer::DebugVisualize
    */
   void DebugVisualize(bool update_layers = true);
 };
@@ -0,0 +1,156 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 world_bundle.h
+ * @brief	 A world resolved into a single binary file
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_WORLD_BUNDLE_H
+#define FLATLAND_SERVER_WORLD_BUNDLE_H
+
+#include <yaml-cpp/yaml.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This class reads and writes world bundles, a world resolved into a single
+ * binary file: the preprocessed world yaml, the preprocessed yaml and the
+ * extracted geometry of each layer map, and the preprocessed yaml of each
+ * model. Loading a bundle skips the Lua preprocessor, the image decoding and
+ * the edge extraction. The file is memory mapped, the geometry is stored in
+ * the formats of LayerCache and LineSegmentsFile and used in place. The
+ * data is stored in native byte order
+ *
+ * The entries are keyed by the paths as written in the world yaml file,
+ * e.g. "map/map.yaml" and "model/turtlebot.model.yaml"
+ */
+class WorldBundle {
+ public:
+  static const char *WORLD_KEY;  ///< key of the world yaml
+
+  WorldBundle() = default;
+  ~WorldBundle();
+  WorldBundle(const WorldBundle &) = delete;
+  WorldBundle &operator=(const WorldBundle &) = delete;
+
+  /**
+   * @brief Check if a file is a world bundle
+   * @param[in] path Path to the file
+   * @return true if the file starts with the bundle magic
+   */
+  static bool IsBundle(const std::string &path);
+
+  /**
+   * @brief Resolve a world yaml file and everything it references into a
+   * bundle, throws exceptions upon failure. The environment variables and
+   * rosparams of the $eval expressions are evaluated now
+   * @param[in] world_path Path to the world yaml file
+   * @param[in] bundle_path Path to the bundle to write, the file is written
+   * next to it and renamed, so that readers never see a partial file
+   */
+  static void Build(const std::string &world_path,
+                    const std::string &bundle_path);
+
+  /**
+   * @brief Map a bundle, throws exception upon failure
+   * @param[in] path Path to the bundle
+   */
+  void Open(const std::string &path);
+
+  /**
+   * @brief Find an entry
+   * @param[in] key Key of the entry
+   * @param[out] data The content, 8 byte aligned, valid for the lifetime of
+   * this object
+   * @param[out] size Size of the content
+   * @return false if there is no such entry
+   */
+  bool Find(const std::string &key, const char **data, size_t *size) const;
+
+  /**
+   * @brief Parse a yaml entry
+   * @param[in] key Key of the entry
+   * @param[out] node The parsed yaml, a new node on every call
+   * @return false if there is no such entry
+   */
+  bool FindYaml(const std::string &key, YAML::Node *node) const;
+
+  /**
+   * @param[in] prefix Prefix of the keys
+   * @return The keys starting with the prefix, without the prefix
+   */
+  std::vector<std::string> Keys(const std::string &prefix) const;
+
+  /**
+   * @return Key of the yaml of a layer map, as written in the world yaml
+   */
+  static std::string MapKey(const std::string &map);
+
+  /**
+   * @return Key of the geometry of a layer map, as written in the world yaml
+   */
+  static std::string GeometryKey(const std::string &map);
+
+  /**
+   * @return Key of the yaml of a model, as written in the world yaml
+   */
+  static std::string ModelKey(const std::string &model);
+
+ private:
+  void *data_ = nullptr;  ///< mapped file
+  size_t size_ = 0;       ///< size of the mapped file
+  std::unordered_map<std::string, std::pair<const char *, size_t>>
+      entries_;  ///< content and size of the entries by key
+
+  /**
+   * @brief Unmap the file
+   */
+  void Close();
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_WORLD_BUNDLE_H
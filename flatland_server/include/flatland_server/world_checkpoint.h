@@ -0,0 +1,199 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 world_checkpoint.h
+ * @brief	 The dynamic state of a world saved to a binary file
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_WORLD_CHECKPOINT_H
+#define FLATLAND_SERVER_WORLD_CHECKPOINT_H
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/world_snapshot.h>
+#include <ros/time.h>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace flatland_server {
+
+/**
+ * This class builds the binary encoding of the checkpoints, for the plugins
+ * encoding their state, see FlatlandPlugin::EncodeState. The data is stored
+ * in native byte order
+ */
+class CheckpointWriter {
+ public:
+  /**
+   * @brief Append a value of a trivially copyable type
+   * @param[in] value The value
+   */
+  template <class T>
+  void Put(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable values are written as is");
+    data_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  /**
+   * @brief Append a string, preceded by its size
+   * @param[in] value The string
+   */
+  void PutString(const std::string &value) {
+    Put<uint32_t>(value.size());
+    data_.append(value);
+  }
+
+  /**
+   * @return The data written so far
+   */
+  const std::string &Data() const { return data_; }
+
+ private:
+  std::string data_;  ///< the encoding
+};
+
+/**
+ * This class reads the encoding built by a CheckpointWriter, in the same
+ * order. Reading past the end throws Exception
+ */
+class CheckpointReader {
+ public:
+  /**
+   * @param[in] data The encoding, must outlive the reader
+   */
+  explicit CheckpointReader(const std::string &data)
+      : data_(data.data()), end_(data.data() + data.size()) {}
+
+  /**
+   * @return The next value of a trivially copyable type
+   */
+  template <class T>
+  T Get() {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable values are read as is");
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  /**
+   * @return The next string
+   */
+  std::string GetString() {
+    uint32_t size = Get<uint32_t>();
+    return std::string(Take(size), size);
+  }
+
+  /**
+   * @brief Read the number of elements that follow, so that a corrupted count
+   * does not allocate more than the encoding can hold
+   * @param[in] min_size The fewest bytes an element is encoded in
+   * @return The count, throws Exception if the rest of the encoding is
+   * shorter than count elements of min_size bytes
+   */
+  uint32_t GetCount(size_t min_size) {
+    uint32_t count = Get<uint32_t>();
+    if (min_size > 0 && count > size_t(end_ - data_) / min_size) {
+      throw Exception("Flatland File: Checkpoint count " +
+                      std::to_string(count) + " exceeds the " +
+                      std::to_string(end_ - data_) + " bytes left");
+    }
+    return count;
+  }
+
+  /**
+   * @return true if everything was read
+   */
+  bool AtEnd() const { return data_ == end_; }
+
+ private:
+  const char *data_;  ///< the next byte
+  const char *end_;   ///< the end of the encoding
+
+  /**
+   * @brief Consume bytes, throws Exception if there are not as many left
+   * @param[in] size The number of bytes
+   * @return The first byte
+   */
+  const char *Take(size_t size) {
+    if (size_t(end_ - data_) < size) {
+      throw Exception("Flatland File: Truncated checkpoint data");
+    }
+    const char *start = data_;
+    data_ += size;
+    return start;
+  }
+};
+
+/**
+ * This class reads and writes world checkpoints, the dynamic state of a world
+ * saved to a binary file by the save_world service: the simulation time, and
+ * the WorldSnapshot of the world, i.e. the models with the paths of their
+ * yaml files, the transforms and velocities of their bodies, and the states
+ * of the plugins that encode them, see FlatlandPlugin::EncodeState
+ */
+class WorldCheckpoint {
+ public:
+  /**
+   * @brief Write a checkpoint, the file is written next to its final path and
+   * renamed, so that readers never see a partial file. Throws Exception upon
+   * failure
+   * @param[in] path Path to the file
+   * @param[in] snapshot The state of the world, the plugin states are saved
+   * from their WorldSnapshot::PluginState::encoded
+   * @param[in] time The simulation time
+   */
+  static void Write(const std::string &path, const WorldSnapshot &snapshot,
+                    const ros::Time &time);
+
+  /**
+   * @brief Read a checkpoint, throws Exception upon failure
+   * @param[in] path Path to the file
+   * @param[out] time The simulation time
+   * @return The state of the world, the plugin states are left encoded
+   */
+  static WorldSnapshot Read(const std::string &path, ros::Time *time);
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_WORLD_CHECKPOINT_H
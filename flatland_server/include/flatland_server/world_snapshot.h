@@ -0,0 +1,101 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 world_snapshot.h
+ * @brief	 Defines the recorded state of a world
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLATLAND_SERVER_WORLD_SNAPSHOT_H
+#define FLATLAND_SERVER_WORLD_SNAPSHOT_H
+
+#include <Box2D/Box2D.h>
+#include <boost/any.hpp>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+/**
+ * This struct holds the state of a world recorded by World::Snapshot, which
+ * World::Restore returns the world to without reloading anything
+ */
+struct WorldSnapshot {
+  /**
+   * State of a Box2D body
+   */
+  struct BodyState {
+    b2Vec2 position;         ///< position of the body origin
+    float angle;             ///< angle of the body
+    b2Vec2 linear_velocity;  ///< linear velocity of the body origin
+    float angular_velocity;  ///< angular velocity of the body
+    bool awake;              ///< if the body is awake
+  };
+
+  /**
+   * State of a model, joints have no state of their own since the joint
+   * positions follow from the bodies
+   */
+  struct ModelState {
+    std::string name;       ///< name of the model
+    std::string ns;         ///< namespace passed to World::LoadModel
+    std::string yaml_path;  ///< model file, to reload deleted models
+    std::vector<BodyState> bodies;  ///< states of the bodies, in order
+  };
+
+  /**
+   * State of a plugin returned by FlatlandPlugin::SaveState
+   */
+  struct PluginState {
+    std::string model;    ///< name of the model, empty for world plugins
+    std::string name;     ///< name of the plugin
+    boost::any state;     ///< state of the plugin
+    std::string encoded;  ///< the state encoded by FlatlandPlugin::EncodeState
+                          /// for a WorldCheckpoint, decoded by Restore when
+                          /// state is empty
+  };
+
+  bool valid = false;                ///< if a snapshot was recorded
+  std::vector<ModelState> models;    ///< states of the models
+  std::vector<PluginState> plugins;  ///< states of the plugins
+};
+};      // namespace flatland_server
+#endif  // FLATLAND_SERVER_WORLD_SNAPSHOT_H
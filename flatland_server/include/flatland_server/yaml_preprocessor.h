@@ -55,6 +55,7 @@
 #include <lualib.h>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace flatland_server {
@@ -62,6 +63,42 @@ namespace flatland_server {
 /**
  */
 namespace YamlPreprocessor {
+/**
+ * A Lua state shared by the $eval expressions of a preprocessing pass, each
+ * expression is compiled once per state. The expressions run in
+ * environments of their own, so that the globals they set are not seen by
+ * the others
+ */
+class LuaEvaluator {
+ private:
+  lua_State *L_;                                ///< the state, owned
+  std::unordered_map<std::string, int> chunks_;  ///< registry references of
+                                                 /// the compiled expressions
+
+ public:
+  /**
+   * @brief Open a state with the standard libraries, env and param
+   */
+  LuaEvaluator();
+
+  /**
+   * @brief Close the state
+   */
+  ~LuaEvaluator();
+
+  LuaEvaluator(const LuaEvaluator &) = delete;
+  LuaEvaluator &operator=(const LuaEvaluator &) = delete;
+
+  /**
+   * @brief Run an expression, results of expressions that depend on nothing
+   * but their text are memoized for the whole process
+   * @param[in] expression Lua code returning the value
+   * @param[out] result The value as a string, nil as an empty string
+   * @return false if the expression failed or returned no usable value
+   */
+  bool Evaluate(const std::string &expression, std::string *result);
+};
+
 /**
  * @brief Preprocess with a given node
  * @param[in/out] node A Yaml node to parse
@@ -83,12 +120,26 @@ YAML::Node LoadParse(const std::string &path);
  */
 void ProcessNodes(YAML::Node &node);
 
+/**
+ * @brief Find and run any $eval nodes
+ * @param[in/out] node A Yaml node to recursively parse
+ * @param[in] lua The state to run the expressions in
+ */
+void ProcessNodes(YAML::Node &node, LuaEvaluator &lua);
+
 /**
  * @brief Find and run any $eval expressions
  * @param[in/out] node A Yaml string node to parse
  */
 void ProcessScalarNode(YAML::Node &node);
 
+/**
+ * @brief Find and run any $eval expressions
+ * @param[in/out] node A Yaml string node to parse
+ * @param[in] lua The state to run the expression in
+ */
+void ProcessScalarNode(YAML::Node &node, LuaEvaluator &lua);
+
 /**
   * @brief Get an environment variable with an optional default value
   * @param[in/out] lua_State The lua state/stack to read/write to/from
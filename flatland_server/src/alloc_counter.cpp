@@ -0,0 +1,125 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 alloc_counter.cpp
+ * @brief	 Counting of the heap allocations of the simulation steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/alloc_counter.h>
+#include <ros/ros.h>
+#include <cstdlib>
+#include <new>
+
+namespace flatland_server {
+
+std::atomic<int> AllocCounter::active_(0);
+std::atomic<uint64_t> AllocCounter::allocations_(0);
+std::atomic<uint64_t> AllocCounter::bytes_(0);
+
+AllocCounter::Scope::Scope(const char *name) : name_(name) {
+  active_++;
+  start_ = Get();
+}
+
+AllocCounter::Scope::~Scope() {
+  Counts counts = GetCounts();
+  active_--;
+  if (counts.allocations > 0) {
+    ROS_WARN_THROTTLE_NAMED(1.0, "AllocCounter",
+                            "%s: %lu heap allocations of %lu bytes", name_,
+                            static_cast<unsigned long>(counts.allocations),
+                            static_cast<unsigned long>(counts.bytes));
+  }
+}
+
+AllocCounter::Counts AllocCounter::Scope::GetCounts() const {
+  Counts now = Get();
+  return {now.allocations - start_.allocations, now.bytes - start_.bytes};
+}
+
+bool AllocCounter::IsEnabled() {
+#ifdef FLATLAND_ALLOC_COUNTING
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocCounter::Counts AllocCounter::Get() {
+  return {allocations_.load(std::memory_order_relaxed),
+          bytes_.load(std::memory_order_relaxed)};
+}
+};  // namespace flatland_server
+
+#ifdef FLATLAND_ALLOC_COUNTING
+// the replaced global allocation functions, the other forms of operator new
+// and delete call these
+void *operator new(std::size_t size) {
+  flatland_server::AllocCounter::Record(size);
+  void *p = std::malloc(size > 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  flatland_server::AllocCounter::Record(size);
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+#endif
+#endif
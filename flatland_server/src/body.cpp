@@ -103,4 +103,18 @@ void Body::DebugOutput() const {
       physics_body_->GetAngularDamping(), physics_body_->GetLinearDamping());
 }
 
+BulkFixtures::BulkFixtures(b2World *physics_world)
+    : physics_world_(physics_world) {
+  physics_world_->BeginStaticBulk();
+}
+
+BulkFixtures::~BulkFixtures() { physics_world_->EndStaticBulk(); }
+
+BulkDestroy::BulkDestroy(b2World *physics_world)
+    : physics_world_(physics_world) {
+  physics_world_->BeginBulkDestroy();
+}
+
+BulkDestroy::~BulkDestroy() { physics_world_->EndBulkDestroy(); }
+
 };  // namespace flatland_server
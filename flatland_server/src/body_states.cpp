@@ -0,0 +1,171 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 body_states.cpp
+ * @brief	 Contiguous snapshot of the states of the bodies
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+
+namespace flatland_server {
+
+void BodyStates::Add(Body *body) {
+  generation_++;
+  body->state_index_ = bodies_.size();
+  bodies_.push_back(body);
+  x_.push_back(0);
+  y_.push_back(0);
+  angle_.push_back(0);
+  cos_.push_back(1);
+  sin_.push_back(0);
+  vx_.push_back(0);
+  vy_.push_back(0);
+  omega_.push_back(0);
+  Read(bodies_.size() - 1);
+}
+
+void BodyStates::Remove(Body *body) {
+  int i = IndexOf(body);
+  if (i < 0) {
+    return;
+  }
+
+  // the last body is moved into the hole, so the arrays stay contiguous
+  generation_++;
+  size_t last = bodies_.size() - 1;
+  bodies_[i] = bodies_[last];
+  x_[i] = x_[last];
+  y_[i] = y_[last];
+  angle_[i] = angle_[last];
+  cos_[i] = cos_[last];
+  sin_[i] = sin_[last];
+  vx_[i] = vx_[last];
+  vy_[i] = vy_[last];
+  omega_[i] = omega_[last];
+  bodies_[i]->state_index_ = i;
+
+  bodies_.pop_back();
+  x_.pop_back();
+  y_.pop_back();
+  angle_.pop_back();
+  cos_.pop_back();
+  sin_.pop_back();
+  vx_.pop_back();
+  vy_.pop_back();
+  omega_.pop_back();
+  body->state_index_ = -1;
+}
+
+void BodyStates::Refresh() {
+  refreshes_++;
+  for (size_t i = 0; i < bodies_.size(); i++) {
+    Read(i);
+  }
+}
+
+void BodyStates::Refresh(const Body *body) {
+  int i = IndexOf(body);
+  if (i >= 0) {
+    refreshes_++;
+    moves_++;
+    Read(i);
+  }
+}
+
+b2Transform BodyStates::GetTransform(const Body *body) const {
+  int i = IndexOf(body);
+  if (i < 0) {
+    return body->physics_body_->GetTransform();
+  }
+
+  b2Transform t;
+  t.p.Set(x_[i], y_[i]);
+  t.q.c = cos_[i];
+  t.q.s = sin_[i];
+  return t;
+}
+
+Pose BodyStates::GetPose(const Body *body) const {
+  int i = IndexOf(body);
+  if (i < 0) {
+    const b2Vec2 &p = body->physics_body_->GetPosition();
+    return Pose(p.x, p.y, body->physics_body_->GetAngle());
+  }
+  return Pose(x_[i], y_[i], angle_[i]);
+}
+
+b2Vec2 BodyStates::GetLinearVelocity(const Body *body) const {
+  int i = IndexOf(body);
+  if (i < 0) {
+    return body->physics_body_->GetLinearVelocity();
+  }
+  return b2Vec2(vx_[i], vy_[i]);
+}
+
+float BodyStates::GetAngularVelocity(const Body *body) const {
+  int i = IndexOf(body);
+  if (i < 0) {
+    return body->physics_body_->GetAngularVelocity();
+  }
+  return omega_[i];
+}
+
+int BodyStates::IndexOf(const Body *body) const {
+  // the index of a body added to another instance is not valid here
+  int i = body->state_index_;
+  return i >= 0 && size_t(i) < bodies_.size() && bodies_[i] == body ? i : -1;
+}
+
+void BodyStates::Read(size_t i) {
+  const b2Body *b = bodies_[i]->physics_body_;
+  const b2Transform &t = b->GetTransform();
+  x_[i] = t.p.x;
+  y_[i] = t.p.y;
+  angle_[i] = b->GetAngle();
+  cos_[i] = t.q.c;
+  sin_[i] = t.q.s;
+  vx_[i] = b->GetLinearVelocity().x;
+  vy_[i] = b->GetLinearVelocity().y;
+  omega_[i] = b->GetAngularVelocity();
+}
+};  // namespace flatland_server
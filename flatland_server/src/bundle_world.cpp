@@ -0,0 +1,87 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 bundle_world.cpp
+ * @brief	 Resolve a world into a WorldBundle for fast startup
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/world_bundle.h>
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <iostream>
+#include <string>
+
+/**
+ * @name        main
+ * @brief       Write the bundle of a world, by default next to the world
+ * yaml file with the extension .bundle. The node only runs so that the
+ * $eval expressions can read rosparams
+ */
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "bundle_world", ros::init_options::AnonymousName);
+
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: bundle_world <world.yaml> [<world.bundle>]"
+              << std::endl;
+    return 1;
+  }
+
+  std::string world_path = argv[1];
+  std::string bundle_path =
+      argc == 3
+          ? std::string(argv[2])
+          : boost::filesystem::path(world_path)
+                .replace_extension(".bundle")
+                .string();
+
+  try {
+    flatland_server::WorldBundle::Build(world_path, bundle_path);
+  } catch (const flatland_server::Exception &e) {
+    std::cerr << "Failed to bundle " << world_path << ": " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << bundle_path << std::endl;
+  return 0;
+}
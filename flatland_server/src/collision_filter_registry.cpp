@@ -44,7 +44,9 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <Box2D/Box2D.h>
 #include <flatland_server/collision_filter_registry.h>
+#include <algorithm>
 
 namespace flatland_server {
 
@@ -52,20 +54,49 @@ const int CollisionFilterRegistry::LAYER_NOT_EXIST;
 const int CollisionFilterRegistry::LAYER_ALREADY_EXIST;
 const int CollisionFilterRegistry::LAYERS_FULL;
 const int CollisionFilterRegistry::MAX_LAYERS;
+const int CollisionFilterRegistry::MAX_GROUPS;
+const size_t CollisionFilterRegistry::MAX_CACHED_BITS;
+
+static_assert(sizeof(b2Filter::categoryBits) * 8 ==
+                      CollisionFilterRegistry::MAX_LAYERS &&
+                  sizeof(uint32_t) * 8 == CollisionFilterRegistry::MAX_LAYERS,
+              "MAX_LAYERS must match the width of the Box2D category bits");
 
 CollisionFilterRegistry::CollisionFilterRegistry()
-    : no_collide_group_cnt_(0), collide_group_cnt_(0) {}
+    : no_collide_group_cnt_(0), collide_group_cnt_(0), used_layer_ids_(0) {}
 
 int CollisionFilterRegistry::RegisterCollide() {
+  std::lock_guard<std::mutex> lock(groups_mutex_);
   collide_group_cnt_++;
   return collide_group_cnt_;
 }
 
 int CollisionFilterRegistry::RegisterNoCollide() {
+  std::lock_guard<std::mutex> lock(groups_mutex_);
   no_collide_group_cnt_--;
   return no_collide_group_cnt_;
 }
 
+int CollisionFilterRegistry::RegisterGroup(const std::string &name,
+                                           bool collide) {
+  std::lock_guard<std::mutex> lock(groups_mutex_);
+  auto it = groups_.find(name);
+  if (it != groups_.end()) {
+    return it->second;
+  }
+
+  int group;
+  if (collide) {
+    if (collide_group_cnt_ >= MAX_GROUPS) return 0;
+    group = ++collide_group_cnt_;
+  } else {
+    if (-no_collide_group_cnt_ >= MAX_GROUPS) return 0;
+    group = --no_collide_group_cnt_;
+  }
+  groups_[name] = group;
+  return group;
+}
+
 bool CollisionFilterRegistry::IsLayersFull() const {
   return layer_id_table_.size() >= MAX_LAYERS;
 }
@@ -79,41 +110,34 @@ int CollisionFilterRegistry::RegisterLayer(std::string layer_name) {
     return LAYER_ALREADY_EXIST;
   }
 
-  // You have maximum number of ID you can assign. Loop through all the ones
-  // assigned currently and find on that is not used
-  int i;
-  for (i = 0; i < MAX_LAYERS; i++) {
-    std::map<std::string, int>::iterator it;
-    for (it = layer_id_table_.begin(); it != layer_id_table_.end(); it++) {
-      if (it->second == i) {
-        break;
-      }
-    }
-
-    if (it == layer_id_table_.end()) {
-      layer_id_table_[layer_name] = i;
-      break;
-    }
+  // take the lowest ID not set in the bitmap of assigned IDs, there is one
+  // since the layers are not full
+  int i = 0;
+  while (used_layer_ids_ & (uint32_t(1) << i)) {
+    i++;
   }
-
+  used_layer_ids_ |= uint32_t(1) << i;
+  layer_id_table_[layer_name] = i;
   return i;
 }
 
 int CollisionFilterRegistry::LookUpLayerId(std::string layer_name) const {
-  if (layer_id_table_.count(layer_name) == 0) {
+  auto it = layer_id_table_.find(layer_name);
+  if (it == layer_id_table_.end()) {
     return LAYER_NOT_EXIST;
   }
-  return layer_id_table_.at(layer_name);
+  return it->second;
 }
 
 std::vector<std::string> CollisionFilterRegistry::GetAllLayers() const {
   std::vector<std::string> layer_names;
 
-  std::map<std::string, int>::const_iterator it;
-  for (it = layer_id_table_.begin(); it != layer_id_table_.end(); it++) {
-    layer_names.push_back(it->first);
+  for (const auto &entry : layer_id_table_) {
+    layer_names.push_back(entry.first);
   }
 
+  // sorted, the order of the hash table is unspecified
+  std::sort(layer_names.begin(), layer_names.end());
   return layer_names;
 }
 
@@ -121,28 +145,49 @@ int CollisionFilterRegistry::LayersCount() const {
   return layer_id_table_.size();
 }
 
-uint16_t CollisionFilterRegistry::GetCategoryBits(
+uint32_t CollisionFilterRegistry::GetCategoryBits(
     const std::vector<std::string> &layers,
     std::vector<std::string> *invalid_layers) const {
   if (layers.size() == 1 && layers[0] == "all") {
-    return ~((uint16_t)0x0);
+    return ~((uint32_t)0x0);
   }
 
   if (invalid_layers) {
     invalid_layers->clear();
   }
-  uint16_t category_bits = 0;
 
+  std::string key;
+  for (const auto &layer : layers) {
+    key += layer;
+    key += '\n';
+  }
+
+  std::lock_guard<std::mutex> lock(bits_cache_mutex_);
+  auto cached = bits_cache_.find(key);
+  if (cached != bits_cache_.end()) {
+    return cached->second;
+  }
+
+  uint32_t category_bits = 0;
+  bool all_valid = true;
   for (const auto &layer : layers) {
     int layer_id = LookUpLayerId(layer);
 
-    if (layer_id < 0 && invalid_layers) {
-      invalid_layers->push_back(layer);
+    if (layer_id < 0) {
+      all_valid = false;
+      if (invalid_layers) {
+        invalid_layers->push_back(layer);
+      }
     } else {
-      category_bits |= 1 << layer_id;
+      category_bits |= uint32_t(1) << layer_id;
     }
   }
 
+  // lists with missing layers are not cached, the layers may be registered
+  // later and the invalid layers must be reported on every call
+  if (all_valid && bits_cache_.size() < MAX_CACHED_BITS) {
+    bits_cache_[key] = category_bits;
+  }
   return category_bits;
 }
 
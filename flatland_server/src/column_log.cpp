@@ -0,0 +1,477 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 column_log.cpp
+ * @brief	 Chunked columnar binary log of the state of a run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/column_log.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/yaml_reader.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace flatland_server {
+
+namespace {
+const char COLUMN_LOG_MAGIC[8] = {'F', 'L', 'C', 'O', 'L', 'L', 'O', 'G'};
+const uint32_t COLUMN_LOG_VERSION = 1;
+const uint8_t TABLE_BLOCK = 1;
+const uint8_t CHUNK_BLOCK = 2;
+const uint8_t RAW = 0;
+const uint8_t ZLIB = 1;
+const size_t MAX_QUEUED_BLOCKS = 8;  ///< chunks waiting for the thread
+
+void WriteVarint(std::vector<uint8_t> *out, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value) byte |= 0x80;
+    out->push_back(byte);
+  } while (value);
+}
+
+void WriteString(std::vector<uint8_t> *out, const std::string &s) {
+  WriteVarint(out, s.size());
+  out->insert(out->end(), s.begin(), s.end());
+}
+
+/**
+ * @brief Read a varint at pos, advances pos
+ * @return false if the data ends before the varint
+ */
+bool ReadVarint(const std::vector<char> &data, size_t *pos, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *pos < data.size(); shift += 7) {
+    uint8_t byte = data[(*pos)++];
+    *value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Read a string at pos, advances pos
+ * @return false if the data ends before the string
+ */
+bool ReadString(const std::vector<char> &data, size_t *pos, std::string *s) {
+  uint64_t size;
+  if (!ReadVarint(data, pos, &size) || size > data.size() - *pos) {
+    return false;
+  }
+  s->assign(data.data() + *pos, size);
+  *pos += size;
+  return true;
+}
+
+/**
+ * @return The number of bytes of the values of a column, split into streams
+ * when above 1
+ */
+uint8_t ValueWidth(ColumnLog::Type type) {
+  switch (type) {
+    case ColumnLog::FLOAT32:
+    case ColumnLog::FLOAT32_LIST:
+      return 4;
+    case ColumnLog::FLOAT64:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+bool HasLengths(ColumnLog::Type type) {
+  return type == ColumnLog::FLOAT32_LIST || type == ColumnLog::STRING;
+}
+
+/**
+ * @brief Split or join the byte streams of values, see ColumnLog
+ * @param[in] in The values
+ * @param[in] width Bytes per value
+ * @param[in] split true to split, false to join
+ * @param[out] out The result, as large as in
+ */
+void SplitStreams(const uint8_t *in, size_t size, uint8_t width, bool split,
+                  uint8_t *out) {
+  size_t n = size / width;
+  for (size_t i = 0; i < n; i++) {
+    for (uint8_t b = 0; b < width; b++) {
+      if (split) {
+        out[b * n + i] = in[i * width + b];
+      } else {
+        out[i * width + b] = in[b * n + i];
+      }
+    }
+  }
+}
+}
+
+ColumnLog::Writer::Writer(const std::string &path, int level,
+                          uint32_t chunk_rows)
+    : path_(path),
+      out_(path, std::ios::binary | std::ios::trunc),
+      level_(level),
+      chunk_rows_(std::max(chunk_rows, 1u)) {
+  uint8_t version[4] = {COLUMN_LOG_VERSION & 0xff,
+                        (COLUMN_LOG_VERSION >> 8) & 0xff,
+                        (COLUMN_LOG_VERSION >> 16) & 0xff,
+                        COLUMN_LOG_VERSION >> 24};
+  out_.write(COLUMN_LOG_MAGIC, sizeof(COLUMN_LOG_MAGIC));
+  out_.write(reinterpret_cast<const char *>(version), sizeof(version));
+  if (out_.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+  thread_ = std::thread(&Writer::Run, this);
+}
+
+ColumnLog::Writer::~Writer() {
+  try {
+    Close();
+  } catch (const Exception &) {
+    // nothing to report the failure to
+  }
+}
+
+uint32_t ColumnLog::Writer::AddTable(const std::string &name,
+                                     const std::vector<Column> &columns) {
+  uint32_t id = tables_.size();
+  tables_.emplace_back();
+  PendingTable &t = tables_.back();
+  t.columns = columns;
+  t.values.resize(columns.size());
+  t.lengths.resize(columns.size());
+
+  Block block;
+  WriteVarint(&block.header, TABLE_BLOCK);
+  WriteVarint(&block.header, id);
+  WriteString(&block.header, name);
+  WriteVarint(&block.header, columns.size());
+  for (const auto &column : columns) {
+    WriteString(&block.header, column.name);
+    WriteVarint(&block.header, column.type);
+  }
+  Enqueue(std::move(block));
+  return id;
+}
+
+void ColumnLog::Writer::Put(uint32_t table, uint32_t column,
+                            const float *values, uint32_t count) {
+  tables_[table].lengths[column].push_back(count);
+  Append(table, column, values, count * sizeof(float));
+}
+
+void ColumnLog::Writer::Put(uint32_t table, uint32_t column,
+                            const std::string &value) {
+  tables_[table].lengths[column].push_back(value.size());
+  Append(table, column, value.data(), value.size());
+}
+
+void ColumnLog::Writer::EndRow(uint32_t table) {
+  if (++tables_[table].rows >= chunk_rows_) {
+    Seal(table);
+  }
+}
+
+void ColumnLog::Writer::Seal(uint32_t table) {
+  PendingTable &t = tables_[table];
+  if (t.rows == 0) {
+    return;
+  }
+
+  Block block;
+  WriteVarint(&block.header, CHUNK_BLOCK);
+  WriteVarint(&block.header, table);
+  WriteVarint(&block.header, t.rows);
+  for (size_t c = 0; c < t.columns.size(); c++) {
+    if (HasLengths(t.columns[c].type)) {
+      const std::vector<uint32_t> &lengths = t.lengths[c];
+      const uint8_t *bytes = reinterpret_cast<const uint8_t *>(lengths.data());
+      block.buffers.emplace_back(bytes, bytes + lengths.size() * 4);
+      block.widths.push_back(1);
+      t.lengths[c].clear();
+    }
+    // the next chunk will be about as large
+    size_t size = t.values[c].size();
+    block.buffers.push_back(std::move(t.values[c]));
+    block.widths.push_back(ValueWidth(t.columns[c].type));
+    t.values[c].clear();
+    t.values[c].reserve(size);
+  }
+  t.rows = 0;
+  Enqueue(std::move(block));
+}
+
+void ColumnLog::Writer::Enqueue(Block block) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] {
+    return queue_.size() < MAX_QUEUED_BLOCKS || failed_;
+  });
+  if (failed_) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+  queue_.push_back(std::move(block));
+  cv_.notify_all();
+}
+
+void ColumnLog::Writer::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+
+  bool failed = false;
+  try {
+    for (uint32_t t = 0; t < tables_.size(); t++) {
+      Seal(t);
+    }
+  } catch (const Exception &) {
+    failed = true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  out_.close();
+  if (failed || failed_ || out_.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+}
+
+void ColumnLog::Writer::Run() {
+  std::vector<uint8_t> split, stored, header;
+  while (true) {
+    Block block;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+      if (queue_.empty()) {
+        return;
+      }
+      block = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    cv_.notify_all();
+
+    out_.write(reinterpret_cast<const char *>(block.header.data()),
+               block.header.size());
+    for (size_t b = 0; b < block.buffers.size(); b++) {
+      const std::vector<uint8_t> &raw = block.buffers[b];
+      const uint8_t *data = raw.data();
+      if (block.widths[b] > 1) {
+        split.resize(raw.size());
+        SplitStreams(raw.data(), raw.size(), block.widths[b], true,
+                     split.data());
+        data = split.data();
+      }
+
+      // stored raw when zlib does not help, e.g. for tiny buffers
+      uint8_t codec = RAW;
+      uLongf stored_size = raw.size();
+      if (level_ > 0 && !raw.empty()) {
+        stored.resize(compressBound(raw.size()));
+        stored_size = stored.size();
+        if (compress2(stored.data(), &stored_size, data, raw.size(),
+                      level_) == Z_OK &&
+            stored_size < raw.size()) {
+          codec = ZLIB;
+          data = stored.data();
+        } else {
+          stored_size = raw.size();
+        }
+      }
+
+      header.clear();
+      WriteVarint(&header, codec);
+      WriteVarint(&header, raw.size());
+      WriteVarint(&header, stored_size);
+      out_.write(reinterpret_cast<const char *>(header.data()), header.size());
+      out_.write(reinterpret_cast<const char *>(data), stored_size);
+    }
+
+    if (out_.fail()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      failed_ = true;
+      queue_.clear();
+      cv_.notify_all();
+      return;
+    }
+  }
+}
+
+std::vector<ColumnLog::Table> ColumnLog::Read(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+
+  const size_t header_size = sizeof(COLUMN_LOG_MAGIC) + 4;
+  if (data.size() < header_size ||
+      std::memcmp(data.data(), COLUMN_LOG_MAGIC, sizeof(COLUMN_LOG_MAGIC)) !=
+          0) {
+    throw Exception("Flatland File: Invalid column log " + Q(path));
+  }
+  uint32_t version = 0;
+  for (int i = 0; i < 4; i++) {
+    version |= uint32_t(uint8_t(data[sizeof(COLUMN_LOG_MAGIC) + i]))
+               << (8 * i);
+  }
+  if (version != COLUMN_LOG_VERSION) {
+    throw Exception("Flatland File: Unsupported column log version " +
+                    std::to_string(version) + " in " + Q(path));
+  }
+
+  // decodes the next buffer of a chunk, false if it is cut short
+  std::vector<uint8_t> raw;
+  auto read_buffer = [&](size_t *pos, uint8_t width,
+                         std::vector<uint8_t> *out) {
+    uint64_t codec, raw_size, stored_size;
+    if (!ReadVarint(data, pos, &codec) || !ReadVarint(data, pos, &raw_size) ||
+        !ReadVarint(data, pos, &stored_size) ||
+        stored_size > data.size() - *pos) {
+      return false;
+    }
+    const uint8_t *stored = reinterpret_cast<const uint8_t *>(data.data()) + *pos;
+    *pos += stored_size;
+
+    raw.resize(raw_size);
+    if (codec == RAW && stored_size == raw_size) {
+      std::copy(stored, stored + raw_size, raw.begin());
+    } else {
+      uLongf size = raw_size;
+      if (codec != ZLIB ||
+          uncompress(raw.data(), &size, stored, stored_size) != Z_OK ||
+          size != raw_size) {
+        throw Exception("Flatland File: Invalid column log " + Q(path));
+      }
+    }
+
+    size_t offset = out->size();
+    out->resize(offset + raw_size);
+    if (width > 1) {
+      SplitStreams(raw.data(), raw_size, width, false, out->data() + offset);
+    } else {
+      std::copy(raw.begin(), raw.end(), out->begin() + offset);
+    }
+    return true;
+  };
+
+  std::vector<Table> tables;
+  std::vector<uint8_t> lengths;
+  size_t pos = header_size;
+  while (pos < data.size()) {
+    uint64_t type, id;
+    if (!ReadVarint(data, &pos, &type) || !ReadVarint(data, &pos, &id)) {
+      break;  // cut short, the complete chunks are kept
+    }
+
+    if (type == TABLE_BLOCK) {
+      Table t;
+      uint64_t count;
+      if (id != tables.size() || !ReadString(data, &pos, &t.name) ||
+          !ReadVarint(data, &pos, &count)) {
+        break;
+      }
+      bool complete = true;
+      for (uint64_t c = 0; c < count && complete; c++) {
+        Column column;
+        uint64_t column_type;
+        complete = ReadString(data, &pos, &column.name) &&
+                   ReadVarint(data, &pos, &column_type);
+        if (complete && column_type > STRING) {
+          throw Exception("Flatland File: Invalid column log " + Q(path));
+        }
+        column.type = Type(column_type);
+        t.columns.push_back(column);
+      }
+      if (!complete) {
+        break;
+      }
+      t.values.resize(t.columns.size());
+      t.lengths.resize(t.columns.size());
+      tables.push_back(std::move(t));
+      continue;
+    }
+
+    if (type != CHUNK_BLOCK || id >= tables.size()) {
+      throw Exception("Flatland File: Invalid column log " + Q(path));
+    }
+
+    // a chunk cut short is dropped from all its columns
+    Table &t = tables[id];
+    Table chunk;
+    chunk.values.resize(t.columns.size());
+    chunk.lengths.resize(t.columns.size());
+    uint64_t rows;
+    bool complete = ReadVarint(data, &pos, &rows);
+    for (size_t c = 0; c < t.columns.size() && complete; c++) {
+      if (HasLengths(t.columns[c].type)) {
+        lengths.clear();
+        complete = read_buffer(&pos, 1, &lengths);
+        const uint32_t *l = reinterpret_cast<const uint32_t *>(lengths.data());
+        chunk.lengths[c].assign(l, l + lengths.size() / 4);
+      }
+      complete = complete &&
+                 read_buffer(&pos, ValueWidth(t.columns[c].type),
+                             &chunk.values[c]);
+    }
+    if (!complete) {
+      break;
+    }
+
+    t.rows += rows;
+    for (size_t c = 0; c < t.columns.size(); c++) {
+      t.values[c].insert(t.values[c].end(), chunk.values[c].begin(),
+                         chunk.values[c].end());
+      t.lengths[c].insert(t.lengths[c].end(), chunk.lengths[c].begin(),
+                          chunk.lengths[c].end());
+    }
+  }
+  return tables;
+}
+};  // namespace flatland_server
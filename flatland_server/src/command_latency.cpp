@@ -0,0 +1,130 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_latency.cpp
+ * @brief	 Latency from commands being received to their effects
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/command_latency.h>
+#include <time.h>
+
+namespace flatland_server {
+
+const char *CommandLatency::GetStageName(Stage stage) {
+  switch (stage) {
+    case DISPATCH:
+      return "dispatch";
+    case PHYSICS:
+      return "physics";
+    case ODOMETRY:
+      return "odometry";
+    case SCAN:
+      return "scan";
+    default:
+      return "unknown";
+  }
+}
+
+double CommandLatency::Now() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void CommandLatency::Receive(double received, double now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  commands_++;
+  if (pending_) {
+    superseded_++;
+  }
+  pending_ = true;
+  pending_received_ = received;
+  latencies_[DISPATCH].Add(now - received);
+}
+
+void CommandLatency::Apply(double sim_time, double now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!pending_) {
+    return;
+  }
+  pending_ = false;
+  latencies_[PHYSICS].Add(now - pending_received_);
+  applied_received_ = pending_received_;
+  applied_sim_time_ = sim_time;
+  armed_[ODOMETRY] = true;
+  armed_[SCAN] = true;
+}
+
+void CommandLatency::Publish(Stage stage, double sim_time, double now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!armed_[stage] || sim_time < applied_sim_time_ ||
+      (stage == SCAN && sim_time == applied_sim_time_)) {
+    return;
+  }
+  armed_[stage] = false;
+  latencies_[stage].Add(now - applied_received_);
+}
+
+TimingHistogram CommandLatency::GetLatency(Stage stage) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latencies_[stage];
+}
+
+uint64_t CommandLatency::GetCommandCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return commands_;
+}
+
+uint64_t CommandLatency::GetSupersededCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return superseded_;
+}
+
+void CommandLatency::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &latency : latencies_) {
+    latency.Reset();
+  }
+  commands_ = 0;
+  superseded_ = 0;
+}
+};  // namespace flatland_server
@@ -0,0 +1,166 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_queue.cpp
+ * @brief	 Queue of commands applied by the simulation loop
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/command_queue.h>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+
+namespace flatland_server {
+
+CommandQueue &CommandQueue::Get() {
+  static CommandQueue instance;
+  return instance;
+}
+
+CommandQueue::~CommandQueue() { Delete(head_.exchange(nullptr)); }
+
+void CommandQueue::SetEnabled(bool enabled) {
+  Delete(head_.exchange(nullptr));
+  closed_ = false;
+  enabled_ = enabled;
+}
+
+void CommandQueue::Post(Command command) {
+  if (!enabled_) {
+    command();
+    return;
+  }
+  if (closed_) return;
+
+  Node *node = new Node{std::move(command), head_.load()};
+  while (!head_.compare_exchange_weak(node->next, node)) {
+  }
+
+  // Wait checks head_ after counting itself in waiting_, so either it sees
+  // the command or it is counted here. Taking the lock orders the
+  // notification after it started waiting
+  if (waiting_ > 0) {
+    { std::lock_guard<std::mutex> lock(wait_mutex_); }
+    posted_.notify_all();
+  }
+}
+
+bool CommandQueue::Call(Command command) {
+  if (!enabled_) {
+    command();
+    return true;
+  }
+
+  // the command references the state of the caller, so it must not run once
+  // the caller returned. Close sets closed_ after its last Apply, so the
+  // command was either applied or never will be when closed_ is seen
+  auto done = std::make_shared<std::promise<void>>();
+  std::future<void> future = done->get_future();
+  Post([&command, done]() {
+    try {
+      command();
+      done->set_value();
+    } catch (...) {
+      done->set_exception(std::current_exception());
+    }
+  });
+
+  auto ready = std::future_status::ready;
+  while (future.wait_for(std::chrono::milliseconds(10)) != ready) {
+    if (closed_ && future.wait_for(std::chrono::seconds(0)) != ready) {
+      return false;
+    }
+  }
+  future.get();
+  return true;
+}
+
+unsigned int CommandQueue::Apply() {
+  // the stack is last posted first, reverse it to apply in order
+  Node *node = head_.exchange(nullptr);
+  Node *ordered = nullptr;
+  while (node != nullptr) {
+    Node *next = node->next;
+    node->next = ordered;
+    ordered = node;
+    node = next;
+  }
+
+  unsigned int count = 0;
+  while (ordered != nullptr) {
+    std::unique_ptr<Node> current(ordered);
+    ordered = ordered->next;
+    try {
+      current->command();
+    } catch (...) {
+      Delete(ordered);
+      throw;
+    }
+    count++;
+  }
+  return count;
+}
+
+bool CommandQueue::Wait(double timeout) {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiting_++;
+  bool posted = posted_.wait_for(
+      lock, std::chrono::duration<double>(timeout),
+      [this]() { return head_.load() != nullptr || closed_; });
+  waiting_--;
+  return posted && head_.load() != nullptr;
+}
+
+void CommandQueue::Close() {
+  Apply();
+  closed_ = true;
+}
+
+void CommandQueue::Delete(Node *head) {
+  while (head != nullptr) {
+    Node *next = head->next;
+    delete head;
+    head = next;
+  }
+}
+};  // namespace flatland_server
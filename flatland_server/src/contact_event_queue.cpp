@@ -0,0 +1,100 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 contact_event_queue.cpp
+ * @brief	 Ring buffer of the contact events of a physics step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/contact_event_queue.h>
+
+namespace flatland_server {
+
+ContactEvent ContactEvent::Record(Type type, b2Contact *contact,
+                                  const b2ContactImpulse *impulse) {
+  ContactEvent event;
+  event.type = type;
+  event.fixture_a = contact->GetFixtureA();
+  event.fixture_b = contact->GetFixtureB();
+  event.normal.SetZero();
+  event.point.SetZero();
+  event.normal_impulse = 0;
+  event.tangent_impulse = 0;
+
+  int32 count = contact->GetManifold()->pointCount;
+  if (count > 0) {
+    b2WorldManifold manifold;
+    contact->GetWorldManifold(&manifold);
+    event.normal = manifold.normal;
+    for (int32 i = 0; i < count; i++) {
+      event.point += manifold.points[i];
+    }
+    event.point *= 1.0f / count;
+  }
+  if (impulse) {
+    for (int32 i = 0; i < impulse->count; i++) {
+      event.normal_impulse += impulse->normalImpulses[i];
+      event.tangent_impulse += impulse->tangentImpulses[i];
+    }
+  }
+  return event;
+}
+
+void ContactEventQueue::SetCapacity(size_t capacity) {
+  events_.assign(capacity, ContactEvent());
+  events_.shrink_to_fit();
+  Clear();
+}
+
+void ContactEventQueue::Push(const ContactEvent &event) {
+  if (events_.empty()) return;
+  if (size_ < events_.size()) {
+    events_[(head_ + size_) % events_.size()] = event;
+    size_++;
+    return;
+  }
+  // full, the newest event takes the place of the oldest
+  events_[head_] = event;
+  head_ = (head_ + 1) % events_.size();
+  dropped_++;
+}
+
+};  // namespace flatland_server
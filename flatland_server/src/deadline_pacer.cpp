@@ -0,0 +1,153 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 deadline_pacer.cpp
+ * @brief	 Paces the simulation loop to absolute deadlines
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/deadline_pacer.h>
+#include <flatland_server/exceptions.h>
+#include <time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+namespace flatland_server {
+
+DeadlinePacer::Overrun DeadlinePacer::ParseOverrun(const std::string &name) {
+  if (name == "skip") return SKIP;
+  if (name == "burst") return BURST;
+  if (name == "slip") return SLIP;
+  throw Exception("Unknown overrun policy \"" + name +
+                  "\", must be one of skip, burst, slip");
+}
+
+std::string DeadlinePacer::OverrunName(Overrun overrun) {
+  switch (overrun) {
+    case SKIP:
+      return "skip";
+    case BURST:
+      return "burst";
+    case SLIP:
+      return "slip";
+  }
+  return "";
+}
+
+double DeadlinePacer::Now() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+DeadlinePacer::DeadlinePacer(double period, Overrun overrun, double spin_tail,
+                             unsigned int max_burst)
+    : period_(period),
+      overrun_(overrun),
+      spin_tail_(std::max(spin_tail, 0.0)),
+      max_burst_(std::max(max_burst, 1u)),
+      deadline_(0),
+      wake_(0),
+      cycle_time_(0),
+      overruns_(0) {}
+
+void DeadlinePacer::Reset(double now) {
+  deadline_ = now + period_;
+  wake_ = now;
+}
+
+double DeadlinePacer::NextDeadline(double now) {
+  if (now <= deadline_) {
+    double deadline = deadline_;
+    deadline_ += period_;
+    return deadline;
+  }
+  overruns_++;
+
+  // the deadlines of the schedule missed before the one now due
+  double missed = std::floor((now - deadline_) / period_);
+  switch (overrun_) {
+    case SKIP:
+      deadline_ += (missed + 1) * period_;
+      break;
+    case BURST:
+      if (missed >= max_burst_) {
+        deadline_ += (missed - max_burst_ + 1) * period_;
+      }
+      break;
+    case SLIP:
+      deadline_ = now;
+      break;
+  }
+  double deadline = deadline_;
+  deadline_ += period_;
+  return deadline;
+}
+
+void DeadlinePacer::Wait() {
+  double now = Now();
+  cycle_time_ = now - wake_;
+  double deadline = NextDeadline(now);
+  if (deadline <= now) {
+    wake_ = now;
+    return;
+  }
+
+  // clock_nanosleep to an absolute time does not drift when it is
+  // interrupted, it is called again with the same deadline
+  double sleep_until = deadline - spin_tail_;
+  if (sleep_until > now) {
+    timespec ts;
+    ts.tv_sec = (time_t)std::floor(sleep_until);
+    ts.tv_nsec = (long)((sleep_until - ts.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+           EINTR) {
+    }
+  }
+  do {
+    now = Now();
+  } while (now < deadline);
+
+  wake_ = now;
+  jitter_.Add(now - deadline);
+}
+};  // namespace flatland_server
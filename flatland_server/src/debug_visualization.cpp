@@ -46,33 +46,150 @@
 
 #include "flatland_server/debug_visualization.h"
 #include <Box2D/Box2D.h>
+#include <flatland_server/counted_publish.h>
+#include <flatland_server/geometry.h>
+#include <flatland_server/types.h>
 #include <ros/master.h>
 #include <ros/ros.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <map>
+#include <set>
 #include <string>
 
 namespace flatland_server {
 
+LayerVisualization::LayerVisualization(const YAML::Node& properties) {
+  YamlReader reader(properties);
+  YamlReader debug_reader =
+      reader.SubnodeOpt("debug", YamlReader::NodeTypeCheck::MAP);
+  min_z = debug_reader.Get<float>("min_z", 0.0);
+  max_z = debug_reader.Get<float>("max_z", 1.0);
+  merge_segments = debug_reader.Get<bool>("merge_segments", false);
+  simplify_tolerance = debug_reader.Get<double>("simplify_tolerance", 0.0);
+  region_size = debug_reader.Get<double>("region_size", 0.0);
+  max_bytes = debug_reader.Get<double>("max_bytes", 0.0);
+}
+
+bool LayerVisualization::ReducesDetail() const {
+  return merge_segments || simplify_tolerance > 0 || region_size > 0 ||
+         max_bytes > 0;
+}
+
+bool DebugVisualization::headless_ = false;
+unsigned int DebugVisualization::models_per_topic_ = 0;
+bool DebugVisualization::async_publishing_ = false;
+bool DebugVisualization::topic_list_deltas_ = false;
+
 DebugVisualization::DebugVisualization() : node_("~debug") {
-  topic_list_publisher_ =
-      node_.advertise<flatland_msgs::DebugTopicList>("topics", 0, true);
+  if (headless_) {
+    return;
+  }
+  if (topic_list_deltas_) {
+    // the deltas are only meaningful after the whole list, sent to each
+    // subscriber when it connects
+    topic_list_publisher_ = node_.advertise<flatland_msgs::DebugTopicList>(
+        "topics", 0,
+        boost::bind(&DebugVisualization::SendTopicList, this, _1));
+  } else {
+    topic_list_publisher_ =
+        node_.advertise<flatland_msgs::DebugTopicList>("topics", 0, true);
+  }
 }
 
+DebugVisualization::~DebugVisualization() { StopPublishing(); }
+
 DebugVisualization& DebugVisualization::Get() {
   static DebugVisualization instance;
   return instance;
 }
 
+void DebugVisualization::SetHeadless(bool headless) { headless_ = headless; }
+
+bool DebugVisualization::IsHeadless() { return headless_; }
+
+void DebugVisualization::SetModelsPerTopic(unsigned int count) {
+  models_per_topic_ = count;
+}
+
+void DebugVisualization::SetAsyncPublishing(bool async) {
+  async_publishing_ = async;
+}
+
+void DebugVisualization::SetTopicListDeltas(bool deltas) {
+  topic_list_deltas_ = deltas;
+}
+
+void DebugVisualization::Send(const std::string& name,
+                              const ros::Publisher& publisher,
+                              visualization_msgs::MarkerArray& markers,
+                              const ros::Time& stamp) {
+  for (auto& marker : markers.markers) {
+    marker.header.stamp = stamp;
+  }
+  if (!async_publishing_) {
+    PublishCounted(publisher, markers);
+    return;
+  }
+
+  // the copy is the simulation thread's only cost, the thread serializes
+  // and publishes it
+  PublishJob job;
+  job.publisher = publisher;
+  job.markers = boost::make_shared<visualization_msgs::MarkerArray>(markers);
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  if (!publisher_thread_.joinable()) {
+    stopping_ = false;
+    publisher_thread_ = std::thread(&DebugVisualization::PublisherThread, this);
+  }
+  pending_[name] = job;
+  pending_cv_.notify_one();
+}
+
+void DebugVisualization::PublisherThread() {
+  std::map<std::string, PublishJob> jobs;
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  while (true) {
+    pending_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      return;  // stopping
+    }
+
+    // double buffered, the simulation thread fills pending_ while the jobs
+    // are published
+    jobs.swap(pending_);
+    lock.unlock();
+    for (const auto& job : jobs) {
+      PublishCountedNow(job.second.publisher, job.second.markers);
+    }
+    jobs.clear();
+    lock.lock();
+  }
+}
+
+void DebugVisualization::StopPublishing() {
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (!publisher_thread_.joinable()) return;
+    stopping_ = true;
+    pending_cv_.notify_one();
+  }
+  publisher_thread_.join();
+}
+
 void DebugVisualization::JointToMarkers(
     visualization_msgs::MarkerArray& markers, b2Joint* joint, float r, float g,
     float b, float a) {
   if (joint->GetType() == e_distanceJoint ||
       joint->GetType() == e_pulleyJoint || joint->GetType() == e_mouseJoint) {
-    ROS_ERROR_NAMED("DebugVis",
-                    "Unimplemented visualization joints. See b2World.cpp for "
-                    "implementation");
+    ROS_ERROR_ONCE_NAMED("DebugVis",
+                         "Unimplemented visualization joints. See b2World.cpp "
+                         "for implementation");
     return;
   }
 
@@ -118,6 +235,61 @@ void DebugVisualization::JointToMarkers(
   markers.markers.push_back(marker);
 }
 
+void DebugVisualization::JointsToMarkers(
+    visualization_msgs::MarkerArray& markers,
+    const std::vector<JointState>& states) {
+  if (states.empty()) return;
+
+  visualization_msgs::Marker lines;
+  lines.header.frame_id = "map";
+  lines.color.r = states[0].color.r;
+  lines.color.g = states[0].color.g;
+  lines.color.b = states[0].color.b;
+  lines.color.a = states[0].color.a;
+  lines.type = lines.LINE_LIST;
+  lines.scale.x = 0.01;
+  visualization_msgs::Marker cubes = lines;
+  cubes.type = cubes.CUBE_LIST;
+  cubes.scale.x = cubes.scale.y = cubes.scale.z = 0.03;
+
+  lines.points.reserve(6 * states.size());
+  lines.colors.reserve(6 * states.size());
+  cubes.points.reserve(4 * states.size());
+  cubes.colors.reserve(4 * states.size());
+  for (const auto& state : states) {
+    std_msgs::ColorRGBA color;
+    color.r = state.color.r;
+    color.g = state.color.g;
+    color.b = state.color.b;
+    color.a = state.color.a;
+
+    geometry_msgs::Point p_a1, p_a2, p_b1, p_b2;
+    p_a1.x = state.anchor_a.x;
+    p_a1.y = state.anchor_a.y;
+    p_a2.x = state.anchor_b.x;
+    p_a2.y = state.anchor_b.y;
+    p_b1.x = state.position_a.x;
+    p_b1.y = state.position_a.y;
+    p_b2.x = state.position_b.x;
+    p_b2.y = state.position_b.y;
+
+    // lines from bodyA to anchorA, bodyB to anchorB, and anchorA to anchorB
+    for (const auto& p : {p_b1, p_a1, p_b2, p_a2, p_a1, p_a2}) {
+      lines.points.push_back(p);
+      lines.colors.push_back(color);
+    }
+    for (const auto& p : {p_a1, p_a2, p_b1, p_b2}) {
+      cubes.points.push_back(p);
+      cubes.colors.push_back(color);
+    }
+  }
+
+  lines.id = markers.markers.size();
+  markers.markers.push_back(lines);
+  cubes.id = markers.markers.size();
+  markers.markers.push_back(cubes);
+}
+
 void DebugVisualization::BodyToMarkers(visualization_msgs::MarkerArray& markers,
                                        b2Body* body, float r, float g, float b,
                                        float a) {
@@ -201,6 +373,21 @@ void DebugVisualization::BodyToMarkers(visualization_msgs::MarkerArray& markers,
 
       } break;
 
+      case b2Shape::e_chain: {  // Convert b2Chain -> LINE_STRIP
+        b2ChainShape* chain = (b2ChainShape*)fixture->GetShape();
+        marker.type = marker.LINE_STRIP;
+        marker.scale.x = 0.03;  // 3cm wide lines
+
+        // loops repeat their first vertex at the end
+        for (int i = 0; i < chain->m_count; i++) {
+          geometry_msgs::Point p;
+          p.x = chain->m_vertices[i].x;
+          p.y = chain->m_vertices[i].y;
+          marker.points.push_back(p);
+        }
+
+      } break;
+
       default:  // Unsupported shape
         ROS_WARN_THROTTLE_NAMED(1.0, "DebugVis", "Unsupported Box2D shape %d",
                                 static_cast<int>(fixture->GetType()));
@@ -217,9 +404,12 @@ void DebugVisualization::BodyToMarkers(visualization_msgs::MarkerArray& markers,
 }
 
 void DebugVisualization::Publish(const Timekeeper& timekeeper) {
+  if (headless_) return;
+
   // Iterate over the topics_ map as pair(name, topic)
 
-  std::vector<std::string> to_delete;
+  std::vector<std::string> &to_delete = deleted_topics_;
+  to_delete.clear();
 
   for (auto& topic : topics_) {
     if (!topic.second.needs_publishing) {
@@ -230,26 +420,61 @@ void DebugVisualization::Publish(const Timekeeper& timekeeper) {
     // using the old data, delete the topic list
     if (topic.second.markers.markers.size() == 0) {
       to_delete.push_back(topic.first);
+    } else if (topic.second.shard >= 0) {
+      // published with the other topics of the shard below
+      shards_[topic.second.shard].needs_publishing = true;
+      topic.second.needs_publishing = false;
     } else {
-      // Iterate the marker array to update all the timestamps
-      for (unsigned int i = 0; i < topic.second.markers.markers.size(); i++) {
-        topic.second.markers.markers[i].header.stamp = timekeeper.GetSimTime();
-      }
-      topic.second.publisher.publish(topic.second.markers);
+      Send(topic.first, topic.second.publisher, topic.second.markers,
+           timekeeper.GetSimTime());
       topic.second.needs_publishing = false;
     }
   }
 
-  if (to_delete.size() > 0) {
-    for (const auto& topic : to_delete) {
+  for (const auto& topic : to_delete) {
+    int shard = topics_[topic].shard;
+    if (shard >= 0) {
+      // a shard is kept even if it becomes empty, it gets the next models
+      auto& shard_topics = shards_[shard].topics;
+      shard_topics.erase(
+          std::find(shard_topics.begin(), shard_topics.end(), topic));
+      shards_[shard].needs_publishing = true;
+    } else {
       ROS_WARN_NAMED("DebugVis", "Deleting topic %s", topic.c_str());
-      topics_.erase(topic);
+      topic_list_dirty_ = true;
     }
+    topics_.erase(topic);
+  }
+  if (topic_list_dirty_) {
     PublishTopicList();
   }
+
+  for (auto& shard : shards_) {
+    if (!shard.needs_publishing) {
+      continue;
+    }
+
+    // rviz keeps the markers missing from a marker array, so the shard
+    // starts by deleting all markers, e.g. those of deleted models
+    visualization_msgs::MarkerArray markers;
+    visualization_msgs::Marker delete_all;
+    delete_all.header.frame_id = "map";
+    delete_all.action = visualization_msgs::Marker::DELETEALL;
+    markers.markers.push_back(delete_all);
+    for (const auto& name : shard.topics) {
+      for (const auto& marker : topics_[name].markers.markers) {
+        markers.markers.push_back(marker);
+        markers.markers.back().ns = name;
+      }
+    }
+    Send(shard.publisher.getTopic(), shard.publisher, markers,
+         timekeeper.GetSimTime());
+    shard.needs_publishing = false;
+  }
 }
 
 void DebugVisualization::VisualizeLayer(std::string name, Body* body) {
+  if (headless_) return;
   AddTopicIfNotExist(name);
 
   b2Fixture* fixture = body->physics_body_->GetFixtureList();
@@ -257,6 +482,11 @@ void DebugVisualization::VisualizeLayer(std::string name, Body* body) {
   visualization_msgs::Marker marker;
   if (fixture == NULL) return;  // Nothing to visualize, empty linked list
 
+  // the height of the walls is the same for all fixtures
+  LayerVisualization lod(body->properties_);
+  float min_z = lod.min_z;
+  float max_z = lod.max_z;
+
   while (fixture != NULL) {  // traverse fixture linked list
 
     marker.header.frame_id = "map";
@@ -276,42 +506,46 @@ void DebugVisualization::VisualizeLayer(std::string name, Body* body) {
     marker.pose.orientation = tf2::toMsg(q);
     marker.type = marker.TRIANGLE_LIST;
 
-    YamlReader reader(body->properties_);
-    YamlReader debug_reader =
-        reader.SubnodeOpt("debug", YamlReader::NodeTypeCheck::MAP);
-    float min_z = debug_reader.Get<float>("min_z", 0.0);
-    float max_z = debug_reader.Get<float>("max_z", 1.0);
-
-    // Get the shape from the fixture
-    if (fixture->GetType() == b2Shape::e_edge) {
+    // adds the two triangles of the wall standing on an edge
+    auto add_wall = [&](const b2EdgeShape& edge) {
       geometry_msgs::Point p;  // b2Edge uses vertex1 and 2 for its edges
-      b2EdgeShape* edge = (b2EdgeShape*)fixture->GetShape();
-
-      p.x = edge->m_vertex1.x;
-      p.y = edge->m_vertex1.y;
+      p.x = edge.m_vertex1.x;
+      p.y = edge.m_vertex1.y;
       p.z = min_z;
       marker.points.push_back(p);
-      p.x = edge->m_vertex2.x;
-      p.y = edge->m_vertex2.y;
+      p.x = edge.m_vertex2.x;
+      p.y = edge.m_vertex2.y;
       p.z = min_z;
       marker.points.push_back(p);
-      p.x = edge->m_vertex2.x;
-      p.y = edge->m_vertex2.y;
+      p.x = edge.m_vertex2.x;
+      p.y = edge.m_vertex2.y;
       p.z = max_z;
       marker.points.push_back(p);
 
-      p.x = edge->m_vertex1.x;
-      p.y = edge->m_vertex1.y;
+      p.x = edge.m_vertex1.x;
+      p.y = edge.m_vertex1.y;
       p.z = min_z;
       marker.points.push_back(p);
-      p.x = edge->m_vertex2.x;
-      p.y = edge->m_vertex2.y;
+      p.x = edge.m_vertex2.x;
+      p.y = edge.m_vertex2.y;
       p.z = max_z;
       marker.points.push_back(p);
-      p.x = edge->m_vertex1.x;
-      p.y = edge->m_vertex1.y;
+      p.x = edge.m_vertex1.x;
+      p.y = edge.m_vertex1.y;
       p.z = max_z;
       marker.points.push_back(p);
+    };
+
+    // Get the shape from the fixture
+    if (fixture->GetType() == b2Shape::e_edge) {
+      add_wall(*(b2EdgeShape*)fixture->GetShape());
+    } else if (fixture->GetType() == b2Shape::e_chain) {
+      b2ChainShape* chain = (b2ChainShape*)fixture->GetShape();
+      for (int i = 0; i < chain->GetChildCount(); i++) {
+        b2EdgeShape edge;
+        chain->GetChildEdge(&edge, i);
+        add_wall(edge);
+      }
     }
 
     fixture = fixture->GetNext();  // Traverse the linked list of fixtures
@@ -323,41 +557,313 @@ void DebugVisualization::VisualizeLayer(std::string name, Body* body) {
 
 void DebugVisualization::Visualize(std::string name, b2Body* body, float r,
                                    float g, float b, float a) {
+  if (headless_) return;
   AddTopicIfNotExist(name);
   BodyToMarkers(topics_[name].markers, body, r, g, b, a);
   topics_[name].needs_publishing = true;
 }
 
+std::vector<std::pair<b2Vec2, b2Vec2>> DebugVisualization::LayerEdges(
+    b2Body* body, const LayerVisualization& lod) {
+  std::vector<LineSegment> segments;
+  for (b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext()) {
+    if (f->GetType() == b2Shape::e_edge) {
+      b2EdgeShape* edge = (b2EdgeShape*)f->GetShape();
+      segments.push_back(
+          LineSegment(Vec2(edge->m_vertex1.x, edge->m_vertex1.y),
+                      Vec2(edge->m_vertex2.x, edge->m_vertex2.y)));
+    } else if (f->GetType() == b2Shape::e_chain) {
+      b2ChainShape* chain = (b2ChainShape*)f->GetShape();
+      for (int i = 0; i < chain->GetChildCount(); i++) {
+        b2EdgeShape edge;
+        chain->GetChildEdge(&edge, i);
+        segments.push_back(
+            LineSegment(Vec2(edge.m_vertex1.x, edge.m_vertex1.y),
+                        Vec2(edge.m_vertex2.x, edge.m_vertex2.y)));
+      }
+    }
+  }
+
+  std::vector<std::pair<b2Vec2, b2Vec2>> edges;
+  bool simplify =
+      lod.merge_segments || lod.simplify_tolerance > 0 || lod.max_bytes > 0;
+  if (!simplify) {
+    for (const auto& s : segments) {
+      edges.push_back(std::make_pair(s.start.Box2D(), s.end.Box2D()));
+    }
+    return edges;
+  }
+
+  std::vector<std::vector<b2Vec2>> closed, open;
+  Geometry::LinkSegments(segments, &closed, &open);
+
+  // the 2.5d walls take six points of 24 bytes per edge
+  const size_t edge_bytes = 6 * sizeof(geometry_msgs::Point);
+  double tolerance = lod.simplify_tolerance;
+  for (int attempt = 0;; attempt++) {
+    edges.clear();
+    auto add = [&](const std::vector<std::vector<b2Vec2>>& polylines,
+                   bool loop) {
+      for (const auto& polyline : polylines) {
+        std::vector<b2Vec2> simple =
+            Geometry::SimplifyPolyline(polyline, tolerance, loop);
+        for (unsigned int i = 0; i + 1 < simple.size(); i++) {
+          edges.push_back(std::make_pair(simple[i], simple[i + 1]));
+        }
+        if (loop && simple.size() > 2) {
+          edges.push_back(std::make_pair(simple.back(), simple.front()));
+        }
+      }
+    };
+    add(closed, true);
+    add(open, false);
+
+    if (lod.max_bytes == 0 || edges.size() * edge_bytes <= lod.max_bytes) {
+      break;
+    }
+    if (attempt == 20) {
+      ROS_WARN_NAMED("DebugVis",
+                     "Layer markers of %lu bytes exceed max_bytes %lu with a "
+                     "tolerance of %f",
+                     edges.size() * edge_bytes, lod.max_bytes, tolerance);
+      break;
+    }
+    tolerance = tolerance > 0 ? 2 * tolerance : 0.01;
+  }
+  return edges;
+}
+
+void DebugVisualization::VisualizeLayer(const std::string& name, Body* body,
+                                        const LayerVisualization& lod) {
+  if (headless_) return;
+  std::vector<std::pair<b2Vec2, b2Vec2>> edges =
+      LayerEdges(body->physics_body_, lod);
+  if (edges.empty()) return;
+
+  visualization_msgs::Marker base;
+  base.header.frame_id = "map";
+  base.color.r = body->color_.r;
+  base.color.g = body->color_.g;
+  base.color.b = body->color_.b;
+  base.color.a = body->color_.a;
+  base.pose.position.x = body->physics_body_->GetPosition().x;
+  base.pose.position.y = body->physics_body_->GetPosition().y;
+  tf2::Quaternion q;  // use tf2 to convert 2d yaw -> 3d quaternion
+  q.setRPY(0, 0, body->physics_body_->GetAngle());
+  base.pose.orientation = tf2::toMsg(q);
+
+  // one marker per region, by the region of the middle of the edges
+  std::map<std::pair<int64_t, int64_t>,
+           std::pair<visualization_msgs::Marker, visualization_msgs::Marker>>
+      tiles;
+  for (const auto& edge : edges) {
+    std::pair<int64_t, int64_t> key(0, 0);
+    if (lod.region_size > 0) {
+      b2Vec2 mid = 0.5f * (edge.first + edge.second);
+      key.first = std::floor(mid.x / lod.region_size);
+      key.second = std::floor(mid.y / lod.region_size);
+    }
+    if (tiles.count(key) == 0) {
+      visualization_msgs::Marker lines = base;
+      lines.type = lines.LINE_LIST;
+      lines.scale.x = 0.03;  // 3cm wide lines
+      visualization_msgs::Marker walls = base;
+      walls.type = walls.TRIANGLE_LIST;
+      walls.scale.x = walls.scale.y = walls.scale.z = 1.0;
+      walls.frame_locked = true;
+      tiles[key] = std::make_pair(lines, walls);
+    }
+    auto& tile = tiles[key];
+
+    geometry_msgs::Point a, b;
+    a.x = edge.first.x;
+    a.y = edge.first.y;
+    b.x = edge.second.x;
+    b.y = edge.second.y;
+    tile.first.points.push_back(a);
+    tile.first.points.push_back(b);
+
+    // the two triangles of the wall standing on the edge
+    geometry_msgs::Point a_top = a, b_top = b;
+    a.z = b.z = lod.min_z;
+    a_top.z = b_top.z = lod.max_z;
+    for (const auto& p : {a, b, b_top, a, b_top, a_top}) {
+      tile.second.points.push_back(p);
+    }
+  }
+
+  AddTopicIfNotExist(name);
+  AddTopicIfNotExist(name + "_3d");
+  auto& lines = topics_[name].markers.markers;
+  auto& walls = topics_[name + "_3d"].markers.markers;
+  for (auto& tile : tiles) {
+    tile.second.first.id = lines.size();
+    lines.push_back(tile.second.first);
+    tile.second.second.id = walls.size();
+    walls.push_back(tile.second.second);
+  }
+  topics_[name].needs_publishing = true;
+  topics_[name + "_3d"].needs_publishing = true;
+}
+
+size_t DebugVisualization::VisualizeMovable(const std::string& name,
+                                            b2Body* body, float r, float g,
+                                            float b, float a) {
+  if (headless_) return 0;
+  AddTopicIfNotExist(name);
+  visualization_msgs::MarkerArray body_markers;
+  BodyToMarkers(body_markers, body, r, g, b, a);
+
+  auto& markers = topics_[name].markers.markers;
+  for (auto& marker : body_markers.markers) {
+    marker.id = markers.size();
+    markers.push_back(marker);
+  }
+  topics_[name].needs_publishing = true;
+  return body_markers.markers.size();
+}
+
+void DebugVisualization::MoveBody(const std::string& name, size_t first,
+                                  size_t count, b2Body* body) {
+  if (headless_ || topics_.count(name) == 0) return;
+  auto& markers = topics_[name].markers.markers;
+  tf2::Quaternion q;  // use tf2 to convert 2d yaw -> 3d quaternion
+  q.setRPY(0, 0, body->GetAngle());
+  for (size_t i = first; i < first + count && i < markers.size(); i++) {
+    markers[i].pose.position.x = body->GetPosition().x;
+    markers[i].pose.position.y = body->GetPosition().y;
+    markers[i].pose.orientation = tf2::toMsg(q);
+  }
+  topics_[name].needs_publishing = true;
+}
+
 void DebugVisualization::Visualize(std::string name, b2Joint* joint, float r,
                                    float g, float b, float a) {
+  if (headless_) return;
   AddTopicIfNotExist(name);
   JointToMarkers(topics_[name].markers, joint, r, g, b, a);
   topics_[name].needs_publishing = true;
 }
 
+void DebugVisualization::VisualizeJoints(
+    const std::string& name, const std::vector<JointState>& states) {
+  if (headless_) return;
+  AddTopicIfNotExist(name);
+  JointsToMarkers(topics_[name].markers, states);
+  topics_[name].needs_publishing = true;
+}
+
 void DebugVisualization::Reset(std::string name) {
+  if (headless_) return;
   if (topics_.count(name) > 0) {  // If the topic exists, clear it
     topics_[name].markers.markers.clear();
     topics_[name].needs_publishing = true;
   }
 }
 
+void DebugVisualization::Truncate(const std::string& name, size_t count) {
+  if (headless_ || topics_.count(name) == 0) return;
+  auto& markers = topics_[name].markers.markers;
+  if (markers.size() > count) {
+    markers.resize(count);
+    topics_[name].needs_publishing = true;
+  }
+}
+
+size_t DebugVisualization::MarkerCount(const std::string& name) const {
+  auto it = topics_.find(name);
+  return it != topics_.end() ? it->second.markers.markers.size() : 0;
+}
+
+bool DebugVisualization::HasSubscribers(const std::string& name) {
+  if (headless_) return false;
+  if (topics_.count(name) == 0) {
+    // nothing to publish yet, an empty topic to publish would be deleted
+    AddTopicIfNotExist(name);
+    topics_[name].needs_publishing = false;
+  }
+  const DebugTopic& topic = topics_[name];
+  const ros::Publisher& publisher =
+      topic.shard >= 0 ? shards_[topic.shard].publisher : topic.publisher;
+  return publisher.getNumSubscribers() > 0;
+}
+
 void DebugVisualization::AddTopicIfNotExist(const std::string& name) {
   // If the topic doesn't exist yet, create it
   if (topics_.count(name) == 0) {
-    topics_[name] = {
-        node_.advertise<visualization_msgs::MarkerArray>(name, 0, true), true,
-        visualization_msgs::MarkerArray()};
+    DebugTopic& topic = topics_[name];
+    topic.needs_publishing = true;
+    topic.shard = -1;
+
+    if (models_per_topic_ > 0 && name.compare(0, 6, "model/") == 0) {
+      // the first shard with room, so the shards stay filled when models
+      // are deleted and spawned
+      unsigned int shard = 0;
+      while (shard < shards_.size() &&
+             shards_[shard].topics.size() >= models_per_topic_) {
+        shard++;
+      }
+      if (shard == shards_.size()) {
+        std::string shard_name = "models/" + std::to_string(shard);
+        shards_.push_back(
+            {node_.advertise<visualization_msgs::MarkerArray>(shard_name, 0,
+                                                              true),
+             false,
+             {}});
+        ROS_INFO_ONCE_NAMED("DebugVis", "Visualizing %s", shard_name.c_str());
+        topic_list_dirty_ = true;
+      }
+      shards_[shard].topics.push_back(name);
+      topic.shard = shard;
+      return;
+    }
 
+    topic.publisher =
+        node_.advertise<visualization_msgs::MarkerArray>(name, 0, true);
     ROS_INFO_ONCE_NAMED("DebugVis", "Visualizing %s", name.c_str());
-    PublishTopicList();
+    topic_list_dirty_ = true;
   }
 }
 
 void DebugVisualization::PublishTopicList() {
+  topic_list_dirty_ = false;
+  std::set<std::string> topics;
+  for (auto const& topic_pair : topics_) {
+    if (topic_pair.second.shard < 0) {
+      topics.insert(topic_pair.first);
+    }
+  }
+  for (unsigned int i = 0; i < shards_.size(); i++) {
+    topics.insert("models/" + std::to_string(i));
+  }
+
+  // e.g. a model deleted and spawned again in the same cycle
+  std::lock_guard<std::mutex> lock(topic_list_mutex_);
+  if (topics == listed_topics_) {
+    return;
+  }
+
+  flatland_msgs::DebugTopicList topic_list;
+  if (topic_list_deltas_) {
+    topic_list.delta = true;
+    std::set_difference(topics.begin(), topics.end(), listed_topics_.begin(),
+                        listed_topics_.end(),
+                        std::back_inserter(topic_list.added));
+    std::set_difference(listed_topics_.begin(), listed_topics_.end(),
+                        topics.begin(), topics.end(),
+                        std::back_inserter(topic_list.removed));
+  } else {
+    topic_list.topics.assign(topics.begin(), topics.end());
+  }
+  listed_topics_.swap(topics);
+  PublishCounted(topic_list_publisher_, topic_list);
+}
+
+void DebugVisualization::SendTopicList(
+    const ros::SingleSubscriberPublisher& publisher) {
   flatland_msgs::DebugTopicList topic_list;
-  for (auto const& topic_pair : topics_)
-    topic_list.topics.push_back(topic_pair.first);
-  topic_list_publisher_.publish(topic_list);
+  std::lock_guard<std::mutex> lock(topic_list_mutex_);
+  topic_list.topics.assign(listed_topics_.begin(), listed_topics_.end());
+  publisher.publish(topic_list);
 }
 };  // namespace flatland_server
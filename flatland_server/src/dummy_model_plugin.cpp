@@ -47,6 +47,7 @@
 #include <flatland_server/dummy_model_plugin.h>
 #include <flatland_server/exceptions.h>
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
 #include <pluginlib/class_list_macros.h>
 
 using namespace flatland_server;
@@ -79,4 +80,6 @@ void DummyModelPlugin::OnInitialize(const YAML::Node &config) {
 };
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::DummyModelPlugin,
-                       flatland_server::ModelPlugin)
\ No newline at end of file
+                       flatland_server::ModelPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::DummyModelPlugin,
+                         flatland_server::ModelPlugin)
@@ -46,6 +46,7 @@
 
 #include <flatland_server/dummy_world_plugin.h>
 #include <flatland_server/exceptions.h>
+#include <flatland_server/plugin_registry.h>
 #include <flatland_server/world_plugin.h>
 #include <flatland_server/yaml_reader.h>
 #include <pluginlib/class_list_macros.h>
@@ -74,4 +75,6 @@ void DummyWorldPlugin::OnInitialize(const YAML::Node &config) {
 };
 
 PLUGINLIB_EXPORT_CLASS(flatland_plugins::DummyWorldPlugin,
-                       flatland_server::WorldPlugin)
\ No newline at end of file
+                       flatland_server::WorldPlugin)
+FLATLAND_REGISTER_PLUGIN(flatland_plugins::DummyWorldPlugin,
+                         flatland_server::WorldPlugin)
@@ -0,0 +1,182 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 extrapolator.cpp
+ * @brief	 Extrapolates the plugin outputs between physics steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/extrapolator.h>
+#include <flatland_server/tracer.h>
+#include <algorithm>
+#include <chrono>
+
+namespace flatland_server {
+
+Extrapolator::Motion Extrapolator::Motion::Of(const b2Transform &transform,
+                                              const b2Vec2 &center_velocity,
+                                              float angular,
+                                              const b2Vec2 &local_center) {
+  // the origin turns about the center of mass
+  Motion motion;
+  motion.transform = transform;
+  motion.linear =
+      center_velocity - b2Cross(angular, b2Mul(transform.q, local_center));
+  motion.angular = angular;
+  return motion;
+}
+
+b2Transform Extrapolator::Motion::At(double dt) const {
+  b2Transform extrapolated;
+  extrapolated.p = transform.p + float(dt) * linear;
+  extrapolated.q.Set(transform.q.GetAngle() + float(dt) * angular);
+  return extrapolated;
+}
+
+void Extrapolator::Clock::Step(double sim_time, double wall_time) {
+  double period = sim_time - time_;
+  double wall_period = wall_time - wall_;
+  if (period <= 0 || wall_ == 0) {
+    period_ = 0;
+    factor_ = 0;
+  } else {
+    period_ = period;
+    if (wall_period > 0) {
+      double factor = period / wall_period;
+      factor_ = factor_ > 0 ? 0.75 * factor_ + 0.25 * factor : factor;
+    }
+  }
+  time_ = sim_time;
+  wall_ = wall_time;
+}
+
+double Extrapolator::Clock::Estimate(double wall_time) const {
+  if (factor_ <= 0) {
+    return time_;
+  }
+  return time_ + std::min(std::max(wall_time - wall_, 0.0) * factor_, period_);
+}
+
+Extrapolator &Extrapolator::Get() {
+  static Extrapolator instance;
+  return instance;
+}
+
+double Extrapolator::Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+Extrapolator::~Extrapolator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+unsigned int Extrapolator::Add(double rate, Task task) {
+  unsigned int id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_id_++;
+    tasks_[id] = Entry{1.0 / rate, Now(), std::move(task)};
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&Extrapolator::Loop, this);
+    }
+  }
+  cv_.notify_all();
+  return id;
+}
+
+void Extrapolator::Remove(unsigned int id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  tasks_.erase(id);
+  cv_.notify_all();
+  cv_.wait(lock, [this, id] { return running_ != id; });
+}
+
+size_t Extrapolator::GetTaskCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tasks_.size();
+}
+
+void Extrapolator::Loop() {
+  Tracer::Get().SetThreadName("extrapolator");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (tasks_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+    auto due = std::min_element(
+        tasks_.begin(), tasks_.end(),
+        [](const std::pair<const unsigned int, Entry> &a,
+           const std::pair<const unsigned int, Entry> &b) {
+          return a.second.next < b.second.next;
+        });
+    double now = Now();
+    if (due->second.next > now) {
+      // woken early when the tasks change
+      cv_.wait_for(lock,
+                   std::chrono::duration<double>(due->second.next - now));
+      continue;
+    }
+
+    // a task late by more than its period skips the missed runs instead of
+    // running in a burst
+    Entry &entry = due->second;
+    entry.next = std::max(entry.next + entry.period, now);
+    running_ = due->first;
+    Task task = entry.task;
+    lock.unlock();
+    task(now);
+    lock.lock();
+    running_ = 0;
+    cv_.notify_all();
+  }
+}
+
+};  // namespace flatland_server
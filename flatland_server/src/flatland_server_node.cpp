@@ -46,9 +46,24 @@
 
 #include <ros/ros.h>
 #include <signal.h>
+#include <algorithm>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "flatland_server/deadline_pacer.h"
+#include "flatland_server/debug_visualization.h"
+#include "flatland_server/exceptions.h"
+#include "flatland_server/publish_queue.h"
+#include "flatland_server/recorder.h"
+#include "flatland_server/sensor_executor.h"
 #include "flatland_server/simulation_manager.h"
+#include "flatland_server/step_budget_governor.h"
+#include "flatland_server/thread_config.h"
+#include "flatland_server/odometry_aggregator.h"
+#include "flatland_server/tf_aggregator.h"
+#include "flatland_server/topic_stats.h"
+#include "flatland_server/tracer.h"
 
 /** Global variables */
 flatland_server::SimulationManager *simulation_manager;
@@ -89,18 +104,245 @@ int main(int argc, char **argv) {
   float update_rate = 200.0;  // The physics update rate (Hz)
   node_handle.getParam("update_rate", update_rate);
 
+  // pace update_rate to absolute deadlines instead of with ros::WallRate
+  std::string pacing = "rate";
+  node_handle.getParam("pacing", pacing);
+  double spin_tail = 0;  // seconds spun on the clock before each deadline
+  node_handle.getParam("spin_tail", spin_tail);
+  std::string overrun_name = "skip";
+  node_handle.getParam("overrun_policy", overrun_name);
+  flatland_server::DeadlinePacer::Overrun overrun_policy;
+  try {
+    if (pacing != "rate" && pacing != "deadline") {
+      throw flatland_server::Exception("Unknown pacing \"" + pacing +
+                                       "\", must be one of rate, deadline");
+    }
+    overrun_policy = flatland_server::DeadlinePacer::ParseOverrun(overrun_name);
+  } catch (const std::exception &e) {
+    ROS_FATAL_NAMED("Node", "%s", e.what());
+    ros::shutdown();
+    return 1;
+  }
+
+  // paces the loop by the achieved simulation time instead of update_rate
+  double real_time_factor = 0;
+  node_handle.getParam("real_time_factor", real_time_factor);
+  int max_steps_per_cycle = 1;  // steps to catch up with real_time_factor
+  node_handle.getParam("max_steps_per_cycle", max_steps_per_cycle);
+
   float step_size = 1 / 200.0;
   node_handle.getParam("step_size", step_size);
 
   bool show_viz = false;
   node_handle.getParam("show_viz", show_viz);
 
+  // no visualization topics or interactive markers at all, for batch runs
+  bool headless = false;
+  node_handle.getParam("headless", headless);
+
+  // steps per message on step_timing, 0 to not time the steps
+  int timing_steps = 1000;
+  node_handle.getParam("timing_steps", timing_steps);
+
+  // number of most costly plugins on step_timing, 0 to not profile plugins
+  int profile_plugins = 0;
+  node_handle.getParam("profile_plugins", profile_plugins);
+
+  // count the hardware events of the stages on step_timing
+  bool perf_counters = false;
+  node_handle.getParam("perf_counters", perf_counters);
+
+  // publish the health of the simulation loop on /diagnostics
+  bool diagnostics = false;
+  node_handle.getParam("diagnostics", diagnostics);
+
+  // keep the details of the last iterations, and write the ones around a
+  // step taking longer than this wall time to a file, 0 to disable
+  double flight_recorder_threshold = 0;
+  node_handle.getParam("flight_recorder_threshold", flight_recorder_threshold);
+  int flight_recorder_steps = 200;
+  node_handle.getParam("flight_recorder_steps", flight_recorder_steps);
+  std::string flight_recorder_dir;
+  node_handle.getParam("flight_recorder_dir", flight_recorder_dir);
+
+  // serve the ROS callbacks on this many threads instead of in the loop
+  int callback_threads = 0;
+  node_handle.getParam("callback_threads", callback_threads);
+
   float viz_pub_rate = 30.0;
   node_handle.getParam("viz_pub_rate", viz_pub_rate);
 
+  // pack the model visualizations into topics of this many models, 0 for a
+  // topic per model
+  int models_per_viz_topic = 0;
+  node_handle.getParam("models_per_viz_topic", models_per_viz_topic);
+  flatland_server::DebugVisualization::SetModelsPerTopic(
+      std::max(models_per_viz_topic, 0));
+
+  // serialize and publish the visualization on a thread of its own
+  bool viz_publish_thread = false;
+  node_handle.getParam("viz_publish_thread", viz_publish_thread);
+  flatland_server::DebugVisualization::SetAsyncPublishing(viz_publish_thread);
+
+  // hand the messages of the plugins to this many publisher threads, which
+  // serialize them off the simulation thread, 0 to publish them in the step
+  int publish_threads = 0;
+  node_handle.getParam("publish_threads", publish_threads);
+  int publish_queue_depth = 2;  // messages waiting per topic at most
+  node_handle.getParam("publish_queue_depth", publish_queue_depth);
+  if (publish_threads > 0) {
+    flatland_server::PublishQueue::Get().Start(
+        publish_threads, std::max(publish_queue_depth, 1));
+  }
+
+  // publish the changes of the visualization topic list instead of the
+  // whole list, for large fleets
+  bool viz_topic_deltas = false;
+  node_handle.getParam("viz_topic_deltas", viz_topic_deltas);
+  flatland_server::DebugVisualization::SetTopicListDeltas(viz_topic_deltas);
+
+  // collect the transforms of the plugins into one message per flush
+  bool aggregate_tf = false;
+  node_handle.getParam("aggregate_tf", aggregate_tf);
+  flatland_server::TfAggregator::SetEnabled(aggregate_tf);
+  double tf_publish_rate = 0;  // flushes per simulated second, 0 every cycle
+  node_handle.getParam("tf_publish_rate", tf_publish_rate);
+  flatland_server::TfAggregator::SetRate(tf_publish_rate);
+
+  // collect the odometry of the drive plugins into one message per cycle
+  bool aggregate_odom = false;
+  node_handle.getParam("aggregate_odom", aggregate_odom);
+  flatland_server::OdometryAggregator::SetEnabled(aggregate_odom);
+
+  // count the messages and bytes published on each topic
+  bool topic_stats = false;
+  node_handle.getParam("topic_stats", topic_stats);
+  flatland_server::TopicStats::SetEnabled(topic_stats);
+
+  bool lockstep = false;  // step only through the step_world service
+  node_handle.getParam("lockstep", lockstep);
+
+  int num_worlds = 1;  // independent copies of the world, stepped in parallel
+  node_handle.getParam("num_worlds", num_worlds);
+  if (num_worlds < 1) {
+    ROS_FATAL_NAMED("Node", "num_worlds must be at least 1!");
+    ros::shutdown();
+    return 1;
+  }
+
+  // record a timeline of the simulation loop, see the dump_trace service
+  bool trace = false;
+  node_handle.getParam("trace", trace);
+  int trace_buffer_size = 1 << 16;  // spans kept per thread
+  node_handle.getParam("trace_buffer_size", trace_buffer_size);
+  if (trace) {
+    flatland_server::Tracer::Get().Start(std::max(trace_buffer_size, 1));
+  }
+
+  // record the inputs of the run to a file, or replay such a file
+  std::string record_path, replay_path;
+  node_handle.getParam("record", record_path);
+  node_handle.getParam("replay", replay_path);
+  try {
+    if (!record_path.empty() && !replay_path.empty()) {
+      throw flatland_server::Exception(
+          "record and replay cannot be used together!");
+    }
+    if (!record_path.empty()) {
+      flatland_server::Recorder::Get().StartRecording(record_path);
+      ROS_INFO_NAMED("Node", "Recording to %s", record_path.c_str());
+    } else if (!replay_path.empty()) {
+      flatland_server::Recorder::Get().StartReplay(replay_path);
+      ROS_INFO_NAMED("Node", "Replaying %s", replay_path.c_str());
+    }
+  } catch (const std::exception &e) {
+    ROS_FATAL_NAMED("Node", "%s", e.what());
+    ros::shutdown();
+    return 1;
+  }
+
+  // log the time spent in the phases of loading the worlds, also enabled by
+  // the --profile-startup command line flag
+  bool profile_startup = false;
+  node_handle.getParam("profile_startup", profile_startup);
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--profile-startup") {
+      profile_startup = true;
+    }
+  }
+
+  // throttle /clock, e.g. when stepping at 1 kHz and more in free run
+  double clock_rate = 0;
+  node_handle.getParam("clock_rate", clock_rate);
+
+  // reduce the work of the sensors and the visualization while the steps
+  // overrun this wall time, in the order of the degradations
+  double step_budget = 0;
+  node_handle.getParam("step_budget", step_budget);
+  std::string degradation_names = "visualization,laser_rate,laser_beams";
+  node_handle.getParam("step_budget_degradations", degradation_names);
+  std::vector<flatland_server::StepBudgetGovernor::Degradation> degradations;
+  try {
+    std::stringstream names(degradation_names);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+      name.erase(0, name.find_first_not_of(' '));
+      name.erase(name.find_last_not_of(' ') + 1);
+      if (name.empty()) continue;
+      degradations.push_back(
+          flatland_server::StepBudgetGovernor::ParseDegradation(name));
+    }
+  } catch (const std::exception &e) {
+    ROS_FATAL_NAMED("Node", "%s", e.what());
+    ros::shutdown();
+    return 1;
+  }
+
+  // run the simulation thread, which calls Main, and the sensor workers with
+  // less scheduling noise. This thread is configured before the worlds are
+  // loaded, so their memory is allocated on the NUMA node of its CPUs
+  int realtime_priority = 0;  // SCHED_FIFO priority, 0 for the default policy
+  node_handle.getParam("realtime_priority", realtime_priority);
+  std::string simulation_cpus, sensor_cpus;
+  node_handle.getParam("simulation_cpus", simulation_cpus);
+  node_handle.getParam("sensor_cpus", sensor_cpus);
+  bool lock_memory = false;
+  node_handle.getParam("lock_memory", lock_memory);
+  try {
+    using flatland_server::ThreadConfig;
+    std::vector<unsigned int> process_cpus =
+        ThreadConfig::GetAffinity(pthread_self());
+    std::vector<unsigned int> simulation =
+        ThreadConfig::ParseCpuSet(simulation_cpus);
+    std::vector<unsigned int> sensors = ThreadConfig::ParseCpuSet(sensor_cpus);
+
+    // the sensor workers are started by the simulation thread, they would
+    // inherit its CPUs
+    if (sensors.empty() && !simulation.empty()) sensors = process_cpus;
+    flatland_server::SensorExecutor::Get().SetCpus(sensors);
+    if (!simulation.empty()) {
+      ThreadConfig::SetAffinity(pthread_self(), simulation);
+    }
+    if (realtime_priority > 0) {
+      ThreadConfig::SetFifoPriority(pthread_self(), realtime_priority);
+    }
+    if (lock_memory) ThreadConfig::LockMemory();
+  } catch (const std::exception &e) {
+    ROS_FATAL_NAMED("Node", "%s", e.what());
+    ros::shutdown();
+    return 1;
+  }
+
   // Create simulation manager object
   simulation_manager = new flatland_server::SimulationManager(
-      world_path, update_rate, step_size, show_viz, viz_pub_rate);
+      world_path, update_rate, step_size, show_viz, viz_pub_rate, lockstep,
+      num_worlds, headless, std::max(timing_steps, 0),
+      std::max(profile_plugins, 0), real_time_factor,
+      std::max(max_steps_per_cycle, 1), std::max(callback_threads, 0),
+      profile_startup, clock_rate, step_budget, degradations,
+      pacing == "deadline", spin_tail, overrun_policy, perf_counters,
+      diagnostics, flight_recorder_threshold,
+      std::max(flight_recorder_steps, 1), flight_recorder_dir);
 
   // Register sigint shutdown handler
   signal(SIGINT, SigintHandler);
@@ -111,5 +353,11 @@ int main(int argc, char **argv) {
   ROS_INFO_STREAM_NAMED("Node", "Returned from simulation manager main");
   delete simulation_manager;
   simulation_manager = nullptr;
+
+  try {
+    flatland_server::Recorder::Get().Stop();
+  } catch (const std::exception &e) {
+    ROS_ERROR_NAMED("Node", "%s", e.what());
+  }
   return 0;
 }
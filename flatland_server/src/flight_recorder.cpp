@@ -0,0 +1,163 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 flight_recorder.cpp
+ * @brief	 Keeps the last iterations of the loop to write the ones around a spike
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/flight_recorder.h>
+#include <flatland_server/tracer.h>
+#include <flatland_server/yaml_reader.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace flatland_server {
+
+namespace {
+/**
+ * @brief Format a time in ns as the microseconds of the trace format
+ */
+std::string Microseconds(uint64_t ns) {
+  char us[32];
+  snprintf(us, sizeof(us), "%llu.%03u", (unsigned long long)(ns / 1000),
+           (unsigned int)(ns % 1000));
+  return us;
+}
+}
+
+FlightRecorder::FlightRecorder(double threshold, size_t window,
+                               const std::string &directory, size_t max_dumps)
+    : threshold_(threshold),
+      directory_(directory),
+      max_dumps_(max_dumps),
+      ring_(std::max<size_t>(window, 1)),
+      count_(0),
+      overruns_(0),
+      dumps_(0),
+      pending_(0),
+      overrun_step_(0),
+      next_trigger_(0) {}
+
+bool FlightRecorder::Add(const Step &step) {
+  ring_[count_ % ring_.size()] = step;
+  count_++;
+
+  bool overrun = step.duration * 1e-9 > threshold_ * step.steps;
+  if (overrun) {
+    overruns_++;
+  }
+  if (overrun && pending_ == 0 && count_ > next_trigger_ &&
+      dumps_ < max_dumps_) {
+    // the overrun ends up at three quarters of the window written
+    overrun_step_ = step.step;
+    pending_ = ring_.size() / 4 + 1;
+  }
+  if (pending_ > 0 && --pending_ == 0) {
+    return true;
+  }
+  return false;
+}
+
+size_t FlightRecorder::WriteChromeTrace(std::ostream &out) const {
+  std::vector<std::string> events;
+  events.push_back(
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+      "\"args\":{\"name\":\"flight_recorder\"}}");
+  uint64_t first = count_ > ring_.size() ? count_ - ring_.size() : 0;
+  uint64_t begin = UINT64_MAX, end = 0;
+  for (uint64_t i = first; i < count_; i++) {
+    const Step &step = ring_[i % ring_.size()];
+    begin = std::min(begin, step.start);
+    end = std::max(end, step.start + step.duration);
+
+    bool overrun = step.duration * 1e-9 > threshold_ * step.steps;
+    std::ostringstream event;
+    event << "{\"name\":\"" << (overrun ? "overrun" : "step")
+          << "\",\"cat\":\"flight_recorder\",\"ph\":\"X\",\"ts\":"
+          << Microseconds(step.start)
+          << ",\"dur\":" << Microseconds(step.duration)
+          << ",\"pid\":1,\"tid\":0,\"args\":{\"step\":" << step.step
+          << ",\"steps\":" << step.steps << ",\"contacts\":" << step.contacts
+          << ",\"islands\":" << step.islands
+          << ",\"island_bodies\":" << step.island_bodies
+          << ",\"pairs\":" << step.pairs
+          << ",\"toi_events\":" << step.toi_events
+          << ",\"sensor_tasks\":" << step.sensor_tasks;
+    for (int s = 0; s < StepTimer::STAGE_COUNT; s++) {
+      if (step.stages[s] > 0) {
+        event << ",\"" << StepTimer::GetStageName(StepTimer::Stage(s))
+              << "_ms\":" << step.stages[s] * 1000;
+      }
+    }
+    event << "}}";
+    events.push_back(event.str());
+  }
+  if (count_ == first) {
+    begin = end = 0;
+  }
+  Tracer::Get().WriteChromeTrace(out, begin, end, events);
+  return count_ - first;
+}
+
+std::string FlightRecorder::Dump() {
+  dumps_++;
+  next_trigger_ = count_ + ring_.size();
+
+  std::string name =
+      "flight_recorder_" + std::to_string(overrun_step_) + ".json";
+  std::string path = directory_.empty() ? name : directory_ + "/" + name;
+  std::ofstream out(path);
+  if (!out) {
+    throw Exception("Flatland File: Failed to open " + Q(path));
+  }
+  WriteChromeTrace(out);
+  out.close();
+  if (!out) {
+    throw Exception("Flatland File: Failed to write " + Q(path));
+  }
+  return path;
+}
+};  // namespace flatland_server
@@ -0,0 +1,180 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gaussian_noise.cpp
+ * @brief	 Counter based bulk gaussian noise generator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/gaussian_noise.h>
+#include <flatland_server/state_hash.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_server {
+
+namespace {
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const unsigned int PHILOX_ROUNDS = 10;
+
+// number of counters per block, each counter gives four 32 bit values
+const unsigned int LANES = GaussianNoise::BLOCK_SIZE / 4;
+}
+
+GaussianNoise::GaussianNoise(double std_dev, uint64_t seed)
+    : std_dev_(std_dev) {
+  Seed(seed);
+}
+
+void GaussianNoise::Seed(uint64_t seed) {
+  key_[0] = static_cast<uint32_t>(seed);
+  key_[1] = static_cast<uint32_t>(seed >> 32);
+  counter_ = 0;
+  used_ = BLOCK_SIZE;
+}
+
+void GaussianNoise::GenerateBlock(float *out) {
+  // Philox4x32-10, the state is kept as one array per word so every step is
+  // a loop over all counters of the block
+  uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+  for (unsigned int l = 0; l < LANES; l++) {
+    uint64_t c = counter_ + l;
+    c0[l] = static_cast<uint32_t>(c);
+    c1[l] = static_cast<uint32_t>(c >> 32);
+    c2[l] = 0;
+    c3[l] = 0;
+  }
+  counter_ += LANES;
+
+  uint32_t k0 = key_[0], k1 = key_[1];
+  for (unsigned int r = 0; r < PHILOX_ROUNDS; r++) {
+    for (unsigned int l = 0; l < LANES; l++) {
+      uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * c0[l];
+      uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * c2[l];
+      uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+      uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+      c1[l] = static_cast<uint32_t>(p1);
+      c3[l] = static_cast<uint32_t>(p0);
+      c0[l] = n0;
+      c2[l] = n2;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  // Box-Muller, each pair of uniforms gives two gaussian values. u1 is taken
+  // in (0, 1] so the log is always finite
+  const float scale = 1.0f / 16777216.0f;  // 2^-24
+  const float two_pi = 6.28318530717958647692f;
+  for (unsigned int l = 0; l < LANES; l++) {
+    float u1 = ((c0[l] >> 8) + 1.0f) * scale;
+    float u2 = (c1[l] >> 8) * scale;
+    float u3 = ((c2[l] >> 8) + 1.0f) * scale;
+    float u4 = (c3[l] >> 8) * scale;
+    float r1 = std::sqrt(-2.0f * std::log(u1));
+    float r2 = std::sqrt(-2.0f * std::log(u3));
+    out[4 * l + 0] = r1 * std::cos(two_pi * u2);
+    out[4 * l + 1] = r1 * std::sin(two_pi * u2);
+    out[4 * l + 2] = r2 * std::cos(two_pi * u4);
+    out[4 * l + 3] = r2 * std::sin(two_pi * u4);
+  }
+}
+
+void GaussianNoise::Fill(float *out, size_t n) {
+  const float s = static_cast<float>(std_dev_);
+  size_t i = 0;
+
+  // use up what is left of the current block first
+  while (i < n && used_ < BLOCK_SIZE) {
+    out[i++] = buffer_[used_++] * s;
+  }
+
+  // whole blocks are generated straight into the output
+  for (; n - i >= BLOCK_SIZE; i += BLOCK_SIZE) {
+    GenerateBlock(out + i);
+    for (unsigned int j = 0; j < BLOCK_SIZE; j++) {
+      out[i + j] *= s;
+    }
+  }
+
+  if (i < n) {
+    GenerateBlock(buffer_);
+    used_ = 0;
+    while (i < n) {
+      out[i++] = buffer_[used_++] * s;
+    }
+  }
+}
+
+void GaussianNoise::Add(float *data, size_t n) {
+  if (std_dev_ == 0) {
+    return;
+  }
+
+  float noise[BLOCK_SIZE];
+  for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+    size_t m = std::min<size_t>(BLOCK_SIZE, n - i);
+    Fill(noise, m);
+    for (size_t j = 0; j < m; j++) {
+      data[i + j] += noise[j];
+    }
+  }
+}
+
+float GaussianNoise::Next() {
+  if (used_ == BLOCK_SIZE) {
+    GenerateBlock(buffer_);
+    used_ = 0;
+  }
+  return buffer_[used_++] * static_cast<float>(std_dev_);
+}
+
+uint64_t GaussianNoise::GetState() const {
+  StateHash hash;
+  hash.Add(key_);
+  hash.Add(counter_);
+  hash.Add(used_);
+  return hash.Get();
+}
+};  // namespace flatland_server
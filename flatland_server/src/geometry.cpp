@@ -46,7 +46,17 @@
 
 #include "flatland_server/geometry.h"
 #include <Box2D/Box2D.h>
+#include <algorithm>
 #include <cmath>
+#include <utility>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace flatland_server {
 
@@ -85,4 +95,445 @@ b2Vec2 Geometry::InverseTransform(const b2Vec2& in, const RotateTranslate& rt) {
   out.y = -(in.x - rt.dx) * rt.sin + (in.y - rt.dy) * rt.cos;
   return out;
 }
+
+RotateTranslate Geometry::Inverse(const RotateTranslate& rt) {
+  RotateTranslate out = {-(rt.dx * rt.cos + rt.dy * rt.sin),
+                         rt.dx * rt.sin - rt.dy * rt.cos, rt.cos, -rt.sin};
+  return out;
+}
+
+void Geometry::TransformPoints(const RotateTranslate& rt, const b2Vec2* in,
+                               size_t count, b2Vec2* out) {
+  const float c = rt.cos, s = rt.sin, dx = rt.dx, dy = rt.dy;
+  size_t i = 0;
+
+  // two interleaved points per vector, [x0 y0 x1 y1], the swapped vector
+  // [y0 x0 y1 x1] gives the cross terms
+#if defined(__SSE2__)
+  const __m128 vc = _mm_set1_ps(c);
+  const __m128 vs = _mm_setr_ps(-s, s, -s, s);
+  const __m128 vd = _mm_setr_ps(dx, dy, dx, dy);
+  for (; i + 2 <= count; i += 2) {
+    __m128 p = _mm_loadu_ps(&in[i].x);
+    __m128 swapped = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 r = _mm_add_ps(_mm_mul_ps(p, vc), _mm_mul_ps(swapped, vs));
+    _mm_storeu_ps(&out[i].x, _mm_add_ps(r, vd));
+  }
+#elif defined(__ARM_NEON)
+  const float signs[4] = {-s, s, -s, s};
+  const float offsets[4] = {dx, dy, dx, dy};
+  const float32x4_t vc = vdupq_n_f32(c);
+  const float32x4_t vs = vld1q_f32(signs);
+  const float32x4_t vd = vld1q_f32(offsets);
+  for (; i + 2 <= count; i += 2) {
+    float32x4_t p = vld1q_f32(&in[i].x);
+    float32x4_t r = vmlaq_f32(vmulq_f32(p, vc), vrev64q_f32(p), vs);
+    vst1q_f32(&out[i].x, vaddq_f32(r, vd));
+  }
+#endif
+
+  // scalar fallback, and the remainder when vectorized
+  for (; i < count; i++) {
+    float x = in[i].x, y = in[i].y;
+    out[i].x = x * c - y * s + dx;
+    out[i].y = x * s + y * c + dy;
+  }
+}
+
+void Geometry::InverseTransformPoints(const RotateTranslate& rt,
+                                      const b2Vec2* in, size_t count,
+                                      b2Vec2* out) {
+  TransformPoints(Inverse(rt), in, count, out);
+}
+
+void Geometry::TransformPoints(const RotateTranslate& rt, const float* x,
+                               const float* y, size_t count, float* out_x,
+                               float* out_y) {
+  const float c = rt.cos, s = rt.sin, dx = rt.dx, dy = rt.dy;
+  size_t i = 0;
+
+#if defined(__AVX__)
+  const __m256 vc = _mm256_set1_ps(c), vs = _mm256_set1_ps(s);
+  const __m256 vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy);
+  for (; i + 8 <= count; i += 8) {
+    __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+    __m256 rx = _mm256_add_ps(
+        _mm256_sub_ps(_mm256_mul_ps(px, vc), _mm256_mul_ps(py, vs)), vdx);
+    __m256 ry = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(px, vs), _mm256_mul_ps(py, vc)), vdy);
+    _mm256_storeu_ps(out_x + i, rx);
+    _mm256_storeu_ps(out_y + i, ry);
+  }
+#elif defined(__SSE2__)
+  const __m128 vc = _mm_set1_ps(c), vs = _mm_set1_ps(s);
+  const __m128 vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+  for (; i + 4 <= count; i += 4) {
+    __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+    __m128 rx =
+        _mm_add_ps(_mm_sub_ps(_mm_mul_ps(px, vc), _mm_mul_ps(py, vs)), vdx);
+    __m128 ry =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, vs), _mm_mul_ps(py, vc)), vdy);
+    _mm_storeu_ps(out_x + i, rx);
+    _mm_storeu_ps(out_y + i, ry);
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t vc = vdupq_n_f32(c), vs = vdupq_n_f32(s);
+  const float32x4_t vdx = vdupq_n_f32(dx), vdy = vdupq_n_f32(dy);
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t px = vld1q_f32(x + i), py = vld1q_f32(y + i);
+    float32x4_t rx = vaddq_f32(vmlsq_f32(vmulq_f32(px, vc), py, vs), vdx);
+    float32x4_t ry = vaddq_f32(vmlaq_f32(vmulq_f32(px, vs), py, vc), vdy);
+    vst1q_f32(out_x + i, rx);
+    vst1q_f32(out_y + i, ry);
+  }
+#endif
+
+  for (; i < count; i++) {
+    float px = x[i], py = y[i];
+    out_x[i] = px * c - py * s + dx;
+    out_y[i] = px * s + py * c + dy;
+  }
+}
+void Geometry::LinkSegments(const std::vector<LineSegment>& segments,
+                            std::vector<std::vector<b2Vec2>>* closed,
+                            std::vector<std::vector<b2Vec2>>* open) {
+  // end e of segment i has the id 2 * i + e, sort the ends by position and
+  // pair up the ends sharing a position
+  auto point = [&](int id) {
+    const LineSegment& s = segments[id / 2];
+    const Vec2& v = (id % 2) ? s.end : s.start;
+    return std::make_pair(v.x, v.y);
+  };
+
+  std::vector<int> ends(segments.size() * 2);
+  for (unsigned int i = 0; i < ends.size(); i++) {
+    ends[i] = i;
+  }
+  std::sort(ends.begin(), ends.end(),
+            [&](int a, int b) { return point(a) < point(b); });
+
+  std::vector<int> partner(ends.size(), -1);
+  for (unsigned int i = 0; i + 1 < ends.size(); i++) {
+    if (point(ends[i]) == point(ends[i + 1])) {
+      partner[ends[i]] = ends[i + 1];
+      partner[ends[i + 1]] = ends[i];
+      i++;
+    }
+  }
+
+  auto vertex = [&](int id) {
+    std::pair<double, double> p = point(id);
+    return b2Vec2(p.first, p.second);
+  };
+
+  std::vector<bool> visited(segments.size(), false);
+
+  // walks from the end id through the linked segments, appending the far end
+  // of each one until an unlinked end or an already visited segment
+  auto walk = [&](int id, std::vector<b2Vec2>* polyline) {
+    int next = partner[id];
+    while (next >= 0 && !visited[next / 2]) {
+      visited[next / 2] = true;
+      id = next ^ 1;
+      polyline->push_back(vertex(id));
+      next = partner[id];
+    }
+    return next;
+  };
+
+  // open polylines start at the unlinked ends
+  for (unsigned int id = 0; id < ends.size(); id++) {
+    if (partner[id] >= 0 || visited[id / 2]) {
+      continue;
+    }
+    visited[id / 2] = true;
+    std::vector<b2Vec2> polyline = {vertex(id), vertex(id ^ 1)};
+    walk(id ^ 1, &polyline);
+    open->push_back(polyline);
+  }
+
+  // every remaining segment belongs to a cycle
+  for (unsigned int i = 0; i < segments.size(); i++) {
+    if (visited[i]) {
+      continue;
+    }
+    visited[i] = true;
+    std::vector<b2Vec2> polyline = {vertex(2 * i)};
+    polyline.push_back(vertex(2 * i + 1));
+    int last = walk(2 * i + 1, &polyline);
+    if (last == int(2 * i)) {
+      // back to the first vertex, which is not repeated
+      polyline.pop_back();
+      closed->push_back(polyline);
+    } else {
+      open->push_back(polyline);
+    }
+  }
+}
+
+std::vector<b2Vec2> Geometry::SimplifyPolyline(
+    const std::vector<b2Vec2>& polyline, double tolerance, bool closed) {
+  if (polyline.size() < 3) {
+    return polyline;
+  }
+
+  // a closed polyline is split at the first vertex and the vertex farthest
+  // from it, the two halves are simplified as open polylines
+  std::vector<b2Vec2> points = polyline;
+  unsigned int split = points.size() - 1;
+  if (closed) {
+    points.push_back(points[0]);
+    float max_dist = -1;
+    for (unsigned int i = 1; i + 1 < points.size(); i++) {
+      float d = b2DistanceSquared(points[0], points[i]);
+      if (d > max_dist) {
+        max_dist = d;
+        split = i;
+      }
+    }
+  }
+
+  // distance from p to the segment ab
+  auto distance = [](const b2Vec2& p, const b2Vec2& a, const b2Vec2& b) {
+    b2Vec2 ab = b - a;
+    float len_sq = ab.LengthSquared();
+    float t = len_sq > 0 ? b2Dot(p - a, ab) / len_sq : 0;
+    t = std::max(0.0f, std::min(1.0f, t));
+    return b2Distance(p, a + t * ab);
+  };
+
+  // iterative Douglas-Peucker, so large polylines cannot overflow the stack
+  std::vector<bool> keep(points.size(), false);
+  keep[0] = keep[split] = keep.back() = true;
+  std::vector<std::pair<unsigned int, unsigned int>> stack = {
+      {0, split}, {split, points.size() - 1}};
+  while (!stack.empty()) {
+    unsigned int a = stack.back().first, b = stack.back().second;
+    stack.pop_back();
+
+    float max_dist = -1;
+    unsigned int farthest = a;
+    for (unsigned int i = a + 1; i < b; i++) {
+      float d = distance(points[i], points[a], points[b]);
+      if (d > max_dist) {
+        max_dist = d;
+        farthest = i;
+      }
+    }
+
+    if (farthest != a && max_dist > tolerance) {
+      keep[farthest] = true;
+      stack.push_back({a, farthest});
+      stack.push_back({farthest, b});
+    }
+  }
+
+  if (closed) {
+    points.pop_back();
+  }
+
+  std::vector<b2Vec2> result;
+  for (unsigned int i = 0; i < points.size(); i++) {
+    if (keep[i]) {
+      result.push_back(points[i]);
+    }
+  }
+  return result;
+}
+
+namespace {
+// twice the signed area of the triangle a, b, c, positive if counterclockwise
+double Cross(const b2Vec2& a, const b2Vec2& b, const b2Vec2& c) {
+  return (double(b.x) - a.x) * (double(c.y) - a.y) -
+         (double(b.y) - a.y) * (double(c.x) - a.x);
+}
+
+// if p is inside or on the triangle a, b, c, which is counterclockwise
+bool InTriangle(const b2Vec2& p, const b2Vec2& a, const b2Vec2& b,
+                const b2Vec2& c) {
+  return Cross(a, b, p) >= 0 && Cross(b, c, p) >= 0 && Cross(c, a, p) >= 0;
+}
+
+// if the segments a-b and c-d cross at a point interior to both
+bool SegmentsCross(const b2Vec2& a, const b2Vec2& b, const b2Vec2& c,
+                   const b2Vec2& d) {
+  double d1 = Cross(a, b, c), d2 = Cross(a, b, d);
+  double d3 = Cross(c, d, a), d4 = Cross(c, d, b);
+  return ((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) &&
+         ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0));
+}
+
+// if p lies on the segment a-b, within the tolerance of the orientation
+bool OnSegment(const b2Vec2& p, const b2Vec2& a, const b2Vec2& b,
+               double eps) {
+  return std::abs(Cross(a, b, p)) <= eps && b2Dot(p - a, b - a) >= 0 &&
+         b2Dot(p - b, a - b) >= 0;
+}
+
+// the vertices of a polygon given by indices, without the collinear ones
+std::vector<b2Vec2> Corners(const std::vector<b2Vec2>& points,
+                            const std::vector<int>& polygon, double eps) {
+  std::vector<b2Vec2> corners;
+  size_t n = polygon.size();
+  for (size_t i = 0; i < n; i++) {
+    const b2Vec2& prev = points[polygon[(i + n - 1) % n]];
+    const b2Vec2& p = points[polygon[i]];
+    const b2Vec2& next = points[polygon[(i + 1) % n]];
+    if (std::abs(Cross(prev, p, next)) > eps) {
+      corners.push_back(p);
+    }
+  }
+  return corners;
+}
+}
+
+bool Geometry::IsConvex(const std::vector<b2Vec2>& polygon) {
+  size_t n = polygon.size();
+  bool positive = false, negative = false;
+  for (size_t i = 0; i < n; i++) {
+    double c = Cross(polygon[i], polygon[(i + 1) % n], polygon[(i + 2) % n]);
+    positive = positive || c > 0;
+    negative = negative || c < 0;
+  }
+  return !(positive && negative);
+}
+
+bool Geometry::DecomposePolygon(const std::vector<b2Vec2>& polygon,
+                                int max_vertices,
+                                std::vector<std::vector<b2Vec2>>* pieces) {
+  pieces->clear();
+  size_t n = polygon.size();
+  if (n < 3 || max_vertices < 3) {
+    return false;
+  }
+
+  // the tolerance of the orientation tests scales with the polygon
+  double area = 0, extent = 0;
+  for (size_t i = 0; i < n; i++) {
+    const b2Vec2& p = polygon[i];
+    const b2Vec2& q = polygon[(i + 1) % n];
+    area += double(p.x) * q.y - double(q.x) * p.y;
+    extent = std::max(extent, double(std::max(std::abs(p.x), std::abs(p.y))));
+  }
+  double eps = 1e-9 * std::max(extent * extent, 1e-12);
+  if (std::abs(area) <= eps) {
+    return false;
+  }
+
+  // a simple polygon has no two edges crossing, nor repeated vertices, nor
+  // vertices touching the edges they do not belong to
+  for (size_t i = 0; i < n; i++) {
+    const b2Vec2& a = polygon[i];
+    const b2Vec2& b = polygon[(i + 1) % n];
+    for (size_t j = 0; j < n; j++) {
+      if (j == i || j == (i + 1) % n) {
+        continue;
+      }
+      if (OnSegment(polygon[j], a, b, eps)) {
+        return false;
+      }
+      if (j > i && SegmentsCross(a, b, polygon[j], polygon[(j + 1) % n])) {
+        return false;
+      }
+    }
+  }
+
+  // the vertices counterclockwise
+  std::vector<b2Vec2> points(polygon);
+  if (area < 0) {
+    std::reverse(points.begin(), points.end());
+  }
+
+  // ear clipping: a convex vertex whose triangle contains no other remaining
+  // vertex is cut off, until a triangle is left
+  std::vector<std::vector<int>> polygons;
+  std::vector<int> remaining(n);
+  for (size_t i = 0; i < n; i++) {
+    remaining[i] = i;
+  }
+  while (remaining.size() > 3) {
+    size_t m = remaining.size();
+    bool clipped = false;
+    for (size_t i = 0; i < m && !clipped; i++) {
+      int a = remaining[(i + m - 1) % m], b = remaining[i],
+          c = remaining[(i + 1) % m];
+      double turn = Cross(points[a], points[b], points[c]);
+      if (turn <= eps) {
+        // a collinear vertex is dropped, its neighbours are joined
+        if (std::abs(turn) <= eps &&
+            b2Dot(points[b] - points[a], points[c] - points[b]) > 0) {
+          remaining.erase(remaining.begin() + i);
+          clipped = true;
+        }
+        continue;
+      }
+      bool ear = true;
+      for (int k : remaining) {
+        if (k != a && k != b && k != c &&
+            InTriangle(points[k], points[a], points[b], points[c])) {
+          ear = false;
+          break;
+        }
+      }
+      if (ear) {
+        polygons.push_back({a, b, c});
+        remaining.erase(remaining.begin() + i);
+        clipped = true;
+      }
+    }
+    if (!clipped) {
+      return false;
+    }
+  }
+  if (Cross(points[remaining[0]], points[remaining[1]],
+            points[remaining[2]]) > eps) {
+    polygons.push_back(remaining);
+  }
+
+  // Hertel-Mehlhorn: two pieces sharing a diagonal are merged when the
+  // result is still convex and small enough, the merged piece goes around
+  // the first one from b to a and around the second one back to b
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < polygons.size() && !merged; i++) {
+      for (size_t j = i + 1; j < polygons.size() && !merged; j++) {
+        const std::vector<int>& p = polygons[i];
+        const std::vector<int>& q = polygons[j];
+        for (size_t u = 0; u < p.size() && !merged; u++) {
+          int a = p[u], b = p[(u + 1) % p.size()];
+          auto v = std::find(q.begin(), q.end(), b);
+          if (v == q.end() || q[(v - q.begin() + 1) % q.size()] != a) {
+            continue;
+          }
+          std::vector<int> combined;
+          for (size_t k = 0; k < p.size(); k++) {
+            combined.push_back(p[(u + 1 + k) % p.size()]);
+          }
+          size_t start = (v - q.begin() + 2) % q.size();
+          for (size_t k = 0; k + 2 < q.size(); k++) {
+            combined.push_back(q[(start + k) % q.size()]);
+          }
+          bool convex = true;
+          size_t c = combined.size();
+          for (size_t k = 0; k < c && convex; k++) {
+            convex = Cross(points[combined[k]], points[combined[(k + 1) % c]],
+                           points[combined[(k + 2) % c]]) >= -eps;
+          }
+          if (convex &&
+              int(Corners(points, combined, eps).size()) <= max_vertices) {
+            polygons[i] = combined;
+            polygons.erase(polygons.begin() + j);
+            merged = true;
+          }
+        }
+      }
+    }
+  }
+
+  for (const auto& piece : polygons) {
+    pieces->push_back(Corners(points, piece, eps));
+  }
+  return true;
+}
 };
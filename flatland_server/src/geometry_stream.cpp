@@ -0,0 +1,241 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 geometry_stream.cpp
+ * @brief	 Publishes the outlines and poses of the bodies as packed arrays
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/debug_visualization.h>
+#include <flatland_server/geometry_stream.h>
+#include <flatland_server/layer_tiles.h>
+#include <flatland_server/world.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_server {
+
+const int GeometryStream::CIRCLE_SEGMENTS;
+
+namespace {
+void AppendSegment(const b2Transform &transform, const b2Vec2 &a,
+                   const b2Vec2 &b, std::vector<float> *segments) {
+  b2Vec2 p = b2Mul(transform, a), q = b2Mul(transform, b);
+  segments->insert(segments->end(), {p.x, p.y, q.x, q.y});
+}
+
+uint8_t ColorByte(float c) {
+  return uint8_t(std::lround(std::min(std::max(c, 0.0f), 1.0f) * 255));
+}
+}
+
+GeometryStream::GeometryStream(World *world, double rate)
+    : world_(world), period_(1.0 / rate) {
+  ros::NodeHandle nh(world_->namespace_);
+  geometry_publisher_ =
+      nh.advertise<flatland_msgs::WorldGeometry>("geometry", 1, true);
+  poses_publisher_ = nh.advertise<flatland_msgs::BodyPoses>("body_poses", 1);
+  geometry_.header.frame_id = "map";
+  poses_.header.frame_id = "map";
+}
+
+void GeometryStream::AfterStep(const ros::Time &time) {
+  // the geometry is latched, it is published once it changes whether or not
+  // anyone is listening, so that late subscribers get the current one
+  uint64_t signature = Signature();
+  if (!published_ || signature != signature_) {
+    Rebuild(time);
+    geometry_publisher_.publish(geometry_);
+    signature_ = signature;
+    published_ = true;
+  }
+
+  double t = time.toSec();
+  if (t < next_time_) {
+    return;
+  }
+  next_time_ = std::max(next_time_ + period_, t);
+  if (poses_publisher_.getNumSubscribers() == 0) {
+    return;
+  }
+
+  const BodyStates &states = world_->plugin_manager_.body_states_;
+  poses_.header.stamp = time;
+  poses_.version = geometry_.version;
+  poses_.poses.resize(3 * bodies_.size());
+  float *pose = poses_.poses.data();
+  for (const Body *body : bodies_) {
+    int j = body->state_index_;
+    if (j < 0) {
+      Pose p = states.GetPose(body);
+      pose[0] = p.x;
+      pose[1] = p.y;
+      pose[2] = p.theta;
+    } else {
+      pose[0] = states.x_[j];
+      pose[1] = states.y_[j];
+      pose[2] = states.angle_[j];
+    }
+    pose += 3;
+  }
+  poses_publisher_.publish(poses_);
+}
+
+void GeometryStream::AppendOutline(const b2Body *body,
+                                   const b2Transform &transform,
+                                   std::vector<float> *segments) {
+  for (const b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    switch (f->GetType()) {
+      case b2Shape::e_circle: {
+        const b2CircleShape *circle =
+            static_cast<const b2CircleShape *>(f->GetShape());
+        b2Vec2 prev = circle->m_p + b2Vec2(circle->m_radius, 0);
+        for (int i = 1; i <= CIRCLE_SEGMENTS; i++) {
+          double a = 2 * M_PI * i / CIRCLE_SEGMENTS;
+          b2Vec2 next = circle->m_p + circle->m_radius * b2Vec2(std::cos(a),
+                                                                std::sin(a));
+          AppendSegment(transform, prev, next, segments);
+          prev = next;
+        }
+      } break;
+
+      case b2Shape::e_polygon: {
+        const b2PolygonShape *poly =
+            static_cast<const b2PolygonShape *>(f->GetShape());
+        for (int i = 0; i < poly->m_count; i++) {
+          AppendSegment(transform, poly->m_vertices[i],
+                        poly->m_vertices[(i + 1) % poly->m_count], segments);
+        }
+      } break;
+
+      case b2Shape::e_edge: {
+        const b2EdgeShape *edge =
+            static_cast<const b2EdgeShape *>(f->GetShape());
+        AppendSegment(transform, edge->m_vertex1, edge->m_vertex2, segments);
+      } break;
+
+      case b2Shape::e_chain: {
+        // loops repeat their first vertex at the end
+        const b2ChainShape *chain =
+            static_cast<const b2ChainShape *>(f->GetShape());
+        for (int i = 0; i + 1 < chain->m_count; i++) {
+          AppendSegment(transform, chain->m_vertices[i],
+                        chain->m_vertices[i + 1], segments);
+        }
+      } break;
+
+      default:
+        break;
+    }
+  }
+}
+
+void GeometryStream::AppendBody(const std::string &name, const Color &color,
+                                flatland_msgs::WorldGeometry *msg) {
+  msg->names.push_back(name);
+  msg->colors.insert(msg->colors.end(),
+                     {ColorByte(color.r), ColorByte(color.g),
+                      ColorByte(color.b), ColorByte(color.a)});
+  msg->segment_ends.push_back(msg->segments.size() / 4);
+}
+
+uint64_t GeometryStream::Signature() const {
+  // all the counters only grow, so their sum changes whenever one does
+  uint64_t signature = world_->plugin_manager_.body_states_.generation_;
+  for (const Layer *layer : world_->layers_) {
+    signature += layer->geometry_changes_;
+    if (layer->tiles_ != nullptr) {
+      signature += layer->tiles_->GetChangeCount();
+    }
+  }
+  for (const Model *model : world_->models_) {
+    signature += model->geometry_changes_;
+  }
+  return signature;
+}
+
+void GeometryStream::Rebuild(const ros::Time &time) {
+  uint32_t version = geometry_.version + 1;
+  geometry_ = flatland_msgs::WorldGeometry();
+  geometry_.header.frame_id = "map";
+  geometry_.header.stamp = time;
+  geometry_.version = version;
+
+  // the layers are sent in the world frame, with the reduced level of detail
+  // of their markers if they have one
+  for (const Layer *layer : world_->layers_) {
+    const Body *body = layer->body_;
+    if (body == nullptr) {
+      continue;
+    }
+    const b2Transform &transform = body->physics_body_->GetTransform();
+    LayerVisualization lod(body->properties_);
+    if (lod.ReducesDetail()) {
+      for (const auto &edge :
+           DebugVisualization::LayerEdges(body->physics_body_, lod)) {
+        AppendSegment(transform, edge.first, edge.second,
+                      &geometry_.segments);
+      }
+    } else {
+      AppendOutline(body->physics_body_, transform, &geometry_.segments);
+    }
+    if (layer->tiles_ != nullptr) {
+      for (b2Body *b : layer->tiles_->GetActiveBodies()) {
+        AppendOutline(b, b->GetTransform(), &geometry_.segments);
+      }
+    }
+    AppendBody("layer/" + layer->name_, body->color_, &geometry_);
+  }
+  geometry_.static_count = geometry_.names.size();
+
+  b2Transform identity;
+  identity.SetIdentity();
+  bodies_.clear();
+  for (const Model *model : world_->models_) {
+    for (const Body *body : model->bodies_) {
+      AppendOutline(body->physics_body_, identity, &geometry_.segments);
+      AppendBody(model->GetName() + "/" + body->name_, body->color_,
+                 &geometry_);
+      bodies_.push_back(body);
+    }
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,159 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gps_batch.cpp
+ * @brief	 Converts the positions of all GPS receivers of a world at once
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/gps_batch.h>
+#include <cmath>
+
+namespace flatland_server {
+
+const double GpsBatch::WGS84_A = 6378137.0;
+const double GpsBatch::WGS84_E2 = 0.0066943799831668;
+
+/// Fixed point iterations of the latitude, from a start that is already
+/// within a few micro radians near the surface of the Earth
+static const int LATITUDE_ITERATIONS = 2;
+
+GpsReference::GpsReference(double lat_rad, double lon_rad)
+    : sin_lat(sin(lat_rad)),
+      cos_lat(cos(lat_rad)),
+      sin_lon(sin(lon_rad)),
+      cos_lon(cos(lon_rad)) {
+  double n = GpsBatch::WGS84_A /
+             sqrt(1.0 - GpsBatch::WGS84_E2 * sin_lat * sin_lat);
+  ecef_x = n * cos_lat * cos_lon;
+  ecef_y = n * cos_lat * sin_lon;
+  ecef_z = n * (1.0 - GpsBatch::WGS84_E2) * sin_lat;
+}
+
+int GpsBatch::Add(const Body *body, const b2Vec2 &offset,
+                  const GpsReference &reference) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int id;
+  if (!free_.empty()) {
+    id = free_.back();
+    free_.pop_back();
+  } else {
+    id = bodies_.size();
+    bodies_.push_back(nullptr);
+    offsets_.emplace_back();
+    references_.emplace_back();
+    x_.push_back(0);
+    y_.push_back(0);
+    latitudes_.push_back(0);
+    longitudes_.push_back(0);
+  }
+  bodies_[id] = body;
+  offsets_[id] = offset;
+  references_[id] = reference;
+  size_++;
+  changed_ = true;
+  return id;
+}
+
+void GpsBatch::Remove(int id) {
+  if (id < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  bodies_[id] = nullptr;
+  free_.push_back(id);
+  size_--;
+}
+
+GpsBatch::Fix GpsBatch::Get(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t refreshes = states_ ? states_->refreshes_ : 0;
+  if (refreshes != converted_ || changed_ || !states_) {
+    // the positions of all receivers, then one pass over the arrays
+    for (size_t i = 0; i < bodies_.size(); i++) {
+      if (!bodies_[i]) continue;
+      b2Transform t = states_ ? states_->GetTransform(bodies_[i])
+                              : bodies_[i]->physics_body_->GetTransform();
+      b2Vec2 p = b2Mul(t, offsets_[i]);
+      x_[i] = p.x;
+      y_[i] = p.y;
+    }
+    Convert(bodies_.size(), x_.data(), y_.data(), references_.data(),
+            latitudes_.data(), longitudes_.data());
+    converted_ = refreshes;
+    changed_ = false;
+  }
+
+  Fix fix;
+  fix.latitude = latitudes_[id];
+  fix.longitude = longitudes_[id];
+  return fix;
+}
+
+void GpsBatch::Convert(size_t count, const double *x, const double *y,
+                       const GpsReference *references, double *latitudes,
+                       double *longitudes) {
+  for (size_t i = 0; i < count; i++) {
+    const GpsReference &r = references[i];
+
+    // map position, east and north of the reference, to ECEF coordinates
+    double ecef_x = r.ecef_x - r.sin_lon * x[i] - r.sin_lat * r.cos_lon * y[i];
+    double ecef_y = r.ecef_y + r.cos_lon * x[i] - r.sin_lat * r.sin_lon * y[i];
+    double ecef_z = r.ecef_z + r.cos_lat * y[i];
+
+    // ECEF to latitude and longitude, the longitude is exact
+    longitudes[i] = atan2(ecef_y, ecef_x) * 180.0 * M_1_PI;
+
+    // the latitude solves tan(lat) = z / (p - e2 * N(lat) * cos(lat)),
+    // starting from the one of a point at zero altitude
+    double p = sqrt(ecef_x * ecef_x + ecef_y * ecef_y);
+    double lat_rad = atan2(ecef_z, p * (1.0 - WGS84_E2));
+    for (int k = 0; k < LATITUDE_ITERATIONS; k++) {
+      double s_lat = sin(lat_rad);
+      double n = WGS84_A / sqrt(1.0 - WGS84_E2 * s_lat * s_lat);
+      lat_rad = atan2(ecef_z, p - WGS84_E2 * n * cos(lat_rad));
+    }
+    latitudes[i] = lat_rad * 180.0 * M_1_PI;
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,457 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gpu_raycaster.cpp
+ * @brief	 Casts batches of rays on a GPU with OpenCL
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/gpu_raycaster.h>
+#include <flatland_server/layer.h>
+#include <flatland_server/tracer.h>
+#include <ros/ros.h>
+#include <algorithm>
+
+#ifdef FLATLAND_GPU_RAYCAST
+#define CL_TARGET_OPENCL_VERSION 120
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#include <CL/cl.h>
+#endif
+
+namespace flatland_server {
+
+#ifdef FLATLAND_GPU_RAYCAST
+
+namespace {
+
+// one work item per ray, the tests match b2EdgeShape::RayCast and
+// b2CircleShape::RayCast, the nearest hit wins
+const char *kKernelSource = R"CL(
+void cast_segments(__global const float4 *segments, __global const uint *bits,
+                   uint count, float2 p1, float2 d, uint mask, float *best,
+                   uint *best_bits) {
+  for (uint k = 0; k < count; k++) {
+    if (!(bits[k] & mask)) continue;
+    float4 s = segments[k];
+    float2 v1 = s.xy;
+    float2 e = s.zw - s.xy;
+    float2 n = (float2)(e.y, -e.x);
+    float den = dot(n, d);
+    float ee = dot(e, e);
+    if (den == 0.0f || ee == 0.0f) continue;
+    float t = dot(n, v1 - p1) / den;
+    if (t < 0.0f || t > *best) continue;
+    float u = dot(p1 + t * d - v1, e) / ee;
+    if (u < 0.0f || u > 1.0f) continue;
+    *best = t;
+    *best_bits = bits[k];
+  }
+}
+
+__kernel void cast_rays(
+    __global const float4 *static_segments, __global const uint *static_bits,
+    uint static_count, __global const float4 *dynamic_segments,
+    __global const uint *dynamic_bits, uint dynamic_count,
+    __global const float4 *circles, __global const uint *circle_bits,
+    uint circle_count, __global const float4 *rays,
+    __global const uint *ray_masks, uint ray_count, __global float *fractions,
+    __global uint *hit_bits) {
+  uint i = get_global_id(0);
+  if (i >= ray_count) return;
+
+  float4 ray = rays[i];
+  float2 p1 = ray.xy;
+  float2 d = ray.zw - ray.xy;
+  uint mask = ray_masks[i];
+  float best = 1.0f;
+  uint best_bits = 0;
+
+  cast_segments(static_segments, static_bits, static_count, p1, d, mask,
+                &best, &best_bits);
+  cast_segments(dynamic_segments, dynamic_bits, dynamic_count, p1, d, mask,
+                &best, &best_bits);
+
+  float rr = dot(d, d);
+  for (uint k = 0; k < circle_count; k++) {
+    if (!(circle_bits[k] & mask)) continue;
+    float4 c = circles[k];
+    float2 s = p1 - c.xy;
+    float b = dot(s, s) - c.z * c.z;
+    float cr = dot(s, d);
+    float sigma = cr * cr - rr * b;
+    if (sigma < 0.0f || rr < FLT_EPSILON) continue;
+    float a = -(cr + sqrt(sigma));
+    if (a < 0.0f || a > best * rr) continue;
+    best = a / rr;
+    best_bits = circle_bits[k];
+  }
+
+  fractions[i] = best;
+  hit_bits[i] = best_bits;
+}
+)CL";
+
+/**
+ * A device buffer that only grows
+ */
+struct Buffer {
+  cl_mem mem = nullptr;
+  size_t capacity = 0;
+
+  ~Buffer() {
+    if (mem) clReleaseMemObject(mem);
+  }
+
+  /**
+   * @brief Make room for at least size bytes, the content is lost if the
+   * buffer is reallocated
+   * @return false if the allocation failed
+   */
+  bool Reserve(cl_context context, cl_mem_flags flags, size_t size) {
+    if (mem && size <= capacity) return true;
+    if (mem) clReleaseMemObject(mem);
+    // OpenCL has no empty buffers
+    capacity = std::max<size_t>(std::max(size, capacity * 2), 16);
+    cl_int err;
+    mem = clCreateBuffer(context, flags, capacity, nullptr, &err);
+    if (err != CL_SUCCESS) {
+      mem = nullptr;
+      capacity = 0;
+      return false;
+    }
+    return true;
+  }
+};
+};  // namespace
+
+struct GpuRaycaster::Device {
+  cl_context context = nullptr;
+  cl_command_queue queue = nullptr;
+  cl_program program = nullptr;
+  cl_kernel kernel = nullptr;
+  Buffer static_segments, static_bits, dynamic_segments, dynamic_bits;
+  Buffer circles, circle_bits, rays, ray_masks, fractions, hit_bits;
+
+  ~Device() {
+    if (kernel) clReleaseKernel(kernel);
+    if (program) clReleaseProgram(program);
+    if (queue) clReleaseCommandQueue(queue);
+    if (context) clReleaseContext(context);
+  }
+
+  /**
+   * @brief Copy a vector into a buffer, without waiting
+   * @return false if the buffer could not be allocated or written
+   */
+  template <typename T>
+  bool Write(Buffer *buffer, cl_mem_flags flags, const std::vector<T> &data) {
+    size_t size = data.size() * sizeof(T);
+    if (!buffer->Reserve(context, flags, size)) return false;
+    return size == 0 ||
+           clEnqueueWriteBuffer(queue, buffer->mem, CL_FALSE, 0, size,
+                                data.data(), 0, nullptr,
+                                nullptr) == CL_SUCCESS;
+  }
+};
+
+std::unique_ptr<GpuRaycaster> GpuRaycaster::Create(b2World *world) {
+  // the first GPU of any platform, an OpenCL CPU device would not beat the
+  // Box2D tree
+  cl_uint platform_count = 0;
+  clGetPlatformIDs(0, nullptr, &platform_count);
+  std::vector<cl_platform_id> platforms(platform_count);
+  if (platform_count > 0) {
+    clGetPlatformIDs(platform_count, platforms.data(), nullptr);
+  }
+  cl_device_id device_id = nullptr;
+  for (cl_platform_id platform : platforms) {
+    if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device_id, nullptr) ==
+        CL_SUCCESS) {
+      break;
+    }
+    device_id = nullptr;
+  }
+  if (!device_id) {
+    ROS_WARN_NAMED("GpuRaycaster", "No OpenCL GPU found, rays are cast on "
+                                   "the CPU");
+    return nullptr;
+  }
+
+  std::unique_ptr<Device> device(new Device());
+  cl_int err;
+  device->context =
+      clCreateContext(nullptr, 1, &device_id, nullptr, nullptr, &err);
+  if (err == CL_SUCCESS) {
+    device->queue = clCreateCommandQueue(device->context, device_id, 0, &err);
+  }
+  if (err == CL_SUCCESS) {
+    device->program = clCreateProgramWithSource(device->context, 1,
+                                                &kKernelSource, nullptr, &err);
+  }
+  if (err == CL_SUCCESS) {
+    err = clBuildProgram(device->program, 1, &device_id, "-cl-fast-relaxed-math",
+                         nullptr, nullptr);
+  }
+  if (err == CL_SUCCESS) {
+    device->kernel = clCreateKernel(device->program, "cast_rays", &err);
+  }
+  if (err != CL_SUCCESS) {
+    ROS_WARN_NAMED("GpuRaycaster",
+                   "Failed to set up the OpenCL GPU (error %d), rays are cast "
+                   "on the CPU",
+                   err);
+    return nullptr;
+  }
+
+  std::unique_ptr<GpuRaycaster> raycaster(
+      new GpuRaycaster(world, std::move(device)));
+  char name[256] = {0};
+  clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+  raycaster->device_name_ = name;
+  ROS_INFO_NAMED("GpuRaycaster", "Casting the batched rays on %s", name);
+  return raycaster;
+}
+
+bool GpuRaycaster::Cast(const Ray *rays, unsigned int count, Hit *hits) {
+  if (count == 0) return true;
+  FLATLAND_TRACE("sensor", "gpu_raycast");
+
+  bool static_changed = GatherFixtures();
+
+  ray_data_.resize(4 * count);
+  ray_masks_.resize(count);
+  for (unsigned int i = 0; i < count; i++) {
+    ray_data_[4 * i] = rays[i].p1.x;
+    ray_data_[4 * i + 1] = rays[i].p1.y;
+    ray_data_[4 * i + 2] = rays[i].p2.x;
+    ray_data_[4 * i + 3] = rays[i].p2.y;
+    ray_masks_[i] = rays[i].maskBits;
+  }
+
+  Device &d = *device_;
+  const cl_mem_flags ro = CL_MEM_READ_ONLY;
+  bool ok = true;
+  if (static_changed) {
+    ok = d.Write(&d.static_segments, ro, static_segments_) &&
+         d.Write(&d.static_bits, ro, static_bits_);
+  }
+  ok = ok && d.Write(&d.dynamic_segments, ro, dynamic_segments_) &&
+       d.Write(&d.dynamic_bits, ro, dynamic_bits_) &&
+       d.Write(&d.circles, ro, circles_) &&
+       d.Write(&d.circle_bits, ro, circle_bits_) &&
+       d.Write(&d.rays, ro, ray_data_) && d.Write(&d.ray_masks, ro, ray_masks_) &&
+       d.fractions.Reserve(d.context, CL_MEM_WRITE_ONLY, count * sizeof(float)) &&
+       d.hit_bits.Reserve(d.context, CL_MEM_WRITE_ONLY, count * sizeof(cl_uint));
+  if (!ok) {
+    // upload the static fixtures again on the next try
+    proxy_count_ = -1;
+    return false;
+  }
+
+  cl_uint static_count = static_bits_.size();
+  cl_uint dynamic_count = dynamic_bits_.size();
+  cl_uint circle_count = circle_bits_.size();
+  cl_uint ray_count = count;
+  cl_int err = CL_SUCCESS;
+  cl_uint a = 0;
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.static_segments.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.static_bits.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_uint), &static_count);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.dynamic_segments.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.dynamic_bits.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_uint), &dynamic_count);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.circles.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.circle_bits.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_uint), &circle_count);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.rays.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.ray_masks.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_uint), &ray_count);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.fractions.mem);
+  err |= clSetKernelArg(d.kernel, a++, sizeof(cl_mem), &d.hit_bits.mem);
+
+  // all the rays of the step in a single launch, the reads wait for it
+  size_t local = 64;
+  size_t global = (count + local - 1) / local * local;
+  fractions_.resize(count);
+  hit_bits_.resize(count);
+  if (err == CL_SUCCESS) {
+    err = clEnqueueNDRangeKernel(d.queue, d.kernel, 1, nullptr, &global,
+                                 &local, 0, nullptr, nullptr);
+  }
+  if (err == CL_SUCCESS) {
+    err = clEnqueueReadBuffer(d.queue, d.fractions.mem, CL_FALSE, 0,
+                              count * sizeof(float), fractions_.data(), 0,
+                              nullptr, nullptr);
+  }
+  if (err == CL_SUCCESS) {
+    err = clEnqueueReadBuffer(d.queue, d.hit_bits.mem, CL_TRUE, 0,
+                              count * sizeof(cl_uint), hit_bits_.data(), 0,
+                              nullptr, nullptr);
+  }
+  if (err != CL_SUCCESS) {
+    clFinish(d.queue);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < count; i++) {
+    hits[i].fraction = fractions_[i];
+    hits[i].categoryBits = hit_bits_[i];
+  }
+  return true;
+}
+
+#else
+
+struct GpuRaycaster::Device {};
+
+std::unique_ptr<GpuRaycaster> GpuRaycaster::Create(b2World *world) {
+  ROS_WARN_NAMED("GpuRaycaster",
+                 "flatland_server is built without GPU_RAYCAST, rays are "
+                 "cast on the CPU");
+  return nullptr;
+}
+
+bool GpuRaycaster::Cast(const Ray *rays, unsigned int count, Hit *hits) {
+  return false;
+}
+
+#endif
+
+GpuRaycaster::GpuRaycaster(b2World *world, std::unique_ptr<Device> device)
+    : world_(world),
+      device_(std::move(device)),
+      layer_generation_(Layer::GetGeometryGeneration()) {}
+
+GpuRaycaster::~GpuRaycaster() = default;
+
+void GpuRaycaster::AddFixture(const b2Fixture *fixture, const b2Transform &xf,
+                              std::vector<float> *segments,
+                              std::vector<uint32> *segment_bits,
+                              std::vector<float> *circles,
+                              std::vector<uint32> *circle_bits) {
+  if (fixture->IsSensor()) return;
+  uint32 bits = fixture->GetFilterData().categoryBits;
+
+  auto add_segment = [&](const b2Vec2 &v1, const b2Vec2 &v2) {
+    b2Vec2 a = b2Mul(xf, v1);
+    b2Vec2 b = b2Mul(xf, v2);
+    segments->insert(segments->end(), {a.x, a.y, b.x, b.y});
+    segment_bits->push_back(bits);
+  };
+
+  const b2Shape *shape = fixture->GetShape();
+  switch (shape->GetType()) {
+    case b2Shape::e_edge: {
+      const b2EdgeShape *edge = static_cast<const b2EdgeShape *>(shape);
+      add_segment(edge->m_vertex1, edge->m_vertex2);
+      break;
+    }
+    case b2Shape::e_chain: {
+      const b2ChainShape *chain = static_cast<const b2ChainShape *>(shape);
+      for (int32 i = 0; i < chain->GetChildCount(); i++) {
+        b2EdgeShape edge;
+        chain->GetChildEdge(&edge, i);
+        add_segment(edge.m_vertex1, edge.m_vertex2);
+      }
+      break;
+    }
+    case b2Shape::e_polygon: {
+      const b2PolygonShape *poly = static_cast<const b2PolygonShape *>(shape);
+      for (int32 i = 0; i < poly->m_count; i++) {
+        add_segment(poly->m_vertices[i],
+                    poly->m_vertices[(i + 1) % poly->m_count]);
+      }
+      break;
+    }
+    case b2Shape::e_circle: {
+      const b2CircleShape *circle = static_cast<const b2CircleShape *>(shape);
+      b2Vec2 c = b2Mul(xf, circle->m_p);
+      circles->insert(circles->end(), {c.x, c.y, circle->m_radius, 0.0f});
+      circle_bits->push_back(bits);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+bool GpuRaycaster::GatherFixtures() {
+  // the static bodies only change with the layers, or with the proxies when
+  // tiles are swapped or models spawned
+  bool static_changed = layer_generation_ != Layer::GetGeometryGeneration() ||
+                        proxy_count_ != world_->GetProxyCount();
+  if (static_changed) {
+    layer_generation_ = Layer::GetGeometryGeneration();
+    proxy_count_ = world_->GetProxyCount();
+    static_segments_.clear();
+    static_bits_.clear();
+    static_circles_.clear();
+    static_circle_bits_.clear();
+  }
+  dynamic_segments_.clear();
+  dynamic_bits_.clear();
+  circles_.clear();
+  circle_bits_.clear();
+
+  for (const b2Body *b = world_->GetBodyList(); b; b = b->GetNext()) {
+    bool is_static = b->GetType() == b2_staticBody;
+    if (!b->IsActive() || (is_static && !static_changed)) {
+      continue;
+    }
+    for (const b2Fixture *f = b->GetFixtureList(); f; f = f->GetNext()) {
+      if (is_static) {
+        AddFixture(f, b->GetTransform(), &static_segments_, &static_bits_,
+                   &static_circles_, &static_circle_bits_);
+      } else {
+        AddFixture(f, b->GetTransform(), &dynamic_segments_, &dynamic_bits_,
+                   &circles_, &circle_bits_);
+      }
+    }
+  }
+
+  // the circles are few, all of them are uploaded on every cast
+  circles_.insert(circles_.end(), static_circles_.begin(),
+                  static_circles_.end());
+  circle_bits_.insert(circle_bits_.end(), static_circle_bits_.begin(),
+                      static_circle_bits_.end());
+  return static_changed;
+}
+};  // namespace flatland_server
@@ -0,0 +1,162 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_cache.cpp
+ * @brief	Process wide cache of the decoded map images
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/image_cache.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+#if CV_MAJOR_VERSION < 3
+#define GREYSCALE CV_LOAD_IMAGE_GRAYSCALE
+#else
+#include <opencv2/imgcodecs.hpp>
+#define GREYSCALE cv::ImreadModes::IMREAD_GRAYSCALE
+#endif
+
+namespace flatland_server {
+
+const size_t ImageCache::DEFAULT_CAPACITY;
+
+namespace {
+size_t ImageBytes(const cv::Mat &image) {
+  return image.total() * image.elemSize();
+}
+}
+
+ImageCache &ImageCache::Get() {
+  static ImageCache instance;
+  return instance;
+}
+
+std::shared_ptr<const cv::Mat> ImageCache::Load(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return nullptr;
+  }
+  int64_t mtime_ns =
+      int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  int64_t size = st.st_size;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      if (it->second.mtime_ns == mtime_ns && it->second.size == size) {
+        stats_.hits++;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it->second.image;
+      }
+      Erase(it);
+    }
+    stats_.misses++;
+  }
+
+  // decoded without the lock so that other images load concurrently, if two
+  // threads decode the same image the first one inserted is kept
+  std::shared_ptr<cv::Mat> image =
+      std::make_shared<cv::Mat>(cv::imread(path, GREYSCALE));
+  if (image->empty()) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ImageBytes(*image) > capacity_) {
+    return image;
+  }
+  auto inserted = entries_.emplace(path, Entry());
+  Entry &entry = inserted.first->second;
+  if (!inserted.second) {
+    if (entry.mtime_ns == mtime_ns && entry.size == size) {
+      return entry.image;
+    }
+    stats_.bytes -= ImageBytes(*entry.image);
+    lru_.erase(entry.lru);
+  }
+  entry.mtime_ns = mtime_ns;
+  entry.size = size;
+  entry.image = image;
+  lru_.push_front(path);
+  entry.lru = lru_.begin();
+  stats_.bytes += ImageBytes(*image);
+  Evict();
+  return image;
+}
+
+void ImageCache::SetCapacity(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = bytes;
+  Evict();
+}
+
+size_t ImageCache::GetCapacity() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return capacity_;
+}
+
+void ImageCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  lru_.clear();
+  stats_.bytes = 0;
+}
+
+ImageCache::Stats ImageCache::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.images = entries_.size();
+  return stats;
+}
+
+void ImageCache::Evict() {
+  while (stats_.bytes > capacity_ && !lru_.empty()) {
+    Erase(entries_.find(lru_.back()));
+  }
+}
+
+void ImageCache::Erase(std::unordered_map<std::string, Entry>::iterator it) {
+  stats_.bytes -= ImageBytes(*it->second.image);
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+};  // namespace flatland_server
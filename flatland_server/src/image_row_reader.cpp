@@ -0,0 +1,304 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_row_reader.cpp
+ * @brief	 Decodes map images row by row
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/image_row_reader.h>
+#include <flatland_server/yaml_reader.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace flatland_server {
+
+namespace {
+const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+const size_t kInputSize = 64 << 10;  ///< bytes of IDAT read at once
+
+uint32_t BigEndian32(const uint8_t *bytes) {
+  return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 |
+         uint32_t(bytes[2]) << 8 | uint32_t(bytes[3]);
+}
+
+uint8_t Paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return uint8_t(a);
+  }
+  return uint8_t(pb <= pc ? b : c);
+}
+};  // namespace
+
+ImageRowReader::~ImageRowReader() {
+  if (inflating_) {
+    inflateEnd(&zstream_);
+  }
+}
+
+bool ImageRowReader::Open(const std::string &path) {
+  path_ = path;
+  file_.open(path, std::ios::binary);
+  uint8_t magic[8];
+  if (!file_.read(reinterpret_cast<char *>(magic), sizeof(magic))) {
+    return false;
+  }
+  if (memcmp(magic, kPngSignature, sizeof(magic)) == 0) {
+    png_ = true;
+    return OpenPng();
+  }
+  if (magic[0] == 'P' && magic[1] == '5') {
+    file_.seekg(2);
+    return OpenPgm();
+  }
+  return false;
+}
+
+uint32_t ImageRowReader::ReadChunkHeader(std::string *type) {
+  uint8_t header[8];
+  if (!file_.read(reinterpret_cast<char *>(header), sizeof(header))) {
+    Fail("truncated");
+  }
+  type->assign(reinterpret_cast<char *>(header) + 4, 4);
+  crc_ = crc32(crc32(0, Z_NULL, 0), header + 4, 4);
+  return BigEndian32(header);
+}
+
+void ImageRowReader::CheckChunkCrc() {
+  uint8_t crc[4];
+  if (!file_.read(reinterpret_cast<char *>(crc), sizeof(crc))) {
+    Fail("truncated");
+  }
+  if (BigEndian32(crc) != crc_) {
+    Fail("CRC error");
+  }
+}
+
+bool ImageRowReader::OpenPng() {
+  std::string type;
+  uint32_t length = ReadChunkHeader(&type);
+  uint8_t ihdr[13];
+  if (type != "IHDR" || length != sizeof(ihdr) ||
+      !file_.read(reinterpret_cast<char *>(ihdr), sizeof(ihdr))) {
+    return false;
+  }
+  crc_ = crc32(crc_, ihdr, sizeof(ihdr));
+  CheckChunkCrc();
+
+  // greyscale, without compression, filtering or interlacing variants
+  uint32_t cols = BigEndian32(ihdr), rows = BigEndian32(ihdr + 4);
+  bit_depth_ = ihdr[8];
+  if (cols == 0 || rows == 0 || cols > (1u << 30) || rows > (1u << 30) ||
+      (bit_depth_ != 1 && bit_depth_ != 2 && bit_depth_ != 4 &&
+       bit_depth_ != 8) ||
+      ihdr[9] != 0 || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0) {
+    return false;
+  }
+  cols_ = int(cols);
+  rows_ = int(rows);
+
+  // the chunks before the pixels, e.g. text or gamma, are not needed
+  while (true) {
+    length = ReadChunkHeader(&type);
+    if (type == "IDAT") {
+      chunk_left_ = length;
+      break;
+    }
+    if (type == "IEND" || !file_.seekg(length + 4, std::ios::cur)) {
+      Fail("no pixels");
+    }
+  }
+
+  memset(&zstream_, 0, sizeof(zstream_));
+  if (inflateInit(&zstream_) != Z_OK) {
+    Fail("inflate failed");
+  }
+  inflating_ = true;
+  size_t row_bytes = (size_t(cols_) * bit_depth_ + 7) / 8;
+  input_.resize(kInputSize);
+  filtered_.resize(row_bytes + 1);
+  previous_.resize(row_bytes);
+  current_.assign(row_bytes, 0);
+  return true;
+}
+
+bool ImageRowReader::OpenPgm() {
+  // width, height and maximum value, separated by whitespace and comments
+  int values[3];
+  for (int &value : values) {
+    int c = file_.get();
+    while (std::isspace(c) || c == '#') {
+      if (c == '#') {
+        while (c != '\n' && c != EOF) {
+          c = file_.get();
+        }
+      }
+      c = file_.get();
+    }
+    if (!std::isdigit(c)) {
+      return false;
+    }
+    value = 0;
+    while (std::isdigit(c) && value < (1 << 30)) {
+      value = value * 10 + (c - '0');
+      c = file_.get();
+    }
+    if (!std::isspace(c)) {
+      return false;
+    }
+  }
+
+  // only one byte per pixel is read as is
+  cols_ = values[0];
+  rows_ = values[1];
+  return cols_ > 0 && rows_ > 0 && values[2] == 255;
+}
+
+void ImageRowReader::ReadRow(uint8_t *row) {
+  if (row_ >= rows_) {
+    Fail("read past the last row");
+  }
+  row_++;
+  if (!png_) {
+    if (!file_.read(reinterpret_cast<char *>(row), cols_)) {
+      Fail("truncated");
+    }
+    return;
+  }
+
+  ReadPngRow();
+  if (bit_depth_ == 8) {
+    memcpy(row, current_.data(), cols_);
+    return;
+  }
+
+  // the samples are scaled to 8 bits, e.g. 1 bit pixels are 0 or 255
+  int mask = (1 << bit_depth_) - 1;
+  int per_byte = 8 / bit_depth_;
+  for (int j = 0; j < cols_; j++) {
+    int shift = 8 - bit_depth_ * (j % per_byte + 1);
+    int sample = (current_[j / per_byte] >> shift) & mask;
+    row[j] = uint8_t(sample * 255 / mask);
+  }
+}
+
+void ImageRowReader::ReadPngRow() {
+  previous_.swap(current_);
+  zstream_.next_out = filtered_.data();
+  zstream_.avail_out = uInt(filtered_.size());
+  while (zstream_.avail_out > 0) {
+    if (zstream_.avail_in == 0 && !ReadPngData()) {
+      Fail("truncated");
+    }
+    int ret = inflate(&zstream_, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END && zstream_.avail_out > 0) {
+      Fail("truncated");
+    }
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      Fail("invalid compressed data");
+    }
+  }
+
+  // each byte is predicted from the bytes on its left and above, one byte
+  // per pixel at these bit depths
+  const uint8_t *src = filtered_.data() + 1;
+  const uint8_t *above = previous_.data();
+  uint8_t *out = current_.data();
+  size_t n = current_.size();
+  switch (filtered_[0]) {
+    case 0:
+      memcpy(out, src, n);
+      break;
+    case 1:
+      out[0] = src[0];
+      for (size_t i = 1; i < n; i++) out[i] = uint8_t(src[i] + out[i - 1]);
+      break;
+    case 2:
+      for (size_t i = 0; i < n; i++) out[i] = uint8_t(src[i] + above[i]);
+      break;
+    case 3:
+      out[0] = uint8_t(src[0] + (above[0] >> 1));
+      for (size_t i = 1; i < n; i++) {
+        out[i] = uint8_t(src[i] + ((out[i - 1] + above[i]) >> 1));
+      }
+      break;
+    case 4:
+      out[0] = uint8_t(src[0] + above[0]);
+      for (size_t i = 1; i < n; i++) {
+        out[i] = uint8_t(src[i] + Paeth(out[i - 1], above[i], above[i - 1]));
+      }
+      break;
+    default:
+      Fail("invalid filter");
+  }
+}
+
+bool ImageRowReader::ReadPngData() {
+  // the compressed stream may be split in many IDAT chunks
+  while (chunk_left_ == 0) {
+    CheckChunkCrc();
+    std::string type;
+    chunk_left_ = ReadChunkHeader(&type);
+    if (type != "IDAT") {
+      return false;
+    }
+  }
+  size_t size = std::min<size_t>(chunk_left_, input_.size());
+  if (!file_.read(reinterpret_cast<char *>(input_.data()), size)) {
+    Fail("truncated");
+  }
+  crc_ = crc32(crc_, input_.data(), uInt(size));
+  chunk_left_ -= uint32_t(size);
+  zstream_.next_in = input_.data();
+  zstream_.avail_in = uInt(size);
+  return true;
+}
+
+void ImageRowReader::Fail(const std::string &what) const {
+  throw Exception("Flatland File: Failed to decode " + Q(path_) + ", " + what);
+}
+};  // namespace flatland_server
@@ -1,31 +1,137 @@
+#include <flatland_server/command_queue.h>
+#include <flatland_server/debug_visualization.h>
 #include <flatland_server/interactive_marker_manager.h>
+#include <flatland_server/world.h>
+#include <ros/topic_manager.h>
 
 namespace flatland_server {
 
-InteractiveMarkerManager::InteractiveMarkerManager(
-    std::vector<Model *> *model_list_ptr, PluginManager *plugin_manager_ptr) {
-  models_ = model_list_ptr;
-  plugin_manager_ = plugin_manager_ptr;
+namespace {
+
+typedef boost::function<void(
+    const visualization_msgs::InteractiveMarkerFeedbackConstPtr &)>
+    FeedbackCallback;
+
+/**
+ * @brief Pass the feedback of a callback through the CommandQueue, so
+ * dragging or deleting a model never runs while the world is stepped
+ * @param[in] callback The callback
+ * @return The callback posting the feedback
+ */
+FeedbackCallback Queued(const FeedbackCallback &callback) {
+  return [callback](
+      const visualization_msgs::InteractiveMarkerFeedbackConstPtr &feedback) {
+    CommandQueue::Get().Post([callback, feedback]() { callback(feedback); });
+  };
+}
+
+const double kPositionEpsilon = 1e-3;  ///< moves ignored below, meters
+const double kAngleEpsilon = 1e-3;     ///< turns ignored below, radians
+
+/**
+ * @brief If a model moved from the pose its marker was last sent at
+ */
+bool Moved(const Pose &a, const Pose &b) {
+  return fabs(a.x - b.x) > kPositionEpsilon ||
+         fabs(a.y - b.y) > kPositionEpsilon ||
+         fabs(remainder(a.theta - b.theta, 2 * M_PI)) > kAngleEpsilon;
+}
+};  // namespace
+
+InteractiveMarkerManager::InteractiveMarkerManager(World *world,
+                                                   const std::string &ns) {
+  world_ = world;
+  models_ = &world->models_;
   manipulating_model_ = false;
+  setUpdateRate(30);
 
-  // Initialize interactive marker server
+  // Initialize interactive marker server, its markers are created once its
+  // update topic has subscribers
+  std::string topic_ns = ns.empty() ? "interactive_model_markers"
+                                    : ns + "/interactive_model_markers";
   interactive_marker_server_.reset(
-      new interactive_markers::InteractiveMarkerServer(
-          "interactive_model_markers"));
+      new interactive_markers::InteractiveMarkerServer(topic_ns));
+  update_topic_ = ros::NodeHandle(topic_ns).resolveName("update");
+  active_ = false;
 
   // Add "Delete Model" context menu option to menu handler and bind callback
   menu_handler_.setCheckState(
       menu_handler_.insert(
           "Delete Model",
-          boost::bind(&InteractiveMarkerManager::deleteModelMenuCallback, this,
-                      _1)),
+          Queued(boost::bind(
+              &InteractiveMarkerManager::deleteModelMenuCallback, this, _1))),
       interactive_markers::MenuHandler::NO_CHECKBOX);
   interactive_marker_server_->applyChanges();
 }
 
-void InteractiveMarkerManager::createInteractiveMarker(
-    const std::string &model_name, const Pose &pose,
-    const visualization_msgs::MarkerArray &body_markers) {
+void InteractiveMarkerManager::createInteractiveMarker(Model *model) {
+  // without subscribers, nobody would see the marker, it is created once one
+  // subscribes
+  if (!active_) {
+    return;
+  }
+  insertInteractiveMarker(model);
+  interactive_marker_server_->applyChanges();
+}
+
+void InteractiveMarkerManager::getBodyMarkers(
+    Model *model, std::vector<visualization_msgs::Marker> &markers) {
+  // the models of a file have the same bodies, unless their geometry was
+  // changed after loading
+  std::string key =
+      model->yaml_path_ + ":" + std::to_string(model->yaml_mtime_);
+  bool shared = model->geometry_changes_ == 0 && !model->yaml_path_.empty();
+  if (shared) {
+    auto it = body_markers_.find(key);
+    if (it != body_markers_.end()) {
+      markers = it->second;
+      return;
+    }
+  }
+
+  visualization_msgs::MarkerArray body_markers;
+  for (size_t i = 0; i < model->bodies_.size(); i++) {
+    DebugVisualization::Get().BodyToMarkers(
+        body_markers, model->bodies_[i]->physics_body_, 1.0, 0.0, 0.0, 1.0);
+  }
+
+  // Transform original body frame markers from global to the frame of the
+  // root body
+  const b2Transform &root = model->bodies_[0]->physics_body_->GetTransform();
+  markers.clear();
+  for (size_t i = 0; i < body_markers.markers.size(); i++) {
+    visualization_msgs::Marker transformed_body_marker =
+        body_markers.markers[i];
+    b2Vec2 position = b2MulT(
+        root, b2Vec2(body_markers.markers[i].pose.position.x,
+                     body_markers.markers[i].pose.position.y));
+    transformed_body_marker.header.frame_id = "";
+    transformed_body_marker.header.stamp = ros::Time(0);
+    transformed_body_marker.pose.position.x = position.x;
+    transformed_body_marker.pose.position.y = position.y;
+    transformed_body_marker.pose.orientation.w = 1.0;
+    transformed_body_marker.pose.orientation.x = 0.0;
+    transformed_body_marker.pose.orientation.y = 0.0;
+    transformed_body_marker.pose.orientation.z = 0.0;
+
+    // Make line strips thicker than the original
+    if (transformed_body_marker.type ==
+            visualization_msgs::Marker::LINE_STRIP ||
+        transformed_body_marker.type == visualization_msgs::Marker::LINE_LIST) {
+      transformed_body_marker.scale.x = 0.1;
+    }
+    markers.push_back(transformed_body_marker);
+  }
+  if (shared) {
+    body_markers_[key] = markers;
+  }
+}
+
+void InteractiveMarkerManager::insertInteractiveMarker(Model *model) {
+  const std::string &model_name = model->GetName();
+  const b2Body *root = model->bodies_[0]->physics_body_;
+  Pose pose(root->GetPosition().x, root->GetPosition().y, root->GetAngle());
+
   // Set up interactive marker control objects to allow both translation and
   // rotation movement
   visualization_msgs::InteractiveMarkerControl plane_control;
@@ -76,35 +182,10 @@ void InteractiveMarkerManager::createInteractiveMarker(
 
   // Also add body markers to the no_control object to visualize model pose
   // while moving its interactive marker
-  for (size_t i = 0; i < body_markers.markers.size(); i++) {
-    visualization_msgs::Marker transformed_body_marker =
-        body_markers.markers[i];
-
-    // Transform original body frame marker from global to local frame
-    RotateTranslate rt = Geometry::CreateTransform(pose.x, pose.y, pose.theta);
-    transformed_body_marker.header.frame_id = "";
-    transformed_body_marker.header.stamp = ros::Time(0);
-    transformed_body_marker.pose.position.x =
-        (body_markers.markers[i].pose.position.x - rt.dx) * rt.cos +
-        (body_markers.markers[i].pose.position.y - rt.dy) * rt.sin;
-    transformed_body_marker.pose.position.y =
-        -(body_markers.markers[i].pose.position.x - rt.dx) * rt.sin +
-        (body_markers.markers[i].pose.position.y - rt.dy) * rt.cos;
-    transformed_body_marker.pose.orientation.w = 1.0;
-    transformed_body_marker.pose.orientation.x = 0.0;
-    transformed_body_marker.pose.orientation.y = 0.0;
-    transformed_body_marker.pose.orientation.z = 0.0;
-
-    // Make line strips thicker than the original
-    if (transformed_body_marker.type ==
-            visualization_msgs::Marker::LINE_STRIP ||
-        transformed_body_marker.type == visualization_msgs::Marker::LINE_LIST) {
-      transformed_body_marker.scale.x = 0.1;
-    }
-
-    // Add transformed body marker to interactive marker control object
-    no_control.markers.push_back(transformed_body_marker);
-  }
+  std::vector<visualization_msgs::Marker> body_markers;
+  getBodyMarkers(model, body_markers);
+  no_control.markers.insert(no_control.markers.end(), body_markers.begin(),
+                            body_markers.end());
 
   // Send new interactive marker to server
   visualization_msgs::InteractiveMarker new_interactive_marker;
@@ -119,44 +200,35 @@ void InteractiveMarkerManager::createInteractiveMarker(
   new_interactive_marker.controls.push_back(rotate_control);
   new_interactive_marker.controls.push_back(no_control);
   interactive_marker_server_->insert(new_interactive_marker);
+  marker_poses_[model_name] = pose;
 
   // Bind feedback callbacks for the new interactive marker
   interactive_marker_server_->setCallback(
       model_name,
-      boost::bind(&InteractiveMarkerManager::processMouseUpFeedback, this, _1),
+      Queued(boost::bind(&InteractiveMarkerManager::processMouseUpFeedback,
+                         this, _1)),
       visualization_msgs::InteractiveMarkerFeedback::MOUSE_UP);
   interactive_marker_server_->setCallback(
       model_name,
-      boost::bind(&InteractiveMarkerManager::processMouseDownFeedback, this,
-                  _1),
+      Queued(boost::bind(&InteractiveMarkerManager::processMouseDownFeedback,
+                         this, _1)),
       visualization_msgs::InteractiveMarkerFeedback::MOUSE_DOWN);
   interactive_marker_server_->setCallback(
       model_name,
-      boost::bind(&InteractiveMarkerManager::processPoseUpdateFeedback, this,
-                  _1),
+      Queued(boost::bind(&InteractiveMarkerManager::processPoseUpdateFeedback,
+                         this, _1)),
       visualization_msgs::InteractiveMarkerFeedback::POSE_UPDATE);
 
   // Add context menu to the new interactive marker
   menu_handler_.apply(*interactive_marker_server_, model_name);
-
-  // Apply changes to server
-  interactive_marker_server_->applyChanges();
 }
 
 void InteractiveMarkerManager::deleteModelMenuCallback(
     const visualization_msgs::InteractiveMarkerFeedbackConstPtr &feedback) {
-  // Delete the model just as when the DeleteModel service is called
-  for (unsigned int i = 0; i < (*models_).size(); i++) {
-    if ((*models_)[i]->GetName() == feedback->marker_name) {
-      // delete the plugins associated with the model
-      plugin_manager_->DeleteModelPlugin((*models_)[i]);
-      delete (*models_)[i];
-      (*models_).erase((*models_).begin() + i);
-
-      // Also remove corresponding interactive marker
-      deleteInteractiveMarker(feedback->marker_name);
-      break;
-    }
+  // Delete the model just as when the DeleteModel service is called, which
+  // also removes the corresponding interactive marker
+  if (world_->GetModel(feedback->marker_name) != nullptr) {
+    world_->DeleteModel(feedback->marker_name);
   }
 
   // Update menu handler and server
@@ -168,27 +240,28 @@ void InteractiveMarkerManager::deleteInteractiveMarker(
     const std::string &model_name) {
   // Remove target interactive marker by name and
   // update the server
+  if (!active_) {
+    return;
+  }
   interactive_marker_server_->erase(model_name);
   interactive_marker_server_->applyChanges();
+  marker_poses_.erase(model_name);
 }
 
 void InteractiveMarkerManager::processMouseUpFeedback(
     const visualization_msgs::InteractiveMarkerFeedbackConstPtr &feedback) {
   // Update model that was manipulated the same way
   // as when the MoveModel service is called
-  for (unsigned int i = 0; i < models_->size(); i++) {
-    if ((*models_)[i]->GetName() == feedback->marker_name) {
-      Pose new_pose;
-      new_pose.x = feedback->pose.position.x;
-      new_pose.y = feedback->pose.position.y;
-      new_pose.theta = atan2(
-          2.0 * feedback->pose.orientation.w * feedback->pose.orientation.z,
-          1.0 -
-              2.0 * feedback->pose.orientation.z *
-                  feedback->pose.orientation.z);
-      (*models_)[i]->SetPose(new_pose);
-      break;
-    }
+  Model *model = world_->GetModel(feedback->marker_name);
+  if (model != nullptr) {
+    Pose new_pose;
+    new_pose.x = feedback->pose.position.x;
+    new_pose.y = feedback->pose.position.y;
+    new_pose.theta = atan2(
+        2.0 * feedback->pose.orientation.w * feedback->pose.orientation.z,
+        1.0 -
+            2.0 * feedback->pose.orientation.z * feedback->pose.orientation.z);
+    model->SetPose(new_pose);
   }
   manipulating_model_ = false;
   interactive_marker_server_->applyChanges();
@@ -204,22 +277,41 @@ void InteractiveMarkerManager::processPoseUpdateFeedback(
   pose_update_stamp_ = ros::WallTime::now();
 }
 
+void InteractiveMarkerManager::setUpdateRate(double rate) {
+  update_period_ = rate > 0 ? 1.0 / rate : 0;
+}
+
 void InteractiveMarkerManager::update() {
   // Loop through each model, extract the pose of the root body,
-  // and use it to update the interactive marker pose. Only
-  // necessary to compute if user is not currently dragging
-  // an interactive marker
-  if (!manipulating_model_) {
-    for (size_t i = 0; i < (*models_).size(); i++) {
+  // and use it to update the interactive marker pose of the models that
+  // moved. Only necessary to compute if user is not currently dragging
+  // an interactive marker, and at most at the update rate, since each
+  // applyChanges publishes an update
+  ros::WallTime now = ros::WallTime::now();
+  if (!manipulating_model_ && (now - last_update_).toSec() >= update_period_) {
+    last_update_ = now;
+    updateSubscribers();
+    const BodyStates &body_states = world_->plugin_manager_.body_states_;
+    bool changed = false;
+    for (size_t i = 0; active_ && i < (*models_).size(); i++) {
+      Model *model = (*models_)[i];
+      Pose pose = body_states.GetPose(model->bodies_[0]);
+      auto it = marker_poses_.find(model->GetName());
+      if (it != marker_poses_.end() && !Moved(pose, it->second)) {
+        continue;
+      }
+      marker_poses_[model->GetName()] = pose;
+
       geometry_msgs::Pose new_pose;
-      new_pose.position.x =
-          (*models_)[i]->bodies_[0]->physics_body_->GetPosition().x;
-      new_pose.position.y =
-          (*models_)[i]->bodies_[0]->physics_body_->GetPosition().y;
-      double theta = (*models_)[i]->bodies_[0]->physics_body_->GetAngle();
+      new_pose.position.x = pose.x;
+      new_pose.position.y = pose.y;
+      double theta = pose.theta;
       new_pose.orientation.w = cos(0.5 * theta);
       new_pose.orientation.z = sin(0.5 * theta);
-      interactive_marker_server_->setPose((*models_)[i]->GetName(), new_pose);
+      interactive_marker_server_->setPose(model->GetName(), new_pose);
+      changed = true;
+    }
+    if (changed) {
       interactive_marker_server_->applyChanges();
     }
   }
@@ -239,9 +331,31 @@ void InteractiveMarkerManager::update() {
   }
   if (manipulating_model_ && dt > 0.1 && dt < 1.0) {
     manipulating_model_ = false;
+
+    // the dragged marker was left where the user dropped it, send all poses
+    // again
+    marker_poses_.clear();
   }
 }
 
+void InteractiveMarkerManager::updateSubscribers() {
+  bool subscribed =
+      ros::TopicManager::instance()->getNumSubscribers(update_topic_) > 0;
+  if (subscribed == active_) {
+    return;
+  }
+  active_ = subscribed;
+  marker_poses_.clear();
+  if (active_) {
+    for (Model *model : *models_) {
+      insertInteractiveMarker(model);
+    }
+  } else {
+    interactive_marker_server_->clear();
+  }
+  interactive_marker_server_->applyChanges();
+}
+
 InteractiveMarkerManager::~InteractiveMarkerManager() {
   interactive_marker_server_.reset();
 }
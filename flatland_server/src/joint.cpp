@@ -67,6 +67,16 @@ const Color &Joint::GetColor() const { return color_; }
 
 void Joint::SetColor(const Color &color) { color_ = color; }
 
+JointState Joint::GetState() const {
+  JointState state;
+  state.anchor_a = physics_joint_->GetAnchorA();
+  state.anchor_b = physics_joint_->GetAnchorB();
+  state.position_a = physics_joint_->GetBodyA()->GetPosition();
+  state.position_b = physics_joint_->GetBodyB()->GetPosition();
+  state.color = color_;
+  return state;
+}
+
 b2Joint *Joint::GetPhysicsJoint() { return physics_joint_; }
 
 b2World *Joint::GetphysicsWorld() { return physics_world_; }
@@ -0,0 +1,161 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 kinematic_animator.cpp
+ * @brief	 Moves the animated bodies of a world in one pass
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/body.h>
+#include <flatland_server/kinematic_animator.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+int KinematicAnimator::Add(Body *body, const Pose &start, const Pose &delta,
+                           double duration, Mode mode, Easing easing,
+                           bool use_table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Track track;
+  track.body = body;
+  track.start = start;
+  track.delta = delta;
+  track.duration = duration;
+  track.mode = mode;
+  track.easing = easing;
+  if (use_table) {
+    // one table per easing, shared by all tracks using it
+    std::vector<double> &table = tables_[easing];
+    if (table.empty()) {
+      table.resize(TABLE_SIZE + 1);
+      for (int i = 0; i <= TABLE_SIZE; i++) {
+        table[i] = easing(double(i) / TABLE_SIZE);
+      }
+    }
+    track.table = &table;
+  }
+
+  int id;
+  if (!free_.empty()) {
+    id = free_.back();
+    free_.pop_back();
+    tracks_[id] = track;
+  } else {
+    id = tracks_.size();
+    tracks_.push_back(track);
+  }
+  size_++;
+  return id;
+}
+
+void KinematicAnimator::Remove(int id) {
+  if (id < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  tracks_[id].body = nullptr;
+  free_.push_back(id);
+  size_--;
+}
+
+void KinematicAnimator::SetTriggered(int id, bool triggered) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tracks_[id].triggered = triggered;
+}
+
+void KinematicAnimator::Step(double dt) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  moved_ = 0;
+  for (Track &t : tracks_) {
+    if (!t.body) continue;
+
+    double position =
+        std::min(std::max(t.position + t.direction * dt, 0.0), t.duration);
+    // a track resting at an end has nothing to do
+    if (position != t.position || !t.placed) {
+      t.position = position;
+      double progress = position / t.duration;
+      double eased;
+      if (t.table) {
+        double f = progress * TABLE_SIZE;
+        int i = std::min(int(f), TABLE_SIZE - 1);
+        const std::vector<double> &table = *t.table;
+        eased = table[i] + (table[i + 1] - table[i]) * (f - i);
+      } else {
+        eased = t.easing(progress);
+      }
+
+      b2Body *b = t.body->physics_body_;
+      b->SetTransform(b2Vec2(t.start.x + t.delta.x * eased,
+                             t.start.y + t.delta.y * eased),
+                      t.start.theta + t.delta.theta * eased);
+      // Tell Box2D to update the AABB and check for collisions for this
+      // object
+      b->SetAwake(true);
+      t.placed = true;
+      moved_++;
+    }
+
+    switch (t.mode) {
+      case Mode::YOYO:
+        if (t.position >= t.duration) {
+          t.direction = -1;
+        } else if (t.position <= 0.001 * t.duration) {
+          t.direction = 1;
+        }
+        break;
+      case Mode::LOOP:
+        // teleported back by the next step
+        if (t.position >= t.duration) {
+          t.position = 0;
+          t.placed = false;
+        }
+        break;
+      case Mode::TRIGGER:
+        t.direction = t.triggered ? 1 : -1;
+        break;
+      case Mode::ONCE:
+        break;
+    }
+  }
+}
+};  // namespace flatland_server
@@ -48,66 +48,533 @@
 #include <flatland_server/debug_visualization.h>
 #include <flatland_server/exceptions.h>
 #include <flatland_server/geometry.h>
+#include <flatland_server/image_cache.h>
 #include <flatland_server/layer.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/tracer.h>
+#include <flatland_server/vector_map.h>
+#include <flatland_server/world_bundle.h>
 #include <flatland_server/yaml_reader.h>
 #include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
-#if CV_MAJOR_VERSION < 3
-#define GREYSCALE CV_LOAD_IMAGE_GRAYSCALE
-#else
-#include <opencv2/imgcodecs.hpp>
-#define GREYSCALE cv::ImreadModes::IMREAD_GRAYSCALE
-#endif
 #include <sstream>
+#include <unordered_map>
 
 namespace flatland_server {
 
 Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
              const std::vector<std::string> &names, const Color &color,
              const Pose &origin, const cv::Mat &bitmap, double occupied_thresh,
-             double resolution, const YAML::Node &properties)
+             double resolution, bool contours, double simplify_tolerance,
+             const YAML::Node &properties, const LayerTiles::Params &tiling)
     : Entity(physics_world, names[0]),
       names_(names),
       cfr_(cfr),
       viz_name_("layer/" + names[0]) {
   body_ = new Body(physics_world_, this, name_, color, origin, b2_staticBody,
                    properties);
+  InitTiles(tiling);
 
-  LoadFromBitmap(bitmap, occupied_thresh, resolution);
+  LoadFromBitmap(bitmap, occupied_thresh, resolution, contours,
+                 simplify_tolerance);
+}
+
+Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+             const std::vector<std::string> &names, const Color &color,
+             const Pose &origin, const LayerCache &cache, bool contours,
+             double simplify_tolerance, const YAML::Node &properties,
+             const LayerTiles::Params &tiling)
+    : Entity(physics_world, names[0]),
+      names_(names),
+      cfr_(cfr),
+      viz_name_("layer/" + names[0]) {
+  body_ = new Body(physics_world_, this, name_, color, origin, b2_staticBody,
+                   properties);
+  InitTiles(tiling);
+
+  grid_.reset(cache.MakeGrid());
+  LoadFromRuns(cache.GetRuns(), cache.GetRunCount(), cache.GetRows(),
+               grid_->GetResolution(), contours, simplify_tolerance);
+}
+
+Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+             const std::vector<std::string> &names, const Color &color,
+             const Pose &origin, const std::vector<LayerCache::Run> &runs,
+             OccupancyGrid *grid, bool contours, double simplify_tolerance,
+             const YAML::Node &properties, const LayerTiles::Params &tiling)
+    : Entity(physics_world, names[0]),
+      names_(names),
+      cfr_(cfr),
+      viz_name_("layer/" + names[0]) {
+  grid_.reset(grid);
+  body_ = new Body(physics_world_, this, name_, color, origin, b2_staticBody,
+                   properties);
+  InitTiles(tiling);
+
+  LoadFromRuns(runs.data(), runs.size(), grid_->GetHeight(),
+               grid_->GetResolution(), contours, simplify_tolerance);
 }
 
 Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
              const std::vector<std::string> &names, const Color &color,
              const Pose &origin, const std::vector<LineSegment> &line_segments,
-             double scale, const YAML::Node &properties)
+             double scale, const YAML::Node &properties,
+             const LayerTiles::Params &tiling)
     : Entity(physics_world, names[0]),
       names_(names),
       cfr_(cfr),
       viz_name_("layer/" + names[0]) {
   body_ = new Body(physics_world_, this, name_, color, origin, b2_staticBody,
                    properties);
+  InitTiles(tiling);
 
-  uint16_t category_bits = cfr_->GetCategoryBits(names_);
+  FLATLAND_TRACE("load", "layer_fixtures");
+  uint32_t category_bits = cfr_->GetCategoryBits(names_);
+  std::vector<LineSegment> scaled_segments;
+  scaled_segments.reserve(line_segments.size());
 
+  // the edges are inserted into the broad-phase tree in one pass
+  BulkFixtures bulk(physics_world_);
   for (const auto &line_segment : line_segments) {
-    b2EdgeShape edge;
-    edge.Set(line_segment.start.Box2D(), line_segment.end.Box2D());
-    edge.m_vertex1 *= scale;
-    edge.m_vertex2 *= scale;
+    AddLineSegment(line_segment.start.Box2D(), line_segment.end.Box2D(), scale,
+                   category_bits, &scaled_segments);
+  }
 
-    b2FixtureDef fixture_def;
-    fixture_def.shape = &edge;
-    fixture_def.filter.categoryBits = category_bits;
-    fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
-    // todo: add material information
+  segments_ = std::make_shared<SegmentRaycaster>(scaled_segments);
+}
+
+Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+             const std::vector<std::string> &names, const Color &color,
+             const Pose &origin, const LineSegmentsFile &line_segments,
+             double scale, const YAML::Node &properties,
+             const LayerTiles::Params &tiling)
+    : Entity(physics_world, names[0]),
+      names_(names),
+      cfr_(cfr),
+      viz_name_("layer/" + names[0]) {
+  body_ = new Body(physics_world_, this, name_, color, origin, b2_staticBody,
+                   properties);
+  InitTiles(tiling);
+
+  FLATLAND_TRACE("load", "layer_fixtures");
+  uint32_t category_bits = cfr_->GetCategoryBits(names_);
+  std::vector<LineSegment> scaled_segments;
+  scaled_segments.reserve(line_segments.GetCount());
+
+  // the edges are inserted into the broad-phase tree in one pass
+  BulkFixtures bulk(physics_world_);
+  const LineSegmentsFile::Record *records = line_segments.GetRecords();
+  for (size_t i = 0; i < line_segments.GetCount(); i++) {
+    AddLineSegment(b2Vec2(records[i].x1, records[i].y1),
+                   b2Vec2(records[i].x2, records[i].y2), scale, category_bits,
+                   &scaled_segments);
+  }
+
+  segments_ = std::make_shared<SegmentRaycaster>(scaled_segments);
+}
+
+void Layer::AddLineSegment(const b2Vec2 &start, const b2Vec2 &end,
+                           double scale, uint32_t category_bits,
+                           std::vector<LineSegment> *scaled_segments) {
+  b2EdgeShape edge;
+  edge.Set(start, end);
+  edge.m_vertex1 *= scale;
+  edge.m_vertex2 *= scale;
+
+  b2FixtureDef fixture_def;
+  fixture_def.shape = &edge;
+  fixture_def.filter.categoryBits = category_bits;
+  fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+  // todo: add material information
+  if (tiles_) {
+    tiles_->AddSegment(edge.m_vertex1, edge.m_vertex2);
+  } else {
     body_->physics_body_->CreateFixture(&fixture_def);
   }
+
+  scaled_segments->push_back(
+      LineSegment(Vec2(edge.m_vertex1.x, edge.m_vertex1.y),
+                  Vec2(edge.m_vertex2.x, edge.m_vertex2.y)));
+}
+
+std::vector<b2Fixture *> Layer::AddSegments(
+    const std::vector<b2EdgeShape> &segments) {
+  if (tiles_) {
+    throw Exception("Layer " + Q(name_) + " is tiled and cannot be modified");
+  }
+
+  b2FixtureDef fixture_def;
+  fixture_def.filter.categoryBits = cfr_->GetCategoryBits(names_);
+  fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+
+  std::vector<b2Fixture *> fixtures;
+  fixtures.reserve(segments.size());
+  for (const auto &segment : segments) {
+    fixture_def.shape = &segment;
+    fixtures.push_back(body_->physics_body_->CreateFixture(&fixture_def));
+  }
+
+  if (!segments.empty()) {
+    GeometryChanged();
+  }
+  return fixtures;
+}
+
+void Layer::RemoveSegments(const std::vector<b2Fixture *> &fixtures) {
+  for (b2Fixture *fixture : fixtures) {
+    if (fixture->GetBody() != body_->physics_body_) {
+      throw Exception("Fixture does not belong to layer " + Q(name_));
+    }
+    body_->physics_body_->DestroyFixture(fixture);
+  }
+
+  if (!fixtures.empty()) {
+    GeometryChanged();
+  }
+}
+
+namespace {
+/// incremented by each Layer::GeometryChanged
+std::atomic<uint64_t> geometry_generation(0);
+
+/// rows of an image decoded at once by Layer::StreamRuns
+const int STREAM_BAND_ROWS = 256;
+
+/**
+ * @brief The first 8 bit value whose float conversion reaches the occupied
+ * threshold, thresholding 8 bit images at it gives the same map as
+ * converting them to float first
+ * @return 256 if no value reaches the threshold
+ */
+int ThresholdValue(double occupied_thresh) {
+  float thresh = float(occupied_thresh);
+  int lower = 0;
+  while (lower < 256 && float(lower * (1.0 / 255.0)) < thresh) {
+    lower++;
+  }
+  return lower;
+}
+
+/**
+ * @brief Key of a shape matching the geometry of two layers, equal for
+ * shapes of the same type with the same vertices
+ */
+std::string ShapeKey(const b2Shape *shape) {
+  std::string key(1, char(shape->GetType()));
+  auto append = [&](const b2Vec2 *vertices, int32 count) {
+    key.append(reinterpret_cast<const char *>(vertices),
+               count * sizeof(b2Vec2));
+  };
+  switch (shape->GetType()) {
+    case b2Shape::e_edge: {
+      const b2EdgeShape *edge = static_cast<const b2EdgeShape *>(shape);
+      append(&edge->m_vertex1, 1);
+      append(&edge->m_vertex2, 1);
+      break;
+    }
+    case b2Shape::e_chain: {
+      const b2ChainShape *chain = static_cast<const b2ChainShape *>(shape);
+      append(chain->m_vertices, chain->m_count);
+      break;
+    }
+    case b2Shape::e_polygon: {
+      const b2PolygonShape *polygon =
+          static_cast<const b2PolygonShape *>(shape);
+      append(polygon->m_vertices, polygon->m_count);
+      break;
+    }
+    case b2Shape::e_circle: {
+      const b2CircleShape *circle = static_cast<const b2CircleShape *>(shape);
+      append(&circle->m_p, 1);
+      key.append(reinterpret_cast<const char *>(&circle->m_radius),
+                 sizeof(circle->m_radius));
+      break;
+    }
+    default:
+      break;
+  }
+  return key;
+}
+}
+
+void Layer::UpdateGeometry(const Layer &source, size_t *removed,
+                           size_t *added) {
+  if (tiles_ || source.tiles_) {
+    throw Exception("Layer " + Q(name_) + " is tiled and cannot be updated");
+  }
+  if (!body_ || !source.body_) {
+    throw Exception("Layer " + Q(name_) + " has no geometry to update");
+  }
+
+  b2Body *body = body_->physics_body_;
+  const b2Body *source_body = source.body_->physics_body_;
+  if (!(body->GetTransform().p == source_body->GetTransform().p) ||
+      body->GetAngle() != source_body->GetAngle()) {
+    body->SetTransform(source_body->GetPosition(), source_body->GetAngle());
+  }
+
+  // the fixtures with a matching shape in the source are kept, the ones
+  // left in current afterwards are gone from the map
+  std::unordered_multimap<std::string, b2Fixture *> current;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    current.emplace(ShapeKey(f->GetShape()), f);
+  }
+  std::vector<const b2Fixture *> new_fixtures;
+  for (const b2Fixture *f = source_body->GetFixtureList(); f;
+       f = f->GetNext()) {
+    auto it = current.find(ShapeKey(f->GetShape()));
+    if (it != current.end()) {
+      current.erase(it);
+    } else {
+      new_fixtures.push_back(f);
+    }
+  }
+
+  // few fixtures change between versions of a map, the static broad-phase
+  // tree is only rebuilt when many do
+  for (const auto &entry : current) {
+    body->DestroyFixture(entry.second);
+  }
+  for (const b2Fixture *f : new_fixtures) {
+    b2FixtureDef fixture_def;
+    fixture_def.shape = f->GetShape();
+    fixture_def.friction = f->GetFriction();
+    fixture_def.restitution = f->GetRestitution();
+    fixture_def.density = f->GetDensity();
+    fixture_def.isSensor = f->IsSensor();
+    fixture_def.filter = f->GetFilterData();
+    body->CreateFixture(&fixture_def);
+  }
+
+  grid_ = source.grid_;
+  segments_ = source.segments_;
+  fine_sensing_ = source.fine_sensing_;
+  publish_grid_ = source.publish_grid_;
+  publish_distance_field_ = source.publish_distance_field_;
+  GeometryChanged();
+
+  if (removed != nullptr) *removed = current.size();
+  if (added != nullptr) *added = new_fixtures.size();
+}
+
+void Layer::GeometryChanged() {
+  viz_dirty_ = true;
+  geometry_changes_++;
+  geometry_generation++;
+}
+
+uint64_t Layer::GetGeometryGeneration() { return geometry_generation; }
+
+void Layer::SubscribeGrid(const std::string &ns) {
+  if (!stream_) {
+    return;
+  }
+  ros::NodeHandle nh(ns);
+  grid_sub_.Subscribe(nh, stream_->topic, 1, &Layer::GridCallback, this);
+}
+
+void Layer::GridCallback(const nav_msgs::OccupancyGrid &msg) {
+  try {
+    size_t removed, added;
+    UpdateFromGrid(msg, &removed, &added);
+    ROS_DEBUG_NAMED("Layer", "Layer %s updated from grid, %zu fixtures "
+                    "removed, %zu added", Q(name_).c_str(), removed, added);
+  } catch (const Exception &e) {
+    ROS_ERROR_NAMED("Layer", "%s", e.what());
+  }
+}
+
+void Layer::UpdateFromGrid(const nav_msgs::OccupancyGrid &msg,
+                           size_t *removed, size_t *added) {
+  if (!stream_) {
+    throw Exception("Layer " + Q(name_) +
+                    " is not streamed from an occupancy grid topic");
+  }
+  unsigned int width = msg.info.width, height = msg.info.height;
+  if (msg.data.size() != size_t(width) * height) {
+    throw Exception("Occupancy grid of layer " + Q(name_) + " has " +
+                    std::to_string(msg.data.size()) + " cells instead of " +
+                    std::to_string(size_t(width) * height));
+  }
+  if (width == 0 || height == 0 || !(msg.info.resolution > 0)) {
+    throw Exception("Occupancy grid of layer " + Q(name_) + " is empty");
+  }
+
+  // thresholded like a map image, the rows are flipped since the grid
+  // origin is at the bottom left
+  cv::Mat obstacle_map(height, width, CV_8UC1);
+  int8_t thresh = int8_t(std::min(100.0, 100 * stream_->occupied_thresh));
+  for (unsigned int y = 0; y < height; y++) {
+    const int8_t *cells = &msg.data[size_t(y) * width];
+    uint8_t *row = obstacle_map.ptr<uint8_t>(height - 1 - y);
+    for (unsigned int x = 0; x < width; x++) {
+      row[x] = cells[x] > thresh ? 0 : 255;
+    }
+  }
+
+  GridStream &stream = *stream_;
+  b2Body *body = body_->physics_body_;
+  size_t destroyed = 0, created = 0;
+  const geometry_msgs::Pose &origin = msg.info.origin;
+  const geometry_msgs::Pose &prev_origin = stream.info.origin;
+  bool rebuild = stream.obstacle_map.empty() ||
+                 stream.info.width != width || stream.info.height != height ||
+                 stream.info.resolution != msg.info.resolution ||
+                 prev_origin.position.x != origin.position.x ||
+                 prev_origin.position.y != origin.position.y ||
+                 prev_origin.orientation.z != origin.orientation.z ||
+                 prev_origin.orientation.w != origin.orientation.w;
+
+  // the bounding box of the cells that changed, in the obstacle map. A new
+  // grid is inserted into the broad-phase tree in one pass
+  int r0 = 0, r1 = height - 1, c0 = 0, c1 = width - 1;
+  std::unique_ptr<BulkFixtures> bulk;
+  if (rebuild) {
+    bulk.reset(new BulkFixtures(physics_world_));
+    for (auto *lines : {&stream.rows, &stream.cols}) {
+      for (const auto &line : *lines) {
+        for (const auto &edge : line) {
+          body->DestroyFixture(edge.second);
+          destroyed++;
+        }
+      }
+    }
+    stream.rows.assign(height + 1, {});
+    stream.cols.assign(width + 1, {});
+    double yaw = 2 * std::atan2(origin.orientation.z, origin.orientation.w);
+    body->SetTransform(b2Vec2(origin.position.x, origin.position.y), yaw);
+  } else {
+    r0 = height;
+    r1 = -1;
+    c0 = width;
+    c1 = -1;
+    for (unsigned int i = 0; i < height; i++) {
+      const uint8_t *row = obstacle_map.ptr<uint8_t>(i);
+      const uint8_t *prev_row = stream.obstacle_map.ptr<uint8_t>(i);
+      if (std::equal(row, row + width, prev_row)) {
+        continue;
+      }
+      r0 = std::min(r0, int(i));
+      r1 = int(i);
+      for (unsigned int j = 0; j < width; j++) {
+        if (row[j] != prev_row[j]) {
+          c0 = std::min(c0, int(j));
+          c1 = std::max(c1, int(j));
+        }
+      }
+    }
+  }
+
+  if (r1 >= r0) {
+    // the horizontal edges around the changed cells lie on the boundaries
+    // r0 to r1 + 1 across the whole width, and the vertical ones on the
+    // boundaries c0 to c1 + 1 across the whole height. Only the columns
+    // next to these are transposed
+    std::vector<LayerCache::Run> row_runs, col_runs;
+    int band0 = std::max(c0 - 1, 0), band1 = std::min(c1 + 1, int(width) - 1);
+    cv::Mat band;
+    cv::transpose(obstacle_map.colRange(band0, band1 + 1), band);
+    ExtractRowRuns(obstacle_map, false, 0, r0, r1 + 2, &row_runs);
+    ExtractRowRuns(band, true, band0, c0, c1 + 2, &col_runs);
+
+    uint32_t category_bits = cfr_->GetCategoryBits(names_);
+    double res = msg.info.resolution;
+    auto create = [&](const LayerCache::Run &r) {
+      b2EdgeShape edge;
+      edge.Set(b2Vec2(res * r.x1, res * (double(height) - r.y1)),
+               b2Vec2(res * r.x2, res * (double(height) - r.y2)));
+      b2FixtureDef fixture_def;
+      fixture_def.shape = &edge;
+      fixture_def.filter.categoryBits = category_bits;
+      fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+      created++;
+      return body->CreateFixture(&fixture_def);
+    };
+
+    // the edges of a boundary do not overlap and are sorted on both sides,
+    // the ones found on both sides keep their fixtures
+    auto sync = [&](std::vector<std::pair<LayerCache::Run, b2Fixture *>> &line,
+                    const LayerCache::Run *runs, const LayerCache::Run *last,
+                    bool vertical) {
+      auto start = [&](const LayerCache::Run &r) {
+        return vertical ? r.y1 : r.x1;
+      };
+      auto same = [](const LayerCache::Run &a, const LayerCache::Run &b) {
+        return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+      };
+      std::vector<std::pair<LayerCache::Run, b2Fixture *>> updated;
+      updated.reserve(last - runs);
+      auto old = line.begin();
+      while (old != line.end() || runs != last) {
+        if (old != line.end() && runs != last && same(old->first, *runs)) {
+          updated.push_back(*old++);
+          runs++;
+        } else if (runs == last ||
+                   (old != line.end() && start(old->first) <= start(*runs))) {
+          body->DestroyFixture(old->second);
+          destroyed++;
+          old++;
+        } else {
+          updated.emplace_back(*runs, create(*runs));
+          runs++;
+        }
+      }
+      line.swap(updated);
+    };
+
+    auto sync_lines = [&](
+        std::vector<std::vector<std::pair<LayerCache::Run, b2Fixture *>>>
+            &lines,
+        const std::vector<LayerCache::Run> &runs, int begin, int end,
+        bool vertical) {
+      const LayerCache::Run *run = runs.data(), *last = run + runs.size();
+      for (int i = begin; i < end; i++) {
+        const LayerCache::Run *first = run;
+        while (run != last && (vertical ? run->x1 : run->y1) == i) {
+          run++;
+        }
+        sync(lines[i], first, run, vertical);
+      }
+    };
+
+    sync_lines(stream.rows, row_runs, r0, r1 + 2, false);
+    sync_lines(stream.cols, col_runs, c0, c1 + 2, true);
+
+    // the grid may be held by the plugins, the changed cells are written to
+    // a copy
+    std::shared_ptr<OccupancyGrid> grid =
+        std::make_shared<OccupancyGrid>(width, height, res);
+    if (!rebuild) {
+      grid->SetData(grid_->GetData().data());
+    }
+    for (int i = r0; i <= r1; i++) {
+      const uint8_t *row = obstacle_map.ptr<uint8_t>(i);
+      for (int j = c0; j <= c1; j++) {
+        grid->SetOccupied(j, height - 1 - i, !row[j]);
+      }
+    }
+    if (grid_ && grid_->HasDistanceField()) {
+      grid->BuildDistanceField();
+    }
+    grid_ = grid;
+    GeometryChanged();
+  }
+
+  stream.info = msg.info;
+  stream.obstacle_map = obstacle_map;
+  if (removed != nullptr) *removed = destroyed;
+  if (added != nullptr) *added = created;
 }
 
 Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
@@ -118,46 +585,349 @@ Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
       cfr_(cfr),
       viz_name_("layer/" + names[0]) {}
 
-Layer::~Layer() { delete body_; }
+/**
+ * State of a layer streamed from an occupancy grid topic
+ */
+struct Layer::GridStream {
+  std::string topic;       ///< topic of the grids
+  double occupied_thresh;  ///< occupancy probability of obstacles
+  nav_msgs::MapMetaData info;  ///< size and origin of the previous grid
+  cv::Mat obstacle_map;  ///< previous grid thresholded, obstacles are 0 and
+                         /// the rows are flipped like in an image
+  /// the edges of each boundary between rows, then between columns, of the
+  /// obstacle map, in the order of the boundaries, with their fixtures
+  std::vector<std::vector<std::pair<LayerCache::Run, b2Fixture *>>> rows,
+      cols;
+};
+
+Layer::Layer(b2World *physics_world, CollisionFilterRegistry *cfr,
+             const std::vector<std::string> &names, const Color &color,
+             const std::string &topic, double occupied_thresh,
+             const YAML::Node &properties)
+    : Entity(physics_world, names[0]),
+      names_(names),
+      cfr_(cfr),
+      viz_name_("layer/" + names[0]) {
+  body_ = new Body(physics_world_, this, name_, color, Pose(0, 0, 0),
+                   b2_staticBody, properties);
+  stream_ = new GridStream();
+  stream_->topic = topic;
+  stream_->occupied_thresh = occupied_thresh;
+}
+
+void Layer::InitTiles(const LayerTiles::Params &tiling) {
+  if (tiling.size > 0) {
+    tiles_ = new LayerTiles(physics_world_, body_->physics_body_,
+                            cfr_->GetCategoryBits(names_), tiling);
+  }
+}
+
+Layer::~Layer() {
+  grid_sub_.Shutdown();
+  delete stream_;
+
+  // the edges are removed from the broad-phase tree in one pass
+  BulkFixtures bulk(physics_world_);
+  delete tiles_;
+  delete body_;
+}
 
 const std::vector<std::string> &Layer::GetNames() const { return names_; }
 
 const CollisionFilterRegistry *Layer::GetCfr() const { return cfr_; }
 Body *Layer::GetBody() { return body_; }
 
+const OccupancyGrid *Layer::GetGrid() const { return grid_.get(); }
+
+const SegmentRaycaster *Layer::GetSegmentRaycaster() const {
+  return segments_.get();
+}
+
+LayerTiles *Layer::GetTiles() { return tiles_; }
+
+void Layer::BuildDistanceField() {
+  if (!grid_ || grid_->HasDistanceField()) {
+    return;
+  }
+  FLATLAND_TRACE("load", "layer_distance_field");
+  std::shared_ptr<OccupancyGrid> grid =
+      std::make_shared<OccupancyGrid>(*grid_);
+  grid->BuildDistanceField();
+  grid_ = grid;
+}
+
+void Layer::BuildSensingSegments() {
+  if (!grid_ || segments_) {
+    return;
+  }
+  FLATLAND_TRACE("load", "layer_sensing_segments");
+
+  // the edges are extracted again from the grid, whatever the fixtures were
+  // built from, the image rows are flipped back
+  unsigned int width = grid_->GetWidth(), height = grid_->GetHeight();
+  cv::Mat obstacle_map(height, width, CV_8UC1, cv::Scalar(255));
+  cv::Mat transposed_map;
+  for (unsigned int i = 0; i < height; i++) {
+    uint8_t *row = obstacle_map.ptr<uint8_t>(i);
+    for (unsigned int j = 0; j < width; j++) {
+      if (grid_->IsOccupied(j, height - 1 - i)) {
+        row[j] = 0;
+      }
+    }
+  }
+  cv::transpose(obstacle_map, transposed_map);
+  std::vector<LayerCache::Run> runs;
+  ExtractRowRuns(obstacle_map, false, &runs);
+  ExtractRowRuns(transposed_map, true, &runs);
+
+  double res = grid_->GetResolution();
+  std::vector<LineSegment> segments;
+  segments.reserve(runs.size());
+  for (const LayerCache::Run &r : runs) {
+    segments.push_back(
+        LineSegment(Vec2(res * r.x1, res * (double(height) - r.y1)),
+                    Vec2(res * r.x2, res * (double(height) - r.y2))));
+  }
+  segments_ = std::make_shared<SegmentRaycaster>(segments);
+  fine_sensing_ = true;
+}
+
+void Layer::PublishGrid(const std::string &ns) {
+  if (!grid_ || !(publish_grid_ || publish_distance_field_)) {
+    return;
+  }
+
+  // latched, the messages are kept by the publishers for late subscribers
+  ros::NodeHandle nh(ns);
+  if (publish_grid_) {
+    grid_pub_ = nh.advertise<nav_msgs::OccupancyGrid>(viz_name_ + "/map", 1,
+                                                      true);
+    grid_pub_.publish(GridToMsg());
+  }
+  if (publish_distance_field_ && grid_->HasDistanceField()) {
+    distance_field_pub_ = nh.advertise<flatland_msgs::DistanceField>(
+        viz_name_ + "/distance_field", 1, true);
+    distance_field_pub_.publish(DistanceFieldToMsg());
+  }
+}
+
+namespace {
+/**
+ * @brief Get the pose of a body as a message
+ */
+geometry_msgs::Pose BodyPose(const b2Body *body) {
+  geometry_msgs::Pose pose;
+  pose.position.x = body->GetPosition().x;
+  pose.position.y = body->GetPosition().y;
+  pose.orientation.z = std::sin(body->GetAngle() / 2);
+  pose.orientation.w = std::cos(body->GetAngle() / 2);
+  return pose;
+}
+};  // namespace
+
+nav_msgs::OccupancyGrid Layer::GridToMsg() const {
+  nav_msgs::OccupancyGrid msg;
+  msg.header.frame_id = "map";
+  msg.header.stamp = ros::Time::now();
+  msg.info.map_load_time = msg.header.stamp;
+  msg.info.resolution = grid_->GetResolution();
+  msg.info.width = grid_->GetWidth();
+  msg.info.height = grid_->GetHeight();
+  msg.info.origin = BodyPose(body_->physics_body_);
+
+  // both are row major from the bottom row
+  msg.data.resize(size_t(msg.info.width) * msg.info.height);
+  for (unsigned int y = 0; y < msg.info.height; y++) {
+    int8_t *row = &msg.data[size_t(y) * msg.info.width];
+    for (unsigned int x = 0; x < msg.info.width; x++) {
+      row[x] = grid_->IsOccupied(x, y) ? 100 : 0;
+    }
+  }
+  return msg;
+}
+
+flatland_msgs::DistanceField Layer::DistanceFieldToMsg() const {
+  flatland_msgs::DistanceField msg;
+  msg.header.frame_id = "map";
+  msg.header.stamp = ros::Time::now();
+  msg.resolution = grid_->GetResolution();
+  msg.width = grid_->GetWidth();
+  msg.height = grid_->GetHeight();
+  msg.origin = BodyPose(body_->physics_body_);
+
+  msg.distances.resize(size_t(msg.width) * msg.height);
+  for (unsigned int y = 0; y < msg.height; y++) {
+    uint16_t *row = &msg.distances[size_t(y) * msg.width];
+    for (unsigned int x = 0; x < msg.width; x++) {
+      row[x] = grid_->GetDistance(x, y);
+    }
+  }
+  return msg;
+}
+
+void Layer::ShareGeometry(const std::string &map_path) {
+  // the geometry only depends on the map file, the registry holds weak
+  // references so the geometry is freed with the last layer using it
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<const OccupancyGrid>> grids;
+  static std::map<std::string, std::weak_ptr<const SegmentRaycaster>>
+      raycasters;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (grid_) {
+    std::shared_ptr<const OccupancyGrid> shared = grids[map_path].lock();
+    if (shared) {
+      grid_ = shared;
+    } else {
+      grids[map_path] = grid_;
+    }
+  }
+  if (segments_) {
+    std::shared_ptr<const SegmentRaycaster> shared =
+        raycasters[map_path].lock();
+    if (shared) {
+      segments_ = shared;
+    } else {
+      raycasters[map_path] = segments_;
+    }
+  }
+}
+
 Layer *Layer::MakeLayer(b2World *physics_world, CollisionFilterRegistry *cfr,
                         const std::string &map_path,
                         const std::vector<std::string> &names,
-                        const Color &color, const YAML::Node &properties) {
+                        const Color &color, const YAML::Node &properties,
+                        const WorldBundle *bundle,
+                        const std::string &bundle_key) {
   if (map_path.length() > 0) {  // If there is a map in this layer
-    YamlReader reader(map_path);
+    // a bundle holds the preprocessed map yaml and the extracted geometry
+    YAML::Node bundled_map;
+    const char *geometry = nullptr;
+    size_t geometry_size = 0;
+    bool bundled =
+        bundle != nullptr &&
+        bundle->FindYaml(WorldBundle::MapKey(bundle_key), &bundled_map) &&
+        bundle->Find(WorldBundle::GeometryKey(bundle_key), &geometry,
+                     &geometry_size);
+
+    YamlReader reader =
+        bundled ? YamlReader(bundled_map) : YamlReader(map_path);
+    reader.SetFile(map_path);
     reader.SetErrorInfo("layer " + Q(names[0]));
 
     std::string type = reader.Get<std::string>("type", "");
 
-    if (type == "line_segments") {
-      double scale = reader.Get<double>("scale");
+    // optionally split the geometry into tiles activated around the models
+    LayerTiles::Params tiling;
+    tiling.size = reader.Get<double>("tile_size", 0);
+    tiling.margin = reader.Get<double>("tile_margin", tiling.margin);
+    tiling.timeout = reader.Get<double>("tile_timeout", tiling.timeout);
+    if (tiling.size < 0 || tiling.margin < 0 || tiling.timeout < 0) {
+      throw YAMLException("Invalid tiling in layer " + Q(names[0]) +
+                          ", tile_size, tile_margin and tile_timeout must not "
+                          "be negative");
+    }
+
+    // vector drawings become line segments, with the same scale and origin
+    bool vector = type == "vector";
+    if (type == "line_segments" || vector) {
+      double scale = vector ? reader.Get<double>("scale", 1.0)
+                            : reader.Get<double>("scale");
       Pose origin = reader.GetPose("origin");
       boost::filesystem::path data_path(reader.Get<std::string>("data"));
       if (data_path.string().front() != '/') {
         data_path = boost::filesystem::path(map_path).parent_path() / data_path;
       }
 
+      if (bundled) {
+        LineSegmentsFile file;
+        file.Attach(geometry, geometry_size);
+        return new Layer(physics_world, cfr, names, color, origin, file, scale,
+                         properties, tiling);
+      }
+
+      if (vector) {
+        std::string format = reader.Get<std::string>("format", "");
+        double simplify_tolerance = reader.Get<double>("simplify_tolerance", 0);
+        ROS_INFO_NAMED("Layer",
+                       "layer \"%s\" loading vector map from path=\"%s\"",
+                       names[0].c_str(), data_path.string().c_str());
+
+        std::vector<LineSegment> line_segments;
+        {
+          FLATLAND_TRACE("load", "layer_read_vector");
+          line_segments = VectorMap::Load(
+              data_path.string(),
+              format.empty() ? VectorMap::FormatOf(data_path.string())
+                             : VectorMap::ParseFormat(format),
+              simplify_tolerance);
+        }
+        return new Layer(physics_world, cfr, names, color, origin,
+                         line_segments, scale, properties, tiling);
+      }
+
       ROS_INFO_NAMED("Layer",
                      "layer \"%s\" loading line segments from path=\"%s\"",
                      names[0].c_str(), data_path.string().c_str());
 
-      std::vector<LineSegment> line_segments;
+      // binary files are mapped and used in place, see LineSegmentsFile
+      if (LineSegmentsFile::IsBinary(data_path.string())) {
+        LineSegmentsFile file;
+        {
+          FLATLAND_TRACE("load", "layer_read_segments");
+          file.Open(data_path.string());
+        }
+        return new Layer(physics_world, cfr, names, color, origin, file, scale,
+                         properties, tiling);
+      }
 
-      ReadLineSegmentsFile(data_path.string(), line_segments);
+      std::vector<LineSegment> line_segments;
+      {
+        FLATLAND_TRACE("load", "layer_read_segments");
+        ReadLineSegmentsFile(data_path.string(), line_segments);
+      }
 
       return new Layer(physics_world, cfr, names, color, origin, line_segments,
-                       scale, properties);
+                       scale, properties, tiling);
 
     } else {
       double resolution = reader.Get<double>("resolution");
       double occupied_thresh = reader.Get<double>("occupied_thresh");
       Pose origin = reader.GetPose("origin");
+      bool contours = reader.Get<bool>("contours", false);
+      double simplify_tolerance = reader.Get<double>("simplify_tolerance", 0);
+      bool publish_grid = reader.Get<bool>("publish_grid", false);
+      bool publish_distance_field =
+          reader.Get<bool>("publish_distance_field", false);
+      bool distance_field = reader.Get<bool>("distance_field", false) ||
+                            publish_distance_field;
+      bool fine_sensing = reader.Get<bool>("fine_sensing", false);
+      if (contours && tiling.size > 0) {
+        throw YAMLException("Invalid layer " + Q(names[0]) +
+                            ", contours cannot be used with tile_size");
+      }
+
+      // the edges lie on the pixel grid, the tiles keep them in pixels
+      tiling.quantum = resolution;
+      auto finish = [=](Layer *layer) {
+        if (distance_field) layer->BuildDistanceField();
+        if (fine_sensing) layer->BuildSensingSegments();
+        layer->publish_grid_ = publish_grid;
+        layer->publish_distance_field_ = publish_distance_field;
+        return layer;
+      };
+
+      if (bundled) {
+        // the bundle is the key of its caches, they are written with key 0
+        LayerCache cache;
+        if (!cache.Attach(geometry, geometry_size, 0)) {
+          throw YAMLException("Invalid geometry of layer " + Q(names[0]) +
+                              " in the world bundle");
+        }
+        return finish(new Layer(physics_world, cfr, names, color, origin,
+                                cache, contours, simplify_tolerance,
+                                properties, tiling));
+      }
 
       boost::filesystem::path image_path(reader.Get<std::string>("image"));
       if (image_path.string().front() != '/') {
@@ -165,20 +935,79 @@ Layer *Layer::MakeLayer(b2World *physics_world, CollisionFilterRegistry *cfr,
             boost::filesystem::path(map_path).parent_path() / image_path;
       }
 
+      bool geometry_cache = reader.Get<bool>("geometry_cache", false);
+
+      // the cache is keyed on the image content and the parameters the
+      // geometry depends on, so editing either invalidates it. The key is in
+      // the name, layers of the same image with other parameters keep theirs
+      std::string cache_path;
+      uint64_t cache_key = 0;
+      if (geometry_cache) {
+        uint64_t image_hash = LayerCache::HashFile(image_path.string());
+        cache_key = LayerCache::MakeKey(image_hash, resolution, occupied_thresh,
+                                        {origin.x, origin.y, origin.theta});
+        cache_path = LayerCache::MakePath(image_path.string(), cache_key);
+        LayerCache cache;
+        if (cache.Open(cache_path, cache_key)) {
+          ROS_INFO_NAMED("Layer",
+                         "layer \"%s\" loading geometry from path=\"%s\"",
+                         names[0].c_str(), cache_path.c_str());
+          return finish(new Layer(physics_world, cfr, names, color, origin,
+                                  cache, contours, simplify_tolerance,
+                                  properties, tiling));
+        }
+      }
+
       ROS_INFO_NAMED("Layer", "layer \"%s\" loading image from path=\"%s\"",
                      names[0].c_str(), image_path.string().c_str());
 
-      cv::Mat map = cv::imread(image_path.string(), GREYSCALE);
-      if (map.empty()) {
-        throw YAMLException("Failed to load " + Q(image_path.string()) +
-                            " in layer " + Q(names[0]));
+      // images larger than the image cache are decoded row by row into
+      // their edges, they would not be kept anyway. The layers thresholding
+      // the same image otherwise share its decoded pixels
+      std::shared_ptr<const cv::Mat> image;
+      std::vector<LayerCache::Run> runs;
+      std::unique_ptr<OccupancyGrid> grid;
+      {
+        FLATLAND_TRACE("load", "layer_decode");
+        ImageRowReader stream;
+        if (stream.Open(image_path.string()) &&
+            size_t(stream.GetCols()) * stream.GetRows() >
+                ImageCache::Get().GetCapacity()) {
+          grid.reset(StreamRuns(stream, occupied_thresh, resolution, &runs));
+        } else {
+          image = ImageCache::Get().Load(image_path.string());
+          if (!image) {
+            throw YAMLException("Failed to load " + Q(image_path.string()) +
+                                " in layer " + Q(names[0]));
+          }
+        }
       }
 
-      cv::Mat bitmap;
-      map.convertTo(bitmap, CV_32FC1, 1.0 / 255.0);
+      if (geometry_cache) {
+        if (!grid) {
+          grid.reset(ExtractRuns(*image, occupied_thresh, resolution, &runs));
+        }
+        LayerCache cache;
+        if (LayerCache::Write(cache_path, cache_key, runs, *grid) &&
+            cache.Open(cache_path, cache_key)) {
+          return finish(new Layer(physics_world, cfr, names, color, origin,
+                                  cache, contours, simplify_tolerance,
+                                  properties, tiling));
+        }
+        ROS_WARN_NAMED("Layer",
+                       "layer \"%s\" failed to write geometry cache to "
+                       "path=\"%s\"",
+                       names[0].c_str(), cache_path.c_str());
+      }
 
-      return new Layer(physics_world, cfr, names, color, origin, bitmap,
-                       occupied_thresh, resolution, properties);
+      if (grid) {
+        return finish(new Layer(physics_world, cfr, names, color, origin, runs,
+                                grid.release(), contours, simplify_tolerance,
+                                properties, tiling));
+      }
+      return finish(new Layer(physics_world, cfr, names, color, origin,
+                              *image, occupied_thresh, resolution, contours,
+                              simplify_tolerance, properties, tiling));
     }
   } else {  // If the layer has no static obstacles
     return new Layer(physics_world, cfr, names, color, properties);
@@ -218,97 +1047,323 @@ void Layer::ReadLineSegmentsFile(const std::string &file_path,
 }
 
 void Layer::LoadFromBitmap(const cv::Mat &bitmap, double occupied_thresh,
-                           double resolution) {
-  uint16_t category_bits = cfr_->GetCategoryBits(names_);
+                           double resolution, bool contours,
+                           double simplify_tolerance) {
+  std::vector<LayerCache::Run> runs;
+  grid_.reset(ExtractRuns(bitmap, occupied_thresh, resolution, &runs));
+  LoadFromRuns(runs.data(), runs.size(), bitmap.rows, resolution, contours,
+               simplify_tolerance);
+}
 
-  auto add_edge = [&](double x1, double y1, double x2, double y2) {
-    b2EdgeShape edge;
-    double rows = bitmap.rows;
-    double res = resolution;
+OccupancyGrid *Layer::ExtractRuns(const cv::Mat &bitmap,
+                                  double occupied_thresh, double resolution,
+                                  std::vector<LayerCache::Run> *runs) {
+  cv::Mat obstacle_map, transposed_map;
+  SensorExecutor &executor = SensorExecutor::Get();
+  OccupancyGrid *grid;
+  {
+    FLATLAND_TRACE("load", "layer_threshold");
 
-    edge.Set(b2Vec2(res * x1, res * (rows - y1)),
-             b2Vec2(res * x2, res * (rows - y2)));
+    // thresholds the map, values between the occupied threshold and 1.0 are
+    // considered to be occupied. 8 bit images are thresholded in place at the
+    // first value whose float conversion reaches the threshold, which gives
+    // the same map as converting them to float first
+    if (bitmap.depth() == CV_8U) {
+      int lower = ThresholdValue(occupied_thresh);
+      if (lower < 256) {
+        cv::inRange(bitmap, lower, 255, obstacle_map);
+      } else {
+        obstacle_map = cv::Mat::zeros(bitmap.size(), CV_8UC1);
+      }
+    } else {
+      cv::inRange(bitmap, occupied_thresh, 1.0, obstacle_map);
+    }
 
-    b2FixtureDef fixture_def;
-    fixture_def.shape = &edge;
-    fixture_def.filter.categoryBits = category_bits;
-    fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
-    body_->physics_body_->CreateFixture(&fixture_def);
-  };
+    // keep the thresholded map as a packed grid for grid based raycasting,
+    // the image rows are flipped since the image origin is at the top left.
+    // Each grid row is made of its own words, so rows can be filled
+    // concurrently
+    grid = new OccupancyGrid(obstacle_map.cols, obstacle_map.rows, resolution);
+    executor.ParallelFor(obstacle_map.rows, 0, [&](unsigned int begin,
+                                                   unsigned int end) {
+      for (unsigned int i = begin; i < end; i++) {
+        const uint8_t *row = obstacle_map.ptr<uint8_t>(i);
+        for (int j = 0; j < obstacle_map.cols; j++) {
+          if (!row[j]) {
+            grid->SetOccupied(j, obstacle_map.rows - 1 - i, true);
+          }
+        }
+      }
+    });
+  }
 
-  cv::Mat padded_map, obstacle_map;
+  // the horizontal edges are found between consecutive rows, and the
+  // vertical ones between consecutive rows of the transposed map, which keeps
+  // the memory accesses of both passes sequential
+  FLATLAND_TRACE("load", "layer_edges");
+  cv::transpose(obstacle_map, transposed_map);
 
-  // thresholds the map, values between the occupied threshold and 1.0 are
-  // considered to be occupied
-  cv::inRange(bitmap, occupied_thresh, 1.0, obstacle_map);
+  runs->clear();
+  ExtractRowRuns(obstacle_map, false, runs);
+  ExtractRowRuns(transposed_map, true, runs);
+  return grid;
+}
 
-  // pad the top and bottom of the map each with an empty row (255=white). This
-  // helps to look at the transition from one row of pixel to another
-  cv::copyMakeBorder(obstacle_map, padded_map, 1, 1, 0, 0, cv::BORDER_CONSTANT,
-                     255);
+OccupancyGrid *Layer::StreamRuns(ImageRowReader &image, double occupied_thresh,
+                                 double resolution,
+                                 std::vector<LayerCache::Run> *runs) {
+  SensorExecutor &executor = SensorExecutor::Get();
+  int rows = image.GetRows(), cols = image.GetCols();
+  int lower = ThresholdValue(occupied_thresh);
+  std::unique_ptr<OccupancyGrid> grid(new OccupancyGrid(cols, rows, resolution));
 
-  // loop through all the rows, looking at 2 at once
-  for (int i = 0; i < padded_map.rows - 1; i++) {
-    cv::Mat row1 = padded_map.row(i);
-    cv::Mat row2 = padded_map.row(i + 1);
-    cv::Mat diff;
+  // each band of thresholded rows is preceded by the last row of the band
+  // before it, or by a free row above the image, for the horizontal edges
+  // between the bands. Obstacles are 0 as in ExtractRuns
+  cv::Mat pixels(STREAM_BAND_ROWS, cols, CV_8UC1);
+  cv::Mat band(STREAM_BAND_ROWS + 1, cols, CV_8UC1, cv::Scalar(255));
 
-    // if the two row are the same value, there is no edge
-    // if the two rows are not the same value, there is an edge
-    // result is still binary, either 255 or 0
-    cv::absdiff(row1, row2, diff);
+  // the vertical edges are followed down the column boundaries across the
+  // bands, the boundaries are split in chunks as in ExtractRowRuns. starts
+  // holds the first row of the edge running along each boundary, or -1
+  unsigned int boundaries = cols + 1;
+  unsigned int num_chunks =
+      std::min(boundaries, 4 * std::max(1u, executor.GetNumThreads()));
+  unsigned int chunk_size = (boundaries + num_chunks - 1) / num_chunks;
+  std::vector<std::vector<LayerCache::Run>> chunks(
+      (boundaries + chunk_size - 1) / chunk_size);
+  std::vector<int> starts(boundaries, -1);
 
-    int start = 0;
-    bool started = false;
+  runs->clear();
+  for (int first = 0; first < rows; first += STREAM_BAND_ROWS) {
+    int count = std::min(STREAM_BAND_ROWS, rows - first);
+    for (int i = 0; i < count; i++) {
+      image.ReadRow(pixels.ptr<uint8_t>(i));
+    }
+    cv::Mat thresholded = band.rowRange(1, count + 1);
+    if (lower < 256) {
+      cv::inRange(pixels.rowRange(0, count), lower, 255, thresholded);
+    } else {
+      thresholded.setTo(0);
+    }
 
-    // find all the walls, put the connected walls as a single line segment
-    for (unsigned int j = 0; j <= diff.total(); j++) {
-      bool edge_exists = false;
-      if (j < diff.total()) {
-        edge_exists = diff.at<uint8_t>(0, j);  // 255 maps to true
+    executor.ParallelFor(count, 0, [&](unsigned int begin, unsigned int end) {
+      for (unsigned int i = begin; i < end; i++) {
+        const uint8_t *row = thresholded.ptr<uint8_t>(i);
+        for (int j = 0; j < cols; j++) {
+          if (!row[j]) {
+            grid->SetOccupied(j, rows - 1 - first - i, true);
+          }
+        }
       }
+    });
 
-      if (edge_exists && !started) {
-        start = j;
-        started = true;
-      } else if (started && !edge_exists) {
-        add_edge(start, i, j, i);
+    // the boundaries above the rows of the band, and below the last row
+    int last = first + count;
+    ExtractRowRuns(band.rowRange(0, count + 1), false, first - 1, first,
+                   last == rows ? rows + 1 : last, runs);
 
-        started = false;
+    executor.ParallelFor(boundaries, chunk_size, [&](unsigned int begin,
+                                                     unsigned int end) {
+      std::vector<LayerCache::Run> &chunk = chunks[begin / chunk_size];
+      for (int i = 0; i < count; i++) {
+        const uint8_t *row = thresholded.ptr<uint8_t>(i);
+        for (unsigned int c = begin; c < end; c++) {
+          bool occupied1 = c > 0 && !row[c - 1];
+          bool occupied2 = int(c) < cols && !row[c];
+          if (occupied1 != occupied2) {
+            if (starts[c] < 0) {
+              starts[c] = first + i;
+            }
+          } else if (starts[c] >= 0) {
+            chunk.push_back({int(c), starts[c], int(c), first + i});
+            starts[c] = -1;
+          }
+        }
       }
+    });
+
+    band.row(count).copyTo(band.row(0));
+  }
+
+  // the edges are closed by the free row below the image. They were found
+  // in the order they end, the order of ExtractRowRuns on the transposed map
+  // is by boundary, then along the boundary
+  for (unsigned int c = 0; c < boundaries; c++) {
+    if (starts[c] >= 0) {
+      chunks[c / chunk_size].push_back({int(c), starts[c], int(c), rows});
     }
   }
+  size_t total = runs->size();
+  for (auto &chunk : chunks) {
+    std::stable_sort(chunk.begin(), chunk.end(),
+                     [](const LayerCache::Run &a, const LayerCache::Run &b) {
+                       return a.x1 < b.x1;
+                     });
+    total += chunk.size();
+  }
+  runs->reserve(total);
+  for (const auto &chunk : chunks) {
+    runs->insert(runs->end(), chunk.begin(), chunk.end());
+  }
+  return grid.release();
+}
 
-  // pad the left and right of the map each with an empty column (255).
-  cv::copyMakeBorder(obstacle_map, padded_map, 0, 0, 1, 1, cv::BORDER_CONSTANT,
-                     255);
+void Layer::ExtractRowRuns(const cv::Mat &obstacle_map, bool transposed,
+                           std::vector<LayerCache::Run> *runs) {
+  ExtractRowRuns(obstacle_map, transposed, 0, 0, obstacle_map.rows + 1, runs);
+}
 
-  // loop through all the columns, looking at 2 at once
-  for (int i = 0; i < padded_map.cols - 1; i++) {
-    cv::Mat col1 = padded_map.col(i);
-    cv::Mat col2 = padded_map.col(i + 1);
-    cv::Mat diff;
+void Layer::ExtractRowRuns(const cv::Mat &obstacle_map, bool transposed,
+                           int offset, unsigned int begin, unsigned int end,
+                           std::vector<LayerCache::Run> *runs) {
+  if (end <= begin) {
+    return;
+  }
+
+  // the boundaries are split in chunks processed on the sensor executor, each
+  // chunk into its own vector. The chunks are concatenated in order, so the
+  // result does not depend on the number of threads
+  SensorExecutor &executor = SensorExecutor::Get();
+  unsigned int first = begin;
+  unsigned int count = end - begin;
+  unsigned int num_chunks =
+      std::min(count, 4 * std::max(1u, executor.GetNumThreads()));
+  unsigned int chunk_size = (count + num_chunks - 1) / num_chunks;
+  std::vector<std::vector<LayerCache::Run>> chunks(
+      (count + chunk_size - 1) / chunk_size);
+
+  executor.ParallelFor(count, chunk_size, [&](unsigned int begin,
+                                              unsigned int end) {
+    std::vector<LayerCache::Run> &chunk = chunks[begin / chunk_size];
+    int cols = obstacle_map.cols;
 
-    cv::absdiff(col1, col2, diff);
+    // boundary i lies between rows i - 1 and i, the map is padded with a
+    // free row above and below. Obstacles are 0 in the thresholded map
+    for (unsigned int i = first + begin; i < first + end; i++) {
+      int r1 = int(i) - 1 - offset, r2 = int(i) - offset;
+      const uint8_t *row1 = r1 >= 0 && r1 < obstacle_map.rows
+                                ? obstacle_map.ptr<uint8_t>(r1)
+                                : nullptr;
+      const uint8_t *row2 = r2 >= 0 && r2 < obstacle_map.rows
+                                ? obstacle_map.ptr<uint8_t>(r2)
+                                : nullptr;
 
-    int start = 0;
-    bool started = false;
+      int start = 0;
+      bool started = false;
 
-    for (unsigned int j = 0; j <= diff.total(); j++) {
-      bool edge_exists = false;
-      if (j < diff.total()) {
-        edge_exists = diff.at<uint8_t>(j, 0);
+      // find all the walls, put the connected walls as a single line segment
+      for (int j = 0; j <= cols; j++) {
+        bool edge_exists = false;
+        if (j < cols) {
+          bool occupied1 = row1 && !row1[j];
+          bool occupied2 = row2 && !row2[j];
+          edge_exists = occupied1 != occupied2;
+        }
+
+        if (edge_exists && !started) {
+          start = j;
+          started = true;
+        } else if (started && !edge_exists) {
+          LayerCache::Run run = {start, int(i), j, int(i)};
+          if (transposed) {
+            run = {int(i), start, int(i), j};
+          }
+          chunk.push_back(run);
+
+          started = false;
+        }
       }
+    }
+  });
+
+  size_t total = runs->size();
+  for (const auto &chunk : chunks) {
+    total += chunk.size();
+  }
+  runs->reserve(total);
+  for (const auto &chunk : chunks) {
+    runs->insert(runs->end(), chunk.begin(), chunk.end());
+  }
+}
 
-      if (edge_exists && !started) {
-        start = j;
-        started = true;
-      } else if (started && !edge_exists) {
-        add_edge(i, start, i, j);
+void Layer::LoadFromRuns(const LayerCache::Run *runs, size_t run_count,
+                         unsigned int rows, double resolution, bool contours,
+                         double simplify_tolerance) {
+  FLATLAND_TRACE("load", "layer_fixtures");
+  uint32_t category_bits = cfr_->GetCategoryBits(names_);
+  double res = resolution;
 
-        started = false;
+  // the edges are inserted into the broad-phase tree in one pass
+  BulkFixtures bulk(physics_world_);
+  if (!contours) {
+    for (size_t i = 0; i < run_count; i++) {
+      const LayerCache::Run &r = runs[i];
+      b2EdgeShape edge;
+      edge.Set(b2Vec2(res * r.x1, res * (double(rows) - r.y1)),
+               b2Vec2(res * r.x2, res * (double(rows) - r.y2)));
+
+      b2FixtureDef fixture_def;
+      fixture_def.shape = &edge;
+      fixture_def.filter.categoryBits = category_bits;
+      fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+      if (tiles_) {
+        tiles_->AddSegment(edge.m_vertex1, edge.m_vertex2);
+      } else {
+        body_->physics_body_->CreateFixture(&fixture_def);
       }
     }
+    return;
+  }
+
+  // in contour mode, the edges are kept in pixel coordinates to be linked
+  // into polylines
+  std::vector<LineSegment> segments;
+  segments.reserve(run_count);
+  for (size_t i = 0; i < run_count; i++) {
+    const LayerCache::Run &r = runs[i];
+    segments.push_back(LineSegment(Vec2(r.x1, r.y1), Vec2(r.x2, r.y2)));
+  }
+
+  // the map is padded with free pixels, so the edges always form loops
+  // around the obstacles, each loop becomes a single chain fixture
+  std::vector<std::vector<b2Vec2>> loops, chains;
+  Geometry::LinkSegments(segments, &loops, &chains);
+
+  auto add_chain = [&](std::vector<b2Vec2> &polyline, bool closed) {
+    for (auto &v : polyline) {
+      v.Set(res * v.x, res * (double(rows) - v.y));
+    }
+
+    // obstacles the tolerance would collapse keep all their corners
+    std::vector<b2Vec2> simple =
+        Geometry::SimplifyPolyline(polyline, simplify_tolerance, closed);
+    if (simple.size() < (closed ? 3u : 2u)) {
+      simple = Geometry::SimplifyPolyline(polyline, 0, closed);
+    }
+    if (simple.size() < (closed ? 3u : 2u)) {
+      return;
+    }
+
+    b2ChainShape chain;
+    if (closed) {
+      chain.CreateLoop(simple.data(), simple.size());
+    } else {
+      chain.CreateChain(simple.data(), simple.size());
+    }
+
+    b2FixtureDef fixture_def;
+    fixture_def.shape = &chain;
+    fixture_def.filter.categoryBits = category_bits;
+    fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+    body_->physics_body_->CreateFixture(&fixture_def);
+  };
+
+  for (auto &loop : loops) {
+    add_chain(loop, true);
+  }
+  for (auto &chain : chains) {
+    add_chain(chain, false);
   }
 }
 
@@ -318,20 +1373,48 @@ void Layer::DebugVisualize() const {
     return;
   }
 
+  // the markers are kept on the topics until the geometry changes, on large
+  // maps rebuilding them takes long
+  uint64_t tile_changes = tiles_ != nullptr ? tiles_->GetChangeCount() : 0;
+  if (!viz_dirty_ && tile_changes == viz_tile_changes_) {
+    return;
+  }
+
+  // nor built while nobody watches the layer, until a subscriber connects
+  DebugVisualization &viz = DebugVisualization::Get();
+  if (!viz.HasSubscribers(viz_name_) &&
+      !viz.HasSubscribers(viz_name_ + "_3d")) {
+    return;
+  }
+  viz_dirty_ = false;
+  viz_tile_changes_ = tile_changes;
+
   DebugVisualization::Get().Reset(viz_name_);
   DebugVisualization::Get().Reset(viz_name_ + "_3d");
 
-  if (body_ != nullptr) {
+  LayerVisualization lod(body_ != nullptr ? body_->properties_ : YAML::Node());
+  if (body_ != nullptr && lod.ReducesDetail()) {
+    DebugVisualization::Get().VisualizeLayer(viz_name_, body_, lod);
+  } else if (body_ != nullptr) {
     DebugVisualization::Get().Visualize(viz_name_, body_->physics_body_,
                                         body_->color_.r, body_->color_.g,
                                         body_->color_.b, body_->color_.a);
     DebugVisualization::Get().VisualizeLayer(viz_name_ + "_3d", body_);
   }
+
+  // only the tiles active at the time are shown, until the tiles change
+  if (tiles_ != nullptr) {
+    for (b2Body *b : tiles_->GetActiveBodies()) {
+      DebugVisualization::Get().Visualize(viz_name_, b, body_->color_.r,
+                                          body_->color_.g, body_->color_.b,
+                                          body_->color_.a);
+    }
+  }
 }
 
 void Layer::DebugOutput() const {
   std::string names = "{" + boost::algorithm::join(names_, ",") + "}";
-  uint16_t category_bits = cfr_->GetCategoryBits(names_);
+  uint32_t category_bits = cfr_->GetCategoryBits(names_);
 
   ROS_DEBUG_NAMED("Layer",
                   "Layer %p: physics_world(%p) name(%s) names(%s) "
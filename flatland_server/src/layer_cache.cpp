@@ -0,0 +1,257 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_cache.cpp
+ * @brief	 Binary on disk cache of the geometry extracted from bitmap layers
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/layer_cache.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace flatland_server {
+
+namespace {
+const char CACHE_MAGIC[8] = {'F', 'L', 'G', 'E', 'O', 'M', 0, 0};
+const uint32_t CACHE_VERSION = 1;
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t rows;
+  uint64_t key;
+  uint32_t cols;
+  uint32_t reserved;
+  double resolution;
+  uint64_t run_count;
+  uint64_t grid_words;
+};
+
+uint64_t Fnv1a(const void *data, size_t size, uint64_t hash) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ p[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+}
+
+LayerCache::~LayerCache() { Close(); }
+
+void LayerCache::Close() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  runs_ = nullptr;
+  run_count_ = 0;
+  grid_ = nullptr;
+}
+
+uint64_t LayerCache::HashFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (in.fail()) {
+    throw Exception("Flatland File: Failed to load " + path);
+  }
+
+  uint64_t hash = FNV_OFFSET;
+  std::vector<char> buffer(1 << 16);
+  while (in) {
+    in.read(buffer.data(), buffer.size());
+    hash = Fnv1a(buffer.data(), in.gcount(), hash);
+  }
+  return hash;
+}
+
+uint64_t LayerCache::MakeKey(uint64_t image_hash, double resolution,
+                             double occupied_thresh,
+                             const std::vector<double> &origin) {
+  uint64_t key = Fnv1a(&image_hash, sizeof(image_hash), FNV_OFFSET);
+  key = Fnv1a(&CACHE_VERSION, sizeof(CACHE_VERSION), key);
+  key = Fnv1a(&resolution, sizeof(resolution), key);
+  key = Fnv1a(&occupied_thresh, sizeof(occupied_thresh), key);
+  for (double v : origin) {
+    key = Fnv1a(&v, sizeof(v), key);
+  }
+  return key;
+}
+
+std::string LayerCache::Serialize(uint64_t key, const std::vector<Run> &runs,
+                                  const OccupancyGrid &grid) {
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.version = CACHE_VERSION;
+  header.rows = grid.GetHeight();
+  header.cols = grid.GetWidth();
+  header.key = key;
+  header.resolution = grid.GetResolution();
+  header.run_count = runs.size();
+  header.grid_words = grid.GetData().size();
+
+  std::string content(reinterpret_cast<const char *>(&header), sizeof(header));
+  content.append(reinterpret_cast<const char *>(runs.data()),
+                 runs.size() * sizeof(Run));
+  content.append(reinterpret_cast<const char *>(grid.GetData().data()),
+                 grid.GetData().size() * sizeof(uint64_t));
+  return content;
+}
+
+std::string LayerCache::MakePath(const std::string &image_path,
+                                 uint64_t key) {
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016" PRIx64, key);
+  return image_path + "." + hex + ".geometry";
+}
+
+bool LayerCache::Write(const std::string &path, uint64_t key,
+                       const std::vector<Run> &runs,
+                       const OccupancyGrid &grid) {
+  std::string content = Serialize(key, runs, grid);
+
+  // the name is unique so that processes loading the same map at once do not
+  // write to the same file
+  std::vector<char> tmp_path(path.begin(), path.end());
+  const char suffix[] = ".XXXXXX";
+  tmp_path.insert(tmp_path.end(), suffix, suffix + sizeof(suffix));
+  int fd = mkstemp(tmp_path.data());
+  if (fd < 0) {
+    return false;
+  }
+
+  // mkstemp creates the file readable by the owner only
+  bool ok = fchmod(fd, 0644) == 0;
+  for (size_t done = 0; ok && done < content.size();) {
+    ssize_t n = write(fd, content.data() + done, content.size() - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    ok = n > 0;
+    done += ok ? n : 0;
+  }
+  ok = close(fd) == 0 && ok;
+
+  if (!ok || std::rename(tmp_path.data(), path.c_str()) != 0) {
+    std::remove(tmp_path.data());
+    return false;
+  }
+  return true;
+}
+
+bool LayerCache::Open(const std::string &path, uint64_t key) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(CacheHeader)) {
+    close(fd);
+    return false;
+  }
+
+  size_ = st.st_size;
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    size_ = 0;
+    return false;
+  }
+
+  if (!Attach(data_, size_, key)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool LayerCache::Attach(const void *data, size_t size, uint64_t key) {
+  if (data != data_) {
+    Close();  // the content is not the mapping of Open
+  }
+  if (size < sizeof(CacheHeader) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(CacheHeader) != 0) {
+    return false;
+  }
+
+  const CacheHeader *header = static_cast<const CacheHeader *>(data);
+  size_t expected_size = sizeof(CacheHeader) +
+                         header->run_count * sizeof(Run) +
+                         header->grid_words * sizeof(uint64_t);
+  size_t words_per_row = (size_t(header->cols) + 63) / 64;
+  if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header->version != CACHE_VERSION || header->key != key ||
+      header->grid_words != words_per_row * header->rows ||
+      size != expected_size) {
+    return false;
+  }
+
+  const char *p = static_cast<const char *>(data) + sizeof(CacheHeader);
+  runs_ = reinterpret_cast<const Run *>(p);
+  run_count_ = header->run_count;
+  grid_ = reinterpret_cast<const uint64_t *>(p + run_count_ * sizeof(Run));
+  rows_ = header->rows;
+  cols_ = header->cols;
+  resolution_ = header->resolution;
+  return true;
+}
+
+OccupancyGrid *LayerCache::MakeGrid() const {
+  OccupancyGrid *grid = new OccupancyGrid(cols_, rows_, resolution_);
+  grid->SetData(grid_);
+  return grid;
+}
+};  // namespace flatland_server
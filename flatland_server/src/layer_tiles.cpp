@@ -0,0 +1,252 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_tiles.cpp
+ * @brief	 Implements tiles of layer geometry activated around models
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/layer_tiles.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_server {
+
+LayerTiles::LayerTiles(b2World *physics_world, b2Body *layer_body,
+                       uint32_t category_bits, const Params &params)
+    : physics_world_(physics_world),
+      layer_body_(layer_body),
+      category_bits_(category_bits),
+      params_(params) {
+  if (params_.quantum > 0) {
+    double steps = std::max(1.0, std::round(params_.size / params_.quantum));
+    if (steps <= 0xffff) {
+      params_.size = steps * params_.quantum;
+    } else {
+      params_.quantum = 0;
+    }
+  }
+}
+
+LayerTiles::~LayerTiles() {
+  physics_world_->BeginStaticBulk();
+  for (uint64_t key : active_) {
+    physics_world_->DestroyBody(tiles_[key].body);
+  }
+  physics_world_->EndStaticBulk();
+}
+
+uint64_t LayerTiles::Key(int32_t x, int32_t y) {
+  return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+int32_t LayerTiles::TileCoord(double v) const {
+  return int32_t(std::floor(v / params_.size));
+}
+
+void LayerTiles::AddSegment(const b2Vec2 &start, const b2Vec2 &end) {
+  double dx = end.x - start.x;
+  double dy = end.y - start.y;
+
+  // split the segment where it crosses the tile boundaries
+  std::vector<double> splits = {0, 1};
+  int32_t x0 = TileCoord(start.x), x1 = TileCoord(end.x);
+  int32_t y0 = TileCoord(start.y), y1 = TileCoord(end.y);
+  for (int32_t x = std::min(x0, x1) + 1; x <= std::max(x0, x1); x++) {
+    splits.push_back((x * params_.size - start.x) / dx);
+  }
+  for (int32_t y = std::min(y0, y1) + 1; y <= std::max(y0, y1); y++) {
+    splits.push_back((y * params_.size - start.y) / dy);
+  }
+  std::sort(splits.begin(), splits.end());
+
+  for (unsigned int i = 0; i + 1 < splits.size(); i++) {
+    double t0 = splits[i], t1 = splits[i + 1];
+    if (t1 <= t0) {
+      continue;
+    }
+
+    // the middle of a piece is always inside of the tile that owns it
+    double tm = (t0 + t1) / 2;
+    int32_t tx = TileCoord(start.x + tm * dx);
+    int32_t ty = TileCoord(start.y + tm * dy);
+    Tile &tile = tiles_[Key(tx, ty)];
+    if (params_.quantum <= 0) {
+      tile.vertices.push_back(b2Vec2(start.x + t0 * dx, start.y + t0 * dy));
+      tile.vertices.push_back(b2Vec2(start.x + t1 * dx, start.y + t1 * dy));
+      continue;
+    }
+
+    // the points on a tile boundary are on the boundary of both tiles, since
+    // the tile size is a multiple of the quantum
+    double steps = std::round(params_.size / params_.quantum);
+    auto quantize = [&](double v, int32_t t) {
+      double q = std::round((v - t * params_.size) / params_.quantum);
+      return uint16_t(std::min(std::max(q, 0.0), steps));
+    };
+    uint16_t q[4] = {quantize(start.x + t0 * dx, tx),
+                     quantize(start.y + t0 * dy, ty),
+                     quantize(start.x + t1 * dx, tx),
+                     quantize(start.y + t1 * dy, ty)};
+    if (q[0] != q[2] || q[1] != q[3]) {
+      tile.quantized.insert(tile.quantized.end(), q, q + 4);
+    }
+  }
+}
+
+void LayerTiles::Update(const std::vector<b2AABB> &regions, double time) {
+  const b2Transform &xf = layer_body_->GetTransform();
+
+  for (const auto &region : regions) {
+    // bounds of the region in the frame of the layer body
+    b2Vec2 corners[4] = {region.lowerBound,
+                         b2Vec2(region.upperBound.x, region.lowerBound.y),
+                         region.upperBound,
+                         b2Vec2(region.lowerBound.x, region.upperBound.y)};
+    b2Vec2 lower(b2_maxFloat, b2_maxFloat), upper(-b2_maxFloat, -b2_maxFloat);
+    for (const auto &corner : corners) {
+      b2Vec2 p = b2MulT(xf, corner);
+      lower = b2Min(lower, p);
+      upper = b2Max(upper, p);
+    }
+
+    int32_t min_x = TileCoord(lower.x - params_.margin);
+    int32_t max_x = TileCoord(upper.x + params_.margin);
+    int32_t min_y = TileCoord(lower.y - params_.margin);
+    int32_t max_y = TileCoord(upper.y + params_.margin);
+
+    auto touch = [&](uint64_t key, Tile &tile) {
+      tile.last_used = time;
+      if (!tile.body) {
+        Activate(key, &tile);
+        active_.push_back(key);
+      }
+    };
+
+    // huge regions are matched against the existing tiles instead
+    double cells = (double(max_x) - min_x + 1) * (double(max_y) - min_y + 1);
+    if (cells > tiles_.size()) {
+      for (auto &kv : tiles_) {
+        int32_t x = int32_t(kv.first >> 32), y = int32_t(kv.first);
+        if (x >= min_x && x <= max_x && y >= min_y && y <= max_y) {
+          touch(kv.first, kv.second);
+        }
+      }
+      continue;
+    }
+
+    for (int32_t x = min_x; x <= max_x; x++) {
+      for (int32_t y = min_y; y <= max_y; y++) {
+        auto it = tiles_.find(Key(x, y));
+        if (it != tiles_.end()) {
+          touch(it->first, it->second);
+        }
+      }
+    }
+  }
+
+  // evict the tiles no region has been near for the timeout, their edges are
+  // removed from the broad-phase tree in one pass
+  physics_world_->BeginStaticBulk();
+  for (unsigned int i = 0; i < active_.size();) {
+    Tile &tile = tiles_[active_[i]];
+    if (time - tile.last_used > params_.timeout) {
+      physics_world_->DestroyBody(tile.body);
+      tile.body = nullptr;
+      changes_++;
+      active_[i] = active_.back();
+      active_.pop_back();
+    } else {
+      i++;
+    }
+  }
+  physics_world_->EndStaticBulk();
+}
+
+std::vector<b2Body *> LayerTiles::GetActiveBodies() const {
+  std::vector<b2Body *> bodies;
+  for (uint64_t key : active_) {
+    bodies.push_back(tiles_.at(key).body);
+  }
+  return bodies;
+}
+
+void LayerTiles::Activate(uint64_t key, Tile *tile) {
+  b2BodyDef body_def;
+  body_def.type = b2_staticBody;
+  body_def.position = layer_body_->GetPosition();
+  body_def.angle = layer_body_->GetAngle();
+  body_def.userData = layer_body_->GetUserData();
+  tile->body = physics_world_->CreateBody(&body_def);
+  changes_++;
+
+  // the tile is inserted into the broad-phase tree in one pass if it is
+  // large compared to the active tiles
+  physics_world_->BeginStaticBulk();
+  for (unsigned int i = 0; i + 1 < tile->vertices.size(); i += 2) {
+    b2EdgeShape edge;
+    edge.Set(tile->vertices[i], tile->vertices[i + 1]);
+
+    b2FixtureDef fixture_def;
+    fixture_def.shape = &edge;
+    fixture_def.filter.categoryBits = category_bits_;
+    fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+    tile->body->CreateFixture(&fixture_def);
+  }
+
+  b2Vec2 corner(int32_t(key >> 32) * params_.size,
+                int32_t(key) * params_.size);
+  float quantum = params_.quantum;
+  for (unsigned int i = 0; i + 3 < tile->quantized.size(); i += 4) {
+    const uint16_t *q = &tile->quantized[i];
+    b2EdgeShape edge;
+    edge.Set(corner + b2Vec2(quantum * q[0], quantum * q[1]),
+             corner + b2Vec2(quantum * q[2], quantum * q[3]));
+
+    b2FixtureDef fixture_def;
+    fixture_def.shape = &edge;
+    fixture_def.filter.categoryBits = category_bits_;
+    fixture_def.filter.maskBits = fixture_def.filter.categoryBits;
+    tile->body->CreateFixture(&fixture_def);
+  }
+  physics_world_->EndStaticBulk();
+}
+};  // namespace flatland_server
@@ -0,0 +1,184 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 line_segments_file.cpp
+ * @brief	 Implements the binary line segments file format
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/line_segments_file.h>
+#include <flatland_server/yaml_reader.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+
+namespace flatland_server {
+
+namespace {
+const char SEGMENTS_MAGIC[8] = {'F', 'L', 'S', 'E', 'G', 'S', 0, 0};
+const uint32_t SEGMENTS_VERSION = 1;
+
+struct SegmentsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+static_assert(sizeof(SegmentsHeader) == 24, "unexpected header padding");
+static_assert(sizeof(LineSegmentsFile::Record) == 16,
+              "unexpected record padding");
+
+/**
+ * @return true if the content is a complete binary file of this version
+ */
+bool IsValid(const void *data, size_t size) {
+  if (size < sizeof(SegmentsHeader)) {
+    return false;
+  }
+  const SegmentsHeader *header = static_cast<const SegmentsHeader *>(data);
+  size_t expected_size =
+      sizeof(SegmentsHeader) + header->count * sizeof(LineSegmentsFile::Record);
+  return std::memcmp(header->magic, SEGMENTS_MAGIC, sizeof(SEGMENTS_MAGIC)) ==
+             0 &&
+         header->version == SEGMENTS_VERSION && size == expected_size;
+}
+}
+
+LineSegmentsFile::~LineSegmentsFile() { Close(); }
+
+void LineSegmentsFile::Close() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  records_ = nullptr;
+  count_ = 0;
+}
+
+bool LineSegmentsFile::IsBinary(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(SEGMENTS_MAGIC)];
+  in.read(magic, sizeof(magic));
+  return in.gcount() == sizeof(magic) &&
+         std::memcmp(magic, SEGMENTS_MAGIC, sizeof(magic)) == 0;
+}
+
+std::string LineSegmentsFile::Serialize(
+    const std::vector<LineSegment> &line_segments) {
+  SegmentsHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SEGMENTS_MAGIC, sizeof(header.magic));
+  header.version = SEGMENTS_VERSION;
+  header.count = line_segments.size();
+
+  std::vector<Record> records;
+  records.reserve(line_segments.size());
+  for (const auto &l : line_segments) {
+    Record r = {float(l.start.x), float(l.start.y), float(l.end.x),
+                float(l.end.y)};
+    records.push_back(r);
+  }
+
+  std::string content(reinterpret_cast<const char *>(&header), sizeof(header));
+  content.append(reinterpret_cast<const char *>(records.data()),
+                 records.size() * sizeof(Record));
+  return content;
+}
+
+void LineSegmentsFile::Write(const std::string &path,
+                             const std::vector<LineSegment> &line_segments) {
+  std::string content = Serialize(line_segments);
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(content.data(), content.size());
+  if (out.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path));
+  }
+}
+
+void LineSegmentsFile::Open(const std::string &path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SegmentsHeader)) {
+    close(fd);
+    throw Exception("Flatland File: Invalid line segments file " + Q(path));
+  }
+
+  size_ = st.st_size;
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    size_ = 0;
+    throw Exception("Flatland File: Failed to map " + Q(path));
+  }
+
+  if (!IsValid(data_, size_)) {
+    Close();
+    throw Exception("Flatland File: Invalid line segments file " + Q(path));
+  }
+  records_ = reinterpret_cast<const Record *>(
+      static_cast<const char *>(data_) + sizeof(SegmentsHeader));
+  count_ = static_cast<const SegmentsHeader *>(data_)->count;
+}
+
+void LineSegmentsFile::Attach(const void *data, size_t size) {
+  Close();
+  if (!IsValid(data, size) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(SegmentsHeader) != 0) {
+    throw Exception("Flatland File: Invalid line segments data");
+  }
+  records_ = reinterpret_cast<const Record *>(static_cast<const char *>(data) +
+                                              sizeof(SegmentsHeader));
+  count_ = static_cast<const SegmentsHeader *>(data)->count;
+}
+};  // namespace flatland_server
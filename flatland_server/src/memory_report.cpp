@@ -0,0 +1,233 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 memory_report.cpp
+ * @brief	 Breakdown of the memory of a world by subsystem
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/debug_visualization.h>
+#include <flatland_server/layer.h>
+#include <flatland_server/layer_tiles.h>
+#include <flatland_server/memory_report.h>
+#include <flatland_server/model.h>
+#include <flatland_server/world.h>
+#include <ros/serialization.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace flatland_server {
+
+MemoryReport::MemoryReport(World *world) {
+  // the fixtures of the layers, including the active tiles
+  for (Layer *layer : world->layers_) {
+    std::vector<const b2Body *> bodies;
+    if (layer->body_ != nullptr) {
+      bodies.push_back(layer->body_->physics_body_);
+    }
+    if (layer->tiles_ != nullptr) {
+      for (b2Body *body : layer->tiles_->GetActiveBodies()) {
+        bodies.push_back(body);
+      }
+    }
+    uint64_t fixtures = 0, box2d_bytes = 0, bytes = 0;
+    for (const b2Body *body : bodies) {
+      bytes += BodyBytes(body, &fixtures, &box2d_bytes);
+    }
+    Add("layer", layer->name_, fixtures, bytes, box2d_bytes);
+  }
+
+  // the bodies and fixtures of the models
+  for (Model *model : world->models_) {
+    uint64_t fixtures = 0, box2d_bytes = 0, bytes = 0;
+    for (ModelBody *body : model->bodies_) {
+      bytes += BodyBytes(body->physics_body_, &fixtures, &box2d_bytes);
+    }
+    Add("model", model->name_, fixtures, bytes, box2d_bytes);
+  }
+
+  // the YAML retained by the models for their plugins
+  for (Model *model : world->models_) {
+    uint64_t nodes = 0;
+    uint64_t bytes = YamlBytes(model->plugins_reader_.node_, &nodes);
+    for (ModelBody *body : model->bodies_) {
+      bytes += YamlBytes(body->properties_, &nodes);
+    }
+    Add("yaml", model->name_, nodes, bytes);
+  }
+
+  // the parameters shared by the plugins of the instances of a template
+  PluginManager &plugin_manager = world->plugin_manager_;
+  {
+    std::lock_guard<std::mutex> lock(plugin_manager.template_configs_mutex_);
+    uint64_t nodes = 0, bytes = 0;
+    for (const auto &entry : plugin_manager.template_configs_) {
+      bytes += entry.first.capacity() + YamlBytes(entry.second, &nodes);
+    }
+    Add("yaml", "plugin templates", nodes, bytes);
+  }
+
+  // the plugins by type, with the buffers they report
+  std::map<std::string, std::pair<uint64_t, uint64_t>> plugins;
+  for (const auto &plugin : plugin_manager.model_plugins_) {
+    auto &entry = plugins[plugin->GetType()];
+    entry.first++;
+    entry.second += plugin->GetMemoryUsage();
+  }
+  for (const auto &plugin : plugin_manager.world_plugins_) {
+    auto &entry = plugins[plugin->GetType()];
+    entry.first++;
+    entry.second += plugin->GetMemoryUsage();
+  }
+  for (const auto &entry : plugins) {
+    Add("plugin", entry.first, entry.second.first, entry.second.second);
+  }
+
+  // the allocators of Box2D, the block allocator holds the bodies, fixtures,
+  // contacts and joints
+  b2BlockAllocatorStats allocator =
+      world->physics_world_->GetAllocatorStats();
+  Add("box2d", "block allocator", allocator.chunkCount + allocator.largeCount,
+      allocator.chunkBytes + allocator.largeBytes);
+  int32 stack = world->physics_world_->GetStackAllocatorMaxAllocation();
+  Add("box2d", "stack allocator", 1,
+      sizeof(b2StackAllocator) + std::max(0, stack - b2_stackSize));
+
+  // the markers kept to be republished, the size of their messages
+  for (const auto &topic : DebugVisualization::Get().topics_) {
+    Add("markers", topic.first, topic.second.markers.markers.size(),
+        ros::serialization::serializationLength(topic.second.markers));
+  }
+
+  // largest first within each subsystem, the subsystems stay in order
+  auto begin = entries_.begin();
+  while (begin != entries_.end()) {
+    const std::string &subsystem = begin->subsystem;
+    auto end = std::find_if(begin, entries_.end(), [&](const Entry &entry) {
+      return entry.subsystem != subsystem;
+    });
+    std::stable_sort(begin, end, [](const Entry &a, const Entry &b) {
+      return a.bytes > b.bytes;
+    });
+    begin = end;
+  }
+}
+
+uint64_t MemoryReport::GetTotalBytes() const {
+  uint64_t total = 0;
+  for (const Entry &entry : entries_) {
+    total += entry.bytes - entry.box2d_bytes;
+  }
+  return total;
+}
+
+uint64_t MemoryReport::BodyBytes(const b2Body *body, uint64_t *fixtures,
+                                 uint64_t *box2d_bytes) {
+  uint64_t block = sizeof(b2Body);
+  uint64_t heap = 0;
+  for (const b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    (*fixtures)++;
+    const b2Shape *shape = f->GetShape();
+    int32 children = shape->GetChildCount();
+    block += sizeof(b2Fixture) + children * sizeof(b2FixtureProxy);
+    switch (shape->GetType()) {
+      case b2Shape::e_circle:
+        block += sizeof(b2CircleShape);
+        break;
+      case b2Shape::e_edge:
+        block += sizeof(b2EdgeShape);
+        break;
+      case b2Shape::e_polygon:
+        block += sizeof(b2PolygonShape);
+        break;
+      case b2Shape::e_chain:
+        block += sizeof(b2ChainShape);
+        heap += static_cast<const b2ChainShape *>(shape)->m_count *
+                sizeof(b2Vec2);
+        break;
+      default:
+        break;
+    }
+    // the broadphase nodes of the proxies are in the arrays of the trees
+    if (body->IsActive()) {
+      heap += children * sizeof(b2TreeNode);
+    }
+  }
+  *box2d_bytes += block;
+  return block + heap;
+}
+
+uint64_t MemoryReport::YamlBytes(const YAML::Node &node, uint64_t *nodes) {
+  if (!node.IsDefined()) {
+    return 0;
+  }
+  (*nodes)++;
+  uint64_t bytes = sizeof(YAML::detail::node) +
+                   sizeof(YAML::detail::node_ref) +
+                   sizeof(YAML::detail::node_data) + node.Tag().capacity();
+  switch (node.Type()) {
+    case YAML::NodeType::Scalar:
+      bytes += node.Scalar().capacity();
+      break;
+    case YAML::NodeType::Sequence:
+      bytes += node.size() * sizeof(YAML::detail::node *);
+      for (const auto &child : node) {
+        bytes += YamlBytes(child, nodes);
+      }
+      break;
+    case YAML::NodeType::Map:
+      bytes += node.size() * 2 * sizeof(YAML::detail::node *);
+      for (const auto &pair : node) {
+        bytes += YamlBytes(pair.first, nodes) + YamlBytes(pair.second, nodes);
+      }
+      break;
+    default:
+      break;
+  }
+  return bytes;
+}
+
+void MemoryReport::Add(const std::string &subsystem, const std::string &name,
+                       uint64_t count, uint64_t bytes, uint64_t box2d_bytes) {
+  entries_.push_back(Entry{subsystem, name, count, bytes, box2d_bytes});
+}
+};  // namespace flatland_server
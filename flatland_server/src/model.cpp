@@ -59,6 +59,8 @@ Model::Model(b2World *physics_world, CollisionFilterRegistry *cfr,
       viz_name_("model/" + name_) {}
 
 Model::~Model() {
+  // the fixtures of the bodies are removed from the trees in one pass
+  BulkDestroy bulk(physics_world_);
   for (unsigned int i = 0; i < joints_.size(); i++) {
     delete joints_[i];
   }
@@ -79,18 +81,37 @@ Model *Model::MakeModel(b2World *physics_world, CollisionFilterRegistry *cfr,
                         const std::string &ns, const std::string &name) {
   YamlReader reader(model_yaml_path);
   reader.SetErrorInfo("model " + Q(name));
+  return MakeModel(physics_world, cfr, reader, model_yaml_path, ns, name);
+}
 
+Model *Model::MakeModel(b2World *physics_world, CollisionFilterRegistry *cfr,
+                        YamlReader &reader, const std::string &model_yaml_path,
+                        const std::string &ns, const std::string &name) {
   Model *m = new Model(physics_world, cfr, ns, name);
+  m->yaml_path_ = model_yaml_path;
 
   m->plugins_reader_ = reader.SubnodeOpt("plugins", YamlReader::LIST);
 
   try {
     YamlReader bodies_reader = reader.Subnode("bodies", YamlReader::LIST);
     YamlReader joints_reader = reader.SubnodeOpt("joints", YamlReader::LIST);
+    m->kinematic_ = reader.Get<bool>("kinematic", false);
+    m->group_ = reader.Get<std::string>("group", "");
+    m->self_collide_ = reader.Get<bool>("self_collide", true);
     reader.EnsureAccessedAllKeys();
+    if (m->group_.empty() && !m->self_collide_) {
+      throw YAMLException("Invalid \"self_collide\" in " + Q(name) +
+                          " model, self_collide requires a \"group\"");
+    }
 
     m->LoadBodies(bodies_reader);
     m->LoadJoints(joints_reader);
+    if (m->kinematic_) {
+      m->BypassSolver();
+    }
+    for (const auto &body : m->bodies_) {
+      m->initial_transforms_.push_back(body->physics_body_->GetTransform());
+    }
   } catch (const YAMLException &e) {
     delete m;
     throw e;
@@ -118,8 +139,7 @@ void Model::LoadBodies(YamlReader &bodies_reader) {
       bodies_.push_back(b);
 
       // ensure body is not a duplicate
-      if (std::count_if(bodies_.begin(), bodies_.end(),
-                        [&](Body *i) { return i->name_ == b->name_; }) > 1) {
+      if (!bodies_by_name_.insert(std::make_pair(b->name_, b)).second) {
         throw YAMLException("Invalid \"bodies\" in " + Q(name_) +
                             " model, body with name " + Q(b->name_) +
                             " already exists");
@@ -143,8 +163,7 @@ void Model::LoadJoints(YamlReader &joints_reader) {
       joints_.push_back(j);
 
       // ensure joint is not a duplicate
-      if (std::count_if(joints_.begin(), joints_.end(),
-                        [&](Joint *i) { return i->name_ == j->name_; }) > 1) {
+      if (!joints_by_name_.insert(std::make_pair(j->name_, j)).second) {
         throw YAMLException("Invalid \"joints\" in " + Q(name_) +
                             " model, joint with name " + Q(j->name_) +
                             " already exists");
@@ -153,22 +172,26 @@ void Model::LoadJoints(YamlReader &joints_reader) {
   }
 }
 
-ModelBody *Model::GetBody(const std::string &name) {
-  for (unsigned int i = 0; i < bodies_.size(); i++) {
-    if (bodies_[i]->name_ == name) {
-      return bodies_[i];
-    }
+void Model::BypassSolver() {
+  // the solver would be the only thing holding jointed bodies together
+  if (!joints_.empty()) {
+    throw YAMLException("Invalid \"kinematic\" in " + Q(name_) +
+                        " model, a kinematic model cannot have joints");
+  }
+
+  for (auto body : bodies_) {
+    body->physics_body_->SetSolverBypassed(true);
   }
-  return nullptr;
+}
+
+ModelBody *Model::GetBody(const std::string &name) {
+  auto it = bodies_by_name_.find(name);
+  return it != bodies_by_name_.end() ? it->second : nullptr;
 }
 
 Joint *Model::GetJoint(const std::string &name) {
-  for (unsigned int i = 0; i < joints_.size(); i++) {
-    if (joints_[i]->name_ == name) {
-      return joints_[i];
-    }
-  }
-  return nullptr;
+  auto it = joints_by_name_.find(name);
+  return it != joints_by_name_.end() ? it->second : nullptr;
 }
 
 const std::vector<ModelBody *> &Model::GetBodies() { return bodies_; }
@@ -217,17 +240,62 @@ void Model::SetPose(const Pose &pose) {
                                 bodies_[0]->physics_body_->GetAngle());
 
   // Inverse transform all bodies by this to reset their poses
+  GetPositions();
+  Geometry::InverseTransformPoints(root_body_transform, positions_.data(),
+                                   positions_.size(), positions_.data());
   for (unsigned int i = 0; i < bodies_.size(); i++) {
-    bodies_[i]->physics_body_->SetTransform(
-        Geometry::InverseTransform(bodies_[i]->physics_body_->GetPosition(),
-                                   root_body_transform),
-        0.0);
+    bodies_[i]->physics_body_->SetTransform(positions_[i], 0.0);
   }
 
   // Apply new desired pose in world coordinates
   TransformAll(pose);
 }
 
+void Model::Park() {
+  for (const auto &body : bodies_) {
+    body->physics_body_->SetActive(false);
+  }
+  DebugVisualization::Get().Reset(viz_name_);
+}
+
+void Model::Reuse(const std::string &ns, const std::string &name,
+                  const Pose &pose) {
+  name_ = name;
+  namespace_ = ns;
+  viz_name_ = "model/" + name_;
+  viz_dirty_ = true;
+
+  for (unsigned int i = 0; i < bodies_.size(); i++) {
+    b2Body *b = bodies_[i]->physics_body_;
+    const b2Transform &t = initial_transforms_[i];
+    b->SetTransform(t.p, t.q.GetAngle());
+    b->SetLinearVelocity(b2Vec2(0, 0));
+    b->SetAngularVelocity(0);
+    b->SetActive(true);
+    b->SetAwake(true);
+  }
+  TransformAll(pose);
+}
+
+bool Model::IsAwake() const {
+  for (const auto &body : bodies_) {
+    const b2Body *b = body->physics_body_;
+    if (b->GetType() != b2_staticBody && b->IsAwake()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Model::SetAwake(bool awake) {
+  for (const auto &body : bodies_) {
+    b2Body *b = body->physics_body_;
+    if (b->GetType() != b2_staticBody) {
+      b->SetAwake(awake);
+    }
+  }
+}
+
 void Model::TransformAll(const Pose &pose_delta) {
   //     --                --   --                --
   //     | cos(a) -sin(a) x |   | cos(b) -sin(b) u |
@@ -243,27 +311,100 @@ void Model::TransformAll(const Pose &pose_delta) {
   RotateTranslate tf =
       Geometry::CreateTransform(pose_delta.x, pose_delta.y, pose_delta.theta);
 
+  // the positions are transformed in one batch
+  GetPositions();
+  Geometry::TransformPoints(tf, positions_.data(), positions_.size(),
+                            positions_.data());
+  for (unsigned int i = 0; i < bodies_.size(); i++) {
+    b2Body *body = bodies_[i]->physics_body_;
+    body->SetTransform(positions_[i], body->GetAngle() + pose_delta.theta);
+  }
+
+  // the plugins skipped while the model is asleep see the new pose
+  SetAwake(true);
+}
+
+void Model::GetPositions() {
+  positions_.resize(bodies_.size());
   for (unsigned int i = 0; i < bodies_.size(); i++) {
-    bodies_[i]->physics_body_->SetTransform(
-        Geometry::Transform(bodies_[i]->physics_body_->GetPosition(), tf),
-        bodies_[i]->physics_body_->GetAngle() + pose_delta.theta);
+    positions_[i] = bodies_[i]->physics_body_->GetPosition();
   }
 }
 
 void Model::DebugVisualize() const {
-  DebugVisualization::Get().Reset(viz_name_);
+  DebugVisualization &viz = DebugVisualization::Get();
+  if (DebugVisualization::IsHeadless()) return;
+
+  // nothing is built while nobody watches the model, the markers are built,
+  // or moved to the current poses, once a subscriber connects
+  if (!viz.HasSubscribers(viz_name_)) return;
+
+  bool moved = false;
+  if (viz_dirty_ || viz_bodies_.size() != bodies_.size() ||
+      viz.MarkerCount(viz_name_) < viz_joints_first_) {
+    // the shapes of the bodies do not change, so their markers are only
+    // built once
+    viz.Reset(viz_name_);
+    viz_bodies_.clear();
+    for (const auto &body : bodies_) {
+      b2Body *b = body->physics_body_;
+      BodyMarkers markers;
+      markers.first = viz.MarkerCount(viz_name_);
+      markers.count =
+          viz.VisualizeMovable(viz_name_, b, body->color_.r, body->color_.g,
+                               body->color_.b, body->color_.a);
+      markers.position = b->GetPosition();
+      markers.angle = b->GetAngle();
+      viz_bodies_.push_back(markers);
+    }
+    viz_joints_first_ = viz.MarkerCount(viz_name_);
+    viz_dirty_ = false;
+    moved = true;
+  } else {
+    for (unsigned int i = 0; i < bodies_.size(); i++) {
+      b2Body *b = bodies_[i]->physics_body_;
+      BodyMarkers &markers = viz_bodies_[i];
+      if (b->GetPosition() != markers.position ||
+          b->GetAngle() != markers.angle) {
+        viz.MoveBody(viz_name_, markers.first, markers.count, b);
+        markers.position = b->GetPosition();
+        markers.angle = b->GetAngle();
+        moved = true;
+      }
+    }
+  }
 
-  for (const auto &body : bodies_) {
-    DebugVisualization::Get().Visualize(viz_name_, body->physics_body_,
-                                        body->color_.r, body->color_.g,
-                                        body->color_.b, body->color_.a);
+  // the joints are drawn in the world frame between the bodies, they are
+  // rebuilt when any body moved
+  if (moved && !joints_.empty()) {
+    viz.Truncate(viz_name_, viz_joints_first_);
+    viz.VisualizeJoints(viz_name_, GetJointStates());
   }
+}
 
+const std::vector<JointState> &Model::GetJointStates() const {
+  bool moved = joint_states_dirty_ ||
+               joint_states_transforms_.size() != bodies_.size() ||
+               joint_states_.size() != joints_.size();
+  for (unsigned int i = 0; !moved && i < bodies_.size(); i++) {
+    const b2Transform &a = bodies_[i]->physics_body_->GetTransform();
+    const b2Transform &b = joint_states_transforms_[i];
+    moved = a.p != b.p || a.q.s != b.q.s || a.q.c != b.q.c;
+  }
+  if (!moved) {
+    return joint_states_;
+  }
+
+  joint_states_transforms_.clear();
+  for (const auto &body : bodies_) {
+    joint_states_transforms_.push_back(body->physics_body_->GetTransform());
+  }
+  joint_states_.clear();
   for (const auto &joint : joints_) {
-    DebugVisualization::Get().Visualize(viz_name_, joint->physics_joint_,
-                                        joint->color_.r, joint->color_.g,
-                                        joint->color_.b, joint->color_.a);
+    joint_states_.push_back(joint->GetState());
   }
+  joint_states_dirty_ = false;
+  return joint_states_;
 }
 
 void Model::DebugOutput() const {
@@ -45,11 +45,63 @@
  */
 
 #include <flatland_server/exceptions.h>
+#include <flatland_server/geometry.h>
 #include <flatland_server/model_body.h>
 #include <boost/algorithm/string/join.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 
 namespace flatland_server {
 
+namespace {
+
+typedef std::vector<std::vector<b2Vec2>> Decomposition;
+
+/**
+ * Decompositions of the concave footprints, every instance of a model
+ * template has the same points so spawning it again is only a lookup. An
+ * empty decomposition is stored for invalid polygons.
+ */
+std::shared_ptr<const Decomposition> GetDecomposition(
+    const std::vector<b2Vec2> &points) {
+  static std::mutex mutex;
+  static std::map<std::vector<float>, std::shared_ptr<const Decomposition>>
+      cache;
+
+  std::vector<float> key;
+  key.reserve(2 * points.size());
+  for (const auto &p : points) {
+    key.push_back(p.x);
+    key.push_back(p.y);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    return it->second;
+  }
+
+  auto pieces = std::make_shared<Decomposition>();
+  if (!Geometry::DecomposePolygon(points, b2_maxPolygonVertices,
+                                  pieces.get())) {
+    pieces->clear();
+  }
+  cache[key] = pieces;
+  return pieces;
+}
+
+/// Twice the signed area of a counterclockwise polygon
+float DoubleArea(const std::vector<b2Vec2> &polygon) {
+  float area = 0;
+  for (size_t i = 0; i < polygon.size(); i++) {
+    area += b2Cross(polygon[i], polygon[(i + 1) % polygon.size()]);
+  }
+  return area;
+}
+
+};  // namespace
+
 ModelBody::ModelBody(b2World *physics_world, CollisionFilterRegistry *cfr,
                      Model *model, const std::string &name, const Color &color,
                      const Pose &pose, b2BodyType body_type,
@@ -72,6 +124,8 @@ ModelBody *ModelBody::MakeBody(b2World *physics_world,
   std::string type_str = body_reader.Get<std::string>("type", "dynamic");
   double linear_damping = body_reader.Get("linear_damping", 0.0);
   double angular_damping = body_reader.Get("angular_damping", 0.0);
+  bool bullet = body_reader.Get("bullet", false);
+  bool continuous = body_reader.Get("continuous", false);
 
   b2BodyType type;
   if (type_str == "static") {
@@ -90,6 +144,8 @@ ModelBody *ModelBody::MakeBody(b2World *physics_world,
   ModelBody *m =
       new ModelBody(physics_world, cfr, model, name, color, pose, type,
                     YAML::Node(), linear_damping, angular_damping);
+  m->physics_body_->SetBullet(bullet);
+  m->physics_body_->SetContinuous(continuous);
 
   try {
     YamlReader footprints_node =
@@ -157,6 +213,36 @@ void ModelBody::ConfigFootprintDef(YamlReader &footprint_reader,
     // "I will collide with nothing"
     fixture_def.filter.maskBits = 0;
   }
+
+  // a ModelBody always belongs to a Model
+  const Model *model = static_cast<const Model *>(entity_);
+  std::string group =
+      footprint_reader.Get<std::string>("group", model->group_);
+  bool self_collide =
+      footprint_reader.Get<bool>("self_collide", model->self_collide_);
+  if (group.empty() || !collision) {
+    // without collision, a group would override the empty mask
+    return;
+  }
+
+  // Box2D never creates the contacts of two fixtures in the same no collide
+  // group, the pairs are dropped when the broadphase finds them
+  int group_index = cfr_->RegisterGroup(group, self_collide);
+  if (group_index == 0) {
+    throw YAMLException("Invalid footprint \"group\" in " +
+                        footprint_reader.entry_location_ + " " +
+                        footprint_reader.entry_name_ + ", more than " +
+                        std::to_string(CollisionFilterRegistry::MAX_GROUPS) +
+                        " groups");
+  }
+  if ((group_index > 0) != self_collide) {
+    throw YAMLException(
+        "Invalid footprint \"self_collide\" in " +
+        footprint_reader.entry_location_ + " " + footprint_reader.entry_name_ +
+        ", group " + Q(group) + " is used with self_collide " +
+        (group_index > 0 ? "true" : "false") + " already");
+  }
+  fixture_def.filter.groupIndex = group_index;
 }
 
 void ModelBody::LoadCircleFootprint(YamlReader &footprint_reader) {
@@ -176,15 +262,36 @@ void ModelBody::LoadCircleFootprint(YamlReader &footprint_reader) {
 
 void ModelBody::LoadPolygonFootprint(YamlReader &footprint_reader) {
   std::vector<b2Vec2> points =
-      footprint_reader.GetList<b2Vec2>("points", 3, b2_maxPolygonVertices);
+      footprint_reader.GetList<b2Vec2>("points", 3, -1);
 
   b2FixtureDef fixture_def;
   ConfigFootprintDef(footprint_reader, fixture_def);
 
   b2PolygonShape shape;
-  shape.Set(points.data(), points.size());
-
   fixture_def.shape = &shape;
-  physics_body_->CreateFixture(&fixture_def);
+
+  if (points.size() <= b2_maxPolygonVertices && Geometry::IsConvex(points)) {
+    shape.Set(points.data(), points.size());
+    physics_body_->CreateFixture(&fixture_def);
+    return;
+  }
+
+  // concave or too many vertices for Box2D, one fixture per convex piece
+  std::shared_ptr<const Decomposition> pieces = GetDecomposition(points);
+  if (pieces->empty()) {
+    throw YAMLException("Invalid footprint \"points\" in " +
+                        footprint_reader.entry_location_ + " " +
+                        footprint_reader.entry_name_ +
+                        ", polygon is degenerate or intersects itself");
+  }
+
+  for (const auto &piece : *pieces) {
+    // slivers left by nearly collinear vertices would be welded away by Box2D
+    if (DoubleArea(piece) < 2 * b2_linearSlop * b2_linearSlop) {
+      continue;
+    }
+    shape.Set(piece.data(), piece.size());
+    physics_body_->CreateFixture(&fixture_def);
+  }
 }
 };
@@ -45,11 +45,50 @@
  */
 
 #include <flatland_server/model_plugin.h>
+#include <flatland_server/recorder.h>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
 
 namespace flatland_server {
 
+namespace {
+/// the structs of ModelPlugin::SharedConfig by type and config key, weak so
+/// that they are freed with their last plugin
+std::map<std::pair<std::type_index, std::string>, std::weak_ptr<const void>>
+    shared_configs;
+std::mutex shared_configs_mutex;  ///< plugins are prepared on any thread
+}
+
 Model *ModelPlugin::GetModel() { return model_; }
 
+std::shared_ptr<const void> ModelPlugin::FindSharedConfig(
+    const std::type_index &type) {
+  if (config_key_.empty()) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(shared_configs_mutex);
+  auto it = shared_configs.find(std::make_pair(type, config_key_));
+  if (it == shared_configs.end()) {
+    return nullptr;
+  }
+  std::shared_ptr<const void> shared = it->second.lock();
+  if (!shared) {
+    shared_configs.erase(it);
+  }
+  return shared;
+}
+
+void ModelPlugin::StoreSharedConfig(const std::type_index &type,
+                                    const std::shared_ptr<const void> &parsed) {
+  if (config_key_.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(shared_configs_mutex);
+  shared_configs[std::make_pair(type, config_key_)] = parsed;
+}
+
 void ModelPlugin::Initialize(const std::string &type, const std::string &name,
                              Model *model, const YAML::Node &config) {
   type_ = type;
@@ -60,6 +99,41 @@ void ModelPlugin::Initialize(const std::string &type, const std::string &name,
   OnInitialize(config);
 }
 
+void ModelPlugin::SetUpdateRate(double rate) {
+  // same conventions as the UpdateTimer of flatland_plugins, a rate of 0
+  // updates once
+  update_period_ = rate > 0 ? 1.0 / rate : INT32_MAX;
+  if (update_period_ < 1e-5) {
+    update_period_ = 0;
+  }
+}
+
+double ModelPlugin::FirstUpdateTime() const {
+  // a rate of 0 updates once, at the phase
+  if (update_period_ >= INT32_MAX) {
+    return fmod(update_phase_, update_period_);
+  }
+  return fmod(update_phase_ + update_stagger_ * update_period_,
+              update_period_);
+}
+
+double ModelPlugin::StaggerFraction(const std::string &key) {
+  // FNV-1a, std::hash may differ between standard libraries
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : key) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  // the top 53 bits fit the mantissa of a double
+  return (hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint32_t ModelPlugin::RandomSeed() {
+  // model names are unique within a world, the namespace tells the worlds
+  // apart
+  return Recorder::Get().Seed("seed:" + model_->namespace_ + "/" +
+                              model_->GetName() + "/" + name_);
+}
+
 bool ModelPlugin::FilterContact(b2Contact *contact, Entity *&entity,
                                 b2Fixture *&this_fixture,
                                 b2Fixture *&other_fixture) {
@@ -0,0 +1,128 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 model_states_publisher.cpp
+ * @brief	 Publishes the states of all models of a world in one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/model_states_publisher.h>
+#include <flatland_server/world.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+ModelStatesPublisher::ModelStatesPublisher(World *world, double rate)
+    : world_(world), period_(1.0 / rate) {
+  ros::NodeHandle nh(world_->namespace_);
+  publisher_ = nh.advertise<flatland_msgs::ModelStates>("model_states", 1);
+}
+
+void ModelStatesPublisher::AfterStep(const ros::Time &time) {
+  double t = time.toSec();
+  if (t < next_time_) {
+    return;
+  }
+  next_time_ = std::max(next_time_ + period_, t);
+  if (publisher_.getNumSubscribers() == 0) {
+    return;
+  }
+
+  // a model added or deleted adds or removes bodies
+  const BodyStates &states = world_->plugin_manager_.body_states_;
+  if (stale_ || generation_ != states.generation_) {
+    models_.clear();
+    for (const Model *model : world_->models_) {
+      if (!model->bodies_.empty()) {
+        models_.push_back(model);
+      }
+    }
+    msg_.names.clear();
+    generation_ = states.generation_;
+    stale_ = false;
+  }
+  Collect(states, models_, time, &msg_);
+  publisher_.publish(msg_);
+}
+
+void ModelStatesPublisher::Collect(const BodyStates &states,
+                                   const std::vector<const Model *> &models,
+                                   const ros::Time &time,
+                                   flatland_msgs::ModelStates *msg) {
+  size_t count = models.size();
+  msg->header.stamp = time;
+  // the names are only filled when the models change
+  if (msg->names.size() != count) {
+    msg->names.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      msg->names[i] = models[i]->GetName();
+    }
+  }
+  msg->x.resize(count);
+  msg->y.resize(count);
+  msg->theta.resize(count);
+  msg->vx.resize(count);
+  msg->vy.resize(count);
+  msg->omega.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    const Body *body = models[i]->bodies_[0];
+    int j = body->state_index_;
+    if (j < 0) {
+      Pose pose = states.GetPose(body);
+      b2Vec2 v = states.GetLinearVelocity(body);
+      msg->x[i] = pose.x;
+      msg->y[i] = pose.y;
+      msg->theta[i] = pose.theta;
+      msg->vx[i] = v.x;
+      msg->vy[i] = v.y;
+      msg->omega[i] = states.GetAngularVelocity(body);
+      continue;
+    }
+    msg->x[i] = states.x_[j];
+    msg->y[i] = states.y_[j];
+    msg->theta[i] = states.angle_[j];
+    msg->vx[i] = states.vx_[j];
+    msg->vy[i] = states.vy_[j];
+    msg->omega[i] = states.omega_[j];
+  }
+}
+
+};  // namespace flatland_server
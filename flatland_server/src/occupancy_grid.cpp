@@ -0,0 +1,262 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 occupancy_grid.cpp
+ * @brief	 Packed occupancy grid with grid traversal raycasting
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/occupancy_grid.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace flatland_server {
+
+namespace {
+
+/**
+ * @brief Squared Euclidean distance transform of a sampled function in one
+ * dimension, by the lower envelope of parabolas of Felzenszwalb and
+ * Huttenlocher
+ * @param[in] f The function, n values
+ * @param[in] n Number of values
+ * @param[out] d The distances, n values
+ * @param[in] v Scratch space of n values
+ * @param[in] z Scratch space of n + 1 values
+ */
+void DistanceTransform1D(const double *f, int n, double *d, int *v,
+                         double *z) {
+  const double inf = std::numeric_limits<double>::infinity();
+  int k = 0;
+  v[0] = 0;
+  z[0] = -inf;
+  z[1] = inf;
+  for (int q = 1; q < n; q++) {
+    double s;
+    for (;;) {
+      int p = v[k];
+      s = ((f[q] + double(q) * q) - (f[p] + double(p) * p)) / (2.0 * (q - p));
+      if (s > z[k] || k == 0) break;
+      k--;
+    }
+    if (s <= z[k]) s = z[k];
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = inf;
+  }
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q) k++;
+    double r = q - v[k];
+    d[q] = r * r + f[v[k]];
+  }
+}
+};  // namespace
+
+const unsigned int OccupancyGrid::MAX_DISTANCE;
+
+OccupancyGrid::OccupancyGrid(unsigned int width, unsigned int height,
+                             double resolution)
+    : width_(width),
+      height_(height),
+      resolution_(resolution),
+      words_per_row_((width + 63) / 64),
+      bits_(words_per_row_ * height, 0) {}
+
+void OccupancyGrid::SetOccupied(unsigned int x, unsigned int y,
+                                bool occupied) {
+  uint64_t &word = bits_[y * words_per_row_ + (x >> 6)];
+  uint64_t mask = uint64_t(1) << (x & 63);
+  if (occupied) {
+    word |= mask;
+  } else {
+    word &= ~mask;
+  }
+}
+
+void OccupancyGrid::SetData(const uint64_t *data) {
+  std::copy(data, data + bits_.size(), bits_.begin());
+}
+
+void OccupancyGrid::BuildDistanceField() {
+  // a large finite value instead of infinity, the parabolas of free cells
+  // are subtracted from each other
+  const double far = 1e20;
+  int w = width_, h = height_;
+  int n = std::max(w, h);
+  std::vector<double> squared(width_ * height_);
+  std::vector<double> f(n), d(n), z(n + 1);
+  std::vector<int> v(n);
+
+  // the columns first, then the rows of the column results
+  for (int x = 0; x < w; x++) {
+    for (int y = 0; y < h; y++) f[y] = IsOccupied(x, y) ? 0 : far;
+    DistanceTransform1D(f.data(), h, d.data(), v.data(), z.data());
+    for (int y = 0; y < h; y++) squared[y * w + x] = d[y];
+  }
+  distance_.resize(width_ * height_);
+  for (int y = 0; y < h; y++) {
+    DistanceTransform1D(&squared[y * w], w, d.data(), v.data(), z.data());
+    for (int x = 0; x < w; x++) {
+      double distance = std::floor(std::sqrt(d[x]));
+      distance_[y * w + x] =
+          distance >= MAX_DISTANCE ? MAX_DISTANCE : (uint16_t)distance;
+    }
+  }
+}
+
+bool OccupancyGrid::RayCast(const b2Vec2 &p1, const b2Vec2 &p2,
+                            float *fraction) const {
+  const double inf = std::numeric_limits<double>::infinity();
+  double dx = p2.x - p1.x;
+  double dy = p2.y - p1.y;
+
+  // clip the ray against the bounds of the grid, [t0, t1] is the part of the
+  // ray inside of the grid
+  double t0 = 0, t1 = 1;
+  double lo[2] = {0, 0};
+  double hi[2] = {width_ * resolution_, height_ * resolution_};
+  double o[2] = {p1.x, p1.y};
+  double d[2] = {dx, dy};
+
+  for (int k = 0; k < 2; k++) {
+    if (d[k] == 0) {
+      if (o[k] < lo[k] || o[k] > hi[k]) {
+        return false;
+      }
+    } else {
+      double ta = (lo[k] - o[k]) / d[k];
+      double tb = (hi[k] - o[k]) / d[k];
+      if (ta > tb) std::swap(ta, tb);
+      t0 = std::max(t0, ta);
+      t1 = std::min(t1, tb);
+    }
+  }
+
+  if (t0 > t1) {
+    return false;
+  }
+
+  // the cell where the traversal starts, clamped to counter rounding errors
+  int x = std::floor((p1.x + t0 * dx) / resolution_);
+  int y = std::floor((p1.y + t0 * dy) / resolution_);
+  x = std::min(std::max(x, 0), (int)width_ - 1);
+  y = std::min(std::max(y, 0), (int)height_ - 1);
+
+  int step_x = dx > 0 ? 1 : -1;
+  int step_y = dy > 0 ? 1 : -1;
+  double t_delta_x = dx != 0 ? resolution_ / std::fabs(dx) : inf;
+  double t_delta_y = dy != 0 ? resolution_ / std::fabs(dy) : inf;
+  double t_max_x =
+      dx != 0 ? ((x + (dx > 0 ? 1 : 0)) * resolution_ - p1.x) / dx : inf;
+  double t_max_y =
+      dy != 0 ? ((y + (dy > 0 ? 1 : 0)) * resolution_ - p1.y) / dy : inf;
+
+  // a ray starting outside of the grid starts in free space, otherwise the
+  // ray hits when it leaves the region of the starting cell's state
+  bool start_state = t0 == 0 ? IsOccupied(x, y) : false;
+  if (IsOccupied(x, y) != start_state) {
+    *fraction = t0;
+    return true;
+  }
+
+  double length = std::sqrt(dx * dx + dy * dy);
+  bool skip = !start_state && !distance_.empty() && length > 0;
+  double t_cell = t0;  // where the ray entered the current cell
+
+  for (;;) {
+    // in free space, the point the ray entered the current cell at is at
+    // least the distance of the cell minus the diagonal of a cell away from
+    // any occupied cell, so the ray is advanced by that much at once. The
+    // traversal then resumes from the free cell it lands in
+    if (skip) {
+      unsigned int clearance = distance_[y * width_ + x];
+      if (clearance >= 3) {
+        t_cell += (clearance - 1.5) * resolution_ / length;
+        if (t_cell > 1) {
+          return false;
+        }
+        x = std::floor((p1.x + t_cell * dx) / resolution_);
+        y = std::floor((p1.y + t_cell * dy) / resolution_);
+        // the grid is convex, a ray that left it does not come back
+        if (x < 0 || y < 0 || x >= (int)width_ || y >= (int)height_) {
+          return false;
+        }
+        t_max_x =
+            dx != 0 ? ((x + (dx > 0 ? 1 : 0)) * resolution_ - p1.x) / dx : inf;
+        t_max_y =
+            dy != 0 ? ((y + (dy > 0 ? 1 : 0)) * resolution_ - p1.y) / dy : inf;
+        continue;
+      }
+    }
+
+    double t;
+    if (t_max_x < t_max_y) {
+      t = t_max_x;
+      x += step_x;
+      t_max_x += t_delta_x;
+    } else {
+      t = t_max_y;
+      y += step_y;
+      t_max_y += t_delta_y;
+    }
+
+    t_cell = t;
+
+    // the full ray is traversed instead of stopping at t1, a ray starting in
+    // an occupied cell hits the border of the grid when leaving it
+    if (t > 1) {
+      return false;
+    }
+
+    if (IsOccupied(x, y) != start_state) {
+      *fraction = t;
+      return true;
+    }
+
+    if (x < 0 || y < 0 || x >= (int)width_ || y >= (int)height_) {
+      return false;
+    }
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,126 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 odometry_aggregator.cpp
+ * @brief	 Collects the odometry of the drive plugins into one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "flatland_server/odometry_aggregator.h"
+#include <flatland_server/counted_publish.h>
+#include <ros/ros.h>
+
+namespace flatland_server {
+
+bool OdometryAggregator::enabled_ = false;
+
+OdometryAggregator::OdometryAggregator() {
+  publisher_ =
+      node_.advertise<flatland_msgs::FleetOdometry>("/fleet_odometry", 10);
+  joints_publisher_ = node_.advertise<flatland_msgs::FleetJointStates>(
+      "/fleet_joint_states", 10);
+}
+
+OdometryAggregator& OdometryAggregator::Get() {
+  static OdometryAggregator instance;
+  return instance;
+}
+
+void OdometryAggregator::SetEnabled(bool enabled) { enabled_ = enabled; }
+
+bool OdometryAggregator::IsEnabled() { return enabled_; }
+
+void OdometryAggregator::Send(const flatland_msgs::RobotOdometry& odometry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = slots_.find(odometry.child_frame_id);
+  if (it == slots_.end()) {
+    // a slot per robot, so that the steady state does not allocate
+    slots_[odometry.child_frame_id] = latest_.size();
+    latest_.push_back(odometry);
+    dirty_.push_back(true);
+    return;
+  }
+  latest_[it->second] = odometry;
+  dirty_[it->second] = true;
+}
+
+void OdometryAggregator::Send(const flatland_msgs::ModelJointStates& joints) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = joint_slots_.find(joints.model);
+  if (it == joint_slots_.end()) {
+    joint_slots_[joints.model] = latest_joints_.size();
+    latest_joints_.push_back(joints);
+    dirty_joints_.push_back(true);
+    return;
+  }
+  // the arrays keep their capacity, the names are the same every time
+  latest_joints_[it->second] = joints;
+  dirty_joints_[it->second] = true;
+}
+
+void OdometryAggregator::Publish(const ros::Time& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  message_.robots.clear();
+  for (size_t i = 0; i < latest_.size(); i++) {
+    if (dirty_[i]) {
+      message_.robots.push_back(latest_[i]);
+      dirty_[i] = false;
+    }
+  }
+  if (!message_.robots.empty() && publisher_.getNumSubscribers() > 0) {
+    message_.header.stamp = now;
+    PublishCounted(publisher_, message_);
+  }
+
+  joints_message_.models.clear();
+  for (size_t i = 0; i < latest_joints_.size(); i++) {
+    if (dirty_joints_[i]) {
+      joints_message_.models.push_back(latest_joints_[i]);
+      dirty_joints_[i] = false;
+    }
+  }
+  if (!joints_message_.models.empty() &&
+      joints_publisher_.getNumSubscribers() > 0) {
+    joints_message_.header.stamp = now;
+    PublishCounted(joints_publisher_, joints_message_);
+  }
+}
+}
@@ -0,0 +1,151 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 perf_counters.cpp
+ * @brief	 Hardware performance counters of the calling thread
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/perf_counters.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace flatland_server {
+
+PerfCounters::Sample &PerfCounters::Sample::operator+=(const Sample &other) {
+  cycles += other.cycles;
+  instructions += other.instructions;
+  llc_misses += other.llc_misses;
+  return *this;
+}
+
+PerfCounters::Sample PerfCounters::Sample::operator-(
+    const Sample &other) const {
+  Sample difference;
+  difference.cycles = cycles - other.cycles;
+  difference.instructions = instructions - other.instructions;
+  difference.llc_misses = llc_misses - other.llc_misses;
+  return difference;
+}
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < 3; i++) {
+    fds_[i] = -1;
+    ids_[i] = 0;
+  }
+}
+
+PerfCounters::~PerfCounters() { Close(); }
+
+bool PerfCounters::Open() {
+  Close();
+
+  // PERF_COUNT_HW_CACHE_MISSES are the misses of the last level cache on
+  // the common PMUs
+  const uint64_t configs[3] = {PERF_COUNT_HW_CPU_CYCLES,
+                               PERF_COUNT_HW_INSTRUCTIONS,
+                               PERF_COUNT_HW_CACHE_MISSES};
+  for (int i = 0; i < 3; i++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.disabled = i == 0;  // the group starts with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+    // the calling thread, on any CPU
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, fds_[0], 0);
+    if (fd < 0) {
+      error_ = std::string("perf_event_open failed: ") + std::strerror(errno);
+      Close();
+      return false;
+    }
+    fds_[i] = fd;
+    ioctl(fd, PERF_EVENT_IOC_ID, &ids_[i]);
+  }
+
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  owner_ = std::this_thread::get_id();
+  error_.clear();
+  return true;
+}
+
+void PerfCounters::Close() {
+  for (int i = 0; i < 3; i++) {
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+    }
+    fds_[i] = -1;
+  }
+  owner_ = std::thread::id();
+}
+
+void PerfCounters::Read(Sample *sample) const {
+  *sample = Sample();
+  if (!IsOpen()) {
+    return;
+  }
+
+  // the number of counters, then a value and an id per counter
+  uint64_t data[1 + 2 * 3];
+  if (read(fds_[0], data, sizeof(data)) < ssize_t(sizeof(uint64_t))) {
+    return;
+  }
+  for (uint64_t i = 0; i < data[0] && i < 3; i++) {
+    uint64_t value = data[1 + 2 * i], id = data[2 + 2 * i];
+    if (id == ids_[0]) {
+      sample->cycles = value;
+    } else if (id == ids_[1]) {
+      sample->instructions = value;
+    } else if (id == ids_[2]) {
+      sample->llc_misses = value;
+    }
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,203 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_backend.cpp
+ * @brief	 Interface of the physics engine of a world
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/physics_backend.h>
+#include <flatland_server/physics_executor.h>
+
+namespace flatland_server {
+
+std::unique_ptr<PhysicsBackend> PhysicsBackend::Create(const std::string &name,
+                                                       b2World *world) {
+  if (name == "box2d") {
+    return std::unique_ptr<PhysicsBackend>(new Box2DBackend(world));
+  }
+
+  std::string names;
+  for (const auto &n : GetBackendNames()) {
+    names += (names.empty() ? "" : ", ") + n;
+  }
+  throw Exception("Flatland PhysicsBackend: unknown backend \"" + name +
+                  "\", the backends are " + names);
+}
+
+std::vector<std::string> PhysicsBackend::GetBackendNames() {
+  return {"box2d"};
+}
+
+Box2DBackend::Box2DBackend(b2World *world) : world_(world) {}
+
+Box2DBackend::~Box2DBackend() = default;
+
+void Box2DBackend::SetIterations(int velocity_iterations,
+                                 int position_iterations) {
+  velocity_iterations_ = velocity_iterations;
+  position_iterations_ = position_iterations;
+}
+
+void Box2DBackend::SetThreads(unsigned int threads) {
+  // the executor in use must outlive the world stepping with it
+  world_->SetTaskExecutor(nullptr);
+  executor_.reset(threads > 0 ? new PhysicsExecutor(threads) : nullptr);
+  world_->SetTaskExecutor(executor_.get());
+}
+
+void Box2DBackend::Step(double step_size) {
+  world_->Step(step_size, velocity_iterations_, position_iterations_);
+  toi_events_ += world_->GetStepStats().toiEventCount;
+}
+
+PhysicsBackend::Stats Box2DBackend::GetStats() const {
+  Stats stats;
+  stats.bodies = world_->GetBodyCount();
+  for (const b2Body *b = world_->GetBodyList(); b; b = b->GetNext()) {
+    if (b->GetType() != b2_staticBody && b->IsAwake()) {
+      stats.awake_bodies++;
+    }
+    for (const b2Fixture *f = b->GetFixtureList(); f; f = f->GetNext()) {
+      stats.fixtures++;
+    }
+  }
+  stats.proxies = world_->GetProxyCount();
+  stats.static_proxies = world_->GetStaticProxyCount();
+  stats.tree_height = world_->GetTreeHeight();
+  stats.tree_balance = world_->GetTreeBalance();
+  stats.tree_quality = world_->GetTreeQuality();
+  stats.static_tree_height = world_->GetStaticTreeHeight();
+  stats.contacts = world_->GetContactCount();
+  for (const b2Contact *c = world_->GetContactList(); c; c = c->GetNext()) {
+    if (c->IsTouching()) {
+      stats.touching_contacts++;
+    }
+  }
+  stats.step = world_->GetStepStats();
+  stats.toi_events = toi_events_;
+  return stats;
+}
+
+b2Transform Box2DBackend::GetTransform(const Body *body) const {
+  return body->physics_body_->GetTransform();
+}
+
+void Box2DBackend::SetTransform(Body *body, const b2Transform &transform) {
+  body->physics_body_->SetTransform(transform.p, transform.q.GetAngle());
+}
+
+b2Vec2 Box2DBackend::GetLinearVelocity(const Body *body) const {
+  return body->physics_body_->GetLinearVelocity();
+}
+
+float Box2DBackend::GetAngularVelocity(const Body *body) const {
+  return body->physics_body_->GetAngularVelocity();
+}
+
+void Box2DBackend::SetVelocity(Body *body, const b2Vec2 &linear,
+                               float angular) {
+  body->physics_body_->SetLinearVelocity(linear);
+  body->physics_body_->SetAngularVelocity(angular);
+}
+
+void Box2DBackend::RayCast(const b2RayCastInput *inputs, unsigned int count,
+                           uint32_t mask, RayHit *hits) const {
+  b2RayBatchFilter filter;
+  filter.maskBits = mask;
+
+  std::vector<b2RayBatchHit> batch_hits(count);
+  world_->RayCastBatch(inputs, count, filter, batch_hits.data());
+  for (unsigned int i = 0; i < count; i++) {
+    const b2RayBatchHit &hit = batch_hits[i];
+    hits[i] = RayHit();
+    if (hit.fixture) {
+      hits[i].body = static_cast<Body *>(hit.fixture->GetBody()->GetUserData());
+      hits[i].fraction = hit.fraction;
+      hits[i].normal = hit.normal;
+      hits[i].category_bits = hit.fixture->GetFilterData().categoryBits;
+    }
+  }
+}
+
+void Box2DBackend::QueryAABB(const b2AABB &aabb, uint32_t mask,
+                             const QueryCallback &callback) const {
+  struct Query : public b2QueryCallback {
+    uint32_t mask;
+    const QueryCallback *callback;
+
+    bool ReportFixture(b2Fixture *fixture) override {
+      uint32_t category = fixture->GetFilterData().categoryBits;
+      if (fixture->IsSensor() || !(category & mask)) {
+        return true;
+      }
+      Body *body = static_cast<Body *>(fixture->GetBody()->GetUserData());
+      return (*callback)(body, category);
+    }
+  } query;
+  query.mask = mask;
+  query.callback = &callback;
+  world_->QueryAABB(&query, aabb);
+}
+
+void Box2DBackend::GetContacts(std::vector<Contact> *contacts) const {
+  contacts->clear();
+  for (const b2Contact *c = world_->GetContactList(); c; c = c->GetNext()) {
+    if (!c->IsEnabled()) {
+      continue;
+    }
+    b2WorldManifold manifold;
+    c->GetWorldManifold(&manifold);
+
+    Contact contact;
+    contact.body_a =
+        static_cast<Body *>(c->GetFixtureA()->GetBody()->GetUserData());
+    contact.body_b =
+        static_cast<Body *>(c->GetFixtureB()->GetBody()->GetUserData());
+    contact.normal = manifold.normal;
+    contact.touching = c->IsTouching();
+    contacts->push_back(contact);
+  }
+}
+
+};  // namespace flatland_server
@@ -0,0 +1,195 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_lod.cpp
+ * @brief	 Lowers the level of detail of models outside regions of interest
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/physics_lod.h>
+#include <flatland_server/world.h>
+#include <utility>
+
+namespace flatland_server {
+
+PhysicsLod::PhysicsLod(World *world, const Params &params)
+    : world_(world),
+      params_(params),
+      period_(params.physics_rate > 0 ? 1.0 / params.physics_rate : 0) {
+  world_->plugin_manager_.SetReducedUpdateRate(params_.plugin_rate);
+}
+
+bool PhysicsLod::InRegion(const b2Vec2 &position, double margin) const {
+  double radius = params_.radius + margin;
+  for (const b2Vec2 &center : centers_) {
+    if ((position - center).LengthSquared() <= radius * radius) {
+      return true;
+    }
+  }
+  for (const b2AABB &region : params_.regions) {
+    if (position.x >= region.lowerBound.x - margin &&
+        position.y >= region.lowerBound.y - margin &&
+        position.x <= region.upperBound.x + margin &&
+        position.y <= region.upperBound.y + margin) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PhysicsLod::BeforeStep() {
+  centers_.clear();
+  for (const std::string &name : params_.focus) {
+    Model *focus = world_->GetModel(name);
+    if (focus != nullptr && !focus->bodies_.empty()) {
+      centers_.push_back(focus->bodies_[0]->physics_body_->GetPosition());
+    }
+  }
+  bool regions = !centers_.empty() || !params_.regions.empty();
+
+  // the models that entered a region are restored, all of them if there is
+  // no region at all, e.g. before the robots under test are spawned
+  for (size_t i = 0; i < reduced_.size();) {
+    const b2Vec2 &position =
+        reduced_[i].model->bodies_[0]->physics_body_->GetPosition();
+    if (regions && !InRegion(position, 0)) {
+      i++;
+      continue;
+    }
+    Erase(i);
+  }
+  if (!regions) {
+    return;
+  }
+
+  // the focus models are at the centers of their regions, they are never
+  // reduced
+  for (Model *model : world_->models_) {
+    if (model->bodies_.empty() || model->lod_reduced_) {
+      continue;
+    }
+    const b2Vec2 &position = model->bodies_[0]->physics_body_->GetPosition();
+    if (!InRegion(position, params_.hysteresis)) {
+      Reduce(model);
+    }
+  }
+}
+
+void PhysicsLod::BeforePhysicsStep(double step_size) {
+  for (Reduced &reduced : reduced_) {
+    // the motion of the skipped steps is caught up in one step, with the
+    // velocities the plugins set last
+    double scale = 0;
+    if (period_ > 0) {
+      reduced.pending += step_size;
+      if (reduced.pending > period_ - step_size / 2) {
+        scale = reduced.pending / step_size;
+        reduced.pending = 0;
+      }
+    }
+    for (size_t i = 0; i < reduced.bodies.size(); i++) {
+      b2Body *b = reduced.bodies[i];
+      reduced.linear[i] = b->GetLinearVelocity();
+      reduced.angular[i] = b->GetAngularVelocity();
+      b->SetLinearVelocity(float(scale) * reduced.linear[i]);
+      b->SetAngularVelocity(float(scale) * reduced.angular[i]);
+    }
+  }
+}
+
+void PhysicsLod::AfterPhysicsStep() {
+  // frozen bodies keep resting until the plugins command them again, and
+  // fall asleep
+  if (period_ <= 0) {
+    return;
+  }
+  for (Reduced &reduced : reduced_) {
+    for (size_t i = 0; i < reduced.bodies.size(); i++) {
+      reduced.bodies[i]->SetLinearVelocity(reduced.linear[i]);
+      reduced.bodies[i]->SetAngularVelocity(reduced.angular[i]);
+    }
+  }
+}
+
+void PhysicsLod::Remove(Model *model) {
+  auto it = index_.find(model);
+  if (it == index_.end()) {
+    return;
+  }
+  Erase(it->second);
+}
+
+bool PhysicsLod::IsReduced(const Model *model) const {
+  return index_.count(model) > 0;
+}
+
+void PhysicsLod::Reduce(Model *model) {
+  Reduced reduced;
+  reduced.model = model;
+  for (const auto &body : model->bodies_) {
+    b2Body *b = body->physics_body_;
+    if (b->GetType() == b2_dynamicBody) {
+      // keeps the velocity, the contacts of the body are destroyed
+      b->SetType(b2_kinematicBody);
+      reduced.bodies.push_back(b);
+    }
+  }
+  reduced.linear.resize(reduced.bodies.size());
+  reduced.angular.resize(reduced.bodies.size());
+  model->lod_reduced_ = true;
+  index_[model] = reduced_.size();
+  reduced_.push_back(std::move(reduced));
+}
+
+void PhysicsLod::Erase(size_t i) {
+  for (b2Body *b : reduced_[i].bodies) {
+    b->SetType(b2_dynamicBody);
+  }
+  reduced_[i].model->lod_reduced_ = false;
+  index_.erase(reduced_[i].model);
+  if (i + 1 < reduced_.size()) {
+    std::swap(reduced_[i], reduced_.back());
+    index_[reduced_[i].model] = i;
+  }
+  reduced_.pop_back();
+}
+
+};  // namespace flatland_server
@@ -44,13 +44,20 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_server/body.h>
 #include <flatland_server/exceptions.h>
 #include <flatland_server/model.h>
 #include <flatland_server/model_plugin.h>
 #include <flatland_server/plugin_manager.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/tracer.h>
 #include <flatland_server/world.h>
 #include <flatland_server/world_plugin.h>
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
 
 namespace flatland_server {
 
@@ -61,6 +68,7 @@ PluginManager::PluginManager() {
   world_plugin_loader_ =
       new pluginlib::ClassLoader<flatland_server::WorldPlugin>(
           "flatland_server", "flatland_server::WorldPlugin");
+  gps_batch_.SetBodyStates(&body_states_);
 }
 
 PluginManager::~PluginManager() {
@@ -75,21 +83,420 @@ PluginManager::~PluginManager() {
   delete world_plugin_loader_;
 }
 
-void PluginManager::BeforePhysicsStep(const Timekeeper &timekeeper_) {
+void PluginManager::SetNumThreads(unsigned int num_threads) {
+  pool_.reset(num_threads > 0 ? new TaskPool(num_threads) : nullptr);
+  groups_dirty_ = true;
+}
+
+void PluginManager::UpdateDispatch() {
+  if (!groups_dirty_) return;
+  groups_dirty_ = false;
+
+  // most plugins only override one of the step callbacks, e.g. the sensors
+  // have no AfterPhysicsStep, so each callback only goes through the plugins
+  // that have not been found to keep the default
+  auto build = [this](uint8_t FlatlandPlugin::*callbacks, uint8_t callback,
+                      StepDispatch *dispatch) {
+    std::map<Model *, unsigned int> group_of_model;
+    dispatch->plugins.clear();
+    dispatch->parallel_groups.clear();
+    dispatch->serial_plugins.clear();
+    dispatch->world_plugins.clear();
+    for (const auto &model_plugin : model_plugins_) {
+      if ((model_plugin.get()->*callbacks & callback) == 0) continue;
+      dispatch->plugins.push_back(model_plugin.get());
+      if (!model_plugin->IsThreadSafe()) {
+        dispatch->serial_plugins.push_back(model_plugin.get());
+        continue;
+      }
+      Model *model = model_plugin->GetModel();
+      if (group_of_model.count(model) == 0) {
+        group_of_model[model] = dispatch->parallel_groups.size();
+        dispatch->parallel_groups.emplace_back();
+      }
+      dispatch->parallel_groups[group_of_model[model]].push_back(
+          model_plugin.get());
+    }
+    for (const auto &world_plugin : world_plugins_) {
+      if ((world_plugin.get()->*callbacks & callback) == 0) continue;
+      dispatch->world_plugins.push_back(world_plugin.get());
+    }
+  };
+  build(&FlatlandPlugin::step_callbacks_, FlatlandPlugin::BEFORE_PHYSICS_STEP,
+        &before_dispatch_);
+  build(&FlatlandPlugin::step_callbacks_, FlatlandPlugin::AFTER_PHYSICS_STEP,
+        &after_dispatch_);
+  build(&FlatlandPlugin::contact_callbacks_, FlatlandPlugin::CONTACT_EVENTS,
+        &contact_dispatch_);
+  // the world plugins receive no contacts
+  contact_dispatch_.world_plugins.clear();
+}
+
+void PluginManager::CallModelPlugins(
+    const StepDispatch &dispatch,
+    const std::function<void(ModelPlugin *)> &func) {
+  if (!pool_) {
+    for (ModelPlugin *model_plugin : dispatch.plugins) {
+      func(model_plugin);
+    }
+    return;
+  }
+
+  // Run returns once all groups are done, so no plugin is still running when
+  // the serial plugins and the physics step start
+  pool_->Run(dispatch.parallel_groups.size(), [&](unsigned int i) {
+    for (ModelPlugin *model_plugin : dispatch.parallel_groups[i]) {
+      func(model_plugin);
+    }
+  });
+  for (ModelPlugin *model_plugin : dispatch.serial_plugins) {
+    func(model_plugin);
+  }
+}
+
+namespace {
+/**
+ * @brief Check if a plugin is selected by StepPlugins
+ */
+bool IsSelected(const FlatlandPlugin *plugin,
+                PluginManager::StepPlugins plugins) {
+  return plugins == PluginManager::StepPlugins::ALL ||
+         plugin->UpdatesPerSubstep() ==
+             (plugins == PluginManager::StepPlugins::SUBSTEP);
+}
+
+/**
+ * @brief Call a callback of a plugin, adding its wall time to a cost of the
+ * plugin when profiling
+ * @param[in] profiling If the time is measured
+ * @param[in] plugin The plugin called
+ * @param[in] cost The cost of the plugin the time is added to
+ * @param[in] callback Calls the plugin
+ */
+template <class Callback>
+void CallPlugin(bool profiling, FlatlandPlugin *plugin,
+                double PluginCost::*cost, const Callback &callback) {
+  if (!profiling) {
+    callback();
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  callback();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  plugin->cost_.*cost += elapsed.count();
+  plugin->cost_.calls++;
+}
+
+/**
+ * @brief Sort cost entries by decreasing total cost and keep the first ones
+ * @param[in] entries The entries
+ * @param[in] count Number of entries kept, 0 for all
+ */
+void RankCosts(std::vector<PluginManager::CostEntry> *entries, size_t count) {
+  std::stable_sort(entries->begin(), entries->end(),
+                   [](const PluginManager::CostEntry &a,
+                      const PluginManager::CostEntry &b) {
+                     return a.cost.Total() > b.cost.Total();
+                   });
+  if (count > 0 && entries->size() > count) {
+    entries->resize(count);
+  }
+}
+
+/**
+ * @brief Return the model or layer owning a fixture, from the user data of
+ * its body
+ */
+const Entity *FixtureEntity(b2Fixture *fixture) {
+  Body *body = static_cast<Body *>(fixture->GetBody()->GetUserData());
+  return body != nullptr ? body->GetEntity() : nullptr;
+}
+
+/**
+ * @brief Order of the schedule heap, the earliest update first
+ */
+bool LaterUpdate(const PluginManager::ScheduledUpdate &a,
+                 const PluginManager::ScheduledUpdate &b) {
+  return a.time > b.time;
+}
+
+/**
+ * @brief Create a plugin, from the PluginRegistry if its type is registered,
+ * otherwise through pluginlib, which registers the types of the library it
+ * loads so that the next plugins of the library skip pluginlib
+ * @param[in] loader The pluginlib class loader
+ * @param[in] type The type of the plugin, in flatland_plugins if it has no
+ * namespace
+ * @return The plugin
+ */
+template <class Base>
+boost::shared_ptr<Base> CreatePlugin(pluginlib::ClassLoader<Base> *loader,
+                                     const std::string &type) {
+  std::string full_type = type.find("::") != std::string::npos
+                              ? type
+                              : "flatland_plugins::" + type;
+  typename PluginRegistry<Base>::Factory factory =
+      PluginRegistry<Base>::Find(full_type);
+  if (factory != nullptr) {
+    return boost::shared_ptr<Base>(factory());
+  }
+  return loader->createInstance(full_type);
+}
+}
+
+void PluginManager::ScheduleUpdates(const Timekeeper &timekeeper) {
+  for (ModelPlugin *model_plugin : skipped_plugins_) {
+    model_plugin->update_due_ = true;
+  }
+  skipped_plugins_.clear();
+  for (ModelPlugin *model_plugin : due_plugins_) {
+    model_plugin->update_due_ = false;
+  }
+  due_plugins_.clear();
+
+  // an update is due on the step whose time is within half a step of it
+  double now = timekeeper.GetSimTime().toSec();
+  double half_step = timekeeper.GetMaxStepSize() / 2.0;
+
+  // rebuilt when the plugins change, or the time goes back, e.g. on a reset
+  if (schedule_dirty_ || now < schedule_time_) {
+    schedule_.clear();
+    for (const auto &model_plugin : model_plugins_) {
+      ModelPlugin *p = model_plugin.get();
+      p->update_due_ = p->update_period_ <= 0 || p->UpdatesPerSubstep();
+      if (p->update_due_) continue;
+      double phase = p->FirstUpdateTime();
+      int64_t count = std::max<int64_t>(
+          0, std::ceil((now - half_step - phase) / p->update_period_));
+      schedule_.push_back({phase + count * p->update_period_, count, p});
+    }
+    std::make_heap(schedule_.begin(), schedule_.end(), LaterUpdate);
+    schedule_dirty_ = false;
+  }
+  schedule_time_ = now;
+
+  while (!schedule_.empty() && schedule_.front().time < now + half_step) {
+    std::pop_heap(schedule_.begin(), schedule_.end(), LaterUpdate);
+    ScheduledUpdate &update = schedule_.back();
+    update.plugin->update_due_ = true;
+    due_plugins_.push_back(update.plugin);
+
+    // the time is computed from the count so that it does not drift, updates
+    // closer than a step apart are merged
+    double phase = update.plugin->FirstUpdateTime();
+    while (update.time < now + half_step) {
+      update.count++;
+      update.time = phase + update.count * update.plugin->update_period_;
+    }
+    std::push_heap(schedule_.begin(), schedule_.end(), LaterUpdate);
+  }
+}
+
+void PluginManager::SetStaggerUpdates(bool stagger) {
+  stagger_updates_ = stagger;
+}
+
+void PluginManager::SetPipelinedSensing(b2World *world) {
+  pipelined_world_ = world;
+}
+
+void PluginManager::SetGpuRaycasting(b2World *world) {
+  sensor_scheduler_.SetGpuRaycaster(GpuRaycaster::Create(world));
+}
+
+void PluginManager::SetDegradations(uint32_t degradations) {
+  if (degradations == degradations_) return;
+  degradations_ = degradations;
+  for (const auto &model_plugin : model_plugins_) {
+    model_plugin->SetDegradations(degradations_);
+  }
+  // the plugins may have changed their update rates
+  schedule_dirty_ = true;
+}
+
+void PluginManager::SetSleepingUpdateRate(double rate) {
+  sleeping_period_ = rate > 0 ? 1.0 / rate : 0;
+}
+
+void PluginManager::SetReducedUpdateRate(double rate) {
+  reduced_period_ = rate > 0 ? 1.0 / rate : 0;
+}
+
+void PluginManager::SkipThrottledPlugins(const Timekeeper &timekeeper) {
+  double now = timekeeper.GetSimTime().toSec();
+  double half_step = timekeeper.GetMaxStepSize() / 2.0;
+  for (const auto &model_plugin : model_plugins_) {
+    ModelPlugin *p = model_plugin.get();
+    if (!p->update_due_ || p->UpdatesPerSubstep()) {
+      continue;
+    }
+
+    // a reduced model is throttled whether it is asleep or not
+    Model *model = p->GetModel();
+    double period = 0;
+    if (model->lod_reduced_) {
+      period = reduced_period_;
+    } else if (sleeping_period_ > 0 && p->SkipsWhileAsleep() &&
+               !model->IsAwake()) {
+      period = sleeping_period_;
+    }
+
+    // the time goes back e.g. on a reset, which counts as an update being due
+    double elapsed = now - p->last_update_time_;
+    if (period <= 0 || elapsed < 0 || elapsed > period - half_step) {
+      p->last_update_time_ = now;
+      continue;
+    }
+    p->update_due_ = false;
+    skipped_plugins_.push_back(p);
+  }
+}
+
+void PluginManager::BeforePhysicsStep(const Timekeeper &timekeeper_,
+                                      StepPlugins plugins) {
+  // the plugins updated per sub-step are not scheduled
+  if (plugins != StepPlugins::SUBSTEP) {
+    ScheduleUpdates(timekeeper_);
+    if (sleeping_period_ > 0 || reduced_period_ > 0) {
+      SkipThrottledPlugins(timekeeper_);
+    }
+
+    // the clock is current whenever the plugins with an update rate publish,
+    // even if it is throttled, so timers of other nodes see their updates
+    if (!due_plugins_.empty()) {
+      timekeeper_.EnsureClockPublished();
+    }
+
+    // the animated bodies are in place before the plugins see them
+    if (kinematic_animator_.Size() > 0) {
+      FLATLAND_TRACE("before_physics_step", "kinematic_animator");
+      kinematic_animator_.Step(timekeeper_.GetStepSize());
+    }
+  }
+
+  UpdateDispatch();
+  CallModelPlugins(before_dispatch_, [&](ModelPlugin *model_plugin) {
+    if (model_plugin->update_due_ && IsSelected(model_plugin, plugins)) {
+      CallPlugin(profiling_, model_plugin, &PluginCost::before_physics_step,
+                 [&] {
+                   FLATLAND_TRACE("before_physics_step",
+                                  model_plugin->GetName());
+                   model_plugin->BeforePhysicsStep(timekeeper_);
+                 });
+      if (!(model_plugin->step_callbacks_ &
+            FlatlandPlugin::BEFORE_PHYSICS_STEP)) {
+        groups_dirty_ = true;
+      }
+    }
+  });
+  for (WorldPlugin *world_plugin : before_dispatch_.world_plugins) {
+    if (IsSelected(world_plugin, plugins)) {
+      CallPlugin(profiling_, world_plugin, &PluginCost::before_physics_step,
+                 [&] {
+                   FLATLAND_TRACE("before_physics_step",
+                                  world_plugin->GetName());
+                   world_plugin->BeforePhysicsStep(timekeeper_);
+                 });
+      if (!(world_plugin->step_callbacks_ &
+            FlatlandPlugin::BEFORE_PHYSICS_STEP)) {
+        groups_dirty_ = true;
+      }
+    }
+  }
+
+  // render the top down views requested on this step in one pass, before
+  // the world is stepped
+  raster_batch_.Render();
+
+  // cast the rays of all sensors due on this step in one pass, pipelined
+  // with the physics step when it has no sub-steps
+  if (pipelined_world_ && plugins == StepPlugins::ALL) {
+    sensor_scheduler_.Launch(pipelined_world_);
+  } else {
+    sensor_scheduler_.Flush();
+  }
+}
+
+void PluginManager::AfterPhysicsStep(const Timekeeper &timekeeper_,
+                                     StepPlugins plugins) {
+  // the scans of the pipelined sensors are published first
+  sensor_scheduler_.Join();
+
+  if (plugins != StepPlugins::SUBSTEP && !due_plugins_.empty()) {
+    timekeeper_.EnsureClockPublished();
+  }
+
+  UpdateDispatch();
+  CallModelPlugins(after_dispatch_, [&](ModelPlugin *model_plugin) {
+    if (model_plugin->update_due_ && IsSelected(model_plugin, plugins)) {
+      CallPlugin(profiling_, model_plugin, &PluginCost::after_physics_step,
+                 [&] {
+                   FLATLAND_TRACE("after_physics_step",
+                                  model_plugin->GetName());
+                   model_plugin->AfterPhysicsStep(timekeeper_);
+                 });
+      if (!(model_plugin->step_callbacks_ &
+            FlatlandPlugin::AFTER_PHYSICS_STEP)) {
+        groups_dirty_ = true;
+      }
+    }
+  });
+  for (WorldPlugin *world_plugin : after_dispatch_.world_plugins) {
+    if (IsSelected(world_plugin, plugins)) {
+      CallPlugin(profiling_, world_plugin, &PluginCost::after_physics_step,
+                 [&] {
+                   FLATLAND_TRACE("after_physics_step",
+                                  world_plugin->GetName());
+                   world_plugin->AfterPhysicsStep(timekeeper_);
+                 });
+      if (!(world_plugin->step_callbacks_ &
+            FlatlandPlugin::AFTER_PHYSICS_STEP)) {
+        groups_dirty_ = true;
+      }
+    }
+  }
+}
+
+std::vector<PluginManager::CostEntry> PluginManager::GetPluginCosts(
+    size_t count) const {
+  std::vector<CostEntry> entries;
   for (const auto &model_plugin : model_plugins_) {
-    model_plugin->BeforePhysicsStep(timekeeper_);
+    entries.push_back({model_plugin->GetModel()->GetName() + "/" +
+                           model_plugin->GetName(),
+                       model_plugin->GetType(), 1, model_plugin->cost_});
   }
   for (const auto &world_plugin : world_plugins_) {
-    world_plugin->BeforePhysicsStep(timekeeper_);
+    entries.push_back({world_plugin->GetName(), world_plugin->GetType(), 1,
+                       world_plugin->cost_});
+  }
+  RankCosts(&entries, count);
+  return entries;
+}
+
+std::vector<PluginManager::CostEntry> PluginManager::GetPluginTypeCosts(
+    size_t count) const {
+  std::map<std::string, CostEntry> types;
+  for (const auto &entry : GetPluginCosts()) {
+    CostEntry &type = types[entry.type];
+    type.type = entry.type;
+    type.instances++;
+    type.cost.Add(entry.cost);
+  }
+  std::vector<CostEntry> entries;
+  for (const auto &type : types) {
+    entries.push_back(type.second);
   }
+  RankCosts(&entries, count);
+  return entries;
 }
 
-void PluginManager::AfterPhysicsStep(const Timekeeper &timekeeper_) {
+void PluginManager::ResetCosts() {
   for (const auto &model_plugin : model_plugins_) {
-    model_plugin->AfterPhysicsStep(timekeeper_);
+    model_plugin->cost_ = PluginCost();
   }
   for (const auto &world_plugin : world_plugins_) {
-    world_plugin->AfterPhysicsStep(timekeeper_);
+    world_plugin->cost_ = PluginCost();
   }
 }
 
@@ -100,72 +507,134 @@ void PluginManager::DeleteModelPlugin(Model *model) {
                        return p->GetModel() == model;
                      }),
       model_plugins_.end());
+  groups_dirty_ = true;
+  contacts_dirty_ = true;
+  schedule_dirty_ = true;
+  due_plugins_.clear();
+  skipped_plugins_.clear();
 }
 
 void PluginManager::LoadModelPlugin(Model *model, YamlReader &plugin_reader) {
-  std::string name = plugin_reader.Get<std::string>("name");
-  std::string type = plugin_reader.Get<std::string>("type");
+  PreparedPlugin prepared = PrepareModelPlugin(model->name_, plugin_reader);
+  AddModelPlugin(model, prepared);
+}
 
-  // ensure no plugin with the same model and name
-  if (std::count_if(model_plugins_.begin(), model_plugins_.end(),
-                    [&](boost::shared_ptr<ModelPlugin> i) {
-                      return i->GetName() == name && i->GetModel() == model;
-                    }) >= 1) {
-    throw YAMLException("Invalid \"plugins\" in " + Q(model->name_) +
-                        " model, plugin with name " + Q(name) +
-                        " already exists");
-  }
+PluginManager::PreparedPlugin PluginManager::PrepareModelPlugin(
+    const std::string &model_name, YamlReader &plugin_reader,
+    const std::string &config_key) {
+  FLATLAND_TRACE("load", "model_plugins");
+  PreparedPlugin prepared;
+  prepared.name = plugin_reader.Get<std::string>("name");
+  prepared.type = plugin_reader.Get<std::string>("type");
+  const std::string &name = prepared.name;
+  const std::string &type = prepared.type;
 
   try {
     if (!plugin_reader.Get<bool>("enabled", "true")) {
       ROS_WARN_STREAM("Plugin "
-                      << Q(model->name_) << "."
+                      << Q(model_name) << "."
                       << plugin_reader.Get<std::string>("name", "unnamed")
                       << " disabled");
-      return;
+      return prepared;
     }
   } catch (...) {
-    ROS_WARN_STREAM("Body " << Q(model->name_) << "."
+    ROS_WARN_STREAM("Body " << Q(model_name) << "."
                             << plugin_reader.Get<std::string>("name", "unnamed")
                             << " enabled because flag failed to parse: "
                             << plugin_reader.Get<std::string>("enabled"));
   }
 
-  // remove the name, type and enabled of the YAML Node, the plugin does not
-  // need to know
+  // the phase of the updates of the plugins with an update rate, see
+  // ModelPlugin::SetUpdateRate
+  prepared.update_phase = plugin_reader.Get<double>("update_phase", 0.0);
+
+  // the instances of a model template share the copy below, the plugins
+  // only read their config
+  prepared.config_key = config_key;
+  bool shared = false;
+  if (!config_key.empty()) {
+    std::lock_guard<std::mutex> lock(template_configs_mutex_);
+    auto it = template_configs_.find(config_key);
+    if (it != template_configs_.end()) {
+      prepared.config = it->second;
+      shared = true;
+    }
+  }
+
+  // remove the name, type, enabled and update_phase of the YAML Node, the
+  // plugin does not need to know
   // about these parameters, remove method is broken in yaml cpp 5.2, so we
   // create a new node and add everything
-  YAML::Node yaml_node;
-  for (const auto &k : plugin_reader.Node()) {
-    if (k.first.as<std::string>() != "name" &&
-        k.first.as<std::string>() != "type" &&
-        k.first.as<std::string>() != "enabled") {
-      yaml_node[k.first] = k.second;
+  if (!shared) {
+    for (const auto &k : plugin_reader.Node()) {
+      if (k.first.as<std::string>() != "name" &&
+          k.first.as<std::string>() != "type" &&
+          k.first.as<std::string>() != "enabled" &&
+          k.first.as<std::string>() != "update_phase") {
+        prepared.config[k.first] = k.second;
+      }
+    }
+    if (!config_key.empty()) {
+      std::lock_guard<std::mutex> lock(template_configs_mutex_);
+      template_configs_[config_key] = prepared.config;
     }
   }
 
-  boost::shared_ptr<ModelPlugin> model_plugin;
-
   std::string msg = "Model Plugin " + Q(name) + " type " + Q(type) + " model " +
-                    Q(model->name_);
+                    Q(model_name);
 
   try {
-    if (type.find("::") != std::string::npos) {
-      model_plugin = model_plugin_loader_->createInstance(type);
-    } else {
-      model_plugin =
-          model_plugin_loader_->createInstance("flatland_plugins::" + type);
-    }
+    FLATLAND_TRACE("load", "plugin_create");
+    std::lock_guard<std::mutex> lock(model_plugin_loader_mutex_);
+    prepared.plugin = CreatePlugin(model_plugin_loader_, type);
   } catch (pluginlib::PluginlibException &e) {
     throw PluginException(msg + ": " + std::string(e.what()));
   }
+  return prepared;
+}
+
+void PluginManager::AddModelPlugin(Model *model, PreparedPlugin &prepared) {
+  const std::string &name = prepared.name;
+  const std::string &type = prepared.type;
+
+  // ensure no plugin with the same model and name
+  if (std::count_if(model_plugins_.begin(), model_plugins_.end(),
+                    [&](boost::shared_ptr<ModelPlugin> i) {
+                      return i->GetName() == name && i->GetModel() == model;
+                    }) >= 1) {
+    throw YAMLException("Invalid \"plugins\" in " + Q(model->name_) +
+                        " model, plugin with name " + Q(name) +
+                        " already exists");
+  }
+  if (!prepared.plugin) return;  // disabled
+
+  boost::shared_ptr<ModelPlugin> model_plugin = prepared.plugin;
+  std::string msg = "Model Plugin " + Q(name) + " type " + Q(type) + " model " +
+                    Q(model->name_);
+
+  model_plugin->sensor_scheduler_ = &sensor_scheduler_;
+  model_plugin->body_states_ = &body_states_;
+  model_plugin->gps_batch_ = &gps_batch_;
+  model_plugin->raster_batch_ = &raster_batch_;
+  model_plugin->kinematic_animator_ = &kinematic_animator_;
+  model_plugin->state_exporter_ = state_exporter_.get();
+  model_plugin->update_phase_ = prepared.update_phase;
+  model_plugin->update_stagger_ =
+      stagger_updates_ ? ModelPlugin::StaggerFraction(
+                             model->namespace_ + "/" + model->name_ + "/" + name)
+                       : 0;
+  model_plugin->config_key_ = prepared.config_key;
 
   try {
-    model_plugin->Initialize(type, name, model, yaml_node);
+    model_plugin->Initialize(type, name, model, prepared.config);
+    if (degradations_) model_plugin->SetDegradations(degradations_);
   } catch (const std::exception &e) {
     throw PluginException(msg + ": " + std::string(e.what()));
   }
   model_plugins_.push_back(model_plugin);
+  groups_dirty_ = true;
+  contacts_dirty_ = true;
+  schedule_dirty_ = true;
 
   ROS_INFO_NAMED("PluginManager", "%s loaded", msg.c_str());
 }
@@ -196,18 +665,20 @@ void PluginManager::LoadWorldPlugin(World *world, YamlReader &plugin_reader,
 
   // try to create the instance
   try {
-    if (type.find("::") != std::string::npos) {
-      world_plugin = world_plugin_loader_->createInstance(type);
-    } else {
-      world_plugin =
-          world_plugin_loader_->createInstance("flatland_plugins::" + type);
-    }
+    world_plugin = CreatePlugin(world_plugin_loader_, type);
   } catch (pluginlib::PluginlibException &e) {
     throw PluginException(msg + ": " + std::string(e.what()));
   }
 
   ROS_INFO_NAMED("PluginManager", "create instance finished");
 
+  world_plugin->sensor_scheduler_ = &sensor_scheduler_;
+  world_plugin->body_states_ = &body_states_;
+  world_plugin->gps_batch_ = &gps_batch_;
+  world_plugin->raster_batch_ = &raster_batch_;
+  world_plugin->kinematic_animator_ = &kinematic_animator_;
+  world_plugin->state_exporter_ = state_exporter_.get();
+
   try {
     world_plugin->Initialize(world, name, type, yaml_node, world_config);
   } catch (const std::exception &e) {
@@ -215,34 +686,143 @@ void PluginManager::LoadWorldPlugin(World *world, YamlReader &plugin_reader,
     throw PluginException(msg + ": " + std::string(e.what()));
   }
   world_plugins_.push_back(world_plugin);
+  groups_dirty_ = true;
 
   ROS_INFO_NAMED("PluginManager", "%s loaded ", msg.c_str());
 }
 
-void PluginManager::BeginContact(b2Contact *contact) {
-  for (auto &model_plugin : model_plugins_) {
-    model_plugin->BeginContact(contact);
+void PluginManager::SetDeferredContacts(size_t capacity) {
+  contact_queue_.SetCapacity(capacity);
+}
+
+void PluginManager::DeliverContactEvents() {
+  if (contact_queue_.Size() == 0) return;
+  if (contact_queue_.Dropped() > reported_drops_) {
+    ROS_WARN_THROTTLE_NAMED(1, "PluginManager",
+                            "%lu contact events dropped, raise "
+                            "deferred_contacts above %lu",
+                            (unsigned long)contact_queue_.Dropped(),
+                            (unsigned long)contact_queue_.Capacity());
+    reported_drops_ = contact_queue_.Dropped();
+  }
+
+  // each plugin gets the events of its model in its own list, so the models
+  // are processed in parallel without sharing anything
+  for (size_t i = 0; i < contact_queue_.Size(); i++) {
+    const ContactEvent &event = contact_queue_[i];
+    FindContactTargets(event.fixture_a, event.fixture_b);
+    for (size_t target : contact_targets_) {
+      ModelPlugin *model_plugin = model_plugins_[target].get();
+      if (model_plugin->contact_callbacks_ & FlatlandPlugin::CONTACT_EVENTS) {
+        model_plugin->contact_events_.push_back(event);
+      }
+    }
+  }
+  contact_queue_.Clear();
+
+  UpdateDispatch();
+  CallModelPlugins(contact_dispatch_, [&](ModelPlugin *model_plugin) {
+    if (model_plugin->contact_events_.empty()) return;
+    CallPlugin(profiling_, model_plugin, &PluginCost::contact, [&] {
+      FLATLAND_TRACE("contact_events", model_plugin->GetName());
+      model_plugin->ContactEvents(model_plugin->contact_events_);
+    });
+    model_plugin->contact_events_.clear();
+    if (!(model_plugin->contact_callbacks_ & FlatlandPlugin::CONTACT_EVENTS)) {
+      groups_dirty_ = true;
+    }
+  });
+}
+
+void PluginManager::FindContactTargets(b2Fixture *fixture_a,
+                                       b2Fixture *fixture_b) {
+  if (contacts_dirty_) {
+    contact_plugins_.clear();
+    all_contact_plugins_.clear();
+    for (size_t i = 0; i < model_plugins_.size(); i++) {
+      ModelPlugin *model_plugin = model_plugins_[i].get();
+      if (model_plugin->ReceivesAllContacts()) {
+        all_contact_plugins_.push_back(i);
+      } else {
+        contact_plugins_[model_plugin->GetModel()].push_back(i);
+      }
+    }
+    contacts_dirty_ = false;
+  }
+
+  // PreSolve and PostSolve are called for every touching contact on every
+  // step, so only the plugins of the models in contact are called
+  contact_targets_ = all_contact_plugins_;
+  int lists = all_contact_plugins_.empty() ? 0 : 1;
+  auto add_targets = [&](const Entity *entity) {
+    if (entity == nullptr) return;
+    auto it = contact_plugins_.find(entity);
+    if (it == contact_plugins_.end()) return;
+    contact_targets_.insert(contact_targets_.end(), it->second.begin(),
+                            it->second.end());
+    lists++;
+  };
+  const Entity *entity_a = FixtureEntity(fixture_a);
+  const Entity *entity_b = FixtureEntity(fixture_b);
+  add_targets(entity_a);
+  if (entity_b != entity_a) add_targets(entity_b);
+  if (lists > 1) {
+    std::sort(contact_targets_.begin(), contact_targets_.end());
   }
 }
 
-void PluginManager::EndContact(b2Contact *contact) {
-  for (auto &model_plugin : model_plugins_) {
-    model_plugin->EndContact(contact);
+void PluginManager::RecordContact(ContactEvent::Type type, b2Contact *contact,
+                                  const b2ContactImpulse *impulse) {
+  // the end contacts of the bodies destroyed between the steps are not
+  // recorded, their fixtures would be gone by the time they are delivered
+  if (contact_queue_.Capacity() == 0 ||
+      !contact->GetFixtureA()->GetBody()->GetWorld()->IsLocked()) {
+    return;
+  }
+  for (size_t i : contact_targets_) {
+    if (model_plugins_[i]->contact_callbacks_ &
+        FlatlandPlugin::CONTACT_EVENTS) {
+      contact_queue_.Push(ContactEvent::Record(type, contact, impulse));
+      return;
+    }
   }
 }
 
+template <class Call>
+void PluginManager::DispatchContact(b2Contact *contact, uint8_t callback,
+                                    const Call &call) {
+  FindContactTargets(contact->GetFixtureA(), contact->GetFixtureB());
+  for (size_t i : contact_targets_) {
+    ModelPlugin *model_plugin = model_plugins_[i].get();
+    if ((model_plugin->contact_callbacks_ & callback) == 0) continue;
+    CallPlugin(profiling_, model_plugin, &PluginCost::contact,
+               [&] { call(model_plugin); });
+  }
+}
+
+void PluginManager::BeginContact(b2Contact *contact) {
+  DispatchContact(contact, FlatlandPlugin::BEGIN_CONTACT,
+                  [&](ModelPlugin *p) { p->BeginContact(contact); });
+  RecordContact(ContactEvent::BEGIN, contact);
+}
+
+void PluginManager::EndContact(b2Contact *contact) {
+  DispatchContact(contact, FlatlandPlugin::END_CONTACT,
+                  [&](ModelPlugin *p) { p->EndContact(contact); });
+  RecordContact(ContactEvent::END, contact);
+}
+
 void PluginManager::PreSolve(b2Contact *contact,
                              const b2Manifold *oldManifold) {
-  for (auto &model_plugin : model_plugins_) {
-    model_plugin->PreSolve(contact, oldManifold);
-  }
+  DispatchContact(contact, FlatlandPlugin::PRE_SOLVE,
+                  [&](ModelPlugin *p) { p->PreSolve(contact, oldManifold); });
 }
 
 void PluginManager::PostSolve(b2Contact *contact,
                               const b2ContactImpulse *impulse) {
-  for (auto &model_plugin : model_plugins_) {
-    model_plugin->PostSolve(contact, impulse);
-  }
+  DispatchContact(contact, FlatlandPlugin::POST_SOLVE,
+                  [&](ModelPlugin *p) { p->PostSolve(contact, impulse); });
+  RecordContact(ContactEvent::IMPULSE, contact, impulse);
 }
 
 };  // namespace flatland_server
@@ -0,0 +1,93 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 plugin_registry.cpp
+ * @brief	 Registry of statically linked plugin factories
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/model_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <flatland_server/world_plugin.h>
+
+namespace flatland_server {
+
+template <class Base>
+std::mutex &PluginRegistry<Base>::Mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+template <class Base>
+std::map<std::string, typename PluginRegistry<Base>::Factory>
+    &PluginRegistry<Base>::Factories() {
+  static std::map<std::string, Factory> factories;
+  return factories;
+}
+
+template <class Base>
+void PluginRegistry<Base>::Register(const std::string &type,
+                                    Factory factory) {
+  std::lock_guard<std::mutex> lock(Mutex());
+  Factories()[type] = factory;
+}
+
+template <class Base>
+void PluginRegistry<Base>::Unregister(const std::string &type,
+                                      Factory factory) {
+  std::lock_guard<std::mutex> lock(Mutex());
+  auto it = Factories().find(type);
+  if (it != Factories().end() && it->second == factory) {
+    Factories().erase(it);
+  }
+}
+
+template <class Base>
+typename PluginRegistry<Base>::Factory PluginRegistry<Base>::Find(
+    const std::string &type) {
+  std::lock_guard<std::mutex> lock(Mutex());
+  auto it = Factories().find(type);
+  return it != Factories().end() ? it->second : nullptr;
+}
+
+template class PluginRegistry<ModelPlugin>;
+template class PluginRegistry<WorldPlugin>;
+};  // namespace flatland_server
@@ -0,0 +1,151 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 publish_queue.cpp
+ * @brief	 Publishes the messages of the plugins on dedicated threads
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/publish_queue.h>
+#include <flatland_server/tracer.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+std::atomic<bool> PublishQueue::enabled_(false);
+
+PublishQueue &PublishQueue::Get() {
+  static PublishQueue instance;
+  return instance;
+}
+
+PublishQueue::PublishQueue() : depth_(1), coalesced_(0) {}
+
+void PublishQueue::Start(unsigned int num_threads, size_t depth) {
+  std::lock_guard<std::mutex> lock(start_mutex_);
+  if (!workers_.empty()) {
+    return;
+  }
+  depth_ = std::max<size_t>(depth, 1);
+  for (unsigned int i = 0; i < std::max(num_threads, 1u); i++) {
+    workers_.emplace_back(new Worker());
+  }
+  for (unsigned int i = 0; i < workers_.size(); i++) {
+    workers_[i]->thread =
+        std::thread(&PublishQueue::WorkerLoop, this, workers_[i].get(), i);
+  }
+  enabled_ = true;
+}
+
+void PublishQueue::Stop() {
+  std::lock_guard<std::mutex> lock(start_mutex_);
+  // the messages posted until now are still published by the threads
+  enabled_ = false;
+  for (auto &worker : workers_) {
+    {
+      std::lock_guard<std::mutex> worker_lock(worker->mutex);
+      worker->stopping = true;
+    }
+    worker->pending_cv.notify_one();
+    worker->thread.join();
+  }
+  workers_.clear();
+}
+
+void PublishQueue::Post(const std::string &topic,
+                        std::function<void()> publish) {
+  Worker &worker =
+      *workers_[std::hash<std::string>()(topic) % workers_.size()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    std::deque<std::function<void()>> &messages = worker.pending[topic];
+    if (messages.size() >= depth_) {
+      messages.pop_front();
+      coalesced_++;
+    }
+    messages.push_back(std::move(publish));
+  }
+  worker.pending_cv.notify_one();
+}
+
+void PublishQueue::Flush() {
+  std::lock_guard<std::mutex> lock(start_mutex_);
+  for (auto &worker : workers_) {
+    std::unique_lock<std::mutex> worker_lock(worker->mutex);
+    worker->idle_cv.wait(worker_lock, [&worker] {
+      return worker->pending.empty() && !worker->busy;
+    });
+  }
+}
+
+void PublishQueue::WorkerLoop(Worker *worker, unsigned int index) {
+  Tracer::Get().SetThreadName("publisher_" + std::to_string(index));
+  Pending batch;
+  std::unique_lock<std::mutex> lock(worker->mutex);
+  while (true) {
+    worker->pending_cv.wait(lock, [worker] {
+      return worker->stopping || !worker->pending.empty();
+    });
+    if (worker->pending.empty()) {
+      return;  // stopping
+    }
+
+    // double buffered, the producers fill pending while the batch is
+    // published
+    batch.swap(worker->pending);
+    worker->busy = true;
+    lock.unlock();
+    {
+      FLATLAND_TRACE("publish", "publish_queue");
+      for (auto &topic : batch) {
+        for (auto &publish : topic.second) {
+          publish();
+        }
+      }
+    }
+    batch.clear();
+    lock.lock();
+    worker->busy = false;
+    worker->idle_cv.notify_all();
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,388 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 raster_batch.cpp
+ * @brief	 Renders the egocentric top down images of all robots at once
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/raster_batch.h>
+#include <flatland_server/sensor_executor.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace flatland_server {
+
+const uint8_t RasterBatch::FREE;
+const uint8_t RasterBatch::DYNAMIC;
+const uint8_t RasterBatch::STATIC;
+
+namespace {
+
+/**
+ * Collects the fixtures in the layers of a view overlapping an AABB, a
+ * fixture with several children is reported once per child
+ */
+class ViewCollector : public b2QueryCallback {
+ public:
+  uint32_t layers_bits;
+  const Entity *ignore;
+  std::vector<b2Fixture *> fixtures;
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        !(fixture->GetFilterData().categoryBits & layers_bits)) {
+      return true;
+    }
+    Body *body = static_cast<Body *>(fixture->GetBody()->GetUserData());
+    if (ignore && body && body->GetEntity() == ignore) {
+      return true;
+    }
+    fixtures.push_back(fixture);
+    return true;
+  }
+};
+
+/**
+ * The image of a view, the pixel coordinates are continuous with pixel
+ * (col, row) covering [col, col + 1) x [row, row + 1)
+ */
+class Canvas {
+ public:
+  /**
+   * @param[in] view Transform of the view frame in the world
+   * @param[in] params The parameters of the view
+   * @param[in] image The image
+   */
+  Canvas(const b2Transform &view, const RasterBatch::Params &params,
+         uint8_t *image)
+      : view_(view),
+        scale_(1.0 / params.resolution),
+        width_(params.width),
+        height_(params.height),
+        image_(image) {}
+
+  /**
+   * @return The pixel coordinates (col, row) of a point in the world
+   */
+  b2Vec2 ToPixel(const b2Vec2 &point) const {
+    b2Vec2 p = b2MulT(view_, point);
+    return b2Vec2(width_ / 2.0f - p.y * scale_, height_ / 2.0f - p.x * scale_);
+  }
+
+  /**
+   * @return A point in the world at pixel coordinates (col, row)
+   */
+  b2Vec2 ToWorld(float col, float row) const {
+    return b2Mul(view_, b2Vec2((height_ / 2.0f - row) / scale_,
+                               (width_ / 2.0f - col) / scale_));
+  }
+
+  /**
+   * @brief Draw a segment, sampled at least twice per pixel
+   */
+  void Line(b2Vec2 a, b2Vec2 b, uint8_t value) {
+    if (!Clip(&a, &b)) {
+      return;
+    }
+    b2Vec2 d = b - a;
+    int n = std::ceil(2 * std::max(std::abs(d.x), std::abs(d.y)));
+    for (int k = 0; k <= n; k++) {
+      b2Vec2 p = n > 0 ? a + (float(k) / n) * d : a;
+      Set(std::floor(p.x), std::floor(p.y), value);
+    }
+  }
+
+  /**
+   * @brief Fill a convex polygon, the pixels whose center is inside, and
+   * draw its outline so that thin polygons are not lost
+   */
+  void Polygon(const b2Vec2 *points, int count, uint8_t value) {
+    float min_y = points[0].y, max_y = points[0].y;
+    for (int i = 1; i < count; i++) {
+      min_y = std::min(min_y, points[i].y);
+      max_y = std::max(max_y, points[i].y);
+    }
+    int row0 = std::max<int>(0, std::floor(min_y));
+    int row1 = std::min<int>(height_ - 1, std::floor(max_y));
+    for (int row = row0; row <= row1; row++) {
+      float y = row + 0.5f;
+      float x0 = width_, x1 = -1;
+      for (int i = 0; i < count; i++) {
+        const b2Vec2 &a = points[i];
+        const b2Vec2 &b = points[(i + 1) % count];
+        if ((a.y <= y) == (b.y <= y)) {
+          continue;
+        }
+        float x = a.x + (y - a.y) / (b.y - a.y) * (b.x - a.x);
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+      }
+      Span(row, x0, x1, value);
+    }
+    for (int i = 0; i < count; i++) {
+      Line(points[i], points[(i + 1) % count], value);
+    }
+  }
+
+  /**
+   * @brief Fill a disc, the pixels whose center is inside, and its center
+   */
+  void Circle(const b2Vec2 &center, float radius, uint8_t value) {
+    float r = radius * scale_;
+    int row0 = std::max<int>(0, std::floor(center.y - r));
+    int row1 = std::min<int>(height_ - 1, std::floor(center.y + r));
+    for (int row = row0; row <= row1; row++) {
+      float dy = row + 0.5f - center.y;
+      if (std::abs(dy) > r) {
+        continue;
+      }
+      float half = std::sqrt(r * r - dy * dy);
+      Span(row, center.x - half, center.x + half, value);
+    }
+    Set(std::floor(center.x), std::floor(center.y), value);
+  }
+
+ private:
+  b2Transform view_;     ///< transform of the view frame in the world
+  float scale_;          ///< pixels per meter
+  int width_;            ///< width in pixels
+  int height_;           ///< height in pixels
+  uint8_t *image_;       ///< the pixels
+
+  /**
+   * @brief Set a pixel to a value unless it has a higher one, pixels outside
+   * of the image are ignored
+   */
+  void Set(int col, int row, uint8_t value) {
+    if (col < 0 || row < 0 || col >= width_ || row >= height_) {
+      return;
+    }
+    uint8_t &pixel = image_[row * width_ + col];
+    pixel = std::max(pixel, value);
+  }
+
+  /**
+   * @brief Set the pixels of a row whose center is in [x0, x1]
+   */
+  void Span(int row, float x0, float x1, uint8_t value) {
+    int col0 = std::max<int>(0, std::ceil(x0 - 0.5f));
+    int col1 = std::min<int>(width_ - 1, std::floor(x1 - 0.5f));
+    for (int col = col0; col <= col1; col++) {
+      Set(col, row, value);
+    }
+  }
+
+  /**
+   * @brief Clip a segment to the image, Liang-Barsky
+   * @return false if the segment is outside of the image
+   */
+  bool Clip(b2Vec2 *a, b2Vec2 *b) const {
+    b2Vec2 d = *b - *a;
+    float p[4] = {-d.x, d.x, -d.y, d.y};
+    float q[4] = {a->x, width_ - a->x, a->y, height_ - a->y};
+    float t0 = 0, t1 = 1;
+    for (int k = 0; k < 4; k++) {
+      if (p[k] == 0) {
+        if (q[k] < 0) {
+          return false;
+        }
+        continue;
+      }
+      float t = q[k] / p[k];
+      if (p[k] < 0) {
+        t0 = std::max(t0, t);
+      } else {
+        t1 = std::min(t1, t);
+      }
+    }
+    if (t0 > t1) {
+      return false;
+    }
+    *b = *a + t1 * d;
+    *a = *a + t0 * d;
+    return true;
+  }
+};
+}
+
+int RasterBatch::Add(const Params &params) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int id;
+  if (!free_.empty()) {
+    id = free_.back();
+    free_.pop_back();
+  } else {
+    id = views_.size();
+    views_.emplace_back();
+  }
+  views_[id].params = params;
+  views_[id].image.assign(params.width * params.height, FREE);
+  views_[id].used = true;
+  size_++;
+  return id;
+}
+
+void RasterBatch::Remove(int id) {
+  if (id < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  views_[id].used = false;
+  views_[id].image.clear();
+  views_[id].image.shrink_to_fit();
+  free_.push_back(id);
+  size_--;
+
+  // a request of the removed view is dropped
+  jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(),
+                             [id](const Job &job) { return job.id == id; }),
+              jobs_.end());
+}
+
+void RasterBatch::Request(int id, const std::function<void()> &done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(Job{id, done});
+}
+
+void RasterBatch::Render() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (jobs_.empty()) {
+      return;
+    }
+    rendering_.swap(jobs_);
+  }
+
+  SensorExecutor::Get().ParallelFor(
+      rendering_.size(), 1, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+          View &view = views_[rendering_[i].id];
+          const Pose &o = view.params.origin;
+          b2Body *body = view.params.body->physics_body_;
+          b2Transform xf = b2Mul(
+              body->GetTransform(),
+              b2Transform(b2Vec2(o.x, o.y), b2Rot(o.theta)));
+          Rasterize(body->GetWorld(), xf, view.params, view.image.data());
+        }
+      });
+
+  for (const Job &job : rendering_) {
+    job.done();
+  }
+  rendering_.clear();
+}
+
+void RasterBatch::Rasterize(b2World *world, const b2Transform &view,
+                            const Params &params, uint8_t *image) {
+  std::fill(image, image + params.width * params.height, FREE);
+  Canvas canvas(view, params, image);
+
+  // the window is a rotated rectangle, the broadphase is queried for its
+  // bounds
+  b2AABB aabb;
+  aabb.lowerBound.Set(FLT_MAX, FLT_MAX);
+  aabb.upperBound.Set(-FLT_MAX, -FLT_MAX);
+  for (float col : {0.0f, float(params.width)}) {
+    for (float row : {0.0f, float(params.height)}) {
+      b2Vec2 p = canvas.ToWorld(col, row);
+      aabb.lowerBound = b2Min(aabb.lowerBound, p);
+      aabb.upperBound = b2Max(aabb.upperBound, p);
+    }
+  }
+
+  ViewCollector collector;
+  collector.layers_bits = params.layers_bits;
+  collector.ignore = params.ignore;
+  world->QueryAABB(&collector, aabb);
+
+  std::vector<b2Fixture *> &fixtures = collector.fixtures;
+  std::sort(fixtures.begin(), fixtures.end());
+  fixtures.erase(std::unique(fixtures.begin(), fixtures.end()),
+                 fixtures.end());
+
+  b2Vec2 points[b2_maxPolygonVertices];
+  for (b2Fixture *fixture : fixtures) {
+    const b2Transform &xf = fixture->GetBody()->GetTransform();
+    uint8_t value =
+        fixture->GetBody()->GetType() == b2_staticBody ? STATIC : DYNAMIC;
+    const b2Shape *shape = fixture->GetShape();
+
+    switch (shape->GetType()) {
+      case b2Shape::e_circle: {
+        const b2CircleShape *circle = static_cast<const b2CircleShape *>(shape);
+        canvas.Circle(canvas.ToPixel(b2Mul(xf, circle->m_p)), circle->m_radius,
+                      value);
+        break;
+      }
+      case b2Shape::e_edge: {
+        const b2EdgeShape *edge = static_cast<const b2EdgeShape *>(shape);
+        canvas.Line(canvas.ToPixel(b2Mul(xf, edge->m_vertex1)),
+                    canvas.ToPixel(b2Mul(xf, edge->m_vertex2)), value);
+        break;
+      }
+      case b2Shape::e_polygon: {
+        const b2PolygonShape *polygon =
+            static_cast<const b2PolygonShape *>(shape);
+        for (int32 i = 0; i < polygon->m_count; i++) {
+          points[i] = canvas.ToPixel(b2Mul(xf, polygon->m_vertices[i]));
+        }
+        canvas.Polygon(points, polygon->m_count, value);
+        break;
+      }
+      case b2Shape::e_chain: {
+        const b2ChainShape *chain = static_cast<const b2ChainShape *>(shape);
+        b2EdgeShape edge;
+        for (int32 i = 0; i < chain->GetChildCount(); i++) {
+          chain->GetChildEdge(&edge, i);
+          canvas.Line(canvas.ToPixel(b2Mul(xf, edge.m_vertex1)),
+                      canvas.ToPixel(b2Mul(xf, edge.m_vertex2)), value);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+};  // namespace flatland_server
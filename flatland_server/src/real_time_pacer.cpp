@@ -0,0 +1,94 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 real_time_pacer.cpp
+ * @brief	 Paces the simulation loop to a target real time factor
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/real_time_pacer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_server {
+
+RealTimePacer::RealTimePacer(double target_factor,
+                             unsigned int max_steps_per_cycle, double max_lag)
+    : target_factor_(target_factor),
+      max_steps_per_cycle_(std::max(max_steps_per_cycle, 1u)),
+      max_lag_(max_lag),
+      reference_wall_(0),
+      reference_sim_(0),
+      slips_(0) {}
+
+void RealTimePacer::Reset(double wall_time, double sim_time) {
+  reference_wall_ = wall_time;
+  reference_sim_ = sim_time;
+}
+
+unsigned int RealTimePacer::NextCycle(double wall_time, double sim_time,
+                                      double step_size, double *sleep) {
+  // the wall time at which the simulation reaches sim_time on target
+  double due = reference_wall_ + (sim_time - reference_sim_) / target_factor_;
+  double lag = wall_time - due;
+
+  if (lag < 0) {
+    *sleep = -lag;
+    return 1;
+  }
+  *sleep = 0;
+
+  // far behind, e.g. after a pause or a slow spawn: catching up would run the
+  // simulation faster than the target for a long time, so the lag is dropped
+  if (lag > max_lag_) {
+    slips_++;
+    Reset(wall_time, sim_time);
+    return 1;
+  }
+
+  // the steps needed to get back on target, the last one is partly ahead.
+  // The tolerance keeps rounding errors from dropping a step
+  double behind = lag * target_factor_;
+  unsigned int steps =
+      1 + (unsigned int)std::floor(behind / step_size + 1e-9);
+  return std::min(steps, max_steps_per_cycle_);
+}
+};  // namespace flatland_server
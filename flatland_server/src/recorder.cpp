@@ -0,0 +1,181 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 recorder.cpp
+ * @brief	 Records and replays the inputs of a simulation run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/recorder.h>
+#include <random>
+
+namespace flatland_server {
+
+Recorder &Recorder::Get() {
+  static Recorder instance;
+  return instance;
+}
+
+void Recorder::StartRecording(const std::string &path) {
+  Stop();
+  std::lock_guard<std::mutex> lock(mutex_);
+  writer_.reset(new RunLog::Writer(path));
+  step_ = 0;
+  recording_ = true;
+}
+
+void Recorder::StartReplay(const std::string &path) {
+  Stop();
+  std::vector<RunLog::Record> records = RunLog::Read(path);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.clear();
+  seeds_.clear();
+  for (auto &r : records) {
+    if (r.type == RunLog::Record::SEED && r.data.size() == 4) {
+      seeds_[r.channel].push_back(r.data[0] | (r.data[1] << 8) |
+                                  (r.data[2] << 16) |
+                                  (uint32_t(r.data[3]) << 24));
+    } else if (r.type == RunLog::Record::DATA) {
+      records_.push_back(std::move(r));
+    } else if (r.type == RunLog::Record::END) {
+      end_step_ = r.step;
+    }
+  }
+  next_record_ = 0;
+  step_ = 0;
+  mismatches_ = 0;
+  replaying_ = true;
+}
+
+void Recorder::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  recording_ = false;
+  replaying_ = false;
+  records_.clear();
+  seeds_.clear();
+  if (writer_) {
+    std::unique_ptr<RunLog::Writer> writer = std::move(writer_);
+    writer->Close(step_);
+  }
+}
+
+void Recorder::SetStep(uint64_t step) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  step_ = step;
+}
+
+bool Recorder::ReplayStep(uint64_t step) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  step_ = step;
+  if (!replaying_) return true;
+
+  // the handlers are called without the lock, since they may record or pick
+  // seeds, e.g. a replayed spawn_model call
+  while (next_record_ < records_.size() &&
+         records_[next_record_].step <= step) {
+    const RunLog::Record &r = records_[next_record_++];
+    auto it = handlers_.find(r.channel);
+    if (it == handlers_.end()) {
+      mismatches_++;
+      continue;
+    }
+    Handler handler = it->second.second;
+    std::vector<uint8_t> data = r.data;
+    lock.unlock();
+    handler(data);
+    lock.lock();
+  }
+  return step < end_step_;
+}
+
+void Recorder::Record(const std::string &channel,
+                      const std::vector<uint8_t> &data) {
+  if (!recording_) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (writer_) {
+    writer_->Write(step_, RunLog::Record::DATA, channel, data);
+  }
+}
+
+uint32_t Recorder::Seed(const std::string &channel) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (replaying_) {
+    auto it = seeds_.find(channel);
+    if (it != seeds_.end() && !it->second.empty()) {
+      uint32_t seed = it->second.front();
+      it->second.pop_front();
+      return seed;
+    }
+    mismatches_++;
+  }
+
+  std::random_device rd;
+  uint32_t seed = rd();
+  if (writer_) {
+    std::vector<uint8_t> data = {uint8_t(seed), uint8_t(seed >> 8),
+                                 uint8_t(seed >> 16), uint8_t(seed >> 24)};
+    writer_->Write(step_, RunLog::Record::SEED, channel, data);
+  }
+  return seed;
+}
+
+unsigned int Recorder::AddHandler(const std::string &channel,
+                                  const Handler &handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  unsigned int id = next_handler_++;
+  handlers_[channel] = std::make_pair(id, handler);
+  return id;
+}
+
+void Recorder::RemoveHandler(unsigned int id) {
+  if (id == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = handlers_.begin(); it != handlers_.end(); ++it) {
+    if (it->second.first == id) {
+      handlers_.erase(it);
+      return;
+    }
+  }
+}
+
+};  // namespace flatland_server
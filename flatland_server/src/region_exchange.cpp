@@ -0,0 +1,273 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 region_exchange.cpp
+ * @brief	 Exchanges the models between the regions of a distributed simulation
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/region_exchange.h>
+#include <flatland_server/world.h>
+#include <flatland_server/yaml_reader.h>
+#include <set>
+#include <vector>
+
+namespace flatland_server {
+
+namespace {
+/**
+ * @brief Get the state of the bodies of a model as a message
+ */
+flatland_msgs::RegionModel ModelToMsg(const Model *model,
+                                      const std::string &world_ns) {
+  flatland_msgs::RegionModel msg;
+  msg.name = model->GetName();
+  msg.yaml_path = model->yaml_path_;
+
+  // the namespace without the prefix added by LoadModel
+  msg.ns = model->namespace_;
+  if (!world_ns.empty()) {
+    msg.ns = msg.ns.length() > world_ns.length()
+                 ? msg.ns.substr(world_ns.length() + 1)
+                 : "";
+  }
+
+  for (const auto &body : model->bodies_) {
+    const b2Body *b = body->physics_body_;
+    geometry_msgs::Pose2D pose;
+    pose.x = b->GetPosition().x;
+    pose.y = b->GetPosition().y;
+    pose.theta = b->GetAngle();
+    flatland_msgs::Vector2 linear;
+    linear.x = b->GetLinearVelocity().x;
+    linear.y = b->GetLinearVelocity().y;
+    msg.poses.push_back(pose);
+    msg.linear.push_back(linear);
+    msg.angular.push_back(b->GetAngularVelocity());
+  }
+  return msg;
+}
+
+/**
+ * @brief Set the state of the bodies of a model from a message, nothing is
+ * done if the model does not have as many bodies
+ * @return If the state was set
+ */
+bool SetModelState(Model *model, const flatland_msgs::RegionModel &msg) {
+  size_t count = model->bodies_.size();
+  if (msg.poses.size() != count || msg.linear.size() != count ||
+      msg.angular.size() != count) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    b2Body *b = model->bodies_[i]->physics_body_;
+    b->SetTransform(b2Vec2(msg.poses[i].x, msg.poses[i].y),
+                    msg.poses[i].theta);
+    b->SetLinearVelocity(b2Vec2(msg.linear[i].x, msg.linear[i].y));
+    b->SetAngularVelocity(msg.angular[i]);
+  }
+  return true;
+}
+};  // namespace
+
+RegionExchange::RegionExchange(World *world, const Params &params)
+    : world_(world), params_(params) {
+  // the servers are usually in their own namespaces, the topic is absolute
+  ros::NodeHandle nh;
+  publisher_ = nh.advertise<flatland_msgs::RegionModels>(params_.topic, 16);
+  subscriber_.Subscribe(nh, params_.topic, 16, &RegionExchange::Apply, this);
+}
+
+RegionExchange::~RegionExchange() {
+  subscriber_.Shutdown();
+  for (auto &entry : ghosts_) {
+    delete entry.second.model;
+  }
+}
+
+bool RegionExchange::Contains(const b2Vec2 &p, double grow) const {
+  return p.x >= params_.bounds.lowerBound.x - grow &&
+         p.y >= params_.bounds.lowerBound.y - grow &&
+         p.x < params_.bounds.upperBound.x + grow &&
+         p.y < params_.bounds.upperBound.y + grow;
+}
+
+Model *RegionExchange::GetGhost(const std::string &name) const {
+  auto it = ghosts_.find(name);
+  return it != ghosts_.end() ? it->second.model : nullptr;
+}
+
+void RegionExchange::DeleteForeignModels() {
+  std::vector<std::string> foreign;
+  for (const Model *model : world_->models_) {
+    if (!model->bodies_.empty() &&
+        !Contains(model->bodies_[0]->physics_body_->GetPosition(), 0)) {
+      foreign.push_back(model->GetName());
+    }
+  }
+  BulkDestroy bulk(world_->physics_world_);
+  for (const auto &name : foreign) {
+    world_->DeleteModel(name);
+  }
+}
+
+void RegionExchange::AfterStep(const ros::Time &time) {
+  flatland_msgs::RegionModels msg = Collect(time);
+  if (!msg.migrations.empty() || !msg.ghosts.empty() || sent_ghosts_) {
+    publisher_.publish(msg);
+  }
+  sent_ghosts_ = !msg.ghosts.empty();
+}
+
+flatland_msgs::RegionModels RegionExchange::Collect(const ros::Time &time) {
+  flatland_msgs::RegionModels msg;
+  msg.header.stamp = time;
+  msg.region = params_.name;
+
+  // a model belongs to the region containing its first body
+  std::vector<std::string> departed;
+  for (const Model *model : world_->models_) {
+    if (model->bodies_.empty()) {
+      continue;
+    }
+    b2Vec2 p = model->bodies_[0]->physics_body_->GetPosition();
+    if (!Contains(p, 0)) {
+      msg.migrations.push_back(ModelToMsg(model, world_->namespace_));
+      departed.push_back(model->GetName());
+    } else if (!Contains(p, -params_.margin)) {
+      msg.ghosts.push_back(ModelToMsg(model, world_->namespace_));
+    }
+  }
+
+  BulkDestroy bulk(world_->physics_world_);
+  for (const auto &name : departed) {
+    ROS_INFO_NAMED("RegionExchange", "Model %s left region %s",
+                   Q(name).c_str(), Q(params_.name).c_str());
+    world_->DeleteModel(name);
+  }
+  return msg;
+}
+
+void RegionExchange::Apply(const flatland_msgs::RegionModels &msg) {
+  if (msg.region == params_.name) {
+    return;
+  }
+
+  for (const auto &model : msg.migrations) {
+    if (model.poses.empty() ||
+        !Contains(b2Vec2(model.poses[0].x, model.poses[0].y), 0) ||
+        world_->GetModel(model.name) != nullptr) {
+      continue;
+    }
+
+    // the model replaces its ghost, and only gets its plugins back here
+    DeleteGhost(model.name);
+    try {
+      world_->LoadModel(model.yaml_path, model.ns, model.name,
+                        Pose(model.poses[0].x, model.poses[0].y,
+                             model.poses[0].theta));
+    } catch (const std::exception &e) {
+      ROS_ERROR_NAMED("RegionExchange", "Failed to take over model %s: %s",
+                      Q(model.name).c_str(), e.what());
+      continue;
+    }
+    Model *m = world_->GetModel(model.name);
+    if (SetModelState(m, model)) {
+      for (auto &body : m->bodies_) {
+        world_->plugin_manager_.body_states_.Refresh(body);
+      }
+    }
+    ROS_INFO_NAMED("RegionExchange", "Model %s entered region %s",
+                   Q(model.name).c_str(), Q(params_.name).c_str());
+  }
+
+  // the ghosts of the sender are replaced by the ones in the message
+  std::set<std::string> mirrored;
+  for (const auto &model : msg.ghosts) {
+    if (model.poses.empty() ||
+        !Contains(b2Vec2(model.poses[0].x, model.poses[0].y),
+                  params_.margin) ||
+        world_->GetModel(model.name) != nullptr) {
+      continue;
+    }
+
+    Ghost &ghost = ghosts_[model.name];
+    ghost.region = msg.region;
+    if (!ghost.model) {
+      try {
+        YamlReader reader = world_->ReadModelYaml(model.yaml_path);
+        ghost.model = Model::MakeModel(world_->physics_world_, &world_->cfr_,
+                                       reader, model.yaml_path, "",
+                                       model.name);
+      } catch (const std::exception &e) {
+        ROS_ERROR_NAMED("RegionExchange", "Failed to mirror model %s: %s",
+                        Q(model.name).c_str(), e.what());
+        ghosts_.erase(model.name);
+        continue;
+      }
+      for (auto &body : ghost.model->bodies_) {
+        body->physics_body_->SetType(b2_kinematicBody);
+      }
+    }
+    SetModelState(ghost.model, model);
+    mirrored.insert(model.name);
+  }
+
+  std::vector<std::string> gone;
+  for (const auto &entry : ghosts_) {
+    if (entry.second.region == msg.region && !mirrored.count(entry.first)) {
+      gone.push_back(entry.first);
+    }
+  }
+  for (const auto &name : gone) {
+    DeleteGhost(name);
+  }
+}
+
+void RegionExchange::DeleteGhost(const std::string &name) {
+  auto it = ghosts_.find(name);
+  if (it != ghosts_.end()) {
+    delete it->second.model;
+    ghosts_.erase(it);
+  }
+}
+};  // namespace flatland_server
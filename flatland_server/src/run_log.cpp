@@ -0,0 +1,203 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 run_log.cpp
+ * @brief	 Defines the binary log of the inputs of a simulation run
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/run_log.h>
+#include <flatland_server/yaml_reader.h>
+#include <cstring>
+#include <iterator>
+
+namespace flatland_server {
+
+namespace {
+const char RUN_LOG_MAGIC[8] = {'F', 'L', 'R', 'U', 'N', 'L', 'O', 'G'};
+const uint32_t RUN_LOG_VERSION = 1;
+const uint8_t CHANNEL_RECORD = 0;  ///< names a channel, data is the name
+
+void WriteVarint(std::ofstream &out, uint64_t value) {
+  char bytes[10];
+  int n = 0;
+  do {
+    bytes[n] = value & 0x7f;
+    value >>= 7;
+    if (value) bytes[n] |= 0x80;
+    n++;
+  } while (value);
+  out.write(bytes, n);
+}
+
+/**
+ * @brief Read a varint at pos, advances pos
+ * @return false if the data ends before the varint
+ */
+bool ReadVarint(const std::vector<char> &data, size_t *pos, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *pos < data.size(); shift += 7) {
+    uint8_t byte = data[(*pos)++];
+    *value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+}
+
+RunLog::Writer::Writer(const std::string &path)
+    : path_(path), out_(path, std::ios::binary | std::ios::trunc) {
+  uint8_t version[4] = {RUN_LOG_VERSION & 0xff, (RUN_LOG_VERSION >> 8) & 0xff,
+                        (RUN_LOG_VERSION >> 16) & 0xff, RUN_LOG_VERSION >> 24};
+  out_.write(RUN_LOG_MAGIC, sizeof(RUN_LOG_MAGIC));
+  out_.write(reinterpret_cast<const char *>(version), sizeof(version));
+  if (out_.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+}
+
+void RunLog::Writer::WriteHeader(uint64_t step, uint8_t type, uint64_t channel,
+                                 uint64_t size) {
+  if (step < step_) {
+    throw Exception("Flatland File: Run log records out of order in " +
+                    Q(path_));
+  }
+  WriteVarint(out_, step - step_);
+  WriteVarint(out_, type);
+  WriteVarint(out_, channel);
+  WriteVarint(out_, size);
+  step_ = step;
+}
+
+void RunLog::Writer::Write(uint64_t step, Record::Type type,
+                           const std::string &channel,
+                           const std::vector<uint8_t> &data) {
+  auto it = channels_.find(channel);
+  if (it == channels_.end()) {
+    it = channels_.emplace(channel, channels_.size()).first;
+    WriteHeader(step, CHANNEL_RECORD, it->second, channel.size());
+    out_.write(channel.data(), channel.size());
+  }
+
+  WriteHeader(step, type, it->second, data.size());
+  out_.write(reinterpret_cast<const char *>(data.data()), data.size());
+  if (out_.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+}
+
+void RunLog::Writer::Close(uint64_t step) {
+  WriteHeader(step, Record::END, 0, 0);
+  out_.close();
+  if (out_.fail()) {
+    throw Exception("Flatland File: Failed to write " + Q(path_));
+  }
+}
+
+std::vector<RunLog::Record> RunLog::Read(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+
+  const size_t header_size = sizeof(RUN_LOG_MAGIC) + 4;
+  if (data.size() < header_size ||
+      std::memcmp(data.data(), RUN_LOG_MAGIC, sizeof(RUN_LOG_MAGIC)) != 0) {
+    throw Exception("Flatland File: Invalid run log " + Q(path));
+  }
+  uint32_t version = 0;
+  for (int i = 0; i < 4; i++) {
+    version |= uint32_t(uint8_t(data[sizeof(RUN_LOG_MAGIC) + i])) << (8 * i);
+  }
+  if (version != RUN_LOG_VERSION) {
+    throw Exception("Flatland File: Unsupported run log version " +
+                    std::to_string(version) + " in " + Q(path));
+  }
+
+  std::vector<Record> records;
+  std::vector<std::string> channels;
+  uint64_t step = 0;
+  size_t pos = header_size;
+  while (pos < data.size()) {
+    uint64_t delta, type, channel, size;
+    if (!ReadVarint(data, &pos, &delta) || !ReadVarint(data, &pos, &type) ||
+        !ReadVarint(data, &pos, &channel) || !ReadVarint(data, &pos, &size) ||
+        size > data.size() - pos) {
+      break;  // truncated record, the steps of complete records are kept
+    }
+    const char *content = data.data() + pos;
+    pos += size;
+    step += delta;
+
+    if (type == CHANNEL_RECORD) {
+      if (channel != channels.size()) {
+        throw Exception("Flatland File: Invalid run log " + Q(path));
+      }
+      channels.emplace_back(content, size);
+      continue;
+    }
+    if (type == Record::END) {
+      break;
+    }
+    if ((type != Record::SEED && type != Record::DATA) ||
+        channel >= channels.size()) {
+      throw Exception("Flatland File: Invalid run log " + Q(path));
+    }
+
+    Record r;
+    r.step = step;
+    r.type = Record::Type(type);
+    r.channel = channels[channel];
+    r.data.assign(content, content + size);
+    records.push_back(std::move(r));
+  }
+
+  Record end;
+  end.step = step;
+  end.type = Record::END;
+  records.push_back(std::move(end));
+  return records;
+}
+
+};  // namespace flatland_server
@@ -0,0 +1,250 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sampling_profiler.cpp
+ * @brief	 Samples the call stacks of the process on demand
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/sampling_profiler.h>
+#include <flatland_server/yaml_reader.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace flatland_server {
+
+namespace {
+/// the profiler the signal handler writes to, set once the handler is
+/// installed
+SamplingProfiler *handler_profiler = nullptr;
+
+/// if the signal handler records, the handler stays installed once stopped
+/// since a last signal may still be pending
+std::atomic<bool> handler_sampling(false);
+}
+
+SamplingProfiler &SamplingProfiler::Get() {
+  static SamplingProfiler instance;
+  return instance;
+}
+
+SamplingProfiler::SamplingProfiler()
+    : running_(false), max_samples_(0), count_(0) {}
+
+void SamplingProfiler::Start(double frequency, size_t max_samples) {
+  if (running_) {
+    throw Exception("Flatland SamplingProfiler: Already sampling");
+  }
+  if (!(frequency > 0 && frequency <= 10000)) {
+    throw Exception("Flatland SamplingProfiler: Invalid frequency " +
+                    std::to_string(frequency) + ", must be in (0, 10000]");
+  }
+
+  // the first call loads the unwinder, which allocates, so it must not
+  // happen in the handler
+  void *frame;
+  backtrace(&frame, 1);
+
+  max_samples_ = std::max<size_t>(max_samples, 1);
+  samples_.reset(new Sample[max_samples_]);
+  for (size_t i = 0; i < max_samples_; i++) {
+    samples_[i].complete.store(false, std::memory_order_relaxed);
+  }
+  count_ = 0;
+
+  if (handler_profiler == nullptr) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &SamplingProfiler::HandleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+      throw Exception("Flatland SamplingProfiler: Failed to install handler, " +
+                      std::string(strerror(errno)));
+    }
+    handler_profiler = this;
+  }
+  handler_sampling = true;
+
+  long period = std::max(1L, std::lround(1e6 / frequency));
+  struct itimerval timer;
+  timer.it_interval.tv_sec = period / 1000000;
+  timer.it_interval.tv_usec = period % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    handler_sampling = false;
+    throw Exception("Flatland SamplingProfiler: Failed to start timer, " +
+                    std::string(strerror(errno)));
+  }
+  running_ = true;
+}
+
+void SamplingProfiler::Stop() {
+  if (!running_) {
+    return;
+  }
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  handler_sampling = false;
+  running_ = false;
+}
+
+size_t SamplingProfiler::GetSampleCount() const {
+  return std::min(count_.load(), max_samples_);
+}
+
+size_t SamplingProfiler::GetDroppedCount() const {
+  return count_.load() - GetSampleCount();
+}
+
+void SamplingProfiler::HandleSignal(int) {
+  int saved_errno = errno;
+  SamplingProfiler *profiler = handler_profiler;
+  if (profiler != nullptr && handler_sampling.load()) {
+    size_t i = profiler->count_.fetch_add(1, std::memory_order_relaxed);
+    if (i < profiler->max_samples_) {
+      Sample &sample = profiler->samples_[i];
+      sample.depth = backtrace(sample.frames, Sample::kMaxFrames);
+
+      // the span is open on this thread, so its name outlives the copy
+      const char *span = TraceScope::Current();
+      int n = 0;
+      for (; span != nullptr && span[n] != '\0' &&
+             n < Tracer::Event::kNameSize - 1;
+           n++) {
+        sample.span[n] = span[n];
+      }
+      sample.span[n] = '\0';
+      sample.complete.store(true, std::memory_order_release);
+    }
+  }
+  errno = saved_errno;
+}
+
+std::string SamplingProfiler::Symbolize(void *address) {
+  std::string name;
+  Dl_info info;
+  bool found = dladdr(address, &info) != 0;
+  if (found && info.dli_sname != nullptr) {
+    int status;
+    char *demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    name = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+  } else if (found && info.dli_fname != nullptr) {
+    // e.g. static functions, addr2line finds them from the offset
+    const char *file = strrchr(info.dli_fname, '/');
+    char offset[32];
+    snprintf(offset, sizeof(offset), "+0x%lx",
+             (unsigned long)((char *)address - (char *)info.dli_fbase));
+    name = std::string(file != nullptr ? file + 1 : info.dli_fname) + offset;
+  } else {
+    char hex[32];
+    snprintf(hex, sizeof(hex), "0x%lx", (unsigned long)address);
+    name = hex;
+  }
+  // ; separates the frames of the folded format
+  std::replace(name.begin(), name.end(), ';', ':');
+  return name;
+}
+
+size_t SamplingProfiler::WriteFolded(std::ostream &out,
+                                     const std::string &root) {
+  std::map<void *, std::string> names;
+  std::map<std::string, size_t> stacks;
+  size_t written = 0;
+  size_t count = GetSampleCount();
+  for (size_t i = 0; i < count; i++) {
+    const Sample &sample = samples_[i];
+    if (!sample.complete.load(std::memory_order_acquire)) {
+      continue;
+    }
+    std::string stack = root;
+    if (sample.span[0] != '\0') {
+      stack += ";[" + std::string(sample.span) + "]";
+    }
+    // the two innermost frames are the handler and the signal trampoline
+    for (int f = sample.depth - 1; f >= 2; f--) {
+      auto it = names.find(sample.frames[f]);
+      if (it == names.end()) {
+        it = names.emplace(sample.frames[f], Symbolize(sample.frames[f]))
+                 .first;
+      }
+      stack += ';';
+      stack += it->second;
+    }
+    stacks[stack]++;
+    written++;
+  }
+  for (const auto &stack : stacks) {
+    out << stack.first << ' ' << stack.second << '\n';
+  }
+  return written;
+}
+
+size_t SamplingProfiler::DumpFolded(const std::string &path,
+                                    const std::string &root) {
+  std::ofstream out(path);
+  if (!out) {
+    throw Exception("Flatland File: Failed to open " + Q(path));
+  }
+  size_t written = WriteFolded(out, root);
+  out.close();
+  if (!out) {
+    throw Exception("Flatland File: Failed to write " + Q(path));
+  }
+  return written;
+}
+};  // namespace flatland_server
@@ -0,0 +1,323 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 segment_raycaster.cpp
+ * @brief	 Vectorized raycasting against static line segments
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/segment_raycaster.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace flatland_server {
+
+// maximum number of buckets along each axis of the grid
+static const int MAX_BUCKETS_PER_AXIS = 1024;
+
+SegmentRaycaster::SegmentRaycaster(const std::vector<LineSegment> &segments)
+    : segment_count_(segments.size()), cell_size_(1), cols_(0), rows_(0) {
+  if (segments.empty()) {
+    return;
+  }
+
+  b2Vec2 lo(std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max());
+  b2Vec2 hi = -lo;
+  for (const auto &s : segments) {
+    lo = b2Min(lo, b2Min(s.start.Box2D(), s.end.Box2D()));
+    hi = b2Max(hi, b2Max(s.start.Box2D(), s.end.Box2D()));
+  }
+
+  // pad the bounds slightly so points on the bounds fall inside of the grid
+  const float pad = 1e-3f;
+  min_ = lo - b2Vec2(pad, pad);
+  float w = hi.x - lo.x + 2 * pad;
+  float h = hi.y - lo.y + 2 * pad;
+
+  // aim for a few segments per bucket
+  cell_size_ = std::sqrt(w * h / segments.size()) * 2;
+  cell_size_ = std::max(cell_size_, std::max(w, h) / MAX_BUCKETS_PER_AXIS);
+  cols_ = std::max(1, (int)std::ceil(w / cell_size_));
+  rows_ = std::max(1, (int)std::ceil(h / cell_size_));
+  buckets_.resize(cols_ * rows_);
+
+  // add each segment to every bucket it passes through, row by row the
+  // segment is clipped to the row and the columns it spans are found
+  auto to_cell = [this](float v, float origin, int n) {
+    return std::min(std::max((int)std::floor((v - origin) / cell_size_), 0),
+                    n - 1);
+  };
+
+  const float eps = 1e-4f;
+  for (const auto &s : segments) {
+    b2Vec2 a = s.start.Box2D();
+    b2Vec2 b = s.end.Box2D();
+    int r0 = to_cell(std::min(a.y, b.y) - eps, min_.y, rows_);
+    int r1 = to_cell(std::max(a.y, b.y) + eps, min_.y, rows_);
+
+    for (int r = r0; r <= r1; r++) {
+      float x_lo = std::min(a.x, b.x);
+      float x_hi = std::max(a.x, b.x);
+
+      if (a.y != b.y) {
+        float y_lo = min_.y + r * cell_size_;
+        float y_hi = y_lo + cell_size_;
+        float t_a = (y_lo - a.y) / (b.y - a.y);
+        float t_b = (y_hi - a.y) / (b.y - a.y);
+        float t_min = std::max(0.0f, std::min(t_a, t_b));
+        float t_max = std::min(1.0f, std::max(t_a, t_b));
+        float xa = a.x + t_min * (b.x - a.x);
+        float xb = a.x + t_max * (b.x - a.x);
+        x_lo = std::max(x_lo, std::min(xa, xb));
+        x_hi = std::min(x_hi, std::max(xa, xb));
+      }
+
+      int c0 = to_cell(x_lo - eps, min_.x, cols_);
+      int c1 = to_cell(x_hi + eps, min_.x, cols_);
+      for (int c = c0; c <= c1; c++) {
+        Bucket &bucket = buckets_[r * cols_ + c];
+        bucket.ax.push_back(a.x);
+        bucket.ay.push_back(a.y);
+        bucket.ex.push_back(b.x - a.x);
+        bucket.ey.push_back(b.y - a.y);
+      }
+    }
+  }
+
+  // pad the buckets with degenerate segments which never get hit
+  for (auto &bucket : buckets_) {
+    size_t n = (bucket.ax.size() + LANES - 1) / LANES * LANES;
+    bucket.ax.resize(n, 0);
+    bucket.ay.resize(n, 0);
+    bucket.ex.resize(n, 0);
+    bucket.ey.resize(n, 0);
+  }
+}
+
+void SegmentRaycaster::TestBucket(const Bucket &b, const b2Vec2 &p1,
+                                  const b2Vec2 &r, float &best) {
+  // for ray p1 + t * r and segment a + s * e, with q = a - p1
+  //   t = cross(q, e) / cross(r, e), s = cross(q, r) / cross(r, e)
+  // a hit requires 0 <= t <= 1 and 0 <= s <= 1, parallel segments never hit
+  size_t n = b.ax.size();
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256 px = _mm256_set1_ps(p1.x), py = _mm256_set1_ps(p1.y);
+  const __m256 rx = _mm256_set1_ps(r.x), ry = _mm256_set1_ps(r.y);
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  __m256 vbest = _mm256_set1_ps(best);
+  for (; i + 8 <= n; i += 8) {
+    __m256 qx = _mm256_sub_ps(_mm256_loadu_ps(&b.ax[i]), px);
+    __m256 qy = _mm256_sub_ps(_mm256_loadu_ps(&b.ay[i]), py);
+    __m256 ex = _mm256_loadu_ps(&b.ex[i]);
+    __m256 ey = _mm256_loadu_ps(&b.ey[i]);
+    __m256 denom =
+        _mm256_sub_ps(_mm256_mul_ps(rx, ey), _mm256_mul_ps(ry, ex));
+    __m256 t = _mm256_div_ps(
+        _mm256_sub_ps(_mm256_mul_ps(qx, ey), _mm256_mul_ps(qy, ex)), denom);
+    __m256 s = _mm256_div_ps(
+        _mm256_sub_ps(_mm256_mul_ps(qx, ry), _mm256_mul_ps(qy, rx)), denom);
+    __m256 mask = _mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(denom, zero, _CMP_NEQ_OQ),
+                      _mm256_cmp_ps(t, zero, _CMP_GE_OQ)),
+        _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(t, one, _CMP_LE_OQ),
+                          _mm256_cmp_ps(s, zero, _CMP_GE_OQ)),
+            _mm256_cmp_ps(s, one, _CMP_LE_OQ)));
+    vbest = _mm256_min_ps(vbest, _mm256_blendv_ps(vbest, t, mask));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, vbest);
+  for (int k = 0; k < 8; k++) best = std::min(best, lanes[k]);
+#elif defined(__SSE2__)
+  const __m128 px = _mm_set1_ps(p1.x), py = _mm_set1_ps(p1.y);
+  const __m128 rx = _mm_set1_ps(r.x), ry = _mm_set1_ps(r.y);
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  __m128 vbest = _mm_set1_ps(best);
+  for (; i + 4 <= n; i += 4) {
+    __m128 qx = _mm_sub_ps(_mm_loadu_ps(&b.ax[i]), px);
+    __m128 qy = _mm_sub_ps(_mm_loadu_ps(&b.ay[i]), py);
+    __m128 ex = _mm_loadu_ps(&b.ex[i]);
+    __m128 ey = _mm_loadu_ps(&b.ey[i]);
+    __m128 denom = _mm_sub_ps(_mm_mul_ps(rx, ey), _mm_mul_ps(ry, ex));
+    __m128 t = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(qx, ey), _mm_mul_ps(qy, ex)),
+                          denom);
+    __m128 s = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(qx, ry), _mm_mul_ps(qy, rx)),
+                          denom);
+    __m128 mask = _mm_and_ps(
+        _mm_and_ps(_mm_cmpneq_ps(denom, zero), _mm_cmpge_ps(t, zero)),
+        _mm_and_ps(_mm_and_ps(_mm_cmple_ps(t, one), _mm_cmpge_ps(s, zero)),
+                   _mm_cmple_ps(s, one)));
+    __m128 hit_t = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, vbest));
+    vbest = _mm_min_ps(vbest, hit_t);
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, vbest);
+  for (int k = 0; k < 4; k++) best = std::min(best, lanes[k]);
+#elif defined(__ARM_NEON)
+  const float32x4_t px = vdupq_n_f32(p1.x), py = vdupq_n_f32(p1.y);
+  const float32x4_t rx = vdupq_n_f32(r.x), ry = vdupq_n_f32(r.y);
+  const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+  float32x4_t vbest = vdupq_n_f32(best);
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t qx = vsubq_f32(vld1q_f32(&b.ax[i]), px);
+    float32x4_t qy = vsubq_f32(vld1q_f32(&b.ay[i]), py);
+    float32x4_t ex = vld1q_f32(&b.ex[i]);
+    float32x4_t ey = vld1q_f32(&b.ey[i]);
+    float32x4_t denom = vsubq_f32(vmulq_f32(rx, ey), vmulq_f32(ry, ex));
+    // no division on all NEON versions, use a refined reciprocal instead
+    float32x4_t inv = vrecpeq_f32(denom);
+    inv = vmulq_f32(vrecpsq_f32(denom, inv), inv);
+    inv = vmulq_f32(vrecpsq_f32(denom, inv), inv);
+    float32x4_t t =
+        vmulq_f32(vsubq_f32(vmulq_f32(qx, ey), vmulq_f32(qy, ex)), inv);
+    float32x4_t s =
+        vmulq_f32(vsubq_f32(vmulq_f32(qx, ry), vmulq_f32(qy, rx)), inv);
+    uint32x4_t mask = vandq_u32(
+        vandq_u32(vmvnq_u32(vceqq_f32(denom, zero)), vcgeq_f32(t, zero)),
+        vandq_u32(vandq_u32(vcleq_f32(t, one), vcgeq_f32(s, zero)),
+                  vcleq_f32(s, one)));
+    vbest = vminq_f32(vbest, vbslq_f32(mask, t, vbest));
+  }
+  float lanes[4];
+  vst1q_f32(lanes, vbest);
+  for (int k = 0; k < 4; k++) best = std::min(best, lanes[k]);
+#endif
+
+  // scalar fallback, and the remainder when not vectorized
+  for (; i < n; i++) {
+    float qx = b.ax[i] - p1.x;
+    float qy = b.ay[i] - p1.y;
+    float denom = r.x * b.ey[i] - r.y * b.ex[i];
+    if (denom == 0) continue;
+    float t = (qx * b.ey[i] - qy * b.ex[i]) / denom;
+    float s = (qx * r.y - qy * r.x) / denom;
+    if (t >= 0 && t <= 1 && s >= 0 && s <= 1 && t < best) {
+      best = t;
+    }
+  }
+}
+
+bool SegmentRaycaster::RayCast(const b2Vec2 &p1, const b2Vec2 &p2,
+                               float *fraction) const {
+  if (buckets_.empty()) {
+    return false;
+  }
+
+  const double inf = std::numeric_limits<double>::infinity();
+  b2Vec2 r = p2 - p1;
+  double d[2] = {r.x, r.y};
+  double o[2] = {p1.x - min_.x, p1.y - min_.y};
+  double hi[2] = {cols_ * cell_size_, rows_ * cell_size_};
+
+  // clip the ray to the bucket grid
+  double t0 = 0, t1 = 1;
+  for (int k = 0; k < 2; k++) {
+    if (d[k] == 0) {
+      if (o[k] < 0 || o[k] > hi[k]) {
+        return false;
+      }
+    } else {
+      double ta = (0 - o[k]) / d[k];
+      double tb = (hi[k] - o[k]) / d[k];
+      if (ta > tb) std::swap(ta, tb);
+      t0 = std::max(t0, ta);
+      t1 = std::min(t1, tb);
+    }
+  }
+
+  if (t0 > t1) {
+    return false;
+  }
+
+  int x = std::floor((o[0] + t0 * d[0]) / cell_size_);
+  int y = std::floor((o[1] + t0 * d[1]) / cell_size_);
+  x = std::min(std::max(x, 0), cols_ - 1);
+  y = std::min(std::max(y, 0), rows_ - 1);
+
+  int step_x = d[0] > 0 ? 1 : -1;
+  int step_y = d[1] > 0 ? 1 : -1;
+  double t_delta_x = d[0] != 0 ? cell_size_ / std::fabs(d[0]) : inf;
+  double t_delta_y = d[1] != 0 ? cell_size_ / std::fabs(d[1]) : inf;
+  double t_max_x =
+      d[0] != 0 ? ((x + (d[0] > 0 ? 1 : 0)) * cell_size_ - o[0]) / d[0] : inf;
+  double t_max_y =
+      d[1] != 0 ? ((y + (d[1] > 0 ? 1 : 0)) * cell_size_ - o[1]) / d[1] : inf;
+
+  float best = std::numeric_limits<float>::max();
+
+  // walk the buckets in the order the ray passes them, a hit inside of the
+  // current bucket cannot be beaten by any bucket further down the ray
+  while (x >= 0 && y >= 0 && x < cols_ && y < rows_) {
+    TestBucket(buckets_[y * cols_ + x], p1, r, best);
+
+    double t_exit = std::min(t_max_x, t_max_y);
+    if (best <= t_exit || t_exit > t1) {
+      break;
+    }
+
+    if (t_max_x < t_max_y) {
+      x += step_x;
+      t_max_x += t_delta_x;
+    } else {
+      y += step_y;
+      t_max_y += t_delta_y;
+    }
+  }
+
+  if (best <= 1) {
+    *fraction = best;
+    return true;
+  }
+  return false;
+}
+};  // namespace flatland_server
@@ -0,0 +1,337 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_executor.cpp
+ * @brief	 Shared work stealing executor for sensor plugins
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/thread_config.h>
+#include <flatland_server/tracer.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+thread_local bool SensorExecutor::is_worker_ = false;
+
+SensorExecutor &SensorExecutor::Get() {
+  static SensorExecutor instance;
+  return instance;
+}
+
+SensorExecutor::Priority SensorExecutor::ParsePriority(const std::string &str) {
+  if (str == "high") {
+    return HIGH;
+  } else if (str == "normal") {
+    return NORMAL;
+  } else if (str == "low") {
+    return LOW;
+  }
+  throw YAMLException("Invalid task priority \"" + str +
+                      "\", must be one of high, normal or low");
+}
+
+SensorExecutor::SensorExecutor()
+    : next_queue_(0),
+      num_queued_(0),
+      peak_queued_(0),
+      stop_(false),
+      num_threads_(0) {
+  Start(0);
+}
+
+SensorExecutor::~SensorExecutor() {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  boost::unique_lock<boost::shared_mutex> threads_lock(threads_mutex_);
+  Stop();
+}
+
+void SensorExecutor::SetNumThreads(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  if (num_threads == workers_.size()) {
+    return;
+  }
+
+  // the submitting threads wait for the new workers
+  boost::unique_lock<boost::shared_mutex> threads_lock(threads_mutex_);
+  Stop();
+  Start(num_threads);
+}
+
+bool SensorExecutor::Request(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  bool same;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    same = std::all_of(
+        requests_.begin(), requests_.end(),
+        [num_threads](unsigned int n) { return n == num_threads; });
+    requests_.push_back(num_threads);
+  }
+
+  SetNumThreads(num_threads);
+  return same;
+}
+
+void SensorExecutor::Release(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  auto it = std::find(requests_.begin(), requests_.end(), num_threads);
+  if (it != requests_.end()) {
+    requests_.erase(it);
+  }
+}
+
+void SensorExecutor::SetCpus(const std::vector<unsigned int> &cpus) {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  cpus_ = cpus;
+  if (cpus_.empty()) return;
+
+  for (auto &worker : workers_) {
+    ThreadConfig::SetAffinity(worker.native_handle(), cpus_);
+  }
+}
+
+void SensorExecutor::Start(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  stop_ = false;
+  for (unsigned int i = 0; i < num_threads; i++) {
+    queues_.push_back(new WorkerQueue());
+  }
+
+  for (unsigned int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&SensorExecutor::WorkerLoop, this, i);
+    if (!cpus_.empty()) {
+      ThreadConfig::SetAffinity(workers_.back().native_handle(), cpus_);
+    }
+  }
+  num_threads_ = num_threads;
+}
+
+void SensorExecutor::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+
+  for (auto queue : queues_) {
+    delete queue;
+  }
+  queues_.clear();
+}
+
+void SensorExecutor::Submit(const std::function<void()> &task,
+                            Priority priority) {
+  // the workers are not joined while one of them runs a task, so they do
+  // not take the lock, which would deadlock with SetNumThreads
+  if (is_worker_) {
+    Push(task, priority);
+    return;
+  }
+
+  boost::shared_lock<boost::shared_mutex> lock(threads_mutex_);
+  Push(task, priority);
+}
+
+void SensorExecutor::Push(const std::function<void()> &task,
+                          Priority priority) {
+  unsigned int idx = next_queue_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(queues_[idx]->mutex);
+    queues_[idx]->tasks[priority].push_back(task);
+    unsigned int queued = ++num_queued_;
+    unsigned int peak = peak_queued_;
+    while (queued > peak && !peak_queued_.compare_exchange_weak(peak, queued)) {
+    }
+  }
+
+  // take the wake mutex so a worker checking for work cannot miss the signal
+  { std::lock_guard<std::mutex> lock(wake_mutex_); }
+  wake_cv_.notify_one();
+}
+
+void SensorExecutor::ParallelFor(
+    unsigned int count, unsigned int chunk_size,
+    const std::function<void(unsigned int, unsigned int)> &func,
+    Priority priority) {
+  if (count == 0) {
+    return;
+  }
+
+  if (chunk_size == 0) {
+    unsigned int num_chunks =
+        std::min<unsigned int>(std::max(1u, GetNumThreads()), count);
+    chunk_size = (count + num_chunks - 1) / num_chunks;
+  }
+
+  // the tasks only capture a pointer and the chunk, which std::function
+  // stores without allocating
+  struct Latch {
+    const std::function<void(unsigned int, unsigned int)> *func;
+    unsigned int pending;
+    std::mutex mutex;
+    std::condition_variable cv;
+  } latch;
+  latch.func = &func;
+  latch.pending = 0;
+  Latch *l = &latch;
+
+  // the first chunk is run by the calling thread, the rest go to the workers
+  for (unsigned int begin = chunk_size; begin < count; begin += chunk_size) {
+    unsigned int end = std::min(begin + chunk_size, count);
+    {
+      std::lock_guard<std::mutex> lock(latch.mutex);
+      latch.pending++;
+    }
+
+    Submit(
+        [l, begin, end] {
+          (*l->func)(begin, end);
+
+          std::lock_guard<std::mutex> lock(l->mutex);
+          if (--l->pending == 0) {
+            l->cv.notify_one();
+          }
+        },
+        priority);
+  }
+
+  func(0, std::min(chunk_size, count));
+
+  std::unique_lock<std::mutex> lock(latch.mutex);
+  latch.cv.wait(lock, [l] { return l->pending == 0; });
+}
+
+void SensorExecutor::TaskRing::push_back(const std::function<void()> &task) {
+  if (count == slots.size()) {
+    std::vector<std::function<void()>> grown(std::max<size_t>(16, 2 * count));
+    for (size_t i = 0; i < count; i++) {
+      grown[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+    }
+    slots.swap(grown);
+    head = 0;
+  }
+  slots[(head + count) & (slots.size() - 1)] = task;
+  count++;
+}
+
+void SensorExecutor::TaskRing::pop_front(std::function<void()> &task) {
+  task = std::move(slots[head]);
+  head = (head + 1) & (slots.size() - 1);
+  count--;
+}
+
+void SensorExecutor::TaskRing::pop_back(std::function<void()> &task) {
+  task = std::move(slots[(head + count - 1) & (slots.size() - 1)]);
+  count--;
+}
+
+bool SensorExecutor::TryPop(unsigned int id, std::function<void()> &task) {
+  unsigned int n = queues_.size();
+
+  for (unsigned int p = 0; p < NUM_PRIORITIES; p++) {
+    // own queue is served in FIFO order, tasks are stolen from the back of
+    // the other queues
+    for (unsigned int k = 0; k < n; k++) {
+      WorkerQueue *q = queues_[(id + k) % n];
+      std::lock_guard<std::mutex> lock(q->mutex);
+      TaskRing &tasks = q->tasks[p];
+
+      if (tasks.empty()) {
+        continue;
+      }
+
+      if (k == 0) {
+        tasks.pop_front(task);
+      } else {
+        tasks.pop_back(task);
+      }
+
+      num_queued_--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SensorExecutor::WorkerLoop(unsigned int id) {
+  std::function<void()> task;
+  is_worker_ = true;
+  Tracer::Get().SetThreadName("sensor_worker_" + std::to_string(id));
+
+  for (;;) {
+    if (TryPop(id, task)) {
+      FLATLAND_TRACE("sensor", "task");
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_cv_.wait(lock, [this] { return stop_ || num_queued_ > 0; });
+
+    if (stop_ && num_queued_ == 0) {
+      return;
+    }
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,212 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_scheduler.cpp
+ * @brief	 Batches the rays of all sensors due on a step
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/sensor_scheduler.h>
+#include <flatland_server/tracer.h>
+#include <ros/console.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+void SensorScheduler::Submit(const Job &job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(job);
+  offsets_.push_back(total_rays_);
+  total_rays_ += job.count;
+}
+
+void SensorScheduler::Flush(SensorExecutor::Priority priority) {
+  if (jobs_.empty()) {
+    return;
+  }
+  FLATLAND_TRACE("sensor", "sensor_scheduler_flush");
+  start_ = std::chrono::steady_clock::now();
+
+  if (gpu_raycaster_) {
+    CastOnGpu();
+  }
+  SensorExecutor::Get().ParallelFor(
+      total_rays_, ChunkSize(),
+      [this](unsigned int begin, unsigned int end) { CastRays(begin, end); },
+      priority);
+  AddLatency();
+  FinishJobs();
+}
+
+void SensorScheduler::Launch(b2World *world,
+                             SensorExecutor::Priority priority) {
+  if (jobs_.empty()) {
+    return;
+  }
+  FLATLAND_TRACE("sensor", "sensor_scheduler_launch");
+  start_ = std::chrono::steady_clock::now();
+
+  // the GPU casts before the step, the done callbacks still wait for Join
+  if (gpu_raycaster_) {
+    CastOnGpu();
+  }
+  launched_ = true;
+  if (total_rays_ == 0) {
+    return;
+  }
+  world->TakeRayCastSnapshot(&snapshot_);
+
+  unsigned int chunk_size = ChunkSize();
+  pending_chunks_ = (total_rays_ + chunk_size - 1) / chunk_size;
+  SensorExecutor &executor = SensorExecutor::Get();
+  for (unsigned int begin = 0; begin < total_rays_; begin += chunk_size) {
+    unsigned int end = std::min(begin + chunk_size, total_rays_);
+    executor.Submit(
+        [this, begin, end] {
+          CastRays(begin, end);
+
+          std::lock_guard<std::mutex> lock(launch_mutex_);
+          if (--pending_chunks_ == 0) {
+            launch_cv_.notify_one();
+          }
+        },
+        priority);
+  }
+}
+
+void SensorScheduler::Join() {
+  if (!launched_) {
+    return;
+  }
+  {
+    FLATLAND_TRACE("sensor", "sensor_scheduler_join");
+    std::unique_lock<std::mutex> lock(launch_mutex_);
+    launch_cv_.wait(lock, [this] { return pending_chunks_ == 0; });
+  }
+  launched_ = false;
+  AddLatency();
+  FinishJobs();
+}
+
+SensorScheduler::~SensorScheduler() {
+  // the chunks still running point to this scheduler
+  std::unique_lock<std::mutex> lock(launch_mutex_);
+  launch_cv_.wait(lock, [this] { return pending_chunks_ == 0; });
+}
+
+void SensorScheduler::AddLatency() {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+  latency_.Add(elapsed.count());
+}
+
+unsigned int SensorScheduler::ChunkSize() const {
+  return std::max(1u,
+                  total_rays_ / (4 * SensorExecutor::Get().GetNumThreads()));
+}
+
+void SensorScheduler::CastRays(unsigned int begin, unsigned int end) {
+  // find the job containing the first ray of the chunk, then walk to the
+  // following jobs until the end of the chunk
+  unsigned int j = std::upper_bound(offsets_.begin(), offsets_.end(), begin) -
+                   offsets_.begin() - 1;
+
+  while (begin < end) {
+    unsigned int job_end = offsets_[j] + jobs_[j].count;
+    unsigned int stop = std::min(end, job_end);
+    if (stop > begin) {
+      jobs_[j].cast(begin - offsets_[j], stop - offsets_[j]);
+    }
+    begin = stop;
+    j++;
+  }
+}
+
+void SensorScheduler::CastOnGpu() {
+  gpu_rays_.clear();
+  for (auto &job : jobs_) {
+    if (job.rays) {
+      gpu_rays_.resize(gpu_rays_.size() + job.count);
+      job.rays(gpu_rays_.data() + gpu_rays_.size() - job.count);
+    }
+  }
+  if (gpu_rays_.empty()) {
+    return;
+  }
+
+  // the jobs stay on the CPU when the device fails
+  gpu_hits_.resize(gpu_rays_.size());
+  if (!gpu_raycaster_->Cast(gpu_rays_.data(), gpu_rays_.size(),
+                            gpu_hits_.data())) {
+    ROS_WARN_THROTTLE_NAMED(10, "SensorScheduler",
+                            "GPU ray cast failed, casting on the CPU");
+    return;
+  }
+
+  // the jobs cast on the GPU keep no rays in the CPU batch
+  unsigned int offset = 0;
+  total_rays_ = 0;
+  for (size_t j = 0; j < jobs_.size(); j++) {
+    Job &job = jobs_[j];
+    if (job.rays) {
+      job.hits(gpu_hits_.data() + offset);
+      offset += job.count;
+      job.count = 0;
+    }
+    offsets_[j] = total_rays_;
+    total_rays_ += job.count;
+  }
+}
+
+void SensorScheduler::FinishJobs() {
+  // clear before calling done so the callbacks can already submit new jobs
+  done_jobs_.swap(jobs_);
+  offsets_.clear();
+  total_rays_ = 0;
+
+  for (auto &job : done_jobs_) {
+    if (job.done) {
+      job.done();
+    }
+  }
+  done_jobs_.clear();
+}
+};  // namespace flatland_server
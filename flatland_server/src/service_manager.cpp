@@ -44,27 +44,161 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_server/command_queue.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/memory_report.h>
+#include <flatland_server/recorded_subscriber.h>
+#include <flatland_server/recorder.h>
+#include <flatland_server/sampling_profiler.h>
 #include <flatland_server/service_manager.h>
+#include <flatland_server/topic_stats.h>
+#include <flatland_server/tracer.h>
 #include <flatland_server/types.h>
+#include <ros/callback_queue.h>
+#include <topic_tools/shape_shifter.h>
 #include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace flatland_server {
 
-ServiceManager::ServiceManager(SimulationManager *sim_man, World *world)
+template <class Req, class Res>
+ros::ServiceServer ServiceManager::AdvertiseRecorded(
+    ros::NodeHandle &nh, const std::string &service,
+    bool (ServiceManager::*callback)(Req &, Res &)) {
+  std::function<CommandQueue::Command(Req &, Res &)> prepare =
+      [this, callback](Req &request, Res &response) -> CommandQueue::Command {
+    return [this, callback, &request, &response]() {
+      (this->*callback)(request, response);
+    };
+  };
+  return AdvertiseRecorded(nh, service, prepare);
+}
+
+template <class Req, class Res>
+ros::ServiceServer ServiceManager::AdvertiseRecorded(
+    ros::NodeHandle &nh, const std::string &service,
+    CommandQueue::Command (ServiceManager::*prepare)(Req &, Res &)) {
+  std::function<CommandQueue::Command(Req &, Res &)> function =
+      [this, prepare](Req &request, Res &response) {
+        return (this->*prepare)(request, response);
+      };
+  return AdvertiseRecorded(nh, service, function);
+}
+
+template <class Req, class Res>
+ros::ServiceServer ServiceManager::AdvertiseRecorded(
+    ros::NodeHandle &nh, const std::string &service,
+    const std::function<CommandQueue::Command(Req &, Res &)> &prepare) {
+  std::string channel = "service:" + nh.resolveName(service);
+  replay_handlers_.push_back(Recorder::Get().AddHandler(
+      channel, [prepare](const std::vector<uint8_t> &data) {
+        Req request;
+        Res response;
+        DeserializeMessage(data, &request);
+        CommandQueue::Command apply = prepare(request, response);
+        if (apply) apply();
+      }));
+
+  boost::function<bool(Req &, Res &)> call = [prepare, channel](
+      Req &request, Res &response) {
+    Recorder &recorder = Recorder::Get();
+    if (recorder.IsReplaying()) {
+      ROS_WARN_NAMED("ServiceManager", "Refused %s call while replaying",
+                     channel.c_str());
+      return false;
+    }
+
+    // prepared on the calling thread, an empty command means the call failed
+    // and the response says why
+    CommandQueue::Command apply = prepare(request, response);
+    if (!apply) return true;
+
+    // recorded when applied, so the call is replayed before the same step
+    return CommandQueue::Get().Call([&]() {
+      if (recorder.IsRecording()) {
+        recorder.Record(channel, SerializeMessage(request));
+      }
+      apply();
+    });
+  };
+  return nh.advertiseService(service, call);
+}
+
+template <class Req, class Res>
+ros::ServiceServer ServiceManager::AdvertiseQueued(
+    ros::NodeHandle &nh, const std::string &service,
+    bool (ServiceManager::*callback)(Req &, Res &)) {
+  boost::function<bool(Req &, Res &)> call = [this, callback](
+      Req &request, Res &response) {
+    bool result = false;
+    bool applied = CommandQueue::Get().Call(
+        [&]() { result = (this->*callback)(request, response); });
+    return applied && result;
+  };
+  return nh.advertiseService(service, call);
+}
+
+ServiceManager::ServiceManager(SimulationManager *sim_man, World *world,
+                               const std::string &ns)
     : world_(world), sim_man_(sim_man) {
-  ros::NodeHandle nh;
+  ros::NodeHandle nh(ns);
 
+  // the services changing the world are recorded, step_world is not since
+  // the replay makes the same steps by itself. All of them are applied
+  // through the CommandQueue, which runs them between steps
   spawn_model_service_ =
-      nh.advertiseService("spawn_model", &ServiceManager::SpawnModel, this);
+      AdvertiseRecorded(nh, "spawn_model", &ServiceManager::PrepareSpawnModel);
   delete_model_service_ =
-      nh.advertiseService("delete_model", &ServiceManager::DeleteModel, this);
+      AdvertiseRecorded(nh, "delete_model", &ServiceManager::DeleteModel);
   move_model_service_ =
-      nh.advertiseService("move_model", &ServiceManager::MoveModel, this);
-  pause_service_ = nh.advertiseService("pause", &ServiceManager::Pause, this);
-  resume_service_ =
-      nh.advertiseService("resume", &ServiceManager::Resume, this);
+      AdvertiseRecorded(nh, "move_model", &ServiceManager::MoveModel);
+  spawn_models_service_ = AdvertiseRecorded(
+      nh, "spawn_models", &ServiceManager::PrepareSpawnModels);
+  delete_models_service_ =
+      AdvertiseRecorded(nh, "delete_models", &ServiceManager::DeleteModels);
+  move_models_service_ =
+      AdvertiseRecorded(nh, "move_models", &ServiceManager::MoveModels);
+  set_model_awake_service_ = AdvertiseRecorded(
+      nh, "set_model_awake", &ServiceManager::SetModelAwake);
+  pause_service_ = AdvertiseRecorded(nh, "pause", &ServiceManager::Pause);
+  resume_service_ = AdvertiseRecorded(nh, "resume", &ServiceManager::Resume);
   toggle_pause_service_ =
-      nh.advertiseService("toggle_pause", &ServiceManager::TogglePause, this);
+      AdvertiseRecorded(nh, "toggle_pause", &ServiceManager::TogglePause);
+  step_world_service_ =
+      AdvertiseQueued(nh, "step_world", &ServiceManager::StepWorld);
+  run_until_service_ =
+      AdvertiseQueued(nh, "run_until", &ServiceManager::RunUntil);
+  reset_world_service_ =
+      AdvertiseRecorded(nh, "reset_world", &ServiceManager::ResetWorld);
+  snapshot_world_service_ =
+      AdvertiseRecorded(nh, "snapshot_world", &ServiceManager::SnapshotWorld);
+  save_world_service_ =
+      AdvertiseQueued(nh, "save_world", &ServiceManager::SaveWorld);
+  load_world_service_ =
+      AdvertiseRecorded(nh, "load_world", &ServiceManager::LoadWorld);
+  get_plugin_costs_service_ =
+      AdvertiseQueued(nh, "get_plugin_costs", &ServiceManager::GetPluginCosts);
+  dump_trace_service_ =
+      AdvertiseQueued(nh, "dump_trace", &ServiceManager::DumpTrace);
+  start_profiling_service_ = AdvertiseQueued(
+      nh, "start_profiling", &ServiceManager::StartProfiling);
+  stop_profiling_service_ =
+      AdvertiseQueued(nh, "stop_profiling", &ServiceManager::StopProfiling);
+  get_topic_stats_service_ =
+      AdvertiseQueued(nh, "get_topic_stats", &ServiceManager::GetTopicStats);
+  check_collisions_service_ = AdvertiseQueued(
+      nh, "check_collisions", &ServiceManager::CheckCollisions);
+  raycast_batch_service_ =
+      AdvertiseQueued(nh, "raycast_batch", &ServiceManager::RaycastBatch);
+  get_model_states_service_ = AdvertiseQueued(
+      nh, "get_model_states", &ServiceManager::GetModelStates);
+  reload_layer_service_ =
+      AdvertiseRecorded(nh, "reload_layer", &ServiceManager::ReloadLayer);
+  get_memory_report_service_ = AdvertiseQueued(
+      nh, "get_memory_report", &ServiceManager::GetMemoryReport);
 
   if (spawn_model_service_) {
     ROS_INFO_NAMED("Service Manager", "Model spawning service ready to go");
@@ -85,8 +219,22 @@ ServiceManager::ServiceManager(SimulationManager *sim_man, World *world)
   }
 }
 
+ServiceManager::~ServiceManager() {
+  for (unsigned int id : replay_handlers_) {
+    Recorder::Get().RemoveHandler(id);
+  }
+}
+
 bool ServiceManager::SpawnModel(flatland_msgs::SpawnModel::Request &request,
                                 flatland_msgs::SpawnModel::Response &response) {
+  CommandQueue::Command commit = PrepareSpawnModel(request, response);
+  if (commit) commit();
+  return true;
+}
+
+CommandQueue::Command ServiceManager::PrepareSpawnModel(
+    flatland_msgs::SpawnModel::Request &request,
+    flatland_msgs::SpawnModel::Response &response) {
   ROS_DEBUG_NAMED("ServiceManager",
                   "Model spawn requested with path(\"%s\"), namespace(\"%s\"), "
                   "name(\'%s\"), pose(%f,%f,%f)",
@@ -95,19 +243,34 @@ bool ServiceManager::SpawnModel(flatland_msgs::SpawnModel::Request &request,
                   request.pose.theta);
 
   Pose pose(request.pose.x, request.pose.y, request.pose.theta);
-
-  try {
-    world_->LoadModel(request.yaml_path, request.ns, request.name, pose);
-    response.success = true;
-    response.message = "";
-  } catch (const std::exception &e) {
+  auto fail = [&response](const std::exception &e) {
     response.success = false;
     response.message = std::string(e.what());
     ROS_ERROR_NAMED("ServiceManager", "Failed to load model! Exception: %s",
                     e.what());
+  };
+
+  // parsing the model and creating its plugins does not touch the world, so
+  // with an AsyncSpinner it runs on the thread serving the call, and only the
+  // bodies are created and the plugins initialized between steps
+  std::shared_ptr<PreparedModel> prepared;
+  try {
+    prepared = std::make_shared<PreparedModel>(world_->PrepareModel(
+        request.yaml_path, request.ns, request.name, pose));
+  } catch (const std::exception &e) {
+    fail(e);
+    return CommandQueue::Command();
   }
 
-  return true;
+  return [this, prepared, &response, fail]() {
+    try {
+      world_->CommitModel(*prepared);
+      response.success = true;
+      response.message = "";
+    } catch (const std::exception &e) {
+      fail(e);
+    }
+  };
 }
 
 bool ServiceManager::DeleteModel(
@@ -147,6 +310,660 @@ bool ServiceManager::MoveModel(flatland_msgs::MoveModel::Request &request,
   return true;
 }
 
+bool ServiceManager::SetModelAwake(
+    flatland_msgs::SetModelAwake::Request &request,
+    flatland_msgs::SetModelAwake::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager",
+                  "Model %s requested with name(\"%s\")",
+                  request.awake ? "wake" : "sleep", request.name.c_str());
+
+  try {
+    world_->SetModelAwake(request.name, request.awake);
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+
+  return true;
+}
+
+CommandQueue::Command ServiceManager::PrepareSpawnModels(
+    flatland_msgs::SpawnModels::Request &request,
+    flatland_msgs::SpawnModels::Response &response) {
+  size_t count = request.names.size();
+  ROS_DEBUG_NAMED("ServiceManager", "Spawning of %lu models requested", count);
+
+  response.success.assign(count, false);
+  response.messages.assign(count, "");
+  response.ids.assign(count, 0);
+  if (request.yaml_paths.size() != count || request.poses.size() != count ||
+      (!request.ns.empty() && request.ns.size() != count)) {
+    response.messages.assign(
+        count, "yaml_paths, names, ns and poses must have the same size");
+    ROS_ERROR_NAMED("ServiceManager", "Failed to load models! Invalid sizes");
+    return CommandQueue::Command();
+  }
+
+  // the models are prepared one by one on the thread serving the call, and
+  // the ones prepared successfully are all added between the same steps
+  std::vector<std::shared_ptr<PreparedModel>> prepared(count);
+  for (size_t i = 0; i < count; i++) {
+    const geometry_msgs::Pose2D &p = request.poses[i];
+    std::string ns = request.ns.empty() ? "" : request.ns[i];
+    try {
+      prepared[i] = std::make_shared<PreparedModel>(
+          world_->PrepareModel(request.yaml_paths[i], ns, request.names[i],
+                               Pose(p.x, p.y, p.theta)));
+    } catch (const std::exception &e) {
+      response.messages[i] = std::string(e.what());
+      ROS_ERROR_NAMED("ServiceManager", "Failed to load model! Exception: %s",
+                      e.what());
+    }
+  }
+
+  return [this, prepared, &response]() {
+    for (size_t i = 0; i < prepared.size(); i++) {
+      if (!prepared[i]) continue;
+      try {
+        world_->CommitModel(*prepared[i]);
+        response.success[i] = true;
+        response.ids[i] = world_->GetModel(prepared[i]->name)->id_;
+      } catch (const std::exception &e) {
+        response.messages[i] = std::string(e.what());
+        ROS_ERROR_NAMED("ServiceManager",
+                        "Failed to load model! Exception: %s", e.what());
+      }
+    }
+  };
+}
+
+bool ServiceManager::ReloadLayer(
+    flatland_msgs::ReloadLayer::Request &request,
+    flatland_msgs::ReloadLayer::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Layer reload requested with name(\"%s\")",
+                  request.name.c_str());
+
+  try {
+    size_t removed = 0, added = 0;
+    world_->ReloadLayer(request.name, &removed, &added);
+    response.success = true;
+    response.message = "";
+    response.removed = removed;
+    response.added = added;
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+
+  return true;
+}
+
+std::string ServiceManager::ModelName(const std::vector<std::string> &names,
+                                      const std::vector<uint32_t> &ids,
+                                      size_t index) {
+  if (!names.empty()) {
+    return names[index];
+  }
+  Model *m = world_->GetModelById(ids[index]);
+  if (m == nullptr) {
+    throw Exception("Flatland World: model with id " +
+                    std::to_string(ids[index]) + " does not exist");
+  }
+  return m->GetName();
+}
+
+bool ServiceManager::DeleteModels(
+    flatland_msgs::DeleteModels::Request &request,
+    flatland_msgs::DeleteModels::Response &response) {
+  size_t count =
+      request.names.empty() ? request.ids.size() : request.names.size();
+  ROS_DEBUG_NAMED("ServiceManager", "Deleting of %lu models requested", count);
+
+  response.success.assign(count, false);
+  response.messages.assign(count, "");
+  BulkDestroy bulk(world_->physics_world_);
+  for (size_t i = 0; i < count; i++) {
+    try {
+      world_->DeleteModel(ModelName(request.names, request.ids, i));
+      response.success[i] = true;
+    } catch (const std::exception &e) {
+      response.messages[i] = std::string(e.what());
+    }
+  }
+  return true;
+}
+
+bool ServiceManager::MoveModels(flatland_msgs::MoveModels::Request &request,
+                                flatland_msgs::MoveModels::Response &response) {
+  size_t count =
+      request.names.empty() ? request.ids.size() : request.names.size();
+  ROS_DEBUG_NAMED("ServiceManager", "Moving of %lu models requested", count);
+
+  response.success.assign(count, false);
+  response.messages.assign(count, "");
+  if (request.poses.size() != count) {
+    response.messages.assign(count,
+                             "names or ids and poses must have the same size");
+    return true;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const geometry_msgs::Pose2D &p = request.poses[i];
+    try {
+      world_->MoveModel(ModelName(request.names, request.ids, i),
+                        Pose(p.x, p.y, p.theta));
+      response.success[i] = true;
+    } catch (const std::exception &e) {
+      response.messages[i] = std::string(e.what());
+    }
+  }
+  return true;
+}
+
+bool ServiceManager::StepWorld(flatland_msgs::StepWorld::Request &request,
+                               flatland_msgs::StepWorld::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Step world called, steps(%u)",
+                  request.steps);
+
+  response.success =
+      sim_man_->StepWorld(world_, request.steps, &response.message);
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  if (timekeeper != nullptr) {
+    response.sim_time = timekeeper->GetSimTime();
+  }
+  return true;
+}
+
+bool ServiceManager::RunUntil(flatland_msgs::RunUntil::Request &request,
+                              flatland_msgs::RunUntil::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager",
+                  "Run until called, until_time(%f), max_steps(%u)",
+                  request.until_time.toSec(), request.max_steps);
+
+  response.success = false;
+  if (request.until_time.isZero() && request.max_steps == 0) {
+    response.message = "Either until_time or max_steps must be set";
+    return true;
+  }
+  if (request.regions.size() != 4 * request.region_models.size()) {
+    response.message = "regions must have 4 values per region model";
+    return true;
+  }
+
+  // the models are looked up by id after each step, a plugin may delete them
+  // while the world runs
+  auto model_ids = [this, &response](const std::vector<std::string> &names,
+                                     std::vector<uint32_t> *ids) {
+    for (const std::string &name : names) {
+      Model *model = world_->GetModel(name);
+      if (model == nullptr) {
+        response.message = "Model with name \"" + name + "\" does not exist";
+        return false;
+      }
+      ids->push_back(model->id_);
+    }
+    return true;
+  };
+  std::vector<uint32_t> contact_ids, region_ids;
+  if (!model_ids(request.contact_models, &contact_ids) ||
+      !model_ids(request.region_models, &region_ids)) {
+    return true;
+  }
+
+  // the messages are only counted, on a queue of their own drained after
+  // each step, so the call does not wait for the other callbacks
+  ros::NodeHandle nh;
+  ros::CallbackQueue queue;
+  nh.setCallbackQueue(&queue);
+  std::vector<ros::Subscriber> subscribers;
+  std::string received;
+  for (const std::string &topic : request.topics) {
+    boost::function<void(const topic_tools::ShapeShifter::ConstPtr &)>
+        callback = [&received, topic](
+            const topic_tools::ShapeShifter::ConstPtr &) {
+          if (received.empty()) received = topic;
+        };
+    subscribers.push_back(
+        nh.subscribe<topic_tools::ShapeShifter>(topic, 10, callback));
+  }
+
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  auto stop = [&]() {
+    for (size_t i = 0; i < contact_ids.size(); i++) {
+      Model *model = world_->GetModelById(contact_ids[i]);
+      if (model == nullptr) continue;
+      for (ModelBody *body : model->GetBodies()) {
+        for (b2ContactEdge *edge = body->GetPhysicsBody()->GetContactList();
+             edge != nullptr; edge = edge->next) {
+          b2Contact *contact = edge->contact;
+          if (contact->IsTouching() && contact->IsEnabled() &&
+              !contact->GetFixtureA()->IsSensor() &&
+              !contact->GetFixtureB()->IsSensor()) {
+            response.reason = flatland_msgs::RunUntil::Response::CONTACT;
+            response.trigger = request.contact_models[i];
+            return true;
+          }
+        }
+      }
+    }
+
+    for (size_t i = 0; i < region_ids.size(); i++) {
+      Model *model = world_->GetModelById(region_ids[i]);
+      if (model == nullptr || model->GetBodies().empty()) continue;
+      const b2Vec2 &p = model->GetBodies()[0]->GetPhysicsBody()->GetPosition();
+      const double *region = &request.regions[4 * i];
+      if (p.x >= region[0] && p.y >= region[1] && p.x <= region[2] &&
+          p.y <= region[3]) {
+        response.reason = flatland_msgs::RunUntil::Response::REGION;
+        response.trigger = request.region_models[i];
+        return true;
+      }
+    }
+
+    if (!subscribers.empty()) queue.callAvailable();
+    if (!received.empty()) {
+      response.reason = flatland_msgs::RunUntil::Response::TOPIC;
+      response.trigger = received;
+      return true;
+    }
+
+    if (!request.until_time.isZero() &&
+        timekeeper->GetSimTime() >= request.until_time) {
+      response.reason = flatland_msgs::RunUntil::Response::TIME;
+      return true;
+    }
+    return false;
+  };
+
+  unsigned int steps = 0;
+  response.success = sim_man_->RunWorld(world_, request.max_steps, stop,
+                                        &steps, &response.message);
+  response.steps = steps;
+  if (response.success && response.reason == 0) {
+    response.reason = flatland_msgs::RunUntil::Response::STEPS;
+  }
+  if (timekeeper != nullptr) {
+    response.sim_time = timekeeper->GetSimTime();
+  }
+  return true;
+}
+
+bool ServiceManager::ResetWorld(std_srvs::Trigger::Request &request,
+                                std_srvs::Trigger::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Reset world requested");
+
+  try {
+    world_->Restore(world_->snapshot_);
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+    ROS_ERROR_NAMED("ServiceManager", "Failed to reset world! Exception: %s",
+                    e.what());
+  }
+
+  return true;
+}
+
+bool ServiceManager::SaveWorld(
+    flatland_msgs::WorldCheckpoint::Request &request,
+    flatland_msgs::WorldCheckpoint::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Save world requested, path(\"%s\")",
+                  request.path.c_str());
+
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  ros::Time time = timekeeper ? timekeeper->GetSimTime() : ros::Time(0);
+  try {
+    world_->SaveCheckpoint(request.path, time);
+    response.success = true;
+    response.sim_time = time;
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+    ROS_ERROR_NAMED("ServiceManager", "Failed to save world! Exception: %s",
+                    e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::LoadWorld(
+    flatland_msgs::WorldCheckpoint::Request &request,
+    flatland_msgs::WorldCheckpoint::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Load world requested, path(\"%s\")",
+                  request.path.c_str());
+
+  try {
+    response.sim_time = world_->LoadCheckpoint(request.path);
+    response.success = true;
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+    ROS_ERROR_NAMED("ServiceManager", "Failed to load world! Exception: %s",
+                    e.what());
+    return true;
+  }
+
+  // the plugins with an update rate are rescheduled when the time goes back
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  if (timekeeper != nullptr) {
+    timekeeper->SetSimTime(response.sim_time);
+  }
+  return true;
+}
+
+bool ServiceManager::SnapshotWorld(std_srvs::Trigger::Request &request,
+                                   std_srvs::Trigger::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Snapshot world requested");
+
+  world_->snapshot_ = world_->Snapshot();
+  response.success = true;
+  response.message = "";
+  return true;
+}
+
+bool ServiceManager::GetPluginCosts(
+    flatland_msgs::GetPluginCosts::Request &request,
+    flatland_msgs::GetPluginCosts::Response &response) {
+  PluginManager &plugin_manager = world_->plugin_manager_;
+  response.profiling = plugin_manager.IsProfiling();
+  response.plugins =
+      PluginCostsToMsg(plugin_manager.GetPluginCosts(request.count));
+  response.types =
+      PluginCostsToMsg(plugin_manager.GetPluginTypeCosts(request.count));
+  if (request.reset) {
+    plugin_manager.ResetCosts();
+  }
+  return true;
+}
+
+bool ServiceManager::DumpTrace(flatland_msgs::DumpTrace::Request &request,
+                               flatland_msgs::DumpTrace::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Trace dump requested to %s",
+                  request.path.c_str());
+
+  // called between steps, so only this thread may be recording
+  Tracer &tracer = Tracer::Get();
+  if (request.stop) {
+    tracer.Stop();
+  }
+  try {
+    response.events = tracer.DumpChromeTrace(request.path);
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::StartProfiling(
+    flatland_msgs::StartProfiling::Request &request,
+    flatland_msgs::StartProfiling::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Profiling requested at %f Hz",
+                  request.frequency);
+
+  try {
+    SamplingProfiler::Get().Start(request.frequency > 0 ? request.frequency
+                                                        : 100);
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::StopProfiling(
+    flatland_msgs::StopProfiling::Request &request,
+    flatland_msgs::StopProfiling::Response &response) {
+  SamplingProfiler &profiler = SamplingProfiler::Get();
+  if (!profiler.IsRunning()) {
+    response.success = false;
+    response.message = "Not profiling";
+    return true;
+  }
+  profiler.Stop();
+
+  // the stacks start from the world, with the simulation time they were
+  // written at, to tell apart the profiles of several runs
+  std::string world = world_->namespace_.empty()
+                          ? boost::filesystem::path(sim_man_->world_yaml_file_)
+                                .stem()
+                                .string()
+                          : world_->namespace_;
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  ros::Time time = timekeeper ? timekeeper->GetSimTime() : ros::Time(0);
+  response.path = request.path.empty() ? "flatland_profile_" + world + "_" +
+                                             std::to_string(time.toSec()) +
+                                             ".folded"
+                                       : request.path;
+  ROS_DEBUG_NAMED("ServiceManager", "Profile dump requested to %s",
+                  response.path.c_str());
+
+  try {
+    response.samples = profiler.DumpFolded(
+        response.path, world + " t=" + std::to_string(time.toSec()));
+    response.dropped = profiler.GetDroppedCount();
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::GetTopicStats(
+    flatland_msgs::GetTopicStats::Request &request,
+    flatland_msgs::GetTopicStats::Response &response) {
+  TopicStats &topic_stats = TopicStats::Get();
+  TopicStats::SortKey key;
+  if (!TopicStats::ParseSortKey(request.sort_by, &key)) {
+    response.success = false;
+    response.message = "Unknown sort_by " + request.sort_by;
+    return true;
+  }
+
+  response.enabled = TopicStats::IsEnabled();
+  response.period = topic_stats.GetPeriod();
+  for (const auto &entry : topic_stats.GetTopTalkers(request.count, key)) {
+    flatland_msgs::TopicStat msg;
+    msg.topic = entry.topic;
+    msg.messages = entry.messages;
+    msg.bytes = entry.bytes;
+    msg.bytes_sent = entry.bytes_sent;
+    msg.publish_time = entry.publish_time;
+    msg.max_publish_time = entry.max_publish_time;
+    msg.bytes_per_second =
+        response.period > 0 ? entry.bytes_sent / response.period : 0;
+    response.topics.push_back(msg);
+  }
+  if (request.reset) {
+    topic_stats.Reset();
+  }
+  response.success = true;
+  response.message = "";
+  return true;
+}
+
+bool ServiceManager::CheckCollisions(
+    flatland_msgs::CheckCollisions::Request &request,
+    flatland_msgs::CheckCollisions::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Collision check of %lu poses requested",
+                  request.poses.size());
+
+  // the footprint is read as the footprints of models, see ModelBody
+  b2CircleShape circle;
+  b2PolygonShape polygon;
+  const b2Shape *footprint = &circle;
+  if (request.points.empty()) {
+    if (!(request.radius > 0)) {
+      response.success = false;
+      response.message = "radius must be positive for a circle footprint";
+      return true;
+    }
+    circle.m_p.Set(request.center.x, request.center.y);
+    circle.m_radius = request.radius;
+  } else {
+    if (request.points.size() < 3 ||
+        request.points.size() > b2_maxPolygonVertices) {
+      response.success = false;
+      response.message = "a polygon footprint must have 3 to " +
+                         std::to_string(b2_maxPolygonVertices) + " points";
+      return true;
+    }
+    std::vector<b2Vec2> points;
+    for (const auto &point : request.points) {
+      points.emplace_back(point.x, point.y);
+    }
+    polygon.Set(points.data(), points.size());
+    footprint = &polygon;
+  }
+
+  std::vector<Pose> poses;
+  poses.reserve(request.poses.size());
+  for (const auto &p : request.poses) {
+    poses.emplace_back(p.x, p.y, p.theta);
+  }
+
+  std::vector<std::string> layers = request.layers;
+  if (layers.empty()) {
+    layers.push_back("all");
+  }
+
+  try {
+    std::vector<uint8_t> collisions =
+        world_->CheckCollisions(*footprint, layers, poses);
+    response.collisions.assign(collisions.begin(), collisions.end());
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::RaycastBatch(
+    flatland_msgs::RaycastBatch::Request &request,
+    flatland_msgs::RaycastBatch::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Raycast of %lu rays requested",
+                  request.origins.size() / 2);
+
+  if (request.origins.size() % 2 != 0 ||
+      request.origins.size() != request.directions.size()) {
+    response.success = false;
+    response.message =
+        "origins and directions must have the same even size, x and y of "
+        "each ray";
+    return true;
+  }
+
+  size_t count = request.origins.size() / 2;
+  std::vector<b2Vec2> origins(count), directions(count);
+  for (size_t i = 0; i < count; i++) {
+    origins[i].Set(request.origins[2 * i], request.origins[2 * i + 1]);
+    directions[i].Set(request.directions[2 * i],
+                      request.directions[2 * i + 1]);
+  }
+
+  std::vector<std::string> layers = request.layers;
+  if (layers.empty()) {
+    layers.push_back("all");
+  }
+
+  try {
+    response.ranges = world_->RaycastBatch(origins, directions,
+                                           request.max_range, layers);
+    response.success = true;
+    response.message = "";
+  } catch (const std::exception &e) {
+    response.success = false;
+    response.message = std::string(e.what());
+  }
+  return true;
+}
+
+bool ServiceManager::GetModelStates(
+    flatland_msgs::GetModelStates::Request &request,
+    flatland_msgs::GetModelStates::Response &response) {
+  ROS_DEBUG_NAMED("ServiceManager", "Model states requested, ns(\"%s\")",
+                  request.ns.c_str());
+
+  std::vector<const Model *> models;
+  if (request.names.empty()) {
+    for (const Model *model : world_->models_) {
+      if (!model->bodies_.empty() &&
+          (request.ns.empty() || model->GetNameSpace() == request.ns)) {
+        models.push_back(model);
+      }
+    }
+  } else {
+    for (const std::string &name : request.names) {
+      const Model *model = world_->GetModel(name);
+      if (model == nullptr || model->bodies_.empty()) {
+        response.success = false;
+        response.message = "Model " + Q(name) + " does not exist";
+        return true;
+      }
+      if (request.ns.empty() || model->GetNameSpace() == request.ns) {
+        models.push_back(model);
+      }
+    }
+  }
+
+  Timekeeper *timekeeper = sim_man_->GetTimekeeper(world_);
+  ros::Time time = timekeeper ? timekeeper->GetSimTime() : ros::Time(0);
+  ModelStatesPublisher::Collect(world_->plugin_manager_.body_states_, models,
+                                time, &response.states);
+  response.success = true;
+  response.message = "";
+  return true;
+}
+
+std::vector<flatland_msgs::PluginCost> ServiceManager::PluginCostsToMsg(
+    const std::vector<PluginManager::CostEntry> &entries) {
+  std::vector<flatland_msgs::PluginCost> msgs;
+  for (const auto &entry : entries) {
+    flatland_msgs::PluginCost msg;
+    msg.name = entry.name;
+    msg.type = entry.type;
+    msg.instances = entry.instances;
+    msg.calls = entry.cost.calls;
+    msg.before_physics_step = entry.cost.before_physics_step;
+    msg.after_physics_step = entry.cost.after_physics_step;
+    msg.contact = entry.cost.contact;
+    msg.total = entry.cost.Total();
+    msgs.push_back(msg);
+  }
+  return msgs;
+}
+
+bool ServiceManager::GetMemoryReport(
+    flatland_msgs::GetMemoryReport::Request &request,
+    flatland_msgs::GetMemoryReport::Response &response) {
+  MemoryReport report(world_);
+  response.total_bytes = report.GetTotalBytes();
+  for (const MemoryReport::Entry &entry : report.entries_) {
+    if (!request.subsystem.empty() && entry.subsystem != request.subsystem) {
+      continue;
+    }
+    flatland_msgs::MemoryUsage msg;
+    msg.subsystem = entry.subsystem;
+    msg.name = entry.name;
+    msg.count = entry.count;
+    msg.bytes = entry.bytes;
+    msg.box2d_bytes = entry.box2d_bytes;
+    response.entries.push_back(msg);
+  }
+  return true;
+}
+
 bool ServiceManager::Pause(std_srvs::Empty::Request &request,
                            std_srvs::Empty::Response &response) {
   world_->Pause();
@@ -0,0 +1,207 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 simulation_diagnostics.cpp
+ * @brief	 Publishes the health of the simulation loop on /diagnostics
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/plugin_manager.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/simulation_diagnostics.h>
+#include <flatland_server/world.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace flatland_server {
+
+namespace {
+using diagnostic_msgs::DiagnosticStatus;
+
+const double kStepWarnFraction = 0.9;  ///< of the budget, by the mean step
+const double kOverrunWarnFraction = 0.1;  ///< of the steps over the budget
+const double kFactorWarnFraction = 0.95;  ///< of the target factor
+const double kFactorErrorFraction = 0.5;  ///< of the target factor
+const double kPluginWarnFraction = 0.5;   ///< of the budget, by a plugin
+const size_t kReportedPlugins = 5;        ///< most costly plugins reported
+}
+
+SimulationDiagnostics::SimulationDiagnostics(World *world, double step_budget,
+                                             double target_factor)
+    : world_(world), step_budget_(step_budget), target_factor_(target_factor) {
+  updater_.setHardwareID("flatland");
+  updater_.add("Step time", this, &SimulationDiagnostics::StepTime);
+  updater_.add("Real time factor", this,
+               &SimulationDiagnostics::RealTimeFactor);
+  updater_.add("Sensors", this, &SimulationDiagnostics::Sensors);
+  updater_.add("Plugins", this, &SimulationDiagnostics::Plugins);
+}
+
+void SimulationDiagnostics::AddStep(double work) {
+  steps_++;
+  work_ += work;
+  max_work_ = std::max(max_work_, work);
+  if (step_budget_ > 0 && work > step_budget_) {
+    overruns_++;
+  }
+}
+
+void SimulationDiagnostics::StepTime(
+    diagnostic_updater::DiagnosticStatusWrapper &status) {
+  double mean = steps_ > 0 ? work_ / steps_ : 0;
+  status.add("Steps", steps_);
+  status.add("Mean step time (ms)", mean * 1000);
+  status.add("Max step time (ms)", max_work_ * 1000);
+  if (step_budget_ > 0) {
+    status.add("Budget (ms)", step_budget_ * 1000);
+    status.add("Overruns", overruns_);
+  }
+
+  if (steps_ == 0) {
+    status.summary(DiagnosticStatus::OK, "No steps");
+  } else if (step_budget_ <= 0) {
+    status.summary(DiagnosticStatus::OK, "No step budget");
+  } else if (mean > step_budget_) {
+    status.summary(DiagnosticStatus::ERROR,
+                   "Steps take longer than the budget, the simulation is "
+                   "falling behind");
+  } else if (mean > kStepWarnFraction * step_budget_ ||
+             overruns_ > kOverrunWarnFraction * steps_) {
+    status.summary(DiagnosticStatus::WARN, "Steps overrun the budget");
+  } else {
+    status.summary(DiagnosticStatus::OK, "Steps fit the budget");
+  }
+
+  period_steps_ = steps_;
+  steps_ = 0;
+  overruns_ = 0;
+  work_ = 0;
+  max_work_ = 0;
+}
+
+void SimulationDiagnostics::RealTimeFactor(
+    diagnostic_updater::DiagnosticStatusWrapper &status) {
+  status.add("Achieved", real_time_factor_);
+  if (target_factor_ <= 0) {
+    status.summary(DiagnosticStatus::OK, "No target");
+    return;
+  }
+  status.add("Target", target_factor_);
+
+  double ratio = real_time_factor_ / target_factor_;
+  if (ratio < kFactorErrorFraction) {
+    status.summary(DiagnosticStatus::ERROR, "Far below the target factor");
+  } else if (ratio < kFactorWarnFraction) {
+    status.summary(DiagnosticStatus::WARN, "Below the target factor");
+  } else {
+    status.summary(DiagnosticStatus::OK, "At the target factor");
+  }
+}
+
+void SimulationDiagnostics::Sensors(
+    diagnostic_updater::DiagnosticStatusWrapper &status) {
+  SensorExecutor &executor = SensorExecutor::Get();
+  SensorScheduler &scheduler = world_->plugin_manager_.sensor_scheduler_;
+  const TimingHistogram &latency = scheduler.GetLatency();
+  double p99 = latency.GetPercentile(99);
+  status.add("Threads", executor.GetNumThreads());
+  status.add("Peak queue depth", executor.TakePeakQueuedTasks());
+  status.add("Batches", latency.GetCount());
+  status.add("Mean latency (ms)", latency.GetMean() * 1000);
+  status.add("P99 latency (ms)", p99 * 1000);
+  status.add("Max latency (ms)", latency.GetMax() * 1000);
+  scheduler.ResetLatency();
+
+  if (step_budget_ > 0 && p99 > step_budget_) {
+    status.summary(DiagnosticStatus::WARN,
+                   "Sensor batches take longer than the step budget");
+  } else {
+    status.summary(DiagnosticStatus::OK, "OK");
+  }
+}
+
+void SimulationDiagnostics::Plugins(
+    diagnostic_updater::DiagnosticStatusWrapper &status) {
+  PluginManager &plugin_manager = world_->plugin_manager_;
+  if (!plugin_manager.IsProfiling()) {
+    status.summary(DiagnosticStatus::OK,
+                   "Not profiled, see the profile_plugins parameter");
+    return;
+  }
+
+  // the costs add up since the start, the cost of the period is the
+  // difference with the last report
+  std::map<std::string, double> totals;
+  std::vector<std::pair<double, std::string>> costs;
+  for (const auto &entry : plugin_manager.GetPluginCosts()) {
+    double total = entry.cost.Total();
+    auto last = plugin_costs_.find(entry.name);
+    costs.emplace_back(
+        total - (last != plugin_costs_.end() ? last->second : 0), entry.name);
+    totals[entry.name] = total;
+  }
+  plugin_costs_.swap(totals);
+  std::sort(costs.begin(), costs.end(),
+            [](const std::pair<double, std::string> &a,
+               const std::pair<double, std::string> &b) {
+              return a.first > b.first;
+            });
+
+  std::string overrunning;
+  for (size_t i = 0; i < costs.size(); i++) {
+    double per_step = period_steps_ > 0 ? costs[i].first / period_steps_ : 0;
+    if (i < kReportedPlugins) {
+      status.add(costs[i].second + " (ms/step)", per_step * 1000);
+    }
+    if (step_budget_ > 0 && per_step > kPluginWarnFraction * step_budget_) {
+      overrunning += (overrunning.empty() ? "" : ", ") + costs[i].second;
+    }
+  }
+
+  if (!overrunning.empty()) {
+    status.summary(DiagnosticStatus::WARN,
+                   "Over half of the step budget used by " + overrunning);
+  } else {
+    status.summary(DiagnosticStatus::OK, "OK");
+  }
+}
+};  // namespace flatland_server
@@ -45,45 +45,185 @@
  */
 
 #include "flatland_server/simulation_manager.h"
+#include <flatland_server/command_queue.h>
 #include <flatland_server/debug_visualization.h>
+#include <flatland_server/flight_recorder.h>
 #include <flatland_server/layer.h>
 #include <flatland_server/model.h>
+#include <flatland_server/real_time_pacer.h>
+#include <flatland_server/recorder.h>
+#include <flatland_server/sensor_executor.h>
 #include <flatland_server/service_manager.h>
+#include <flatland_server/simulation_diagnostics.h>
+#include <flatland_server/step_budget_governor.h>
+#include <flatland_server/task_pool.h>
+#include <flatland_server/odometry_aggregator.h>
+#include <flatland_server/publish_queue.h>
+#include <flatland_server/tf_aggregator.h>
+#include <flatland_server/tracer.h>
 #include <flatland_server/world.h>
+#include <flatland_msgs/SimulationMetrics.h>
+#include <flatland_msgs/StepBudget.h>
+#include <flatland_msgs/StepTiming.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
 #include <exception>
 #include <limits>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace flatland_server {
 
+namespace {
+
+/**
+ * @brief Convert the histograms of the stages timed so far to a message
+ * @param[in] timer The timer of the stages
+ * @param[out] msg The message to add the stages to
+ */
+void AddStageTimings(const StepTimer& timer, flatland_msgs::StepTiming* msg) {
+  for (int i = 0; i < StepTimer::STAGE_COUNT; i++) {
+    StepTimer::Stage stage = StepTimer::Stage(i);
+    const TimingHistogram& histogram = timer.GetHistogram(stage);
+    if (histogram.GetCount() == 0) {
+      continue;
+    }
+    flatland_msgs::StageTiming timing;
+    timing.name = StepTimer::GetStageName(stage);
+    timing.count = histogram.GetCount();
+    timing.min = histogram.GetMin();
+    timing.mean = histogram.GetMean();
+    timing.p99 = histogram.GetPercentile(99);
+    timing.max = histogram.GetMax();
+    uint64_t counted = timer.GetCountedSteps(stage);
+    if (counted > 0) {
+      const PerfCounters::Sample& counts = timer.GetCounts(stage);
+      timing.cycles = double(counts.cycles) / counted;
+      timing.instructions = double(counts.instructions) / counted;
+      timing.llc_misses = double(counts.llc_misses) / counted;
+    }
+    msg->stages.push_back(timing);
+  }
+}
+};  // namespace
+
 SimulationManager::SimulationManager(std::string world_yaml_file,
                                      double update_rate, double step_size,
-                                     bool show_viz, double viz_pub_rate)
+                                     bool show_viz, double viz_pub_rate,
+                                     bool lockstep, unsigned int num_worlds,
+                                     bool headless, unsigned int timing_steps,
+                                     unsigned int profile_plugins,
+                                     double real_time_factor,
+                                     unsigned int max_steps_per_cycle,
+                                     unsigned int callback_threads,
+                                     bool profile_startup, double clock_rate,
+                                     double step_budget,
+                                     const std::vector<
+                                         StepBudgetGovernor::Degradation>
+                                         &step_budget_degradations,
+                                     bool deadline_pacing, double spin_tail,
+                                     DeadlinePacer::Overrun overrun_policy,
+                                     bool perf_counters, bool diagnostics,
+                                     double flight_recorder_threshold,
+                                     unsigned int flight_recorder_steps,
+                                     const std::string& flight_recorder_dir)
     : world_(nullptr),
       update_rate_(update_rate),
       step_size_(step_size),
-      show_viz_(show_viz),
+      show_viz_(show_viz && !headless),
       viz_pub_rate_(viz_pub_rate),
-      world_yaml_file_(world_yaml_file) {
+      world_yaml_file_(world_yaml_file),
+      lockstep_(lockstep),
+      num_worlds_(std::max(num_worlds, 1u)),
+      headless_(headless),
+      timing_steps_(timing_steps),
+      profile_plugins_(profile_plugins),
+      real_time_factor_(real_time_factor),
+      max_steps_per_cycle_(std::max(max_steps_per_cycle, 1u)),
+      callback_threads_(callback_threads),
+      profile_startup_(profile_startup),
+      clock_rate_(clock_rate),
+      step_budget_(step_budget),
+      step_budget_degradations_(step_budget_degradations),
+      deadline_pacing_(deadline_pacing),
+      spin_tail_(spin_tail),
+      overrun_policy_(overrun_policy),
+      perf_counters_(perf_counters),
+      diagnostics_(diagnostics),
+      flight_recorder_threshold_(flight_recorder_threshold),
+      flight_recorder_steps_(std::max(flight_recorder_steps, 1u)),
+      flight_recorder_dir_(flight_recorder_dir),
+      timekeeper_(nullptr),
+      steps_(0) {
   ROS_INFO_NAMED("SimMan",
                  "Simulation params: world_yaml_file(%s) update_rate(%f), "
-                 "step_size(%f) show_viz(%s), viz_pub_rate(%f)",
+                 "step_size(%f) show_viz(%s), viz_pub_rate(%f), lockstep(%s), "
+                 "num_worlds(%u), headless(%s), timing_steps(%u), "
+                 "profile_plugins(%u), real_time_factor(%f), "
+                 "max_steps_per_cycle(%u), callback_threads(%u), "
+                 "clock_rate(%f), step_budget(%f), deadline_pacing(%s), "
+                 "spin_tail(%f), overrun_policy(%s), perf_counters(%s), "
+                 "diagnostics(%s), flight_recorder_threshold(%f), "
+                 "flight_recorder_steps(%u)",
                  world_yaml_file_.c_str(), update_rate_, step_size_,
-                 show_viz_ ? "true" : "false", viz_pub_rate_);
+                 show_viz_ ? "true" : "false", viz_pub_rate_,
+                 lockstep_ ? "true" : "false", num_worlds_,
+                 headless_ ? "true" : "false", timing_steps_,
+                 profile_plugins_, real_time_factor_, max_steps_per_cycle_,
+                 callback_threads_, clock_rate_, step_budget_,
+                 deadline_pacing_ ? "true" : "false", spin_tail_,
+                 DeadlinePacer::OverrunName(overrun_policy_).c_str(),
+                 perf_counters_ ? "true" : "false",
+                 diagnostics_ ? "true" : "false", flight_recorder_threshold_,
+                 flight_recorder_steps_);
 }
 
 void SimulationManager::Main() {
   ROS_INFO_NAMED("SimMan", "Initializing...");
   run_simulator_ = true;
 
+  // before anything gets the visualization, which advertises its topics
+  if (headless_) DebugVisualization::SetHeadless(true);
+
+  // with several worlds, each world has its own namespace for its topics,
+  // services and clock. Layers loaded from the same map file share their
+  // read-only geometry, see Layer::ShareGeometry
+  std::vector<std::string> namespaces;
+  for (unsigned int i = 0; i < num_worlds_; i++) {
+    namespaces.push_back(num_worlds_ > 1 ? "world_" + std::to_string(i) : "");
+  }
+
+  // the phases of loading are traced, and summed once the worlds are loaded
+  bool trace_startup = profile_startup_ && !Tracer::Get().IsEnabled();
+  if (trace_startup) Tracer::Get().Start();
+
   try {
-    world_ = World::MakeWorld(world_yaml_file_);
-    ROS_INFO_NAMED("SimMan", "World loaded");
+    for (const auto& ns : namespaces) {
+      worlds_.push_back(World::MakeWorld(world_yaml_file_, ns, headless_));
+      ROS_INFO_NAMED("SimMan", "World loaded%s",
+                     ns.empty() ? "" : (" in namespace " + ns).c_str());
+    }
   } catch (const std::exception& e) {
     ROS_FATAL_NAMED("SimMan", "%s", e.what());
+    for (auto& world : worlds_) {
+      delete world;
+    }
+    worlds_.clear();
     return;
   }
+  world_ = worlds_[0];
+
+  if (profile_startup_) {
+    for (const auto& phase : Tracer::Get().SumDurations("load")) {
+      ROS_INFO_NAMED("SimMan", "Startup phase %s: %.3f ms",
+                     phase.first.c_str(), phase.second * 1e-6);
+    }
+  }
+  if (trace_startup) Tracer::Get().Stop();
 
   if (show_viz_) world_->DebugVisualize();
 
@@ -92,55 +232,560 @@ void SimulationManager::Main() {
   double min_cycle_util = std::numeric_limits<double>::infinity();
   double max_cycle_util = 0;
   double viz_update_period = 1.0f / viz_pub_rate_;
-  ServiceManager service_manager(this, world_);
-  Timekeeper timekeeper;
+  std::vector<std::unique_ptr<ServiceManager>> service_managers;
+  std::vector<std::unique_ptr<Timekeeper>> timekeepers;
+  for (unsigned int i = 0; i < worlds_.size(); i++) {
+    const std::string& ns = namespaces[i];
+    service_managers.emplace_back(new ServiceManager(this, worlds_[i], ns));
+    timekeepers.emplace_back(
+        new Timekeeper(ns.empty() ? "/clock" : ns + "/clock"));
+    timekeepers.back()->SetMaxStepSize(step_size_);
+    timekeepers.back()->SetClockRate(clock_rate_);
+    timekeepers_.push_back(timekeepers.back().get());
+  }
+  Timekeeper& timekeeper = *timekeepers[0];
+  timekeeper_ = &timekeeper;
+  steps_ = 0;
+
+  // the worlds are independent, so they are stepped in parallel. The calling
+  // thread steps one of them
+  unsigned int hardware_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  TaskPool pool(std::min(num_worlds_, hardware_threads) - 1);
+
+  // a replay feeds the recorded inputs on the steps they were recorded at,
+  // so it steps as fast as possible and ignores StepWorld
+  Recorder& recorder = Recorder::Get();
+  bool replay = recorder.IsReplaying();
+  if (replay) lockstep_ = false;
+  if ((replay || recorder.IsRecording()) && lockstep_ && num_worlds_ > 1) {
+    ROS_WARN_NAMED("SimMan",
+                   "The recording follows the steps of the first world, the "
+                   "other worlds may not replay exactly in lockstep mode");
+  }
+
+  // an update rate of 0 or inf steps as fast as possible, without sleeping.
+  // In lockstep mode, the loop only serves callbacks and StepWorld steps. A
+  // target real time factor replaces the update rate: the loop sleeps, or
+  // runs several steps per cycle, to hold the factor actually achieved
+  bool controlled = !replay && !lockstep_ && real_time_factor_ > 0 &&
+                    !std::isinf(real_time_factor_);
+  bool free_run =
+      replay || std::isinf(real_time_factor_) ||
+      (!controlled && (update_rate_ <= 0 || std::isinf(update_rate_)));
+  bool paced = !free_run && !lockstep_ && !controlled;
+  ros::WallRate rate(paced ? update_rate_ : 1.0);
+  std::unique_ptr<DeadlinePacer> deadline_pacer;
+  if (paced && deadline_pacing_) {
+    deadline_pacer.reset(new DeadlinePacer(1.0 / update_rate_, overrun_policy_,
+                                           spin_tail_, max_steps_per_cycle_));
+  }
+  double expected_cycle_time = deadline_pacer
+                                   ? deadline_pacer->GetPeriod()
+                                   : rate.expectedCycleTime().toSec();
+  RealTimePacer pacer(controlled ? real_time_factor_ : 1.0,
+                      max_steps_per_cycle_);
+  double period_sleep = 0;  // wall time slept by the pacer in the period
 
-  ros::WallRate rate(update_rate_);
-  timekeeper.SetMaxStepSize(step_size_);
-  ROS_INFO_NAMED("SimMan", "Simulation loop started");
+  // the achieved real time factor is measured over periods of about 1s
+  ros::NodeHandle nh;
+  ros::Publisher metrics_pub =
+      nh.advertise<flatland_msgs::SimulationMetrics>("simulation_metrics", 1);
+  ros::WallTime period_start = ros::WallTime::now();
+  ros::WallTime last_viz_time = period_start;
+  ros::Time period_sim_start = timekeeper.GetSimTime();
+  uint64_t period_steps = 0;
+  uint64_t period_overruns = 0;  // overruns of the deadline pacer
+  uint64_t period_toi_events = 0;  // TOI events of the physics steps
+  double real_time_factor = 0;
+  double step_rate = 0;
 
+  // the stages of the steps of the first world are timed, and their
+  // histograms published every timing_steps_ steps
+  StepTimer& step_timer = world_->step_timer_;
+  step_timer.SetEnabled(timing_steps_ > 0);
+  ros::Publisher timing_pub;
+  if (timing_steps_ > 0) {
+    timing_pub = nh.advertise<flatland_msgs::StepTiming>("step_timing", 1);
+  }
+  uint64_t timing_start_steps = 0;
+
+  // the hardware counters count this thread, so the stages of the first
+  // world run on the pool threads of the other worlds are only timed
+  PerfCounters counters;
+  if (perf_counters_ && timing_steps_ == 0) {
+    ROS_WARN_NAMED("SimMan", "perf_counters needs timing_steps, ignored");
+  } else if (perf_counters_ && !counters.Open()) {
+    ROS_WARN_NAMED("SimMan", "perf_counters ignored, %s",
+                   counters.GetError().c_str());
+  } else if (perf_counters_) {
+    step_timer.SetCounters(&counters);
+  }
+
+  // the cost of the plugins of every world is available through the
+  // get_plugin_costs service of the world
+  for (auto& world : worlds_) {
+    world->plugin_manager_.SetProfiling(profile_plugins_ > 0);
+  }
+
+  // with an AsyncSpinner, the callbacks post their changes to the worlds to
+  // the CommandQueue, which is applied before each step. In lockstep mode,
+  // the loop only waits for callbacks and they step the worlds themselves
+  CommandQueue& commands = CommandQueue::Get();
+  std::unique_ptr<ros::AsyncSpinner> spinner;
+  if (callback_threads_ > 0 && lockstep_) {
+    ROS_WARN_NAMED("SimMan", "callback_threads is ignored in lockstep mode");
+  } else if (callback_threads_ > 0) {
+    commands.SetEnabled(true);
+    spinner.reset(new ros::AsyncSpinner(callback_threads_));
+    spinner->start();
+  }
+
+  // when the steps keep overrunning the budget, the sensors and the
+  // visualization do less work until the steps fit again. The degradations
+  // would make a replay differ, and lockstep steps have no budget
+  std::unique_ptr<StepBudgetGovernor> governor;
+  ros::Publisher budget_pub;
+  if (step_budget_ > 0 && (lockstep_ || replay)) {
+    ROS_WARN_NAMED("SimMan",
+                   "step_budget is ignored in lockstep and replay modes");
+  } else if (step_budget_ > 0) {
+    governor.reset(
+        new StepBudgetGovernor(step_budget_, step_budget_degradations_));
+    budget_pub =
+        nh.advertise<flatland_msgs::StepBudget>("step_budget", 1, true);
+  }
+  auto publish_budget = [&]() {
+    flatland_msgs::StepBudget budget;
+    budget.header.stamp = timekeeper.GetSimTime();
+    budget.budget = governor->GetBudget();
+    budget.level = governor->GetLevel();
+    budget.degradations = governor->GetDegradationNames();
+    budget.overruns = governor->GetOverrunCount();
+    budget_pub.publish(budget);
+  };
+  if (governor) publish_budget();
+
+  // the health of the loop on /diagnostics, the steps are held to the step
+  // budget, or else to the cycle time of the pacing
+  std::unique_ptr<SimulationDiagnostics> diagnostics;
+  if (diagnostics_) {
+    double budget = step_budget_;
+    double target = 0;
+    if (controlled) {
+      target = real_time_factor_;
+      if (budget <= 0) budget = timekeeper.GetStepSize() / real_time_factor_;
+    } else if (paced) {
+      target = timekeeper.GetStepSize() / expected_cycle_time;
+      if (budget <= 0) budget = expected_cycle_time;
+    }
+    diagnostics.reset(new SimulationDiagnostics(world_, budget, target));
+  }
+
+  // the last iterations are kept in detail, with the spans of the tracer,
+  // and the ones around a step time spike are written to a file
+  std::unique_ptr<FlightRecorder> flight_recorder;
+  if (flight_recorder_threshold_ > 0 && lockstep_) {
+    ROS_WARN_NAMED("SimMan",
+                   "flight_recorder_threshold is ignored in lockstep mode");
+  } else if (flight_recorder_threshold_ > 0) {
+    flight_recorder.reset(new FlightRecorder(flight_recorder_threshold_,
+                                             flight_recorder_steps_,
+                                             flight_recorder_dir_));
+    step_timer.SetEnabled(true);
+    if (!Tracer::Get().IsEnabled()) Tracer::Get().Start();
+  }
+
+  ROS_INFO_NAMED("SimMan", "Simulation loop started%s",
+                 lockstep_ ? " in lockstep mode"
+                           : replay ? " in replay mode"
+                                    : free_run ? " in free run mode"
+                                               : controlled ? " paced" : "");
+  ros::WallTime start_time = ros::WallTime::now();
+  pacer.Reset(start_time.toSec(), timekeeper.GetSimTime().toSec());
+  if (deadline_pacer) deadline_pacer->Reset(DeadlinePacer::Now());
+
+  // while the pause service holds every world, the loop blocks until a
+  // callback arrives instead of running at the update rate, waking up at
+  // least every kIdleWait seconds to keep the visualization published
+  const double kIdleWait = 0.1;
+  bool was_idle = false;
+
+  Tracer::Get().SetThreadName("simulation_loop");
   while (ros::ok() && run_simulator_) {
-    // for updating visualization at a given rate
-    // see flatland_plugins/update_timer.cpp for this formula
-    double f = 0.0;
-    try {
-      f = fmod(ros::WallTime::now().toSec() +
-                   (rate.expectedCycleTime().toSec() / 2.0),
-               viz_update_period);
-    } catch (std::runtime_error& ex) {
-      ROS_ERROR("Flatland runtime error: [%s]", ex.what());
-    }
-    bool update_viz = ((f >= 0.0) && (f < rate.expectedCycleTime().toSec()));
-
-    world_->Update(timekeeper);  // Step physics by ros cycle time
-
-    if (show_viz_ && update_viz) {
-      world_->DebugVisualize(false);  // no need to update layer
+    FLATLAND_TRACE("loop", "iteration");
+    ros::WallTime iteration_start = ros::WallTime::now();
+    uint64_t iteration_trace_start = Tracer::Now();
+    double iteration_sleep = 0;  // wall time slept by the pacer
+
+    bool idle = !lockstep_ && !replay;
+    for (const auto& world : worlds_) {
+      idle = idle && world->service_paused_;
+    }
+    if (was_idle && !idle) {
+      // the pacer does not make up for the time paused
+      pacer.Reset(iteration_start.toSec(), timekeeper.GetSimTime().toSec());
+      if (deadline_pacer) deadline_pacer->Reset(DeadlinePacer::Now());
+    }
+    was_idle = idle;
+
+    // the inputs recorded after the previous step are fed before this one
+    if (replay && !recorder.ReplayStep(steps_)) {
+      ROS_INFO_NAMED("SimMan", "Replay finished after %lu steps in %.2fs",
+                     (unsigned long)steps_,
+                     (ros::WallTime::now() - start_time).toSec());
+      if (recorder.GetMismatchCount() > 0) {
+        ROS_WARN_NAMED("SimMan",
+                       "%lu recorded inputs or seeds did not match the "
+                       "replayed world, the replay may differ",
+                       (unsigned long)recorder.GetMismatchCount());
+      }
+      break;
+    }
+
+    bool update_viz = false;
+    if (!paced) {
+      ros::WallTime now = ros::WallTime::now();
+      update_viz = (now - last_viz_time).toSec() >= viz_update_period;
+      if (update_viz) last_viz_time = now;
+    } else {
+      // for updating visualization at a given rate
+      // see flatland_plugins/update_timer.cpp for this formula
+      double f = 0.0;
+      try {
+        f = fmod(ros::WallTime::now().toSec() + (expected_cycle_time / 2.0),
+                 viz_update_period);
+      } catch (std::runtime_error& ex) {
+        ROS_ERROR("Flatland runtime error: [%s]", ex.what());
+      }
+      update_viz = ((f >= 0.0) && (f < expected_cycle_time));
+    }
+
+    unsigned int cycle_steps = 1;
+    if (!lockstep_) {
+      if (controlled && !idle) {
+        double sleep;
+        cycle_steps = pacer.NextCycle(ros::WallTime::now().toSec(),
+                                      timekeeper.GetSimTime().toSec(),
+                                      timekeeper.GetStepSize(), &sleep);
+        if (sleep > 0) {
+          FLATLAND_TRACE("loop", "sleep");
+          ros::WallDuration(sleep).sleep();
+          period_sleep += sleep;
+          iteration_sleep = sleep;
+        }
+      }
+
+      // Step physics by ros cycle time
+      for (unsigned int s = 0; s < cycle_steps; s++) {
+        if (spinner) {
+          StepTimer::Scope scope(step_timer, StepTimer::COMMANDS);
+          FLATLAND_TRACE("loop", "commands");
+          commands.Apply();
+        }
+        if (worlds_.size() == 1) {
+          world_->Update(timekeeper);
+        } else {
+          pool.Run(worlds_.size(), [this](unsigned int i) {
+            worlds_[i]->Update(*timekeepers_[i]);
+          });
+        }
+        steps_++;
+        recorder.SetStep(steps_);
+      }
+    }
+
+    if (TfAggregator::IsEnabled()) {
+      FLATLAND_TRACE("publish", "tf");
+      TfAggregator::Get().Publish(timekeeper.GetSimTime());
+    }
+
+    if (OdometryAggregator::IsEnabled()) {
+      FLATLAND_TRACE("publish", "odometry");
+      OdometryAggregator::Get().Publish(timekeeper.GetSimTime());
+    }
+
+    bool skip_viz =
+        governor && (governor->GetDegradations() &
+                     StepBudgetGovernor::SKIP_VISUALIZATION);
+    if (show_viz_ && update_viz && !skip_viz) {
+      StepTimer::Scope scope(step_timer, StepTimer::VISUALIZATION);
+      FLATLAND_TRACE("publish", "visualization");
+      // layers only rebuild their markers when their geometry changed
+      world_->DebugVisualize();
       DebugVisualization::Get().Publish(
           timekeeper);  // publish debug visualization
     }
 
-    ros::spinOnce();
-    rate.sleep();
+    if (lockstep_) {
+      // wait for step requests instead of spinning
+      ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.01));
+    } else if (idle && spinner) {
+      FLATLAND_TRACE("loop", "idle");
+      commands.Wait(kIdleWait);
+    } else if (idle) {
+      FLATLAND_TRACE("loop", "idle");
+      ros::getGlobalCallbackQueue()->callAvailable(
+          ros::WallDuration(kIdleWait));
+    } else if (!spinner) {
+      StepTimer::Scope scope(step_timer, StepTimer::SPIN);
+      FLATLAND_TRACE("loop", "spin");
+      ros::spinOnce();
+    }
+    step_timer.EndStep();
+
+    if (timing_steps_ > 0 && steps_ - timing_start_steps >= timing_steps_) {
+      flatland_msgs::StepTiming timing;
+      timing.header.stamp = timekeeper.GetSimTime();
+      timing.steps = steps_;
+      AddStageTimings(step_timer, &timing);
+      if (profile_plugins_ > 0) {
+        timing.plugins = ServiceManager::PluginCostsToMsg(
+            world_->plugin_manager_.GetPluginCosts(profile_plugins_));
+      }
+      timing_pub.publish(timing);
+      step_timer.Reset();
+      timing_start_steps = steps_;
+    }
+
+    // the work of the iteration is shared by its steps, including the
+    // publishing, which the degradations may save as well
+    double work =
+        (ros::WallTime::now() - iteration_start).toSec() - iteration_sleep;
+    if (diagnostics && !idle && !lockstep_) {
+      for (unsigned int s = 0; s < cycle_steps; s++) {
+        diagnostics->AddStep(work / cycle_steps);
+      }
+    }
+    if (flight_recorder && !idle) {
+      FlightRecorder::Step record;
+      record.step = steps_;
+      record.steps = cycle_steps;
+      record.start = iteration_trace_start;
+      record.duration = uint64_t(std::max(work, 0.0) * 1e9);
+      record.stages = step_timer.GetLastStep();
+      record.contacts = world_->physics_world_->GetContactCount();
+      const b2StepStats& stats = world_->physics_world_->GetStepStats();
+      record.islands = stats.islandCount;
+      record.island_bodies = stats.islandBodyCount;
+      record.pairs = stats.pairCount;
+      record.toi_events = stats.toiEventCount;
+      record.sensor_tasks = SensorExecutor::Get().GetQueuedTasks();
+      if (flight_recorder->Add(record)) {
+        try {
+          std::string path = flight_recorder->Dump();
+          ROS_WARN_NAMED("SimMan",
+                         "Step time over %.2f ms, %lu overruns so far, the "
+                         "steps around it are written to %s",
+                         flight_recorder_threshold_ * 1000,
+                         (unsigned long)flight_recorder->GetOverrunCount(),
+                         path.c_str());
+        } catch (const std::exception& e) {
+          ROS_ERROR_NAMED("SimMan", "%s", e.what());
+        }
+      }
+    }
+    if (governor) {
+      if (governor->AddStep(work / cycle_steps)) {
+        for (auto& world : worlds_) {
+          world->plugin_manager_.SetDegradations(governor->GetDegradations());
+        }
+        publish_budget();
+        std::vector<std::string> names = governor->GetDegradationNames();
+        std::string active;
+        for (const auto& name : names) {
+          active += (active.empty() ? "" : ", ") + name;
+        }
+        ROS_WARN_NAMED("SimMan", "Step budget of %.2f ms, degradations: %s",
+                       step_budget_ * 1000,
+                       active.empty() ? "none" : active.c_str());
+      }
+    }
+
+    if (paced && !idle) {
+      FLATLAND_TRACE("loop", "sleep");
+      if (deadline_pacer) {
+        deadline_pacer->Wait();
+      } else {
+        rate.sleep();
+      }
+    }
 
     iterations++;
 
-    double cycle_time = rate.cycleTime().toSec() * 1000;
-    double expected_cycle_time = rate.expectedCycleTime().toSec() * 1000;
+    ros::WallTime now = ros::WallTime::now();
+    double period = (now - period_start).toSec();
+    if (period >= 1.0) {
+      real_time_factor =
+          (timekeeper.GetSimTime() - period_sim_start).toSec() / period;
+      step_rate = (steps_ - period_steps) / period;
+      period_start = now;
+      period_sim_start = timekeeper.GetSimTime();
+      period_steps = steps_;
+      if (controlled) {
+        filtered_cycle_util = std::max(0.0, 100 * (1 - period_sleep / period));
+      }
+      period_sleep = 0;
+
+      flatland_msgs::SimulationMetrics metrics;
+      metrics.header.stamp = timekeeper.GetSimTime();
+      metrics.real_time_factor = real_time_factor;
+      metrics.target_real_time_factor = controlled ? real_time_factor_ : 0;
+      metrics.step_rate = step_rate;
+      metrics.utilization = paced || controlled ? filtered_cycle_util : 0;
+      metrics.free_run = free_run;
+      metrics.steps = steps_;
+      b2BlockAllocatorStats allocator =
+          world_->physics_world_->GetAllocatorStats();
+      metrics.allocator_chunks = allocator.chunkCount;
+      metrics.allocator_bytes = allocator.chunkBytes + allocator.largeBytes;
+      for (int i = 0; i < b2_blockSizes; i++) {
+        metrics.allocator_block_sizes.push_back(allocator.blockSizes[i]);
+        metrics.allocator_chunk_bytes.push_back(allocator.classChunkBytes[i]);
+        metrics.allocator_blocks.push_back(allocator.classBlockCounts[i]);
+      }
+      PhysicsBackend::Stats physics = world_->physics_->GetStats();
+      metrics.physics.bodies = physics.bodies;
+      metrics.physics.awake_bodies = physics.awake_bodies;
+      metrics.physics.fixtures = physics.fixtures;
+      metrics.physics.proxies = physics.proxies;
+      metrics.physics.static_proxies = physics.static_proxies;
+      metrics.physics.tree_height = physics.tree_height;
+      metrics.physics.tree_balance = physics.tree_balance;
+      metrics.physics.tree_quality = physics.tree_quality;
+      metrics.physics.static_tree_height = physics.static_tree_height;
+      metrics.physics.contacts = physics.contacts;
+      metrics.physics.touching_contacts = physics.touching_contacts;
+      metrics.physics.islands = physics.step.islandCount;
+      metrics.physics.island_bodies = physics.step.islandBodyCount;
+      metrics.physics.max_island_bodies = physics.step.maxIslandBodyCount;
+      metrics.physics.island_sizes.assign(
+          physics.step.islandSizes,
+          physics.step.islandSizes + b2_islandSizeClasses);
+      metrics.physics.proxy_reinserts = physics.step.proxyReinsertCount;
+      metrics.physics.pairs = physics.step.pairCount;
+      metrics.physics.toi_events = physics.toi_events - period_toi_events;
+      period_toi_events = physics.toi_events;
+      if (deadline_pacer) {
+        const TimingHistogram& jitter = deadline_pacer->GetJitter();
+        metrics.jitter_mean = jitter.GetMean();
+        metrics.jitter_p99 = jitter.GetPercentile(99);
+        metrics.jitter_max = jitter.GetMax();
+        metrics.overruns = deadline_pacer->GetOverrunCount() - period_overruns;
+        period_overruns = deadline_pacer->GetOverrunCount();
+        deadline_pacer->ResetJitter();
+      }
+      metrics_pub.publish(metrics);
+      if (diagnostics) diagnostics->SetRealTimeFactor(real_time_factor);
+    }
+    if (diagnostics) diagnostics->Update();
+
+    if (controlled) {
+      ROS_INFO_THROTTLE_NAMED(
+          1, "SimMan",
+          "utilization: %.1f%%  target factor: %.2f achieved: %.2f  slips: %u",
+          filtered_cycle_util, real_time_factor_, real_time_factor,
+          pacer.GetSlipCount());
+      continue;
+    }
+
+    if (!paced) {
+      ROS_INFO_THROTTLE_NAMED(
+          1, "SimMan", "%s: %.0f steps/s  factor: %.1f",
+          lockstep_ ? "lockstep" : replay ? "replay" : "free run", step_rate,
+          real_time_factor);
+      continue;
+    }
+
+    double cycle_time = deadline_pacer ? deadline_pacer->GetCycleTime()
+                                       : rate.cycleTime().toSec();
     double cycle_util = cycle_time / expected_cycle_time * 100;  // in percent
-    double factor = timekeeper.GetStepSize() * 1000 / expected_cycle_time;
+    double factor = timekeeper.GetStepSize() / expected_cycle_time;
     min_cycle_util = std::min(cycle_util, min_cycle_util);
     if (iterations > 10) max_cycle_util = std::max(cycle_util, max_cycle_util);
     filtered_cycle_util = 0.99 * filtered_cycle_util + 0.01 * cycle_util;
 
     ROS_INFO_THROTTLE_NAMED(
         1, "SimMan",
-        "utilization: min %.1f%% max %.1f%% ave %.1f%%  factor: %.1f",
-        min_cycle_util, max_cycle_util, filtered_cycle_util, factor);
+        "utilization: min %.1f%% max %.1f%% ave %.1f%%  factor: %.1f "
+        "achieved: %.1f",
+        min_cycle_util, max_cycle_util, filtered_cycle_util, factor,
+        real_time_factor);
+  }
+  step_timer.SetCounters(nullptr);
+
+  // the callbacks still waiting for their commands fail once closed
+  if (spinner) {
+    commands.Close();
+    spinner->stop();
+    commands.SetEnabled(false);
   }
+  DebugVisualization::Get().StopPublishing();
+  PublishQueue& publish_queue = PublishQueue::Get();
+  if (publish_queue.GetCoalescedCount() > 0) {
+    ROS_WARN_NAMED("SimMan",
+                   "%lu messages were dropped by the publish queue to keep up",
+                   (unsigned long)publish_queue.GetCoalescedCount());
+  }
+  publish_queue.Stop();
+  timekeeper_ = nullptr;
+  timekeepers_.clear();
   ROS_INFO_NAMED("SimMan", "Simulation loop ended");
 
-  delete world_;
+  service_managers.clear();
+  for (auto& world : worlds_) {
+    delete world;
+  }
+  worlds_.clear();
+  world_ = nullptr;
+}
+
+bool SimulationManager::StepWorld(World* world, unsigned int steps,
+                                  std::string* message) {
+  unsigned int stepped = 0;
+  return RunWorld(world, std::max(steps, 1u), []() { return false; },
+                  &stepped, message);
+}
+
+bool SimulationManager::RunWorld(World* world, unsigned int max_steps,
+                                 const std::function<bool()>& stop,
+                                 unsigned int* steps, std::string* message) {
+  *steps = 0;
+  Timekeeper* timekeeper = GetTimekeeper(world);
+  if (!lockstep_ || timekeeper == nullptr) {
+    *message = "The simulation is not running in lockstep mode";
+    return false;
+  }
+  if (world->IsPaused()) {
+    *message = "The simulation is paused";
+    return false;
+  }
+
+  // World::Update runs the plugins' AfterPhysicsStep before returning
+  do {
+    world->Update(*timekeeper);
+    (*steps)++;
+    if (world == world_) {
+      steps_++;
+      Recorder::Get().SetStep(steps_);
+    }
+  } while (!stop() && (max_steps == 0 || *steps < max_steps) && ros::ok() &&
+           run_simulator_);
+
+  // the caller sees the messages of the steps and the time it stepped to,
+  // even if the clock is throttled
+  PublishQueue::Get().Flush();
+  timekeeper->EnsureClockPublished();
+  return true;
+}
+
+Timekeeper* SimulationManager::GetTimekeeper(const World* world) {
+  for (unsigned int i = 0; i < timekeepers_.size(); i++) {
+    if (worlds_[i] == world) {
+      return timekeepers_[i];
+    }
+  }
+  return nullptr;
 }
 
 void SimulationManager::Shutdown() {
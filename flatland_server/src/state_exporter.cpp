@@ -0,0 +1,330 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_exporter.cpp
+ * @brief	 Exports the world state to shared memory
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/state_exporter.h>
+#include <flatland_server/yaml_reader.h>
+#include <ros/ros.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+namespace flatland_server {
+
+namespace {
+uint64_t Align(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+void CopyName(const std::string &name, char *out) {
+  size_t length = std::min(name.size(), STATE_EXPORT_NAME_SIZE - 1);
+  std::memcpy(out, name.data(), length);
+  std::memset(out + length, 0, STATE_EXPORT_NAME_SIZE - length);
+}
+};  // namespace
+
+StateExporter::~StateExporter() {
+  if (data_) {
+    munmap(data_, size_);
+    shm_unlink(name_.c_str());
+  }
+}
+
+void StateExporter::Create(const std::string &name, uint32_t slot_count,
+                           uint32_t max_bodies, uint32_t max_scans,
+                           uint32_t max_ranges) {
+  if (data_) {
+    throw Exception("Flatland StateExporter: " + Q(name_) +
+                    " is already created");
+  }
+  if (slot_count == 0) {
+    throw Exception("Flatland StateExporter: " + Q(name) +
+                    " must have at least one slot");
+  }
+
+  uint64_t directory_offset = Align(sizeof(StateExportHeader));
+  uint64_t names_offset =
+      directory_offset + Align(sizeof(StateExportDirectory));
+  uint64_t scan_infos_offset =
+      names_offset + Align(uint64_t(max_bodies) * STATE_EXPORT_NAME_SIZE);
+  uint64_t slots_offset =
+      scan_infos_offset +
+      Align(uint64_t(max_scans) * sizeof(StateExportScanInfo));
+  uint64_t bodies_offset = Align(sizeof(StateExportSlot));
+  uint64_t stamps_offset =
+      bodies_offset + Align(uint64_t(max_bodies) * sizeof(StateExportBody));
+  uint64_t ranges_offset = stamps_offset + uint64_t(max_scans) * sizeof(double);
+  uint64_t slot_size =
+      Align(ranges_offset + uint64_t(max_ranges) * sizeof(float));
+  uint64_t size = slots_offset + slot_count * slot_size;
+
+  // a stale object of a crashed simulation is replaced, its readers keep
+  // their mapping of it
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw Exception("Flatland StateExporter: Failed to create " + Q(name) +
+                    ": " + std::strerror(errno));
+  }
+  if (ftruncate(fd, size) != 0) {
+    int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    throw Exception("Flatland StateExporter: Failed to size " + Q(name) +
+                    ": " + std::strerror(error));
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw Exception("Flatland StateExporter: Failed to map " + Q(name));
+  }
+
+  // the object is zero filled, which is a valid state of all the seqlocks.
+  // The magic is written last, so readers never see a partial header
+  data_ = data;
+  size_ = size;
+  name_ = name;
+  StateExportHeader *header = Header();
+  header->version = STATE_EXPORT_VERSION;
+  header->slot_count = slot_count;
+  header->max_bodies = max_bodies;
+  header->max_scans = max_scans;
+  header->max_ranges = max_ranges;
+  header->size = size;
+  header->directory_offset = directory_offset;
+  header->names_offset = names_offset;
+  header->scan_infos_offset = scan_infos_offset;
+  header->slots_offset = slots_offset;
+  header->slot_size = slot_size;
+  header->bodies_offset = bodies_offset;
+  header->stamps_offset = stamps_offset;
+  header->ranges_offset = ranges_offset;
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header->magic, STATE_EXPORT_MAGIC, sizeof(STATE_EXPORT_MAGIC));
+
+  ROS_INFO_NAMED("StateExporter",
+                 "Exporting the world state to %s, %lu bytes, %u slots",
+                 name_.c_str(), size_, slot_count);
+}
+
+int StateExporter::AddScan(const std::string &name, uint32_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!data_) {
+    return -1;
+  }
+
+  size_t used = 0;
+  int id = -1;
+  for (size_t i = 0; i < scans_.size(); i++) {
+    if (scans_[i].used) {
+      used++;
+    } else if (id < 0) {
+      id = i;
+    }
+  }
+  if (used >= Header()->max_scans ||
+      ranges_.size() + count > Header()->max_ranges) {
+    ROS_WARN_NAMED("StateExporter",
+                   "No room left in %s to export scan %s (%u ranges)",
+                   name_.c_str(), name.c_str(), count);
+    return -1;
+  }
+
+  if (id < 0) {
+    id = scans_.size();
+    scans_.emplace_back();
+  }
+  Scan &scan = scans_[id];
+  scan.name = name;
+  scan.count = count;
+  scan.offset = ranges_.size();
+  scan.stamp = 0;
+  scan.used = true;
+  ranges_.resize(ranges_.size() + count, NAN);
+  scans_dirty_ = true;
+  return id;
+}
+
+void StateExporter::RemoveScan(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id < 0 || size_t(id) >= scans_.size() || !scans_[id].used) {
+    return;
+  }
+  scans_[id].used = false;
+  PackScans();
+  scans_dirty_ = true;
+}
+
+void StateExporter::SetScan(int id, double stamp, const float *ranges) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id < 0 || size_t(id) >= scans_.size() || !scans_[id].used) {
+    return;
+  }
+  Scan &scan = scans_[id];
+  scan.stamp = stamp;
+  std::copy(ranges, ranges + scan.count, ranges_.begin() + scan.offset);
+}
+
+void StateExporter::Write(const BodyStates &states, double time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!data_) {
+    return;
+  }
+
+  if (scans_dirty_ || !names_valid_ ||
+      body_generation_ != states.generation_) {
+    WriteDirectory(states);
+  }
+
+  StateExportHeader *header = Header();
+  step_++;
+  char *slot_data = static_cast<char *>(data_) + header->slots_offset +
+                    ((step_ - 1) % header->slot_count) * header->slot_size;
+  StateExportSlot *slot = reinterpret_cast<StateExportSlot *>(slot_data);
+
+  SeqlockWriteBegin(&slot->seq);
+  uint32_t body_count = std::min<size_t>(states.Size(), header->max_bodies);
+  slot->step = step_;
+  slot->time = time;
+  slot->generation = generation_;
+  slot->body_count = body_count;
+
+  StateExportBody *bodies =
+      reinterpret_cast<StateExportBody *>(slot_data + header->bodies_offset);
+  for (uint32_t i = 0; i < body_count; i++) {
+    StateExportBody &body = bodies[i];
+    body.x = states.x_[i];
+    body.y = states.y_[i];
+    body.angle = states.angle_[i];
+    body.vx = states.vx_[i];
+    body.vy = states.vy_[i];
+    body.omega = states.omega_[i];
+  }
+
+  // the scans in the order of the directory
+  double *stamps =
+      reinterpret_cast<double *>(slot_data + header->stamps_offset);
+  uint32_t scan_count = 0;
+  for (const Scan &scan : scans_) {
+    if (scan.used) {
+      stamps[scan_count++] = scan.stamp;
+    }
+  }
+  slot->scan_count = scan_count;
+  slot->range_count = ranges_.size();
+  std::memcpy(slot_data + header->ranges_offset, ranges_.data(),
+              ranges_.size() * sizeof(float));
+  SeqlockWriteEnd(&slot->seq);
+
+  header->written.store(step_, std::memory_order_release);
+}
+
+void StateExporter::PackScans() {
+  std::vector<float> ranges;
+  for (Scan &scan : scans_) {
+    if (scan.used) {
+      uint32_t offset = ranges.size();
+      ranges.insert(ranges.end(), ranges_.begin() + scan.offset,
+                    ranges_.begin() + scan.offset + scan.count);
+      scan.offset = offset;
+    }
+  }
+  ranges_.swap(ranges);
+}
+
+void StateExporter::WriteDirectory(const BodyStates &states) {
+  StateExportHeader *header = Header();
+  char *base = static_cast<char *>(data_);
+  StateExportDirectory *directory =
+      reinterpret_cast<StateExportDirectory *>(base + header->directory_offset);
+
+  uint32_t body_count = std::min<size_t>(states.Size(), header->max_bodies);
+  if (states.Size() > header->max_bodies && !truncated_warned_) {
+    ROS_WARN_NAMED("StateExporter",
+                   "%s only exports %u of the %lu bodies, increase max_bodies",
+                   name_.c_str(), header->max_bodies, states.Size());
+    truncated_warned_ = true;
+  }
+
+  SeqlockWriteBegin(&directory->seq);
+  generation_++;
+  directory->generation = generation_;
+  directory->body_count = body_count;
+
+  char *names = base + header->names_offset;
+  for (uint32_t i = 0; i < body_count; i++) {
+    Body *body = states.bodies_[i];
+    CopyName(body->entity_->GetName() + "/" + body->GetName(),
+             names + i * STATE_EXPORT_NAME_SIZE);
+  }
+
+  StateExportScanInfo *infos =
+      reinterpret_cast<StateExportScanInfo *>(base + header->scan_infos_offset);
+  uint32_t scan_count = 0;
+  for (const Scan &scan : scans_) {
+    if (scan.used) {
+      StateExportScanInfo &info = infos[scan_count++];
+      CopyName(scan.name, info.name);
+      info.offset = scan.offset;
+      info.count = scan.count;
+    }
+  }
+  directory->scan_count = scan_count;
+  SeqlockWriteEnd(&directory->seq);
+
+  body_generation_ = states.generation_;
+  names_valid_ = true;
+  scans_dirty_ = false;
+}
+};  // namespace flatland_server
@@ -0,0 +1,206 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_reader.cpp
+ * @brief	 Reader of the world state exported to shared memory
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <flatland_server/state_export.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace flatland_server {
+
+StateReader::~StateReader() { Close(); }
+
+bool StateReader::Open(const std::string &name) {
+  Close();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(StateExportHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  // the magic is written last, once the rest of the header is valid
+  const StateExportHeader *header = static_cast<StateExportHeader *>(data);
+  bool valid = std::memcmp(header->magic, STATE_EXPORT_MAGIC,
+                           sizeof(STATE_EXPORT_MAGIC)) == 0;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!valid || header->version != STATE_EXPORT_VERSION ||
+      header->size != uint64_t(st.st_size) || header->slot_count == 0 ||
+      !header->written.is_lock_free()) {
+    munmap(data, st.st_size);
+    return false;
+  }
+
+  data_ = data;
+  size_ = st.st_size;
+  return true;
+}
+
+void StateReader::Close() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool StateReader::Read(Frame *frame, unsigned int max_retries) const {
+  const StateExportHeader *header = GetHeader();
+  if (!header) {
+    return false;
+  }
+  const char *base = static_cast<const char *>(data_);
+
+  for (unsigned int attempt = 0; attempt <= max_retries; attempt++) {
+    if (attempt > 0) {
+      std::this_thread::yield();
+    }
+
+    uint64_t written = header->written.load(std::memory_order_acquire);
+    if (written == 0) {
+      return false;
+    }
+
+    const char *slot_data = base + header->slots_offset +
+                            ((written - 1) % header->slot_count) *
+                                header->slot_size;
+    const StateExportSlot *slot =
+        reinterpret_cast<const StateExportSlot *>(slot_data);
+    uint64_t seq = SeqlockReadBegin(&slot->seq);
+    if (seq & 1) {
+      continue;
+    }
+
+    uint64_t generation = slot->generation;
+    uint32_t body_count = std::min(slot->body_count, header->max_bodies);
+    uint32_t scan_count = std::min(slot->scan_count, header->max_scans);
+    uint32_t range_count = std::min(slot->range_count, header->max_ranges);
+    frame->step = slot->step;
+    frame->time = slot->time;
+    frame->bodies.resize(body_count);
+    std::memcpy(frame->bodies.data(), slot_data + header->bodies_offset,
+                body_count * sizeof(StateExportBody));
+    frame->stamps.resize(scan_count);
+    std::memcpy(frame->stamps.data(), slot_data + header->stamps_offset,
+                scan_count * sizeof(double));
+    frame->ranges.resize(range_count);
+    std::memcpy(frame->ranges.data(), slot_data + header->ranges_offset,
+                range_count * sizeof(float));
+    if (!SeqlockReadValid(&slot->seq, seq)) {
+      continue;
+    }
+
+    // the slots of other generations have other bodies and scans
+    if (frame->generation != generation &&
+        !ReadDirectory(generation, frame)) {
+      frame->generation = UINT64_MAX;
+      continue;
+    }
+    if (frame->names.size() != body_count ||
+        frame->scans.size() != scan_count) {
+      frame->generation = UINT64_MAX;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool StateReader::ReadDirectory(uint64_t generation, Frame *frame) const {
+  const StateExportHeader *header = GetHeader();
+  const char *base = static_cast<const char *>(data_);
+  const StateExportDirectory *directory =
+      reinterpret_cast<const StateExportDirectory *>(base +
+                                                     header->directory_offset);
+
+  uint64_t seq = SeqlockReadBegin(&directory->seq);
+  if ((seq & 1) || directory->generation != generation) {
+    return false;
+  }
+
+  uint32_t body_count = std::min(directory->body_count, header->max_bodies);
+  uint32_t scan_count = std::min(directory->scan_count, header->max_scans);
+  const char *names = base + header->names_offset;
+  frame->names.resize(body_count);
+  for (uint32_t i = 0; i < body_count; i++) {
+    const char *name = names + i * STATE_EXPORT_NAME_SIZE;
+    frame->names[i].assign(name, strnlen(name, STATE_EXPORT_NAME_SIZE));
+  }
+
+  const StateExportScanInfo *infos =
+      reinterpret_cast<const StateExportScanInfo *>(base +
+                                                    header->scan_infos_offset);
+  frame->scans.resize(scan_count);
+  for (uint32_t i = 0; i < scan_count; i++) {
+    Scan &scan = frame->scans[i];
+    scan.name.assign(infos[i].name,
+                     strnlen(infos[i].name, STATE_EXPORT_NAME_SIZE));
+    scan.offset = std::min(infos[i].offset, header->max_ranges);
+    scan.count = std::min(infos[i].count, header->max_ranges - scan.offset);
+  }
+
+  if (!SeqlockReadValid(&directory->seq, seq)) {
+    return false;
+  }
+  frame->generation = generation;
+  return true;
+}
+};  // namespace flatland_server
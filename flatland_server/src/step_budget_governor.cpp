@@ -0,0 +1,131 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_budget_governor.cpp
+ * @brief	 Degrades sensor work while simulation steps overrun a budget
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/step_budget_governor.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+StepBudgetGovernor::StepBudgetGovernor(
+    double budget, const std::vector<Degradation> &priorities,
+    unsigned int overrun_steps, unsigned int recover_steps,
+    double recover_fraction)
+    : budget_(budget),
+      priorities_(priorities),
+      overrun_steps_(std::max(overrun_steps, 1u)),
+      recover_steps_(std::max(recover_steps, 1u)),
+      recover_fraction_(recover_fraction),
+      level_(0),
+      streak_(0),
+      overrunning_(false),
+      overruns_(0) {}
+
+bool StepBudgetGovernor::AddStep(double wall_time) {
+  bool overrun = wall_time > budget_;
+  if (overrun) overruns_++;
+
+  // steps between the recover threshold and the budget keep things as they
+  // are, which gives the hysteresis between degrading and restoring
+  if (!overrun && wall_time >= budget_ * recover_fraction_) {
+    streak_ = 0;
+    return false;
+  }
+
+  if (overrun != overrunning_) {
+    overrunning_ = overrun;
+    streak_ = 0;
+  }
+  streak_++;
+
+  if (overrun && streak_ >= overrun_steps_ && level_ < priorities_.size()) {
+    level_++;
+    streak_ = 0;
+    return true;
+  }
+  if (!overrun && streak_ >= recover_steps_ && level_ > 0) {
+    level_--;
+    streak_ = 0;
+    return true;
+  }
+  return false;
+}
+
+uint32_t StepBudgetGovernor::GetDegradations() const {
+  uint32_t flags = 0;
+  for (unsigned int i = 0; i < level_; i++) flags |= priorities_[i];
+  return flags;
+}
+
+std::vector<std::string> StepBudgetGovernor::GetDegradationNames() const {
+  std::vector<std::string> names;
+  for (unsigned int i = 0; i < level_; i++) {
+    names.push_back(DegradationName(priorities_[i]));
+  }
+  return names;
+}
+
+StepBudgetGovernor::Degradation StepBudgetGovernor::ParseDegradation(
+    const std::string &name) {
+  if (name == "visualization") return SKIP_VISUALIZATION;
+  if (name == "laser_rate") return REDUCE_SENSOR_RATE;
+  if (name == "laser_beams") return COARSEN_BEAMS;
+  throw Exception("Unknown step budget degradation \"" + name +
+                  "\", must be one of visualization, laser_rate, laser_beams");
+}
+
+std::string StepBudgetGovernor::DegradationName(Degradation degradation) {
+  switch (degradation) {
+    case SKIP_VISUALIZATION:
+      return "visualization";
+    case REDUCE_SENSOR_RATE:
+      return "laser_rate";
+    case COARSEN_BEAMS:
+      return "laser_beams";
+  }
+  return "unknown";
+}
+};  // namespace flatland_server
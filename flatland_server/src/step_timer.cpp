@@ -0,0 +1,213 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_timer.cpp
+ * @brief	 Timing of the stages of the simulation steps
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/step_timer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace flatland_server {
+
+const int TimingHistogram::kBucketsPerOctave;
+const int TimingHistogram::kBucketCount;
+constexpr double TimingHistogram::kMinTime;
+
+TimingHistogram::TimingHistogram() { Reset(); }
+
+void TimingHistogram::Add(double seconds) {
+  int bucket = 0;
+  if (seconds > kMinTime) {
+    bucket = int(std::ceil(std::log2(seconds / kMinTime) * kBucketsPerOctave));
+    bucket = std::min(bucket, kBucketCount - 1);
+  }
+  buckets_[bucket]++;
+
+  if (count_ == 0) {
+    min_ = max_ = seconds;
+  } else {
+    min_ = std::min(min_, seconds);
+    max_ = std::max(max_, seconds);
+  }
+  count_++;
+  sum_ += seconds;
+}
+
+void TimingHistogram::Reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = max_ = 0;
+}
+
+double TimingHistogram::GetPercentile(double p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  // the rank of the sample at the percentile, starting at 1
+  uint64_t rank = uint64_t(std::ceil(p / 100.0 * count_));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // the last bucket has no upper end
+      if (i == kBucketCount - 1) {
+        return max_;
+      }
+      double upper = kMinTime * std::exp2(double(i) / kBucketsPerOctave);
+      return std::max(min_, std::min(max_, upper));
+    }
+  }
+  return max_;
+}
+
+StepTimer::Scope::Scope(StepTimer &timer, Stage stage)
+    : timer_(timer), stage_(stage), counted_(false) {
+  if (timer_.enabled_) {
+    counted_ = timer_.counters_ && timer_.counters_->IsOwner();
+    if (counted_) timer_.counters_->Read(&start_counts_);
+    start_ = Clock::now();
+  }
+}
+
+StepTimer::Scope::~Scope() {
+  if (timer_.enabled_) {
+    std::chrono::duration<double> elapsed = Clock::now() - start_;
+    timer_.Add(stage_, elapsed.count());
+  }
+  if (counted_) {
+    PerfCounters::Sample end;
+    timer_.counters_->Read(&end);
+    timer_.pending_counts_[stage_] += end - start_counts_;
+    timer_.counted_[stage_] = true;
+  }
+}
+
+StepTimer::StepTimer() : enabled_(false), counters_(nullptr) {
+  pending_.fill(0);
+  timed_.fill(false);
+  last_.fill(0);
+  pending_counts_.fill(PerfCounters::Sample());
+  counted_.fill(false);
+  Reset();
+}
+
+void StepTimer::Add(Stage stage, double seconds) {
+  pending_[stage] += seconds;
+  timed_[stage] = true;
+}
+
+void StepTimer::AddProfile(const b2Profile &profile) {
+  // b2Profile is in milliseconds, its step is timed by PHYSICS_STEP
+  Add(COLLIDE, profile.collide / 1000.0);
+  Add(SOLVE, profile.solve / 1000.0);
+  Add(SOLVE_INIT, profile.solveInit / 1000.0);
+  Add(SOLVE_VELOCITY, profile.solveVelocity / 1000.0);
+  Add(SOLVE_POSITION, profile.solvePosition / 1000.0);
+  Add(BROADPHASE, profile.broadphase / 1000.0);
+  Add(SOLVE_TOI, profile.solveTOI / 1000.0);
+}
+
+void StepTimer::EndStep() {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    last_[i] = timed_[i] ? pending_[i] : 0;
+    if (timed_[i]) {
+      histograms_[i].Add(pending_[i]);
+      pending_[i] = 0;
+      timed_[i] = false;
+    }
+    if (counted_[i]) {
+      counts_[i] += pending_counts_[i];
+      counted_steps_[i]++;
+      pending_counts_[i] = PerfCounters::Sample();
+      counted_[i] = false;
+    }
+  }
+}
+
+void StepTimer::Reset() {
+  for (auto &histogram : histograms_) {
+    histogram.Reset();
+  }
+  counts_.fill(PerfCounters::Sample());
+  counted_steps_.fill(0);
+}
+
+const char *StepTimer::GetStageName(Stage stage) {
+  switch (stage) {
+    case BEFORE_PHYSICS_STEP:
+      return "before_physics_step";
+    case PHYSICS_STEP:
+      return "physics_step";
+    case COLLIDE:
+      return "physics_step/collide";
+    case SOLVE:
+      return "physics_step/solve";
+    case SOLVE_INIT:
+      return "physics_step/solve_init";
+    case SOLVE_VELOCITY:
+      return "physics_step/solve_velocity";
+    case SOLVE_POSITION:
+      return "physics_step/solve_position";
+    case BROADPHASE:
+      return "physics_step/broadphase";
+    case SOLVE_TOI:
+      return "physics_step/solve_toi";
+    case AFTER_PHYSICS_STEP:
+      return "after_physics_step";
+    case INTERACTIVE_MARKERS:
+      return "interactive_markers";
+    case VISUALIZATION:
+      return "visualization";
+    case COMMANDS:
+      return "commands";
+    case SPIN:
+      return "spin";
+    default:
+      return "unknown";
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,113 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 task_pool.cpp
+ * @brief	 Implements a pool of threads running independent tasks
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/task_pool.h>
+
+namespace flatland_server {
+
+TaskPool::TaskPool(unsigned int num_threads) {
+  for (unsigned int i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&TaskPool::ThreadLoop, this);
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void TaskPool::Run(unsigned int count,
+                    const std::function<void(unsigned int)> &func) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  func_ = &func;
+  count_ = count;
+  next_ = 0;
+  generation_++;
+  start_cv_.notify_all();
+
+  Work(lock);
+  done_cv_.wait(lock, [this] { return next_ == count_ && running_ == 0; });
+  func_ = nullptr;
+}
+
+void TaskPool::Work(std::unique_lock<std::mutex> &lock) {
+  while (func_ && next_ < count_) {
+    unsigned int index = next_++;
+    running_++;
+    const std::function<void(unsigned int)> &func = *func_;
+
+    lock.unlock();
+    func(index);
+    lock.lock();
+
+    if (--running_ == 0 && next_ == count_) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void TaskPool::ThreadLoop() {
+  // threads are started before any run, so a run started before the thread
+  // first takes the lock is still seen as new
+  unsigned int generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    start_cv_.wait(lock,
+                   [&] { return stop_ || generation != generation_; });
+    if (stop_) {
+      return;
+    }
+    generation = generation_;
+    Work(lock);
+  }
+}
+};  // namespace flatland_server
@@ -0,0 +1,137 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tf_aggregator.cpp
+ * @brief	 Collects the transforms of the plugins into one message
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "flatland_server/tf_aggregator.h"
+#include <flatland_server/counted_publish.h>
+#include <ros/ros.h>
+#include <string>
+#include <vector>
+
+namespace flatland_server {
+
+bool TfAggregator::enabled_ = false;
+double TfAggregator::rate_ = 0;
+
+TfAggregator::TfAggregator() {
+  // same topics and queue sizes as tf2_ros' broadcasters
+  tf_publisher_ = node_.advertise<tf2_msgs::TFMessage>("/tf", 100);
+  static_publisher_ =
+      node_.advertise<tf2_msgs::TFMessage>("/tf_static", 100, true);
+}
+
+TfAggregator& TfAggregator::Get() {
+  static TfAggregator instance;
+  return instance;
+}
+
+void TfAggregator::SetEnabled(bool enabled) { enabled_ = enabled; }
+
+bool TfAggregator::IsEnabled() { return enabled_; }
+
+void TfAggregator::SetRate(double rate) { rate_ = rate; }
+
+void TfAggregator::Send(const geometry_msgs::TransformStamped& transform) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = slots_.find(transform.child_frame_id);
+  if (it == slots_.end()) {
+    // a slot per child frame, so that the steady state does not allocate
+    slots_[transform.child_frame_id] = latest_.size();
+    latest_.push_back(transform);
+    dirty_.push_back(true);
+    return;
+  }
+  latest_[it->second] = transform;
+  dirty_[it->second] = true;
+}
+
+void TfAggregator::Send(
+    const std::vector<geometry_msgs::TransformStamped>& transforms) {
+  for (const auto& transform : transforms) {
+    Send(transform);
+  }
+}
+
+void TfAggregator::SendStatic(
+    const geometry_msgs::TransformStamped& transform) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  static_[transform.child_frame_id] = transform;
+  static_changed_ = true;
+}
+
+void TfAggregator::Publish(const ros::Time& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (static_changed_) {
+    // /tf_static is latched, so each message carries all static transforms
+    tf2_msgs::TFMessage static_message;
+    static_message.transforms.reserve(static_.size());
+    for (const auto& entry : static_) {
+      static_message.transforms.push_back(entry.second);
+    }
+    PublishCounted(static_publisher_, static_message);
+    static_changed_ = false;
+  }
+
+  // a time going backwards is a reset of the simulation
+  if (rate_ > 0 && now >= last_flush_ &&
+      (now - last_flush_).toSec() < 1.0 / rate_) {
+    return;
+  }
+  last_flush_ = now;
+
+  message_.transforms.clear();
+  for (size_t i = 0; i < latest_.size(); i++) {
+    if (dirty_[i]) {
+      message_.transforms.push_back(latest_[i]);
+      dirty_[i] = false;
+    }
+  }
+  if (!message_.transforms.empty()) {
+    // handed to a publisher thread with the PublishQueue, it is the largest
+    // message of a fleet
+    PublishCounted(tf_publisher_, message_);
+  }
+}
+}
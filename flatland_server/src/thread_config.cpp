@@ -0,0 +1,151 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 thread_config.cpp
+ * @brief	 Real time scheduling, CPU pinning and memory locking of threads
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/thread_config.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace flatland_server {
+
+std::vector<unsigned int> ThreadConfig::ParseCpuSet(
+    const std::string &spec, const std::string &node_dir) {
+  std::vector<unsigned int> cpus;
+  std::stringstream items(spec);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    item.erase(0, item.find_first_not_of(' '));
+    item.erase(item.find_last_not_of(' ') + 1);
+    if (item.empty()) continue;
+
+    // the CPUs of a NUMA node, in the same format from sysfs
+    if (item.compare(0, 5, "node:") == 0) {
+      std::string node = item.substr(5);
+      std::ifstream file(node_dir + "/node" + node + "/cpulist");
+      std::string list;
+      if (node.empty() ||
+          node.find_first_not_of("0123456789") != std::string::npos ||
+          !std::getline(file, list)) {
+        throw Exception("Invalid CPU set \"" + spec + "\", no NUMA node \"" +
+                        node + "\"");
+      }
+      for (unsigned int cpu : ParseCpuSet(list, node_dir)) {
+        cpus.push_back(cpu);
+      }
+      continue;
+    }
+
+    size_t dash = item.find('-');
+    std::string first = item.substr(0, dash);
+    std::string last = dash == std::string::npos ? first : item.substr(dash + 1);
+    if (first.empty() || last.empty() ||
+        first.find_first_not_of("0123456789") != std::string::npos ||
+        last.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoul(first) > std::stoul(last) ||
+        std::stoul(last) >= CPU_SETSIZE) {
+      throw Exception("Invalid CPU set \"" + spec +
+                      "\", must be comma separated CPUs, ranges of CPUs "
+                      "like 4-7 or NUMA nodes like node:1");
+    }
+    for (unsigned long cpu = std::stoul(first); cpu <= std::stoul(last);
+         cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+void ThreadConfig::SetAffinity(pthread_t thread,
+                               const std::vector<unsigned int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  int error = pthread_setaffinity_np(thread, sizeof(set), &set);
+  if (error != 0) {
+    throw Exception(std::string("Failed to pin a thread to its CPUs: ") +
+                    std::strerror(error));
+  }
+}
+
+std::vector<unsigned int> ThreadConfig::GetAffinity(pthread_t thread) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<unsigned int> cpus;
+  if (pthread_getaffinity_np(thread, sizeof(set), &set) == 0) {
+    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+void ThreadConfig::SetFifoPriority(pthread_t thread, int priority) {
+  sched_param param;
+  param.sched_priority = priority;
+  int error = pthread_setschedparam(thread, SCHED_FIFO, &param);
+  if (error != 0) {
+    throw Exception("Failed to run a thread under SCHED_FIFO at priority " +
+                    std::to_string(priority) + ": " + std::strerror(error));
+  }
+}
+
+void ThreadConfig::LockMemory() {
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    throw Exception(std::string("Failed to lock the memory: ") +
+                    std::strerror(errno));
+  }
+}
+};  // namespace flatland_server
@@ -49,21 +49,57 @@
 
 namespace flatland_server {
 
-Timekeeper::Timekeeper()
-    : time_(ros::Time(0, 0)), max_step_size_(0), clock_topic_("/clock") {
-  clock_pub_ = nh_.advertise<rosgraph_msgs::Clock>(clock_topic_, 1);
+Timekeeper::Timekeeper(const std::string& clock_topic)
+    : time_(ros::Time(0, 0)),
+      max_step_size_(0),
+      clock_topic_(clock_topic),
+      clock_period_(0),
+      clock_published_(false) {
+  if (!clock_topic_.empty()) {
+    clock_pub_ = nh_.advertise<rosgraph_msgs::Clock>(clock_topic_, 1);
+  }
 }
 
 void Timekeeper::StepTime() {
   time_ += ros::Duration(max_step_size_);
 
-  UpdateRosClock();
+  // the tolerance of half a step keeps the clock on the steps nearest to
+  // the period, the time goes back on a reset
+  if (!clock_published_ || time_ < clock_time_ ||
+      (time_ - clock_time_).toSec() >= clock_period_ - max_step_size_ / 2) {
+    UpdateRosClock();
+  }
 }
 
 void Timekeeper::UpdateRosClock() const {
-  rosgraph_msgs::Clock clock;
-  clock.clock = time_;
-  clock_pub_.publish(clock);
+  if (clock_sink_) {
+    clock_sink_(time_);
+  } else if (clock_pub_) {
+    rosgraph_msgs::Clock clock;
+    clock.clock = time_;
+    clock_pub_.publish(clock);
+  } else {
+    return;
+  }
+  clock_time_ = time_;
+  clock_published_ = true;
+}
+
+void Timekeeper::EnsureClockPublished() const {
+  if (!clock_published_ || clock_time_ != time_) {
+    UpdateRosClock();
+  }
+}
+
+void Timekeeper::SetClockSink(ClockSink sink) { clock_sink_ = sink; }
+
+void Timekeeper::SetClockRate(double rate) {
+  clock_period_ = rate > 0 ? 1.0 / rate : 0;
+}
+
+void Timekeeper::SetSimTime(const ros::Time& time) {
+  time_ = time;
+  UpdateRosClock();
 }
 
 void Timekeeper::SetMaxStepSize(double step_size) {
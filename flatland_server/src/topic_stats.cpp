@@ -0,0 +1,140 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 topic_stats.cpp
+ * @brief	Counts the messages published on each topic
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/topic_stats.h>
+#include <algorithm>
+
+namespace flatland_server {
+
+bool TopicStats::enabled_ = false;
+
+TopicStats::TopicStats() : start_(std::chrono::steady_clock::now()) {}
+
+TopicStats &TopicStats::Get() {
+  static TopicStats instance;
+  return instance;
+}
+
+void TopicStats::SetEnabled(bool enabled) { enabled_ = enabled; }
+
+bool TopicStats::IsEnabled() { return enabled_; }
+
+bool TopicStats::ParseSortKey(const std::string &name, SortKey *key) {
+  if (name.empty() || name == "bytes_sent") {
+    *key = BYTES_SENT;
+  } else if (name == "bytes") {
+    *key = BYTES;
+  } else if (name == "messages") {
+    *key = MESSAGES;
+  } else if (name == "publish_time") {
+    *key = PUBLISH_TIME;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void TopicStats::Record(const std::string &topic, uint64_t bytes,
+                        uint32_t subscribers, double seconds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry &entry = entries_[topic];
+  entry.messages++;
+  entry.bytes += bytes;
+  entry.bytes_sent += bytes * subscribers;
+  entry.publish_time += seconds;
+  entry.max_publish_time = std::max(entry.max_publish_time, seconds);
+}
+
+std::vector<TopicStats::Entry> TopicStats::GetTopTalkers(size_t count,
+                                                         SortKey key) const {
+  std::vector<Entry> entries;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries.reserve(entries_.size());
+    for (const auto &entry : entries_) {
+      entries.push_back(entry.second);
+      entries.back().topic = entry.first;
+    }
+  }
+
+  auto total = [key](const Entry &entry) -> double {
+    switch (key) {
+      case BYTES:
+        return entry.bytes;
+      case MESSAGES:
+        return entry.messages;
+      case PUBLISH_TIME:
+        return entry.publish_time;
+      default:
+        return entry.bytes_sent;
+    }
+  };
+  // ties by topic, so the order does not depend on the hash map
+  std::sort(entries.begin(), entries.end(),
+            [&total](const Entry &a, const Entry &b) {
+              double total_a = total(a), total_b = total(b);
+              if (total_a != total_b) return total_a > total_b;
+              return a.topic < b.topic;
+            });
+  if (count > 0 && entries.size() > count) {
+    entries.resize(count);
+  }
+  return entries;
+}
+
+double TopicStats::GetPeriod() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start_)
+      .count();
+}
+
+void TopicStats::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  start_ = std::chrono::steady_clock::now();
+}
+};  // namespace flatland_server
@@ -0,0 +1,242 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tracer.cpp
+ * @brief	 Timeline tracing of the simulation loop
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/tracer.h>
+#include <flatland_server/yaml_reader.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace flatland_server {
+
+namespace {
+/// time the timestamps of the trace start from
+const std::chrono::steady_clock::time_point kEpoch =
+    std::chrono::steady_clock::now();
+
+/**
+ * @brief Write a string as a JSON string literal
+ * @param[in] out The stream to write to
+ * @param[in] str The string
+ */
+void WriteJsonString(std::ostream &out, const char *str) {
+  out << '"';
+  for (const char *c = str; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\' << *c;
+    } else if ((unsigned char)*c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+      out << escaped;
+    } else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+/**
+ * @brief Write a time in ns as the microseconds of the trace format
+ */
+void WriteMicroseconds(std::ostream &out, uint64_t ns) {
+  char us[32];
+  snprintf(us, sizeof(us), "%llu.%03u", (unsigned long long)(ns / 1000),
+           (unsigned int)(ns % 1000));
+  out << us;
+}
+}
+
+thread_local Tracer::ThreadBuffer *Tracer::thread_buffer_ = nullptr;
+thread_local std::string Tracer::thread_name_;
+thread_local const char *TraceScope::current_ = nullptr;
+
+Tracer &Tracer::Get() {
+  static Tracer instance;
+  return instance;
+}
+
+Tracer::Tracer() : enabled_(false), buffer_size_(1 << 16) {}
+
+void Tracer::Start(size_t buffer_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (enabled_) {
+    return;
+  }
+  buffer_size_ = std::max<size_t>(buffer_size, 1);
+  for (auto &buffer : buffers_) {
+    buffer->events.resize(buffer_size_);
+    buffer->count = 0;
+  }
+  enabled_ = true;
+}
+
+void Tracer::Stop() { enabled_ = false; }
+
+uint64_t Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - kEpoch)
+      .count();
+}
+
+Tracer::ThreadBuffer *Tracer::GetThreadBuffer() {
+  // the buffers are never deleted, so the pointer stays valid for the thread
+  if (thread_buffer_ == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(new ThreadBuffer());
+    thread_buffer_ = buffers_.back().get();
+    thread_buffer_->events.resize(buffer_size_);
+    thread_buffer_->tid = buffers_.size();
+    thread_buffer_->name =
+        thread_name_.empty() ? "thread_" + std::to_string(thread_buffer_->tid)
+                             : thread_name_;
+  }
+  return thread_buffer_;
+}
+
+void Tracer::SetThreadName(const std::string &name) {
+  thread_name_ = name;
+  if (thread_buffer_ != nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_buffer_->name = name;
+  }
+}
+
+void Tracer::Record(const char *category, const char *name, uint64_t start,
+                    uint64_t end) {
+  if (!IsEnabled()) {
+    return;
+  }
+  ThreadBuffer *buffer = GetThreadBuffer();
+  uint64_t count = buffer->count.load(std::memory_order_relaxed);
+  Event &event = buffer->events[count % buffer->events.size()];
+  strncpy(event.name, name, Event::kNameSize - 1);
+  event.name[Event::kNameSize - 1] = '\0';
+  event.category = category;
+  event.start = start;
+  event.duration = end - start;
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+size_t Tracer::WriteChromeTrace(std::ostream &out) {
+  return WriteChromeTrace(out, 0, UINT64_MAX, {});
+}
+
+size_t Tracer::WriteChromeTrace(std::ostream &out, uint64_t begin,
+                                uint64_t end,
+                                const std::vector<std::string> &extra_events) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t written = 0;
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (const std::string &event : extra_events) {
+    if (!first) out << ",";
+    first = false;
+    out << "\n" << event;
+  }
+  for (const auto &buffer : buffers_) {
+    if (!first) out << ",";
+    first = false;
+    out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << buffer->tid << ",\"args\":{\"name\":";
+    WriteJsonString(out, buffer->name.c_str());
+    out << "}}";
+
+    uint64_t count = buffer->count.load(std::memory_order_acquire);
+    uint64_t size = buffer->events.size();
+    for (uint64_t i = count > size ? count - size : 0; i < count; i++) {
+      const Event &event = buffer->events[i % size];
+      if (event.start > end || event.start + event.duration < begin) {
+        continue;
+      }
+      out << ",\n{\"name\":";
+      WriteJsonString(out, event.name);
+      out << ",\"cat\":";
+      WriteJsonString(out, event.category);
+      out << ",\"ph\":\"X\",\"ts\":";
+      WriteMicroseconds(out, event.start);
+      out << ",\"dur\":";
+      WriteMicroseconds(out, event.duration);
+      out << ",\"pid\":1,\"tid\":" << buffer->tid << "}";
+      written++;
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return written;
+}
+
+std::map<std::string, uint64_t> Tracer::SumDurations(
+    const std::string &category) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::string, uint64_t> durations;
+  for (const auto &buffer : buffers_) {
+    uint64_t count = buffer->count.load(std::memory_order_acquire);
+    uint64_t size = buffer->events.size();
+    for (uint64_t i = count > size ? count - size : 0; i < count; i++) {
+      const Event &event = buffer->events[i % size];
+      if (category == event.category) {
+        durations[event.name] += event.duration;
+      }
+    }
+  }
+  return durations;
+}
+
+size_t Tracer::DumpChromeTrace(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    throw Exception("Flatland File: Failed to open " + Q(path));
+  }
+  size_t written = WriteChromeTrace(out);
+  out.close();
+  if (!out) {
+    throw Exception("Flatland File: Failed to write " + Q(path));
+  }
+  return written;
+}
+};  // namespace flatland_server
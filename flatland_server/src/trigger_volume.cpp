@@ -0,0 +1,135 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trigger_volume.cpp
+ * @brief	 Finds the fixtures overlapping shapes without Box2D contacts
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/trigger_volume.h>
+#include <algorithm>
+#include <iterator>
+
+namespace flatland_server {
+
+TriggerVolume::TriggerVolume(b2Body *body) : body_(body) {}
+
+void TriggerVolume::AddShape(const b2Shape *shape, const b2Filter &filter) {
+  shapes_.push_back(Shape{shape, filter});
+}
+
+int TriggerVolume::AddSensorFixtures() {
+  // categoryBits and maskBits of 0 make b2ContactManager skip the pairs of
+  // the fixture, its proxy stays in the broad phase for the queries
+  b2Filter none;
+  none.categoryBits = 0;
+  none.maskBits = 0;
+  none.groupIndex = 0;
+
+  int count = 0;
+  for (b2Fixture *f = body_->GetFixtureList(); f != nullptr;
+       f = f->GetNext()) {
+    if (!f->IsSensor()) {
+      continue;
+    }
+    AddShape(f->GetShape(), f->GetFilterData());
+    f->SetFilterData(none);
+    count++;
+  }
+  return count;
+}
+
+bool TriggerVolume::Update() {
+  query_xf_ = body_->GetTransform();
+  b2World *world = body_->GetWorld();
+  current_.clear();
+  for (const Shape &shape : shapes_) {
+    query_shape_ = &shape;
+    for (int32 i = 0; i < shape.shape->GetChildCount(); i++) {
+      query_child_ = i;
+      b2AABB aabb;
+      shape.shape->ComputeAABB(&aabb, query_xf_, i);
+      world->QueryAABB(this, aabb);
+    }
+  }
+
+  // a fixture overlapping several shapes or children is found several times
+  std::sort(current_.begin(), current_.end());
+  current_.erase(std::unique(current_.begin(), current_.end()),
+                 current_.end());
+
+  entered_.clear();
+  left_.clear();
+  std::set_difference(current_.begin(), current_.end(), occupants_.begin(),
+                      occupants_.end(), std::back_inserter(entered_));
+  std::set_difference(occupants_.begin(), occupants_.end(), current_.begin(),
+                      current_.end(), std::back_inserter(left_));
+  occupants_.swap(current_);
+  return !entered_.empty() || !left_.empty();
+}
+
+bool TriggerVolume::ReportFixture(b2Fixture *fixture) {
+  if (fixture->GetBody() == body_ ||
+      !ShouldCollide(query_shape_->filter, fixture->GetFilterData())) {
+    return true;
+  }
+
+  const b2Shape *shape = fixture->GetShape();
+  const b2Transform &xf = fixture->GetBody()->GetTransform();
+  for (int32 i = 0; i < shape->GetChildCount(); i++) {
+    if (b2TestOverlap(query_shape_->shape, query_child_, shape, i, query_xf_,
+                      xf)) {
+      current_.push_back(fixture);
+      break;
+    }
+  }
+  return true;
+}
+
+bool TriggerVolume::ShouldCollide(const b2Filter &a, const b2Filter &b) {
+  if (a.groupIndex == b.groupIndex && a.groupIndex != 0) {
+    return a.groupIndex > 0;
+  }
+  return (a.maskBits & b.categoryBits) != 0 &&
+         (a.categoryBits & b.maskBits) != 0;
+}
+
+};  // namespace flatland_server
@@ -0,0 +1,1119 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 vector_map.cpp
+ * @brief	 Read the walls of a layer from vector drawings
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/vector_map.h>
+#include <flatland_server/yaml_reader.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <utility>
+
+namespace flatland_server {
+
+namespace {
+/// max angle between two vertices of a flattened arc or circle
+const double ARC_STEP = M_PI / 16;
+/// segments of a flattened bezier curve
+const int CURVE_SEGMENTS = 8;
+
+/**
+ * 2D affine transform as in SVG, x' = a x + c y + e and y' = b x + d y + f
+ */
+struct Affine {
+  double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+
+  Vec2 Apply(double x, double y) const {
+    return Vec2(a * x + c * y + e, b * x + d * y + f);
+  }
+
+  /// the transform applying o first, then this
+  Affine operator*(const Affine &o) const {
+    Affine r;
+    r.a = a * o.a + c * o.b;
+    r.b = b * o.a + d * o.b;
+    r.c = a * o.c + c * o.d;
+    r.d = b * o.c + d * o.d;
+    r.e = a * o.e + c * o.f + e;
+    r.f = b * o.e + d * o.f + f;
+    return r;
+  }
+};
+
+/**
+ * @brief Append the vertices of an elliptical arc after its start, which is
+ * already the last vertex
+ * @param[in] t Transform of the vertices
+ * @param[in] cx, cy Center of the ellipse
+ * @param[in] rx, ry Radii of the ellipse
+ * @param[in] phi Rotation of the ellipse
+ * @param[in] theta Angle of the start of the arc on the ellipse
+ * @param[in] dtheta Signed sweep of the arc
+ * @param[out] points The vertices
+ */
+void AppendArc(const Affine &t, double cx, double cy, double rx, double ry,
+               double phi, double theta, double dtheta,
+               std::vector<Vec2> *points) {
+  int n = std::max(1, int(std::ceil(std::fabs(dtheta) / ARC_STEP)));
+  double cp = std::cos(phi), sp = std::sin(phi);
+  for (int i = 1; i <= n; i++) {
+    double angle = theta + dtheta * i / n;
+    double x = rx * std::cos(angle), y = ry * std::sin(angle);
+    points->push_back(t.Apply(cx + cp * x - sp * y, cy + sp * x + cp * y));
+  }
+}
+
+/**
+ * @brief Make the polyline of a circle or an ellipse
+ */
+VectorMap::Polyline Ellipse(const Affine &t, double cx, double cy, double rx,
+                            double ry) {
+  VectorMap::Polyline polyline;
+  polyline.closed = true;
+  polyline.points.push_back(t.Apply(cx + rx, cy));
+  AppendArc(t, cx, cy, rx, ry, 0, 0, 2 * M_PI, &polyline.points);
+  polyline.points.pop_back();  // the start again
+  return polyline;
+}
+
+/**
+ * Reads the numbers of SVG attributes, separated by whitespace or commas
+ */
+class NumberScanner {
+ public:
+  explicit NumberScanner(const std::string &text)
+      : text_(text), pos_(text_.c_str()) {}
+
+  /// skip the separators, return true if there is more text
+  bool More() {
+    while (*pos_ != 0 && (std::isspace(*pos_) || *pos_ == ',')) {
+      pos_++;
+    }
+    return *pos_ != 0;
+  }
+
+  /// the next character, after the separators
+  char Peek() { return More() ? *pos_ : 0; }
+
+  void Skip() { pos_++; }
+
+  bool IsNumber() {
+    char c = Peek();
+    return std::isdigit(c) || c == '-' || c == '+' || c == '.';
+  }
+
+  double Number() {
+    More();
+    char *end = nullptr;
+    double value = std::strtod(pos_, &end);
+    if (end == pos_) {
+      throw Exception("Flatland File: Expected a number in " + Q(text_));
+    }
+    pos_ = end;
+    return value;
+  }
+
+  /// the flags of arcs may be written without separators, e.g. 11
+  bool Flag() {
+    char c = Peek();
+    if (c != '0' && c != '1') {
+      throw Exception("Flatland File: Expected an arc flag in " + Q(text_));
+    }
+    pos_++;
+    return c == '1';
+  }
+
+ private:
+  std::string text_;  ///< the scanned text
+  const char *pos_;   ///< position in text_
+};
+
+/**
+ * @brief Parse the transform attribute of an SVG element
+ */
+Affine ParseTransform(const std::string &text) {
+  Affine result;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t open = text.find('(', pos);
+    size_t close = text.find(')', pos);
+    if (open == std::string::npos || close == std::string::npos ||
+        close < open) {
+      break;
+    }
+    std::string name = boost::trim_copy_if(
+        text.substr(pos, open - pos), boost::is_any_of(" \t\r\n,"));
+    NumberScanner args(text.substr(open + 1, close - open - 1));
+    std::vector<double> v;
+    while (args.More()) {
+      v.push_back(args.Number());
+    }
+    pos = close + 1;
+
+    Affine m;
+    if (name == "matrix" && v.size() == 6) {
+      m.a = v[0], m.b = v[1], m.c = v[2], m.d = v[3], m.e = v[4], m.f = v[5];
+    } else if (name == "translate" && (v.size() == 1 || v.size() == 2)) {
+      m.e = v[0];
+      m.f = v.size() == 2 ? v[1] : 0;
+    } else if (name == "scale" && (v.size() == 1 || v.size() == 2)) {
+      m.a = v[0];
+      m.d = v.size() == 2 ? v[1] : v[0];
+    } else if (name == "rotate" && (v.size() == 1 || v.size() == 3)) {
+      double angle = v[0] * M_PI / 180;
+      Affine r;
+      r.a = std::cos(angle), r.b = std::sin(angle);
+      r.c = -r.b, r.d = r.a;
+      if (v.size() == 3) {
+        Affine to, from;
+        to.e = v[1], to.f = v[2];
+        from.e = -v[1], from.f = -v[2];
+        r = to * r * from;
+      }
+      m = r;
+    } else if (name == "skewX" && v.size() == 1) {
+      m.c = std::tan(v[0] * M_PI / 180);
+    } else if (name == "skewY" && v.size() == 1) {
+      m.b = std::tan(v[0] * M_PI / 180);
+    } else {
+      throw Exception("Flatland File: Invalid SVG transform " + Q(text));
+    }
+    result = result * m;
+  }
+  return result;
+}
+
+/**
+ * @brief Parse the path data of an SVG path element
+ * @param[in] data The d attribute
+ * @param[in] t Transform of the element
+ * @param[out] polylines The polylines of the path, one per subpath
+ */
+void ParsePath(const std::string &data, const Affine &t,
+               std::vector<VectorMap::Polyline> *polylines) {
+  NumberScanner s(data);
+  VectorMap::Polyline current;
+  double x = 0, y = 0;              // current point
+  double start_x = 0, start_y = 0;  // start of the subpath
+  double ctrl_x = 0, ctrl_y = 0;    // last control point, for S and T
+  char command = 0, previous = 0;
+
+  auto flush = [&]() {
+    if (current.points.size() >= 2) {
+      polylines->push_back(current);
+    }
+    current = VectorMap::Polyline();
+  };
+  auto line_to = [&](double nx, double ny) {
+    if (current.points.empty()) {
+      current.points.push_back(t.Apply(x, y));
+    }
+    x = nx, y = ny;
+    current.points.push_back(t.Apply(x, y));
+  };
+  auto curve_to = [&](double x1, double y1, double x2, double y2, double nx,
+                      double ny, bool cubic) {
+    if (current.points.empty()) {
+      current.points.push_back(t.Apply(x, y));
+    }
+    for (int i = 1; i <= CURVE_SEGMENTS; i++) {
+      double u = double(i) / CURVE_SEGMENTS, v = 1 - u;
+      double px, py;
+      if (cubic) {
+        px = v * v * v * x + 3 * v * v * u * x1 + 3 * v * u * u * x2 +
+             u * u * u * nx;
+        py = v * v * v * y + 3 * v * v * u * y1 + 3 * v * u * u * y2 +
+             u * u * u * ny;
+      } else {
+        px = v * v * x + 2 * v * u * x1 + u * u * nx;
+        py = v * v * y + 2 * v * u * y1 + u * u * ny;
+      }
+      current.points.push_back(t.Apply(px, py));
+    }
+    x = nx, y = ny;
+  };
+
+  while (s.More()) {
+    if (std::isalpha(s.Peek())) {
+      command = s.Peek();
+      s.Skip();
+    } else if (command == 0) {
+      throw Exception("Flatland File: Invalid SVG path data " + Q(data));
+    } else if (command == 'M') {
+      // coordinates following a move are lines
+      command = 'L';
+    } else if (command == 'm') {
+      command = 'l';
+    }
+    bool relative = std::islower(command);
+    double ox = relative ? x : 0, oy = relative ? y : 0;
+
+    switch (std::toupper(command)) {
+      case 'M': {
+        double nx = ox + s.Number(), ny = oy + s.Number();
+        flush();
+        x = start_x = nx, y = start_y = ny;
+        break;
+      }
+      case 'L': {
+        double nx = ox + s.Number(), ny = oy + s.Number();
+        line_to(nx, ny);
+        break;
+      }
+      case 'H':
+        line_to(ox + s.Number(), y);
+        break;
+      case 'V':
+        line_to(x, oy + s.Number());
+        break;
+      case 'Z':
+        if (!current.points.empty()) {
+          current.closed = true;
+        }
+        flush();
+        x = start_x, y = start_y;
+        break;
+      case 'C':
+      case 'S': {
+        double x1, y1;
+        if (std::toupper(command) == 'C') {
+          x1 = ox + s.Number(), y1 = oy + s.Number();
+        } else if (previous == 'C' || previous == 'S') {
+          x1 = 2 * x - ctrl_x, y1 = 2 * y - ctrl_y;
+        } else {
+          x1 = x, y1 = y;
+        }
+        double x2 = ox + s.Number(), y2 = oy + s.Number();
+        double nx = ox + s.Number(), ny = oy + s.Number();
+        curve_to(x1, y1, x2, y2, nx, ny, true);
+        ctrl_x = x2, ctrl_y = y2;
+        break;
+      }
+      case 'Q':
+      case 'T': {
+        double x1, y1;
+        if (std::toupper(command) == 'Q') {
+          x1 = ox + s.Number(), y1 = oy + s.Number();
+        } else if (previous == 'Q' || previous == 'T') {
+          x1 = 2 * x - ctrl_x, y1 = 2 * y - ctrl_y;
+        } else {
+          x1 = x, y1 = y;
+        }
+        double nx = ox + s.Number(), ny = oy + s.Number();
+        curve_to(x1, y1, 0, 0, nx, ny, false);
+        ctrl_x = x1, ctrl_y = y1;
+        break;
+      }
+      case 'A': {
+        double rx = std::fabs(s.Number()), ry = std::fabs(s.Number());
+        double phi = s.Number() * M_PI / 180;
+        bool large_arc = s.Flag(), sweep = s.Flag();
+        double nx = ox + s.Number(), ny = oy + s.Number();
+        if (rx == 0 || ry == 0 || (nx == x && ny == y)) {
+          line_to(nx, ny);
+          break;
+        }
+        // conversion from the endpoints to the center of the ellipse, see
+        // the implementation notes of the SVG specification
+        double cp = std::cos(phi), sp = std::sin(phi);
+        double dx = (x - nx) / 2, dy = (y - ny) / 2;
+        double x1p = cp * dx + sp * dy, y1p = -sp * dx + cp * dy;
+        double lambda = x1p * x1p / (rx * rx) + y1p * y1p / (ry * ry);
+        if (lambda > 1) {
+          rx *= std::sqrt(lambda);
+          ry *= std::sqrt(lambda);
+        }
+        double num = rx * rx * ry * ry - rx * rx * y1p * y1p -
+                     ry * ry * x1p * x1p;
+        double den = rx * rx * y1p * y1p + ry * ry * x1p * x1p;
+        double coef = std::sqrt(std::max(0.0, num / den)) *
+                      (large_arc == sweep ? -1 : 1);
+        double cxp = coef * rx * y1p / ry, cyp = -coef * ry * x1p / rx;
+        double cx = cp * cxp - sp * cyp + (x + nx) / 2;
+        double cy = sp * cxp + cp * cyp + (y + ny) / 2;
+        double theta = std::atan2((y1p - cyp) / ry, (x1p - cxp) / rx);
+        double dtheta =
+            std::atan2((-y1p - cyp) / ry, (-x1p - cxp) / rx) - theta;
+        if (!sweep && dtheta > 0) {
+          dtheta -= 2 * M_PI;
+        } else if (sweep && dtheta < 0) {
+          dtheta += 2 * M_PI;
+        }
+        if (current.points.empty()) {
+          current.points.push_back(t.Apply(x, y));
+        }
+        AppendArc(t, cx, cy, rx, ry, phi, theta, dtheta, &current.points);
+        x = nx, y = ny;
+        current.points.back() = t.Apply(x, y);
+        break;
+      }
+      default:
+        throw Exception("Flatland File: Invalid SVG path command " +
+                        Q(std::string(1, command)) + " in " + Q(data));
+    }
+    previous = std::toupper(command);
+  }
+  flush();
+}
+
+/**
+ * @brief Parse the points attribute of SVG polyline and polygon elements
+ */
+std::vector<Vec2> ParsePoints(const std::string &text, const Affine &t) {
+  NumberScanner s(text);
+  std::vector<Vec2> points;
+  while (s.More()) {
+    double x = s.Number();
+    double y = s.Number();
+    points.push_back(t.Apply(x, y));
+  }
+  return points;
+}
+
+/**
+ * A tag of an XML document
+ */
+struct XmlTag {
+  std::string name;  ///< name without the namespace prefix
+  std::vector<std::pair<std::string, std::string>> attributes;
+  bool closing = false;       ///< if it is </name>
+  bool self_closing = false;  ///< if it is <name/>
+
+  /// the value of an attribute, empty if it is missing
+  std::string Get(const std::string &key) const {
+    for (const auto &attribute : attributes) {
+      if (attribute.first == key) {
+        return attribute.second;
+      }
+    }
+    return "";
+  }
+
+  /// the value of a length attribute, the unit is ignored
+  double Length(const std::string &key) const {
+    return std::strtod(Get(key).c_str(), nullptr);
+  }
+};
+
+/**
+ * @brief Read the next tag of an XML document, skipping the text, comments,
+ * CDATA sections, declarations and processing instructions
+ * @param[in] text The document
+ * @param[inout] pos Position in the document
+ * @param[out] tag The tag
+ * @return false at the end of the document
+ */
+bool NextTag(const std::string &text, size_t *pos, XmlTag *tag) {
+  while (true) {
+    size_t open = text.find('<', *pos);
+    if (open == std::string::npos) {
+      return false;
+    }
+    const char *skipped[][2] = {
+        {"<!--", "-->"}, {"<![CDATA[", "]]>"}, {"<!", ">"}, {"<?", "?>"}};
+    bool skip = false;
+    for (const auto &s : skipped) {
+      if (text.compare(open, std::strlen(s[0]), s[0]) == 0) {
+        size_t end = text.find(s[1], open);
+        if (end == std::string::npos) {
+          return false;
+        }
+        *pos = end + std::strlen(s[1]);
+        skip = true;
+        break;
+      }
+    }
+    if (skip) {
+      continue;
+    }
+
+    *tag = XmlTag();
+    size_t i = open + 1;
+    if (i < text.size() && text[i] == '/') {
+      tag->closing = true;
+      i++;
+    }
+    size_t name_start = i;
+    while (i < text.size() && !std::isspace(text[i]) && text[i] != '/' &&
+           text[i] != '>') {
+      i++;
+    }
+    tag->name = text.substr(name_start, i - name_start);
+    size_t colon = tag->name.find(':');
+    if (colon != std::string::npos) {
+      tag->name = tag->name.substr(colon + 1);
+    }
+
+    while (i < text.size() && text[i] != '>') {
+      if (std::isspace(text[i])) {
+        i++;
+      } else if (text[i] == '/') {
+        tag->self_closing = true;
+        i++;
+      } else {
+        size_t key_start = i;
+        while (i < text.size() && text[i] != '=' && !std::isspace(text[i]) &&
+               text[i] != '>' && text[i] != '/') {
+          i++;
+        }
+        std::string key = text.substr(key_start, i - key_start);
+        while (i < text.size() && std::isspace(text[i])) {
+          i++;
+        }
+        std::string value;
+        if (i < text.size() && text[i] == '=') {
+          i++;
+          while (i < text.size() && std::isspace(text[i])) {
+            i++;
+          }
+          if (i >= text.size() || (text[i] != '"' && text[i] != '\'')) {
+            throw Exception("Flatland File: Invalid XML attribute " + Q(key));
+          }
+          size_t end = text.find(text[i], i + 1);
+          if (end == std::string::npos) {
+            throw Exception("Flatland File: Invalid XML attribute " + Q(key));
+          }
+          value = text.substr(i + 1, end - i - 1);
+          i = end + 1;
+        }
+        tag->attributes.emplace_back(key, value);
+      }
+    }
+    *pos = i + 1;
+    return true;
+  }
+}
+
+/**
+ * A minimal JSON value, for GeoJSON documents
+ */
+struct Json {
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+  Type type = NUL;
+  double number = 0;
+  std::string string;
+  std::vector<Json> array;
+  std::vector<std::pair<std::string, Json>> object;
+
+  /// a member of an object, null if it is missing
+  const Json *Find(const std::string &key) const {
+    for (const auto &member : object) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+};
+
+/**
+ * Parses a JSON document
+ */
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string &text) : text_(text) {}
+
+  Json Parse() {
+    Json value = Value();
+    SkipSpace();
+    if (pos_ != text_.size()) {
+      Fail();
+    }
+    return value;
+  }
+
+ private:
+  const std::string &text_;  ///< the document
+  size_t pos_ = 0;           ///< position in text_
+
+  void Fail() const {
+    throw Exception("Flatland File: Invalid JSON at offset " +
+                    std::to_string(pos_));
+  }
+
+  void SkipSpace() {
+    while (pos_ < text_.size() && std::isspace(text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  void Expect(char c) {
+    SkipSpace();
+    if (pos_ >= text_.size() || text_[pos_] != c) {
+      Fail();
+    }
+    pos_++;
+  }
+
+  bool Accept(char c) {
+    SkipSpace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  std::string String() {
+    Expect('"');
+    std::string result;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (c == '\\' && pos_ < text_.size()) {
+        char e = text_[pos_++];
+        const char *escapes = "\"\"\\\\//b\bf\fn\nr\rt\t";
+        const char *found = std::strchr(escapes, e);
+        if (e == 'u') {
+          // the names of the walls do not matter, only the geometry
+          pos_ += 4;
+          c = '?';
+        } else if (found != nullptr && (found - escapes) % 2 == 0) {
+          c = found[1];
+        } else {
+          Fail();
+        }
+      }
+      result.push_back(c);
+    }
+    Expect('"');
+    return result;
+  }
+
+  Json Value() {
+    Json value;
+    SkipSpace();
+    if (pos_ >= text_.size()) {
+      Fail();
+    }
+    char c = text_[pos_];
+    if (c == '{') {
+      value.type = Json::OBJECT;
+      pos_++;
+      if (!Accept('}')) {
+        do {
+          std::string key = String();
+          Expect(':');
+          value.object.emplace_back(key, Value());
+        } while (Accept(','));
+        Expect('}');
+      }
+    } else if (c == '[') {
+      value.type = Json::ARRAY;
+      pos_++;
+      if (!Accept(']')) {
+        do {
+          value.array.push_back(Value());
+        } while (Accept(','));
+        Expect(']');
+      }
+    } else if (c == '"') {
+      value.type = Json::STRING;
+      value.string = String();
+    } else if (text_.compare(pos_, 4, "true") == 0 ||
+               text_.compare(pos_, 5, "false") == 0) {
+      value.type = Json::BOOL;
+      value.number = c == 't';
+      pos_ += c == 't' ? 4 : 5;
+    } else if (text_.compare(pos_, 4, "null") == 0) {
+      pos_ += 4;
+    } else {
+      const char *begin = text_.c_str() + pos_;
+      char *end = nullptr;
+      value.type = Json::NUMBER;
+      value.number = std::strtod(begin, &end);
+      if (end == begin) {
+        Fail();
+      }
+      pos_ += end - begin;
+    }
+    return value;
+  }
+};
+
+/**
+ * @brief Convert the positions of a GeoJSON geometry to a polyline
+ */
+VectorMap::Polyline GeoJsonLine(const Json &positions) {
+  if (positions.type != Json::ARRAY) {
+    throw Exception("Flatland File: Invalid GeoJSON coordinates");
+  }
+  VectorMap::Polyline polyline;
+  for (const Json &position : positions.array) {
+    if (position.type != Json::ARRAY || position.array.size() < 2 ||
+        position.array[0].type != Json::NUMBER ||
+        position.array[1].type != Json::NUMBER) {
+      throw Exception("Flatland File: Invalid GeoJSON position");
+    }
+    polyline.points.push_back(
+        Vec2(position.array[0].number, position.array[1].number));
+  }
+  return polyline;
+}
+
+/**
+ * @brief Add the polylines of the geometries of a GeoJSON value and of all
+ * the values it contains
+ */
+void AddGeoJson(const Json &value,
+                std::vector<VectorMap::Polyline> *polylines) {
+  if (value.type == Json::ARRAY) {
+    for (const Json &element : value.array) {
+      AddGeoJson(element, polylines);
+    }
+    return;
+  }
+  if (value.type != Json::OBJECT) {
+    return;
+  }
+
+  const Json *type = value.Find("type");
+  const Json *coordinates = value.Find("coordinates");
+  if (type != nullptr && coordinates != nullptr &&
+      type->type == Json::STRING) {
+    // the rings of polygons repeat their first position at the end
+    const std::string &name = type->string;
+    if (name == "LineString") {
+      polylines->push_back(GeoJsonLine(*coordinates));
+    } else if (name == "MultiLineString" || name == "Polygon") {
+      for (const Json &line : coordinates->array) {
+        polylines->push_back(GeoJsonLine(line));
+      }
+    } else if (name == "MultiPolygon") {
+      for (const Json &polygon : coordinates->array) {
+        for (const Json &ring : polygon.array) {
+          polylines->push_back(GeoJsonLine(ring));
+        }
+      }
+    }
+  }
+
+  // the features, geometries and collections nested in the value
+  for (const auto &member : value.object) {
+    if (member.first != "coordinates") {
+      AddGeoJson(member.second, polylines);
+    }
+  }
+}
+
+/**
+ * @brief Append the vertices of a DXF polyline edge after its start, which
+ * is already the last vertex
+ * @param[in] end End of the edge
+ * @param[in] bulge Tangent of a quarter of the angle of the arc of the edge,
+ * positive counterclockwise, 0 for a straight edge
+ * @param[out] points The vertices
+ */
+void AppendBulge(const Vec2 &end, double bulge, std::vector<Vec2> *points) {
+  Vec2 start = points->back();
+  double dx = end.x - start.x, dy = end.y - start.y;
+  double chord = std::sqrt(dx * dx + dy * dy);
+  if (std::fabs(bulge) < 1e-9 || chord == 0) {
+    points->push_back(end);
+    return;
+  }
+  // the center is on the left of the chord for counterclockwise arcs
+  double offset = chord / 2 * (1 - bulge * bulge) / (2 * bulge);
+  double cx = (start.x + end.x) / 2 - dy / chord * offset;
+  double cy = (start.y + end.y) / 2 + dx / chord * offset;
+  double radius = std::sqrt((start.x - cx) * (start.x - cx) +
+                            (start.y - cy) * (start.y - cy));
+  double theta = std::atan2(start.y - cy, start.x - cx);
+  AppendArc(Affine(), cx, cy, radius, radius, 0, theta, 4 * std::atan(bulge),
+            points);
+  points->back() = end;
+}
+
+/**
+ * A DXF entity, its type and its group codes
+ */
+struct DxfEntity {
+  std::string type;
+  std::vector<std::pair<int, std::string>> groups;
+
+  double Get(int code, double fallback = 0) const {
+    for (const auto &group : groups) {
+      if (group.first == code) {
+        return std::strtod(group.second.c_str(), nullptr);
+      }
+    }
+    return fallback;
+  }
+
+  /// the vertices of a LWPOLYLINE, with the bulges of their edges
+  void Vertices(std::vector<Vec2> *vertices,
+                std::vector<double> *bulges) const {
+    for (const auto &group : groups) {
+      double value = std::strtod(group.second.c_str(), nullptr);
+      if (group.first == 10) {
+        vertices->push_back(Vec2(value, 0));
+        bulges->push_back(0);
+      } else if (group.first == 20 && !vertices->empty()) {
+        vertices->back().y = value;
+      } else if (group.first == 42 && !bulges->empty()) {
+        bulges->back() = value;
+      }
+    }
+  }
+};
+
+/**
+ * @brief Make the polyline of the vertices of a DXF polyline
+ */
+VectorMap::Polyline DxfPolyline(const std::vector<Vec2> &vertices,
+                                const std::vector<double> &bulges,
+                                bool closed) {
+  VectorMap::Polyline polyline;
+  if (vertices.empty()) {
+    return polyline;
+  }
+  polyline.points.push_back(vertices[0]);
+  for (size_t i = 1; i < vertices.size(); i++) {
+    AppendBulge(vertices[i], bulges[i - 1], &polyline.points);
+  }
+  if (closed) {
+    AppendBulge(vertices[0], bulges.back(), &polyline.points);
+  }
+  return polyline;
+}
+
+/**
+ * @brief Check if the vertices between two vertices of a polyline are on
+ * the segment between them, within the tolerance and in order
+ */
+bool OnSegment(const std::vector<Vec2> &points, size_t start, size_t end,
+               double tolerance) {
+  const Vec2 &a = points[start], &b = points[end];
+  double dx = b.x - a.x, dy = b.y - a.y;
+  double length = std::sqrt(dx * dx + dy * dy);
+  if (length == 0) {
+    return false;
+  }
+  // exactly collinear vertices are merged up to rounding
+  double max_distance = std::max(tolerance, 1e-9 * length);
+  double last = 0;
+  for (size_t i = start + 1; i < end; i++) {
+    double px = points[i].x - a.x, py = points[i].y - a.y;
+    double distance = std::fabs(px * dy - py * dx) / length;
+    double along = (px * dx + py * dy) / length;
+    if (distance > max_distance || along < last || along > length) {
+      return false;
+    }
+    last = along;
+  }
+  return true;
+}
+}
+
+VectorMap::Format VectorMap::FormatOf(const std::string &path) {
+  std::string extension =
+      boost::to_lower_copy(boost::filesystem::path(path).extension().string());
+  if (extension == ".svg") {
+    return SVG;
+  } else if (extension == ".dxf") {
+    return DXF;
+  } else if (extension == ".geojson" || extension == ".json") {
+    return GEOJSON;
+  }
+  throw Exception("Flatland File: Unknown vector map format of " + Q(path) +
+                  ", expected .svg, .dxf, .geojson or .json");
+}
+
+VectorMap::Format VectorMap::ParseFormat(const std::string &name) {
+  std::string lower = boost::to_lower_copy(name);
+  if (lower == "svg") {
+    return SVG;
+  } else if (lower == "dxf") {
+    return DXF;
+  } else if (lower == "geojson") {
+    return GEOJSON;
+  }
+  throw Exception("Flatland File: Unknown vector map format " + Q(name) +
+                  ", expected svg, dxf or geojson");
+}
+
+std::vector<VectorMap::Polyline> VectorMap::Read(const std::string &path,
+                                                 Format format) {
+  std::ifstream in(path, std::ios::binary);
+  if (in.fail()) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+
+  try {
+    switch (format) {
+      case SVG:
+        return ParseSvg(text);
+      case DXF:
+        return ParseDxf(text);
+      default:
+        return ParseGeoJson(text);
+    }
+  } catch (const Exception &e) {
+    throw Exception(std::string(e.what()) + ", in file " +
+                    Q(boost::filesystem::path(path).filename().string()));
+  }
+}
+
+std::vector<VectorMap::Polyline> VectorMap::ParseSvg(const std::string &text) {
+  static const std::set<std::string> hidden_elements = {
+      "defs", "clipPath", "mask", "marker", "pattern", "symbol"};
+
+  /**
+   * An element enclosing the next elements
+   */
+  struct Group {
+    Affine transform;     ///< transform of the elements of the group
+    bool hidden = false;  ///< if the elements are not drawn
+  };
+
+  std::vector<Polyline> polylines;
+  std::vector<Group> groups(1);
+  // the y axis of SVG points down
+  groups[0].transform.d = -1;
+
+  size_t pos = 0;
+  XmlTag tag;
+  while (NextTag(text, &pos, &tag)) {
+    if (tag.closing) {
+      if (groups.size() > 1) {
+        groups.pop_back();
+      }
+      continue;
+    }
+
+    Group group;
+    group.transform =
+        groups.back().transform * ParseTransform(tag.Get("transform"));
+    group.hidden = groups.back().hidden || hidden_elements.count(tag.name) ||
+                   tag.Get("display") == "none";
+    if (!tag.self_closing) {
+      groups.push_back(group);
+    }
+    if (group.hidden) {
+      continue;
+    }
+
+    const Affine &t = group.transform;
+    Polyline polyline;
+    if (tag.name == "line") {
+      polyline.points = {t.Apply(tag.Length("x1"), tag.Length("y1")),
+                         t.Apply(tag.Length("x2"), tag.Length("y2"))};
+    } else if (tag.name == "polyline" || tag.name == "polygon") {
+      polyline.points = ParsePoints(tag.Get("points"), t);
+      polyline.closed = tag.name == "polygon";
+    } else if (tag.name == "rect") {
+      double x = tag.Length("x"), y = tag.Length("y");
+      double w = tag.Length("width"), h = tag.Length("height");
+      if (w > 0 && h > 0) {
+        polyline.points = {t.Apply(x, y), t.Apply(x + w, y),
+                           t.Apply(x + w, y + h), t.Apply(x, y + h)};
+        polyline.closed = true;
+      }
+    } else if (tag.name == "circle" && tag.Length("r") > 0) {
+      polyline = Ellipse(t, tag.Length("cx"), tag.Length("cy"),
+                         tag.Length("r"), tag.Length("r"));
+    } else if (tag.name == "ellipse" && tag.Length("rx") > 0 &&
+               tag.Length("ry") > 0) {
+      polyline = Ellipse(t, tag.Length("cx"), tag.Length("cy"),
+                         tag.Length("rx"), tag.Length("ry"));
+    } else if (tag.name == "path") {
+      ParsePath(tag.Get("d"), t, &polylines);
+    }
+    if (polyline.points.size() >= 2) {
+      polylines.push_back(polyline);
+    }
+  }
+  return polylines;
+}
+
+std::vector<VectorMap::Polyline> VectorMap::ParseDxf(const std::string &text) {
+  // the group code and value pairs, one line each
+  std::vector<std::pair<int, std::string>> groups;
+  std::istringstream in(text);
+  std::string code, value;
+  while (std::getline(in, code) && std::getline(in, value)) {
+    boost::trim(code);
+    boost::trim(value);
+    char *end = nullptr;
+    long number = std::strtol(code.c_str(), &end, 10);
+    if (code.empty() || *end != 0) {
+      throw Exception("Flatland File: Invalid DXF group code " + Q(code));
+    }
+    groups.emplace_back(int(number), value);
+  }
+
+  // the entities of the ENTITIES section
+  std::vector<DxfEntity> entities;
+  bool in_entities = false;
+  for (size_t i = 0; i < groups.size(); i++) {
+    if (groups[i].first != 0) {
+      if (in_entities && !entities.empty()) {
+        entities.back().groups.push_back(groups[i]);
+      }
+      continue;
+    }
+    const std::string &type = groups[i].second;
+    if (type == "SECTION") {
+      in_entities = i + 1 < groups.size() && groups[i + 1].first == 2 &&
+                    groups[i + 1].second == "ENTITIES";
+    } else if (type == "ENDSEC") {
+      in_entities = false;
+    } else if (in_entities) {
+      entities.push_back(DxfEntity());
+      entities.back().type = type;
+    }
+  }
+
+  std::vector<Polyline> polylines;
+  for (size_t i = 0; i < entities.size(); i++) {
+    const DxfEntity &e = entities[i];
+    Polyline polyline;
+    if (e.type == "LINE") {
+      polyline.points = {Vec2(e.Get(10), e.Get(20)),
+                         Vec2(e.Get(11), e.Get(21))};
+    } else if (e.type == "LWPOLYLINE") {
+      std::vector<Vec2> vertices;
+      std::vector<double> bulges;
+      e.Vertices(&vertices, &bulges);
+      polyline = DxfPolyline(vertices, bulges, int(e.Get(70)) & 1);
+    } else if (e.type == "POLYLINE") {
+      // the vertices are the VERTEX entities up to the SEQEND
+      std::vector<Vec2> vertices;
+      std::vector<double> bulges;
+      for (i++; i < entities.size() && entities[i].type == "VERTEX"; i++) {
+        // the control points of splines are not on the curve
+        if (int(entities[i].Get(70)) & 16) {
+          continue;
+        }
+        vertices.push_back(Vec2(entities[i].Get(10), entities[i].Get(20)));
+        bulges.push_back(entities[i].Get(42));
+      }
+      polyline = DxfPolyline(vertices, bulges, int(e.Get(70)) & 1);
+    } else if (e.type == "CIRCLE" && e.Get(40) > 0) {
+      polyline = Ellipse(Affine(), e.Get(10), e.Get(20), e.Get(40), e.Get(40));
+    } else if (e.type == "ARC" && e.Get(40) > 0) {
+      double start = e.Get(50) * M_PI / 180, end = e.Get(51) * M_PI / 180;
+      if (end <= start) {
+        end += 2 * M_PI;
+      }
+      double cx = e.Get(10), cy = e.Get(20), r = e.Get(40);
+      polyline.points.push_back(
+          Vec2(cx + r * std::cos(start), cy + r * std::sin(start)));
+      AppendArc(Affine(), cx, cy, r, r, 0, start, end - start,
+                &polyline.points);
+    }
+    if (polyline.points.size() >= 2) {
+      polylines.push_back(polyline);
+    }
+  }
+  return polylines;
+}
+
+std::vector<VectorMap::Polyline> VectorMap::ParseGeoJson(
+    const std::string &text) {
+  std::vector<Polyline> polylines;
+  AddGeoJson(JsonParser(text).Parse(), &polylines);
+  return polylines;
+}
+
+std::vector<LineSegment> VectorMap::ToSegments(
+    const std::vector<Polyline> &polylines, double tolerance) {
+  std::vector<LineSegment> segments;
+  // the segments added, with their smaller end first
+  std::set<std::array<double, 4>> added;
+  std::vector<Vec2> points;
+
+  for (const Polyline &polyline : polylines) {
+    points.clear();
+    for (const Vec2 &p : polyline.points) {
+      if (points.empty() || std::hypot(p.x - points.back().x,
+                                       p.y - points.back().y) > tolerance) {
+        points.push_back(p);
+      }
+    }
+    if (polyline.closed && points.size() > 2 &&
+        std::hypot(points[0].x - points.back().x,
+                   points[0].y - points.back().y) > tolerance) {
+      points.push_back(points[0]);
+    }
+
+    // each segment is extended while the vertices it skips stay on it
+    size_t start = 0;
+    while (start + 1 < points.size()) {
+      size_t end = start + 1;
+      while (end + 1 < points.size() &&
+             OnSegment(points, start, end + 1, tolerance)) {
+        end++;
+      }
+      const Vec2 &a = points[start], &b = points[end];
+      std::array<double, 4> key = {a.x, a.y, b.x, b.y};
+      if (std::make_pair(b.x, b.y) < std::make_pair(a.x, a.y)) {
+        key = {b.x, b.y, a.x, a.y};
+      }
+      if (added.insert(key).second) {
+        segments.push_back(LineSegment(a, b));
+      }
+      start = end;
+    }
+  }
+  return segments;
+}
+
+std::vector<LineSegment> VectorMap::Load(const std::string &path,
+                                         Format format, double tolerance) {
+  return ToSegments(Read(path, format), tolerance);
+}
+};  // namespace flatland_server
@@ -45,25 +45,47 @@
  */
 
 #include <Box2D/Box2D.h>
+#include <flatland_server/alloc_counter.h>
 #include <flatland_server/debug_visualization.h>
 #include <flatland_server/exceptions.h>
+#include <flatland_server/physics_backend.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/task_pool.h>
+#include <flatland_server/tracer.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world.h>
+#include <flatland_server/world_checkpoint.h>
 #include <flatland_server/yaml_reader.h>
 #include <ros/ros.h>
 #include <yaml-cpp/yaml.h>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <exception>
+#include <limits>
 #include <map>
+#include <random>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace flatland_server {
 
-World::World()
+World::World(const std::string &ns, bool headless)
     : gravity_(0, 0),
+      next_model_id_(1),
+      model_pool_size_(0),
       service_paused_(false),
-      int_marker_manager_(&models_, &plugin_manager_) {
+      namespace_(ns),
+      physics_substep_size_(0),
+      substep_timekeeper_("") {
+  if (!headless) {
+    int_marker_manager_.reset(new InteractiveMarkerManager(this, ns));
+  }
   physics_world_ = new b2World(gravity_);
   physics_world_->SetContactListener(this);
+  physics_ = PhysicsBackend::Create("box2d", physics_world_);
 }
 
 World::~World() {
@@ -74,39 +96,225 @@ World::~World() {
   // manager which might cause it to work with deleted layers/models.
   physics_world_->SetContactListener(nullptr);
 
-  // the physics body of layers are set to null because there are tons of
-  // fixtures in a layer and it is too slow for the destroyBody method to remove
-  // them since the AABB tree gets restructured everytime a fixture is removed
-  // The memory will later be freed by deleting the world
-  for (auto &layer : layers_) {
-    if (layer->body_ != nullptr) {
-      layer->body_->physics_body_ = nullptr;
-    }
-    delete layer;
-  }
+  // the ghosts of the models of other regions are models as well
+  region_.reset();
 
-  // The bodies of models are not set to null like layers because there aren't
-  // nearly as many fixtures, and we might hide some memory problems by using
-  // the shortcut
-  for (unsigned int i = 0; i < models_.size(); i++) {
-    delete models_[i];
+  // There are tons of fixtures in the layers and models, they are removed
+  // from the broad-phase trees in one pass at the end of the bulk instead of
+  // restructuring the trees for every fixture
+  {
+    BulkDestroy bulk(physics_world_);
+    for (auto &layer : layers_) {
+      delete layer;
+    }
+    for (unsigned int i = 0; i < models_.size(); i++) {
+      delete models_[i];
+    }
+    for (const auto &pool : model_pools_) {
+      for (Model *m : pool.second.models) {
+        delete m;
+      }
+    }
   }
 
   // This frees the entire Box2D world with everything in it
   delete physics_world_;
 
+  if (sensor_request_) {
+    SensorExecutor::Get().Release(sensor_threads_);
+  }
+
   ROS_INFO_NAMED("World", "World destroyed");
 }
 
 void World::Update(Timekeeper &timekeeper) {
-  if (!IsPaused()) {
-    plugin_manager_.BeforePhysicsStep(timekeeper);
-    physics_world_->Step(timekeeper.GetStepSize(), physics_velocity_iterations_,
-                         physics_position_iterations_);
+  FLATLAND_TRACE("world", "update");
+  FLATLAND_COUNT_ALLOCATIONS("World::Update");
+  typedef StepTimer::Stage Stage;
+  ReloadWatchedLayers();
+  if (IsPaused()) {
+    UpdateInteractiveMarkers();
+    step_timer_.EndStep();
+    return;
+  }
+
+  UpdateLayerTiles(timekeeper.GetSimTime().toSec());
+  if (physics_lod_) {
+    physics_lod_->BeforeStep();
+  }
+
+  int substeps = 1;
+  if (physics_substep_size_ > 0) {
+    // the tolerance keeps rounding errors from adding a sub-step
+    double ratio = timekeeper.GetStepSize() / physics_substep_size_;
+    substeps = std::max(1, int(std::ceil(ratio - 1e-9)));
+  }
+
+  if (substeps == 1) {
+    {
+      StepTimer::Scope scope(step_timer_, Stage::BEFORE_PHYSICS_STEP);
+      FLATLAND_TRACE("world", "before_physics_step");
+      plugin_manager_.BeforePhysicsStep(timekeeper);
+    }
+    PhysicsStep(timekeeper.GetStepSize());
     timekeeper.StepTime();
-    plugin_manager_.AfterPhysicsStep(timekeeper);
+    {
+      StepTimer::Scope scope(step_timer_, Stage::AFTER_PHYSICS_STEP);
+      FLATLAND_TRACE("world", "after_physics_step");
+      plugin_manager_.AfterPhysicsStep(timekeeper);
+    }
+  } else {
+    typedef PluginManager::StepPlugins StepPlugins;
+    double substep_size = timekeeper.GetStepSize() / substeps;
+    {
+      StepTimer::Scope scope(step_timer_, Stage::BEFORE_PHYSICS_STEP);
+      FLATLAND_TRACE("world", "before_physics_step");
+      plugin_manager_.BeforePhysicsStep(timekeeper, StepPlugins::STEP);
+    }
+
+    // forces applied before the step act during all of its sub-steps
+    physics_world_->SetAutoClearForces(false);
+    substep_timekeeper_.time_ = timekeeper.GetSimTime();
+    substep_timekeeper_.SetMaxStepSize(substep_size);
+    for (int i = 0; i < substeps; i++) {
+      {
+        StepTimer::Scope scope(step_timer_, Stage::BEFORE_PHYSICS_STEP);
+        FLATLAND_TRACE("world", "before_physics_substep");
+        plugin_manager_.BeforePhysicsStep(substep_timekeeper_,
+                                          StepPlugins::SUBSTEP);
+      }
+      PhysicsStep(substep_size);
+      substep_timekeeper_.StepTime();
+      {
+        StepTimer::Scope scope(step_timer_, Stage::AFTER_PHYSICS_STEP);
+        FLATLAND_TRACE("world", "after_physics_substep");
+        plugin_manager_.AfterPhysicsStep(substep_timekeeper_,
+                                         StepPlugins::SUBSTEP);
+      }
+    }
+    physics_world_->ClearForces();
+    physics_world_->SetAutoClearForces(true);
+
+    timekeeper.StepTime();
+    {
+      StepTimer::Scope scope(step_timer_, Stage::AFTER_PHYSICS_STEP);
+      FLATLAND_TRACE("world", "after_physics_step");
+      plugin_manager_.AfterPhysicsStep(timekeeper, StepPlugins::STEP);
+    }
+  }
+  if (region_) {
+    region_->AfterStep(timekeeper.GetSimTime());
+  }
+  if (model_states_) {
+    model_states_->AfterStep(timekeeper.GetSimTime());
+  }
+  if (geometry_stream_) {
+    geometry_stream_->AfterStep(timekeeper.GetSimTime());
+  }
+  if (plugin_manager_.state_exporter_) {
+    plugin_manager_.state_exporter_->Write(plugin_manager_.body_states_,
+                                           timekeeper.GetSimTime().toSec());
+  }
+  UpdateInteractiveMarkers();
+  step_timer_.EndStep();
+}
+
+void World::PhysicsStep(double step_size) {
+  Tracer &tracer = Tracer::Get();
+  bool tracing = tracer.IsEnabled();
+  uint64_t start = tracing ? Tracer::Now() : 0;
+  if (physics_lod_) {
+    physics_lod_->BeforePhysicsStep(step_size);
+  }
+  {
+    StepTimer::Scope scope(step_timer_, StepTimer::Stage::PHYSICS_STEP);
+    physics_->Step(step_size);
+  }
+  if (physics_lod_) {
+    physics_lod_->AfterPhysicsStep();
+  }
+  plugin_manager_.body_states_.Refresh();
+  if (step_timer_.IsEnabled()) {
+    step_timer_.AddProfile(physics_->GetProfile());
+  }
+
+  if (tracing) {
+    // Box2D cannot be traced, its phases are laid out from b2Profile in the
+    // order b2World::Step runs them
+    b2Profile profile = physics_->GetProfile();
+    uint64_t end = Tracer::Now();
+    uint64_t collide = start + uint64_t(profile.collide * 1e6);
+    uint64_t solve = collide + uint64_t(profile.solve * 1e6);
+    uint64_t toi = std::min(end, solve + uint64_t(profile.solveTOI * 1e6));
+    tracer.Record("box2d", "step", start, end);
+    tracer.Record("box2d", "collide", start, std::min(end, collide));
+    tracer.Record("box2d", "solve", std::min(end, collide),
+                  std::min(end, solve));
+    tracer.Record("box2d", "solve_toi", std::min(end, solve), toi);
+  }
+
+  {
+    StepTimer::Scope scope(step_timer_, StepTimer::Stage::AFTER_PHYSICS_STEP);
+    FLATLAND_TRACE("world", "contact_events");
+    plugin_manager_.DeliverContactEvents();
+  }
+}
+
+void World::UpdateInteractiveMarkers() {
+  if (int_marker_manager_) {
+    StepTimer::Scope scope(step_timer_, StepTimer::Stage::INTERACTIVE_MARKERS);
+    FLATLAND_TRACE("world", "interactive_markers");
+    int_marker_manager_->update();
+  }
+}
+
+void World::UpdateLayerTiles(double time) {
+  // the scratch vectors keep their capacity, so the steps do not allocate
+  std::vector<Layer *> &tiled_layers = tiled_layers_;
+  tiled_layers.clear();
+  for (auto &layer : layers_) {
+    if (layer->GetTiles()) {
+      tiled_layers.push_back(layer);
+    }
+  }
+  if (tiled_layers.empty()) {
+    return;
+  }
+
+  // one region per model, bounding the broadphase boxes of its fixtures
+  std::vector<b2AABB> &regions = tile_regions_;
+  regions.clear();
+  for (const auto &model : models_) {
+    bool empty = true;
+    b2AABB region;
+    for (const auto &body : model->bodies_) {
+      for (b2Fixture *f = body->physics_body_->GetFixtureList(); f;
+           f = f->GetNext()) {
+        for (int i = 0; i < f->GetShape()->GetChildCount(); i++) {
+          if (empty) {
+            region = f->GetAABB(i);
+            empty = false;
+          } else {
+            region.Combine(f->GetAABB(i));
+          }
+        }
+      }
+    }
+    if (!empty) {
+      regions.push_back(region);
+    }
+  }
+
+  // the activated and evicted tiles change the geometry of their layer for
+  // the plugins caching their raycasts
+  for (Layer *layer : tiled_layers) {
+    LayerTiles *tiles = layer->GetTiles();
+    uint64_t changes = tiles->GetChangeCount();
+    tiles->Update(regions, time);
+    if (tiles->GetChangeCount() != changes) {
+      layer->GeometryChanged();
+    }
   }
-  int_marker_manager_.update();
 }
 
 void World::BeginContact(b2Contact *contact) {
@@ -125,20 +333,239 @@ void World::PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) {
   plugin_manager_.PostSolve(contact, impulse);
 }
 
-World *World::MakeWorld(const std::string &yaml_path) {
-  YamlReader world_reader = YamlReader(yaml_path);
+World *World::MakeWorld(const std::string &yaml_path, const std::string &ns,
+                        bool headless) {
+  FLATLAND_TRACE("load", "world");
+  // a bundle holds the whole world preprocessed, see WorldBundle
+  std::shared_ptr<WorldBundle> bundle;
+  YamlReader world_reader;
+  if (WorldBundle::IsBundle(yaml_path)) {
+    bundle = std::make_shared<WorldBundle>();
+    bundle->Open(yaml_path);
+    YAML::Node node;
+    if (!bundle->FindYaml(WorldBundle::WORLD_KEY, &node)) {
+      throw YAMLException("World bundle " + Q(yaml_path) + " has no world");
+    }
+    world_reader = YamlReader(node);
+    world_reader.SetFile(yaml_path);
+  } else {
+    world_reader = YamlReader(yaml_path);
+  }
   YamlReader prop_reader = world_reader.Subnode("properties", YamlReader::MAP);
   int v = prop_reader.Get<int>("velocity_iterations", 10);
   int p = prop_reader.Get<int>("position_iterations", 10);
+  unsigned int sensor_threads =
+      prop_reader.Get<unsigned int>("sensor_threads", 0);
+  unsigned int plugin_threads =
+      prop_reader.Get<unsigned int>("plugin_threads", 0);
+  unsigned int physics_threads =
+      prop_reader.Get<unsigned int>("physics_threads", 0);
+  std::string physics_backend =
+      prop_reader.Get<std::string>("physics_backend", "box2d");
+  unsigned int load_threads = prop_reader.Get<unsigned int>("load_threads", 0);
+  double physics_substep_size =
+      prop_reader.Get<double>("physics_substep_size", 0);
+  unsigned int model_pool_size =
+      prop_reader.Get<unsigned int>("model_pool_size", 0);
+  double interactive_marker_rate =
+      prop_reader.Get<double>("interactive_marker_rate", 30);
+  double sleeping_update_rate =
+      prop_reader.Get<double>("sleeping_update_rate", 0);
+  bool stagger_updates = prop_reader.Get<bool>("stagger_updates", false);
+  unsigned int deferred_contacts =
+      prop_reader.Get<unsigned int>("deferred_contacts", 0);
+  double model_states_rate = prop_reader.Get<double>("model_states_rate", 0);
+  double geometry_stream_rate =
+      prop_reader.Get<double>("geometry_stream_rate", 0);
+  bool pipelined_sensing = prop_reader.Get<bool>("pipelined_sensing", false);
+  bool gpu_raycast = prop_reader.Get<bool>("gpu_raycast", false);
+  bool continuous_physics = prop_reader.Get<bool>("continuous_physics", true);
+  YamlReader adaptive_reader =
+      prop_reader.SubnodeOpt("adaptive_aabb", YamlReader::MAP);
+  b2AdaptiveAABB adaptive_aabb;
+  if (!adaptive_reader.IsNodeNull()) {
+    adaptive_aabb.enabled = true;
+    adaptive_aabb.minExtension =
+        adaptive_reader.Get<float>("min_margin", adaptive_aabb.minExtension);
+    adaptive_aabb.maxExtension =
+        adaptive_reader.Get<float>("max_margin", adaptive_aabb.maxExtension);
+    adaptive_aabb.lookahead =
+        adaptive_reader.Get<float>("lookahead", adaptive_aabb.lookahead);
+    adaptive_reader.EnsureAccessedAllKeys();
+    if (adaptive_aabb.minExtension <= 0 ||
+        adaptive_aabb.maxExtension < adaptive_aabb.minExtension ||
+        adaptive_aabb.lookahead < 0) {
+      throw YAMLException(
+          "Invalid \"adaptive_aabb\", min_margin must be greater than 0, "
+          "max_margin not less than min_margin and lookahead not negative");
+    }
+  }
+  YamlReader sleep_reader = prop_reader.SubnodeOpt("sleep", YamlReader::MAP);
+  b2SleepSettings sleep;
+  if (!sleep_reader.IsNodeNull()) {
+    sleep.timeToSleep =
+        sleep_reader.Get<float>("time_to_sleep", sleep.timeToSleep);
+    sleep.linearTolerance =
+        sleep_reader.Get<float>("linear_tolerance", sleep.linearTolerance);
+    sleep.angularTolerance =
+        sleep_reader.Get<float>("angular_tolerance", sleep.angularTolerance);
+    sleep_reader.EnsureAccessedAllKeys();
+    if (sleep.timeToSleep < 0 || sleep.linearTolerance < 0 ||
+        sleep.angularTolerance < 0) {
+      throw YAMLException(
+          "Invalid \"sleep\", time_to_sleep, linear_tolerance and "
+          "angular_tolerance must not be negative");
+    }
+  }
+  int allocator_chunk_size =
+      prop_reader.Get<int>("allocator_chunk_size", b2_chunkSize);
+  int allocator_max_chunk_size =
+      prop_reader.Get<int>("allocator_max_chunk_size", 1024 * 1024);
+  if (allocator_chunk_size < b2_maxBlockSize ||
+      allocator_max_chunk_size < allocator_chunk_size) {
+    throw YAMLException(
+        "Invalid \"allocator_chunk_size\" or \"allocator_max_chunk_size\", "
+        "the chunks must hold at least " +
+        std::to_string(b2_maxBlockSize) +
+        " bytes and the maximum must not be less than the first");
+  }
+  YamlReader export_reader =
+      prop_reader.SubnodeOpt("state_export", YamlReader::MAP);
+  std::string export_name;
+  unsigned int export_slots = 0, export_bodies = 0, export_scans = 0,
+               export_ranges = 0;
+  if (!export_reader.IsNodeNull()) {
+    export_name = export_reader.Get<std::string>("name");
+    export_slots = export_reader.Get<unsigned int>("slots", 8);
+    export_bodies = export_reader.Get<unsigned int>("max_bodies", 1024);
+    export_scans = export_reader.Get<unsigned int>("max_scans", 256);
+    export_ranges = export_reader.Get<unsigned int>("max_ranges", 262144);
+    export_reader.EnsureAccessedAllKeys();
+  }
+  YamlReader region_reader = prop_reader.SubnodeOpt("region", YamlReader::MAP);
+  RegionExchange::Params region;
+  if (!region_reader.IsNodeNull()) {
+    region.name = region_reader.Get<std::string>("name");
+    std::array<double, 4> bounds = region_reader.GetArray<double, 4>("bounds");
+    region.bounds.lowerBound.Set(bounds[0], bounds[1]);
+    region.bounds.upperBound.Set(bounds[2], bounds[3]);
+    region.margin = region_reader.Get<double>("ghost_margin", region.margin);
+    region.topic = region_reader.Get<std::string>("topic", region.topic);
+    region_reader.EnsureAccessedAllKeys();
+    if (bounds[2] <= bounds[0] || bounds[3] <= bounds[1] ||
+        region.margin < 0) {
+      throw YAMLException("Invalid region " + Q(region.name) +
+                          ", the bounds must be [min x, min y, max x, max y] "
+                          "and the ghost margin must not be negative");
+    }
+  }
+  YamlReader lod_reader =
+      prop_reader.SubnodeOpt("physics_lod", YamlReader::MAP);
+  PhysicsLod::Params lod;
+  if (!lod_reader.IsNodeNull()) {
+    lod.focus = lod_reader.GetList<std::string>("focus", {}, -1, -1);
+    lod.radius = lod_reader.Get<double>("radius", lod.radius);
+    YamlReader regions_reader =
+        lod_reader.SubnodeOpt("regions", YamlReader::LIST);
+    for (int i = 0; i < regions_reader.NodeSize(); i++) {
+      std::array<double, 4> bounds =
+          regions_reader.Subnode(i, YamlReader::LIST).AsArray<double, 4>();
+      b2AABB region;
+      region.lowerBound.Set(bounds[0], bounds[1]);
+      region.upperBound.Set(bounds[2], bounds[3]);
+      if (bounds[2] < bounds[0] || bounds[3] < bounds[1]) {
+        throw YAMLException(
+            "Invalid \"regions\" in \"physics_lod\", each region must be "
+            "[min x, min y, max x, max y]");
+      }
+      lod.regions.push_back(region);
+    }
+    lod.hysteresis = lod_reader.Get<double>("hysteresis", lod.hysteresis);
+    lod.physics_rate =
+        lod_reader.Get<double>("physics_rate", lod.physics_rate);
+    lod.plugin_rate = lod_reader.Get<double>("plugin_rate", lod.plugin_rate);
+    lod_reader.EnsureAccessedAllKeys();
+    if ((lod.focus.empty() && lod.regions.empty()) || lod.radius < 0 ||
+        lod.hysteresis < 0 || lod.physics_rate < 0 || lod.plugin_rate <= 0) {
+      throw YAMLException(
+          "Invalid \"physics_lod\", it needs focus models or regions, the "
+          "radius, hysteresis and physics_rate must not be negative and the "
+          "plugin_rate must be positive");
+    }
+  }
+  std::vector<std::string> backends = PhysicsBackend::GetBackendNames();
+  if (std::find(backends.begin(), backends.end(), physics_backend) ==
+      backends.end()) {
+    throw YAMLException("Invalid physics_backend " + Q(physics_backend) +
+                        ", the backends built in are " +
+                        boost::algorithm::join(backends, ", "));
+  }
   prop_reader.EnsureAccessedAllKeys();
 
-  World *w = new World();
+  World *w = new World(ns, headless);
+
+  // the executor is shared by all sensor plugins in the process
+  w->sensor_threads_ = sensor_threads;
+  w->sensor_request_ = true;
+  if (!SensorExecutor::Get().Request(sensor_threads)) {
+    ROS_WARN_NAMED("World",
+                   "sensor_threads %u differs from the one of another world, "
+                   "the executor is shared by all worlds and now has %u "
+                   "threads",
+                   sensor_threads, SensorExecutor::Get().GetNumThreads());
+  }
 
   w->world_yaml_dir_ = boost::filesystem::path(yaml_path).parent_path();
-  w->physics_velocity_iterations_ = v;
-  w->physics_position_iterations_ = p;
+  w->bundle_ = bundle;
+  if (bundle) {
+    // the models of the bundle are read from it instead of their files
+    for (const std::string &model : bundle->Keys(WorldBundle::ModelKey(""))) {
+      boost::filesystem::path path(model);
+      if (model.front() != '/') {
+        path = w->world_yaml_dir_ / path;
+      }
+      ModelTemplate &model_template = w->model_templates_[path.string()];
+      model_template.mtime = 0;
+      bundle->FindYaml(WorldBundle::ModelKey(model), &model_template.node);
+      model_template.bundled = true;
+    }
+  }
+  if (physics_backend != w->physics_->GetName()) {
+    w->physics_ = PhysicsBackend::Create(physics_backend, w->physics_world_);
+  }
+  w->physics_->SetIterations(v, p);
+  w->physics_substep_size_ = physics_substep_size;
+  w->model_pool_size_ = model_pool_size;
+  w->load_threads_ = load_threads;
+  if (w->int_marker_manager_) {
+    w->int_marker_manager_->setUpdateRate(interactive_marker_rate);
+  }
+  w->plugin_manager_.SetNumThreads(plugin_threads);
+  w->plugin_manager_.SetSleepingUpdateRate(sleeping_update_rate);
+  w->plugin_manager_.SetStaggerUpdates(stagger_updates);
+  w->plugin_manager_.SetDeferredContacts(deferred_contacts);
+  if (pipelined_sensing) {
+    w->plugin_manager_.SetPipelinedSensing(w->physics_world_);
+  }
+  if (gpu_raycast) {
+    w->plugin_manager_.SetGpuRaycasting(w->physics_world_);
+  }
+  w->physics_world_->SetAllocatorChunkSize(allocator_chunk_size,
+                                           allocator_max_chunk_size);
+  w->physics_world_->SetContinuousPhysics(continuous_physics);
+  w->physics_world_->SetAdaptiveAABB(adaptive_aabb);
+  w->physics_world_->SetSleepSettings(sleep);
+  w->physics_->SetThreads(physics_threads);
 
   try {
+    // created before the plugins, which add their scans to it
+    if (!export_name.empty()) {
+      w->plugin_manager_.state_exporter_.reset(new StateExporter());
+      w->plugin_manager_.state_exporter_->Create(
+          export_name, export_slots, export_bodies, export_scans,
+          export_ranges);
+    }
+
     YamlReader layers_reader = world_reader.Subnode("layers", YamlReader::LIST);
     YamlReader models_reader =
         world_reader.SubnodeOpt("models", YamlReader::LIST);
@@ -148,6 +575,20 @@ World *World::MakeWorld(const std::string &yaml_path) {
     w->LoadLayers(layers_reader);
     w->LoadModels(models_reader);
     w->LoadWorldPlugins(world_plugin_reader, w, world_reader);
+    if (!region.name.empty()) {
+      w->region_.reset(new RegionExchange(w, region));
+      w->region_->DeleteForeignModels();
+    }
+    if (model_states_rate > 0) {
+      w->model_states_.reset(new ModelStatesPublisher(w, model_states_rate));
+    }
+    if (geometry_stream_rate > 0) {
+      w->geometry_stream_.reset(new GeometryStream(w, geometry_stream_rate));
+    }
+    if (!lod_reader.IsNodeNull()) {
+      w->physics_lod_.reset(new PhysicsLod(w, lod));
+    }
+    w->snapshot_ = w->Snapshot();
   } catch (const YAMLException &e) {
     ROS_FATAL_NAMED("World", "Error loading from YAML");
     delete w;
@@ -164,7 +605,42 @@ World *World::MakeWorld(const std::string &yaml_path) {
   return w;
 }
 
+namespace {
+/**
+ * @brief Latest modification time of the map yaml of a layer and of the
+ * image, line segments file or drawing it refers to, 0 if the yaml cannot be
+ * read
+ */
+std::time_t LayerFilesTime(const std::string &map_path) {
+  boost::system::error_code ec;
+  std::time_t latest = boost::filesystem::last_write_time(map_path, ec);
+  if (ec) {
+    return 0;
+  }
+
+  try {
+    YamlReader reader(map_path);
+    std::string type = reader.Get<std::string>("type", "");
+    bool line_segments = type == "line_segments" || type == "vector";
+    std::string data =
+        reader.Get<std::string>(line_segments ? "data" : "image");
+    boost::filesystem::path data_path(data);
+    if (!data.empty() && data.front() != '/') {
+      data_path = boost::filesystem::path(map_path).parent_path() / data_path;
+    }
+    std::time_t data_time = boost::filesystem::last_write_time(data_path, ec);
+    if (!ec) {
+      latest = std::max(latest, data_time);
+    }
+  } catch (const std::exception &) {
+    // a broken map yaml is reported when the layer is reloaded
+  }
+  return latest;
+}
+}
+
 void World::LoadLayers(YamlReader &layers_reader) {
+  FLATLAND_TRACE("load", "layers");
   // loop through each layer and parse the data
   for (int i = 0; i < layers_reader.NodeSize(); i++) {
     YamlReader reader = layers_reader.Subnode(i, YamlReader::MAP);
@@ -186,12 +662,21 @@ void World::LoadLayers(YamlReader &layers_reader) {
           ", max allowed is " + std::to_string(cfr_.MAX_LAYERS));
     }
 
-    boost::filesystem::path map_path(reader.Get<std::string>("map", ""));
+    std::string map = reader.Get<std::string>("map", "");
+    boost::filesystem::path map_path(map);
     Color color = reader.GetColor("color", Color(1, 1, 1, 1));
     auto properties =
         reader.SubnodeOpt("properties", YamlReader::NodeTypeCheck::MAP).Node();
+    bool watch = reader.Get<bool>("watch", false);
+    std::string topic = reader.Get<std::string>("topic", "");
+    double occupied_thresh = reader.Get<double>("occupied_thresh", 0.65);
     reader.EnsureAccessedAllKeys();
 
+    if (!topic.empty() && !map.empty()) {
+      throw YAMLException("Layer " + Q(names[0]) +
+                          " cannot have both a map and a topic");
+    }
+
     for (const auto &name : names) {
       if (cfr_.RegisterLayer(name) == cfr_.LAYER_ALREADY_EXIST) {
         throw YAMLException("Layer with name " + Q(name) + " already exists");
@@ -205,11 +690,29 @@ void World::LoadLayers(YamlReader &layers_reader) {
     ROS_INFO_NAMED("World", "Loading layer \"%s\" from path=\"%s\"",
                    names[0].c_str(), map_path.string().c_str());
 
-    Layer *layer = Layer::MakeLayer(physics_world_, &cfr_, map_path.string(),
-                                    names, color, properties);
+    Layer *layer;
+    if (!topic.empty()) {
+      layer = new Layer(physics_world_, &cfr_, names, color, topic,
+                        occupied_thresh, properties);
+      layer->SubscribeGrid(namespace_);
+    } else {
+      layer = Layer::MakeLayer(physics_world_, &cfr_, map_path.string(), names,
+                               color, properties, bundle_.get(), map);
+    }
+    if (map_path.string().length() > 0) {
+      layer->map_path_ = map_path.string();
+      layer->ShareGeometry(map_path.string());
+      layer->PublishGrid(namespace_);
+      if (watch && !bundle_) {
+        watched_layers_[layer] = LayerFilesTime(layer->map_path_);
+      }
+    }
     layers_name_map_.insert(
         std::pair<std::vector<std::string>, Layer *>(names, layer));
     layers_.push_back(layer);
+    for (const auto &name : names) {
+      layers_by_name_[name] = layer;
+    }
 
     ROS_INFO_NAMED("World", "Layer \"%s\" loaded", layer->name_.c_str());
     layer->DebugOutput();
@@ -217,22 +720,181 @@ void World::LoadLayers(YamlReader &layers_reader) {
 }
 
 void World::LoadModels(YamlReader &models_reader) {
-  if (!models_reader.IsNodeNull()) {
-    for (int i = 0; i < models_reader.NodeSize(); i++) {
-      YamlReader reader = models_reader.Subnode(i, YamlReader::MAP);
-
-      std::string name = reader.Get<std::string>("name");
-      std::string ns = reader.Get<std::string>("namespace", "");
-      Pose pose = reader.GetPose("pose", Pose(0, 0, 0));
-      std::string path = reader.Get<std::string>("model");
+  FLATLAND_TRACE("load", "models");
+  if (models_reader.IsNodeNull()) {
+    return;
+  }
+
+  // the entries are read first, they are cheap to read. The copies of a
+  // replicate entry share the template of their model file, see
+  // ReadModelYaml
+  std::vector<ModelEntry> entries;
+  ReadModelEntries(models_reader, &entries);
+
+  if (load_threads_ == 0) {
+    for (const ModelEntry &entry : entries) {
+      LoadModel(entry.path, entry.ns, entry.name, entry.pose);
+    }
+    return;
+  }
+
+  // reading and preprocessing the model files and creating the plugins does
+  // not touch the world, so it runs in parallel
+  std::vector<PreparedModel> prepared(entries.size());
+  std::vector<std::exception_ptr> errors(entries.size());
+  {
+    TaskPool pool(load_threads_);
+    pool.Run(entries.size(), [&](unsigned int i) {
+      try {
+        prepared[i] = PrepareModel(entries[i].path, entries[i].ns,
+                                   entries[i].name, entries[i].pose);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+
+  // the bodies, joints and plugins are added in the order of the list, so
+  // the ids and the Box2D state do not depend on the threads, and the first
+  // model failing is reported as when loading in series
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+    CommitModel(prepared[i]);
+  }
+}
+
+void World::ReadModelEntries(YamlReader &models_reader,
+                             std::vector<ModelEntry> *entries) {
+  for (int i = 0; i < models_reader.NodeSize(); i++) {
+    YamlReader reader = models_reader.Subnode(i, YamlReader::MAP);
+    YamlReader replicate_reader =
+        reader.SubnodeOpt("replicate", YamlReader::MAP);
+    if (!replicate_reader.IsNodeNull()) {
       reader.EnsureAccessedAllKeys();
-      LoadModel(path, ns, name, pose);
+      ReadReplicas(replicate_reader, entries);
+      continue;
     }
+
+    ModelEntry entry;
+    entry.name = reader.Get<std::string>("name");
+    entry.ns = reader.Get<std::string>("namespace", "");
+    entry.pose = reader.GetPose("pose", Pose(0, 0, 0));
+    entry.path = reader.Get<std::string>("model");
+    reader.EnsureAccessedAllKeys();
+    entries->push_back(entry);
+  }
+}
+
+void World::ReadReplicas(YamlReader &reader,
+                         std::vector<ModelEntry> *entries) {
+  std::string path = reader.Get<std::string>("model");
+  std::string name = reader.Get<std::string>("name");
+  std::string ns = reader.Get<std::string>("namespace", "");
+  int first_index = reader.Get<int>("first_index", 0);
+  YamlReader grid_reader = reader.SubnodeOpt("grid", YamlReader::MAP);
+  YamlReader random_reader = reader.SubnodeOpt("random", YamlReader::MAP);
+  std::vector<Pose> poses =
+      reader.GetList<Pose>("poses", std::vector<Pose>(), -1, -1);
+  int count = reader.Get<int>("count", int(poses.size()));
+  reader.EnsureAccessedAllKeys();
+
+  std::string error = "Invalid replicate entry of model " + Q(path);
+  int patterns = int(!grid_reader.IsNodeNull()) +
+                 int(!random_reader.IsNodeNull()) + int(!poses.empty());
+  if (patterns != 1) {
+    throw YAMLException(error + ", exactly one of grid, random or poses "
+                                "must be given");
+  }
+  if (count <= 0) {
+    throw YAMLException(error + ", count must be positive");
+  }
+  if (count > 1 && name.find("{i}") == std::string::npos) {
+    throw YAMLException(error + ", name must contain {i}");
+  }
+  if (!poses.empty() && count != int(poses.size())) {
+    throw YAMLException(error + ", count must match the number of poses");
+  }
+
+  if (!grid_reader.IsNodeNull()) {
+    // the rows and columns are along the axes of the origin pose
+    Pose origin = grid_reader.GetPose("origin", Pose(0, 0, 0));
+    Vec2 spacing = grid_reader.GetVec2("spacing");
+    int columns = grid_reader.Get<int>("columns", count);
+    grid_reader.EnsureAccessedAllKeys();
+    if (columns <= 0) {
+      throw YAMLException(error + ", columns must be positive");
+    }
+    double c = std::cos(origin.theta), s = std::sin(origin.theta);
+    for (int k = 0; k < count; k++) {
+      double dx = spacing.x * (k % columns), dy = spacing.y * (k / columns);
+      poses.push_back(Pose(origin.x + c * dx - s * dy,
+                           origin.y + s * dx + c * dy, origin.theta));
+    }
+  } else if (!random_reader.IsNodeNull()) {
+    // the copies are drawn one after the other, a position closer than the
+    // clearance to a copy already placed is drawn again
+    std::array<double, 4> region =
+        random_reader.GetArray<double, 4>("region");
+    double clearance = random_reader.Get<double>("clearance", 0);
+    unsigned int seed = random_reader.Get<unsigned int>("seed", 0);
+    random_reader.EnsureAccessedAllKeys();
+    if (region[2] < region[0] || region[3] < region[1] || clearance < 0) {
+      throw YAMLException(error + ", region must be [x_min, y_min, x_max, "
+                                  "y_max] and clearance must not be negative");
+    }
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> x(region[0], region[2]);
+    std::uniform_real_distribution<double> y(region[1], region[3]);
+    std::uniform_real_distribution<double> theta(-M_PI, M_PI);
+    const int max_attempts = 1000;
+    for (int k = 0; k < count; k++) {
+      int attempts = 0;
+      Pose pose;
+      bool overlaps;
+      do {
+        if (attempts++ == max_attempts) {
+          throw YAMLException(error + ", failed to place " +
+                              std::to_string(count) + " copies " +
+                              std::to_string(clearance) +
+                              " apart in the region");
+        }
+        pose = Pose(x(rng), y(rng), theta(rng));
+        overlaps = false;
+        for (const Pose &placed : poses) {
+          double ddx = placed.x - pose.x, ddy = placed.y - pose.y;
+          if (ddx * ddx + ddy * ddy < clearance * clearance) {
+            overlaps = true;
+            break;
+          }
+        }
+      } while (overlaps);
+      poses.push_back(pose);
+    }
+  }
+
+  auto expand = [](std::string pattern, int index) {
+    std::string value = std::to_string(index);
+    for (size_t at = pattern.find("{i}"); at != std::string::npos;
+         at = pattern.find("{i}", at + value.size())) {
+      pattern.replace(at, 3, value);
+    }
+    return pattern;
+  };
+  for (int k = 0; k < count; k++) {
+    ModelEntry entry;
+    entry.path = path;
+    entry.name = expand(name, first_index + k);
+    entry.ns = expand(ns, first_index + k);
+    entry.pose = poses[k];
+    entries->push_back(entry);
   }
 }
 
 void World::LoadWorldPlugins(YamlReader &world_plugin_reader, World *world,
                              YamlReader &world_config) {
+  FLATLAND_TRACE("load", "world_plugins");
   if (!world_plugin_reader.IsNodeNull()) {
     for (int i = 0; i < world_plugin_reader.NodeSize(); i++) {
       YamlReader reader = world_plugin_reader.Subnode(i, YamlReader::MAP);
@@ -241,13 +903,19 @@ void World::LoadWorldPlugins(YamlReader &world_plugin_reader, World *world,
     }
   }
 }
+
 void World::LoadModel(const std::string &model_yaml_path, const std::string &ns,
                       const std::string &name, const Pose &pose) {
-  // ensure no duplicate model names
-  if (std::count_if(models_.begin(), models_.end(),
-                    [&](Model *m) { return m->name_ == name; }) >= 1) {
-    throw YAMLException("Model with name " + Q(name) + " already exists");
-  }
+  PreparedModel prepared = PrepareModel(model_yaml_path, ns, name, pose);
+  CommitModel(prepared);
+}
+
+PreparedModel World::PrepareModel(const std::string &model_yaml_path,
+                                  const std::string &ns,
+                                  const std::string &name, const Pose &pose) {
+  PreparedModel prepared;
+  prepared.name = name;
+  prepared.pose = pose;
 
   boost::filesystem::path abs_path(model_yaml_path);
   if (model_yaml_path.front() != '/') {
@@ -257,77 +925,539 @@ void World::LoadModel(const std::string &model_yaml_path, const std::string &ns,
   ROS_INFO_NAMED("World", "Loading model from path=\"%s\"",
                  abs_path.string().c_str());
 
-  Model *m =
-      Model::MakeModel(physics_world_, &cfr_, abs_path.string(), ns, name);
-  m->TransformAll(pose);
+  prepared.yaml_path = abs_path.string();
+  prepared.ns = ns;
+  if (!namespace_.empty()) {
+    prepared.ns = ns.empty() ? namespace_ : namespace_ + "/" + ns;
+  }
+
+  // the plugins are created here, but only initialized once the model exists
+  prepared.reader = ReadModelYaml(prepared.yaml_path, &prepared.yaml_mtime);
+  prepared.reader.SetErrorInfo("model " + Q(name));
+  YamlReader plugins_reader =
+      prepared.reader.SubnodeOpt("plugins", YamlReader::LIST);
+  // the plugins of the instances of a template share their parameters, a
+  // modified file is a new template
+  std::string template_key = prepared.yaml_path + "@" +
+                             std::to_string(prepared.yaml_mtime) + "#";
+  for (int i = 0; i < plugins_reader.NodeSize(); i++) {
+    YamlReader plugin_reader = plugins_reader.Subnode(i, YamlReader::MAP);
+    prepared.plugins.push_back(plugin_manager_.PrepareModelPlugin(
+        name, plugin_reader, template_key + std::to_string(i)));
+  }
+  return prepared;
+}
+
+YamlReader World::ReadModelYaml(const std::string &path,
+                                 std::time_t *mtime_out) {
+  FLATLAND_TRACE("load", "model_yaml");
+  if (bundle_) {
+    // the templates of a bundle have no file to check
+    std::lock_guard<std::mutex> lock(model_templates_mutex_);
+    auto it = model_templates_.find(path);
+    if (it != model_templates_.end() && it->second.bundled) {
+      if (mtime_out != nullptr) {
+        *mtime_out = it->second.mtime;
+      }
+      YamlReader reader(YAML::Clone(it->second.node));
+      reader.SetFile(path);
+      return reader;
+    }
+  }
+
+  boost::system::error_code ec;
+  std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+  if (mtime_out != nullptr) {
+    *mtime_out = ec ? 0 : mtime;
+  }
+  if (ec) {
+    return YamlReader(path);  // throws the missing file
+  }
+
+  YAML::Node node;
+  bool cached = false;
+  {
+    std::lock_guard<std::mutex> lock(model_templates_mutex_);
+    auto it = model_templates_.find(path);
+    if (it != model_templates_.end() && it->second.mtime == mtime) {
+      node = it->second.node;
+      cached = true;
+    }
+  }
+
+  if (!cached) {
+    YamlReader reader(path);
+    node = YAML::Clone(reader.Node());
+    std::lock_guard<std::mutex> lock(model_templates_mutex_);
+    ModelTemplate &model_template = model_templates_[path];
+    model_template.mtime = mtime;
+    model_template.node = node;
+  }
+
+  // each model gets its own copy, the template is never modified
+  YamlReader reader(YAML::Clone(node));
+  reader.SetFile(path);
+  return reader;
+}
+
+void World::CommitModel(PreparedModel &prepared) {
+  const std::string &name = prepared.name;
+  const Pose &pose = prepared.pose;
+
+  // ensure no duplicate model names
+  if (models_by_name_.count(name) > 0) {
+    throw YAMLException("Model with name " + Q(name) + " already exists");
+  }
+
+  // a parked model of the same file is reused, its bodies and joints are
+  // kept and it only gets new plugins
+  Model *m = nullptr;
+  auto pool = model_pools_.find(prepared.yaml_path);
+  if (pool != model_pools_.end() && !pool->second.models.empty() &&
+      pool->second.mtime == prepared.yaml_mtime) {
+    FLATLAND_TRACE("load", "model_bodies");
+    m = pool->second.models.back();
+    pool->second.models.pop_back();
+    m->Reuse(prepared.ns, name, pose);
+  } else {
+    FLATLAND_TRACE("load", "model_bodies");
+    m = Model::MakeModel(physics_world_, &cfr_, prepared.reader,
+                         prepared.yaml_path, prepared.ns, name);
+    m->yaml_mtime_ = prepared.yaml_mtime;
+    m->TransformAll(pose);
+  }
+
+  // the plugins may read the states of the bodies when initialized
+  BodyStates &body_states = plugin_manager_.body_states_;
+  for (auto &body : m->bodies_) {
+    body_states.Add(body);
+  }
 
   try {
-    for (int i = 0; i < m->plugins_reader_.NodeSize(); i++) {
-      YamlReader plugin_reader = m->plugins_reader_.Subnode(i, YamlReader::MAP);
-      plugin_manager_.LoadModelPlugin(m, plugin_reader);
+    FLATLAND_TRACE("load", "model_plugins_init");
+    for (auto &plugin : prepared.plugins) {
+      plugin_manager_.AddModelPlugin(m, plugin);
     }
   } catch (const YAMLException &e) {
     plugin_manager_.DeleteModelPlugin(m);
+    for (auto &body : m->bodies_) {
+      body_states.Remove(body);
+    }
     delete m;
     throw e;
   } catch (const PluginException &e) {
     plugin_manager_.DeleteModelPlugin(m);
+    for (auto &body : m->bodies_) {
+      body_states.Remove(body);
+    }
     delete m;
     throw e;
   }
 
+  m->id_ = next_model_id_++;
   models_.push_back(m);
+  models_by_name_[name] = m;
+  models_by_id_[m->id_] = m;
 
-  visualization_msgs::MarkerArray body_markers;
-  for (size_t i = 0; i < m->bodies_.size(); i++) {
-    DebugVisualization::Get().BodyToMarkers(
-        body_markers, m->bodies_[i]->physics_body_, 1.0, 0.0, 0.0, 1.0);
+  if (int_marker_manager_) {
+    FLATLAND_TRACE("load", "interactive_marker");
+    int_marker_manager_->createInteractiveMarker(m);
   }
-  int_marker_manager_.createInteractiveMarker(name, pose, body_markers);
 
   ROS_INFO_NAMED("World", "Model \"%s\" loaded", m->name_.c_str());
   m->DebugOutput();
 }
 
 void World::DeleteModel(const std::string &name) {
-  bool found = false;
+  Model *m = GetModel(name);
+  if (m == nullptr) {
+    throw Exception("Flatland World: failed to delete model, model with name " +
+                    Q(name) + " does not exist");
+  }
 
-  for (unsigned int i = 0; i < models_.size(); i++) {
-    // name is unique, so there will only be one object with this name
-    if (models_[i]->GetName() == name) {
-      // delete the plugins associated with the model
-      plugin_manager_.DeleteModelPlugin(models_[i]);
-      delete models_[i];
-      models_.erase(models_.begin() + i);
-      int_marker_manager_.deleteInteractiveMarker(name);
-      found = true;
-      break;
+  // delete the plugins associated with the model
+  plugin_manager_.DeleteModelPlugin(m);
+  if (physics_lod_) {
+    physics_lod_->Remove(m);
+  }
+  for (auto &body : m->bodies_) {
+    plugin_manager_.body_states_.Remove(body);
+  }
+  models_by_name_.erase(name);
+  models_by_id_.erase(m->id_);
+  models_.erase(std::find(models_.begin(), models_.end(), m));
+  if (int_marker_manager_) {
+    int_marker_manager_->deleteInteractiveMarker(name);
+  }
+
+  if (model_pool_size_ == 0) {
+    delete m;
+    return;
+  }
+
+  // the models parked from an older version of the file are useless
+  ModelPool &pool = model_pools_[m->yaml_path_];
+  if (pool.mtime != m->yaml_mtime_) {
+    for (Model *parked : pool.models) {
+      delete parked;
     }
+    pool.models.clear();
+    pool.mtime = m->yaml_mtime_;
   }
+  if (pool.models.size() >= model_pool_size_) {
+    delete m;
+    return;
+  }
+  m->Park();
+  pool.models.push_back(m);
+}
 
-  if (!found) {
-    throw Exception("Flatland World: failed to delete model, model with name " +
+void World::MoveModel(const std::string &name, const Pose &pose) {
+  Model *m = GetModel(name);
+  if (m == nullptr) {
+    throw Exception("Flatland World: failed to move model, model with name " +
                     Q(name) + " does not exist");
   }
+  m->SetPose(pose);
+  for (auto &body : m->bodies_) {
+    plugin_manager_.body_states_.Refresh(body);
+  }
 }
 
-void World::MoveModel(const std::string &name, const Pose &pose) {
-  // Find desired model
-  bool found = false;
+void World::SetModelAwake(const std::string &name, bool awake) {
+  Model *m = GetModel(name);
+  if (m == nullptr) {
+    throw Exception(
+        "Flatland World: failed to set model awake, model with name " +
+        Q(name) + " does not exist");
+  }
+  m->SetAwake(awake);
+  for (auto &body : m->bodies_) {
+    plugin_manager_.body_states_.Refresh(body);
+  }
+}
+
+Model *World::GetModel(const std::string &name) {
+  auto it = models_by_name_.find(name);
+  return it != models_by_name_.end() ? it->second : nullptr;
+}
+
+void World::ReloadLayer(const std::string &name, size_t *removed,
+                        size_t *added) {
+  FLATLAND_TRACE("world", "reload_layer");
+  Layer *layer = GetLayer(name);
+  if (layer == nullptr) {
+    throw Exception("Layer " + Q(name) + " does not exist");
+  }
+  if (layer->map_path_.empty()) {
+    throw Exception("Layer " + Q(name) + " has no map to reload");
+  }
+  if (bundle_) {
+    throw Exception("Layer " + Q(name) +
+                    " is loaded from a world bundle and cannot be reloaded");
+  }
+
+  // the new map is loaded into a scratch world, its fixtures are only
+  // compared to the ones of the layer. The layer is declared after the world
+  // so it is destroyed first
+  b2World scratch_world(gravity_);
+  std::unique_ptr<Layer> source(Layer::MakeLayer(
+      &scratch_world, &cfr_, layer->map_path_, layer->names_,
+      layer->body_->GetColor(), layer->body_->properties_));
+  size_t removed_count = 0, added_count = 0;
+  layer->UpdateGeometry(*source, &removed_count, &added_count);
+  layer->PublishGrid(namespace_);
 
-  for (unsigned int i = 0; i < models_.size(); i++) {
-    if (models_[i]->GetName() == name) {
-      // move the model
-      models_[i]->SetPose(pose);
-      found = true;
-      break;
+  ROS_INFO_NAMED("World",
+                 "Layer \"%s\" reloaded, %lu fixtures removed and %lu added",
+                 layer->name_.c_str(), removed_count, added_count);
+  if (removed != nullptr) *removed = removed_count;
+  if (added != nullptr) *added = added_count;
+}
+
+void World::ReloadWatchedLayers() {
+  if (watched_layers_.empty()) {
+    return;
+  }
+  ros::WallTime now = ros::WallTime::now();
+  if (now < next_layer_check_) {
+    return;
+  }
+  next_layer_check_ = now + ros::WallDuration(1.0);
+
+  for (auto &watched : watched_layers_) {
+    std::time_t mtime = LayerFilesTime(watched.first->map_path_);
+    if (mtime == watched.second) {
+      continue;
+    }
+    // a file still being written is loaded again once it is complete
+    watched.second = mtime;
+    try {
+      ReloadLayer(watched.first->name_);
+    } catch (const std::exception &e) {
+      ROS_ERROR_NAMED("World", "Failed to reload layer \"%s\": %s",
+                      watched.first->name_.c_str(), e.what());
     }
   }
+}
 
-  if (!found) {
-    throw Exception("Flatland World: failed to move model, model with name " +
-                    Q(name) + " does not exist");
+Layer *World::GetLayer(const std::string &name) {
+  auto it = layers_by_name_.find(name);
+  return it != layers_by_name_.end() ? it->second : nullptr;
+}
+
+Model *World::GetModelById(uint32_t id) {
+  auto it = models_by_id_.find(id);
+  return it != models_by_id_.end() ? it->second : nullptr;
+}
+
+namespace {
+/**
+ * Finds if a footprint overlaps a fixture in the categories of a mask, for
+ * World::CheckCollisions
+ */
+class FootprintOverlap : public b2QueryCallback {
+ public:
+  const b2Shape *footprint;  ///< the footprint
+  b2Transform transform;     ///< pose of the footprint
+  uint32_t mask;             ///< categories of the fixtures checked
+  bool collides = false;     ///< if a fixture overlaps the footprint
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    if (fixture->IsSensor() ||
+        (fixture->GetFilterData().categoryBits & mask) == 0) {
+      return true;
+    }
+
+    const b2Shape *shape = fixture->GetShape();
+    const b2Transform &xf = fixture->GetBody()->GetTransform();
+    for (int32 i = 0; i < shape->GetChildCount(); i++) {
+      if (b2TestOverlap(footprint, 0, shape, i, transform, xf)) {
+        collides = true;
+        return false;
+      }
+    }
+    return true;
+  }
+};
+};  // namespace
+
+uint32_t World::GetLayerMask(const std::vector<std::string> &layers) const {
+  std::vector<std::string> invalid_layers;
+  uint32_t mask = cfr_.GetCategoryBits(layers, &invalid_layers);
+  if (!invalid_layers.empty()) {
+    throw Exception("Flatland World: layer \"" + invalid_layers[0] +
+                    "\" does not exist");
+  }
+  return mask;
+}
+
+std::vector<uint8_t> World::CheckCollisions(
+    const b2Shape &footprint, const std::vector<std::string> &layers,
+    const std::vector<Pose> &poses) {
+  uint32_t mask = GetLayerMask(layers);
+
+  // the queries only read the Box2D world, which does not change between
+  // steps, so the poses are split among the sensor workers
+  std::vector<uint8_t> collisions(poses.size(), 0);
+  SensorExecutor::Get().ParallelFor(
+      poses.size(), 64, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+          FootprintOverlap overlap;
+          overlap.footprint = &footprint;
+          overlap.transform.Set(b2Vec2(poses[i].x, poses[i].y),
+                                poses[i].theta);
+          overlap.mask = mask;
+
+          b2AABB aabb;
+          footprint.ComputeAABB(&aabb, overlap.transform, 0);
+          physics_world_->QueryAABB(&overlap, aabb);
+          collisions[i] = overlap.collides;
+        }
+      });
+  return collisions;
+}
+
+std::vector<float> World::RaycastBatch(const std::vector<b2Vec2> &origins,
+                                       const std::vector<b2Vec2> &directions,
+                                       float max_range,
+                                       const std::vector<std::string> &layers) {
+  if (origins.size() != directions.size()) {
+    throw Exception("Flatland World: origins and directions of the rays "
+                    "must have the same size");
+  }
+
+  uint32_t mask = GetLayerMask(layers);
+
+  std::vector<b2RayCastInput> inputs(origins.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    b2Vec2 d = directions[i];
+    if (d.Normalize() < b2_epsilon) {
+      throw Exception("Flatland World: direction of ray " +
+                      std::to_string(i) + " is zero");
+    }
+    inputs[i].p1 = origins[i];
+    inputs[i].p2 = origins[i] + max_range * d;
+    inputs[i].maxFraction = 1;
+  }
+
+  // consecutive rays of a request are usually close to each other, so the
+  // packets are contiguous chunks, cast in parallel on the sensor workers
+  std::vector<float> ranges(inputs.size());
+  SensorExecutor::Get().ParallelFor(
+      inputs.size(), 256, [&](unsigned int begin, unsigned int end) {
+        std::vector<PhysicsBackend::RayHit> hits(end - begin);
+        physics_->RayCast(&inputs[begin], end - begin, mask, hits.data());
+        for (unsigned int i = begin; i < end; i++) {
+          const PhysicsBackend::RayHit &hit = hits[i - begin];
+          ranges[i] = hit.body ? hit.fraction * max_range
+                               : std::numeric_limits<float>::infinity();
+        }
+      });
+  return ranges;
+}
+
+WorldSnapshot World::Snapshot() {
+  WorldSnapshot snapshot;
+  snapshot.valid = true;
+
+  for (const auto &model : models_) {
+    WorldSnapshot::ModelState model_state;
+    model_state.name = model->GetName();
+    model_state.yaml_path = model->yaml_path_;
+
+    // the namespace without the prefix added by LoadModel
+    model_state.ns = model->namespace_;
+    if (!namespace_.empty()) {
+      model_state.ns = model_state.ns.length() > namespace_.length()
+                           ? model_state.ns.substr(namespace_.length() + 1)
+                           : "";
+    }
+
+    for (const auto &body : model->bodies_) {
+      const b2Body *b = body->physics_body_;
+      WorldSnapshot::BodyState body_state;
+      body_state.position = b->GetPosition();
+      body_state.angle = b->GetAngle();
+      body_state.linear_velocity = b->GetLinearVelocity();
+      body_state.angular_velocity = b->GetAngularVelocity();
+      body_state.awake = b->IsAwake();
+      model_state.bodies.push_back(body_state);
+    }
+    snapshot.models.push_back(model_state);
+  }
+
+  for (const auto &plugin : plugin_manager_.model_plugins_) {
+    snapshot.plugins.push_back({plugin->GetModel()->GetName(),
+                                plugin->GetName(), plugin->SaveState()});
+  }
+  for (const auto &plugin : plugin_manager_.world_plugins_) {
+    snapshot.plugins.push_back({"", plugin->GetName(), plugin->SaveState()});
+  }
+
+  return snapshot;
+}
+
+void World::Restore(const WorldSnapshot &snapshot) {
+  if (!snapshot.valid) {
+    throw Exception("Flatland World: failed to restore, invalid snapshot");
+  }
+
+  std::map<std::string, const WorldSnapshot::ModelState *> model_states;
+  for (const auto &model_state : snapshot.models) {
+    model_states[model_state.name] = &model_state;
+  }
+
+  // delete the models spawned since the snapshot
+  std::vector<std::string> spawned;
+  for (const auto &model : models_) {
+    if (model_states.count(model->GetName()) == 0) {
+      spawned.push_back(model->GetName());
+    }
+  }
+  {
+    BulkDestroy bulk(physics_world_);
+    for (const auto &name : spawned) {
+      DeleteModel(name);
+    }
   }
+
+  for (const auto &model_state : snapshot.models) {
+    Model *m = GetModel(model_state.name);
+    if (m == nullptr) {
+      // the slow path, for models deleted since the snapshot
+      LoadModel(model_state.yaml_path, model_state.ns, model_state.name,
+                Pose(0, 0, 0));
+      m = models_.back();
+    }
+
+    if (m->bodies_.size() != model_state.bodies.size()) {
+      throw Exception("Flatland World: failed to restore, model " +
+                      Q(model_state.name) + " does not match the snapshot");
+    }
+
+    for (unsigned int i = 0; i < m->bodies_.size(); i++) {
+      const WorldSnapshot::BodyState &s = model_state.bodies[i];
+      b2Body *b = m->bodies_[i]->physics_body_;
+      b->SetTransform(s.position, s.angle);
+      b->SetLinearVelocity(s.linear_velocity);
+      b->SetAngularVelocity(s.angular_velocity);
+      b->SetAwake(s.awake);
+    }
+  }
+  // the bodies may be restored asleep at other poses
+  plugin_manager_.body_states_.Refresh();
+  plugin_manager_.body_states_.moves_++;
+
+  std::map<std::pair<std::string, std::string>,
+           const WorldSnapshot::PluginState *>
+      plugin_states;
+  for (const auto &plugin_state : snapshot.plugins) {
+    plugin_states[std::make_pair(plugin_state.model, plugin_state.name)] =
+        &plugin_state;
+  }
+
+  // the states loaded from a checkpoint are decoded by their plugins
+  auto restore = [](FlatlandPlugin *plugin,
+                    const WorldSnapshot::PluginState *state) {
+    if (state == nullptr) {
+      plugin->RestoreState(boost::any());
+    } else if (state->state.empty() && !state->encoded.empty()) {
+      plugin->RestoreState(plugin->DecodeState(state->encoded));
+    } else {
+      plugin->RestoreState(state->state);
+    }
+  };
+  for (const auto &plugin : plugin_manager_.model_plugins_) {
+    auto key = std::make_pair(plugin->GetModel()->GetName(), plugin->GetName());
+    restore(plugin.get(), plugin_states[key]);
+  }
+  for (const auto &plugin : plugin_manager_.world_plugins_) {
+    restore(plugin.get(),
+            plugin_states[std::make_pair(std::string(), plugin->GetName())]);
+  }
+}
+
+void World::SaveCheckpoint(const std::string &path, const ros::Time &time) {
+  WorldSnapshot snapshot = Snapshot();
+
+  // the states are listed in the order of the plugins by Snapshot
+  size_t i = 0;
+  for (const auto &plugin : plugin_manager_.model_plugins_) {
+    WorldSnapshot::PluginState &state = snapshot.plugins[i++];
+    state.encoded = plugin->EncodeState(state.state);
+  }
+  for (const auto &plugin : plugin_manager_.world_plugins_) {
+    WorldSnapshot::PluginState &state = snapshot.plugins[i++];
+    state.encoded = plugin->EncodeState(state.state);
+  }
+  WorldCheckpoint::Write(path, snapshot, time);
+}
+
+ros::Time World::LoadCheckpoint(const std::string &path) {
+  ros::Time time;
+  Restore(WorldCheckpoint::Read(path, &time));
+  return time;
 }
 
 void World::Pause() { service_paused_ = true; }
@@ -337,7 +1467,8 @@ void World::Resume() { service_paused_ = false; }
 void World::TogglePaused() { service_paused_ = !service_paused_; }
 
 bool World::IsPaused() {
-  return service_paused_ || int_marker_manager_.isManipulating();
+  return service_paused_ ||
+         (int_marker_manager_ && int_marker_manager_->isManipulating());
 }
 
 void World::DebugVisualize(bool update_layers) {
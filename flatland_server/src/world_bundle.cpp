@@ -0,0 +1,370 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 world_bundle.cpp
+ * @brief	 A world resolved into a single binary file
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/image_cache.h>
+#include <flatland_server/layer.h>
+#include <flatland_server/layer_cache.h>
+#include <flatland_server/line_segments_file.h>
+#include <flatland_server/vector_map.h>
+#include <flatland_server/world_bundle.h>
+#include <flatland_server/yaml_reader.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+namespace flatland_server {
+
+namespace {
+const char BUNDLE_MAGIC[8] = {'F', 'L', 'W', 'O', 'R', 'L', 'D', 0};
+const uint32_t BUNDLE_VERSION = 1;
+const size_t BUNDLE_ALIGNMENT = 8;  ///< of the keys and contents
+
+struct BundleHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_count;  ///< followed by as many BundleEntry
+  uint64_t size;         ///< size of the file
+};
+
+struct BundleEntry {
+  uint64_t key_offset;
+  uint64_t key_size;
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+static_assert(sizeof(BundleHeader) == 24, "unexpected header padding");
+static_assert(sizeof(BundleEntry) == 32, "unexpected entry padding");
+
+/**
+ * @return The path, relative to the directory if it is not absolute
+ */
+boost::filesystem::path Resolve(const boost::filesystem::path &dir,
+                                const std::string &path) {
+  if (path.front() == '/') {
+    return boost::filesystem::path(path);
+  }
+  return dir / path;
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (in.fail()) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Extract the geometry of a layer map the way Layer::MakeLayer does
+ * @param[in] reader Reader of the map yaml
+ * @param[in] map_path Path to the map yaml
+ * @return The geometry in the LayerCache format for bitmaps, and in the
+ * LineSegmentsFile format for line segments and vector drawings
+ */
+std::string ExtractGeometry(YamlReader &reader,
+                            const boost::filesystem::path &map_path) {
+  boost::filesystem::path map_dir = map_path.parent_path();
+  std::string type = reader.Get<std::string>("type", "");
+  if (type == "line_segments") {
+    std::string data_path =
+        Resolve(map_dir, reader.Get<std::string>("data")).string();
+    if (LineSegmentsFile::IsBinary(data_path)) {
+      return ReadFile(data_path);
+    }
+    std::vector<LineSegment> line_segments;
+    Layer::ReadLineSegmentsFile(data_path, line_segments);
+    return LineSegmentsFile::Serialize(line_segments);
+  }
+  if (type == "vector") {
+    std::string data_path =
+        Resolve(map_dir, reader.Get<std::string>("data")).string();
+    std::string format = reader.Get<std::string>("format", "");
+    return LineSegmentsFile::Serialize(VectorMap::Load(
+        data_path,
+        format.empty() ? VectorMap::FormatOf(data_path)
+                       : VectorMap::ParseFormat(format),
+        reader.Get<double>("simplify_tolerance", 0)));
+  }
+
+  double resolution = reader.Get<double>("resolution");
+  double occupied_thresh = reader.Get<double>("occupied_thresh");
+  std::string image_path =
+      Resolve(map_dir, reader.Get<std::string>("image")).string();
+  std::shared_ptr<const cv::Mat> bitmap = ImageCache::Get().Load(image_path);
+  if (!bitmap) {
+    throw YAMLException("Failed to load " + Q(image_path));
+  }
+
+  // the bundle is the key of its caches, they are written with key 0
+  std::vector<LayerCache::Run> runs;
+  std::unique_ptr<OccupancyGrid> grid(
+      Layer::ExtractRuns(*bitmap, occupied_thresh, resolution, &runs));
+  return LayerCache::Serialize(0, runs, *grid);
+}
+
+size_t Align(size_t offset) {
+  return (offset + BUNDLE_ALIGNMENT - 1) / BUNDLE_ALIGNMENT * BUNDLE_ALIGNMENT;
+}
+}
+
+const char *WorldBundle::WORLD_KEY = "world";
+
+WorldBundle::~WorldBundle() { Close(); }
+
+void WorldBundle::Close() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  entries_.clear();
+}
+
+bool WorldBundle::IsBundle(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(BUNDLE_MAGIC)];
+  in.read(magic, sizeof(magic));
+  return in.gcount() == sizeof(magic) &&
+         std::memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) == 0;
+}
+
+std::string WorldBundle::MapKey(const std::string &map) { return "map/" + map; }
+
+std::string WorldBundle::GeometryKey(const std::string &map) {
+  return "geometry/" + map;
+}
+
+std::string WorldBundle::ModelKey(const std::string &model) {
+  return "model/" + model;
+}
+
+void WorldBundle::Build(const std::string &world_path,
+                        const std::string &bundle_path) {
+  boost::filesystem::path world_dir =
+      boost::filesystem::path(world_path).parent_path();
+  std::map<std::string, std::string> entries;
+
+  YamlReader world_reader(world_path);
+  entries[WORLD_KEY] = YAML::Dump(world_reader.Node());
+
+  YamlReader layers_reader = world_reader.Subnode("layers", YamlReader::LIST);
+  for (int i = 0; i < layers_reader.NodeSize(); i++) {
+    YamlReader reader = layers_reader.Subnode(i, YamlReader::MAP);
+    std::string map = reader.Get<std::string>("map", "");
+    if (map.empty() || entries.count(MapKey(map))) {
+      continue;
+    }
+    boost::filesystem::path map_path = Resolve(world_dir, map);
+    YamlReader map_reader(map_path.string());
+    map_reader.SetErrorInfo("layer map " + Q(map));
+    entries[MapKey(map)] = YAML::Dump(map_reader.Node());
+    entries[GeometryKey(map)] = ExtractGeometry(map_reader, map_path);
+  }
+
+  YamlReader models_reader =
+      world_reader.SubnodeOpt("models", YamlReader::LIST);
+  for (int i = 0; i < models_reader.NodeSize(); i++) {
+    YamlReader reader = models_reader.Subnode(i, YamlReader::MAP);
+    YamlReader replicate_reader =
+        reader.SubnodeOpt("replicate", YamlReader::MAP);
+    std::string model = replicate_reader.IsNodeNull()
+                            ? reader.Get<std::string>("model")
+                            : replicate_reader.Get<std::string>("model");
+    if (entries.count(ModelKey(model))) {
+      continue;
+    }
+    YamlReader model_reader(Resolve(world_dir, model).string());
+    entries[ModelKey(model)] = YAML::Dump(model_reader.Node());
+  }
+
+  // header, entry table, then the keys and contents, each aligned
+  std::vector<BundleEntry> table(entries.size());
+  size_t offset = sizeof(BundleHeader) + table.size() * sizeof(BundleEntry);
+  size_t i = 0;
+  for (const auto &entry : entries) {
+    offset = Align(offset);
+    table[i].key_offset = offset;
+    table[i].key_size = entry.first.size();
+    offset = Align(offset + entry.first.size());
+    table[i].data_offset = offset;
+    table[i].data_size = entry.second.size();
+    offset += entry.second.size();
+    i++;
+  }
+
+  BundleHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+  header.version = BUNDLE_VERSION;
+  header.entry_count = table.size();
+  header.size = offset;
+
+  std::string content(offset, '\0');
+  std::memcpy(&content[0], &header, sizeof(header));
+  std::memcpy(&content[sizeof(header)], table.data(),
+              table.size() * sizeof(BundleEntry));
+  i = 0;
+  for (const auto &entry : entries) {
+    std::memcpy(&content[table[i].key_offset], entry.first.data(),
+                entry.first.size());
+    std::memcpy(&content[table[i].data_offset], entry.second.data(),
+                entry.second.size());
+    i++;
+  }
+
+  std::string tmp_path = bundle_path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), content.size());
+    if (out.fail()) {
+      out.close();
+      std::remove(tmp_path.c_str());
+      throw Exception("Flatland File: Failed to write " + Q(bundle_path));
+    }
+  }
+  if (std::rename(tmp_path.c_str(), bundle_path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    throw Exception("Flatland File: Failed to write " + Q(bundle_path));
+  }
+}
+
+void WorldBundle::Open(const std::string &path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(BundleHeader)) {
+    close(fd);
+    throw Exception("Flatland File: Invalid world bundle " + Q(path));
+  }
+
+  size_ = st.st_size;
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    size_ = 0;
+    throw Exception("Flatland File: Failed to map " + Q(path));
+  }
+
+  const char *base = static_cast<const char *>(data_);
+  const BundleHeader *header = reinterpret_cast<const BundleHeader *>(base);
+  if (std::memcmp(header->magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0 ||
+      header->size != size_ ||
+      sizeof(BundleHeader) + header->entry_count * sizeof(BundleEntry) >
+          size_) {
+    Close();
+    throw Exception("Flatland File: Invalid world bundle " + Q(path));
+  }
+  if (header->version != BUNDLE_VERSION) {
+    Close();
+    throw Exception("Flatland File: World bundle " + Q(path) +
+                    " has version " + std::to_string(header->version) +
+                    ", expected " + std::to_string(BUNDLE_VERSION) +
+                    ", rebuild it with bundle_world");
+  }
+
+  const BundleEntry *table =
+      reinterpret_cast<const BundleEntry *>(base + sizeof(BundleHeader));
+  for (uint32_t i = 0; i < header->entry_count; i++) {
+    const BundleEntry &entry = table[i];
+    if (entry.key_offset + entry.key_size > size_ ||
+        entry.data_offset + entry.data_size > size_) {
+      Close();
+      throw Exception("Flatland File: Invalid world bundle " + Q(path));
+    }
+    entries_[std::string(base + entry.key_offset, entry.key_size)] =
+        std::make_pair(base + entry.data_offset, size_t(entry.data_size));
+  }
+}
+
+bool WorldBundle::Find(const std::string &key, const char **data,
+                       size_t *size) const {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *data = it->second.first;
+  *size = it->second.second;
+  return true;
+}
+
+bool WorldBundle::FindYaml(const std::string &key, YAML::Node *node) const {
+  const char *data;
+  size_t size;
+  if (!Find(key, &data, &size)) {
+    return false;
+  }
+  *node = YAML::Load(std::string(data, size));
+  return true;
+}
+
+std::vector<std::string> WorldBundle::Keys(const std::string &prefix) const {
+  std::vector<std::string> keys;
+  for (const auto &entry : entries_) {
+    if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+      keys.push_back(entry.first.substr(prefix.size()));
+    }
+  }
+  return keys;
+}
+};  // namespace flatland_server
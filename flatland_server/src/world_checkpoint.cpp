@@ -0,0 +1,162 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 world_checkpoint.cpp
+ * @brief	 The dynamic state of a world saved to a binary file
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/world_checkpoint.h>
+#include <flatland_server/yaml_reader.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace flatland_server {
+
+namespace {
+const char CHECKPOINT_MAGIC[8] = {'F', 'L', 'C', 'K', 'P', 'T', 0, 0};
+const uint32_t CHECKPOINT_VERSION = 1;
+
+// the fewest bytes of the elements, i.e. with empty strings
+const size_t MODEL_MIN_SIZE = 3 * sizeof(uint32_t) + sizeof(uint32_t);
+const size_t BODY_MIN_SIZE =
+    2 * sizeof(b2Vec2) + 2 * sizeof(float) + sizeof(uint8_t);
+const size_t PLUGIN_MIN_SIZE = 3 * sizeof(uint32_t);
+}
+
+void WorldCheckpoint::Write(const std::string &path,
+                            const WorldSnapshot &snapshot,
+                            const ros::Time &time) {
+  CheckpointWriter writer;
+  for (char c : CHECKPOINT_MAGIC) writer.Put(c);
+  writer.Put(CHECKPOINT_VERSION);
+  writer.Put<uint32_t>(time.sec);
+  writer.Put<uint32_t>(time.nsec);
+
+  writer.Put<uint32_t>(snapshot.models.size());
+  for (const auto &model : snapshot.models) {
+    writer.PutString(model.name);
+    writer.PutString(model.ns);
+    writer.PutString(model.yaml_path);
+    writer.Put<uint32_t>(model.bodies.size());
+    for (const auto &body : model.bodies) {
+      writer.Put(body.position);
+      writer.Put(body.angle);
+      writer.Put(body.linear_velocity);
+      writer.Put(body.angular_velocity);
+      writer.Put<uint8_t>(body.awake);
+    }
+  }
+
+  writer.Put<uint32_t>(snapshot.plugins.size());
+  for (const auto &plugin : snapshot.plugins) {
+    writer.PutString(plugin.model);
+    writer.PutString(plugin.name);
+    writer.PutString(plugin.encoded);
+  }
+
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(writer.Data().data(), writer.Data().size());
+    if (out.fail()) {
+      out.close();
+      std::remove(tmp_path.c_str());
+      throw Exception("Flatland File: Failed to write " + Q(path));
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    throw Exception("Flatland File: Failed to write " + Q(path));
+  }
+}
+
+WorldSnapshot WorldCheckpoint::Read(const std::string &path, ros::Time *time) {
+  std::ifstream in(path, std::ios::binary);
+  if (in.fail()) {
+    throw Exception("Flatland File: Failed to load " + Q(path));
+  }
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+
+  WorldSnapshot snapshot;
+  try {
+    CheckpointReader reader(data);
+    for (char c : CHECKPOINT_MAGIC) {
+      if (reader.Get<char>() != c) {
+        throw Exception("Flatland File: Invalid world checkpoint");
+      }
+    }
+    if (reader.Get<uint32_t>() != CHECKPOINT_VERSION) {
+      throw Exception("Flatland File: Unsupported world checkpoint version");
+    }
+    time->sec = reader.Get<uint32_t>();
+    time->nsec = reader.Get<uint32_t>();
+
+    snapshot.models.resize(reader.GetCount(MODEL_MIN_SIZE));
+    for (auto &model : snapshot.models) {
+      model.name = reader.GetString();
+      model.ns = reader.GetString();
+      model.yaml_path = reader.GetString();
+      model.bodies.resize(reader.GetCount(BODY_MIN_SIZE));
+      for (auto &body : model.bodies) {
+        body.position = reader.Get<b2Vec2>();
+        body.angle = reader.Get<float>();
+        body.linear_velocity = reader.Get<b2Vec2>();
+        body.angular_velocity = reader.Get<float>();
+        body.awake = reader.Get<uint8_t>() != 0;
+      }
+    }
+
+    snapshot.plugins.resize(reader.GetCount(PLUGIN_MIN_SIZE));
+    for (auto &plugin : snapshot.plugins) {
+      plugin.model = reader.GetString();
+      plugin.name = reader.GetString();
+      plugin.encoded = reader.GetString();
+    }
+  } catch (const Exception &e) {
+    throw Exception(std::string(e.what()) + " in " + Q(path));
+  }
+  snapshot.valid = true;
+  return snapshot;
+}
+};  // namespace flatland_server
@@ -60,6 +60,7 @@ void WorldPlugin::Initialize(World *world, std::string name, std::string type,
   type_ = type;
   world_config_ = world_config;
   plugin_type_ = PluginType::World;
+  nh_ = ros::NodeHandle(world->namespace_);
   OnInitialize(plugin_reader);
 }
 }
\ No newline at end of file
@@ -51,28 +51,145 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace flatland_server {
 
+namespace {
+/// results of the pure expressions by expression, for all LuaEvaluators
+std::unordered_map<std::string, std::string> pure_results;
+std::mutex pure_results_mutex;  ///< guards pure_results
+const size_t kMaxPureResults = 10000;  ///< bound of pure_results
+
+/**
+ * @return true if the result of the expression depends only on its text, it
+ * is false for expressions that look up parameters, the environment, the
+ * time, random numbers or files
+ */
+bool IsPure(const std::string &expression) {
+  static const char *impure[] = {"env",     "param",  "os.",      "io.",
+                                 "random",  "require", "dofile",  "load",
+                                 "_G",      "getfenv", "setfenv", "debug.",
+                                 "package.", "rawset",  "collectgarbage"};
+  for (const char *name : impure) {
+    if (expression.find(name) != std::string::npos) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Give the function at the top of the stack a fresh environment that
+ * reads through to the globals, so that the globals it sets stay its own
+ */
+void SetIsolatedEnvironment(lua_State *L) {
+  lua_newtable(L);  // the environment
+  lua_newtable(L);  // its metatable
+#if LUA_VERSION_NUM >= 502
+  lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+  lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+  lua_setfield(L, -2, "__index");
+  lua_setmetatable(L, -2);
+#if LUA_VERSION_NUM >= 502
+  lua_setupvalue(L, -2, 1);  // _ENV of the chunk
+#else
+  lua_setfenv(L, -2);
+#endif
+}
+}
+
+YamlPreprocessor::LuaEvaluator::LuaEvaluator() {
+  L_ = luaL_newstate();
+  luaL_openlibs(L_);
+  lua_pushcfunction(L_, YamlPreprocessor::LuaGetEnv);
+  lua_setglobal(L_, "env");
+  lua_pushcfunction(L_, YamlPreprocessor::LuaGetParam);
+  lua_setglobal(L_, "param");
+}
+
+YamlPreprocessor::LuaEvaluator::~LuaEvaluator() { lua_close(L_); }
+
+bool YamlPreprocessor::LuaEvaluator::Evaluate(const std::string &expression,
+                                              std::string *result) {
+  bool pure = IsPure(expression);
+  if (pure) {
+    std::lock_guard<std::mutex> lock(pure_results_mutex);
+    auto it = pure_results.find(expression);
+    if (it != pure_results.end()) {
+      *result = it->second;
+      return true;
+    }
+  }
+
+  int top = lua_gettop(L_);
+  auto chunk = chunks_.find(expression);
+  if (chunk == chunks_.end()) {
+    if (luaL_loadstring(L_, expression.c_str())) {
+      ROS_ERROR_STREAM(lua_tostring(L_, -1));
+      lua_settop(L_, top);
+      return false;
+    }
+    chunk = chunks_.emplace(expression, luaL_ref(L_, LUA_REGISTRYINDEX)).first;
+  }
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, chunk->second);
+  SetIsolatedEnvironment(L_);
+
+  if (lua_pcall(L_, 0, 1, 0)) {
+    ROS_ERROR_STREAM(lua_tostring(L_, -1));
+    lua_settop(L_, top);
+    return false;
+  }
+
+  bool ok = true;
+  int t = lua_type(L_, -1);
+  if (t == LUA_TNIL) {
+    *result = "";
+  } else if (t == LUA_TBOOLEAN) {
+    *result = lua_toboolean(L_, -1) ? "true" : "false";
+  } else if (t == LUA_TSTRING || t == LUA_TNUMBER) {
+    *result = lua_tostring(L_, -1);
+  } else {
+    ok = false;
+  }
+  lua_settop(L_, top);
+
+  if (ok && pure) {
+    std::lock_guard<std::mutex> lock(pure_results_mutex);
+    if (pure_results.size() < kMaxPureResults) {
+      pure_results[expression] = *result;
+    }
+  }
+  return ok;
+}
+
 void YamlPreprocessor::Parse(YAML::Node &node) {
-  YamlPreprocessor::ProcessNodes(node);
+  LuaEvaluator lua;  // one state for the whole pass
+  YamlPreprocessor::ProcessNodes(node, lua);
 }
 
 void YamlPreprocessor::ProcessNodes(YAML::Node &node) {
+  LuaEvaluator lua;
+  YamlPreprocessor::ProcessNodes(node, lua);
+}
+
+void YamlPreprocessor::ProcessNodes(YAML::Node &node, LuaEvaluator &lua) {
   switch (node.Type()) {
     case YAML::NodeType::Sequence:
       for (YAML::Node child : node) {
-        YamlPreprocessor::ProcessNodes(child);
+        YamlPreprocessor::ProcessNodes(child, lua);
       }
       break;
     case YAML::NodeType::Map:
       for (YAML::iterator it = node.begin(); it != node.end(); ++it) {
-        YamlPreprocessor::ProcessNodes(it->second);
+        YamlPreprocessor::ProcessNodes(it->second, lua);
       }
       break;
     case YAML::NodeType::Scalar:
       if (node.as<std::string>().compare(0, 5, "$eval") == 0) {
-        ProcessScalarNode(node);
+        ProcessScalarNode(node, lua);
       }
       break;
     default:
@@ -83,44 +200,26 @@ void YamlPreprocessor::ProcessNodes(YAML::Node &node) {
 }
 
 void YamlPreprocessor::ProcessScalarNode(YAML::Node &node) {
+  LuaEvaluator lua;
+  YamlPreprocessor::ProcessScalarNode(node, lua);
+}
+
+void YamlPreprocessor::ProcessScalarNode(YAML::Node &node, LuaEvaluator &lua) {
   std::string value = node.as<std::string>().substr(5);  // omit the $parse
   boost::algorithm::trim(value);                         // trim whitespace
-  ROS_INFO_STREAM("Attempting to parse lua " << value);
+  ROS_DEBUG_STREAM("Attempting to parse lua " << value);
 
   if (value.find("return ") == std::string::npos) {  // Has no return statement
     value = "return " + value;
   }
 
-  // Create the Lua context
-  lua_State *L = luaL_newstate();
-  luaL_openlibs(L);
-  lua_pushcfunction(L, YamlPreprocessor::LuaGetEnv);
-  lua_setglobal(L, "env");
-  lua_pushcfunction(L, YamlPreprocessor::LuaGetParam);
-  lua_setglobal(L, "param");
-
   try { /* Attempt to run the Lua string and parse its results */
-    int error = luaL_dostring(L, value.c_str());
-    if (error) {
-      ROS_ERROR_STREAM(lua_tostring(L, -1));
-      lua_pop(L, 1); /* pop error message from the stack */
+    std::string result;
+    if (lua.Evaluate(value, &result)) {
+      ROS_DEBUG_STREAM("Preprocessor parsed " << value << " as " << result);
+      node = result;
     } else {
-      int t = lua_type(L, 1);
-      if (t == LUA_TNIL) {
-        node = "";
-        ROS_INFO_STREAM("Preprocessor parsed " << value << " as empty string");
-      } else if (t == LUA_TBOOLEAN) {
-        ROS_INFO_STREAM("Preprocessor parsed "
-                        << value << " as bool "
-                        << (lua_toboolean(L, 1) ? "true" : "false"));
-        node = lua_toboolean(L, 1) ? "true" : "false";
-      } else if (t == LUA_TSTRING || t == LUA_TNUMBER) {
-        ROS_INFO_STREAM("Preprocessor parsed " << value << " as "
-                                               << lua_tostring(L, 1));
-        node = lua_tostring(L, 1);
-      } else {
-        ROS_ERROR_STREAM("No lua output for " << value);
-      }
+      ROS_ERROR_STREAM("No lua output for " << value);
     }
   } catch (
       ...) { /* Something went wrong parsing the lua, or gettings its results */
@@ -177,11 +276,15 @@ int YamlPreprocessor::LuaGetEnv(lua_State *L) {
 
 int YamlPreprocessor::LuaGetParam(lua_State *L) {
   const char *name = lua_tostring(L, 1);
-  std::string param_s;
-  double param_d;
-  bool param_b;
 
-  if (lua_gettop(L) == 2 && !ros::param::has(name)) {  // use default
+  // one lookup through the cache of roscpp, which subscribes to the
+  // parameter so that only the first lookup in the process goes to the
+  // parameter server, and keeps it current. Model files spawned many times
+  // would otherwise make blocking calls for every param() of every spawn
+  XmlRpc::XmlRpcValue value;
+  bool found = ros::param::getCached(name, value);
+
+  if (lua_gettop(L) == 2 && !found) {  // use default
     if (lua_isnumber(L, 2)) {
       lua_pushnumber(L, lua_tonumber(L, 2));
     } else if (lua_isboolean(L, 2)) {
@@ -193,23 +296,21 @@ int YamlPreprocessor::LuaGetParam(lua_State *L) {
                       << name);
       lua_pushnil(L);
     }
-  } else {                         // no default
-    if (!ros::param::has(name)) {  // Push back a nil
-      ROS_WARN_STREAM("No rosparam found for: " << name);
-      lua_pushnil(L);
-    } else {
-      if (ros::param::get(name, param_d)) {
-        lua_pushnumber(L, param_d);
-      } else if (ros::param::get(name, param_s)) {
-        lua_pushstring(L, param_s.c_str());
-      } else if (ros::param::get(name, param_b)) {
-        lua_pushstring(L, param_b ? "true" : "false");
-      } else {
-        ROS_WARN_STREAM("Couldn't load int/double/string value at param "
-                        << name);
-        lua_pushnil(L);
-      }
-    }
+  } else if (!found) {  // no default, push back a nil
+    ROS_WARN_STREAM("No rosparam found for: " << name);
+    lua_pushnil(L);
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+    lua_pushnumber(L, static_cast<double>(value));
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+    lua_pushnumber(L, static_cast<int>(value));
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeString) {
+    lua_pushstring(L, static_cast<std::string>(value).c_str());
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeBoolean) {
+    lua_pushstring(L, static_cast<bool>(value) ? "true" : "false");
+  } else {
+    ROS_WARN_STREAM("Couldn't load int/double/string value at param "
+                    << name);
+    lua_pushnil(L);
   }
 
   return 1;  // 1 return value
@@ -44,6 +44,7 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_server/tracer.h>
 #include <flatland_server/yaml_preprocessor.h>
 #include <flatland_server/yaml_reader.h>
 #include <boost/filesystem/path.hpp>
@@ -61,7 +62,11 @@ YamlReader::YamlReader(const YAML::Node &node) : node_(node) {
 
 YamlReader::YamlReader(const std::string &path) {
   try {
-    node_ = YAML::LoadFile(path);
+    {
+      FLATLAND_TRACE("load", "yaml_parse");
+      node_ = YAML::LoadFile(path);
+    }
+    FLATLAND_TRACE("load", "yaml_preprocess");
     YamlPreprocessor::Parse(node_);
   } catch (const YAML::BadFile &e) {
     throw YAMLException("File does not exist, path=" + Q(path));
@@ -0,0 +1,104 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 alloc_counter_test.cpp
+ * @brief	 Tests for the allocation counter
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/alloc_counter.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace flatland_server;
+
+// Allocations are only counted within a scope, with the counting compiled in
+TEST(AllocCounterTest, counts_allocations_in_scope) {
+  AllocCounter::Counts before = AllocCounter::Get();
+  std::unique_ptr<std::vector<int>> outside(new std::vector<int>(16));
+  AllocCounter::Counts after = AllocCounter::Get();
+  EXPECT_EQ(after.allocations, before.allocations);
+
+  AllocCounter::Counts counts;
+  {
+    AllocCounter::Scope scope("counts_allocations_in_scope");
+    std::unique_ptr<std::vector<int>> inside(new std::vector<int>(16));
+    counts = scope.GetCounts();
+  }
+  if (AllocCounter::IsEnabled()) {
+    // the compiler may merge or elide some allocations
+    EXPECT_GE(counts.allocations, 1u);
+    EXPECT_GE(counts.bytes, 16 * sizeof(int));
+  } else {
+    EXPECT_EQ(counts.allocations, 0u);
+    EXPECT_EQ(counts.bytes, 0u);
+  }
+}
+
+// The allocations of other threads are counted while a scope is alive
+TEST(AllocCounterTest, counts_other_threads) {
+  // the thread is started before the scope, which would count its state
+  std::atomic<bool> go(false);
+  std::thread thread([&go] {
+    while (!go) {
+      std::this_thread::yield();
+    }
+    std::unique_ptr<std::vector<int>> values(new std::vector<int>(16));
+  });
+
+  AllocCounter::Scope scope("counts_other_threads");
+  go = true;
+  thread.join();
+  if (AllocCounter::IsEnabled()) {
+    EXPECT_GE(scope.GetCounts().allocations, 1u);
+  } else {
+    EXPECT_EQ(scope.GetCounts().allocations, 0u);
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 body_states_test.cpp
+ * @brief	 Test the contiguous snapshot of the body states
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace flatland_server;
+
+class BodyStatesTest : public ::testing::Test {
+ public:
+  b2World world;
+  BodyStates states;
+
+  BodyStatesTest() : world(b2Vec2(0, 0)) {}
+
+  Body *MakeBody(const Pose &pose) {
+    return new Body(&world, nullptr, "body", Color(1, 1, 1, 1), pose,
+                    b2_dynamicBody, YAML::Node());
+  }
+};
+
+// Test the states are read on add and refresh
+TEST_F(BodyStatesTest, refresh) {
+  Body *body = MakeBody(Pose(1, 2, 0.5));
+  states.Add(body);
+  ASSERT_EQ(states.Size(), 1u);
+  EXPECT_EQ(body->state_index_, 0);
+  EXPECT_FLOAT_EQ(states.x_[0], 1);
+  EXPECT_FLOAT_EQ(states.y_[0], 2);
+  EXPECT_FLOAT_EQ(states.angle_[0], 0.5);
+  EXPECT_FLOAT_EQ(states.cos_[0], std::cos(0.5));
+  EXPECT_FLOAT_EQ(states.sin_[0], std::sin(0.5));
+
+  // changes to the Box2D body are only seen after a refresh
+  body->physics_body_->SetLinearVelocity(b2Vec2(3, 0));
+  body->physics_body_->SetAngularVelocity(1);
+  world.Step(0.1, 1, 1);
+  EXPECT_FLOAT_EQ(states.GetPose(body).x, 1);
+  EXPECT_FLOAT_EQ(states.GetLinearVelocity(body).x, 0);
+
+  states.Refresh();
+  b2Transform t = body->physics_body_->GetTransform();
+  EXPECT_FLOAT_EQ(states.GetPose(body).x, t.p.x);
+  EXPECT_FLOAT_EQ(states.GetPose(body).theta, body->physics_body_->GetAngle());
+  EXPECT_FLOAT_EQ(states.GetTransform(body).q.s, t.q.s);
+  EXPECT_FLOAT_EQ(states.GetLinearVelocity(body).x, 3);
+  EXPECT_FLOAT_EQ(states.GetAngularVelocity(body), 1);
+
+  states.Remove(body);
+  delete body;
+}
+
+// Test removing a body keeps the arrays contiguous
+TEST_F(BodyStatesTest, remove) {
+  Body *a = MakeBody(Pose(1, 0, 0));
+  Body *b = MakeBody(Pose(2, 0, 0));
+  Body *c = MakeBody(Pose(3, 0, 0));
+  states.Add(a);
+  states.Add(b);
+  states.Add(c);
+
+  states.Remove(a);
+  ASSERT_EQ(states.Size(), 2u);
+  EXPECT_EQ(a->state_index_, -1);
+  EXPECT_EQ(c->state_index_, 0);
+  EXPECT_EQ(states.bodies_[0], c);
+  EXPECT_FLOAT_EQ(states.x_[0], 3);
+  EXPECT_FLOAT_EQ(states.x_[1], 2);
+
+  // a body not added is read from Box2D, removing it does nothing
+  a->physics_body_->SetTransform(b2Vec2(4, 0), 0);
+  EXPECT_FLOAT_EQ(states.GetPose(a).x, 4);
+  states.Remove(a);
+  EXPECT_EQ(states.Size(), 2u);
+
+  // a body of another instance is not mistaken for this one's
+  BodyStates other;
+  other.Add(a);
+  EXPECT_EQ(a->state_index_, 0);
+  c->physics_body_->SetTransform(b2Vec2(5, 0), 0);
+  states.Refresh(a);
+  EXPECT_FLOAT_EQ(states.x_[0], 3);
+  states.Refresh(c);
+  EXPECT_FLOAT_EQ(states.x_[0], 5);
+
+  delete a;
+  delete b;
+  delete c;
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
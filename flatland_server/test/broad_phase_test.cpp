@@ -0,0 +1,633 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 broad_phase_test.cpp
+ * @brief	 Test the static tree of the Box2D broad-phase
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <set>
+#include <vector>
+
+/**
+ * Collects the fixtures reported by a query or the closest of a ray cast
+ */
+class FixtureCollector : public b2QueryCallback, public b2RayCastCallback {
+ public:
+  std::set<b2Fixture *> fixtures;  ///< fixtures of the query or ray cast
+  b2Fixture *closest = nullptr;    ///< closest fixture of the ray cast
+  float32 fraction = 1;            ///< fraction of the closest fixture
+  bool stop = false;               ///< terminate at the first fixture
+
+  bool ReportFixture(b2Fixture *fixture) override {
+    fixtures.insert(fixture);
+    return !stop;
+  }
+
+  float32 ReportFixture(b2Fixture *fixture, const b2Vec2 &point,
+                        const b2Vec2 &normal, float32 fraction) override {
+    fixtures.insert(fixture);
+    if (stop) {
+      return 0;
+    }
+    closest = fixture;
+    this->fraction = fraction;
+    return fraction;
+  }
+};
+
+class BroadPhaseTest : public ::testing::Test {
+ public:
+  b2World world;
+  b2Body *walls;  ///< static body with a grid of edges
+  b2Body *ball;   ///< dynamic circle in the grid
+
+  BroadPhaseTest() : world(b2Vec2(0, 0)) {
+    b2BodyDef walls_def;
+    walls = world.CreateBody(&walls_def);
+    b2EdgeShape edge;
+    for (int i = 0; i < 2000; i++) {
+      float32 x = (i % 50) * 2, y = (i / 50) * 2;
+      edge.Set(b2Vec2(x, y), b2Vec2(x + 1, y));
+      walls->CreateFixture(&edge, 0);
+    }
+
+    b2BodyDef ball_def;
+    ball_def.type = b2_dynamicBody;
+    ball_def.position.Set(10.5, 10.5);
+    ball = world.CreateBody(&ball_def);
+    b2CircleShape circle;
+    circle.m_radius = 0.25;
+    ball->CreateFixture(&circle, 1);
+  }
+};
+
+// Test the static edges are kept in their own balanced tree
+TEST_F(BroadPhaseTest, static_tree) {
+  EXPECT_EQ(world.GetProxyCount(), 2001);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2000);
+  EXPECT_EQ(world.GetTreeHeight(), 0);
+
+  // the step rebuilds the static tree after the bulk insertion
+  world.Step(1.0 / 60, 10, 10);
+  EXPECT_LE(world.GetStaticTreeHeight(), std::ceil(std::log2(2000)));
+
+  // a few more edges do not trigger a rebuild, but are found
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(10, 11), b2Vec2(11, 11));
+  b2Fixture *added = walls->CreateFixture(&edge, 0);
+  world.Step(1.0 / 60, 10, 10);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2001);
+
+  FixtureCollector query;
+  b2AABB aabb;
+  aabb.lowerBound.Set(10, 10);
+  aabb.upperBound.Set(11, 11);
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.count(added), 1u);
+  EXPECT_EQ(query.fixtures.count(ball->GetFixtureList()), 1u);
+  EXPECT_EQ(query.fixtures.size(), 3u);  // and the edge at y = 10
+}
+
+// Test the ball collides with the static edges
+TEST_F(BroadPhaseTest, static_contacts) {
+  ball->SetLinearVelocity(b2Vec2(0, -1));
+  for (int i = 0; i < 60; i++) {
+    world.Step(1.0 / 60, 10, 10);
+  }
+  EXPECT_GT(world.GetContactCount(), 0);
+  EXPECT_GE(ball->GetPosition().y, 10.25 - b2_linearSlop * 2);
+}
+
+// Test ray casts clip the ray across both trees
+TEST_F(BroadPhaseTest, ray_cast) {
+  // the ball is closer than the edge at y = 10
+  FixtureCollector ray;
+  world.RayCast(&ray, b2Vec2(10.5, 11.9), b2Vec2(10.5, 9));
+  EXPECT_EQ(ray.closest, ball->GetFixtureList());
+  EXPECT_NEAR(ray.fraction, 1.15 / 2.9, 1e-5);
+
+  // the edge at y = 12 is closer than the ball
+  ray = FixtureCollector();
+  world.RayCast(&ray, b2Vec2(10.5, 13), b2Vec2(10.5, 10.4));
+  ASSERT_TRUE(ray.closest != nullptr);
+  EXPECT_EQ(ray.closest->GetBody(), walls);
+  EXPECT_NEAR(ray.fraction, 1 / 2.6, 1e-5);
+
+  // terminating the ray cast in one tree skips the other
+  ray = FixtureCollector();
+  ray.stop = true;
+  world.RayCast(&ray, b2Vec2(10.5, 13), b2Vec2(10.5, 9));
+  EXPECT_EQ(ray.fixtures.size(), 1u);
+}
+
+// Test bodies changing from and to static move their proxies between trees
+TEST_F(BroadPhaseTest, set_type) {
+  ball->SetType(b2_staticBody);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2001);
+  ball->SetType(b2_dynamicBody);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2000);
+
+  walls->SetType(b2_kinematicBody);
+  EXPECT_EQ(world.GetStaticProxyCount(), 0);
+  EXPECT_EQ(world.GetProxyCount(), 2001);
+  world.Step(1.0 / 60, 10, 10);
+  walls->SetType(b2_staticBody);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2000);
+}
+
+// Test fixtures created in bulk are inserted when the bulk ends
+TEST_F(BroadPhaseTest, static_bulk) {
+  world.Step(1.0 / 60, 10, 10);
+  b2AABB aabb;
+  aabb.lowerBound.Set(200, 200);
+  aabb.upperBound.Set(300, 300);
+
+  // few fixtures compared to the tree are inserted one by one
+  world.BeginStaticBulk();
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(200, 200), b2Vec2(201, 200));
+  walls->CreateFixture(&edge, 0);
+  FixtureCollector query;
+  world.QueryAABB(&query, aabb);
+  EXPECT_TRUE(query.fixtures.empty());
+  world.EndStaticBulk();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 1u);
+
+  // nested bulks build the tree once at the end, in one pass
+  b2BodyDef body_def;
+  b2Body *more = world.CreateBody(&body_def);
+  world.BeginStaticBulk();
+  world.BeginStaticBulk();
+  for (int i = 0; i < 3000; i++) {
+    edge.Set(b2Vec2(200 + i % 50, 210 + i / 50), b2Vec2(200.5 + i % 50, 210));
+    more->CreateFixture(&edge, 0);
+  }
+  world.EndStaticBulk();
+  query = FixtureCollector();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 1u);
+  world.EndStaticBulk();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 3001u);
+  EXPECT_EQ(world.GetStaticProxyCount(), 5001);
+  EXPECT_LE(world.GetStaticTreeHeight(), std::ceil(std::log2(5001)));
+
+  // stepping during a bulk inserts and removes the pending proxies
+  world.BeginStaticBulk();
+  b2Body *last = world.CreateBody(&body_def);
+  last->CreateFixture(&edge, 0);
+  world.DestroyBody(more);
+  world.Step(1.0 / 60, 10, 10);
+  query = FixtureCollector();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 2u);
+  world.EndStaticBulk();
+  EXPECT_EQ(world.GetStaticProxyCount(), 2002);
+}
+
+// Test fixtures destroyed in bulk are removed when the bulk ends, and are not
+// found by queries and ray casts before
+TEST_F(BroadPhaseTest, static_bulk_destroy) {
+  world.Step(1.0 / 60, 10, 10);
+  b2BodyDef body_def;
+  b2Body *more = world.CreateBody(&body_def);
+  b2EdgeShape edge;
+  for (int i = 0; i < 100; i++) {
+    edge.Set(b2Vec2(10 + i * 0.01, 10.75), b2Vec2(10 + i * 0.01, 10.8));
+    more->CreateFixture(&edge, 0);
+  }
+  world.Step(1.0 / 60, 10, 10);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2100);
+
+  // a pending proxy destroyed before it was inserted is freed as well
+  world.BeginStaticBulk();
+  edge.Set(b2Vec2(10, 10.9), b2Vec2(11, 10.9));
+  more->CreateFixture(&edge, 0);
+  world.DestroyBody(more);
+  EXPECT_EQ(world.GetStaticProxyCount(), 2000);
+  FixtureCollector query;
+  b2AABB aabb;
+  aabb.lowerBound.Set(10, 10);
+  aabb.upperBound.Set(11, 11);
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 2u);  // the ball and the edge at y = 10
+  FixtureCollector ray;
+  world.RayCast(&ray, b2Vec2(10.05, 10.85), b2Vec2(10.05, 10.7));
+  EXPECT_TRUE(ray.fixtures.empty());
+  std::vector<b2RayCastInput> inputs(1);
+  inputs[0].p1.Set(10.05, 10.85);
+  inputs[0].p2.Set(10.05, 9.5);
+  inputs[0].maxFraction = 1;
+  b2RayBatchHit hit;
+  b2RayBatchFilter all;
+  world.RayCastBatch(inputs.data(), 1, all, &hit);
+  ASSERT_TRUE(hit.fixture != nullptr);
+  EXPECT_EQ(hit.fixture->GetBody(), walls);
+  world.EndStaticBulk();
+
+  // few destroyed proxies compared to the tree are removed one by one
+  EXPECT_EQ(world.GetStaticProxyCount(), 2000);
+  query = FixtureCollector();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 2u);
+
+  // destroying all static bodies in bulk leaves an empty tree
+  world.BeginStaticBulk();
+  world.DestroyBody(walls);
+  world.EndStaticBulk();
+  EXPECT_EQ(world.GetStaticProxyCount(), 0);
+  EXPECT_EQ(world.GetStaticTreeHeight(), 0);
+  EXPECT_EQ(world.GetProxyCount(), 1);
+  query = FixtureCollector();
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 1u);
+  world.Step(1.0 / 60, 10, 10);
+}
+
+// Test destroying many dynamic bodies in bulk, they are skipped until the
+// bulk ends and removed from the tree in one pass
+TEST_F(BroadPhaseTest, bulk_destroy) {
+  std::vector<b2Body *> fleet;
+  b2BodyDef def;
+  def.type = b2_dynamicBody;
+  b2CircleShape circle;
+  circle.m_radius = 0.25;
+  for (int i = 0; i < 100; i++) {
+    def.position.Set(10.5 + i % 10, 12.5 + i / 10);
+    fleet.push_back(world.CreateBody(&def));
+    fleet.back()->CreateFixture(&circle, 1);
+  }
+  world.Step(1.0 / 60, 10, 10);
+  EXPECT_EQ(world.GetProxyCount(), 2101);
+
+  // a few destroyed bodies are removed one by one
+  b2AABB aabb;
+  aabb.lowerBound.Set(10, 12);
+  aabb.upperBound.Set(11, 13);
+  world.BeginBulkDestroy();
+  world.DestroyBody(fleet[0]);
+  FixtureCollector query;
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.size(), 1u);  // the edge at y = 12
+  world.EndBulkDestroy();
+  EXPECT_EQ(world.GetProxyCount(), 2100);
+
+  // most of them rebuild the tree, while ray casts and queries skip them
+  world.BeginBulkDestroy();
+  for (int i = 1; i < 99; i++) {
+    world.DestroyBody(fleet[i]);
+  }
+  FixtureCollector ray;
+  world.RayCast(&ray, b2Vec2(9.9, 13.5), b2Vec2(20, 13.5));
+  EXPECT_TRUE(ray.fixtures.empty());
+  std::vector<b2RayCastInput> inputs(1);
+  inputs[0].p1.Set(9.9, 13.5);
+  inputs[0].p2.Set(20, 13.5);
+  inputs[0].maxFraction = 1;
+  b2RayBatchHit hit;
+  b2RayBatchFilter all;
+  world.RayCastBatch(inputs.data(), 1, all, &hit);
+  EXPECT_TRUE(hit.fixture == nullptr);
+  world.EndBulkDestroy();
+  EXPECT_EQ(world.GetProxyCount(), 2002);
+  EXPECT_LE(world.GetTreeHeight(), 1);
+
+  // the remaining bodies are still found and collide
+  query = FixtureCollector();
+  aabb.lowerBound.Set(19, 21);
+  aabb.upperBound.Set(20, 22);
+  world.QueryAABB(&query, aabb);
+  EXPECT_EQ(query.fixtures.count(fleet[99]->GetFixtureList()), 1u);
+  fleet[99]->SetTransform(b2Vec2(20.5, 21.5), 0);
+  fleet[99]->SetLinearVelocity(b2Vec2(0, -60));
+  for (int i = 0; i < 60 && world.GetContactCount() == 0; i++) {
+    world.Step(1.0 / 60, 10, 10);
+  }
+  EXPECT_GT(world.GetContactCount(), 0);
+}
+
+// Test the batch ray cast finds the closest hit of each ray, filtered
+TEST_F(BroadPhaseTest, ray_cast_batch) {
+  world.Step(1.0 / 60, 10, 10);
+  b2Filter filter;
+  filter.categoryBits = 0x2;
+  ball->GetFixtureList()->SetFilterData(filter);
+
+  const int count = 360;
+  std::vector<b2RayCastInput> inputs(count);
+  for (int i = 0; i < count; i++) {
+    float32 angle = i * 2 * b2_pi / count;
+    inputs[i].p1.Set(11.5, 11.5);
+    inputs[i].p2 = inputs[i].p1 + 5 * b2Vec2(std::cos(angle), std::sin(angle));
+    inputs[i].maxFraction = i % 2 ? 1 : 0.5;
+  }
+
+  std::vector<b2RayBatchHit> hits(count);
+  b2RayBatchFilter all;
+  world.RayCastBatch(inputs.data(), count, all, hits.data());
+  int hit_count = 0;
+  for (int i = 0; i < count; i++) {
+    FixtureCollector ray;
+    b2Vec2 p2 = inputs[i].p1 +
+                inputs[i].maxFraction * (inputs[i].p2 - inputs[i].p1);
+    world.RayCast(&ray, inputs[i].p1, p2);
+    EXPECT_EQ(hits[i].fixture, ray.closest) << "ray " << i;
+    if (ray.closest) {
+      EXPECT_NEAR(hits[i].fraction, ray.fraction * inputs[i].maxFraction,
+                  1e-5);
+      hit_count++;
+    }
+  }
+  EXPECT_GT(hit_count, 0);
+  EXPECT_LT(hit_count, count);
+
+  // the ball is not in the mask, the edges are on an ignored body
+  b2RayBatchFilter walls_only;
+  walls_only.maskBits = 0x1;
+  b2RayBatchFilter ball_only;
+  const b2Body *ignored[] = {walls};
+  ball_only.ignoredBodies = ignored;
+  ball_only.ignoredBodyCount = 1;
+  b2RayCastInput down;
+  down.p1.Set(10.5, 11.9);
+  down.p2.Set(10.5, 9);
+  down.maxFraction = 1;
+  b2RayBatchHit hit;
+  world.RayCastBatch(&down, 1, all, &hit);
+  EXPECT_EQ(hit.fixture, ball->GetFixtureList());
+  world.RayCastBatch(&down, 1, walls_only, &hit);
+  ASSERT_TRUE(hit.fixture != nullptr);
+  EXPECT_EQ(hit.fixture->GetBody(), walls);
+  EXPECT_NEAR(hit.fraction, 1.9 / 2.9, 1e-5);
+  down.p1.Set(12.5, 11.9);
+  down.p2.Set(12.5, 9);
+  world.RayCastBatch(&down, 1, ball_only, &hit);
+  EXPECT_TRUE(hit.fixture == nullptr);
+  EXPECT_EQ(hit.fraction, 1);
+}
+
+/**
+ * Collects the leaves reported by a packet ray cast of a tree
+ */
+struct PacketCollector {
+  std::set<int32> proxies;  ///< leaves overlapped by a ray
+
+  void RayCastPacketCallback(int32 proxyId, const int32 *rays,
+                             int32 rayCount) {
+    proxies.insert(proxyId);
+  }
+};
+
+// Test the packet ray cast skips the subtrees that no proxy passes the filter
+TEST(DynamicTreeTest, ray_cast_packet_filter) {
+  b2DynamicTree tree;
+  std::vector<int32> proxies;
+  for (int i = 0; i < 100; i++) {
+    b2AABB aabb;
+    aabb.lowerBound.Set(i, 0);
+    aabb.upperBound.Set(i + 0.5, 1);
+    int32 id = tree.CreateProxy(aabb, nullptr);
+    tree.SetProxyFilter(id, i < 50 ? 0x1 : 0x2, i % 10 == 0);
+    proxies.push_back(id);
+  }
+  tree.Validate();
+
+  b2RayCastInput ray;
+  ray.p1.Set(-1, 0.5);
+  ray.p2.Set(101, 0.5);
+  ray.maxFraction = 1;
+  float32 max_fraction = 1;
+
+  PacketCollector all;
+  tree.RayCastPacket(&all, &ray, &max_fraction, 1);
+  EXPECT_EQ(all.proxies.size(), 100u);
+
+  PacketCollector second;
+  tree.RayCastPacket(&second, &ray, &max_fraction, 1, 0x2);
+  EXPECT_EQ(second.proxies.size(), 50u);
+  for (int32 id : second.proxies) {
+    EXPECT_GE(id, proxies[50]);
+  }
+
+  PacketCollector solid;
+  tree.RayCastPacket(&solid, &ray, &max_fraction, 1, 0x3, true);
+  EXPECT_EQ(solid.proxies.size(), 90u);
+  EXPECT_EQ(solid.proxies.count(proxies[10]), 0u);
+
+  PacketCollector none;
+  tree.RayCastPacket(&none, &ray, &max_fraction, 1, 0x4);
+  EXPECT_TRUE(none.proxies.empty());
+
+  // the unions follow changes of the filter, moves and rebuilds
+  tree.SetProxyFilter(proxies[42], 0x4, false);
+  b2AABB moved;
+  moved.lowerBound.Set(60, 0);
+  moved.upperBound.Set(60.5, 1);
+  tree.MoveProxy(proxies[7], moved, b2Vec2(53, 0));
+  tree.Validate();
+  tree.RayCastPacket(&none, &ray, &max_fraction, 1, 0x4);
+  EXPECT_EQ(none.proxies, std::set<int32>{proxies[42]});
+  tree.RebuildTopDown();
+  tree.Validate();
+  PacketCollector rebuilt;
+  tree.RayCastPacket(&rebuilt, &ray, &max_fraction, 1, 0x1);
+  EXPECT_EQ(rebuilt.proxies.size(), 49u);
+}
+
+// Test the batch ray cast follows the sensor and filter changes of fixtures
+TEST_F(BroadPhaseTest, ray_cast_batch_refilter) {
+  b2RayCastInput down;
+  down.p1.Set(10.5, 11.9);
+  down.p2.Set(10.5, 9);
+  down.maxFraction = 1;
+  b2RayBatchHit hit;
+  b2RayBatchFilter all;
+  world.RayCastBatch(&down, 1, all, &hit);
+  EXPECT_EQ(hit.fixture, ball->GetFixtureList());
+
+  ball->GetFixtureList()->SetSensor(true);
+  world.RayCastBatch(&down, 1, all, &hit);
+  ASSERT_TRUE(hit.fixture != nullptr);
+  EXPECT_EQ(hit.fixture->GetBody(), walls);
+
+  ball->GetFixtureList()->SetSensor(false);
+  b2Filter filter;
+  filter.categoryBits = 0x4;
+  ball->GetFixtureList()->SetFilterData(filter);
+  b2RayBatchFilter ball_only;
+  ball_only.maskBits = 0x4;
+  world.RayCastBatch(&down, 1, ball_only, &hit);
+  EXPECT_EQ(hit.fixture, ball->GetFixtureList());
+  filter.categoryBits = 0x1;
+  ball->GetFixtureList()->SetFilterData(filter);
+  world.RayCastBatch(&down, 1, ball_only, &hit);
+  EXPECT_TRUE(hit.fixture == nullptr);
+}
+
+// Test the block allocator grows its chunks up to the maximum and reports them
+TEST(BlockAllocatorTest, chunk_size) {
+  b2BlockAllocator allocator;
+  allocator.SetChunkSize(1024, 4096);
+  std::vector<void *> blocks;
+  for (int i = 0; i < 1000; i++) {
+    blocks.push_back(allocator.Allocate(64));
+  }
+  void *large = allocator.Allocate(1000);
+
+  // 16, 32, 64 and then 64 blocks per chunk
+  b2BlockAllocatorStats stats = allocator.GetStats();
+  EXPECT_EQ(stats.chunkCount, 17);
+  EXPECT_EQ(stats.chunkBytes, 1024u + 2048 + 15 * 4096);
+  EXPECT_EQ(stats.blockSizes[2], 64);
+  EXPECT_EQ(stats.classChunkBytes[2], stats.chunkBytes);
+  EXPECT_EQ(stats.classBlockCounts[2], 1000);
+  EXPECT_EQ(stats.classBlockCounts[3], 0);
+  EXPECT_EQ(stats.largeCount, 1);
+  EXPECT_EQ(stats.largeBytes, 1000u);
+
+  // freed blocks are reused, the chunks are kept
+  for (void *block : blocks) {
+    allocator.Free(block, 64);
+  }
+  allocator.Free(large, 1000);
+  EXPECT_EQ(allocator.Allocate(64), blocks.back());
+  stats = allocator.GetStats();
+  EXPECT_EQ(stats.chunkCount, 17);
+  EXPECT_EQ(stats.classBlockCounts[2], 1);
+  EXPECT_EQ(stats.largeCount, 0);
+  EXPECT_EQ(stats.largeBytes, 0u);
+}
+
+// Test the world reports the memory of its fixtures
+TEST_F(BroadPhaseTest, allocator_stats) {
+  b2BlockAllocatorStats stats = world.GetAllocatorStats();
+  EXPECT_GT(stats.chunkCount, 0);
+  int32 blocks = 0;
+  size_t used = 0;
+  for (int i = 0; i < b2_blockSizes; i++) {
+    blocks += stats.classBlockCounts[i];
+    used += size_t(stats.classBlockCounts[i]) * stats.blockSizes[i];
+    EXPECT_LE(size_t(stats.classBlockCounts[i]) * stats.blockSizes[i],
+              stats.classChunkBytes[i]);
+  }
+  // a fixture, a shape and a proxy per edge, and the ball
+  EXPECT_GE(blocks, 3 * 2001);
+  EXPECT_LE(used, stats.chunkBytes);
+
+  // the blocks of the edges and their body are free again
+  world.DestroyBody(walls);
+  stats = world.GetAllocatorStats();
+  int32 remaining = 0;
+  for (int i = 0; i < b2_blockSizes; i++) {
+    remaining += stats.classBlockCounts[i];
+  }
+  EXPECT_LE(remaining, blocks - 3 * 2000 - 1);
+}
+
+/**
+ * Step a world with a column of slow circles 0.15 m apart and a fast one far
+ * from them, and return the proxy reinsertions and candidate pairs of the
+ * column and of the fast circle
+ */
+static void StepMixedSpeeds(bool adaptive, int32 *slow_reinserts,
+                            int32 *slow_pairs, int32 *fast_reinserts) {
+  for (int run = 0; run < 2; run++) {
+    b2World world(b2Vec2(0, 0));
+    b2AdaptiveAABB adaptive_aabb;
+    adaptive_aabb.enabled = adaptive;
+    world.SetAdaptiveAABB(adaptive_aabb);
+
+    b2BodyDef body_def;
+    body_def.type = b2_dynamicBody;
+    b2CircleShape circle;
+    circle.m_radius = 0.25;
+    if (run == 0) {
+      for (int i = 0; i < 10; i++) {
+        body_def.position.Set(0, 0.65 * i);
+        body_def.linearVelocity.Set(0.05, 0);
+        world.CreateBody(&body_def)->CreateFixture(&circle, 1);
+      }
+    } else {
+      body_def.position.Set(0, 100);
+      body_def.linearVelocity.Set(20, 0);
+      world.CreateBody(&body_def)->CreateFixture(&circle, 1);
+    }
+
+    int32 reinserts = 0, pairs = 0;
+    for (int i = 0; i < 300; i++) {
+      world.Step(1.0 / 60, 10, 10);
+      reinserts += world.GetStepStats().proxyReinsertCount;
+      pairs += world.GetStepStats().pairCount;
+    }
+    if (run == 0) {
+      *slow_reinserts = reinserts;
+      *slow_pairs = pairs;
+    } else {
+      *fast_reinserts = reinserts;
+    }
+  }
+}
+
+// Test the adaptive margins keep the slow bodies from pairing with their
+// neighbours, and reinsert the fast body less often
+TEST(AdaptiveAABBTest, mixed_speeds) {
+  int32 slow_reinserts, slow_pairs, fast_reinserts;
+  StepMixedSpeeds(false, &slow_reinserts, &slow_pairs, &fast_reinserts);
+  int32 adaptive_slow_reinserts, adaptive_slow_pairs, adaptive_fast_reinserts;
+  StepMixedSpeeds(true, &adaptive_slow_reinserts, &adaptive_slow_pairs,
+                  &adaptive_fast_reinserts);
+
+  EXPECT_GT(slow_reinserts, 0);
+  EXPECT_GT(slow_pairs, 0);
+  EXPECT_EQ(adaptive_slow_pairs, 0);
+  EXPECT_LT(adaptive_fast_reinserts, fast_reinserts);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
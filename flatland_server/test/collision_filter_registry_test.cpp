@@ -44,9 +44,11 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <Box2D/Box2D.h>
 #include <flatland_server/collision_filter_registry.h>
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <string>
 #include <vector>
 
 using namespace flatland_server;
@@ -82,8 +84,25 @@ TEST_F(CollisionFilterRegistryTest, register_no_collide_test) {
   EXPECT_EQ(cfr.RegisterNoCollide(), -5);
 }
 
+TEST_F(CollisionFilterRegistryTest, register_group_test) {
+  EXPECT_EQ(cfr.RegisterGroup("fleet_a", false), -1);
+  EXPECT_EQ(cfr.RegisterGroup("fleet_b", false), -2);
+  EXPECT_EQ(cfr.RegisterGroup("bumpers", true), 1);
+  EXPECT_EQ(cfr.RegisterGroup("fleet_a", false), -1);
+  EXPECT_EQ(cfr.RegisterGroup("fleet_a", true), -1);  // keeps its kind
+  EXPECT_EQ(cfr.RegisterNoCollide(), -3);
+  EXPECT_EQ(cfr.RegisterCollide(), 2);
+  EXPECT_EQ(cfr.RegisterGroup("bumpers", true), 1);
+
+  for (int i = 2; i < CFR::MAX_GROUPS; i++) {
+    cfr.RegisterCollide();
+  }
+  EXPECT_EQ(cfr.RegisterGroup("full", true), 0);
+  EXPECT_EQ(cfr.RegisterGroup("full", false), -4);
+}
+
 TEST_F(CollisionFilterRegistryTest, register_layers_test) {
-  EXPECT_EQ(CFR::MAX_LAYERS, 16);
+  EXPECT_EQ(CFR::MAX_LAYERS, 32);
 
   EXPECT_EQ(cfr.RegisterLayer("layer1"), 0);
   EXPECT_EQ(cfr.RegisterLayer("layer2"), 1);
@@ -123,12 +142,64 @@ TEST_F(CollisionFilterRegistryTest, register_layers_test) {
   EXPECT_EQ(cfr.RegisterLayer("layer14"), 13);
   EXPECT_EQ(cfr.RegisterLayer("layer15"), 14);
   EXPECT_EQ(cfr.RegisterLayer("layer16"), 15);
-  EXPECT_EQ(cfr.RegisterLayer("layer17"), CFR::LAYERS_FULL);
+  for (int i = 17; i <= 32; i++) {
+    EXPECT_EQ(cfr.RegisterLayer("layer" + std::to_string(i)), i - 1);
+  }
+  EXPECT_EQ(cfr.RegisterLayer("layer33"), CFR::LAYERS_FULL);
 
   EXPECT_TRUE(cfr.IsLayersFull());
   layer_names = cfr.GetAllLayers();
 
-  EXPECT_EQ(layer_names.size(), 16);
+  EXPECT_EQ(layer_names.size(), 32);
+}
+
+TEST_F(CollisionFilterRegistryTest, category_bits_test) {
+  for (int i = 1; i <= 32; i++) {
+    cfr.RegisterLayer("layer" + std::to_string(i));
+  }
+
+  EXPECT_EQ(cfr.GetCategoryBits({"all"}), 0xFFFFFFFF);
+  EXPECT_EQ(cfr.GetCategoryBits({"layer1", "layer3"}), 0b101);
+  EXPECT_EQ(cfr.GetCategoryBits({"layer17", "layer32"}), 0x80010000);
+
+  std::vector<std::string> invalid_layers;
+  EXPECT_EQ(cfr.GetCategoryBits({"layer32", "layer33"}, &invalid_layers),
+            0x80000000);
+  EXPECT_EQ(invalid_layers, std::vector<std::string>({"layer33"}));
+
+  // fixtures on layers above the 16th still filter each other out
+  b2Filter a, b;
+  a.categoryBits = a.maskBits = cfr.GetCategoryBits({"layer20"});
+  b.categoryBits = b.maskBits = cfr.GetCategoryBits({"layer21"});
+  EXPECT_EQ(a.categoryBits & b.maskBits, 0u);
+  EXPECT_NE(a.categoryBits & cfr.GetCategoryBits({"all"}), 0u);
+}
+
+TEST_F(CollisionFilterRegistryTest, category_bits_cache_test) {
+  cfr.RegisterLayer("layer1");
+  cfr.RegisterLayer("layer2");
+
+  // cached lists return the same bits and still clear invalid_layers
+  std::vector<std::string> invalid_layers = {"stale"};
+  EXPECT_EQ(cfr.GetCategoryBits({"layer2", "layer1"}, &invalid_layers), 0b11);
+  EXPECT_TRUE(invalid_layers.empty());
+  invalid_layers = {"stale"};
+  EXPECT_EQ(cfr.GetCategoryBits({"layer2", "layer1"}, &invalid_layers), 0b11);
+  EXPECT_TRUE(invalid_layers.empty());
+
+  // the names are joined unambiguously
+  EXPECT_EQ(cfr.GetCategoryBits({"layer1layer2"}, &invalid_layers), 0u);
+  EXPECT_EQ(invalid_layers, std::vector<std::string>({"layer1layer2"}));
+
+  // lists with missing layers are reported on every call and pick up layers
+  // registered later
+  EXPECT_EQ(cfr.GetCategoryBits({"layer1", "layer3"}, &invalid_layers), 0b1);
+  EXPECT_EQ(invalid_layers, std::vector<std::string>({"layer3"}));
+  EXPECT_EQ(cfr.GetCategoryBits({"layer1", "layer3"}, &invalid_layers), 0b1);
+  EXPECT_EQ(invalid_layers, std::vector<std::string>({"layer3"}));
+  EXPECT_EQ(cfr.RegisterLayer("layer3"), 2);
+  EXPECT_EQ(cfr.GetCategoryBits({"layer1", "layer3"}, &invalid_layers), 0b101);
+  EXPECT_TRUE(invalid_layers.empty());
 }
 
 // Run all the tests that were declared with TEST()
@@ -0,0 +1,168 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 column_log_test.cpp
+ * @brief	 Tests the columnar log
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/column_log.h>
+#include <flatland_server/exceptions.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class ColumnLogTest : public ::testing::Test {
+ public:
+  fs::path dir;
+  std::string path;
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    path = (dir / "run.flcol").string();
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+
+  /**
+   * @brief Write 1000 rows of poses over chunks of 64 rows, and a few names
+   */
+  void WriteLog(int level) {
+    ColumnLog::Writer writer(path, level, 64);
+    uint32_t names = writer.AddTable(
+        "names", {{"id", ColumnLog::UINT32}, {"name", ColumnLog::STRING}});
+    uint32_t poses = writer.AddTable("poses", {{"step", ColumnLog::UINT32},
+                                               {"time", ColumnLog::FLOAT64},
+                                               {"x", ColumnLog::FLOAT32},
+                                               {"ranges",
+                                                ColumnLog::FLOAT32_LIST}});
+    for (uint32_t i = 0; i < 1000; i++) {
+      float ranges[3] = {float(i), 1.5f, -2.0f};
+      writer.Put(poses, 0, i);
+      writer.Put(poses, 1, i * 0.01);
+      writer.Put(poses, 2, 0.5f * i);
+      writer.Put(poses, 3, ranges, i % 4);
+      writer.EndRow(poses);
+    }
+    writer.Put(names, 0, 7u);
+    writer.Put(names, 1, std::string("robot/base"));
+    writer.EndRow(names);
+    writer.Put(names, 0, 8u);
+    writer.Put(names, 1, std::string());
+    writer.EndRow(names);
+    writer.Close();
+  }
+
+  void ExpectLog(const std::vector<ColumnLog::Table> &tables) {
+    ASSERT_EQ(tables.size(), 2);
+    EXPECT_EQ(tables[0].name, "names");
+    ASSERT_EQ(tables[0].rows, 2);
+    EXPECT_EQ(tables[0].Get<uint32_t>(0), std::vector<uint32_t>({7, 8}));
+    EXPECT_EQ(tables[0].lengths[1], std::vector<uint32_t>({10, 0}));
+    EXPECT_EQ(std::string(tables[0].values[1].begin(),
+                          tables[0].values[1].end()),
+              "robot/base");
+
+    const ColumnLog::Table &poses = tables[1];
+    EXPECT_EQ(poses.name, "poses");
+    ASSERT_EQ(poses.columns.size(), 4);
+    EXPECT_EQ(poses.columns[3].name, "ranges");
+    EXPECT_EQ(poses.columns[3].type, ColumnLog::FLOAT32_LIST);
+    ASSERT_EQ(poses.rows, 1000);
+    std::vector<uint32_t> step = poses.Get<uint32_t>(0);
+    std::vector<double> time = poses.Get<double>(1);
+    std::vector<float> x = poses.Get<float>(2);
+    std::vector<float> ranges = poses.Get<float>(3);
+    ASSERT_EQ(step.size(), 1000);
+    ASSERT_EQ(time.size(), 1000);
+    ASSERT_EQ(x.size(), 1000);
+    ASSERT_EQ(poses.lengths[3].size(), 1000);
+    size_t r = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+      ASSERT_EQ(step[i], i);
+      ASSERT_EQ(time[i], i * 0.01);
+      ASSERT_EQ(x[i], 0.5f * i);
+      ASSERT_EQ(poses.lengths[3][i], i % 4);
+      if (i % 4 > 0) {
+        ASSERT_EQ(ranges[r], float(i));
+      }
+      r += i % 4;
+    }
+    EXPECT_EQ(ranges.size(), r);
+  }
+};
+
+// Test that the tables read back as they were written, compressed or not
+TEST_F(ColumnLogTest, round_trip) {
+  WriteLog(1);
+  ExpectLog(ColumnLog::Read(path));
+  size_t compressed = fs::file_size(path);
+
+  WriteLog(0);
+  ExpectLog(ColumnLog::Read(path));
+  EXPECT_LT(compressed, fs::file_size(path) / 2);
+}
+
+// Test that a log cut short keeps its complete chunks
+TEST_F(ColumnLogTest, truncated) {
+  WriteLog(1);
+  size_t size = fs::file_size(path);
+  fs::resize_file(path, size - 10);
+
+  std::vector<ColumnLog::Table> tables = ColumnLog::Read(path);
+  ASSERT_EQ(tables.size(), 2);
+  EXPECT_LT(tables[1].rows, 1000);
+  EXPECT_EQ(tables[1].rows % 64, 0);
+  EXPECT_EQ(tables[1].Get<uint32_t>(0).size(), tables[1].rows);
+
+  std::ofstream(path) << "not a log";
+  EXPECT_THROW(ColumnLog::Read(path), Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,96 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_latency_test.cpp
+ * @brief	 Tests of the latency of the commands
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/command_latency.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+
+// Test a command is followed through the stages, each measured once
+TEST(CommandLatencyTest, stages) {
+  CommandLatency latency;
+  latency.Receive(10.0, 10.001);  // handled 1ms after receipt
+  latency.Publish(CommandLatency::ODOMETRY, 0.5, 10.002);  // not applied yet
+  latency.Apply(1.0, 10.005);
+  latency.Apply(1.0, 10.006);  // already applied
+  latency.Publish(CommandLatency::SCAN, 1.0, 10.007);  // before the step
+  latency.Publish(CommandLatency::ODOMETRY, 1.0, 10.008);
+  latency.Publish(CommandLatency::ODOMETRY, 1.1, 10.009);  // already reached
+  latency.Publish(CommandLatency::SCAN, 1.1, 10.05);
+
+  EXPECT_EQ(latency.GetCommandCount(), 1u);
+  EXPECT_EQ(latency.GetSupersededCount(), 0u);
+  const double expected[] = {0.001, 0.005, 0.008, 0.05};
+  for (int s = 0; s < CommandLatency::STAGE_COUNT; s++) {
+    TimingHistogram h = latency.GetLatency(CommandLatency::Stage(s));
+    EXPECT_EQ(h.GetCount(), 1u) << CommandLatency::GetStageName(
+        CommandLatency::Stage(s));
+    EXPECT_NEAR(h.GetMean(), expected[s], 1e-9);
+  }
+
+  latency.Reset();
+  EXPECT_EQ(latency.GetCommandCount(), 0u);
+  EXPECT_EQ(latency.GetLatency(CommandLatency::SCAN).GetCount(), 0u);
+}
+
+// Test a command replaced before it is applied is not measured past dispatch
+TEST(CommandLatencyTest, superseded) {
+  CommandLatency latency;
+  latency.Receive(1.0, 1.0);
+  latency.Receive(2.0, 2.0);
+  latency.Apply(0.1, 2.5);
+  EXPECT_EQ(latency.GetCommandCount(), 2u);
+  EXPECT_EQ(latency.GetSupersededCount(), 1u);
+  TimingHistogram physics = latency.GetLatency(CommandLatency::PHYSICS);
+  EXPECT_EQ(physics.GetCount(), 1u);
+  EXPECT_NEAR(physics.GetMean(), 0.5, 1e-9);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,169 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 command_queue_test.cpp
+ * @brief	 Tests for the CommandQueue
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/command_queue.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace flatland_server;
+
+class CommandQueueTest : public ::testing::Test {
+ protected:
+  CommandQueue &queue = CommandQueue::Get();
+
+  void TearDown() override { queue.SetEnabled(false); }
+};
+
+/**
+ * While disabled, the commands run when posted
+ */
+TEST_F(CommandQueueTest, disabled) {
+  queue.SetEnabled(false);
+  int runs = 0;
+  queue.Post([&runs]() { runs++; });
+  EXPECT_TRUE(queue.Call([&runs]() { runs++; }));
+  EXPECT_EQ(runs, 2);
+  EXPECT_EQ(queue.Apply(), 0u);
+}
+
+/**
+ * The commands of several threads are applied in the order each thread
+ * posted them
+ */
+TEST_F(CommandQueueTest, apply_in_order) {
+  queue.SetEnabled(true);
+  const int kThreads = 4;
+  const int kCommands = 1000;
+  std::vector<std::vector<int>> applied(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kCommands; i++) {
+        queue.Post([&, t, i]() { applied[t].push_back(i); });
+      }
+    });
+  }
+
+  unsigned int count = 0;
+  for (auto &thread : threads) {
+    count += queue.Apply();
+    thread.join();
+  }
+  count += queue.Apply();
+  EXPECT_EQ(count, unsigned(kThreads * kCommands));
+  for (int t = 0; t < kThreads; t++) {
+    ASSERT_EQ(applied[t].size(), size_t(kCommands));
+    for (int i = 0; i < kCommands; i++) {
+      EXPECT_EQ(applied[t][i], i);
+    }
+  }
+}
+
+/**
+ * Call waits for the command, rethrows its exceptions and returns false once
+ * the queue is closed
+ */
+TEST_F(CommandQueueTest, call) {
+  queue.SetEnabled(true);
+  int value = 0;
+  bool result = false;
+  std::thread caller([&]() { result = queue.Call([&value]() { value = 1; }); });
+  while (value == 0) {
+    queue.Apply();
+  }
+  caller.join();
+  EXPECT_TRUE(result);
+
+  std::thread thrower([&]() {
+    EXPECT_THROW(queue.Call([]() { throw std::runtime_error("failed"); }),
+                 std::runtime_error);
+  });
+  while (queue.Apply() == 0) {
+  }
+  thrower.join();
+
+  queue.Close();
+  EXPECT_FALSE(queue.Call([&value]() { value = 2; }));
+  queue.Post([&value]() { value = 3; });
+  EXPECT_EQ(queue.Apply(), 0u);
+  EXPECT_EQ(value, 1);
+}
+
+/**
+ * Wait returns once a command is posted, or after the timeout
+ */
+TEST_F(CommandQueueTest, wait) {
+  queue.SetEnabled(true);
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(queue.Wait(0.05));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(50));
+
+  int value = 0;
+  std::thread poster([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.Post([&value]() { value = 1; });
+  });
+  start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(queue.Wait(10));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  poster.join();
+  EXPECT_EQ(queue.Apply(), 1u);
+  EXPECT_EQ(value, 1);
+
+  // a command already waiting returns at once
+  queue.Post([&value]() { value = 2; });
+  EXPECT_TRUE(queue.Wait(10));
+  EXPECT_EQ(queue.Apply(), 1u);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
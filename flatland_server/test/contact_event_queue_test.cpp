@@ -0,0 +1,154 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 contact_event_queue_test.cpp
+ * @brief	 Tests for the ContactEventQueue
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Box2D/Box2D.h>
+#include <flatland_server/contact_event_queue.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace flatland_server;
+
+namespace {
+ContactEvent MakeEvent(float impulse) {
+  ContactEvent event = ContactEvent();
+  event.type = ContactEvent::IMPULSE;
+  event.normal_impulse = impulse;
+  return event;
+}
+}  // namespace
+
+/**
+ * The events are kept in the order they were pushed
+ */
+TEST(ContactEventQueueTest, push_in_order) {
+  ContactEventQueue queue;
+  queue.SetCapacity(4);
+  for (int i = 0; i < 3; i++) {
+    queue.Push(MakeEvent(i));
+  }
+  ASSERT_EQ(queue.Size(), 3u);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(queue[i].normal_impulse, i);
+  }
+  EXPECT_EQ(queue.Dropped(), 0u);
+
+  queue.Clear();
+  EXPECT_EQ(queue.Size(), 0u);
+  EXPECT_EQ(queue.Capacity(), 4u);
+}
+
+/**
+ * Once full, the newest events overwrite the oldest ones
+ */
+TEST(ContactEventQueueTest, overwrite_oldest) {
+  ContactEventQueue queue;
+  queue.SetCapacity(3);
+  for (int i = 0; i < 5; i++) {
+    queue.Push(MakeEvent(i));
+  }
+  ASSERT_EQ(queue.Size(), 3u);
+  EXPECT_EQ(queue[0].normal_impulse, 2);
+  EXPECT_EQ(queue[1].normal_impulse, 3);
+  EXPECT_EQ(queue[2].normal_impulse, 4);
+  EXPECT_EQ(queue.Dropped(), 2u);
+}
+
+/**
+ * Nothing is recorded without capacity
+ */
+TEST(ContactEventQueueTest, disabled) {
+  ContactEventQueue queue;
+  queue.Push(MakeEvent(1));
+  EXPECT_EQ(queue.Size(), 0u);
+  EXPECT_EQ(queue.Dropped(), 0u);
+}
+
+/**
+ * An event records the fixtures, normal and impulses of a contact
+ */
+TEST(ContactEventQueueTest, record) {
+  b2World world(b2Vec2(0, 0));
+  b2PolygonShape box;
+  box.SetAsBox(0.5, 0.5);
+  b2BodyDef def;
+  def.type = b2_dynamicBody;
+  b2Body *a = world.CreateBody(&def);
+  b2Fixture *fixture_a = a->CreateFixture(&box, 1);
+  def.position.Set(0.9, 0);
+  b2Body *b = world.CreateBody(&def);
+  b2Fixture *fixture_b = b->CreateFixture(&box, 1);
+
+  world.Step(0.01, 10, 10);
+  b2Contact *contact = world.GetContactList();
+  ASSERT_NE(contact, nullptr);
+  ASSERT_TRUE(contact->IsTouching());
+
+  b2ContactImpulse impulse;
+  impulse.count = 2;
+  impulse.normalImpulses[0] = 1;
+  impulse.normalImpulses[1] = 2;
+  impulse.tangentImpulses[0] = 0.5;
+  impulse.tangentImpulses[1] = 0;
+  ContactEvent event =
+      ContactEvent::Record(ContactEvent::IMPULSE, contact, &impulse);
+  EXPECT_EQ(event.type, ContactEvent::IMPULSE);
+  EXPECT_TRUE(
+      (event.fixture_a == fixture_a && event.fixture_b == fixture_b) ||
+      (event.fixture_a == fixture_b && event.fixture_b == fixture_a));
+  EXPECT_NEAR(std::abs(event.normal.x), 1, 0.01);
+  EXPECT_NEAR(event.normal.y, 0, 0.01);
+  EXPECT_NEAR(event.point.x, a->GetPosition().x + 0.45, 0.05);
+  EXPECT_FLOAT_EQ(event.normal_impulse, 3);
+  EXPECT_FLOAT_EQ(event.tangent_impulse, 0.5);
+
+  event = ContactEvent::Record(ContactEvent::BEGIN, contact);
+  EXPECT_EQ(event.normal_impulse, 0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
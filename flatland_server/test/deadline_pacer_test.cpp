@@ -0,0 +1,148 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 deadline_pacer_test.cpp
+ * @brief	 Tests for the deadline pacing
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/deadline_pacer.h>
+#include <flatland_server/exceptions.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace flatland_server;
+
+/**
+ * Run a simulated loop of 10 ms cycles where the cycles take work[i] seconds,
+ * and return the time each cycle starts at
+ */
+std::vector<double> RunLoop(DeadlinePacer *pacer,
+                            const std::vector<double> &work) {
+  std::vector<double> starts;
+  double now = 100;
+  pacer->Reset(now);
+  for (double w : work) {
+    starts.push_back(now);
+    now += w;
+    now = std::max(now, pacer->NextDeadline(now));
+  }
+  return starts;
+}
+
+// Test that the cycles start on the deadlines, whatever their work
+TEST(DeadlinePacerTest, on_schedule) {
+  DeadlinePacer pacer(0.01);
+  std::vector<double> starts = RunLoop(&pacer, {0.001, 0.009, 0.005, 0});
+  ASSERT_EQ(starts.size(), 4u);
+  for (unsigned int i = 0; i < starts.size(); i++) {
+    EXPECT_NEAR(starts[i], 100 + 0.01 * i, 1e-9);
+  }
+  EXPECT_EQ(pacer.GetOverrunCount(), 0u);
+}
+
+// Test the overrun policies after a cycle of 25 ms
+TEST(DeadlinePacerTest, overrun_policies) {
+  std::vector<double> work = {0.025, 0.001, 0.001, 0.001};
+
+  // the deadlines at 10 and 20 ms are dropped
+  DeadlinePacer skip(0.01, DeadlinePacer::SKIP);
+  std::vector<double> starts = RunLoop(&skip, work);
+  EXPECT_NEAR(starts[1], 100.030, 1e-9);
+  EXPECT_NEAR(starts[2], 100.040, 1e-9);
+  EXPECT_EQ(skip.GetOverrunCount(), 1u);
+
+  // the cycles of 10 and 20 ms run right away, then back on schedule
+  DeadlinePacer burst(0.01, DeadlinePacer::BURST, 0, 2);
+  starts = RunLoop(&burst, work);
+  EXPECT_NEAR(starts[1], 100.025, 1e-9);
+  EXPECT_NEAR(starts[2], 100.026, 1e-9);
+  EXPECT_NEAR(starts[3], 100.030, 1e-9);
+  EXPECT_EQ(burst.GetOverrunCount(), 2u);
+
+  // with a burst of 1, only the cycle of 20 ms runs right away
+  DeadlinePacer short_burst(0.01, DeadlinePacer::BURST, 0, 1);
+  starts = RunLoop(&short_burst, work);
+  EXPECT_NEAR(starts[1], 100.025, 1e-9);
+  EXPECT_NEAR(starts[2], 100.030, 1e-9);
+  EXPECT_EQ(short_burst.GetOverrunCount(), 1u);
+
+  // the schedule restarts after the overrun
+  DeadlinePacer slip(0.01, DeadlinePacer::SLIP);
+  starts = RunLoop(&slip, work);
+  EXPECT_NEAR(starts[1], 100.025, 1e-9);
+  EXPECT_NEAR(starts[2], 100.035, 1e-9);
+  EXPECT_NEAR(starts[3], 100.045, 1e-9);
+  EXPECT_EQ(slip.GetOverrunCount(), 1u);
+}
+
+// Test the policies are parsed by name
+TEST(DeadlinePacerTest, parse_overrun) {
+  for (auto overrun :
+       {DeadlinePacer::SKIP, DeadlinePacer::BURST, DeadlinePacer::SLIP}) {
+    EXPECT_EQ(DeadlinePacer::ParseOverrun(DeadlinePacer::OverrunName(overrun)),
+              overrun);
+  }
+  EXPECT_THROW(DeadlinePacer::ParseOverrun("catch_up"), Exception);
+}
+
+// Test that waiting holds the period on the clock and records the jitter
+TEST(DeadlinePacerTest, wait) {
+  DeadlinePacer pacer(0.002, DeadlinePacer::SKIP, 0.0002);
+  double start = DeadlinePacer::Now();
+  pacer.Reset(start);
+  for (int i = 0; i < 20; i++) {
+    pacer.Wait();
+  }
+  double elapsed = DeadlinePacer::Now() - start;
+  EXPECT_GE(elapsed, 0.040);
+  EXPECT_LT(elapsed, 0.040 + 0.002 * (pacer.GetOverrunCount() + 1));
+  // with SKIP, even the cycles that overran wait for a deadline
+  EXPECT_EQ(pacer.GetJitter().GetCount(), 20u);
+  EXPECT_GE(pacer.GetJitter().GetMin(), 0);
+  EXPECT_LT(pacer.GetCycleTime(), 0.002);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -46,10 +46,12 @@
 
 #include "flatland_server/debug_visualization.h"
 #include <Box2D/Box2D.h>
+#include <flatland_msgs/DebugTopicList.h>
 #include <flatland_server/timekeeper.h>
 #include <gtest/gtest.h>
 #include <ros/ros.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <algorithm>
 #include <cmath>
 
 // Test the bodyToMarkers method on a polygon shape
@@ -290,6 +292,149 @@ TEST(DebugVizTest, testBodyToMarkersMultibody) {
   ASSERT_NEAR(markers.markers[0].points[3].y, 7.0, 1e-5);
 }
 
+// test that movable bodies get markers of their own, which can be moved
+TEST(DebugVizTest, testVisualizeMovable) {
+  b2Vec2 gravity(0.0, 0.0);
+  b2World world(gravity);
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+  b2Body* body2 = world.CreateBody(&bodyDef);
+
+  b2FixtureDef fixtureDef;
+  b2EdgeShape edge;
+  edge.m_vertex1.Set(0.0, 1.0);
+  edge.m_vertex2.Set(1.0, 2.0);
+  fixtureDef.shape = &edge;
+  body->CreateFixture(&fixtureDef);
+  body2->CreateFixture(&fixtureDef);
+
+  flatland_server::DebugVisualization& viz =
+      flatland_server::DebugVisualization::Get();
+  EXPECT_EQ(viz.VisualizeMovable("movable", body, 1.0, 0.0, 0.0, 1.0), 1);
+  EXPECT_EQ(viz.VisualizeMovable("movable", body2, 1.0, 0.0, 0.0, 1.0), 1);
+
+  // the edges of the two bodies are not merged into one line list
+  auto& markers = viz.topics_["movable"].markers.markers;
+  ASSERT_EQ(viz.MarkerCount("movable"), 2);
+  EXPECT_EQ(markers[1].id, 1);
+
+  // only the pose of the markers of the moved body changes
+  viz.topics_["movable"].needs_publishing = false;
+  body2->SetTransform(b2Vec2(3.0, 4.0), 0);
+  viz.MoveBody("movable", 1, 1, body2);
+  EXPECT_TRUE(viz.topics_["movable"].needs_publishing);
+  EXPECT_NEAR(markers[0].pose.position.x, 0.0, 1e-5);
+  EXPECT_NEAR(markers[1].pose.position.x, 3.0, 1e-5);
+  EXPECT_NEAR(markers[1].pose.position.y, 4.0, 1e-5);
+  ASSERT_EQ(markers[1].points.size(), 2);
+  EXPECT_NEAR(markers[1].points[0].y, 1.0, 1e-5);
+
+  viz.Truncate("movable", 1);
+  EXPECT_EQ(viz.MarkerCount("movable"), 1);
+  EXPECT_EQ(viz.MarkerCount("nonexistent"), 0);
+
+  // the other tests expect no topics
+  viz.topics_.erase("movable");
+}
+
+// test the merging, simplification and budget of the edges of a layer
+TEST(DebugVizTest, testLayerEdges) {
+  b2Vec2 gravity(0.0, 0.0);
+  b2World world(gravity);
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+
+  // a wall of four collinear edges, followed by a small step
+  b2FixtureDef fixtureDef;
+  b2EdgeShape edge;
+  fixtureDef.shape = &edge;
+  for (int i = 0; i < 4; i++) {
+    edge.m_vertex1.Set(i, 0.0);
+    edge.m_vertex2.Set(i + 1, 0.0);
+    body->CreateFixture(&fixtureDef);
+  }
+  edge.m_vertex1.Set(4.0, 0.0);
+  edge.m_vertex2.Set(5.0, 0.05);
+  body->CreateFixture(&fixtureDef);
+
+  YAML::Node properties;
+  flatland_server::LayerVisualization lod(properties);
+  EXPECT_FALSE(lod.ReducesDetail());
+  EXPECT_EQ(flatland_server::DebugVisualization::LayerEdges(body, lod).size(),
+            5);
+
+  // the collinear edges are merged, the step is kept
+  properties["debug"]["merge_segments"] = true;
+  lod = flatland_server::LayerVisualization(properties);
+  EXPECT_TRUE(lod.ReducesDetail());
+  auto edges = flatland_server::DebugVisualization::LayerEdges(body, lod);
+  ASSERT_EQ(edges.size(), 2);
+  float longest = std::max((edges[0].first - edges[0].second).Length(),
+                           (edges[1].first - edges[1].second).Length());
+  EXPECT_NEAR(longest, 4.0, 1e-5);
+
+  // the step is within the tolerance
+  properties["debug"]["simplify_tolerance"] = 0.1;
+  lod = flatland_server::LayerVisualization(properties);
+  EXPECT_EQ(flatland_server::DebugVisualization::LayerEdges(body, lod).size(),
+            1);
+
+  // the budget of one edge raises the tolerance until the step is dropped
+  properties["debug"]["simplify_tolerance"] = 0.0;
+  properties["debug"]["max_bytes"] = 6 * sizeof(geometry_msgs::Point);
+  lod = flatland_server::LayerVisualization(properties);
+  EXPECT_EQ(flatland_server::DebugVisualization::LayerEdges(body, lod).size(),
+            1);
+}
+
+// test that models are packed into shards when aggregated
+TEST(DebugVizTest, testModelsPerTopic) {
+  flatland_server::Timekeeper timekeeper;
+  b2Vec2 gravity(0.0, 0.0);
+  b2World world(gravity);
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+  b2FixtureDef fixtureDef;
+  b2CircleShape circle;
+  circle.m_radius = 0.2f;
+  fixtureDef.shape = &circle;
+  body->CreateFixture(&fixtureDef);
+
+  flatland_server::DebugVisualization::SetModelsPerTopic(2);
+  flatland_server::DebugVisualization& viz =
+      flatland_server::DebugVisualization::Get();
+  for (const char* name : {"model/a", "model/b", "model/c", "layer/d"}) {
+    viz.Visualize(name, body, 1.0, 0.0, 0.0, 1.0);
+  }
+
+  // only the model topics are packed, two per shard
+  ASSERT_EQ(viz.shards_.size(), 2);
+  EXPECT_EQ(viz.topics_["model/a"].shard, 0);
+  EXPECT_EQ(viz.topics_["model/b"].shard, 0);
+  EXPECT_EQ(viz.topics_["model/c"].shard, 1);
+  EXPECT_EQ(viz.topics_["layer/d"].shard, -1);
+
+  viz.Publish(timekeeper);
+  EXPECT_FALSE(viz.shards_[0].needs_publishing);
+  EXPECT_FALSE(viz.topics_["model/a"].needs_publishing);
+
+  // a deleted model leaves its shard, and the next model takes its place
+  viz.Reset("model/a");
+  viz.Publish(timekeeper);
+  EXPECT_EQ(viz.topics_.count("model/a"), 0);
+  EXPECT_EQ(viz.shards_[0].topics, std::vector<std::string>({"model/b"}));
+  viz.Visualize("model/e", body, 1.0, 0.0, 0.0, 1.0);
+  EXPECT_EQ(viz.topics_["model/e"].shard, 0);
+
+  // the other tests expect no topics
+  flatland_server::DebugVisualization::SetModelsPerTopic(0);
+  viz.topics_.clear();
+  viz.shards_.clear();
+}
+
 // test bodyToMarkers with multiple joint
 TEST(DebugVizTest, testJointToMarkersMultiJoint) {
   b2Vec2 gravity(0.0, 0.0);
@@ -374,6 +519,50 @@ TEST(DebugVizTest, testJointToMarkersMultiJoint) {
   ASSERT_FLOAT_EQ(markers.markers[3].points[3].y, 0.0);
 }
 
+// test that JointsToMarkers batches the joints into two markers
+TEST(DebugVizTest, testJointsToMarkers) {
+  flatland_server::JointState j1, j2;
+  j1.anchor_a = b2Vec2(0, 0);
+  j1.anchor_b = b2Vec2(0, 0);
+  j1.position_a = b2Vec2(0, 0);
+  j1.position_b = b2Vec2(0, 0);
+  j1.color = flatland_server::Color(0.1, 0.2, 0.3, 0.4);
+  j2.anchor_a = b2Vec2(1, 2);
+  j2.anchor_b = b2Vec2(3, 4);
+  j2.position_a = b2Vec2(0, 0);
+  j2.position_b = b2Vec2(0, 0);
+  j2.color = flatland_server::Color(0.5, 0.6, 0.7, 0.8);
+
+  visualization_msgs::MarkerArray markers;
+  flatland_server::DebugVisualization::Get().JointsToMarkers(markers,
+                                                             {j1, j2});
+  ASSERT_EQ(markers.markers.size(), 2);
+
+  // the same lines as JointToMarkers, one after the other
+  ASSERT_EQ(markers.markers[0].type, markers.markers[0].LINE_LIST);
+  ASSERT_EQ(markers.markers[0].points.size(), 12);
+  ASSERT_EQ(markers.markers[0].colors.size(), 12);
+  ASSERT_FLOAT_EQ(markers.markers[0].points[7].x, 1.0);
+  ASSERT_FLOAT_EQ(markers.markers[0].points[7].y, 2.0);
+  ASSERT_FLOAT_EQ(markers.markers[0].points[11].x, 3.0);
+  ASSERT_FLOAT_EQ(markers.markers[0].points[11].y, 4.0);
+  ASSERT_FLOAT_EQ(markers.markers[0].colors[5].r, 0.1);
+  ASSERT_FLOAT_EQ(markers.markers[0].colors[6].r, 0.5);
+
+  ASSERT_EQ(markers.markers[1].type, markers.markers[1].CUBE_LIST);
+  ASSERT_EQ(markers.markers[1].id, 1);
+  ASSERT_EQ(markers.markers[1].points.size(), 8);
+  ASSERT_EQ(markers.markers[1].colors.size(), 8);
+  ASSERT_FLOAT_EQ(markers.markers[1].points[4].x, 1.0);
+  ASSERT_FLOAT_EQ(markers.markers[1].points[5].x, 3.0);
+  ASSERT_FLOAT_EQ(markers.markers[1].colors[4].a, 0.8);
+
+  // no joints, no markers
+  markers.markers.clear();
+  flatland_server::DebugVisualization::Get().JointsToMarkers(markers, {});
+  ASSERT_EQ(markers.markers.size(), 0);
+}
+
 // A helper class to accept MarkerArray message callbacks
 struct MarkerArraySubscriptionHelper {
   visualization_msgs::MarkerArray markers_;
@@ -502,6 +691,120 @@ TEST(DebugVizTest, testPublishMarkers) {
   EXPECT_EQ(2, helper.markers_.markers.size());
 }
 
+// Test publishing the markers on the publisher thread
+TEST(DebugVizTest, testPublishMarkersAsync) {
+  flatland_server::Timekeeper timekeeper;
+  b2Vec2 gravity(0.0, 0.0);
+  b2World world(gravity);
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+  b2FixtureDef fixtureDef;
+  b2CircleShape circle;
+  circle.m_radius = 0.2f;
+  fixtureDef.shape = &circle;
+  body->CreateFixture(&fixtureDef);
+
+  ros::NodeHandle nh;
+  MarkerArraySubscriptionHelper helper;
+  ros::Subscriber sub =
+      nh.subscribe("/debug_visualization_test/debug/async", 0,
+                   &MarkerArraySubscriptionHelper::callback, &helper);
+
+  flatland_server::DebugVisualization::SetAsyncPublishing(true);
+  flatland_server::DebugVisualization& viz =
+      flatland_server::DebugVisualization::Get();
+  viz.Visualize("async", body, 1.0, 0.0, 0.0, 1.0);
+  viz.Publish(timekeeper);
+  EXPECT_TRUE(helper.waitForMessageCount(1));
+  EXPECT_EQ(1, helper.markers_.markers.size());
+
+  // the thread publishes the pending markers before stopping
+  viz.Visualize("async", body, 1.0, 0.0, 0.0, 1.0);
+  viz.Publish(timekeeper);
+  viz.StopPublishing();
+  EXPECT_TRUE(helper.waitForMessageCount(2));
+  EXPECT_EQ(2, helper.markers_.markers.size());
+
+  flatland_server::DebugVisualization::SetAsyncPublishing(false);
+  viz.topics_.erase("async");
+}
+
+// A helper class to accept DebugTopicList message callbacks
+struct TopicListSubscriptionHelper {
+  flatland_msgs::DebugTopicList topic_list_;
+  int count_ = 0;
+
+  void callback(const flatland_msgs::DebugTopicListConstPtr& msg) {
+    ++count_;
+    topic_list_ = *msg;
+  }
+
+  /**
+   * @brief Spin for half a second, to receive the messages in flight
+   */
+  void settle() {
+    ros::Rate rate(20);
+    for (unsigned int i = 0; i < 10; i++) {
+      ros::spinOnce();
+      rate.sleep();
+    }
+  }
+};
+
+// Test that the topic list is published once per Publish, not per topic
+TEST(DebugVizTest, testTopicListCoalesced) {
+  flatland_server::Timekeeper timekeeper;
+  b2Vec2 gravity(0.0, 0.0);
+  b2World world(gravity);
+
+  b2BodyDef bodyDef;
+  b2Body* body = world.CreateBody(&bodyDef);
+  b2FixtureDef fixtureDef;
+  b2CircleShape circle;
+  circle.m_radius = 0.2f;
+  fixtureDef.shape = &circle;
+  body->CreateFixture(&fixtureDef);
+
+  ros::NodeHandle nh;
+  TopicListSubscriptionHelper helper;
+  ros::Subscriber sub =
+      nh.subscribe("/debug_visualization_test/debug/topics", 0,
+                   &TopicListSubscriptionHelper::callback, &helper);
+  helper.settle();  // the latched list of the previous tests
+  int count = helper.count_;
+
+  flatland_server::DebugVisualization& viz =
+      flatland_server::DebugVisualization::Get();
+  for (const char* name : {"model/a", "model/b", "model/c"}) {
+    viz.Visualize(name, body, 1.0, 0.0, 0.0, 1.0);
+  }
+  helper.settle();
+  EXPECT_EQ(helper.count_, count);
+
+  viz.Publish(timekeeper);
+  helper.settle();
+  EXPECT_EQ(helper.count_, count + 1);
+  EXPECT_FALSE(helper.topic_list_.delta);
+  const std::vector<std::string>& topics = helper.topic_list_.topics;
+  for (const char* name : {"model/a", "model/b", "model/c"}) {
+    EXPECT_EQ(std::count(topics.begin(), topics.end(), name), 1) << name;
+  }
+
+  // deleting them all publishes one list as well, and an unchanged list is
+  // not published again
+  for (const char* name : {"model/a", "model/b", "model/c"}) {
+    viz.Reset(name);
+  }
+  viz.Publish(timekeeper);
+  viz.Publish(timekeeper);
+  helper.settle();
+  EXPECT_EQ(helper.count_, count + 2);
+  for (const char* name : {"model/a", "model/b", "model/c"}) {
+    EXPECT_EQ(std::count(topics.begin(), topics.end(), name), 0) << name;
+  }
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char** argv) {
   ros::init(argc, argv, "debug_visualization_test");
@@ -0,0 +1,129 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 extrapolator_test.cpp
+ * @brief	 Unit test for the Extrapolator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/extrapolator.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace flatland_server;
+
+// Test that a body moving at constant velocities is extrapolated about its
+// origin, with the velocity of its center of mass
+TEST(ExtrapolatorTest, motion) {
+  b2Transform transform(b2Vec2(1, 2), b2Rot(0));
+  // turning about its center of mass at (1, 0) in the body frame, the
+  // origin moves at -omega x r
+  Extrapolator::Motion motion = Extrapolator::Motion::Of(
+      transform, b2Vec2(0.5, 0), 2, b2Vec2(1, 0));
+  EXPECT_NEAR(motion.linear.x, 0.5, 1e-6);
+  EXPECT_NEAR(motion.linear.y, -2, 1e-6);
+
+  b2Transform at = motion.At(0.1);
+  EXPECT_NEAR(at.p.x, 1.05, 1e-6);
+  EXPECT_NEAR(at.p.y, 1.8, 1e-6);
+  EXPECT_NEAR(at.q.GetAngle(), 0.2, 1e-6);
+
+  b2Transform now = motion.At(0);
+  EXPECT_NEAR(now.p.x, 1, 1e-6);
+  EXPECT_NEAR(now.q.GetAngle(), 0, 1e-6);
+}
+
+// Test that the clock follows the real time factor and stops one step ahead
+TEST(ExtrapolatorTest, clock) {
+  Extrapolator::Clock clock;
+  clock.Step(1.0, 100.0);
+  // the factor is unknown after one step
+  EXPECT_DOUBLE_EQ(clock.Estimate(100.05), 1.0);
+
+  // twice as fast as real time, steps of 0.1 s
+  clock.Step(1.1, 100.05);
+  EXPECT_DOUBLE_EQ(clock.GetTime(), 1.1);
+  EXPECT_NEAR(clock.Estimate(100.05), 1.1, 1e-9);
+  EXPECT_NEAR(clock.Estimate(100.075), 1.15, 1e-9);
+  EXPECT_NEAR(clock.Estimate(100.5), 1.2, 1e-9);
+
+  // a reset restarts the estimate
+  clock.Step(0.1, 101.0);
+  EXPECT_DOUBLE_EQ(clock.Estimate(101.02), 0.1);
+  clock.Step(0.2, 101.1);
+  EXPECT_NEAR(clock.Estimate(101.15), 0.25, 1e-9);
+}
+
+// Test that the tasks run at their rates until removed
+TEST(ExtrapolatorTest, tasks) {
+  Extrapolator &extrapolator = Extrapolator::Get();
+  std::atomic<int> fast(0), slow(0);
+  unsigned int a = extrapolator.Add(200, [&](double) { fast++; });
+  unsigned int b = extrapolator.Add(20, [&](double) { slow++; });
+  EXPECT_NE(a, b);
+  EXPECT_EQ(extrapolator.GetTaskCount(), 2u);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  extrapolator.Remove(a);
+  extrapolator.Remove(b);
+  EXPECT_EQ(extrapolator.GetTaskCount(), 0u);
+
+  // loose bounds for loaded machines
+  EXPECT_GT(fast.load(), 15);
+  EXPECT_LT(fast.load(), 80);
+  EXPECT_GT(slow.load(), 2);
+  EXPECT_LT(slow.load(), 10);
+  EXPECT_GT(fast.load(), slow.load());
+
+  // nothing runs after Remove returned
+  int count = fast.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(fast.load(), count);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,177 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 flight_recorder_test.cpp
+ * @brief	 Test the flight recorder
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/flight_recorder.h>
+#include <flatland_server/tracer.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class FlightRecorderTest : public ::testing::Test {
+ public:
+  fs::path dir;
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+
+  /**
+   * @brief Make an iteration of one step starting every ms
+   * @param[in] i Index of the iteration
+   * @param[in] duration Duration in ms
+   */
+  FlightRecorder::Step MakeStep(uint64_t i, double duration) {
+    FlightRecorder::Step step;
+    step.step = i;
+    step.start = i * 1000000;
+    step.duration = uint64_t(duration * 1e6);
+    step.contacts = 3;
+    step.stages[StepTimer::PHYSICS_STEP] = duration * 1e-3 / 2;
+    return step;
+  }
+
+  // Count the occurrences of a regex in a string
+  int Count(const std::string &str, const std::string &regex) {
+    std::regex re(regex);
+    return std::distance(std::sregex_iterator(str.begin(), str.end(), re),
+                         std::sregex_iterator());
+  }
+};
+
+// Test that the window around an overrun is written once complete, with the
+// spans of the tracer over the same time
+TEST_F(FlightRecorderTest, dump_window) {
+  Tracer &tracer = Tracer::Get();
+  tracer.Start();
+  tracer.Record("test", "outside", 2000000, 2100000);
+  tracer.Record("test", "inside", 16000000, 16100000);
+  tracer.Stop();
+
+  FlightRecorder recorder(1e-3, 8, dir.string());
+  for (uint64_t i = 0; i < 20; i++) {
+    EXPECT_FALSE(recorder.Add(MakeStep(i, 0.5)));
+  }
+  // the dump waits for a quarter of the window after the overrun
+  EXPECT_FALSE(recorder.Add(MakeStep(20, 5)));
+  EXPECT_FALSE(recorder.Add(MakeStep(21, 0.5)));
+  EXPECT_TRUE(recorder.Add(MakeStep(22, 0.5)));
+  EXPECT_EQ(recorder.GetOverrunCount(), 1u);
+
+  std::string path = recorder.Dump();
+  EXPECT_EQ(path, (dir / "flight_recorder_20.json").string());
+  EXPECT_EQ(recorder.GetDumpCount(), 1u);
+  std::ifstream in(path);
+  std::stringstream json;
+  json << in.rdbuf();
+  EXPECT_EQ(Count(json.str(), "\"name\":\"step\""), 7);
+  EXPECT_EQ(Count(json.str(), "\"name\":\"overrun\""), 1);
+  EXPECT_EQ(Count(json.str(), "\"step\":15,"), 1);
+  EXPECT_EQ(Count(json.str(), "\"step\":14,"), 0);
+  EXPECT_EQ(Count(json.str(), "\"physics_step_ms\":2.5"), 1);
+  EXPECT_EQ(Count(json.str(), "\"contacts\":3"), 8);
+  EXPECT_EQ(Count(json.str(), "\"name\":\"inside\""), 1);
+  EXPECT_EQ(Count(json.str(), "\"name\":\"outside\""), 0);
+}
+
+// Test that the windows written do not overlap, and that the number of files
+// is limited
+TEST_F(FlightRecorderTest, trigger_limits) {
+  FlightRecorder recorder(1e-3, 8, dir.string(), 2);
+  uint64_t i = 0;
+  EXPECT_FALSE(recorder.Add(MakeStep(i++, 5)));
+  EXPECT_FALSE(recorder.Add(MakeStep(i++, 0.5)));
+  EXPECT_TRUE(recorder.Add(MakeStep(i++, 0.5)));
+  recorder.Dump();
+
+  // within the window written
+  for (int j = 0; j < 8; j++) {
+    EXPECT_FALSE(recorder.Add(MakeStep(i++, 5)));
+  }
+  EXPECT_EQ(recorder.GetOverrunCount(), 9u);
+
+  // once the window is past, the next overrun is written, up to 2 files
+  for (int dumps = 0; dumps < 2; dumps++) {
+    bool dumped = false;
+    for (int j = 0; j < 20 && !dumped; j++) {
+      dumped = recorder.Add(MakeStep(i++, 5));
+    }
+    if (dumped) recorder.Dump();
+  }
+  EXPECT_EQ(recorder.GetDumpCount(), 2u);
+
+  // an iteration of several steps overruns with its mean step time
+  uint64_t overruns = recorder.GetOverrunCount();
+  FlightRecorder::Step step = MakeStep(i++, 1.5);
+  step.steps = 2;
+  recorder.Add(step);
+  EXPECT_EQ(recorder.GetOverrunCount(), overruns);
+  step.duration = 2500000;
+  recorder.Add(step);
+  EXPECT_EQ(recorder.GetOverrunCount(), overruns + 1);
+}
+
+// Test that writing to an invalid directory throws
+TEST_F(FlightRecorderTest, dump_invalid_path) {
+  FlightRecorder recorder(1e-3, 4, "/nonexistent/dir");
+  recorder.Add(MakeStep(0, 5));
+  EXPECT_THROW(recorder.Dump(), Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
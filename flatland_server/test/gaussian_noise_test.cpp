@@ -0,0 +1,132 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gaussian_noise_test.cpp
+ * @brief	 Unit tests for the gaussian noise generator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/gaussian_noise.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace flatland_server;
+
+// Test the samples have the expected mean and standard deviation
+TEST(GaussianNoiseTest, distribution) {
+  GaussianNoise noise(0.5, 42);
+  std::vector<float> v(200000);
+  noise.Fill(v.data(), v.size());
+
+  double sum = 0, sq_sum = 0;
+  unsigned int within_one = 0;
+  for (float x : v) {
+    EXPECT_TRUE(std::isfinite(x));
+    sum += x;
+    sq_sum += x * x;
+    if (std::fabs(x) < 0.5) within_one++;
+  }
+  double mean = sum / v.size();
+  double std_dev = std::sqrt(sq_sum / v.size() - mean * mean);
+
+  EXPECT_NEAR(mean, 0, 0.01);
+  EXPECT_NEAR(std_dev, 0.5, 0.01);
+  EXPECT_NEAR(within_one / double(v.size()), 0.6827, 0.01);
+}
+
+// Test the stream only depends on the seed and not on how it is drawn
+TEST(GaussianNoiseTest, reproducible) {
+  GaussianNoise a(1.0, 7), b(1.0, 7), c(1.0, 8);
+
+  std::vector<float> va(1000), vc(1000);
+  a.Fill(va.data(), va.size());
+  c.Fill(vc.data(), vc.size());
+
+  // draw in odd sized pieces mixed with single values
+  std::vector<float> vb;
+  unsigned int sizes[] = {1, 63, 3, 200, 0, 129, 64};
+  for (unsigned int n : sizes) {
+    std::vector<float> piece(n);
+    b.Fill(piece.data(), n);
+    vb.insert(vb.end(), piece.begin(), piece.end());
+    vb.push_back(b.Next());
+  }
+  while (vb.size() < va.size()) vb.push_back(b.Next());
+
+  unsigned int same_as_c = 0;
+  for (unsigned int i = 0; i < va.size(); i++) {
+    EXPECT_EQ(va[i], vb[i]) << "i=" << i;
+    if (va[i] == vc[i]) same_as_c++;
+  }
+  EXPECT_LT(same_as_c, 5u);
+
+  // the state only depends on the seed and the number of values drawn
+  EXPECT_EQ(a.GetState(), b.GetState());
+  EXPECT_NE(a.GetState(), c.GetState());
+  b.Next();
+  EXPECT_NE(a.GetState(), b.GetState());
+
+  // reseeding restarts the stream
+  a.Seed(7);
+  for (unsigned int i = 0; i < 100; i++) {
+    EXPECT_EQ(va[i], a.Next());
+  }
+}
+
+// Test adding noise
+TEST(GaussianNoiseTest, add) {
+  std::vector<float> v(100, 3.0f);
+
+  GaussianNoise none(0, 1);
+  none.Add(v.data(), v.size());
+  for (float x : v) EXPECT_EQ(3.0f, x);
+
+  GaussianNoise noise(0.1, 1), ref(0.1, 1);
+  noise.Add(v.data(), v.size());
+  for (float x : v) EXPECT_EQ(3.0f + ref.Next(), x);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 geometry_stream_test.cpp
+ * @brief	 Test the packing of the geometry stream
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/geometry_stream.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace flatland_server;
+
+class GeometryStreamTest : public ::testing::Test {
+ protected:
+  b2World world;
+  b2Body *body;
+  b2Transform identity;
+
+  GeometryStreamTest() : world(b2Vec2(0, 0)) {
+    b2BodyDef def;
+    def.type = b2_dynamicBody;
+    def.position.Set(5, 5);
+    body = world.CreateBody(&def);
+    identity.SetIdentity();
+  }
+};
+
+// Test that each shape is outlined with closed segments
+TEST_F(GeometryStreamTest, outline) {
+  b2PolygonShape box;
+  box.SetAsBox(1, 0.5);
+  body->CreateFixture(&box, 1);
+  std::vector<float> segments;
+  GeometryStream::AppendOutline(body, identity, &segments);
+  ASSERT_EQ(segments.size(), 16u);
+  for (size_t i = 0; i < 4; i++) {
+    // each segment ends where the next one starts
+    size_t next = (i + 1) % 4;
+    EXPECT_FLOAT_EQ(segments[4 * i + 2], segments[4 * next]);
+    EXPECT_FLOAT_EQ(segments[4 * i + 3], segments[4 * next + 1]);
+    EXPECT_FLOAT_EQ(std::abs(segments[4 * i]), 1);
+    EXPECT_FLOAT_EQ(std::abs(segments[4 * i + 1]), 0.5);
+  }
+
+  b2CircleShape circle;
+  circle.m_p.Set(1, 0);
+  circle.m_radius = 0.25;
+  body->CreateFixture(&circle, 1);
+  b2Vec2 chain_points[3] = {b2Vec2(0, 0), b2Vec2(1, 0), b2Vec2(1, 1)};
+  b2ChainShape chain;
+  chain.CreateChain(chain_points, 3);
+  body->CreateFixture(&chain, 1);
+  segments.clear();
+  GeometryStream::AppendOutline(body, identity, &segments);
+  EXPECT_EQ(segments.size(),
+            4u * (4 + GeometryStream::CIRCLE_SEGMENTS + 2));
+}
+
+// Test that the segments are moved by the transform
+TEST_F(GeometryStreamTest, transform) {
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(0, 0), b2Vec2(1, 0));
+  body->CreateFixture(&edge, 1);
+  std::vector<float> segments;
+  GeometryStream::AppendOutline(body, body->GetTransform(), &segments);
+  ASSERT_EQ(segments.size(), 4u);
+  EXPECT_FLOAT_EQ(segments[0], 5);
+  EXPECT_FLOAT_EQ(segments[1], 5);
+  EXPECT_FLOAT_EQ(segments[2], 6);
+  EXPECT_FLOAT_EQ(segments[3], 5);
+}
+
+// Test that the bodies index the segments appended before them
+TEST_F(GeometryStreamTest, append_body) {
+  flatland_msgs::WorldGeometry msg;
+  msg.segments.assign(8, 0);
+  GeometryStream::AppendBody("layer/walls", Color(1, 0, 0.5, 1), &msg);
+  msg.segments.resize(20, 0);
+  GeometryStream::AppendBody("robot/base", Color(0, 1, 0, 2), &msg);
+
+  ASSERT_EQ(msg.names.size(), 2u);
+  EXPECT_EQ(msg.names[1], "robot/base");
+  ASSERT_EQ(msg.segment_ends.size(), 2u);
+  EXPECT_EQ(msg.segment_ends[0], 2u);
+  EXPECT_EQ(msg.segment_ends[1], 5u);
+  std::vector<uint8_t> colors = {255, 0, 128, 255, 0, 255, 0, 255};
+  EXPECT_EQ(msg.colors, colors);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -46,6 +46,7 @@
 
 #include "flatland_server/geometry.h"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
 
 // Test the CreateTransform method
@@ -95,6 +96,155 @@ TEST(TestSuite, testTransformTranslateAndRotate) {
   EXPECT_NEAR(out.y, -1.0, 1e-5);
 }
 
+// Test the batch transforms against the single point Transform, with a point
+// count that exercises both the vector lanes and the scalar remainder
+TEST(TestSuite, testTransformPoints) {
+  flatland_server::RotateTranslate rt =
+      flatland_server::Geometry::CreateTransform(1.0, -2.5, 0.7);
+
+  std::vector<b2Vec2> in, out(13), back(13);
+  std::vector<float> x, y, out_x(13), out_y(13);
+  for (int i = 0; i < 13; i++) {
+    in.push_back(b2Vec2(0.5 * i - 3.0, 1.5 - 0.25 * i));
+    x.push_back(in.back().x);
+    y.push_back(in.back().y);
+  }
+
+  flatland_server::Geometry::TransformPoints(rt, in.data(), in.size(),
+                                             out.data());
+  flatland_server::Geometry::TransformPoints(rt, x.data(), y.data(), x.size(),
+                                             out_x.data(), out_y.data());
+  flatland_server::Geometry::InverseTransformPoints(rt, out.data(), out.size(),
+                                                    back.data());
+
+  for (int i = 0; i < 13; i++) {
+    b2Vec2 expected = flatland_server::Geometry::Transform(in[i], rt);
+    EXPECT_NEAR(out[i].x, expected.x, 1e-5);
+    EXPECT_NEAR(out[i].y, expected.y, 1e-5);
+    EXPECT_NEAR(out_x[i], expected.x, 1e-5);
+    EXPECT_NEAR(out_y[i], expected.y, 1e-5);
+    EXPECT_NEAR(back[i].x, in[i].x, 1e-5);
+    EXPECT_NEAR(back[i].y, in[i].y, 1e-5);
+  }
+}
+
+// Test linking segments into closed and open polylines
+TEST(TestSuite, testLinkSegments) {
+  using flatland_server::LineSegment;
+  using flatland_server::Vec2;
+
+  // a square with segments in random directions and order, and an L shape
+  std::vector<LineSegment> segments = {
+      LineSegment(Vec2(0, 0), Vec2(2, 0)), LineSegment(Vec2(5, 5), Vec2(6, 5)),
+      LineSegment(Vec2(2, 2), Vec2(2, 0)), LineSegment(Vec2(0, 2), Vec2(0, 0)),
+      LineSegment(Vec2(5, 4), Vec2(5, 5)), LineSegment(Vec2(2, 2), Vec2(0, 2))};
+
+  std::vector<std::vector<b2Vec2>> closed, open;
+  flatland_server::Geometry::LinkSegments(segments, &closed, &open);
+
+  ASSERT_EQ(closed.size(), 1u);
+  ASSERT_EQ(closed[0].size(), 4u);
+  // consecutive vertices of the loop are one side apart
+  for (unsigned int i = 0; i < 4; i++) {
+    EXPECT_NEAR(b2Distance(closed[0][i], closed[0][(i + 1) % 4]), 2, 1e-5);
+  }
+
+  ASSERT_EQ(open.size(), 1u);
+  ASSERT_EQ(open[0].size(), 3u);
+  EXPECT_NEAR(open[0][1].x, 5, 1e-5);
+  EXPECT_NEAR(open[0][1].y, 5, 1e-5);
+}
+
+// Test the Douglas-Peucker simplification
+TEST(TestSuite, testSimplifyPolyline) {
+  // a staircase of small steps along the diagonal
+  std::vector<b2Vec2> stairs;
+  for (int i = 0; i < 10; i++) {
+    stairs.push_back(b2Vec2(i * 0.1, i * 0.1));
+    stairs.push_back(b2Vec2((i + 1) * 0.1, i * 0.1));
+  }
+  stairs.push_back(b2Vec2(1, 1));
+
+  std::vector<b2Vec2> exact =
+      flatland_server::Geometry::SimplifyPolyline(stairs, 0, false);
+  EXPECT_EQ(exact.size(), stairs.size());
+
+  std::vector<b2Vec2> simple =
+      flatland_server::Geometry::SimplifyPolyline(stairs, 0.1, false);
+  ASSERT_EQ(simple.size(), 2u);
+  EXPECT_NEAR(simple[1].x, 1, 1e-5);
+
+  // collinear vertices of a square loop are removed with zero tolerance
+  std::vector<b2Vec2> square = {b2Vec2(0, 0), b2Vec2(1, 0), b2Vec2(2, 0),
+                                b2Vec2(2, 2), b2Vec2(1, 2), b2Vec2(0, 2),
+                                b2Vec2(0, 1)};
+  std::vector<b2Vec2> loop =
+      flatland_server::Geometry::SimplifyPolyline(square, 0, true);
+  EXPECT_EQ(loop.size(), 4u);
+}
+
+// Twice the signed area of a polygon
+static double DoubleArea(const std::vector<b2Vec2> &polygon) {
+  double area = 0;
+  for (size_t i = 0; i < polygon.size(); i++) {
+    area += b2Cross(polygon[i], polygon[(i + 1) % polygon.size()]);
+  }
+  return area;
+}
+
+// Test the convexity check
+TEST(TestSuite, testIsConvex) {
+  std::vector<b2Vec2> square = {b2Vec2(0, 0), b2Vec2(1, 0), b2Vec2(2, 0),
+                                b2Vec2(2, 2), b2Vec2(0, 2)};
+  EXPECT_TRUE(flatland_server::Geometry::IsConvex(square));
+  std::reverse(square.begin(), square.end());
+  EXPECT_TRUE(flatland_server::Geometry::IsConvex(square));
+
+  std::vector<b2Vec2> l_shape = {b2Vec2(0, 0), b2Vec2(2, 0), b2Vec2(2, 1),
+                                 b2Vec2(1, 1), b2Vec2(1, 2), b2Vec2(0, 2)};
+  EXPECT_FALSE(flatland_server::Geometry::IsConvex(l_shape));
+}
+
+// Test the decomposition of polygons into convex pieces
+TEST(TestSuite, testDecomposePolygon) {
+  std::vector<std::vector<b2Vec2>> pieces;
+
+  // an L shape is two rectangles, given clockwise
+  std::vector<b2Vec2> l_shape = {b2Vec2(0, 2), b2Vec2(1, 2), b2Vec2(1, 1),
+                                 b2Vec2(2, 1), b2Vec2(2, 0), b2Vec2(0, 0)};
+  ASSERT_TRUE(
+      flatland_server::Geometry::DecomposePolygon(l_shape, 8, &pieces));
+  EXPECT_EQ(pieces.size(), 2u);
+  double area = 0;
+  for (const auto &piece : pieces) {
+    EXPECT_TRUE(flatland_server::Geometry::IsConvex(piece));
+    EXPECT_GT(DoubleArea(piece), 0);
+    area += DoubleArea(piece) / 2;
+  }
+  EXPECT_NEAR(area, 3, 1e-5);
+
+  // a convex polygon with too many vertices is split into pieces of at most 8
+  std::vector<b2Vec2> circle;
+  for (int i = 0; i < 32; i++) {
+    circle.push_back(
+        b2Vec2(std::cos(i * 2 * M_PI / 32), std::sin(i * 2 * M_PI / 32)));
+  }
+  ASSERT_TRUE(flatland_server::Geometry::DecomposePolygon(circle, 8, &pieces));
+  EXPECT_EQ(pieces.size(), 5u);
+  area = 0;
+  for (const auto &piece : pieces) {
+    EXPECT_LE(piece.size(), 8u);
+    EXPECT_TRUE(flatland_server::Geometry::IsConvex(piece));
+    area += DoubleArea(piece) / 2;
+  }
+  EXPECT_NEAR(area, DoubleArea(circle) / 2, 1e-4);
+
+  // self intersecting polygons are rejected
+  std::vector<b2Vec2> bowtie = {b2Vec2(0, 0), b2Vec2(1, 1), b2Vec2(1, 0),
+                                b2Vec2(0, 1)};
+  EXPECT_FALSE(flatland_server::Geometry::DecomposePolygon(bowtie, 8, &pieces));
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,162 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 gps_batch_test.cpp
+ * @brief	 Test the batch GPS conversion
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/gps_batch.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace flatland_server;
+
+/**
+ * The conversion of a single point before the batch, with many iterations
+ * of the latitude
+ */
+static void ReferenceConvert(double ref_lat, double ref_lon, double x,
+                             double y, double *lat, double *lon) {
+  const double a = 6378137.0, e2 = 0.0066943799831668;
+  double n = a / sqrt(1.0 - e2 * sin(ref_lat) * sin(ref_lat));
+  double rx = n * cos(ref_lat) * cos(ref_lon);
+  double ry = n * cos(ref_lat) * sin(ref_lon);
+  double rz = n * (1.0 - e2) * sin(ref_lat);
+  double ex = rx - sin(ref_lon) * x - sin(ref_lat) * cos(ref_lon) * y;
+  double ey = ry + cos(ref_lon) * x - sin(ref_lat) * sin(ref_lon) * y;
+  double ez = rz + cos(ref_lat) * y;
+  *lon = atan2(ey, ex) * 180.0 * M_1_PI;
+  double p = sqrt(ex * ex + ey * ey);
+  double lat_rad = atan(p / ez);
+  for (unsigned int i = 0; i < 20; i++) {
+    double r = a / sqrt(1.0 - e2 * sin(lat_rad) * sin(lat_rad));
+    double alt = p / cos(lat_rad) - r;
+    lat_rad = atan(ez / p / (1 - e2 * r / (r + alt)));
+  }
+  *lat = lat_rad * 180.0 * M_1_PI;
+}
+
+// Test the batch conversion against the converged reference
+TEST(GpsBatchTest, convert) {
+  const double refs[][2] = {{0, 0}, {43.5, -80.5}, {-33.9, 151.2}, {78, 15}};
+  const double points[][2] = {{0, 0}, {100, -50}, {-2000, 3500}, {1e4, 1e4}};
+  std::vector<double> x, y;
+  std::vector<GpsReference> references;
+  for (const auto &ref : refs) {
+    for (const auto &point : points) {
+      references.emplace_back(ref[0] * M_PI / 180, ref[1] * M_PI / 180);
+      x.push_back(point[0]);
+      y.push_back(point[1]);
+    }
+  }
+
+  std::vector<double> lat(x.size()), lon(x.size());
+  GpsBatch::Convert(x.size(), x.data(), y.data(), references.data(),
+                    lat.data(), lon.data());
+  for (size_t i = 0; i < x.size(); i++) {
+    const double *ref = refs[i / 4];
+    double expected_lat, expected_lon;
+    ReferenceConvert(ref[0] * M_PI / 180, ref[1] * M_PI / 180, x[i], y[i],
+                     &expected_lat, &expected_lon);
+    // 1e-9 degrees is about 0.1 mm
+    EXPECT_NEAR(lat[i], expected_lat, 1e-9) << i;
+    EXPECT_NEAR(lon[i], expected_lon, 1e-9) << i;
+  }
+}
+
+// Test the receivers are converted from the body states
+TEST(GpsBatchTest, receivers) {
+  b2World world(b2Vec2(0, 0));
+  BodyStates states;
+  GpsBatch batch;
+  batch.SetBodyStates(&states);
+
+  Body *a = new Body(&world, nullptr, "a", Color(1, 1, 1, 1),
+                     Pose(10, 20, M_PI / 2), b2_dynamicBody, YAML::Node());
+  Body *b = new Body(&world, nullptr, "b", Color(1, 1, 1, 1),
+                     Pose(-5, 0, 0), b2_dynamicBody, YAML::Node());
+  states.Add(a);
+  states.Add(b);
+
+  GpsReference reference(0.75, -1.4);
+  int id_a = batch.Add(a, b2Vec2(1, 0), reference);
+  int id_b = batch.Add(b, b2Vec2(0, 0), reference);
+  EXPECT_EQ(batch.Size(), 2u);
+
+  // a is rotated by 90 degrees, its offset points north
+  auto expect_fix = [&](int id, double x, double y) {
+    double lat, lon;
+    GpsBatch::Convert(1, &x, &y, &reference, &lat, &lon);
+    GpsBatch::Fix fix = batch.Get(id);
+    EXPECT_NEAR(fix.latitude, lat, 1e-9);
+    EXPECT_NEAR(fix.longitude, lon, 1e-9);
+  };
+  expect_fix(id_a, 10, 21);
+  expect_fix(id_b, -5, 0);
+
+  // moves are only seen after a refresh of the states
+  b->physics_body_->SetTransform(b2Vec2(3, 4), 0);
+  expect_fix(id_b, -5, 0);
+  states.Refresh();
+  expect_fix(id_b, 3, 4);
+  expect_fix(id_a, 10, 21);
+
+  // removed ids are reused
+  batch.Remove(id_a);
+  EXPECT_EQ(batch.Size(), 1u);
+  int id_c = batch.Add(b, b2Vec2(0, 1), reference);
+  EXPECT_EQ(id_c, id_a);
+  expect_fix(id_c, 3, 5);
+
+  states.Remove(a);
+  states.Remove(b);
+  delete a;
+  delete b;
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
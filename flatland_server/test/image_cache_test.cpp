@@ -0,0 +1,195 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_cache_test.cpp
+ * @brief	 Test the cache of decoded map images
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/image_cache.h>
+#include <flatland_server/layer.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class ImageCacheTest : public ::testing::Test {
+ public:
+  fs::path dir;
+  std::string path;
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    path = (dir / "map.png").string();
+    ImageCache::Get().Clear();
+    ImageCache::Get().SetCapacity(ImageCache::DEFAULT_CAPACITY);
+  }
+
+  void TearDown() override {
+    ImageCache::Get().Clear();
+    fs::remove_all(dir);
+  }
+
+  /**
+   * @brief Write a gradient image, each pixel is its column plus an offset
+   */
+  void WriteImage(const std::string &file, int rows, int offset) {
+    cv::Mat image(rows, 200, CV_8UC1);
+    for (int i = 0; i < image.rows; i++) {
+      for (int j = 0; j < image.cols; j++) {
+        image.at<uint8_t>(i, j) = uint8_t(j + offset);
+      }
+    }
+    ASSERT_TRUE(cv::imwrite(file, image));
+  }
+
+  /**
+   * @brief Move the modification time of a file, so that a rewrite within
+   * the resolution of the file system is seen as a change
+   */
+  void Touch(const std::string &file, std::time_t time) {
+    fs::last_write_time(file, time);
+  }
+};
+
+// Test that an image is decoded once and shared between the loads
+TEST_F(ImageCacheTest, shared) {
+  WriteImage(path, 10, 0);
+  std::shared_ptr<const cv::Mat> a = ImageCache::Get().Load(path);
+  std::shared_ptr<const cv::Mat> b = ImageCache::Get().Load(path);
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a->type(), CV_8UC1);
+  EXPECT_EQ(a->at<uint8_t>(3, 42), 42);
+
+  ImageCache::Stats stats = ImageCache::Get().GetStats();
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.images, 1u);
+  EXPECT_EQ(stats.bytes, 2000u);
+}
+
+// Test that an image is decoded again once its file changes
+TEST_F(ImageCacheTest, modified) {
+  WriteImage(path, 10, 0);
+  Touch(path, 1000);
+  std::shared_ptr<const cv::Mat> a = ImageCache::Get().Load(path);
+  WriteImage(path, 10, 1);
+  Touch(path, 2000);
+  std::shared_ptr<const cv::Mat> b = ImageCache::Get().Load(path);
+  ASSERT_NE(b, nullptr);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(a->at<uint8_t>(0, 42), 42);
+  EXPECT_EQ(b->at<uint8_t>(0, 42), 43);
+  EXPECT_EQ(ImageCache::Get().GetStats().images, 1u);
+}
+
+// Test that missing and invalid files are not cached
+TEST_F(ImageCacheTest, invalid) {
+  EXPECT_EQ(ImageCache::Get().Load((dir / "missing.png").string()), nullptr);
+  std::string text = (dir / "text.png").string();
+  std::ofstream(text) << "not an image";
+  EXPECT_EQ(ImageCache::Get().Load(text), nullptr);
+  EXPECT_EQ(ImageCache::Get().GetStats().images, 0u);
+}
+
+// Test that the least recently used images are dropped beyond the capacity
+TEST_F(ImageCacheTest, capacity) {
+  std::string other = (dir / "other.png").string();
+  std::string large = (dir / "large.png").string();
+  WriteImage(path, 10, 0);
+  WriteImage(other, 10, 0);
+  WriteImage(large, 30, 0);
+  ImageCache::Get().SetCapacity(5000);
+
+  std::shared_ptr<const cv::Mat> a = ImageCache::Get().Load(path);
+  ImageCache::Get().Load(other);
+  ImageCache::Get().Load(path);
+  ImageCache::Get().Load(large);  // 6000 bytes, decoded but not kept
+  EXPECT_EQ(ImageCache::Get().GetStats().images, 2u);
+
+  WriteImage(large, 15, 0);  // 3000 bytes, drops other
+  Touch(large, 1000);
+  ImageCache::Get().Load(large);
+  EXPECT_EQ(ImageCache::Get().GetStats().images, 2u);
+  EXPECT_EQ(ImageCache::Get().GetStats().bytes, 5000u);
+  EXPECT_EQ(ImageCache::Get().Load(path), a);
+
+  ImageCache::Get().SetCapacity(0);
+  EXPECT_EQ(ImageCache::Get().GetStats().images, 0u);
+  EXPECT_EQ(a->rows, 10);
+}
+
+// Test that thresholding the 8 bit image extracts the same geometry as
+// thresholding its float conversion
+TEST_F(ImageCacheTest, threshold_8bit) {
+  WriteImage(path, 10, 0);
+  std::shared_ptr<const cv::Mat> image = ImageCache::Get().Load(path);
+  cv::Mat bitmap;
+  image->convertTo(bitmap, CV_32FC1, 1.0 / 255.0);
+
+  for (double thresh : {-0.5, 0.0, 0.196, 0.65, 199 / 255.0, 1.0, 1.5}) {
+    std::vector<LayerCache::Run> runs_8bit, runs_float;
+    std::unique_ptr<OccupancyGrid> grid_8bit(
+        Layer::ExtractRuns(*image, thresh, 0.05, &runs_8bit));
+    std::unique_ptr<OccupancyGrid> grid_float(
+        Layer::ExtractRuns(bitmap, thresh, 0.05, &runs_float));
+    EXPECT_EQ(grid_8bit->GetData(), grid_float->GetData()) << thresh;
+    ASSERT_EQ(runs_8bit.size(), runs_float.size()) << thresh;
+    for (size_t i = 0; i < runs_8bit.size(); i++) {
+      EXPECT_EQ(runs_8bit[i].x1, runs_float[i].x1);
+      EXPECT_EQ(runs_8bit[i].y1, runs_float[i].y1);
+      EXPECT_EQ(runs_8bit[i].x2, runs_float[i].x2);
+      EXPECT_EQ(runs_8bit[i].y2, runs_float[i].y2);
+    }
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
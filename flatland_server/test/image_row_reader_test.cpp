@@ -0,0 +1,183 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 image_row_reader_test.cpp
+ * @brief	 Test the row by row decoding of map images
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/image_row_reader.h>
+#include <flatland_server/layer.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <random>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class ImageRowReaderTest : public ::testing::Test {
+ public:
+  fs::path this_file_dir;
+  fs::path dir;
+
+  void SetUp() override {
+    this_file_dir = fs::path(__FILE__).parent_path();
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+
+  /**
+   * @brief Make an image of random blocks of random grey levels, with some
+   * single pixels in between
+   */
+  cv::Mat MakeImage(int rows, int cols) {
+    std::mt19937 rng(rows * cols);
+    cv::Mat image(rows, cols, CV_8UC1, cv::Scalar(255));
+    for (int k = 0; k < rows * cols / 50; k++) {
+      cv::Rect block(rng() % cols, rng() % rows, 1 + rng() % 12,
+                     1 + rng() % 12);
+      image(block & cv::Rect(0, 0, cols, rows)).setTo(rng() % 256);
+    }
+    return image;
+  }
+
+  /**
+   * @brief Check that an image is read row by row as cv::imread decodes it
+   */
+  void ExpectRows(const std::string &path) {
+    cv::Mat expected = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    ImageRowReader reader;
+    ASSERT_TRUE(reader.Open(path)) << path;
+    ASSERT_EQ(reader.GetCols(), expected.cols);
+    ASSERT_EQ(reader.GetRows(), expected.rows);
+    std::vector<uint8_t> row(reader.GetCols());
+    for (int i = 0; i < reader.GetRows(); i++) {
+      reader.ReadRow(row.data());
+      ASSERT_TRUE(std::equal(row.begin(), row.end(), expected.ptr<uint8_t>(i)))
+          << path << " row " << i;
+    }
+  }
+};
+
+// Test that greyscale PNG and PGM images are read as cv::imread decodes them
+TEST_F(ImageRowReaderTest, rows) {
+  ExpectRows((this_file_dir / "conestogo_office_test/map.png").string());
+
+  cv::Mat image = MakeImage(300, 517);
+  std::string png = (dir / "map.png").string();
+  std::string pgm = (dir / "map.pgm").string();
+  std::string bilevel = (dir / "bilevel.png").string();
+  ASSERT_TRUE(cv::imwrite(png, image));
+  ASSERT_TRUE(cv::imwrite(pgm, image));
+  ASSERT_TRUE(cv::imwrite(bilevel, image, {cv::IMWRITE_PNG_BILEVEL, 1}));
+  ExpectRows(png);
+  ExpectRows(pgm);
+  ExpectRows(bilevel);
+}
+
+// Test that the images that cannot be read row by row are left to a whole
+// decode, and that truncated images throw
+TEST_F(ImageRowReaderTest, unsupported) {
+  cv::Mat colour(20, 30, CV_8UC3, cv::Scalar(10, 20, 30));
+  std::string png = (dir / "colour.png").string();
+  std::string text = (dir / "text.png").string();
+  ASSERT_TRUE(cv::imwrite(png, colour));
+  std::ofstream(text) << "not an image";
+  EXPECT_FALSE(ImageRowReader().Open(png));
+  EXPECT_FALSE(ImageRowReader().Open(text));
+  EXPECT_FALSE(ImageRowReader().Open((dir / "missing.png").string()));
+
+  std::string truncated = (dir / "truncated.png").string();
+  ASSERT_TRUE(cv::imwrite(truncated, MakeImage(300, 517)));
+  fs::resize_file(truncated, fs::file_size(truncated) / 2);
+  ImageRowReader reader;
+  ASSERT_TRUE(reader.Open(truncated));
+  std::vector<uint8_t> row(reader.GetCols());
+  EXPECT_THROW(
+      {
+        for (int i = 0; i < reader.GetRows(); i++) {
+          reader.ReadRow(row.data());
+        }
+      },
+      Exception);
+}
+
+// Test that the edges extracted row by row are the edges extracted from the
+// whole image, across several bands of rows
+TEST_F(ImageRowReaderTest, stream_runs) {
+  cv::Mat image = MakeImage(700, 333);
+  std::string path = (dir / "map.png").string();
+  ASSERT_TRUE(cv::imwrite(path, image));
+
+  for (double thresh : {0.0, 0.196, 0.65, 1.5}) {
+    std::vector<LayerCache::Run> expected, runs;
+    std::unique_ptr<OccupancyGrid> expected_grid(
+        Layer::ExtractRuns(image, thresh, 0.05, &expected));
+    ImageRowReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    std::unique_ptr<OccupancyGrid> grid(
+        Layer::StreamRuns(reader, thresh, 0.05, &runs));
+
+    EXPECT_EQ(grid->GetWidth(), expected_grid->GetWidth());
+    EXPECT_EQ(grid->GetHeight(), expected_grid->GetHeight());
+    EXPECT_EQ(grid->GetData(), expected_grid->GetData()) << thresh;
+    ASSERT_EQ(runs.size(), expected.size()) << thresh;
+    for (size_t i = 0; i < runs.size(); i++) {
+      EXPECT_EQ(runs[i].x1, expected[i].x1);
+      EXPECT_EQ(runs[i].y1, expected[i].y1);
+      EXPECT_EQ(runs[i].x2, expected[i].x2);
+      EXPECT_EQ(runs[i].y2, expected[i].y2);
+    }
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 kinematic_animator_test.cpp
+ * @brief	 Test the animator of kinematic bodies
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/kinematic_animator.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace flatland_server;
+
+static double Linear(double p) { return p; }
+static double Quadratic(double p) { return p * p; }
+
+class KinematicAnimatorTest : public ::testing::Test {
+ public:
+  b2World world;
+  KinematicAnimator animator;
+  Body *body;
+
+  KinematicAnimatorTest() : world(b2Vec2(0, 0)) {
+    body = new Body(&world, nullptr, "body", Color(1, 1, 1, 1),
+                    Pose(0, 0, 0), b2_kinematicBody, YAML::Node());
+  }
+
+  ~KinematicAnimatorTest() { delete body; }
+
+  /// Step and check the x of the body
+  void ExpectSteps(const std::vector<double> &xs) {
+    for (double x : xs) {
+      animator.Step(0.5);
+      EXPECT_NEAR(body->physics_body_->GetPosition().x, x, 1e-5);
+    }
+  }
+};
+
+// Test the tracks that turn around or jump back at the ends
+TEST_F(KinematicAnimatorTest, yoyo_loop) {
+  int id = animator.Add(body, Pose(0, 0, 0), Pose(10, 10, 1), 1,
+                        KinematicAnimator::Mode::YOYO, Linear, false);
+  ExpectSteps({5, 10, 5, 0, 5});
+  EXPECT_NEAR(body->physics_body_->GetPosition().y, 5, 1e-5);
+  EXPECT_NEAR(body->physics_body_->GetAngle(), 0.5, 1e-5);
+  animator.Remove(id);
+  EXPECT_EQ(animator.Size(), 0u);
+
+  animator.Add(body, Pose(0, 0, 0), Pose(10, 10, 1), 2,
+               KinematicAnimator::Mode::LOOP, Linear, false);
+  ExpectSteps({2.5, 5, 7.5, 10, 2.5, 5});
+}
+
+// Test the tracks that stop at the ends are skipped
+TEST_F(KinematicAnimatorTest, once_trigger) {
+  int id = animator.Add(body, Pose(2, 1, 0), Pose(1, 3, 2), 1,
+                        KinematicAnimator::Mode::ONCE, Linear, false);
+  ExpectSteps({2.5, 3});
+  EXPECT_EQ(animator.Moved(), 1u);
+  ExpectSteps({3});
+  EXPECT_EQ(animator.Moved(), 0u);
+  animator.Remove(id);
+
+  // the first step is forward, then the trigger decides
+  id = animator.Add(body, Pose(0, 0, 0), Pose(10, 0, 0), 1,
+                    KinematicAnimator::Mode::TRIGGER, Linear, false);
+  ExpectSteps({5, 0, 0});
+  EXPECT_EQ(animator.Moved(), 0u);
+  animator.SetTriggered(id, true);
+  ExpectSteps({0, 5, 10, 10});
+  animator.SetTriggered(id, false);
+  ExpectSteps({10, 5});
+}
+
+// Test the easing tables are close to the easing
+TEST_F(KinematicAnimatorTest, table) {
+  b2World other_world(b2Vec2(0, 0));
+  Body *other = new Body(&other_world, nullptr, "other", Color(1, 1, 1, 1),
+                         Pose(0, 0, 0), b2_kinematicBody, YAML::Node());
+  animator.Add(body, Pose(0, 0, 0), Pose(10, 0, 0), 3.3,
+               KinematicAnimator::Mode::YOYO, Quadratic, false);
+  animator.Add(other, Pose(0, 0, 0), Pose(10, 0, 0), 3.3,
+               KinematicAnimator::Mode::YOYO, Quadratic, true);
+  for (int i = 0; i < 100; i++) {
+    animator.Step(0.1);
+    EXPECT_NEAR(body->physics_body_->GetPosition().x,
+                other->physics_body_->GetPosition().x, 1e-4);
+  }
+  delete other;
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
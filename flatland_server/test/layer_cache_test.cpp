@@ -0,0 +1,167 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_cache_test.cpp
+ * @brief	 Unit tests for the layer geometry cache
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/layer_cache.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <memory>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class LayerCacheTest : public ::testing::Test {
+ public:
+  fs::path dir;
+  std::string path;
+  std::vector<LayerCache::Run> runs;
+  OccupancyGrid grid;
+
+  LayerCacheTest() : grid(70, 2, 0.05) {}
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    path = (dir / "map.png.geometry").string();
+
+    runs.push_back({0, 0, 70, 0});
+    runs.push_back({0, 2, 70, 2});
+    runs.push_back({0, 0, 0, 2});
+    runs.push_back({70, 0, 70, 2});
+    grid.SetOccupied(0, 0, true);
+    grid.SetOccupied(66, 1, true);
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+
+  void WriteFile(const std::string &file, const std::string &content) {
+    std::ofstream out(file, std::ios::binary);
+    out << content;
+  }
+};
+
+// Test that the cached geometry reads back as it was written
+TEST_F(LayerCacheTest, round_trip) {
+  ASSERT_TRUE(LayerCache::Write(path, 42, runs, grid));
+  ASSERT_TRUE(LayerCache::Write(path, 42, runs, grid));
+
+  // the temporary files are renamed to the cache file
+  std::vector<fs::path> files(fs::directory_iterator(dir),
+                              fs::directory_iterator{});
+  ASSERT_EQ(files.size(), 1);
+  EXPECT_EQ(files[0].string(), path);
+  EXPECT_EQ(fs::status(path).permissions() & fs::owner_read, fs::owner_read);
+
+  LayerCache cache;
+  ASSERT_TRUE(cache.Open(path, 42));
+  EXPECT_EQ(cache.GetRows(), 2u);
+  ASSERT_EQ(cache.GetRunCount(), 4u);
+  EXPECT_EQ(cache.GetRuns()[1].y1, 2);
+  EXPECT_EQ(cache.GetRuns()[3].x2, 70);
+
+  std::unique_ptr<OccupancyGrid> loaded(cache.MakeGrid());
+  EXPECT_EQ(loaded->GetWidth(), 70u);
+  EXPECT_EQ(loaded->GetHeight(), 2u);
+  EXPECT_DOUBLE_EQ(loaded->GetResolution(), 0.05);
+  EXPECT_EQ(loaded->GetData(), grid.GetData());
+}
+
+// Test that stale and damaged caches are rejected
+TEST_F(LayerCacheTest, invalid_cache) {
+  LayerCache cache;
+  EXPECT_FALSE(cache.Open(path, 42));
+
+  ASSERT_TRUE(LayerCache::Write(path, 42, runs, grid));
+  EXPECT_FALSE(cache.Open(path, 43));
+
+  fs::resize_file(path, fs::file_size(path) - 1);
+  EXPECT_FALSE(cache.Open(path, 42));
+
+  WriteFile(path, "not a geometry cache, but long enough for a header");
+  EXPECT_FALSE(cache.Open(path, 42));
+}
+
+// Test that the key depends on the image content and the parameters
+TEST_F(LayerCacheTest, key) {
+  std::string image = (dir / "map.png").string();
+  WriteFile(image, "image a");
+  uint64_t hash_a = LayerCache::HashFile(image);
+  WriteFile(image, "image b");
+  uint64_t hash_b = LayerCache::HashFile(image);
+  EXPECT_NE(hash_a, hash_b);
+  EXPECT_EQ(hash_b, LayerCache::HashFile(image));
+
+  uint64_t key = LayerCache::MakeKey(hash_a, 0.05, 0.65, {0, 0, 0});
+  EXPECT_EQ(key, LayerCache::MakeKey(hash_a, 0.05, 0.65, {0, 0, 0}));
+  EXPECT_NE(key, LayerCache::MakeKey(hash_b, 0.05, 0.65, {0, 0, 0}));
+  EXPECT_NE(key, LayerCache::MakeKey(hash_a, 0.1, 0.65, {0, 0, 0}));
+  EXPECT_NE(key, LayerCache::MakeKey(hash_a, 0.05, 0.5, {0, 0, 0}));
+  EXPECT_NE(key, LayerCache::MakeKey(hash_a, 0.05, 0.65, {0, 0, 1}));
+
+  EXPECT_THROW(LayerCache::HashFile((dir / "missing.png").string()),
+               Exception);
+}
+
+// Test that caches of an image with different keys have different paths
+TEST_F(LayerCacheTest, path) {
+  std::string image = (dir / "map.png").string();
+  EXPECT_EQ(LayerCache::MakePath(image, 0x2a),
+            image + ".000000000000002a.geometry");
+  EXPECT_NE(LayerCache::MakePath(image, 1), LayerCache::MakePath(image, 2));
+
+  ASSERT_TRUE(LayerCache::Write(LayerCache::MakePath(image, 1), 1, runs, grid));
+  ASSERT_TRUE(LayerCache::Write(LayerCache::MakePath(image, 2), 2, runs, grid));
+  LayerCache cache;
+  EXPECT_TRUE(cache.Open(LayerCache::MakePath(image, 1), 1));
+  EXPECT_TRUE(cache.Open(LayerCache::MakePath(image, 2), 2));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
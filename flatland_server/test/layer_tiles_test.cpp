@@ -0,0 +1,213 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 layer_tiles_test.cpp
+ * @brief	 Unit tests for layer tiles
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/layer_tiles.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace flatland_server;
+
+class LayerTilesTest : public ::testing::Test {
+ public:
+  b2World world;
+  b2Body *layer_body;
+  int user_data;
+  LayerTiles::Params params;
+
+  LayerTilesTest() : world(b2Vec2(0, 0)) {
+    b2BodyDef body_def;
+    body_def.position.Set(0, 0);
+    body_def.userData = &user_data;
+    layer_body = world.CreateBody(&body_def);
+
+    params.size = 1;
+    params.margin = 0.25;
+    params.timeout = 2;
+  }
+
+  // returns the region of a point in the world frame
+  b2AABB Region(float x, float y) {
+    b2AABB aabb;
+    aabb.lowerBound.Set(x, y);
+    aabb.upperBound.Set(x, y);
+    return aabb;
+  }
+
+  // returns the total length of the edges of the active tiles
+  double ActiveLength(const LayerTiles &tiles) {
+    double length = 0;
+    for (b2Body *body : tiles.GetActiveBodies()) {
+      for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+        b2EdgeShape *edge = dynamic_cast<b2EdgeShape *>(f->GetShape());
+        length += (edge->m_vertex2 - edge->m_vertex1).Length();
+      }
+    }
+    return length;
+  }
+};
+
+// Test that segments are split at the tile boundaries
+TEST_F(LayerTilesTest, split) {
+  LayerTiles tiles(&world, layer_body, 0x2, params);
+  tiles.AddSegment(b2Vec2(0.5, 0.5), b2Vec2(2.5, 0.5));
+  tiles.AddSegment(b2Vec2(0.5, 3.5), b2Vec2(1.5, 4.5));  // through a corner
+  tiles.AddSegment(b2Vec2(5, 5), b2Vec2(5, 6));  // on a boundary
+  EXPECT_EQ(tiles.GetTileCount(), 6u);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 0u);
+  EXPECT_EQ(world.GetBodyCount(), 1);
+
+  // a region covering everything activates all tiles
+  b2AABB all;
+  all.lowerBound.Set(-10, -10);
+  all.upperBound.Set(10, 10);
+  tiles.Update({all}, 0);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 6u);
+  EXPECT_EQ(world.GetBodyCount(), 7);
+  EXPECT_NEAR(ActiveLength(tiles), 2 + std::sqrt(2.0) + 1, 1e-5);
+
+  for (b2Body *body : tiles.GetActiveBodies()) {
+    EXPECT_EQ(body->GetType(), b2_staticBody);
+    EXPECT_EQ(body->GetUserData(), &user_data);
+    EXPECT_EQ(body->GetFixtureList()->GetFilterData().categoryBits, 0x2);
+    EXPECT_EQ(body->GetFixtureList()->GetFilterData().maskBits, 0x2);
+  }
+}
+
+// Test that tiles are activated near the regions and evicted after timeout
+TEST_F(LayerTilesTest, activate_and_evict) {
+  LayerTiles tiles(&world, layer_body, 0x1, params);
+  tiles.AddSegment(b2Vec2(0.5, 0.5), b2Vec2(2.5, 0.5));
+
+  tiles.Update({Region(0.5, 0.5)}, 0);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 1u);
+  EXPECT_NEAR(ActiveLength(tiles), 0.5, 1e-5);
+
+  // within the margin of the tile at [1, 2)
+  tiles.Update({Region(0.8, 0.5)}, 1);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 2u);
+
+  tiles.Update({Region(2.5, 0.5)}, 2.5);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 3u);
+
+  // the first two tiles were last touched at 1
+  tiles.Update({Region(2.5, 0.5)}, 3.5);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 1u);
+  EXPECT_NEAR(ActiveLength(tiles), 0.5, 1e-5);
+
+  tiles.Update({}, 6);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 0u);
+  EXPECT_EQ(world.GetBodyCount(), 1);
+}
+
+// Test that the tiles follow the transform of the layer body
+TEST_F(LayerTilesTest, transform) {
+  layer_body->SetTransform(b2Vec2(10, 0), M_PI / 2);
+  LayerTiles tiles(&world, layer_body, 0x1, params);
+  tiles.AddSegment(b2Vec2(0.5, 0.2), b2Vec2(0.5, 0.8));
+
+  // the tile [0, 1) x [0, 1) is now at [9, 10] x [0, 1] in the world, and the
+  // segment goes from (9.8, 0.5) to (9.2, 0.5)
+  tiles.Update({Region(5, 0.5)}, 0);
+  EXPECT_EQ(tiles.GetActiveTileCount(), 0u);
+  tiles.Update({Region(9.5, 0.5)}, 0);
+  ASSERT_EQ(tiles.GetActiveTileCount(), 1u);
+
+  b2Body *body = tiles.GetActiveBodies()[0];
+  EXPECT_NEAR(body->GetPosition().x, 10, 1e-5);
+  EXPECT_NEAR(body->GetAngle(), M_PI / 2, 1e-5);
+
+  b2RayCastInput input;
+  input.p1.Set(9.5, 0);
+  input.p2.Set(9.5, 1);
+  input.maxFraction = 1;
+  b2RayCastOutput output;
+  b2Fixture *f = body->GetFixtureList();
+  ASSERT_TRUE(f->RayCast(&output, input, 0));
+  EXPECT_NEAR(output.fraction, 0.5, 1e-5);
+}
+
+// Test that quantized tiles hold the same geometry as float tiles
+TEST_F(LayerTilesTest, quantized) {
+  params.size = 1.1;
+  params.quantum = 0.25;
+  LayerTiles tiles(&world, layer_body, 0x1, params);
+  EXPECT_EQ(tiles.GetParams().size, 1);
+  tiles.AddSegment(b2Vec2(0.25, 0.5), b2Vec2(2.75, 0.5));
+  tiles.AddSegment(b2Vec2(-0.5, -0.5), b2Vec2(0.5, 0.5));
+  tiles.AddSegment(b2Vec2(1, 2), b2Vec2(1, 3));  // on a boundary
+  EXPECT_EQ(tiles.GetTileCount(), 5u);
+
+  b2AABB all;
+  all.lowerBound.Set(-10, -10);
+  all.upperBound.Set(10, 10);
+  tiles.Update({all}, 0);
+  EXPECT_NEAR(ActiveLength(tiles), 2.5 + std::sqrt(2.0) + 1, 1e-5);
+
+  // the pieces meet exactly at the tile boundaries
+  std::vector<b2Vec2> points;
+  for (b2Body *body : tiles.GetActiveBodies()) {
+    for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+      b2EdgeShape *edge = dynamic_cast<b2EdgeShape *>(f->GetShape());
+      points.push_back(edge->m_vertex1);
+      points.push_back(edge->m_vertex2);
+    }
+  }
+  EXPECT_EQ(std::count(points.begin(), points.end(), b2Vec2(1, 0.5)), 2);
+  EXPECT_EQ(std::count(points.begin(), points.end(), b2Vec2(2, 0.5)), 2);
+  EXPECT_EQ(std::count(points.begin(), points.end(), b2Vec2(0, 0)), 2);
+
+  // too many quanta per tile for 16 bits
+  params.quantum = 1e-5;
+  EXPECT_EQ(LayerTiles(&world, layer_body, 0x1, params).GetParams().quantum,
+            0);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,112 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 line_segments_file_test.cpp
+ * @brief	 Unit tests for the binary line segments file format
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/line_segments_file.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class LineSegmentsFileTest : public ::testing::Test {
+ public:
+  fs::path dir;
+  std::string path;
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    path = (dir / "map_lines.bin").string();
+  }
+
+  void TearDown() override { fs::remove_all(dir); }
+};
+
+// Test that line segments read back as they were written
+TEST_F(LineSegmentsFileTest, round_trip) {
+  std::vector<LineSegment> line_segments = {
+      LineSegment(Vec2(1, 2), Vec2(3, 4)),
+      LineSegment(Vec2(-0.1, -0.2), Vec2(-0.3, -0.4))};
+  LineSegmentsFile::Write(path, line_segments);
+  EXPECT_TRUE(LineSegmentsFile::IsBinary(path));
+
+  LineSegmentsFile file;
+  file.Open(path);
+  ASSERT_EQ(file.GetCount(), 2u);
+  EXPECT_FLOAT_EQ(file.GetRecords()[0].x1, 1);
+  EXPECT_FLOAT_EQ(file.GetRecords()[0].y2, 4);
+  EXPECT_FLOAT_EQ(file.GetRecords()[1].y1, -0.2);
+  EXPECT_FLOAT_EQ(file.GetRecords()[1].x2, -0.3);
+
+  LineSegmentsFile::Write(path, {});
+  file.Open(path);
+  EXPECT_EQ(file.GetCount(), 0u);
+}
+
+// Test that text files and damaged files are rejected
+TEST_F(LineSegmentsFileTest, invalid_file) {
+  LineSegmentsFile file;
+  EXPECT_FALSE(LineSegmentsFile::IsBinary(path));
+  EXPECT_THROW(file.Open(path), Exception);
+
+  std::ofstream(path) << "0 0 1 1\n2 3 -1 2\n";
+  EXPECT_FALSE(LineSegmentsFile::IsBinary(path));
+  EXPECT_THROW(file.Open(path), Exception);
+
+  LineSegmentsFile::Write(path, {LineSegment(Vec2(1, 2), Vec2(3, 4))});
+  fs::resize_file(path, fs::file_size(path) - 1);
+  EXPECT_TRUE(LineSegmentsFile::IsBinary(path));
+  EXPECT_THROW(file.Open(path), Exception);
+  EXPECT_EQ(file.GetCount(), 0u);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
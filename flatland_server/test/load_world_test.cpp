@@ -51,9 +51,15 @@
 #include <flatland_server/geometry.h>
 #include <flatland_server/types.h>
 #include <flatland_server/world.h>
+#include <flatland_server/world_bundle.h>
 #include <gtest/gtest.h>
+#include <ros/topic.h>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <memory>
 #include <regex>
+#include <set>
 #include <string>
 
 namespace fs = boost::filesystem;
@@ -319,7 +325,7 @@ class LoadWorldTest : public ::testing::Test {
   }
 
   bool FixtureEq(b2Fixture *f, bool is_sensor, int group_index,
-                 uint16_t category_bits, uint16_t mask_bits, double density,
+                 uint32_t category_bits, uint32_t mask_bits, double density,
                  double friction, double restitution) {
     if (f->IsSensor() != is_sensor) {
       printf("is_sensor Actual:%d != Expected:%d\n", f->IsSensor(), is_sensor);
@@ -652,9 +658,10 @@ TEST_F(LoadWorldTest, simple_test_A) {
                      {1, 1, 0, 0.25}, 0.1, 0.125));
   auto fs = GetBodyFixtures(m0->bodies_[0]);
   ASSERT_EQ(fs.size(), 2);
-  EXPECT_TRUE(FixtureEq(fs[0], false, 0, 0xFFFF, 0xFFFF, 0, 0, 0));
+  EXPECT_TRUE(FixtureEq(fs[0], false, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0));
   EXPECT_TRUE(CircleEq(fs[0], 0, 0, 1.777));
-  EXPECT_TRUE(FixtureEq(fs[1], false, 0, 0xFFFF, 0xFFFF, 982.24, 0.59, 0.234));
+  EXPECT_TRUE(FixtureEq(fs[1], false, 0, 0xFFFFFFFF, 0xFFFFFFFF, 982.24, 0.59,
+                        0.234));
   EXPECT_TRUE(
       PolygonEq(fs[1], {{-0.1, 0.1}, {-0.1, -0.1}, {0.1, -0.1}, {0.1, 0.1}}));
 
@@ -672,7 +679,7 @@ TEST_F(LoadWorldTest, simple_test_A) {
                      {0, 1, 0, 0.25}, 0, 0));
   fs = GetBodyFixtures(m0->bodies_[2]);
   ASSERT_EQ(fs.size(), 1);
-  EXPECT_TRUE(FixtureEq(fs[0], false, 0, 0xFFFF, 0xFFFF, 0, 0, 0));
+  EXPECT_TRUE(FixtureEq(fs[0], false, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0));
   EXPECT_TRUE(PolygonEq(
       fs[0], {{-0.2, 0.75}, {-0.2, -0.75}, {0.2, -0.75}, {0.2, 0.75}}));
 
@@ -734,7 +741,7 @@ TEST_F(LoadWorldTest, simple_test_A) {
   EXPECT_TRUE(FixtureEq(fs[0], false, 0, 0b1100, 0b1100, 0, 0, 0));
   EXPECT_TRUE(CircleEq(fs[0], 0, 0, 1));
 
-  EXPECT_TRUE(FixtureEq(fs[1], false, 0, 0xFFFF, 0xFFFF, 0, 0, 0));
+  EXPECT_TRUE(FixtureEq(fs[1], false, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0, 0, 0));
   EXPECT_TRUE(CircleEq(fs[1], 0, 0, 0.2));
 
   // Check model 3 which is the chair
@@ -748,6 +755,886 @@ TEST_F(LoadWorldTest, simple_test_A) {
                      {0, 0.75, 0.75, 0.25}, 0, 0));
 }
 
+/**
+ * This test loads a bitmap layer in contour mode, the edges around each
+ * obstacle should be loaded as a single chain shape
+ */
+TEST_F(LoadWorldTest, contour_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/contour_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  // the same edges as layer[1] of simple_test_A
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.0, 7.5), b2Vec2(1.5, 7.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.0, 7.5), b2Vec2(0.0, 4.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.0, 4.5), b2Vec2(4.5, 4.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(4.5, 4.5), b2Vec2(4.5, 1.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(6.0, 3.0), b2Vec2(6.0, 6.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(6.0, 6.0), b2Vec2(1.5, 6.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 7.5), b2Vec2(1.5, 6.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(3.0, 3.0), b2Vec2(6.0, 3.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(3.0, 0.0), b2Vec2(3.0, 3.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 1.5), b2Vec2(4.5, 1.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 0.0), b2Vec2(3.0, 0.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 1.5), b2Vec2(1.5, 0.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(6.0, 1.5), b2Vec2(7.5, 1.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(6.0, 1.5), b2Vec2(6.0, 0.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(7.5, 1.5), b2Vec2(7.5, 0.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(6.0, 0.0), b2Vec2(7.5, 0.0))};
+
+  std::vector<b2EdgeShape> edges;
+  int num_fixtures = 0;
+  for (b2Fixture *f = w->layers_[0]->body_->physics_body_->GetFixtureList(); f;
+       f = f->GetNext()) {
+    num_fixtures++;
+    ASSERT_EQ(f->GetType(), b2Shape::e_chain);
+    b2ChainShape *chain = dynamic_cast<b2ChainShape *>(f->GetShape());
+    for (int i = 0; i < chain->GetChildCount(); i++) {
+      b2EdgeShape e;
+      chain->GetChildEdge(&e, i);
+      edges.push_back(e);
+    }
+  }
+
+  // one loop around each of the two obstacles
+  EXPECT_EQ(num_fixtures, 2);
+  EXPECT_EQ(edges.size(), expected_edges.size());
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+}
+
+/**
+ * This test loads a bitmap layer with simplified chain fixtures for the
+ * collisions and segments at the resolution of the image for the sensors
+ */
+TEST_F(LoadWorldTest, fine_sensing_test) {
+  world_yaml = this_file_dir /
+               fs::path("load_world_tests/fine_sensing_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  Layer *layer = w->layers_[0];
+  EXPECT_TRUE(layer->HasSensingGeometry());
+  EXPECT_EQ(layer->body_->physics_body_->GetFixtureList()->GetType(),
+            b2Shape::e_chain);
+
+  // the edges of the image, as in contour_test
+  const SegmentRaycaster *segments = layer->GetSegmentRaycaster();
+  ASSERT_TRUE(segments != nullptr);
+  EXPECT_EQ(segments->GetSegmentCount(), 16u);
+  float fraction;
+  ASSERT_TRUE(segments->RayCast(b2Vec2(-1, 5.25), b2Vec2(10, 5.25), &fraction));
+  EXPECT_NEAR(fraction, 1 / 11.0, 1e-6);
+  EXPECT_FALSE(segments->RayCast(b2Vec2(-1, 8), b2Vec2(10, 8), &fraction));
+}
+
+/**
+ * This test publishes the occupancy grid and the distance field of a bitmap
+ * layer on latched topics
+ */
+TEST_F(LoadWorldTest, publish_grid_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/publish_grid_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  const OccupancyGrid *grid = w->layers_[0]->GetGrid();
+  ASSERT_TRUE(grid != nullptr);
+  ASSERT_TRUE(grid->HasDistanceField());
+
+  auto map = ros::topic::waitForMessage<nav_msgs::OccupancyGrid>(
+      "layer/3d/map", ros::Duration(5));
+  ASSERT_TRUE(map != nullptr);
+  EXPECT_STREQ(map->header.frame_id.c_str(), "map");
+  EXPECT_FLOAT_EQ(map->info.resolution, 1.5);
+  EXPECT_EQ(map->info.width, grid->GetWidth());
+  EXPECT_EQ(map->info.height, grid->GetHeight());
+  EXPECT_DOUBLE_EQ(map->info.origin.position.x, 1.0);
+  EXPECT_DOUBLE_EQ(map->info.origin.position.y, 2.0);
+  ASSERT_EQ(map->data.size(), grid->GetWidth() * grid->GetHeight());
+
+  auto field = ros::topic::waitForMessage<flatland_msgs::DistanceField>(
+      "layer/3d/distance_field", ros::Duration(5));
+  ASSERT_TRUE(field != nullptr);
+  EXPECT_EQ(field->width, grid->GetWidth());
+  EXPECT_EQ(field->height, grid->GetHeight());
+  ASSERT_EQ(field->distances.size(), map->data.size());
+
+  int occupied = 0;
+  for (unsigned int y = 0; y < grid->GetHeight(); y++) {
+    for (unsigned int x = 0; x < grid->GetWidth(); x++) {
+      size_t i = y * grid->GetWidth() + x;
+      EXPECT_EQ(map->data[i], grid->IsOccupied(x, y) ? 100 : 0);
+      EXPECT_EQ(field->distances[i], grid->GetDistance(x, y));
+      EXPECT_EQ(field->distances[i] == 0, grid->IsOccupied(x, y));
+      occupied += grid->IsOccupied(x, y);
+    }
+  }
+  EXPECT_GT(occupied, 0);
+}
+
+/**
+ * This test loads a line segments layer from a binary file, converted from the
+ * line segments of simple_test_A with scripts/lines_to_binary.py
+ */
+TEST_F(LoadWorldTest, binary_lines_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/binary_lines_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  ASSERT_EQ(w->layers_.size(), 1);
+  EXPECT_TRUE(BodyEq(w->layers_[0]->body_, "lines", b2_staticBody,
+                     {-1.20, -5, 1.23}, {1, 1, 1, 1}, 0, 0));
+
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.1, 0.2), b2Vec2(0.3, 0.4)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(-0.1, -0.2), b2Vec2(-0.3, -0.4)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.01, 0.02), b2Vec2(0.03, 0.04))};
+
+  std::vector<b2EdgeShape> edges;
+  for (b2Fixture *f = w->layers_[0]->body_->physics_body_->GetFixtureList(); f;
+       f = f->GetNext()) {
+    edges.push_back(*(dynamic_cast<b2EdgeShape *>(f->GetShape())));
+  }
+  EXPECT_EQ(edges.size(), expected_edges.size());
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+  ASSERT_NE(w->layers_[0]->GetSegmentRaycaster(), nullptr);
+}
+
+/**
+ * This test adds line segments to a layer and removes them again, by finding
+ * the layer with its name
+ */
+TEST_F(LoadWorldTest, layer_modification_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/binary_lines_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  Layer *layer = w->GetLayer("lines");
+  ASSERT_EQ(layer, w->layers_[0]);
+  EXPECT_TRUE(w->GetLayer("random_layer") == nullptr);
+  b2Body *body = layer->body_->physics_body_;
+  uint32_t category_bits = body->GetFixtureList()->GetFilterData().categoryBits;
+
+  std::vector<b2EdgeShape> segments(2);
+  segments[0].Set(b2Vec2(1, 1), b2Vec2(2, 1));
+  segments[1].Set(b2Vec2(2, 1), b2Vec2(2, 2));
+  std::vector<b2Fixture *> fixtures = layer->AddSegments(segments);
+  ASSERT_EQ(fixtures.size(), 2u);
+  for (unsigned int i = 0; i < fixtures.size(); i++) {
+    b2EdgeShape *edge = dynamic_cast<b2EdgeShape *>(fixtures[i]->GetShape());
+    EXPECT_EQ(edge->m_vertex1, segments[i].m_vertex1);
+    EXPECT_EQ(edge->m_vertex2, segments[i].m_vertex2);
+    EXPECT_EQ(fixtures[i]->GetFilterData().categoryBits, category_bits);
+    EXPECT_EQ(fixtures[i]->GetFilterData().maskBits, category_bits);
+  }
+
+  int count = 0;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    count++;
+  }
+  EXPECT_EQ(count, 5);
+
+  // only the added segments are removed
+  layer->RemoveSegments(fixtures);
+  std::vector<b2EdgeShape> edges;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    edges.push_back(*(dynamic_cast<b2EdgeShape *>(f->GetShape())));
+  }
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.1, 0.2), b2Vec2(0.3, 0.4)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(-0.1, -0.2), b2Vec2(-0.3, -0.4)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.01, 0.02), b2Vec2(0.03, 0.04))};
+  EXPECT_EQ(edges.size(), expected_edges.size());
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+}
+
+/**
+ * This test reloads a line segments layer after editing its file, only the
+ * segments that changed should be removed and added
+ */
+TEST_F(LoadWorldTest, layer_reload_test) {
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  auto write = [&](const std::string &file, const std::string &content) {
+    std::ofstream((dir / file).string()) << content;
+  };
+  write("world.yaml",
+        "properties: {}\nlayers:\n  - name: lines\n    map: map.yaml\n");
+  write("map.yaml",
+        "type: line_segments\ndata: map.dat\nscale: 1\norigin: [0, 0, 0]\n");
+  write("map.dat", "0 0 1 0\n1 0 1 1\n1 1 0 1\n");
+  w = World::MakeWorld((dir / "world.yaml").string());
+
+  b2Body *body = w->GetLayer("lines")->body_->physics_body_;
+  std::vector<b2Fixture *> before;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    before.push_back(f);
+  }
+  ASSERT_EQ(before.size(), 3u);
+
+  // one segment moved and one added
+  write("map.dat", "0 0 1 0\n1 0 1 1\n1 1 0 2\n0 2 0 0\n");
+  size_t removed = 0, added = 0;
+  w->ReloadLayer("lines", &removed, &added);
+  EXPECT_EQ(removed, 1u);
+  EXPECT_EQ(added, 2u);
+
+  std::vector<b2EdgeShape> edges;
+  int kept = 0;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    edges.push_back(*(dynamic_cast<b2EdgeShape *>(f->GetShape())));
+    kept += std::count(before.begin(), before.end(), f);
+  }
+  EXPECT_EQ(kept, 2);
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0, 0), b2Vec2(1, 0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1, 0), b2Vec2(1, 1)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1, 1), b2Vec2(0, 2)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0, 2), b2Vec2(0, 0))};
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+  float fraction;
+  EXPECT_TRUE(w->GetLayer("lines")->GetSegmentRaycaster()->RayCast(
+      b2Vec2(-1, 1), b2Vec2(0.5, 1), &fraction));
+  EXPECT_NEAR(fraction, 1 / 1.5, 1e-5);
+
+  // an unchanged map changes nothing, a broken one leaves the layer as is
+  w->ReloadLayer("lines", &removed, &added);
+  EXPECT_EQ(removed, 0u);
+  EXPECT_EQ(added, 0u);
+  write("map.dat", "0 0 1\n");
+  EXPECT_ANY_THROW(w->ReloadLayer("lines"));
+  int count = 0;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    count++;
+  }
+  EXPECT_EQ(count, 4);
+  EXPECT_THROW(w->ReloadLayer("random_layer"), Exception);
+
+  fs::remove_all(dir);
+}
+
+/**
+ * This test streams a layer from occupancy grids, only the edges around the
+ * cells that changed should be removed and added
+ */
+TEST_F(LoadWorldTest, grid_stream_test) {
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  std::ofstream((dir / "world.yaml").string())
+      << "properties: {}\nlayers:\n  - name: live\n    topic: live_map\n";
+  w = World::MakeWorld((dir / "world.yaml").string());
+  fs::remove_all(dir);
+
+  Layer *layer = w->GetLayer("live");
+  b2Body *body = layer->body_->physics_body_;
+  EXPECT_TRUE(body->GetFixtureList() == nullptr);
+  EXPECT_TRUE(layer->GetGrid() == nullptr);
+
+  nav_msgs::OccupancyGrid msg;
+  msg.info.width = 5;
+  msg.info.height = 5;
+  msg.info.resolution = 0.5;
+  msg.info.origin.orientation.w = 1;
+  msg.data.assign(25, 0);
+  msg.data[5 + 1] = 100;
+  msg.data[15 + 3] = -1;
+  size_t removed = 0, added = 0;
+  layer->UpdateFromGrid(msg, &removed, &added);
+  EXPECT_EQ(removed, 0u);
+  EXPECT_EQ(added, 4u);
+
+  std::vector<b2Fixture *> before;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    before.push_back(f);
+  }
+
+  // the obstacle grows to the right, only its left edge is kept
+  msg.data[5 + 2] = 100;
+  layer->UpdateFromGrid(msg, &removed, &added);
+  EXPECT_EQ(removed, 3u);
+  EXPECT_EQ(added, 3u);
+
+  std::vector<b2EdgeShape> edges;
+  int kept = 0;
+  for (b2Fixture *f = body->GetFixtureList(); f; f = f->GetNext()) {
+    edges.push_back(*(dynamic_cast<b2EdgeShape *>(f->GetShape())));
+    kept += std::count(before.begin(), before.end(), f);
+  }
+  EXPECT_EQ(kept, 1);
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.5, 1), b2Vec2(1.5, 1)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.5, 0.5), b2Vec2(1.5, 0.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.5, 1), b2Vec2(0.5, 0.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 1), b2Vec2(1.5, 0.5))};
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+  EXPECT_TRUE(layer->GetGrid()->IsOccupied(2, 1));
+  EXPECT_FALSE(layer->GetGrid()->IsOccupied(3, 3));
+
+  // an unchanged grid changes nothing, a moved one is rebuilt
+  layer->UpdateFromGrid(msg, &removed, &added);
+  EXPECT_EQ(removed, 0u);
+  EXPECT_EQ(added, 0u);
+  msg.info.origin.position.x = 2;
+  layer->UpdateFromGrid(msg, &removed, &added);
+  EXPECT_EQ(removed, 4u);
+  EXPECT_EQ(added, 4u);
+  EXPECT_EQ(body->GetPosition(), b2Vec2(2, 0));
+
+  msg.data.pop_back();
+  EXPECT_THROW(layer->UpdateFromGrid(msg), Exception);
+}
+
+/**
+ * This test loads a tiled bitmap layer, only the tiles around the model should
+ * have fixtures
+ */
+TEST_F(LoadWorldTest, tile_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/tile_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  Layer *layer = w->layers_[0];
+  ASSERT_NE(layer->GetTiles(), nullptr);
+  EXPECT_EQ(layer->body_->physics_body_->GetFixtureList(), nullptr);
+  EXPECT_EQ(layer->GetTiles()->GetActiveTileCount(), 0u);
+  EXPECT_THROW(layer->AddSegments(std::vector<b2EdgeShape>(1)), Exception);
+
+  // the model at (0.5, 7) only touches the tile [0, 3) x [6, 9), which holds
+  // the parts of the edges of the top left obstacle inside of it
+  w->UpdateLayerTiles(0);
+  std::vector<b2Body *> bodies = layer->GetTiles()->GetActiveBodies();
+  ASSERT_EQ(bodies.size(), 1u);
+
+  std::vector<std::pair<b2Vec2, b2Vec2>> expected_edges = {
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.0, 7.5), b2Vec2(1.5, 7.5)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(0.0, 7.5), b2Vec2(0.0, 6.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(3.0, 6.0), b2Vec2(1.5, 6.0)),
+      std::pair<b2Vec2, b2Vec2>(b2Vec2(1.5, 7.5), b2Vec2(1.5, 6.0))};
+
+  std::vector<b2EdgeShape> edges;
+  for (b2Fixture *f = bodies[0]->GetFixtureList(); f; f = f->GetNext()) {
+    edges.push_back(*(dynamic_cast<b2EdgeShape *>(f->GetShape())));
+    EXPECT_EQ(f->GetFilterData().categoryBits, 0x1);
+  }
+  EXPECT_EQ(bodies[0]->GetUserData(), layer->body_);
+  EXPECT_EQ(edges.size(), expected_edges.size());
+  EXPECT_TRUE(do_edges_exactly_match(edges, expected_edges));
+
+  // once the model is gone, the tile is evicted after the timeout
+  w->models_[0]->bodies_[0]->physics_body_->SetTransform(b2Vec2(20, 20), 0);
+  w->UpdateLayerTiles(0.5);
+  EXPECT_EQ(layer->GetTiles()->GetActiveTileCount(), 1u);
+  w->UpdateLayerTiles(1.5);
+  EXPECT_EQ(layer->GetTiles()->GetActiveTileCount(), 0u);
+}
+
+/**
+ * This test visualizes a layer several times, the markers should only be
+ * built once subscribed to, and rebuilt once its geometry changed
+ */
+TEST_F(LoadWorldTest, layer_visualization_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  Layer *layer = w->layers_[2];
+  ASSERT_EQ(layer->names_[0], "lines");
+  DebugVisualization &viz = DebugVisualization::Get();
+
+  // nothing is built until the topic is subscribed to
+  layer->DebugVisualize();
+  ASSERT_EQ(viz.topics_.count("layer/lines"), 1);
+  DebugTopic &topic = viz.topics_["layer/lines"];
+  EXPECT_EQ(topic.markers.markers.size(), 0u);
+
+  ros::NodeHandle nh;
+  boost::function<void(const visualization_msgs::MarkerArrayConstPtr &)>
+      ignore = [](const visualization_msgs::MarkerArrayConstPtr &) {};
+  ros::Subscriber sub = nh.subscribe<visualization_msgs::MarkerArray>(
+      "/load_world_test/debug/layer/lines", 0, ignore);
+  for (int i = 0; i < 100 && !viz.HasSubscribers("layer/lines"); i++) {
+    ros::Duration(0.01).sleep();
+  }
+  ASSERT_TRUE(viz.HasSubscribers("layer/lines"));
+  layer->DebugVisualize();
+  ASSERT_GT(topic.markers.markers.size(), 0u);
+  size_t points = topic.markers.markers[0].points.size();
+  EXPECT_TRUE(topic.needs_publishing);
+
+  // nothing is rebuilt while the geometry does not change
+  topic.needs_publishing = false;
+  layer->DebugVisualize();
+  EXPECT_FALSE(topic.needs_publishing);
+
+  b2EdgeShape wall;
+  wall.Set(b2Vec2(0, 0), b2Vec2(1, 1));
+  b2FixtureDef fixture_def;
+  fixture_def.shape = &wall;
+  layer->body_->physics_body_->CreateFixture(&fixture_def);
+  layer->GeometryChanged();
+  layer->DebugVisualize();
+  EXPECT_TRUE(topic.needs_publishing);
+  EXPECT_EQ(topic.markers.markers[0].points.size(), points + 2);
+}
+
+/**
+ * This test checks that a model yaml file loaded by several models is only
+ * parsed once, and that each model reads its own copy
+ */
+TEST_F(LoadWorldTest, model_template_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  // the two turtlebots share a template
+  ASSERT_EQ(w->models_.size(), 4);
+  EXPECT_EQ(w->model_templates_.size(), 3);
+
+  std::string path =
+      (this_file_dir /
+       fs::path("load_world_tests/simple_test_A/turtlebot.model.yaml"))
+          .string();
+  ASSERT_EQ(w->model_templates_.count(path), 1);
+  YamlReader a = w->ReadModelYaml(path);
+  YamlReader b = w->ReadModelYaml(path);
+  EXPECT_EQ(w->model_templates_.size(), 3);
+  EXPECT_FALSE(a.Node().is(b.Node()));
+  EXPECT_FALSE(a.Node().is(w->model_templates_[path].node));
+  EXPECT_EQ(a.Subnode("bodies", YamlReader::LIST).NodeSize(),
+            b.Subnode("bodies", YamlReader::LIST).NodeSize());
+}
+
+/**
+ * This test checks the lookups of models by name and id, and of their bodies
+ * and joints by name
+ */
+TEST_F(LoadWorldTest, model_lookup_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  ASSERT_EQ(w->models_.size(), 4);
+
+  Model *m = w->models_[1];
+  EXPECT_EQ(w->GetModel(m->GetName()), m);
+  EXPECT_EQ(w->GetModelById(m->id_), m);
+  EXPECT_TRUE(w->GetModel("random_model") == nullptr);
+  EXPECT_TRUE(w->GetModelById(0) == nullptr);
+  for (unsigned int i = 0; i < m->bodies_.size(); i++) {
+    EXPECT_EQ(m->GetBody(m->bodies_[i]->name_), m->bodies_[i]);
+  }
+  for (unsigned int i = 0; i < m->joints_.size(); i++) {
+    EXPECT_EQ(m->GetJoint(m->joints_[i]->name_), m->joints_[i]);
+  }
+  EXPECT_TRUE(m->GetBody("random_body") == nullptr);
+
+  // the ids of deleted models are not reused
+  uint32_t id = m->id_;
+  std::string name = m->GetName();
+  w->DeleteModel(name);
+  EXPECT_TRUE(w->GetModel(name) == nullptr);
+  EXPECT_TRUE(w->GetModelById(id) == nullptr);
+  w->LoadModel("turtlebot.model.yaml", "", name, Pose(0, 0, 0));
+  EXPECT_NE(w->GetModel(name)->id_, id);
+  EXPECT_EQ(w->models_.size(), 4);
+}
+
+/**
+ * This test checks that deleted models are parked and reused by the next
+ * model loaded from the same file
+ */
+TEST_F(LoadWorldTest, model_pool_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  w->model_pool_size_ = 1;
+  ASSERT_EQ(w->models_.size(), 4);
+
+  Model *m = w->models_[0];
+  b2Transform initial = m->bodies_[1]->physics_body_->GetTransform();
+  w->MoveModel(m->GetName(), Pose(5, 6, 1));
+  w->DeleteModel(m->GetName());
+  EXPECT_EQ(w->models_.size(), 3);
+  ASSERT_EQ(w->model_pools_[m->yaml_path_].models.size(), 1);
+  EXPECT_FALSE(m->bodies_[0]->physics_body_->IsActive());
+
+  // only one model is kept per file
+  w->DeleteModel(w->models_[0]->GetName());
+  EXPECT_EQ(w->model_pools_[m->yaml_path_].models.size(), 1);
+
+  // the parked model comes back under its new name, at rest at its pose
+  w->LoadModel("turtlebot.model.yaml", "ns", "reused", Pose(0, 0, 0));
+  EXPECT_EQ(w->models_.back(), m);
+  EXPECT_EQ(w->GetModel("reused"), m);
+  EXPECT_STREQ(m->GetNameSpace().c_str(), "ns");
+  EXPECT_TRUE(w->model_pools_[m->yaml_path_].models.empty());
+  b2Body *b = m->bodies_[1]->physics_body_;
+  EXPECT_TRUE(b->IsActive());
+  EXPECT_NEAR(b->GetPosition().x, initial.p.x, 1e-5);
+  EXPECT_NEAR(b->GetPosition().y, initial.p.y, 1e-5);
+  EXPECT_NEAR(b->GetAngle(), initial.q.GetAngle(), 1e-5);
+  EXPECT_EQ(b->GetLinearVelocity(), b2Vec2(0, 0));
+}
+
+/**
+ * This test bundles simple_test_A into a directory without its files, the
+ * world loaded from the bundle should match the world loaded from the files
+ */
+TEST_F(LoadWorldTest, world_bundle_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  fs::path bundle_path = dir / "world.bundle";
+  WorldBundle::Build(world_yaml.string(), bundle_path.string());
+  ASSERT_TRUE(WorldBundle::IsBundle(bundle_path.string()));
+  EXPECT_FALSE(WorldBundle::IsBundle(world_yaml.string()));
+
+  World *expected = World::MakeWorld(world_yaml.string());
+  w = World::MakeWorld(bundle_path.string());
+
+  ASSERT_EQ(w->layers_.size(), expected->layers_.size());
+  for (unsigned int i = 0; i < w->layers_.size(); i++) {
+    EXPECT_EQ(w->layers_[i]->names_, expected->layers_[i]->names_);
+    int count = 0, expected_count = 0;
+    for (b2Fixture *f = w->layers_[i]->body_->physics_body_->GetFixtureList();
+         f; f = f->GetNext()) {
+      count++;
+    }
+    for (b2Fixture *f =
+             expected->layers_[i]->body_->physics_body_->GetFixtureList();
+         f; f = f->GetNext()) {
+      expected_count++;
+    }
+    EXPECT_EQ(count, expected_count) << "layer " << i;
+  }
+
+  ASSERT_EQ(w->models_.size(), expected->models_.size());
+  for (unsigned int i = 0; i < w->models_.size(); i++) {
+    EXPECT_EQ(w->models_[i]->GetName(), expected->models_[i]->GetName());
+    EXPECT_EQ(w->models_[i]->bodies_.size(),
+              expected->models_[i]->bodies_.size());
+  }
+  delete expected;
+
+  // the models of the bundle are spawned without their files
+  w->LoadModel("turtlebot.model.yaml", "", "spawned", Pose(0, 0, 0));
+  EXPECT_NE(w->GetModel("spawned"), nullptr);
+
+  fs::remove_all(dir);
+}
+
+/**
+ * This test loads a headless world, which has no interactive markers, and
+ * checks its models can still be stepped, paused and deleted
+ */
+TEST_F(LoadWorldTest, headless_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  w = World::MakeWorld(world_yaml.string(), "", true);
+
+  EXPECT_TRUE(w->int_marker_manager_ == nullptr);
+  ASSERT_EQ(w->models_.size(), 4);
+  EXPECT_FALSE(w->IsPaused());
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  w->Update(timekeeper);
+  w->DeleteModel(w->models_[0]->GetName());
+  EXPECT_EQ(w->models_.size(), 3);
+}
+
+/**
+ * This test checks that the models prepared on several threads are added in
+ * the order of the world file, as when loaded in series
+ */
+TEST_F(LoadWorldTest, parallel_load_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  World *serial = World::MakeWorld(world_yaml.string(), "", true);
+  world_yaml = this_file_dir /
+               fs::path("load_world_tests/simple_test_A/world_parallel.yaml");
+  w = World::MakeWorld(world_yaml.string(), "", true);
+
+  ASSERT_EQ(w->models_.size(), serial->models_.size());
+  for (unsigned int i = 0; i < w->models_.size(); i++) {
+    Model *a = w->models_[i];
+    Model *b = serial->models_[i];
+    EXPECT_EQ(a->GetName(), b->GetName());
+    EXPECT_EQ(a->GetNameSpace(), b->GetNameSpace());
+    EXPECT_EQ(a->id_, b->id_);
+    ASSERT_EQ(a->bodies_.size(), b->bodies_.size());
+    for (unsigned int j = 0; j < a->bodies_.size(); j++) {
+      EXPECT_EQ(a->bodies_[j]->name_, b->bodies_[j]->name_);
+      EXPECT_EQ(a->bodies_[j]->physics_body_->GetPosition(),
+                b->bodies_[j]->physics_body_->GetPosition());
+      EXPECT_EQ(a->bodies_[j]->physics_body_->GetAngle(),
+                b->bodies_[j]->physics_body_->GetAngle());
+    }
+  }
+  EXPECT_EQ(w->model_templates_.size(), serial->model_templates_.size());
+  delete serial;
+}
+
+/**
+ * This test drives a kinematic model through a dynamic one, the mover must
+ * follow its velocity exactly and the block must not be pushed, while the
+ * contact between them is still reported
+ */
+TEST_F(LoadWorldTest, kinematic_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/kinematic_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  Model *mover = w->GetModel("mover");
+  Model *block = w->GetModel("block");
+  ASSERT_NE(mover, nullptr);
+  ASSERT_NE(block, nullptr);
+  EXPECT_TRUE(mover->kinematic_);
+  EXPECT_FALSE(block->kinematic_);
+  b2Body *mover_body = mover->bodies_[0]->physics_body_;
+  b2Body *block_body = block->bodies_[0]->physics_body_;
+  EXPECT_TRUE(mover_body->IsSolverBypassed());
+  EXPECT_FALSE(block_body->IsSolverBypassed());
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  mover_body->SetLinearVelocity(b2Vec2(2, 0));
+  for (int i = 0; i < 100; i++) {
+    w->Update(timekeeper);
+  }
+
+  bool touching = false;
+  for (b2ContactEdge *ce = mover_body->GetContactList(); ce; ce = ce->next) {
+    touching |= ce->other == block_body && ce->contact->IsTouching();
+  }
+  EXPECT_TRUE(touching);
+
+  for (int i = 0; i < 100; i++) {
+    w->Update(timekeeper);
+  }
+  EXPECT_NEAR(mover_body->GetPosition().x, 4, 1e-3);
+  EXPECT_NEAR(mover_body->GetPosition().y, 0, 1e-6);
+  EXPECT_NEAR(block_body->GetPosition().x, 2, 1e-6);
+  EXPECT_NEAR(block_body->GetPosition().y, 0, 1e-6);
+}
+
+/**
+ * This test loads a world without continuous physics and shoots two robots at
+ * a thin wall, only the one flagged continuous must not tunnel through it
+ */
+TEST_F(LoadWorldTest, continuous_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/continuous_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  EXPECT_FALSE(w->physics_world_->GetContinuousPhysics());
+  b2Body *fast = w->GetModel("fast")->bodies_[0]->physics_body_;
+  b2Body *slow = w->GetModel("slow")->bodies_[0]->physics_body_;
+  EXPECT_TRUE(fast->IsContinuous());
+  EXPECT_FALSE(fast->IsBullet());
+  EXPECT_FALSE(slow->IsContinuous());
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  fast->SetLinearVelocity(b2Vec2(150, 0));
+  slow->SetLinearVelocity(b2Vec2(150, 0));
+  for (int i = 0; i < 5; i++) {
+    w->Update(timekeeper);
+  }
+
+  EXPECT_LT(fast->GetPosition().x, 2);
+  EXPECT_GT(slow->GetPosition().x, 2);
+}
+
+/**
+ * This test loads robots in a collision group whose robots must not collide
+ * with each other, no contact should be created between their footprints,
+ * while the footprints outside the group still collide with them
+ */
+TEST_F(LoadWorldTest, collision_group_test) {
+  world_yaml = this_file_dir /
+               fs::path("load_world_tests/collision_group_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+
+  Model *robot_1 = w->GetModel("robot_1");
+  Model *robot_2 = w->GetModel("robot_2");
+  EXPECT_EQ(robot_1->group_, "fleet");
+  EXPECT_FALSE(robot_1->self_collide_);
+  // Box2D prepends the fixtures, the bumper comes first
+  b2Fixture *bumper_1 = robot_1->bodies_[0]->physics_body_->GetFixtureList();
+  b2Fixture *base_1 = bumper_1->GetNext();
+  b2Fixture *base_2 =
+      robot_2->bodies_[0]->physics_body_->GetFixtureList()->GetNext();
+  ASSERT_NE(base_1, nullptr);
+  ASSERT_NE(base_2, nullptr);
+  EXPECT_LT(base_1->GetFilterData().groupIndex, 0);
+  EXPECT_EQ(base_1->GetFilterData().groupIndex,
+            base_2->GetFilterData().groupIndex);
+  EXPECT_GT(bumper_1->GetFilterData().groupIndex, 0);
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  w->Update(timekeeper);
+
+  // fixture pairs with a contact
+  std::set<std::pair<b2Fixture *, b2Fixture *>> pairs;
+  for (b2Contact *c = w->physics_world_->GetContactList(); c;
+       c = c->GetNext()) {
+    pairs.insert({c->GetFixtureA(), c->GetFixtureB()});
+    pairs.insert({c->GetFixtureB(), c->GetFixtureA()});
+  }
+  b2Fixture *block =
+      w->GetModel("block")->bodies_[0]->physics_body_->GetFixtureList();
+  EXPECT_EQ(pairs.count({base_1, base_2}), 0u);
+  EXPECT_EQ(pairs.count({bumper_1, base_2}), 1u);
+  EXPECT_EQ(pairs.count({base_2, block}), 1u);
+}
+
+/**
+ * This test splits a world into two regions, a model crossing the border
+ * should move to the other region, and the models near the border should be
+ * mirrored there
+ */
+TEST_F(LoadWorldTest, region_test) {
+  fs::path dir = this_file_dir / fs::path("load_world_tests/region_test");
+  w = World::MakeWorld((dir / "west.world.yaml").string(), "", true);
+  std::unique_ptr<World> east(
+      World::MakeWorld((dir / "east.world.yaml").string(), "", true));
+
+  // each region keeps its own models
+  ASSERT_TRUE(w->region_ != nullptr);
+  EXPECT_EQ(w->models_.size(), 2u);
+  EXPECT_TRUE(w->GetModel("r3") == nullptr);
+  EXPECT_EQ(east->models_.size(), 1u);
+  EXPECT_TRUE(east->GetModel("r3") != nullptr);
+
+  // r2 is near the border
+  flatland_msgs::RegionModels msg = w->region_->Collect(ros::Time(1));
+  EXPECT_EQ(msg.region, "west");
+  EXPECT_EQ(msg.migrations.size(), 0u);
+  ASSERT_EQ(msg.ghosts.size(), 1u);
+  EXPECT_EQ(msg.ghosts[0].name, "r2");
+  east->region_->Apply(msg);
+  Model *ghost = east->region_->GetGhost("r2");
+  ASSERT_TRUE(ghost != nullptr);
+  EXPECT_TRUE(east->GetModel("r2") == nullptr);
+  EXPECT_EQ(ghost->bodies_[0]->physics_body_->GetType(), b2_kinematicBody);
+  EXPECT_EQ(ghost->bodies_[0]->physics_body_->GetPosition(), b2Vec2(-1, 0));
+  w->region_->Apply(msg);  // ignored by the sender
+  EXPECT_EQ(w->region_->GetGhostCount(), 0u);
+
+  // r2 crosses the border and replaces its ghost
+  w->MoveModel("r2", Pose(0.5, 0, 0));
+  w->GetModel("r2")->bodies_[0]->physics_body_->SetLinearVelocity(
+      b2Vec2(1, 0));
+  msg = w->region_->Collect(ros::Time(2));
+  ASSERT_EQ(msg.migrations.size(), 1u);
+  EXPECT_EQ(msg.ghosts.size(), 0u);
+  EXPECT_TRUE(w->GetModel("r2") == nullptr);
+  east->region_->Apply(msg);
+  EXPECT_EQ(east->region_->GetGhostCount(), 0u);
+  Model *r2 = east->GetModel("r2");
+  ASSERT_TRUE(r2 != nullptr);
+  b2Body *body = r2->bodies_[0]->physics_body_;
+  EXPECT_EQ(body->GetType(), b2_dynamicBody);
+  EXPECT_EQ(body->GetPosition(), b2Vec2(0.5, 0));
+  EXPECT_EQ(body->GetLinearVelocity(), b2Vec2(1, 0));
+
+  // now mirrored in the west
+  w->region_->Apply(east->region_->Collect(ros::Time(2)));
+  EXPECT_TRUE(w->region_->GetGhost("r2") != nullptr);
+  EXPECT_TRUE(w->region_->GetGhost("r3") == nullptr);
+}
+
+/**
+ * This test loads a world with a region of interest around one robot, the
+ * robot far from it must be kinematic and catch up its motion at the reduced
+ * rate, and get its dynamic body back once it enters the region
+ */
+TEST_F(LoadWorldTest, physics_lod_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/physics_lod_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  ASSERT_TRUE(w->physics_lod_ != nullptr);
+
+  Timekeeper timekeeper;
+  timekeeper.SetMaxStepSize(0.01);
+  b2Body *near = w->GetModel("near")->bodies_[0]->physics_body_;
+  b2Body *far = w->GetModel("far")->bodies_[0]->physics_body_;
+  w->Update(timekeeper);
+  EXPECT_EQ(w->physics_lod_->GetReducedCount(), 1u);
+  EXPECT_TRUE(w->GetModel("far")->lod_reduced_);
+  EXPECT_EQ(far->GetType(), b2_kinematicBody);
+  EXPECT_EQ(near->GetType(), b2_dynamicBody);
+
+  // the far robot moves once per 10 steps, by the motion of all of them
+  far->SetLinearVelocity(b2Vec2(1, 0));
+  for (int i = 0; i < 4; i++) {
+    w->Update(timekeeper);
+  }
+  EXPECT_EQ(far->GetPosition(), b2Vec2(30, 0));
+  EXPECT_EQ(far->GetLinearVelocity(), b2Vec2(1, 0));
+  for (int i = 0; i < 5; i++) {
+    w->Update(timekeeper);
+  }
+  EXPECT_NEAR(far->GetPosition().x, 30.1, 1e-4);
+
+  // a robot leaves the region only beyond the hysteresis
+  w->MoveModel("near", Pose(10.5, 0, 0));
+  w->Update(timekeeper);
+  EXPECT_EQ(near->GetType(), b2_dynamicBody);
+  w->MoveModel("near", Pose(12, 0, 0));
+  w->Update(timekeeper);
+  EXPECT_EQ(near->GetType(), b2_kinematicBody);
+  EXPECT_EQ(w->physics_lod_->GetReducedCount(), 2u);
+
+  // entering the region restores the body
+  w->MoveModel("far", Pose(8, 0, 0));
+  w->Update(timekeeper);
+  EXPECT_EQ(far->GetType(), b2_dynamicBody);
+  EXPECT_FALSE(w->GetModel("far")->lod_reduced_);
+  EXPECT_EQ(w->physics_lod_->GetReducedCount(), 1u);
+
+  w->DeleteModel("near");
+  EXPECT_EQ(w->physics_lod_->GetReducedCount(), 0u);
+}
+
+/**
+ * This test loads copies of a model from replicate entries, on a grid, at
+ * listed poses and at random poses apart from each other
+ */
+TEST_F(LoadWorldTest, replicate_test) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/replicate_test/world.yaml");
+  w = World::MakeWorld(world_yaml.string());
+  ASSERT_EQ(w->models_.size(), 28u);
+  EXPECT_EQ(w->models_[0]->GetName(), "single");
+
+  // the copies follow the list, the grid fills its rows first
+  Model *grid = w->GetModel("grid_3");
+  ASSERT_TRUE(grid != nullptr);
+  EXPECT_EQ(w->models_[4], grid);
+  EXPECT_EQ(grid->GetNameSpace(), "fleet/grid_3");
+  EXPECT_EQ(grid->bodies_[0]->physics_body_->GetPosition(), b2Vec2(2, 3));
+  EXPECT_EQ(w->GetModel("grid_4")->bodies_[0]->physics_body_->GetPosition(),
+            b2Vec2(0, 6));
+  EXPECT_TRUE(w->GetModel("grid_5") == nullptr);
+
+  EXPECT_TRUE(w->GetModel("listed_0") == nullptr);
+  b2Body *listed = w->GetModel("listed_2")->bodies_[0]->physics_body_;
+  EXPECT_EQ(listed->GetPosition(), b2Vec2(20, 5));
+  EXPECT_FLOAT_EQ(listed->GetAngle(), 1.5);
+
+  for (int i = 0; i < 20; i++) {
+    Model *a = w->GetModel("random_" + std::to_string(i));
+    ASSERT_TRUE(a != nullptr);
+    b2Vec2 p = a->bodies_[0]->physics_body_->GetPosition();
+    EXPECT_TRUE(p.x >= 30 && p.x <= 40 && p.y >= 0 && p.y <= 10);
+    for (int j = 0; j < i; j++) {
+      Model *b = w->GetModel("random_" + std::to_string(j));
+      EXPECT_GE((b->bodies_[0]->physics_body_->GetPosition() - p).Length(),
+                1 - 1e-5);
+    }
+  }
+}
+
 /**
  * This test tries to loads a non-existent world yaml file. It should throw
  * an exception
@@ -823,8 +1710,8 @@ TEST_F(LoadWorldTest, world_invalid_F) {
   world_yaml =
       this_file_dir / fs::path("load_world_tests/world_invalid_F/world.yaml");
   test_yaml_fail(
-      "Flatland YAML: Unable to add 3 additional layer\\(s\\) \\{layer_15, "
-      "layer_16, layer_17\\}, current layers count is 14, max allowed is 16");
+      "Flatland YAML: Unable to add 3 additional layer\\(s\\) \\{layer_31, "
+      "layer_32, layer_33\\}, current layers count is 30, max allowed is 32");
 }
 
 /**
@@ -992,8 +1879,32 @@ TEST_F(LoadWorldTest, model_invalid_J) {
   world_yaml =
       this_file_dir / fs::path("load_world_tests/model_invalid_J/world.yaml");
   test_yaml_fail(
-      "Flatland YAML: Entry \"points\" must have size <= 8 \\(in model "
-      "\"turtlebot\" body \"base\" \"footprints\" index=1\\)");
+      "Flatland YAML: Invalid footprint \"points\" in model \"turtlebot\" "
+      "body \"base\" \"footprints\" index=1, polygon is degenerate or "
+      "intersects itself");
+}
+
+/**
+ * This test tries to load a invalid model yaml file, it should fail
+ */
+TEST_F(LoadWorldTest, model_invalid_K) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/model_invalid_K/world.yaml");
+  test_yaml_fail(
+      "Flatland YAML: Invalid \"kinematic\" in \"turtlebot\" model, a "
+      "kinematic model cannot have joints");
+}
+
+/**
+ * This test tries to load a model that disables self collisions without a
+ * collision group
+ */
+TEST_F(LoadWorldTest, model_invalid_L) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/model_invalid_L/world.yaml");
+  test_yaml_fail(
+      "Flatland YAML: Invalid \"self_collide\" in \"turtlebot\" model, "
+      "self_collide requires a \"group\"");
 }
 
 // Run all the tests that were declared with TEST()
@@ -0,0 +1,105 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 memory_report_test.cpp
+ * @brief	 Test the estimates of the memory report
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/memory_report.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+
+// Test that the fixtures and their shapes are counted
+TEST(MemoryReportTest, body_bytes) {
+  b2World world(b2Vec2(0, 0));
+  b2BodyDef def;
+  b2Body *body = world.CreateBody(&def);
+
+  uint64_t fixtures = 0, box2d_bytes = 0;
+  uint64_t empty = MemoryReport::BodyBytes(body, &fixtures, &box2d_bytes);
+  EXPECT_EQ(fixtures, 0u);
+  EXPECT_EQ(empty, sizeof(b2Body));
+  EXPECT_EQ(box2d_bytes, sizeof(b2Body));
+
+  b2PolygonShape box;
+  box.SetAsBox(1, 1);
+  body->CreateFixture(&box, 1);
+  b2Vec2 points[4] = {b2Vec2(0, 0), b2Vec2(1, 0), b2Vec2(1, 1), b2Vec2(2, 1)};
+  b2ChainShape chain;
+  chain.CreateChain(points, 4);
+  body->CreateFixture(&chain, 1);
+
+  fixtures = 0;
+  box2d_bytes = 0;
+  uint64_t bytes = MemoryReport::BodyBytes(body, &fixtures, &box2d_bytes);
+  EXPECT_EQ(fixtures, 2u);
+  EXPECT_EQ(box2d_bytes, sizeof(b2Body) + 2 * sizeof(b2Fixture) +
+                             sizeof(b2PolygonShape) + sizeof(b2ChainShape) +
+                             4 * sizeof(b2FixtureProxy));
+  // the chain vertices and the broadphase nodes are not in the allocator
+  EXPECT_EQ(bytes, box2d_bytes + 4 * sizeof(b2Vec2) + 4 * sizeof(b2TreeNode));
+}
+
+// Test that the nodes and scalars of a YAML document are counted
+TEST(MemoryReportTest, yaml_bytes) {
+  uint64_t nodes = 0;
+  EXPECT_GT(MemoryReport::YamlBytes(YAML::Node(), &nodes), 0u);
+  EXPECT_EQ(nodes, 1u);
+
+  nodes = 0;
+  YAML::Node small = YAML::Load("{a: 1}");
+  uint64_t small_bytes = MemoryReport::YamlBytes(small, &nodes);
+  EXPECT_EQ(nodes, 3u);
+
+  nodes = 0;
+  YAML::Node large = YAML::Load("{a: 1, b: [1, 2, 3], c: {d: long string}}");
+  uint64_t large_bytes = MemoryReport::YamlBytes(large, &nodes);
+  EXPECT_EQ(nodes, 12u);
+  EXPECT_GT(large_bytes, 3 * small_bytes);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,191 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 occupancy_grid_test.cpp
+ * @brief	 Test the occupancy grid raycasting
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/occupancy_grid.h>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace flatland_server;
+
+class OccupancyGridTest : public ::testing::Test {
+ public:
+  OccupancyGrid grid;
+
+  // 10x10 grid of 0.5m cells with a vertical wall at x in [3.5, 4.0]
+  OccupancyGridTest() : grid(10, 10, 0.5) {
+    for (unsigned int y = 0; y < 10; y++) {
+      grid.SetOccupied(7, y, true);
+    }
+  }
+};
+
+// Test setting and getting cells, including words boundaries
+TEST(OccupancyGridBitsTest, set_and_get) {
+  OccupancyGrid grid(130, 3, 1.0);
+  grid.SetOccupied(0, 0, true);
+  grid.SetOccupied(63, 1, true);
+  grid.SetOccupied(64, 1, true);
+  grid.SetOccupied(129, 2, true);
+
+  EXPECT_TRUE(grid.IsOccupied(0, 0));
+  EXPECT_TRUE(grid.IsOccupied(63, 1));
+  EXPECT_TRUE(grid.IsOccupied(64, 1));
+  EXPECT_TRUE(grid.IsOccupied(129, 2));
+  EXPECT_FALSE(grid.IsOccupied(1, 0));
+  EXPECT_FALSE(grid.IsOccupied(65, 1));
+
+  grid.SetOccupied(64, 1, false);
+  EXPECT_FALSE(grid.IsOccupied(64, 1));
+  EXPECT_TRUE(grid.IsOccupied(63, 1));
+
+  // out of bounds cells are free
+  EXPECT_FALSE(grid.IsOccupied(-1, 0));
+  EXPECT_FALSE(grid.IsOccupied(130, 2));
+  EXPECT_FALSE(grid.IsOccupied(0, 3));
+}
+
+// Test rays from free space hitting the wall
+TEST_F(OccupancyGridTest, ray_from_free_space) {
+  float fraction;
+
+  EXPECT_TRUE(grid.RayCast(b2Vec2(0.25, 0.25), b2Vec2(4.25, 0.25), &fraction));
+  EXPECT_NEAR(fraction, 3.25 / 4.0, 1e-5);
+
+  EXPECT_TRUE(grid.RayCast(b2Vec2(4.25, 1), b2Vec2(0, 1), &fraction));
+  EXPECT_NEAR(fraction, 0.25 / 4.25, 1e-5);
+
+  // diagonal ray, hits x = 3.5
+  EXPECT_TRUE(grid.RayCast(b2Vec2(0.5, 0.5), b2Vec2(4.5, 4.5), &fraction));
+  EXPECT_NEAR(fraction, 3.0 / 4.0, 1e-5);
+
+  // too short to reach the wall
+  EXPECT_FALSE(grid.RayCast(b2Vec2(0.25, 1), b2Vec2(3.25, 1), &fraction));
+}
+
+// Test rays starting outside of the grid, or inside of an obstacle
+TEST_F(OccupancyGridTest, ray_from_outside_and_obstacle) {
+  float fraction;
+
+  EXPECT_TRUE(grid.RayCast(b2Vec2(10, 1), b2Vec2(0, 1), &fraction));
+  EXPECT_NEAR(fraction, 6.0 / 10.0, 1e-5);
+
+  EXPECT_FALSE(grid.RayCast(b2Vec2(-1, 1), b2Vec2(1, 1), &fraction));
+  EXPECT_FALSE(grid.RayCast(b2Vec2(-1, 20), b2Vec2(10, 20), &fraction));
+
+  // leaving the wall counts as a hit, the same as an edge in Box2D
+  EXPECT_TRUE(grid.RayCast(b2Vec2(3.75, 1), b2Vec2(10, 1), &fraction));
+  EXPECT_NEAR(fraction, 0.25 / 6.25, 1e-5);
+}
+
+// Test the border of the grid is an edge for occupied border cells
+TEST(OccupancyGridBorderTest, border_cells) {
+  OccupancyGrid grid(4, 1, 1.0);
+  grid.SetOccupied(0, 0, true);
+  float fraction;
+
+  EXPECT_TRUE(grid.RayCast(b2Vec2(-2, 0.5), b2Vec2(2, 0.5), &fraction));
+  EXPECT_NEAR(fraction, 0.5, 1e-5);
+
+  EXPECT_TRUE(grid.RayCast(b2Vec2(0.5, 0.5), b2Vec2(-1.5, 0.5), &fraction));
+  EXPECT_NEAR(fraction, 0.25, 1e-5);
+}
+
+// Test the distance of the cells to the nearest occupied cell
+TEST_F(OccupancyGridTest, distance_field) {
+  EXPECT_FALSE(grid.HasDistanceField());
+  grid.SetOccupied(2, 2, true);
+  grid.BuildDistanceField();
+  EXPECT_TRUE(grid.HasDistanceField());
+
+  EXPECT_EQ(grid.GetDistance(7, 5), 0u);
+  EXPECT_EQ(grid.GetDistance(2, 2), 0u);
+  EXPECT_EQ(grid.GetDistance(9, 5), 2u);
+  EXPECT_EQ(grid.GetDistance(0, 9), 7u);  // sqrt(4 + 49) to (2, 2)
+  EXPECT_EQ(grid.GetDistance(4, 4), 2u);  // sqrt(8) to (2, 2)
+  EXPECT_EQ(grid.GetDistance(0, 0), 2u);
+
+  OccupancyGrid empty(3, 3, 1.0);
+  empty.BuildDistanceField();
+  EXPECT_EQ(empty.GetDistance(1, 1), OccupancyGrid::MAX_DISTANCE);
+}
+
+// Test rays skipping through open space on the distance field hit the same
+// as the traversal of every cell
+TEST(OccupancyGridDistanceTest, same_hits) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> cell(0, 199);
+  std::uniform_real_distribution<double> point(-5, 105);
+
+  // sparse obstacles and long walls with open space in between
+  OccupancyGrid grid(200, 200, 0.5), field(200, 200, 0.5);
+  for (int i = 0; i < 100; i++) {
+    int x = cell(rng), y = cell(rng);
+    grid.SetOccupied(x, y, true);
+  }
+  for (int x = 20; x < 180; x++) grid.SetOccupied(x, 150, true);
+  for (int y = 10; y < 100; y++) grid.SetOccupied(60, y, true);
+  field.SetData(grid.GetData().data());
+  field.BuildDistanceField();
+
+  int hits = 0;
+  for (int i = 0; i < 10000; i++) {
+    b2Vec2 p1(point(rng), point(rng)), p2(point(rng), point(rng));
+    float expected, fraction;
+    bool hit = grid.RayCast(p1, p2, &expected);
+    ASSERT_EQ(field.RayCast(p1, p2, &fraction), hit) << "ray " << i;
+    if (hit) {
+      EXPECT_NEAR(fraction, expected, 1e-5) << "ray " << i;
+      hits++;
+    }
+  }
+  EXPECT_GT(hits, 1000);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 odometry_aggregator_test.cpp
+ * @brief	 Test the odometry aggregator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_msgs/FleetOdometry.h>
+#include <flatland_server/odometry_aggregator.h>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <string>
+
+using namespace flatland_server;
+
+// A helper class to accept FleetOdometry callbacks
+struct OdometrySubscriptionHelper {
+  flatland_msgs::FleetOdometry message_;
+  int count_ = 0;
+
+  void callback(const flatland_msgs::FleetOdometryConstPtr& msg) {
+    ++count_;
+    message_ = *msg;
+  }
+
+  /**
+   * @brief Wait up to 2 seconds for a specific message count
+   * @param count The message count to wait for
+   * @return true if successful
+   */
+  bool waitForMessageCount(int count) {
+    ros::Rate rate(10);
+    for (unsigned int i = 0; i < 20; i++) {
+      ros::spinOnce();
+      if (count_ >= count) return true;
+      rate.sleep();
+    }
+    return false;
+  }
+};
+
+flatland_msgs::RobotOdometry MakeOdometry(const std::string& child,
+                                          double x) {
+  flatland_msgs::RobotOdometry odometry;
+  odometry.frame_id = "odom";
+  odometry.child_frame_id = child;
+  odometry.pose.x = x;
+  odometry.odom_pose.x = x + 0.1;
+  return odometry;
+}
+
+/**
+ * Test that the odometry sent between flushes is published in one message,
+ * with only the latest odometry of each robot
+ */
+TEST(OdometryAggregatorTest, testPublish) {
+  ros::NodeHandle nh;
+  OdometrySubscriptionHelper helper;
+  ros::Subscriber sub = nh.subscribe(
+      "/fleet_odometry", 0, &OdometrySubscriptionHelper::callback, &helper);
+
+  OdometryAggregator& aggregator = OdometryAggregator::Get();
+
+  // wait for the connection, the aggregator only publishes to subscribers
+  for (unsigned int i = 0;
+       i < 20 && aggregator.publisher_.getNumSubscribers() == 0; i++) {
+    ros::WallDuration(0.1).sleep();
+  }
+
+  aggregator.Send(MakeOdometry("robot1/base", 1));
+  aggregator.Send(MakeOdometry("robot2/base", 2));
+  aggregator.Send(MakeOdometry("robot1/base", 3));
+  aggregator.Publish(ros::Time(1.0));
+
+  ASSERT_TRUE(helper.waitForMessageCount(1));
+  EXPECT_EQ(helper.message_.header.stamp, ros::Time(1.0));
+  ASSERT_EQ(helper.message_.robots.size(), 2);
+  EXPECT_EQ(helper.message_.robots[0].child_frame_id, "robot1/base");
+  EXPECT_DOUBLE_EQ(helper.message_.robots[0].pose.x, 3);
+  EXPECT_DOUBLE_EQ(helper.message_.robots[0].odom_pose.x, 3.1);
+  EXPECT_EQ(helper.message_.robots[1].child_frame_id, "robot2/base");
+
+  // only the robots sent since the last flush are published
+  aggregator.Send(MakeOdometry("robot2/base", 4));
+  aggregator.Publish(ros::Time(1.1));
+  ASSERT_TRUE(helper.waitForMessageCount(2));
+  ASSERT_EQ(helper.message_.robots.size(), 1);
+  EXPECT_EQ(helper.message_.robots[0].child_frame_id, "robot2/base");
+  EXPECT_DOUBLE_EQ(helper.message_.robots[0].pose.x, 4);
+
+  // nothing was sent, nothing is published
+  aggregator.Publish(ros::Time(1.2));
+  EXPECT_FALSE(helper.waitForMessageCount(3));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "odometry_aggregator_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,238 @@
+#!/usr/bin/env python2
+
+'''
+This program runs the benchmarks of flatland and the fleet scenario, stores
+their results as JSON, and compares them against a stored baseline. It fails
+when a checked metric, by default the steps per second of the fleet scenario
+and the ns per beam of the laser benchmarks, is worse than the baseline by
+more than the tolerance.
+
+A missing baseline is created from the results, --update-baseline replaces
+it. Baselines only make sense on the machine they were recorded on.
+
+run with --help to see more options
+'''
+
+import argparse
+import fnmatch
+import json
+import os
+import platform
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+
+import roslib.packages
+
+# (group, package, executable) of the Google Benchmark executables
+BENCHMARKS = [
+    ("laser", "flatland_plugins", "flatland_benchmarks"),
+    ("layer", "flatland_server", "flatland_server_benchmarks"),
+    ("plugin_manager", "flatland_server",
+     "flatland_plugin_manager_benchmarks"),
+    ("box2d", "flatland_server", "flatland_box2d_benchmarks"),
+    ("visualization", "flatland_server",
+     "flatland_visualization_benchmarks"),
+    ("spawn", "flatland_plugins", "flatland_spawn_benchmarks"),
+]
+
+DEFAULT_CHECKS = ["fleet/steps_per_sec", "laser/*/ns_per_beam"]
+
+# metrics where a larger value is better, all others are times or sizes
+HIGHER_IS_BETTER = ["*steps_per_sec", "*real_time_factor", "*scans_per_sec"]
+
+NANOSECONDS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def find_executable(package, name):
+    paths = roslib.packages.find_node(package, name)
+    return paths[0] if paths else None
+
+
+def run_benchmark(group, path, args):
+    '''
+    Run a Google Benchmark executable, returns its metrics: the real time of
+    each benchmark in ns, and its counters
+    '''
+    fd, out_path = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+    try:
+        subprocess.check_call([path, "--benchmark_out=" + out_path,
+                               "--benchmark_out_format=json"] + args)
+        with open(out_path, "r") as f:
+            report = json.load(f)
+    finally:
+        os.remove(out_path)
+
+    metrics = {}
+    for entry in report["benchmarks"]:
+        if entry.get("run_type") == "aggregate":
+            continue
+        name = group + "/" + entry["name"]
+        metrics[name + "/real_time_ns"] = \
+            entry["real_time"] * NANOSECONDS[entry.get("time_unit", "ns")]
+        if "ns/beam" in entry:
+            metrics[name + "/ns_per_beam"] = entry["ns/beam"]
+        if "scans/s" in entry:
+            metrics[name + "/scans_per_sec"] = entry["scans/s"]
+        if "bytes" in entry:
+            metrics[name + "/bytes"] = entry["bytes"]
+    return metrics
+
+
+def run_fleet(path, args):
+    '''
+    Run the fleet scenario, returns its metrics
+    '''
+    fd, out_path = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+    try:
+        subprocess.check_call([path, "--json", out_path] + args)
+        with open(out_path, "r") as f:
+            report = json.load(f)
+    finally:
+        os.remove(out_path)
+    return dict(("fleet/" + key, value) for key, value in report.items())
+
+
+def run_all(options):
+    '''
+    Run all benchmarks found, returns the results with their metrics
+    '''
+    benchmark_args = shlex.split(options.benchmark_args)
+    if options.filter:
+        benchmark_args.append("--benchmark_filter=" + options.filter)
+
+    metrics = {}
+    for group, package, name in BENCHMARKS:
+        path = find_executable(package, name)
+        if path is None:
+            print("%s of %s not found, skipped" % (name, package))
+            continue
+        print("running %s" % path)
+        metrics.update(run_benchmark(group, path, benchmark_args))
+
+    path = find_executable("flatland_plugins", "fleet_benchmark")
+    if path is None:
+        print("fleet_benchmark of flatland_plugins not found, skipped")
+    else:
+        print("running %s" % path)
+        metrics.update(run_fleet(path, shlex.split(options.fleet_args)))
+
+    return {
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "machine": platform.node(),
+        "metrics": metrics,
+    }
+
+
+def matches(name, patterns):
+    return any(fnmatch.fnmatchcase(name, p) for p in patterns)
+
+
+def compare(results, baseline, checks, tolerance):
+    '''
+    Compare the checked metrics of results to the baseline, returns the
+    regressions as messages
+    '''
+    regressions = []
+    current = results["metrics"]
+    for name in sorted(baseline["metrics"]):
+        if not matches(name, checks):
+            continue
+        if name not in current:
+            print("%-60s missing from the results" % name)
+            continue
+        old, new = baseline["metrics"][name], current[name]
+        if matches(name, HIGHER_IS_BETTER):
+            regressed = new < old * (1 - tolerance)
+        else:
+            regressed = new > old * (1 + tolerance)
+        change = (new - old) / old * 100 if old else 0.0
+        print("%-60s %14.4g %14.4g %+7.1f%%%s" %
+              (name, old, new, change, "  REGRESSED" if regressed else ""))
+        if regressed:
+            regressions.append("%s regressed from %g to %g" %
+                               (name, old, new))
+    return regressions
+
+
+def write_json(path, data):
+    directory = os.path.dirname(os.path.abspath(path))
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    with open(path, "w") as f:
+        json.dump(data, f, indent=2, sort_keys=True)
+
+
+def run(options):
+    '''
+    Run the benchmarks, store the results and compare them to the baseline,
+    returns the regressions
+    '''
+    results = run_all(options)
+    if options.results:
+        write_json(options.results, results)
+        print("results written to %s" % options.results)
+
+    if options.update_baseline or not os.path.isfile(options.baseline):
+        write_json(options.baseline, results)
+        print("baseline written to %s" % options.baseline)
+        return []
+
+    with open(options.baseline, "r") as f:
+        baseline = json.load(f)
+    print("")
+    print("%-60s %14s %14s %8s" % ("metric", "baseline", "result", "change"))
+    regressions = compare(results, baseline, DEFAULT_CHECKS + options.check,
+                          options.tolerance)
+    for regression in regressions:
+        print(regression)
+    return regressions
+
+
+def parse_options(argv):
+    arg_parser = argparse.ArgumentParser(
+        description="Run the flatland benchmarks and compare them to a baseline")
+    arg_parser.add_argument("--baseline", default=os.path.expanduser(
+        "~/.ros/flatland_perf_baseline.json"),
+        help="path of the baseline, created from the results if it does not exist")
+    arg_parser.add_argument("--results", default="",
+        help="path to write the results to")
+    arg_parser.add_argument("--update-baseline", action="store_true",
+        help="replace the baseline with the results")
+    arg_parser.add_argument("--tolerance", type=float, default=0.1,
+        help="fraction a metric may be worse than the baseline, default 0.1")
+    arg_parser.add_argument("--check", action="append", default=[],
+        help="also check the metrics matching this pattern, e.g. 'layer/*'")
+    arg_parser.add_argument("--filter", default="",
+        help="regex of the Google Benchmarks to run, default all")
+    arg_parser.add_argument("--benchmark-args", default="",
+        help="more arguments of the Google Benchmark executables")
+    arg_parser.add_argument("--fleet-args", default="",
+        help="arguments of fleet_benchmark")
+    # rostest adds --gtest_output and the remappings
+    return arg_parser.parse_known_args(argv)[0]
+
+
+class PerfRegressionTest(unittest.TestCase):
+    def test_no_regression(self):
+        regressions = run(parse_options(
+            [arg for arg in sys.argv[1:] if not arg.startswith("__")]))
+        self.assertEqual(regressions, [], "\n".join(regressions))
+
+
+def main():
+    if any(arg.startswith("--gtest_output") for arg in sys.argv):
+        import rostest
+        rostest.rosrun("flatland_server", "perf_regression",
+                       PerfRegressionTest)
+    else:
+        sys.exit(1 if run(parse_options(sys.argv[1:])) else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,252 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_backend_test.cpp
+ * @brief	 Test the Box2D physics backend
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/exceptions.h>
+#include <flatland_server/physics_backend.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace flatland_server;
+
+/**
+ * A world with a static 1 x 1 m box at (2, 0) and a dynamic 0.2 m box at the
+ * origin
+ */
+class PhysicsBackendTest : public ::testing::Test {
+ protected:
+  b2World world_;
+  Body *wall_;
+  Body *robot_;
+  std::unique_ptr<PhysicsBackend> backend_;
+
+  PhysicsBackendTest() : world_(b2Vec2(0, 0)) {}
+
+  void SetUp() override {
+    wall_ = new Body(&world_, nullptr, "wall", Color(1, 1, 1, 1),
+                     Pose(2, 0, 0), b2_staticBody, YAML::Node());
+    robot_ = new Body(&world_, nullptr, "robot", Color(1, 1, 1, 1),
+                      Pose(0, 0, 0), b2_dynamicBody, YAML::Node());
+    b2PolygonShape box;
+    box.SetAsBox(0.5, 0.5);
+    wall_->physics_body_->CreateFixture(&box, 0);
+    box.SetAsBox(0.1, 0.1);
+    robot_->physics_body_->CreateFixture(&box, 1);
+    backend_ = PhysicsBackend::Create("box2d", &world_);
+  }
+
+  void TearDown() override {
+    backend_.reset();
+    delete robot_;
+    delete wall_;
+  }
+};
+
+// Test the bodies move with their velocities, on any number of threads
+TEST_F(PhysicsBackendTest, step) {
+  EXPECT_EQ(backend_->GetName(), "box2d");
+  for (unsigned int threads : {0, 2, 0}) {
+    backend_->SetThreads(threads);
+    backend_->SetTransform(robot_, b2Transform(b2Vec2(0, 0), b2Rot(0)));
+    backend_->SetVelocity(robot_, b2Vec2(1, 0), 0.5);
+    for (int i = 0; i < 10; i++) {
+      backend_->Step(0.01);
+    }
+    b2Transform transform = backend_->GetTransform(robot_);
+    EXPECT_NEAR(transform.p.x, 0.1, 1e-4);
+    EXPECT_NEAR(transform.p.y, 0, 1e-4);
+    EXPECT_NEAR(transform.q.GetAngle(), 0.05, 1e-4);
+    EXPECT_NEAR(backend_->GetLinearVelocity(robot_).x, 1, 1e-4);
+    EXPECT_NEAR(backend_->GetAngularVelocity(robot_), 0.5, 1e-4);
+  }
+
+  // pushed into the wall, the robot ends up in contact with it
+  backend_->SetTransform(robot_, b2Transform(b2Vec2(1.45, 0), b2Rot(0)));
+  backend_->SetVelocity(robot_, b2Vec2(1, 0), 0);
+  backend_->Step(0.01);
+  backend_->Step(0.01);
+  std::vector<PhysicsBackend::Contact> contacts;
+  backend_->GetContacts(&contacts);
+  ASSERT_EQ(contacts.size(), 1u);
+  EXPECT_TRUE(contacts[0].touching);
+  EXPECT_TRUE((contacts[0].body_a == wall_ && contacts[0].body_b == robot_) ||
+              (contacts[0].body_a == robot_ && contacts[0].body_b == wall_));
+}
+
+// Test the rays hit the nearest surfaces in the categories cast against
+TEST_F(PhysicsBackendTest, ray_cast) {
+  std::vector<b2RayCastInput> inputs(3);
+  inputs[0].p1.Set(-1, 0);  // hits the robot
+  inputs[1].p1.Set(-1, 1);  // hits the wall
+  inputs[2].p1.Set(-1, 2);  // hits nothing
+  for (auto &input : inputs) {
+    input.p2 = input.p1 + b2Vec2(4, 0);
+    input.maxFraction = 1;
+  }
+  inputs[1].p2.y = 0;
+
+  std::vector<PhysicsBackend::RayHit> hits(inputs.size());
+  backend_->RayCast(inputs.data(), inputs.size(), 0xFFFF, hits.data());
+  EXPECT_EQ(hits[0].body, robot_);
+  EXPECT_NEAR(hits[0].fraction, 0.9 / 4, 1e-5);
+  EXPECT_NEAR(hits[0].normal.x, -1, 1e-5);
+  EXPECT_EQ(hits[0].category_bits, 0x0001);
+  EXPECT_EQ(hits[1].body, wall_);
+  EXPECT_EQ(hits[2].body, nullptr);
+  EXPECT_EQ(hits[2].fraction, 1);
+
+  // outside of the mask, nothing is hit
+  backend_->RayCast(inputs.data(), inputs.size(), 0x0002, hits.data());
+  for (const auto &hit : hits) {
+    EXPECT_EQ(hit.body, nullptr);
+  }
+}
+
+// Test the bodies overlapping a box are found
+TEST_F(PhysicsBackendTest, query_aabb) {
+  b2AABB aabb;
+  aabb.lowerBound.Set(1, -1);
+  aabb.upperBound.Set(3, 1);
+  std::vector<Body *> found;
+  auto collect = [&](Body *body, uint32_t) {
+    found.push_back(body);
+    return true;
+  };
+  backend_->QueryAABB(aabb, 0xFFFF, collect);
+  EXPECT_EQ(found, std::vector<Body *>({wall_}));
+
+  found.clear();
+  aabb.lowerBound.Set(-3, -1);
+  backend_->QueryAABB(aabb, 0xFFFF, collect);
+  EXPECT_EQ(found.size(), 2u);
+
+  found.clear();
+  backend_->QueryAABB(aabb, 0x0002, collect);
+  EXPECT_TRUE(found.empty());
+}
+
+// Test the categories above the 16 bits of the original Box2D filters, the
+// layers 17 to 32, are hit and found
+TEST_F(PhysicsBackendTest, high_category_bits) {
+  b2Filter filter;
+  filter.categoryBits = 1u << 20;
+  wall_->physics_body_->GetFixtureList()->SetFilterData(filter);
+
+  std::vector<b2RayCastInput> inputs(1);
+  inputs[0].p1.Set(1, 0.3);
+  inputs[0].p2.Set(3, 0.3);
+  inputs[0].maxFraction = 1;
+  std::vector<PhysicsBackend::RayHit> hits(inputs.size());
+  backend_->RayCast(inputs.data(), inputs.size(), 1u << 20, hits.data());
+  EXPECT_EQ(hits[0].body, wall_);
+  EXPECT_EQ(hits[0].category_bits, 1u << 20);
+  backend_->RayCast(inputs.data(), inputs.size(), 0xFFFF, hits.data());
+  EXPECT_EQ(hits[0].body, nullptr);
+
+  b2AABB aabb;
+  aabb.lowerBound.Set(1, -1);
+  aabb.upperBound.Set(3, 1);
+  std::vector<uint32_t> categories;
+  auto collect = [&](Body *, uint32_t category) {
+    categories.push_back(category);
+    return true;
+  };
+  backend_->QueryAABB(aabb, 1u << 20, collect);
+  EXPECT_EQ(categories, std::vector<uint32_t>({1u << 20}));
+  categories.clear();
+  backend_->QueryAABB(aabb, 0xFFFF, collect);
+  EXPECT_TRUE(categories.empty());
+}
+
+// Test the statistics count the bodies, contacts, islands and TOI events
+TEST_F(PhysicsBackendTest, stats) {
+  backend_->SetVelocity(robot_, b2Vec2(1, 0), 0);
+  backend_->Step(0.01);
+  PhysicsBackend::Stats stats = backend_->GetStats();
+  EXPECT_EQ(stats.bodies, 2);
+  EXPECT_EQ(stats.awake_bodies, 1);
+  EXPECT_EQ(stats.fixtures, 2);
+  EXPECT_EQ(stats.proxies, 2);
+  EXPECT_EQ(stats.static_proxies, 1);
+  EXPECT_GE(stats.tree_quality, 1);
+  EXPECT_EQ(stats.contacts, 0);
+  EXPECT_EQ(stats.step.islandCount, 1);
+  EXPECT_EQ(stats.step.islandBodyCount, 1);
+  EXPECT_EQ(stats.step.maxIslandBodyCount, 1);
+  EXPECT_EQ(stats.step.islandSizes[0], 1);
+  EXPECT_EQ(stats.toi_events, 0u);
+
+  // too fast to stop at the wall without continuous collision
+  backend_->SetTransform(robot_, b2Transform(b2Vec2(0.9, 0), b2Rot(0)));
+  backend_->SetVelocity(robot_, b2Vec2(100, 0), 0);
+  backend_->Step(0.01);
+  stats = backend_->GetStats();
+  EXPECT_EQ(stats.toi_events, 1u);
+  EXPECT_LT(backend_->GetTransform(robot_).p.x, 1.45);
+
+  // resting against the wall, the robot shares an island with it
+  backend_->Step(0.01);
+  stats = backend_->GetStats();
+  EXPECT_EQ(stats.contacts, 1);
+  EXPECT_EQ(stats.touching_contacts, 1);
+  EXPECT_EQ(stats.step.islandCount, 1);
+  EXPECT_EQ(stats.step.maxIslandBodyCount, 2);
+  EXPECT_EQ(stats.step.islandSizes[1], 1);
+}
+
+// Test unknown backends are refused
+TEST(PhysicsBackendCreateTest, unknown_backend) {
+  b2World world(b2Vec2(0, 0));
+  EXPECT_EQ(PhysicsBackend::GetBackendNames(),
+            std::vector<std::string>({"box2d"}));
+  EXPECT_THROW(PhysicsBackend::Create("box2d_v3", &world), Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,279 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 physics_executor_test.cpp
+ * @brief	 Test the parallel island solver
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/physics_executor.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace flatland_server;
+
+/**
+ * Records the order of the PostSolve calls by the user data of the bodies
+ */
+class PostSolveRecorder : public b2ContactListener {
+ public:
+  std::vector<std::pair<intptr_t, intptr_t>> calls;
+  std::vector<std::vector<float>> impulses;
+
+  void PostSolve(b2Contact *contact, const b2ContactImpulse *impulse) override {
+    calls.emplace_back(
+        (intptr_t)contact->GetFixtureA()->GetBody()->GetUserData(),
+        (intptr_t)contact->GetFixtureB()->GetBody()->GetUserData());
+    impulses.emplace_back(impulse->normalImpulses,
+                          impulse->normalImpulses + impulse->count);
+  }
+};
+
+/**
+ * Creates a world with a static wall and many small piles of colliding boxes,
+ * some of them pushed into the wall, some of them connected by joints
+ */
+b2World *CreateWorld() {
+  b2World *world = new b2World(b2Vec2(0, 0));
+  intptr_t id = 0;
+
+  b2BodyDef wall_def;
+  wall_def.userData = (void *)id++;
+  b2Body *wall = world->CreateBody(&wall_def);
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(-1, -50), b2Vec2(-1, 50));
+  wall->CreateFixture(&edge, 0);
+
+  b2PolygonShape box;
+  box.SetAsBox(0.5, 0.5);
+  for (int i = 0; i < 40; i++) {
+    b2Body *prev = nullptr;
+    for (int j = 0; j < 3; j++) {
+      b2BodyDef def;
+      def.type = b2_dynamicBody;
+      def.userData = (void *)id++;
+      def.position.Set(j * 0.9 + (i % 4 == 0 ? -0.4 : 1), i * 2.5);
+      def.linearVelocity.Set(i % 4 == 0 ? -1 : (j - 1) * 0.5, 0.1 * j);
+      def.angularVelocity = 0.3 * (i % 3);
+      b2Body *body = world->CreateBody(&def);
+      body->CreateFixture(&box, 1 + 0.1 * j);
+
+      if (prev && i % 5 == 0) {
+        b2DistanceJointDef joint;
+        joint.Initialize(prev, body, prev->GetPosition(), body->GetPosition());
+        world->CreateJoint(&joint);
+      }
+      prev = body;
+    }
+  }
+  return world;
+}
+
+// Test that solving the islands in parallel gives exactly the same bodies
+// and PostSolve calls as solving them one after the other
+TEST(PhysicsExecutorTest, same_as_serial) {
+  for (unsigned int num_threads : {1u, 3u}) {
+    b2World *serial = CreateWorld();
+    b2World *parallel = CreateWorld();
+    PostSolveRecorder serial_recorder, parallel_recorder;
+    PhysicsExecutor executor(num_threads);
+    EXPECT_EQ(executor.GetThreadCount(), (int32)num_threads + 1);
+    serial->SetContactListener(&serial_recorder);
+    parallel->SetContactListener(&parallel_recorder);
+    parallel->SetTaskExecutor(&executor);
+
+    for (int step = 0; step < 120; step++) {
+      serial->Step(1.0 / 60, 10, 10);
+      parallel->Step(1.0 / 60, 10, 10);
+
+      for (b2Body *a = serial->GetBodyList(), *b = parallel->GetBodyList();
+           a || b; a = a->GetNext(), b = b->GetNext()) {
+        ASSERT_TRUE(a && b);
+        ASSERT_EQ(a->GetUserData(), b->GetUserData());
+        ASSERT_EQ(a->GetPosition().x, b->GetPosition().x) << "step " << step;
+        ASSERT_EQ(a->GetPosition().y, b->GetPosition().y) << "step " << step;
+        ASSERT_EQ(a->GetAngle(), b->GetAngle()) << "step " << step;
+        ASSERT_EQ(a->IsAwake(), b->IsAwake()) << "step " << step;
+      }
+    }
+
+    EXPECT_FALSE(serial_recorder.calls.empty());
+    EXPECT_EQ(serial_recorder.calls, parallel_recorder.calls);
+    EXPECT_EQ(serial_recorder.impulses, parallel_recorder.impulses);
+
+    delete serial;
+    delete parallel;
+  }
+}
+
+/**
+ * Records the Begin, End and PreSolve calls with the point counts of the
+ * manifolds
+ */
+class ContactRecorder : public b2ContactListener {
+ public:
+  std::vector<std::string> calls;
+
+  void Record(const char *type, b2Contact *contact) {
+    calls.push_back(
+        std::string(type) + " " +
+        std::to_string((intptr_t)contact->GetFixtureA()->GetUserData()) +
+        " " +
+        std::to_string((intptr_t)contact->GetFixtureB()->GetUserData()) +
+        " " + std::to_string(contact->GetManifold()->pointCount));
+  }
+
+  void BeginContact(b2Contact *contact) override { Record("begin", contact); }
+  void EndContact(b2Contact *contact) override { Record("end", contact); }
+  void PreSolve(b2Contact *contact, const b2Manifold *) override {
+    Record("presolve", contact);
+  }
+};
+
+// Test that computing the contact manifolds in parallel gives the same
+// listener calls in the same order, with many contacts starting and ending,
+// sensors, and sleeping bodies woken up by others
+TEST(PhysicsExecutorTest, narrowphase_same_as_serial) {
+  b2World *worlds[2];
+  ContactRecorder recorders[2];
+  PhysicsExecutor executor(3);
+  for (int w = 0; w < 2; w++) {
+    b2World *world = worlds[w] = new b2World(b2Vec2(0, -10));
+    world->SetContactListener(&recorders[w]);
+    intptr_t id = 0;
+
+    b2BodyDef ground_def;
+    b2Body *ground = world->CreateBody(&ground_def);
+    b2EdgeShape edge;
+    edge.Set(b2Vec2(-60, 0), b2Vec2(60, 0));
+    ground->CreateFixture(&edge, 0)->SetUserData((void *)id++);
+
+    b2PolygonShape box;
+    box.SetAsBox(0.5, 0.5);
+    b2CircleShape circle;
+    circle.m_radius = 0.4;
+    for (int i = 0; i < 300; i++) {
+      b2BodyDef def;
+      def.type = b2_dynamicBody;
+      def.position.Set((i % 50) * 2.1 - 52, 0.5 + (i / 50) * 1.05);
+      def.linearVelocity.Set(0, i % 7 == 0 ? 4 : 0);
+      b2Body *body = world->CreateBody(&def);
+      b2FixtureDef fixture_def;
+      fixture_def.shape = i % 3 ? (b2Shape *)&box : &circle;
+      fixture_def.density = 1;
+      fixture_def.isSensor = i % 11 == 0;
+      fixture_def.userData = (void *)id++;
+      body->CreateFixture(&fixture_def);
+    }
+  }
+  worlds[1]->SetTaskExecutor(&executor);
+
+  for (int step = 0; step < 240; step++) {
+    worlds[0]->Step(1.0 / 60, 8, 3);
+    worlds[1]->Step(1.0 / 60, 8, 3);
+    ASSERT_EQ(worlds[0]->GetContactCount(), worlds[1]->GetContactCount());
+    ASSERT_EQ(recorders[0].calls, recorders[1].calls) << "step " << step;
+  }
+  EXPECT_GT(worlds[0]->GetContactCount(), 300);
+
+  for (b2Body *a = worlds[0]->GetBodyList(), *b = worlds[1]->GetBodyList();
+       a || b; a = a->GetNext(), b = b->GetNext()) {
+    ASSERT_TRUE(a && b);
+    EXPECT_EQ(a->GetPosition().x, b->GetPosition().x);
+    EXPECT_EQ(a->GetPosition().y, b->GetPosition().y);
+    EXPECT_EQ(a->IsAwake(), b->IsAwake());
+  }
+
+  delete worlds[0];
+  delete worlds[1];
+}
+
+// Test that a pyramid of boxes resting on the ground stays up and is stepped
+// exactly the same way twice, whichever contact solver is compiled in
+TEST(PhysicsExecutorTest, stacking_is_repeatable) {
+  b2World *worlds[2];
+  for (b2World *&world : worlds) {
+    world = new b2World(b2Vec2(0, -10));
+    b2BodyDef ground_def;
+    b2Body *ground = world->CreateBody(&ground_def);
+    b2EdgeShape edge;
+    edge.Set(b2Vec2(-40, 0), b2Vec2(40, 0));
+    ground->CreateFixture(&edge, 0);
+
+    b2PolygonShape box;
+    box.SetAsBox(0.5, 0.5);
+    for (int i = 0; i < 12; i++) {
+      for (int j = i; j < 12; j++) {
+        b2BodyDef def;
+        def.type = b2_dynamicBody;
+        def.position.Set(j * 1.125 - i * 0.5625, 0.5 + i);
+        world->CreateBody(&def)->CreateFixture(&box, 5);
+      }
+    }
+  }
+
+  for (int step = 0; step < 300; step++) {
+    worlds[0]->Step(1.0 / 60, 8, 3);
+    worlds[1]->Step(1.0 / 60, 8, 3);
+  }
+
+  float top = 0;
+  for (b2Body *a = worlds[0]->GetBodyList(), *b = worlds[1]->GetBodyList();
+       a || b; a = a->GetNext(), b = b->GetNext()) {
+    ASSERT_TRUE(a && b);
+    EXPECT_EQ(a->GetPosition().x, b->GetPosition().x);
+    EXPECT_EQ(a->GetPosition().y, b->GetPosition().y);
+    EXPECT_EQ(a->GetAngle(), b->GetAngle());
+    top = std::max(top, a->GetPosition().y);
+  }
+  EXPECT_GT(top, 11.4);
+
+  delete worlds[0];
+  delete worlds[1];
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -50,7 +50,12 @@
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/world.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <regex>
+#include <thread>
+#include <vector>
 
 namespace fs = boost::filesystem;
 using namespace flatland_server;
@@ -115,6 +120,117 @@ class TestModelPlugin : public ModelPlugin {
   }
 };
 
+// receives the contacts of all models
+class AllContactsModelPlugin : public TestModelPlugin {
+ public:
+  bool ReceivesAllContacts() const override { return true; }
+};
+
+// records the contact events passed after the steps
+class DeferredContactsModelPlugin : public ModelPlugin {
+ public:
+  std::vector<ContactEvent> events;
+  bool world_locked = false;  ///< if the world was locked during a call
+
+  void OnInitialize(const YAML::Node &config) override {}
+
+  void ContactEvents(const std::vector<ContactEvent> &events) override {
+    this->events.insert(this->events.end(), events.begin(), events.end());
+    world_locked |= GetModel()->GetPhysicsWorld()->IsLocked();
+  }
+};
+
+// records the calls of the plugin manager, for testing parallel plugins
+class CountingModelPlugin : public ModelPlugin {
+ public:
+  bool thread_safe;
+  std::atomic<int> *before_calls;  ///< shared by all plugins of a test
+  int before_calls_seen = -1;      ///< before_calls when this plugin ran
+  std::thread::id thread;          ///< thread calling BeforePhysicsStep
+  int after_calls = 0;
+
+  CountingModelPlugin(bool thread_safe, std::atomic<int> *before_calls)
+      : thread_safe(thread_safe), before_calls(before_calls) {}
+
+  void OnInitialize(const YAML::Node &config) override {}
+
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override {
+    before_calls_seen = (*before_calls)++;
+    thread = std::this_thread::get_id();
+  }
+
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override {
+    after_calls++;
+  }
+
+  bool IsThreadSafe() const override { return thread_safe; }
+};
+
+class SubstepModelPlugin : public ModelPlugin {
+ public:
+  bool per_substep;
+  std::vector<double> before_times;  ///< sim time of BeforePhysicsStep calls
+  std::vector<double> after_times;   ///< sim time of AfterPhysicsStep calls
+  std::vector<double> step_sizes;    ///< step size of BeforePhysicsStep calls
+
+  explicit SubstepModelPlugin(bool per_substep) : per_substep(per_substep) {}
+
+  void OnInitialize(const YAML::Node &config) override {}
+
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override {
+    before_times.push_back(timekeeper.GetSimTime().toSec());
+    step_sizes.push_back(timekeeper.GetStepSize());
+  }
+
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override {
+    after_times.push_back(timekeeper.GetSimTime().toSec());
+  }
+
+  bool UpdatesPerSubstep() const override { return per_substep; }
+};
+
+// registers an update rate, for testing the scheduled plugins
+class ScheduledModelPlugin : public ModelPlugin {
+ public:
+  double rate;
+  std::vector<double> before_times;  ///< sim time of BeforePhysicsStep calls
+  int after_calls = 0;
+
+  explicit ScheduledModelPlugin(double rate) : rate(rate) {}
+
+  void OnInitialize(const YAML::Node &config) override { SetUpdateRate(rate); }
+
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override {
+    before_times.push_back(timekeeper.GetSimTime().toSec());
+  }
+
+  void AfterPhysicsStep(const Timekeeper &timekeeper) override {
+    after_calls++;
+  }
+};
+
+// skipped while its model is asleep, for testing the sleeping plugins
+class IdleModelPlugin : public ScheduledModelPlugin {
+ public:
+  IdleModelPlugin() : ScheduledModelPlugin(0) {}
+
+  bool SkipsWhileAsleep() const override { return true; }
+};
+
+// sleeps in BeforePhysicsStep, for testing the plugin costs
+class SleepingModelPlugin : public ModelPlugin {
+ public:
+  int sleep_ms;
+
+  explicit SleepingModelPlugin(int sleep_ms) : sleep_ms(sleep_ms) {}
+
+  void OnInitialize(const YAML::Node &config) override {}
+
+  void BeforePhysicsStep(const Timekeeper &timekeeper) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+  }
+};
+
 class PluginManagerTest : public ::testing::Test {
  protected:
   boost::filesystem::path this_file_dir;
@@ -298,6 +414,399 @@ TEST_F(PluginManagerTest, collision_test) {
   // ros::spin();
 }
 
+/**
+ * The contacts are only passed to the plugins of the models in contact, and
+ * to the plugins receiving all contacts
+ */
+TEST_F(PluginManagerTest, contact_dispatch) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  Model *m0 = w->models_[0];
+  Model *m1 = w->models_[1];
+  PluginManager *pm = &w->plugin_manager_;
+
+  boost::shared_ptr<TestModelPlugin> p0(new TestModelPlugin());
+  p0->Initialize("TestModelPlugin", "p0", m0, YAML::Node());
+  boost::shared_ptr<SleepingModelPlugin> sleeping(new SleepingModelPlugin(0));
+  sleeping->Initialize("SleepingModelPlugin", "sleeping", m0, YAML::Node());
+  boost::shared_ptr<TestModelPlugin> p1(new TestModelPlugin());
+  p1->Initialize("TestModelPlugin", "p1", m1, YAML::Node());
+  boost::shared_ptr<AllContactsModelPlugin> all(new AllContactsModelPlugin());
+  all->Initialize("AllContactsModelPlugin", "all", m1, YAML::Node());
+  pm->model_plugins_.push_back(p0);
+  pm->model_plugins_.push_back(sleeping);
+  pm->model_plugins_.push_back(p1);
+  pm->model_plugins_.push_back(all);
+
+  // model 0 begins in contact with the layer, model 1 touches nothing
+  w->Update(timekeeper);
+  w->Update(timekeeper);
+  EXPECT_TRUE(p0->function_called["BeginContact"]);
+  EXPECT_FALSE(p1->function_called["BeginContact"]);
+  EXPECT_TRUE(all->function_called["BeginContact"]);
+
+  // the plugin not overriding BeginContact is not called anymore
+  EXPECT_EQ(sleeping->contact_callbacks_ & FlatlandPlugin::BEGIN_CONTACT, 0);
+  EXPECT_NE(p0->contact_callbacks_ & FlatlandPlugin::BEGIN_CONTACT, 0);
+  EXPECT_NE(sleeping->contact_callbacks_ & FlatlandPlugin::END_CONTACT, 0);
+}
+
+/**
+ * The deferred contact events are passed after the step to the plugins of
+ * the models in contact
+ */
+TEST_F(PluginManagerTest, deferred_contacts) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  Model *m0 = w->models_[0];
+  Model *m1 = w->models_[1];
+  PluginManager *pm = &w->plugin_manager_;
+  pm->SetDeferredContacts(16);
+
+  boost::shared_ptr<DeferredContactsModelPlugin> p0(
+      new DeferredContactsModelPlugin());
+  p0->Initialize("DeferredContactsModelPlugin", "p0", m0, YAML::Node());
+  boost::shared_ptr<TestModelPlugin> immediate(new TestModelPlugin());
+  immediate->Initialize("TestModelPlugin", "immediate", m0, YAML::Node());
+  boost::shared_ptr<DeferredContactsModelPlugin> p1(
+      new DeferredContactsModelPlugin());
+  p1->Initialize("DeferredContactsModelPlugin", "p1", m1, YAML::Node());
+  pm->model_plugins_.push_back(p0);
+  pm->model_plugins_.push_back(immediate);
+  pm->model_plugins_.push_back(p1);
+
+  // model 0 begins in contact with the layer, model 1 touches nothing
+  w->Update(timekeeper);
+  w->Update(timekeeper);
+  ASSERT_FALSE(p0->events.empty());
+  EXPECT_EQ(p0->events[0].type, ContactEvent::BEGIN);
+  b2Fixture *fixture = m0->bodies_[0]->physics_body_->GetFixtureList();
+  EXPECT_TRUE(p0->events[0].fixture_a == fixture ||
+              p0->events[0].fixture_b == fixture);
+  EXPECT_FALSE(p0->world_locked);
+  EXPECT_TRUE(p1->events.empty());
+
+  // the contact callbacks are still called during the step
+  EXPECT_TRUE(immediate->function_called["BeginContact"]);
+  EXPECT_EQ(immediate->contact_callbacks_ & FlatlandPlugin::CONTACT_EVENTS,
+            0);
+  EXPECT_EQ(pm->contact_queue_.Size(), 0u);
+}
+
+/**
+ * This test runs thread safe plugins in parallel, which should call every
+ * plugin once per step, keep the plugins of a model on one thread, and call
+ * the other plugins once the thread safe plugins are done
+ */
+TEST_F(PluginManagerTest, parallel_plugins) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+
+  std::atomic<int> before_calls(0);
+  std::vector<boost::shared_ptr<CountingModelPlugin>> plugins;
+  for (int i = 0; i < 6; i++) {
+    // the last plugin is not thread safe
+    plugins.emplace_back(new CountingModelPlugin(i < 5, &before_calls));
+    plugins.back()->Initialize("CountingModelPlugin",
+                               "counting_plugin_" + std::to_string(i),
+                               w->models_[i % 2], YAML::Node());
+    pm->model_plugins_.push_back(plugins.back());
+  }
+  pm->SetNumThreads(2);
+
+  for (int step = 1; step <= 3; step++) {
+    w->Update(timekeeper);
+    EXPECT_EQ(before_calls, 6 * step);
+    for (const auto &p : plugins) {
+      EXPECT_EQ(p->after_calls, step);
+    }
+    EXPECT_EQ(plugins[5]->before_calls_seen, 6 * step - 1);
+
+    // models_[0] has plugins 0, 2 and 4, models_[1] has plugins 1 and 3
+    EXPECT_EQ(plugins[0]->thread, plugins[2]->thread);
+    EXPECT_EQ(plugins[0]->thread, plugins[4]->thread);
+    EXPECT_EQ(plugins[1]->thread, plugins[3]->thread);
+    EXPECT_LT(plugins[0]->before_calls_seen, plugins[2]->before_calls_seen);
+    EXPECT_LT(plugins[2]->before_calls_seen, plugins[4]->before_calls_seen);
+  }
+}
+
+/**
+ * This test sub-steps the world, which should call the plugins updated per
+ * sub-step around each Box2D sub-step, and the other plugins once per step
+ */
+TEST_F(PluginManagerTest, substep_plugins) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  w->physics_substep_size_ = 0.3;
+  PluginManager *pm = &w->plugin_manager_;
+
+  boost::shared_ptr<SubstepModelPlugin> step(new SubstepModelPlugin(false));
+  boost::shared_ptr<SubstepModelPlugin> substep(new SubstepModelPlugin(true));
+  step->Initialize("SubstepModelPlugin", "step", w->models_[0], YAML::Node());
+  substep->Initialize("SubstepModelPlugin", "substep", w->models_[0],
+                      YAML::Node());
+  pm->model_plugins_.push_back(step);
+  pm->model_plugins_.push_back(substep);
+
+  w->Update(timekeeper);
+  EXPECT_NEAR(timekeeper.GetSimTime().toSec(), 1.0, 1e-9);
+  EXPECT_EQ(step->before_times, std::vector<double>({0}));
+  EXPECT_EQ(step->step_sizes, std::vector<double>({1.0}));
+  EXPECT_EQ(step->after_times, std::vector<double>({1.0}));
+
+  // 1.0 is split into 4 sub-steps of 0.25, no larger than 0.3
+  std::vector<double> before = {0, 0.25, 0.5, 0.75};
+  std::vector<double> after = {0.25, 0.5, 0.75, 1.0};
+  ASSERT_EQ(substep->before_times.size(), 4u);
+  ASSERT_EQ(substep->after_times.size(), 4u);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_NEAR(substep->before_times[i], before[i], 1e-6);
+    EXPECT_NEAR(substep->after_times[i], after[i], 1e-6);
+    EXPECT_DOUBLE_EQ(substep->step_sizes[i], 0.25);
+  }
+
+  // without sub-stepping, all plugins are called once per step
+  w->physics_substep_size_ = 0;
+  w->Update(timekeeper);
+  EXPECT_EQ(step->before_times.size(), 2u);
+  EXPECT_EQ(substep->before_times.size(), 5u);
+  EXPECT_NEAR(substep->before_times.back(), 1.0, 1e-9);
+  EXPECT_DOUBLE_EQ(substep->step_sizes.back(), 1.0);
+}
+
+/**
+ * This test registers update rates, which should call the plugins only on
+ * the steps closest to their updates, shifted by their phase
+ */
+TEST_F(PluginManagerTest, scheduled_plugins) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(0.1);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+
+  std::vector<boost::shared_ptr<ScheduledModelPlugin>> plugins;
+  std::vector<double> rates = {2.5, 2.5,
+                               std::numeric_limits<double>::infinity()};
+  std::vector<double> phases = {0, 0.2, 0};
+  for (unsigned int i = 0; i < rates.size(); i++) {
+    plugins.emplace_back(new ScheduledModelPlugin(rates[i]));
+    plugins.back()->update_phase_ = phases[i];
+    plugins.back()->Initialize("ScheduledModelPlugin",
+                               "scheduled_" + std::to_string(i),
+                               w->models_[0], YAML::Node());
+    pm->model_plugins_.push_back(plugins.back());
+  }
+
+  for (int step = 0; step < 13; step++) {
+    w->Update(timekeeper);
+  }
+
+  std::vector<double> in_phase = {0, 0.4, 0.8, 1.2};
+  std::vector<double> shifted = {0.2, 0.6, 1.0};
+  ASSERT_EQ(plugins[0]->before_times.size(), in_phase.size());
+  ASSERT_EQ(plugins[1]->before_times.size(), shifted.size());
+  for (unsigned int i = 0; i < in_phase.size(); i++) {
+    EXPECT_NEAR(plugins[0]->before_times[i], in_phase[i], 1e-6);
+  }
+  for (unsigned int i = 0; i < shifted.size(); i++) {
+    EXPECT_NEAR(plugins[1]->before_times[i], shifted[i], 1e-6);
+  }
+  EXPECT_EQ(plugins[0]->after_calls, 4);
+  EXPECT_EQ(plugins[1]->after_calls, 3);
+  EXPECT_EQ(plugins[2]->before_times.size(), 13u);
+  EXPECT_EQ(plugins[2]->after_calls, 13);
+}
+
+/**
+ * This test staggers plugins with the same rate, they should be updated on
+ * the steps closest to their offsets, which are the same from run to run
+ */
+TEST_F(PluginManagerTest, staggered_plugins) {
+  double a = ModelPlugin::StaggerFraction("/robot_1/laser");
+  EXPECT_EQ(a, ModelPlugin::StaggerFraction("/robot_1/laser"));
+  EXPECT_NE(a, ModelPlugin::StaggerFraction("/robot_2/laser"));
+  for (const char *key : {"", "a", "/robot_1/laser", "/robot_2/laser"}) {
+    EXPECT_GE(ModelPlugin::StaggerFraction(key), 0.0);
+    EXPECT_LT(ModelPlugin::StaggerFraction(key), 1.0);
+  }
+
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(0.1);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+
+  std::vector<boost::shared_ptr<ScheduledModelPlugin>> plugins;
+  std::vector<double> staggers = {0, 0.5, 0.74};
+  for (unsigned int i = 0; i < staggers.size(); i++) {
+    plugins.emplace_back(new ScheduledModelPlugin(2.5));
+    plugins.back()->update_stagger_ = staggers[i];
+    plugins.back()->Initialize("ScheduledModelPlugin",
+                               "staggered_" + std::to_string(i),
+                               w->models_[0], YAML::Node());
+    pm->model_plugins_.push_back(plugins.back());
+  }
+
+  for (int step = 0; step < 13; step++) {
+    w->Update(timekeeper);
+  }
+
+  // the period of 0.4 s shifted by 0, 0.2 and 0.296 s
+  std::vector<std::vector<double>> expected = {
+      {0, 0.4, 0.8, 1.2}, {0.2, 0.6, 1.0}, {0.3, 0.7, 1.1}};
+  for (unsigned int i = 0; i < plugins.size(); i++) {
+    ASSERT_EQ(plugins[i]->before_times.size(), expected[i].size()) << i;
+    for (unsigned int j = 0; j < expected[i].size(); j++) {
+      EXPECT_NEAR(plugins[i]->before_times[j], expected[i][j], 1e-6) << i;
+    }
+  }
+}
+
+/**
+ * This test puts a model to sleep, its plugins skipping sleeping models should
+ * only be called at the sleeping update rate until it is woken up
+ */
+TEST_F(PluginManagerTest, sleeping_plugins) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(0.1);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+  pm->SetSleepingUpdateRate(2);
+  Model *m = w->models_[0];
+
+  boost::shared_ptr<IdleModelPlugin> idle(new IdleModelPlugin());
+  boost::shared_ptr<ScheduledModelPlugin> always(new ScheduledModelPlugin(0));
+  idle->Initialize("IdleModelPlugin", "idle", m, YAML::Node());
+  always->Initialize("ScheduledModelPlugin", "always", m, YAML::Node());
+  pm->model_plugins_.push_back(idle);
+  pm->model_plugins_.push_back(always);
+
+  for (int step = 0; step < 13; step++) {
+    m->SetAwake(false);
+    w->Update(timekeeper);
+  }
+  std::vector<double> asleep = {0, 0.5, 1.0};
+  ASSERT_EQ(idle->before_times.size(), asleep.size());
+  for (unsigned int i = 0; i < asleep.size(); i++) {
+    EXPECT_NEAR(idle->before_times[i], asleep[i], 1e-6);
+  }
+  EXPECT_EQ(idle->after_calls, 3);
+  EXPECT_EQ(always->before_times.size(), 13u);
+
+  // moving the model wakes it up
+  m->TransformAll(Pose(1, 0, 0));
+  w->Update(timekeeper);
+  ASSERT_EQ(idle->before_times.size(), 4u);
+  EXPECT_NEAR(idle->before_times[3], 1.3, 1e-6);
+}
+
+/**
+ * This test profiles plugins, which should rank them by the time spent in
+ * their callbacks, per plugin and per type
+ */
+TEST_F(PluginManagerTest, plugin_costs) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+  pm->model_plugins_.clear();
+
+  int sleeps[] = {1, 5, 2};
+  for (int i = 0; i < 3; i++) {
+    boost::shared_ptr<SleepingModelPlugin> p(
+        new SleepingModelPlugin(sleeps[i]));
+    p->Initialize("SleepingModelPlugin", "sleeping_" + std::to_string(i),
+                  w->models_[0], YAML::Node());
+    pm->model_plugins_.push_back(p);
+  }
+  boost::shared_ptr<SubstepModelPlugin> other(new SubstepModelPlugin(false));
+  other->Initialize("SubstepModelPlugin", "other", w->models_[1],
+                    YAML::Node());
+  pm->model_plugins_.push_back(other);
+
+  // nothing is measured unless profiling
+  w->Update(timekeeper);
+  EXPECT_EQ(pm->GetPluginCosts()[0].cost.calls, 0u);
+
+  pm->SetProfiling(true);
+  w->Update(timekeeper);
+  w->Update(timekeeper);
+
+  auto costs = pm->GetPluginCosts(2);
+  ASSERT_EQ(costs.size(), 2u);
+  EXPECT_EQ(costs[0].name, w->models_[0]->GetName() + "/sleeping_1");
+  EXPECT_EQ(costs[1].name, w->models_[0]->GetName() + "/sleeping_2");
+  EXPECT_EQ(costs[0].type, "SleepingModelPlugin");
+  EXPECT_GE(costs[0].cost.before_physics_step, 0.010);
+  EXPECT_GE(costs[0].cost.calls, 2u);  // BeforePhysicsStep twice, the
+                                      // default AfterPhysicsStep is dropped
+
+  auto types = pm->GetPluginTypeCosts();
+  ASSERT_EQ(types.size(), 2u);
+  EXPECT_EQ(types[0].type, "SleepingModelPlugin");
+  EXPECT_EQ(types[0].instances, 3u);
+  EXPECT_GE(types[0].cost.Total(), 0.016);
+  EXPECT_EQ(types[1].type, "SubstepModelPlugin");
+  EXPECT_EQ(types[1].instances, 1u);
+
+  pm->ResetCosts();
+  EXPECT_EQ(pm->GetPluginCosts()[0].cost.Total(), 0);
+}
+
+/**
+ * The step callbacks are only called on the plugins overriding them, the
+ * others are dropped from the dispatch lists once called
+ */
+TEST_F(PluginManagerTest, step_dispatch) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/collision_test/world.yaml");
+  timekeeper.SetMaxStepSize(1.0);
+  w = World::MakeWorld(world_yaml.string());
+  PluginManager *pm = &w->plugin_manager_;
+  pm->model_plugins_.clear();
+
+  boost::shared_ptr<SleepingModelPlugin> before(new SleepingModelPlugin(0));
+  before->Initialize("SleepingModelPlugin", "before", w->models_[0],
+                     YAML::Node());
+  boost::shared_ptr<TestModelPlugin> both(new TestModelPlugin());
+  both->Initialize("TestModelPlugin", "both", w->models_[0], YAML::Node());
+  pm->model_plugins_.push_back(before);
+  pm->model_plugins_.push_back(both);
+
+  w->Update(timekeeper);
+  EXPECT_EQ(before->step_callbacks_, FlatlandPlugin::BEFORE_PHYSICS_STEP);
+  EXPECT_EQ(both->step_callbacks_, FlatlandPlugin::ALL_STEP_CALLBACKS);
+
+  w->Update(timekeeper);
+  ASSERT_EQ(pm->before_dispatch_.plugins.size(), 2u);
+  ASSERT_EQ(pm->after_dispatch_.plugins.size(), 1u);
+  EXPECT_EQ(pm->after_dispatch_.plugins[0], both.get());
+
+  // new plugins are dispatched to until found to keep a default
+  boost::shared_ptr<SleepingModelPlugin> added(new SleepingModelPlugin(0));
+  added->Initialize("SleepingModelPlugin", "added", w->models_[1],
+                    YAML::Node());
+  pm->model_plugins_.push_back(added);
+  pm->groups_dirty_ = true;
+  w->Update(timekeeper);
+  EXPECT_EQ(pm->before_dispatch_.plugins.size(), 3u);
+  w->Update(timekeeper);
+  EXPECT_EQ(pm->after_dispatch_.plugins.size(), 1u);
+}
+
 TEST_F(PluginManagerTest, load_dummy_test) {
   world_yaml = this_file_dir /
                fs::path("plugin_manager_tests/load_dummy_test/world.yaml");
@@ -310,6 +819,43 @@ TEST_F(PluginManagerTest, load_dummy_test) {
   EXPECT_STREQ(p->GetName().c_str(), "dummy_test_plugin");
 }
 
+/**
+ * A model prepared on another thread is only added to the world, and its
+ * plugins initialized, once committed
+ */
+TEST_F(PluginManagerTest, prepare_model) {
+  world_yaml = this_file_dir /
+               fs::path("plugin_manager_tests/load_dummy_test/world.yaml");
+
+  w = World::MakeWorld(world_yaml.string());
+  ASSERT_EQ(w->plugin_manager_.model_plugins_.size(), 1);
+
+  PreparedModel prepared;
+  std::thread preparer([&]() {
+    prepared = w->PrepareModel("turtlebot.model.yaml", "robot2", "turtlebot2",
+                               Pose(1, 2, 0));
+  });
+  preparer.join();
+  ASSERT_EQ(prepared.plugins.size(), 1);
+  EXPECT_EQ(prepared.plugins[0].type, "DummyModelPlugin");
+  EXPECT_EQ(w->models_.size(), 1);
+  EXPECT_EQ(w->plugin_manager_.model_plugins_.size(), 1);
+
+  w->CommitModel(prepared);
+  ASSERT_EQ(w->models_.size(), 2);
+  EXPECT_EQ(w->models_[1]->GetName(), "turtlebot2");
+  ASSERT_EQ(w->plugin_manager_.model_plugins_.size(), 2);
+  EXPECT_EQ(w->plugin_manager_.model_plugins_[1]->GetModel(), w->models_[1]);
+  EXPECT_FLOAT_EQ(
+      w->models_[1]->bodies_[0]->physics_body_->GetPosition().x, 1);
+
+  // the name is only checked when committing
+  prepared = w->PrepareModel("turtlebot.model.yaml", "", "turtlebot2",
+                             Pose(0, 0, 0));
+  EXPECT_THROW(w->CommitModel(prepared), YAMLException);
+  EXPECT_EQ(w->models_.size(), 2);
+}
+
 TEST_F(PluginManagerTest, plugin_throws_exception) {
   world_yaml =
       this_file_dir /
@@ -0,0 +1,121 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 plugin_registry_test.cpp
+ * @brief	 Unit tests for the plugin registry
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/dummy_model_plugin.h>
+#include <flatland_server/dummy_world_plugin.h>
+#include <flatland_server/plugin_registry.h>
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace flatland_server;
+
+namespace test_plugins {
+class TestModelPlugin : public ModelPlugin {
+ public:
+  void OnInitialize(const YAML::Node &config) override {}
+};
+};
+
+FLATLAND_REGISTER_PLUGIN(test_plugins::TestModelPlugin,
+                         flatland_server::ModelPlugin)
+
+// Test that the plugins linked in are registered by their full type name,
+// under their base class only
+TEST(PluginRegistryTest, linked_plugins) {
+  PluginRegistry<ModelPlugin>::Factory factory =
+      PluginRegistry<ModelPlugin>::Find("test_plugins::TestModelPlugin");
+  ASSERT_NE(factory, nullptr);
+  std::unique_ptr<ModelPlugin> plugin(factory());
+  EXPECT_NE(dynamic_cast<test_plugins::TestModelPlugin *>(plugin.get()),
+            nullptr);
+
+  // the dummy plugins are part of the server library
+  factory = PluginRegistry<ModelPlugin>::Find(
+      "flatland_plugins::DummyModelPlugin");
+  ASSERT_NE(factory, nullptr);
+  plugin.reset(factory());
+  EXPECT_NE(dynamic_cast<flatland_plugins::DummyModelPlugin *>(plugin.get()),
+            nullptr);
+  EXPECT_NE(PluginRegistry<WorldPlugin>::Find(
+                "flatland_plugins::DummyWorldPlugin"),
+            nullptr);
+
+  EXPECT_EQ(PluginRegistry<WorldPlugin>::Find(
+                "flatland_plugins::DummyModelPlugin"),
+            nullptr);
+  EXPECT_EQ(PluginRegistry<ModelPlugin>::Find("DummyModelPlugin"), nullptr);
+  EXPECT_EQ(PluginRegistry<ModelPlugin>::Find("test_plugins::Missing"),
+            nullptr);
+}
+
+// Test that a registrar removes its factory when destroyed, as when its
+// library is unloaded, but leaves a factory added for the type since
+TEST(PluginRegistryTest, registrar_lifetime) {
+  const char *type = "test_plugins::ScopedModelPlugin";
+  {
+    PluginRegistrar<ModelPlugin, test_plugins::TestModelPlugin> registrar(
+        type);
+    EXPECT_NE(PluginRegistry<ModelPlugin>::Find(type), nullptr);
+  }
+  EXPECT_EQ(PluginRegistry<ModelPlugin>::Find(type), nullptr);
+
+  PluginRegistry<ModelPlugin>::Factory other =
+      PluginRegistry<ModelPlugin>::Find("flatland_plugins::DummyModelPlugin");
+  {
+    PluginRegistrar<ModelPlugin, test_plugins::TestModelPlugin> registrar(
+        type);
+    PluginRegistry<ModelPlugin>::Register(type, other);
+  }
+  EXPECT_EQ(PluginRegistry<ModelPlugin>::Find(type), other);
+  PluginRegistry<ModelPlugin>::Unregister(type, other);
+  EXPECT_EQ(PluginRegistry<ModelPlugin>::Find(type), nullptr);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
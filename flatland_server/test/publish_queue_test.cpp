@@ -0,0 +1,121 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 publish_queue_test.cpp
+ * @brief	 Test the queue of the publisher threads
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/publish_queue.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace flatland_server;
+
+// Test that the messages of each topic are published in order by the threads
+TEST(PublishQueueTest, order) {
+  PublishQueue &queue = PublishQueue::Get();
+  EXPECT_FALSE(PublishQueue::IsEnabled());
+  queue.Start(2, 100);
+  EXPECT_TRUE(PublishQueue::IsEnabled());
+
+  std::mutex mutex;
+  std::vector<int> a, b;
+  for (int i = 0; i < 50; i++) {
+    queue.Post("a", [&, i]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      a.push_back(i);
+    });
+    queue.Post("b", [&, i]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      b.push_back(i);
+    });
+  }
+  queue.Flush();
+  ASSERT_EQ(a.size(), 50u);
+  ASSERT_EQ(b.size(), 50u);
+  for (int i = 0; i < 50; i++) {
+    EXPECT_EQ(a[i], i);
+    EXPECT_EQ(b[i], i);
+  }
+  EXPECT_EQ(queue.GetCoalescedCount(), 0u);
+
+  queue.Stop();
+  EXPECT_FALSE(PublishQueue::IsEnabled());
+}
+
+// Test that the oldest messages of a topic falling behind are dropped
+TEST(PublishQueueTest, coalesce) {
+  PublishQueue &queue = PublishQueue::Get();
+  queue.Start(1, 2);
+
+  // the thread is held by the first message while the others wait
+  std::atomic<bool> started(false), release(false);
+  std::vector<int> published;
+  queue.Post("slow", [&]() {
+    started = true;
+    while (!release) std::this_thread::yield();
+    published.push_back(0);
+  });
+  while (!started) std::this_thread::yield();
+  for (int i = 1; i <= 5; i++) {
+    queue.Post("slow", [&, i]() { published.push_back(i); });
+  }
+  EXPECT_EQ(queue.GetCoalescedCount(), 3u);
+
+  release = true;
+  queue.Stop();
+  ASSERT_EQ(published.size(), 3u);
+  EXPECT_EQ(published[0], 0);
+  EXPECT_EQ(published[1], 4);
+  EXPECT_EQ(published[2], 5);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 raster_batch_test.cpp
+ * @brief	 Test the batch top down rendering
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/raster_batch.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace flatland_server;
+
+/**
+ * A 4 x 4 meter view of 40 x 40 pixels, the pixel of a point at (x, y) in
+ * the view frame is at row 20 - 10 x and column 20 - 10 y
+ */
+static RasterBatch::Params MakeParams() {
+  RasterBatch::Params params;
+  params.resolution = 0.1;
+  params.width = 40;
+  params.height = 40;
+  params.layers_bits = 0xFFFF;
+  return params;
+}
+
+/**
+ * @brief Add a static wall from (1, -1) to (1, 1) and a dynamic 0.2 m box at
+ * (0, 1.5)
+ * @return The box
+ */
+static b2Body *AddGeometry(b2World *world) {
+  b2BodyDef wall_def;
+  b2Body *wall = world->CreateBody(&wall_def);
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(1, -1), b2Vec2(1, 1));
+  wall->CreateFixture(&edge, 0);
+
+  b2BodyDef box_def;
+  box_def.type = b2_dynamicBody;
+  box_def.position.Set(0, 1.5);
+  b2Body *box = world->CreateBody(&box_def);
+  b2PolygonShape polygon;
+  polygon.SetAsBox(0.1, 0.1);
+  box->CreateFixture(&polygon, 1);
+  return box;
+}
+
+// Test the geometry is drawn in the frame of the view
+TEST(RasterBatchTest, rasterize) {
+  b2World world(b2Vec2(0, 0));
+  AddGeometry(&world);
+  RasterBatch::Params params = MakeParams();
+  std::vector<uint8_t> image(40 * 40, 1);
+
+  // facing x, the wall is ahead and the box to the left
+  RasterBatch::Rasterize(&world, b2Transform(b2Vec2(0, 0), b2Rot(0)), params,
+                         image.data());
+  EXPECT_EQ(image[10 * 40 + 20], RasterBatch::STATIC);
+  EXPECT_EQ(image[10 * 40 + 11], RasterBatch::STATIC);
+  EXPECT_EQ(image[10 * 40 + 29], RasterBatch::STATIC);
+  EXPECT_EQ(image[10 * 40 + 35], RasterBatch::FREE);
+  EXPECT_EQ(image[20 * 40 + 5], RasterBatch::DYNAMIC);
+  EXPECT_EQ(image[20 * 40 + 20], RasterBatch::FREE);
+  EXPECT_EQ(image[19 * 40 + 4], RasterBatch::DYNAMIC);
+  EXPECT_EQ(image[22 * 40 + 5], RasterBatch::FREE);
+
+  // facing y, the box is ahead and the wall to the right
+  RasterBatch::Rasterize(&world,
+                         b2Transform(b2Vec2(0, 0), b2Rot(M_PI / 2)), params,
+                         image.data());
+  EXPECT_EQ(image[5 * 40 + 20], RasterBatch::DYNAMIC);
+  EXPECT_EQ(image[20 * 40 + 30], RasterBatch::STATIC);
+  EXPECT_EQ(image[20 * 40 + 5], RasterBatch::FREE);
+
+  // fixtures outside of the layers are not drawn
+  params.layers_bits = 0x0002;
+  RasterBatch::Rasterize(&world, b2Transform(b2Vec2(0, 0), b2Rot(0)), params,
+                         image.data());
+  for (uint8_t pixel : image) {
+    ASSERT_EQ(pixel, RasterBatch::FREE);
+  }
+}
+
+// Test the requested views are rendered at the pose of their bodies
+TEST(RasterBatchTest, render) {
+  b2World world(b2Vec2(0, 0));
+  b2Body *box = AddGeometry(&world);
+  Body *robot = new Body(&world, nullptr, "robot", Color(1, 1, 1, 1),
+                         Pose(0, 0, 0), b2_dynamicBody, YAML::Node());
+
+  RasterBatch batch;
+  RasterBatch::Params params = MakeParams();
+  params.body = robot;
+  int a = batch.Add(params);
+  params.origin = Pose(0, 0, M_PI / 2);
+  int b = batch.Add(params);
+  EXPECT_EQ(batch.Size(), 2u);
+
+  std::vector<int> done;
+  batch.Request(a, [&] { done.push_back(a); });
+  batch.Request(b, [&] { done.push_back(b); });
+  batch.Render();
+  EXPECT_EQ(done, std::vector<int>({a, b}));
+  EXPECT_EQ(batch.GetImage(a)[20 * 40 + 5], RasterBatch::DYNAMIC);
+  EXPECT_EQ(batch.GetImage(b)[5 * 40 + 20], RasterBatch::DYNAMIC);
+
+  // only the requested views are rendered again
+  box->SetTransform(b2Vec2(0, -1.5), 0);
+  batch.Request(b, [&] { done.push_back(b); });
+  batch.Render();
+  EXPECT_EQ(done.size(), 3u);
+  EXPECT_EQ(batch.GetImage(a)[20 * 40 + 5], RasterBatch::DYNAMIC);
+  EXPECT_EQ(batch.GetImage(b)[35 * 40 + 20], RasterBatch::DYNAMIC);
+  EXPECT_EQ(batch.GetImage(b)[5 * 40 + 20], RasterBatch::FREE);
+
+  // the requests of removed views are dropped, their ids reused
+  batch.Request(a, [&] { done.push_back(a); });
+  batch.Remove(a);
+  batch.Render();
+  EXPECT_EQ(done.size(), 3u);
+  EXPECT_EQ(batch.Add(params), a);
+
+  delete robot;
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 real_time_pacer_test.cpp
+ * @brief	 Tests for the real time factor pacing
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/real_time_pacer.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+
+/**
+ * Run a simulated loop where each step costs step_cost wall seconds, and
+ * return the achieved real time factor after wall_duration seconds
+ */
+double RunLoop(RealTimePacer *pacer, double step_size, double step_cost,
+               double wall_duration, unsigned int *max_steps = nullptr) {
+  double wall = 100, sim = 0;
+  pacer->Reset(wall, sim);
+  while (wall < 100 + wall_duration) {
+    double sleep;
+    unsigned int steps = pacer->NextCycle(wall, sim, step_size, &sleep);
+    EXPECT_GE(sleep, 0);
+    EXPECT_GE(steps, 1u);
+    if (max_steps) *max_steps = std::max(*max_steps, steps);
+    wall += sleep + steps * step_cost;
+    sim += steps * step_size;
+  }
+  return sim / (wall - 100);
+}
+
+// Test that a fast simulation sleeps to hold the target factor
+TEST(RealTimePacerTest, sleeps_when_ahead) {
+  for (double target : {0.5, 1.0, 5.0}) {
+    RealTimePacer pacer(target);
+    double factor = RunLoop(&pacer, 0.005, 0.0001, 10);
+    EXPECT_NEAR(factor, target, target * 0.01) << "target " << target;
+    EXPECT_EQ(pacer.GetSlipCount(), 0u);
+  }
+}
+
+// Test that a slow simulation runs several steps per cycle to catch up
+TEST(RealTimePacerTest, catches_up_when_behind) {
+  // each step costs 1.5 times its simulated time, so at most 1 / 1.5 of the
+  // target is reached by stepping as fast as possible
+  RealTimePacer single(1.0, 1, 1e9);
+  double factor = RunLoop(&single, 0.01, 0.015, 10);
+  EXPECT_NEAR(factor, 1 / 1.5, 0.01);
+
+  // each cycle has a fixed cost larger than a step, e.g. publishing, while
+  // the steps are cheap: with catch up steps the target is held
+  RealTimePacer pacer(1.0, 10);
+  double wall = 0, sim = 0;
+  pacer.Reset(wall, sim);
+  unsigned int max_steps = 0;
+  for (int i = 0; i < 1000; i++) {
+    double sleep;
+    unsigned int steps = pacer.NextCycle(wall, sim, 0.01, &sleep);
+    max_steps = std::max(max_steps, steps);
+    wall += sleep + 0.02 + (steps - 1) * 0.001;
+    sim += steps * 0.01;
+  }
+  EXPECT_GT(max_steps, 1u);
+  EXPECT_NEAR(sim / wall, 1.0, 0.02);
+  EXPECT_EQ(pacer.GetSlipCount(), 0u);
+}
+
+// Test that a lag larger than max_lag is dropped instead of caught up
+TEST(RealTimePacerTest, drops_large_lag) {
+  RealTimePacer pacer(1.0, 100, 0.5);
+  pacer.Reset(0, 0);
+  double sleep;
+
+  // the simulation stalled for 10s
+  EXPECT_EQ(pacer.NextCycle(10, 0, 0.01, &sleep), 1u);
+  EXPECT_EQ(sleep, 0);
+  EXPECT_EQ(pacer.GetSlipCount(), 1u);
+
+  // the target is measured from the stall on
+  EXPECT_EQ(pacer.NextCycle(10, 0.01, 0.01, &sleep), 1u);
+  EXPECT_NEAR(sleep, 0.01, 1e-9);
+
+  // a small lag is caught up, with the step partly ahead of the target
+  EXPECT_EQ(pacer.NextCycle(10.2, 0.01, 0.01, &sleep), 20u);
+  EXPECT_EQ(sleep, 0);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
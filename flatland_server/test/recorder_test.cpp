@@ -0,0 +1,197 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 recorder_test.cpp
+ * @brief	 Test the run log and the recorder
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/recorder.h>
+#include <flatland_server/run_log.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+class RecorderTest : public ::testing::Test {
+ public:
+  fs::path dir;
+  std::string path;
+
+  void SetUp() override {
+    dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    path = (dir / "run.log").string();
+  }
+
+  void TearDown() override {
+    Recorder::Get().Stop();
+    fs::remove_all(dir);
+  }
+};
+
+// Test that records read back as they were written
+TEST_F(RecorderTest, run_log_round_trip) {
+  std::vector<uint8_t> big(300, 7);
+  RunLog::Writer writer(path);
+  writer.Write(0, RunLog::Record::SEED, "seed:a", {1, 2, 3, 4});
+  writer.Write(0, RunLog::Record::DATA, "topic:/cmd_vel", {5});
+  writer.Write(200, RunLog::Record::DATA, "topic:/cmd_vel", big);
+  writer.Write(200, RunLog::Record::DATA, "service:/pause", {});
+  writer.Write(100000, RunLog::Record::DATA, "topic:/cmd_vel", {6, 7});
+  EXPECT_THROW(writer.Write(5, RunLog::Record::DATA, "topic:/cmd_vel", {}),
+               Exception);
+  writer.Close(100010);
+
+  std::vector<RunLog::Record> records = RunLog::Read(path);
+  ASSERT_EQ(records.size(), 6u);
+  EXPECT_EQ(records[0].step, 0u);
+  EXPECT_EQ(records[0].type, RunLog::Record::SEED);
+  EXPECT_EQ(records[0].channel, "seed:a");
+  EXPECT_EQ(records[0].data, std::vector<uint8_t>({1, 2, 3, 4}));
+  EXPECT_EQ(records[1].channel, "topic:/cmd_vel");
+  EXPECT_EQ(records[1].data, std::vector<uint8_t>({5}));
+  EXPECT_EQ(records[2].step, 200u);
+  EXPECT_EQ(records[2].data, big);
+  EXPECT_EQ(records[3].channel, "service:/pause");
+  EXPECT_TRUE(records[3].data.empty());
+  EXPECT_EQ(records[4].step, 100000u);
+  EXPECT_EQ(records[4].type, RunLog::Record::DATA);
+  EXPECT_EQ(records[4].channel, "topic:/cmd_vel");
+  EXPECT_EQ(records[5].step, 100010u);
+  EXPECT_EQ(records[5].type, RunLog::Record::END);
+
+  // the channel names are only stored once
+  EXPECT_LT(fs::file_size(path), 400u);
+}
+
+// Test that a log cut in the middle of a record keeps the complete records
+TEST_F(RecorderTest, run_log_truncated) {
+  {
+    RunLog::Writer writer(path);
+    writer.Write(3, RunLog::Record::DATA, "a", {1});
+    writer.Write(8, RunLog::Record::DATA, "a", {1, 2, 3});
+  }
+  fs::resize_file(path, fs::file_size(path) - 1);
+
+  std::vector<RunLog::Record> records = RunLog::Read(path);
+  ASSERT_EQ(records.size(), 2u);
+  EXPECT_EQ(records[0].step, 3u);
+  EXPECT_EQ(records[1].step, 3u);
+  EXPECT_EQ(records[1].type, RunLog::Record::END);
+}
+
+// Test that invalid logs throw
+TEST_F(RecorderTest, run_log_invalid) {
+  EXPECT_THROW(RunLog::Read((dir / "missing.log").string()), Exception);
+  std::ofstream(path) << "not a run log";
+  EXPECT_THROW(RunLog::Read(path), Exception);
+  EXPECT_THROW(RunLog::Writer((dir / "no/such/dir.log").string()), Exception);
+}
+
+// Test that a recorded run replays its seeds and inputs on the same steps
+TEST_F(RecorderTest, record_replay) {
+  Recorder &recorder = Recorder::Get();
+  EXPECT_FALSE(recorder.IsRecording());
+  EXPECT_FALSE(recorder.IsReplaying());
+
+  // not recorded
+  recorder.Record("topic:/cmd_vel", {9});
+
+  recorder.StartRecording(path);
+  EXPECT_TRUE(recorder.IsRecording());
+  uint32_t seed_a = recorder.Seed("seed:a");
+  uint32_t seed_b = recorder.Seed("seed:b");
+  recorder.Record("topic:/cmd_vel", {1});
+  recorder.SetStep(4);
+  recorder.Record("topic:/cmd_vel", {2});
+  recorder.Record("service:/pause", {});
+  recorder.SetStep(9);
+  uint32_t seed_a2 = recorder.Seed("seed:a");
+  recorder.Record("topic:/unknown", {3});
+  recorder.SetStep(12);
+  recorder.Stop();
+  EXPECT_FALSE(recorder.IsRecording());
+
+  std::vector<std::pair<uint64_t, std::vector<uint8_t>>> cmd_vel;
+  int pauses = 0;
+  uint64_t step = 0;
+  unsigned int old_id = recorder.AddHandler(
+      "topic:/cmd_vel", [&](const std::vector<uint8_t> &) { FAIL(); });
+  recorder.AddHandler("topic:/cmd_vel", [&](const std::vector<uint8_t> &data) {
+    cmd_vel.emplace_back(step, data);
+  });
+  unsigned int pause_id = recorder.AddHandler(
+      "service:/pause", [&](const std::vector<uint8_t> &) { pauses++; });
+  recorder.RemoveHandler(old_id);  // already replaced
+
+  recorder.StartReplay(path);
+  EXPECT_TRUE(recorder.IsReplaying());
+  EXPECT_EQ(recorder.Seed("seed:b"), seed_b);
+  EXPECT_EQ(recorder.Seed("seed:a"), seed_a);
+  EXPECT_EQ(recorder.Seed("seed:a"), seed_a2);
+  EXPECT_EQ(recorder.GetMismatchCount(), 0u);
+  recorder.Seed("seed:a");  // not recorded
+  EXPECT_EQ(recorder.GetMismatchCount(), 1u);
+
+  for (step = 0; recorder.ReplayStep(step); step++) {
+    if (step == 4) recorder.RemoveHandler(pause_id);
+  }
+  EXPECT_EQ(step, 12u);
+  ASSERT_EQ(cmd_vel.size(), 2u);
+  EXPECT_EQ(cmd_vel[0], std::make_pair(uint64_t(0), std::vector<uint8_t>{1}));
+  EXPECT_EQ(cmd_vel[1], std::make_pair(uint64_t(4), std::vector<uint8_t>{2}));
+  EXPECT_EQ(pauses, 1);
+  EXPECT_EQ(recorder.GetMismatchCount(), 2u);  // topic:/unknown
+
+  recorder.Stop();
+  EXPECT_FALSE(recorder.IsReplaying());
+  EXPECT_TRUE(recorder.ReplayStep(100));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
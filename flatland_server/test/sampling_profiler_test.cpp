@@ -0,0 +1,144 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sampling_profiler_test.cpp
+ * @brief	 Test the sampling profiler
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/sampling_profiler.h>
+#include <flatland_server/tracer.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+using namespace flatland_server;
+
+// Use the CPU for a duration, so the profiling timer fires
+double Spin(double seconds) {
+  double sum = 0;
+  auto end = std::chrono::steady_clock::now() +
+             std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 1000; i++) {
+      sum += std::sqrt(double(i));
+    }
+  }
+  return sum;
+}
+
+// Test that the samples are taken while sampling and grouped by trace span
+TEST(SamplingProfilerTest, sample) {
+  SamplingProfiler &profiler = SamplingProfiler::Get();
+  Tracer::Get().Start();
+  profiler.Start(1000);
+  EXPECT_TRUE(profiler.IsRunning());
+  {
+    FLATLAND_TRACE("test", "busy");
+    Spin(0.2);
+  }
+  profiler.Stop();
+  Tracer::Get().Stop();
+  EXPECT_FALSE(profiler.IsRunning());
+
+  // the timer counts the CPU time of the process, about 200 samples
+  size_t samples = profiler.GetSampleCount();
+  EXPECT_GT(samples, 20u);
+  EXPECT_EQ(profiler.GetDroppedCount(), 0u);
+
+  // no more samples once stopped
+  Spin(0.05);
+  EXPECT_EQ(profiler.GetSampleCount(), samples);
+
+  std::ostringstream out;
+  EXPECT_EQ(profiler.WriteFolded(out, "world"), samples);
+  std::istringstream lines(out.str());
+  std::string line;
+  size_t total = 0, busy = 0;
+  while (std::getline(lines, line)) {
+    EXPECT_EQ(line.find("world;"), 0u);
+    size_t count = std::stoul(line.substr(line.rfind(' ') + 1));
+    total += count;
+    if (line.find("world;[busy];") == 0) {
+      busy += count;
+    }
+  }
+  EXPECT_EQ(total, samples);
+  EXPECT_GT(busy, samples / 2);
+}
+
+// Test that the samples past the buffer are dropped
+TEST(SamplingProfilerTest, dropped) {
+  SamplingProfiler &profiler = SamplingProfiler::Get();
+  profiler.Start(1000, 5);
+  Spin(0.1);
+  profiler.Stop();
+  EXPECT_EQ(profiler.GetSampleCount(), 5u);
+  EXPECT_GT(profiler.GetDroppedCount(), 0u);
+}
+
+// Test that invalid frequencies and a second start throw
+TEST(SamplingProfilerTest, invalid_start) {
+  SamplingProfiler &profiler = SamplingProfiler::Get();
+  EXPECT_THROW(profiler.Start(0), Exception);
+  EXPECT_THROW(profiler.Start(20000), Exception);
+  EXPECT_FALSE(profiler.IsRunning());
+
+  profiler.Start(100);
+  EXPECT_THROW(profiler.Start(100), Exception);
+  profiler.Stop();
+}
+
+// Test that writing to an invalid path throws
+TEST(SamplingProfilerTest, dump_invalid_path) {
+  EXPECT_THROW(SamplingProfiler::Get().DumpFolded(
+                   "/nonexistent/dir/profile.folded", "world"),
+               Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
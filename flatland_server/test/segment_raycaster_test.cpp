@@ -0,0 +1,152 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 segment_raycaster_test.cpp
+ * @brief	 Test the vectorized segment raycaster
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/segment_raycaster.h>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace flatland_server;
+
+/**
+ * Reference raycast against all of the segments one by one using Box2D
+ */
+bool RayCastBox2D(const std::vector<LineSegment> &segments, const b2Vec2 &p1,
+                  const b2Vec2 &p2, float *fraction) {
+  b2RayCastInput input;
+  input.p1 = p1;
+  input.p2 = p2;
+  input.maxFraction = 1.0f;
+  bool hit = false;
+
+  for (const auto &s : segments) {
+    b2EdgeShape edge;
+    edge.Set(s.start.Box2D(), s.end.Box2D());
+    b2RayCastOutput output;
+    if (edge.RayCast(&output, input, b2Transform(b2Vec2_zero, b2Rot(0)), 0)) {
+      input.maxFraction = output.fraction;
+      hit = true;
+    }
+  }
+
+  *fraction = input.maxFraction;
+  return hit;
+}
+
+// Test simple hits and misses
+TEST(SegmentRaycasterTest, simple_rays) {
+  std::vector<LineSegment> segments;
+  segments.push_back(LineSegment(Vec2(2, -1), Vec2(2, 1)));
+  segments.push_back(LineSegment(Vec2(4, -1), Vec2(4, 1)));
+  SegmentRaycaster raycaster(segments);
+  EXPECT_EQ(raycaster.GetSegmentCount(), 2);
+
+  float fraction;
+  EXPECT_TRUE(raycaster.RayCast(b2Vec2(0, 0), b2Vec2(5, 0), &fraction));
+  EXPECT_NEAR(fraction, 0.4, 1e-5);
+
+  EXPECT_TRUE(raycaster.RayCast(b2Vec2(5, 0.5), b2Vec2(0, 0.5), &fraction));
+  EXPECT_NEAR(fraction, 0.2, 1e-5);
+
+  EXPECT_TRUE(raycaster.RayCast(b2Vec2(3, 0), b2Vec2(5, 0), &fraction));
+  EXPECT_NEAR(fraction, 0.5, 1e-5);
+
+  EXPECT_FALSE(raycaster.RayCast(b2Vec2(0, 0), b2Vec2(1.5, 0), &fraction));
+  EXPECT_FALSE(raycaster.RayCast(b2Vec2(0, 2), b2Vec2(5, 2), &fraction));
+  EXPECT_FALSE(raycaster.RayCast(b2Vec2(-10, 0), b2Vec2(-5, 0), &fraction));
+
+  // parallel to the segments
+  EXPECT_FALSE(raycaster.RayCast(b2Vec2(3, -2), b2Vec2(3, 2), &fraction));
+}
+
+// Test no segments never hit
+TEST(SegmentRaycasterTest, empty) {
+  SegmentRaycaster raycaster((std::vector<LineSegment>()));
+  float fraction;
+  EXPECT_FALSE(raycaster.RayCast(b2Vec2(0, 0), b2Vec2(5, 0), &fraction));
+}
+
+// Test against Box2D edge raycasting on random segments and rays
+TEST(SegmentRaycasterTest, matches_box2d) {
+  std::default_random_engine rng(1234);
+  std::uniform_real_distribution<float> pos(-20, 20);
+  std::uniform_real_distribution<float> len(-3, 3);
+
+  std::vector<LineSegment> segments;
+  for (int i = 0; i < 500; i++) {
+    float x = pos(rng), y = pos(rng);
+    segments.push_back(
+        LineSegment(Vec2(x, y), Vec2(x + len(rng), y + len(rng))));
+  }
+  // a few long walls crossing many buckets
+  segments.push_back(LineSegment(Vec2(-20, -20), Vec2(20, 20)));
+  segments.push_back(LineSegment(Vec2(-20, 15), Vec2(20, 15)));
+
+  SegmentRaycaster raycaster(segments);
+
+  int hits = 0;
+  for (int i = 0; i < 2000; i++) {
+    b2Vec2 p1(pos(rng), pos(rng));
+    b2Vec2 p2(pos(rng) * 1.5, pos(rng) * 1.5);
+
+    float expected, actual;
+    bool expected_hit = RayCastBox2D(segments, p1, p2, &expected);
+    bool actual_hit = raycaster.RayCast(p1, p2, &actual);
+
+    ASSERT_EQ(actual_hit, expected_hit) << "ray " << i;
+    if (expected_hit) {
+      hits++;
+      ASSERT_NEAR(actual, expected, 1e-4) << "ray " << i;
+    }
+  }
+
+  EXPECT_GT(hits, 1000);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_executor_test.cpp
+ * @brief	 Test the shared sensor executor
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/sensor_executor.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace flatland_server;
+
+// Test every item is visited exactly once for all chunk sizes
+TEST(SensorExecutorTest, parallel_for_covers_range) {
+  SensorExecutor &executor = SensorExecutor::Get();
+  executor.SetNumThreads(4);
+  EXPECT_EQ(executor.GetNumThreads(), 4);
+
+  for (unsigned int chunk_size : {0u, 1u, 7u, 1000u}) {
+    std::vector<int> visits(1081, 0);
+    executor.ParallelFor(visits.size(), chunk_size,
+                         [&visits](unsigned int begin, unsigned int end) {
+                           for (unsigned int i = begin; i < end; i++) {
+                             visits[i]++;
+                           }
+                         });
+
+    for (unsigned int i = 0; i < visits.size(); i++) {
+      ASSERT_EQ(visits[i], 1) << "index " << i << " chunk " << chunk_size;
+    }
+  }
+}
+
+// Test submitted tasks all run, including after changing the thread count
+TEST(SensorExecutorTest, submit_and_resize) {
+  SensorExecutor &executor = SensorExecutor::Get();
+  std::atomic<int> count(0);
+
+  executor.SetNumThreads(2);
+  for (int i = 0; i < 100; i++) {
+    executor.Submit([&count] { count++; }, SensorExecutor::LOW);
+  }
+
+  // resizing finishes all the tasks in the queues first
+  executor.SetNumThreads(3);
+  EXPECT_EQ(count, 100);
+  EXPECT_EQ(executor.GetNumThreads(), 3);
+
+  executor.ParallelFor(10, 1, [&count](unsigned int, unsigned int) { count++; },
+                       SensorExecutor::HIGH);
+  EXPECT_EQ(count, 110);
+}
+
+// Test resizing while other threads submit tasks and tasks submit tasks
+TEST(SensorExecutorTest, resize_while_submitting) {
+  SensorExecutor &executor = SensorExecutor::Get();
+  std::atomic<int> count(0);
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> submitters;
+  for (int t = 0; t < 3; t++) {
+    submitters.emplace_back([&] {
+      while (!done) {
+        executor.Submit([&] { executor.Submit([&count] { count++; }); });
+        executor.ParallelFor(8, 1, [](unsigned int, unsigned int) {});
+      }
+    });
+  }
+
+  for (unsigned int threads = 1; threads <= 20; threads++) {
+    executor.SetNumThreads(threads % 4 + 1);
+  }
+  done = true;
+  for (auto &submitter : submitters) {
+    submitter.join();
+  }
+
+  // the queues are drained by a restart
+  executor.SetNumThreads(2);
+  EXPECT_GT(count, 0);
+  EXPECT_EQ(executor.GetQueuedTasks(), 0);
+}
+
+// Test the requests of the worlds are compared until released
+TEST(SensorExecutorTest, request_threads) {
+  SensorExecutor &executor = SensorExecutor::Get();
+
+  EXPECT_TRUE(executor.Request(2));
+  EXPECT_TRUE(executor.Request(2));
+  EXPECT_EQ(executor.GetNumThreads(), 2);
+
+  EXPECT_FALSE(executor.Request(3));
+  EXPECT_EQ(executor.GetNumThreads(), 3);
+
+  executor.Release(2);
+  executor.Release(2);
+  EXPECT_TRUE(executor.Request(3));
+  executor.Release(3);
+  executor.Release(3);
+
+  EXPECT_TRUE(executor.Request(1));
+  executor.Release(1);
+}
+
+// Test priority strings
+TEST(SensorExecutorTest, parse_priority) {
+  EXPECT_EQ(SensorExecutor::ParsePriority("high"), SensorExecutor::HIGH);
+  EXPECT_EQ(SensorExecutor::ParsePriority("normal"), SensorExecutor::NORMAL);
+  EXPECT_EQ(SensorExecutor::ParsePriority("low"), SensorExecutor::LOW);
+  EXPECT_THROW(SensorExecutor::ParsePriority("urgent"), YAMLException);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
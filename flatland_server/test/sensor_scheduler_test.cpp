@@ -0,0 +1,261 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 sensor_scheduler_test.cpp
+ * @brief	 Test batching rays of several sensors
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/sensor_scheduler.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace flatland_server;
+
+// Test all rays of all jobs are cast once and done is called in order
+TEST(SensorSchedulerTest, flush_jobs) {
+  SensorExecutor::Get().SetNumThreads(3);
+  SensorScheduler scheduler;
+
+  std::vector<unsigned int> counts = {5, 0, 1081, 1, 360, 0};
+  std::vector<std::vector<int>> visits(counts.size());
+  std::vector<int> done_order;
+
+  for (unsigned int j = 0; j < counts.size(); j++) {
+    visits[j].resize(counts[j], 0);
+
+    SensorScheduler::Job job;
+    job.count = counts[j];
+    job.cast = [&visits, j](unsigned int begin, unsigned int end) {
+      for (unsigned int i = begin; i < end; i++) {
+        visits[j][i]++;
+      }
+    };
+    job.done = [&done_order, j] { done_order.push_back(j); };
+    scheduler.Submit(job);
+  }
+
+  EXPECT_EQ(scheduler.GetPendingJobs(), counts.size());
+  scheduler.Flush();
+  EXPECT_EQ(scheduler.GetPendingJobs(), 0);
+
+  for (unsigned int j = 0; j < counts.size(); j++) {
+    for (unsigned int i = 0; i < counts[j]; i++) {
+      ASSERT_EQ(visits[j][i], 1) << "job " << j << " ray " << i;
+    }
+  }
+
+  EXPECT_EQ(done_order, std::vector<int>({0, 1, 2, 3, 4, 5}));
+
+  // flushing with nothing submitted does nothing
+  scheduler.Flush();
+  EXPECT_EQ(done_order.size(), counts.size());
+
+  // the flush is timed, and the chunks went through the queues
+  EXPECT_EQ(scheduler.GetLatency().GetCount(), 1u);
+  EXPECT_GT(scheduler.GetLatency().GetMax(), 0);
+  EXPECT_GT(SensorExecutor::Get().TakePeakQueuedTasks(), 0u);
+  EXPECT_EQ(SensorExecutor::Get().TakePeakQueuedTasks(), 0u);
+  scheduler.ResetLatency();
+  EXPECT_EQ(scheduler.GetLatency().GetCount(), 0u);
+}
+
+// Test launched jobs hit the world as it was when launched, while it is
+// stepped, and are done once joined
+TEST(SensorSchedulerTest, launch_jobs) {
+  SensorExecutor::Get().SetNumThreads(3);
+  SensorScheduler scheduler;
+
+  b2World world(b2Vec2(0, 0));
+  b2BodyDef wall_def;
+  b2Body *wall = world.CreateBody(&wall_def);
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(10, -5), b2Vec2(10, 5));
+  wall->CreateFixture(&edge, 0);
+
+  b2BodyDef ball_def;
+  ball_def.type = b2_dynamicBody;
+  ball_def.position.Set(5, 0);
+  b2Body *ball = world.CreateBody(&ball_def);
+  b2CircleShape circle;
+  circle.m_radius = 0.5;
+  ball->CreateFixture(&circle, 1);
+  ball->SetLinearVelocity(b2Vec2(50, 0));
+
+  // rays along x at several heights, only the middle ones hit the ball
+  const unsigned int count = 64;
+  std::vector<b2RayCastInput> inputs(count);
+  std::vector<b2RayBatchHit> hits(count);
+  for (unsigned int i = 0; i < count; i++) {
+    float y = -2 + 4.0f * i / (count - 1);
+    inputs[i].p1.Set(0, y);
+    inputs[i].p2.Set(20, y);
+    inputs[i].maxFraction = 1;
+  }
+  std::vector<b2RayBatchHit> expected(count);
+  world.RayCastBatch(inputs.data(), count, b2RayBatchFilter(),
+                     expected.data());
+
+  bool done = false;
+  SensorScheduler::Job job;
+  job.count = count;
+  job.cast = [&](unsigned int begin, unsigned int end) {
+    ASSERT_NE(scheduler.GetSnapshot(), nullptr);
+    scheduler.GetSnapshot()->RayCastBatch(inputs.data() + begin, end - begin,
+                                          b2RayBatchFilter(),
+                                          hits.data() + begin);
+  };
+  job.done = [&done] { done = true; };
+  scheduler.Submit(job);
+
+  EXPECT_EQ(scheduler.GetSnapshot(), nullptr);
+  scheduler.Launch(&world);
+  world.Step(0.01, 8, 3);
+  EXPECT_FALSE(done);
+  scheduler.Join();
+  EXPECT_TRUE(done);
+  EXPECT_EQ(scheduler.GetSnapshot(), nullptr);
+  EXPECT_EQ(scheduler.GetPendingJobs(), 0);
+
+  for (unsigned int i = 0; i < count; i++) {
+    EXPECT_EQ(hits[i].fixture, expected[i].fixture) << "ray " << i;
+    EXPECT_FLOAT_EQ(hits[i].fraction, expected[i].fraction) << "ray " << i;
+  }
+  EXPECT_EQ(hits[count / 2].fixture, ball->GetFixtureList());
+  EXPECT_NEAR(hits[count / 2].fraction * 20, 4.5, 0.01);
+
+  // the ball has moved in the world itself
+  world.RayCastBatch(inputs.data(), count, b2RayBatchFilter(),
+                     expected.data());
+  EXPECT_NEAR(expected[count / 2].fraction * 20, 5.0, 0.01);
+
+  // joining with nothing launched does nothing
+  done = false;
+  scheduler.Join();
+  EXPECT_FALSE(done);
+}
+
+// Test the jobs describing their rays are cast on the GPU when there is one,
+// and on the CPU otherwise, with the same hits as Box2D
+TEST(SensorSchedulerTest, gpu_jobs) {
+  SensorExecutor::Get().SetNumThreads(3);
+  SensorScheduler scheduler;
+
+  b2World world(b2Vec2(0, 0));
+  b2BodyDef wall_def;
+  b2Body *wall = world.CreateBody(&wall_def);
+  b2EdgeShape edge;
+  edge.Set(b2Vec2(10, -5), b2Vec2(10, 5));
+  wall->CreateFixture(&edge, 0);
+
+  b2BodyDef ball_def;
+  ball_def.type = b2_dynamicBody;
+  ball_def.position.Set(5, 0);
+  b2Body *ball = world.CreateBody(&ball_def);
+  b2CircleShape circle;
+  circle.m_radius = 0.5;
+  ball->CreateFixture(&circle, 1);
+
+  // nullptr without a GPU or GPU_RAYCAST, the jobs are then cast by cast
+  scheduler.SetGpuRaycaster(GpuRaycaster::Create(&world));
+
+  const unsigned int count = 64;
+  std::vector<b2RayCastInput> inputs(count);
+  for (unsigned int i = 0; i < count; i++) {
+    float y = -2 + 4.0f * i / (count - 1);
+    inputs[i].p1.Set(0, y);
+    inputs[i].p2.Set(20, y);
+    inputs[i].maxFraction = 1;
+  }
+  std::vector<b2RayBatchHit> expected(count);
+  world.RayCastBatch(inputs.data(), count, b2RayBatchFilter(),
+                     expected.data());
+
+  std::vector<float> fractions(count, -1);
+  int casts = 0, gpu_casts = 0;
+  bool done = false;
+  SensorScheduler::Job job;
+  job.count = count;
+  job.cast = [&](unsigned int begin, unsigned int end) {
+    std::vector<b2RayBatchHit> hits(end - begin);
+    world.RayCastBatch(inputs.data() + begin, end - begin, b2RayBatchFilter(),
+                       hits.data());
+    for (unsigned int i = begin; i < end; i++) {
+      fractions[i] = hits[i - begin].fraction;
+    }
+    casts++;
+  };
+  job.rays = [&](GpuRaycaster::Ray *rays) {
+    for (unsigned int i = 0; i < count; i++) {
+      rays[i].p1 = inputs[i].p1;
+      rays[i].p2 = inputs[i].p2;
+      rays[i].maskBits = 0xFFFF;
+    }
+  };
+  job.hits = [&](const GpuRaycaster::Hit *hits) {
+    for (unsigned int i = 0; i < count; i++) {
+      fractions[i] = hits[i].fraction;
+    }
+    gpu_casts++;
+  };
+  job.done = [&done] { done = true; };
+  scheduler.Submit(job);
+  scheduler.Flush();
+
+  EXPECT_TRUE(done);
+  if (scheduler.GetGpuRaycaster()) {
+    EXPECT_EQ(gpu_casts, 1);
+    EXPECT_EQ(casts, 0);
+  } else {
+    EXPECT_EQ(gpu_casts, 0);
+    EXPECT_GT(casts, 0);
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    EXPECT_NEAR(fractions[i], expected[i].fraction, 1e-4) << "ray " << i;
+  }
+  EXPECT_NEAR(fractions[count / 2] * 20, 4.5, 0.01);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
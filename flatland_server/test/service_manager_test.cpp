@@ -44,13 +44,27 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <flatland_msgs/CheckCollisions.h>
 #include <flatland_msgs/DeleteModel.h>
+#include <flatland_msgs/DeleteModels.h>
+#include <flatland_msgs/GetModelStates.h>
 #include <flatland_msgs/MoveModel.h>
+#include <flatland_msgs/MoveModels.h>
+#include <flatland_msgs/RaycastBatch.h>
+#include <flatland_msgs/RunUntil.h>
+#include <flatland_msgs/SetModelAwake.h>
 #include <flatland_msgs/SpawnModel.h>
+#include <flatland_msgs/SpawnModels.h>
+#include <flatland_msgs/StepWorld.h>
+#include <flatland_msgs/WorldCheckpoint.h>
 #include <flatland_server/simulation_manager.h>
 #include <flatland_server/timekeeper.h>
 #include <flatland_server/world.h>
+#include <flatland_server/world_checkpoint.h>
 #include <gtest/gtest.h>
+#include <std_srvs/Trigger.h>
+#include <cmath>
+#include <fstream>
 #include <regex>
 #include <thread>
 
@@ -79,9 +93,10 @@ class ServiceManagerTest : public ::testing::Test {
     if (sim_man) delete sim_man;
   }
 
-  void StartSimulationThread() {
-    sim_man =
-        new SimulationManager(world_yaml.string(), 1000, 1 / 1000.0, false, 0);
+  void StartSimulationThread(bool lockstep = false,
+                             unsigned int num_worlds = 1) {
+    sim_man = new SimulationManager(world_yaml.string(), 1000, 1 / 1000.0,
+                                    false, 0, lockstep, num_worlds);
     simulation_thread = std::thread(&ServiceManagerTest::SimulationThread,
                                     dynamic_cast<ServiceManagerTest*>(this));
   }
@@ -229,6 +244,40 @@ TEST_F(ServiceManagerTest, move_nonexistent_model) {
       srv.response.message.c_str());
 }
 
+/**
+ * Testing service for putting a model to sleep
+ */
+TEST_F(ServiceManagerTest, set_model_awake) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::SetModelAwake srv;
+  srv.request.name = "turtlebot1";
+  srv.request.awake = false;
+
+  client = nh.serviceClient<flatland_msgs::SetModelAwake>("set_model_awake");
+
+  StartSimulationThread();
+
+  ros::service::waitForService("set_model_awake", 1000);
+  ASSERT_TRUE(client.call(srv));
+
+  ASSERT_TRUE(srv.response.success);
+
+  // nothing touches the model, it keeps sleeping
+  World* w = sim_man->world_;
+  EXPECT_FALSE(w->GetModel("turtlebot1")->IsAwake());
+
+  srv.request.name = "not_a_robot";
+  ASSERT_TRUE(client.call(srv));
+
+  ASSERT_FALSE(srv.response.success);
+  EXPECT_STREQ(
+      "Flatland World: failed to set model awake, model with name "
+      "\"not_a_robot\" does not exist",
+      srv.response.message.c_str());
+}
+
 /**
  * Testing service for deleting a model
  */
@@ -280,6 +329,480 @@ TEST_F(ServiceManagerTest, delete_nonexistent_model) {
       srv.response.message.c_str());
 }
 
+/**
+ * Testing the batch services, each model succeeds or fails on its own
+ */
+TEST_F(ServiceManagerTest, batch_models) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  robot_yaml = this_file_dir /
+               fs::path("load_world_tests/simple_test_A/person.model.yaml");
+
+  flatland_msgs::SpawnModels spawn;
+  for (int i = 0; i < 3; i++) {
+    spawn.request.yaml_paths.push_back(robot_yaml.string());
+    geometry_msgs::Pose2D pose;
+    pose.x = 10.0 + i;
+    spawn.request.poses.push_back(pose);
+  }
+  spawn.request.names = {"batch_1", "batch_2", "batch_1"};
+
+  StartSimulationThread();
+  World* w = sim_man->world_;
+
+  ros::service::waitForService("spawn_models", 1000);
+  client = nh.serviceClient<flatland_msgs::SpawnModels>("spawn_models");
+  ASSERT_TRUE(client.call(spawn));
+  ASSERT_EQ(spawn.response.success.size(), 3);
+  EXPECT_TRUE(spawn.response.success[0]);
+  EXPECT_TRUE(spawn.response.success[1]);
+  EXPECT_FALSE(spawn.response.success[2]);
+  EXPECT_NE(spawn.response.messages[2].find("already exists"),
+            std::string::npos);
+  ASSERT_EQ(6, w->models_.size());
+  ASSERT_EQ(spawn.response.ids.size(), 3);
+  EXPECT_EQ(spawn.response.ids[0], w->GetModel("batch_1")->id_);
+  EXPECT_EQ(spawn.response.ids[1], w->GetModel("batch_2")->id_);
+  EXPECT_EQ(spawn.response.ids[2], 0);
+  uint32_t batch_2_id = spawn.response.ids[1];
+
+  // arrays of different sizes are refused as a whole
+  spawn.request.names = {"batch_3"};
+  ASSERT_TRUE(client.call(spawn));
+  ASSERT_EQ(spawn.response.success.size(), 1);
+  EXPECT_FALSE(spawn.response.success[0]);
+  EXPECT_EQ(6, w->models_.size());
+
+  // the models are moved by their ids
+  flatland_msgs::MoveModels move;
+  move.request.ids = {batch_2_id, 12345};
+  move.request.poses.resize(2);
+  move.request.poses[0].x = 20.0;
+  client = nh.serviceClient<flatland_msgs::MoveModels>("move_models");
+  ASSERT_TRUE(client.call(move));
+  ASSERT_EQ(move.response.success.size(), 2);
+  EXPECT_TRUE(move.response.success[0]);
+  EXPECT_FALSE(move.response.success[1]);
+  EXPECT_FLOAT_EQ(20.0,
+                  w->models_[5]->bodies_[0]->physics_body_->GetPosition().x);
+
+  flatland_msgs::DeleteModels del;
+  del.request.names = {"batch_1", "batch_2", "random_model"};
+  client = nh.serviceClient<flatland_msgs::DeleteModels>("delete_models");
+  ASSERT_TRUE(client.call(del));
+  ASSERT_EQ(del.response.success.size(), 3);
+  EXPECT_TRUE(del.response.success[0]);
+  EXPECT_TRUE(del.response.success[1]);
+  EXPECT_FALSE(del.response.success[2]);
+  EXPECT_EQ(4, w->models_.size());
+}
+
+/**
+ * Testing service for checking a footprint at many poses
+ */
+TEST_F(ServiceManagerTest, check_collisions) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  // the pole of the static chair is on all layers, a 0.2 m circle at
+  // (1.2, 3.5)
+  flatland_msgs::CheckCollisions srv;
+  srv.request.layers = {"robot"};
+  srv.request.radius = 0.1;
+  srv.request.poses.resize(2);
+  srv.request.poses[0].x = 1.2;
+  srv.request.poses[0].y = 3.5;
+  srv.request.poses[1].x = -100;
+  srv.request.poses[1].y = -100;
+
+  StartSimulationThread();
+
+  ros::service::waitForService("check_collisions", 1000);
+  client =
+      nh.serviceClient<flatland_msgs::CheckCollisions>("check_collisions");
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  ASSERT_EQ(srv.response.collisions.size(), 2u);
+  EXPECT_TRUE(srv.response.collisions[0]);
+  EXPECT_FALSE(srv.response.collisions[1]);
+
+  // a square 0.05 m into the pole, and 0.05 m away from it
+  srv.request.points.resize(4);
+  srv.request.points[0].x = -0.1;
+  srv.request.points[0].y = -0.1;
+  srv.request.points[1].x = 0.1;
+  srv.request.points[1].y = -0.1;
+  srv.request.points[2].x = 0.1;
+  srv.request.points[2].y = 0.1;
+  srv.request.points[3].x = -0.1;
+  srv.request.points[3].y = 0.1;
+  srv.request.poses[0].x = 0.95;
+  srv.request.poses[1].x = 0.85;
+  srv.request.poses[1].y = 3.5;
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  ASSERT_EQ(srv.response.collisions.size(), 2u);
+  EXPECT_TRUE(srv.response.collisions[0]);
+  EXPECT_FALSE(srv.response.collisions[1]);
+
+  srv.request.layers = {"random_layer"};
+  ASSERT_TRUE(client.call(srv));
+  EXPECT_FALSE(srv.response.success);
+  EXPECT_NE(srv.response.message.find("random_layer"), std::string::npos);
+}
+
+/**
+ * Testing service for casting many rays
+ */
+TEST_F(ServiceManagerTest, raycast_batch) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  // up to the pole of the static chair, a 0.2 m circle at (1.2, 3.5), and
+  // far away from everything
+  flatland_msgs::RaycastBatch srv;
+  srv.request.layers = {"robot"};
+  srv.request.origins = {1.2, 2.0, -100, -100};
+  srv.request.directions = {0, 2, 1, 0};
+  srv.request.max_range = 2;
+
+  StartSimulationThread();
+
+  ros::service::waitForService("raycast_batch", 1000);
+  client = nh.serviceClient<flatland_msgs::RaycastBatch>("raycast_batch");
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  ASSERT_EQ(srv.response.ranges.size(), 2u);
+  EXPECT_NEAR(srv.response.ranges[0], 1.3, 1e-4);
+  EXPECT_TRUE(std::isinf(srv.response.ranges[1]));
+
+  srv.request.directions = {0, 1};
+  ASSERT_TRUE(client.call(srv));
+  EXPECT_FALSE(srv.response.success);
+
+  srv.request.directions = {0, 1, 0, 0};
+  ASSERT_TRUE(client.call(srv));
+  EXPECT_FALSE(srv.response.success);
+  EXPECT_NE(srv.response.message.find("zero"), std::string::npos);
+}
+
+/**
+ * Testing service for the states of many models at once
+ */
+TEST_F(ServiceManagerTest, get_model_states) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::GetModelStates srv;
+  client = nh.serviceClient<flatland_msgs::GetModelStates>("get_model_states");
+
+  // in lockstep mode the models stay where they were loaded
+  StartSimulationThread(true);
+
+  ros::service::waitForService("get_model_states", 1000);
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  const flatland_msgs::ModelStates &states = srv.response.states;
+  ASSERT_EQ(states.names.size(), 4u);
+  EXPECT_EQ(states.names[1], "turtlebot2");
+  ASSERT_EQ(states.x.size(), 4u);
+  ASSERT_EQ(states.omega.size(), 4u);
+  EXPECT_NEAR(states.x[1], 3, 1e-5);
+  EXPECT_NEAR(states.y[1], 4.5, 1e-5);
+  EXPECT_NEAR(states.theta[1], 3.14159, 1e-5);
+  EXPECT_NEAR(states.vx[1], 0, 1e-5);
+
+  srv.request.ns = "robot2";
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  ASSERT_EQ(srv.response.states.names.size(), 1u);
+  EXPECT_EQ(srv.response.states.names[0], "turtlebot2");
+
+  srv.request.ns = "";
+  srv.request.names = {"person1", "chair1"};
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  ASSERT_EQ(srv.response.states.names.size(), 2u);
+  EXPECT_EQ(srv.response.states.names[0], "person1");
+  EXPECT_NEAR(srv.response.states.y[0], 1, 1e-5);
+
+  srv.request.names = {"person1", "nobody"};
+  ASSERT_TRUE(client.call(srv));
+  EXPECT_FALSE(srv.response.success);
+  EXPECT_NE(srv.response.message.find("nobody"), std::string::npos);
+}
+
+/**
+ * Testing service for stepping the world in lockstep mode
+ */
+TEST_F(ServiceManagerTest, step_world) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::StepWorld srv;
+  srv.request.steps = 5;
+
+  client = nh.serviceClient<flatland_msgs::StepWorld>("step_world");
+
+  StartSimulationThread(true);
+
+  ros::service::waitForService("step_world", 1000);
+  ASSERT_TRUE(client.call(srv));
+
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.005, 1e-9);
+
+  // the world does not advance in between requests
+  ros::WallDuration(0.1).sleep();
+  srv.request.steps = 3;
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.008, 1e-9);
+}
+
+/**
+ * Testing service for stepping the world outside of lockstep mode, which
+ * should fail
+ */
+TEST_F(ServiceManagerTest, step_world_not_lockstep) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::StepWorld srv;
+  srv.request.steps = 1;
+
+  client = nh.serviceClient<flatland_msgs::StepWorld>("step_world");
+
+  StartSimulationThread();
+
+  ros::service::waitForService("step_world", 1000);
+  ASSERT_TRUE(client.call(srv));
+
+  ASSERT_FALSE(srv.response.success);
+  EXPECT_STREQ("The simulation is not running in lockstep mode",
+               srv.response.message.c_str());
+}
+
+/**
+ * Testing service for running the world until a condition is met
+ */
+TEST_F(ServiceManagerTest, run_until) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::RunUntil srv;
+  client = nh.serviceClient<flatland_msgs::RunUntil>("run_until");
+
+  StartSimulationThread(true);
+
+  ros::service::waitForService("run_until", 1000);
+
+  // neither a time nor a number of steps, the call would never return
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_FALSE(srv.response.success);
+  EXPECT_STREQ("Either until_time or max_steps must be set",
+               srv.response.message.c_str());
+
+  srv.request.until_time = ros::Time(0.02);
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_EQ(flatland_msgs::RunUntil::Response::TIME, srv.response.reason);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.02, 1e-9);
+
+  // the step limit is reached before the time
+  srv.request.until_time = ros::Time(1.0);
+  srv.request.max_steps = 7;
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_EQ(flatland_msgs::RunUntil::Response::STEPS, srv.response.reason);
+  EXPECT_EQ(7u, srv.response.steps);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.027, 1e-9);
+
+  // turtlebot2 stands in the region, the first step stops
+  srv.request.region_models = {"person1", "turtlebot2"};
+  srv.request.regions = {5, 5, 6, 6, 2.5, 4, 3.5, 5};
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_EQ(flatland_msgs::RunUntil::Response::REGION, srv.response.reason);
+  EXPECT_STREQ("turtlebot2", srv.response.trigger.c_str());
+  EXPECT_EQ(1u, srv.response.steps);
+
+  srv.request.region_models = {"person2"};
+  srv.request.regions = {0, 0, 1, 1};
+  ASSERT_TRUE(client.call(srv));
+  ASSERT_FALSE(srv.response.success);
+  EXPECT_STREQ("Model with name \"person2\" does not exist",
+               srv.response.message.c_str());
+}
+
+/**
+ * Testing service for resetting the world, which should undo moving and
+ * spawning models
+ */
+TEST_F(ServiceManagerTest, reset_world) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  robot_yaml = this_file_dir /
+               fs::path("load_world_tests/simple_test_A/person.model.yaml");
+
+  StartSimulationThread(true);
+
+  ros::service::waitForService("reset_world", 1000);
+  World* w = sim_man->world_;
+  size_t model_count = w->models_.size();
+  ASSERT_GT(model_count, 0u);
+  std::string name = w->models_[0]->GetName();
+  b2Vec2 position = w->models_[0]->bodies_[0]->physics_body_->GetPosition();
+
+  flatland_msgs::MoveModel move;
+  move.request.name = name;
+  move.request.pose.x = position.x + 5;
+  move.request.pose.y = position.y - 3;
+  client = nh.serviceClient<flatland_msgs::MoveModel>("move_model");
+  ASSERT_TRUE(client.call(move));
+  ASSERT_TRUE(move.response.success);
+
+  flatland_msgs::SpawnModel spawn;
+  spawn.request.name = "reset_world_test_robot";
+  spawn.request.yaml_path = robot_yaml.string();
+  client = nh.serviceClient<flatland_msgs::SpawnModel>("spawn_model");
+  ASSERT_TRUE(client.call(spawn));
+  ASSERT_TRUE(spawn.response.success);
+  ASSERT_EQ(w->models_.size(), model_count + 1);
+
+  std_srvs::Trigger reset;
+  client = nh.serviceClient<std_srvs::Trigger>("reset_world");
+  ASSERT_TRUE(client.call(reset));
+  ASSERT_TRUE(reset.response.success);
+
+  ASSERT_EQ(w->models_.size(), model_count);
+  EXPECT_EQ(w->models_[0]->GetName(), name);
+  b2Vec2 restored = w->models_[0]->bodies_[0]->physics_body_->GetPosition();
+  EXPECT_FLOAT_EQ(restored.x, position.x);
+  EXPECT_FLOAT_EQ(restored.y, position.y);
+}
+
+/**
+ * Testing services for saving the world to a checkpoint file and loading it
+ * back, which should restore the models and the simulation time
+ */
+TEST_F(ServiceManagerTest, save_and_load_world) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+  fs::path checkpoint = fs::temp_directory_path() / fs::unique_path();
+
+  StartSimulationThread(true);
+
+  ros::service::waitForService("save_world", 1000);
+  World* w = sim_man->world_;
+  size_t model_count = w->models_.size();
+  std::string name = w->models_[0]->GetName();
+
+  flatland_msgs::StepWorld step;
+  step.request.steps = 5;
+  client = nh.serviceClient<flatland_msgs::StepWorld>("step_world");
+  ASSERT_TRUE(client.call(step));
+
+  flatland_msgs::WorldCheckpoint save;
+  save.request.path = checkpoint.string();
+  client = nh.serviceClient<flatland_msgs::WorldCheckpoint>("save_world");
+  ASSERT_TRUE(client.call(save));
+  ASSERT_TRUE(save.response.success) << save.response.message;
+  EXPECT_NEAR(save.response.sim_time.toSec(), 0.005, 1e-9);
+  b2Vec2 position = w->models_[0]->bodies_[0]->physics_body_->GetPosition();
+
+  // the model is deleted, it is reloaded from its template
+  flatland_msgs::DeleteModel del;
+  del.request.name = name;
+  client = nh.serviceClient<flatland_msgs::DeleteModel>("delete_model");
+  ASSERT_TRUE(client.call(del));
+  ASSERT_TRUE(del.response.success);
+  client = nh.serviceClient<flatland_msgs::StepWorld>("step_world");
+  ASSERT_TRUE(client.call(step));
+
+  flatland_msgs::WorldCheckpoint load;
+  load.request.path = checkpoint.string();
+  client = nh.serviceClient<flatland_msgs::WorldCheckpoint>("load_world");
+  ASSERT_TRUE(client.call(load));
+  ASSERT_TRUE(load.response.success) << load.response.message;
+  EXPECT_NEAR(load.response.sim_time.toSec(), 0.005, 1e-9);
+  EXPECT_NEAR(sim_man->GetTimekeeper(w)->GetSimTime().toSec(), 0.005, 1e-9);
+
+  ASSERT_EQ(w->models_.size(), model_count);
+  Model* restored = w->GetModel(name);
+  ASSERT_NE(restored, nullptr);
+  b2Vec2 p = restored->bodies_[0]->physics_body_->GetPosition();
+  EXPECT_FLOAT_EQ(p.x, position.x);
+  EXPECT_FLOAT_EQ(p.y, position.y);
+
+  // a file that is not a checkpoint fails
+  load.request.path = world_yaml.string();
+  ASSERT_TRUE(client.call(load));
+  EXPECT_FALSE(load.response.success);
+
+  // a corrupted count fails before allocating the models
+  CheckpointWriter writer;
+  for (char c : {'F', 'L', 'C', 'K', 'P', 'T', '\0', '\0'}) writer.Put(c);
+  writer.Put<uint32_t>(1);
+  writer.Put<uint32_t>(0);
+  writer.Put<uint32_t>(0);
+  writer.Put<uint32_t>(0xffffffff);
+  {
+    std::ofstream out(checkpoint.string(), std::ios::binary);
+    out << writer.Data();
+  }
+  load.request.path = checkpoint.string();
+  ASSERT_TRUE(client.call(load));
+  EXPECT_FALSE(load.response.success);
+  EXPECT_NE(load.response.message.find("count"), std::string::npos)
+      << load.response.message;
+  fs::remove(checkpoint);
+}
+
+/**
+ * Testing service for stepping one of several worlds, which should only step
+ * that world
+ */
+TEST_F(ServiceManagerTest, step_world_multiple_worlds) {
+  world_yaml =
+      this_file_dir / fs::path("load_world_tests/simple_test_A/world.yaml");
+
+  flatland_msgs::StepWorld srv;
+  srv.request.steps = 4;
+
+  ros::ServiceClient client_0 =
+      nh.serviceClient<flatland_msgs::StepWorld>("world_0/step_world");
+  ros::ServiceClient client_1 =
+      nh.serviceClient<flatland_msgs::StepWorld>("world_1/step_world");
+
+  StartSimulationThread(true, 2);
+
+  ros::service::waitForService("world_0/step_world", 1000);
+  ros::service::waitForService("world_1/step_world", 1000);
+  ASSERT_TRUE(client_1.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.004, 1e-9);
+
+  srv.request.steps = 1;
+  ASSERT_TRUE(client_0.call(srv));
+  ASSERT_TRUE(srv.response.success);
+  EXPECT_NEAR(srv.response.sim_time.toSec(), 0.001, 1e-9);
+
+  // the worlds are loaded from the same file in their own namespaces, and
+  // share the geometry of their layers
+  ASSERT_EQ(sim_man->worlds_.size(), 2u);
+  World* w0 = sim_man->worlds_[0];
+  World* w1 = sim_man->worlds_[1];
+  EXPECT_STREQ(w1->namespace_.c_str(), "world_1");
+  ASSERT_EQ(w0->models_.size(), w1->models_.size());
+  ASSERT_EQ(w0->layers_.size(), w1->layers_.size());
+  for (unsigned int i = 0; i < w0->layers_.size(); i++) {
+    EXPECT_EQ(w0->layers_[i]->GetGrid(), w1->layers_[i]->GetGrid());
+    EXPECT_EQ(w0->layers_[i]->GetSegmentRaycaster(),
+              w1->layers_[i]->GetSegmentRaycaster());
+  }
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char** argv) {
   ros::init(argc, argv, "service_manager_test");
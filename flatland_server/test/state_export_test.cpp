@@ -0,0 +1,214 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 state_export_test.cpp
+ * @brief	 Test the export of the world state to shared memory
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/body.h>
+#include <flatland_server/body_states.h>
+#include <flatland_server/entity.h>
+#include <flatland_server/state_export.h>
+#include <flatland_server/state_exporter.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace flatland_server;
+
+/**
+ * An entity to own the bodies of the test
+ */
+class TestEntity : public Entity {
+ public:
+  explicit TestEntity(b2World *world) : Entity(world, "robot") {}
+  EntityType Type() const override { return EntityType::MODEL; }
+  void DebugVisualize() const override {}
+  void DebugOutput() const override {}
+};
+
+class StateExportTest : public ::testing::Test {
+ public:
+  b2World world;
+  TestEntity entity;
+  BodyStates states;
+  std::vector<Body *> bodies;
+  std::string name;
+
+  StateExportTest()
+      : world(b2Vec2(0, 0)),
+        entity(&world),
+        name("/flatland_state_test_" + std::to_string(getpid())) {}
+
+  ~StateExportTest() {
+    for (Body *body : bodies) {
+      delete body;
+    }
+  }
+
+  Body *AddBody(const std::string &body_name, const Pose &pose) {
+    Body *body = new Body(&world, &entity, body_name, Color(1, 1, 1, 1), pose,
+                          b2_dynamicBody, YAML::Node());
+    bodies.push_back(body);
+    states.Add(body);
+    return body;
+  }
+};
+
+// Test a reader sees the bodies and scans of the latest step
+TEST_F(StateExportTest, read) {
+  StateExporter exporter;
+  exporter.Create(name, 4, 16, 4, 100);
+  StateReader reader;
+  ASSERT_TRUE(reader.Open(name));
+  StateReader::Frame frame;
+  EXPECT_FALSE(reader.Read(&frame));
+
+  AddBody("base", Pose(1, 2, 0.5));
+  Body *wheel = AddBody("wheel", Pose(3, 4, 0));
+  wheel->physics_body_->SetLinearVelocity(b2Vec2(1, 0));
+  states.Refresh();
+  int id = exporter.AddScan("robot/laser", 3);
+  ASSERT_EQ(id, 0);
+  float ranges[] = {1, 2, 3};
+  exporter.SetScan(id, 0.5, ranges);
+  exporter.Write(states, 0.5);
+
+  ASSERT_TRUE(reader.Read(&frame));
+  EXPECT_EQ(frame.step, 1u);
+  EXPECT_DOUBLE_EQ(frame.time, 0.5);
+  ASSERT_EQ(frame.names.size(), 2u);
+  EXPECT_EQ(frame.names[0], "robot/base");
+  EXPECT_EQ(frame.names[1], "robot/wheel");
+  ASSERT_EQ(frame.bodies.size(), 2u);
+  EXPECT_FLOAT_EQ(frame.bodies[0].x, 1);
+  EXPECT_FLOAT_EQ(frame.bodies[0].angle, 0.5);
+  EXPECT_FLOAT_EQ(frame.bodies[1].y, 4);
+  EXPECT_FLOAT_EQ(frame.bodies[1].vx, 1);
+  ASSERT_EQ(frame.scans.size(), 1u);
+  EXPECT_EQ(frame.scans[0].name, "robot/laser");
+  EXPECT_DOUBLE_EQ(frame.stamps[0], 0.5);
+  ASSERT_EQ(frame.scans[0].count, 3u);
+  EXPECT_FLOAT_EQ(frame.ranges[frame.scans[0].offset + 2], 3);
+
+  // the ring wraps around, the names are read again once they change
+  for (int i = 0; i < 5; i++) {
+    exporter.Write(states, 1 + i);
+  }
+  int second = exporter.AddScan("robot/laser2", 2);
+  exporter.RemoveScan(id);
+  exporter.Write(states, 10);
+  ASSERT_TRUE(reader.Read(&frame));
+  EXPECT_EQ(frame.step, 7u);
+  ASSERT_EQ(frame.scans.size(), 1u);
+  EXPECT_EQ(frame.scans[0].name, "robot/laser2");
+  EXPECT_EQ(frame.scans[0].offset, 0u);
+  EXPECT_TRUE(std::isnan(frame.ranges[0]));
+
+  // no room for more ranges than max_ranges
+  EXPECT_EQ(exporter.AddScan("robot/laser3", 99), -1);
+  exporter.RemoveScan(second);
+}
+
+// Test an invalid or missing export is not opened
+TEST_F(StateExportTest, open) {
+  StateReader reader;
+  EXPECT_FALSE(reader.Open(name));
+  {
+    StateExporter exporter;
+    exporter.Create(name, 2, 1, 1, 1);
+    EXPECT_TRUE(reader.Open(name));
+    EXPECT_EQ(reader.GetHeader()->slot_count, 2u);
+    EXPECT_THROW(exporter.Create(name, 2, 1, 1, 1), Exception);
+  }
+
+  // the object is unlinked with the exporter, the mapping stays readable
+  EXPECT_TRUE(reader.IsOpen());
+  StateReader other;
+  EXPECT_FALSE(other.Open(name));
+}
+
+// Test readers never see a partially written slot
+TEST_F(StateExportTest, concurrent) {
+  for (int i = 0; i < 64; i++) {
+    AddBody("body" + std::to_string(i), Pose(0, 0, 0));
+  }
+  StateExporter exporter;
+  exporter.Create(name, 2, 64, 1, 1);
+  exporter.Write(states, 0);
+
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    for (int step = 1; step <= 20000; step++) {
+      for (size_t i = 0; i < states.Size(); i++) {
+        states.x_[i] = step;
+      }
+      exporter.Write(states, step);
+    }
+    done = true;
+  });
+
+  StateReader reader;
+  ASSERT_TRUE(reader.Open(name));
+  StateReader::Frame frame;
+  int reads = 0;
+  while (!done) {
+    if (!reader.Read(&frame)) {
+      continue;
+    }
+    reads++;
+    ASSERT_EQ(frame.bodies.size(), 64u);
+    for (const auto &body : frame.bodies) {
+      ASSERT_EQ(body.x, float(frame.time));
+    }
+  }
+  writer.join();
+  EXPECT_GT(reads, 0);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
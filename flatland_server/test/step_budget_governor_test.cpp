@@ -0,0 +1,118 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_budget_governor_test.cpp
+ * @brief	 Tests for the step budget governor
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/step_budget_governor.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+typedef StepBudgetGovernor G;
+
+// Test that runs of overruns activate the degradations in priority order
+TEST(StepBudgetGovernorTest, degrades_in_order) {
+  G governor(0.01, {G::COARSEN_BEAMS, G::SKIP_VISUALIZATION}, 3, 5);
+
+  // a single slow step changes nothing
+  EXPECT_FALSE(governor.AddStep(0.1));
+  EXPECT_FALSE(governor.AddStep(0.001));
+  EXPECT_EQ(governor.GetLevel(), 0u);
+
+  EXPECT_FALSE(governor.AddStep(0.02));
+  EXPECT_FALSE(governor.AddStep(0.02));
+  EXPECT_TRUE(governor.AddStep(0.02));
+  EXPECT_EQ(governor.GetDegradations(), (uint32_t)G::COARSEN_BEAMS);
+
+  for (int i = 0; i < 2; i++) EXPECT_FALSE(governor.AddStep(0.02));
+  EXPECT_TRUE(governor.AddStep(0.02));
+  EXPECT_EQ(governor.GetDegradations(),
+            (uint32_t)(G::COARSEN_BEAMS | G::SKIP_VISUALIZATION));
+  EXPECT_EQ(governor.GetDegradationNames(),
+            std::vector<std::string>({"laser_beams", "visualization"}));
+
+  // all degradations are active, overruns only count
+  for (int i = 0; i < 10; i++) EXPECT_FALSE(governor.AddStep(0.02));
+  EXPECT_EQ(governor.GetLevel(), 2u);
+  EXPECT_EQ(governor.GetOverrunCount(), 17u);
+}
+
+// Test that the degradations are lifted in reverse order once recovered
+TEST(StepBudgetGovernorTest, recovers_with_hysteresis) {
+  G governor(0.01, {G::SKIP_VISUALIZATION, G::REDUCE_SENSOR_RATE}, 1, 4, 0.5);
+  EXPECT_TRUE(governor.AddStep(0.02));
+  EXPECT_TRUE(governor.AddStep(0.02));
+  EXPECT_EQ(governor.GetLevel(), 2u);
+
+  // steps just under the budget are not enough to restore
+  for (int i = 0; i < 20; i++) EXPECT_FALSE(governor.AddStep(0.008));
+  EXPECT_EQ(governor.GetLevel(), 2u);
+
+  for (int i = 0; i < 3; i++) EXPECT_FALSE(governor.AddStep(0.004));
+  EXPECT_TRUE(governor.AddStep(0.004));
+  EXPECT_EQ(governor.GetDegradations(), (uint32_t)G::SKIP_VISUALIZATION);
+
+  // a step in between the thresholds restarts the run
+  for (int i = 0; i < 3; i++) EXPECT_FALSE(governor.AddStep(0.004));
+  EXPECT_FALSE(governor.AddStep(0.008));
+  for (int i = 0; i < 3; i++) EXPECT_FALSE(governor.AddStep(0.004));
+  EXPECT_TRUE(governor.AddStep(0.004));
+  EXPECT_EQ(governor.GetDegradations(), 0u);
+  EXPECT_TRUE(governor.GetDegradationNames().empty());
+}
+
+// Test parsing the degradation names
+TEST(StepBudgetGovernorTest, parse_degradation) {
+  for (G::Degradation d :
+       {G::SKIP_VISUALIZATION, G::REDUCE_SENSOR_RATE, G::COARSEN_BEAMS}) {
+    EXPECT_EQ(G::ParseDegradation(G::DegradationName(d)), d);
+  }
+  EXPECT_THROW(G::ParseDegradation("lidar"), Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,183 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 step_timer_test.cpp
+ * @brief	 Tests for the step timing histograms
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/step_timer.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <thread>
+
+using namespace flatland_server;
+
+// Test the statistics of a histogram against samples with known percentiles
+TEST(StepTimerTest, histogram) {
+  TimingHistogram histogram;
+  EXPECT_EQ(histogram.GetCount(), 0u);
+  EXPECT_EQ(histogram.GetPercentile(99), 0);
+
+  // 1ms to 1s, in steps of 1ms
+  for (int i = 1; i <= 1000; i++) {
+    histogram.Add(i * 1e-3);
+  }
+  EXPECT_EQ(histogram.GetCount(), 1000u);
+  EXPECT_DOUBLE_EQ(histogram.GetMin(), 1e-3);
+  EXPECT_DOUBLE_EQ(histogram.GetMax(), 1.0);
+  EXPECT_NEAR(histogram.GetMean(), 0.5005, 1e-9);
+
+  // the estimate is the upper end of a bucket about 9% wide
+  double p99 = histogram.GetPercentile(99);
+  EXPECT_GE(p99, 0.99);
+  EXPECT_LE(p99, 0.99 * 1.1);
+  double p50 = histogram.GetPercentile(50);
+  EXPECT_GE(p50, 0.5);
+  EXPECT_LE(p50, 0.5 * 1.1);
+
+  // clamped to the samples
+  EXPECT_DOUBLE_EQ(histogram.GetPercentile(100), 1.0);
+  EXPECT_GE(histogram.GetPercentile(0), 1e-3);
+
+  // out of range samples go to the first and last buckets
+  histogram.Add(0);
+  histogram.Add(1e6);
+  EXPECT_EQ(histogram.GetMin(), 0);
+  EXPECT_EQ(histogram.GetPercentile(100), 1e6);
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.GetCount(), 0u);
+  EXPECT_EQ(histogram.GetMean(), 0);
+}
+
+// Test that the time of a stage is summed over a step
+TEST(StepTimerTest, steps) {
+  StepTimer timer;
+  timer.Add(StepTimer::PHYSICS_STEP, 0.001);
+  timer.Add(StepTimer::PHYSICS_STEP, 0.002);
+  timer.Add(StepTimer::SPIN, 0.004);
+  timer.EndStep();
+  timer.Add(StepTimer::PHYSICS_STEP, 0.005);
+  timer.EndStep();
+  timer.EndStep();
+
+  const TimingHistogram &physics = timer.GetHistogram(StepTimer::PHYSICS_STEP);
+  EXPECT_EQ(physics.GetCount(), 2u);
+  EXPECT_DOUBLE_EQ(physics.GetMin(), 0.003);
+  EXPECT_DOUBLE_EQ(physics.GetMax(), 0.005);
+  EXPECT_EQ(timer.GetHistogram(StepTimer::SPIN).GetCount(), 1u);
+  EXPECT_EQ(timer.GetHistogram(StepTimer::SOLVE).GetCount(), 0u);
+
+  b2Profile profile = {};
+  profile.solve = 2.0f;  // in ms
+  timer.AddProfile(profile);
+  timer.EndStep();
+  EXPECT_DOUBLE_EQ(timer.GetHistogram(StepTimer::SOLVE).GetMax(), 0.002);
+  EXPECT_EQ(timer.GetHistogram(StepTimer::COLLIDE).GetCount(), 1u);
+
+  timer.Reset();
+  EXPECT_EQ(timer.GetHistogram(StepTimer::PHYSICS_STEP).GetCount(), 0u);
+  EXPECT_STREQ(StepTimer::GetStageName(StepTimer::SOLVE),
+               "physics_step/solve");
+}
+
+// Test that scopes only measure when the timer is enabled
+TEST(StepTimerTest, scope) {
+  StepTimer timer;
+  {
+    StepTimer::Scope scope(timer, StepTimer::SPIN);
+  }
+  timer.EndStep();
+  EXPECT_EQ(timer.GetHistogram(StepTimer::SPIN).GetCount(), 0u);
+
+  timer.SetEnabled(true);
+  {
+    StepTimer::Scope scope(timer, StepTimer::SPIN);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  timer.EndStep();
+  EXPECT_EQ(timer.GetHistogram(StepTimer::SPIN).GetCount(), 1u);
+  EXPECT_GE(timer.GetHistogram(StepTimer::SPIN).GetMin(), 0.002);
+}
+
+// Test that the scopes on the thread of the counters count its events
+TEST(StepTimerTest, counters) {
+  PerfCounters counters;
+  if (!counters.Open()) {
+    // e.g. in containers and virtual machines without a PMU
+    std::cout << "skipped, " << counters.GetError() << std::endl;
+    return;
+  }
+
+  StepTimer timer;
+  timer.SetEnabled(true);
+  timer.SetCounters(&counters);
+  volatile double sum = 0;
+  for (int step = 0; step < 2; step++) {
+    StepTimer::Scope scope(timer, StepTimer::PHYSICS_STEP);
+    for (int i = 0; i < 100000; i++) {
+      sum = sum + i;
+    }
+  }
+  timer.EndStep();
+  EXPECT_EQ(timer.GetCountedSteps(StepTimer::PHYSICS_STEP), 1u);
+  EXPECT_GT(timer.GetCounts(StepTimer::PHYSICS_STEP).instructions, 200000u);
+  EXPECT_GT(timer.GetCounts(StepTimer::PHYSICS_STEP).cycles, 0u);
+
+  // the scopes of other threads are only timed
+  std::thread([&timer] {
+    StepTimer::Scope scope(timer, StepTimer::SPIN);
+  }).join();
+  timer.EndStep();
+  EXPECT_EQ(timer.GetHistogram(StepTimer::SPIN).GetCount(), 1u);
+  EXPECT_EQ(timer.GetCountedSteps(StepTimer::SPIN), 0u);
+
+  timer.Reset();
+  EXPECT_EQ(timer.GetCountedSteps(StepTimer::PHYSICS_STEP), 0u);
+  EXPECT_EQ(timer.GetCounts(StepTimer::PHYSICS_STEP).instructions, 0u);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,157 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tf_aggregator_test.cpp
+ * @brief	 Test the TF aggregator
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/tf_aggregator.h>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <tf2_msgs/TFMessage.h>
+#include <string>
+
+using namespace flatland_server;
+
+// A helper class to accept TFMessage callbacks
+struct TfSubscriptionHelper {
+  tf2_msgs::TFMessage message_;
+  int count_ = 0;
+
+  void callback(const tf2_msgs::TFMessageConstPtr& msg) {
+    ++count_;
+    message_ = *msg;
+  }
+
+  /**
+   * @brief Wait up to 2 seconds for a specific message count
+   * @param count The message count to wait for
+   * @return true if successful
+   */
+  bool waitForMessageCount(int count) {
+    ros::Rate rate(10);
+    for (unsigned int i = 0; i < 20; i++) {
+      ros::spinOnce();
+      if (count_ >= count) return true;
+      rate.sleep();
+    }
+    return false;
+  }
+};
+
+geometry_msgs::TransformStamped MakeTransform(const std::string& child,
+                                              double x) {
+  geometry_msgs::TransformStamped tf;
+  tf.header.frame_id = "map";
+  tf.child_frame_id = child;
+  tf.transform.translation.x = x;
+  tf.transform.rotation.w = 1;
+  return tf;
+}
+
+/**
+ * Test that the transforms sent between flushes are published together, with
+ * only the latest transform of each frame, and that the static transforms
+ * are all published on the latched topic
+ */
+TEST(TfAggregatorTest, testPublish) {
+  ros::NodeHandle nh;
+  TfSubscriptionHelper tf_helper, static_helper;
+  ros::Subscriber tf_sub = nh.subscribe(
+      "/tf", 0, &TfSubscriptionHelper::callback, &tf_helper);
+  ros::Subscriber static_sub = nh.subscribe(
+      "/tf_static", 0, &TfSubscriptionHelper::callback, &static_helper);
+
+  TfAggregator& aggregator = TfAggregator::Get();
+  TfAggregator::SetRate(10);
+
+  // wait for the connections
+  for (unsigned int i = 0; i < 20 && (tf_sub.getNumPublishers() == 0 ||
+                                      static_sub.getNumPublishers() == 0);
+       i++) {
+    ros::WallDuration(0.1).sleep();
+  }
+
+  aggregator.Send(MakeTransform("a", 1));
+  aggregator.Send({MakeTransform("b", 2), MakeTransform("a", 3)});
+  aggregator.SendStatic(MakeTransform("laser_a", 4));
+  aggregator.SendStatic(MakeTransform("laser_b", 5));
+  aggregator.Publish(ros::Time(1.0));
+
+  ASSERT_TRUE(tf_helper.waitForMessageCount(1));
+  ASSERT_EQ(tf_helper.message_.transforms.size(), 2);
+  EXPECT_EQ(tf_helper.message_.transforms[0].child_frame_id, "a");
+  EXPECT_DOUBLE_EQ(tf_helper.message_.transforms[0].transform.translation.x,
+                   3);
+  EXPECT_EQ(tf_helper.message_.transforms[1].child_frame_id, "b");
+
+  ASSERT_TRUE(static_helper.waitForMessageCount(1));
+  ASSERT_EQ(static_helper.message_.transforms.size(), 2);
+  EXPECT_EQ(static_helper.message_.transforms[0].child_frame_id, "laser_a");
+  EXPECT_EQ(static_helper.message_.transforms[1].child_frame_id, "laser_b");
+
+  // within the period of the rate, nothing is flushed
+  aggregator.Send(MakeTransform("b", 6));
+  aggregator.Publish(ros::Time(1.05));
+  EXPECT_FALSE(tf_helper.waitForMessageCount(2));
+
+  // only the frames sent since the last flush are published
+  aggregator.Publish(ros::Time(1.2));
+  ASSERT_TRUE(tf_helper.waitForMessageCount(2));
+  ASSERT_EQ(tf_helper.message_.transforms.size(), 1);
+  EXPECT_EQ(tf_helper.message_.transforms[0].child_frame_id, "b");
+  EXPECT_DOUBLE_EQ(tf_helper.message_.transforms[0].transform.translation.x,
+                   6);
+
+  // nothing was sent, nothing is published, the static transforms did not
+  // change either
+  aggregator.Publish(ros::Time(2.0));
+  EXPECT_FALSE(tf_helper.waitForMessageCount(3));
+  EXPECT_EQ(static_helper.count_, 1);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "tf_aggregator_test");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
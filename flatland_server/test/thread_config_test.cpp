@@ -0,0 +1,114 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 thread_config_test.cpp
+ * @brief	 Tests for the thread configuration
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/sensor_executor.h>
+#include <flatland_server/thread_config.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace flatland_server;
+
+// Test the CPU sets are parsed, with the NUMA nodes read from sysfs
+TEST(ThreadConfigTest, parse_cpu_set) {
+  char dir_template[] = "/tmp/thread_config_test_XXXXXX";
+  std::string dir = mkdtemp(dir_template);
+  mkdir((dir + "/node1").c_str(), 0755);
+  std::ofstream(dir + "/node1/cpulist") << "8-11,16\n";
+
+  typedef std::vector<unsigned int> Cpus;
+  EXPECT_EQ(ThreadConfig::ParseCpuSet(""), Cpus());
+  EXPECT_EQ(ThreadConfig::ParseCpuSet("3"), Cpus({3}));
+  EXPECT_EQ(ThreadConfig::ParseCpuSet("4-6, 1,5"), Cpus({1, 4, 5, 6}));
+  EXPECT_EQ(ThreadConfig::ParseCpuSet("0,node:1", dir),
+            Cpus({0, 8, 9, 10, 11, 16}));
+
+  for (const char *spec : {"a", "3-1", "1-", "-1", "1.5", "node:x", "node:2",
+                           "100000"}) {
+    EXPECT_THROW(ThreadConfig::ParseCpuSet(spec, dir), Exception) << spec;
+  }
+  std::remove((dir + "/node1/cpulist").c_str());
+  rmdir((dir + "/node1").c_str());
+  rmdir(dir.c_str());
+}
+
+// Test the sensor workers run on the CPUs they are pinned to
+TEST(ThreadConfigTest, pin_sensor_workers) {
+  std::vector<unsigned int> cpus = ThreadConfig::GetAffinity(pthread_self());
+  ASSERT_FALSE(cpus.empty());
+  std::vector<unsigned int> first = {cpus[0]};
+
+  SensorExecutor &executor = SensorExecutor::Get();
+  executor.SetNumThreads(2);
+  executor.SetCpus(first);
+  for (unsigned int threads : {2u, 3u}) {
+    executor.SetNumThreads(threads);
+    std::mutex mutex;
+    std::set<std::vector<unsigned int>> seen;
+    executor.ParallelFor(64, 1, [&](unsigned int, unsigned int) {
+      std::lock_guard<std::mutex> lock(mutex);
+      seen.insert(ThreadConfig::GetAffinity(pthread_self()));
+    });
+    EXPECT_EQ(seen, std::set<std::vector<unsigned int>>({first}));
+  }
+
+  // back on all the CPUs for the other tests
+  executor.SetCpus(cpus);
+  executor.SetCpus({});
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 topic_stats_test.cpp
+ * @brief	Tests for TopicStats
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/topic_stats.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+
+// Test the totals of the topics and their ranking
+TEST(TopicStatsTest, top_talkers) {
+  TopicStats &stats = TopicStats::Get();
+  stats.Reset();
+  stats.Record("/scan", 1000, 2, 0.002);
+  stats.Record("/scan", 1000, 0, 0.001);
+  stats.Record("/odom", 700, 1, 0.004);
+  stats.Record("/odom", 700, 1, 0.001);
+  stats.Record("/odom", 700, 1, 0.001);
+  stats.Record("/bumper", 10, 0, 0.0);
+
+  std::vector<TopicStats::Entry> entries =
+      stats.GetTopTalkers(0, TopicStats::BYTES_SENT);
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries[0].topic, "/odom");
+  EXPECT_EQ(entries[0].messages, 3u);
+  EXPECT_EQ(entries[0].bytes, 2100u);
+  EXPECT_EQ(entries[0].bytes_sent, 2100u);
+  EXPECT_NEAR(entries[0].publish_time, 0.006, 1e-12);
+  EXPECT_NEAR(entries[0].max_publish_time, 0.004, 1e-12);
+  EXPECT_EQ(entries[1].topic, "/scan");
+  EXPECT_EQ(entries[1].bytes, 2000u);
+  EXPECT_EQ(entries[1].bytes_sent, 2000u);
+  EXPECT_EQ(entries[2].topic, "/bumper");
+
+  entries = stats.GetTopTalkers(2, TopicStats::MESSAGES);
+  ASSERT_EQ(entries.size(), 2u);
+  EXPECT_EQ(entries[0].topic, "/odom");
+  EXPECT_EQ(entries[1].topic, "/scan");
+
+  // ties are ranked by topic
+  stats.Record("/bumper", 90, 0, 0.0);
+  entries = stats.GetTopTalkers(0, TopicStats::MESSAGES);
+  EXPECT_EQ(entries[0].topic, "/odom");
+  EXPECT_EQ(entries[1].topic, "/bumper");
+  EXPECT_EQ(entries[2].topic, "/scan");
+
+  entries = stats.GetTopTalkers(1, TopicStats::PUBLISH_TIME);
+  ASSERT_EQ(entries.size(), 1u);
+  EXPECT_EQ(entries[0].topic, "/odom");
+
+  EXPECT_GE(stats.GetPeriod(), 0.0);
+  stats.Reset();
+  EXPECT_TRUE(stats.GetTopTalkers(0, TopicStats::BYTES).empty());
+}
+
+// Test the names of the sort keys
+TEST(TopicStatsTest, sort_keys) {
+  TopicStats::SortKey key = TopicStats::MESSAGES;
+  EXPECT_TRUE(TopicStats::ParseSortKey("", &key));
+  EXPECT_EQ(key, TopicStats::BYTES_SENT);
+  EXPECT_TRUE(TopicStats::ParseSortKey("bytes", &key));
+  EXPECT_EQ(key, TopicStats::BYTES);
+  EXPECT_TRUE(TopicStats::ParseSortKey("messages", &key));
+  EXPECT_EQ(key, TopicStats::MESSAGES);
+  EXPECT_TRUE(TopicStats::ParseSortKey("publish_time", &key));
+  EXPECT_EQ(key, TopicStats::PUBLISH_TIME);
+  EXPECT_FALSE(TopicStats::ParseSortKey("size", &key));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,145 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 tracer_test.cpp
+ * @brief	 Tests for the timeline tracer
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/tracer.h>
+#include <gtest/gtest.h>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+using namespace flatland_server;
+
+// Count the occurrences of a regex in a string
+int Count(const std::string &str, const std::string &regex) {
+  std::regex re(regex);
+  return std::distance(std::sregex_iterator(str.begin(), str.end(), re),
+                       std::sregex_iterator());
+}
+
+#ifndef FLATLAND_NO_TRACING
+// Test that spans are only recorded while tracing, per thread
+TEST(TracerTest, record) {
+  Tracer &tracer = Tracer::Get();
+  { FLATLAND_TRACE("test", "before_start"); }
+
+  tracer.Start();
+  tracer.SetThreadName("main");
+  {
+    FLATLAND_TRACE("test", "outer");
+    FLATLAND_TRACE("test", std::string("inner \"quoted\""));
+  }
+  std::thread worker([&] {
+    tracer.SetThreadName("worker");
+    FLATLAND_TRACE("test", "on_worker");
+  });
+  worker.join();
+  tracer.Stop();
+  { FLATLAND_TRACE("test", "after_stop"); }
+
+  std::ostringstream out;
+  EXPECT_EQ(tracer.WriteChromeTrace(out), 3u);
+  std::string json = out.str();
+  EXPECT_EQ(Count(json, "\"ph\":\"X\""), 3);
+  EXPECT_EQ(Count(json, "\"name\":\"outer\""), 1);
+  EXPECT_EQ(Count(json, "\"name\":\"inner \\\\\"quoted\\\\\"\""), 1);
+  EXPECT_EQ(Count(json, "\"name\":\"on_worker\""), 1);
+  EXPECT_EQ(Count(json, "before_start|after_stop"), 0);
+  EXPECT_EQ(Count(json, "\"args\":\\{\"name\":\"main\"\\}"), 1);
+  EXPECT_EQ(Count(json, "\"args\":\\{\"name\":\"worker\"\\}"), 1);
+}
+#endif
+
+// Test that the ring buffer keeps the last events
+TEST(TracerTest, ring_buffer) {
+  Tracer &tracer = Tracer::Get();
+  tracer.Start(4);
+  for (int i = 0; i < 10; i++) {
+    tracer.Record("test", ("event_" + std::to_string(i)).c_str(), i, i + 1);
+  }
+  tracer.Stop();
+
+  std::ostringstream out;
+  EXPECT_EQ(tracer.WriteChromeTrace(out), 4u);
+  std::string json = out.str();
+  EXPECT_EQ(Count(json, "event_[0-5]\""), 0);
+  EXPECT_EQ(Count(json, "event_[6-9]\""), 4);
+
+  // a new start clears the trace
+  tracer.Start(4);
+  tracer.Stop();
+  std::ostringstream empty;
+  EXPECT_EQ(tracer.WriteChromeTrace(empty), 0u);
+}
+
+// Test that the durations of the spans are summed by name in one category
+TEST(TracerTest, sum_durations) {
+  Tracer &tracer = Tracer::Get();
+  tracer.Start();
+  tracer.Record("startup", "layers", 0, 10);
+  tracer.Record("startup", "layers", 20, 25);
+  tracer.Record("startup", "models", 30, 33);
+  tracer.Record("other", "layers", 0, 100);
+  tracer.Stop();
+
+  std::map<std::string, uint64_t> durations = tracer.SumDurations("startup");
+  EXPECT_EQ(durations.size(), 2u);
+  EXPECT_EQ(durations["layers"], 15u);
+  EXPECT_EQ(durations["models"], 3u);
+  EXPECT_TRUE(tracer.SumDurations("none").empty());
+}
+
+// Test that writing to an invalid path throws
+TEST(TracerTest, dump_invalid_path) {
+  EXPECT_THROW(Tracer::Get().DumpChromeTrace("/nonexistent/dir/trace.json"),
+               Exception);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,137 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 trigger_volume_test.cpp
+ * @brief	 Test the trigger volumes
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/trigger_volume.h>
+#include <gtest/gtest.h>
+
+using namespace flatland_server;
+
+class TriggerVolumeTest : public ::testing::Test {
+ protected:
+  b2World world = b2World(b2Vec2(0, 0));
+
+  b2Body *AddBox(const b2Vec2 &position, b2BodyType type, bool sensor,
+                 uint16 category = 0x0001) {
+    b2BodyDef body_def;
+    body_def.type = type;
+    body_def.position = position;
+    b2Body *body = world.CreateBody(&body_def);
+    b2PolygonShape box;
+    box.SetAsBox(0.5, 0.5);
+    b2FixtureDef fixture_def;
+    fixture_def.shape = &box;
+    fixture_def.density = 1;
+    fixture_def.isSensor = sensor;
+    fixture_def.filter.categoryBits = category;
+    body->CreateFixture(&fixture_def);
+    return body;
+  }
+};
+
+// Test the fixtures entering and leaving a shape added to the volume
+TEST_F(TriggerVolumeTest, enter_and_leave) {
+  b2Body *sensor = AddBox(b2Vec2(0, 0), b2_kinematicBody, false);
+  b2CircleShape circle;
+  circle.m_radius = 1;
+  TriggerVolume volume(sensor);
+  volume.AddShape(&circle);
+  EXPECT_EQ(volume.GetShapeCount(), 1);
+
+  b2Body *other = AddBox(b2Vec2(5, 0), b2_dynamicBody, false);
+  EXPECT_FALSE(volume.Update());
+  EXPECT_TRUE(volume.GetOccupants().empty());
+
+  // the own fixture of the body is never an occupant
+  other->SetTransform(b2Vec2(1.2, 0), 0);
+  EXPECT_TRUE(volume.Update());
+  ASSERT_EQ(volume.GetOccupants().size(), 1);
+  EXPECT_EQ(volume.GetOccupants()[0], other->GetFixtureList());
+  ASSERT_EQ(volume.GetEntered().size(), 1);
+  EXPECT_TRUE(volume.GetLeft().empty());
+
+  EXPECT_FALSE(volume.Update());
+  EXPECT_TRUE(volume.GetEntered().empty());
+
+  // the boxes of the broad phase overlap, the shapes do not
+  other->SetTransform(b2Vec2(1.6, 0), 0);
+  EXPECT_TRUE(volume.Update());
+  EXPECT_TRUE(volume.GetOccupants().empty());
+  ASSERT_EQ(volume.GetLeft().size(), 1);
+  EXPECT_EQ(volume.GetLeft()[0], other->GetFixtureList());
+}
+
+// Test the sensor fixtures turned into shapes, which create no contacts
+TEST_F(TriggerVolumeTest, sensor_fixtures) {
+  b2Body *sensor = AddBox(b2Vec2(0, 0), b2_dynamicBody, true, 0x0002);
+  AddBox(b2Vec2(0.5, 0), b2_staticBody, false, 0x0001);
+  AddBox(b2Vec2(-0.5, 0), b2_staticBody, false, 0x0002);
+
+  TriggerVolume volume(sensor);
+  EXPECT_EQ(volume.AddSensorFixtures(), 1);
+  EXPECT_EQ(sensor->GetFixtureList()->GetFilterData().categoryBits, 0);
+  EXPECT_EQ(sensor->GetFixtureList()->GetFilterData().maskBits, 0);
+
+  world.Step(0.1, 8, 3);
+  EXPECT_EQ(world.GetContactCount(), 0);
+
+  // a mask of 0x0001 only sees the first box
+  b2Fixture *fixture = sensor->GetFixtureList();
+  TriggerVolume masked(sensor);
+  b2Filter mask;
+  mask.categoryBits = 0x0002;
+  mask.maskBits = 0x0001;
+  masked.AddShape(fixture->GetShape(), mask);
+  EXPECT_TRUE(volume.Update());
+  EXPECT_EQ(volume.GetOccupants().size(), 2);
+  EXPECT_TRUE(masked.Update());
+  EXPECT_EQ(masked.GetOccupants().size(), 1);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
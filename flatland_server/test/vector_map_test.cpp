@@ -0,0 +1,239 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name	 vector_map_test.cpp
+ * @brief	 Test the vector map reader
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_server/exceptions.h>
+#include <flatland_server/vector_map.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include <fstream>
+
+using namespace flatland_server;
+namespace fs = boost::filesystem;
+
+namespace {
+bool HasSegment(const std::vector<LineSegment> &segments, double x1,
+                double y1, double x2, double y2) {
+  auto near = [](double a, double b) { return std::fabs(a - b) < 1e-6; };
+  for (const LineSegment &s : segments) {
+    if ((near(s.start.x, x1) && near(s.start.y, y1) && near(s.end.x, x2) &&
+         near(s.end.y, y2)) ||
+        (near(s.start.x, x2) && near(s.start.y, y2) && near(s.end.x, x1) &&
+         near(s.end.y, y1))) {
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+// Test that collinear vertices and duplicate walls are merged
+TEST(VectorMapTest, to_segments) {
+  VectorMap::Polyline diagonal;
+  diagonal.points = {Vec2(0, 0), Vec2(1, 1), Vec2(2, 2), Vec2(2, 2),
+                     Vec2(3, 3), Vec2(3, 0)};
+  VectorMap::Polyline twice;
+  twice.points = {Vec2(3, 0), Vec2(3, 3)};
+  VectorMap::Polyline back;  // a run folding back on itself is kept
+  back.points = {Vec2(5, 0), Vec2(7, 0), Vec2(6, 0)};
+
+  std::vector<LineSegment> segments =
+      VectorMap::ToSegments({diagonal, twice, back}, 0);
+  ASSERT_EQ(segments.size(), 4u);
+  EXPECT_TRUE(HasSegment(segments, 0, 0, 3, 3));
+  EXPECT_TRUE(HasSegment(segments, 3, 3, 3, 0));
+  EXPECT_TRUE(HasSegment(segments, 5, 0, 7, 0));
+  EXPECT_TRUE(HasSegment(segments, 7, 0, 6, 0));
+
+  // a wall with small deviations is one segment within the tolerance
+  VectorMap::Polyline wobbly;
+  wobbly.points = {Vec2(0, 0), Vec2(1, 0.01), Vec2(2, -0.01), Vec2(3, 0)};
+  EXPECT_EQ(VectorMap::ToSegments({wobbly}, 0).size(), 3u);
+  EXPECT_EQ(VectorMap::ToSegments({wobbly}, 0.02).size(), 1u);
+
+  VectorMap::Polyline square;
+  square.points = {Vec2(0, 0), Vec2(1, 0), Vec2(1, 1), Vec2(0, 1)};
+  square.closed = true;
+  segments = VectorMap::ToSegments({square}, 0);
+  ASSERT_EQ(segments.size(), 4u);
+  EXPECT_TRUE(HasSegment(segments, 0, 1, 0, 0));
+}
+
+// Test the elements, transforms and path commands of SVG
+TEST(VectorMapTest, svg) {
+  std::string svg =
+      "<?xml version=\"1.0\"?>\n"
+      "<!-- a floorplan -->\n"
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"10cm\">\n"
+      "  <defs><line x1=\"0\" y1=\"0\" x2=\"9\" y2=\"9\"/></defs>\n"
+      "  <g transform=\"translate(10, 0) scale(2)\">\n"
+      "    <line x1=\"0\" y1=\"0\" x2=\"1\" y2=\"1\"/>\n"
+      "  </g>\n"
+      "  <polyline points=\"0,0 1,0 2,0 2,1\"/>\n"
+      "  <rect x=\"1\" y=\"1\" width=\"2\" height=\"1\"/>\n"
+      "  <path d=\"M0 0h4v-2l-1-1 -1-1zM5,5 L6,6\"/>\n"
+      "  <path d=\"M0 0 A1 1 0 0 1 2 0\"/>\n"
+      "  <circle cx=\"0\" cy=\"0\" r=\"1\" display=\"none\"/>\n"
+      "</svg>\n";
+  std::vector<VectorMap::Polyline> polylines = VectorMap::ParseSvg(svg);
+  ASSERT_EQ(polylines.size(), 6u);
+
+  // the y axis is flipped, the transforms apply from the right
+  ASSERT_EQ(polylines[0].points.size(), 2u);
+  EXPECT_DOUBLE_EQ(polylines[0].points[1].x, 12);
+  EXPECT_DOUBLE_EQ(polylines[0].points[1].y, -2);
+
+  EXPECT_EQ(polylines[1].points.size(), 4u);
+  EXPECT_FALSE(polylines[1].closed);
+  EXPECT_TRUE(polylines[2].closed);
+
+  // relative commands and implicit repetitions
+  ASSERT_EQ(polylines[3].points.size(), 5u);
+  EXPECT_TRUE(polylines[3].closed);
+  EXPECT_DOUBLE_EQ(polylines[3].points[4].x, 2);
+  EXPECT_DOUBLE_EQ(polylines[3].points[4].y, 4);
+  EXPECT_FALSE(polylines[4].closed);
+
+  // the arc is a half circle through (1, -1) in the drawing
+  const std::vector<Vec2> &arc = polylines[5].points;
+  EXPECT_GT(arc.size(), 8u);
+  EXPECT_DOUBLE_EQ(arc.back().x, 2);
+  for (const Vec2 &p : arc) {
+    EXPECT_NEAR(std::hypot(p.x - 1, p.y), 1, 1e-9);
+    EXPECT_GE(p.y, -1e-9);
+  }
+
+  EXPECT_THROW(VectorMap::ParseSvg("<path d=\"M0 0 X1 1\"/>"), Exception);
+}
+
+// Test the entities of DXF
+TEST(VectorMapTest, dxf) {
+  std::string dxf =
+      "0\nSECTION\n2\nHEADER\n0\nLINE\n10\n9\n20\n9\n11\n8\n21\n8\n"
+      "0\nENDSEC\n"
+      "0\nSECTION\n2\nENTITIES\n"
+      "0\nLINE\n8\nwalls\n10\n0.0\n20\n0.0\n11\n4.0\n21\n3.0\n"
+      "0\nLWPOLYLINE\n90\n3\n70\n1\n10\n0\n20\n0\n10\n1\n20\n0\n42\n1\n"
+      "10\n1\n20\n2\n"
+      "0\nPOLYLINE\n70\n0\n0\nVERTEX\n10\n5\n20\n5\n0\nVERTEX\n10\n6\n20\n5\n"
+      "0\nSEQEND\n"
+      "0\nCIRCLE\n10\n0\n20\n0\n40\n2\n"
+      "0\nENDSEC\n0\nEOF\n";
+  std::vector<VectorMap::Polyline> polylines = VectorMap::ParseDxf(dxf);
+  ASSERT_EQ(polylines.size(), 4u);
+
+  EXPECT_DOUBLE_EQ(polylines[0].points[1].x, 4);
+  EXPECT_DOUBLE_EQ(polylines[0].points[1].y, 3);
+
+  // the bulge of 1 is a counterclockwise half circle from (1, 0) to (1, 2)
+  // through (2, 1), the polyline is closed back to its first vertex
+  const std::vector<Vec2> &lw = polylines[1].points;
+  bool through = false;
+  for (const Vec2 &p : lw) {
+    through = through ||
+              (std::fabs(p.x - 2) < 1e-9 && std::fabs(p.y - 1) < 1e-9);
+  }
+  EXPECT_TRUE(through);
+  EXPECT_DOUBLE_EQ(lw.back().x, 0);
+  EXPECT_DOUBLE_EQ(lw.back().y, 0);
+
+  EXPECT_EQ(polylines[2].points.size(), 2u);
+  EXPECT_TRUE(polylines[3].closed);
+  EXPECT_EQ(polylines[3].points.size(), 32u);
+}
+
+// Test the geometries of GeoJSON
+TEST(VectorMapTest, geojson) {
+  std::string geojson =
+      "{\"type\": \"FeatureCollection\", \"features\": [\n"
+      "  {\"type\": \"Feature\", \"properties\": {\"name\": \"w\\u00e4ll\"},\n"
+      "   \"geometry\": {\"type\": \"LineString\",\n"
+      "                \"coordinates\": [[0, 0], [1.5, 1.5, 10], [3, 3]]}},\n"
+      "  {\"type\": \"Feature\", \"properties\": null, \"geometry\": {\n"
+      "   \"type\": \"Polygon\", \"coordinates\": [\n"
+      "     [[0, 0], [4, 0], [4, 4], [0, 4], [0, 0]],\n"
+      "     [[1, 1], [2, 1], [2, 2], [1, 1]]]}},\n"
+      "  {\"type\": \"Feature\", \"geometry\": {\"type\": \"Point\",\n"
+      "                                       \"coordinates\": [7, 7]}}\n"
+      "]}";
+  std::vector<VectorMap::Polyline> polylines =
+      VectorMap::ParseGeoJson(geojson);
+  ASSERT_EQ(polylines.size(), 3u);
+  EXPECT_DOUBLE_EQ(polylines[0].points[1].x, 1.5);
+
+  std::vector<LineSegment> segments = VectorMap::ToSegments(polylines, 0);
+  EXPECT_EQ(segments.size(), 1u + 4u + 3u);
+  EXPECT_TRUE(HasSegment(segments, 0, 0, 3, 3));
+
+  EXPECT_THROW(VectorMap::ParseGeoJson("{\"type\": }"), Exception);
+  EXPECT_THROW(VectorMap::ParseGeoJson(
+                   "{\"type\": \"LineString\", \"coordinates\": [[0]]}"),
+               Exception);
+}
+
+// Test loading a drawing from a file
+TEST(VectorMapTest, load) {
+  fs::path dir = fs::temp_directory_path() / fs::unique_path();
+  fs::create_directories(dir);
+  std::string path = (dir / "floor.SVG").string();
+  std::ofstream(path) << "<svg><polygon points=\"0,0 1,0 2,0 2,2\"/></svg>";
+
+  EXPECT_EQ(VectorMap::FormatOf(path), VectorMap::SVG);
+  EXPECT_EQ(VectorMap::ParseFormat("GeoJSON"), VectorMap::GEOJSON);
+  EXPECT_THROW(VectorMap::FormatOf("floor.png"), Exception);
+  EXPECT_EQ(VectorMap::Load(path, VectorMap::SVG, 0).size(), 3u);
+  EXPECT_THROW(VectorMap::Load(path, VectorMap::GEOJSON, 0), Exception);
+  EXPECT_THROW(
+      VectorMap::Load((dir / "missing.svg").string(), VectorMap::SVG, 0),
+      Exception);
+  fs::remove_all(dir);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
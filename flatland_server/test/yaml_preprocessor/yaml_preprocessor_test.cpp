@@ -127,6 +127,51 @@ TEST(YamlPreprocTest, testEvalStrings) {
   compareNodes("testParam", "param9", in, out);
 }
 
+// Test the state shared by the expressions of a pass
+TEST(YamlPreprocTest, testLuaEvaluator) {
+  YamlPreprocessor::LuaEvaluator lua;
+  std::string result;
+
+  ASSERT_TRUE(lua.Evaluate("x = 3 return x", &result));
+  EXPECT_EQ(result, "3");
+
+  // the globals set by an expression are not seen by the others
+  ASSERT_TRUE(lua.Evaluate("return x", &result));
+  EXPECT_EQ(result, "");
+
+  // a compiled expression runs in a fresh environment each time
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(lua.Evaluate("y = (y or 0) + 1 return y", &result));
+    EXPECT_EQ(result, "1");
+  }
+
+  EXPECT_FALSE(lua.Evaluate("return {}", &result));
+  EXPECT_FALSE(lua.Evaluate("return (", &result));
+
+  // the state is still usable after the errors
+  ASSERT_TRUE(lua.Evaluate("return string.rep(\"a\", 3)", &result));
+  EXPECT_EQ(result, "aaa");
+}
+
+// Test the parameters looked up through the cache, which must follow changes
+TEST(YamlPreprocTest, testParamCache) {
+  YamlPreprocessor::LuaEvaluator lua;
+  std::string result;
+
+  ASSERT_TRUE(lua.Evaluate("return param('/cached', 1)", &result));
+  EXPECT_EQ(result, "1");
+  ASSERT_TRUE(lua.Evaluate("return param('/int')", &result));
+  EXPECT_EQ(result, "7");
+
+  ros::param::set("/cached", 2.5);
+  ros::param::set("/int", 8);
+  ASSERT_TRUE(lua.Evaluate("return param('/cached', 1)", &result));
+  EXPECT_EQ(result, "2.5");
+  ASSERT_TRUE(lua.Evaluate("return param('/int')", &result));
+  EXPECT_EQ(result, "8");
+  ros::param::set("/int", 7);
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv) {
   ros::init(argc, argv, "yaml_preprocessor_test");
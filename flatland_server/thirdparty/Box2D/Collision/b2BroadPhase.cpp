@@ -21,6 +21,22 @@
 b2BroadPhase::b2BroadPhase()
 {
 	m_proxyCount = 0;
+	m_staticProxyCount = 0;
+	m_staticChangeCount = 0;
+
+	m_staticBulkDepth = 0;
+	m_deferredCapacity = 16;
+	m_deferredCount = 0;
+	m_deferredBuffer = (int32*)b2Alloc(m_deferredCapacity * sizeof(int32));
+
+	m_destroyedCapacity = 16;
+	m_destroyedCount = 0;
+	m_destroyedBuffer = (int32*)b2Alloc(m_destroyedCapacity * sizeof(int32));
+
+	m_bulkDestroyDepth = 0;
+	m_movingDestroyedCapacity = 16;
+	m_movingDestroyedCount = 0;
+	m_movingDestroyedBuffer = (int32*)b2Alloc(m_movingDestroyedCapacity * sizeof(int32));
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
@@ -29,17 +45,49 @@ b2BroadPhase::b2BroadPhase()
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_reinsertCount = 0;
+	m_reportedPairCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
 	b2Free(m_moveBuffer);
 	b2Free(m_pairBuffer);
+	b2Free(m_deferredBuffer);
+	b2Free(m_destroyedBuffer);
+	b2Free(m_movingDestroyedBuffer);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	int32 proxyId;
+	if (isStatic)
+	{
+		bool defer = m_staticBulkDepth > 0;
+		proxyId = m_staticTree.CreateProxy(aabb, userData, defer == false);
+		b2Assert((proxyId & e_staticProxyFlag) == 0);
+		if (defer)
+		{
+			if (m_deferredCount == m_deferredCapacity)
+			{
+				int32* oldBuffer = m_deferredBuffer;
+				m_deferredCapacity *= 2;
+				m_deferredBuffer = (int32*)b2Alloc(m_deferredCapacity * sizeof(int32));
+				memcpy(m_deferredBuffer, oldBuffer, m_deferredCount * sizeof(int32));
+				b2Free(oldBuffer);
+			}
+			m_deferredBuffer[m_deferredCount] = proxyId;
+			++m_deferredCount;
+		}
+		proxyId |= e_staticProxyFlag;
+		++m_staticProxyCount;
+		++m_staticChangeCount;
+	}
+	else
+	{
+		proxyId = m_tree.CreateProxy(aabb, userData);
+	}
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
@@ -47,25 +95,231 @@ int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
+	if (IsStaticProxy(proxyId) && m_staticBulkDepth > 0)
+	{
+		// Removed from the tree and the move buffer when the bulk ends.
+		int32 nodeId = proxyId & ~e_staticProxyFlag;
+		m_staticTree.DestroyProxy(nodeId, false);
+		if (m_destroyedCount == m_destroyedCapacity)
+		{
+			int32* oldBuffer = m_destroyedBuffer;
+			m_destroyedCapacity *= 2;
+			m_destroyedBuffer = (int32*)b2Alloc(m_destroyedCapacity * sizeof(int32));
+			memcpy(m_destroyedBuffer, oldBuffer, m_destroyedCount * sizeof(int32));
+			b2Free(oldBuffer);
+		}
+		m_destroyedBuffer[m_destroyedCount] = nodeId;
+		++m_destroyedCount;
+		--m_proxyCount;
+		--m_staticProxyCount;
+		++m_staticChangeCount;
+		return;
+	}
+
+	if (IsStaticProxy(proxyId) == false && m_bulkDestroyDepth > 0)
+	{
+		// Removed from the tree and the move buffer when the bulk ends.
+		m_tree.DestroyProxy(proxyId, false);
+		if (m_movingDestroyedCount == m_movingDestroyedCapacity)
+		{
+			int32* oldBuffer = m_movingDestroyedBuffer;
+			m_movingDestroyedCapacity *= 2;
+			m_movingDestroyedBuffer = (int32*)b2Alloc(m_movingDestroyedCapacity * sizeof(int32));
+			memcpy(m_movingDestroyedBuffer, oldBuffer, m_movingDestroyedCount * sizeof(int32));
+			b2Free(oldBuffer);
+		}
+		m_movingDestroyedBuffer[m_movingDestroyedCount] = proxyId;
+		++m_movingDestroyedCount;
+		--m_proxyCount;
+		return;
+	}
+
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+	if (IsStaticProxy(proxyId))
+	{
+		InsertDeferredProxies();
+		m_staticTree.DestroyProxy(proxyId & ~e_staticProxyFlag);
+		--m_staticProxyCount;
+		++m_staticChangeCount;
+	}
+	else
+	{
+		m_tree.DestroyProxy(proxyId);
+	}
 }
 
-void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement,
+							 float32 extension, bool shrink)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	if (IsStaticProxy(proxyId))
+	{
+		InsertDeferredProxies();
+		buffer = m_staticTree.MoveProxy(proxyId & ~e_staticProxyFlag, aabb, displacement, extension, shrink);
+	}
+	else
+	{
+		buffer = m_tree.MoveProxy(proxyId, aabb, displacement, extension, shrink);
+	}
 	if (buffer)
 	{
+		++m_reinsertCount;
 		BufferMove(proxyId);
 	}
 }
 
+void b2BroadPhase::RebuildStaticTree()
+{
+	// The rebuild inserts the deferred proxies and frees the destroyed ones.
+	UnBufferDestroyedProxies();
+	m_staticTree.RebuildTopDown();
+	m_staticChangeCount = 0;
+	m_deferredCount = 0;
+	m_destroyedCount = 0;
+}
+
+void b2BroadPhase::SettleStaticTree()
+{
+	// Proxies created in bulk must be in the tree to form pairs, the ones
+	// destroyed in bulk must be out of it.
+	InsertDeferredProxies();
+
+	// Rebalance the static tree after bulk changes, e.g. loading a layer.
+	if (m_staticChangeCount > 0 && 4 * m_staticChangeCount >= m_staticProxyCount)
+	{
+		RebuildStaticTree();
+	}
+	FreeDestroyedProxies();
+}
+
+void b2BroadPhase::BeginStaticBulk()
+{
+	++m_staticBulkDepth;
+}
+
+void b2BroadPhase::EndStaticBulk()
+{
+	b2Assert(m_staticBulkDepth > 0);
+	--m_staticBulkDepth;
+	if (m_staticBulkDepth > 0 || (m_deferredCount == 0 && m_destroyedCount == 0))
+	{
+		return;
+	}
+
+	if (4 * m_staticChangeCount >= m_staticProxyCount)
+	{
+		RebuildStaticTree();
+	}
+	else
+	{
+		InsertDeferredProxies();
+		FreeDestroyedProxies();
+	}
+}
+
+void b2BroadPhase::BeginBulkDestroy()
+{
+	++m_bulkDestroyDepth;
+}
+
+void b2BroadPhase::EndBulkDestroy()
+{
+	b2Assert(m_bulkDestroyDepth > 0);
+	--m_bulkDestroyDepth;
+	if (m_bulkDestroyDepth == 0)
+	{
+		SettleMovingTree();
+	}
+}
+
+void b2BroadPhase::SettleMovingTree()
+{
+	if (m_movingDestroyedCount == 0)
+	{
+		return;
+	}
+
+	// One pass over the move buffer, instead of one per destroyed proxy.
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		int32 proxyId = m_moveBuffer[i];
+		if (proxyId != e_nullProxy && IsStaticProxy(proxyId) == false && m_tree.IsDestroyed(proxyId))
+		{
+			m_moveBuffer[i] = e_nullProxy;
+		}
+	}
+
+	// The rebuild frees the destroyed proxies. It costs about twice as much
+	// per remaining proxy as removing a destroyed one, e.g. when deleting a
+	// whole world only the rebuild of an empty tree is left.
+	int32 remainingCount = m_proxyCount - m_staticProxyCount;
+	if (m_movingDestroyedCount >= 2 * remainingCount)
+	{
+		m_tree.RebuildTopDown();
+	}
+	else
+	{
+		for (int32 i = 0; i < m_movingDestroyedCount; ++i)
+		{
+			m_tree.FreeDestroyedProxy(m_movingDestroyedBuffer[i]);
+		}
+	}
+	m_movingDestroyedCount = 0;
+}
+
+void b2BroadPhase::InsertDeferredProxies()
+{
+	for (int32 i = 0; i < m_deferredCount; ++i)
+	{
+		// Proxies destroyed before they were inserted are freed later.
+		if (m_staticTree.IsDestroyed(m_deferredBuffer[i]) == false)
+		{
+			m_staticTree.InsertProxy(m_deferredBuffer[i]);
+		}
+	}
+	m_deferredCount = 0;
+}
+
+void b2BroadPhase::UnBufferDestroyedProxies()
+{
+	if (m_destroyedCount == 0)
+	{
+		return;
+	}
+
+	// One pass over the move buffer, instead of one per destroyed proxy.
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		int32 proxyId = m_moveBuffer[i];
+		if (IsStaticProxy(proxyId) && m_staticTree.IsDestroyed(proxyId & ~e_staticProxyFlag))
+		{
+			m_moveBuffer[i] = e_nullProxy;
+		}
+	}
+}
+
+void b2BroadPhase::FreeDestroyedProxies()
+{
+	UnBufferDestroyedProxies();
+	for (int32 i = 0; i < m_destroyedCount; ++i)
+	{
+		m_staticTree.FreeDestroyedProxy(m_destroyedBuffer[i]);
+	}
+	m_destroyedCount = 0;
+}
+
 void b2BroadPhase::TouchProxy(int32 proxyId)
 {
 	BufferMove(proxyId);
 }
 
+void b2BroadPhase::SetProxyFilter(int32 proxyId, uint32 categoryBits, bool isSensor)
+{
+	b2DynamicTree& tree = IsStaticProxy(proxyId) ? m_staticTree : m_tree;
+	tree.SetProxyFilter(proxyId & ~e_staticProxyFlag, categoryBits, isSensor);
+}
+
 void b2BroadPhase::BufferMove(int32 proxyId)
 {
 	if (m_moveCount == m_moveCapacity)
@@ -30,35 +30,53 @@ struct b2Pair
 	int32 proxyIdB;
 };
 
+template <typename T>
+struct b2TreeCallback;
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+///
+/// Flatland: the proxies of static bodies live in a separate static tree. The
+/// large number of static edges of the layers then neither deepen the tree of
+/// the moving proxies nor get queried for pairs among themselves, and the
+/// static tree is rebuilt balanced after bulk insertions, see UpdatePairs.
 class b2BroadPhase
 {
 public:
 
 	enum
 	{
-		e_nullProxy = -1
+		e_nullProxy = -1,
+
+		/// Set in the ids of the proxies of the static tree.
+		e_staticProxyFlag = 0x40000000
 	};
 
 	b2BroadPhase();
 	~b2BroadPhase();
 
 	/// Create a proxy with an initial AABB. Pairs are not reported until
-	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// UpdatePairs is called. Static proxies (of static bodies) are put in the
+	/// static tree, they never form pairs with each other.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic = false);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
 
 	/// Call MoveProxy as many times as you like, then when you are done
 	/// call UpdatePairs to finalized the proxy pairs (for your time step).
-	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
+	/// Flatland: see b2DynamicTree::MoveProxy for extension and shrink.
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement,
+				   float32 extension = b2_aabbExtension, bool shrink = false);
 
 	/// Call to trigger a re-processing of it's pairs on the next call to UpdatePairs.
 	void TouchProxy(int32 proxyId);
 
+	/// Set the category bits of a proxy and whether it is a sensor, so that
+	/// RayCastPacket skips the subtrees no ray can hit.
+	void SetProxyFilter(int32 proxyId, uint32 categoryBits, bool isSensor);
+
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
@@ -90,32 +108,129 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
-	/// Get the height of the embedded tree.
+	/// Ray-cast a packet of rays in one traversal of each tree, see
+	/// b2DynamicTree::RayCastPacket. The static tree is cast first.
+	template <typename T>
+	void RayCastPacket(T* callback, const b2RayCastInput* inputs, const float32* maxFractions, int32 count,
+					   uint32 maskBits = 0xFFFFFFFF, bool skipSensors = false) const;
+
+	/// Get the height of the embedded tree of the non static proxies.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the balance of the embedded tree of the non static proxies.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the quality metric of the embedded tree of the non static proxies.
 	float32 GetTreeQuality() const;
 
+	/// Get the number of static proxies.
+	int32 GetStaticProxyCount() const;
+
+	/// Flatland: get the number of proxies MoveProxy reinserted, and of
+	/// candidate pairs UpdatePairs reported, since ResetCounts.
+	int32 GetReinsertCount() const;
+	int32 GetReportedPairCount() const;
+	void ResetCounts();
+
+	/// Get the height of the static tree.
+	int32 GetStaticTreeHeight() const;
+
+	/// Rebuild the static tree balanced, this is done by UpdatePairs once the
+	/// static proxies created or destroyed since the last build are at least a
+	/// quarter of the static proxies.
+	void RebuildStaticTree();
+
+	/// Apply the pending changes of the static tree, which UpdatePairs would
+	/// otherwise apply. Until static proxies are created, destroyed or moved
+	/// again, the static tree is then left untouched.
+	void SettleStaticTree();
+
+	/// Get the tree of the non static proxies.
+	const b2DynamicTree& GetMovingTree() const;
+
+	/// Get the tree of the static proxies, their ids without e_staticProxyFlag.
+	const b2DynamicTree& GetStaticTree() const;
+
+	/// Begin creating or destroying many static proxies. Until the matching
+	/// EndStaticBulk, static proxies are not inserted into or removed from
+	/// the static tree one by one, which saves the incremental rebalancing.
+	/// Queries and ray casts do not find them until then. Calls nest.
+	void BeginStaticBulk();
+
+	/// End creating or destroying many static proxies. If they are many
+	/// compared to the static tree, the tree is rebuilt in one top-down pass,
+	/// otherwise they are inserted or removed one by one.
+	void EndStaticBulk();
+
+	/// Begin destroying many non static proxies, e.g. of the models of a
+	/// fleet. Until the matching EndBulkDestroy, they are only marked
+	/// destroyed instead of being removed from the tree one by one. Queries
+	/// and ray casts skip them. Calls nest.
+	void BeginBulkDestroy();
+
+	/// End destroying many non static proxies. If they are most of the tree,
+	/// the tree is rebuilt in one top-down pass without them, otherwise they
+	/// are removed one by one.
+	void EndBulkDestroy();
+
+	/// Remove the non static proxies destroyed in bulk, which UpdatePairs
+	/// would otherwise do.
+	void SettleMovingTree();
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Check if a proxy is in the static tree.
+	static bool IsStaticProxy(int32 proxyId);
+
 private:
 
 	friend class b2DynamicTree;
+	template <typename T>
+	friend struct b2TreeCallback;
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
 
 	bool QueryCallback(int32 proxyId);
 
+	const b2DynamicTree& GetTree(int32 proxyId) const;
+
+	void InsertDeferredProxies();
+	void UnBufferDestroyedProxies();
+	void FreeDestroyedProxies();
+
 	b2DynamicTree m_tree;
+	b2DynamicTree m_staticTree;
 
 	int32 m_proxyCount;
+	int32 m_staticProxyCount;
+
+	/// The static proxies created or destroyed since the static tree was built.
+	int32 m_staticChangeCount;
+
+	/// Nesting depth of BeginStaticBulk.
+	int32 m_staticBulkDepth;
+
+	/// The static tree node ids of the proxies created in bulk, not yet inserted.
+	int32* m_deferredBuffer;
+	int32 m_deferredCapacity;
+	int32 m_deferredCount;
+
+	/// The static tree node ids of the proxies destroyed in bulk, not yet freed.
+	int32* m_destroyedBuffer;
+	int32 m_destroyedCapacity;
+	int32 m_destroyedCount;
+
+	/// Nesting depth of BeginBulkDestroy.
+	int32 m_bulkDestroyDepth;
+
+	/// The non static proxies destroyed in bulk, not yet freed.
+	int32* m_movingDestroyedBuffer;
+	int32 m_movingDestroyedCapacity;
+	int32 m_movingDestroyedCount;
 
 	int32* m_moveBuffer;
 	int32 m_moveCapacity;
@@ -126,6 +241,64 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+
+	int32 m_reinsertCount;
+	int32 m_reportedPairCount;
+};
+
+/// Adapts a callback of one tree to the proxy ids of b2BroadPhase, by setting
+/// the flag of the tree in the ids. Tracks if the callback terminated the
+/// query or ray cast and the fraction the ray was clipped to, so that the
+/// other tree can be cast with the clipped ray.
+template <typename T>
+struct b2TreeCallback
+{
+	b2TreeCallback(T* callback, const b2DynamicTree* tree, int32 flag, float32 maxFraction)
+		: callback(callback), tree(tree), flag(flag), maxFraction(maxFraction), terminated(false) {}
+
+	bool QueryCallback(int32 proxyId)
+	{
+		// The proxies destroyed in bulk have no fixture anymore.
+		if (tree->IsDestroyed(proxyId))
+		{
+			return true;
+		}
+		bool proceed = callback->QueryCallback(proxyId | flag);
+		terminated = !proceed;
+		return proceed;
+	}
+
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		if (tree->IsDestroyed(proxyId))
+		{
+			return -1.0f;
+		}
+		float32 value = callback->RayCastCallback(input, proxyId | flag);
+		if (value == 0.0f)
+		{
+			terminated = true;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	void RayCastPacketCallback(int32 proxyId, const int32* rays, int32 rayCount)
+	{
+		if (tree->IsDestroyed(proxyId) == false)
+		{
+			callback->RayCastPacketCallback(proxyId | flag, rays, rayCount);
+		}
+	}
+
+	T* callback;
+	const b2DynamicTree* tree;
+	int32 flag;
+	float32 maxFraction;
+	bool terminated;
 };
 
 /// This is used to sort pairs.
@@ -144,21 +317,31 @@ inline bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
 	return false;
 }
 
+inline bool b2BroadPhase::IsStaticProxy(int32 proxyId)
+{
+	return proxyId != e_nullProxy && (proxyId & e_staticProxyFlag) != 0;
+}
+
+inline const b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId) const
+{
+	return IsStaticProxy(proxyId) ? m_staticTree : m_tree;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	return GetTree(proxyId).GetUserData(proxyId & ~e_staticProxyFlag);
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	return GetTree(proxyId).GetFatAABB(proxyId & ~e_staticProxyFlag);
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -166,6 +349,16 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline const b2DynamicTree& b2BroadPhase::GetMovingTree() const
+{
+	return m_tree;
+}
+
+inline const b2DynamicTree& b2BroadPhase::GetStaticTree() const
+{
+	return m_staticTree;
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
 	return m_tree.GetHeight();
@@ -181,9 +374,38 @@ inline float32 b2BroadPhase::GetTreeQuality() const
 	return m_tree.GetAreaRatio();
 }
 
+inline int32 b2BroadPhase::GetStaticProxyCount() const
+{
+	return m_staticProxyCount;
+}
+
+inline int32 b2BroadPhase::GetStaticTreeHeight() const
+{
+	return m_staticTree.GetHeight();
+}
+
+inline int32 b2BroadPhase::GetReinsertCount() const
+{
+	return m_reinsertCount;
+}
+
+inline int32 b2BroadPhase::GetReportedPairCount() const
+{
+	return m_reportedPairCount;
+}
+
+inline void b2BroadPhase::ResetCounts()
+{
+	m_reinsertCount = 0;
+	m_reportedPairCount = 0;
+}
+
 template <typename T>
 void b2BroadPhase::UpdatePairs(T* callback)
 {
+	SettleStaticTree();
+	SettleMovingTree();
+
 	// Reset pair buffer
 	m_pairCount = 0;
 
@@ -198,10 +420,16 @@ void b2BroadPhase::UpdatePairs(T* callback)
 
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
 
-		// Query tree, create pairs and add them pair buffer.
+		// Query tree, create pairs and add them pair buffer. Static proxies
+		// only pair with the non static ones.
 		m_tree.Query(this, fatAABB);
+		if (IsStaticProxy(m_queryProxyId) == false)
+		{
+			b2TreeCallback<b2BroadPhase> staticCallback(this, &m_staticTree, e_staticProxyFlag, 0.0f);
+			m_staticTree.Query(&staticCallback, fatAABB);
+		}
 	}
 
 	// Reset move buffer
@@ -215,10 +443,11 @@ void b2BroadPhase::UpdatePairs(T* callback)
 	while (i < m_pairCount)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
+		++m_reportedPairCount;
 		++i;
 
 		// Skip any duplicate pairs.
@@ -240,18 +469,49 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	b2TreeCallback<T> treeCallback(callback, &m_tree, 0, 0.0f);
+	m_tree.Query(&treeCallback, aabb);
+	if (treeCallback.terminated)
+	{
+		return;
+	}
+
+	b2TreeCallback<T> staticCallback(callback, &m_staticTree, e_staticProxyFlag, 0.0f);
+	m_staticTree.Query(&staticCallback, aabb);
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	// Cast the static tree first, it usually clips the ray the most, then cast
+	// the clipped ray against the other proxies.
+	b2TreeCallback<T> staticCallback(callback, &m_staticTree, e_staticProxyFlag, input.maxFraction);
+	m_staticTree.RayCast(&staticCallback, input);
+	if (staticCallback.terminated)
+	{
+		return;
+	}
+
+	b2RayCastInput clipped = input;
+	clipped.maxFraction = staticCallback.maxFraction;
+	b2TreeCallback<T> movingCallback(callback, &m_tree, 0, clipped.maxFraction);
+	m_tree.RayCast(&movingCallback, clipped);
+}
+
+template <typename T>
+inline void b2BroadPhase::RayCastPacket(T* callback, const b2RayCastInput* inputs, const float32* maxFractions, int32 count,
+										uint32 maskBits, bool skipSensors) const
+{
+	b2TreeCallback<T> staticCallback(callback, &m_staticTree, e_staticProxyFlag, 0.0f);
+	m_staticTree.RayCastPacket(&staticCallback, inputs, maxFractions, count, maskBits, skipSensors);
+	b2TreeCallback<T> movingCallback(callback, &m_tree, 0, 0.0f);
+	m_tree.RayCastPacket(&movingCallback, inputs, maxFractions, count, maskBits, skipSensors);
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
+	m_staticTree.ShiftOrigin(newOrigin);
 }
 
 #endif
@@ -17,6 +17,8 @@
 */
 
 #include "Box2D/Collision/b2DynamicTree.h"
+#include <algorithm>
+#include <new>
 #include <string.h>
 
 b2DynamicTree::b2DynamicTree()
@@ -26,7 +28,10 @@ b2DynamicTree::b2DynamicTree()
 	m_nodeCapacity = 16;
 	m_nodeCount = 0;
 	m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
-	memset(m_nodes, 0, m_nodeCapacity * sizeof(b2TreeNode));
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		new (m_nodes + i) b2TreeNode();
+	}
 
 	// Build a linked list for the free list.
 	for (int32 i = 0; i < m_nodeCapacity - 1; ++i)
@@ -84,6 +89,8 @@ int32 b2DynamicTree::AllocateNode()
 	m_nodes[nodeId].child2 = b2_nullNode;
 	m_nodes[nodeId].height = 0;
 	m_nodes[nodeId].userData = nullptr;
+	m_nodes[nodeId].categoryBits = 0xFFFFFFFF;
+	m_nodes[nodeId].solidBits = 0xFFFFFFFF;
 	++m_nodeCount;
 	return nodeId;
 }
@@ -102,7 +109,7 @@ void b2DynamicTree::FreeNode(int32 nodeId)
 // Create a proxy in the tree as a leaf node. We return the index
 // of the node instead of a pointer so that we can grow
 // the node pool.
-int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData, bool insert)
 {
 	int32 proxyId = AllocateNode();
 
@@ -113,36 +120,107 @@ int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 	m_nodes[proxyId].userData = userData;
 	m_nodes[proxyId].height = 0;
 
-	InsertLeaf(proxyId);
+	if (insert)
+	{
+		InsertLeaf(proxyId);
+	}
 
 	return proxyId;
 }
 
-void b2DynamicTree::DestroyProxy(int32 proxyId)
+void b2DynamicTree::InsertProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	b2Assert(m_nodes[proxyId].IsLeaf());
+	InsertLeaf(proxyId);
+}
+
+void b2DynamicTree::DestroyProxy(int32 proxyId, bool remove)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
+	if (remove == false)
+	{
+		m_nodes[proxyId].userData = nullptr;
+		m_nodes[proxyId].child2 = b2_destroyedNode;
+		return;
+	}
+
 	RemoveLeaf(proxyId);
 	FreeNode(proxyId);
 }
 
-bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+void b2DynamicTree::FreeDestroyedProxy(int32 proxyId)
+{
+	b2Assert(IsDestroyed(proxyId));
+	m_nodes[proxyId].child2 = b2_nullNode;
+
+	// A proxy that was never inserted has no parent and is not the root.
+	if (m_nodes[proxyId].parent != b2_nullNode || proxyId == m_root)
+	{
+		RemoveLeaf(proxyId);
+	}
+	FreeNode(proxyId);
+}
+
+void b2DynamicTree::SetProxyFilter(int32 proxyId, uint32 categoryBits, bool isSensor)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	b2Assert(m_nodes[proxyId].IsLeaf());
+
+	b2TreeNode* leaf = m_nodes + proxyId;
+	leaf->categoryBits = categoryBits;
+	leaf->solidBits = isSensor ? 0 : categoryBits;
+
+	// Refresh the unions of the ancestors, up to the first one that does not
+	// change. A proxy that is not inserted yet has no parent.
+	int32 index = leaf->parent;
+	while (index != b2_nullNode)
+	{
+		b2TreeNode* node = m_nodes + index;
+		uint32 oldCategoryBits = node->categoryBits;
+		uint32 oldSolidBits = node->solidBits;
+		node->CombineFilter(m_nodes[node->child1], m_nodes[node->child2]);
+		if (node->categoryBits == oldCategoryBits && node->solidBits == oldSolidBits)
+		{
+			break;
+		}
+		index = node->parent;
+	}
+}
+
+bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement,
+							  float32 extension, bool shrink)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
-	if (m_nodes[proxyId].aabb.Contains(aabb))
+	b2Vec2 r(extension, extension);
+	const b2AABB& treeAABB = m_nodes[proxyId].aabb;
+	if (treeAABB.Contains(aabb))
 	{
-		return false;
+		if (shrink == false)
+		{
+			return false;
+		}
+
+		// The fat AABB may be much larger than needed now, the pairs it
+		// overlaps would be reported for nothing.
+		b2AABB hugeAABB;
+		hugeAABB.lowerBound = aabb.lowerBound - 4.0f * r;
+		hugeAABB.upperBound = aabb.upperBound + 4.0f * r;
+		if (hugeAABB.Contains(treeAABB))
+		{
+			return false;
+		}
 	}
 
 	RemoveLeaf(proxyId);
 
 	// Extend AABB.
 	b2AABB b = aabb;
-	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
 	b.lowerBound = b.lowerBound - r;
 	b.upperBound = b.upperBound + r;
 
@@ -264,6 +342,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 	m_nodes[newParent].userData = nullptr;
 	m_nodes[newParent].aabb.Combine(leafAABB, m_nodes[sibling].aabb);
 	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].CombineFilter(m_nodes[leaf], m_nodes[sibling]);
 
 	if (oldParent != b2_nullNode)
 	{
@@ -306,6 +385,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 		m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
 		m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+		m_nodes[index].CombineFilter(m_nodes[child1], m_nodes[child2]);
 
 		index = m_nodes[index].parent;
 	}
@@ -357,6 +437,7 @@ void b2DynamicTree::RemoveLeaf(int32 leaf)
 			int32 child2 = m_nodes[index].child2;
 
 			m_nodes[index].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+			m_nodes[index].CombineFilter(m_nodes[child1], m_nodes[child2]);
 			m_nodes[index].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
 
 			index = m_nodes[index].parent;
@@ -435,6 +516,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			G->parent = iA;
 			A->aabb.Combine(B->aabb, G->aabb);
 			C->aabb.Combine(A->aabb, F->aabb);
+			A->CombineFilter(*B, *G);
+			C->CombineFilter(*A, *F);
 
 			A->height = 1 + b2Max(B->height, G->height);
 			C->height = 1 + b2Max(A->height, F->height);
@@ -446,6 +529,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			F->parent = iA;
 			A->aabb.Combine(B->aabb, F->aabb);
 			C->aabb.Combine(A->aabb, G->aabb);
+			A->CombineFilter(*B, *F);
+			C->CombineFilter(*A, *G);
 
 			A->height = 1 + b2Max(B->height, F->height);
 			C->height = 1 + b2Max(A->height, G->height);
@@ -495,6 +580,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			E->parent = iA;
 			A->aabb.Combine(C->aabb, E->aabb);
 			B->aabb.Combine(A->aabb, D->aabb);
+			A->CombineFilter(*C, *E);
+			B->CombineFilter(*A, *D);
 
 			A->height = 1 + b2Max(C->height, E->height);
 			B->height = 1 + b2Max(A->height, D->height);
@@ -506,6 +593,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 			D->parent = iA;
 			A->aabb.Combine(C->aabb, D->aabb);
 			B->aabb.Combine(A->aabb, E->aabb);
+			A->CombineFilter(*C, *D);
+			B->CombineFilter(*A, *E);
 
 			A->height = 1 + b2Max(C->height, D->height);
 			B->height = 1 + b2Max(A->height, E->height);
@@ -646,6 +735,9 @@ void b2DynamicTree::ValidateMetrics(int32 index) const
 	b2Assert(aabb.lowerBound == node->aabb.lowerBound);
 	b2Assert(aabb.upperBound == node->aabb.upperBound);
 
+	b2Assert(node->categoryBits == (m_nodes[child1].categoryBits | m_nodes[child2].categoryBits));
+	b2Assert(node->solidBits == (m_nodes[child1].solidBits | m_nodes[child2].solidBits));
+
 	ValidateMetrics(child1);
 	ValidateMetrics(child2);
 }
@@ -753,6 +845,7 @@ void b2DynamicTree::RebuildBottomUp()
 		parent->child2 = index2;
 		parent->height = 1 + b2Max(child1->height, child2->height);
 		parent->aabb.Combine(child1->aabb, child2->aabb);
+		parent->CombineFilter(*child1, *child2);
 		parent->parent = b2_nullNode;
 
 		child1->parent = parentIndex;
@@ -769,6 +862,124 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+void b2DynamicTree::RebuildTopDown()
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	int32* leaves = (int32*)b2Alloc(m_nodeCount * sizeof(int32));
+	int32 count = 0;
+
+	// Build array of leaves. Free the rest.
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf() && m_nodes[i].child2 != b2_destroyedNode)
+		{
+			m_nodes[i].parent = b2_nullNode;
+			leaves[count] = i;
+			++count;
+		}
+		else
+		{
+			m_nodes[i].child2 = b2_nullNode;
+			FreeNode(i);
+		}
+	}
+
+	if (count == 0)
+	{
+		m_root = b2_nullNode;
+		b2Free(leaves);
+		return;
+	}
+
+	m_root = BuildTopDown(leaves, count);
+	m_nodes[m_root].parent = b2_nullNode;
+	b2Free(leaves);
+
+	Validate();
+}
+
+int32 b2DynamicTree::BuildTopDown(int32* leaves, int32 count)
+{
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	// Split along the longest axis of the bounds of the centers.
+	b2Vec2 lower = m_nodes[leaves[0]].aabb.GetCenter();
+	b2Vec2 upper = lower;
+	for (int32 i = 1; i < count; ++i)
+	{
+		b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+		lower = b2Min(lower, c);
+		upper = b2Max(upper, c);
+	}
+	int32 axis = upper.x - lower.x >= upper.y - lower.y ? 0 : 1;
+
+	// Partition at the median, the halves have the same number of leaves so
+	// the height is at most ceil(log2(count)).
+	int32 half = count / 2;
+	const b2TreeNode* nodes = m_nodes;
+	std::nth_element(leaves, leaves + half, leaves + count,
+		[nodes, axis](int32 a, int32 b)
+		{
+			const b2AABB& aabbA = nodes[a].aabb;
+			const b2AABB& aabbB = nodes[b].aabb;
+			if (axis == 0)
+			{
+				return aabbA.lowerBound.x + aabbA.upperBound.x < aabbB.lowerBound.x + aabbB.upperBound.x;
+			}
+			return aabbA.lowerBound.y + aabbA.upperBound.y < aabbB.lowerBound.y + aabbB.upperBound.y;
+		});
+
+	int32 index1 = BuildTopDown(leaves, half);
+	int32 index2 = BuildTopDown(leaves + half, count - half);
+
+	// The internal nodes were freed before the build, so the pool does not
+	// grow here.
+	int32 parentIndex = AllocateNode();
+	b2TreeNode* parent = m_nodes + parentIndex;
+	b2TreeNode* child1 = m_nodes + index1;
+	b2TreeNode* child2 = m_nodes + index2;
+	parent->child1 = index1;
+	parent->child2 = index2;
+	parent->height = 1 + b2Max(child1->height, child2->height);
+	parent->aabb.Combine(child1->aabb, child2->aabb);
+	parent->CombineFilter(*child1, *child2);
+	parent->parent = b2_nullNode;
+
+	child1->parent = parentIndex;
+	child2->parent = parentIndex;
+	return parentIndex;
+}
+
+void b2DynamicTree::CopyFrom(const b2DynamicTree& tree)
+{
+	if (m_nodeCapacity != tree.m_nodeCapacity)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = tree.m_nodeCapacity;
+		m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	}
+	memcpy(m_nodes, tree.m_nodes, m_nodeCapacity * sizeof(b2TreeNode));
+
+	m_root = tree.m_root;
+	m_nodeCount = tree.m_nodeCount;
+	m_freeList = tree.m_freeList;
+	m_path = tree.m_path;
+	m_insertionCount = tree.m_insertionCount;
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	// Build array of leaves. Free the rest.
@@ -21,9 +21,13 @@
 
 #include "Box2D/Collision/b2Collision.h"
 #include "Box2D/Common/b2GrowableStack.h"
+#include "Box2D/Common/b2StackAllocator.h"
 
 #define b2_nullNode (-1)
 
+/// Flatland: marks a leaf destroyed in bulk, in the child2 of the leaf.
+#define b2_destroyedNode (-2)
+
 /// A node in the dynamic tree. The client does not interact with this directly.
 struct b2TreeNode
 {
@@ -48,6 +52,63 @@ struct b2TreeNode
 
 	// leaf = 0, free node = -1
 	int32 height;
+
+	/// Flatland: the union of the category bits of the proxies in the
+	/// subtree, and the union over the proxies that are not sensors. They let
+	/// RayCastPacket skip the subtrees that no ray can hit.
+	uint32 categoryBits;
+	uint32 solidBits;
+
+	/// Set the filter bits of an internal node from its children.
+	void CombineFilter(const b2TreeNode& a, const b2TreeNode& b)
+	{
+		categoryBits = a.categoryBits | b.categoryBits;
+		solidBits = a.solidBits | b.solidBits;
+	}
+};
+
+/// Test if the segment p1 + t * (p2 - p1), t in [0, maxFraction], overlaps an AABB.
+inline bool b2TestSegmentOverlap(const b2AABB& aabb, const b2Vec2& p1, const b2Vec2& p2, float32 maxFraction)
+{
+	b2Vec2 d = p2 - p1;
+	float32 tmin = 0.0f;
+	float32 tmax = maxFraction;
+	for (int32 i = 0; i < 2; ++i)
+	{
+		if (b2Abs(d(i)) < b2_epsilon)
+		{
+			// Parallel to the slab.
+			if (p1(i) < aabb.lowerBound(i) || aabb.upperBound(i) < p1(i))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float32 inv_d = 1.0f / d(i);
+		float32 t1 = (aabb.lowerBound(i) - p1(i)) * inv_d;
+		float32 t2 = (aabb.upperBound(i) - p1(i)) * inv_d;
+		if (t1 > t2)
+		{
+			b2Swap(t1, t2);
+		}
+		tmin = b2Max(tmin, t1);
+		tmax = b2Min(tmax, t2);
+		if (tmin > tmax)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// A node of the traversal of b2DynamicTree::RayCastPacket, with the range of
+/// the rays overlapping its parent.
+struct b2PacketNode
+{
+	int32 nodeId;
+	int32 begin;
+	int32 end;
 };
 
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
@@ -68,16 +129,40 @@ public:
 	~b2DynamicTree();
 
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// If insert is false, the proxy is not part of the tree until it is
+	/// inserted with InsertProxy or by RebuildTopDown, so queries do not find
+	/// it. Such a proxy must not be moved or destroyed before.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool insert = true);
+
+	/// Insert a proxy created with insert set to false.
+	void InsertProxy(int32 proxyId);
+
+	/// Destroy a proxy. This asserts if the id is invalid. If remove is
+	/// false, the proxy is only marked as destroyed and loses its user data,
+	/// it stays in the tree until FreeDestroyedProxy or RebuildTopDown. This
+	/// saves the incremental rebalancing when destroying many proxies.
+	void DestroyProxy(int32 proxyId, bool remove = true);
+
+	/// Remove a proxy marked as destroyed from the tree and free it.
+	void FreeDestroyedProxy(int32 proxyId);
 
-	/// Destroy a proxy. This asserts if the id is invalid.
-	void DestroyProxy(int32 proxyId);
+	/// Check if a proxy is marked as destroyed.
+	bool IsDestroyed(int32 proxyId) const;
 
 	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
 	/// then the proxy is removed from the tree and re-inserted. Otherwise
 	/// the function returns immediately.
+	/// Flatland: the fattened AABB is extended by extension. With shrink, a
+	/// proxy whose fattened AABB is larger than the AABB extended by 4 times
+	/// extension is re-inserted as well, e.g. of a body that slowed down.
 	/// @return true if the proxy was re-inserted.
-	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement,
+				   float32 extension = b2_aabbExtension, bool shrink = false);
+
+	/// Set the category bits of a proxy and whether it is a sensor, for the
+	/// filtering of RayCastPacket. A proxy matches every mask until this is
+	/// called.
+	void SetProxyFilter(int32 proxyId, uint32 categoryBits, bool isSensor);
 
 	/// Get proxy user data.
 	/// @return the proxy user data or 0 if the id is invalid.
@@ -101,6 +186,23 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Ray-cast a packet of rays, e.g. the beams of a laser, in one traversal
+	/// of the tree. Each node is only tested against the rays that overlap its
+	/// parent. The callback is called once per overlapped leaf, with the rays
+	/// overlapping it:
+	/// void RayCastPacketCallback(int32 proxyId, const int32* rays, int32 rayCount)
+	/// It may lower the max fractions of these rays, which clips them for the
+	/// rest of the traversal.
+	/// @param inputs the rays, their maxFraction is not used.
+	/// @param maxFractions the max fraction of each ray.
+	/// @param count the number of rays.
+	/// @param maskBits the subtrees without a proxy in these categories are
+	/// skipped.
+	/// @param skipSensors the subtrees with only sensor proxies are skipped.
+	template <typename T>
+	void RayCastPacket(T* callback, const b2RayCastInput* inputs, const float32* maxFractions, int32 count,
+					   uint32 maskBits = 0xFFFFFFFF, bool skipSensors = false) const;
+
 	/// Validate this tree. For testing.
 	void Validate() const;
 
@@ -118,11 +220,25 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Build a balanced tree from the current proxies in O(n log n), by
+	/// splitting them at the median of their centers along the longest axis,
+	/// recursively. Meant for trees of proxies that rarely move, e.g. after
+	/// inserting many static proxies. The proxies not inserted yet are
+	/// inserted, the ones marked as destroyed are freed. The proxy ids do not
+	/// change.
+	void RebuildTopDown();
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Make this tree a copy of another one, with the same proxy ids.
+	void CopyFrom(const b2DynamicTree& tree);
+
+	/// Get the number of nodes the pool holds, all proxy ids are below it.
+	int32 GetNodeCapacity() const;
+
 private:
 
 	int32 AllocateNode();
@@ -131,6 +247,8 @@ private:
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
+	int32 BuildTopDown(int32* leaves, int32 count);
+
 	int32 Balance(int32 index);
 
 	int32 ComputeHeight() const;
@@ -165,6 +283,17 @@ inline const b2AABB& b2DynamicTree::GetFatAABB(int32 proxyId) const
 	return m_nodes[proxyId].aabb;
 }
 
+inline int32 b2DynamicTree::GetNodeCapacity() const
+{
+	return m_nodeCapacity;
+}
+
+inline bool b2DynamicTree::IsDestroyed(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	return m_nodes[proxyId].child2 == b2_destroyedNode;
+}
+
 template <typename T>
 inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 {
@@ -286,4 +415,93 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 	}
 }
 
+template <typename T>
+inline void b2DynamicTree::RayCastPacket(T* callback, const b2RayCastInput* inputs, const float32* maxFractions, int32 count,
+										 uint32 maskBits, bool skipSensors) const
+{
+	if (m_root == b2_nullNode || count <= 0)
+	{
+		return;
+	}
+
+	// The ray lists of the nodes on the stack. The traversal is depth first,
+	// so the lists are freed in the reverse order they are added: a node
+	// writes the rays overlapping it after the list of its parent, over the
+	// lists of the subtrees traversed before. They start on the stack
+	// allocator of the thread, and move to the heap if they outgrow it.
+	int32 capacity = 4 * count;
+	b2StackAllocator* allocator = b2GetThreadStackAllocator();
+	int32* stackRays = (int32*)allocator->Allocate(capacity * sizeof(int32));
+	int32* rays = stackRays;
+	for (int32 i = 0; i < count; ++i)
+	{
+		rays[i] = i;
+	}
+
+	b2GrowableStack<b2PacketNode, 256> stack;
+	b2PacketNode root = {m_root, 0, count};
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2PacketNode entry = stack.Pop();
+		const b2TreeNode* node = m_nodes + entry.nodeId;
+
+		// No proxy of the subtree passes the filter, skip it before the
+		// rays are tested.
+		uint32 bits = skipSensors ? node->solidBits : node->categoryBits;
+		if ((bits & maskBits) == 0)
+		{
+			continue;
+		}
+
+		int32 begin = entry.end;
+		if (capacity < begin + (entry.end - entry.begin))
+		{
+			int32* oldRays = rays;
+			capacity = 2 * (begin + (entry.end - entry.begin));
+			rays = (int32*)b2Alloc(capacity * sizeof(int32));
+			memcpy(rays, oldRays, begin * sizeof(int32));
+			if (oldRays != stackRays)
+			{
+				b2Free(oldRays);
+			}
+		}
+
+		int32 end = begin;
+		for (int32 i = entry.begin; i < entry.end; ++i)
+		{
+			int32 ray = rays[i];
+			if (b2TestSegmentOverlap(node->aabb, inputs[ray].p1, inputs[ray].p2, maxFractions[ray]))
+			{
+				rays[end] = ray;
+				++end;
+			}
+		}
+
+		if (end == begin)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			callback->RayCastPacketCallback(entry.nodeId, rays + begin, end - begin);
+		}
+		else
+		{
+			b2PacketNode child1 = {node->child1, begin, end};
+			b2PacketNode child2 = {node->child2, begin, end};
+			stack.Push(child1);
+			stack.Push(child2);
+		}
+	}
+
+	if (rays != stackRays)
+	{
+		b2Free(rays);
+	}
+	allocator->Free(stackRays);
+}
+
 #endif
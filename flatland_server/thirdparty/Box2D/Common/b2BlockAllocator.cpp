@@ -17,6 +17,7 @@
 */
 
 #include "Box2D/Common/b2BlockAllocator.h"
+#include "Box2D/Common/b2Math.h"
 #include <limits.h>
 #include <string.h>
 #include <stddef.h>
@@ -44,6 +45,7 @@ bool b2BlockAllocator::s_blockSizeLookupInitialized;
 struct b2Chunk
 {
 	int32 blockSize;
+	int32 size;
 	b2Block* blocks;
 };
 
@@ -63,6 +65,11 @@ b2BlockAllocator::b2BlockAllocator()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
 
+	SetChunkSize(b2_chunkSize, b2_chunkSize);
+	memset(m_blockCounts, 0, sizeof(m_blockCounts));
+	m_largeCount = 0;
+	m_largeBytes = 0;
+
 	if (s_blockSizeLookupInitialized == false)
 	{
 		int32 j = 0;
@@ -103,11 +110,14 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 	if (size > b2_maxBlockSize)
 	{
+		++m_largeCount;
+		m_largeBytes += size;
 		return b2Alloc(size);
 	}
 
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
+	++m_blockCounts[index];
 
 	if (m_freeLists[index])
 	{
@@ -119,23 +129,30 @@ void* b2BlockAllocator::Allocate(int32 size)
 	{
 		if (m_chunkCount == m_chunkSpace)
 		{
+			// Grow geometrically, the chunk array of millions of fixtures
+			// would be copied thousands of times otherwise.
 			b2Chunk* oldChunks = m_chunks;
-			m_chunkSpace += b2_chunkArrayIncrement;
+			int32 oldSpace = m_chunkSpace;
+			m_chunkSpace *= 2;
 			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
 			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
-			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
+			memset(m_chunks + m_chunkCount, 0, (m_chunkSpace - oldSpace) * sizeof(b2Chunk));
 			b2Free(oldChunks);
 		}
 
+		int32 chunkSize = m_nextChunkSizes[index];
+		m_nextChunkSizes[index] = b2Min(2 * chunkSize, m_maxChunkSize);
+
 		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		chunk->blocks = (b2Block*)b2Alloc(chunkSize);
+		chunk->size = chunkSize;
 #if defined(_DEBUG)
-		memset(chunk->blocks, 0xcd, b2_chunkSize);
+		memset(chunk->blocks, 0xcd, chunkSize);
 #endif
 		int32 blockSize = s_blockSizes[index];
 		chunk->blockSize = blockSize;
-		int32 blockCount = b2_chunkSize / blockSize;
-		b2Assert(blockCount * blockSize <= b2_chunkSize);
+		int32 blockCount = chunkSize / blockSize;
+		b2Assert(blockCount * blockSize <= chunkSize);
 		for (int32 i = 0; i < blockCount - 1; ++i)
 		{
 			b2Block* block = (b2Block*)((int8*)chunk->blocks + blockSize * i);
@@ -163,12 +180,15 @@ void b2BlockAllocator::Free(void* p, int32 size)
 
 	if (size > b2_maxBlockSize)
 	{
+		--m_largeCount;
+		m_largeBytes -= size;
 		b2Free(p);
 		return;
 	}
 
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
+	--m_blockCounts[index];
 
 #ifdef _DEBUG
 	// Verify the memory address and size is valid.
@@ -180,11 +200,11 @@ void b2BlockAllocator::Free(void* p, int32 size)
 		if (chunk->blockSize != blockSize)
 		{
 			b2Assert(	(int8*)p + blockSize <= (int8*)chunk->blocks ||
-						(int8*)chunk->blocks + b2_chunkSize <= (int8*)p);
+						(int8*)chunk->blocks + chunk->size <= (int8*)p);
 		}
 		else
 		{
-			if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + b2_chunkSize)
+			if ((int8*)chunk->blocks <= (int8*)p && (int8*)p + blockSize <= (int8*)chunk->blocks + chunk->size)
 			{
 				found = true;
 			}
@@ -212,4 +232,41 @@ void b2BlockAllocator::Clear()
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+
+	SetChunkSize(m_chunkSize, m_maxChunkSize);
+	memset(m_blockCounts, 0, sizeof(m_blockCounts));
+}
+
+void b2BlockAllocator::SetChunkSize(int32 chunkSize, int32 maxChunkSize)
+{
+	b2Assert(b2_maxBlockSize <= chunkSize && chunkSize <= maxChunkSize);
+	m_chunkSize = chunkSize;
+	m_maxChunkSize = maxChunkSize;
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		m_nextChunkSizes[i] = chunkSize;
+	}
+}
+
+b2BlockAllocatorStats b2BlockAllocator::GetStats() const
+{
+	b2BlockAllocatorStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.chunkCount = m_chunkCount;
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		stats.blockSizes[i] = s_blockSizes[i];
+		stats.classBlockCounts[i] = m_blockCounts[i];
+	}
+
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		const b2Chunk& chunk = m_chunks[i];
+		stats.chunkBytes += chunk.size;
+		stats.classChunkBytes[s_blockSizeLookup[chunk.blockSize]] += chunk.size;
+	}
+
+	stats.largeCount = m_largeCount;
+	stats.largeBytes = m_largeBytes;
+	return stats;
 }
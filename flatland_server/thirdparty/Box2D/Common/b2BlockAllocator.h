@@ -29,6 +29,25 @@ const int32 b2_chunkArrayIncrement = 128;
 struct b2Block;
 struct b2Chunk;
 
+/// Flatland: the memory held by a b2BlockAllocator.
+struct b2BlockAllocatorStats
+{
+	/// The chunks of all size classes.
+	int32 chunkCount;
+	size_t chunkBytes;
+
+	/// Per size class: the size of its blocks, the bytes of its chunks and
+	/// the number of blocks in use.
+	int32 blockSizes[b2_blockSizes];
+	size_t classChunkBytes[b2_blockSizes];
+	int32 classBlockCounts[b2_blockSizes];
+
+	/// The allocations in use larger than b2_maxBlockSize, these are passed
+	/// to b2Alloc.
+	int32 largeCount;
+	size_t largeBytes;
+};
+
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
@@ -46,6 +65,17 @@ public:
 
 	void Clear();
 
+	/// Flatland: set the size of the chunks allocated from now on. The first
+	/// new chunk of each size class has chunkSize bytes, each further one
+	/// twice the bytes of the previous one, up to maxChunkSize. Larger chunks
+	/// mean fewer calls to b2Alloc when creating millions of fixtures, e.g.
+	/// the edges of a large map, but more memory left unused in small worlds.
+	/// The default is b2_chunkSize for both.
+	void SetChunkSize(int32 chunkSize, int32 maxChunkSize);
+
+	/// Flatland: get the memory held by the allocator.
+	b2BlockAllocatorStats GetStats() const;
+
 private:
 
 	b2Chunk* m_chunks;
@@ -54,6 +84,14 @@ private:
 
 	b2Block* m_freeLists[b2_blockSizes];
 
+	int32 m_chunkSize;
+	int32 m_maxChunkSize;
+	int32 m_nextChunkSizes[b2_blockSizes];
+
+	int32 m_blockCounts[b2_blockSizes];
+	int32 m_largeCount;
+	size_t m_largeBytes;
+
 	static int32 s_blockSizes[b2_blockSizes];
 	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
 	static bool s_blockSizeLookupInitialized;
@@ -18,6 +18,40 @@
 
 #include "Box2D/Common/b2StackAllocator.h"
 #include "Box2D/Common/b2Math.h"
+#include <new>
+
+namespace
+{
+
+// Owns the stack allocator of a thread, it is heap allocated so that threads
+// never using it do not pay for its memory.
+struct b2ThreadStackAllocator
+{
+	~b2ThreadStackAllocator()
+	{
+		if (allocator != nullptr)
+		{
+			allocator->~b2StackAllocator();
+			b2Free(allocator);
+		}
+	}
+
+	b2StackAllocator* allocator = nullptr;
+};
+
+thread_local b2ThreadStackAllocator s_threadStackAllocator;
+
+}
+
+b2StackAllocator* b2GetThreadStackAllocator()
+{
+	if (s_threadStackAllocator.allocator == nullptr)
+	{
+		void* mem = b2Alloc(sizeof(b2StackAllocator));
+		s_threadStackAllocator.allocator = new (mem) b2StackAllocator;
+	}
+	return s_threadStackAllocator.allocator;
+}
 
 b2StackAllocator::b2StackAllocator()
 {
@@ -57,4 +57,11 @@ private:
 	int32 m_entryCount;
 };
 
+/// Flatland: get the stack allocator of the calling thread, created on first
+/// use and freed when the thread exits. It is meant for the temporary memory
+/// of queries running on several threads at once, e.g. b2World::RayCastBatch
+/// called by the sensor threads, since the one of the world is not thread
+/// safe.
+b2StackAllocator* b2GetThreadStackAllocator();
+
 #endif
@@ -42,8 +42,8 @@ private:
 	float64 m_start;
 	static float64 s_invFrequency;
 #elif defined(__linux__) || defined (__APPLE__)
-	unsigned long m_start_sec;
-	unsigned long m_start_usec;
+	long m_start_sec;
+	long m_start_usec;
 #endif
 };
 
@@ -189,6 +189,14 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	/// Compute the manifold of the current transforms into manifold, with the
+	/// impulses of the matching points of m_manifold, without changing this
+	/// contact. Returns whether the shapes touch. This may run on any thread.
+	bool ComputeManifold(b2Manifold* manifold);
+
+	/// Update with a manifold computed by ComputeManifold.
+	void Update(b2ContactListener* listener, const b2Manifold& manifold, bool touching);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
@@ -24,6 +24,13 @@
 #include "Box2D/Dynamics/b2World.h"
 #include "Box2D/Common/b2StackAllocator.h"
 
+#include <string.h>
+
+#if defined(B2_SIMD_CONTACT_SOLVER) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define B2_SIMD_SSE2 1
+#endif
+
 // Solver debugging is normally disabled because the block solver sometimes has to deal with a poorly conditioned effective mass matrix.
 #define B2_DEBUG_SOLVER 0
 
@@ -54,6 +61,10 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_wideConstraints = NULL;
+	m_wideCount = 0;
+	m_scalarConstraints = NULL;
+	m_scalarCount = 0;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -133,6 +144,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wideConstraints != NULL)
+	{
+		m_allocator->Free(m_scalarConstraints);
+		m_allocator->Free(m_wideConstraints);
+	}
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -247,6 +263,10 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+#if defined(B2_SIMD_CONTACT_SOLVER)
+	PrepareWideConstraints();
+#endif
 }
 
 void b2ContactSolver::WarmStart()
@@ -291,8 +311,21 @@ void b2ContactSolver::WarmStart()
 
 void b2ContactSolver::SolveVelocityConstraints()
 {
-	for (int32 i = 0; i < m_count; ++i)
+	const int32* indices = NULL;
+	int32 count = m_count;
+
+#if defined(B2_SIMD_CONTACT_SOLVER)
+	if (m_wideConstraints != NULL)
 	{
+		SolveWideVelocityConstraints();
+		indices = m_scalarConstraints;
+		count = m_scalarCount;
+	}
+#endif
+
+	for (int32 n = 0; n < count; ++n)
+	{
+		int32 i = indices != NULL ? indices[n] : n;
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
 
 		int32 indexA = vc->indexA;
@@ -601,6 +634,472 @@ void b2ContactSolver::SolveVelocityConstraints()
 	}
 }
 
+#if defined(B2_SIMD_CONTACT_SOLVER)
+
+// Number of constraints solved together.
+#define b2_contactLanes 4
+
+// Number of batches being filled at the same time while packing.
+#define b2_openBatches 32
+
+#if defined(B2_SIMD_SSE2)
+
+typedef __m128 b2FloatW;
+
+inline b2FloatW b2LoadW(const float32* p) { return _mm_loadu_ps(p); }
+inline void b2StoreW(float32* p, b2FloatW a) { _mm_storeu_ps(p, a); }
+inline b2FloatW b2ZeroW() { return _mm_setzero_ps(); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm_max_ps(a, b); }
+
+// All bits set in the lanes where a >= b.
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm_cmpge_ps(a, b); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm_and_ps(a, b); }
+
+// b in the lanes set in mask, a elsewhere.
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask)
+{
+	return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+#else
+
+// Portable fallback with the same lane layout, used where SSE2 is missing.
+struct b2FloatW
+{
+	float32 v[b2_contactLanes];
+};
+
+inline b2FloatW b2LoadW(const float32* p)
+{
+	b2FloatW r;
+	for (int32 l = 0; l < b2_contactLanes; ++l) r.v[l] = p[l];
+	return r;
+}
+
+inline void b2StoreW(float32* p, b2FloatW a)
+{
+	for (int32 l = 0; l < b2_contactLanes; ++l) p[l] = a.v[l];
+}
+
+inline b2FloatW b2ZeroW()
+{
+	b2FloatW r;
+	for (int32 l = 0; l < b2_contactLanes; ++l) r.v[l] = 0.0f;
+	return r;
+}
+
+#define B2_LANEWISE(name, expr) \
+	inline b2FloatW name(b2FloatW a, b2FloatW b) \
+	{ \
+		b2FloatW r; \
+		for (int32 l = 0; l < b2_contactLanes; ++l) r.v[l] = (expr); \
+		return r; \
+	}
+
+B2_LANEWISE(b2AddW, a.v[l] + b.v[l])
+B2_LANEWISE(b2SubW, a.v[l] - b.v[l])
+B2_LANEWISE(b2MulW, a.v[l] * b.v[l])
+B2_LANEWISE(b2MinW, a.v[l] < b.v[l] ? a.v[l] : b.v[l])
+B2_LANEWISE(b2MaxW, a.v[l] > b.v[l] ? a.v[l] : b.v[l])
+
+// Masks hold 1 in the set lanes and 0 elsewhere.
+B2_LANEWISE(b2GreaterEqualW, a.v[l] >= b.v[l] ? 1.0f : 0.0f)
+B2_LANEWISE(b2AndW, a.v[l] * b.v[l])
+
+#undef B2_LANEWISE
+
+inline b2FloatW b2BlendW(b2FloatW a, b2FloatW b, b2FloatW mask)
+{
+	b2FloatW r;
+	for (int32 l = 0; l < b2_contactLanes; ++l) r.v[l] = mask.v[l] != 0.0f ? b.v[l] : a.v[l];
+	return r;
+}
+
+#endif
+
+struct b2ContactPointW
+{
+	float32 rAx[b2_contactLanes], rAy[b2_contactLanes];
+	float32 rBx[b2_contactLanes], rBy[b2_contactLanes];
+	float32 normalImpulse[b2_contactLanes];
+	float32 tangentImpulse[b2_contactLanes];
+	float32 normalMass[b2_contactLanes];
+	float32 tangentMass[b2_contactLanes];
+	float32 velocityBias[b2_contactLanes];
+};
+
+// Structure of arrays over up to b2_contactLanes velocity constraints with the
+// same point count. Unused lanes are zero, which makes all their impulses zero.
+struct b2ContactConstraintW
+{
+	b2ContactPointW points[b2_maxManifoldPoints];
+	float32 normalX[b2_contactLanes], normalY[b2_contactLanes];
+	float32 kExX[b2_contactLanes], kExY[b2_contactLanes];
+	float32 kEyX[b2_contactLanes], kEyY[b2_contactLanes];
+	float32 massExX[b2_contactLanes], massExY[b2_contactLanes];
+	float32 massEyX[b2_contactLanes], massEyY[b2_contactLanes];
+	float32 invMassA[b2_contactLanes], invIA[b2_contactLanes];
+	float32 invMassB[b2_contactLanes], invIB[b2_contactLanes];
+	float32 friction[b2_contactLanes];
+	float32 tangentSpeed[b2_contactLanes];
+	int32 constraints[b2_contactLanes];
+	int32 laneCount;
+	int32 pointCount;
+};
+
+// Bodies that no constraint can move may be shared by the lanes of a batch.
+inline bool b2IsFixed(float32 invMass, float32 invI)
+{
+	return invMass == 0.0f && invI == 0.0f;
+}
+
+static void b2AddLane(b2ContactConstraintW* c, const b2ContactVelocityConstraint* vc, int32 index)
+{
+	int32 l = c->laneCount++;
+	c->constraints[l] = index;
+	c->pointCount = vc->pointCount;
+	c->normalX[l] = vc->normal.x;
+	c->normalY[l] = vc->normal.y;
+	if (vc->pointCount == 2 && g_blockSolve)
+	{
+		c->kExX[l] = vc->K.ex.x;
+		c->kExY[l] = vc->K.ex.y;
+		c->kEyX[l] = vc->K.ey.x;
+		c->kEyY[l] = vc->K.ey.y;
+		c->massExX[l] = vc->normalMass.ex.x;
+		c->massExY[l] = vc->normalMass.ex.y;
+		c->massEyX[l] = vc->normalMass.ey.x;
+		c->massEyY[l] = vc->normalMass.ey.y;
+	}
+	c->invMassA[l] = vc->invMassA;
+	c->invIA[l] = vc->invIA;
+	c->invMassB[l] = vc->invMassB;
+	c->invIB[l] = vc->invIB;
+	c->friction[l] = vc->friction;
+	c->tangentSpeed[l] = vc->tangentSpeed;
+
+	for (int32 j = 0; j < vc->pointCount; ++j)
+	{
+		const b2VelocityConstraintPoint* vcp = vc->points + j;
+		b2ContactPointW* cp = c->points + j;
+		cp->rAx[l] = vcp->rA.x;
+		cp->rAy[l] = vcp->rA.y;
+		cp->rBx[l] = vcp->rB.x;
+		cp->rBy[l] = vcp->rB.y;
+		cp->normalImpulse[l] = vcp->normalImpulse;
+		cp->tangentImpulse[l] = vcp->tangentImpulse;
+		cp->normalMass[l] = vcp->normalMass;
+		cp->tangentMass[l] = vcp->tangentMass;
+		cp->velocityBias[l] = vcp->velocityBias;
+	}
+}
+
+// Greedy colouring in constraint order: each constraint goes to the first open
+// batch with its point count that does not touch its bodies. A batch is closed
+// once all its lanes are used. The result only depends on the constraint order,
+// so a replay packs the same batches.
+void b2ContactSolver::PrepareWideConstraints()
+{
+	if (m_count == 0)
+	{
+		return;
+	}
+
+	int32 bodyCount = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bodyCount = b2Max(bodyCount, b2Max(vc->indexA, vc->indexB) + 1);
+	}
+
+	int32 capacity = (m_count + b2_contactLanes - 1) / b2_contactLanes + b2_openBatches;
+	m_wideConstraints = (b2ContactConstraintW*)m_allocator->Allocate(capacity * sizeof(b2ContactConstraintW));
+	m_scalarConstraints = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	memset(m_wideConstraints, 0, capacity * sizeof(b2ContactConstraintW));
+
+	// Bit s of a body is set while the open batch s has a lane on it.
+	uint32* bodyBatches = (uint32*)m_allocator->Allocate(bodyCount * sizeof(uint32));
+	memset(bodyBatches, 0, bodyCount * sizeof(uint32));
+	int32 openBatches[b2_openBatches];
+	uint32 openMask = 0;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bool fixedA = b2IsFixed(vc->invMassA, vc->invIA);
+		bool fixedB = b2IsFixed(vc->invMassB, vc->invIB);
+		uint32 used = (fixedA ? 0 : bodyBatches[vc->indexA]) | (fixedB ? 0 : bodyBatches[vc->indexB]);
+
+		int32 slot = -1;
+		for (int32 s = 0; s < b2_openBatches; ++s)
+		{
+			uint32 bit = 1u << s;
+			if ((openMask & bit) == 0)
+			{
+				if (slot == -1)
+				{
+					slot = s;
+				}
+			}
+			else if ((used & bit) == 0 && m_wideConstraints[openBatches[s]].pointCount == vc->pointCount)
+			{
+				slot = s;
+				break;
+			}
+		}
+
+		if (slot == -1)
+		{
+			m_scalarConstraints[m_scalarCount++] = i;
+			continue;
+		}
+
+		uint32 bit = 1u << slot;
+		if ((openMask & bit) == 0)
+		{
+			openBatches[slot] = m_wideCount++;
+			openMask |= bit;
+		}
+
+		b2ContactConstraintW* c = m_wideConstraints + openBatches[slot];
+		b2AddLane(c, vc, i);
+		if (fixedA == false)
+		{
+			bodyBatches[vc->indexA] |= bit;
+		}
+		if (fixedB == false)
+		{
+			bodyBatches[vc->indexB] |= bit;
+		}
+
+		if (c->laneCount == b2_contactLanes)
+		{
+			for (int32 l = 0; l < b2_contactLanes; ++l)
+			{
+				const b2ContactVelocityConstraint* lane = m_velocityConstraints + c->constraints[l];
+				bodyBatches[lane->indexA] &= ~bit;
+				bodyBatches[lane->indexB] &= ~bit;
+			}
+			openMask &= ~bit;
+		}
+	}
+
+	m_allocator->Free(bodyBatches);
+}
+
+// Same steps as the scalar solver below, on all lanes of a batch at once.
+static void b2SolveWide(b2ContactConstraintW* c, b2Velocity* velocities, b2ContactVelocityConstraint* constraints)
+{
+	float32 vAx[b2_contactLanes] = {}, vAy[b2_contactLanes] = {}, wAs[b2_contactLanes] = {};
+	float32 vBx[b2_contactLanes] = {}, vBy[b2_contactLanes] = {}, wBs[b2_contactLanes] = {};
+	for (int32 l = 0; l < c->laneCount; ++l)
+	{
+		const b2ContactVelocityConstraint* vc = constraints + c->constraints[l];
+		const b2Velocity& a = velocities[vc->indexA];
+		const b2Velocity& b = velocities[vc->indexB];
+		vAx[l] = a.v.x;
+		vAy[l] = a.v.y;
+		wAs[l] = a.w;
+		vBx[l] = b.v.x;
+		vBy[l] = b.v.y;
+		wBs[l] = b.w;
+	}
+
+	b2FloatW vA_x = b2LoadW(vAx), vA_y = b2LoadW(vAy), wA = b2LoadW(wAs);
+	b2FloatW vB_x = b2LoadW(vBx), vB_y = b2LoadW(vBy), wB = b2LoadW(wBs);
+	b2FloatW mA = b2LoadW(c->invMassA), iA = b2LoadW(c->invIA);
+	b2FloatW mB = b2LoadW(c->invMassB), iB = b2LoadW(c->invIB);
+	b2FloatW nx = b2LoadW(c->normalX), ny = b2LoadW(c->normalY);
+	b2FloatW zero = b2ZeroW();
+
+	// tangent = b2Cross(normal, 1.0f)
+	b2FloatW tx = ny, ty = b2SubW(zero, nx);
+	b2FloatW friction = b2LoadW(c->friction);
+	b2FloatW tangentSpeed = b2LoadW(c->tangentSpeed);
+	int32 pointCount = c->pointCount;
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2ContactPointW* cp = c->points + j;
+		b2FloatW rAx = b2LoadW(cp->rAx), rAy = b2LoadW(cp->rAy);
+		b2FloatW rBx = b2LoadW(cp->rBx), rBy = b2LoadW(cp->rBy);
+
+		// dv = vB + b2Cross(wB, rB) - vA - b2Cross(wA, rA)
+		b2FloatW dvx = b2AddW(b2SubW(b2SubW(vB_x, b2MulW(wB, rBy)), vA_x), b2MulW(wA, rAy));
+		b2FloatW dvy = b2SubW(b2SubW(b2AddW(vB_y, b2MulW(wB, rBx)), vA_y), b2MulW(wA, rAx));
+
+		b2FloatW vt = b2SubW(b2AddW(b2MulW(dvx, tx), b2MulW(dvy, ty)), tangentSpeed);
+		b2FloatW lambda = b2MulW(b2LoadW(cp->tangentMass), b2SubW(zero, vt));
+
+		b2FloatW oldImpulse = b2LoadW(cp->tangentImpulse);
+		b2FloatW maxFriction = b2MulW(friction, b2LoadW(cp->normalImpulse));
+		b2FloatW newImpulse = b2MaxW(b2SubW(zero, maxFriction), b2MinW(b2AddW(oldImpulse, lambda), maxFriction));
+		lambda = b2SubW(newImpulse, oldImpulse);
+		b2StoreW(cp->tangentImpulse, newImpulse);
+
+		b2FloatW Px = b2MulW(lambda, tx), Py = b2MulW(lambda, ty);
+		vA_x = b2SubW(vA_x, b2MulW(mA, Px));
+		vA_y = b2SubW(vA_y, b2MulW(mA, Py));
+		wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx, Py), b2MulW(rAy, Px))));
+		vB_x = b2AddW(vB_x, b2MulW(mB, Px));
+		vB_y = b2AddW(vB_y, b2MulW(mB, Py));
+		wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx, Py), b2MulW(rBy, Px))));
+	}
+
+	if (pointCount == 1 || g_blockSolve == false)
+	{
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2ContactPointW* cp = c->points + j;
+			b2FloatW rAx = b2LoadW(cp->rAx), rAy = b2LoadW(cp->rAy);
+			b2FloatW rBx = b2LoadW(cp->rBx), rBy = b2LoadW(cp->rBy);
+
+			b2FloatW dvx = b2AddW(b2SubW(b2SubW(vB_x, b2MulW(wB, rBy)), vA_x), b2MulW(wA, rAy));
+			b2FloatW dvy = b2SubW(b2SubW(b2AddW(vB_y, b2MulW(wB, rBx)), vA_y), b2MulW(wA, rAx));
+
+			b2FloatW vn = b2AddW(b2MulW(dvx, nx), b2MulW(dvy, ny));
+			b2FloatW lambda = b2MulW(b2SubW(zero, b2LoadW(cp->normalMass)), b2SubW(vn, b2LoadW(cp->velocityBias)));
+
+			b2FloatW oldImpulse = b2LoadW(cp->normalImpulse);
+			b2FloatW newImpulse = b2MaxW(b2AddW(oldImpulse, lambda), zero);
+			lambda = b2SubW(newImpulse, oldImpulse);
+			b2StoreW(cp->normalImpulse, newImpulse);
+
+			b2FloatW Px = b2MulW(lambda, nx), Py = b2MulW(lambda, ny);
+			vA_x = b2SubW(vA_x, b2MulW(mA, Px));
+			vA_y = b2SubW(vA_y, b2MulW(mA, Py));
+			wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx, Py), b2MulW(rAy, Px))));
+			vB_x = b2AddW(vB_x, b2MulW(mB, Px));
+			vB_y = b2AddW(vB_y, b2MulW(mB, Py));
+			wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx, Py), b2MulW(rBy, Px))));
+		}
+	}
+	else
+	{
+		// Block solver, see the scalar version for the derivation. All four
+		// cases are evaluated and the first valid one is kept per lane. Lanes
+		// without a solution keep their impulses.
+		b2ContactPointW* cp1 = c->points + 0;
+		b2ContactPointW* cp2 = c->points + 1;
+		b2FloatW r1Ax = b2LoadW(cp1->rAx), r1Ay = b2LoadW(cp1->rAy);
+		b2FloatW r1Bx = b2LoadW(cp1->rBx), r1By = b2LoadW(cp1->rBy);
+		b2FloatW r2Ax = b2LoadW(cp2->rAx), r2Ay = b2LoadW(cp2->rAy);
+		b2FloatW r2Bx = b2LoadW(cp2->rBx), r2By = b2LoadW(cp2->rBy);
+
+		b2FloatW ax = b2LoadW(cp1->normalImpulse), ay = b2LoadW(cp2->normalImpulse);
+
+		b2FloatW dv1x = b2AddW(b2SubW(b2SubW(vB_x, b2MulW(wB, r1By)), vA_x), b2MulW(wA, r1Ay));
+		b2FloatW dv1y = b2SubW(b2SubW(b2AddW(vB_y, b2MulW(wB, r1Bx)), vA_y), b2MulW(wA, r1Ax));
+		b2FloatW dv2x = b2AddW(b2SubW(b2SubW(vB_x, b2MulW(wB, r2By)), vA_x), b2MulW(wA, r2Ay));
+		b2FloatW dv2y = b2SubW(b2SubW(b2AddW(vB_y, b2MulW(wB, r2Bx)), vA_y), b2MulW(wA, r2Ax));
+
+		b2FloatW vn1 = b2AddW(b2MulW(dv1x, nx), b2MulW(dv1y, ny));
+		b2FloatW vn2 = b2AddW(b2MulW(dv2x, nx), b2MulW(dv2y, ny));
+
+		// b' = b - K * a
+		b2FloatW kExX = b2LoadW(c->kExX), kExY = b2LoadW(c->kExY);
+		b2FloatW kEyX = b2LoadW(c->kEyX), kEyY = b2LoadW(c->kEyY);
+		b2FloatW bx = b2SubW(vn1, b2LoadW(cp1->velocityBias));
+		b2FloatW by = b2SubW(vn2, b2LoadW(cp2->velocityBias));
+		bx = b2SubW(bx, b2AddW(b2MulW(kExX, ax), b2MulW(kEyX, ay)));
+		by = b2SubW(by, b2AddW(b2MulW(kExY, ax), b2MulW(kEyY, ay)));
+
+		// Case 4: x1 = 0 and x2 = 0
+		b2FloatW xx = ax, xy = ay;
+		b2FloatW mask = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+		xx = b2BlendW(xx, zero, mask);
+		xy = b2BlendW(xy, zero, mask);
+
+		// Case 3: vn2 = 0 and x1 = 0
+		b2FloatW x2 = b2MulW(b2SubW(zero, b2LoadW(cp2->normalMass)), by);
+		b2FloatW v1 = b2AddW(b2MulW(kEyX, x2), bx);
+		mask = b2AndW(b2GreaterEqualW(x2, zero), b2GreaterEqualW(v1, zero));
+		xx = b2BlendW(xx, zero, mask);
+		xy = b2BlendW(xy, x2, mask);
+
+		// Case 2: vn1 = 0 and x2 = 0
+		b2FloatW x1 = b2MulW(b2SubW(zero, b2LoadW(cp1->normalMass)), bx);
+		b2FloatW v2 = b2AddW(b2MulW(kExY, x1), by);
+		mask = b2AndW(b2GreaterEqualW(x1, zero), b2GreaterEqualW(v2, zero));
+		xx = b2BlendW(xx, x1, mask);
+		xy = b2BlendW(xy, zero, mask);
+
+		// Case 1: vn = 0
+		x1 = b2SubW(zero, b2AddW(b2MulW(b2LoadW(c->massExX), bx), b2MulW(b2LoadW(c->massEyX), by)));
+		x2 = b2SubW(zero, b2AddW(b2MulW(b2LoadW(c->massExY), bx), b2MulW(b2LoadW(c->massEyY), by)));
+		mask = b2AndW(b2GreaterEqualW(x1, zero), b2GreaterEqualW(x2, zero));
+		xx = b2BlendW(xx, x1, mask);
+		xy = b2BlendW(xy, x2, mask);
+
+		// Apply the incremental impulse
+		b2FloatW dx = b2SubW(xx, ax), dy = b2SubW(xy, ay);
+		b2FloatW P1x = b2MulW(dx, nx), P1y = b2MulW(dx, ny);
+		b2FloatW P2x = b2MulW(dy, nx), P2y = b2MulW(dy, ny);
+		b2FloatW Px = b2AddW(P1x, P2x), Py = b2AddW(P1y, P2y);
+
+		vA_x = b2SubW(vA_x, b2MulW(mA, Px));
+		vA_y = b2SubW(vA_y, b2MulW(mA, Py));
+		wA = b2SubW(wA, b2MulW(iA, b2AddW(
+			b2SubW(b2MulW(r1Ax, P1y), b2MulW(r1Ay, P1x)),
+			b2SubW(b2MulW(r2Ax, P2y), b2MulW(r2Ay, P2x)))));
+
+		vB_x = b2AddW(vB_x, b2MulW(mB, Px));
+		vB_y = b2AddW(vB_y, b2MulW(mB, Py));
+		wB = b2AddW(wB, b2MulW(iB, b2AddW(
+			b2SubW(b2MulW(r1Bx, P1y), b2MulW(r1By, P1x)),
+			b2SubW(b2MulW(r2Bx, P2y), b2MulW(r2By, P2x)))));
+
+		b2StoreW(cp1->normalImpulse, xx);
+		b2StoreW(cp2->normalImpulse, xy);
+	}
+
+	b2StoreW(vAx, vA_x);
+	b2StoreW(vAy, vA_y);
+	b2StoreW(wAs, wA);
+	b2StoreW(vBx, vB_x);
+	b2StoreW(vBy, vB_y);
+	b2StoreW(wBs, wB);
+
+	// Lanes may share a fixed body, which is never written back.
+	for (int32 l = 0; l < c->laneCount; ++l)
+	{
+		b2ContactVelocityConstraint* vc = constraints + c->constraints[l];
+		if (b2IsFixed(vc->invMassA, vc->invIA) == false)
+		{
+			velocities[vc->indexA].v.Set(vAx[l], vAy[l]);
+			velocities[vc->indexA].w = wAs[l];
+		}
+		if (b2IsFixed(vc->invMassB, vc->invIB) == false)
+		{
+			velocities[vc->indexB].v.Set(vBx[l], vBy[l]);
+			velocities[vc->indexB].w = wBs[l];
+		}
+
+		// Keep the impulses visible to StoreImpulses and the contact listener.
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			vc->points[j].normalImpulse = c->points[j].normalImpulse[l];
+			vc->points[j].tangentImpulse = c->points[j].tangentImpulse[l];
+		}
+	}
+}
+
+void b2ContactSolver::SolveWideVelocityConstraints()
+{
+	for (int32 i = 0; i < m_wideCount; ++i)
+	{
+		b2SolveWide(m_wideConstraints + i, m_velocities, m_velocityConstraints);
+	}
+}
+
+#endif
+
 void b2ContactSolver::StoreImpulses()
 {
 	for (int32 i = 0; i < m_count; ++i)
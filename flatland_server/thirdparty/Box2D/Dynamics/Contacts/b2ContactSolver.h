@@ -27,6 +27,7 @@ class b2Contact;
 class b2Body;
 class b2StackAllocator;
 struct b2ContactPositionConstraint;
+struct b2ContactConstraintW;
 
 struct b2VelocityConstraintPoint
 {
@@ -81,6 +82,11 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	/// Batch the velocity constraints into SIMD lanes. Only compiled with
+	/// B2_SIMD_CONTACT_SOLVER.
+	void PrepareWideConstraints();
+	void SolveWideVelocityConstraints();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -89,6 +95,14 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+
+	// Constraints batched four at a time so that no two lanes of a batch share
+	// a body that can move. The constraints that did not fit in a batch are
+	// solved one by one after the batches.
+	b2ContactConstraintW* m_wideConstraints;
+	int32 m_wideCount;
+	int32* m_scalarConstraints;
+	int32 m_scalarCount;
 };
 
 #endif
@@ -83,6 +83,9 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 
 	m_sleepTime = 0.0f;
 
+	m_aabbExtension = b2_aabbExtension;
+	m_averageSpeed = 0.0f;
+
 	m_type = bd->type;
 
 	if (m_type == b2_dynamicBody)
@@ -123,6 +126,9 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	// Flatland: the proxies of static bodies are in the static tree of the
+	// broad-phase, move them when the body becomes or stops being static.
+	bool moveTree = (m_type == b2_staticBody) != (type == b2_staticBody);
 	m_type = type;
 
 	ResetMassData();
@@ -155,6 +161,14 @@ void b2Body::SetType(b2BodyType type)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
+		if (moveTree && f->m_proxyCount > 0)
+		{
+			// Recreated proxies are buffered like touched ones.
+			f->DestroyProxies(broadPhase);
+			f->CreateProxies(broadPhase, m_xf);
+			continue;
+		}
+
 		int32 proxyCount = f->m_proxyCount;
 		for (int32 i = 0; i < proxyCount; ++i)
 		{
@@ -163,6 +177,34 @@ void b2Body::SetType(b2BodyType type)
 	}
 }
 
+// The world counts the bodies with their own continuous collision, to skip
+// the TOI events when there are none and it is disabled for the world.
+void b2Body::SetBullet(bool flag)
+{
+	SetContinuousFlag(e_bulletFlag, flag);
+}
+
+void b2Body::SetContinuous(bool flag)
+{
+	SetContinuousFlag(e_continuousFlag, flag);
+}
+
+void b2Body::SetContinuousFlag(uint16 flag, bool set)
+{
+	const uint16 continuous = e_bulletFlag | e_continuousFlag;
+	bool wasContinuous = (m_flags & continuous) != 0;
+	if (set)
+	{
+		m_flags |= flag;
+	}
+	else
+	{
+		m_flags &= ~flag;
+	}
+	bool isContinuous = (m_flags & continuous) != 0;
+	m_world->m_continuousBodyCount += int32(isContinuous) - int32(wasContinuous);
+}
+
 b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 {
 	b2Assert(m_world->IsLocked() == false);
@@ -439,7 +481,7 @@ void b2Body::SetTransform(const b2Vec2& position, float32 angle)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
-		f->Synchronize(broadPhase, m_xf, m_xf);
+		f->Synchronize(broadPhase, m_xf, m_xf, m_aabbExtension, m_world->m_adaptiveAABB.enabled);
 	}
 }
 
@@ -452,7 +494,7 @@ void b2Body::SynchronizeFixtures()
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
-		f->Synchronize(broadPhase, xf1, m_xf);
+		f->Synchronize(broadPhase, xf1, m_xf, m_aabbExtension, m_world->m_adaptiveAABB.enabled);
 	}
 }
 
@@ -317,6 +317,24 @@ public:
 	/// Is this body treated like a bullet for continuous collision detection?
 	bool IsBullet() const;
 
+	/// Should this body keep continuous collision detection against static
+	/// and kinematic bodies when it is disabled for the whole world (see
+	/// b2World::SetContinuousPhysics)? Bullets always keep it.
+	void SetContinuous(bool flag);
+
+	/// Does this body keep continuous collision detection on its own?
+	bool IsContinuous() const;
+
+	/// Should this body bypass the constraint solver? Such a body is moved by
+	/// its velocity alone at the end of each step. It keeps its fixtures in
+	/// the broad-phase, so it still reports contacts and shows up in queries
+	/// and ray casts, but nothing ever pushes it or is pushed by it.
+	/// Joints attached to it are not solved.
+	void SetSolverBypassed(bool flag);
+
+	/// Is this body moved outside the constraint solver?
+	bool IsSolverBypassed() const;
+
 	/// You can disable sleeping on this body. If you disable sleeping, the
 	/// body will be woken.
 	void SetSleepingAllowed(bool flag);
@@ -418,12 +436,16 @@ private:
 		e_bulletFlag		= 0x0008,
 		e_fixedRotationFlag	= 0x0010,
 		e_activeFlag		= 0x0020,
-		e_toiFlag			= 0x0040
+		e_toiFlag			= 0x0040,
+		e_bypassFlag		= 0x0080,
+		e_continuousFlag	= 0x0100
 	};
 
 	b2Body(const b2BodyDef* bd, b2World* world);
 	~b2Body();
 
+	void SetContinuousFlag(uint16 flag, bool set);
+
 	void SynchronizeFixtures();
 	void SynchronizeTransform();
 
@@ -469,6 +491,11 @@ private:
 
 	float32 m_sleepTime;
 
+	// Flatland: the margin of the fat AABBs of the fixtures and the average
+	// speed it is computed from, see b2AdaptiveAABB.
+	float32 m_aabbExtension;
+	float32 m_averageSpeed;
+
 	void* m_userData;
 };
 
@@ -619,21 +646,31 @@ inline void b2Body::SetGravityScale(float32 scale)
 	m_gravityScale = scale;
 }
 
-inline void b2Body::SetBullet(bool flag)
+inline bool b2Body::IsBullet() const
+{
+	return (m_flags & e_bulletFlag) == e_bulletFlag;
+}
+
+inline bool b2Body::IsContinuous() const
+{
+	return (m_flags & e_continuousFlag) == e_continuousFlag;
+}
+
+inline void b2Body::SetSolverBypassed(bool flag)
 {
 	if (flag)
 	{
-		m_flags |= e_bulletFlag;
+		m_flags |= e_bypassFlag;
 	}
 	else
 	{
-		m_flags &= ~e_bulletFlag;
+		m_flags &= ~e_bypassFlag;
 	}
 }
 
-inline bool b2Body::IsBullet() const
+inline bool b2Body::IsSolverBypassed() const
 {
-	return (m_flags & e_bulletFlag) == e_bulletFlag;
+	return (m_flags & e_bypassFlag) == e_bypassFlag;
 }
 
 inline void b2Body::SetAwake(bool flag)
@@ -22,9 +22,42 @@
 #include "Box2D/Dynamics/b2WorldCallbacks.h"
 #include "Box2D/Dynamics/Contacts/b2Contact.h"
 
+#include <vector>
+
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
 
+// Minimum number of contacts for Collide to run on the task executor.
+const int32 b2_minParallelContacts = 64;
+
+// Number of contacts evaluated by each task of the parallel narrowphase.
+const int32 b2_narrowPhaseTaskSize = 32;
+
+// The manifolds computed ahead by the parallel narrowphase of Collide.
+// Evaluating a contact only reads its fixtures, its previous manifold and
+// the body transforms, none of which change before the contact is updated.
+struct b2NarrowPhase
+{
+	struct Result
+	{
+		b2Manifold manifold;
+		bool touching;
+		bool evaluated;
+	};
+
+	b2ContactManager* manager;
+	std::vector<b2Contact*> contacts;
+	std::vector<Result> results;
+};
+
+static void b2EvaluateContacts(void* context, int32 index)
+{
+	b2NarrowPhase* narrowPhase = static_cast<b2NarrowPhase*>(context);
+	int32 begin = index * b2_narrowPhaseTaskSize;
+	int32 end = b2Min(begin + b2_narrowPhaseTaskSize, int32(narrowPhase->contacts.size()));
+	narrowPhase->manager->EvaluateContacts(begin, end);
+}
+
 b2ContactManager::b2ContactManager()
 {
 	m_contactList = nullptr;
@@ -32,6 +65,13 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = nullptr;
+	m_taskExecutor = nullptr;
+	m_narrowPhase = nullptr;
+}
+
+b2ContactManager::~b2ContactManager()
+{
+	delete m_narrowPhase;
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -102,12 +142,75 @@ void b2ContactManager::Destroy(b2Contact* c)
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
+// Compute the manifolds of the contacts [begin, end) of the narrowphase that
+// Collide will update, unless a body is woken up in between.
+void b2ContactManager::EvaluateContacts(int32 begin, int32 end)
+{
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2Contact* c = m_narrowPhase->contacts[i];
+		b2NarrowPhase::Result& r = m_narrowPhase->results[i];
+		r.evaluated = false;
+
+		b2Fixture* fixtureA = c->GetFixtureA();
+		b2Fixture* fixtureB = c->GetFixtureB();
+		b2Body* bodyA = fixtureA->GetBody();
+		b2Body* bodyB = fixtureB->GetBody();
+		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+		if (activeA == false && activeB == false)
+		{
+			continue;
+		}
+
+		int32 proxyIdA = fixtureA->m_proxies[c->GetChildIndexA()].proxyId;
+		int32 proxyIdB = fixtureB->m_proxies[c->GetChildIndexB()].proxyId;
+		if (m_broadPhase.TestOverlap(proxyIdA, proxyIdB) == false)
+		{
+			continue;
+		}
+
+		r.touching = c->ComputeManifold(&r.manifold);
+		r.evaluated = true;
+	}
+}
+
+// With a task executor, the manifolds of the contacts are computed on all its
+// threads first. The contacts are then updated one after the other as without
+// it, using the precomputed manifolds, so the touching transitions and the
+// listener calls happen in the same order. A contact whose body was woken up
+// by a contact before it in the list is evaluated in this second pass.
 void b2ContactManager::Collide()
 {
-	// Update awake contacts.
+	b2NarrowPhase* narrowPhase = nullptr;
+	if (m_taskExecutor != nullptr && m_taskExecutor->GetThreadCount() > 1 &&
+		m_contactCount >= b2_minParallelContacts)
+	{
+		if (m_narrowPhase == nullptr)
+		{
+			m_narrowPhase = new b2NarrowPhase;
+		}
+		narrowPhase = m_narrowPhase;
+		narrowPhase->manager = this;
+		narrowPhase->contacts.clear();
+		for (b2Contact* c = m_contactList; c; c = c->GetNext())
+		{
+			narrowPhase->contacts.push_back(c);
+		}
+		narrowPhase->results.resize(narrowPhase->contacts.size());
+
+		int32 count = int32(narrowPhase->contacts.size());
+		int32 taskCount = (count + b2_narrowPhaseTaskSize - 1) / b2_narrowPhaseTaskSize;
+		m_taskExecutor->ParallelFor(b2EvaluateContacts, narrowPhase, taskCount);
+	}
+
+	// Update awake contacts. The callbacks cannot destroy contacts, so the
+	// list is in the same order as the precomputed contacts.
+	int32 index = -1;
 	b2Contact* c = m_contactList;
 	while (c)
 	{
+		++index;
 		b2Fixture* fixtureA = c->GetFixtureA();
 		b2Fixture* fixtureB = c->GetFixtureB();
 		int32 indexA = c->GetChildIndexA();
@@ -164,7 +267,16 @@ void b2ContactManager::Collide()
 		}
 
 		// The contact persists.
-		c->Update(m_contactListener);
+		if (narrowPhase != nullptr && narrowPhase->results[index].evaluated)
+		{
+			b2Assert(narrowPhase->contacts[index] == c);
+			const b2NarrowPhase::Result& r = narrowPhase->results[index];
+			c->Update(m_contactListener, r.manifold, r.touching);
+		}
+		else
+		{
+			c->Update(m_contactListener);
+		}
 		c = c->GetNext();
 	}
 }
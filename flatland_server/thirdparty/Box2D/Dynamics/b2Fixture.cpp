@@ -130,7 +130,8 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 	{
 		b2FixtureProxy* proxy = m_proxies + i;
 		m_shape->ComputeAABB(&proxy->aabb, xf, i);
-		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
+		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy, m_body->GetType() == b2_staticBody);
+		broadPhase->SetProxyFilter(proxy->proxyId, m_filter.categoryBits, m_isSensor);
 		proxy->fixture = this;
 		proxy->childIndex = i;
 	}
@@ -149,7 +150,8 @@ void b2Fixture::DestroyProxies(b2BroadPhase* broadPhase)
 	m_proxyCount = 0;
 }
 
-void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2)
+void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2,
+							float32 extension, bool shrink)
 {
 	if (m_proxyCount == 0)
 	{	
@@ -169,7 +171,7 @@ void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transfo
 
 		b2Vec2 displacement = transform2.p - transform1.p;
 
-		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement, extension, shrink);
 	}
 }
 
@@ -214,6 +216,7 @@ void b2Fixture::Refilter()
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
 		broadPhase->TouchProxy(m_proxies[i].proxyId);
+		broadPhase->SetProxyFilter(m_proxies[i].proxyId, m_filter.categoryBits, m_isSensor);
 	}
 }
 
@@ -223,6 +226,12 @@ void b2Fixture::SetSensor(bool sensor)
 	{
 		m_body->SetAwake(true);
 		m_isSensor = sensor;
+
+		b2BroadPhase* broadPhase = &m_body->GetWorld()->m_contactManager.m_broadPhase;
+		for (int32 i = 0; i < m_proxyCount; ++i)
+		{
+			broadPhase->SetProxyFilter(m_proxies[i].proxyId, m_filter.categoryBits, m_isSensor);
+		}
 	}
 }
 
@@ -233,8 +242,8 @@ void b2Fixture::Dump(int32 bodyIndex)
 	b2Log("    fd.restitution = %.15lef;\n", m_restitution);
 	b2Log("    fd.density = %.15lef;\n", m_density);
 	b2Log("    fd.isSensor = bool(%d);\n", m_isSensor);
-	b2Log("    fd.filter.categoryBits = uint16(%d);\n", m_filter.categoryBits);
-	b2Log("    fd.filter.maskBits = uint16(%d);\n", m_filter.maskBits);
+	b2Log("    fd.filter.categoryBits = uint32(%u);\n", m_filter.categoryBits);
+	b2Log("    fd.filter.maskBits = uint32(%u);\n", m_filter.maskBits);
 	b2Log("    fd.filter.groupIndex = int16(%d);\n", m_filter.groupIndex);
 
 	switch (m_shape->m_type)
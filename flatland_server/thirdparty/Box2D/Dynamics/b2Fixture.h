@@ -34,16 +34,17 @@ struct b2Filter
 	b2Filter()
 	{
 		categoryBits = 0x0001;
-		maskBits = 0xFFFF;
+		maskBits = 0xFFFFFFFF;
 		groupIndex = 0;
 	}
 
 	/// The collision category bits. Normally you would just set one bit.
-	uint16 categoryBits;
+	/// Flatland: widened from 16 to 32 bits for up to 32 layers.
+	uint32 categoryBits;
 
 	/// The collision mask bits. This states the categories that this
 	/// shape would accept for collision.
-	uint16 maskBits;
+	uint32 maskBits;
 
 	/// Collision groups allow a certain group of objects to never collide (negative)
 	/// or always collide (positive). Zero means no collision group. Non-zero group
@@ -213,7 +214,10 @@ protected:
 	void CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf);
 	void DestroyProxies(b2BroadPhase* broadPhase);
 
-	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
+	// Flatland: extension is the margin of the fat AABBs, shrink reinserts
+	// the proxies whose fat AABBs are too large, see b2DynamicTree::MoveProxy.
+	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2,
+					 float32 extension = b2_aabbExtension, bool shrink = false);
 
 	float32 m_density;
 
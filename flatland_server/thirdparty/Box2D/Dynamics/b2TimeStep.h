@@ -34,6 +34,55 @@ struct b2Profile
 	float32 solveTOI;
 };
 
+/// Flatland: number of size classes of b2StepStats::islandSizes.
+#define b2_islandSizeClasses 8
+
+/// Flatland: what the last time step solved, see b2World::GetStepStats.
+struct b2StepStats
+{
+	/// Awake islands solved, with their bodies. The static bodies are
+	/// counted in every island they touch.
+	int32 islandCount;
+	int32 islandBodyCount;
+	int32 maxIslandBodyCount;
+
+	/// Islands of 1, 2-3, 4-7, ... bodies, the last class holds the larger
+	/// islands.
+	int32 islandSizes[b2_islandSizeClasses];
+
+	/// TOI events solved, each a pair of bodies moved back to their time of
+	/// impact.
+	int32 toiEventCount;
+
+	/// Proxies reinserted in the broad-phase because they left their fat
+	/// AABBs, and candidate pairs of overlapping fat AABBs reported to the
+	/// contact manager.
+	int32 proxyReinsertCount;
+	int32 pairCount;
+};
+
+/// Flatland: when the bodies of an island fall asleep, see
+/// b2World::SetSleepSettings. The defaults are the constants of b2Settings.h.
+struct b2SleepSettings
+{
+	b2SleepSettings()
+	{
+		timeToSleep = b2_timeToSleep;
+		linearTolerance = b2_linearSleepTolerance;
+		angularTolerance = b2_angularSleepTolerance;
+	}
+
+	/// The time that all the bodies of an island must be still before it
+	/// falls asleep.
+	float32 timeToSleep;
+
+	/// A body is not still while its linear velocity is above this.
+	float32 linearTolerance;
+
+	/// A body is not still while its angular velocity is above this.
+	float32 angularTolerance;
+};
+
 /// This is an internal structure.
 struct b2TimeStep
 {
@@ -43,6 +92,7 @@ struct b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	b2SleepSettings sleep;	// Flatland: see b2World::SetSleepSettings
 };
 
 /// This is an internal structure.
@@ -33,12 +33,207 @@
 #include "Box2D/Common/b2Draw.h"
 #include "Box2D/Common/b2Timer.h"
 #include <new>
+#include <vector>
+
+// Records the contact impulses reported by an island solved on a worker
+// thread, so they can be reported to the contact listener afterwards.
+class b2ImpulseRecorder : public b2ContactListener
+{
+public:
+	explicit b2ImpulseRecorder(b2ContactImpulse* impulses) : m_impulses(impulses) {}
+
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		B2_NOT_USED(contact);
+		*m_impulses++ = *impulse;
+	}
+
+	b2ContactImpulse* m_impulses;
+};
+
+// The islands of a step when b2World::Solve runs on a b2TaskExecutor. The
+// islands are collected with the same depth first search as the serial
+// solver, then grouped into batches that are solved in parallel, each with
+// its own stack allocator.
+struct b2ParallelSolver
+{
+	struct Island
+	{
+		int32 bodyStart, bodyCount;
+		int32 contactStart, contactCount;
+		int32 jointStart, jointCount;
+		bool hasStatic;
+	};
+
+	~b2ParallelSolver()
+	{
+		for (size_t i = 0; i < allocators.size(); ++i)
+		{
+			allocators[i]->~b2StackAllocator();
+			b2Free(allocators[i]);
+		}
+	}
+
+	void Clear()
+	{
+		bodies.clear();
+		contacts.clear();
+		joints.clear();
+		islands.clear();
+	}
+
+	void AddIsland(const b2Island& island)
+	{
+		Island r;
+		r.bodyStart = int32(bodies.size());
+		r.bodyCount = island.m_bodyCount;
+		r.contactStart = int32(contacts.size());
+		r.contactCount = island.m_contactCount;
+		r.jointStart = int32(joints.size());
+		r.jointCount = island.m_jointCount;
+		r.hasStatic = false;
+		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		{
+			bodies.push_back(island.m_bodies[i]);
+			r.hasStatic |= island.m_bodies[i]->GetType() == b2_staticBody;
+		}
+		contacts.insert(contacts.end(), island.m_contacts,
+						island.m_contacts + island.m_contactCount);
+		joints.insert(joints.end(), island.m_joints,
+					  island.m_joints + island.m_jointCount);
+		islands.push_back(r);
+	}
+
+	// Group the islands into at most threadCount batches of about the same
+	// size. A static body is shared by all the islands it touches, since the
+	// island solver writes to the bodies of an island and indexes them with
+	// b2Body::m_islandIndex, these islands all go into the first batch and
+	// are solved one after the other.
+	void Partition(int32 threadCount)
+	{
+		order.clear();
+		batchStarts.clear();
+
+		int32 total = 0;
+		for (size_t i = 0; i < islands.size(); ++i)
+		{
+			if (islands[i].hasStatic)
+			{
+				order.push_back(int32(i));
+			}
+			else
+			{
+				total += Weight(islands[i]);
+			}
+		}
+
+		if (order.empty() == false)
+		{
+			batchStarts.push_back(0);
+		}
+
+		int32 target = b2Max((total + threadCount - 1) / threadCount, 1);
+		int32 weight = target;
+		for (size_t i = 0; i < islands.size(); ++i)
+		{
+			if (islands[i].hasStatic)
+			{
+				continue;
+			}
+
+			if (weight >= target)
+			{
+				batchStarts.push_back(int32(order.size()));
+				weight = 0;
+			}
+			order.push_back(int32(i));
+			weight += Weight(islands[i]);
+		}
+		batchStarts.push_back(int32(order.size()));
+
+		int32 batchCount = GetBatchCount();
+		while (int32(allocators.size()) < batchCount)
+		{
+			void* mem = b2Alloc(sizeof(b2StackAllocator));
+			allocators.push_back(new (mem) b2StackAllocator);
+		}
+		profiles.resize(batchCount);
+		impulses.resize(contacts.size());
+	}
+
+	int32 GetBatchCount() const
+	{
+		return int32(batchStarts.size()) - 1;
+	}
+
+	static int32 Weight(const Island& r)
+	{
+		return r.bodyCount + r.contactCount + r.jointCount;
+	}
+
+	void SolveBatch(int32 index)
+	{
+		b2Profile& total = profiles[index];
+		memset(&total, 0, sizeof(b2Profile));
+
+		for (int32 k = batchStarts[index]; k < batchStarts[index + 1]; ++k)
+		{
+			const Island& r = islands[order[k]];
+
+			b2ImpulseRecorder recorder(impulses.data() + r.contactStart);
+			b2Island island(r.bodyCount, r.contactCount, r.jointCount,
+							allocators[index], report ? &recorder : nullptr);
+			for (int32 i = 0; i < r.bodyCount; ++i)
+			{
+				island.Add(bodies[r.bodyStart + i]);
+			}
+			for (int32 i = 0; i < r.contactCount; ++i)
+			{
+				island.Add(contacts[r.contactStart + i]);
+			}
+			for (int32 i = 0; i < r.jointCount; ++i)
+			{
+				island.Add(joints[r.jointStart + i]);
+			}
+
+			b2Profile profile;
+			island.Solve(&profile, step, gravity, allowSleep);
+			total.solveInit += profile.solveInit;
+			total.solveVelocity += profile.solveVelocity;
+			total.solvePosition += profile.solvePosition;
+		}
+	}
+
+	std::vector<b2Body*> bodies;
+	std::vector<b2Contact*> contacts;
+	std::vector<b2Joint*> joints;
+	std::vector<Island> islands;
+
+	std::vector<int32> order;		// island indices, grouped by batch
+	std::vector<int32> batchStarts;	// start of each batch in order
+	std::vector<b2StackAllocator*> allocators;
+	std::vector<b2Profile> profiles;
+	std::vector<b2ContactImpulse> impulses;	// one per contact
+
+	b2TimeStep step;
+	b2Vec2 gravity;
+	bool allowSleep;
+	bool report;
+};
+
+static void b2SolveBatch(void* context, int32 index)
+{
+	static_cast<b2ParallelSolver*>(context)->SolveBatch(index);
+}
 
 b2World::b2World(const b2Vec2& gravity)
 {
 	m_destructionListener = nullptr;
 	g_debugDraw = nullptr;
 
+	m_taskExecutor = nullptr;
+	m_parallelSolver = nullptr;
+
 	m_bodyList = nullptr;
 	m_jointList = nullptr;
 
@@ -47,6 +242,7 @@ b2World::b2World(const b2Vec2& gravity)
 
 	m_warmStarting = true;
 	m_continuousPhysics = true;
+	m_continuousBodyCount = 0;
 	m_subStepping = false;
 
 	m_stepComplete = true;
@@ -61,10 +257,13 @@ b2World::b2World(const b2Vec2& gravity)
 	m_contactManager.m_allocator = &m_blockAllocator;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
+	memset(&m_stepStats, 0, sizeof(b2StepStats));
 }
 
 b2World::~b2World()
 {
+	delete m_parallelSolver;
+
 	// Some shapes allocate using b2Alloc.
 	b2Body* b = m_bodyList;
 	while (b)
@@ -104,6 +303,12 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	g_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskExecutor(b2TaskExecutor* executor)
+{
+	m_taskExecutor = executor;
+	m_contactManager.m_taskExecutor = executor;
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -125,6 +330,11 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 	m_bodyList = b;
 	++m_bodyCount;
 
+	if (b->m_flags & b2Body::e_bulletFlag)
+	{
+		++m_continuousBodyCount;
+	}
+
 	return b;
 }
 
@@ -205,10 +415,40 @@ void b2World::DestroyBody(b2Body* b)
 	}
 
 	--m_bodyCount;
+	if (b->m_flags & (b2Body::e_bulletFlag | b2Body::e_continuousFlag))
+	{
+		--m_continuousBodyCount;
+	}
 	b->~b2Body();
 	m_blockAllocator.Free(b, sizeof(b2Body));
 }
 
+void b2World::BeginStaticBulk()
+{
+	b2Assert(IsLocked() == false);
+	m_contactManager.m_broadPhase.BeginStaticBulk();
+}
+
+void b2World::EndStaticBulk()
+{
+	b2Assert(IsLocked() == false);
+	m_contactManager.m_broadPhase.EndStaticBulk();
+}
+
+void b2World::BeginBulkDestroy()
+{
+	b2Assert(IsLocked() == false);
+	m_contactManager.m_broadPhase.BeginStaticBulk();
+	m_contactManager.m_broadPhase.BeginBulkDestroy();
+}
+
+void b2World::EndBulkDestroy()
+{
+	b2Assert(IsLocked() == false);
+	m_contactManager.m_broadPhase.EndBulkDestroy();
+	m_contactManager.m_broadPhase.EndStaticBulk();
+}
+
 b2Joint* b2World::CreateJoint(const b2JointDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -410,6 +650,19 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
+	// With a task executor, the islands are only collected here and solved
+	// afterwards by SolveIslandsParallel.
+	b2ParallelSolver* parallel = nullptr;
+	if (m_taskExecutor != nullptr && m_taskExecutor->GetThreadCount() > 1)
+	{
+		if (m_parallelSolver == nullptr)
+		{
+			m_parallelSolver = new b2ParallelSolver;
+		}
+		parallel = m_parallelSolver;
+		parallel->Clear();
+	}
+
 	// Build and simulate all awake islands.
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
@@ -431,6 +684,12 @@ void b2World::Solve(const b2TimeStep& step)
 			continue;
 		}
 
+		// Bodies bypassing the solver are moved by IntegrateBypassed.
+		if (seed->m_flags & b2Body::e_bypassFlag)
+		{
+			continue;
+		}
+
 		// Reset island and stack.
 		island.Clear();
 		int32 stackCount = 0;
@@ -481,11 +740,16 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
+				// Contacts with bodies bypassing the solver get no response.
+				b2Body* other = ce->other;
+				if (other->m_flags & b2Body::e_bypassFlag)
+				{
+					continue;
+				}
+
 				island.Add(contact);
 				contact->m_flags |= b2Contact::e_islandFlag;
 
-				b2Body* other = ce->other;
-
 				// Was the other body already added to this island?
 				if (other->m_flags & b2Body::e_islandFlag)
 				{
@@ -513,6 +777,12 @@ void b2World::Solve(const b2TimeStep& step)
 					continue;
 				}
 
+				// Nor joints connected to bodies bypassing the solver.
+				if (other->m_flags & b2Body::e_bypassFlag)
+				{
+					continue;
+				}
+
 				island.Add(je->joint);
 				je->joint->m_islandFlag = true;
 
@@ -527,11 +797,28 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+		m_stepStats.islandCount += 1;
+		m_stepStats.islandBodyCount += island.m_bodyCount;
+		m_stepStats.maxIslandBodyCount = b2Max(m_stepStats.maxIslandBodyCount, island.m_bodyCount);
+		int32 sizeClass = 0;
+		while (sizeClass < b2_islandSizeClasses - 1 && (island.m_bodyCount >> (sizeClass + 1)) > 0)
+		{
+			++sizeClass;
+		}
+		m_stepStats.islandSizes[sizeClass] += 1;
+
+		if (parallel != nullptr)
+		{
+			parallel->AddIsland(island);
+		}
+		else
+		{
+			b2Profile profile;
+			island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+		}
 
 		// Post solve cleanup.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -547,8 +834,15 @@ void b2World::Solve(const b2TimeStep& step)
 
 	m_stackAllocator.Free(stack);
 
+	if (parallel != nullptr)
+	{
+		SolveIslandsParallel(step);
+	}
+
 	{
 		b2Timer timer;
+		IntegrateBypassed(step);
+
 		// Synchronize fixtures, check for out of range bodies.
 		for (b2Body* b = m_bodyList; b; b = b->GetNext())
 		{
@@ -564,6 +858,10 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 
 			// Update fixtures (for broad-phase).
+			if (m_adaptiveAABB.enabled)
+			{
+				UpdateAABBExtension(b, step.dt);
+			}
 			b->SynchronizeFixtures();
 		}
 
@@ -573,6 +871,140 @@ void b2World::Solve(const b2TimeStep& step)
 	}
 }
 
+// Flatland: average the speed of a body over about the lookahead, and
+// extend its fat AABBs by the distance it travels in that time.
+void b2World::UpdateAABBExtension(b2Body* body, float32 dt)
+{
+	const b2AdaptiveAABB& adaptive = m_adaptiveAABB;
+	float32 alpha = adaptive.lookahead > 0.0f ? b2Min(dt / adaptive.lookahead, 1.0f) : 1.0f;
+	float32 speed = body->m_linearVelocity.Length();
+	body->m_averageSpeed += alpha * (speed - body->m_averageSpeed);
+	body->m_aabbExtension = b2Clamp(body->m_averageSpeed * adaptive.lookahead,
+									adaptive.minExtension, adaptive.maxExtension);
+}
+
+// Move the bodies bypassing the solver by their velocities. The state is
+// gathered into flat arrays so the integration itself is a tight loop.
+void b2World::IntegrateBypassed(const b2TimeStep& step)
+{
+	int32 count = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if ((b->m_flags & b2Body::e_bypassFlag) && b->IsAwake() &&
+			b->IsActive() && b->GetType() != b2_staticBody)
+		{
+			++count;
+		}
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(count * sizeof(b2Body*));
+	float32* state = (float32*)m_stackAllocator.Allocate(6 * count * sizeof(float32));
+	float32* cx = state;
+	float32* cy = state + count;
+	float32* a = state + 2 * count;
+	float32* vx = state + 3 * count;
+	float32* vy = state + 4 * count;
+	float32* w = state + 5 * count;
+
+	int32 moving = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if ((b->m_flags & b2Body::e_bypassFlag) == 0 || b->IsAwake() == false ||
+			b->IsActive() == false || b->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+
+		// Resting bodies need neither integration nor a broad-phase update.
+		b->m_sweep.c0 = b->m_sweep.c;
+		b->m_sweep.a0 = b->m_sweep.a;
+		if (b->m_linearVelocity.x == 0.0f && b->m_linearVelocity.y == 0.0f &&
+			b->m_angularVelocity == 0.0f)
+		{
+			continue;
+		}
+
+		bodies[moving] = b;
+		cx[moving] = b->m_sweep.c.x;
+		cy[moving] = b->m_sweep.c.y;
+		a[moving] = b->m_sweep.a;
+		vx[moving] = b->m_linearVelocity.x;
+		vy[moving] = b->m_linearVelocity.y;
+		w[moving] = b->m_angularVelocity;
+		++moving;
+	}
+
+	float32 h = step.dt;
+	for (int32 i = 0; i < moving; ++i)
+	{
+		cx[i] += h * vx[i];
+		cy[i] += h * vy[i];
+		a[i] += h * w[i];
+	}
+
+	for (int32 i = 0; i < moving; ++i)
+	{
+		b2Body* b = bodies[i];
+		b->m_sweep.c.Set(cx[i], cy[i]);
+		b->m_sweep.a = a[i];
+		b->SynchronizeTransform();
+		if (m_adaptiveAABB.enabled)
+		{
+			UpdateAABBExtension(b, h);
+		}
+		b->SynchronizeFixtures();
+	}
+
+	m_stackAllocator.Free(state);
+	m_stackAllocator.Free(bodies);
+}
+
+// Solve the islands collected by Solve on the task executor.
+void b2World::SolveIslandsParallel(const b2TimeStep& step)
+{
+	b2ParallelSolver* solver = m_parallelSolver;
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+
+	solver->step = step;
+	solver->gravity = m_gravity;
+	solver->allowSleep = m_allowSleep;
+	solver->report = listener != nullptr;
+	solver->Partition(m_taskExecutor->GetThreadCount());
+
+	int32 batchCount = solver->GetBatchCount();
+	if (batchCount > 1)
+	{
+		m_taskExecutor->ParallelFor(b2SolveBatch, solver, batchCount);
+	}
+	else if (batchCount == 1)
+	{
+		solver->SolveBatch(0);
+	}
+
+	// The profile sums the time spent by all threads.
+	for (int32 i = 0; i < batchCount; ++i)
+	{
+		m_profile.solveInit += solver->profiles[i].solveInit;
+		m_profile.solveVelocity += solver->profiles[i].solveVelocity;
+		m_profile.solvePosition += solver->profiles[i].solvePosition;
+	}
+
+	// Report the impulses on this thread, in the same order as the islands
+	// would have reported them when solved one after the other.
+	if (listener != nullptr)
+	{
+		for (size_t i = 0; i < solver->contacts.size(); ++i)
+		{
+			listener->PostSolve(solver->contacts[i], &solver->impulses[i]);
+		}
+	}
+}
+
 // Find TOI contacts and solve them.
 void b2World::SolveTOI(const b2TimeStep& step)
 {
@@ -636,6 +1068,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				b2Body* bA = fA->GetBody();
 				b2Body* bB = fB->GetBody();
 
+				// Bodies bypassing the solver take no part in TOI events.
+				if ((bA->m_flags | bB->m_flags) & b2Body::e_bypassFlag)
+				{
+					continue;
+				}
+
 				b2BodyType typeA = bA->m_type;
 				b2BodyType typeB = bB->m_type;
 				b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
@@ -658,6 +1096,14 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					continue;
 				}
 
+				// Without continuous physics for the whole world, is neither
+				// body flagged to have its own?
+				const uint16 continuous = b2Body::e_bulletFlag | b2Body::e_continuousFlag;
+				if (m_continuousPhysics == false && ((bA->m_flags | bB->m_flags) & continuous) == 0)
+				{
+					continue;
+				}
+
 				// Compute the TOI for this contact.
 				// Put the sweeps onto the same time interval.
 				float32 alpha0 = bA->m_sweep.alpha0;
@@ -750,6 +1196,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 		bA->SetAwake(true);
 		bB->SetAwake(true);
+		m_stepStats.toiEventCount += 1;
 
 		// Build the island
 		island.Clear();
@@ -796,6 +1243,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 						continue;
 					}
 
+					// Nor bodies bypassing the solver.
+					if (other->m_flags & b2Body::e_bypassFlag)
+					{
+						continue;
+					}
+
 					// Skip sensors.
 					bool sensorA = contact->m_fixtureA->m_isSensor;
 					bool sensorB = contact->m_fixtureB->m_isSensor;
@@ -906,6 +1359,8 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	}
 
 	m_flags |= e_locked;
+	memset(&m_stepStats, 0, sizeof(b2StepStats));
+	m_contactManager.m_broadPhase.ResetCounts();
 
 	b2TimeStep step;
 	step.dt = dt;
@@ -923,6 +1378,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.sleep = m_sleepSettings;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -940,7 +1396,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	}
 
 	// Handle TOI events.
-	if (m_continuousPhysics && step.dt > 0.0f)
+	if ((m_continuousPhysics || m_continuousBodyCount > 0) && step.dt > 0.0f)
 	{
 		b2Timer timer;
 		SolveTOI(step);
@@ -957,6 +1413,9 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 		ClearForces();
 	}
 
+	m_stepStats.proxyReinsertCount = m_contactManager.m_broadPhase.GetReinsertCount();
+	m_stepStats.pairCount = m_contactManager.m_broadPhase.GetReportedPairCount();
+
 	m_flags &= ~e_locked;
 
 	m_profile.step = stepTimer.GetMilliseconds();
@@ -1028,6 +1487,308 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
 }
 
+// Test the rays of a packet overlapping the proxy of a fixture child, in the
+// given transform of the fixture, keeping the nearest hit of each ray.
+static void b2RayCastPacketFixture(b2Fixture* fixture, int32 childIndex, const b2Transform& xf,
+								   const int32* rays, int32 rayCount, const b2RayCastInput* inputs,
+								   const b2RayBatchFilter* filter, float32* maxFractions, b2RayBatchHit* hits)
+{
+	if ((fixture->GetFilterData().categoryBits & filter->maskBits) == 0 ||
+		(filter->ignoreSensors && fixture->IsSensor()))
+	{
+		return;
+	}
+
+	const b2Body* body = fixture->GetBody();
+	for (int32 i = 0; i < filter->ignoredBodyCount; ++i)
+	{
+		if (filter->ignoredBodies[i] == body)
+		{
+			return;
+		}
+	}
+
+	const b2Shape* shape = fixture->GetShape();
+	for (int32 i = 0; i < rayCount; ++i)
+	{
+		int32 ray = rays[i];
+		b2RayCastInput input = inputs[ray];
+		input.maxFraction = maxFractions[ray];
+
+		b2RayCastOutput output;
+		bool hit = shape->RayCast(&output, input, xf, childIndex);
+		if (hit && (hits[ray].fixture == nullptr || output.fraction < maxFractions[ray]))
+		{
+			maxFractions[ray] = output.fraction;
+			hits[ray].fixture = fixture;
+			hits[ray].fraction = output.fraction;
+			hits[ray].normal = output.normal;
+		}
+	}
+}
+
+// Reset the hits of RayCastBatch, and initialize the max fractions.
+static void b2InitRayBatch(const b2RayCastInput* inputs, int32 count, float32* maxFractions, b2RayBatchHit* hits)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		maxFractions[i] = inputs[i].maxFraction;
+		hits[i].fixture = nullptr;
+		hits[i].fraction = inputs[i].maxFraction;
+		hits[i].normal.SetZero();
+	}
+}
+
+struct b2WorldRayCastPacketWrapper
+{
+	void RayCastPacketCallback(int32 proxyId, const int32* rays, int32 rayCount)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		b2RayCastPacketFixture(fixture, proxy->childIndex, fixture->GetBody()->GetTransform(),
+							   rays, rayCount, inputs, filter, maxFractions, hits);
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2RayCastInput* inputs;
+	const b2RayBatchFilter* filter;
+	float32* maxFractions;
+	b2RayBatchHit* hits;
+};
+
+void b2World::RayCastBatch(const b2RayCastInput* inputs, int32 count, const b2RayBatchFilter& filter, b2RayBatchHit* hits) const
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// The stack allocator of the world is not thread safe.
+	b2StackAllocator* allocator = b2GetThreadStackAllocator();
+	float32* maxFractions = (float32*)allocator->Allocate(count * sizeof(float32));
+	b2InitRayBatch(inputs, count, maxFractions, hits);
+
+	b2WorldRayCastPacketWrapper wrapper;
+	wrapper.broadPhase = &m_contactManager.m_broadPhase;
+	wrapper.inputs = inputs;
+	wrapper.filter = &filter;
+	wrapper.maxFractions = maxFractions;
+	wrapper.hits = hits;
+	m_contactManager.m_broadPhase.RayCastPacket(&wrapper, inputs, maxFractions, count, filter.maskBits, filter.ignoreSensors);
+
+	allocator->Free(maxFractions);
+}
+
+void b2World::TakeRayCastSnapshot(b2RayCastSnapshot* snapshot)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// The static tree must not change during the next step, it is shared.
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->SettleStaticTree();
+	broadPhase->SettleMovingTree();
+
+	const b2DynamicTree& tree = broadPhase->GetMovingTree();
+	snapshot->m_broadPhase = broadPhase;
+	snapshot->m_tree.CopyFrom(tree);
+
+	int32 capacity = tree.GetNodeCapacity();
+	if (snapshot->m_proxyCapacity < capacity)
+	{
+		b2Free(snapshot->m_proxies);
+		snapshot->m_proxyCapacity = capacity;
+		snapshot->m_proxies = (b2RayCastSnapshot::Proxy*)b2Alloc(capacity * sizeof(b2RayCastSnapshot::Proxy));
+	}
+	for (int32 i = 0; i < capacity; ++i)
+	{
+		new (snapshot->m_proxies + i) b2RayCastSnapshot::Proxy();
+	}
+
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->m_type == b2_staticBody)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				int32 proxyId = f->m_proxies[i].proxyId;
+				if (b2BroadPhase::IsStaticProxy(proxyId))
+				{
+					continue;
+				}
+
+				b2RayCastSnapshot::Proxy* proxy = snapshot->m_proxies + proxyId;
+				proxy->fixture = f;
+				proxy->childIndex = f->m_proxies[i].childIndex;
+				proxy->xf = b->m_xf;
+			}
+		}
+	}
+}
+
+b2RayCastSnapshot::b2RayCastSnapshot()
+{
+	m_broadPhase = nullptr;
+	m_proxies = nullptr;
+	m_proxyCapacity = 0;
+}
+
+b2RayCastSnapshot::~b2RayCastSnapshot()
+{
+	b2Free(m_proxies);
+}
+
+bool b2RayCastSnapshot::GetProxy(bool isStatic, int32 proxyId, b2Fixture** fixture, int32* childIndex,
+								 b2Transform* xf) const
+{
+	if (isStatic)
+	{
+		// Static bodies do not move, their transform is read in place.
+		const b2DynamicTree& tree = m_broadPhase->GetStaticTree();
+		if (tree.IsDestroyed(proxyId))
+		{
+			return false;
+		}
+		b2FixtureProxy* proxy = (b2FixtureProxy*)tree.GetUserData(proxyId);
+		*fixture = proxy->fixture;
+		*childIndex = proxy->childIndex;
+		*xf = proxy->fixture->GetBody()->GetTransform();
+		return true;
+	}
+
+	const Proxy& proxy = m_proxies[proxyId];
+	if (proxy.fixture == nullptr || m_tree.IsDestroyed(proxyId))
+	{
+		return false;
+	}
+	*fixture = proxy.fixture;
+	*childIndex = proxy.childIndex;
+	*xf = proxy.xf;
+	return true;
+}
+
+struct b2SnapshotRayCastWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2Fixture* fixture;
+		int32 index;
+		b2Transform xf;
+		if (snapshot->GetProxy(isStatic, proxyId, &fixture, &index, &xf) == false)
+		{
+			return -1.0f;
+		}
+
+		b2RayCastOutput output;
+		if (fixture->GetShape()->RayCast(&output, input, xf, index) == false)
+		{
+			return input.maxFraction;
+		}
+
+		float32 fraction = output.fraction;
+		b2Vec2 point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+		float32 value = callback->ReportFixture(fixture, point, output.normal, fraction);
+		if (value == 0.0f)
+		{
+			terminated = true;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	const b2RayCastSnapshot* snapshot;
+	b2RayCastCallback* callback;
+	bool isStatic;
+	float32 maxFraction;
+	bool terminated;
+};
+
+void b2RayCastSnapshot::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const
+{
+	b2Assert(IsTaken());
+
+	// Same order as b2BroadPhase::RayCast, the static tree first.
+	b2SnapshotRayCastWrapper wrapper;
+	wrapper.snapshot = this;
+	wrapper.callback = callback;
+	wrapper.isStatic = true;
+	wrapper.maxFraction = 1.0f;
+	wrapper.terminated = false;
+	b2RayCastInput input;
+	input.maxFraction = 1.0f;
+	input.p1 = point1;
+	input.p2 = point2;
+	m_broadPhase->GetStaticTree().RayCast(&wrapper, input);
+	if (wrapper.terminated)
+	{
+		return;
+	}
+
+	wrapper.isStatic = false;
+	input.maxFraction = wrapper.maxFraction;
+	m_tree.RayCast(&wrapper, input);
+}
+
+struct b2SnapshotRayCastPacketWrapper
+{
+	void RayCastPacketCallback(int32 proxyId, const int32* rays, int32 rayCount)
+	{
+		b2Fixture* fixture;
+		int32 index;
+		b2Transform xf;
+		if (snapshot->GetProxy(isStatic, proxyId, &fixture, &index, &xf))
+		{
+			b2RayCastPacketFixture(fixture, index, xf, rays, rayCount, inputs, filter, maxFractions, hits);
+		}
+	}
+
+	const b2RayCastSnapshot* snapshot;
+	bool isStatic;
+	const b2RayCastInput* inputs;
+	const b2RayBatchFilter* filter;
+	float32* maxFractions;
+	b2RayBatchHit* hits;
+};
+
+void b2RayCastSnapshot::RayCastBatch(const b2RayCastInput* inputs, int32 count, const b2RayBatchFilter& filter,
+									 b2RayBatchHit* hits) const
+{
+	b2Assert(IsTaken());
+	if (count <= 0)
+	{
+		return;
+	}
+
+	b2StackAllocator* allocator = b2GetThreadStackAllocator();
+	float32* maxFractions = (float32*)allocator->Allocate(count * sizeof(float32));
+	b2InitRayBatch(inputs, count, maxFractions, hits);
+
+	b2SnapshotRayCastPacketWrapper wrapper;
+	wrapper.snapshot = this;
+	wrapper.isStatic = true;
+	wrapper.inputs = inputs;
+	wrapper.filter = &filter;
+	wrapper.maxFractions = maxFractions;
+	wrapper.hits = hits;
+	m_broadPhase->GetStaticTree().RayCastPacket(&wrapper, inputs, maxFractions, count, filter.maskBits,
+												filter.ignoreSensors);
+	wrapper.isStatic = false;
+	m_tree.RayCastPacket(&wrapper, inputs, maxFractions, count, filter.maskBits, filter.ignoreSensors);
+
+	allocator->Free(maxFractions);
+}
+
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
 	switch (fixture->GetType())
@@ -1274,6 +2035,16 @@ float32 b2World::GetTreeQuality() const
 	return m_contactManager.m_broadPhase.GetTreeQuality();
 }
 
+int32 b2World::GetStaticProxyCount() const
+{
+	return m_contactManager.m_broadPhase.GetStaticProxyCount();
+}
+
+int32 b2World::GetStaticTreeHeight() const
+{
+	return m_contactManager.m_broadPhase.GetStaticTreeHeight();
+}
+
 void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	b2Assert((m_flags & e_locked) == 0);
@@ -34,6 +34,117 @@ class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+struct b2ParallelSolver;
+
+/// The fixtures b2World::RayCastBatch tests, checked once per fixture
+/// without callbacks.
+struct b2RayBatchFilter
+{
+	b2RayBatchFilter()
+	{
+		maskBits = 0xFFFFFFFF;
+		ignoreSensors = true;
+		ignoredBodies = nullptr;
+		ignoredBodyCount = 0;
+	}
+
+	/// Only the fixtures with one of these category bits are hit.
+	uint32 maskBits;
+
+	/// Do not hit sensor fixtures.
+	bool ignoreSensors;
+
+	/// Do not hit the fixtures of these bodies, e.g. ones ray-cast otherwise.
+	const b2Body* const* ignoredBodies;
+	int32 ignoredBodyCount;
+};
+
+/// Flatland: broad-phase AABB margins adapted to the recent speed of each
+/// body, see b2World::SetAdaptiveAABB. Slow bodies get tight fat AABBs, which
+/// overlap fewer others, fast ones wide fat AABBs, which they leave less
+/// often. When disabled, every fat AABB is extended by b2_aabbExtension.
+struct b2AdaptiveAABB
+{
+	b2AdaptiveAABB()
+	{
+		enabled = false;
+		minExtension = 0.02f;
+		maxExtension = 1.0f;
+		lookahead = 0.5f;
+	}
+
+	bool enabled;
+
+	/// The margin of resting bodies.
+	float32 minExtension;
+
+	/// The margin of the fastest bodies.
+	float32 maxExtension;
+
+	/// The seconds of travel at the average speed of a body its margin
+	/// covers, also the time constant of the average.
+	float32 lookahead;
+};
+
+/// The nearest hit of a ray of b2World::RayCastBatch.
+struct b2RayBatchHit
+{
+	/// The fixture hit, nullptr if the ray did not hit anything.
+	b2Fixture* fixture;
+
+	/// The fraction of the ray at the hit, maxFraction if there is no hit.
+	float32 fraction;
+
+	/// The normal of the fixture at the hit.
+	b2Vec2 normal;
+};
+
+/// Flatland: the moving proxies of a world with their transforms, taken by
+/// b2World::TakeRayCastSnapshot. Ray casts against the snapshot hit what ray
+/// casts against the world hit when it was taken, and may run on other
+/// threads while the world is stepped. Only the tree of the moving proxies is
+/// copied: a step leaves the static tree alone once settled, and the
+/// fixtures are only used for their shapes and filters, which a step does not
+/// modify either. Nothing else may modify the world until these ray casts are
+/// done, and the hit fixtures are only valid as long as they exist.
+class b2RayCastSnapshot
+{
+public:
+	b2RayCastSnapshot();
+	~b2RayCastSnapshot();
+
+	/// Same as b2World::RayCast, against the snapshot.
+	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
+
+	/// Same as b2World::RayCastBatch, against the snapshot.
+	void RayCastBatch(const b2RayCastInput* inputs, int32 count, const b2RayBatchFilter& filter, b2RayBatchHit* hits) const;
+
+	/// Is a snapshot of a world taken?
+	bool IsTaken() const { return m_broadPhase != nullptr; }
+
+private:
+
+	friend class b2World;
+	friend struct b2SnapshotRayCastWrapper;
+	friend struct b2SnapshotRayCastPacketWrapper;
+
+	/// Get the fixture child of a proxy of the static tree or of the copied
+	/// tree, with its transform. Returns false if there is none.
+	bool GetProxy(bool isStatic, int32 proxyId, b2Fixture** fixture, int32* childIndex, b2Transform* xf) const;
+
+	/// A moving proxy, by proxy id.
+	struct Proxy
+	{
+		b2Fixture* fixture;
+		int32 childIndex;
+		b2Transform xf;
+	};
+
+	const b2BroadPhase* m_broadPhase;
+	b2DynamicTree m_tree;
+	Proxy* m_proxies;
+	int32 m_proxyCapacity;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -66,6 +177,17 @@ public:
 	/// by you and must remain in scope.
 	void SetDebugDraw(b2Draw* debugDraw);
 
+	/// Register a task executor to solve independent islands on several
+	/// threads. Islands touching a static body are still solved one after the
+	/// other, and PostSolve is called on the stepping thread after all islands
+	/// are solved, in the same order as without an executor, so the results
+	/// do not depend on the number of threads. The contact manifolds are
+	/// computed on the executor as well, the listener is still called on the
+	/// stepping thread in the usual order. Null (the default) does all of it
+	/// on the stepping thread. The executor is owned by you and must remain
+	/// in scope.
+	void SetTaskExecutor(b2TaskExecutor* executor);
+
 	/// Create a rigid body given a definition. No reference to the definition
 	/// is retained.
 	/// @warning This function is locked during callbacks.
@@ -77,6 +199,34 @@ public:
 	/// @warning This function is locked during callbacks.
 	void DestroyBody(b2Body* body);
 
+	/// Begin creating many fixtures on static bodies, e.g. the edges of a map.
+	/// Until the matching EndStaticBulk, their broad-phase proxies are not
+	/// inserted one by one, the static tree is built in one top-down pass at
+	/// the end instead. Queries and ray casts do not find these fixtures until
+	/// then. Likewise, the proxies of fixtures on static bodies destroyed
+	/// until then are removed at the end, e.g. when destroying a map. Calls
+	/// nest, the next time step inserts and removes the pending proxies.
+	/// @warning This function is locked during callbacks.
+	void BeginStaticBulk();
+
+	/// End creating or destroying many fixtures on static bodies, see
+	/// BeginStaticBulk.
+	/// @warning This function is locked during callbacks.
+	void EndStaticBulk();
+
+	/// Begin destroying many bodies, e.g. a fleet of models or a whole world.
+	/// Until the matching EndBulkDestroy, the broad-phase proxies of the
+	/// destroyed fixtures are only marked destroyed, static or not, and
+	/// removed from the trees at the end, which are rebuilt in one top-down
+	/// pass if the destroyed proxies are many. Queries and ray casts skip
+	/// them. Implies BeginStaticBulk. Calls nest.
+	/// @warning This function is locked during callbacks.
+	void BeginBulkDestroy();
+
+	/// End destroying many bodies, see BeginBulkDestroy.
+	/// @warning This function is locked during callbacks.
+	void EndBulkDestroy();
+
 	/// Create a joint to constrain bodies together. No reference to the definition
 	/// is retained. This may cause the connected bodies to cease colliding.
 	/// @warning This function is locked during callbacks.
@@ -121,6 +271,23 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Find the nearest hit of each of a packet of rays, e.g. the beams of a
+	/// laser. The broad-phase trees are traversed once for all rays, with the
+	/// nodes tested against the rays overlapping their parents, and the
+	/// fixtures are filtered without callbacks. Coherent rays, i.e. with close
+	/// origins and directions, share the most work. Thread safe, like RayCast.
+	/// @param inputs the rays, each from p1 to p1 + maxFraction * (p2 - p1).
+	/// @param count the number of rays.
+	/// @param filter the fixtures to test.
+	/// @param hits the nearest hit of each ray, of size count.
+	void RayCastBatch(const b2RayCastInput* inputs, int32 count, const b2RayBatchFilter& filter, b2RayBatchHit* hits) const;
+
+	/// Flatland: take a snapshot of the world to ray cast while it is stepped,
+	/// see b2RayCastSnapshot. This costs a copy of the tree of the moving
+	/// proxies, the static tree is shared.
+	/// @warning this should be called outside of a time step.
+	void TakeRayCastSnapshot(b2RayCastSnapshot* snapshot);
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A nullptr body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -149,7 +316,8 @@ public:
 	void SetWarmStarting(bool flag) { m_warmStarting = flag; }
 	bool GetWarmStarting() const { return m_warmStarting; }
 
-	/// Enable/disable continuous physics. For testing.
+	/// Enable/disable continuous physics. When disabled, only the bullets and
+	/// the bodies flagged with b2Body::SetContinuous get TOI events.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 	bool GetContinuousPhysics() const { return m_continuousPhysics; }
 
@@ -157,6 +325,17 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Flatland: set the adaptive margins of the fat AABBs. The margin of a
+	/// proxy changes when it is reinserted, and a proxy whose fat AABB has
+	/// become much larger than its margin is reinserted.
+	void SetAdaptiveAABB(const b2AdaptiveAABB& adaptive) { m_adaptiveAABB = adaptive; }
+	const b2AdaptiveAABB& GetAdaptiveAABB() const { return m_adaptiveAABB; }
+
+	/// Flatland: set when the islands fall asleep, e.g. sooner to skip
+	/// solving resting fleets. Takes effect with the next time step.
+	void SetSleepSettings(const b2SleepSettings& sleep) { m_sleepSettings = sleep; }
+	const b2SleepSettings& GetSleepSettings() const { return m_sleepSettings; }
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -179,6 +358,13 @@ public:
 	/// The minimum is 1.
 	float32 GetTreeQuality() const;
 
+	/// Get the number of broad-phase proxies of static bodies, these are kept
+	/// in a separate static tree.
+	int32 GetStaticProxyCount() const;
+
+	/// Get the height of the static tree.
+	int32 GetStaticTreeHeight() const;
+
 	/// Change the global gravity vector.
 	void SetGravity(const b2Vec2& gravity);
 	
@@ -205,6 +391,21 @@ public:
 	/// Get the current profile.
 	const b2Profile& GetProfile() const;
 
+	/// Flatland: get what the last time step solved.
+	const b2StepStats& GetStepStats() const;
+
+	/// Flatland: set the size of the chunks of the allocator of the bodies,
+	/// fixtures, shapes, contacts and joints, see b2BlockAllocator::SetChunkSize.
+	void SetAllocatorChunkSize(int32 chunkSize, int32 maxChunkSize);
+
+	/// Flatland: get the memory held by the allocator of the bodies,
+	/// fixtures, shapes, contacts and joints.
+	b2BlockAllocatorStats GetAllocatorStats() const;
+
+	/// Flatland: get the most memory the stack allocator of the time steps
+	/// held at once, allocations beyond b2_stackSize are on the heap.
+	int32 GetStackAllocatorMaxAllocation() const;
+
 	/// Dump the world into the log file.
 	/// @warning this should be called outside of a time step.
 	void Dump();
@@ -225,6 +426,9 @@ private:
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
+	void SolveIslandsParallel(const b2TimeStep& step);
+	void IntegrateBypassed(const b2TimeStep& step);
+	void UpdateAABBExtension(b2Body* body, float32 dt);
 	void SolveTOI(const b2TimeStep& step);
 
 	void DrawJoint(b2Joint* joint);
@@ -243,12 +447,18 @@ private:
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
+	// Number of bullets and bodies flagged as continuous.
+	int32 m_continuousBodyCount;
+
 	b2Vec2 m_gravity;
 	bool m_allowSleep;
 
 	b2DestructionListener* m_destructionListener;
 	b2Draw* g_debugDraw;
 
+	b2TaskExecutor* m_taskExecutor;
+	b2ParallelSolver* m_parallelSolver;
+
 	// This is used to compute the time step ratio to
 	// support a variable time step.
 	float32 m_inv_dt0;
@@ -261,6 +471,10 @@ private:
 	bool m_stepComplete;
 
 	b2Profile m_profile;
+	b2StepStats m_stepStats;
+
+	b2AdaptiveAABB m_adaptiveAABB;
+	b2SleepSettings m_sleepSettings;
 };
 
 inline b2Body* b2World::GetBodyList()
@@ -351,4 +565,24 @@ inline const b2Profile& b2World::GetProfile() const
 	return m_profile;
 }
 
+inline const b2StepStats& b2World::GetStepStats() const
+{
+	return m_stepStats;
+}
+
+inline void b2World::SetAllocatorChunkSize(int32 chunkSize, int32 maxChunkSize)
+{
+	m_blockAllocator.SetChunkSize(chunkSize, maxChunkSize);
+}
+
+inline b2BlockAllocatorStats b2World::GetAllocatorStats() const
+{
+	return m_blockAllocator.GetStats();
+}
+
+inline int32 b2World::GetStackAllocatorMaxAllocation() const
+{
+	return m_stackAllocator.GetMaxAllocation();
+}
+
 #endif
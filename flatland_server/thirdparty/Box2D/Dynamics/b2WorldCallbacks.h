@@ -152,4 +152,25 @@ public:
 									const b2Vec2& normal, float32 fraction) = 0;
 };
 
+/// A function called by b2TaskExecutor::ParallelFor for each index.
+typedef void b2TaskFcn(void* context, int32 index);
+
+/// Implement this class to let b2World::Step solve independent islands and
+/// compute the contact manifolds on several threads. See
+/// b2World::SetTaskExecutor.
+class b2TaskExecutor
+{
+public:
+	virtual ~b2TaskExecutor() {}
+
+	/// Call fcn(context, i) for each i in [0, count), possibly concurrently,
+	/// and return when all calls are done.
+	virtual void ParallelFor(b2TaskFcn* fcn, void* context, int32 count) = 0;
+
+	/// Get the number of threads running the calls of ParallelFor, including
+	/// the calling thread. Nothing is done in parallel unless this is more
+	/// than one.
+	virtual int32 GetThreadCount() const = 0;
+};
+
 #endif
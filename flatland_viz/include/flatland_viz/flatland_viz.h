@@ -97,12 +97,27 @@ class FlatlandViz : public QWidget {
       FlatlandViz(FlatlandWindow* parent = 0);
 
   /**
-   * @brief Recieve a new DebugTopicList msg and add any new displays required
+   * @brief Recieve a new DebugTopicList msg and add any new displays required,
+   * or apply the topics added and removed of a delta
    *
    * @param msg The DebugTopicList message
    */
   void RecieveDebugTopics(const flatland_msgs::DebugTopicList& msg);
 
+  /**
+   * @brief Add the marker display of a debug topic, if it does not exist
+   *
+   * @param topic The debug topic
+   */
+  void AddDebugDisplay(const std::string& topic);
+
+  /**
+   * @brief Remove the marker display of a debug topic, if it exists
+   *
+   * @param topic The debug topic
+   */
+  void RemoveDebugDisplay(const std::string& topic);
+
   /**
    * @brief Destruct
    */
@@ -115,6 +130,10 @@ class FlatlandViz : public QWidget {
 
   rviz::Display* grid_;
   rviz::Display* interactive_markers_;
+  rviz::Display* geometry_;  ///< the geometry stream display, nullptr unless
+                             /// geometry_stream_ is set
+  bool geometry_stream_;     ///< draw the layers and models from the
+                             /// geometry stream instead of their markers
   std::map<std::string, rviz::Display*> debug_displays_;
   ros::Subscriber debug_topic_subscriber_;
   rviz::PropertyTreeWidget* tree_widget_;
@@ -0,0 +1,167 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name   geometry_display.h
+ * @brief  Rviz display rendering the compact geometry stream
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GEOMETRY_DISPLAY_H
+#define GEOMETRY_DISPLAY_H
+
+#include <flatland_msgs/BodyPoses.h>
+#include <flatland_msgs/WorldGeometry.h>
+#include <ros/ros.h>
+#include <rviz/display.h>
+#include <vector>
+
+namespace Ogre {
+class ManualObject;
+class SceneNode;
+}
+
+namespace rviz {
+class RosTopicProperty;
+}
+
+namespace flatland_viz {
+
+/**
+ * @name                GeometryDisplay
+ * @brief               Rviz display rendering the geometry and body_poses
+ * topics of a world, see flatland_server::GeometryStream. The outlines are
+ * uploaded once per geometry into static vertex buffers, one for the layers
+ * and one per body, and each poses message only moves the scene nodes of the
+ * bodies, so the frame rate does not depend on the marker arrays of the
+ * models
+ */
+class GeometryDisplay : public rviz::Display {
+  Q_OBJECT
+ public:
+  GeometryDisplay();
+  ~GeometryDisplay();
+
+ protected:
+  /**
+   * @name                onInitialize
+   * @brief               Creates the topic properties
+   */
+  void onInitialize() override;
+
+  /**
+   * @name                onEnable
+   * @brief               Subscribes to the topics
+   */
+  void onEnable() override;
+
+  /**
+   * @name                onDisable
+   * @brief               Unsubscribes and hides the geometry
+   */
+  void onDisable() override;
+
+  /**
+   * @name                update
+   * @brief               Places the geometry in the fixed frame
+   */
+  void update(float wall_dt, float ros_dt) override;
+
+  /**
+   * @name                reset
+   * @brief               Drops the geometry until it is received again
+   */
+  void reset() override;
+
+ private Q_SLOTS:
+  /**
+   * @name                updateTopics
+   * @brief               Subscribes to the topics set in the properties
+   */
+  void updateTopics();
+
+ private:
+  /**
+   * @name                subscribe
+   * @brief               Subscribes to the topics if enabled
+   */
+  void subscribe();
+
+  /**
+   * @name                unsubscribe
+   * @brief               Unsubscribes from the topics
+   */
+  void unsubscribe();
+
+  /**
+   * @name                clear
+   * @brief               Destroys the vertex buffers and scene nodes
+   */
+  void clear();
+
+  /**
+   * @name                receiveGeometry
+   * @brief               Rebuilds the vertex buffers from a geometry message
+   * @param[in] msg       The geometry
+   */
+  void receiveGeometry(const flatland_msgs::WorldGeometry::ConstPtr &msg);
+
+  /**
+   * @name                receivePoses
+   * @brief               Moves the bodies to their poses, the poses of
+   * another geometry version are ignored
+   * @param[in] msg       The poses
+   */
+  void receivePoses(const flatland_msgs::BodyPoses::ConstPtr &msg);
+
+  rviz::RosTopicProperty *geometry_topic_property_;  ///< geometry topic
+  rviz::RosTopicProperty *poses_topic_property_;     ///< body_poses topic
+  ros::Subscriber geometry_sub_;  ///< subscription to the geometry
+  ros::Subscriber poses_sub_;     ///< subscription to the body poses
+  std::string frame_id_;          ///< frame of the geometry
+  uint32_t version_ = 0;          ///< version of the geometry shown
+  bool has_geometry_ = false;     ///< if a geometry was received
+  Ogre::ManualObject *layers_ = nullptr;  ///< outlines of the layers
+  std::vector<Ogre::SceneNode *> body_nodes_;  ///< node of each body
+  std::vector<Ogre::ManualObject *> bodies_;   ///< outline of each body
+};
+}
+
+#endif  // GEOMETRY_DISPLAY_H
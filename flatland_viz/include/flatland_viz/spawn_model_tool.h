@@ -49,7 +49,12 @@
 #define SPAWN_MODEL_TOOL_H
 
 #include <rviz/tool.h>
+#include <ctime>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <OGRE/OgreEntity.h>
@@ -63,6 +68,20 @@
 #include "rviz/ogre_helpers/arrow.h"
 
 namespace flatland_viz {
+/**
+ * @name                ModelPreview
+ * @brief               The outlines of the footprints of a model, parsed from
+ * its yaml file
+ */
+struct ModelPreview {
+  /// A closed outline of a footprint
+  struct Outline {
+    flatland_server::Pose pose;  ///< pose of the body in the model frame
+    std::vector<flatland_server::Vec2> points;  ///< in the body frame
+  };
+  std::vector<Outline> outlines;  ///< the outlines of the enabled bodies
+};
+
 /**
  * @name                SpawnModelTool
  * @brief               Every tool which can be added to the tool bar is a
@@ -128,25 +147,61 @@ class SpawnModelTool : public rviz::Tool {
   void SetMovingModelColor(QColor c);
   /**
    * @name               LoadPreview
-   * @brief              Load a vector preview of the model
+   * @brief              Show the preview of the model, from the cache if the
+   * model file did not change since it was parsed, otherwise the file is
+   * parsed on a worker thread and the preview shown once it is done
    */
   void LoadPreview();
+  /**
+   * @name               ShowPreview
+   * @brief              Replace the lines of the preview
+   * @param preview      The outlines to show
+   */
+  void ShowPreview(const ModelPreview &preview);
+  /**
+   * @name               ParsePreview
+   * @brief              Parse the outlines of a model file, thread safe
+   * @param path         Path to the model yaml
+   * @return             The outlines, nullptr if the file is invalid
+   */
+  static std::shared_ptr<const ModelPreview> ParsePreview(
+      const std::string &path);
+  /**
+   * @name               GetCachedPreview
+   * @brief              Look up a parsed preview, thread safe
+   * @param path         Path to the model yaml
+   * @param mtime        Modification time of the file
+   * @return             The outlines, nullptr if the file was not parsed
+   * since it last changed
+   */
+  static std::shared_ptr<const ModelPreview> GetCachedPreview(
+      const std::string &path, std::time_t mtime);
   /**
    * @name               LoadPolygonFootprint
    * @brief              Load a vector preview of the model's polygon footprint
    * @param footprint    The footprint yaml node
-   * @param pose         x,y,theta pose of footprint
+   * @param outline      The outline, the points are appended
    */
-  void LoadPolygonFootprint(flatland_server::YamlReader &footprint,
-                            const flatland_server::Pose pose);
+  static void LoadPolygonFootprint(flatland_server::YamlReader &footprint,
+                                   ModelPreview::Outline *outline);
   /**
    * @name               LoadCircleFootprint
    * @brief              Load a vector preview of the model's circle footprint
    * @param footprint    The footprint yaml node
-   * @param pose         x,y,theta pose of footprint
+   * @param outline      The outline, the points are appended
    */
-  void LoadCircleFootprint(flatland_server::YamlReader &footprint,
-                           const flatland_server::Pose pose);
+  static void LoadCircleFootprint(flatland_server::YamlReader &footprint,
+                                  ModelPreview::Outline *outline);
+
+ private Q_SLOTS:
+  /**
+   * @name               OnPreviewParsed
+   * @brief              Show the preview parsed by the worker thread, if it
+   * is still the one of the selected model
+   */
+  void OnPreviewParsed();
+
+ private:
 
   Ogre::Vector3
       intersection;     // location cursor intersects ground plane, ie the
@@ -164,6 +219,22 @@ class SpawnModelTool : public rviz::Tool {
   ros::NodeHandle nh;         // ros service node handle
   ros::ServiceClient client;  // ros service client
   std::vector<std::shared_ptr<rviz::BillboardLine>> lines_list_;
+
+ private:
+  /// A preview in the cache
+  struct CachedPreview {
+    std::time_t mtime;                            ///< of the model file
+    std::shared_ptr<const ModelPreview> preview;  ///< the outlines
+  };
+
+  static std::mutex cache_mutex_;  ///< guards cache_
+  static std::map<std::string, CachedPreview>
+      cache_;                  ///< previews by model file path
+  std::future<void> parsing_;  ///< the worker thread parsing a preview
+  std::mutex parsed_mutex_;    ///< guards the members below
+  std::string parsed_path_;    ///< path of parsed_
+  std::shared_ptr<const ModelPreview> parsed_;  ///< preview parsed by the
+                                                /// worker thread
 };
 
 }  // end namespace flatland_viz
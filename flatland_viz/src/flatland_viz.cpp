@@ -155,6 +155,21 @@ FlatlandViz::FlatlandViz(FlatlandWindow* parent) : QWidget((QWidget*)parent) {
   interactive_markers_->subProp("Update Topic")
       ->setValue("/interactive_model_markers/update");
 
+  // With ~geometry_stream, the layers and models are drawn from the compact
+  // geometry stream of the world instead of their marker arrays, see the
+  // geometry_stream_rate property of the world
+  ros::NodeHandle private_nh("~");
+  private_nh.param("geometry_stream", geometry_stream_, false);
+  geometry_ = nullptr;
+  if (geometry_stream_) {
+    geometry_ =
+        manager_->createDisplay("flatland_viz/Geometry", "geometry", true);
+    if (geometry_ == nullptr) {
+      ROS_FATAL("Geometry display failed to instantiate");
+      exit(1);
+    }
+  }
+
   // Subscribe to debug topics topic
   ros::NodeHandle n;
   debug_topic_subscriber_ = n.subscribe("/flatland_server/debug/topics", 0,
@@ -375,29 +390,56 @@ void FlatlandViz::setFullScreen(bool full_screen) {
 }
 
 void FlatlandViz::RecieveDebugTopics(const flatland_msgs::DebugTopicList& msg) {
-  std::vector<std::string> topics = msg.topics;
+  if (msg.delta) {
+    for (const auto& topic : msg.removed) {
+      RemoveDebugDisplay(topic);
+    }
+    for (const auto& topic : msg.added) {
+      AddDebugDisplay(topic);
+    }
+    return;
+  }
 
   // check for deleted topics
-  for (auto& topic : debug_displays_) {
-    if (std::count(topics.begin(), topics.end(), topic.first) == 0) {
-      delete debug_displays_[topic.first];
-      debug_displays_.erase(topic.first);
+  std::vector<std::string> deleted;
+  for (const auto& topic : debug_displays_) {
+    if (std::count(msg.topics.begin(), msg.topics.end(), topic.first) == 0) {
+      deleted.push_back(topic.first);
     }
   }
+  for (const auto& topic : deleted) {
+    RemoveDebugDisplay(topic);
+  }
 
   // check for new topics
-  for (const auto& topic : topics) {
-    if (debug_displays_.count(topic) == 0) {
-      // Create the marker display and set its topic
-      debug_displays_[topic] = manager_->createDisplay(
-          "rviz/MarkerArray", QString::fromLocal8Bit(topic.c_str()), true);
-      if (debug_displays_[topic] == nullptr) {
-        ROS_FATAL("MarkerArray failed to instantiate");
-        exit(1);
-      }
-      QString topic_qt = QString::fromLocal8Bit(
-          (std::string("/flatland_server/debug/") + topic).c_str());
-      debug_displays_[topic]->subProp("Marker Topic")->setValue(topic_qt);
+  for (const auto& topic : msg.topics) {
+    AddDebugDisplay(topic);
+  }
+}
+
+void FlatlandViz::AddDebugDisplay(const std::string& topic) {
+  if (geometry_stream_ && (topic.compare(0, 5, "layer") == 0 ||
+                           topic.compare(0, 5, "model") == 0)) {
+    return;
+  }
+  if (debug_displays_.count(topic) == 0) {
+    // Create the marker display and set its topic
+    debug_displays_[topic] = manager_->createDisplay(
+        "rviz/MarkerArray", QString::fromLocal8Bit(topic.c_str()), true);
+    if (debug_displays_[topic] == nullptr) {
+      ROS_FATAL("MarkerArray failed to instantiate");
+      exit(1);
     }
+    QString topic_qt = QString::fromLocal8Bit(
+        (std::string("/flatland_server/debug/") + topic).c_str());
+    debug_displays_[topic]->subProp("Marker Topic")->setValue(topic_qt);
+  }
+}
+
+void FlatlandViz::RemoveDebugDisplay(const std::string& topic) {
+  auto it = debug_displays_.find(topic);
+  if (it != debug_displays_.end()) {
+    delete it->second;
+    debug_displays_.erase(it);
   }
 }
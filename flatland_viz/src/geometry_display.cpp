@@ -0,0 +1,252 @@
+/*
+ *  ______                   __  __              __
+ * /\  _  \           __    /\ \/\ \            /\ \__
+ * \ \ \L\ \  __  __ /\_\   \_\ \ \ \____    ___\ \ ,_\   ____
+ *  \ \  __ \/\ \/\ \\/\ \  /'_` \ \ '__`\  / __`\ \ \/  /',__\
+ *   \ \ \/\ \ \ \_/ |\ \ \/\ \L\ \ \ \L\ \/\ \L\ \ \ \_/\__, `\
+ *    \ \_\ \_\ \___/  \ \_\ \___,_\ \_,__/\ \____/\ \__\/\____/
+ *     \/_/\/_/\/__/    \/_/\/__,_ /\/___/  \/___/  \/__/\/___/
+ * @copyright Copyright 2017 Avidbots Corp.
+ * @name   geometry_display.cpp
+ * @brief  Rviz display rendering the compact geometry stream
+ * @author Chunshang Li
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, Avidbots Corp.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Avidbots Corp. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <flatland_viz/geometry_display.h>
+
+#include <OGRE/OgreManualObject.h>
+#include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreSceneNode.h>
+
+#include <rviz/display_context.h>
+#include <rviz/frame_manager.h>
+#include <rviz/properties/ros_topic_property.h>
+
+#include <algorithm>
+
+namespace flatland_viz {
+
+namespace {
+const char *MATERIAL = "BaseWhiteNoLighting";
+
+// Appends segments as a line list with the color of their body, Ogre does
+// not accept empty sections
+void AddSegments(Ogre::ManualObject *object, const float *segments,
+                 size_t count, const Ogre::ColourValue &color) {
+  if (count == 0) {
+    return;
+  }
+  object->begin(MATERIAL, Ogre::RenderOperation::OT_LINE_LIST);
+  for (size_t i = 0; i < count; i++) {
+    const float *s = segments + 4 * i;
+    object->position(s[0], s[1], 0);
+    object->colour(color);
+    object->position(s[2], s[3], 0);
+    object->colour(color);
+  }
+  object->end();
+}
+}
+
+GeometryDisplay::GeometryDisplay() {
+  geometry_topic_property_ = new rviz::RosTopicProperty(
+      "Geometry Topic", "/geometry",
+      QString::fromStdString(
+          ros::message_traits::datatype<flatland_msgs::WorldGeometry>()),
+      "flatland_msgs::WorldGeometry topic to subscribe to.", this,
+      SLOT(updateTopics()));
+  poses_topic_property_ = new rviz::RosTopicProperty(
+      "Poses Topic", "/body_poses",
+      QString::fromStdString(
+          ros::message_traits::datatype<flatland_msgs::BodyPoses>()),
+      "flatland_msgs::BodyPoses topic to subscribe to.", this,
+      SLOT(updateTopics()));
+}
+
+GeometryDisplay::~GeometryDisplay() {
+  unsubscribe();
+  clear();
+}
+
+void GeometryDisplay::onInitialize() {}
+
+void GeometryDisplay::onEnable() {
+  subscribe();
+  scene_node_->setVisible(true);
+}
+
+void GeometryDisplay::onDisable() {
+  unsubscribe();
+  scene_node_->setVisible(false);
+}
+
+void GeometryDisplay::reset() {
+  rviz::Display::reset();
+  clear();
+}
+
+void GeometryDisplay::updateTopics() {
+  unsubscribe();
+  clear();
+  subscribe();
+}
+
+void GeometryDisplay::subscribe() {
+  if (!isEnabled()) {
+    return;
+  }
+  // the callbacks run on the update thread of rviz, where Ogre may be used
+  geometry_sub_ =
+      update_nh_.subscribe(geometry_topic_property_->getTopicStd(), 1,
+                           &GeometryDisplay::receiveGeometry, this);
+  poses_sub_ = update_nh_.subscribe(poses_topic_property_->getTopicStd(), 1,
+                                    &GeometryDisplay::receivePoses, this);
+}
+
+void GeometryDisplay::unsubscribe() {
+  geometry_sub_.shutdown();
+  poses_sub_.shutdown();
+}
+
+void GeometryDisplay::clear() {
+  if (scene_manager_ == nullptr) {
+    return;
+  }
+  if (layers_ != nullptr) {
+    scene_manager_->destroyManualObject(layers_);
+    layers_ = nullptr;
+  }
+  for (Ogre::ManualObject *object : bodies_) {
+    scene_manager_->destroyManualObject(object);
+  }
+  for (Ogre::SceneNode *node : body_nodes_) {
+    scene_manager_->destroySceneNode(node);
+  }
+  bodies_.clear();
+  body_nodes_.clear();
+  has_geometry_ = false;
+}
+
+void GeometryDisplay::update(float wall_dt, float ros_dt) {
+  if (!has_geometry_) {
+    return;
+  }
+  Ogre::Vector3 position;
+  Ogre::Quaternion orientation;
+  if (!context_->getFrameManager()->getTransform(frame_id_, ros::Time(),
+                                                 position, orientation)) {
+    setStatus(rviz::StatusProperty::Error, "Transform",
+              QString::fromStdString("No transform from [" + frame_id_ +
+                                     "] to the fixed frame"));
+    return;
+  }
+  setStatus(rviz::StatusProperty::Ok, "Transform", "Transform OK");
+  scene_node_->setPosition(position);
+  scene_node_->setOrientation(orientation);
+}
+
+void GeometryDisplay::receiveGeometry(
+    const flatland_msgs::WorldGeometry::ConstPtr &msg) {
+  size_t count = msg->names.size();
+  bool valid = msg->colors.size() == 4 * count &&
+               msg->segment_ends.size() == count &&
+               msg->static_count <= count &&
+               std::is_sorted(msg->segment_ends.begin(),
+                              msg->segment_ends.end()) &&
+               msg->segments.size() ==
+                   4 * size_t(count > 0 ? msg->segment_ends.back() : 0);
+  if (!valid) {
+    setStatus(rviz::StatusProperty::Error, "Geometry", "Invalid message");
+    return;
+  }
+  clear();
+
+  // the layers are static, they share one vertex buffer in the world frame
+  layers_ = scene_manager_->createManualObject();
+  layers_->setDynamic(false);
+  size_t begin = 0;
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t *c = &msg->colors[4 * i];
+    Ogre::ColourValue color(c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f,
+                            c[3] / 255.0f);
+    size_t end = msg->segment_ends[i];
+    const float *segments = msg->segments.data() + 4 * begin;
+    if (i < msg->static_count) {
+      AddSegments(layers_, segments, end - begin, color);
+    } else {
+      Ogre::ManualObject *object = scene_manager_->createManualObject();
+      object->setDynamic(false);
+      AddSegments(object, segments, end - begin, color);
+      Ogre::SceneNode *node = scene_node_->createChildSceneNode();
+      node->attachObject(object);
+      // hidden until their first pose is received
+      node->setVisible(false);
+      bodies_.push_back(object);
+      body_nodes_.push_back(node);
+    }
+    begin = end;
+  }
+  scene_node_->attachObject(layers_);
+
+  frame_id_ = msg->header.frame_id;
+  version_ = msg->version;
+  has_geometry_ = true;
+  setStatus(rviz::StatusProperty::Ok, "Geometry",
+            QString::number(count) + " bodies, " +
+                QString::number(msg->segments.size() / 4) + " segments");
+}
+
+void GeometryDisplay::receivePoses(
+    const flatland_msgs::BodyPoses::ConstPtr &msg) {
+  if (!has_geometry_ || msg->version != version_ ||
+      msg->poses.size() != 3 * body_nodes_.size()) {
+    return;
+  }
+  for (size_t i = 0; i < body_nodes_.size(); i++) {
+    const float *pose = &msg->poses[3 * i];
+    Ogre::SceneNode *node = body_nodes_[i];
+    node->setPosition(pose[0], pose[1], 0);
+    node->setOrientation(
+        Ogre::Quaternion(Ogre::Radian(pose[2]), Ogre::Vector3::UNIT_Z));
+    node->setVisible(true);
+  }
+  context_->queueRender();
+}
+
+}  // end namespace flatland_viz
+
+// Tell pluginlib about the display class
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(flatland_viz::GeometryDisplay, rviz::Display)
@@ -78,6 +78,8 @@ class DialogOptionsWidget;
 namespace flatland_viz {
 QString SpawnModelTool::path_to_model_file_;
 QString SpawnModelTool::model_name;
+std::mutex SpawnModelTool::cache_mutex_;
+std::map<std::string, SpawnModelTool::CachedPreview> SpawnModelTool::cache_;
 
 // Set the "shortcut_key_" member variable defined in the
 // superclass to declare which key will activate the tool.
@@ -90,6 +92,10 @@ SpawnModelTool::SpawnModelTool() : moving_model_node_(NULL) {
 // only called when the tool is removed from the toolbar with the "-"
 // button.
 SpawnModelTool::~SpawnModelTool() {
+  // the worker thread uses this tool, and its queued call is dropped with it
+  if (parsing_.valid()) {
+    parsing_.wait();
+  }
   scene_manager_->destroySceneNode(arrow_->getSceneNode());
   scene_manager_->destroySceneNode(moving_model_node_);
 }
@@ -293,10 +299,85 @@ void SpawnModelTool::LoadPreview() {
   moving_model_node_->removeAllChildren();
   lines_list_.clear();
 
-  // Load the bodies list into a model object
-  flatland_server::YamlReader reader(path_to_model_file_.toStdString());
+  std::string path = path_to_model_file_.toStdString();
+  boost::system::error_code ec;
+  std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+  std::shared_ptr<const ModelPreview> preview =
+      ec ? nullptr : GetCachedPreview(path, mtime);
+  if (preview) {
+    ShowPreview(*preview);
+    return;
+  }
+
+  // a previous selection still parsing is waited for, there is a single
+  // worker thread
+  if (parsing_.valid()) {
+    parsing_.wait();
+  }
+  parsing_ = std::async(std::launch::async, [this, path, mtime]() {
+    std::shared_ptr<const ModelPreview> parsed = ParsePreview(path);
+    if (parsed) {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      cache_[path] = CachedPreview{mtime, parsed};
+    }
+    {
+      std::lock_guard<std::mutex> lock(parsed_mutex_);
+      parsed_path_ = path;
+      parsed_ = parsed;
+    }
+    QMetaObject::invokeMethod(this, "OnPreviewParsed", Qt::QueuedConnection);
+  });
+}
+
+void SpawnModelTool::OnPreviewParsed() {
+  std::shared_ptr<const ModelPreview> preview;
+  {
+    std::lock_guard<std::mutex> lock(parsed_mutex_);
+    if (parsed_path_ != path_to_model_file_.toStdString()) {
+      return;  // another model was selected meanwhile
+    }
+    preview = parsed_;
+  }
+  if (preview) {
+    ShowPreview(*preview);
+  }
+}
+
+std::shared_ptr<const ModelPreview> SpawnModelTool::GetCachedPreview(
+    const std::string &path, std::time_t mtime) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  auto it = cache_.find(path);
+  if (it == cache_.end() || it->second.mtime != mtime) {
+    return nullptr;
+  }
+  return it->second.preview;
+}
+
+void SpawnModelTool::ShowPreview(const ModelPreview &preview) {
+  moving_model_node_->removeAllChildren();
+  lines_list_.clear();
+
+  for (const auto &outline : preview.outlines) {
+    lines_list_.push_back(std::make_shared<rviz::BillboardLine>(
+        context_->getSceneManager(), moving_model_node_));
+    auto lines = lines_list_.back();
+    lines->setColor(0.0, 1.0, 0.0, 0.75);  // Green
+    lines->setLineWidth(0.05);
+    lines->setOrientation(Ogre::Quaternion(Ogre::Radian(outline.pose.theta),
+                                           Ogre::Vector3(0, 0, 1)));
+    lines->setPosition(Ogre::Vector3(outline.pose.x, outline.pose.y, 0));
+    for (const auto &p : outline.points) {
+      lines->addPoint(Ogre::Vector3(p.x, p.y, 0.));
+    }
+  }
+}
 
+std::shared_ptr<const ModelPreview> SpawnModelTool::ParsePreview(
+    const std::string &path) {
+  auto preview = std::make_shared<ModelPreview>();
   try {
+    // Load the bodies list into a model object
+    flatland_server::YamlReader reader(path);
     flatland_server::YamlReader bodies_reader =
         reader.Subnode("bodies", flatland_server::YamlReader::LIST);
     // Iterate each body and add to the preview
@@ -315,55 +396,49 @@ void SpawnModelTool::LoadPreview() {
         flatland_server::YamlReader footprint =
             footprints_node.Subnode(j, flatland_server::YamlReader::MAP);
 
-        lines_list_.push_back(std::make_shared<rviz::BillboardLine>(
-            context_->getSceneManager(), moving_model_node_));
-        auto lines = lines_list_.back();
-        lines->setColor(0.0, 1.0, 0.0, 0.75);  // Green
-        lines->setLineWidth(0.05);
-        lines->setOrientation(
-            Ogre::Quaternion(Ogre::Radian(pose.theta), Ogre::Vector3(0, 0, 1)));
-        lines->setPosition(Ogre::Vector3(pose.x, pose.y, 0));
+        preview->outlines.emplace_back();
+        ModelPreview::Outline &outline = preview->outlines.back();
+        outline.pose = pose;
 
         std::string type = footprint.Get<std::string>("type");
         if (type == "circle") {
-          LoadCircleFootprint(footprint, pose);
+          LoadCircleFootprint(footprint, &outline);
         } else if (type == "polygon") {
-          LoadPolygonFootprint(footprint, pose);
+          LoadPolygonFootprint(footprint, &outline);
         } else {
           throw flatland_server::YAMLException("Invalid footprint \"type\"");
         }
       }
     }
-  } catch (const flatland_server::YAMLException &e) {
+  } catch (const flatland_server::Exception &e) {
     ROS_ERROR_STREAM("Couldn't load model bodies for preview" << e.what());
+    return nullptr;
   }
+  return preview;
 }
 
 void SpawnModelTool::LoadPolygonFootprint(
-    flatland_server::YamlReader &footprint, const flatland_server::Pose pose) {
-  auto lines = lines_list_.back();
+    flatland_server::YamlReader &footprint, ModelPreview::Outline *outline) {
   auto points = footprint.GetList<flatland_server::Vec2>("points", 3,
                                                          b2_maxPolygonVertices);
   for (auto p : points) {
-    lines->addPoint(Ogre::Vector3(p.x, p.y, 0.));
+    outline->points.push_back(p);
   }
   if (points.size() > 0) {
-    lines->addPoint(
-        Ogre::Vector3(points.at(0).x, points.at(0).y, 0.));  // Close the box
+    outline->points.push_back(points.at(0));  // Close the box
   }
 }
 
 void SpawnModelTool::LoadCircleFootprint(flatland_server::YamlReader &footprint,
-                                         const flatland_server::Pose pose) {
-  auto lines = lines_list_.back();
+                                         ModelPreview::Outline *outline) {
   auto center = footprint.GetVec2("center", flatland_server::Vec2());
   auto radius = footprint.Get<float>("radius", 1.0);
   for (float a = 0.; a < M_PI * 2.0; a += M_PI / 8.) {  // 16 point circle
-    lines->addPoint(Ogre::Vector3(center.x + radius * cos(a),
-                                  center.y + radius * sin(a), 0.));
+    outline->points.push_back(flatland_server::Vec2(
+        center.x + radius * cos(a), center.y + radius * sin(a)));
   }
-  lines->addPoint(
-      Ogre::Vector3(center.x + radius, center.y, 0.));  // close the loop
+  outline->points.push_back(
+      flatland_server::Vec2(center.x + radius, center.y));  // close the loop
 }
 
 void SpawnModelTool::SavePath(QString p) {
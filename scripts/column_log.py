@@ -0,0 +1,175 @@
+#!/usr/bin/env python2
+
+'''
+This program reads the column logs written by flatland, e.g. by the
+TrajectoryLogger world plugin, see flatland_server/column_log.h for the
+format. It prints the tables of a log, or exports them to one CSV file per
+table. Import it to load a log into numpy arrays with read_column_log.
+
+run with --help to see more options
+'''
+
+import argparse
+import collections
+import csv
+import os
+import struct
+import zlib
+
+import numpy as np
+
+MAGIC = b"FLCOLLOG"
+VERSION = 1
+TABLE_BLOCK = 1
+CHUNK_BLOCK = 2
+RAW = 0
+ZLIB = 1
+
+UINT32, FLOAT32, FLOAT64, FLOAT32_LIST, STRING = range(5)
+DTYPES = {UINT32: "<u4", FLOAT32: "<f4", FLOAT64: "<f8",
+          FLOAT32_LIST: "<f4", STRING: "u1"}
+
+
+class Reader(object):
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            if self.pos >= len(self.data):
+                raise EOFError()
+            byte = ord(self.data[self.pos:self.pos + 1])
+            self.pos += 1
+            value |= (byte & 0x7f) << shift
+            if not byte & 0x80:
+                return value
+            shift += 7
+
+    def bytes(self, size):
+        if size > len(self.data) - self.pos:
+            raise EOFError()
+        self.pos += size
+        return self.data[self.pos - size:self.pos]
+
+    def buffer(self, width):
+        codec = self.varint()
+        raw_size = self.varint()
+        stored = self.bytes(self.varint())
+        raw = zlib.decompress(stored) if codec == ZLIB else stored
+        if len(raw) != raw_size:
+            raise ValueError("Invalid column log buffer")
+        values = np.frombuffer(raw, dtype=np.uint8)
+        if width > 1:
+            # join the byte streams of the values
+            values = values.reshape(width, -1).T.copy()
+        return values.tobytes()
+
+
+def read_column_log(path):
+    '''
+    Read all tables of a column log. Returns an ordered dict from table name to
+    an ordered dict from column name to numpy array. The list columns are lists
+    of arrays, the string columns lists of strings. A log cut short ends with
+    its last complete chunk
+    '''
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < 12 or data[:8] != MAGIC:
+        raise ValueError("Invalid column log %s" % path)
+    version = struct.unpack("<I", data[8:12])[0]
+    if version != VERSION:
+        raise ValueError("Unsupported column log version %d in %s" %
+                         (version, path))
+
+    reader = Reader(data)
+    reader.pos = 12
+    tables = []
+    while reader.pos < len(data):
+        try:
+            block = reader.varint()
+            table_id = reader.varint()
+            if block == TABLE_BLOCK:
+                name = reader.bytes(reader.varint()).decode("utf-8")
+                columns = []
+                for _ in range(reader.varint()):
+                    column = reader.bytes(reader.varint()).decode("utf-8")
+                    columns.append((column, reader.varint()))
+                tables.append((name, columns, [[] for _ in columns]))
+                continue
+            if block != CHUNK_BLOCK or table_id >= len(tables):
+                raise ValueError("Invalid column log %s" % path)
+
+            name, columns, chunks = tables[table_id]
+            rows = reader.varint()
+            chunk = []
+            for _, column_type in columns:
+                lengths = None
+                if column_type in (FLOAT32_LIST, STRING):
+                    lengths = np.frombuffer(reader.buffer(1), dtype="<u4")
+                width = np.dtype(DTYPES[column_type]).itemsize
+                values = np.frombuffer(reader.buffer(width),
+                                       dtype=DTYPES[column_type])
+                chunk.append((lengths, values))
+        except EOFError:
+            break
+        for c, (lengths, values) in enumerate(chunk):
+            chunks[c].append((lengths, values))
+
+    result = collections.OrderedDict()
+    for name, columns, chunks in tables:
+        table = collections.OrderedDict()
+        for (column, column_type), parts in zip(columns, chunks):
+            if column_type in (FLOAT32_LIST, STRING):
+                items = []
+                for lengths, values in parts:
+                    ends = np.cumsum(lengths)
+                    for begin, end in zip(ends - lengths, ends):
+                        item = values[begin:end]
+                        if column_type == STRING:
+                            item = item.tobytes().decode("utf-8")
+                        items.append(item)
+                table[column] = items
+            elif parts:
+                table[column] = np.concatenate([v for _, v in parts])
+            else:
+                table[column] = np.zeros(0, dtype=DTYPES[column_type])
+        result[name] = table
+    return result
+
+
+def write_csv(table, path):
+    with open(path, "w") as f:
+        writer = csv.writer(f)
+        writer.writerow(list(table.keys()))
+        for row in zip(*table.values()):
+            writer.writerow([" ".join(repr(float(v)) for v in value)
+                             if isinstance(value, np.ndarray) else value
+                             for value in row])
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(
+        description="Print or export the tables of a flatland column log")
+    arg_parser.add_argument("path", help="path to the column log")
+    arg_parser.add_argument("--csv", metavar="DIR",
+        help="write each table to DIR/<table>.csv, the values of list "
+             "columns separated by spaces")
+    args = arg_parser.parse_args()
+
+    tables = read_column_log(args.path)
+    for name, table in tables.items():
+        rows = len(next(iter(table.values()))) if table else 0
+        print("%s: %d rows, columns %s" % (name, rows, ", ".join(table)))
+
+    if args.csv:
+        if not os.path.isdir(args.csv):
+            os.makedirs(args.csv)
+        for name, table in tables.items():
+            write_csv(table, os.path.join(args.csv, name + ".csv"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python2
+
+'''
+This program converts line segment data files from the text format (one
+"x1 y1 x2 y2" line per segment, as written by map_to_lines.py) to the binary
+format, which flatland maps into memory instead of parsing. Loading large maps
+becomes much faster.
+
+The input is either a line segment data file, or a line segment map yaml file
+in which case the data file it points to is converted and a new map yaml file
+pointing to the binary data file is written next to it.
+
+run with --help to see more options
+'''
+
+import argparse
+import os
+import struct
+import yaml
+
+MAGIC = b"FLSEGS\0\0"
+VERSION = 1
+
+
+def read_text_lines(path):
+    segments = []
+    with open(path, "r") as f:
+        for line_number, line in enumerate(f, 1):
+            values = line.split()
+            if len(values) < 4:
+                raise ValueError("Failed to read line segment from line %d, "
+                                 "in file %s" % (line_number, path))
+            segments.append([float(v) for v in values[:4]])
+    return segments
+
+
+def write_binary_lines(path, segments):
+    with open(path, "wb") as f:
+        f.write(MAGIC)
+        f.write(struct.pack("<IIQ", VERSION, 0, len(segments)))
+        for s in segments:
+            f.write(struct.pack("<4f", *s))
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(
+        description="Convert line segment data files to the binary format")
+    arg_parser.add_argument("input_path",
+        help="path to a line segment data file (.dat) or map yaml file (.yaml)")
+    arg_parser.add_argument("-o", "--output", dest="output_path", default=None,
+        help="path of the binary data file, defaults to the input data file "
+             "with the extension .bin")
+    args = arg_parser.parse_args()
+
+    input_path = os.path.abspath(args.input_path)
+    map_yaml = None
+
+    if input_path.endswith(".yaml"):
+        map_yaml = yaml.safe_load(open(input_path, "r"))
+        if map_yaml.get("type") != "line_segments":
+            raise ValueError("%s is not a line segments map" % input_path)
+        data_path = os.path.join(os.path.dirname(input_path), map_yaml["data"])
+    else:
+        data_path = input_path
+
+    output_path = args.output_path
+    if output_path is None:
+        output_path = os.path.splitext(data_path)[0] + ".bin"
+    output_path = os.path.abspath(output_path)
+
+    segments = read_text_lines(data_path)
+    write_binary_lines(output_path, segments)
+    print("%d line segments written to %s" % (len(segments), output_path))
+
+    if map_yaml is not None:
+        map_yaml["data"] = os.path.relpath(output_path,
+                                           os.path.dirname(input_path))
+        output_yaml_path = os.path.splitext(input_path)[0] + "_bin.yaml"
+        yaml.dump(map_yaml, open(output_yaml_path, "w"))
+        print("map written to %s" % output_yaml_path)
+
+if __name__ == "__main__":
+    main()
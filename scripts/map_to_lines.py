@@ -16,6 +16,7 @@ import argparse
 import cv2
 import yaml
 import os
+from lines_to_binary import write_binary_lines
 
 def main():
     # get all the arguments
@@ -29,6 +30,8 @@ def main():
         help="Output image with line segments drawn on top of the map image")
     arg_parser.add_argument("-d", "--definition", dest="definition", choices=["low", "med", "high"], default="low", 
         help="how detailed you want the linesegments to represent the map")    
+    arg_parser.add_argument("-b", "--binary", dest="binary", action='store_true',
+        help="write the line segments in the binary format (.bin instead of .dat), which loads faster")
     args = arg_parser.parse_args()
 
     map_yaml_path = os.path.abspath(args.map_yaml_path)
@@ -36,6 +39,7 @@ def main():
     filename = args.filename
     output_image = args.output_image
     definition = args.definition
+    binary = args.binary
     
     # extract data from map server format
     node = yaml.load(open(map_yaml_path, "r"))
@@ -52,7 +56,7 @@ def main():
     print("occupied_thresh: %f" % occupied_thresh)
 
     output_yaml_path = os.path.join(output_path, filename + ".yaml")
-    output_lines_path = os.path.join(output_path, filename + ".dat")
+    output_lines_path = os.path.join(output_path, filename + (".bin" if binary else ".dat"))
     output_image_path = os.path.join(output_path, filename + ".png")
 
     print("")
@@ -97,14 +101,16 @@ def main():
     print("%d line segments generated\n" % len(lines))
     
     # generate the line segment file
-    output_lines_file = open(output_lines_path, "w")
     rows = np.size(img, 0)
-    for line in lines:
-        line = line[0]
-        output_lines_file.write("%25.15f %25.15f %25.15f %25.15f\n" % 
-            (line[0], rows - line[1], line[2], rows - line[3]))
-    
-    output_lines_file.close()
+    segments = [(line[0][0], rows - line[0][1], line[0][2], rows - line[0][3])
+                for line in lines]
+    if binary:
+        write_binary_lines(output_lines_path, segments)
+    else:
+        output_lines_file = open(output_lines_path, "w")
+        for segment in segments:
+            output_lines_file.write("%25.15f %25.15f %25.15f %25.15f\n" % segment)
+        output_lines_file.close()
 
     # generate the map yaml file
     output_yaml = {}
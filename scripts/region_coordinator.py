@@ -0,0 +1,69 @@
+#!/usr/bin/env python2
+
+'''
+This program steps the servers of a distributed simulation in lockstep. Each
+server simulates one region of the world, see the region world property, and
+is started with lockstep:=true in its own namespace. At every cycle, all the
+servers run one step through their step_world services at the same time, and
+the next cycle starts once all of them have finished, so the simulation time
+is the same on all servers.
+
+run with --help to see more options
+'''
+
+import argparse
+import threading
+import rospy
+from flatland_msgs.srv import StepWorld
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(
+        description="Step the servers of a distributed simulation in lockstep")
+    arg_parser.add_argument("namespaces", nargs="+",
+        help="namespaces of the servers, e.g. /region_a /region_b")
+    arg_parser.add_argument("-r", "--rate", type=float, default=0,
+        help="max cycles per second of wall time, 0 (default) to step as "
+             "fast as the servers allow")
+    arg_parser.add_argument("-s", "--steps", type=int, default=0,
+        help="number of cycles to run, 0 (default) to run until shut down")
+    args = arg_parser.parse_args(rospy.myargv()[1:])
+
+    rospy.init_node("region_coordinator")
+    services = []
+    for ns in args.namespaces:
+        name = ns.rstrip("/") + "/step_world"
+        rospy.loginfo("waiting for %s", name)
+        rospy.wait_for_service(name)
+        services.append(rospy.ServiceProxy(name, StepWorld, persistent=True))
+
+    responses = [None] * len(services)
+
+    def step(i):
+        try:
+            responses[i] = services[i](1)
+        except rospy.ServiceException as e:
+            responses[i] = e
+
+    rate = rospy.Rate(args.rate) if args.rate > 0 else None
+    cycle = 0
+    while not rospy.is_shutdown() and (args.steps == 0 or cycle < args.steps):
+        threads = [threading.Thread(target=step, args=(i,))
+                   for i in range(len(services))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        for ns, response in zip(args.namespaces, responses):
+            if isinstance(response, Exception) or not response.success:
+                message = response if isinstance(response, Exception) \
+                    else response.message
+                rospy.logfatal("%s failed to step: %s", ns, message)
+                return
+        cycle += 1
+        if rate is not None:
+            rate.sleep()
+
+if __name__ == "__main__":
+    main()
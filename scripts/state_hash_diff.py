@@ -0,0 +1,93 @@
+#!/usr/bin/env python2
+
+'''
+This program compares the state digests of two runs logged by the StateHasher
+world plugin, e.g. of a run with the parallel and pipelined modes against one
+without them. It prints the first step at which the digests differ, with the
+bodies and random generators whose digests differ at that step. It exits with
+1 if the runs diverge, 0 if they agree over the steps they have in common.
+
+run with --help to see more options
+'''
+
+import argparse
+import sys
+
+from column_log import read_column_log
+
+
+def load(path):
+    '''
+    Read a log into (digests by step, times by step, {step: {name: digest}})
+    '''
+    tables = read_column_log(path)
+
+    def digests(table):
+        return [(int(hi) << 32) | int(lo)
+                for hi, lo in zip(table["hash_hi"], table["hash_lo"])]
+
+    steps = tables["steps"]
+    hashes = dict(zip(steps["step"].tolist(), digests(steps)))
+    times = dict(zip(steps["step"].tolist(), steps["time"].tolist()))
+
+    details = {}
+    for names, table, column in (("bodies", "body_hashes", "body"),
+                                 ("generators", "random_states",
+                                  "generator")):
+        name_of = dict(zip(tables[names]["id"].tolist(),
+                           tables[names]["name"]))
+        rows = tables[table]
+        for step, id, digest in zip(rows["step"].tolist(),
+                                    rows[column].tolist(), digests(rows)):
+            details.setdefault(step, {})[(names, name_of[id])] = digest
+    return hashes, times, details
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(
+        description="Find the first step at which two runs logged by the "
+                    "StateHasher world plugin diverge")
+    arg_parser.add_argument("a", help="path to the log of the first run")
+    arg_parser.add_argument("b", help="path to the log of the second run")
+    arg_parser.add_argument("--max-names", type=int, default=10,
+        help="max number of divergent bodies and generators printed")
+    args = arg_parser.parse_args()
+
+    hashes_a, times, details_a = load(args.a)
+    hashes_b, _, details_b = load(args.b)
+    common = sorted(set(hashes_a) & set(hashes_b))
+    divergent = [s for s in common if hashes_a[s] != hashes_b[s]]
+    if not divergent:
+        print("The runs agree over %d common steps (%d and %d steps)" %
+              (len(common), len(hashes_a), len(hashes_b)))
+        return 0
+
+    step = divergent[0]
+    print("The runs diverge at step %d, time %.6f" % (step, times[step]))
+    a = details_a.get(step, {})
+    b = details_b.get(step, {})
+    if not a and not b:
+        print("The logs have no digests per body, log them with details: "
+              "true")
+        return 1
+
+    # the names in the order of the first run, then the ones only in b
+    names = [n for n in sorted(a) if a[n] != b.get(n)]
+    names += [n for n in sorted(b) if n not in a]
+    for key in names[:args.max_names]:
+        if key not in b:
+            state = "only in %s" % args.a
+        elif key not in a:
+            state = "only in %s" % args.b
+        else:
+            state = "%016x != %016x" % (a[key], b[key])
+        kind, name = key
+        print("  %s %s: %s" % ("body" if kind == "bodies" else "generator",
+                                name, state))
+    if len(names) > args.max_names:
+        print("  and %d more" % (len(names) - args.max_names))
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())